@@ -30,8 +30,18 @@
 #include "xpath.h"
 #include "context.h"
 
+#ifdef __SSE2__
+# define LY_SSE2
+# include <emmintrin.h>
+#endif
+
 THREAD_LOCAL enum int_log_opts log_opt;
 THREAD_LOCAL int8_t ly_errno_glob;
+THREAD_LOCAL struct ly_ctx_counters ly_cnt;
+uint32_t ly_ctx_live;
+
+/* allocator of all the memory, the C library functions are used if its callbacks are NULL */
+static struct ly_allocator ly_allocator;
 
 API LY_ERR *
 ly_errno_glob_address(void)
@@ -167,7 +177,8 @@ get_current_dir_name(void)
     char *retval;
 
     if (getcwd(tmp, sizeof(tmp))) {
-        retval = strdup(tmp);
+        /* allocated by the C library as the GNU function */
+        retval = (strdup)(tmp);
         LY_CHECK_ERR_RETURN(!retval, LOGMEM(NULL), NULL);
         return retval;
     }
@@ -1340,6 +1351,146 @@ ly_realloc(void *ptr, size_t size)
     return new_mem;
 }
 
+API int
+ly_set_allocator(const struct ly_allocator *allocator)
+{
+    FUN_IN;
+
+    if (allocator && (!allocator->malloc_clb || !allocator->realloc_clb || !allocator->free_clb)) {
+        LOGARG;
+        return EXIT_FAILURE;
+    }
+    if (LY_ATOMIC_LOAD(ly_ctx_live)) {
+        LOGERR(NULL, LY_EINVAL, "The allocator cannot be changed while there are contexts.");
+        return EXIT_FAILURE;
+    }
+
+    if (allocator) {
+        ly_allocator = *allocator;
+    } else {
+        memset(&ly_allocator, 0, sizeof ly_allocator);
+    }
+    return EXIT_SUCCESS;
+}
+
+void *
+ly_mem_malloc(size_t size)
+{
+    if (ly_allocator.malloc_clb) {
+        return ly_allocator.malloc_clb(size, ly_allocator.user_data);
+    }
+    return (malloc)(size);
+}
+
+void *
+ly_mem_calloc(size_t nmemb, size_t size)
+{
+    void *mem;
+
+    if (ly_allocator.calloc_clb) {
+        return ly_allocator.calloc_clb(nmemb, size, ly_allocator.user_data);
+    } else if (ly_allocator.malloc_clb) {
+        if (size && (nmemb > SIZE_MAX / size)) {
+            return NULL;
+        }
+        mem = ly_allocator.malloc_clb(nmemb * size, ly_allocator.user_data);
+        if (mem) {
+            memset(mem, 0, nmemb * size);
+        }
+        return mem;
+    }
+    return (calloc)(nmemb, size);
+}
+
+void *
+ly_mem_realloc(void *ptr, size_t size)
+{
+    if (ly_allocator.realloc_clb) {
+        return ly_allocator.realloc_clb(ptr, size, ly_allocator.user_data);
+    }
+    return (realloc)(ptr, size);
+}
+
+void
+ly_mem_free(void *ptr)
+{
+    if (ly_allocator.free_clb) {
+        ly_allocator.free_clb(ptr, ly_allocator.user_data);
+    } else {
+        (free)(ptr);
+    }
+}
+
+char *
+ly_mem_strndup(const char *s, size_t n)
+{
+    char *dup;
+    size_t len;
+
+    for (len = 0; (len < n) && s[len]; ++len);
+    dup = ly_mem_malloc(len + 1);
+    if (dup) {
+        memcpy(dup, s, len);
+        dup[len] = '\0';
+    }
+    return dup;
+}
+
+char *
+ly_mem_strdup(const char *s)
+{
+    return ly_mem_strndup(s, SIZE_MAX);
+}
+
+int
+ly_mem_vasprintf(char **strp, const char *fmt, va_list ap)
+{
+    va_list ap2;
+    int len;
+
+    va_copy(ap2, ap);
+    len = vsnprintf(NULL, 0, fmt, ap2);
+    va_end(ap2);
+    if (len < 0) {
+        *strp = NULL;
+        return -1;
+    }
+
+    *strp = ly_mem_malloc(len + 1);
+    if (!*strp) {
+        return -1;
+    }
+    vsnprintf(*strp, len + 1, fmt, ap);
+    return len;
+}
+
+int
+ly_mem_asprintf(char **strp, const char *fmt, ...)
+{
+    va_list ap;
+    int len;
+
+    va_start(ap, fmt);
+    len = ly_mem_vasprintf(strp, fmt, ap);
+    va_end(ap);
+    return len;
+}
+
+char *
+ly_mem_adopt(char *str)
+{
+    char *dup;
+
+    if (!str || !ly_allocator.malloc_clb) {
+        /* the same memory */
+        return str;
+    }
+
+    dup = ly_mem_strdup(str);
+    (free)(str);
+    return dup;
+}
+
 int
 ly_strequal_(const char *s1, const char *s2)
 {
@@ -1401,8 +1552,9 @@ lyb_hash(struct lys_node *sibling, uint8_t collision_id)
 
     mod = lys_node_module(sibling);
 
-    full_hash = dict_hash_multi(0, mod->name, strlen(mod->name));
-    full_hash = dict_hash_multi(full_hash, sibling->name, strlen(sibling->name));
+    /* LYB_HASH_VERSION 0 */
+    full_hash = dict_hash_oaat_multi(0, mod->name, strlen(mod->name));
+    full_hash = dict_hash_oaat_multi(full_hash, sibling->name, strlen(sibling->name));
     if (collision_id) {
         if (collision_id > strlen(mod->name)) {
             /* fine, we will not hash more bytes, just use more bits from the hash than previously */
@@ -1411,16 +1563,16 @@ lyb_hash(struct lys_node *sibling, uint8_t collision_id)
             /* use one more byte from the module name than before */
             ext_len = collision_id;
         }
-        full_hash = dict_hash_multi(full_hash, mod->name, ext_len);
+        full_hash = dict_hash_oaat_multi(full_hash, mod->name, ext_len);
     }
-    full_hash = dict_hash_multi(full_hash, NULL, 0);
+    full_hash = dict_hash_oaat_multi(full_hash, NULL, 0);
 
     /* use the shortened hash */
     hash = full_hash & (LYB_HASH_MASK >> collision_id);
     /* add colision identificator */
     hash |= LYB_HASH_COLLISION_ID >> collision_id;
 
-    /* save this hash */
+    /* save this hash, concurrent threads can only store the same value */
 #ifdef LY_ENABLED_CACHE
     if (collision_id < LYS_NODE_HASH_COUNT) {
         sibling->hash[collision_id] = hash;
@@ -1430,6 +1582,53 @@ lyb_hash(struct lys_node *sibling, uint8_t collision_id)
     return hash;
 }
 
+static uint32_t
+lyb_ctx_hash_features(uint32_t hash, const struct lys_feature *features, uint8_t features_size)
+{
+    uint8_t i;
+
+    for (i = 0; i < features_size; ++i) {
+        if (features[i].flags & LYS_FENABLED) {
+            hash = dict_hash_oaat_multi(hash, features[i].name, strlen(features[i].name) + 1);
+        }
+    }
+
+    return hash;
+}
+
+uint32_t
+lyb_ctx_hash(struct ly_ctx *ctx)
+{
+    const struct lys_module *mod;
+    uint32_t hash = 0, mod_hash;
+    int i, j;
+
+    for (i = 0; i < ctx->models.used; ++i) {
+        mod = ctx->models.list[i];
+        if (mod->disabled) {
+            continue;
+        }
+
+        /* the terminating zeros separate the strings */
+        mod_hash = dict_hash_oaat_multi(0, mod->name, strlen(mod->name) + 1);
+        if (mod->rev_size) {
+            mod_hash = dict_hash_oaat_multi(mod_hash, mod->rev[0].date, strlen(mod->rev[0].date) + 1);
+        }
+        mod_hash = dict_hash_oaat_multi(mod_hash, mod->implemented ? "i" : "x", 1);
+
+        mod_hash = lyb_ctx_hash_features(mod_hash, mod->features, mod->features_size);
+        for (j = 0; j < mod->inc_size; ++j) {
+            mod_hash = lyb_ctx_hash_features(mod_hash, mod->inc[j].submodule->features,
+                                             mod->inc[j].submodule->features_size);
+        }
+
+        /* the order the modules were loaded in does not matter */
+        hash += dict_hash_oaat_multi(mod_hash, NULL, 0);
+    }
+
+    return hash ? hash : 1;
+}
+
 int
 lyb_has_schema_model(struct lys_node *sibling, const struct lys_module **models, int mod_count)
 {
@@ -1482,3 +1681,162 @@ ly_strlen_utf8(const char *str)
     for (len = 0, clen = strlen(str), ptr = str; *ptr && len < clen; ++len, ptr += UTF8LEN(*ptr));
     return len;
 }
+
+static int
+esc_char(unsigned char c, int esc)
+{
+    switch (c) {
+    case '\0':
+        return 1;
+    case '&':
+    case '<':
+    case '>':
+        return esc & (LY_ESC_XML_ELEM | LY_ESC_XML_ATTR);
+    case '"':
+        return esc & (LY_ESC_XML_ATTR | LY_ESC_JSON);
+    case '\\':
+        return esc & LY_ESC_JSON;
+    default:
+        return ((c < 0x20) && (esc & LY_ESC_JSON)) || ((c >= 0x80) && (esc & LY_ESC_NONASCII));
+    }
+}
+
+LY_NO_SANITIZE size_t
+ly_strlen_noesc(const char *str, int esc)
+{
+    size_t i = 0;
+#ifdef LY_SSE2
+    __m128i block, special;
+    uint32_t mask;
+
+    /* scan the unaligned beginning byte by byte, aligned loads then never cross the page with the terminating byte */
+    for (; (uintptr_t)(str + i) & 0xf; ++i) {
+        if (esc_char(str[i], esc)) {
+            return i;
+        }
+    }
+
+    for (; ; i += 16) {
+        block = _mm_load_si128((const __m128i *)(str + i));
+        special = _mm_cmpeq_epi8(block, _mm_setzero_si128());
+        if (esc & (LY_ESC_XML_ELEM | LY_ESC_XML_ATTR)) {
+            special = _mm_or_si128(special, _mm_or_si128(_mm_cmpeq_epi8(block, _mm_set1_epi8('&')),
+                                                         _mm_cmpeq_epi8(block, _mm_set1_epi8('<'))));
+            special = _mm_or_si128(special, _mm_cmpeq_epi8(block, _mm_set1_epi8('>')));
+        }
+        if (esc & (LY_ESC_XML_ATTR | LY_ESC_JSON)) {
+            special = _mm_or_si128(special, _mm_cmpeq_epi8(block, _mm_set1_epi8('"')));
+        }
+        if (esc & LY_ESC_JSON) {
+            /* unsigned comparison (c <= 0x1f) of the control characters */
+            special = _mm_or_si128(special, _mm_cmpeq_epi8(block, _mm_set1_epi8('\\')));
+            special = _mm_or_si128(special, _mm_cmpeq_epi8(_mm_min_epu8(block, _mm_set1_epi8(0x1f)), block));
+        }
+
+        mask = (uint32_t)_mm_movemask_epi8(special);
+        if (esc & LY_ESC_NONASCII) {
+            /* the most significant bits are set exactly in the non-ASCII bytes */
+            mask |= (uint32_t)_mm_movemask_epi8(block);
+        }
+        if (mask) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+#else
+    for (; !esc_char(str[i], esc); ++i);
+
+    return i;
+#endif
+}
+
+/* CRC32C (Castagnoli, reflected polynomial 0x82f63b78) of every byte value */
+static const uint32_t crc32c_table[256] = {
+    0x00000000, 0xf26b8303, 0xe13b70f7, 0x1350f3f4, 0xc79a971f, 0x35f1141c,
+    0x26a1e7e8, 0xd4ca64eb, 0x8ad958cf, 0x78b2dbcc, 0x6be22838, 0x9989ab3b,
+    0x4d43cfd0, 0xbf284cd3, 0xac78bf27, 0x5e133c24, 0x105ec76f, 0xe235446c,
+    0xf165b798, 0x030e349b, 0xd7c45070, 0x25afd373, 0x36ff2087, 0xc494a384,
+    0x9a879fa0, 0x68ec1ca3, 0x7bbcef57, 0x89d76c54, 0x5d1d08bf, 0xaf768bbc,
+    0xbc267848, 0x4e4dfb4b, 0x20bd8ede, 0xd2d60ddd, 0xc186fe29, 0x33ed7d2a,
+    0xe72719c1, 0x154c9ac2, 0x061c6936, 0xf477ea35, 0xaa64d611, 0x580f5512,
+    0x4b5fa6e6, 0xb93425e5, 0x6dfe410e, 0x9f95c20d, 0x8cc531f9, 0x7eaeb2fa,
+    0x30e349b1, 0xc288cab2, 0xd1d83946, 0x23b3ba45, 0xf779deae, 0x05125dad,
+    0x1642ae59, 0xe4292d5a, 0xba3a117e, 0x4851927d, 0x5b016189, 0xa96ae28a,
+    0x7da08661, 0x8fcb0562, 0x9c9bf696, 0x6ef07595, 0x417b1dbc, 0xb3109ebf,
+    0xa0406d4b, 0x522bee48, 0x86e18aa3, 0x748a09a0, 0x67dafa54, 0x95b17957,
+    0xcba24573, 0x39c9c670, 0x2a993584, 0xd8f2b687, 0x0c38d26c, 0xfe53516f,
+    0xed03a29b, 0x1f682198, 0x5125dad3, 0xa34e59d0, 0xb01eaa24, 0x42752927,
+    0x96bf4dcc, 0x64d4cecf, 0x77843d3b, 0x85efbe38, 0xdbfc821c, 0x2997011f,
+    0x3ac7f2eb, 0xc8ac71e8, 0x1c661503, 0xee0d9600, 0xfd5d65f4, 0x0f36e6f7,
+    0x61c69362, 0x93ad1061, 0x80fde395, 0x72966096, 0xa65c047d, 0x5437877e,
+    0x4767748a, 0xb50cf789, 0xeb1fcbad, 0x197448ae, 0x0a24bb5a, 0xf84f3859,
+    0x2c855cb2, 0xdeeedfb1, 0xcdbe2c45, 0x3fd5af46, 0x7198540d, 0x83f3d70e,
+    0x90a324fa, 0x62c8a7f9, 0xb602c312, 0x44694011, 0x5739b3e5, 0xa55230e6,
+    0xfb410cc2, 0x092a8fc1, 0x1a7a7c35, 0xe811ff36, 0x3cdb9bdd, 0xceb018de,
+    0xdde0eb2a, 0x2f8b6829, 0x82f63b78, 0x709db87b, 0x63cd4b8f, 0x91a6c88c,
+    0x456cac67, 0xb7072f64, 0xa457dc90, 0x563c5f93, 0x082f63b7, 0xfa44e0b4,
+    0xe9141340, 0x1b7f9043, 0xcfb5f4a8, 0x3dde77ab, 0x2e8e845f, 0xdce5075c,
+    0x92a8fc17, 0x60c37f14, 0x73938ce0, 0x81f80fe3, 0x55326b08, 0xa759e80b,
+    0xb4091bff, 0x466298fc, 0x1871a4d8, 0xea1a27db, 0xf94ad42f, 0x0b21572c,
+    0xdfeb33c7, 0x2d80b0c4, 0x3ed04330, 0xccbbc033, 0xa24bb5a6, 0x502036a5,
+    0x4370c551, 0xb11b4652, 0x65d122b9, 0x97baa1ba, 0x84ea524e, 0x7681d14d,
+    0x2892ed69, 0xdaf96e6a, 0xc9a99d9e, 0x3bc21e9d, 0xef087a76, 0x1d63f975,
+    0x0e330a81, 0xfc588982, 0xb21572c9, 0x407ef1ca, 0x532e023e, 0xa145813d,
+    0x758fe5d6, 0x87e466d5, 0x94b49521, 0x66df1622, 0x38cc2a06, 0xcaa7a905,
+    0xd9f75af1, 0x2b9cd9f2, 0xff56bd19, 0x0d3d3e1a, 0x1e6dcdee, 0xec064eed,
+    0xc38d26c4, 0x31e6a5c7, 0x22b65633, 0xd0ddd530, 0x0417b1db, 0xf67c32d8,
+    0xe52cc12c, 0x1747422f, 0x49547e0b, 0xbb3ffd08, 0xa86f0efc, 0x5a048dff,
+    0x8ecee914, 0x7ca56a17, 0x6ff599e3, 0x9d9e1ae0, 0xd3d3e1ab, 0x21b862a8,
+    0x32e8915c, 0xc083125f, 0x144976b4, 0xe622f5b7, 0xf5720643, 0x07198540,
+    0x590ab964, 0xab613a67, 0xb831c993, 0x4a5a4a90, 0x9e902e7b, 0x6cfbad78,
+    0x7fab5e8c, 0x8dc0dd8f, 0xe330a81a, 0x115b2b19, 0x020bd8ed, 0xf0605bee,
+    0x24aa3f05, 0xd6c1bc06, 0xc5914ff2, 0x37faccf1, 0x69e9f0d5, 0x9b8273d6,
+    0x88d28022, 0x7ab90321, 0xae7367ca, 0x5c18e4c9, 0x4f48173d, 0xbd23943e,
+    0xf36e6f75, 0x0105ec76, 0x12551f82, 0xe03e9c81, 0x34f4f86a, 0xc69f7b69,
+    0xd5cf889d, 0x27a40b9e, 0x79b737ba, 0x8bdcb4b9, 0x988c474d, 0x6ae7c44e,
+    0xbe2da0a5, 0x4c4623a6, 0x5f16d052, 0xad7d5351
+};
+
+static uint32_t
+ly_crc32c_sw(uint32_t crc, const uint8_t *data, size_t len)
+{
+    for (; len; ++data, --len) {
+        crc = crc32c_table[(crc ^ *data) & 0xff] ^ (crc >> 8);
+    }
+
+    return crc;
+}
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+
+/* the SSE4.2 crc32 instruction computes exactly CRC32C, 8 bytes at a time */
+__attribute__((target("sse4.2")))
+static uint32_t
+ly_crc32c_hw(uint32_t crc, const uint8_t *data, size_t len)
+{
+    uint64_t crc64 = crc, word;
+
+    for (; len >= sizeof word; data += sizeof word, len -= sizeof word) {
+        memcpy(&word, data, sizeof word);
+        crc64 = __builtin_ia32_crc32di(crc64, word);
+    }
+    crc = (uint32_t)crc64;
+    for (; len; ++data, --len) {
+        crc = __builtin_ia32_crc32qi(crc, *data);
+    }
+
+    return crc;
+}
+
+#endif
+
+uint32_t
+ly_crc32c(uint32_t crc, const void *data, size_t len)
+{
+    crc = ~crc;
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+    if (__builtin_cpu_supports("sse4.2")) {
+        return ~ly_crc32c_hw(crc, data, len);
+    }
+#endif
+    return ~ly_crc32c_sw(crc, data, len);
+}
@@ -30,6 +30,7 @@
 #include "parser.h"
 #include "tree_internal.h"
 #include "resolve.h"
+#include "xpath.h"
 
 /*
  * counter for references to the extensions plugins (for the number of contexts)
@@ -52,6 +53,9 @@ extern unsigned int ext_plugins_ref;
 #include IETF_DATASTORES
 #include IETF_YANG_LIB_PATH
 
+/* maximum number of threads reading schema files in advance, see ly_ctx_prefetch() */
+#define LY_CTX_PREFETCH_THREADS 8
+
 #define LY_INTERNAL_MODULE_COUNT 6
 static struct internal_modules_s {
     const char *name;
@@ -80,6 +84,235 @@ ly_ctx_internal_modules_count(struct ly_ctx *ctx)
     return ctx->internal_module_count;
 }
 
+/**
+ * @brief Key of a module in the context indices.
+ */
+struct ly_ctx_module_key {
+    const char *key;    /**< module name or namespace */
+    size_t key_len;     /**< length of the key */
+    int offset;         /**< offset of the key in struct lys_module */
+};
+
+/**
+ * @brief Callback for the context module indices, modules are compared when changing the index, keys when searching.
+ */
+static int
+ly_ctx_module_equal(void *val1_p, void *val2_p, int mod, void *UNUSED(cb_data))
+{
+    struct ly_ctx_module_key *key;
+    struct lys_module *module;
+    const char *val;
+
+    module = *(struct lys_module **)val2_p;
+    if (mod) {
+        return *(struct lys_module **)val1_p == module;
+    }
+
+    key = (struct ly_ctx_module_key *)val1_p;
+    val = *(char **)(((char *)module) + key->offset);
+    return !strncmp(key->key, val, key->key_len) && !val[key->key_len];
+}
+
+static uint32_t
+ly_ctx_module_hash(const char *key, size_t key_len)
+{
+    return dict_hash_multi(dict_hash_multi(0, key, key_len), NULL, 0);
+}
+
+/**
+ * @brief Import of a context module, the edge of the module dependency graph.
+ */
+struct ly_ctx_module_imp {
+    struct lys_module *module;      /**< imported module */
+    struct lys_module *importer;    /**< module importing it */
+};
+
+/**
+ * @brief Callback for the context imports index, all the importers of a module are equal when searching.
+ */
+static int
+ly_ctx_module_imp_equal(void *val1_p, void *val2_p, int mod, void *UNUSED(cb_data))
+{
+    struct ly_ctx_module_imp *imp1 = val1_p, *imp2 = val2_p;
+
+    return (imp1->module == imp2->module) && (!mod || (imp1->importer == imp2->importer));
+}
+
+static uint32_t
+ly_ctx_module_imp_hash(const struct lys_module *module)
+{
+    return dict_hash_multi(dict_hash_multi(0, (const char *)&module, sizeof module), NULL, 0);
+}
+
+int
+ly_ctx_modules_retire(struct ly_ctx *ctx, void *ptr, int ht)
+{
+    struct ly_modules_retired *retired;
+
+    retired = malloc(sizeof *retired);
+    LY_CHECK_ERR_RETURN(!retired, LOGMEM(ctx), -1);
+    retired->ptr = ptr;
+    retired->ht = ht;
+    retired->next = ctx->models.retired;
+    ctx->models.retired = retired;
+
+    return EXIT_SUCCESS;
+}
+
+void
+ly_ctx_modules_reclaim(struct ly_ctx *ctx)
+{
+    struct ly_modules_retired *retired;
+
+    /* the replaced ones were published before, any reader starting from now on cannot see them */
+    if (LY_ATOMIC_LOAD(ctx->models.readers)) {
+        /* but some of the current readers may still be using them */
+        return;
+    }
+
+    while ((retired = ctx->models.retired)) {
+        ctx->models.retired = retired->next;
+        if (retired->ht) {
+            lyht_free(retired->ptr);
+        } else {
+            free(retired->ptr);
+        }
+        free(retired);
+    }
+}
+
+/**
+ * @brief Start accessing the context modules list or indices without locking.
+ */
+static void
+ly_ctx_modules_enter(const struct ly_ctx *ctx)
+{
+    LY_ATOMIC_INC(((struct ly_ctx *)ctx)->models.readers);
+}
+
+/**
+ * @brief Stop accessing the context modules list or indices, what was read from them stays valid.
+ */
+static void
+ly_ctx_modules_leave(const struct ly_ctx *ctx)
+{
+    LY_ATOMIC_DEC(((struct ly_ctx *)ctx)->models.readers);
+}
+
+/**
+ * @brief Publish a new version of a module index, the lock-free readers may still use the previous one.
+ */
+static int
+ly_ctx_module_index_publish(struct ly_ctx *ctx, struct hash_table **ht_p, struct hash_table *ht)
+{
+    if (ly_ctx_modules_retire(ctx, *ht_p, 1)) {
+        lyht_free(ht);
+        return -1;
+    }
+    LY_ATOMIC_STORE(*ht_p, ht);
+
+    return EXIT_SUCCESS;
+}
+
+int
+ly_ctx_module_index_add(struct lys_module *module)
+{
+    struct ly_ctx *ctx = module->ctx;
+    struct ly_ctx_module_imp imp;
+    struct hash_table *name_ht, *ns_ht = NULL;
+    uint8_t u;
+
+    /* the name and namespace indices are read without locking, modify their copies */
+    name_ht = lyht_dup(ctx->models.name_ht);
+    LY_CHECK_ERR_RETURN(!name_ht, LOGMEM(ctx), -1);
+    if (lyht_insert(name_ht, &module, ly_ctx_module_hash(module->name, strlen(module->name)), NULL) == -1) {
+        lyht_free(name_ht);
+        return -1;
+    }
+    if (module->ns) {
+        ns_ht = lyht_dup(ctx->models.ns_ht);
+        LY_CHECK_ERR_RETURN(!ns_ht, LOGMEM(ctx); lyht_free(name_ht), -1);
+        if (lyht_insert(ns_ht, &module, ly_ctx_module_hash(module->ns, strlen(module->ns)), NULL) == -1) {
+            lyht_free(name_ht);
+            lyht_free(ns_ht);
+            return -1;
+        }
+    }
+
+    /* the imports index is used only by the (exclusive) module set changes */
+    imp.importer = module;
+    for (u = 0; u < module->imp_size; u++) {
+        imp.module = module->imp[u].module;
+        if (lyht_insert(ctx->models.imp_ht, &imp, ly_ctx_module_imp_hash(imp.module), NULL) == -1) {
+            for (; u; u--) {
+                imp.module = module->imp[u - 1].module;
+                lyht_remove(ctx->models.imp_ht, &imp, ly_ctx_module_imp_hash(imp.module));
+            }
+            lyht_free(name_ht);
+            lyht_free(ns_ht);
+            return -1;
+        }
+    }
+
+    if (ly_ctx_module_index_publish(ctx, &ctx->models.name_ht, name_ht)) {
+        lyht_free(ns_ht);
+        return -1;
+    }
+    if (ns_ht && ly_ctx_module_index_publish(ctx, &ctx->models.ns_ht, ns_ht)) {
+        return -1;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Remove a module from a module index read without locking.
+ */
+static void
+ly_ctx_module_index_unpublish(struct ly_ctx *ctx, struct hash_table **ht_p, struct lys_module *module, uint32_t hash)
+{
+    struct hash_table *ht;
+    int r;
+
+    ht = lyht_dup(*ht_p);
+    if (!ht) {
+        /* no memory, the best we can do is to remove it in place */
+        lyht_remove(*ht_p, &module, hash);
+        return;
+    }
+
+    r = lyht_remove(ht, &module, hash);
+    if (r == 1) {
+        /* not there */
+        lyht_free(ht);
+    } else if (ly_ctx_module_index_publish(ctx, ht_p, ht)) {
+        lyht_remove(*ht_p, &module, hash);
+    }
+}
+
+void
+ly_ctx_module_index_remove(struct lys_module *module)
+{
+    struct ly_ctx *ctx = module->ctx;
+    struct ly_ctx_module_imp imp;
+    uint8_t u;
+
+    if (ctx->models.name_ht) {
+        ly_ctx_module_index_unpublish(ctx, &ctx->models.name_ht, module,
+                                      ly_ctx_module_hash(module->name, strlen(module->name)));
+    }
+    if (ctx->models.ns_ht && module->ns) {
+        ly_ctx_module_index_unpublish(ctx, &ctx->models.ns_ht, module, ly_ctx_module_hash(module->ns, strlen(module->ns)));
+    }
+    if (ctx->models.imp_ht) {
+        imp.importer = module;
+        for (u = 0; u < module->imp_size; u++) {
+            imp.module = module->imp[u].module;
+            lyht_remove(ctx->models.imp_ht, &imp, ly_ctx_module_imp_hash(imp.module));
+        }
+    }
+}
+
 API struct ly_ctx *
 ly_ctx_new(const char *search_dir, int options)
 {
@@ -94,18 +327,46 @@ ly_ctx_new(const char *search_dir, int options)
 
     ctx = calloc(1, sizeof *ctx);
     LY_CHECK_ERR_RETURN(!ctx, LOGMEM(NULL), NULL);
+    LY_ATOMIC_INC(ly_ctx_live);
 
     /* dictionary */
-    lydict_init(&ctx->dict);
+    lydict_init(&ctx->dict, options & LY_CTX_DICT_SHARDED, options & LY_CTX_DICT_IMMORTAL);
+
+    /* compiled XPath expressions */
+    pthread_rwlock_init(&ctx->xpath_cache_lock, NULL);
+    pthread_mutex_init(&ctx->regex_cache_lock, NULL);
+    pthread_mutex_init(&ctx->xpath_deps_lock, NULL);
+    pthread_rwlock_init(&ctx->data_children_lock, NULL);
+    pthread_rwlock_init(&ctx->lyb_hashes_lock, NULL);
+    pthread_mutex_init(&ctx->lyb_sibling_hts_lock, NULL);
+    pthread_rwlock_init(&ctx->idents_lock, NULL);
+    pthread_rwlock_init(&ctx->instids_lock, NULL);
+    pthread_mutex_init(&ctx->lref_rev_lock, NULL);
+    pthread_rwlock_init(&ctx->exts_lock, NULL);
+    pthread_mutex_init(&ctx->devs_lock, NULL);
+    pthread_mutex_init(&ctx->print_cache_lock, NULL);
+    pthread_mutex_init(&ctx->info_lock, NULL);
+    pthread_mutex_init(&ctx->type_chk_lock, NULL);
+    pthread_mutex_init(&ctx->cnt_lock, NULL);
+#ifdef LY_ENABLED_CACHE
+    pthread_mutex_init(&ctx->pattern_cache_lock, NULL);
+#endif
+#ifdef LY_ENABLED_DATA_POOL
+    pthread_mutex_init(&ctx->data_pool.lock, NULL);
+#endif
 
     /* plugins */
-    ly_load_plugins();
+    ly_load_plugins_int(!(options & LY_CTX_NOPLUGINS_SCAN));
 
     /* initialize thread-specific key */
     if (pthread_key_create(&ctx->errlist_key, ly_err_free) != 0) {
         LOGERR(NULL, LY_ESYS, "pthread_key_create() in ly_ctx_new() failed");
         goto error;
     }
+    if (pthread_key_create(&ctx->cnt_key, NULL) != 0) {
+        LOGERR(NULL, LY_ESYS, "pthread_key_create() in ly_ctx_new() failed");
+        goto error;
+    }
 
     /* models list */
     ctx->models.list = calloc(16, sizeof *ctx->models.list);
@@ -113,6 +374,15 @@ ly_ctx_new(const char *search_dir, int options)
     ctx->models.flags = options;
     ctx->models.used = 0;
     ctx->models.size = 16;
+    ctx->models.name_ht = lyht_new(16, sizeof(struct lys_module *), ly_ctx_module_equal, NULL, 1);
+    LY_CHECK_ERR_GOTO(!ctx->models.name_ht, LOGMEM(NULL), error);
+    ctx->models.ns_ht = lyht_new(16, sizeof(struct lys_module *), ly_ctx_module_equal, NULL, 1);
+    LY_CHECK_ERR_GOTO(!ctx->models.ns_ht, LOGMEM(NULL), error);
+    ctx->models.imp_ht = lyht_new(16, sizeof(struct ly_ctx_module_imp), ly_ctx_module_imp_equal, NULL, 1);
+    LY_CHECK_ERR_GOTO(!ctx->models.imp_ht, LOGMEM(NULL), error);
+    if ((options & LY_CTX_LEAFREF_INDEX) && resolve_lref_rev_init(ctx)) {
+        goto error;
+    }
     if (search_dir) {
         search_dir_list = strdup(search_dir);
         LY_CHECK_ERR_GOTO(!search_dir_list, LOGMEM(NULL), error);
@@ -131,6 +401,9 @@ ly_ctx_new(const char *search_dir, int options)
         }
     }
     ctx->models.module_set_id = 1;
+#ifdef LY_ENABLED_CACHE
+    ctx->feature_set_id = 1;
+#endif
 
     /* load internal modules */
     if (options & LY_CTX_NOYANGLIBRARY) {
@@ -138,6 +411,8 @@ ly_ctx_new(const char *search_dir, int options)
     } else {
         ctx->internal_module_count = LY_INTERNAL_MODULE_COUNT;
     }
+    /* the embedded modules are known to be valid, do not check their restrictions and conditions */
+    ctx->models.flags |= LY_CTX_TRUSTED;
     for (i = 0; i < ctx->internal_module_count; i++) {
         module = (struct lys_module *)lys_parse_mem(ctx, internal_modules[i].data, internal_modules[i].format);
         if (!module) {
@@ -145,6 +420,9 @@ ly_ctx_new(const char *search_dir, int options)
         }
         module->implemented = internal_modules[i].implemented;
     }
+    if (!(options & LY_CTX_TRUSTED)) {
+        ctx->models.flags &= ~LY_CTX_TRUSTED;
+    }
 
     return ctx;
 
@@ -154,6 +432,173 @@ error:
     return NULL;
 }
 
+struct ly_ctx_prefetch_arg {
+    char **paths;
+    unsigned int count;
+    unsigned int first;
+    unsigned int step;
+};
+
+static void
+ly_ctx_prefetch_thread(void *arg)
+{
+    struct ly_ctx_prefetch_arg *parg = arg;
+    char buf[16384];
+    unsigned int u;
+    int fd;
+
+    for (u = parg->first; u < parg->count; u += parg->step) {
+        fd = open(parg->paths[u], O_RDONLY);
+        if (fd < 0) {
+            continue;
+        }
+        /* the content is not needed, only the file in the page cache */
+        while (read(fd, buf, sizeof buf) > 0);
+        close(fd);
+    }
+}
+
+void
+ly_ctx_prefetch_clb(struct ly_ctx *ctx, const char **names, const char **revisions, unsigned int count)
+{
+    const char **fnames, **frevs;
+    unsigned int u, fcount = 0;
+
+    if (!ctx->prefetch_clb || !count) {
+        return;
+    }
+
+    fnames = malloc(2 * count * sizeof *fnames);
+    LY_CHECK_ERR_RETURN(!fnames, LOGMEM(ctx), );
+    frevs = fnames + count;
+
+    /* announce only what is going to be requested */
+    for (u = 0; u < count; ++u) {
+        if (!names[u] || ly_ctx_get_module(ctx, names[u], revisions[u] && revisions[u][0] ? revisions[u] : NULL, 0)) {
+            continue;
+        }
+        fnames[fcount] = names[u];
+        frevs[fcount] = revisions[u] && revisions[u][0] ? revisions[u] : NULL;
+        ++fcount;
+    }
+
+    if (fcount) {
+        ctx->prefetch_clb(fnames, frevs, fcount, ctx->prefetch_clb_data);
+    }
+    free(fnames);
+}
+
+/**
+ * @brief Read the schema files of the modules (or submodules) about to be loaded from the searchpaths
+ * concurrently, so their sequential parsing does not wait for the storage. Best effort, nothing is reported.
+ * The modules are also announced to the user prefetch callback.
+ *
+ * @param[in] ctx Context to load into.
+ * @param[in] names Names of the (sub)modules.
+ * @param[in] revisions Revisions of the (sub)modules, each may be NULL.
+ * @param[in] count Number of the (sub)modules.
+ */
+static void
+ly_ctx_prefetch(struct ly_ctx *ctx, const char **names, const char **revisions, unsigned int count)
+{
+    struct ly_ctx_prefetch_arg args[LY_CTX_PREFETCH_THREADS];
+    unsigned int u, path_count = 0, thread_count;
+    char **paths = NULL, *filepath;
+    LYS_INFORMAT format;
+
+    ly_ctx_prefetch_clb(ctx, names, revisions, count);
+
+    if ((ctx->models.flags & LY_CTX_DISABLE_SEARCHDIRS) || (ctx->imp_clb && !(ctx->models.flags & LY_CTX_PREFER_SEARCHDIRS))
+            || (count < 2)) {
+        /* the files would not be read or there is nothing to be done in parallel */
+        return;
+    }
+
+    paths = malloc(count * sizeof *paths);
+    LY_CHECK_ERR_RETURN(!paths, LOGMEM(ctx), );
+
+    /* locating the files is fast with the directory listings cached in the context */
+    for (u = 0; u < count; ++u) {
+        if (!names[u] || ly_ctx_get_module(ctx, names[u], revisions[u] && revisions[u][0] ? revisions[u] : NULL, 0)) {
+            continue;
+        }
+        filepath = NULL;
+        if (!lys_search_localfile_ctx(ctx, ly_ctx_get_searchdirs(ctx), !(ctx->models.flags & LY_CTX_DISABLE_SEARCHDIR_CWD),
+                                      names[u], revisions[u] && revisions[u][0] ? revisions[u] : NULL, &filepath, &format)
+                && filepath) {
+            paths[path_count++] = filepath;
+        }
+    }
+
+    thread_count = ly_parallel_count(ctx, (path_count > LY_CTX_PREFETCH_THREADS) ? LY_CTX_PREFETCH_THREADS : path_count);
+    for (u = 0; u < thread_count; ++u) {
+        args[u].paths = paths;
+        args[u].count = path_count;
+        args[u].first = u;
+        args[u].step = thread_count;
+    }
+
+    /* this thread reads its own share and the share of the tasks that could not be submitted */
+    ly_parallel_run(ctx, ly_ctx_prefetch_thread, args, sizeof *args, thread_count);
+
+    for (u = 0; u < path_count; ++u) {
+        free(paths[u]);
+    }
+    free(paths);
+}
+
+/**
+ * @brief Prefetch the schema files of the (sub)modules listed in yang library data, see ly_ctx_prefetch().
+ *
+ * @param[in] ctx Context to load into.
+ * @param[in] yltree Yang library data.
+ * @param[in] ylpaths NULL-terminated paths of the lists with name and revision leaves.
+ */
+static void
+ly_ctx_prefetch_yl(struct ly_ctx *ctx, struct lyd_node *yltree, const char **ylpaths)
+{
+    struct ly_set *set;
+    struct lyd_node *node;
+    const char **names = NULL, **revisions = NULL;
+    unsigned int i, u, count = 0, size = 0;
+    void *r;
+
+    for (i = 0; ylpaths[i]; ++i) {
+        set = lyd_find_path(yltree, ylpaths[i]);
+        if (!set) {
+            continue;
+        }
+        if (count + set->number > size) {
+            size = count + set->number;
+            r = realloc(names, size * sizeof *names);
+            LY_CHECK_ERR_GOTO(!r, LOGMEM(ctx); ly_set_free(set), cleanup);
+            names = r;
+            r = realloc(revisions, size * sizeof *revisions);
+            LY_CHECK_ERR_GOTO(!r, LOGMEM(ctx); ly_set_free(set), cleanup);
+            revisions = r;
+        }
+        for (u = 0; u < set->number; ++u) {
+            names[count] = NULL;
+            revisions[count] = NULL;
+            LY_TREE_FOR(set->set.d[u]->child, node) {
+                if (!strcmp(node->schema->name, "name")) {
+                    names[count] = ((struct lyd_node_leaf_list *)node)->value_str;
+                } else if (!strcmp(node->schema->name, "revision")) {
+                    revisions[count] = ((struct lyd_node_leaf_list *)node)->value_str;
+                }
+            }
+            ++count;
+        }
+        ly_set_free(set);
+    }
+
+    ly_ctx_prefetch(ctx, names, revisions, count);
+
+cleanup:
+    free(names);
+    free(revisions);
+}
+
 static int
 ly_ctx_new_yl_legacy(struct ly_ctx *ctx, struct lyd_node *yltree)
 {
@@ -161,14 +606,19 @@ ly_ctx_new_yl_legacy(struct ly_ctx *ctx, struct lyd_node *yltree)
     struct lyd_node *module, *node;
     struct ly_set *set;
     const char *name, *revision;
-    struct ly_set features = {0, 0, {NULL}};
+    struct ly_set features = {0};
     const struct lys_module *mod;
+    const char *ylpaths[] = {"/ietf-yang-library:yang-library/modules-state/module",
+                             "/ietf-yang-library:yang-library/modules-state/module/submodule", NULL};
 
-    set = lyd_find_path(yltree, "/ietf-yang-library:yang-library/modules-state/module");
+    set = lyd_find_path(yltree, ylpaths[0]);
     if (!set) {
         return 1;
     }
 
+    /* including the imported modules and submodules */
+    ly_ctx_prefetch_yl(ctx, yltree, ylpaths);
+
     /* process the data tree */
     for (i = 0; i < set->number; ++i) {
         module = set->set.d[i];
@@ -198,6 +648,8 @@ ly_ctx_new_yl_legacy(struct ly_ctx *ctx, struct lyd_node *yltree)
         if (!mod) {
             LOGERR(ctx, LY_EINVAL, "Unable to load module specified by yang library data.");
             ly_set_free(set);
+            ly_set_clean(&features);
+            free(features.set.g);
             return 1;
         }
 
@@ -208,6 +660,8 @@ ly_ctx_new_yl_legacy(struct ly_ctx *ctx, struct lyd_node *yltree)
     }
 
     ly_set_free(set);
+    ly_set_clean(&features);
+    free(features.set.g);
     return 0;
 }
 
@@ -218,12 +672,16 @@ ly_ctx_new_yl_common(const char *search_dir, const char *input, LYD_FORMAT forma
     unsigned int i, u;
     struct lyd_node *module, *node;
     const char *name, *revision;
-    struct ly_set features = {0, 0, {NULL}};
+    struct ly_set features = {0};
     const struct lys_module *mod;
     struct lyd_node *yltree = NULL;
     struct ly_ctx *ctx = NULL;
     struct ly_set *set = NULL;
     int err = 0;
+    const char *ylpaths[] = {"/ietf-yang-library:yang-library/module-set[1]/module",
+                             "/ietf-yang-library:yang-library/module-set[1]/module/submodule",
+                             "/ietf-yang-library:yang-library/module-set[1]/import-only-module",
+                             "/ietf-yang-library:yang-library/module-set[1]/import-only-module/submodule", NULL};
 
     /* create empty (with internal modules including ietf-yang-library) context */
     ctx = ly_ctx_new(search_dir, options);
@@ -237,7 +695,7 @@ ly_ctx_new_yl_common(const char *search_dir, const char *input, LYD_FORMAT forma
         goto error;
     }
 
-    set = lyd_find_path(yltree, "/ietf-yang-library:yang-library/module-set[1]/module");
+    set = lyd_find_path(yltree, ylpaths[0]);
     if (!set) {
         goto error;
     }
@@ -248,6 +706,9 @@ ly_ctx_new_yl_common(const char *search_dir, const char *input, LYD_FORMAT forma
             goto error;
         }
     } else {
+        /* including the imported modules and submodules */
+        ly_ctx_prefetch_yl(ctx, yltree, ylpaths);
+
         /* process the data tree */
         for (i = 0; i < set->number; ++i) {
             module = set->set.d[i];
@@ -295,6 +756,8 @@ error:
     if (set) {
         ly_set_free(set);
     }
+    ly_set_clean(&features);
+    free(features.set.g);
     if (err) {
         ly_ctx_destroy(ctx, NULL);
         ctx = NULL;
@@ -419,6 +882,22 @@ ly_ctx_unset_trusted(struct ly_ctx *ctx)
     ly_ctx_unset_option(ctx, LY_CTX_TRUSTED);
 }
 
+API void
+ly_ctx_set_ordered_data(struct ly_ctx *ctx)
+{
+    FUN_IN;
+
+    ly_ctx_set_option(ctx, LY_CTX_ORDERED_DATA);
+}
+
+API void
+ly_ctx_unset_ordered_data(struct ly_ctx *ctx)
+{
+    FUN_IN;
+
+    ly_ctx_unset_option(ctx, LY_CTX_ORDERED_DATA);
+}
+
 API int
 ly_ctx_get_options(struct ly_ctx *ctx)
 {
@@ -449,7 +928,8 @@ ly_ctx_set_searchdir(struct ly_ctx *ctx, const char *search_dir)
             return EXIT_FAILURE;
         }
 
-        new_dir = realpath(search_dir, NULL);
+        /* allocated by the C library */
+        new_dir = ly_mem_adopt(realpath(search_dir, NULL));
         LY_CHECK_ERR_GOTO(!new_dir, LOGERR(ctx, LY_ESYS, "realpath() call failed (%s).", strerror(errno)), cleanup);
         if (!ctx->models.search_paths) {
             ctx->models.search_paths = malloc(2 * sizeof *ctx->models.search_paths);
@@ -471,6 +951,9 @@ ly_ctx_set_searchdir(struct ly_ctx *ctx, const char *search_dir)
         new_dir = NULL;
         ctx->models.search_paths[index + 1] = NULL;
 
+        /* searched differently now, do not keep the directory listings */
+        lys_search_dirs_clean(ctx);
+
 success:
         rc = EXIT_SUCCESS;
     } else {
@@ -506,6 +989,9 @@ ly_ctx_unset_searchdirs(struct ly_ctx *ctx, int index)
         return;
     }
 
+    /* searched differently now, do not keep the directory listings */
+    lys_search_dirs_clean(ctx);
+
     for (i = 0; ctx->models.search_paths[i]; i++) {
         if (index < 0 || index == i) {
             free(ctx->models.search_paths[i]);
@@ -526,13 +1012,27 @@ ly_ctx_destroy(struct ly_ctx *ctx, void (*private_destructor)(const struct lys_n
 {
     FUN_IN;
 
+    struct ly_ctx_cnt_block *cnt_block, *cnt_next;
     int i;
 
     if (!ctx) {
         return;
     }
 
-    /* models list */
+    /* all the strings are freed with the dictionary at the end, do not remove them one by one */
+    ctx->dict.destroying = 1;
+
+    /* the data of ietf-yang-library, before its schema */
+    ly_ctx_info_clean(ctx);
+    pthread_mutex_destroy(&ctx->info_lock);
+
+    /* models list, the indices are not needed anymore */
+    lyht_free(ctx->models.name_ht);
+    ctx->models.name_ht = NULL;
+    lyht_free(ctx->models.ns_ht);
+    ctx->models.ns_ht = NULL;
+    lyht_free(ctx->models.imp_ht);
+    ctx->models.imp_ht = NULL;
     for (; ctx->models.used > 0; ctx->models.used--) {
         /* remove the applied deviations and augments */
         lys_sub_module_remove_devs_augs(ctx->models.list[ctx->models.used - 1]);
@@ -546,11 +1046,57 @@ ly_ctx_destroy(struct ly_ctx *ctx, void (*private_destructor)(const struct lys_n
         free(ctx->models.search_paths);
     }
     free(ctx->models.list);
+    ly_ctx_modules_reclaim(ctx);
+    lys_search_dirs_clean(ctx);
 
     /* clean the error list */
     ly_err_clean(ctx, 0);
     pthread_key_delete(ctx->errlist_key);
 
+    /* counters, the blocks of the threads that exited are kept until now */
+    for (cnt_block = ctx->cnt_blocks; cnt_block; cnt_block = cnt_next) {
+        cnt_next = cnt_block->next;
+        free(cnt_block);
+    }
+    pthread_key_delete(ctx->cnt_key);
+    pthread_mutex_destroy(&ctx->cnt_lock);
+
+    /* compiled XPath expressions */
+    lyxp_expr_cache_clean(ctx);
+    pthread_rwlock_destroy(&ctx->xpath_cache_lock);
+    lyxp_regex_cache_clean(ctx);
+    pthread_mutex_destroy(&ctx->regex_cache_lock);
+    lyxp_deps_clean(ctx);
+    pthread_mutex_destroy(&ctx->xpath_deps_lock);
+    lys_data_children_clean(ctx);
+    pthread_rwlock_destroy(&ctx->data_children_lock);
+    lyb_hashes_clean(ctx);
+    pthread_rwlock_destroy(&ctx->lyb_hashes_lock);
+    lyb_sibling_hts_clean(ctx);
+    pthread_mutex_destroy(&ctx->lyb_sibling_hts_lock);
+    resolve_idents_clean(ctx);
+    pthread_rwlock_destroy(&ctx->idents_lock);
+    resolve_instids_clean(ctx);
+    pthread_rwlock_destroy(&ctx->instids_lock);
+    resolve_lref_rev_clean(ctx);
+    pthread_mutex_destroy(&ctx->lref_rev_lock);
+    lyp_ext_instances_clean(ctx);
+    pthread_rwlock_destroy(&ctx->exts_lock);
+    lys_deviations_clean(ctx);
+    pthread_mutex_destroy(&ctx->devs_lock);
+    lys_print_cache_clean(ctx);
+    pthread_mutex_destroy(&ctx->print_cache_lock);
+    pthread_mutex_destroy(&ctx->type_chk_lock);
+#ifdef LY_ENABLED_CACHE
+    /* after all the modules, they only borrow the compiled patterns */
+    lyp_pattern_cache_clean(ctx);
+    pthread_mutex_destroy(&ctx->pattern_cache_lock);
+#endif
+#ifdef LY_ENABLED_DATA_POOL
+    lyd_pool_clean(ctx);
+    pthread_mutex_destroy(&ctx->data_pool.lock);
+#endif
+
     /* dictionary */
     lydict_clean(&ctx->dict);
 
@@ -558,6 +1104,7 @@ ly_ctx_destroy(struct ly_ctx *ctx, void (*private_destructor)(const struct lys_n
     ly_clean_plugins();
 
     free(ctx);
+    LY_ATOMIC_DEC(ly_ctx_live);
 }
 
 API const struct lys_submodule *
@@ -647,45 +1194,56 @@ static const struct lys_module *
 ly_ctx_get_module_by(const struct ly_ctx *ctx, const char *key, size_t key_len, int offset, const char *revision,
                      int with_disabled, int implemented)
 {
-    int i;
-    char *val;
-    struct lys_module *result = NULL;
+    struct ly_ctx_module_key mod_key;
+    struct hash_table *ht;
+    struct lys_module **match_p, *module, *result = NULL;
+    uint32_t hash;
+    int r;
 
     if (!ctx || !key) {
         LOGARG;
         return NULL;
     }
 
-    for (i = 0; i < ctx->models.used; i++) {
-        if (!with_disabled && ctx->models.list[i]->disabled) {
-            /* skip the disabled modules */
+    if (!key_len) {
+        key_len = strlen(key);
+    }
+    mod_key.key = key;
+    mod_key.key_len = key_len;
+    mod_key.offset = offset;
+    /* the index is replaced, never changed, when a module is added */
+    ly_ctx_modules_enter(ctx);
+    ht = (offset == offsetof(struct lys_module, name)) ? LY_ATOMIC_LOAD(ctx->models.name_ht) : LY_ATOMIC_LOAD(ctx->models.ns_ht);
+    hash = ly_ctx_module_hash(key, key_len);
+
+    /* all the modules with the same key have the same hash */
+    for (r = lyht_find(ht, &mod_key, hash, (void **)&match_p); !r; r = lyht_find_next(ht, match_p, hash, (void **)&match_p)) {
+        module = *match_p;
+        if (!ly_ctx_module_equal(&mod_key, match_p, 0, NULL)) {
+            /* hash collision */
             continue;
         }
-        /* use offset to get address of the pointer to string (char**), remember that offset is in
-         * bytes, so we have to cast the pointer to the module to (char*), finally, we want to have
-         * string not the pointer to string
-         */
-        val = *(char **)(((char *)ctx->models.list[i]) + offset);
-        if (!ctx->models.list[i] || (!key_len && strcmp(key, val)) || (key_len && (strncmp(key, val, key_len) || val[key_len]))) {
+        if (!with_disabled && module->disabled) {
+            /* skip the disabled modules */
             continue;
         }
 
         if (!revision) {
             /* compare revisons and remember the newest one */
             if (result) {
-                if (!ctx->models.list[i]->rev_size) {
+                if (!module->rev_size) {
                     /* the current have no revision, keep the previous with some revision */
                     continue;
                 }
-                if (result->rev_size && strcmp(ctx->models.list[i]->rev[0].date, result->rev[0].date) < 0) {
+                if (result->rev_size && strcmp(module->rev[0].date, result->rev[0].date) < 0) {
                     /* the previous found matching module has a newer revision */
                     continue;
                 }
             }
             if (implemented) {
-                if (ctx->models.list[i]->implemented) {
+                if (module->implemented) {
                     /* we have the implemented revision */
-                    result = ctx->models.list[i];
+                    result = module;
                     break;
                 } else {
                     /* do not remember the result, we are supposed to return the implemented revision
@@ -695,15 +1253,16 @@ ly_ctx_get_module_by(const struct ly_ctx *ctx, const char *key, size_t key_len,
             }
 
             /* remember the current match and search for newer version */
-            result = ctx->models.list[i];
+            result = module;
         } else {
-            if (ctx->models.list[i]->rev_size && !strcmp(revision, ctx->models.list[i]->rev[0].date)) {
+            if (module->rev_size && !strcmp(revision, module->rev[0].date)) {
                 /* matching revision */
-                result = ctx->models.list[i];
+                result = module;
                 break;
             }
         }
     }
+    ly_ctx_modules_leave(ctx);
 
     return result;
 
@@ -731,6 +1290,38 @@ ly_ctx_nget_module(const struct ly_ctx *ctx, const char *name, size_t name_len,
     return ly_ctx_get_module_by(ctx, name, name_len, offsetof(struct lys_module, name), revision, 0, implemented);
 }
 
+int
+ly_ctx_nget_modules(const struct ly_ctx *ctx, const char *name, size_t name_len, struct ly_set *set)
+{
+    struct ly_ctx_module_key mod_key;
+    struct lys_module **match_p;
+    struct hash_table *ht;
+    uint32_t hash;
+    int r, ret = EXIT_SUCCESS;
+
+    mod_key.key = name;
+    mod_key.key_len = name_len ? name_len : strlen(name);
+    mod_key.offset = offsetof(struct lys_module, name);
+    hash = ly_ctx_module_hash(mod_key.key, mod_key.key_len);
+
+    ly_ctx_modules_enter(ctx);
+    ht = LY_ATOMIC_LOAD(ctx->models.name_ht);
+    if (!ht) {
+        /* the context is being destroyed */
+        ly_ctx_modules_leave(ctx);
+        return EXIT_SUCCESS;
+    }
+    for (r = lyht_find(ht, &mod_key, hash, (void **)&match_p); !r; r = lyht_find_next(ht, match_p, hash, (void **)&match_p)) {
+        if (ly_ctx_module_equal(&mod_key, match_p, 0, NULL) && (ly_set_add(set, *match_p, LY_SET_OPT_USEASLIST) == -1)) {
+            ret = -1;
+            break;
+        }
+    }
+    ly_ctx_modules_leave(ctx);
+
+    return ret;
+}
+
 API const struct lys_module *
 ly_ctx_get_module_older(const struct ly_ctx *ctx, const struct lys_module *module)
 {
@@ -805,6 +1396,36 @@ ly_ctx_get_module_imp_clb(const struct ly_ctx *ctx, void **user_data)
     return ctx->imp_clb;
 }
 
+API void
+ly_ctx_set_module_prefetch_clb(struct ly_ctx *ctx, ly_module_prefetch_clb clb, void *user_data)
+{
+    FUN_IN;
+
+    if (!ctx) {
+        LOGARG;
+        return;
+    }
+
+    ctx->prefetch_clb = clb;
+    ctx->prefetch_clb_data = user_data;
+}
+
+API ly_module_prefetch_clb
+ly_ctx_get_module_prefetch_clb(const struct ly_ctx *ctx, void **user_data)
+{
+    FUN_IN;
+
+    if (!ctx) {
+        LOGARG;
+        return NULL;
+    }
+
+    if (user_data) {
+        *user_data = ctx->prefetch_clb_data;
+    }
+    return ctx->prefetch_clb;
+}
+
 API void
 ly_ctx_set_module_data_clb(struct ly_ctx *ctx, ly_module_data_clb clb, void *user_data)
 {
@@ -835,20 +1456,266 @@ ly_ctx_get_module_data_clb(const struct ly_ctx *ctx, void **user_data)
     return ctx->data_clb;
 }
 
-#ifdef LY_ENABLED_LYD_PRIV
-
 API void
-ly_ctx_set_priv_dup_clb(struct ly_ctx *ctx, void *(*priv_dup_clb)(const void *priv))
+ly_ctx_set_ext_deps_clb(struct ly_ctx *ctx, ly_ext_deps_clb clb, void *user_data)
 {
     FUN_IN;
 
-    ctx->priv_dup_clb = priv_dup_clb;
+    if (!ctx) {
+        LOGARG;
+        return;
+    }
+
+    ctx->ext_deps_clb = clb;
+    ctx->ext_deps_clb_data = user_data;
 }
 
-#endif
+API ly_ext_deps_clb
+ly_ctx_get_ext_deps_clb(const struct ly_ctx *ctx, void **user_data)
+{
+    FUN_IN;
 
-/* if module is !NULL, then the function searches for submodule */
-static struct lys_module *
+    if (!ctx) {
+        LOGARG;
+        return NULL;
+    }
+
+    if (user_data) {
+        *user_data = ctx->ext_deps_clb_data;
+    }
+    return ctx->ext_deps_clb;
+}
+
+API int
+ly_ctx_set_allocator(struct ly_ctx *ctx, const struct ly_allocator *allocator)
+{
+    FUN_IN;
+
+#ifdef LY_ENABLED_DATA_POOL
+    struct lyd_pool_chunk *chunk;
+    union lyd_pool_slot *slot;
+    uint64_t used;
+#endif
+
+    if (!ctx || (allocator && (!allocator->malloc_clb || !allocator->free_clb))) {
+        LOGARG;
+        return EXIT_FAILURE;
+    }
+
+#ifdef LY_ENABLED_DATA_POOL
+    pthread_mutex_lock(&ctx->data_pool.lock);
+
+    /* the pool is already used while parsing the internal modules, it can be released only if no slot is used */
+    used = 0;
+    for (chunk = ctx->data_pool.chunks; chunk; chunk = chunk->next) {
+        used += chunk->size;
+    }
+    used -= ctx->data_pool.unused;
+    for (slot = ctx->data_pool.free; slot; slot = slot->next) {
+        --used;
+    }
+    if (used) {
+        pthread_mutex_unlock(&ctx->data_pool.lock);
+        LOGERR(ctx, LY_EINVAL, "The allocator cannot be changed while some data of the context exist.");
+        return EXIT_FAILURE;
+    }
+    lyd_pool_clean(ctx);
+
+    if (allocator) {
+        ctx->data_pool.allocator = *allocator;
+    } else {
+        memset(&ctx->data_pool.allocator, 0, sizeof ctx->data_pool.allocator);
+    }
+    pthread_mutex_unlock(&ctx->data_pool.lock);
+    return EXIT_SUCCESS;
+#else
+    (void)allocator;
+    LOGERR(ctx, LY_EINVAL, "The data pool is not enabled (ENABLE_DATA_POOL).");
+    return EXIT_FAILURE;
+#endif
+}
+
+API void
+ly_ctx_set_executor(struct ly_ctx *ctx, ly_task_submit_clb clb, unsigned int threads, void *user_data)
+{
+    FUN_IN;
+
+    if (!ctx) {
+        LOGARG;
+        return;
+    }
+
+    ctx->exec_clb = clb;
+    ctx->exec_clb_data = user_data;
+    ctx->exec_threads = threads;
+}
+
+API ly_task_submit_clb
+ly_ctx_get_executor(const struct ly_ctx *ctx, unsigned int *threads, void **user_data)
+{
+    FUN_IN;
+
+    if (!ctx) {
+        LOGARG;
+        return NULL;
+    }
+
+    if (threads) {
+        *threads = ctx->exec_threads;
+    }
+    if (user_data) {
+        *user_data = ctx->exec_clb_data;
+    }
+    return ctx->exec_clb;
+}
+
+uint32_t
+ly_parallel_count(const struct ly_ctx *ctx, uint32_t max)
+{
+    long cpus;
+    uint32_t count;
+
+    if (ctx && ctx->exec_threads) {
+        count = ctx->exec_threads;
+    } else {
+        cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        count = (cpus > 1) ? (uint32_t)cpus : 1;
+    }
+
+    return (count > max) ? max : count;
+}
+
+struct ly_parallel {
+    void (*task)(void *arg);
+    uint32_t pending;         /* number of the submitted tasks not finished yet */
+    pthread_mutex_t lock;
+    pthread_cond_t done;
+};
+
+struct ly_parallel_task {
+    struct ly_parallel *par;
+    void *arg;
+};
+
+static void
+ly_parallel_task(void *arg)
+{
+    struct ly_parallel_task *ptask = arg;
+    struct ly_parallel *par = ptask->par;
+
+    par->task(ptask->arg);
+
+    /* the submitting thread may free everything as soon as the lock is released */
+    pthread_mutex_lock(&par->lock);
+    if (!--par->pending) {
+        pthread_cond_signal(&par->done);
+    }
+    pthread_mutex_unlock(&par->lock);
+}
+
+static void *
+ly_parallel_thread(void *arg)
+{
+    ly_parallel_task(arg);
+    return NULL;
+}
+
+void
+ly_parallel_run(const struct ly_ctx *ctx, void (*task)(void *arg), void *args, size_t arg_size, uint32_t count)
+{
+    struct ly_parallel par;
+    struct ly_parallel_task *ptasks = NULL;
+    pthread_t *threads = NULL;
+    uint8_t *submitted = NULL;
+    uint32_t i;
+    int r;
+
+    if (count > 1) {
+        ptasks = malloc(count * sizeof *ptasks);
+        submitted = calloc(count, sizeof *submitted);
+        if (!ctx || !ctx->exec_clb) {
+            threads = malloc(count * sizeof *threads);
+        }
+    }
+    if (!ptasks || !submitted || ((!ctx || !ctx->exec_clb) && !threads)) {
+        /* run everything in this thread */
+        for (i = 0; i < count; ++i) {
+            task((char *)args + i * arg_size);
+        }
+        goto cleanup;
+    }
+
+    par.task = task;
+    par.pending = 0;
+    pthread_mutex_init(&par.lock, NULL);
+    pthread_cond_init(&par.done, NULL);
+
+    /* the calling thread runs the first task */
+    for (i = 1; i < count; ++i) {
+        ptasks[i].par = &par;
+        ptasks[i].arg = (char *)args + i * arg_size;
+
+        /* counted before it can finish */
+        pthread_mutex_lock(&par.lock);
+        ++par.pending;
+        pthread_mutex_unlock(&par.lock);
+
+        if (threads) {
+            r = pthread_create(&threads[i], NULL, ly_parallel_thread, &ptasks[i]);
+        } else {
+            r = ctx->exec_clb(ly_parallel_task, &ptasks[i], ctx->exec_clb_data);
+        }
+        if (r) {
+            pthread_mutex_lock(&par.lock);
+            --par.pending;
+            pthread_mutex_unlock(&par.lock);
+        } else {
+            submitted[i] = 1;
+        }
+    }
+    for (i = 0; i < count; ++i) {
+        if (!submitted[i]) {
+            /* the first task or a task that could not be submitted */
+            task((char *)args + i * arg_size);
+        }
+    }
+
+    pthread_mutex_lock(&par.lock);
+    while (par.pending) {
+        pthread_cond_wait(&par.done, &par.lock);
+    }
+    pthread_mutex_unlock(&par.lock);
+
+    if (threads) {
+        for (i = 1; i < count; ++i) {
+            if (submitted[i]) {
+                pthread_join(threads[i], NULL);
+            }
+        }
+    }
+    pthread_cond_destroy(&par.done);
+    pthread_mutex_destroy(&par.lock);
+
+cleanup:
+    free(ptasks);
+    free(submitted);
+    free(threads);
+}
+
+#ifdef LY_ENABLED_LYD_PRIV
+
+API void
+ly_ctx_set_priv_dup_clb(struct ly_ctx *ctx, void *(*priv_dup_clb)(const void *priv))
+{
+    FUN_IN;
+
+    ctx->priv_dup_clb = priv_dup_clb;
+}
+
+#endif
+
+/* if module is !NULL, then the function searches for submodule */
+static struct lys_module *
 ly_ctx_load_localfile(struct ly_ctx *ctx, struct lys_module *module, const char *name, const char *revision,
                 int implement, struct unres_schema *unres)
 {
@@ -858,8 +1725,8 @@ ly_ctx_load_localfile(struct ly_ctx *ctx, struct lys_module *module, const char
     LYS_INFORMAT format;
     struct lys_module *result = NULL;
 
-    if (lys_search_localfile(ly_ctx_get_searchdirs(ctx), !(ctx->models.flags & LY_CTX_DISABLE_SEARCHDIR_CWD), name, revision,
-                             &filepath, &format)) {
+    if (lys_search_localfile_ctx(ctx, ly_ctx_get_searchdirs(ctx), !(ctx->models.flags & LY_CTX_DISABLE_SEARCHDIR_CWD),
+                                 name, revision, &filepath, &format)) {
         goto cleanup;
     } else if (!filepath) {
         if (!module && !revision) {
@@ -1102,109 +1969,352 @@ ly_ctx_load_module(struct ly_ctx *ctx, const char *name, const char *revision)
     return ly_ctx_load_sub_module(ctx, NULL, name, revision && revision[0] ? revision : NULL, 1, NULL);
 }
 
-/*
- * mods - set of removed modules, if NULL all modules are supposed to be removed so any backlink is invalid
+API int
+ly_ctx_load_modules(struct ly_ctx *ctx, const char **names, const char **revisions, unsigned int count,
+                    const struct lys_module **modules)
+{
+    FUN_IN;
+
+    const char **revs = revisions;
+    const struct lys_module *mod;
+    unsigned int u;
+
+    if (!ctx || (!names && count)) {
+        LOGARG;
+        return EXIT_FAILURE;
+    }
+    for (u = 0; u < count; ++u) {
+        if (!names[u]) {
+            LOGARG;
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (!revs) {
+        revs = calloc(count ? count : 1, sizeof *revs);
+        LY_CHECK_ERR_RETURN(!revs, LOGMEM(ctx), EXIT_FAILURE);
+    }
+
+    ly_ctx_prefetch(ctx, names, revs, count);
+
+    for (u = 0; u < count; ++u) {
+        mod = ly_ctx_load_sub_module(ctx, NULL, names[u], revs[u] && revs[u][0] ? revs[u] : NULL, 1, NULL);
+        if (!mod) {
+            break;
+        }
+        if (modules) {
+            modules[u] = mod;
+        }
+    }
+
+    if (revs != revisions) {
+        free(revs);
+    }
+    return (u < count) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+static int
+ctx_module_internal(struct ly_ctx *ctx, const struct lys_module *mod)
+{
+    int i;
+
+    for (i = 0; i < ctx->internal_module_count; i++) {
+        if (mod == ctx->models.list[i]) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Check whether a module is imported by a module which is going to stay in the context.
+ *
+ * @param[in] ctx Context with the imports index.
+ * @param[in] mod Module to check.
+ * @param[in] mods Set of the modules to remove (disable).
+ * @param[in] disable Whether the modules are being disabled, the disabled modules are not imported anymore.
+ * @return 1 if imported, 0 if not.
  */
-static void
-ctx_modules_undo_backlinks(struct ly_ctx *ctx, struct ly_set *mods)
+static int
+ctx_module_imported(struct ly_ctx *ctx, struct lys_module *mod, struct ly_set *mods, int disable)
 {
-    int o;
+    struct ly_ctx_module_imp imp, *match;
+    uint32_t hash;
+    int r;
+
+    imp.module = mod;
+    hash = ly_ctx_module_imp_hash(mod);
+    for (r = lyht_find(ctx->models.imp_ht, &imp, hash, (void **)&match); !r;
+            r = lyht_find_next(ctx->models.imp_ht, match, hash, (void **)&match)) {
+        if (match->module != mod) {
+            /* hash collision */
+            continue;
+        }
+        if (ctx_module_internal(ctx, match->importer) || (disable && match->importer->disabled)
+                || (ly_set_contains(mods, match->importer) != -1)) {
+            /* importer is not taken into account or it is going to be removed, too */
+            continue;
+        }
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Get the complete list of modules to remove (disable) because of dependencies,
+ * we are going also to remove all the imported (not implemented) modules that are not used in any other module.
+ *
+ * Only the imports of the affected modules are followed in the imports index, not the whole context.
+ *
+ * @param[in] ctx Context of the module.
+ * @param[in] mod Module to remove (disable).
+ * @param[in] disable Whether the modules are being disabled, they are marked disabled and
+ * the already disabled modules are skipped.
+ * @return Set of the modules to remove (disable), NULL on error.
+ */
+static struct ly_set *
+ctx_modules_dependent(struct ly_ctx *ctx, struct lys_module *mod, int disable)
+{
+    struct ly_set *mods, *cand;
+    struct ly_ctx_module_imp imp, *match;
+    struct lys_module *m;
+    unsigned int u = 0;
+    uint32_t hash;
     uint8_t j;
-    unsigned int u, v;
-    struct lys_module *mod;
-    struct lys_node *elem, *next;
-    struct lys_node_leaf *leaf;
+    int i, r;
 
-    /* maintain backlinks (start with internal ietf-yang-library which have leafs as possible targets of leafrefs */
-    for (o = ctx->internal_module_count - 1; o < ctx->models.used; o++) {
-        mod = ctx->models.list[o]; /* shortcut */
+    mods = ly_set_new();
+    cand = ly_set_new();
+    LY_CHECK_ERR_GOTO(!mods || !cand, LOGMEM(ctx), error);
+    LY_CHECK_GOTO(ly_set_add(mods, mod, 0) == -1, error);
 
-        /* 1) features */
-        for (j = 0; j < mod->features_size; j++) {
-            if (!mod->features[j].depfeatures) {
-                continue;
-            }
-            for (v = 0; v < mod->features[j].depfeatures->number; v++) {
-                if (!mods || ly_set_contains(mods, ((struct lys_feature *)mod->features[j].depfeatures->set.g[v])->module) != -1) {
-                    /* depending feature is in module to remove */
-                    ly_set_rm_index(mod->features[j].depfeatures, v);
-                    v--;
+    /* any imported (not implemented) module can be unused */
+    for (i = ctx->internal_module_count; i < ctx->models.used; i++) {
+        m = ctx->models.list[i];
+        if (m && (m != mod) && !m->implemented) {
+            LY_CHECK_GOTO(ly_set_add(cand, m, LY_SET_OPT_USEASLIST) == -1, error);
+        }
+    }
+
+    do {
+        for (; u < mods->number; u++) {
+            m = mods->set.g[u];
+
+            /* modules importing some module to remove must be also removed */
+            imp.module = m;
+            hash = ly_ctx_module_imp_hash(m);
+            for (r = lyht_find(ctx->models.imp_ht, &imp, hash, (void **)&match); !r;
+                    r = lyht_find_next(ctx->models.imp_ht, match, hash, (void **)&match)) {
+                if ((match->module != m) || ctx_module_internal(ctx, match->importer)
+                        || (disable && match->importer->disabled) || (ly_set_contains(mods, match->importer) != -1)) {
+                    continue;
+                }
+                LY_CHECK_GOTO(ly_set_add(mods, match->importer, LY_SET_OPT_USEASLIST) == -1, error);
+                if (disable) {
+                    match->importer->disabled = 1;
                 }
             }
-            if (!mod->features[j].depfeatures->number) {
-                /* all backlinks removed */
-                ly_set_free(mod->features[j].depfeatures);
-                mod->features[j].depfeatures = NULL;
+
+            /* the modules it imports may become useless */
+            for (j = 0; j < m->imp_size; j++) {
+                if (!m->imp[j].module->implemented) {
+                    LY_CHECK_GOTO(ly_set_add(cand, m->imp[j].module, LY_SET_OPT_USEASLIST) == -1, error);
+                }
             }
         }
 
-        /* 2) identities */
-        for (u = 0; u < mod->ident_size; u++) {
-            if (!mod->ident[u].der) {
+        while (cand->number) {
+            m = cand->set.g[cand->number - 1];
+            ly_set_rm_index(cand, cand->number - 1);
+            if (ctx_module_internal(ctx, m) || (disable && m->disabled) || (ly_set_contains(mods, m) != -1)) {
                 continue;
             }
-            for (v = 0; v < mod->ident[u].der->number; v++) {
-                if (!mods || ly_set_contains(mods, ((struct lys_ident *)mod->ident[u].der->set.g[v])->module) != -1) {
-                    /* derived identity is in module to remove */
-                    ly_set_rm_index(mod->ident[u].der, v);
-                    v--;
+
+            if (!ctx_module_imported(ctx, m, mods, disable)) {
+                /* module is not implemented and neither imported by any other module in context
+                 * which is supposed to be kept after this operation, so we are going to remove also
+                 * this useless module, its imports are checked in the next round */
+                LY_CHECK_GOTO(ly_set_add(mods, m, LY_SET_OPT_USEASLIST) == -1, error);
+                if (disable) {
+                    m->disabled = 1;
                 }
             }
-            if (!mod->ident[u].der->number) {
-                /* all backlinks removed */
-                ly_set_free(mod->ident[u].der);
-                mod->ident[u].der = NULL;
+        }
+    } while (u < mods->number);
+
+    ly_set_free(cand);
+    return mods;
+
+error:
+    for (u = 0; disable && mods && (u < mods->number); u++) {
+        ((struct lys_module *)mods->set.g[u])->disabled = 0;
+    }
+    ly_set_free(mods);
+    ly_set_free(cand);
+    return NULL;
+}
+
+/**
+ * @brief Add the modules imported by a module, including the imports of its submodules.
+ */
+static int
+ctx_modules_add_imports(struct ly_set *set, struct lys_module *mod)
+{
+    uint8_t j, k;
+
+    for (j = 0; j < mod->imp_size; j++) {
+        if (ly_set_add(set, mod->imp[j].module, 0) == -1) {
+            return -1;
+        }
+    }
+    for (k = 0; k < mod->inc_size; k++) {
+        if (!mod->inc[k].submodule) {
+            continue;
+        }
+        for (j = 0; j < mod->inc[k].submodule->imp_size; j++) {
+            if (ly_set_add(set, mod->inc[k].submodule->imp[j].module, 0) == -1) {
+                return -1;
             }
         }
+    }
+    return 0;
+}
 
-        /* 3) leafrefs */
-        for (elem = next = mod->data; elem; elem = next) {
-            if (elem->nodetype & (LYS_LEAF | LYS_LEAFLIST)) {
-                leaf = (struct lys_node_leaf *)elem; /* shortcut */
-                if (leaf->backlinks) {
-                    if (!mods) {
-                        /* remove all backlinks */
+/*
+ * mods - set of removed modules
+ */
+static void
+ctx_module_undo_backlinks(struct lys_module *mod, struct ly_set *mods)
+{
+    uint8_t j;
+    unsigned int u, v;
+    struct lys_node *elem, *next;
+    struct lys_node_leaf *leaf;
+
+    /* 1) features */
+    for (j = 0; j < mod->features_size; j++) {
+        if (!mod->features[j].depfeatures) {
+            continue;
+        }
+        for (v = 0; v < mod->features[j].depfeatures->number; v++) {
+            if (!mods || ly_set_contains(mods, ((struct lys_feature *)mod->features[j].depfeatures->set.g[v])->module) != -1) {
+                /* depending feature is in module to remove */
+                ly_set_rm_index(mod->features[j].depfeatures, v);
+                v--;
+            }
+        }
+        if (!mod->features[j].depfeatures->number) {
+            /* all backlinks removed */
+            ly_set_free(mod->features[j].depfeatures);
+            mod->features[j].depfeatures = NULL;
+        }
+    }
+
+    /* 2) identities */
+    for (u = 0; u < mod->ident_size; u++) {
+        if (!mod->ident[u].der) {
+            continue;
+        }
+        for (v = 0; v < mod->ident[u].der->number; v++) {
+            if (!mods || ly_set_contains(mods, ((struct lys_ident *)mod->ident[u].der->set.g[v])->module) != -1) {
+                /* derived identity is in module to remove */
+                ly_set_rm_index(mod->ident[u].der, v);
+                v--;
+            }
+        }
+        if (!mod->ident[u].der->number) {
+            /* all backlinks removed */
+            ly_set_free(mod->ident[u].der);
+            mod->ident[u].der = NULL;
+        }
+    }
+
+    /* 3) leafrefs */
+    for (elem = next = mod->data; elem; elem = next) {
+        if (elem->nodetype & (LYS_LEAF | LYS_LEAFLIST)) {
+            leaf = (struct lys_node_leaf *)elem; /* shortcut */
+            if (leaf->backlinks) {
+                if (!mods) {
+                    /* remove all backlinks */
+                    ly_set_free(leaf->backlinks);
+                    leaf->backlinks = NULL;
+                } else {
+                    for (v = 0; v < leaf->backlinks->number; v++) {
+                        if (ly_set_contains(mods, leaf->backlinks->set.s[v]->module) != -1) {
+                            /* derived identity is in module to remove */
+                            ly_set_rm_index(leaf->backlinks, v);
+                            v--;
+                        }
+                    }
+                    if (!leaf->backlinks->number) {
+                        /* all backlinks removed */
                         ly_set_free(leaf->backlinks);
                         leaf->backlinks = NULL;
-                    } else {
-                        for (v = 0; v < leaf->backlinks->number; v++) {
-                            if (ly_set_contains(mods, leaf->backlinks->set.s[v]->module) != -1) {
-                                /* derived identity is in module to remove */
-                                ly_set_rm_index(leaf->backlinks, v);
-                                v--;
-                            }
-                        }
-                        if (!leaf->backlinks->number) {
-                            /* all backlinks removed */
-                            ly_set_free(leaf->backlinks);
-                            leaf->backlinks = NULL;
-                        }
                     }
                 }
             }
+        }
 
-            /* select next element to process */
-            next = elem->child;
-            /* child exception for leafs, leaflists, anyxml and groupings */
-            if (elem->nodetype & (LYS_LEAF | LYS_LEAFLIST | LYS_ANYDATA | LYS_GROUPING)) {
-                next = NULL;
-            }
-            if (!next) {
-                /* no children,  try siblings */
-                next = elem->next;
-            }
-            while (!next) {
-                /* parent is already processed, go to its sibling */
-                elem = lys_parent(elem);
-                if (!elem) {
-                    /* we are done, no next element to process */
-                    break;
-                }
-                /* no siblings, go back through parents */
-                next = elem->next;
+        /* select next element to process */
+        next = elem->child;
+        /* child exception for leafs, leaflists, anyxml and groupings */
+        if (elem->nodetype & (LYS_LEAF | LYS_LEAFLIST | LYS_ANYDATA | LYS_GROUPING)) {
+            next = NULL;
+        }
+        if (!next) {
+            /* no children,  try siblings */
+            next = elem->next;
+        }
+        while (!next) {
+            /* parent is already processed, go to its sibling */
+            elem = lys_parent(elem);
+            if (!elem) {
+                /* we are done, no next element to process */
+                break;
             }
+            /* no siblings, go back through parents */
+            next = elem->next;
+        }
+    }
+}
+
+/*
+ * mods - set of removed modules, if NULL all modules are supposed to be removed so any backlink is invalid
+ */
+static void
+ctx_modules_undo_backlinks(struct ly_ctx *ctx, struct ly_set *mods)
+{
+    int o;
+    unsigned int u;
+    struct ly_set *targets;
+
+    if (!mods) {
+        for (o = ctx->internal_module_count - 1; o < ctx->models.used; o++) {
+            ctx_module_undo_backlinks(ctx->models.list[o], NULL);
+        }
+        return;
+    }
+
+    /* the backlinks (features, identities, leafref targets) are always in modules referenced by prefixes,
+     * so only the removed modules and the modules they import, directly or indirectly, are affected,
+     * start with internal ietf-yang-library which have leafs as possible targets of leafrefs */
+    targets = ly_set_new();
+    LY_CHECK_ERR_RETURN(!targets, LOGMEM(ctx), );
+    ly_set_add(targets, ctx->models.list[ctx->internal_module_count - 1], 0);
+    for (u = 0; u < mods->number; u++) {
+        ly_set_add(targets, mods->set.g[u], 0);
+    }
+    for (u = 0; u < targets->number; u++) {
+        if (ctx_modules_add_imports(targets, (struct lys_module *)targets->set.g[u])) {
+            LOGMEM(ctx);
+            break;
         }
     }
+
+    for (u = 0; u < targets->number; u++) {
+        ctx_module_undo_backlinks((struct lys_module *)targets->set.g[u], mods);
+    }
+    ly_set_free(targets);
 }
 
 static int
@@ -1297,8 +2407,7 @@ lys_set_disabled(const struct lys_module *module)
     struct ly_ctx *ctx; /* shortcut */
     struct lys_module *mod;
     struct ly_set *mods;
-    uint8_t j, imported;
-    int i, o;
+    int i;
     unsigned int u, v;
 
     if (!module) {
@@ -1322,63 +2431,11 @@ lys_set_disabled(const struct lys_module *module)
     /* disable the module */
     mod->disabled = 1;
 
-    /* get the complete list of modules to disable because of dependencies,
-     * we are going also to disable all the imported (not implemented) modules
-     * that are not used in any other module */
-    mods = ly_set_new();
-    ly_set_add(mods, mod, 0);
-checkdependency:
-    for (i = ctx->internal_module_count; i < ctx->models.used; i++) {
-        mod = ctx->models.list[i]; /* shortcut */
-        if (mod->disabled) {
-            /* skip the already disabled modules */
-            continue;
-        }
-
-        /* check depndency of imported modules */
-        for (j = 0; j < mod->imp_size; j++) {
-            for (u = 0; u < mods->number; u++) {
-                if (mod->imp[j].module == mods->set.g[u]) {
-                    /* module is importing some module to disable, so it must be also disabled */
-                    mod->disabled = 1;
-                    ly_set_add(mods, mod, 0);
-                    /* we have to start again because some of the already checked modules can
-                     * depend on the one we have just decided to disable */
-                    goto checkdependency;
-                }
-            }
-        }
-        /* check if the imported module is used in any module supposed to be kept */
-        if (!mod->implemented) {
-            imported = 0;
-            for (o = ctx->internal_module_count; o < ctx->models.used; o++) {
-                if (ctx->models.list[o]->disabled) {
-                    /* skip modules already disabled */
-                    continue;
-                }
-                for (j = 0; j < ctx->models.list[o]->imp_size; j++) {
-                    if (ctx->models.list[o]->imp[j].module == mod) {
-                        /* the module is used in some other module not yet selected to be disabled */
-                        imported = 1;
-                        goto imported;
-                    }
-                }
-            }
-imported:
-            if (!imported) {
-                /* module is not implemented and neither imported by any other module in context
-                 * which is supposed to be kept enabled after this operation, so we are going to disable also
-                 * this module */
-                mod->disabled = 1;
-                ly_set_add(mods, mod, 0);
-                /* we have to start again, this time not because other module can depend on this one
-                 * (we know that there is no such module), but because the module can import module
-                 * that could became useless. If there are no imports, we can continue */
-                if (mod->imp_size) {
-                    goto checkdependency;
-                }
-            }
-        }
+    /* get the complete list of modules to disable because of dependencies */
+    mods = ctx_modules_dependent(ctx, mod, 1);
+    if (!mods) {
+        mod->disabled = 0;
+        return EXIT_FAILURE;
     }
 
     /* before removing applied deviations, augments and updating leafrefs, we have to enable the modules
@@ -1443,8 +2500,10 @@ lys_set_enabled(const struct lys_module *module)
 
     struct ly_ctx *ctx; /* shortcut */
     struct lys_module *mod;
-    struct ly_set *mods, *disabled;
-    int i;
+    struct ly_set *mods;
+    struct ly_ctx_module_imp imp, *match;
+    uint32_t hash;
+    int i, r;
     unsigned int u, v, w;
 
     if (!module) {
@@ -1466,60 +2525,43 @@ lys_set_enabled(const struct lys_module *module)
     }
 
     mods = ly_set_new();
-    disabled = ly_set_new();
 
     /* enable the module, including its dependencies */
     lys_set_enabled_(mods, mod);
 
-    /* we will go through the all disabled modules in the context, if the module has no dependency (import)
-     * that is still disabled AND at least one of its imported module is from the set we are enabling now,
-     * it is going to be also enabled. This way we try to revert everething that was possibly done by
-     * lys_set_disabled(). */
-checkdependency:
-    for (i = ctx->internal_module_count; i < ctx->models.used; i++) {
-        mod = ctx->models.list[i]; /* shortcut */
-        if (!mod->disabled || ly_set_contains(disabled, mod) != -1) {
-            /* skip the enabled modules */
-            continue;
-        }
-
-        /* check imported modules */
-        for (u = 0; u < mod->imp_size; u++) {
-            if (mod->imp[u].module->disabled) {
-                /* it has disabled dependency so it must stay disabled */
-                break;
+    /* the disabled modules importing any module enabled now are enabled as well, if they have no other
+     * disabled dependency (import). Only the importers of the enabled modules are found in the imports index,
+     * this way we try to revert everything that was possibly done by lys_set_disabled(). */
+    for (v = 0; v < mods->number; v++) {
+        imp.module = mods->set.g[v];
+        hash = ly_ctx_module_imp_hash(imp.module);
+        for (r = lyht_find(ctx->models.imp_ht, &imp, hash, (void **)&match); !r;
+                r = lyht_find_next(ctx->models.imp_ht, match, hash, (void **)&match)) {
+            mod = match->importer; /* shortcut */
+            if ((match->module != imp.module) || !mod->disabled || ctx_module_internal(ctx, mod)) {
+                /* hash collision or an enabled module */
+                continue;
             }
-        }
-        if (u < mod->imp_size) {
-            /* it has disabled dependency, continue with the next module in the context */
-            continue;
-        }
 
-        /* get know if at least one of the imported modules is being enabled this time */
-        for (u = 0; u < mod->imp_size; u++) {
-            for (v = 0; v < mods->number; v++) {
-                if (mod->imp[u].module == mods->set.g[v]) {
-                    /* yes, it is, so they are connected and we are going to enable it as well,
-                     * it is not necessary to call recursive lys_set_enable_() because we already
-                     * know that there is no disabled import to enable */
-                    mod->disabled = 0;
-                    ly_set_add(mods, mod, 0);
-                    for (w = 0; w < mod->inc_size; w++) {
-                        mod->inc[w].submodule->disabled = 0;
-                    }
-                    /* we have to start again because some of the already checked modules can
-                     * depend on the one we have just decided to enable */
-                    goto checkdependency;
+            /* check imported modules */
+            for (u = 0; u < mod->imp_size; u++) {
+                if (mod->imp[u].module->disabled) {
+                    /* it has disabled dependency so it must stay disabled */
+                    break;
                 }
             }
-        }
+            if (u < mod->imp_size) {
+                continue;
+            }
 
-        /* this module is disabled, but it does not depend on any other disabled module and none
-         * of its imports was not enabled in this call. No future enabling of the disabled module
-         * will change this so we can remember the module and skip it next time we will have to go
-         * through the all context because of the checkdependency goto.
-         */
-        ly_set_add(disabled, mod, 0);
+            /* it is not necessary to call recursive lys_set_enable_() because we already
+             * know that there is no disabled import to enable */
+            mod->disabled = 0;
+            for (w = 0; w < mod->inc_size; w++) {
+                mod->inc[w].submodule->disabled = 0;
+            }
+            ly_set_add(mods, mod, 0);
+        }
     }
 
     /* maintain backlinks (start with internal ietf-yang-library which have leafs as possible targets of leafrefs */
@@ -1532,9 +2574,7 @@ checkdependency:
         }
     }
 
-    /* free the sets */
     ly_set_free(mods);
-    ly_set_free(disabled);
 
     /* update the module-set-id */
     ctx->models.module_set_id++;
@@ -1551,7 +2591,6 @@ ly_ctx_remove_module(const struct lys_module *module,
     struct ly_ctx *ctx; /* shortcut */
     struct lys_module *mod = NULL;
     struct ly_set *mods;
-    uint8_t j, imported;
     int i, o;
     unsigned int u;
 
@@ -1570,129 +2609,302 @@ ly_ctx_remove_module(const struct lys_module *module,
             return EXIT_FAILURE;
         }
     }
-    /* ... and hide the module from the further processing of the context modules list */
-    for (i = ctx->internal_module_count; i < ctx->models.used; i++) {
-        if (mod == ctx->models.list[i]) {
+
+    /* get the complete list of modules to remove because of dependencies */
+    mods = ctx_modules_dependent(ctx, mod, 0);
+    if (!mods) {
+        return EXIT_FAILURE;
+    }
+
+    /* the modules cannot be found anymore */
+    for (u = 0; u < mods->number; u++) {
+        ly_ctx_module_index_remove((struct lys_module *)mods->set.g[u]);
+    }
+
+    /* consolidate the modules list */
+    for (i = o = ctx->internal_module_count; i < ctx->models.used; i++) {
+        if (ly_set_contains(mods, ctx->models.list[i]) != -1) {
+            /* removed module */
             ctx->models.list[i] = NULL;
-            break;
+        } else {
+            /* used cell, move it to the first empty output cell */
+            if (i != o) {
+                ctx->models.list[o] = ctx->models.list[i];
+                ctx->models.list[i] = NULL;
+            }
+            o++;
         }
     }
+    ctx->models.used = o;
+    ctx->models.module_set_id++;
+
+    /* maintain backlinks (start with internal ietf-yang-library which have leafs as possible targets of leafrefs */
+    ctx_modules_undo_backlinks(ctx, mods);
+
+    /* free the modules */
+    for (u = 0; u < mods->number; u++) {
+        /* remove the applied deviations and augments */
+        lys_sub_module_remove_devs_augs((struct lys_module *)mods->set.g[u]);
+        /* remove the module */
+        lys_free((struct lys_module *)mods->set.g[u], private_destructor, 1, 0);
+    }
+    ly_set_free(mods);
+
+    /* the cached expressions and the indexed nodes may belong to the removed modules */
+    lyxp_expr_cache_clean(ctx);
+    lyxp_deps_clean(ctx);
+    lys_data_children_clean(ctx);
+    lyb_hashes_clean(ctx);
+    lyb_sibling_hts_clean(ctx);
+    lys_print_cache_clean(ctx);
+    /* the modules cannot be removed concurrently with any reader */
+    ly_ctx_modules_reclaim(ctx);
+
+    return EXIT_SUCCESS;
+}
+
+API void
+ly_ctx_clean(struct ly_ctx *ctx, void (*private_destructor)(const struct lys_node *node, void *priv))
+{
+    FUN_IN;
+
+    if (!ctx) {
+        return;
+    }
+
+    /* models list */
+    for (; ctx->models.used > ctx->internal_module_count; ctx->models.used--) {
+        /* remove the applied deviations and augments */
+        lys_sub_module_remove_devs_augs(ctx->models.list[ctx->models.used - 1]);
+        /* remove the module */
+        lys_free(ctx->models.list[ctx->models.used - 1], private_destructor, 1, 0);
+        /* clean it for safer future use */
+        ctx->models.list[ctx->models.used - 1] = NULL;
+    }
+    ctx->models.module_set_id++;
+
+    /* the cached expressions and the indexed nodes may belong to the removed modules */
+    lyxp_expr_cache_clean(ctx);
+    lyxp_deps_clean(ctx);
+    lys_data_children_clean(ctx);
+    lyb_hashes_clean(ctx);
+    lyb_sibling_hts_clean(ctx);
+    lys_print_cache_clean(ctx);
+    ly_ctx_modules_reclaim(ctx);
+
+    /* maintain backlinks (actually done only with ietf-yang-library since its leafs can be target of leafref) */
+    ctx_modules_undo_backlinks(ctx, NULL);
+}
+
+/*
+ * The schema text of a module or a submodule of the context being cloned, either the content
+ * of the file it was read from or the module printed back as YANG.
+ */
+static char *
+ly_ctx_clone_source(const struct lys_module *module, LYS_INFORMAT *format)
+{
+    struct stat st;
+    char *data = NULL;
+    size_t len;
+    ssize_t r;
+    int fd;
+
+    if (module->filepath) {
+        len = strlen(module->filepath);
+        *format = (len > 4 && !strcmp(module->filepath + len - 4, ".yin")) ? LYS_IN_YIN : LYS_IN_YANG;
+
+        fd = open(module->filepath, O_RDONLY);
+        if (fd == -1) {
+            LOGERR(module->ctx, LY_ESYS, "Opening file \"%s\" failed (%s).", module->filepath, strerror(errno));
+            return NULL;
+        }
+        if (fstat(fd, &st) == -1) {
+            LOGERR(module->ctx, LY_ESYS, "Reading file \"%s\" failed (%s).", module->filepath, strerror(errno));
+            goto error;
+        }
+        data = malloc(st.st_size + 1);
+        LY_CHECK_ERR_GOTO(!data, LOGMEM(module->ctx), error);
+        for (len = 0; len < (size_t)st.st_size; len += r) {
+            r = read(fd, data + len, st.st_size - len);
+            if (r < 1) {
+                LOGERR(module->ctx, LY_ESYS, "Reading file \"%s\" failed (%s).", module->filepath,
+                       r ? strerror(errno) : "unexpected end of file");
+                goto error;
+            }
+        }
+        data[len] = '\0';
+        close(fd);
+        return data;
+
+error:
+        free(data);
+        close(fd);
+        return NULL;
+    }
+
+    if (module->deviated) {
+        /* printing it would switch its deviations off for a while, under the users of the source context */
+        LOGERR(module->ctx, LY_EINVAL, "Deviated %smodule \"%s\" was not read from a file and cannot be cloned.",
+               module->type ? "sub" : "", module->name);
+        return NULL;
+    }
+
+    *format = LYS_IN_YANG;
+    if (lys_print_mem(&data, module, LYS_OUT_YANG, NULL, 0, 0)) {
+        free(data);
+        return NULL;
+    }
+    return data;
+}
+
+static void
+ly_ctx_clone_free_source(void *model_data, void *UNUSED(user_data))
+{
+    free(model_data);
+}
+
+/* provides the submodules (and the modules) of the source context while cloning it */
+static const char *
+ly_ctx_clone_imp_clb(const char *mod_name, const char *mod_rev, const char *submod_name, const char *sub_rev,
+                     void *user_data, LYS_INFORMAT *format, void (**free_module_data)(void *model_data, void *user_data))
+{
+    const struct ly_ctx *src = user_data;
+    const struct lys_module *module;
+
+    if (submod_name) {
+        module = (const struct lys_module *)ly_ctx_get_submodule(src, mod_name, mod_rev, submod_name, sub_rev);
+    } else {
+        module = ly_ctx_get_module_by(src, mod_name, 0, offsetof(struct lys_module, name), mod_rev, 1, 0);
+    }
+    if (!module) {
+        return NULL;
+    }
+
+    *free_module_data = ly_ctx_clone_free_source;
+    return ly_ctx_clone_source(module, format);
+}
+
+static void
+ly_ctx_clone_features(struct lys_feature *dst, uint8_t dst_size, const struct lys_feature *src, uint8_t src_size)
+{
+    uint8_t i;
+
+    for (i = 0; (i < dst_size) && (i < src_size); ++i) {
+        if (!ly_strequal(dst[i].name, src[i].name, 0)) {
+            continue;
+        }
+        dst[i].flags = (dst[i].flags & ~LYS_FENABLED) | (src[i].flags & LYS_FENABLED);
+    }
+}
+
+API struct ly_ctx *
+ly_ctx_clone(const struct ly_ctx *ctx)
+{
+    FUN_IN;
+
+    struct ly_ctx *clone;
+    const struct lys_module *mod;
+    struct lys_module *cmod;
+    const char * const *dirs;
+    char *data;
+    LYS_INFORMAT format;
+    int i;
+    uint8_t u;
+
+    if (!ctx) {
+        LOGARG;
+        return NULL;
+    }
 
-    /* get the complete list of modules to remove because of dependencies,
-     * we are going also to remove all the imported (not implemented) modules
-     * that are not used in any other module */
-    mods = ly_set_new();
-    ly_set_add(mods, mod, 0);
-checkdependency:
-    for (i = ctx->internal_module_count; i < ctx->models.used; i++) {
-        mod = ctx->models.list[i]; /* shortcut */
-        if (!mod) {
-            /* skip modules already selected for removing */
-            continue;
+    /* the source schemas were already validated and all the modules are loaded
+     * explicitly below with their implemented state */
+    clone = ly_ctx_new(NULL, (ctx->models.flags | LY_CTX_TRUSTED) & ~(LY_CTX_ALLIMPLEMENTED | LY_CTX_PREFER_SEARCHDIRS));
+    if (!clone) {
+        return NULL;
+    }
+    for (dirs = ly_ctx_get_searchdirs(ctx); dirs && *dirs; ++dirs) {
+        if (ly_ctx_set_searchdir(clone, *dirs)) {
+            goto error;
         }
+    }
+    clone->data_clb = ctx->data_clb;
+    clone->data_clb_data = ctx->data_clb_data;
+    clone->ext_deps_clb = ctx->ext_deps_clb;
+    clone->ext_deps_clb_data = ctx->ext_deps_clb_data;
+#ifdef LY_ENABLED_DATA_POOL
+    /* no data created yet */
+    clone->data_pool.allocator = ctx->data_pool.allocator;
+#endif
+#ifdef LY_ENABLED_LYD_PRIV
+    clone->priv_dup_clb = ctx->priv_dup_clb;
+#endif
 
-        /* check depndency of imported modules */
-        for (j = 0; j < mod->imp_size; j++) {
-            for (u = 0; u < mods->number; u++) {
-                if (mod->imp[j].module == mods->set.g[u]) {
-                    /* module is importing some module to remove, so it must be also removed */
-                    ly_set_add(mods, mod, 0);
-                    ctx->models.list[i] = NULL;
-                    /* we have to start again because some of the already checked modules can
-                     * depend on the one we have just decided to remove */
-                    goto checkdependency;
-                }
+    /* submodules are taken from the source context, a module always follows its imports in the list */
+    clone->imp_clb = ly_ctx_clone_imp_clb;
+    clone->imp_clb_data = (void *)ctx;
+    for (i = 0; i < ctx->models.used; ++i) {
+        mod = ctx->models.list[i];
+        cmod = (struct lys_module *)ly_ctx_get_module_by(clone, mod->name, 0, offsetof(struct lys_module, name),
+                                                         mod->rev_size ? mod->rev[0].date : NULL, 1, 0);
+        if (!cmod) {
+            data = ly_ctx_clone_source(mod, &format);
+            if (!data) {
+                goto error;
             }
-        }
-        /* check if the imported module is used in any module supposed to be kept */
-        if (!mod->implemented) {
-            imported = 0;
-            for (o = ctx->internal_module_count; o < ctx->models.used; o++) {
-                if (!ctx->models.list[o]) {
-                    /* skip modules already selected for removing */
-                    continue;
-                }
-                for (j = 0; j < ctx->models.list[o]->imp_size; j++) {
-                    if (ctx->models.list[o]->imp[j].module == mod) {
-                        /* the module is used in some other module not yet selected to be deleted */
-                        imported = 1;
-                        goto imported;
-                    }
-                }
+            cmod = (struct lys_module *)lys_parse_mem_(clone, data, format, NULL, 0, mod->implemented);
+            free(data);
+            if (!cmod) {
+                goto error;
             }
-imported:
-            if (!imported) {
-                /* module is not implemented and neither imported by any other module in context
-                 * which is supposed to be kept after this operation, so we are going to remove also
-                 * this useless module */
-                ly_set_add(mods, mod, 0);
-                ctx->models.list[i] = NULL;
-                /* we have to start again, this time not because other module can depend on this one
-                 * (we know that there is no such module), but because the module can import module
-                 * that could became useless. If there are no imports, we can continue */
-                if (mod->imp_size) {
-                    goto checkdependency;
-                }
+            if (mod->filepath && !cmod->filepath) {
+                cmod->filepath = lydict_insert(clone, mod->filepath, 0);
             }
+        } else if (mod->implemented && !cmod->implemented && lys_set_implemented(cmod)) {
+            goto error;
         }
     }
 
-
-    /* consolidate the modules list */
-    for (i = o = ctx->internal_module_count; i < ctx->models.used; i++) {
-        if (ctx->models.list[o]) {
-            /* used cell */
-            o++;
-        } else {
-            /* the current output cell is empty, move here an input cell */
-            ctx->models.list[o] = ctx->models.list[i];
-            ctx->models.list[i] = NULL;
+    for (i = 0; i < ctx->models.used; ++i) {
+        mod = ctx->models.list[i];
+        cmod = (struct lys_module *)ly_ctx_get_module_by(clone, mod->name, 0, offsetof(struct lys_module, name),
+                                                         mod->rev_size ? mod->rev[0].date : NULL, 1, 0);
+        if (!cmod) {
+            LOGINT(ctx);
+            goto error;
         }
-    }
-    /* get the last used cell to get know the number of used */
-    while (!ctx->models.list[o]) {
-        o--;
-    }
-    ctx->models.used = o + 1;
-    ctx->models.module_set_id++;
-
-    /* maintain backlinks (start with internal ietf-yang-library which have leafs as possible targets of leafrefs */
-    ctx_modules_undo_backlinks(ctx, mods);
 
-    /* free the modules */
-    for (u = 0; u < mods->number; u++) {
-        /* remove the applied deviations and augments */
-        lys_sub_module_remove_devs_augs((struct lys_module *)mods->set.g[u]);
-        /* remove the module */
-        lys_free((struct lys_module *)mods->set.g[u], private_destructor, 1, 0);
+        ly_ctx_clone_features(cmod->features, cmod->features_size, mod->features, mod->features_size);
+        for (u = 0; (u < cmod->inc_size) && (u < mod->inc_size); ++u) {
+            ly_ctx_clone_features(cmod->inc[u].submodule->features, cmod->inc[u].submodule->features_size,
+                                  mod->inc[u].submodule->features, mod->inc[u].submodule->features_size);
+        }
     }
-    ly_set_free(mods);
-
-    return EXIT_SUCCESS;
-}
+    lys_features_changed(clone);
+    lys_data_children_clean(clone);
+    ly_ctx_info_clean(clone);
+    lyb_hashes_clean(clone);
 
-API void
-ly_ctx_clean(struct ly_ctx *ctx, void (*private_destructor)(const struct lys_node *node, void *priv))
-{
-    FUN_IN;
-
-    if (!ctx) {
-        return;
+    for (i = 0; i < ctx->models.used; ++i) {
+        mod = ctx->models.list[i];
+        if (mod->disabled) {
+            cmod = (struct lys_module *)ly_ctx_get_module_by(clone, mod->name, 0, offsetof(struct lys_module, name),
+                                                             mod->rev_size ? mod->rev[0].date : NULL, 1, 0);
+            if (!cmod->disabled && lys_set_disabled(cmod)) {
+                goto error;
+            }
+        }
     }
 
-    /* models list */
-    for (; ctx->models.used > ctx->internal_module_count; ctx->models.used--) {
-        /* remove the applied deviations and augments */
-        lys_sub_module_remove_devs_augs(ctx->models.list[ctx->models.used - 1]);
-        /* remove the module */
-        lys_free(ctx->models.list[ctx->models.used - 1], private_destructor, 1, 0);
-        /* clean it for safer future use */
-        ctx->models.list[ctx->models.used - 1] = NULL;
-    }
-    ctx->models.module_set_id++;
+    clone->imp_clb = ctx->imp_clb;
+    clone->imp_clb_data = ctx->imp_clb_data;
+    clone->prefetch_clb = ctx->prefetch_clb;
+    clone->prefetch_clb_data = ctx->prefetch_clb_data;
+    clone->models.flags = ctx->models.flags;
+    return clone;
 
-    /* maintain backlinks (actually done only with ietf-yang-library since its leafs can be target of leafref) */
-    ctx_modules_undo_backlinks(ctx, NULL);
+error:
+    ly_ctx_destroy(clone, NULL);
+    return NULL;
 }
 
 API const struct lys_module *
@@ -1700,18 +2912,27 @@ ly_ctx_get_module_iter(const struct ly_ctx *ctx, uint32_t *idx)
 {
     FUN_IN;
 
+    struct lys_module **list, *module = NULL;
+    uint32_t used;
+
     if (!ctx || !idx) {
         LOGARG;
         return NULL;
     }
 
-    for ( ; *idx < (unsigned)ctx->models.used; (*idx)++) {
-        if (!ctx->models.list[(*idx)]->disabled) {
-            return ctx->models.list[(*idx)++];
+    /* the count is published after the list, see lyp_ctx_add_module() */
+    ly_ctx_modules_enter(ctx);
+    used = LY_ATOMIC_LOAD(ctx->models.used);
+    list = LY_ATOMIC_LOAD(ctx->models.list);
+    for ( ; *idx < used; (*idx)++) {
+        if (list[*idx] && !list[*idx]->disabled) {
+            module = list[(*idx)++];
+            break;
         }
     }
+    ly_ctx_modules_leave(ctx);
 
-    return NULL;
+    return module;
 }
 
 API const struct lys_module *
@@ -1719,18 +2940,27 @@ ly_ctx_get_disabled_module_iter(const struct ly_ctx *ctx, uint32_t *idx)
 {
     FUN_IN;
 
+    struct lys_module **list, *module = NULL;
+    uint32_t used;
+
     if (!ctx || !idx) {
         LOGARG;
         return NULL;
     }
 
-    for ( ; *idx < (unsigned)ctx->models.used; (*idx)++) {
-        if (ctx->models.list[(*idx)]->disabled) {
-            return ctx->models.list[(*idx)++];
+    /* the count is published after the list, see lyp_ctx_add_module() */
+    ly_ctx_modules_enter(ctx);
+    used = LY_ATOMIC_LOAD(ctx->models.used);
+    list = LY_ATOMIC_LOAD(ctx->models.list);
+    for ( ; *idx < used; (*idx)++) {
+        if (list[*idx] && list[*idx]->disabled) {
+            module = list[(*idx)++];
+            break;
         }
     }
+    ly_ctx_modules_leave(ctx);
 
-    return NULL;
+    return module;
 }
 
 static int
@@ -1852,22 +3082,15 @@ ly_ctx_get_module_set_id(const struct ly_ctx *ctx)
     return ctx->models.module_set_id;
 }
 
-API struct lyd_node *
-ly_ctx_info(struct ly_ctx *ctx)
+static struct lyd_node *
+ly_ctx_info_build(struct ly_ctx *ctx)
 {
-    FUN_IN;
-
     int i, bis = 0;
     char id[8];
     char *str;
     const struct lys_module *mod;
     struct lyd_node *root, *root_bis = NULL, *cont = NULL, *set_bis = NULL;
 
-    if (!ctx) {
-        LOGARG;
-        return NULL;
-    }
-
     mod = ly_ctx_get_module(ctx, "ietf-yang-library", NULL, 1);
     if (!mod || !mod->data) {
         LOGERR(ctx, LY_EINVAL, "ietf-yang-library is not implemented.");
@@ -2038,6 +3261,208 @@ error:
     return NULL;
 }
 
+API struct lyd_node *
+ly_ctx_info(struct ly_ctx *ctx)
+{
+    FUN_IN;
+
+    struct lyd_node *root = NULL;
+
+    if (!ctx) {
+        LOGARG;
+        return NULL;
+    }
+
+    pthread_mutex_lock(&ctx->info_lock);
+
+    if (ctx->info && (ctx->info_set_id != ctx->models.module_set_id)) {
+        /* modules changed, build the data again */
+        lyd_free_withsiblings(ctx->info);
+        ctx->info = NULL;
+    }
+    if (!ctx->info) {
+        ctx->info = ly_ctx_info_build(ctx);
+        ctx->info_set_id = ctx->models.module_set_id;
+    }
+
+    /* the data are already validated, so are their copies */
+    if (ctx->info) {
+        root = lyd_dup_withsiblings(ctx->info, LYD_DUP_OPT_RECURSIVE);
+    }
+
+    pthread_mutex_unlock(&ctx->info_lock);
+    return root;
+}
+
+void
+ly_ctx_info_clean(struct ly_ctx *ctx)
+{
+    pthread_mutex_lock(&ctx->info_lock);
+
+    lyd_free_withsiblings(ctx->info);
+    ctx->info = NULL;
+
+    pthread_mutex_unlock(&ctx->info_lock);
+}
+
+static void
+ly_ctx_counters_add(struct ly_ctx_counters *counters, const struct ly_ctx_counters *add)
+{
+    int i;
+
+    counters->nodes_parsed += add->nodes_parsed;
+    counters->nodes_printed += add->nodes_printed;
+    counters->xpath_evals += add->xpath_evals;
+    counters->xpath_set_nodes += add->xpath_set_nodes;
+    counters->xpath_node_visits += add->xpath_node_visits;
+    counters->dict_inserts += add->dict_inserts;
+    counters->dict_hits += add->dict_hits;
+    counters->ht_resizes += add->ht_resizes;
+    counters->when_evals += add->when_evals;
+    counters->must_evals += add->must_evals;
+    counters->leafref_resolutions += add->leafref_resolutions;
+    for (i = 0; i <= LY_TRACE_PRINT; ++i) {
+        counters->phase_ns[i] += add->phase_ns[i];
+    }
+}
+
+void
+ly_ctx_counters_flush(const struct ly_ctx *ctx)
+{
+    struct ly_ctx *c = (struct ly_ctx *)ctx;
+    struct ly_ctx_cnt_block *block;
+
+    block = pthread_getspecific(ctx->cnt_key);
+    if (!block) {
+        /* the first operation of the thread with this context */
+        block = calloc(1, sizeof *block);
+        LY_CHECK_ERR_RETURN(!block, LOGMEM(ctx), );
+        if (pthread_setspecific(ctx->cnt_key, block)) {
+            free(block);
+            return;
+        }
+
+        pthread_mutex_lock(&c->cnt_lock);
+        block->next = c->cnt_blocks;
+        c->cnt_blocks = block;
+        pthread_mutex_unlock(&c->cnt_lock);
+    }
+
+    /* only this thread writes into its block, the readers may see a partial update */
+    ly_ctx_counters_add(&block->cnt, &ly_cnt);
+}
+
+API int
+ly_ctx_get_counters(const struct ly_ctx *ctx, struct ly_ctx_counters *counters)
+{
+    FUN_IN;
+
+    struct ly_ctx *c = (struct ly_ctx *)ctx;
+    struct ly_ctx_cnt_block *block;
+
+    if (!ctx || !counters) {
+        LOGARG;
+        return EXIT_FAILURE;
+    }
+
+    memset(counters, 0, sizeof *counters);
+
+    pthread_mutex_lock(&c->cnt_lock);
+    for (block = ctx->cnt_blocks; block; block = block->next) {
+        ly_ctx_counters_add(counters, &block->cnt);
+    }
+    pthread_mutex_unlock(&c->cnt_lock);
+
+    return EXIT_SUCCESS;
+}
+
+API int
+ly_ctx_mem_usage(struct ly_ctx *ctx, struct ly_ctx_mem_stats *stats)
+{
+    FUN_IN;
+
+    int i;
+#ifdef LY_ENABLED_DATA_POOL
+    struct lyd_pool_chunk *chunk;
+    union lyd_pool_slot *slot;
+#endif
+
+    if (!ctx || !stats) {
+        LOGARG;
+        return EXIT_FAILURE;
+    }
+
+    memset(stats, 0, sizeof *stats);
+
+    /* schemas */
+    for (i = 0; i < ctx->models.used; ++i) {
+        ++stats->modules;
+        lys_mem_usage(ctx->models.list[i], &stats->schema);
+    }
+    stats->schema.module_mem += ctx->models.size * sizeof *ctx->models.list;
+
+    /* dictionary */
+    stats->dict_mem = lydict_mem_size(ctx, &stats->dict_strings);
+
+    /* indices */
+    stats->index_mem = lyht_mem_size(ctx->models.name_ht) + lyht_mem_size(ctx->models.ns_ht)
+            + lyht_mem_size(ctx->models.imp_ht);
+
+    pthread_rwlock_rdlock(&ctx->xpath_cache_lock);
+    stats->index_mem += lyht_mem_size(ctx->xpath_cache);
+    pthread_rwlock_unlock(&ctx->xpath_cache_lock);
+    pthread_mutex_lock(&ctx->xpath_deps_lock);
+    stats->index_mem += lyht_mem_size(ctx->xpath_deps);
+    pthread_mutex_unlock(&ctx->xpath_deps_lock);
+    pthread_rwlock_rdlock(&ctx->data_children_lock);
+    stats->index_mem += lyht_mem_size(ctx->data_children) + lyht_mem_size(ctx->mand_subtrees);
+    pthread_rwlock_unlock(&ctx->data_children_lock);
+    pthread_rwlock_rdlock(&ctx->lyb_hashes_lock);
+    stats->index_mem += lyht_mem_size(ctx->lyb_hashes);
+    pthread_rwlock_unlock(&ctx->lyb_hashes_lock);
+    pthread_mutex_lock(&ctx->lyb_sibling_hts_lock);
+    stats->index_mem += lyht_mem_size(ctx->lyb_sibling_hts);
+    pthread_mutex_unlock(&ctx->lyb_sibling_hts_lock);
+    pthread_rwlock_rdlock(&ctx->idents_lock);
+    stats->index_mem += lyht_mem_size(ctx->idents);
+    pthread_rwlock_unlock(&ctx->idents_lock);
+    pthread_rwlock_rdlock(&ctx->instids_lock);
+    stats->index_mem += lyht_mem_size(ctx->instids);
+    pthread_rwlock_unlock(&ctx->instids_lock);
+    pthread_mutex_lock(&ctx->lref_rev_lock);
+    stats->index_mem += lyht_mem_size(ctx->lref_rev);
+    pthread_mutex_unlock(&ctx->lref_rev_lock);
+    pthread_rwlock_rdlock(&ctx->exts_lock);
+    stats->index_mem += lyht_mem_size(ctx->exts);
+    pthread_rwlock_unlock(&ctx->exts_lock);
+    pthread_mutex_lock(&ctx->devs_lock);
+    stats->index_mem += lyht_mem_size(ctx->devs);
+    pthread_mutex_unlock(&ctx->devs_lock);
+    pthread_mutex_lock(&ctx->print_cache_lock);
+    stats->index_mem += lyht_mem_size(ctx->print_cache);
+    pthread_mutex_unlock(&ctx->print_cache_lock);
+#ifdef LY_ENABLED_CACHE
+    pthread_mutex_lock(&ctx->pattern_cache_lock);
+    stats->index_mem += lyht_mem_size(ctx->pattern_cache);
+    pthread_mutex_unlock(&ctx->pattern_cache_lock);
+#endif
+
+#ifdef LY_ENABLED_DATA_POOL
+    /* data pool, the slots stashed by the threads are not free */
+    pthread_mutex_lock(&ctx->data_pool.lock);
+    for (chunk = ctx->data_pool.chunks; chunk; chunk = chunk->next) {
+        stats->data_pool_mem += sizeof *chunk + chunk->size * sizeof *chunk->slots;
+    }
+    stats->data_pool_free = ctx->data_pool.unused * sizeof(union lyd_pool_slot);
+    for (slot = ctx->data_pool.free; slot; slot = slot->next) {
+        stats->data_pool_free += sizeof *slot;
+    }
+    pthread_mutex_unlock(&ctx->data_pool.lock);
+#endif
+
+    return EXIT_SUCCESS;
+}
+
 API const struct lys_node *
 ly_ctx_get_node(const struct ly_ctx *ctx, const struct lys_node *start, const char *nodeid, int output)
 {
@@ -2076,3 +3501,141 @@ ly_ctx_find_path(struct ly_ctx *ctx, const char *path)
     resolve_schema_nodeid(path, NULL, ctx->models.list[0], &resultset, 1, 1);
     return resultset;
 }
+
+static void
+ly_ctx_precompute_iffeatures(struct lys_iffeature *iffeature, uint8_t iffeature_size)
+{
+    uint8_t i;
+
+    /* only caches the values */
+    for (i = 0; i < iffeature_size; ++i) {
+        resolve_iffeature(&iffeature[i]);
+    }
+}
+
+static void
+ly_ctx_precompute_module_iffeatures(struct lys_module *mod)
+{
+    uint32_t i;
+
+    for (i = 0; i < mod->features_size; ++i) {
+        ly_ctx_precompute_iffeatures(mod->features[i].iffeature, mod->features[i].iffeature_size);
+    }
+    for (i = 0; i < mod->ident_size; ++i) {
+        ly_ctx_precompute_iffeatures(mod->ident[i].iffeature, mod->ident[i].iffeature_size);
+    }
+}
+
+static int
+ly_ctx_precompute_augments(struct lys_node_augment *augment, uint8_t augment_size)
+{
+    uint8_t i;
+
+    for (i = 0; i < augment_size; ++i) {
+        ly_ctx_precompute_iffeatures(augment[i].iffeature, augment[i].iffeature_size);
+        /* the augment children are connected into its target */
+        if (lyxp_node_precompile((struct lys_node *)&augment[i])) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int
+ly_ctx_precompute_siblings(struct ly_ctx *ctx, struct lys_node *siblings, struct lys_node **data_node)
+{
+    struct lys_node *node;
+#ifdef LY_ENABLED_CACHE
+    uint8_t i;
+#endif
+
+    LY_TREE_FOR(siblings, node) {
+        if (node->nodetype == LYS_GROUPING) {
+            /* only its instantiated copies are ever used */
+            continue;
+        }
+
+        ly_ctx_precompute_iffeatures(node->iffeature, node->iffeature_size);
+        if (lyxp_node_precompile(node)) {
+            return -1;
+        }
+        if ((node->nodetype == LYS_USES) && ly_ctx_precompute_augments(((struct lys_node_uses *)node)->augment,
+                                                                       ((struct lys_node_uses *)node)->augment_size)) {
+            return -1;
+        }
+
+        if (node->nodetype & (LYS_CONTAINER | LYS_LEAF | LYS_LEAFLIST | LYS_LIST | LYS_ANYDATA | LYS_RPC | LYS_ACTION
+                              | LYS_NOTIF)) {
+#ifdef LY_ENABLED_CACHE
+            for (i = 0; i < LYS_NODE_HASH_COUNT; ++i) {
+                lyb_hash(node, i);
+            }
+#endif
+            if (!*data_node) {
+                *data_node = node;
+            }
+        }
+
+        if (node->nodetype & (LYS_LEAF | LYS_LEAFLIST)) {
+            /* children of terminal nodes are the leafref backlinks, not schema nodes */
+            if (lyp_type_precompute(ctx, &((struct lys_node_leaf *)node)->type)) {
+                return -1;
+            }
+            continue;
+        } else if (node->nodetype & LYS_ANYDATA) {
+            continue;
+        }
+
+        if (ly_ctx_precompute_siblings(ctx, node->child, data_node)) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+API int
+ly_ctx_precompute(struct ly_ctx *ctx)
+{
+    FUN_IN;
+
+    struct lys_module *mod;
+    struct lys_node *data_node = NULL;
+    const struct ly_set *dependents;
+    int i;
+    uint8_t j;
+
+    if (!ctx) {
+        LOGARG;
+        return EXIT_FAILURE;
+    }
+
+    for (i = 0; i < ctx->models.used; ++i) {
+        mod = ctx->models.list[i];
+        if (ly_ctx_precompute_siblings(ctx, mod->data, &data_node)
+                || ly_ctx_precompute_augments(mod->augment, mod->augment_size)) {
+            return EXIT_FAILURE;
+        }
+        ly_ctx_precompute_module_iffeatures(mod);
+        for (j = 0; j < mod->inc_size; ++j) {
+            if (!mod->inc[j].submodule) {
+                continue;
+            }
+            if (ly_ctx_precompute_augments(mod->inc[j].submodule->augment, mod->inc[j].submodule->augment_size)) {
+                return EXIT_FAILURE;
+            }
+            ly_ctx_precompute_module_iffeatures((struct lys_module *)mod->inc[j].submodule);
+        }
+    }
+
+    /* the dependency, identities and extension instances indexes are built for all the modules at once */
+    if (data_node && lyxp_deps_get(data_node, &dependents)) {
+        return EXIT_FAILURE;
+    }
+    if (resolve_idents_index(ctx) || lyp_ext_instances_index(ctx)) {
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
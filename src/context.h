@@ -16,17 +16,30 @@
 #define LY_CONTEXT_H_
 
 #include <pthread.h>
+#include <time.h>
 
 #include "libyang.h"
 #include "common.h"
 #include "hash_table.h"
 #include "tree_schema.h"
 
+/* replaced modules list or module index, freed once no reader can access it, see ly_ctx_modules_reclaim() */
+struct ly_modules_retired {
+    void *ptr;
+    int ht;                         /* ptr is a hash table, a modules list otherwise */
+    struct ly_modules_retired *next;
+};
+
 struct ly_modules_list {
     char **search_paths;
     int size;
     int used;
     struct lys_module **list;
+    struct hash_table *name_ht; /* modules of the list by their names, see ly_ctx_get_module_by() */
+    struct hash_table *ns_ht;   /* modules of the list by their namespaces */
+    struct hash_table *imp_ht;  /* imports of the modules of the list by the imported module, see ly_ctx_module_index_add() */
+    struct ly_modules_retired *retired; /* replaced lists and indices the lock-free readers can still access */
+    uint32_t readers;           /* number of the lock-free readers currently accessing the list or the indices */
     /* all (sub)modules that are currently being parsed */
     struct lys_module **parsing_sub_modules;
     /* all already parsed submodules of a module, which is before all its submodules (to mark submodule imports) */
@@ -37,18 +50,150 @@ struct ly_modules_list {
     int flags; /* see @ref contextoptions. */
 };
 
+/* size of the compiled re-match() pattern cache */
+#define LY_REGEX_CACHE_SIZE 16
+
+struct ly_regex_cache_item {
+    char *pattern;      /* XPath regular expression, NULL if the item is free */
+    void *precomp;      /* pcre * */
+    void *extra;        /* pcre_extra *, can be NULL */
+    uint32_t used;      /* stamp of the last use (LRU) */
+};
+
+/* entry of a directory searched for (sub)modules */
+struct ly_search_entry {
+    char *name;         /* file name */
+    int dir;            /* directory (1) or regular file (0), other files are not listed */
+};
+
+/* listing of a directory searched for (sub)modules, see lys_search_localfile_ctx() */
+struct ly_search_dir {
+    char *path;
+    struct timespec mtime;  /* modification time of the directory when it was listed */
+    int racy;               /* listed too soon after its modification to notice the next one, list it again */
+    uint32_t count;
+    uint32_t dir_count;     /* the directories come first in entries, then the files, both sorted by name */
+    struct ly_search_entry *entries;
+};
+
+/* counters of the data operations of a thread added to its context, see ly_ctx_counters_flush() */
+struct ly_ctx_cnt_block {
+    struct ly_ctx_counters cnt;
+    struct ly_ctx_cnt_block *next;
+};
+
+#ifdef LY_ENABLED_DATA_POOL
+
+/* number of slots in the first data pool chunk, every next chunk is twice as large */
+#define LYD_POOL_CHUNK_MIN 64
+
+/* maximum number of slots in a data pool chunk */
+#define LYD_POOL_CHUNK_MAX 8192
+
+/* number of slots taken from a data pool into a thread stash at once */
+#define LYD_POOL_BATCH 64
+
+/* data pool slot large enough for any data node, attribute or XML element and attribute, linked into a list when free */
+union lyd_pool_slot {
+    union lyd_pool_slot *next;
+    struct lyd_node node;
+    struct lyd_node_leaf_list leaf;
+    struct lyd_node_anydata any;
+    struct lyd_attr attr;
+    struct lyxml_elem xml_elem;
+    struct lyxml_ns xml_ns;
+    struct lyxml_attr xml_attr;
+};
+
+struct lyd_pool_chunk {
+    struct lyd_pool_chunk *next;
+    uint32_t size;                  /* number of slots */
+    union lyd_pool_slot slots[];
+};
+
+struct lyd_pool {
+    struct lyd_pool_chunk *chunks;  /* all the chunks, the newest first */
+    uint32_t unused;                /* number of never used slots at the end of the newest chunk */
+    union lyd_pool_slot *free;      /* freed slots */
+    struct ly_allocator allocator;  /* allocator of the chunks, see ly_ctx_set_allocator() */
+    pthread_mutex_t lock;
+};
+
+#endif
+
 struct ly_ctx {
     struct dict_table dict;
     struct ly_modules_list models;
     ly_module_imp_clb imp_clb;
     void *imp_clb_data;
+    ly_module_prefetch_clb prefetch_clb;
+    void *prefetch_clb_data;
     ly_module_data_clb data_clb;
     void *data_clb_data;
+    ly_ext_deps_clb ext_deps_clb;  /* supplier of the external dependencies of operations, see ly_ctx_set_ext_deps_clb() */
+    void *ext_deps_clb_data;
+    ly_task_submit_clb exec_clb;   /* executor of the parallel data operations, see ly_parallel_run() */
+    void *exec_clb_data;
+    uint32_t exec_threads;
 #ifdef LY_ENABLED_LYD_PRIV
     void *(*priv_dup_clb)(const void *priv);
 #endif
     pthread_key_t errlist_key;
+    pthread_key_t cnt_key;         /* counters block of the thread, see ly_ctx_counters_flush() */
+    struct ly_ctx_cnt_block *cnt_blocks; /* counters blocks of all the threads */
+    pthread_mutex_t cnt_lock;
     uint8_t internal_module_count;
+    struct hash_table *xpath_cache; /* compiled XPath expressions of the schemas, see lyxp_expr_cache_get() */
+    pthread_rwlock_t xpath_cache_lock;
+    struct ly_regex_cache_item regex_cache[LY_REGEX_CACHE_SIZE]; /* compiled re-match() patterns, see lyxp_regex_cache_clean() */
+    uint32_t regex_cache_used;
+    pthread_mutex_t regex_cache_lock;
+    struct hash_table *xpath_deps; /* schema nodes with when/must depending on other schema nodes, see lyxp_deps_get() */
+    uint16_t xpath_deps_set_id;    /* module set ID the dependency index was built for */
+    pthread_mutex_t xpath_deps_lock;
+    struct hash_table *data_children; /* data children of schema nodes by names, see lys_find_data_child() */
+    uint16_t data_children_set_id;    /* module set ID the children index was built for */
+    struct hash_table *mand_subtrees; /* whether schema subtrees have mandatory nodes, see lys_has_mandatory_when(),
+                                         with the same set ID and lock as the children index */
+    pthread_rwlock_t data_children_lock;
+    struct hash_table *lyb_hashes; /* schema nodes by their LYB hashes, see lyb_find_schema_hash() */
+    uint16_t lyb_hashes_set_id;    /* module set ID the hash index was built for */
+    pthread_rwlock_t lyb_hashes_lock;
+    struct hash_table *lyb_sibling_hts; /* LYB printer hash tables of schema siblings, see lyb_sibling_ht_get() */
+    uint16_t lyb_sibling_hts_set_id;    /* module set ID the hash tables were built for */
+    pthread_mutex_t lyb_sibling_hts_lock;
+    struct hash_table *idents;     /* identities by their module, name and base identities, see resolve_ident_find() */
+    uint16_t idents_set_id;        /* module set ID the identities index was built for */
+    pthread_rwlock_t idents_lock;
+    struct hash_table *instids;    /* compiled instance-identifier values by their JSON form, see resolve_instid() */
+    uint16_t instids_set_id;       /* module set ID the values were compiled for */
+    pthread_rwlock_t instids_lock;
+    struct hash_table *lref_rev;   /* resolved leafref instances and their targets, see resolve_lref_rev_take(),
+                                      only with #LY_CTX_LEAFREF_INDEX */
+    pthread_mutex_t lref_rev_lock;
+    struct hash_table *exts;       /* extension instances of the modules by their arguments, see lyp_ext_instance_find() */
+    uint16_t exts_set_id;          /* module set ID the extension instances index was built for */
+    pthread_rwlock_t exts_lock;
+    struct hash_table *devs;       /* deviations by the modules they may target, see lys_deviations_get() */
+    uint16_t devs_set_id;          /* module set ID the deviations index was built for */
+    pthread_mutex_t devs_lock;
+    struct hash_table *print_cache; /* printed modules by their formats and options, see lys_print_mem() */
+    uint16_t print_cache_set_id;   /* module set ID the modules were printed for */
+    pthread_mutex_t print_cache_lock;
+    struct lyd_node *info;         /* ietf-yang-library data duplicated by ly_ctx_info() */
+    uint16_t info_set_id;          /* module set ID the data were built for */
+    pthread_mutex_t info_lock;
+    pthread_mutex_t type_chk_lock; /* compiling length/range restrictions and patterns of types, see validate_len_ran_chk() */
+#ifdef LY_ENABLED_CACHE
+    uint32_t feature_set_id;       /* changed with every feature state change, see resolve_iffeature() */
+    struct hash_table *pattern_cache; /* compiled patterns shared by all the types, see lyp_pattern_cache_get() */
+    pthread_mutex_t pattern_cache_lock;
+#endif
+    struct ly_search_dir *search_dirs; /* listings of the directories searched for (sub)modules */
+    uint32_t search_dir_count;
+#ifdef LY_ENABLED_DATA_POOL
+    struct lyd_pool data_pool;     /* memory of the data nodes, attributes and XML trees, see lyd_pool_alloc() */
+#endif
 };
 
 #endif /* LY_CONTEXT_H_ */
@@ -57,10 +57,11 @@ const char *lydict_insert(struct ly_ctx *ctx, const char *value, size_t len);
  *
  * @param[in] ctx libyang context handler
  * @param[in] value NULL-terminated string to be stored in the dictionary. If
- * the string is not present in dictionary, the pointer is directly used by the
- * dictionary. Otherwise, the reference counter is incremented and the value is
- * freed. So, after calling the function, caller is supposed to not use the
- * value address anymore.
+ * the string is not present in dictionary, the memory is reallocated by one more
+ * byte (for the flags following every dictionary string) and used by the
+ * dictionary, so it can be moved. Otherwise, the reference counter is incremented
+ * and the value is freed. So, after calling the function, caller is supposed to
+ * not use the value address anymore, only the returned pointer.
  * @return pointer to the string stored in the dictionary
  */
 const char *lydict_insert_zc(struct ly_ctx *ctx, char *value);
@@ -76,6 +77,32 @@ const char *lydict_insert_zc(struct ly_ctx *ctx, char *value);
  */
 void lydict_remove(struct ly_ctx *ctx, const char *value);
 
+/**
+ * @brief Statistics of a hash table or an aggregate of several hash tables. The lookup
+ * and resize counters are collected only if libyang is compiled with ENABLE_HT_STATS,
+ * otherwise they are always 0, and they are only approximate if the tables are used
+ * by several threads at once.
+ */
+struct ly_ht_stats {
+    uint32_t used;         /**< number of stored values, divided by size it is the load factor */
+    uint32_t size;         /**< number of allocated records */
+    uint32_t deleted;      /**< number of removed records still occupying their records (tombstones) */
+    uint64_t lookups;      /**< number of lookups of a value (when finding, inserting, and removing it) */
+    uint64_t probes;       /**< total number of record groups probed by all the lookups, divided by lookups
+                                it is the average probe length */
+    uint32_t max_probe;    /**< maximal number of record groups probed by a single lookup */
+    uint32_t resizes;      /**< number of enlargements, shrinks, and compactions (rehashing) */
+};
+
+/**
+ * @brief Get the statistics of the context dictionary, aggregated over all its hash tables.
+ *
+ * @param[in] ctx libyang context handler
+ * @param[out] stats Dictionary statistics.
+ * @return 0 on success, non-zero on error.
+ */
+int lydict_stats(struct ly_ctx *ctx, struct ly_ht_stats *stats);
+
 /**@} dict */
 
 #ifdef __cplusplus
@@ -35,7 +35,7 @@ extern "C" {
  * @brief Macro to store version of extension plugins API in the plugins.
  * It is matched when the plugin is being loaded by libyang.
  */
-#ifdef STATIC
+#if defined(STATIC) || defined(LY_BUILTIN_PLUGINS)
 #define LYEXT_VERSION_CHECK
 #else
 #define LYEXT_VERSION_CHECK int lyext_api_version = LYEXT_API_VERSION;
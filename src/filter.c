@@ -0,0 +1,834 @@
+/**
+ * @file filter.c
+ * @brief Evaluation of many subscription filters (XPath or subtree) on notifications
+ *
+ * Copyright (c) 2019 CESNET, z.s.p.o.
+ *
+ * This source code is licensed under BSD 3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://opensource.org/licenses/BSD-3-Clause
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "hash_table.h"
+#include "libyang.h"
+#include "tree_internal.h"
+#include "xpath.h"
+
+/**
+ * @brief Distinct filter expression, shared by all the subscribers with the same filter.
+ */
+struct filter_expr {
+    char *xpath;                    /**< JSON XPath of the filter */
+    const struct lys_module *module; /**< module of the unprefixed nodes in xpath */
+    struct lyd_path *path;          /**< prepared xpath */
+    uint32_t *ids;                  /**< subscribers */
+    uint32_t id_count;
+};
+
+/**
+ * @brief Expressions that can only match a tree with an instance of a top-level schema node.
+ */
+struct filter_bucket {
+    const struct lys_node *schema;
+    uint32_t *exprs;                /**< indexes of the expressions */
+    uint32_t count;
+};
+
+/* hash table records, the indexes into the arrays */
+struct filter_expr_rec {
+    const char *xpath;
+    const struct lys_module *module;
+    uint32_t idx;
+};
+
+struct filter_bucket_rec {
+    const struct lys_node *schema;
+    uint32_t idx;
+};
+
+struct lyd_filter {
+    struct ly_ctx *ctx;
+    struct filter_expr *exprs;
+    uint32_t expr_count;
+    struct hash_table *expr_ht;     /**< struct filter_expr_rec records */
+    struct filter_bucket *buckets;
+    uint32_t bucket_count;
+    struct hash_table *bucket_ht;   /**< struct filter_bucket_rec records */
+    struct filter_bucket generic;   /**< expressions that must be evaluated on every tree */
+};
+
+static int
+filter_expr_equal(void *val1_p, void *val2_p, int UNUSED(mod), void *UNUSED(cb_data))
+{
+    struct filter_expr_rec *rec1 = val1_p, *rec2 = val2_p;
+
+    return (rec1->module == rec2->module) && !strcmp(rec1->xpath, rec2->xpath);
+}
+
+static int
+filter_bucket_equal(void *val1_p, void *val2_p, int UNUSED(mod), void *UNUSED(cb_data))
+{
+    return ((struct filter_bucket_rec *)val1_p)->schema == ((struct filter_bucket_rec *)val2_p)->schema;
+}
+
+static uint32_t
+filter_ptr_hash(const void *ptr)
+{
+    return dict_hash_multi(dict_hash_multi(0, (const char *)&ptr, sizeof ptr), NULL, 0);
+}
+
+API struct lyd_filter *
+lyd_filter_new(struct ly_ctx *ctx)
+{
+    FUN_IN;
+
+    struct lyd_filter *filter;
+
+    if (!ctx) {
+        LOGARG;
+        return NULL;
+    }
+
+    filter = calloc(1, sizeof *filter);
+    LY_CHECK_ERR_RETURN(!filter, LOGMEM(ctx), NULL);
+    filter->ctx = ctx;
+    filter->expr_ht = lyht_new(16, sizeof(struct filter_expr_rec), filter_expr_equal, NULL, 1);
+    filter->bucket_ht = lyht_new(8, sizeof(struct filter_bucket_rec), filter_bucket_equal, NULL, 1);
+    if (!filter->expr_ht || !filter->bucket_ht) {
+        LOGMEM(ctx);
+        lyd_filter_free(filter);
+        return NULL;
+    }
+
+    return filter;
+}
+
+API void
+lyd_filter_free(struct lyd_filter *filter)
+{
+    FUN_IN;
+
+    uint32_t i;
+
+    if (!filter) {
+        return;
+    }
+
+    for (i = 0; i < filter->expr_count; ++i) {
+        free(filter->exprs[i].xpath);
+        lyd_path_free(filter->exprs[i].path);
+        free(filter->exprs[i].ids);
+    }
+    free(filter->exprs);
+    for (i = 0; i < filter->bucket_count; ++i) {
+        free(filter->buckets[i].exprs);
+    }
+    free(filter->buckets);
+    free(filter->generic.exprs);
+    lyht_free(filter->expr_ht);
+    lyht_free(filter->bucket_ht);
+    free(filter);
+}
+
+static int
+filter_bucket_add(struct lyd_filter *filter, struct filter_bucket *bucket, uint32_t expr)
+{
+    uint32_t *exprs;
+
+    if (bucket->count && (bucket->exprs[bucket->count - 1] == expr)) {
+        /* several branches of the expression with the same top-level node */
+        return EXIT_SUCCESS;
+    }
+
+    exprs = realloc(bucket->exprs, (bucket->count + 1) * sizeof *bucket->exprs);
+    LY_CHECK_ERR_RETURN(!exprs, LOGMEM(filter->ctx), EXIT_FAILURE);
+    bucket->exprs = exprs;
+    bucket->exprs[bucket->count++] = expr;
+    return EXIT_SUCCESS;
+}
+
+static struct filter_bucket *
+filter_bucket_get(struct lyd_filter *filter, const struct lys_node *schema)
+{
+    struct filter_bucket_rec rec, *match;
+    struct filter_bucket *buckets;
+    uint32_t hash;
+
+    rec.schema = schema;
+    hash = filter_ptr_hash(schema);
+    if (!lyht_find(filter->bucket_ht, &rec, hash, (void **)&match)) {
+        return &filter->buckets[match->idx];
+    }
+
+    buckets = realloc(filter->buckets, (filter->bucket_count + 1) * sizeof *filter->buckets);
+    LY_CHECK_ERR_RETURN(!buckets, LOGMEM(filter->ctx), NULL);
+    filter->buckets = buckets;
+    memset(&filter->buckets[filter->bucket_count], 0, sizeof *filter->buckets);
+    filter->buckets[filter->bucket_count].schema = schema;
+
+    rec.idx = filter->bucket_count;
+    if (lyht_insert(filter->bucket_ht, &rec, hash, NULL)) {
+        LOGMEM(filter->ctx);
+        return NULL;
+    }
+    return &filter->buckets[filter->bucket_count++];
+}
+
+/**
+ * @brief Get the top-level schema nodes the expression can only match a tree with.
+ *
+ * The expression must be a location path starting with "/mod:name" or a union ('|' or "or") of them,
+ * the predicates are not inspected.
+ *
+ * @return Number of the nodes in @p nodes, 0 if the expression must be evaluated always, -1 on error.
+ */
+static int
+filter_top_nodes(struct lyd_filter *filter, const struct lys_module *module, const char *xpath, struct ly_set *nodes)
+{
+    struct lyxp_expr *exp;
+    const struct lys_node *snode;
+    const char *name, *colon;
+    char *path;
+    uint16_t i, branch_start = 0;
+    int depth = 0, ret = 0, len;
+
+    exp = lyxp_parse_expr(filter->ctx, xpath);
+    if (!exp) {
+        return -1;
+    }
+
+    for (i = 0; i <= exp->used; ++i) {
+        if (i < exp->used) {
+            switch (exp->tokens[i]) {
+            case LYXP_TOKEN_BRACK1:
+                ++depth;
+                continue;
+            case LYXP_TOKEN_BRACK2:
+                --depth;
+                continue;
+            default:
+                break;
+            }
+            if (depth) {
+                /* predicate */
+                continue;
+            }
+
+            if ((exp->tokens[i] == LYXP_TOKEN_OPERATOR_UNI) || ((exp->tokens[i] == LYXP_TOKEN_OPERATOR_LOG)
+                    && (exp->tok_len[i] == 2) && !strncmp(&exp->expr[exp->expr_pos[i]], "or", 2))) {
+                /* end of a branch */
+            } else if ((exp->tokens[i] == LYXP_TOKEN_OPERATOR_PATH) || (exp->tokens[i] == LYXP_TOKEN_NAMETEST)) {
+                continue;
+            } else {
+                /* not a location path */
+                goto generic;
+            }
+        }
+
+        /* branch [branch_start, i) must begin with "/mod:name" */
+        if ((i - branch_start < 2) || (exp->tokens[branch_start] != LYXP_TOKEN_OPERATOR_PATH)
+                || (exp->tok_len[branch_start] != 1) || (exp->tokens[branch_start + 1] != LYXP_TOKEN_NAMETEST)) {
+            goto generic;
+        }
+        name = &exp->expr[exp->expr_pos[branch_start + 1]];
+        len = exp->tok_len[branch_start + 1];
+        if (memchr(name, '*', len)) {
+            goto generic;
+        }
+        colon = memchr(name, ':', len);
+        if (colon) {
+            len = asprintf(&path, "/%.*s", len, name);
+        } else {
+            len = asprintf(&path, "/%s:%.*s", module->name, len, name);
+        }
+        LY_CHECK_ERR_GOTO(len == -1, LOGMEM(filter->ctx); ret = -1, cleanup);
+        snode = ly_ctx_get_node(filter->ctx, NULL, path, 0);
+        free(path);
+        if (!snode) {
+            goto generic;
+        }
+        if (ly_set_add(nodes, (void *)snode, 0) == -1) {
+            ret = -1;
+            goto cleanup;
+        }
+
+        branch_start = i + 1;
+    }
+
+    ret = nodes->number;
+    goto cleanup;
+
+generic:
+    ly_set_clean(nodes);
+    ret = 0;
+
+cleanup:
+    lyxp_expr_free(exp);
+    return ret;
+}
+
+API int
+lyd_filter_add(struct lyd_filter *filter, const struct lys_module *module, const char *xpath, uint32_t id)
+{
+    FUN_IN;
+
+    struct filter_expr_rec rec, *match;
+    struct filter_expr *expr, *exprs;
+    struct filter_bucket *bucket;
+    struct ly_set *nodes = NULL;
+    uint32_t hash, *ids, i;
+    int r;
+
+    if (!filter || !module || !xpath || (module->ctx != filter->ctx)) {
+        LOGARG;
+        return EXIT_FAILURE;
+    }
+
+    rec.xpath = xpath;
+    rec.module = module;
+    hash = dict_hash_multi(dict_hash_multi(0, (const char *)&module, sizeof module), xpath, strlen(xpath));
+    hash = dict_hash_multi(hash, NULL, 0);
+    if (!lyht_find(filter->expr_ht, &rec, hash, (void **)&match)) {
+        /* the same filter of another subscriber */
+        expr = &filter->exprs[match->idx];
+        ids = realloc(expr->ids, (expr->id_count + 1) * sizeof *expr->ids);
+        LY_CHECK_ERR_RETURN(!ids, LOGMEM(filter->ctx), EXIT_FAILURE);
+        expr->ids = ids;
+        expr->ids[expr->id_count++] = id;
+        return EXIT_SUCCESS;
+    }
+
+    exprs = realloc(filter->exprs, (filter->expr_count + 1) * sizeof *filter->exprs);
+    LY_CHECK_ERR_RETURN(!exprs, LOGMEM(filter->ctx), EXIT_FAILURE);
+    filter->exprs = exprs;
+    expr = &filter->exprs[filter->expr_count];
+    memset(expr, 0, sizeof *expr);
+
+    expr->module = module;
+    expr->xpath = strdup(xpath);
+    expr->ids = malloc(sizeof *expr->ids);
+    LY_CHECK_ERR_GOTO(!expr->xpath || !expr->ids, LOGMEM(filter->ctx), error);
+    expr->ids[0] = id;
+    expr->id_count = 1;
+    expr->path = lyd_path_prepare(module, xpath);
+    if (!expr->path) {
+        LOGERR(filter->ctx, LY_EINVAL, "Invalid filter \"%s\".", xpath);
+        goto error;
+    }
+
+    /* dispatch by the top-level nodes */
+    nodes = ly_set_new();
+    LY_CHECK_ERR_GOTO(!nodes, LOGMEM(filter->ctx), error);
+    r = filter_top_nodes(filter, module, xpath, nodes);
+    if (r == -1) {
+        goto error;
+    } else if (!r) {
+        if (filter_bucket_add(filter, &filter->generic, filter->expr_count)) {
+            goto error;
+        }
+    } else {
+        for (i = 0; i < nodes->number; ++i) {
+            bucket = filter_bucket_get(filter, nodes->set.s[i]);
+            if (!bucket || filter_bucket_add(filter, bucket, filter->expr_count)) {
+                goto error;
+            }
+        }
+    }
+    ly_set_free(nodes);
+    nodes = NULL;
+
+    rec.xpath = expr->xpath;
+    rec.idx = filter->expr_count;
+    if (lyht_insert(filter->expr_ht, &rec, hash, NULL)) {
+        LOGMEM(filter->ctx);
+        goto error;
+    }
+    ++filter->expr_count;
+
+    return EXIT_SUCCESS;
+
+error:
+    /* the buckets may reference it but it is never evaluated, it is reused by the next added expression */
+    if (filter->generic.count && (filter->generic.exprs[filter->generic.count - 1] == filter->expr_count)) {
+        --filter->generic.count;
+    }
+    for (i = 0; i < filter->bucket_count; ++i) {
+        bucket = &filter->buckets[i];
+        if (bucket->count && (bucket->exprs[bucket->count - 1] == filter->expr_count)) {
+            --bucket->count;
+        }
+    }
+    ly_set_free(nodes);
+    free(expr->xpath);
+    free(expr->ids);
+    lyd_path_free(expr->path);
+    return EXIT_FAILURE;
+}
+
+/* append a string to the dynamic buffer */
+static int
+filter_buf_add(struct ly_ctx *ctx, char **buf, size_t *len, size_t *size, const char *str, size_t str_len)
+{
+    char *ptr;
+
+    if (*len + str_len + 1 > *size) {
+        *size = (*len + str_len + 1) * 2;
+        ptr = realloc(*buf, *size);
+        LY_CHECK_ERR_RETURN(!ptr, LOGMEM(ctx), EXIT_FAILURE);
+        *buf = ptr;
+    }
+    memcpy(*buf + *len, str, str_len);
+    *len += str_len;
+    (*buf)[*len] = '\0';
+    return EXIT_SUCCESS;
+}
+
+/* content match node is a leaf (leaf-list) with a value */
+#define FILTER_CONTENT_MATCH(node) (((node)->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST)) \
+        && ((struct lyd_node_leaf_list *)(node))->value_str && ((struct lyd_node_leaf_list *)(node))->value_str[0])
+
+/**
+ * @brief Transform a subtree filter node into XPath location paths of all its selection nodes, joined by '|'.
+ */
+static int
+filter_subtree2xpath(struct ly_ctx *ctx, const struct lyd_node *node, const char *parent_path, char **xpath,
+                     size_t *len, size_t *size)
+{
+    const struct lyd_node *child;
+    const struct lys_module *mod;
+    char *path = NULL, *ptr;
+    const char *value;
+    size_t path_len, path_size = 0;
+    int branch = 0, ret = EXIT_FAILURE;
+    char quot;
+
+    path_len = 0;
+    if (filter_buf_add(ctx, &path, &path_len, &path_size, parent_path, strlen(parent_path))
+            || filter_buf_add(ctx, &path, &path_len, &path_size, "/", 1)) {
+        goto cleanup;
+    }
+    mod = lyd_node_module(node);
+    if (!node->parent || (lyd_node_module(node->parent) != mod)) {
+        if (filter_buf_add(ctx, &path, &path_len, &path_size, mod->name, strlen(mod->name))
+                || filter_buf_add(ctx, &path, &path_len, &path_size, ":", 1)) {
+            goto cleanup;
+        }
+    }
+    if (filter_buf_add(ctx, &path, &path_len, &path_size, node->schema->name, strlen(node->schema->name))) {
+        goto cleanup;
+    }
+
+    if (FILTER_CONTENT_MATCH(node)) {
+        /* a top-level content match node */
+        value = ((struct lyd_node_leaf_list *)node)->value_str;
+        quot = strchr(value, '\'') ? '"' : '\'';
+        if (strchr(value, quot)) {
+            LOGERR(ctx, LY_EINVAL, "Subtree filter value \"%s\" with both quotes not supported.", value);
+            goto cleanup;
+        }
+        if (asprintf(&ptr, "[.=%c%s%c]", quot, value, quot) == -1) {
+            LOGMEM(ctx);
+            goto cleanup;
+        }
+        ret = filter_buf_add(ctx, &path, &path_len, &path_size, ptr, strlen(ptr));
+        free(ptr);
+        if (ret) {
+            goto cleanup;
+        }
+        ret = EXIT_FAILURE;
+    } else if (!(node->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST | LYS_ANYDATA))) {
+        /* content match children are the predicates */
+        LY_TREE_FOR(node->child, child) {
+            if (!FILTER_CONTENT_MATCH(child)) {
+                continue;
+            }
+            value = ((struct lyd_node_leaf_list *)child)->value_str;
+            quot = strchr(value, '\'') ? '"' : '\'';
+            if (strchr(value, quot)) {
+                LOGERR(ctx, LY_EINVAL, "Subtree filter value \"%s\" with both quotes not supported.", value);
+                goto cleanup;
+            }
+            if (asprintf(&ptr, "[%s%s%s=%c%s%c]", (lyd_node_module(child) != mod) ? lyd_node_module(child)->name : "",
+                         (lyd_node_module(child) != mod) ? ":" : "", child->schema->name, quot, value, quot) == -1) {
+                LOGMEM(ctx);
+                goto cleanup;
+            }
+            ret = filter_buf_add(ctx, &path, &path_len, &path_size, ptr, strlen(ptr));
+            free(ptr);
+            if (ret) {
+                goto cleanup;
+            }
+            ret = EXIT_FAILURE;
+        }
+
+        /* containment and selection children are the branches */
+        LY_TREE_FOR(node->child, child) {
+            if (FILTER_CONTENT_MATCH(child)) {
+                continue;
+            }
+            branch = 1;
+            if (filter_subtree2xpath(ctx, child, path, xpath, len, size)) {
+                goto cleanup;
+            }
+        }
+    }
+
+    if (!branch) {
+        /* selection of the whole node */
+        if ((*len && filter_buf_add(ctx, xpath, len, size, " | ", 3))
+                || filter_buf_add(ctx, xpath, len, size, path, path_len)) {
+            goto cleanup;
+        }
+    }
+    ret = EXIT_SUCCESS;
+
+cleanup:
+    free(path);
+    return ret;
+}
+
+API int
+lyd_filter_add_subtree(struct lyd_filter *filter, const struct lyd_node *subtree, uint32_t id)
+{
+    FUN_IN;
+
+    const struct lyd_node *iter;
+    char *xpath = NULL;
+    size_t len = 0, size = 0;
+    int ret;
+
+    if (!filter || !subtree || (lyd_node_module(subtree)->ctx != filter->ctx)) {
+        LOGARG;
+        return EXIT_FAILURE;
+    }
+
+    /* all the top-level siblings */
+    for (iter = subtree; iter->prev->next; iter = iter->prev);
+    for (; iter; iter = iter->next) {
+        if (filter_subtree2xpath(filter->ctx, iter, "", &xpath, &len, &size)) {
+            free(xpath);
+            return EXIT_FAILURE;
+        }
+    }
+
+    ret = lyd_filter_add(filter, lyd_node_module(subtree), xpath, id);
+    free(xpath);
+    return ret;
+}
+
+static int
+filter_id_cmp(const void *ptr1, const void *ptr2)
+{
+    uint32_t id1 = *(uint32_t *)ptr1, id2 = *(uint32_t *)ptr2;
+
+    return (id1 > id2) - (id1 < id2);
+}
+
+/* evaluate the expressions of a bucket, add the subscribers of the matching ones */
+static int
+filter_bucket_eval(const struct lyd_filter *filter, const struct filter_bucket *bucket, const struct lyd_node *tree,
+                   uint32_t **ids, uint32_t *count, uint32_t *size)
+{
+    struct filter_expr *expr;
+    struct lyxp_set set;
+    uint32_t i, *ptr;
+
+    for (i = 0; i < bucket->count; ++i) {
+        expr = &filter->exprs[bucket->exprs[i]];
+
+        memset(&set, 0, sizeof set);
+        if (lyxp_eval_expr(expr->path->exp, tree, LYXP_NODE_ELEM, expr->path->module, &set, 0) != EXIT_SUCCESS) {
+            return EXIT_FAILURE;
+        }
+        lyxp_set_cast(&set, LYXP_SET_BOOLEAN, tree, expr->path->module, 0);
+        if (!set.val.bool) {
+            continue;
+        }
+
+        if (*count + expr->id_count > *size) {
+            *size = (*count + expr->id_count) * 2;
+            ptr = realloc(*ids, *size * sizeof **ids);
+            LY_CHECK_ERR_RETURN(!ptr, LOGMEM(filter->ctx), EXIT_FAILURE);
+            *ids = ptr;
+        }
+        memcpy(*ids + *count, expr->ids, expr->id_count * sizeof **ids);
+        *count += expr->id_count;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+API int
+lyd_filter_match(const struct lyd_filter *filter, const struct lyd_node *tree, uint32_t **ids, uint32_t *count)
+{
+    FUN_IN;
+
+    struct filter_bucket_rec rec, *match;
+    const struct lyd_node *iter;
+    uint32_t size = 0, i, j;
+
+    if (!filter || !tree || !ids || !count || (lyd_node_module(tree)->ctx != filter->ctx)) {
+        LOGARG;
+        return EXIT_FAILURE;
+    }
+    *ids = NULL;
+    *count = 0;
+
+    /* find the tree root */
+    for (; tree->parent; tree = tree->parent);
+    for (; tree->prev->next; tree = tree->prev);
+
+    if (filter_bucket_eval(filter, &filter->generic, tree, ids, count, &size)) {
+        goto error;
+    }
+    LY_TREE_FOR(tree, iter) {
+        /* evaluate every bucket once, for its first instance */
+        if ((iter != tree) && (iter->prev->schema == iter->schema)) {
+            continue;
+        }
+        rec.schema = iter->schema;
+        if (!lyht_find(filter->bucket_ht, &rec, filter_ptr_hash(iter->schema), (void **)&match)
+                && filter_bucket_eval(filter, &filter->buckets[match->idx], tree, ids, count, &size)) {
+            goto error;
+        }
+    }
+
+    /* every subscriber once */
+    if (*count > 1) {
+        qsort(*ids, *count, sizeof **ids, filter_id_cmp);
+        for (i = 1, j = 1; i < *count; ++i) {
+            if ((*ids)[i] != (*ids)[j - 1]) {
+                (*ids)[j++] = (*ids)[i];
+            }
+        }
+        *count = j;
+    }
+
+    return EXIT_SUCCESS;
+
+error:
+    free(*ids);
+    *ids = NULL;
+    *count = 0;
+    return EXIT_FAILURE;
+}
+
+/* subtree filter content match node, an element with only a text content */
+#define SUBTREE_CONTENT_MATCH(elem) (!(elem)->child && (elem)->content && (elem)->content[0])
+
+/* whether a subtree filter element names a data node, an element without a namespace matches any module */
+static int
+subtree_elem_match(const struct lyxml_elem *elem, const struct lyd_node *node)
+{
+    return ly_strequal(elem->name, node->schema->name, 0)
+            && (!elem->ns || ly_strequal(elem->ns->value, lyd_node_module(node)->ns, 0));
+}
+
+/* whether the data siblings satisfy all the content match nodes of the filter siblings */
+static int
+subtree_content_match(const struct lyxml_elem *fsibling, const struct lyd_node *dsibling)
+{
+    const struct lyxml_elem *f;
+    const struct lyd_node *d;
+
+    LY_TREE_FOR(fsibling, f) {
+        if (!SUBTREE_CONTENT_MATCH(f)) {
+            continue;
+        }
+
+        /* any leaf-list instance can match */
+        LY_TREE_FOR(dsibling, d) {
+            if ((d->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST)) && subtree_elem_match(f, d)
+                    && ly_strequal(((struct lyd_node_leaf_list *)d)->value_str, f->content, 0)) {
+                break;
+            }
+        }
+        if (!d) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+static int
+subtree_insert(struct lyd_node *rparent, struct lyd_node **rfirst, struct lyd_node *node)
+{
+    if (!rparent && !*rfirst) {
+        /* lyd_insert_sibling() needs a sibling */
+        *rfirst = node;
+        return EXIT_SUCCESS;
+    }
+    if (rparent ? lyd_insert(rparent, node) : lyd_insert_sibling(rfirst, node)) {
+        lyd_free(node);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Select the data siblings by several lists of filter siblings (of the filter nodes with the same
+ * schema as the data parent), the result is their union.
+ *
+ * @return Number of the selected siblings inserted into @p rparent (@p rfirst for top-level), -1 on error.
+ */
+static int
+subtree_select(const struct lyxml_elem **fsiblings, uint32_t fcount, const struct lyd_node *dsibling,
+               struct lyd_node *rparent, struct lyd_node **rfirst)
+{
+    const struct lyxml_elem **matched, **sub = NULL, *f;
+    const struct lyd_node *d, *key;
+    struct lyd_node *dup, *iter;
+    uint32_t i, mcount = 0, scount, fnodes = 0;
+    int all = 0, full, r, ret = -1, count = 0;
+
+    /* a list can have more containment nodes of the same schema, each of them is a list of the children */
+    for (i = 0; i < fcount; ++i) {
+        LY_TREE_FOR(fsiblings[i], f) {
+            ++fnodes;
+        }
+    }
+
+    matched = malloc(fcount * sizeof *matched);
+    sub = malloc(fnodes * sizeof *sub);
+    if (!matched || !sub) {
+        LOGMEM(NULL);
+        goto cleanup;
+    }
+
+    /* the filter sibling lists whose content matches */
+    for (i = 0; i < fcount; ++i) {
+        if (!subtree_content_match(fsiblings[i], dsibling)) {
+            continue;
+        }
+        matched[mcount++] = fsiblings[i];
+
+        LY_TREE_FOR(fsiblings[i], f) {
+            if (!SUBTREE_CONTENT_MATCH(f)) {
+                break;
+            }
+        }
+        if (!f) {
+            /* only content match nodes, all the siblings are selected */
+            all = 1;
+        }
+    }
+
+    LY_TREE_FOR(dsibling, d) {
+        if (!mcount) {
+            break;
+        }
+
+        /* union of all the matched lists */
+        full = all;
+        scount = 0;
+        for (i = 0; !full && (i < mcount); ++i) {
+            LY_TREE_FOR(matched[i], f) {
+                if (!subtree_elem_match(f, d)) {
+                    continue;
+                }
+                if (SUBTREE_CONTENT_MATCH(f)) {
+                    full = (d->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST))
+                            && ly_strequal(((struct lyd_node_leaf_list *)d)->value_str, f->content, 0);
+                } else if (!f->child) {
+                    /* selection node */
+                    full = 1;
+                } else if (!(d->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST | LYS_ANYDATA))) {
+                    /* containment node */
+                    sub[scount++] = f->child;
+                }
+                if (full) {
+                    break;
+                }
+            }
+        }
+
+        if (full) {
+            dup = lyd_dup(d, LYD_DUP_OPT_RECURSIVE);
+            if (!dup || subtree_insert(rparent, rfirst, dup)) {
+                goto cleanup;
+            }
+            ++count;
+        } else if (scount) {
+            dup = lyd_dup(d, 0);
+            if (!dup) {
+                goto cleanup;
+            }
+            r = subtree_select(sub, scount, d->child, dup, NULL);
+            if (r < 1) {
+                lyd_free(dup);
+                if (r == -1) {
+                    goto cleanup;
+                }
+                continue;
+            }
+
+            if (d->schema->nodetype == LYS_LIST) {
+                /* the keys are always selected */
+                for (i = 0, key = d->child; i < ((struct lys_node_list *)d->schema)->keys_size; ++i, key = key->next) {
+                    LY_TREE_FOR(dup->child, iter) {
+                        if (iter->schema == key->schema) {
+                            break;
+                        }
+                    }
+                    if (!iter && ((iter = lyd_dup(key, 0)) == NULL || subtree_insert(dup, NULL, iter))) {
+                        lyd_free(dup);
+                        goto cleanup;
+                    }
+                }
+            }
+
+            if (subtree_insert(rparent, rfirst, dup)) {
+                goto cleanup;
+            }
+            ++count;
+        }
+    }
+    ret = count;
+
+cleanup:
+    free(matched);
+    free(sub);
+    return ret;
+}
+
+API int
+lyd_subtree_filter(const struct lyd_node *data, const struct lyxml_elem *filter, struct lyd_node **result)
+{
+    FUN_IN;
+
+    const struct lyxml_elem *fsibling;
+
+    if (!filter || !result) {
+        LOGARG;
+        return EXIT_FAILURE;
+    }
+    *result = NULL;
+
+    if (!data) {
+        return EXIT_SUCCESS;
+    }
+
+    /* the first top-level siblings */
+    for (; data->parent; data = data->parent);
+    for (; data->prev->next; data = data->prev);
+    for (fsibling = filter; fsibling->parent; fsibling = fsibling->parent);
+    for (; fsibling->prev->next; fsibling = fsibling->prev);
+
+    if (subtree_select(&fsibling, 1, data, NULL, result) == -1) {
+        lyd_free_withsiblings(*result);
+        *result = NULL;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -22,6 +22,10 @@
 #include "context.h"
 #include "hash_table.h"
 
+#ifdef LYHT_SSE2
+# include <emmintrin.h>
+#endif
+
 static int
 lydict_val_eq(void *val1_p, void *val2_p, int UNUSED(mod), void *cb_data)
 {
@@ -45,73 +49,225 @@ lydict_val_eq(void *val1_p, void *val2_p, int UNUSED(mod), void *cb_data)
     return 0;
 }
 
+static int
+lydict_immortal_val_eq(void *val1_p, void *val2_p, int UNUSED(mod), void *UNUSED(cb_data))
+{
+    struct dict_immortal_rec *rec1 = val1_p, *rec2 = val2_p;
+
+    return (rec1->len == rec2->len) && !memcmp(rec1->value, rec2->value, rec1->len);
+}
+
 void
-lydict_init(struct dict_table *dict)
+lydict_init(struct dict_table *dict, int sharded, int immortal)
 {
+    uint32_t i, count;
+
     if (!dict) {
         LOGARG;
         return;
     }
 
-    dict->hash_tab = lyht_new(1024, sizeof(struct dict_rec), lydict_val_eq, NULL, 1);
-    LY_CHECK_ERR_RETURN(!dict->hash_tab, LOGINT(NULL), );
-    pthread_mutex_init(&dict->lock, NULL);
+    dict->shard_bits = sharded ? LYDICT_SHARD_BITS : 0;
+    count = 1 << dict->shard_bits;
+
+    dict->shards = calloc(count, sizeof *dict->shards);
+    LY_CHECK_ERR_RETURN(!dict->shards, LOGMEM(NULL), );
+    for (i = 0; i < count; ++i) {
+        dict->shards[i].hash_tab = lyht_new(LYDICT_INIT_SIZE >> dict->shard_bits, sizeof(struct dict_rec), lydict_val_eq, NULL, 1);
+        LY_CHECK_ERR_RETURN(!dict->shards[i].hash_tab, LOGINT(NULL), );
+        pthread_mutex_init(&dict->shards[i].lock, NULL);
+    }
+
+    if (immortal) {
+        dict->immortal.hash_tab = lyht_new(LYDICT_INIT_SIZE, sizeof(struct dict_immortal_rec), lydict_immortal_val_eq, NULL, 1);
+        LY_CHECK_ERR_RETURN(!dict->immortal.hash_tab, LOGINT(NULL), );
+        pthread_mutex_init(&dict->immortal.lock, NULL);
+    }
 }
 
 void
 lydict_clean(struct dict_table *dict)
 {
-    unsigned int i;
+    unsigned int i, j;
     struct dict_rec *dict_rec  = NULL;
-    struct ht_rec *rec = NULL;
+    struct dict_shard *shard;
+    struct dict_chunk *chunk;
 
     if (!dict) {
         LOGARG;
         return;
     }
 
-    for (i = 0; i < dict->hash_tab->size; i++) {
-        /* get ith record */
-        rec = (struct ht_rec *)&dict->hash_tab->recs[i * dict->hash_tab->rec_size];
-        if (rec->hits == 1) {
-            /*
-             * this should not happen, all records inserted into
-             * dictionary are supposed to be removed using lydict_remove()
-             * before calling lydict_clean()
-             */
-            dict_rec  = (struct dict_rec *)rec->val;
-            LOGWRN(NULL, "String \"%s\" not freed from the dictionary, refcount %d", dict_rec->value, dict_rec->refcount);
-            /* if record wasn't removed before free string allocated for that record */
+    if (!dict->shards) {
+        return;
+    }
+
+    for (j = 0; j < (1U << dict->shard_bits); ++j) {
+        shard = &dict->shards[j];
+        if (!shard->hash_tab) {
+            /* initialization failed */
+            continue;
+        }
+
+        lyht_finish_resize(shard->hash_tab);
+        for (i = 0; i < shard->hash_tab->size; i++) {
+            /* get ith record */
+            dict_rec = lyht_get_val(shard->hash_tab, i);
+            if (dict_rec && dict->destroying) {
+                /* the strings were not removed one by one */
+                free(dict_rec->value);
+            } else if (dict_rec) {
+                /*
+                 * this should not happen, all records inserted into
+                 * dictionary are supposed to be removed using lydict_remove()
+                 * before calling lydict_clean()
+                 */
+                LOGWRN(NULL, "String \"%s\" not freed from the dictionary, refcount %d", dict_rec->value, dict_rec->refcount);
+                /* if record wasn't removed before free string allocated for that record */
 #ifdef NDEBUG
-            free(dict_rec->value);
+                free(dict_rec->value);
 #endif
+            }
         }
+
+        /* free table and destroy mutex */
+        lyht_free(shard->hash_tab);
+        pthread_mutex_destroy(&shard->lock);
+    }
+    free(dict->shards);
+    dict->shards = NULL;
+
+    if (dict->immortal.hash_tab) {
+        /* immortal strings are freed only here */
+        while (dict->immortal.chunks) {
+            chunk = dict->immortal.chunks;
+            dict->immortal.chunks = chunk->next;
+            free(chunk);
+        }
+        lyht_free(dict->immortal.hash_tab);
+        dict->immortal.hash_tab = NULL;
+        pthread_mutex_destroy(&dict->immortal.lock);
+    }
+}
+
+API int
+lydict_stats(struct ly_ctx *ctx, struct ly_ht_stats *stats)
+{
+    FUN_IN;
+
+    uint32_t i;
+    struct dict_shard *shard;
+
+    if (!ctx || !stats) {
+        LOGARG;
+        return -1;
+    }
+
+    memset(stats, 0, sizeof *stats);
+    for (i = 0; i < (1U << ctx->dict.shard_bits); ++i) {
+        shard = &ctx->dict.shards[i];
+        pthread_mutex_lock(&shard->lock);
+        lyht_add_stats(shard->hash_tab, stats);
+        pthread_mutex_unlock(&shard->lock);
+    }
+
+    if (ctx->dict.immortal.hash_tab) {
+        pthread_mutex_lock(&ctx->dict.immortal.lock);
+        lyht_add_stats(ctx->dict.immortal.hash_tab, stats);
+        pthread_mutex_unlock(&ctx->dict.immortal.lock);
     }
 
-    /* free table and destroy mutex */
-    lyht_free(dict->hash_tab);
-    pthread_mutex_destroy(&dict->lock);
+    return 0;
 }
 
-/*
- * Bob Jenkin's one-at-a-time hash
- * http://www.burtleburtle.net/bob/hash/doobs.html
+size_t
+lydict_mem_size(struct ly_ctx *ctx, uint32_t *count)
+{
+    uint32_t i, j;
+    size_t mem = 0;
+    struct dict_shard *shard;
+    struct dict_rec *rec;
+    struct dict_chunk *chunk;
+
+    *count = 0;
+    for (i = 0; i < (1U << ctx->dict.shard_bits); ++i) {
+        shard = &ctx->dict.shards[i];
+        pthread_mutex_lock(&shard->lock);
+        lyht_finish_resize(shard->hash_tab);
+        mem += lyht_mem_size(shard->hash_tab);
+        for (j = 0; j < shard->hash_tab->size; ++j) {
+            rec = lyht_get_val(shard->hash_tab, j);
+            if (rec) {
+                /* with the flags byte */
+                mem += strlen(rec->value) + 2;
+                ++(*count);
+            }
+        }
+        pthread_mutex_unlock(&shard->lock);
+    }
+    mem += (1U << ctx->dict.shard_bits) * sizeof *ctx->dict.shards;
+
+    if (ctx->dict.immortal.hash_tab) {
+        pthread_mutex_lock(&ctx->dict.immortal.lock);
+        mem += lyht_mem_size(ctx->dict.immortal.hash_tab);
+        *count += ctx->dict.immortal.hash_tab->used;
+        for (chunk = ctx->dict.immortal.chunks; chunk; chunk = chunk->next) {
+            mem += sizeof *chunk + chunk->size;
+        }
+        pthread_mutex_unlock(&ctx->dict.immortal.lock);
+    }
+
+    return mem;
+}
+
+/**
+ * @brief Get the dictionary shard a string belongs to. The top bits of the hash are used
+ * so that the bits used for indexing the shard hash table stay uniformly distributed.
  *
- * Spooky hash is faster, but it works only for little endian architectures.
+ * @param[in] dict Dictionary.
+ * @param[in] hash Hash of the string.
+ * @return Dictionary shard.
+ */
+static struct dict_shard *
+dict_get_shard(struct dict_table *dict, uint32_t hash)
+{
+    if (!dict->shard_bits) {
+        return &dict->shards[0];
+    }
+    return &dict->shards[hash >> (32 - dict->shard_bits)];
+}
+
+/* 32-bit rotation to the left */
+#define DICT_HASH_ROTL(x, r) (((x) << (r)) | ((x) >> (32 - (r))))
+
+/* read 4 bytes as a little-endian number regardless of the host endianness (compiles into a single load on LE) */
+#define DICT_HASH_LOAD32(p) ((uint32_t)(p)[0] | ((uint32_t)(p)[1] << 8) | ((uint32_t)(p)[2] << 16) | ((uint32_t)(p)[3] << 24))
+
+/*
+ * One block round of MurmurHash3 (x86_32 variant), public domain
+ * https://github.com/aappleby/smhasher
  */
 static uint32_t
-dict_hash(const char *key, size_t len)
+dict_hash_round(uint32_t hash, uint32_t block)
 {
-    uint32_t hash, i;
+    block *= 0xcc9e2d51;
+    block = DICT_HASH_ROTL(block, 15);
+    block *= 0x1b873593;
 
-    for (hash = i = 0; i < len; ++i) {
-        hash += key[i];
-        hash += (hash << 10);
-        hash ^= (hash >> 6);
-    }
-    hash += (hash << 3);
-    hash ^= (hash >> 11);
-    hash += (hash << 15);
+    hash ^= block;
+    hash = DICT_HASH_ROTL(hash, 13);
+    return hash * 5 + 0xe6546b64;
+}
+
+/* MurmurHash3 finalization mix, forces all bits of the hash to avalanche */
+static uint32_t
+dict_hash_fmix(uint32_t hash)
+{
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6b;
+    hash ^= hash >> 13;
+    hash *= 0xc2b2ae35;
+    hash ^= hash >> 16;
     return hash;
 }
 
@@ -120,9 +276,55 @@ dict_hash(const char *key, size_t len)
  * - init hash to 0
  * - repeatedly call dict_hash_multi(), provide hash from the last call
  * - call dict_hash_multi() with key_part = NULL to finish the hash
+ *
+ * The key is processed a 32-bit word at a time, the trailing bytes are hashed together
+ * with the length of the part so the result depends on the part boundaries.
  */
 uint32_t
 dict_hash_multi(uint32_t hash, const char *key_part, size_t len)
+{
+    const uint8_t *data = (const uint8_t *)key_part;
+    uint32_t block;
+    size_t i;
+
+    if (!key_part) {
+        return dict_hash_fmix(hash);
+    }
+
+    for (i = 0; i + 4 <= len; i += 4) {
+        hash = dict_hash_round(hash, DICT_HASH_LOAD32(data + i));
+    }
+
+    block = (uint32_t)len << 24;
+    switch (len & 3) {
+    case 3:
+        block |= (uint32_t)data[i + 2] << 16;
+        /* fallthrough */
+    case 2:
+        block |= (uint32_t)data[i + 1] << 8;
+        /* fallthrough */
+    case 1:
+        block |= (uint32_t)data[i];
+        break;
+    }
+
+    return dict_hash_round(hash, block);
+}
+
+static uint32_t
+dict_hash(const char *key, size_t len)
+{
+    return dict_hash_fmix(dict_hash_multi(0, key, len));
+}
+
+/*
+ * Bob Jenkin's one-at-a-time hash
+ * http://www.burtleburtle.net/bob/hash/doobs.html
+ *
+ * Usage is the same as for dict_hash_multi().
+ */
+uint32_t
+dict_hash_oaat_multi(uint32_t hash, const char *key_part, size_t len)
 {
     uint32_t i;
 
@@ -141,39 +343,197 @@ dict_hash_multi(uint32_t hash, const char *key_part, size_t len)
     return hash;
 }
 
-API void
-lydict_remove(struct ly_ctx *ctx, const char *value)
+/**
+ * @brief Thread-specific dictionary insert cache. While a context is being parsed into,
+ * the most recently inserted strings are remembered together with the number of references
+ * given out but not yet counted in the dictionary, which avoids hashing, locking, and
+ * probing the shared dictionary for the repeating strings.
+ */
+static THREAD_LOCAL struct {
+    struct ly_ctx *ctx; /* context the cache is used for, NULL if not used */
+    uint32_t depth;     /* number of nested lydict_cache_start() calls */
+    struct dict_cache_rec {
+        char *value;    /* string stored in the dictionary, one reference of it is held by the cache */
+        size_t len;     /* length of value */
+        uint32_t hash;  /* hash of value */
+        uint32_t refs;  /* references given out and not counted in the dictionary */
+    } recs[LYDICT_CACHE_SIZE];
+} dict_cache;
+
+/**
+ * @brief Thread-specific state of inserting into the immortal part of a dictionary.
+ */
+static THREAD_LOCAL struct {
+    struct ly_ctx *ctx; /* context whose immortal strings are being inserted, NULL if none */
+    uint32_t depth;     /* number of nested lydict_immortal_start() calls */
+} dict_immortal;
+
+void
+lydict_immortal_start(struct ly_ctx *ctx)
 {
-    FUN_IN;
+    if (!ctx->dict.immortal.hash_tab) {
+        /* immortal strings not used */
+        return;
+    }
 
-    size_t len;
-    int ret;
-    uint32_t hash;
-    struct dict_rec rec, *match = NULL;
-    char *val_p;
+    if (!dict_immortal.ctx) {
+        dict_immortal.ctx = ctx;
+    } else if (dict_immortal.ctx != ctx) {
+        /* already used for another context */
+        return;
+    }
 
-    if (!value || !ctx) {
+    ++dict_immortal.depth;
+}
+
+void
+lydict_immortal_stop(struct ly_ctx *ctx)
+{
+    if (dict_immortal.ctx != ctx) {
         return;
     }
 
-    len = strlen(value);
-    hash = dict_hash(value, len);
+    if (!--dict_immortal.depth) {
+        dict_immortal.ctx = NULL;
+    }
+}
+
+/**
+ * @brief Set the flags byte following a new dictionary string.
+ *
+ * @param[in] value String with space for the flags byte after its terminating NULL byte.
+ * @param[in] len Length of \p value.
+ */
+static void
+dict_set_flags(char *value, size_t len)
+{
+    value[len + 1] = (ly_strlen_noesc(value, LY_ESC_XML_ATTR | LY_ESC_JSON) == len) ? LYDICT_PLAIN : 0;
+}
+
+/**
+ * @brief Find an immortal string in the dictionary, no lock is needed.
+ *
+ * @param[in] dict Dictionary.
+ * @param[in] value String to find.
+ * @param[in] len Length of \p value.
+ * @param[in] hash Hash of \p value.
+ * @return Stored immortal string, NULL if not found.
+ */
+static char *
+dict_find_immortal(struct dict_table *dict, const char *value, size_t len, uint32_t hash)
+{
+    struct dict_immortal_rec rec, *match;
+
+    if (!dict->immortal.hash_tab) {
+        return NULL;
+    }
+
+    rec.value = (char *)value;
+    rec.len = len;
+    if (lyht_find(dict->immortal.hash_tab, &rec, hash, (void **)&match)) {
+        return NULL;
+    }
+    return match->value;
+}
+
+/**
+ * @brief Store a new immortal string, the immortal lock must be held.
+ *
+ * @param[in] ctx Context with the dictionary.
+ * @param[in] value String to store.
+ * @param[in] len Length of \p value.
+ * @param[in] hash Hash of \p value.
+ * @return Stored immortal string, NULL on error.
+ */
+static char *
+dict_store_immortal(struct ly_ctx *ctx, const char *value, size_t len, uint32_t hash)
+{
+    struct dict_immortal *immortal = &ctx->dict.immortal;
+    struct dict_immortal_rec rec, *match;
+    struct dict_chunk *chunk;
+    size_t size;
+    int ret;
+
+    chunk = immortal->chunks;
+    if (!chunk || (chunk->size - chunk->used < len + 2)) {
+        /* new chunk needed */
+        size = (len + 2 > LYDICT_CHUNK_SIZE) ? len + 2 : LYDICT_CHUNK_SIZE;
+        chunk = malloc(sizeof *chunk + size);
+        LY_CHECK_ERR_RETURN(!chunk, LOGMEM(ctx), NULL);
+        chunk->used = 0;
+        chunk->size = size;
+        chunk->next = immortal->chunks;
+        immortal->chunks = chunk;
+    }
+
+    rec.value = chunk->data + chunk->used;
+    rec.len = len;
+    memcpy(rec.value, value, len);
+    rec.value[len] = '\0';
+    dict_set_flags(rec.value, len);
+
+    ret = lyht_insert(immortal->hash_tab, &rec, hash, (void **)&match);
+    if (ret == -1) {
+        LOGINT(ctx);
+        return NULL;
+    } else if (ret == 0) {
+        /* the string space is used */
+        chunk->used += len + 2;
+    }
+    return match->value;
+}
+
+/**
+ * @brief Thread-specific batch of dictionary strings to be removed. While freeing data of a context,
+ * the removed strings are only collected and then removed together, sorted by their hash, taking
+ * the dictionary lock once per batch.
+ */
+static THREAD_LOCAL struct {
+    struct ly_ctx *ctx; /* context the batch is used for, NULL if not used */
+    uint32_t depth;     /* number of nested lydict_release_start() calls */
+    uint32_t used;      /* number of used records */
+    struct dict_release_rec {
+        const char *value; /* string stored in the dictionary */
+        size_t len;        /* length of value */
+        uint32_t hash;     /* hash of value */
+    } recs[LYDICT_RELEASE_BATCH];
+} dict_release;
+
+/**
+ * @brief Remove references of a string from the dictionary, the dictionary shard must be locked.
+ *
+ * @param[in] ctx Context with the dictionary.
+ * @param[in] shard Dictionary shard of \p value.
+ * @param[in] value String stored in the dictionary.
+ * @param[in] len Length of \p value.
+ * @param[in] hash Hash of \p value.
+ * @param[in] add_refs Number of references to add to the string before removing.
+ * @param[in] rem_refs Number of references to remove.
+ */
+static void
+dict_remove_locked(struct ly_ctx *ctx, struct dict_shard *shard, const char *value, size_t len, uint32_t hash,
+                   uint32_t add_refs, uint32_t rem_refs)
+{
+    int ret;
+    struct dict_rec rec, *match = NULL;
+    char *val_p;
 
     /* create record for lyht_find call */
     rec.value = (char *)value;
     rec.refcount = 0;
 
-    pthread_mutex_lock(&ctx->dict.lock);
     /* set len as data for compare callback */
-    lyht_set_cb_data(ctx->dict.hash_tab, (void *)&len);
+    lyht_set_cb_data(shard->hash_tab, (void *)&len);
     /* check if value is already inserted */
-    ret = lyht_find(ctx->dict.hash_tab, &rec, hash, (void **)&match);
+    ret = lyht_find(shard->hash_tab, &rec, hash, (void **)&match);
 
     if (ret == 0) {
-        LY_CHECK_ERR_GOTO(!match, LOGINT(ctx), finish);
+        LY_CHECK_ERR_RETURN(!match, LOGINT(ctx), );
 
         /* if value is already in dictionary, decrement reference counter */
-        match->refcount--;
+        match->refcount += add_refs;
+        assert(match->refcount >= rem_refs);
+        match->refcount -= rem_refs;
         if (match->refcount == 0) {
             /*
              * remove record
@@ -181,34 +541,247 @@ lydict_remove(struct ly_ctx *ctx, const char *value)
              * free it after it is removed from hash table
              */
             val_p = match->value;
-            ret = lyht_remove(ctx->dict.hash_tab, &rec, hash);
+            ret = lyht_remove(shard->hash_tab, &rec, hash);
             free(val_p);
-            LY_CHECK_ERR_GOTO(ret, LOGINT(ctx), finish);
+            LY_CHECK_ERR_RETURN(ret, LOGINT(ctx), );
+        }
+    }
+}
+
+/**
+ * @brief Remove references of a string from the dictionary.
+ *
+ * @param[in] ctx Context with the dictionary.
+ * @param[in] value String stored in the dictionary.
+ * @param[in] len Length of \p value.
+ * @param[in] hash Hash of \p value.
+ * @param[in] add_refs Number of references to add to the string before removing one.
+ */
+static void
+dict_remove(struct ly_ctx *ctx, const char *value, size_t len, uint32_t hash, uint32_t add_refs)
+{
+    struct dict_shard *shard;
+
+    shard = dict_get_shard(&ctx->dict, hash);
+    pthread_mutex_lock(&shard->lock);
+    dict_remove_locked(ctx, shard, value, len, hash, add_refs, 1);
+    pthread_mutex_unlock(&shard->lock);
+}
+
+static int
+dict_release_rec_cmp(const void *ptr1, const void *ptr2)
+{
+    const struct dict_release_rec *rec1 = ptr1, *rec2 = ptr2;
+
+    if (rec1->hash != rec2->hash) {
+        return (rec1->hash < rec2->hash) ? -1 : 1;
+    }
+    if (rec1->value != rec2->value) {
+        return (rec1->value < rec2->value) ? -1 : 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Remove all the strings collected in the release batch from the dictionary.
+ */
+static void
+dict_release_batch(struct ly_ctx *ctx)
+{
+    struct dict_shard *shard = NULL, *rec_shard;
+    struct dict_release_rec *rec;
+    uint32_t i, count;
+
+    /* sorting by hash groups the strings of a shard together and the same strings next to each other */
+    qsort(dict_release.recs, dict_release.used, sizeof *dict_release.recs, dict_release_rec_cmp);
+
+    for (i = 0; i < dict_release.used; i += count) {
+        rec = &dict_release.recs[i];
+        for (count = 1; (i + count < dict_release.used) && (rec[count].value == rec->value); ++count);
+
+        rec_shard = dict_get_shard(&ctx->dict, rec->hash);
+        if (rec_shard != shard) {
+            if (shard) {
+                pthread_mutex_unlock(&shard->lock);
+            }
+            shard = rec_shard;
+            pthread_mutex_lock(&shard->lock);
         }
+        dict_remove_locked(ctx, shard, rec->value, rec->len, rec->hash, 0, count);
+    }
+    if (shard) {
+        pthread_mutex_unlock(&shard->lock);
+    }
+
+    dict_release.used = 0;
+}
+
+void
+lydict_release_start(struct ly_ctx *ctx)
+{
+    if (!dict_release.ctx) {
+        dict_release.ctx = ctx;
+    } else if (dict_release.ctx != ctx) {
+        /* the batch is already used for another context */
+        return;
+    }
+
+    ++dict_release.depth;
+}
+
+void
+lydict_release_flush(struct ly_ctx *ctx)
+{
+    if (dict_release.ctx != ctx) {
+        return;
+    }
+
+    if (--dict_release.depth) {
+        /* nested call */
+        return;
+    }
+
+    dict_release_batch(ctx);
+    dict_release.ctx = NULL;
+}
+
+/**
+ * @brief Count all the references held and given out by a cache record in the dictionary and empty it.
+ */
+static void
+dict_cache_rec_flush(struct ly_ctx *ctx, struct dict_cache_rec *crec)
+{
+    if (crec->value) {
+        dict_remove(ctx, crec->value, crec->len, crec->hash, crec->refs);
+        crec->value = NULL;
+        crec->refs = 0;
+    }
+}
+
+void
+lydict_cache_start(struct ly_ctx *ctx)
+{
+    if (!dict_cache.ctx) {
+        dict_cache.ctx = ctx;
+    } else if (dict_cache.ctx != ctx) {
+        /* the cache is already used for another context */
+        return;
+    }
+
+    ++dict_cache.depth;
+}
+
+void
+lydict_cache_flush(struct ly_ctx *ctx)
+{
+    uint32_t i;
+
+    if (dict_cache.ctx != ctx) {
+        return;
+    }
+
+    if (--dict_cache.depth) {
+        /* nested call */
+        return;
+    }
+
+    for (i = 0; i < LYDICT_CACHE_SIZE; ++i) {
+        dict_cache_rec_flush(ctx, &dict_cache.recs[i]);
+    }
+    dict_cache.ctx = NULL;
+}
+
+API void
+lydict_remove(struct ly_ctx *ctx, const char *value)
+{
+    FUN_IN;
+
+    size_t len;
+    uint32_t hash;
+    struct dict_cache_rec *crec;
+
+    if (!value || !ctx || ctx->dict.destroying) {
+        return;
+    }
+
+    len = strlen(value);
+    hash = dict_hash(value, len);
+
+    if (dict_cache.ctx == ctx) {
+        crec = &dict_cache.recs[hash & (LYDICT_CACHE_SIZE - 1)];
+        if ((crec->value == value) && crec->refs) {
+            /* return a reference that was not yet counted in the dictionary */
+            --crec->refs;
+            return;
+        }
+    }
+
+    if (dict_find_immortal(&ctx->dict, value, len, hash) == value) {
+        /* immortal strings are not reference counted */
+        return;
+    }
+
+    if (dict_release.ctx == ctx) {
+        /* remove it later together with other strings */
+        if (dict_release.used == LYDICT_RELEASE_BATCH) {
+            dict_release_batch(ctx);
+        }
+        dict_release.recs[dict_release.used].value = value;
+        dict_release.recs[dict_release.used].len = len;
+        dict_release.recs[dict_release.used].hash = hash;
+        ++dict_release.used;
+        return;
+    }
+
+    dict_remove(ctx, value, len, hash, 0);
+}
+
+uint32_t
+lydict_refcount(struct ly_ctx *ctx, const char *value)
+{
+    size_t len;
+    uint32_t hash, refcount = 0;
+    struct dict_shard *shard;
+    struct dict_rec rec, *match;
+
+    len = strlen(value);
+    hash = dict_hash(value, len);
+    if (dict_find_immortal(&ctx->dict, value, len, hash) == value) {
+        return 0;
+    }
+
+    rec.value = (char *)value;
+    rec.refcount = 0;
+    shard = dict_get_shard(&ctx->dict, hash);
+    pthread_mutex_lock(&shard->lock);
+    lyht_set_cb_data(shard->hash_tab, (void *)&len);
+    if (!lyht_find(shard->hash_tab, &rec, hash, (void **)&match) && (match->value == value)) {
+        refcount = match->refcount;
     }
+    pthread_mutex_unlock(&shard->lock);
 
-finish:
-    pthread_mutex_unlock(&ctx->dict.lock);
+    return refcount;
 }
 
 static char *
-dict_insert(struct ly_ctx *ctx, char *value, size_t len, int zerocopy)
+dict_insert(struct ly_ctx *ctx, struct dict_shard *shard, char *value, size_t len, uint32_t hash, int zerocopy,
+            uint32_t refs)
 {
     struct dict_rec *match = NULL, rec;
+    char *val_p;
     int ret = 0;
-    uint32_t hash;
 
-    hash = dict_hash(value, len);
     /* set len as data for compare callback */
-    lyht_set_cb_data(ctx->dict.hash_tab, (void *)&len);
+    lyht_set_cb_data(shard->hash_tab, (void *)&len);
     /* create record for lyht_insert */
     rec.value = value;
-    rec.refcount = 1;
+    rec.refcount = refs;
 
     LOGDBG(LY_LDGDICT, "inserting \"%s\"", rec.value);
-    ret = lyht_insert(ctx->dict.hash_tab, (void *)&rec, hash, (void **)&match);
+    ret = lyht_insert(shard->hash_tab, (void *)&rec, hash, (void **)&match);
     if (ret == 1) {
-        match->refcount++;
+        ++ly_cnt.dict_hits;
+        match->refcount += refs;
         if (zerocopy) {
             free(value);
         }
@@ -218,64 +791,254 @@ dict_insert(struct ly_ctx *ctx, char *value, size_t len, int zerocopy)
              * allocate string for new record
              * record is already inserted in hash table
              */
-            match->value = malloc(sizeof *match->value * (len + 1));
+            match->value = malloc(sizeof *match->value * (len + 2));
             LY_CHECK_ERR_RETURN(!match->value, LOGMEM(ctx), NULL);
             memcpy(match->value, value, len);
             match->value[len] = '\0';
+        } else {
+            /* make space for the flags byte */
+            val_p = realloc(value, len + 2);
+            if (!val_p) {
+                LOGMEM(ctx);
+                lyht_remove(shard->hash_tab, &rec, hash);
+                free(value);
+                return NULL;
+            }
+            match->value = val_p;
         }
+        dict_set_flags(match->value, len);
     } else {
         /* lyht_insert returned error */
         LOGINT(ctx);
         return NULL;
     }
 
-    return match->value;
+    return match->value;
+}
+
+/**
+ * @brief Insert a string into the immortal part of the dictionary. If the string is already stored
+ * as reference counted, only its reference is added so that every string is stored only once.
+ */
+static char *
+dict_insert_immortal(struct ly_ctx *ctx, char *value, size_t len, uint32_t hash, int zerocopy)
+{
+    char *result;
+    struct dict_shard *shard;
+    struct dict_rec rec, *match;
+
+    shard = dict_get_shard(&ctx->dict, hash);
+    pthread_mutex_lock(&shard->lock);
+
+    lyht_set_cb_data(shard->hash_tab, (void *)&len);
+    rec.value = value;
+    rec.refcount = 0;
+    if (!lyht_find(shard->hash_tab, &rec, hash, (void **)&match)) {
+        ++match->refcount;
+        result = match->value;
+    } else {
+        pthread_mutex_lock(&ctx->dict.immortal.lock);
+        result = dict_store_immortal(ctx, value, len, hash);
+        pthread_mutex_unlock(&ctx->dict.immortal.lock);
+    }
+
+    pthread_mutex_unlock(&shard->lock);
+
+    if (zerocopy) {
+        free(value);
+    }
+    return result;
+}
+
+/**
+ * @brief Insert a string into the dictionary using the thread insert cache, if used for the context.
+ */
+static const char *
+dict_insert_cached(struct ly_ctx *ctx, char *value, size_t len, int zerocopy)
+{
+    char *result;
+    struct dict_shard *shard;
+    struct dict_cache_rec *crec = NULL;
+    uint32_t hash;
+
+    /* hash outside the lock */
+    hash = dict_hash(value, len);
+    ++ly_cnt.dict_inserts;
+
+    result = dict_find_immortal(&ctx->dict, value, len, hash);
+    if (result) {
+        /* immortal string, no reference to count */
+        ++ly_cnt.dict_hits;
+        if (zerocopy) {
+            free(value);
+        }
+        return result;
+    }
+
+    if (dict_immortal.ctx == ctx) {
+        /* schema string */
+        return dict_insert_immortal(ctx, value, len, hash, zerocopy);
+    }
+
+    if (dict_cache.ctx == ctx) {
+        crec = &dict_cache.recs[hash & (LYDICT_CACHE_SIZE - 1)];
+        if (crec->value && (crec->hash == hash) && (crec->len == len) && !strncmp(crec->value, value, len)) {
+            /* cache hit, the reference will be counted later */
+            ++ly_cnt.dict_hits;
+            ++crec->refs;
+            if (zerocopy) {
+                free(value);
+            }
+            return crec->value;
+        }
+
+        /* replace the cached string */
+        dict_cache_rec_flush(ctx, crec);
+    }
+
+    shard = dict_get_shard(&ctx->dict, hash);
+    pthread_mutex_lock(&shard->lock);
+    /* the cache holds its own reference */
+    result = dict_insert(ctx, shard, value, len, hash, zerocopy, crec ? 2 : 1);
+    pthread_mutex_unlock(&shard->lock);
+
+    if (crec && result) {
+        crec->value = result;
+        crec->len = len;
+        crec->hash = hash;
+    }
+
+    return result;
+}
+
+API const char *
+lydict_insert(struct ly_ctx *ctx, const char *value, size_t len)
+{
+    FUN_IN;
+
+    if (!value) {
+        return NULL;
+    }
+
+    if (!len) {
+        len = strlen(value);
+    }
+
+    return dict_insert_cached(ctx, (char *)value, len, 0);
+}
+
+API const char *
+lydict_insert_zc(struct ly_ctx *ctx, char *value)
+{
+    FUN_IN;
+
+    if (!value) {
+        return NULL;
+    }
+
+    return dict_insert_cached(ctx, value, strlen(value), 1);
+}
+
+/*
+ * Control byte group operations. Each function returns a bitmask with bit i set
+ * if the i-th control byte of the group starting at \p ctrl satisfies the condition.
+ */
+#ifdef LYHT_SSE2
+
+static uint32_t
+lyht_group_match(const uint8_t *ctrl, uint8_t c)
+{
+    __m128i group = _mm_loadu_si128((const __m128i *)ctrl);
+
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8((char)c)));
 }
 
-API const char *
-lydict_insert(struct ly_ctx *ctx, const char *value, size_t len)
+static uint32_t
+lyht_group_match_free(const uint8_t *ctrl)
 {
-    FUN_IN;
+    /* both empty and deleted records have the highest bit set */
+    return (uint32_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)ctrl));
+}
 
-    const char *result;
+#else
 
-    if (!value) {
-        return NULL;
-    }
+static uint32_t
+lyht_group_match(const uint8_t *ctrl, uint8_t c)
+{
+    uint32_t i, mask = 0;
 
-    if (!len) {
-        len = strlen(value);
+    for (i = 0; i < LYHT_GROUP_WIDTH; ++i) {
+        mask |= (uint32_t)(ctrl[i] == c) << i;
     }
+    return mask;
+}
 
-    pthread_mutex_lock(&ctx->dict.lock);
-    result = dict_insert(ctx, (char *)value, len, 0);
-    pthread_mutex_unlock(&ctx->dict.lock);
+static uint32_t
+lyht_group_match_free(const uint8_t *ctrl)
+{
+    uint32_t i, mask = 0;
 
-    return result;
+    for (i = 0; i < LYHT_GROUP_WIDTH; ++i) {
+        mask |= (uint32_t)(ctrl[i] >> 7) << i;
+    }
+    return mask;
 }
 
-API const char *
-lydict_insert_zc(struct ly_ctx *ctx, char *value)
-{
-    FUN_IN;
+#endif
 
-    const char *result;
+/* bitmask of the group bits that belong to distinct records (tables smaller than a group see some records twice) */
+#define LYHT_GROUP_MASK(ht) (((ht)->size < LYHT_GROUP_WIDTH) ? ((1U << (ht)->size) - 1) : (uint32_t)((1ULL << LYHT_GROUP_WIDTH) - 1))
 
-    if (!value) {
-        return NULL;
+/* get 7 bits of a hash that are stored in the control byte, mix all the hash bits because the lower ones are used as index */
+#define LYHT_H2(hash) ((uint8_t)(((hash) * 0x9E3779B1U) >> 25))
+
+/**
+ * @brief Set control byte of a record, including its cloned copies at the end of the control array.
+ *
+ * @param[in] ht Hash table.
+ * @param[in] idx Index of the record.
+ * @param[in] c Control byte value.
+ */
+static void
+lyht_set_ctrl(struct hash_table *ht, uint32_t idx, uint8_t c)
+{
+    uint32_t i;
+
+    ht->ctrl[idx] = c;
+    for (i = idx; i < LYHT_GROUP_WIDTH - 1; i += ht->size) {
+        ht->ctrl[ht->size + i] = c;
     }
+}
+
+/**
+ * @brief Allocate records of a hash table. The hashes, values, and control bytes are all
+ * stored in a single memory block, in this order.
+ *
+ * @param[in] ht Hash table with set sizes.
+ * @return 0 on success, -1 on error.
+ */
+static int
+lyht_alloc_recs(struct hash_table *ht)
+{
+    size_t ctrl_offset;
 
-    pthread_mutex_lock(&ctx->dict.lock);
-    result = dict_insert(ctx, value, strlen(value), 1);
-    pthread_mutex_unlock(&ctx->dict.lock);
+    ctrl_offset = (size_t)ht->size * (sizeof *ht->hashes + ht->val_size);
+    ht->hashes = malloc(ctrl_offset + ht->size + LYHT_GROUP_WIDTH);
+    LY_CHECK_ERR_RETURN(!ht->hashes, LOGMEM(NULL), -1);
 
-    return result;
+    ht->vals = (unsigned char *)(ht->hashes + ht->size);
+    ht->ctrl = ((uint8_t *)ht->hashes) + ctrl_offset;
+    memset(ht->ctrl, LYHT_CTRL_EMPTY, ht->size + LYHT_GROUP_WIDTH);
+    return 0;
 }
 
-struct ht_rec *
-lyht_get_rec(unsigned char *recs, uint16_t rec_size, uint32_t idx)
+void *
+lyht_get_val(const struct hash_table *ht, uint32_t idx)
 {
-    return (struct ht_rec *)&recs[idx * rec_size];
+    if (ht->ctrl[idx] & LYHT_CTRL_FREE) {
+        return NULL;
+    }
+    return &ht->vals[(size_t)idx * ht->val_size];
 }
 
 struct hash_table *
@@ -296,15 +1059,23 @@ lyht_new(uint32_t size, uint16_t val_size, values_equal_cb val_equal, void *cb_d
     LY_CHECK_ERR_RETURN(!ht, LOGMEM(NULL), NULL);
 
     ht->used = 0;
+    ht->deleted = 0;
     ht->size = size;
     ht->val_equal = val_equal;
     ht->cb_data = cb_data;
     ht->resize = (uint16_t)resize;
+    ht->val_size = val_size;
+    ht->old = NULL;
+    ht->old_idx = 0;
+#ifdef LY_ENABLED_HT_STATS
+    ht->lookups = 0;
+    ht->probes = 0;
+    ht->max_probe = 0;
+    ht->resizes = 0;
+#endif
 
-    ht->rec_size = (sizeof(struct ht_rec) - 1) + val_size;
     /* allocate the records correctly */
-    ht->recs = calloc(size, ht->rec_size);
-    LY_CHECK_ERR_RETURN(!ht->recs, free(ht); LOGMEM(NULL), NULL);
+    LY_CHECK_ERR_RETURN(lyht_alloc_recs(ht), free(ht), NULL);
 
     return ht;
 }
@@ -316,6 +1087,9 @@ lyht_set_cb(struct hash_table *ht, values_equal_cb new_val_equal)
 
     prev = ht->val_equal;
     ht->val_equal = new_val_equal;
+    if (ht->old) {
+        ht->old->val_equal = new_val_equal;
+    }
     return prev;
 }
 
@@ -326,6 +1100,9 @@ lyht_set_cb_data(struct hash_table *ht, void *new_cb_data)
 
     prev = ht->cb_data;
     ht->cb_data = new_cb_data;
+    if (ht->old) {
+        ht->old->cb_data = new_cb_data;
+    }
     return prev;
 }
 
@@ -338,13 +1115,20 @@ lyht_dup(const struct hash_table *orig)
         return NULL;
     }
 
-    ht = lyht_new(orig->size, orig->rec_size - (sizeof(struct ht_rec) - 1), orig->val_equal, orig->cb_data, orig->resize ? 1 : 0);
+    ht = lyht_new(orig->size, orig->val_size, orig->val_equal, orig->cb_data, orig->resize ? 1 : 0);
     if (!ht) {
         return NULL;
     }
 
-    memcpy(ht->recs, orig->recs, (size_t)orig->used * (size_t)orig->rec_size);
+    memcpy(ht->hashes, orig->hashes, (size_t)orig->size * (sizeof *orig->hashes + orig->val_size) + orig->size + LYHT_GROUP_WIDTH);
     ht->used = orig->used;
+    ht->deleted = orig->deleted;
+    ht->resize = orig->resize;
+    if (orig->old) {
+        ht->old = lyht_dup(orig->old);
+        LY_CHECK_ERR_RETURN(!ht->old, lyht_free(ht), NULL);
+        ht->old_idx = orig->old_idx;
+    }
     return ht;
 }
 
@@ -352,253 +1136,429 @@ void
 lyht_free(struct hash_table *ht)
 {
     if (ht) {
-        free(ht->recs);
+        lyht_free(ht->old);
+        free(ht->hashes);
         free(ht);
     }
 }
 
+/**
+ * @brief Probe sequence state.
+ */
+struct lyht_probe {
+    uint32_t hash;   /* searched hash */
+    uint32_t pos;    /* index of the first record of the current group */
+    uint32_t probed; /* number of records in the already finished groups */
+    uint32_t match;  /* remaining matching records in the current group */
+    uint8_t h2;      /* control byte of the searched hash */
+};
+
+static void
+lyht_probe_init(const struct hash_table *ht, uint32_t hash, struct lyht_probe *probe)
+{
+    probe->hash = hash;
+    probe->h2 = LYHT_H2(hash);
+    probe->pos = hash & (ht->size - 1);
+    probe->probed = 0;
+    probe->match = lyht_group_match(ht->ctrl + probe->pos, probe->h2) & LYHT_GROUP_MASK(ht);
+}
+
+/**
+ * @brief Get next record with the searched hash.
+ *
+ * @param[in] ht Hash table.
+ * @param[in,out] probe Probe sequence state.
+ * @param[out] idx_p Index of the record.
+ * @return 0 on success, 1 if there are no more records with the hash.
+ */
 static int
-lyht_resize(struct hash_table *ht, int enlarge)
+lyht_probe_next(const struct hash_table *ht, struct lyht_probe *probe, uint32_t *idx_p)
 {
-    struct ht_rec *rec;
-    unsigned char *old_recs;
-    uint32_t i, old_size;
-    int ret;
+    uint32_t idx;
+
+    while (1) {
+        while (probe->match) {
+            idx = (probe->pos + __builtin_ctz(probe->match)) & (ht->size - 1);
+            probe->match &= probe->match - 1;
+            if (ht->hashes[idx] == probe->hash) {
+                *idx_p = idx;
+                return 0;
+            }
+        }
 
-    old_recs = ht->recs;
-    old_size = ht->size;
+        /* the searched value can be only in groups until there is an empty record */
+        if (lyht_group_match(ht->ctrl + probe->pos, LYHT_CTRL_EMPTY) & LYHT_GROUP_MASK(ht)) {
+            return 1;
+        }
+        probe->probed += LYHT_GROUP_WIDTH;
+        if (probe->probed >= ht->size) {
+            /* we went through all the records */
+            return 1;
+        }
 
-    if (enlarge) {
-        /* double the size */
-        ht->size <<= 1;
-    } else {
-        /* half the size */
-        ht->size >>= 1;
+        probe->pos = (probe->pos + LYHT_GROUP_WIDTH) & (ht->size - 1);
+        probe->match = lyht_group_match(ht->ctrl + probe->pos, probe->h2) & LYHT_GROUP_MASK(ht);
     }
+}
 
-    ht->recs = calloc(ht->size, ht->rec_size);
-    LY_CHECK_ERR_RETURN(!ht->recs, LOGMEM(NULL); ht->recs = old_recs; ht->size = old_size, -1);
-
-    /* reset used, it will increase again */
-    ht->used = 0;
+/**
+ * @brief Find a free (empty or deleted) record where a value with the hash can be inserted.
+ *
+ * @param[in] ht Hash table.
+ * @param[in] hash Hash of the value.
+ * @param[out] idx_p Index of the free record.
+ * @return 0 on success, 1 if the hash table is full.
+ */
+static int
+lyht_find_free(const struct hash_table *ht, uint32_t hash, uint32_t *idx_p)
+{
+    uint32_t pos, probed, mask;
 
-    /* add all the old records into the new records array */
-    for (i = 0; i < old_size; ++i) {
-        rec = lyht_get_rec(old_recs, ht->rec_size, i);
-        if (rec->hits > 0) {
-            ret = lyht_insert(ht, rec->val, rec->hash, NULL);
-            assert(!ret);
-            (void)ret;
+    pos = hash & (ht->size - 1);
+    for (probed = 0; probed < ht->size; probed += LYHT_GROUP_WIDTH) {
+        mask = lyht_group_match_free(ht->ctrl + pos) & LYHT_GROUP_MASK(ht);
+        if (mask) {
+            *idx_p = (pos + __builtin_ctz(mask)) & (ht->size - 1);
+            return 0;
         }
+        pos = (pos + LYHT_GROUP_WIDTH) & (ht->size - 1);
     }
 
-    /* final touches */
-    free(old_recs);
-    return 0;
+    return 1;
 }
 
-/* return: 0 - hash found, returned its record,
- *         1 - hash not found, returned the record where it would be inserted */
-static int
-lyht_find_first(struct hash_table *ht, uint32_t hash, struct ht_rec **rec_p)
+/**
+ * @brief Store a value into a free record.
+ */
+static void
+lyht_store(struct hash_table *ht, uint32_t idx, void *val_p, uint32_t hash)
 {
-    struct ht_rec *rec, *inval_rec = NULL;
-    uint32_t i, idx;
-
-    if (rec_p) {
-        *rec_p = NULL;
+    if (ht->ctrl[idx] == LYHT_CTRL_DELETED) {
+        --ht->deleted;
     }
+    lyht_set_ctrl(ht, idx, LYHT_H2(hash));
+    ht->hashes[idx] = hash;
+    memcpy(&ht->vals[(size_t)idx * ht->val_size], val_p, ht->val_size);
+    ++ht->used;
+}
+
+/**
+ * @brief Move values from the previous records of an incrementally enlarged table into its records.
+ *
+ * @param[in] ht Hash table with previous records.
+ * @param[in] count Number of previous records to process.
+ */
+static void
+lyht_move_old(struct hash_table *ht, uint32_t count)
+{
+    struct hash_table *old = ht->old;
+    uint32_t i, idx;
+    int ret;
 
-    idx = i = hash & (ht->size - 1);
-    rec = lyht_get_rec(ht->recs, ht->rec_size, idx);
+    for (i = ht->old_idx; count && (i < old->size); --count, ++i) {
+        if (!(old->ctrl[i] & LYHT_CTRL_FREE)) {
+            ret = lyht_find_free(ht, old->hashes[i], &idx);
+            assert(!ret);
+            (void)ret;
+            lyht_store(ht, idx, &old->vals[(size_t)i * old->val_size], old->hashes[i]);
+            /* the value was already counted */
+            --ht->used;
 
-    /* skip through overflow and deleted records */
-    while ((rec->hits != 0) && ((rec->hits == -1) || ((rec->hash & (ht->size - 1)) != idx))) {
-        if ((rec->hits == -1) && !inval_rec) {
-            /* remember the first invalid record we found while searching for this hash */
-            inval_rec = rec;
-        }
-        i = (i + 1) % ht->size;
-        if (i == idx) {
-            /* we went through all the records (very unlikely, but possible when many records are invalid),
-             * just return not found */
-            assert(inval_rec);
-            if (rec_p) {
-                *rec_p = inval_rec;
-            }
-            return 1;
+            /* it must not be found in the previous records anymore, keep their probe sequences */
+            lyht_set_ctrl(old, i, LYHT_CTRL_DELETED);
+            --old->used;
         }
-        rec = lyht_get_rec(ht->recs, ht->rec_size, i);
     }
-
-    if (rec->hits == 0) {
-        /* we could not find the value */
-        if (rec_p) {
-            /* return the first empty (or invalid) record found */
-            *rec_p = inval_rec ? inval_rec : rec;
-        }
-        return 1;
+    ht->old_idx = i;
+
+    if (ht->old_idx == old->size) {
+        /* all moved */
+        assert(!old->used);
+        lyht_free(old);
+        ht->old = NULL;
+        ht->old_idx = 0;
     }
+}
 
-    /* we have found a record with equal (shortened) hash,
-     * move it to the first invalid record so that the next search is faster */
-    if (inval_rec) {
-        memcpy(inval_rec, rec, ht->rec_size);
-        rec->hits = -1;
-        rec = inval_rec;
+void
+lyht_finish_resize(struct hash_table *ht)
+{
+    if (ht->old) {
+        lyht_move_old(ht, ht->old->size);
     }
-    if (rec_p) {
-        *rec_p = rec;
+}
+
+/**
+ * @brief Start enlarging a table incrementally, its current records become the previous
+ * records and the values are going to be moved from them by the following operations.
+ *
+ * @param[in] ht Hash table without previous records.
+ * @param[in] new_size New size of \p ht.
+ * @return 0 on success, -1 on error.
+ */
+static int
+lyht_resize_start(struct hash_table *ht, uint32_t new_size)
+{
+    struct hash_table *old;
+
+    assert(!ht->old);
+
+    old = malloc(sizeof *old);
+    LY_CHECK_ERR_RETURN(!old, LOGMEM(NULL), -1);
+    *old = *ht;
+    old->resize = 0;
+
+    ht->size = new_size;
+    if (lyht_alloc_recs(ht)) {
+        *ht = *old;
+        free(old);
+        return -1;
     }
+
+    /* all the values are still in the previous records */
+    ht->deleted = 0;
+    ht->old = old;
+    ht->old_idx = 0;
+    ++ly_cnt.ht_resizes;
+#ifdef LY_ENABLED_HT_STATS
+    ++ht->resizes;
+#endif
     return 0;
 }
 
 /**
- * @brief Search for the next collision.
+ * @brief Rehash all the values into new records, which also removes all the deleted records.
  *
- * @param[in] ht Hash table to search in.
- * @param[in,out] last Last returned collision record.
- * @param[in] first First collision record (hits > 1).
- * @return 0 when hash collision found, \p last points to this next collision,
- *         1 when hash collision not found, \p last points to the record where it would be inserted.
+ * @param[in] ht Hash table.
+ * @param[in] new_size New size of \p ht, can be the same as the current one.
+ * @return 0 on success, -1 on error.
  */
 static int
-lyht_find_collision(struct hash_table *ht, struct ht_rec **last, struct ht_rec *first)
+lyht_resize(struct hash_table *ht, uint32_t new_size)
 {
-    struct ht_rec *inval_rec = NULL;
-    uint32_t i, idx;
+    uint32_t *old_hashes;
+    unsigned char *old_vals;
+    uint8_t *old_ctrl;
+    uint32_t i, idx, old_size;
+    int ret;
 
-    assert(last && *last);
+    /* rehash only the records of this table */
+    lyht_finish_resize(ht);
 
-    idx = (*last)->hash & (ht->size - 1);
-    i = (((unsigned char *)*last) - ht->recs) / ht->rec_size;
+    old_hashes = ht->hashes;
+    old_vals = ht->vals;
+    old_ctrl = ht->ctrl;
+    old_size = ht->size;
 
-    do {
-        i = (i + 1) % ht->size;
-        *last = lyht_get_rec(ht->recs, ht->rec_size, i);
-        if (*last == first) {
-            /* we went through all the records (very unlikely, but possible when many records are invalid),
-             * just return an invalid record */
-            assert(inval_rec);
-            *last = inval_rec;
-            return 1;
-        }
+    ht->size = new_size;
+    if (lyht_alloc_recs(ht)) {
+        ht->hashes = old_hashes;
+        ht->vals = old_vals;
+        ht->ctrl = old_ctrl;
+        ht->size = old_size;
+        return -1;
+    }
 
-        if (((*last)->hits == -1) && !inval_rec) {
-            inval_rec = *last;
-        }
-    } while (((*last)->hits != 0) && (((*last)->hits == -1) || (((*last)->hash & (ht->size - 1)) != idx)));
+    /* reset used, it will increase again, deleted records are not copied */
+    ht->used = 0;
+    ht->deleted = 0;
 
-    if ((*last)->hits > 0) {
-        /* we found a collision, so move it to the first invalid record so the next search is faster */
-        assert((*last)->hits == 1);
-        if (inval_rec) {
-            memcpy(inval_rec, *last, ht->rec_size);
-            (*last)->hits = -1;
-            *last = inval_rec;
+    /* add all the old records into the new records array, they are all different */
+    for (i = 0; i < old_size; ++i) {
+        if (!(old_ctrl[i] & LYHT_CTRL_FREE)) {
+            ret = lyht_find_free(ht, old_hashes[i], &idx);
+            assert(!ret);
+            (void)ret;
+            lyht_store(ht, idx, &old_vals[(size_t)i * ht->val_size], old_hashes[i]);
         }
-        return 0;
     }
 
-    /* no next collision found, return the record where it would be inserted */
-    if (inval_rec) {
-        *last = inval_rec;
-    } /* else (*last)->hits == 0, it is already correct */
-    return 1;
+    /* final touches */
+    free(old_hashes);
+    ++ly_cnt.ht_resizes;
+#ifdef LY_ENABLED_HT_STATS
+    ++ht->resizes;
+#endif
+    return 0;
 }
 
 int
-lyht_find(struct hash_table *ht, void *val_p, uint32_t hash, void **match_p)
+lyht_reserve(struct hash_table *ht, uint32_t count)
 {
-    struct ht_rec *rec, *crec;
-    uint32_t i, c;
-    int r;
+    uint32_t new_size;
 
-    if (lyht_find_first(ht, hash, &rec)) {
-        /* not found */
-        return 1;
+    assert(ht->resize);
+
+    new_size = ht->size;
+    while (((uint64_t)count * 100) / new_size >= LYHT_ENLARGE_PERCENTAGE) {
+        new_size <<= 1;
     }
-    if ((rec->hash == hash) && ht->val_equal(val_p, &rec->val, 0, ht->cb_data)) {
-        /* even the value matches */
-        if (match_p) {
-            *match_p = rec->val;
+
+    if (new_size > ht->size) {
+        if (lyht_resize(ht, new_size)) {
+            return -1;
         }
+
+        /* do not shrink before the reserved values are inserted */
+        ht->resize = 1;
+    }
+
+    return 0;
+}
+
+#ifdef LY_ENABLED_HT_STATS
+
+/**
+ * @brief Count a finished lookup in the hash table statistics.
+ *
+ * @param[in] ht Hash table.
+ * @param[in] probe Probe sequence state of the lookup.
+ */
+static void
+lyht_count_lookup(struct hash_table *ht, const struct lyht_probe *probe)
+{
+    uint32_t groups;
+
+    groups = (probe->probed / LYHT_GROUP_WIDTH) + 1;
+    ++ht->lookups;
+    ht->probes += groups;
+    if (groups > ht->max_probe) {
+        ht->max_probe = groups;
+    }
+}
+
+#else
+# define lyht_count_lookup(ht, probe)
+#endif
+
+void
+lyht_add_stats(const struct hash_table *ht, struct ly_ht_stats *stats)
+{
+    stats->used += ht->used;
+    stats->size += ht->size;
+    stats->deleted += ht->deleted;
+    if (ht->old) {
+        stats->size += ht->old->size;
+        stats->deleted += ht->old->deleted;
+    }
+#ifdef LY_ENABLED_HT_STATS
+    stats->lookups += ht->lookups;
+    stats->probes += ht->probes;
+    if (ht->max_probe > stats->max_probe) {
+        stats->max_probe = ht->max_probe;
+    }
+    stats->resizes += ht->resizes;
+#endif
+}
+
+size_t
+lyht_mem_size(const struct hash_table *ht)
+{
+    if (!ht) {
         return 0;
     }
 
-    /* some collisions, we need to go through them, too */
-    crec = rec;
-    c = rec->hits;
-    for (i = 1; i < c; ++i) {
-        r = lyht_find_collision(ht, &rec, crec);
-        assert(!r);
-        (void)r;
+    return sizeof *ht + (size_t)ht->size * (sizeof *ht->hashes + ht->val_size) + ht->size + LYHT_GROUP_WIDTH
+            + lyht_mem_size(ht->old);
+}
 
-        /* compare values */
-        if ((rec->hash == hash) && ht->val_equal(val_p, &rec->val, 0, ht->cb_data)) {
-            if (match_p) {
-                *match_p = rec->val;
+/**
+ * @brief Find the record of a value, also in the previous records of an incrementally enlarged table.
+ *
+ * @param[in] ht Hash table.
+ * @param[in] val_p Pointer to the value to find.
+ * @param[in] hash Hash of the value.
+ * @param[in] mod Whether the operation modifies the hash table, passed to the callback.
+ * @param[in] val_equal Callback for checking value equivalence.
+ * @param[out] rec_ht_p Table with the found record, \p ht or its previous records.
+ * @param[out] idx_p Index of the found record.
+ * @return 0 on success, 1 on not found.
+ */
+static int
+lyht_find_rec(struct hash_table *ht, void *val_p, uint32_t hash, int mod, values_equal_cb val_equal,
+              struct hash_table **rec_ht_p, uint32_t *idx_p)
+{
+    struct hash_table *rec_ht;
+    struct lyht_probe probe;
+    uint32_t idx;
+
+    for (rec_ht = ht; rec_ht; rec_ht = rec_ht->old) {
+        lyht_probe_init(rec_ht, hash, &probe);
+        while (!lyht_probe_next(rec_ht, &probe, &idx)) {
+            if (val_equal(val_p, &rec_ht->vals[(size_t)idx * ht->val_size], mod, ht->cb_data)) {
+                *rec_ht_p = rec_ht;
+                *idx_p = idx;
+                lyht_count_lookup(ht, &probe);
+                return 0;
             }
-            return 0;
         }
+        lyht_count_lookup(ht, &probe);
     }
 
-    /* not found even in collisions */
     return 1;
 }
 
 int
-lyht_find_next(struct hash_table *ht, void *val_p, uint32_t hash, void **match_p)
+lyht_find(struct hash_table *ht, void *val_p, uint32_t hash, void **match_p)
 {
-    struct ht_rec *rec, *crec;
-    uint32_t i, c;
-    int r, found = 0;
-
-    if (lyht_find_first(ht, hash, &rec)) {
-        /* not found, cannot happen */
-        assert(0);
-    }
+    return lyht_find_with_cb(ht, val_p, hash, ht->val_equal, match_p);
+}
 
-    if ((rec->hash == hash) && ht->val_equal(val_p, &rec->val, 1, ht->cb_data)) {
-        /* previously returned value */
-        found = 1;
-    }
+int
+lyht_find_with_cb(struct hash_table *ht, void *val_p, uint32_t hash, values_equal_cb val_equal, void **match_p)
+{
+    struct hash_table *rec_ht;
+    uint32_t idx;
 
-    if (rec->hits == 1) {
-        /* there are no more similar values */
-        assert(rec->hash == hash);
-        assert(found);
+    if (lyht_find_rec(ht, val_p, hash, 0, val_equal, &rec_ht, &idx)) {
+        /* not found */
         return 1;
     }
 
-    /* go through collisions and find next one after the previous one */
-    crec = rec;
-    c = rec->hits;
-    for (i = 1; i < c; ++i) {
-        r = lyht_find_collision(ht, &rec, crec);
-        assert(!r);
-        (void)r;
+    if (match_p) {
+        *match_p = &rec_ht->vals[(size_t)idx * ht->val_size];
+    }
+    return 0;
+}
 
-        if (rec->hash != hash) {
-            /* a normal collision, we are not interested in those */
-            continue;
-        }
+int
+lyht_find_next(struct hash_table *ht, void *val_p, uint32_t hash, void **match_p)
+{
+    struct lyht_probe probe;
+    uint32_t idx;
+    int found = 0;
 
+    /* values with equal hashes are always returned in the order of the probe sequence */
+    lyht_probe_init(ht, hash, &probe);
+    while (!lyht_probe_next(ht, &probe, &idx)) {
         if (found) {
             /* next value with equal hash, found our value */
             if (match_p) {
-                *match_p = rec->val;
+                *match_p = &ht->vals[(size_t)idx * ht->val_size];
             }
             return 0;
         }
 
-        if (!ht->val_equal(val_p, &rec->val, 1, ht->cb_data)) {
-            /* already returned value, skip */
-            continue;
+        if (ht->val_equal(val_p, &ht->vals[(size_t)idx * ht->val_size], 1, ht->cb_data)) {
+            /* this one was returned previously, continue looking */
+            found = 1;
+        }
+    }
+
+    if (ht->old) {
+        if (!found) {
+            /* the previous value was not moved yet */
+            return lyht_find_next(ht->old, val_p, hash, match_p);
         }
 
-        /* this one was returned previously, continue looking */
-        found = 1;
+        /* continue with the first value with equal hash in the previous records */
+        lyht_probe_init(ht->old, hash, &probe);
+        if (!lyht_probe_next(ht->old, &probe, &idx)) {
+            if (match_p) {
+                *match_p = &ht->old->vals[(size_t)idx * ht->old->val_size];
+            }
+            return 0;
+        }
     }
 
     /* the last equal value was already returned */
@@ -608,16 +1568,14 @@ lyht_find_next(struct hash_table *ht, void *val_p, uint32_t hash, void **match_p
 
 /* prints little-endian numbers, will also work on big-endian just the values will look weird */
 static char *
-lyht_dbgprint_val2str(void *val_p, int32_t hits, uint16_t rec_size)
+lyht_dbgprint_val2str(void *val_p, int filled, uint16_t val_size)
 {
     char *val;
-    int32_t i, j, val_size;
-
-    val_size = rec_size - (sizeof(struct ht_rec) - 1);
+    int32_t i, j;
 
     val = malloc(val_size * 2 + 1);
     for (i = 0, j = val_size - 1; i < val_size; ++i, --j) {
-        if (hits > 0) {
+        if (filled) {
             sprintf(val + i * 2, "%02x", *(((uint8_t *)val_p) + j));
         } else {
             sprintf(val + i * 2, "  ");
@@ -630,7 +1588,6 @@ lyht_dbgprint_val2str(void *val_p, int32_t hits, uint16_t rec_size)
 static void
 lyht_dbgprint_ht(struct hash_table *ht, const char *info)
 {
-    struct ht_rec *rec;
     uint32_t i, i_len;
     char *val;
 
@@ -639,7 +1596,7 @@ lyht_dbgprint_ht(struct hash_table *ht, const char *info)
     }
 
     LOGDBG(LY_LDGHASH, "");
-    LOGDBG(LY_LDGHASH, "hash table %s (used %u, size %u):", info, ht->used, ht->size);
+    LOGDBG(LY_LDGHASH, "hash table %s (used %u, deleted %u, size %u):", info, ht->used, ht->deleted, ht->size);
 
     val = malloc(11);
     sprintf(val, "%u", ht->size);
@@ -647,14 +1604,13 @@ lyht_dbgprint_ht(struct hash_table *ht, const char *info)
     free(val);
 
     for (i = 0; i < ht->size; ++i) {
-        rec = lyht_get_rec(ht->recs, ht->rec_size, i);
-        val = lyht_dbgprint_val2str(&rec->val, rec->hits, ht->rec_size);
-        if (rec->hits > 0) {
-            LOGDBG(LY_LDGHASH, "[%*u] val  %s  hash  %10u %% %*u  hits  %2d",
-                   (int)i_len, i, val, rec->hash, (int)i_len, rec->hash & (ht->size - 1), rec->hits);
+        val = lyht_dbgprint_val2str(&ht->vals[(size_t)i * ht->val_size], !(ht->ctrl[i] & LYHT_CTRL_FREE), ht->val_size);
+        if (!(ht->ctrl[i] & LYHT_CTRL_FREE)) {
+            LOGDBG(LY_LDGHASH, "[%*u] val  %s  hash  %10u %% %*u  ctrl  %02x",
+                   (int)i_len, i, val, ht->hashes[i], (int)i_len, ht->hashes[i] & (ht->size - 1), ht->ctrl[i]);
         } else {
-            LOGDBG(LY_LDGHASH, "[%*u] val  %s  hash  %10s %% %*s  hits  %2d",
-                   (int)i_len, i, val, "", (int)i_len, "", rec->hits);
+            LOGDBG(LY_LDGHASH, "[%*u] val  %s  hash  %10s %% %*s  ctrl  %02x",
+                   (int)i_len, i, val, "", (int)i_len, "", ht->ctrl[i]);
         }
         free(val);
     }
@@ -662,13 +1618,13 @@ lyht_dbgprint_ht(struct hash_table *ht, const char *info)
 }
 
 static void
-lyht_dbgprint_value(void *val_p, uint32_t hash, uint16_t rec_size, const char *operation)
+lyht_dbgprint_value(void *val_p, uint32_t hash, uint16_t val_size, const char *operation)
 {
     if (LY_LLDBG > ly_log_level) {
         return;
     }
 
-    char *val = lyht_dbgprint_val2str(val_p, 1, rec_size);
+    char *val = lyht_dbgprint_val2str(val_p, 1, val_size);
     LOGDBG(LY_LDGHASH, "%s value %s with hash %u", operation, val, hash);
     free(val);
 }
@@ -677,77 +1633,66 @@ int
 lyht_insert_with_resize_cb(struct hash_table *ht, void *val_p, uint32_t hash,
                            values_equal_cb resize_val_equal, void **match_p)
 {
-    struct ht_rec *rec, *crec = NULL;
-    int32_t i;
+    struct hash_table *rec_ht;
+    uint32_t idx, new_size;
     int r, ret;
-    values_equal_cb old_val_equal;
+    values_equal_cb old_val_equal = NULL;
 
     lyht_dbgprint_ht(ht, "before");
-    lyht_dbgprint_value(val_p, hash, ht->rec_size, "inserting");
-
-    if (!lyht_find_first(ht, hash, &rec)) {
-        /* we found matching shortened hash */
-        if ((rec->hash == hash) && ht->val_equal(val_p, &rec->val, 1, ht->cb_data)) {
-            /* even the value matches */
-            if (match_p) {
-                *match_p = (void *)&rec->val;
-            }
-            return 1;
-        }
-
-        /* some collisions, we need to go through them, too */
-        crec = rec;
-        for (i = 1; i < crec->hits; ++i) {
-            r = lyht_find_collision(ht, &rec, crec);
-            assert(!r);
+    lyht_dbgprint_value(val_p, hash, ht->val_size, "inserting");
 
-            /* compare values */
-            if ((rec->hash == hash) && ht->val_equal(val_p, &rec->val, 1, ht->cb_data)) {
-                if (match_p) {
-                    *match_p = (void *)&rec->val;
-                }
-                return 1;
-            }
+    /* check whether the value is not already inserted */
+    if (!lyht_find_rec(ht, val_p, hash, 1, ht->val_equal, &rec_ht, &idx)) {
+        if (match_p) {
+            *match_p = &rec_ht->vals[(size_t)idx * ht->val_size];
         }
-
-        /* value not found, get the record where it will be inserted */
-        r = lyht_find_collision(ht, &rec, crec);
-        assert(r);
+        return 1;
     }
 
-    /* insert it into the returned record */
-    assert(rec->hits < 1);
-    rec->hash = hash;
-    rec->hits = 1;
-    memcpy(&rec->val, val_p, ht->rec_size - (sizeof(struct ht_rec) - 1));
+    /* insert it into a free record */
+    if (lyht_find_free(ht, hash, &idx)) {
+        /* full hash table that cannot be resized */
+        LOGINT(NULL);
+        return -1;
+    }
+    lyht_store(ht, idx, val_p, hash);
     if (match_p) {
-        *match_p = (void *)&rec->val;
+        *match_p = &ht->vals[(size_t)idx * ht->val_size];
     }
 
-    if (crec) {
-        /* there was a collision, increase hits */
-        if (crec->hits == INT32_MAX) {
-            LOGINT(NULL);
-        }
-        ++crec->hits;
+    if (ht->old) {
+        /* continue moving the previous values, the inserted one stays where it is */
+        lyht_move_old(ht, LYHT_INCREMENTAL_STEP);
     }
 
     /* check size & enlarge if needed */
     ret = 0;
-    ++ht->used;
     if (ht->resize) {
+        new_size = 0;
         r = (ht->used * 100) / ht->size;
         if ((ht->resize == 1) && (r >= LYHT_FIRST_SHRINK_PERCENTAGE)) {
             /* enable shrinking */
             ht->resize = 2;
         }
         if ((ht->resize == 2) && (r >= LYHT_ENLARGE_PERCENTAGE)) {
+            /* enlarge (double the size) */
+            new_size = ht->size << 1;
+        } else if ((((ht->used + ht->deleted) * 100) / ht->size) >= LYHT_ENLARGE_PERCENTAGE) {
+            /* there are too many deleted records making the probe sequences long, compact the table */
+            new_size = ht->size;
+        }
+
+        if (new_size) {
             if (resize_val_equal) {
                 old_val_equal = lyht_set_cb(ht, resize_val_equal);
             }
 
-            /* enlarge */
-            ret = lyht_resize(ht, 1);
+            if ((new_size > ht->size) && (ht->size >= LYHT_INCREMENTAL_SIZE) && !ht->old) {
+                /* the values are going to be moved gradually */
+                ret = lyht_resize_start(ht, new_size);
+            } else {
+                ret = lyht_resize(ht, new_size);
+            }
             /* if hash_table was resized, we need to find new matching value */
             if (ret == 0 && match_p) {
                 lyht_find(ht, val_p, hash, match_p);
@@ -769,68 +1714,80 @@ lyht_insert(struct hash_table *ht, void *val_p, uint32_t hash, void **match_p)
     return lyht_insert_with_resize_cb(ht, val_p, hash, NULL, match_p);
 }
 
-int
-lyht_remove(struct hash_table *ht, void *val_p, uint32_t hash)
+/**
+ * @brief Check whether a record was always in a group with an empty record. Probing stops
+ * on such groups so the record can be marked empty instead of deleted when removing its value.
+ *
+ * @param[in] ht Hash table.
+ * @param[in] idx Index of the record.
+ * @return non-zero if there is no group of non-empty records containing \p idx, 0 otherwise.
+ */
+static int
+lyht_was_never_full(const struct hash_table *ht, uint32_t idx)
 {
-    struct ht_rec *rec, *crec;
-    int32_t i;
-    int first_matched = 0, r, ret;
+    uint32_t before, after;
 
-    lyht_dbgprint_ht(ht, "before");
-    lyht_dbgprint_value(val_p, hash, ht->rec_size, "removing");
-
-    if (lyht_find_first(ht, hash, &rec)) {
-        /* hash not found */
-        LOGDBG(LY_LDGHASH, "remove failed");
+    if (ht->size <= LYHT_GROUP_WIDTH) {
+        /* the whole table is always probed as a single group */
         return 1;
     }
-    if ((rec->hash == hash) && ht->val_equal(val_p, &rec->val, 1, ht->cb_data)) {
-        /* even the value matches */
-        first_matched = 1;
-    }
 
-    /* we always need to go through collisions */
-    crec = rec;
-    for (i = 1; i < crec->hits; ++i) {
-        r = lyht_find_collision(ht, &rec, crec);
-        assert(!r);
-
-        /* compare values */
-        if (!first_matched && (rec->hash == hash) && ht->val_equal(val_p, &rec->val, 1, ht->cb_data)) {
+    /* count the non-empty records right before and right after idx */
+    for (before = 0; before < LYHT_GROUP_WIDTH; ++before) {
+        if (ht->ctrl[(idx - before - 1) & (ht->size - 1)] == LYHT_CTRL_EMPTY) {
             break;
         }
     }
-
-    if (i < crec->hits) {
-        /* one of collisions matched, reduce collision count, remove the record */
-        assert(!first_matched);
-        --crec->hits;
-        rec->hits = -1;
-    } else if (first_matched) {
-        /* the first record matches */
-        if (crec != rec) {
-            /* ... and there are some collisions so put the last collision in its place keeping the correct collision count */
-            rec->hits = crec->hits - 1;
-            memcpy(crec, rec, ht->rec_size);
+    for (after = 0; after < LYHT_GROUP_WIDTH; ++after) {
+        if (ht->ctrl[(idx + after + 1) & (ht->size - 1)] == LYHT_CTRL_EMPTY) {
+            break;
         }
+    }
 
-        /* this matching record was removed and is not valid anymore */
-        rec->hits = -1;
-    } else {
-        /* value not found even in collisions */
-        assert(!first_matched);
+    return (before + 1 + after) < LYHT_GROUP_WIDTH;
+}
+
+int
+lyht_remove(struct hash_table *ht, void *val_p, uint32_t hash)
+{
+    struct hash_table *rec_ht;
+    uint32_t idx;
+    int r, ret;
+
+    lyht_dbgprint_ht(ht, "before");
+    lyht_dbgprint_value(val_p, hash, ht->val_size, "removing");
+
+    if (lyht_find_rec(ht, val_p, hash, 1, ht->val_equal, &rec_ht, &idx)) {
+        /* value not found */
         LOGDBG(LY_LDGHASH, "remove failed");
         return 1;
     }
 
+    /* this matching record was removed and is not valid anymore */
+    if (lyht_was_never_full(rec_ht, idx)) {
+        /* no probe sequence could have continued past this record, there is no need for a tombstone */
+        lyht_set_ctrl(rec_ht, idx, LYHT_CTRL_EMPTY);
+    } else {
+        lyht_set_ctrl(rec_ht, idx, LYHT_CTRL_DELETED);
+        ++rec_ht->deleted;
+    }
+    if (rec_ht != ht) {
+        --rec_ht->used;
+    }
+
+    if (ht->old) {
+        /* continue moving the previous values */
+        lyht_move_old(ht, LYHT_INCREMENTAL_STEP);
+    }
+
     /* check size & shrink if needed */
     ret = 0;
     --ht->used;
     if (ht->resize == 2) {
         r = (ht->used * 100) / ht->size;
         if ((r < LYHT_SHRINK_PERCENTAGE) && (ht->size > LYHT_MIN_SIZE)) {
-            /* shrink */
-            ret = lyht_resize(ht, 0);
+            /* shrink (half the size) */
+            ret = lyht_resize(ht, ht->size >> 1);
         }
     }
 
@@ -32,6 +32,14 @@
  */
 uint32_t dict_hash_multi(uint32_t hash, const char *key_part, size_t len);
 
+/**
+ * @brief Compute hash from (several) string(s) using Bob Jenkin's one-at-a-time hash.
+ *
+ * Its results are stored in LYB data (schema hashes, see lyb_hash()) so it must never change,
+ * use dict_hash_multi() for anything else. Usage is the same as for dict_hash_multi().
+ */
+uint32_t dict_hash_oaat_multi(uint32_t hash, const char *key_part, size_t len);
+
 /**
  * @brief Callback for checking hash table values equivalence.
  *
@@ -43,7 +51,8 @@ uint32_t dict_hash_multi(uint32_t hash, const char *key_part, size_t len);
  */
 typedef int (*values_equal_cb)(void *val1_p, void *val2_p, int mod, void *cb_data);
 
-/** when the table is at least this much percent full, it is enlarged (double the size) */
+/** when the table is at least this much percent full, it is enlarged (double the size),
+ * if only together with the deleted records, it is rehashed to drop them */
 #define LYHT_ENLARGE_PERCENTAGE 75
 
 /** only once the table is this much percent full, enable shrinking */
@@ -55,54 +64,154 @@ typedef int (*values_equal_cb)(void *val1_p, void *val2_p, int mod, void *cb_dat
 /** never shrink beyond this size */
 #define LYHT_MIN_SIZE 8
 
-/**
- * @brief Generic hash table record.
+/** tables of at least this size are enlarged incrementally, the records are moved into the new records
+ * gradually by the following operations instead of all at once */
+#define LYHT_INCREMENTAL_SIZE 8192
+
+/** number of records moved by each insert or remove of an incrementally enlarged table */
+#define LYHT_INCREMENTAL_STEP 16
+
+/*
+ * Hash table record control byte values. A filled record has the highest bit
+ * cleared and the remaining 7 bits hold some of its hash bits.
  */
-struct ht_rec {
-    uint32_t hash;        /* hash of the value */
-    int32_t hits;         /* (collision/overflow value count - 1) (a filled entry has 1 hit),
-                           * special value (-1) means a deleted record) */
-    unsigned char val[1]; /* arbitrary-size value */
-} _PACKED;
+#define LYHT_CTRL_EMPTY 0x80   /* empty record */
+#define LYHT_CTRL_DELETED 0xfe /* removed record */
+#define LYHT_CTRL_FREE 0x80    /* mask of the bit set for both empty and deleted records */
+
+/* number of control bytes probed at once */
+#ifdef __SSE2__
+# define LYHT_SSE2
+# define LYHT_GROUP_WIDTH 16
+#else
+# define LYHT_GROUP_WIDTH 8
+#endif
 
 /**
  * @brief (Very) generic hash table.
  *
- * Hash table with open addressing collision resolution and
- * linear probing of interval 1 (next free record is used).
- * Removal is lazy (removed records are only marked).
+ * Hash table with open addressing collision resolution and linear probing
+ * of whole groups of records. Records are split into 3 parallel arrays: one control
+ * byte per record (probed a group at a time), full 32-bit hashes, and the values.
+ * Removal is lazy (removed records are only marked) unless no probe sequence could have
+ * passed the record, and the deleted records are dropped by rehashing the table once
+ * they make it too full. Large tables are enlarged incrementally, the previous records
+ * are kept and searched as well until all their values are moved.
  */
 struct hash_table {
     uint32_t used;        /* number of values stored in the hash table (filled records) */
     uint32_t size;        /* always holds 2^x == size (is power of 2), actually number of records allocated */
+    uint32_t deleted;     /* number of removed (deleted) records */
     values_equal_cb val_equal; /* callback for testing value equivalence */
     void *cb_data;        /* user data callback arbitrary value */
     uint16_t resize;      /* 0 - resizing is disabled, *
                            * 1 - enlarging is enabled, *
                            * 2 - both shrinking and enlarging is enabled */
-    uint16_t rec_size;    /* real size (in bytes) of one record for accessing recs array */
-    unsigned char *recs;  /* pointer to the hash table itself (array of struct ht_rec) */
+    uint16_t val_size;    /* size (in bytes) of one value for accessing vals array */
+    uint32_t *hashes;     /* array of the record hashes, the other arrays are allocated in the same block */
+    unsigned char *vals;  /* array of the record values */
+    uint8_t *ctrl;        /* array of the record control bytes, the first (LYHT_GROUP_WIDTH - 1)
+                           * bytes are repeated at its end so that any group can be read at once */
+    struct hash_table *old; /* previous records being moved into this table after an incremental enlargement,
+                             * their values are included in used, NULL if there are none */
+    uint32_t old_idx;     /* index of the next record in old to be moved */
+#ifdef LY_ENABLED_HT_STATS
+    uint64_t lookups;     /* number of value lookups */
+    uint64_t probes;      /* number of groups probed by the lookups */
+    uint32_t max_probe;   /* maximal number of groups probed by a lookup */
+    uint32_t resizes;     /* number of rehashes */
+#endif
 };
 
 struct dict_rec {
     char *value;
     uint32_t refcount;
-} _PACKED;
+};
 
 /**
- * dictionary to store repeating strings
+ * Flags stored in the byte following the terminating NULL byte of every dictionary string.
  */
-struct dict_table {
+#define LYDICT_PLAIN 0x01 /**< the string contains no characters escaped by the XML or JSON printers */
+
+/**
+ * @brief Learn whether a string stored in the dictionary contains no characters escaped by the printers.
+ *
+ * @param[in] value Dictionary string or its suffix.
+ * @param[in] len Length of \p value.
+ */
+#define lydict_plain(value, len) ((value)[(len) + 1] & LYDICT_PLAIN)
+
+/** number of hash bits selecting the dictionary shard in the sharded mode (#LY_CTX_DICT_SHARDED) */
+#define LYDICT_SHARD_BITS 4
+
+/** starting size of the dictionary hash table (of all the shards together) */
+#define LYDICT_INIT_SIZE 1024
+
+/** number of records in the thread dictionary insert cache (power of 2) */
+#define LYDICT_CACHE_SIZE 64
+
+/** maximum number of strings in the thread dictionary release batch */
+#define LYDICT_RELEASE_BATCH 256
+
+/**
+ * @brief Dictionary shard, part of the dictionary with its own lock.
+ */
+struct dict_shard {
     struct hash_table *hash_tab;
     pthread_mutex_t lock;
 };
 
+/** minimal size of a memory chunk storing the immortal dictionary strings */
+#define LYDICT_CHUNK_SIZE 4096
+
+/**
+ * @brief Record of the immortal dictionary strings, the length is stored so
+ * that the records can be compared without any data set in the hash table.
+ */
+struct dict_immortal_rec {
+    char *value;
+    size_t len;
+};
+
+/**
+ * @brief Memory chunk storing the immortal dictionary strings.
+ */
+struct dict_chunk {
+    struct dict_chunk *next;
+    size_t used;
+    size_t size;
+    char data[];
+};
+
+/**
+ * @brief Immortal part of the dictionary (#LY_CTX_DICT_IMMORTAL). Holds the strings inserted while parsing schemas,
+ * which are never removed before the context is destroyed and so are not reference counted. It is searched without
+ * any lock, it must not be modified (no schema can be parsed) while another thread works with the context.
+ */
+struct dict_immortal {
+    struct hash_table *hash_tab; /* NULL if the immortal strings are not used */
+    struct dict_chunk *chunks;   /* chunks storing the strings, the first one is the last allocated */
+    pthread_mutex_t lock;        /* lock for modifying the immortal strings */
+};
+
+/**
+ * dictionary to store repeating strings
+ */
+struct dict_table {
+    struct dict_shard *shards; /* array of 2^shard_bits shards, a string belongs to the shard given by its hash */
+    uint8_t shard_bits;        /* 0 for a single shard (one global lock), LYDICT_SHARD_BITS if sharded */
+    struct dict_immortal immortal; /* strings inserted while parsing schemas */
+    uint8_t destroying;        /* the whole dictionary is being freed with its context, lydict_remove() does nothing */
+};
+
 /**
  * @brief Initiate content (non-zero values) of the dictionary
  *
  * @param[in] dict Dictionary table to initiate
+ * @param[in] sharded Whether to split the dictionary into several independently locked shards.
+ * @param[in] immortal Whether to store the strings inserted while parsing schemas separately without reference counting.
  */
-void lydict_init(struct dict_table *dict);
+void lydict_init(struct dict_table *dict, int sharded, int immortal);
 
 /**
  * @brief Cleanup the dictionary content
@@ -112,14 +221,107 @@ void lydict_init(struct dict_table *dict);
 void lydict_clean(struct dict_table *dict);
 
 /**
- * @brief Get a specific record from a hash table.
+ * @brief Start using the thread dictionary insert cache for a context, should be called
+ * before parsing data so that the repeating strings are inserted faster. Can be nested,
+ * but the cache is used only for one context at a time.
+ *
+ * @param[in] ctx Context whose dictionary is to be cached.
+ */
+void lydict_cache_start(struct ly_ctx *ctx);
+
+/**
+ * @brief Stop using the thread dictionary insert cache for a context and count all
+ * the cached references in the dictionary. Must be called for every lydict_cache_start().
+ *
+ * @param[in] ctx Context whose dictionary was cached.
+ */
+void lydict_cache_flush(struct ly_ctx *ctx);
+
+/**
+ * @brief Start inserting strings into the immortal part of a context dictionary, should be called before
+ * parsing a schema. Has no effect if the context does not use immortal strings. Can be nested,
+ * but it is used only for one context at a time.
  *
- * @param[in] recs Hash table records.
- * @param[in] rec_size Size of one hash table record.
- * @param[in] idx Index of the record.
- * @return Record from \p recs on index \p idx.
+ * @param[in] ctx Context whose dictionary is to be inserted into.
  */
-struct ht_rec *lyht_get_rec(unsigned char *recs, uint16_t rec_size, uint32_t idx);
+void lydict_immortal_start(struct ly_ctx *ctx);
+
+/**
+ * @brief Stop inserting strings into the immortal part of a context dictionary.
+ * Must be called for every lydict_immortal_start().
+ *
+ * @param[in] ctx Context whose dictionary was inserted into.
+ */
+void lydict_immortal_stop(struct ly_ctx *ctx);
+
+/**
+ * @brief Start collecting the strings removed from a context dictionary in the thread release batch,
+ * should be called before freeing many data nodes. The strings are then removed in batches
+ * with a single lock acquisition each. Can be nested, but the batch is used only for one context at a time.
+ *
+ * @param[in] ctx Context whose dictionary strings are to be removed in batches.
+ */
+void lydict_release_start(struct ly_ctx *ctx);
+
+/**
+ * @brief Stop collecting the strings removed from a context dictionary and remove all the collected ones.
+ * Must be called for every lydict_release_start().
+ *
+ * @param[in] ctx Context whose dictionary strings were removed in batches.
+ */
+void lydict_release_flush(struct ly_ctx *ctx);
+
+/**
+ * @brief Get the memory used by a context dictionary, its hash tables and strings.
+ *
+ * @param[in] ctx Context with the dictionary.
+ * @param[out] count Number of the stored strings.
+ * @return Size in bytes.
+ */
+size_t lydict_mem_size(struct ly_ctx *ctx, uint32_t *count);
+
+/**
+ * @brief Get the number of references of a dictionary string.
+ *
+ * @param[in] ctx Context with the dictionary.
+ * @param[in] value String stored in the dictionary.
+ * @return Reference count, 0 if \p value is immortal (owned by the schemas) or not stored in the dictionary.
+ */
+uint32_t lydict_refcount(struct ly_ctx *ctx, const char *value);
+
+/**
+ * @brief Get a value from a specific record of a hash table. The values still in the previous
+ * records of an incrementally enlarged table are not included, see lyht_finish_resize().
+ *
+ * @param[in] ht Hash table.
+ * @param[in] idx Index of the record, must be lower than the size of \p ht.
+ * @return Value from the record on index \p idx, NULL if the record is not filled.
+ */
+void *lyht_get_val(const struct hash_table *ht, uint32_t idx);
+
+/**
+ * @brief Add statistics of a hash table to aggregated statistics.
+ *
+ * @param[in] ht Hash table.
+ * @param[in,out] stats Statistics to add to, the maximums are updated.
+ */
+void lyht_add_stats(const struct hash_table *ht, struct ly_ht_stats *stats);
+
+/**
+ * @brief Get the memory used by a hash table, including the previous records of an incremental enlargement.
+ * The memory referenced by its values is not included.
+ *
+ * @param[in] ht Hash table, may be NULL.
+ * @return Size in bytes.
+ */
+size_t lyht_mem_size(const struct hash_table *ht);
+
+/**
+ * @brief Finish any incremental enlargement of a hash table so that all its values are in its records.
+ *
+ * @param[in] ht Hash table.
+ */
+void lyht_finish_resize(struct hash_table *ht);
 
 /**
  * @brief Create new hash table.
@@ -177,6 +379,21 @@ void lyht_free(struct hash_table *ht);
  */
 int lyht_find(struct hash_table *ht, void *val_p, uint32_t hash, void **match_p);
 
+/**
+ * @brief Find a value in a hash table comparing it with a different callback than the table uses.
+ *
+ * Unlike changing the table callback with lyht_set_cb(), the table is not modified so it can be searched
+ * this way concurrently.
+ *
+ * @param[in] ht Hash table to search in.
+ * @param[in] val_p Pointer to the value to find, in the form \p val_equal expects.
+ * @param[in] hash Hash of the stored value.
+ * @param[in] val_equal Callback for checking value equivalence, passed the table callback data.
+ * @param[out] match_p Pointer to the matching value, optional.
+ * @return 0 on success, 1 on not found.
+ */
+int lyht_find_with_cb(struct hash_table *ht, void *val_p, uint32_t hash, values_equal_cb val_equal, void **match_p);
+
 /**
  * @brief Find another equal value in the hash table.
  *
@@ -227,4 +444,14 @@ int lyht_insert_with_resize_cb(struct hash_table *ht, void *val_p, uint32_t hash
  */
 int lyht_remove(struct hash_table *ht, void *val_p, uint32_t hash);
 
+/**
+ * @brief Make sure a hash table can hold a number of values without being enlarged.
+ * The table is not shrunk until it is filled enough again.
+ *
+ * @param[in] ht Hash table to enlarge, must be resizable.
+ * @param[in] count Number of values the table should hold.
+ * @return 0 on success, -1 on error.
+ */
+int lyht_reserve(struct hash_table *ht, uint32_t count);
+
 #endif /* LY_HASH_TABLE_H_ */
@@ -21,6 +21,7 @@
 #include <limits.h>
 #include <string.h>
 #include <assert.h>
+#include <time.h>
 
 #include "common.h"
 #include "parser.h"
@@ -31,9 +32,15 @@ volatile uint8_t ly_log_level = LY_LLWRN;
 volatile uint8_t ly_log_opts = LY_LOLOG | LY_LOSTORE_LAST;
 static void (*ly_log_clb)(LY_LOG_LEVEL level, const char *msg, const char *path);
 static volatile int path_flag = 1;
+static volatile uint32_t ly_log_store_max;
 #ifndef NDEBUG
 volatile int ly_log_dbg_groups = 0;
 #endif
+#ifdef LY_ENABLED_TRACE
+void (*volatile ly_trace_clb)(LY_TRACE_PHASE phase, int end, uint64_t timestamp, const struct ly_ctx *ctx);
+void (*volatile ly_profile_clb)(LY_PROFILE_KIND kind, const struct lys_node *snode, const char *expr, uint64_t ns,
+                                uint64_t visits, const struct ly_ctx *ctx);
+#endif
 
 API LY_LOG_LEVEL
 ly_verb(LY_LOG_LEVEL level)
@@ -53,6 +60,15 @@ ly_log_options(int opts)
     return prev;
 }
 
+API uint32_t
+ly_log_store_limit(uint32_t limit)
+{
+    uint32_t prev = ly_log_store_max;
+
+    ly_log_store_max = limit;
+    return prev;
+}
+
 API void
 ly_verb_dbg(int dbg_groups)
 {
@@ -76,11 +92,156 @@ API void
     return ly_log_clb;
 }
 
+API int
+ly_set_trace_clb(void (*clb)(LY_TRACE_PHASE phase, int end, uint64_t timestamp, const struct ly_ctx *ctx))
+{
+#ifdef LY_ENABLED_TRACE
+    ly_trace_clb = clb;
+    return 0;
+#else
+    (void)clb;
+    return 1;
+#endif
+}
+
+API int
+ly_set_profile_clb(void (*clb)(LY_PROFILE_KIND kind, const struct lys_node *snode, const char *expr, uint64_t ns,
+                               uint64_t visits, const struct ly_ctx *ctx))
+{
+#ifdef LY_ENABLED_TRACE
+    ly_profile_clb = clb;
+    return 0;
+#else
+    (void)clb;
+    return 1;
+#endif
+}
+
+/**
+ * @brief Data operation phases in progress in the thread.
+ */
+struct log_phase {
+    uint32_t depth;                           /* number of all the phases in progress */
+    uint32_t phase_depth[LY_TRACE_PRINT + 1]; /* number of the instances of each phase in progress */
+    uint64_t phase_start[LY_TRACE_PRINT + 1]; /* start of the outermost instance of each phase */
+};
+
+static THREAD_LOCAL struct log_phase log_phase;
+
+static uint64_t
+ly_phase_time(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void
+ly_phase(LY_TRACE_PHASE phase, int end, const struct ly_ctx *ctx)
+{
+#ifdef LY_ENABLED_TRACE
+    void (*clb)(LY_TRACE_PHASE phase, int end, uint64_t timestamp, const struct ly_ctx *ctx);
+#endif
+    uint64_t now = 0;
+
+    if (!end && !log_phase.depth) {
+        /* a new data operation, the events outside of them are not counted */
+        memset(&ly_cnt, 0, sizeof ly_cnt);
+    }
+
+    /* XPath evaluations are too frequent to be timed, the other phases only in their outermost instance */
+    if (phase != LY_TRACE_XPATH) {
+        if (!end) {
+            if (!log_phase.phase_depth[phase]++) {
+                now = ly_phase_time();
+                log_phase.phase_start[phase] = now;
+            }
+        } else if (log_phase.phase_depth[phase] && !--log_phase.phase_depth[phase]) {
+            now = ly_phase_time();
+            ly_cnt.phase_ns[phase] += now - log_phase.phase_start[phase];
+        }
+    }
+
+    if (!end) {
+        ++log_phase.depth;
+    } else if (log_phase.depth && !--log_phase.depth && ctx) {
+        /* the data operation is finished */
+        ly_ctx_counters_flush(ctx);
+    }
+
+#ifdef LY_ENABLED_TRACE
+    clb = ly_trace_clb;
+    if (clb) {
+        clb(phase, end, now ? now : ly_phase_time(), ctx);
+    }
+#endif
+}
+
+void
+ly_profile_start(struct ly_profile_mark *mark)
+{
+    mark->start = 0;
+#ifdef LY_ENABLED_TRACE
+    if (ly_profile_clb) {
+        mark->start = ly_phase_time();
+        mark->visits = ly_cnt.xpath_node_visits;
+    }
+#endif
+}
+
+void
+ly_profile_end(const struct ly_profile_mark *mark, LY_PROFILE_KIND kind, const struct lys_node *snode,
+               const char *expr, const struct ly_ctx *ctx)
+{
+#ifdef LY_ENABLED_TRACE
+    void (*clb)(LY_PROFILE_KIND kind, const struct lys_node *snode, const char *expr, uint64_t ns, uint64_t visits,
+                const struct ly_ctx *ctx);
+
+    clb = ly_profile_clb;
+    if (mark->start && clb) {
+        clb(kind, snode, expr, ly_phase_time() - mark->start, ly_cnt.xpath_node_visits - mark->visits, ctx);
+    }
+#else
+    (void)mark;
+    (void)kind;
+    (void)snode;
+    (void)expr;
+    (void)ctx;
+#endif
+}
+
+/**
+ * @brief Stored error record, the records are allocated and freed as the error items.
+ */
+struct log_err_rec {
+    struct ly_err_item item;  /* must be the first member */
+    uint32_t seq;             /* sequence number in the error list, the count is (last - first + 1) */
+    uint32_t dropped;         /* number of the records dropped from the list before this one was stored */
+};
+
+/**
+ * @brief Thread-specific validation errors collected by ly_vlog(), see ly_vlog_collect_start().
+ */
+static THREAD_LOCAL struct {
+    uint32_t depth;           /* number of nested ly_vlog_collect_start() calls */
+    uint32_t count;           /* number of collected errors */
+    uint32_t size;            /* number of allocated records */
+    uint32_t lost;            /* number of errors not collected because of a memory allocation failure */
+    int last;                 /* whether the most recent validation error was collected (for its app-tag) */
+    struct log_val_rec {
+        struct lyd_val_err err;
+        uint32_t seq;         /* sequence number of the corresponding temporarily stored error record */
+        int pending;          /* whether the error is only stored temporarily (ILO_STORE) and can be thrown away */
+    } *recs;
+} log_val_errs;
+
 /* !! spends all string parameters !! */
 static int
 log_store(const struct ly_ctx *ctx, LY_LOG_LEVEL level, LY_ERR no, LY_VECODE vecode, char *msg, char *path, char *apptag)
 {
     struct ly_err_item *eitem, *last;
+    struct log_err_rec *rec, *last_rec;
 
     assert(ctx && (level < LY_LLVRB));
 
@@ -88,10 +249,13 @@ log_store(const struct ly_ctx *ctx, LY_LOG_LEVEL level, LY_ERR no, LY_VECODE vec
     if (!eitem) {
         /* if we are only to fill in path, there must have been an error stored */
         assert(msg);
-        eitem = malloc(sizeof *eitem);
-        if (!eitem) {
+        rec = malloc(sizeof *rec);
+        if (!rec) {
             goto mem_fail;
         }
+        rec->seq = 0;
+        rec->dropped = 0;
+        eitem = &rec->item;
         eitem->prev = eitem;
         eitem->next = NULL;
 
@@ -118,13 +282,37 @@ log_store(const struct ly_ctx *ctx, LY_LOG_LEVEL level, LY_ERR no, LY_VECODE vec
         free(eitem->msg);
         free(eitem->path);
         free(eitem->apptag);
+    } else if ((log_opt != ILO_STORE) && ly_log_store_max
+            && (((struct log_err_rec *)eitem->prev)->seq - ((struct log_err_rec *)eitem)->seq + 1 >= ly_log_store_max)) {
+        /* the limit is reached, drop the oldest message and reuse its record for the new one
+         * (not when storing only temporarily, the items before the new ones are remembered then) */
+        last_rec = (struct log_err_rec *)eitem->prev;
+        rec = (struct log_err_rec *)eitem;
+        free(eitem->msg);
+        free(eitem->path);
+        free(eitem->apptag);
+        if (eitem->next) {
+            /* move it to the end */
+            last = eitem->prev;
+            eitem->next->prev = eitem;
+            pthread_setspecific(ctx->errlist_key, eitem->next);
+            eitem->next = NULL;
+            eitem->prev = last;
+            last->next = eitem;
+            rec->seq = last_rec->seq + 1;
+        }
+        rec->dropped = last_rec->dropped + 1;
     } else {
         /* store new message */
         last = eitem->prev;
-        eitem->prev = malloc(sizeof *eitem);
-        if (!eitem->prev) {
+        last_rec = (struct log_err_rec *)last;
+        rec = malloc(sizeof *rec);
+        if (!rec) {
             goto mem_fail;
         }
+        rec->seq = last_rec->seq + 1;
+        rec->dropped = last_rec->dropped;
+        eitem->prev = &rec->item;
         eitem = eitem->prev;
         eitem->prev = last;
         eitem->next = NULL;
@@ -148,6 +336,23 @@ mem_fail:
     return -1;
 }
 
+/* learn whether a message would be stored or printed by log_vprintf(), otherwise there is no need to format it */
+static int
+log_is_used(const struct ly_ctx *ctx, LY_LOG_LEVEL level)
+{
+    if ((log_opt == ILO_ERR2WRN) && (level == LY_LLERR)) {
+        level = LY_LLWRN;
+    }
+
+    if ((log_opt == ILO_IGNORE) || (level > ly_log_level)) {
+        return 0;
+    }
+    if ((level < LY_LLVRB) && ctx && ((ly_log_opts & LY_LOSTORE) || (log_opt == ILO_STORE))) {
+        return 1;
+    }
+    return (ly_log_opts & LY_LOLOG) && (log_opt != ILO_STORE);
+}
+
 /* !! spends path !! */
 static void
 log_vprintf(const struct ly_ctx *ctx, LY_LOG_LEVEL level, LY_ERR no, LY_VECODE vecode, char *path,
@@ -197,6 +402,10 @@ log_vprintf(const struct ly_ctx *ctx, LY_LOG_LEVEL level, LY_ERR no, LY_VECODE v
             }
         }
         free_strs = 0;
+    } else if (!(ly_log_opts & LY_LOLOG) || (log_opt == ILO_STORE)) {
+        /* neither stored nor printed */
+        free(path);
+        return;
     } else {
         if (vasprintf(&msg, format, args) == -1) {
             LOGMEM(ctx);
@@ -333,7 +542,7 @@ lyext_vlog(const struct ly_ctx *ctx, LY_VECODE vecode, const char *plugin, const
     va_list ap;
     int ret;
 
-    if (path_flag && (etype != LY_VLOG_NONE)) {
+    if (path_flag && (etype != LY_VLOG_NONE) && log_is_used(ctx, LY_LLERR)) {
         if (etype == LY_VLOG_PREV) {
             /* use previous path */
             const struct ly_err_item *first = ly_err_first(ctx);
@@ -847,6 +1056,96 @@ success:
     return 0;
 }
 
+void
+ly_vlog_collect_start(void)
+{
+    ++log_val_errs.depth;
+}
+
+uint32_t
+ly_vlog_collected(void)
+{
+    return log_val_errs.count + log_val_errs.lost;
+}
+
+struct lyd_val_err *
+ly_vlog_collect_stop(void)
+{
+    struct lyd_val_err *errs = NULL;
+    uint32_t i;
+
+    assert(log_val_errs.depth);
+    if (--log_val_errs.depth) {
+        /* nested, the errors are returned by the outer call */
+        return NULL;
+    }
+
+    if (log_val_errs.count) {
+        errs = malloc((log_val_errs.count + 1) * sizeof *errs);
+        if (!errs) {
+            LOGMEM(NULL);
+        } else {
+            for (i = 0; i < log_val_errs.count; ++i) {
+                errs[i] = log_val_errs.recs[i].err;
+            }
+            memset(&errs[i], 0, sizeof *errs);
+        }
+    }
+
+    free(log_val_errs.recs);
+    memset(&log_val_errs, 0, sizeof log_val_errs);
+    return errs;
+}
+
+/* only errors that are going to be reported are collected, the temporarily stored ones may still be thrown away */
+static void
+log_val_collect(const struct ly_ctx *ctx, LY_ECODE ecode, enum LY_VLOG_ELEM elem_type, const void *elem)
+{
+    struct log_val_rec *rec;
+    const struct ly_err_item *first;
+
+    log_val_errs.last = 0;
+    if (((log_opt != ILO_LOG) && (log_opt != ILO_STORE)) || ((log_opt == ILO_STORE) && !ctx)) {
+        return;
+    }
+
+    if (log_val_errs.count == log_val_errs.size) {
+        rec = realloc(log_val_errs.recs, (log_val_errs.size ? log_val_errs.size * 2 : 8) * sizeof *rec);
+        if (!rec) {
+            LOGMEM(ctx);
+            ++log_val_errs.lost;
+            return;
+        }
+        log_val_errs.recs = rec;
+        log_val_errs.size = log_val_errs.size ? log_val_errs.size * 2 : 8;
+    }
+    rec = &log_val_errs.recs[log_val_errs.count];
+
+    rec->err.no = LY_EVALID;
+    rec->err.vecode = ecode2vecode[ecode];
+    rec->err.node = NULL;
+    rec->err.schema = NULL;
+    rec->err.apptag = NULL;
+    if (elem_type == LY_VLOG_LYD) {
+        rec->err.node = elem;
+        rec->err.schema = elem ? ((struct lyd_node *)elem)->schema : NULL;
+    } else if (elem_type == LY_VLOG_LYS) {
+        rec->err.schema = elem;
+    }
+
+    rec->pending = 0;
+    if (log_opt == ILO_STORE) {
+        first = ly_err_first(ctx);
+        if (first) {
+            rec->pending = 1;
+            rec->seq = ((struct log_err_rec *)first->prev)->seq;
+        }
+    }
+
+    ++log_val_errs.count;
+    log_val_errs.last = 1;
+}
+
 void
 ly_vlog(const struct ly_ctx *ctx, LY_ECODE ecode, enum LY_VLOG_ELEM elem_type, const void *elem, ...)
 {
@@ -855,11 +1154,12 @@ ly_vlog(const struct ly_ctx *ctx, LY_ECODE ecode, enum LY_VLOG_ELEM elem_type, c
     char* path = NULL;
     const struct ly_err_item *first;
 
-    if ((ecode == LYE_PATH) && !path_flag) {
+    if ((ecode == LYE_PATH) && (!path_flag || !log_is_used(ctx, LY_LLERR))) {
         return;
     }
 
-    if (path_flag && (elem_type != LY_VLOG_NONE)) {
+    /* the path is built only if it is going to be used (not for the ignored errors of union resolution etc.) */
+    if (path_flag && (elem_type != LY_VLOG_NONE) && log_is_used(ctx, LY_LLERR)) {
         if (elem_type == LY_VLOG_PREV) {
             /* use previous path */
             first = ly_err_first(ctx);
@@ -893,6 +1193,10 @@ ly_vlog(const struct ly_ctx *ctx, LY_ECODE ecode, enum LY_VLOG_ELEM elem_type, c
         break;
     }
     va_end(ap);
+
+    if (log_val_errs.depth && (ecode != LYE_PATH) && (elem_type != LY_VLOG_PREV)) {
+        log_val_collect(ctx, ecode, elem_type, elem);
+    }
 }
 
 void
@@ -904,6 +1208,14 @@ ly_vlog_str(const struct ly_ctx *ctx, enum LY_VLOG_ELEM elem_type, const char *s
 
     assert((elem_type == LY_VLOG_NONE) || (elem_type == LY_VLOG_PREV));
 
+    if (!log_is_used(ctx, LY_LLERR)) {
+        /* the message is not going to be formatted, only the errno is set */
+        va_start(ap, str);
+        log_vprintf(ctx, LY_LLERR, LY_EVALID, LYVE_SUCCESS, NULL, str, ap);
+        va_end(ap);
+        return;
+    }
+
     if (elem_type == LY_VLOG_PREV) {
         /* use previous path */
         first = ly_err_first(ctx);
@@ -932,6 +1244,18 @@ ly_vlog_str(const struct ly_ctx *ctx, enum LY_VLOG_ELEM elem_type, const char *s
     free(fmt);
 }
 
+API uint32_t
+ly_err_dropped(const struct ly_ctx *ctx)
+{
+    struct ly_err_item *first;
+
+    first = ly_err_first(ctx);
+    if (!first) {
+        return 0;
+    }
+    return ((struct log_err_rec *)first->prev)->dropped;
+}
+
 API void
 ly_err_print(struct ly_err_item *eitem)
 {
@@ -975,6 +1299,13 @@ err_print(struct ly_ctx *ctx, struct ly_err_item *last_eitem)
 void
 ly_err_free_next(struct ly_ctx *ctx, struct ly_err_item *last_eitem)
 {
+    /* throw away the collected validation errors of the freed records as well */
+    while (log_val_errs.count && log_val_errs.recs[log_val_errs.count - 1].pending
+            && (!last_eitem || (log_val_errs.recs[log_val_errs.count - 1].seq > ((struct log_err_rec *)last_eitem)->seq))) {
+        --log_val_errs.count;
+        log_val_errs.last = 0;
+    }
+
     if (!last_eitem) {
         ly_err_clean(ctx, NULL);
     } else if (last_eitem->next) {
@@ -1046,6 +1377,8 @@ ly_ilo_change(struct ly_ctx *ctx, enum int_log_opts new_ilo, enum int_log_opts *
 void
 ly_ilo_restore(struct ly_ctx *ctx, enum int_log_opts prev_ilo, struct ly_err_item *prev_last_eitem, int keep_and_print)
 {
+    uint32_t i;
+
     assert(log_opt != ILO_LOG);
     if (log_opt != ILO_STORE) {
         /* nothing to print or free */
@@ -1058,6 +1391,12 @@ ly_ilo_restore(struct ly_ctx *ctx, enum int_log_opts prev_ilo, struct ly_err_ite
 
     log_opt = prev_ilo;
     if (keep_and_print) {
+        if (log_opt == ILO_LOG) {
+            /* the errors are reported now, so the collected ones are final even if not stored anymore */
+            for (i = log_val_errs.count; i && log_val_errs.recs[i - 1].pending; --i) {
+                log_val_errs.recs[i - 1].pending = 0;
+            }
+        }
         err_print(ctx, prev_last_eitem);
     }
     err_clean(ctx, prev_last_eitem, keep_and_print);
@@ -1068,11 +1407,16 @@ ly_err_last_set_apptag(const struct ly_ctx *ctx, const char *apptag)
 {
     struct ly_err_item *i;
 
-    if (log_opt != ILO_IGNORE) {
+    /* the last error was stored only if storing is enabled, otherwise it is an older one */
+    if ((log_opt != ILO_IGNORE) && ((ly_log_opts & LY_LOSTORE) || (log_opt == ILO_STORE))) {
         i = ly_err_first(ctx);
         if (i) {
             i = i->prev;
+            free(i->apptag);
             i->apptag = strdup(apptag);
         }
     }
+    if (log_val_errs.last) {
+        log_val_errs.recs[log_val_errs.count - 1].err.apptag = apptag;
+    }
 }
@@ -0,0 +1,1048 @@
+/**
+ * @file nacm.c
+ * @brief NETCONF Access Control Model (RFC 8341) evaluation on data trees
+ *
+ * Copyright (c) 2019 CESNET, z.s.p.o.
+ *
+ * This source code is licensed under BSD 3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://opensource.org/licenses/BSD-3-Clause
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "hash_table.h"
+#include "libyang.h"
+#include "tree_internal.h"
+
+/* all the access operations */
+#define NACM_ACCESS_ALL (LYD_NACM_CREATE | LYD_NACM_READ | LYD_NACM_UPDATE | LYD_NACM_DELETE | LYD_NACM_EXEC)
+/* access operations of the write-default */
+#define NACM_ACCESS_WRITE (LYD_NACM_CREATE | LYD_NACM_UPDATE | LYD_NACM_DELETE)
+
+/**
+ * @brief Type of a compiled NACM rule according to its rule-type choice.
+ */
+enum nacm_rule_type {
+    NACM_RULE_ANY,                  /**< no rule-type, matches all the requests */
+    NACM_RULE_OPER,                 /**< protocol-operation (rpc-name) */
+    NACM_RULE_NOTIF,                /**< notification (notification-name) */
+    NACM_RULE_DATA                  /**< data-node (path) */
+};
+
+/**
+ * @brief NETCONF edit-config operations as used in the ietf-netconf operation attribute.
+ */
+enum nacm_edit_op {
+    NACM_OP_NONE,
+    NACM_OP_MERGE,
+    NACM_OP_REPLACE,
+    NACM_OP_CREATE,
+    NACM_OP_DELETE                  /**< also the remove operation */
+};
+
+/**
+ * @brief Compiled NACM rule, all the applicable rules of all the rule-lists are kept in their order.
+ */
+struct nacm_rule {
+    enum nacm_rule_type type;
+    uint8_t access;                 /**< matching access operations (LYD_NACM_*) */
+    uint8_t permit;                 /**< action of the rule */
+    const char *module;             /**< module-name (in the dictionary), NULL for "*" */
+    const char *name;               /**< rpc-name or notification-name (in the dictionary), NULL for "*" */
+    const struct lys_node *target;  /**< schema node of the path, NULL for "/" */
+    struct lyd_path *path;          /**< prepared path if it has predicates and so depends on the data instances */
+    struct hash_table *instances;   /**< data nodes matching path in the evaluated trees */
+    struct ly_set *roots;           /**< roots of the trees path was evaluated in */
+};
+
+/**
+ * @brief Cached decision for a schema node.
+ */
+struct nacm_node {
+    const struct lys_node *schema;
+    uint8_t permit;                 /**< access operations permitted by the first matching rule or the default */
+    uint8_t dynamic;                /**< access operations whose first matching rule depends on the data instance */
+    uint8_t dflt;                   /**< access operations permitted if no rule matches */
+};
+
+struct lyd_nacm {
+    struct ly_ctx *ctx;
+    int enabled;                    /**< enable-nacm */
+    uint8_t dflt;                   /**< access operations permitted by read-default, write-default and exec-default */
+    struct nacm_rule *rules;
+    uint32_t rule_count;
+    struct hash_table *nodes;       /**< struct nacm_node records of the already evaluated schema nodes */
+};
+
+static int
+nacm_node_equal(void *val1_p, void *val2_p, int UNUSED(mod), void *UNUSED(cb_data))
+{
+    return ((struct nacm_node *)val1_p)->schema == ((struct nacm_node *)val2_p)->schema;
+}
+
+static int
+nacm_ptr_equal(void *val1_p, void *val2_p, int UNUSED(mod), void *UNUSED(cb_data))
+{
+    return *(void **)val1_p == *(void **)val2_p;
+}
+
+static uint32_t
+nacm_ptr_hash(const void *ptr)
+{
+    return dict_hash_multi(dict_hash_multi(0, (const char *)&ptr, sizeof ptr), NULL, 0);
+}
+
+static const struct lyd_node *
+nacm_child(const struct lyd_node *parent, const char *name)
+{
+    const struct lyd_node *iter;
+
+    LY_TREE_FOR(parent->child, iter) {
+        if (!strcmp(iter->schema->name, name)) {
+            return iter;
+        }
+    }
+
+    return NULL;
+}
+
+static const char *
+nacm_child_value(const struct lyd_node *parent, const char *name)
+{
+    const struct lyd_node *child;
+
+    child = nacm_child(parent, name);
+    if (!child || !(child->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST))) {
+        return NULL;
+    }
+    return ((struct lyd_node_leaf_list *)child)->value_str;
+}
+
+/**
+ * @brief Parse access-operations value.
+ */
+static uint8_t
+nacm_parse_access(const char *value)
+{
+    const char *ptr;
+    size_t len;
+    uint8_t access = 0;
+
+    if (!value || !strcmp(value, "*")) {
+        return NACM_ACCESS_ALL;
+    }
+
+    for (ptr = value; *ptr; ptr += len) {
+        ptr += strspn(ptr, " ");
+        len = strcspn(ptr, " ");
+        if ((len == 6) && !strncmp(ptr, "create", len)) {
+            access |= LYD_NACM_CREATE;
+        } else if ((len == 4) && !strncmp(ptr, "read", len)) {
+            access |= LYD_NACM_READ;
+        } else if ((len == 6) && !strncmp(ptr, "update", len)) {
+            access |= LYD_NACM_UPDATE;
+        } else if ((len == 6) && !strncmp(ptr, "delete", len)) {
+            access |= LYD_NACM_DELETE;
+        } else if ((len == 4) && !strncmp(ptr, "exec", len)) {
+            access |= LYD_NACM_EXEC;
+        }
+    }
+
+    return access;
+}
+
+/**
+ * @brief Compile the path of a data-node rule.
+ *
+ * The schema node of the path is resolved now, only the paths with predicates are kept
+ * to be evaluated on the data trees.
+ *
+ * @return 0 on success, 1 if the path cannot match any node, -1 on error.
+ */
+static int
+nacm_compile_path(struct ly_ctx *ctx, struct nacm_rule *rule, const char *path)
+{
+    char *spath;
+    const char *ptr;
+    char quot;
+    int len, pred = 0;
+
+    if (!strcmp(path, "/")) {
+        return 0;
+    }
+
+    /* the schema path is the path without the predicates */
+    spath = malloc(strlen(path) + 1);
+    LY_CHECK_ERR_RETURN(!spath, LOGMEM(ctx), -1);
+    for (ptr = path, len = 0; *ptr; ++ptr) {
+        if (*ptr != '[') {
+            spath[len++] = *ptr;
+            continue;
+        }
+
+        pred = 1;
+        for (quot = 0; *ptr && (quot || (*ptr != ']')); ++ptr) {
+            if (quot && (*ptr == quot)) {
+                quot = 0;
+            } else if (!quot && ((*ptr == '\'') || (*ptr == '\"'))) {
+                quot = *ptr;
+            }
+        }
+        if (!*ptr) {
+            break;
+        }
+    }
+    spath[len] = '\0';
+
+    rule->target = ly_ctx_get_node(ctx, NULL, spath, 0);
+    free(spath);
+    if (!rule->target) {
+        /* the node is not in the context, the rule applies to nothing */
+        ly_err_clean(ctx, NULL);
+        return 1;
+    }
+
+    if (pred) {
+        rule->path = lyd_path_prepare(lys_node_module(rule->target), path);
+        if (!rule->path) {
+            ly_err_clean(ctx, NULL);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Compile a rule into the next item of the nacm rules.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int
+nacm_compile_rule(struct lyd_nacm *nacm, const struct lyd_node *rule_data)
+{
+    struct nacm_rule *rule;
+    const char *value;
+    int ret;
+
+    rule = &nacm->rules[nacm->rule_count];
+    memset(rule, 0, sizeof *rule);
+
+    value = nacm_child_value(rule_data, "action");
+    rule->permit = (value && !strcmp(value, "permit")) ? 1 : 0;
+    rule->access = nacm_parse_access(nacm_child_value(rule_data, "access-operations"));
+
+    value = nacm_child_value(rule_data, "module-name");
+    if (value && strcmp(value, "*")) {
+        rule->module = lydict_insert(nacm->ctx, value, 0);
+    }
+
+    if ((value = nacm_child_value(rule_data, "rpc-name"))) {
+        rule->type = NACM_RULE_OPER;
+    } else if ((value = nacm_child_value(rule_data, "notification-name"))) {
+        rule->type = NACM_RULE_NOTIF;
+    } else if ((value = nacm_child_value(rule_data, "path"))) {
+        rule->type = NACM_RULE_DATA;
+        ret = nacm_compile_path(nacm->ctx, rule, value);
+        if (ret) {
+            lydict_remove(nacm->ctx, rule->module);
+            /* the rule is skipped if it cannot match anything */
+            return (ret == 1) ? 0 : -1;
+        }
+        value = NULL;
+    } else {
+        rule->type = NACM_RULE_ANY;
+    }
+
+    if (value && strcmp(value, "*")) {
+        rule->name = lydict_insert(nacm->ctx, value, 0);
+    }
+
+    ++nacm->rule_count;
+    return 0;
+}
+
+/**
+ * @brief Check that a rule-list applies to any of the user groups.
+ */
+static int
+nacm_rule_list_applies(const struct lyd_node *rule_list, struct ly_set *groups)
+{
+    const struct lyd_node *iter;
+    const char *group;
+    unsigned int i;
+
+    LY_TREE_FOR(rule_list->child, iter) {
+        if (strcmp(iter->schema->name, "group")) {
+            continue;
+        }
+        group = ((struct lyd_node_leaf_list *)iter)->value_str;
+        if (!strcmp(group, "*")) {
+            return 1;
+        }
+        for (i = 0; i < groups->number; ++i) {
+            if (!strcmp(group, groups->set.g[i])) {
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Collect the names of the groups the user is a member of.
+ */
+static int
+nacm_user_groups(const struct lyd_node *nacm_data, const char *user, const char **ext_groups, struct ly_set *groups)
+{
+    const struct lyd_node *node, *group, *iter;
+    const char *value;
+    uint32_t i;
+
+    if (!user) {
+        return 0;
+    }
+
+    node = nacm_child(nacm_data, "groups");
+    if (node) {
+        LY_TREE_FOR(node->child, group) {
+            if (strcmp(group->schema->name, "group")) {
+                continue;
+            }
+            LY_TREE_FOR(group->child, iter) {
+                if (!strcmp(iter->schema->name, "user-name")
+                        && !strcmp(((struct lyd_node_leaf_list *)iter)->value_str, user)) {
+                    if (ly_set_add(groups, (void *)nacm_child_value(group, "name"), LY_SET_OPT_USEASLIST) == -1) {
+                        return -1;
+                    }
+                    break;
+                }
+            }
+        }
+    }
+
+    value = nacm_child_value(nacm_data, "enable-external-groups");
+    if (ext_groups && (!value || !strcmp(value, "true"))) {
+        for (i = 0; ext_groups[i]; ++i) {
+            if (ly_set_add(groups, (void *)ext_groups[i], 0) == -1) {
+                return -1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+API struct lyd_nacm *
+lyd_nacm_new(const struct lyd_node *nacm_data, const char *user, const char **groups)
+{
+    FUN_IN;
+
+    struct lyd_nacm *nacm;
+    struct ly_set *user_groups = NULL;
+    const struct lyd_node *iter, *list, *rule;
+    const char *value;
+    struct ly_ctx *ctx;
+    uint32_t count;
+
+    if (!nacm_data) {
+        LOGARG;
+        return NULL;
+    }
+    ctx = nacm_data->schema->module->ctx;
+
+    /* find the nacm container among the top-level siblings */
+    for (iter = nacm_data; iter->prev->next; iter = iter->prev);
+    for (; iter; iter = iter->next) {
+        if (!strcmp(iter->schema->name, "nacm") && !strcmp(lyd_node_module(iter)->name, "ietf-netconf-acm")) {
+            break;
+        }
+    }
+    if (!iter) {
+        LOGERR(ctx, LY_EINVAL, "%s: ietf-netconf-acm nacm container not found.", __func__);
+        return NULL;
+    }
+    nacm_data = iter;
+
+    nacm = calloc(1, sizeof *nacm);
+    LY_CHECK_ERR_RETURN(!nacm, LOGMEM(ctx), NULL);
+    nacm->ctx = ctx;
+
+    /* global settings, the defaults are the ones of the schema */
+    value = nacm_child_value(nacm_data, "enable-nacm");
+    nacm->enabled = (!value || !strcmp(value, "true")) ? 1 : 0;
+    value = nacm_child_value(nacm_data, "read-default");
+    if (!value || !strcmp(value, "permit")) {
+        nacm->dflt |= LYD_NACM_READ;
+    }
+    value = nacm_child_value(nacm_data, "write-default");
+    if (value && !strcmp(value, "permit")) {
+        nacm->dflt |= NACM_ACCESS_WRITE;
+    }
+    value = nacm_child_value(nacm_data, "exec-default");
+    if (!value || !strcmp(value, "permit")) {
+        nacm->dflt |= LYD_NACM_EXEC;
+    }
+
+    nacm->nodes = lyht_new(16, sizeof(struct nacm_node), nacm_node_equal, NULL, 1);
+    user_groups = ly_set_new();
+    if (!nacm->nodes || !user_groups) {
+        LOGMEM(ctx);
+        goto error;
+    }
+
+    if (nacm_user_groups(nacm_data, user, groups, user_groups)) {
+        goto error;
+    }
+
+    /* count the rules */
+    count = 0;
+    LY_TREE_FOR(nacm_data->child, list) {
+        if (!strcmp(list->schema->name, "rule-list")) {
+            LY_TREE_FOR(list->child, rule) {
+                if (!strcmp(rule->schema->name, "rule")) {
+                    ++count;
+                }
+            }
+        }
+    }
+    if (count) {
+        nacm->rules = malloc(count * sizeof *nacm->rules);
+        LY_CHECK_ERR_GOTO(!nacm->rules, LOGMEM(ctx), error);
+    }
+
+    /* compile the rules of the applicable rule-lists in their order */
+    LY_TREE_FOR(nacm_data->child, list) {
+        if (strcmp(list->schema->name, "rule-list") || !nacm_rule_list_applies(list, user_groups)) {
+            continue;
+        }
+        LY_TREE_FOR(list->child, rule) {
+            if (!strcmp(rule->schema->name, "rule") && nacm_compile_rule(nacm, rule)) {
+                goto error;
+            }
+        }
+    }
+
+    ly_set_free(user_groups);
+    return nacm;
+
+error:
+    ly_set_free(user_groups);
+    lyd_nacm_free(nacm);
+    return NULL;
+}
+
+/**
+ * @brief Forget the data instances of all the rules with predicates.
+ */
+static void
+nacm_instances_clean(struct lyd_nacm *nacm)
+{
+    uint32_t i;
+
+    for (i = 0; i < nacm->rule_count; ++i) {
+        lyht_free(nacm->rules[i].instances);
+        nacm->rules[i].instances = NULL;
+        ly_set_free(nacm->rules[i].roots);
+        nacm->rules[i].roots = NULL;
+    }
+}
+
+API void
+lyd_nacm_free(struct lyd_nacm *nacm)
+{
+    FUN_IN;
+
+    uint32_t i;
+
+    if (!nacm) {
+        return;
+    }
+
+    nacm_instances_clean(nacm);
+    for (i = 0; i < nacm->rule_count; ++i) {
+        lydict_remove(nacm->ctx, nacm->rules[i].module);
+        lydict_remove(nacm->ctx, nacm->rules[i].name);
+        lyd_path_free(nacm->rules[i].path);
+    }
+    free(nacm->rules);
+    lyht_free(nacm->nodes);
+    free(nacm);
+}
+
+/**
+ * @brief Check whether a rule matches a schema node, regardless the data instance.
+ */
+static int
+nacm_rule_match_schema(const struct nacm_rule *rule, const struct lys_node *schema, int access)
+{
+    const struct lys_node *iter;
+
+    if (!(rule->access & access)) {
+        return 0;
+    }
+    if (rule->module && !ly_strequal(rule->module, lys_node_module(schema)->name, 1)) {
+        return 0;
+    }
+
+    switch (rule->type) {
+    case NACM_RULE_ANY:
+        return 1;
+    case NACM_RULE_OPER:
+        return (schema->nodetype == LYS_RPC) && (!rule->name || ly_strequal(rule->name, schema->name, 1));
+    case NACM_RULE_NOTIF:
+        return (schema->nodetype == LYS_NOTIF) && !lys_parent(schema)
+                && (!rule->name || ly_strequal(rule->name, schema->name, 1));
+    case NACM_RULE_DATA:
+        if ((schema->nodetype & (LYS_RPC | LYS_NOTIF)) && !lys_parent(schema)) {
+            /* operations have their own rules */
+            return 0;
+        }
+        if (!rule->target) {
+            return 1;
+        }
+        /* the rule applies to the node and all its descendants */
+        for (iter = schema; iter; iter = lys_parent(iter)) {
+            if (iter == rule->target) {
+                return 1;
+            }
+        }
+        return 0;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Check the presence of a NACM default-deny-* extension instance in a schema node or its ancestors.
+ */
+static int
+nacm_default_deny(const struct lys_node *schema, const char *name)
+{
+    const struct lys_node *iter;
+    uint8_t i;
+
+    for (iter = schema; iter; iter = lys_parent(iter)) {
+        for (i = 0; i < iter->ext_size; ++i) {
+            if (!strcmp(iter->ext[i]->def->name, name)
+                    && !strcmp(iter->ext[i]->def->module->name, "ietf-netconf-acm")) {
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Get the decision record of a schema node, evaluate all the rules for it on first use.
+ */
+static struct nacm_node *
+nacm_schema_node(struct lyd_nacm *nacm, const struct lys_node *schema)
+{
+    struct nacm_node rec, *match;
+    uint32_t hash, i;
+    uint8_t access;
+
+    memset(&rec, 0, sizeof rec);
+    rec.schema = schema;
+    hash = nacm_ptr_hash(schema);
+    if (!lyht_find(nacm->nodes, &rec, hash, (void **)&match)) {
+        return match;
+    }
+
+    /* the defaults if no rule matches */
+    rec.dflt = nacm->dflt;
+    if (nacm_default_deny(schema, "default-deny-all")) {
+        rec.dflt = 0;
+    } else if (nacm_default_deny(schema, "default-deny-write")) {
+        rec.dflt &= ~NACM_ACCESS_WRITE;
+    }
+
+    for (access = LYD_NACM_CREATE; access & NACM_ACCESS_ALL; access <<= 1) {
+        for (i = 0; i < nacm->rule_count; ++i) {
+            if (nacm_rule_match_schema(&nacm->rules[i], schema, access)) {
+                break;
+            }
+        }
+        if (i == nacm->rule_count) {
+            rec.permit |= rec.dflt & access;
+        } else if (nacm->rules[i].path) {
+            rec.dynamic |= access;
+        } else if (nacm->rules[i].permit) {
+            rec.permit |= access;
+        }
+    }
+    if (schema->nodetype & (LYS_RPC | LYS_ACTION)) {
+        /* close-session is always permitted */
+        if (!strcmp(schema->name, "close-session") && !strcmp(lys_node_module(schema)->name, "ietf-netconf")) {
+            rec.permit |= LYD_NACM_EXEC;
+            rec.dynamic &= ~LYD_NACM_EXEC;
+        }
+    } else {
+        /* exec is relevant only for operations */
+        rec.permit &= ~LYD_NACM_EXEC;
+        rec.dynamic &= ~LYD_NACM_EXEC;
+    }
+
+    if (lyht_insert(nacm->nodes, &rec, hash, (void **)&match)) {
+        LOGMEM(nacm->ctx);
+        return NULL;
+    }
+    return match;
+}
+
+/**
+ * @brief Check whether a data node or any of its ancestors is an instance of the path of a rule.
+ *
+ * @return 1 if it is, 0 if not, -1 on error.
+ */
+static int
+nacm_rule_match_instance(struct nacm_rule *rule, const struct lyd_node *node)
+{
+    const struct lyd_node *root, *iter;
+    struct ly_set *set;
+    unsigned int i;
+
+    for (root = node; root->parent; root = root->parent);
+    for (; root->prev->next; root = root->prev);
+
+    if (!rule->roots) {
+        rule->roots = ly_set_new();
+        rule->instances = lyht_new(8, sizeof(struct lyd_node *), nacm_ptr_equal, NULL, 1);
+        LY_CHECK_ERR_RETURN(!rule->roots || !rule->instances, LOGMEM(lyd_node_module(node)->ctx), -1);
+    }
+    if (ly_set_contains(rule->roots, (void *)root) == -1) {
+        /* evaluate the path in this tree for the first time */
+        set = lyd_find_path_prepared(root, rule->path);
+        if (!set) {
+            return -1;
+        }
+        for (i = 0; i < set->number; ++i) {
+            if (lyht_insert(rule->instances, &set->set.d[i], nacm_ptr_hash(set->set.d[i]), NULL) == -1) {
+                ly_set_free(set);
+                return -1;
+            }
+        }
+        ly_set_free(set);
+        if (ly_set_add(rule->roots, (void *)root, LY_SET_OPT_USEASLIST) == -1) {
+            return -1;
+        }
+    }
+
+    for (iter = node; iter; iter = iter->parent) {
+        if (!lyht_find(rule->instances, &iter, nacm_ptr_hash(iter), NULL)) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Decide the access to a data node.
+ *
+ * @return 1 if permitted, 0 if denied, -1 on error.
+ */
+static int
+nacm_allowed(struct lyd_nacm *nacm, const struct lyd_node *node, int access)
+{
+    struct nacm_node *rec;
+    uint32_t i;
+    int r;
+
+    if (!nacm->enabled) {
+        return 1;
+    }
+
+    rec = nacm_schema_node(nacm, node->schema);
+    if (!rec) {
+        return -1;
+    }
+    if (!(rec->dynamic & access)) {
+        return (rec->permit & access) ? 1 : 0;
+    }
+
+    /* some rule before the first static match depends on the data instance */
+    for (i = 0; i < nacm->rule_count; ++i) {
+        if (!nacm_rule_match_schema(&nacm->rules[i], node->schema, access)) {
+            continue;
+        }
+        if (nacm->rules[i].path) {
+            r = nacm_rule_match_instance(&nacm->rules[i], node);
+            if (r == -1) {
+                return -1;
+            } else if (!r) {
+                continue;
+            }
+        }
+        return nacm->rules[i].permit;
+    }
+
+    return (rec->dflt & access) ? 1 : 0;
+}
+
+API int
+lyd_nacm_allowed(struct lyd_nacm *nacm, const struct lyd_node *node, int access)
+{
+    FUN_IN;
+
+    int ret;
+
+    if (!nacm || !node || !access || (access & ~NACM_ACCESS_ALL) || (access & (access - 1))) {
+        LOGARG;
+        return -1;
+    }
+
+    ret = nacm_allowed(nacm, node, access);
+    nacm_instances_clean(nacm);
+    return ret;
+}
+
+/**
+ * @brief Remove the not readable nodes from siblings, recursively.
+ *
+ * @return 0 on success, 1 if a key of the parent list is not readable, -1 on error.
+ */
+static int
+nacm_filter_r(struct lyd_nacm *nacm, struct lyd_node **first)
+{
+    struct lyd_node *iter, *next;
+    int r;
+
+    for (iter = *first; iter; iter = next) {
+        next = iter->next;
+
+        r = nacm_allowed(nacm, iter, LYD_NACM_READ);
+        if (r == -1) {
+            return -1;
+        } else if (!r) {
+            if ((iter->schema->nodetype == LYS_LEAF) && lys_is_key((struct lys_node_leaf *)iter->schema, NULL)) {
+                /* the whole list instance is not readable */
+                return 1;
+            }
+            if (iter == *first) {
+                *first = next;
+            }
+            lyd_free(iter);
+            continue;
+        }
+
+        if (!(iter->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST | LYS_ANYDATA)) && iter->child) {
+            r = nacm_filter_r(nacm, &iter->child);
+            if (r == -1) {
+                return -1;
+            } else if (r) {
+                if (iter == *first) {
+                    *first = next;
+                }
+                lyd_free(iter);
+            }
+        }
+    }
+
+    return 0;
+}
+
+API int
+lyd_nacm_filter(struct lyd_nacm *nacm, struct lyd_node **tree)
+{
+    FUN_IN;
+
+    struct lyd_node *first;
+    int ret;
+
+    if (!nacm || !tree) {
+        LOGARG;
+        return -1;
+    }
+
+    if (!nacm->enabled || !*tree) {
+        return 0;
+    }
+
+    for (first = *tree; first->prev->next; first = first->prev);
+
+    /* all the instances are evaluated before anything is freed */
+    ret = nacm_filter_r(nacm, &first);
+    nacm_instances_clean(nacm);
+    if (ret == -1) {
+        return -1;
+    }
+
+    *tree = first;
+    return 0;
+}
+
+/**
+ * @brief Get the edit-config operation of an edit node.
+ */
+static enum nacm_edit_op
+nacm_edit_op(const struct lyd_node *node, enum nacm_edit_op parent_op)
+{
+    const struct lyd_attr *attr;
+
+    for (attr = node->attr; attr; attr = attr->next) {
+        if (strcmp(attr->annotation->arg_value, "operation") || strcmp(attr->annotation->module->name, "ietf-netconf")) {
+            continue;
+        }
+        if (!strcmp(attr->value_str, "none")) {
+            return NACM_OP_NONE;
+        } else if (!strcmp(attr->value_str, "merge")) {
+            return NACM_OP_MERGE;
+        } else if (!strcmp(attr->value_str, "replace")) {
+            return NACM_OP_REPLACE;
+        } else if (!strcmp(attr->value_str, "create")) {
+            return NACM_OP_CREATE;
+        } else if (!strcmp(attr->value_str, "delete") || !strcmp(attr->value_str, "remove")) {
+            return NACM_OP_DELETE;
+        }
+    }
+
+    return parent_op;
+}
+
+/**
+ * @brief Find the instance of a data node among siblings of another tree.
+ */
+static const struct lyd_node *
+nacm_find_instance(const struct lyd_node *siblings, const struct lyd_node *node)
+{
+    const struct lys_node_list *slist;
+    const struct lyd_node *key;
+    const struct lyd_node *match;
+    const char **values = NULL;
+    uint8_t i;
+
+    if (!siblings) {
+        return NULL;
+    }
+
+    if (node->schema->nodetype == LYS_LIST) {
+        slist = (struct lys_node_list *)node->schema;
+        if (slist->keys_size) {
+            values = malloc(slist->keys_size * sizeof *values);
+            LY_CHECK_ERR_RETURN(!values, LOGMEM(slist->module->ctx), NULL);
+            for (i = 0; i < slist->keys_size; ++i) {
+                for (key = node->child; key && (key->schema != (struct lys_node *)slist->keys[i]); key = key->next);
+                if (!key) {
+                    free(values);
+                    return NULL;
+                }
+                values[i] = ((struct lyd_node_leaf_list *)key)->value_str;
+            }
+        }
+    } else if (node->schema->nodetype == LYS_LEAFLIST) {
+        values = malloc(sizeof *values);
+        LY_CHECK_ERR_RETURN(!values, LOGMEM(node->schema->module->ctx), NULL);
+        values[0] = ((struct lyd_node_leaf_list *)node)->value_str;
+    }
+
+    match = lyd_find_sibling_val(siblings, node->schema, values);
+    free(values);
+    return match;
+}
+
+static int
+nacm_is_key(const struct lyd_node *node)
+{
+    return (node->schema->nodetype == LYS_LEAF) && lys_is_key((struct lys_node_leaf *)node->schema, NULL);
+}
+
+/**
+ * @brief Check the delete access to a whole subtree.
+ *
+ * @return 0 if permitted, 1 if denied, -1 on error.
+ */
+static int
+nacm_check_delete(struct lyd_nacm *nacm, const struct lyd_node *subtree, const struct lyd_node **denied)
+{
+    struct lyd_node *next, *elem;
+    int r;
+
+    LY_TREE_DFS_BEGIN((struct lyd_node *)subtree, next, elem) {
+        if (!nacm_is_key(elem)) {
+            r = nacm_allowed(nacm, elem, LYD_NACM_DELETE);
+            if (r < 1) {
+                if (!r && denied) {
+                    *denied = elem;
+                }
+                return r ? -1 : 1;
+            }
+        }
+        LY_TREE_DFS_END((struct lyd_node *)subtree, next, elem);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Check the access to edit siblings and their descendants.
+ *
+ * @param[in] edit First edit sibling.
+ * @param[in] data Siblings of the current data on the same level, if known.
+ * @return 0 if permitted, 1 if denied, -1 on error.
+ */
+static int
+nacm_check_edit_r(struct lyd_nacm *nacm, const struct lyd_node *edit, const struct lyd_node *data,
+                  enum nacm_edit_op parent_op, const struct lyd_node **denied)
+{
+    const struct lyd_node *iter, *match, *dchild;
+    enum nacm_edit_op op;
+    int access, r, inner;
+
+    LY_TREE_FOR(edit, iter) {
+        op = nacm_edit_op(iter, parent_op);
+        match = nacm_find_instance(data, iter);
+        inner = !(iter->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST | LYS_ANYDATA));
+
+        access = 0;
+        switch (op) {
+        case NACM_OP_NONE:
+            break;
+        case NACM_OP_CREATE:
+            access = LYD_NACM_CREATE;
+            break;
+        case NACM_OP_DELETE:
+            access = LYD_NACM_DELETE;
+            break;
+        case NACM_OP_MERGE:
+        case NACM_OP_REPLACE:
+            if (!match) {
+                access = LYD_NACM_CREATE;
+            } else if (iter->schema->nodetype & LYS_ANYDATA) {
+                access = LYD_NACM_UPDATE;
+            } else if ((iter->schema->nodetype == LYS_LEAF) && !ly_strequal(((struct lyd_node_leaf_list *)iter)->value_str,
+                                                                             ((struct lyd_node_leaf_list *)match)->value_str, 1)) {
+                access = LYD_NACM_UPDATE;
+            }
+            break;
+        }
+
+        /* keys are created and deleted with their list */
+        if (access && !nacm_is_key(iter)) {
+            r = nacm_allowed(nacm, iter, access);
+            if (r < 1) {
+                if (!r && denied) {
+                    *denied = iter;
+                }
+                return r ? -1 : 1;
+            }
+        }
+
+        if (op == NACM_OP_DELETE) {
+            /* all the existing descendants are deleted, too */
+            if (match && inner && match->child) {
+                LY_TREE_FOR(match->child, dchild) {
+                    if ((r = nacm_check_delete(nacm, dchild, denied))) {
+                        return r;
+                    }
+                }
+            }
+            continue;
+        }
+
+        if (!inner) {
+            continue;
+        }
+
+        if ((op == NACM_OP_REPLACE) && match) {
+            /* the existing children not in the edit are deleted */
+            LY_TREE_FOR(match->child, dchild) {
+                if (!nacm_find_instance(iter->child, dchild) && (r = nacm_check_delete(nacm, dchild, denied))) {
+                    return r;
+                }
+            }
+        }
+
+        if (iter->child && (r = nacm_check_edit_r(nacm, iter->child, match ? match->child : NULL, op, denied))) {
+            return r;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Find an action or a nested notification in a data tree.
+ */
+static const struct lyd_node *
+nacm_find_operation(const struct lyd_node *tree)
+{
+    struct lyd_node *next, *elem;
+
+    LY_TREE_DFS_BEGIN((struct lyd_node *)tree, next, elem) {
+        if (elem->schema->nodetype & (LYS_RPC | LYS_ACTION | LYS_NOTIF)) {
+            return elem;
+        }
+        LY_TREE_DFS_END((struct lyd_node *)tree, next, elem);
+    }
+
+    return NULL;
+}
+
+API int
+lyd_nacm_check(struct lyd_nacm *nacm, const struct lyd_node *tree, const struct lyd_node *data, int options,
+               const struct lyd_node **denied)
+{
+    FUN_IN;
+
+    const struct lyd_node *op, *iter;
+    enum nacm_edit_op dflt_op;
+    int ret;
+
+    if (!nacm || !tree) {
+        LOGARG;
+        return -1;
+    }
+    if (denied) {
+        *denied = NULL;
+    }
+
+    if (!nacm->enabled) {
+        return 0;
+    }
+
+    for (; tree->prev->next; tree = tree->prev);
+    if (data) {
+        for (; data->parent; data = data->parent);
+        for (; data->prev->next; data = data->prev);
+    }
+
+    if (!tree->next && (op = nacm_find_operation(tree))) {
+        /* RPC, action, or notification */
+        ret = nacm_allowed(nacm, op, (op->schema->nodetype == LYS_NOTIF) ? LYD_NACM_READ : LYD_NACM_EXEC);
+        if (ret != -1) {
+            ret = ret ? 0 : 1;
+        }
+        if ((ret == 1) && denied) {
+            *denied = op;
+        }
+    } else {
+        if (options & LYD_EDITOPT_NONE) {
+            dflt_op = NACM_OP_NONE;
+        } else if (options & LYD_EDITOPT_REPLACE) {
+            dflt_op = NACM_OP_REPLACE;
+        } else {
+            dflt_op = NACM_OP_MERGE;
+        }
+        ret = nacm_check_edit_r(nacm, tree, data, dflt_op, denied);
+        if (!ret && (dflt_op == NACM_OP_REPLACE)) {
+            /* the top-level nodes missing in the edit are deleted */
+            for (iter = data; iter && !ret; iter = iter->next) {
+                if (!nacm_find_instance(tree, iter)) {
+                    ret = nacm_check_delete(nacm, iter, denied);
+                }
+            }
+        }
+    }
+
+    nacm_instances_clean(nacm);
+    return ret;
+}
@@ -231,6 +231,37 @@ lyp_data_check_options(struct ly_ctx *ctx, int options, const char *func)
         }
     }
 
+    /* LYD_OPT_VAL_INCREMENTAL can be used only with LYD_OPT_DATA or LYD_OPT_CONFIG of the whole tree */
+    if (options & LYD_OPT_VAL_INCREMENTAL) {
+        if ((x & ~LYD_OPT_CONFIG) || (options & (LYD_OPT_NOSIBLINGS | LYD_OPT_WHENAUTODEL))) {
+            LOGERR(ctx, LY_EINVAL, "%s: Invalid options 0x%x (LYD_OPT_VAL_INCREMENTAL can be used only with LYD_OPT_DATA or LYD_OPT_CONFIG"
+                   " and without LYD_OPT_NOSIBLINGS and LYD_OPT_WHENAUTODEL)", func, options);
+            return 1;
+        }
+    }
+
+    if ((options & LYD_OPT_VAL_DIFF_NODUP) && !(options & LYD_OPT_VAL_DIFF)) {
+        LOGERR(ctx, LY_EINVAL, "%s: Invalid options 0x%x (LYD_OPT_VAL_DIFF_NODUP can be used only with LYD_OPT_VAL_DIFF)",
+               func, options);
+        return 1;
+    }
+
+    /* LYD_OPT_VAL_ALL references the data nodes, which must not be freed */
+    if ((options & LYD_OPT_VAL_ALL) && (options & (LYD_OPT_WHENAUTODEL | LYD_OPT_WD_VIRTUAL))) {
+        LOGERR(ctx, LY_EINVAL, "%s: Invalid options 0x%x (LYD_OPT_VAL_ALL cannot be used with LYD_OPT_WHENAUTODEL"
+               " and LYD_OPT_WD_VIRTUAL)", func, options);
+        return 1;
+    }
+
+    /* LYD_OPT_WD_VIRTUAL can be used only with LYD_OPT_DATA or LYD_OPT_CONFIG, the default nodes are freed */
+    if (options & LYD_OPT_WD_VIRTUAL) {
+        if ((x & ~LYD_OPT_CONFIG) || (options & (LYD_OPT_VAL_INCREMENTAL | LYD_OPT_VAL_DIFF))) {
+            LOGERR(ctx, LY_EINVAL, "%s: Invalid options 0x%x (LYD_OPT_WD_VIRTUAL can be used only with LYD_OPT_DATA or LYD_OPT_CONFIG"
+                   " and without LYD_OPT_VAL_INCREMENTAL and LYD_OPT_VAL_DIFF)", func, options);
+            return 1;
+        }
+    }
+
     if (options & (LYD_OPT_DATA_ADD_YANGLIB | LYD_OPT_DATA_NO_YANGLIB)) {
         if (x != LYD_OPT_DATA) {
             LOGERR(ctx, LY_EINVAL, "%s: Invalid options 0x%x (LYD_OPT_DATA_*_YANGLIB can be used only with LYD_OPT_DATA)",
@@ -499,6 +530,84 @@ error:
     return EXIT_FAILURE;
 }
 
+/**
+ * @brief Check whether a value matches one length or range restriction, the intervals are binary searched.
+ *
+ * kind == 0 - unsigned (unum used), 1 - signed (snum used), 2 - floating point (fnum used)
+ *
+ * @return 1 on match, 0 otherwise.
+ */
+static int
+validate_len_ran_restr(const struct len_ran_restr *restr, uint8_t kind, uint64_t unum, int64_t snum, int64_t fnum,
+                       uint8_t fnum_dig)
+{
+    const struct len_ran_intv *intv;
+    uint32_t lo = 0, hi = restr->count, mid;
+
+    /* find the last interval with its minimum not above the value */
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        intv = &restr->intv[mid];
+        if (((kind == 0) && (unum < intv->value.uval.min))
+                || ((kind == 1) && (snum < intv->value.sval.min))
+                || ((kind == 2) && (dec64cmp(fnum, fnum_dig, intv->value.fval.min, restr->type->info.dec64.dig) < 0))) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+    if (!lo) {
+        /* below all the intervals */
+        return 0;
+    }
+
+    intv = &restr->intv[lo - 1];
+    return ((kind == 0) && (unum <= intv->value.uval.max))
+            || ((kind == 1) && (snum <= intv->value.sval.max))
+            || ((kind == 2) && (dec64cmp(fnum, fnum_dig, intv->value.fval.max, restr->type->info.dec64.dig) < 1));
+}
+
+#ifdef LY_ENABLED_CACHE
+
+/**
+ * @brief Get compiled length or range restrictions of a type, they are compiled on the first use.
+ *
+ * @return Compiled restrictions, NULL on error.
+ */
+static struct len_ran_chk *
+validate_len_ran_chk(struct ly_ctx *ctx, struct lys_type *type)
+{
+    void **chk;
+
+    switch (type->base) {
+    case LY_TYPE_BINARY:
+        chk = &type->info.binary.length_chk;
+        break;
+    case LY_TYPE_DEC64:
+        chk = &type->info.dec64.range_chk;
+        break;
+    case LY_TYPE_STRING:
+        chk = &type->info.str.length_chk;
+        break;
+    default:
+        chk = &type->info.num.range_chk;
+        break;
+    }
+
+    if (!*chk) {
+        /* there is no cache, build it */
+        pthread_mutex_lock(&ctx->type_chk_lock);
+        if (!*chk && resolve_len_ran_chk(ctx, type, (struct len_ran_chk **)chk)) {
+            *chk = NULL;
+        }
+        pthread_mutex_unlock(&ctx->type_chk_lock);
+    }
+
+    return *chk;
+}
+
+#endif
+
 /* logs directly
  *
  * kind == 0 - unsigned (unum used), 1 - signed (snum used), 2 - floating point (fnum used)
@@ -508,59 +617,36 @@ validate_length_range(uint8_t kind, uint64_t unum, int64_t snum, int64_t fnum, u
                       const char *val_str, struct lyd_node *node)
 {
     struct lys_restr *restr = NULL;
-    struct len_ran_intv *intv = NULL, *tmp_intv;
+    struct len_ran_chk *chk;
     struct lys_type *cur_type;
     struct ly_ctx *ctx = type->parent->module->ctx;
-    int match;
+    uint32_t u;
 
-    if (resolve_len_ran_interval(ctx, NULL, type, &intv)) {
+#ifdef LY_ENABLED_CACHE
+    chk = validate_len_ran_chk(ctx, type);
+#else
+    if (resolve_len_ran_chk(ctx, type, &chk)) {
+        chk = NULL;
+    }
+#endif
+    if (!chk) {
         /* already done during schema parsing */
         LOGINT(ctx);
         return EXIT_FAILURE;
     }
-    if (!intv) {
-        return EXIT_SUCCESS;
-    }
-
-    /* I know that all intervals belonging to a single restriction share one type pointer */
-    tmp_intv = intv;
-    cur_type = intv->type;
-    do {
-        match = 0;
-        for (; tmp_intv && (tmp_intv->type == cur_type); tmp_intv = tmp_intv->next) {
-            if (match) {
-                /* just iterate through the rest of this restriction intervals */
-                continue;
-            }
 
-            if (((kind == 0) && (unum < tmp_intv->value.uval.min))
-                    || ((kind == 1) && (snum < tmp_intv->value.sval.min))
-                    || ((kind == 2) && (dec64cmp(fnum, fnum_dig, tmp_intv->value.fval.min, cur_type->info.dec64.dig) < 0))) {
-                break;
-            }
-
-            if (((kind == 0) && (unum >= tmp_intv->value.uval.min) && (unum <= tmp_intv->value.uval.max))
-                    || ((kind == 1) && (snum >= tmp_intv->value.sval.min) && (snum <= tmp_intv->value.sval.max))
-                    || ((kind == 2) && (dec64cmp(fnum, fnum_dig, tmp_intv->value.fval.min, cur_type->info.dec64.dig) > -1)
-                    && (dec64cmp(fnum, fnum_dig, tmp_intv->value.fval.max, cur_type->info.dec64.dig) < 1))) {
-                match = 1;
-            }
-        }
-
-        if (!match) {
+    /* the value must match all the restrictions */
+    for (u = 0; u < chk->count; ++u) {
+        if (!validate_len_ran_restr(&chk->restr[u], kind, unum, snum, fnum, fnum_dig)) {
             break;
-        } else if (tmp_intv) {
-            cur_type = tmp_intv->type;
         }
-    } while (tmp_intv);
-
-    while (intv) {
-        tmp_intv = intv->next;
-        free(intv);
-        intv = tmp_intv;
     }
+    cur_type = (u < chk->count) ? chk->restr[u].type : NULL;
+#ifndef LY_ENABLED_CACHE
+    free(chk);
+#endif
 
-    if (!match) {
+    if (cur_type) {
         switch (cur_type->base) {
         case LY_TYPE_BINARY:
             restr = cur_type->info.binary.length;
@@ -598,6 +684,114 @@ validate_length_range(uint8_t kind, uint64_t unum, int64_t snum, int64_t fnum, u
     return EXIT_SUCCESS;
 }
 
+#ifdef LY_ENABLED_CACHE
+
+/**
+ * @brief Compile the patterns of a string type (not its base types), if not yet. The compiled patterns
+ * are published only complete, so the threads validating concurrently never use a partially built array.
+ *
+ * @return EXIT_SUCCESS on success, EXIT_FAILURE on error.
+ */
+static int
+validate_pattern_cache(struct ly_ctx *ctx, struct lys_type *type)
+{
+    unsigned int i;
+    void **patterns_pcre;
+    int rc = EXIT_SUCCESS;
+
+    if (type->info.str.patterns_pcre || !type->info.str.pat_count) {
+        return EXIT_SUCCESS;
+    }
+
+    /* there is no cache, build it */
+    pthread_mutex_lock(&ctx->type_chk_lock);
+    if (!type->info.str.patterns_pcre) {
+        patterns_pcre = malloc(2 * type->info.str.pat_count * sizeof *patterns_pcre);
+        LY_CHECK_ERR_GOTO(!patterns_pcre, LOGMEM(ctx); rc = EXIT_FAILURE, cleanup);
+
+        for (i = 0; i < type->info.str.pat_count; ++i) {
+            if (lyp_pattern_cache_get(ctx, &type->info.str.patterns[i].expr[1], (pcre**)&patterns_pcre[i * 2],
+                                      (pcre_extra**)&patterns_pcre[i * 2 + 1])) {
+                free(patterns_pcre);
+                rc = EXIT_FAILURE;
+                goto cleanup;
+            }
+        }
+        type->info.str.patterns_pcre = patterns_pcre;
+    }
+
+cleanup:
+    pthread_mutex_unlock(&ctx->type_chk_lock);
+    return rc;
+}
+
+#endif
+
+int
+lyp_type_precompute(struct ly_ctx *ctx, struct lys_type *type)
+{
+#ifdef LY_ENABLED_CACHE
+    struct lys_type *iter;
+    unsigned int i, j;
+
+    switch (type->base) {
+    case LY_TYPE_ENUM:
+        /* cache the values of the if-features */
+        for (iter = type; !iter->info.enums.count && iter->der; iter = &iter->der->type);
+        for (i = 0; i < iter->info.enums.count; ++i) {
+            for (j = 0; j < iter->info.enums.enm[i].iffeature_size; ++j) {
+                resolve_iffeature(&iter->info.enums.enm[i].iffeature[j]);
+            }
+        }
+        break;
+    case LY_TYPE_BITS:
+        for (iter = type; !iter->info.bits.count && iter->der; iter = &iter->der->type);
+        for (i = 0; i < iter->info.bits.count; ++i) {
+            for (j = 0; j < iter->info.bits.bit[i].iffeature_size; ++j) {
+                resolve_iffeature(&iter->info.bits.bit[i].iffeature[j]);
+            }
+        }
+        break;
+    case LY_TYPE_STRING:
+        for (iter = type; iter; iter = iter->der ? &iter->der->type : NULL) {
+            if (validate_pattern_cache(ctx, iter)) {
+                return -1;
+            }
+        }
+        /* fallthrough */
+    case LY_TYPE_BINARY:
+    case LY_TYPE_DEC64:
+    case LY_TYPE_INT8:
+    case LY_TYPE_INT16:
+    case LY_TYPE_INT32:
+    case LY_TYPE_INT64:
+    case LY_TYPE_UINT8:
+    case LY_TYPE_UINT16:
+    case LY_TYPE_UINT32:
+    case LY_TYPE_UINT64:
+        if (!validate_len_ran_chk(ctx, type)) {
+            return -1;
+        }
+        break;
+    case LY_TYPE_UNION:
+        for (iter = type; !iter->info.uni.count && iter->der; iter = &iter->der->type);
+        for (i = 0; i < iter->info.uni.count; ++i) {
+            if (lyp_type_precompute(ctx, &iter->info.uni.types[i])) {
+                return -1;
+            }
+        }
+        break;
+    default:
+        break;
+    }
+#else
+    (void)ctx;
+    (void)type;
+#endif
+
+    return EXIT_SUCCESS;
+}
+
 /* logs directly */
 static int
 validate_pattern(struct ly_ctx *ctx, const char *val_str, struct lys_type *type, struct lyd_node *node)
@@ -619,18 +813,8 @@ validate_pattern(struct ly_ctx *ctx, const char *val_str, struct lys_type *type,
     }
 
 #ifdef LY_ENABLED_CACHE
-    /* there is no cache, build it */
-    if (!type->info.str.patterns_pcre && type->info.str.pat_count) {
-        type->info.str.patterns_pcre = malloc(2 * type->info.str.pat_count * sizeof *type->info.str.patterns_pcre);
-        LY_CHECK_ERR_RETURN(!type->info.str.patterns_pcre, LOGMEM(ctx), -1);
-
-        for (i = 0; i < type->info.str.pat_count; ++i) {
-            if (lyp_precompile_pattern(ctx, &type->info.str.patterns[i].expr[1],
-                                       (pcre**)&type->info.str.patterns_pcre[i * 2],
-                                       (pcre_extra**)&type->info.str.patterns_pcre[i * 2 + 1])) {
-                return EXIT_FAILURE;
-            }
-        }
+    if (validate_pattern_cache(ctx, type)) {
+        return EXIT_FAILURE;
     }
 #endif
 
@@ -954,7 +1138,11 @@ lyp_precompile_pattern(struct ly_ctx *ctx, const char *pattern, pcre** pcre_cmp,
     }
 
     if (pcre_std && pcre_cmp) {
+#ifdef PCRE_STUDY_JIT_COMPILE
+        (*pcre_std) = pcre_study(*pcre_cmp, PCRE_STUDY_JIT_COMPILE, &err_msg);
+#else
         (*pcre_std) = pcre_study(*pcre_cmp, 0, &err_msg);
+#endif
         if (err_msg) {
             LOGWRN(ctx, "Studying pattern \"%s\" failed (%s).", pattern, err_msg);
         }
@@ -963,6 +1151,93 @@ lyp_precompile_pattern(struct ly_ctx *ctx, const char *pattern, pcre** pcre_cmp,
     return EXIT_SUCCESS;
 }
 
+#ifdef LY_ENABLED_CACHE
+
+/* record of the compiled pattern cache, see lyp_pattern_cache_get() */
+struct lyp_pattern_rec {
+    char *pattern;
+    pcre *pcre_cmp;
+    pcre_extra *pcre_std;
+};
+
+static int
+lyp_pattern_equal(void *val1_p, void *val2_p, int UNUSED(mod), void *UNUSED(cb_data))
+{
+    return !strcmp(((struct lyp_pattern_rec *)val1_p)->pattern, ((struct lyp_pattern_rec *)val2_p)->pattern);
+}
+
+int
+lyp_pattern_cache_get(struct ly_ctx *ctx, const char *pattern, pcre **pcre_cmp, pcre_extra **pcre_std)
+{
+    struct lyp_pattern_rec rec, *match;
+    uint32_t hash;
+    int ret = EXIT_FAILURE;
+
+    rec.pattern = (char *)pattern;
+    hash = dict_hash_multi(dict_hash_multi(0, pattern, strlen(pattern)), NULL, 0);
+
+    pthread_mutex_lock(&ctx->pattern_cache_lock);
+
+    if (!ctx->pattern_cache) {
+        ctx->pattern_cache = lyht_new(8, sizeof rec, lyp_pattern_equal, NULL, 1);
+        LY_CHECK_ERR_GOTO(!ctx->pattern_cache, LOGMEM(ctx), cleanup);
+    }
+
+    if (lyht_find(ctx->pattern_cache, &rec, hash, (void **)&match)) {
+        /* not compiled yet */
+        rec.pcre_std = NULL;
+        if (lyp_precompile_pattern(ctx, pattern, &rec.pcre_cmp, &rec.pcre_std)) {
+            goto cleanup;
+        }
+        rec.pattern = strdup(pattern);
+        LY_CHECK_ERR_GOTO(!rec.pattern, LOGMEM(ctx); pcre_free(rec.pcre_cmp); pcre_free_study(rec.pcre_std), cleanup);
+        if (lyht_insert(ctx->pattern_cache, &rec, hash, (void **)&match)) {
+            LOGMEM(ctx);
+            free(rec.pattern);
+            pcre_free(rec.pcre_cmp);
+            pcre_free_study(rec.pcre_std);
+            goto cleanup;
+        }
+    }
+
+    *pcre_cmp = match->pcre_cmp;
+    if (pcre_std) {
+        *pcre_std = match->pcre_std;
+    }
+    ret = EXIT_SUCCESS;
+
+cleanup:
+    pthread_mutex_unlock(&ctx->pattern_cache_lock);
+    return ret;
+}
+
+void
+lyp_pattern_cache_clean(struct ly_ctx *ctx)
+{
+    struct lyp_pattern_rec *rec;
+    uint32_t i;
+
+    pthread_mutex_lock(&ctx->pattern_cache_lock);
+
+    if (ctx->pattern_cache) {
+        lyht_finish_resize(ctx->pattern_cache);
+        for (i = 0; i < ctx->pattern_cache->size; ++i) {
+            rec = lyht_get_val(ctx->pattern_cache, i);
+            if (rec) {
+                free(rec->pattern);
+                pcre_free(rec->pcre_cmp);
+                pcre_free_study(rec->pcre_std);
+            }
+        }
+        lyht_free(ctx->pattern_cache);
+        ctx->pattern_cache = NULL;
+    }
+
+    pthread_mutex_unlock(&ctx->pattern_cache_lock);
+}
+
+#endif
+
 /**
  * @brief Change the value into its canonical form. In libyang, additionally to the RFC,
  * all identities have their module as a prefix in their canonical form.
@@ -1204,7 +1479,8 @@ ident_val_add_module_prefix(const char *value, const struct lyxml_elem *xml, str
  * local_mod - optional if the local module dos not match the module of leaf/attr
  * store - flag for union resolution - we do not want to store the result, we are just learning the type
  * dflt - whether the value is a default value from the schema
- * trusted - whether the value is trusted to be valid (but may not be canonical, so it is canonized)
+ * trusted - whether the value is trusted to be valid (but may not be canonical, so it is canonized),
+ *           #LYP_TRUSTED_CANONICAL if it is also trusted to be canonical
  */
 struct lys_type *
 lyp_parse_value(struct lys_type *type, const char **value_, struct lyxml_elem *xml,
@@ -1225,6 +1501,7 @@ lyp_parse_value(struct lys_type *type, const char **value_, struct lyxml_elem *x
     LY_DATA_TYPE *val_type, old_val_type;
     uint8_t *val_flags, old_val_flags;
     struct lyd_node *contextnode;
+    struct lys_type *old_type = type;
     struct ly_ctx *ctx = type->parent->module->ctx;
 
     assert(leaf || attr);
@@ -1253,9 +1530,14 @@ lyp_parse_value(struct lys_type *type, const char **value_, struct lyxml_elem *x
 
     /* fully clear the value */
     if (store) {
-        old_val_str = lydict_insert(ctx, *value_, 0);
+        if (*val_flags & LY_VALUE_USER) {
+            /* the string is needed only to free a user type value */
+            old_val_str = lydict_insert(ctx, *value_, 0);
+        }
         lyd_free_value(*val, *val_type, *val_flags, type, old_val_str, &old_val, &old_val_type, &old_val_flags);
-        *val_flags &= ~LY_VALUE_UNRES;
+        /* the backup is owned only by this call, nested calls for union members or leafref targets must not free it */
+        memset(val, 0, sizeof *val);
+        *val_flags &= ~(LY_VALUE_UNRES | LY_VALUE_USER);
     }
 
     switch (type->base) {
@@ -1420,7 +1702,8 @@ lyp_parse_value(struct lys_type *type, const char **value_, struct lyxml_elem *x
             c = c + len;
         }
 
-        if (make_canonical(ctx, LY_TYPE_BITS, value_, bits, &type->info.bits.count) == -1) {
+        if ((trusted != LYP_TRUSTED_CANONICAL)
+                && (make_canonical(ctx, LY_TYPE_BITS, value_, bits, &type->info.bits.count) == -1)) {
             free(bits);
             goto error;
         }
@@ -1481,7 +1764,8 @@ lyp_parse_value(struct lys_type *type, const char **value_, struct lyxml_elem *x
             goto error;
         }
 
-        if (make_canonical(ctx, LY_TYPE_DEC64, value_, &num, &type->info.dec64.dig) == -1) {
+        if ((trusted != LYP_TRUSTED_CANONICAL)
+                && (make_canonical(ctx, LY_TYPE_DEC64, value_, &num, &type->info.dec64.dig) == -1)) {
             goto error;
         }
 
@@ -1769,7 +2053,7 @@ lyp_parse_value(struct lys_type *type, const char **value_, struct lyxml_elem *x
             goto error;
         }
 
-        if (make_canonical(ctx, LY_TYPE_INT8, value_, &num, NULL) == -1) {
+        if ((trusted != LYP_TRUSTED_CANONICAL) && (make_canonical(ctx, LY_TYPE_INT8, value_, &num, NULL) == -1)) {
             goto error;
         }
 
@@ -1786,7 +2070,7 @@ lyp_parse_value(struct lys_type *type, const char **value_, struct lyxml_elem *x
             goto error;
         }
 
-        if (make_canonical(ctx, LY_TYPE_INT16, value_, &num, NULL) == -1) {
+        if ((trusted != LYP_TRUSTED_CANONICAL) && (make_canonical(ctx, LY_TYPE_INT16, value_, &num, NULL) == -1)) {
             goto error;
         }
 
@@ -1803,7 +2087,7 @@ lyp_parse_value(struct lys_type *type, const char **value_, struct lyxml_elem *x
             goto error;
         }
 
-        if (make_canonical(ctx, LY_TYPE_INT32, value_, &num, NULL) == -1) {
+        if ((trusted != LYP_TRUSTED_CANONICAL) && (make_canonical(ctx, LY_TYPE_INT32, value_, &num, NULL) == -1)) {
             goto error;
         }
 
@@ -1821,7 +2105,7 @@ lyp_parse_value(struct lys_type *type, const char **value_, struct lyxml_elem *x
             goto error;
         }
 
-        if (make_canonical(ctx, LY_TYPE_INT64, value_, &num, NULL) == -1) {
+        if ((trusted != LYP_TRUSTED_CANONICAL) && (make_canonical(ctx, LY_TYPE_INT64, value_, &num, NULL) == -1)) {
             goto error;
         }
 
@@ -1838,7 +2122,7 @@ lyp_parse_value(struct lys_type *type, const char **value_, struct lyxml_elem *x
             goto error;
         }
 
-        if (make_canonical(ctx, LY_TYPE_UINT8, value_, &unum, NULL) == -1) {
+        if ((trusted != LYP_TRUSTED_CANONICAL) && (make_canonical(ctx, LY_TYPE_UINT8, value_, &unum, NULL) == -1)) {
             goto error;
         }
 
@@ -1855,7 +2139,7 @@ lyp_parse_value(struct lys_type *type, const char **value_, struct lyxml_elem *x
             goto error;
         }
 
-        if (make_canonical(ctx, LY_TYPE_UINT16, value_, &unum, NULL) == -1) {
+        if ((trusted != LYP_TRUSTED_CANONICAL) && (make_canonical(ctx, LY_TYPE_UINT16, value_, &unum, NULL) == -1)) {
             goto error;
         }
 
@@ -1872,7 +2156,7 @@ lyp_parse_value(struct lys_type *type, const char **value_, struct lyxml_elem *x
             goto error;
         }
 
-        if (make_canonical(ctx, LY_TYPE_UINT32, value_, &unum, NULL) == -1) {
+        if ((trusted != LYP_TRUSTED_CANONICAL) && (make_canonical(ctx, LY_TYPE_UINT32, value_, &unum, NULL) == -1)) {
             goto error;
         }
 
@@ -1889,7 +2173,7 @@ lyp_parse_value(struct lys_type *type, const char **value_, struct lyxml_elem *x
             goto error;
         }
 
-        if (make_canonical(ctx, LY_TYPE_UINT64, value_, &unum, NULL) == -1) {
+        if ((trusted != LYP_TRUSTED_CANONICAL) && (make_canonical(ctx, LY_TYPE_UINT64, value_, &unum, NULL) == -1)) {
             goto error;
         }
 
@@ -1931,6 +2215,11 @@ lyp_parse_value(struct lys_type *type, const char **value_, struct lyxml_elem *x
 
         while ((t = lyp_get_next_union_type(type, t, &found))) {
             found = 0;
+            if (!lyp_union_type_may_match(t, *value_)) {
+                /* the value cannot be of this type */
+                continue;
+            }
+
             ret = lyp_parse_value(t, value_, xml, leaf, attr, NULL, store, dflt, 0);
             if (ret) {
                 /* we have the result */
@@ -1967,9 +2256,9 @@ lyp_parse_value(struct lys_type *type, const char **value_, struct lyxml_elem *x
         goto error;
     }
 
-    /* search user types in case this value is supposed to be stored in a custom way */
-    if (store && type->der && type->der->module) {
-        c = lytype_store(type->der->module, type->der->name, value_, val);
+    /* search user types in case this value is supposed to be stored in a custom way (unless a nested call already did) */
+    if (store && !(*val_flags & LY_VALUE_USER) && type->der && type->der->module) {
+        c = lytype_store(type->der, value_, val);
         if (c == -1) {
             goto error;
         } else if (!c) {
@@ -1977,9 +2266,9 @@ lyp_parse_value(struct lys_type *type, const char **value_, struct lyxml_elem *x
         }
     }
 
-    /* free backup */
+    /* free backup, it was stored for the original (possibly union) type */
     if (store) {
-        lyd_free_value(old_val, old_val_type, old_val_flags, type, old_val_str, NULL, NULL, NULL);
+        lyd_free_value(old_val, old_val_type, old_val_flags, old_type, old_val_str, NULL, NULL, NULL);
         lydict_remove(ctx, old_val_str);
     }
     return type;
@@ -1995,6 +2284,284 @@ error:
     return NULL;
 }
 
+int
+lyp_parse_number(struct lyd_node_leaf_list *leaf, const char *number, unsigned int len, int trusted)
+{
+    struct lys_type *type = &((struct lys_node_leaf *)leaf->schema)->type;
+    struct ly_ctx *ctx = leaf->schema->module->ctx;
+    const char *ptr;
+    int64_t num = 0, min = 0, max = 0;
+    uint64_t unum = 0, umax = 0;
+    unsigned int i;
+    int c, neg;
+
+    if (strnchr(number, 'e', len) || strnchr(number, 'E', len)) {
+        /* needs to be converted first */
+        return 1;
+    }
+
+    switch (type->base) {
+    case LY_TYPE_INT8:
+        min = __INT64_C(-128);
+        max = __INT64_C(127);
+        break;
+    case LY_TYPE_INT16:
+        min = __INT64_C(-32768);
+        max = __INT64_C(32767);
+        break;
+    case LY_TYPE_INT32:
+        min = __INT64_C(-2147483648);
+        max = __INT64_C(2147483647);
+        break;
+    case LY_TYPE_INT64:
+        min = __INT64_C(-9223372036854775807) - __INT64_C(1);
+        max = __INT64_C(9223372036854775807);
+        break;
+    case LY_TYPE_UINT8:
+        umax = __UINT64_C(255);
+        break;
+    case LY_TYPE_UINT16:
+        umax = __UINT64_C(65535);
+        break;
+    case LY_TYPE_UINT32:
+        umax = __UINT64_C(4294967295);
+        break;
+    case LY_TYPE_UINT64:
+        umax = __UINT64_C(18446744073709551615);
+        break;
+    case LY_TYPE_DEC64:
+        break;
+    default:
+        return 1;
+    }
+
+    /* JSON numbers have no leading zeros nor plus sign, the number is canonical unless changed below */
+    leaf->value_str = lydict_insert(ctx, number, len);
+
+    if (type->base == LY_TYPE_DEC64) {
+        ptr = number;
+        if (parse_range_dec64(&ptr, type->info.dec64.dig, &num) || (ptr != number + len)) {
+            goto inval;
+        }
+        if (!trusted && validate_length_range(2, 0, 0, num, type->info.dec64.dig, type, leaf->value_str,
+                                              (struct lyd_node *)leaf)) {
+            return -1;
+        }
+        if (!strnchr(number, '.', len) || (number[len - 1] == '0')) {
+            /* missing or trailing fraction digits */
+            if (make_canonical(ctx, LY_TYPE_DEC64, &leaf->value_str, &num, &type->info.dec64.dig) == -1) {
+                return -1;
+            }
+        }
+        leaf->value.dec64 = num;
+    } else {
+        neg = (number[0] == '-');
+        for (i = neg; i < len; ++i) {
+            if (!isdigit(number[i])) {
+                /* fraction digits, invalid */
+                goto inval;
+            }
+            c = number[i] - '0';
+            if (unum > (__UINT64_C(18446744073709551615) - c) / 10) {
+                goto inval;
+            }
+            unum = unum * 10 + c;
+        }
+
+        if (umax) {
+            /* unsigned */
+            if ((neg && unum) || (unum > umax)) {
+                goto inval;
+            }
+            if (!trusted && validate_length_range(0, unum, 0, 0, 0, type, leaf->value_str, (struct lyd_node *)leaf)) {
+                return -1;
+            }
+        } else {
+            if (neg) {
+                if (unum > (uint64_t)max + 1) {
+                    goto inval;
+                }
+                num = (unum > (uint64_t)max) ? min : -(int64_t)unum;
+            } else {
+                if (unum > (uint64_t)max) {
+                    goto inval;
+                }
+                num = unum;
+            }
+            if (!trusted && validate_length_range(1, 0, num, 0, 0, type, leaf->value_str, (struct lyd_node *)leaf)) {
+                return -1;
+            }
+        }
+
+        if (neg && !unum) {
+            /* "-0" */
+            lydict_remove(ctx, leaf->value_str);
+            leaf->value_str = lydict_insert(ctx, "0", 1);
+        }
+
+        switch (type->base) {
+        case LY_TYPE_INT8:
+            leaf->value.int8 = (int8_t)num;
+            break;
+        case LY_TYPE_INT16:
+            leaf->value.int16 = (int16_t)num;
+            break;
+        case LY_TYPE_INT32:
+            leaf->value.int32 = (int32_t)num;
+            break;
+        case LY_TYPE_INT64:
+            leaf->value.int64 = num;
+            break;
+        case LY_TYPE_UINT8:
+            leaf->value.uint8 = (uint8_t)unum;
+            break;
+        case LY_TYPE_UINT16:
+            leaf->value.uint16 = (uint16_t)unum;
+            break;
+        case LY_TYPE_UINT32:
+            leaf->value.uint32 = (uint32_t)unum;
+            break;
+        default:
+            leaf->value.uint64 = unum;
+            break;
+        }
+    }
+    leaf->value_type = type->base;
+
+    /* search user types in case this value is supposed to be stored in a custom way */
+    if (type->der && type->der->module) {
+        c = lytype_store(type->der, &leaf->value_str, &leaf->value);
+        if (c == -1) {
+            return -1;
+        } else if (!c) {
+            leaf->value_flags |= LY_VALUE_USER;
+        }
+    }
+
+    return 0;
+
+inval:
+    LOGVAL(ctx, LYE_INVAL, LY_VLOG_LYD, leaf, leaf->value_str, leaf->schema->name);
+    return -1;
+}
+
+int
+lyp_store_value(struct lyd_node_leaf_list *leaf, struct lys_type *type, const void *value, int trusted)
+{
+    struct ly_ctx *ctx = leaf->schema->module->ctx;
+    struct lys_type *iter;
+    char buf[32];
+    int64_t num = 0;
+    uint64_t unum = 0;
+    int c, kind, j;
+    unsigned int i;
+
+    switch (type->base) {
+    case LY_TYPE_BOOL:
+        leaf->value.bln = *(const int8_t *)value ? 1 : 0;
+        lydict_remove(ctx, leaf->value_str);
+        leaf->value_str = lydict_insert(ctx, leaf->value.bln ? "true" : "false", 0);
+        leaf->value_type = LY_TYPE_BOOL;
+        return 0;
+    case LY_TYPE_ENUM:
+        /* the first type with the (restricted) enums */
+        for (iter = type; !iter->info.enums.count; iter = &iter->der->type);
+        for (i = 0; i < iter->info.enums.count; ++i) {
+            if (iter->info.enums.enm[i].value == *(const int32_t *)value) {
+                break;
+            }
+        }
+        if (i == iter->info.enums.count) {
+            sprintf(buf, "%"PRId32, *(const int32_t *)value);
+            LOGVAL(ctx, LYE_INVAL, LY_VLOG_LYD, leaf, buf, leaf->schema->name);
+            return -1;
+        }
+        for (j = 0; !trusted && (j < iter->info.enums.enm[i].iffeature_size); ++j) {
+            if (!resolve_iffeature(&iter->info.enums.enm[i].iffeature[j])) {
+                LOGVAL(ctx, LYE_INVAL, LY_VLOG_LYD, leaf, iter->info.enums.enm[i].name, leaf->schema->name);
+                LOGVAL(ctx, LYE_SPEC, LY_VLOG_PREV, NULL, "Enum \"%s\" is disabled by its %d. if-feature condition.",
+                       iter->info.enums.enm[i].name, j + 1);
+                return -1;
+            }
+        }
+        leaf->value.enm = &iter->info.enums.enm[i];
+        lydict_remove(ctx, leaf->value_str);
+        leaf->value_str = lydict_insert(ctx, leaf->value.enm->name, 0);
+        leaf->value_type = LY_TYPE_ENUM;
+        return 0;
+    case LY_TYPE_INT8:
+        num = leaf->value.int8 = *(const int8_t *)value;
+        break;
+    case LY_TYPE_INT16:
+        num = leaf->value.int16 = *(const int16_t *)value;
+        break;
+    case LY_TYPE_INT32:
+        num = leaf->value.int32 = *(const int32_t *)value;
+        break;
+    case LY_TYPE_INT64:
+        num = leaf->value.int64 = *(const int64_t *)value;
+        break;
+    case LY_TYPE_UINT8:
+        unum = leaf->value.uint8 = *(const uint8_t *)value;
+        break;
+    case LY_TYPE_UINT16:
+        unum = leaf->value.uint16 = *(const uint16_t *)value;
+        break;
+    case LY_TYPE_UINT32:
+        unum = leaf->value.uint32 = *(const uint32_t *)value;
+        break;
+    case LY_TYPE_UINT64:
+        unum = leaf->value.uint64 = *(const uint64_t *)value;
+        break;
+    case LY_TYPE_DEC64:
+        num = leaf->value.dec64 = *(const int64_t *)value;
+        break;
+    default:
+        return 1;
+    }
+    leaf->value_type = type->base;
+
+    /* canonical string value */
+    switch (type->base) {
+    case LY_TYPE_DEC64:
+        kind = 2;
+        if (make_canonical(ctx, LY_TYPE_DEC64, &leaf->value_str, &num, &type->info.dec64.dig) == -1) {
+            return -1;
+        }
+        break;
+    case LY_TYPE_INT8:
+    case LY_TYPE_INT16:
+    case LY_TYPE_INT32:
+    case LY_TYPE_INT64:
+        kind = 1;
+        lydict_remove(ctx, leaf->value_str);
+        leaf->value_str = lydict_insert(ctx, buf, sprintf(buf, "%"PRId64, num));
+        break;
+    default:
+        kind = 0;
+        lydict_remove(ctx, leaf->value_str);
+        leaf->value_str = lydict_insert(ctx, buf, sprintf(buf, "%"PRIu64, unum));
+        break;
+    }
+
+    if (!trusted && validate_length_range(kind, unum, num, num, (kind == 2) ? type->info.dec64.dig : 0, type,
+                                          leaf->value_str, (struct lyd_node *)leaf)) {
+        return -1;
+    }
+
+    /* search user types in case this value is supposed to be stored in a custom way */
+    if (type->der && type->der->module) {
+        c = lytype_store(type->der, &leaf->value_str, &leaf->value);
+        if (c == -1) {
+            return -1;
+        } else if (!c) {
+            leaf->value_flags |= LY_VALUE_USER;
+        }
+    }
+
+    return 0;
+}
+
 /* does not log, cannot fail */
 struct lys_type *
 lyp_get_next_union_type(struct lys_type *type, struct lys_type *prev_type, int *found)
@@ -2029,16 +2596,54 @@ lyp_get_next_union_type(struct lys_type *type, struct lys_type *prev_type, int *
     return ret;
 }
 
+int
+lyp_union_type_may_match(const struct lys_type *type, const char *value)
+{
+    if (!value) {
+        value = "";
+    }
+
+    switch (type->base) {
+    case LY_TYPE_INT8:
+    case LY_TYPE_INT16:
+    case LY_TYPE_INT32:
+    case LY_TYPE_INT64:
+    case LY_TYPE_UINT8:
+    case LY_TYPE_UINT16:
+    case LY_TYPE_UINT32:
+    case LY_TYPE_UINT64:
+        /* strtoll() and strtoull() skip leading whitespaces and need a digit after an optional sign */
+        while (isspace(value[0])) {
+            ++value;
+        }
+        if ((value[0] == '-') || (value[0] == '+')) {
+            ++value;
+        }
+        return isdigit(value[0]);
+    case LY_TYPE_DEC64:
+        if ((value[0] == '-') || (value[0] == '+')) {
+            ++value;
+        }
+        return isdigit(value[0]);
+    case LY_TYPE_BOOL:
+        return !strcmp(value, "true") || !strcmp(value, "false");
+    case LY_TYPE_EMPTY:
+        return !value[0];
+    default:
+        /* the shape of other values is not limited enough */
+        return 1;
+    }
+}
+
 /* ret 0 - ret set, ret 1 - ret not set, no log, ret -1 - ret not set, fatal error */
 int
 lyp_fill_attr(struct ly_ctx *ctx, struct lyd_node *parent, const char *module_ns, const char *module_name,
               const char *attr_name, const char *attr_value, struct lyxml_elem *xml, int options, struct lyd_attr **ret)
 {
     const struct lys_module *mod = NULL;
-    const struct lys_submodule *submod = NULL;
     struct lys_type **type;
     struct lyd_attr *dattr;
-    int pos, i, j, k;
+    struct lys_ext_instance *annot;
 
     /* first, get module where the annotation should be defined */
     if (module_ns) {
@@ -2053,58 +2658,29 @@ lyp_fill_attr(struct ly_ctx *ctx, struct lyd_node *parent, const char *module_ns
         return 1;
     }
 
-    /* then, find the appropriate annotation definition */
-    pos = -1;
-    for (i = 0, j = 0; i < mod->ext_size; i = i + j + 1) {
-        j = lys_ext_instance_presence(&ctx->models.list[0]->extensions[0], &mod->ext[i], mod->ext_size - i);
-        if (j == -1) {
-            break;
-        }
-        if (ly_strequal(mod->ext[i + j]->arg_value, attr_name, 0)) {
-            pos = i + j;
-            break;
-        }
-    }
-
-    /* try submodules */
-    if (pos == -1) {
-        for (k = 0; k < mod->inc_size; ++k) {
-            submod = mod->inc[k].submodule;
-            for (i = 0, j = 0; i < submod->ext_size; i = i + j + 1) {
-                j = lys_ext_instance_presence(&ctx->models.list[0]->extensions[0], &submod->ext[i], submod->ext_size - i);
-                if (j == -1) {
-                    break;
-                }
-                if (ly_strequal(submod->ext[i + j]->arg_value, attr_name, 0)) {
-                    pos = i + j;
-                    break;
-                }
-            }
-        }
-    }
-
-    if (pos == -1) {
+    /* then, find the appropriate annotation definition, in the module or its submodules */
+    annot = lyp_ext_instance_find(mod, "ietf-yang-metadata", "annotation", attr_name, strlen(attr_name));
+    if (!annot) {
         return 1;
     }
 
     /* allocate and fill the data attribute structure */
-    dattr = calloc(1, sizeof *dattr);
+    dattr = lyd_pool_alloc(ctx, sizeof *dattr);
     LY_CHECK_ERR_RETURN(!dattr, LOGMEM(ctx), -1);
 
     dattr->parent = parent;
     dattr->next = NULL;
-    dattr->annotation = submod ? (struct lys_ext_instance_complex *)submod->ext[pos] :
-                                 (struct lys_ext_instance_complex *)mod->ext[pos];
+    dattr->annotation = (struct lys_ext_instance_complex *)annot;
     dattr->name = lydict_insert(ctx, attr_name, 0);
     dattr->value_str = lydict_insert(ctx, attr_value, 0);
 
     /* the value is here converted to a JSON format if needed in case of LY_TYPE_IDENT and LY_TYPE_INST or to a
      * canonical form of the value */
     type = lys_ext_complex_get_substmt(LY_STMT_TYPE, dattr->annotation, NULL);
-    if (!type || !lyp_parse_value(*type, &dattr->value_str, xml, NULL, dattr, NULL, 1, 0, options & LYD_OPT_TRUSTED)) {
+    if (!type || !lyp_parse_value(*type, &dattr->value_str, xml, NULL, dattr, NULL, 1, 0, LYP_TRUSTED_OPT(options))) {
         lydict_remove(ctx, dattr->name);
         lydict_remove(ctx, dattr->value_str);
-        free(dattr);
+        lyd_pool_free(ctx, dattr);
         return -1;
     }
 
@@ -3480,6 +4056,12 @@ lyp_deviation_apply_ext(struct lys_module *module)
     struct ly_set *extset;
 
     for (i = 0; i < module->deviation_size; i++) {
+        for (j = 0; (j < module->deviation[i].deviate_size) && !module->deviation[i].deviate[j].ext_size; j++);
+        if (j == module->deviation[i].deviate_size) {
+            /* no extensions in any deviate, do not even resolve the target */
+            continue;
+        }
+
         target = NULL;
         extset = NULL;
         j = resolve_schema_nodeid(module->deviation[i].target_name, NULL, module, &extset, 0, 0);
@@ -3645,13 +4227,13 @@ lyp_ctx_check_module(struct lys_module *module)
 int
 lyp_ctx_add_module(struct lys_module *module)
 {
+    struct ly_ctx *ctx = module->ctx;
     struct lys_module **newlist = NULL;
-    int i;
 
     assert(!lyp_ctx_check_module(module));
 
 #ifndef NDEBUG
-    int j;
+    int i, j;
     /* check that all augments are resolved */
     for (i = 0; i < module->augment_size; ++i) {
         assert(module->augment[i].target);
@@ -3663,18 +4245,29 @@ lyp_ctx_add_module(struct lys_module *module)
     }
 #endif
 
-    /* add to the context's list of modules */
-    if (module->ctx->models.used == module->ctx->models.size) {
-        newlist = realloc(module->ctx->models.list, (2 * module->ctx->models.size) * sizeof *newlist);
-        LY_CHECK_ERR_RETURN(!newlist, LOGMEM(module->ctx), -1);
-        for (i = module->ctx->models.size; i < module->ctx->models.size * 2; i++) {
-            newlist[i] = NULL;
+    /* add to the context's list of modules, it is read without locking so it is never reallocated, only replaced */
+    if (ctx->models.used == ctx->models.size) {
+        newlist = calloc(2 * ctx->models.size, sizeof *newlist);
+        LY_CHECK_ERR_RETURN(!newlist, LOGMEM(ctx), -1);
+        memcpy(newlist, ctx->models.list, ctx->models.used * sizeof *newlist);
+        if (ly_ctx_modules_retire(ctx, ctx->models.list, 0)) {
+            free(newlist);
+            return -1;
         }
-        module->ctx->models.size *= 2;
-        module->ctx->models.list = newlist;
+        ctx->models.size *= 2;
+        LY_ATOMIC_STORE(ctx->models.list, newlist);
+    }
+    if (ly_ctx_module_index_add(module)) {
+        return -1;
     }
-    module->ctx->models.list[module->ctx->models.used++] = module;
-    module->ctx->models.module_set_id++;
+    /* the module is visible in the list only after it is stored there */
+    ctx->models.list[ctx->models.used] = module;
+    LY_ATOMIC_STORE(ctx->models.used, ctx->models.used + 1);
+    ctx->models.module_set_id++;
+    /* the expressions could be evaluated before all their features were resolved */
+    lys_features_changed(ctx);
+    /* free the replaced lists and indices if no reader uses them */
+    ly_ctx_modules_reclaim(ctx);
 
     return 0;
 }
@@ -3916,28 +4509,157 @@ lyp_get_yang_data_template_name(const struct lyd_node *node)
 const struct lys_node *
 lyp_get_yang_data_template(const struct lys_module *module, const char *yang_data_name, int yang_data_name_len)
 {
-    int i, j;
-    const struct lys_node *ret = NULL;
-    const struct lys_submodule *submodule;
+    return (struct lys_node *)lyp_ext_instance_find(module, "ietf-restconf", "yang-data", yang_data_name, yang_data_name_len);
+}
 
-    for(i = 0; i < module->ext_size; ++i) {
-        if (!strcmp(module->ext[i]->def->name, "yang-data") && !strncmp(module->ext[i]->arg_value, yang_data_name, yang_data_name_len)
-            && !module->ext[i]->arg_value[yang_data_name_len]) {
-            ret = (struct lys_node *)module->ext[i];
-            break;
+/* record of the extension instances index, the strings are not terminated in the searched record */
+struct lyp_ext_rec {
+    const struct lys_module *module; /* main module of the instance */
+    const char *def_module;          /* main module of the extension definition */
+    const char *def_name;
+    const char *arg;
+    int arg_len;
+    struct lys_ext_instance *ext;
+};
+
+static int
+lyp_ext_equal(void *val1_p, void *val2_p, int UNUSED(mod), void *UNUSED(cb_data))
+{
+    struct lyp_ext_rec *rec1 = val1_p, *rec2 = val2_p;
+
+    return (rec1->module == rec2->module) && (rec1->arg_len == rec2->arg_len) && !strcmp(rec1->def_name, rec2->def_name)
+            && !strcmp(rec1->def_module, rec2->def_module) && !strncmp(rec1->arg, rec2->arg, rec1->arg_len);
+}
+
+static uint32_t
+lyp_ext_hash(const struct lyp_ext_rec *rec)
+{
+    uint32_t hash;
+
+    hash = dict_hash_multi(0, (const char *)&rec->module, sizeof rec->module);
+    hash = dict_hash_multi(hash, rec->def_module, strlen(rec->def_module));
+    hash = dict_hash_multi(hash, rec->def_name, strlen(rec->def_name));
+    hash = dict_hash_multi(hash, rec->arg, rec->arg_len);
+    return dict_hash_multi(hash, NULL, 0);
+}
+
+static int
+lyp_ext_index_instances(struct hash_table *ht, const struct lys_module *mod, struct lys_ext_instance **ext, uint8_t ext_size)
+{
+    struct lyp_ext_rec rec;
+    uint8_t i;
+
+    rec.module = mod;
+    for (i = 0; i < ext_size; ++i) {
+        if (!ext[i]->arg_value) {
+            continue;
+        }
+        rec.def_module = lys_main_module(ext[i]->def->module)->name;
+        rec.def_name = ext[i]->def->name;
+        rec.arg = ext[i]->arg_value;
+        rec.arg_len = strlen(ext[i]->arg_value);
+        rec.ext = ext[i];
+
+        /* with more instances of the same argument, the first one is found, lyht_insert() then just returns 1 */
+        if (lyht_insert(ht, &rec, lyp_ext_hash(&rec), NULL) == -1) {
+            return -1;
         }
     }
+    return EXIT_SUCCESS;
+}
 
-    for(j = 0; !ret && j < module->inc_size; ++j) {
-        submodule = module->inc[j].submodule;
-        for(i = 0; i < submodule->ext_size; ++i) {
-            if (!strcmp(submodule->ext[i]->def->name, "yang-data") && !strncmp(submodule->ext[i]->arg_value, yang_data_name, yang_data_name_len)
-                && !submodule->ext[i]->arg_value[yang_data_name_len]) {
-                ret = (struct lys_node *)submodule->ext[i];
-                break;
+/* ctx->exts_lock must be held, for writing if the index is not built */
+static int
+lyp_ext_instances_index_build(struct ly_ctx *ctx)
+{
+    struct lys_module *mod;
+    int i;
+    uint8_t j;
+
+    if (ctx->exts && (ctx->exts_set_id == ctx->models.module_set_id)) {
+        return EXIT_SUCCESS;
+    }
+
+    lyht_free(ctx->exts);
+    ctx->exts = lyht_new(64, sizeof(struct lyp_ext_rec), lyp_ext_equal, NULL, 1);
+    LY_CHECK_ERR_RETURN(!ctx->exts, LOGMEM(ctx), -1);
+
+    /* the module instances first, they are found before the ones of the submodules */
+    for (i = 0; i < ctx->models.used; ++i) {
+        mod = ctx->models.list[i];
+        if (lyp_ext_index_instances(ctx->exts, mod, mod->ext, mod->ext_size)) {
+            goto error;
+        }
+        for (j = 0; j < mod->inc_size; ++j) {
+            if (mod->inc[j].submodule && lyp_ext_index_instances(ctx->exts, mod, mod->inc[j].submodule->ext,
+                                                                 mod->inc[j].submodule->ext_size)) {
+                goto error;
             }
         }
     }
+    ctx->exts_set_id = ctx->models.module_set_id;
+    return EXIT_SUCCESS;
+
+error:
+    LOGMEM(ctx);
+    lyht_free(ctx->exts);
+    ctx->exts = NULL;
+    return -1;
+}
+
+struct lys_ext_instance *
+lyp_ext_instance_find(const struct lys_module *module, const char *def_module, const char *def_name, const char *arg,
+                      int arg_len)
+{
+    struct ly_ctx *ctx;
+    struct lyp_ext_rec rec, *match;
+    struct lys_ext_instance *ret = NULL;
+    uint32_t hash;
+
+    assert(module && def_module && def_name && arg);
+
+    ctx = module->ctx;
+    rec.module = lys_main_module(module);
+    rec.def_module = def_module;
+    rec.def_name = def_name;
+    rec.arg = arg;
+    rec.arg_len = arg_len;
+    hash = lyp_ext_hash(&rec);
+
+    /* the index is usually built already, the readers do not block each other */
+    pthread_rwlock_rdlock(&ctx->exts_lock);
+    if (!ctx->exts || (ctx->exts_set_id != ctx->models.module_set_id)) {
+        pthread_rwlock_unlock(&ctx->exts_lock);
+        pthread_rwlock_wrlock(&ctx->exts_lock);
+    }
+
+    if (!lyp_ext_instances_index_build(ctx) && !lyht_find(ctx->exts, &rec, hash, (void **)&match)) {
+        ret = match->ext;
+    }
 
+    pthread_rwlock_unlock(&ctx->exts_lock);
     return ret;
 }
+
+int
+lyp_ext_instances_index(struct ly_ctx *ctx)
+{
+    int rc;
+
+    pthread_rwlock_wrlock(&ctx->exts_lock);
+    rc = lyp_ext_instances_index_build(ctx);
+    pthread_rwlock_unlock(&ctx->exts_lock);
+
+    return rc;
+}
+
+void
+lyp_ext_instances_clean(struct ly_ctx *ctx)
+{
+    pthread_rwlock_wrlock(&ctx->exts_lock);
+
+    lyht_free(ctx->exts);
+    ctx->exts = NULL;
+
+    pthread_rwlock_unlock(&ctx->exts_lock);
+}
@@ -95,21 +95,102 @@ int lyp_yin_parse_subnode_ext(struct lys_module *mod, void *elem, LYEXT_PAR elem
 
 struct lys_type *lyp_get_next_union_type(struct lys_type *type, struct lys_type *prev_type, int *found);
 
+/**
+ * @brief Cheaply check the shape of a value to learn whether it can be valid for a union member type
+ * at all, so that members that cannot match are skipped without parsing. The order of the members
+ * still decides which of the possible ones is used.
+ *
+ * @param[in] type Member type.
+ * @param[in] value Value to check, NULL for an empty value.
+ * @return 0 if the value is certainly invalid for the type, non-zero if it may be valid.
+ */
+int lyp_union_type_may_match(const struct lys_type *type, const char *value);
+
+/**
+ * @brief Compute the data of a type otherwise built on the first value checked (compiled patterns and
+ * length/range restrictions), including its union member types.
+ *
+ * @param[in] ctx Context of the type.
+ * @param[in] type Type of a leaf or leaf-list.
+ * @return EXIT_SUCCESS on success, -1 on error.
+ */
+int lyp_type_precompute(struct ly_ctx *ctx, struct lys_type *type);
+
 /* return: 0 - ret set, ok; 1 - ret not set, no log, unknown meta; -1 - ret not set, log, fatal error */
 int lyp_fill_attr(struct ly_ctx *ctx, struct lyd_node *parent, const char *module_ns, const char *module_name,
                   const char *attr_name, const char *attr_value, struct lyxml_elem *xml, int options, struct lyd_attr **ret);
 
 int lyp_check_edit_attr(struct ly_ctx *ctx, struct lyd_attr *attr, struct lyd_node *parent, int *editbits);
 
+/* trusted parameter of lyp_parse_value() for a valid value that is also canonical, it is then stored as it is */
+#define LYP_TRUSTED_CANONICAL 2
+
+/* trusted parameter of lyp_parse_value() for data parsed with the given parser options */
+#define LYP_TRUSTED_OPT(options) (!((options) & LYD_OPT_TRUSTED) ? 0 : \
+                                  ((options) & LYD_OPT_CANONICAL) ? LYP_TRUSTED_CANONICAL : 1)
+
 struct lys_type *lyp_parse_value(struct lys_type *type, const char **value_, struct lyxml_elem *xml,
                                  struct lyd_node_leaf_list *leaf, struct lyd_attr *attr, struct lys_module *local_mod,
                                  int store, int dflt, int trusted);
 
+/**
+ * @brief Parse a number of the JSON encoding directly into the value of an integer or decimal64 leaf, without
+ * converting it into the string value first. The number must already be a valid JSON number.
+ *
+ * @param[in] leaf Leaf (leaf-list) with no value yet.
+ * @param[in] number Number in the input, not terminated.
+ * @param[in] len Length of @p number.
+ * @param[in] trusted Whether the value is trusted to be valid so the restrictions are not checked.
+ * @return 0 on success, the value and its canonical string are stored,
+ * @return 1 if the number or the type is not supported, lyp_parse_value() must be used,
+ * @return -1 on error.
+ */
+int lyp_parse_number(struct lyd_node_leaf_list *leaf, const char *number, unsigned int len, int trusted);
+
+/**
+ * @brief Store an already typed integer, boolean, enumeration or decimal64 value into a leaf, without parsing
+ * its string value. The canonical string value is generated from it.
+ *
+ * @param[in] leaf Leaf (leaf-list) with an empty value string.
+ * @param[in] type Type of the value, the type of the leaf or its leafref target.
+ * @param[in] value Value of the C type of \p type base (int8_t for #LY_TYPE_BOOL, the int32_t enum value for
+ * #LY_TYPE_ENUM, the raw int64_t for #LY_TYPE_DEC64).
+ * @param[in] trusted Whether the value is trusted to be valid so the restrictions are not checked.
+ * @return 0 on success, the value and its canonical string are stored,
+ * @return 1 if the type is not supported, lyp_parse_value() must be used,
+ * @return -1 on error.
+ */
+int lyp_store_value(struct lyd_node_leaf_list *leaf, struct lys_type *type, const void *value, int trusted);
+
 int lyp_check_length_range(struct ly_ctx *ctx, const char *expr, struct lys_type *type);
 
 int lyp_check_pattern(struct ly_ctx *ctx, const char *pattern, pcre **pcre_precomp);
 int lyp_precompile_pattern(struct ly_ctx *ctx, const char *pattern, pcre** pcre_cmp, pcre_extra **pcre_std);
 
+#ifdef LY_ENABLED_CACHE
+
+/**
+ * @brief Get a compiled pattern from the context cache, check and compile it if not there yet (see
+ * lyp_precompile_pattern()). The same patterns of all the types (including all the copies of a type
+ * in the instantiated groupings) share one compiled pattern, it is owned by the cache and freed with the context.
+ *
+ * @param[in] ctx Context with the cache.
+ * @param[in] pattern Pattern to compile.
+ * @param[out] pcre_cmp Compiled pattern.
+ * @param[out] pcre_std Studied pattern, may be NULL.
+ * @return EXIT_SUCCESS on success, EXIT_FAILURE on error.
+ */
+int lyp_pattern_cache_get(struct ly_ctx *ctx, const char *pattern, pcre **pcre_cmp, pcre_extra **pcre_std);
+
+/**
+ * @brief Free all the compiled patterns of a context.
+ *
+ * @param[in] ctx Context with the cache.
+ */
+void lyp_pattern_cache_clean(struct ly_ctx *ctx);
+
+#endif
+
 int fill_yin_type(struct lys_module *module, struct lys_node *parent, struct lyxml_elem *yin, struct lys_type *type,
                   int tpdftype, struct unres_schema *unres);
 
@@ -160,6 +241,37 @@ int lyp_mand_check_ext(struct lys_ext_instance_complex *ext, const char *ext_nam
 const char *lyp_get_yang_data_template_name(const struct lyd_node *node);
 const struct lys_node *lyp_get_yang_data_template(const struct lys_module *module, const char *yang_data_name, int yang_data_name_len);
 
+/**
+ * @brief Find an extension instance of a module or its submodules by its definition and argument.
+ *
+ * The instances of all the modules in the context are indexed on the first use, so it is not needed to iterate
+ * over the extension instances of the modules, as in the case of lys_ext_instance_presence().
+ *
+ * @param[in] module Module of the instance, its submodules are searched as well.
+ * @param[in] def_module Name of the (main) module of the extension definition.
+ * @param[in] def_name Name of the extension definition.
+ * @param[in] arg Argument of the instance.
+ * @param[in] arg_len Length of \p arg.
+ * @return Found first such instance, NULL if there is none.
+ */
+struct lys_ext_instance *lyp_ext_instance_find(const struct lys_module *module, const char *def_module,
+                                               const char *def_name, const char *arg, int arg_len);
+
+/**
+ * @brief Build the extension instances index of a context, if not yet built for its current modules.
+ *
+ * @param[in] ctx Context to use.
+ * @return EXIT_SUCCESS on success, -1 on error.
+ */
+int lyp_ext_instances_index(struct ly_ctx *ctx);
+
+/**
+ * @brief Free the extension instances index of a context.
+ *
+ * @param[in] ctx Context to use.
+ */
+void lyp_ext_instances_clean(struct ly_ctx *ctx);
+
 void lyp_ext_instance_rm(struct ly_ctx *ctx, struct lys_ext_instance ***ext, uint8_t *size, uint8_t index);
 
 /**
@@ -253,16 +365,38 @@ const struct lys_module *lyp_get_import_module_ns(const struct lys_module *modul
  */
 struct lyext_plugin *ext_get_plugin(const char *name, const char *module, const char *revision);
 
+/**
+ * @brief Get a user XPath function plugin.
+ *
+ * @param[in] name Name of the function, not terminated.
+ * @param[in] len Length of \p name.
+ * @return Function plugin, NULL if there is none.
+ */
+const struct lyxp_func_list *xpath_get_plugin_func(const char *name, uint16_t len);
+
+/**
+ * @brief Register the built-in plugins and, optionally, load the plugins from the plugin directories.
+ *
+ * @param[in] scan Whether to scan the plugin directories for new plugins.
+ */
+void ly_load_plugins_int(int scan);
+
+/**
+ * @brief Find the user type plugin of a typedef and remember it in the typedef.
+ *
+ * @param[in] tpdf Typedef, nothing is done for the built-in ones.
+ */
+void lytype_tpdf_bind(struct lys_tpdf *tpdf);
+
 /**
  * @brief Try to store a value as a user type defined by a plugin.
  *
- * @param[in] mod Module of the type.
- * @param[in] type_name Type (typedef) name.
+ * @param[in] tpdf Typedef of the type, bound by lytype_tpdf_bind().
  * @param[in,out] value_str Stored string value, can be overwritten by the user store callback.
  * @param[in,out] value Filled value to be overwritten by the user store callback.
  * @return 0 on successful storing, 1 if the type is not a user type, -1 on error.
  */
-int lytype_store(const struct lys_module *mod, const char *type_name, const char **value_str, lyd_val *value);
+int lytype_store(const struct lys_tpdf *tpdf, const char **value_str, lyd_val *value);
 
 /**
  * @brief Free a user type stored value.
@@ -273,4 +407,68 @@ int lytype_store(const struct lys_module *mod, const char *type_name, const char
  */
 void lytype_free(const struct lys_type *type, lyd_val value, const char *value_str);
 
+/**
+ * @brief Compare two user type stored values using their plugin.
+ *
+ * @param[in] type1 Type of the first value.
+ * @param[in] value1 First value.
+ * @param[in] type2 Type of the second value.
+ * @param[in] value2 Second value.
+ * @return 0 if equal, 1 if not equal, -1 if the values cannot be compared by a plugin.
+ */
+int lytype_compare(const struct lys_type *type1, const lyd_val *value1, const struct lys_type *type2, const lyd_val *value2);
+
+/**
+ * @brief Add a user type stored value to a hash using its plugin.
+ *
+ * @param[in] type Type of the value.
+ * @param[in] value Stored value.
+ * @param[in,out] hash Hash to update.
+ * @return 0 on success, 1 if the value is not hashed by a plugin.
+ */
+int lytype_hash(const struct lys_type *type, const lyd_val *value, uint32_t *hash);
+
+/**
+ * @brief Add a string value to a hash the same way lytype_hash() hashes it once stored.
+ *
+ * @param[in] type Type of the value.
+ * @param[in] value_str String value.
+ * @param[in] len Length of \p value_str.
+ * @param[in,out] hash Hash to update.
+ * @return 0 on success, 1 if the value is not hashed by a plugin.
+ */
+int lytype_hash_str(const struct lys_type *type, const char *value_str, size_t len, uint32_t *hash);
+
+/**
+ * @brief Learn whether the user type stored values of a type can be encoded for LYB data by its plugin.
+ *
+ * @param[in] type Type of the values.
+ * @return 1 if lytype_encode() may encode them, 0 if not.
+ */
+int lytype_can_encode(const struct lys_type *type);
+
+/**
+ * @brief Encode a user type stored value for LYB data using its plugin.
+ *
+ * @param[in] type Type of the value.
+ * @param[in] value Stored value.
+ * @param[in] buf Buffer to use for the encoded value if large enough.
+ * @param[in] size Size of \p buf.
+ * @param[out] len Length of the encoded value.
+ * @return Encoded value, either \p buf or memory to be freed, NULL if the value is not encoded by a plugin.
+ */
+uint8_t *lytype_encode(const struct lys_type *type, const lyd_val *value, uint8_t *buf, size_t size, size_t *len);
+
+/**
+ * @brief Decode a user type value from LYB data using its plugin.
+ *
+ * @param[in] type Type of the value.
+ * @param[in] data Encoded value.
+ * @param[in] len Length of \p data.
+ * @param[out] value_str Canonical string value in the dictionary.
+ * @param[out] value Stored value.
+ * @return 0 on success, -1 on error.
+ */
+int lytype_decode(const struct lys_type *type, const void *data, size_t len, const char **value_str, lyd_val *value);
+
 #endif /* LY_PARSER_H_ */
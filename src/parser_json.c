@@ -29,6 +29,11 @@
 #include "validation.h"
 #include "xml_internal.h"
 
+#ifdef __SSE2__
+# define LYJSON_SSE2
+# include <emmintrin.h>
+#endif
+
 static int
 lyjson_isspace(int c)
 {
@@ -43,10 +48,278 @@ lyjson_isspace(int c)
     }
 }
 
+/**
+ * @brief Structural index of the JSON input.
+ *
+ * Lists offsets of all the structural characters ('{', '}', '[', ']', ':' and ','), both quotation marks
+ * of every string and the first character of every number or literal, everything outside strings, followed by
+ * the offset of the terminating NULL byte. Only whitespaces or the rest of a number/literal can be found between
+ * two consecutive items outside a string, so the parser can jump over them instead of reading them.
+ */
+struct lyjson_idx {
+    const char *data;   /**< indexed input */
+    uint32_t *items;    /**< offsets of the tokens in the input with LYJSON_IDX_* flags */
+    uint32_t count;     /**< number of items */
+    uint32_t cur;       /**< item found by the last lookup, the parser is mostly moving forward from there */
+    uint32_t *match;    /**< items of the matching closing brackets of the opening ones (0 for other items),
+                             created by the first skipped subtree */
+};
+
+#define LYJSON_IDX_OPEN 0x80000000 /**< item flag of the opening quotation mark of a string */
+#define LYJSON_IDX_ESC 0x40000000  /**< item flag of the closing quotation mark of a string that must be decoded */
+#define LYJSON_IDX_POS 0x3fffffff  /**< mask of the offset of an item */
+
+#ifdef LYJSON_SSE2
+
+/**
+ * @brief Get masks of the interesting characters in a 64-byte block of the input.
+ */
+static void
+lyjson_idx_classify(const char *block, uint64_t *quote, uint64_t *bslash, uint64_t *op, uint64_t *ws, uint64_t *special)
+{
+    __m128i chunk, low, v;
+    int i;
+
+    *quote = *bslash = *op = *ws = *special = 0;
+    for (i = 0; i < 4; ++i) {
+        chunk = _mm_loadu_si128((const __m128i *)(block + 16 * i));
+
+        v = _mm_cmpeq_epi8(chunk, _mm_set1_epi8('"'));
+        *quote |= (uint64_t)(uint16_t)_mm_movemask_epi8(v) << (16 * i);
+
+        v = _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\\'));
+        *bslash |= (uint64_t)(uint16_t)_mm_movemask_epi8(v) << (16 * i);
+
+        /* '[' and ']' differ from '{' and '}' only in one bit */
+        low = _mm_or_si128(chunk, _mm_set1_epi8(0x20));
+        v = _mm_or_si128(_mm_cmpeq_epi8(low, _mm_set1_epi8('{')), _mm_cmpeq_epi8(low, _mm_set1_epi8('}')));
+        v = _mm_or_si128(v, _mm_cmpeq_epi8(chunk, _mm_set1_epi8(':')));
+        v = _mm_or_si128(v, _mm_cmpeq_epi8(chunk, _mm_set1_epi8(',')));
+        *op |= (uint64_t)(uint16_t)_mm_movemask_epi8(v) << (16 * i);
+
+        v = _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(0x20)), _mm_cmpeq_epi8(chunk, _mm_set1_epi8(0x09)));
+        v = _mm_or_si128(v, _mm_cmpeq_epi8(chunk, _mm_set1_epi8(0x0a)));
+        v = _mm_or_si128(v, _mm_cmpeq_epi8(chunk, _mm_set1_epi8(0x0d)));
+        *ws |= (uint64_t)(uint16_t)_mm_movemask_epi8(v) << (16 * i);
+
+        /* signed comparison, so all non-ASCII bytes are matched as well */
+        v = _mm_cmplt_epi8(chunk, _mm_set1_epi8(0x20));
+        *special |= (uint64_t)(uint16_t)_mm_movemask_epi8(v) << (16 * i);
+    }
+}
+
+/**
+ * @brief Build the structural index of the whole JSON input.
+ *
+ * @param[in] ctx libyang context for logging.
+ * @param[in] data Input data.
+ * @param[out] idx Index to fill, idx->items stay NULL if the input is too long to be indexed.
+ * @return EXIT_SUCCESS on success, EXIT_FAILURE on memory allocation error.
+ */
+static int
+lyjson_idx_build(struct ly_ctx *ctx, const char *data, struct lyjson_idx *idx)
+{
+    char tail[64];
+    const char *block;
+    uint64_t quote, bslash, op, ws, special, escaped, inside, scalar, structural, dirty, bit, valid;
+    uint64_t prev_escaped = 0, prev_inside = 0, prev_scalar = 0;
+    uint32_t *aux, item, size;
+    size_t len, i;
+    int str_dirty = 0;
+
+    memset(idx, 0, sizeof *idx);
+    len = strlen(data);
+    if (len > LYJSON_IDX_POS) {
+        return EXIT_SUCCESS;
+    }
+
+    idx->data = data;
+    size = len / 8 + 65;
+    idx->items = malloc(size * sizeof *idx->items);
+    LY_CHECK_ERR_RETURN(!idx->items, LOGMEM(ctx), EXIT_FAILURE);
+
+    for (i = 0; i < len; i += 64) {
+        if (len - i >= 64) {
+            block = &data[i];
+            valid = UINT64_MAX;
+        } else {
+            memset(tail, 0, sizeof tail);
+            memcpy(tail, &data[i], len - i);
+            block = tail;
+            valid = (UINT64_C(1) << (len - i)) - 1;
+        }
+        lyjson_idx_classify(block, &quote, &bslash, &op, &ws, &special);
+
+        /* every backslash escapes the next character unless it is escaped itself (backslashes are rare) */
+        escaped = prev_escaped;
+        prev_escaped = 0;
+        for (dirty = bslash; dirty; dirty &= dirty - 1) {
+            bit = dirty & -dirty;
+            if (escaped & bit) {
+                continue;
+            }
+            if (bit << 1) {
+                escaped |= bit << 1;
+            } else {
+                prev_escaped = 1;
+            }
+        }
+        quote &= ~escaped;
+
+        /* prefix XOR of the quotation marks, strings are masked including the opening but not the closing mark */
+        inside = quote ^ (quote << 1);
+        inside ^= inside << 2;
+        inside ^= inside << 4;
+        inside ^= inside << 8;
+        inside ^= inside << 16;
+        inside ^= inside << 32;
+        inside ^= prev_inside;
+        prev_inside = (inside >> 63) ? UINT64_MAX : 0;
+
+        /* numbers and literals, only their first characters are indexed */
+        scalar = ~(op | ws | quote | inside) & valid;
+        structural = quote | (op & ~inside) | (scalar & ~((scalar << 1) | prev_scalar));
+        prev_scalar = scalar >> 63;
+
+        /* characters that prevent using a string directly from the input */
+        dirty = (bslash | special) & inside & valid;
+
+        if (idx->count + 65 > size) {
+            size *= 2;
+            aux = ly_realloc(idx->items, size * sizeof *idx->items);
+            LY_CHECK_ERR_RETURN(!aux, LOGMEM(ctx); memset(idx, 0, sizeof *idx), EXIT_FAILURE);
+            idx->items = aux;
+        }
+        for (; structural; structural &= structural - 1) {
+            bit = structural & -structural;
+            item = i + __builtin_ctzll(structural);
+            if (quote & bit) {
+                if (inside & bit) {
+                    item |= LYJSON_IDX_OPEN;
+                } else {
+                    /* end of a string, its characters are all before this quotation mark */
+                    if (str_dirty || (dirty & (bit - 1))) {
+                        item |= LYJSON_IDX_ESC;
+                    }
+                    str_dirty = 0;
+                    dirty &= ~(bit - 1);
+                }
+            }
+            idx->items[idx->count++] = item;
+        }
+        if (dirty) {
+            /* the string continues in the next block */
+            str_dirty = 1;
+        }
+    }
+    idx->items[idx->count++] = len;
+
+    return EXIT_SUCCESS;
+}
+
+#endif
+
+/**
+ * @brief Find the first item of an index not before a position in the input.
+ *
+ * @param[in] idx Structural index.
+ * @param[in] pos Offset in the input.
+ * @return Index of the item.
+ */
+static uint32_t
+lyjson_idx_find(struct lyjson_idx *idx, uint32_t pos)
+{
+    uint32_t i, n, lo, hi, mid;
+
+    i = idx->cur;
+    if (i && ((idx->items[i - 1] & LYJSON_IDX_POS) >= pos)) {
+        /* backwards */
+        lo = 0;
+        hi = i - 1;
+    } else {
+        /* mostly only a few items forward, the last item is the input end so it is never passed */
+        for (n = 0; (n < 8) && ((idx->items[i] & LYJSON_IDX_POS) < pos); ++n, ++i);
+        lo = i;
+        hi = idx->count - 1;
+    }
+
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if ((idx->items[mid] & LYJSON_IDX_POS) < pos) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    idx->cur = lo;
+    return lo;
+}
+
+/**
+ * @brief Check whether a position in the input is outside strings according to the index.
+ *
+ * The index and the parser can disagree only on invalid input, the index is then not used.
+ */
+static int
+lyjson_idx_outside(struct lyjson_idx *idx, uint32_t item)
+{
+    return !item || !(idx->items[item - 1] & LYJSON_IDX_OPEN);
+}
+
+/**
+ * @brief Pair all the brackets of an index so that any subtree can be skipped at once.
+ *
+ * Unpaired and mismatched brackets are left without a pair, the subtree is then traversed to report the error.
+ *
+ * @param[in] ctx libyang context for logging.
+ * @param[in] idx Structural index.
+ * @return EXIT_SUCCESS on success, EXIT_FAILURE on error.
+ */
+static int
+lyjson_idx_match(struct ly_ctx *ctx, struct lyjson_idx *idx)
+{
+    uint32_t i, top = UINT32_MAX, next;
+    char c;
+
+    idx->match = malloc(idx->count * sizeof *idx->match);
+    LY_CHECK_ERR_RETURN(!idx->match, LOGMEM(ctx), EXIT_FAILURE);
+
+    /* the opening brackets not yet closed hold the previous one, forming a stack */
+    for (i = 0; i < idx->count; ++i) {
+        c = idx->data[idx->items[i] & LYJSON_IDX_POS];
+        idx->match[i] = 0;
+        if ((c == '{') || (c == '[')) {
+            idx->match[i] = top;
+            top = i;
+        } else if (((c == '}') || (c == ']')) && (top != UINT32_MAX)) {
+            next = idx->match[top];
+            idx->match[top] = (idx->data[idx->items[top] & LYJSON_IDX_POS] == ((c == '}') ? '{' : '[')) ? i : 0;
+            top = next;
+        }
+    }
+    for (; top != UINT32_MAX; top = next) {
+        next = idx->match[top];
+        idx->match[top] = 0;
+    }
+
+    return EXIT_SUCCESS;
+}
+
 static unsigned int
-skip_ws(const char *data)
+skip_ws(struct lyjson_idx *idx, const char *data)
 {
     unsigned int len = 0;
+    uint32_t pos, item;
+
+    if (idx && lyjson_isspace(data[0])) {
+        /* jump to the next token */
+        pos = data - idx->data;
+        item = lyjson_idx_find(idx, pos);
+        if (lyjson_idx_outside(idx, item)) {
+            return (idx->items[item] & LYJSON_IDX_POS) - pos;
+        }
+    }
 
     /* skip leading whitespaces */
     while (data[len] && lyjson_isspace(data[len])) {
@@ -197,6 +470,37 @@ error:
     return NULL;
 }
 
+/**
+ * @brief Check whether a JSON string is plain ASCII with no escape sequences so it can be used directly
+ * from the input instead of being decoded by lyjson_parse_text().
+ *
+ * @param[in] idx Structural index of the input, if any.
+ * @param[in] data Input data following the opening quotation mark.
+ * @param[out] len Length of the string, the closing quotation mark follows.
+ * @return 1 if the string can be used in place, 0 if it must be decoded.
+ */
+static int
+lyjson_plain_text(struct lyjson_idx *idx, const char *data, unsigned int *len)
+{
+    uint32_t pos, item, end;
+
+    if (idx) {
+        /* the string ends with the next item */
+        pos = (data - 1) - idx->data;
+        item = lyjson_idx_find(idx, pos);
+        if (idx->items[item] == (pos | LYJSON_IDX_OPEN)) {
+            end = idx->items[item + 1] & LYJSON_IDX_POS;
+            if (idx->data[end] == '"') {
+                *len = end - pos - 1;
+                return !(idx->items[item + 1] & LYJSON_IDX_ESC);
+            }
+        }
+    }
+
+    *len = ly_strlen_noesc(data, LY_ESC_JSON | LY_ESC_NONASCII);
+    return data[*len] == '"';
+}
+
 static unsigned int
 lyjson_parse_number(struct ly_ctx *ctx, const char *data)
 {
@@ -365,8 +669,58 @@ lyjson_parse_boolean(struct ly_ctx *ctx, const char *data)
     return len;
 }
 
+/**
+ * @brief Get the length of a JSON object without its parsing.
+ *
+ * @param[in] ctx libyang context for logging.
+ * @param[in] idx Structural index of the input, if any.
+ * @param[in] data Input data starting with the begin-object.
+ * @param[out] len Length of the object.
+ * @return EXIT_SUCCESS on success, EXIT_FAILURE on error, an unterminated object is not logged.
+ */
+static int
+lyjson_object_len(struct ly_ctx *ctx, struct lyjson_idx *idx, const char *data, unsigned int *len)
+{
+    uint32_t base, item;
+    unsigned int i, c = 0;
+    int qstr = 0;
+
+    if (idx) {
+        if (!idx->match && lyjson_idx_match(ctx, idx)) {
+            return EXIT_FAILURE;
+        }
+        base = data - idx->data;
+        item = lyjson_idx_find(idx, base);
+        if (((idx->items[item] & LYJSON_IDX_POS) == base) && idx->match[item]) {
+            *len = (idx->items[idx->match[item]] & LYJSON_IDX_POS) - base + 1;
+            return EXIT_SUCCESS;
+        }
+    }
+
+    /* count opening '{' and closing '}' brackets outside strings */
+    for (i = 0; data[i]; ++i) {
+        if (qstr) {
+            if ((data[i] == '\\') && data[i + 1]) {
+                ++i;
+            } else if (data[i] == '"') {
+                qstr = 0;
+            }
+        } else if (data[i] == '"') {
+            qstr = 1;
+        } else if (data[i] == '{') {
+            ++c;
+        } else if ((data[i] == '}') && !--c) {
+            *len = i + 1;
+            return EXIT_SUCCESS;
+        }
+    }
+
+    *len = 0;
+    return EXIT_SUCCESS;
+}
+
 static unsigned int
-json_get_anydata(struct lyd_node_anydata *any, const char *data)
+json_get_anydata(struct lyd_node_anydata *any, struct lyjson_idx *idx, const char *data)
 {
     struct ly_ctx *ctx = any->schema->module->ctx;
     unsigned int len = 0, c = 0;
@@ -374,6 +728,13 @@ json_get_anydata(struct lyd_node_anydata *any, const char *data)
 
     if (data[len] == '"') {
         len = 1;
+        if (lyjson_plain_text(idx, &data[len], &c)) {
+            /* zero length would mean the whole rest of the input */
+            any->value.str = lydict_insert(ctx, c ? &data[len] : "", c);
+            any->value_type = LYD_ANYDATA_CONSTSTRING;
+            return len + c + 1;
+        }
+
         str = lyjson_parse_text(ctx, &data[len], &c);
         if (!str) {
             return 0;
@@ -393,22 +754,10 @@ json_get_anydata(struct lyd_node_anydata *any, const char *data)
         return 0;
     }
 
-    /* count opening '{' and closing '}' brackets to get the end of the object without its parsing */
-    c = len = 0;
-    do {
-        switch (data[len]) {
-        case '{':
-            c++;
-            break;
-        case '}':
-            c--;
-            break;
-        default:
-            break;
-        }
-        len++;
-    } while (data[len] && c);
-    if (c) {
+    /* the value is stored serialized, only its end is needed */
+    if (lyjson_object_len(ctx, idx, data, &len)) {
+        return 0;
+    } else if (!len) {
         LOGVAL(ctx, LYE_EOF, LY_VLOG_LYD, any);
         return 0;
     }
@@ -420,13 +769,14 @@ json_get_anydata(struct lyd_node_anydata *any, const char *data)
 }
 
 static unsigned int
-json_get_value(struct lyd_node_leaf_list *leaf, struct lyd_node **first_sibling, const char *data, int options,
-               struct unres_data *unres)
+json_get_value(struct lyd_node_leaf_list *leaf, struct lyd_node **first_sibling, struct lyjson_idx *idx, const char *data,
+               int options, struct unres_data *unres)
 {
     struct lyd_node_leaf_list *new;
     struct lys_type *stype;
     struct ly_ctx *ctx;
     unsigned int len = 0, r;
+    int ret;
     char *str;
 
     assert(leaf && data);
@@ -442,7 +792,7 @@ json_get_value(struct lyd_node_leaf_list *leaf, struct lyd_node **first_sibling,
         }
 
 repeat:
-        len += skip_ws(&data[len]);
+        len += skip_ws(idx, &data[len]);
     }
 
     /* will be changed in case of union */
@@ -451,12 +801,17 @@ repeat:
     if (data[len] == '"') {
         /* string representations */
         ++len;
-        str = lyjson_parse_text(ctx, &data[len], &r);
-        if (!str) {
-            LOGPATH(ctx, LY_VLOG_LYD, leaf);
-            return 0;
+        if (lyjson_plain_text(idx, &data[len], &r)) {
+            /* no need to decode, insert directly from the input (zero length would mean all of it) */
+            leaf->value_str = lydict_insert(ctx, r ? &data[len] : "", r);
+        } else {
+            str = lyjson_parse_text(ctx, &data[len], &r);
+            if (!str) {
+                LOGPATH(ctx, LY_VLOG_LYD, leaf);
+                return 0;
+            }
+            leaf->value_str = lydict_insert_zc(ctx, str);
         }
-        leaf->value_str = lydict_insert_zc(ctx, str);
         if (data[len + r] != '"') {
             LOGVAL(ctx, LYE_XML_INVAL, LY_VLOG_LYD, leaf,
                    "JSON data (missing quotation-mark at the end of string)");
@@ -470,6 +825,15 @@ repeat:
             LOGPATH(ctx, LY_VLOG_LYD, leaf);
             return 0;
         }
+        /* integers and decimal64 numbers are stored directly */
+        ret = lyp_parse_number(leaf, &data[len], r, options & LYD_OPT_TRUSTED);
+        if (ret == -1) {
+            return 0;
+        } else if (!ret) {
+            len += r;
+            goto stored;
+        }
+
         /* if it's a number with 'e' or 'E', get rid of it first */
         if ((str = strnchr(&data[len], 'e', r)) || (str = strnchr(&data[len], 'E', r))) {
             str = lyjson_convert_enumber(ctx, &data[len], r, str);
@@ -512,10 +876,11 @@ inval:
     /* the value is here converted to a JSON format if needed in case of LY_TYPE_IDENT and LY_TYPE_INST or to a
      * canonical form of the value */
     if (!lyp_parse_value(&((struct lys_node_leaf *)leaf->schema)->type, &leaf->value_str, NULL, leaf, NULL, NULL,
-                         1, 0, options & LYD_OPT_TRUSTED)) {
+                         1, 0, LYP_TRUSTED_OPT(options))) {
         return 0;
     }
 
+stored:
 #ifdef LY_ENABLED_CACHE
     /* calculate the hash and insert it into parent */
     lyd_hash((struct lyd_node *)leaf);
@@ -524,7 +889,7 @@ inval:
 
     if (leaf->schema->nodetype == LYS_LEAFLIST) {
         /* repeat until end-array */
-        len += skip_ws(&data[len]);
+        len += skip_ws(idx, &data[len]);
         if (data[len] == ',') {
             /* various validation checks */
             if (lyv_data_context((struct lyd_node*)leaf, options | LYD_OPT_TRUSTED, unres) ||
@@ -534,8 +899,9 @@ inval:
             }
 
             /* another instance of the leaf-list */
-            new = calloc(1, sizeof(struct lyd_node_leaf_list));
+            new = lyd_pool_alloc(ctx, sizeof(struct lyd_node_leaf_list));
             LY_CHECK_ERR_RETURN(!new, LOGMEM(ctx), 0);
+            ++ly_cnt.nodes_parsed;
 
             new->parent = leaf->parent;
             new->prev = (struct lyd_node *)leaf;
@@ -556,7 +922,7 @@ inval:
             goto repeat;
         } else if (data[len] == ']') {
             len++;
-            len += skip_ws(&data[len]);
+            len += skip_ws(idx, &data[len]);
         } else {
             /* something unexpected */
             LOGVAL(ctx, LYE_XML_INVAL, LY_VLOG_LYD, leaf, "JSON data (expecting value-separator or end-array)");
@@ -564,12 +930,12 @@ inval:
         }
     }
 
-    len += skip_ws(&data[len]);
+    len += skip_ws(idx, &data[len]);
     return len;
 }
 
 static unsigned int
-json_parse_attr(struct lys_module *parent_module, struct lyd_attr **attr, const char *data, int options)
+json_parse_attr(struct lys_module *parent_module, struct lyjson_idx *idx, struct lyd_attr **attr, const char *data, int options)
 {
     struct ly_ctx *ctx = parent_module->ctx;
     unsigned int len = 0, r;
@@ -583,7 +949,7 @@ json_parse_attr(struct lys_module *parent_module, struct lyd_attr **attr, const
     if (data[len] != '{') {
         if (!strncmp(&data[len], "null", 4)) {
             len += 4;
-            len += skip_ws(&data[len]);
+            len += skip_ws(idx, &data[len]);
             return len;
         }
         LOGVAL(ctx, LYE_XML_INVAL, LY_VLOG_NONE, NULL, "JSON data (missing begin-object)");
@@ -593,7 +959,7 @@ json_parse_attr(struct lys_module *parent_module, struct lyd_attr **attr, const
 repeat:
     prefix = NULL;
     len++;
-    len += skip_ws(&data[len]);
+    len += skip_ws(idx, &data[len]);
 
     if (data[len] != '"') {
         LOGVAL(ctx, LYE_XML_INVAL, LY_VLOG_NONE, NULL, "JSON data (missing quotation-mark at the beginning of string)");
@@ -622,13 +988,13 @@ repeat:
 
     /* prepare data for parsing node content */
     len += r + 1;
-    len += skip_ws(&data[len]);
+    len += skip_ws(idx, &data[len]);
     if (data[len] != ':') {
         LOGVAL(ctx, LYE_XML_INVAL, LY_VLOG_NONE, NULL, "JSON data (missing name-separator)");
         goto error;
     }
     len++;
-    len += skip_ws(&data[len]);
+    len += skip_ws(idx, &data[len]);
 
     if (data[len] != '"') {
         LOGVAL(ctx, LYE_XML_INVAL, LY_VLOG_NONE, NULL, "JSON data (missing quotation-mark at the beginning of string)");
@@ -644,7 +1010,7 @@ repeat:
         goto error;
     }
     len += r + 1;
-    len += skip_ws(&data[len]);
+    len += skip_ws(idx, &data[len]);
 
     ret = lyp_fill_attr(parent_module->ctx, NULL, NULL, prefix, name, value, NULL, options, &attr_new);
     if (ret == -1) {
@@ -682,7 +1048,7 @@ next:
         goto error;
     }
     len++;
-    len += skip_ws(&data[len]);
+    len += skip_ws(idx, &data[len]);
 
     return len;
 
@@ -776,6 +1142,7 @@ error:
 /**
  * @brief Skip subtree (find its end in the input data) of the current JSON item.
  * @param[in] ctx libyang context for logging
+ * @param[in] idx Structural index of the input, if any.
  * @param[in] parent parent node for logging
  * @param[in] data input data (pointing to the beginning, @p len is used to go to the current position).
  * @param[in, out] len Current position in the @p data, will be updated to the end of the element's subtree in the @p data
@@ -783,11 +1150,74 @@ error:
  * @return -1 on error.
  */
 static int
-json_skip_unknown(struct ly_ctx *ctx, struct lyd_node *parent, const char *data, unsigned int *len)
+json_skip_unknown(struct ly_ctx *ctx, struct lyjson_idx *idx, struct lyd_node *parent, const char *data, unsigned int *len)
 {
     int qstr = 0;
     int objects = 0;
     int arrays = 0;
+    uint32_t base, item, pos;
+
+    if (idx) {
+        base = data - idx->data;
+        item = lyjson_idx_find(idx, base + *len);
+        if (lyjson_idx_outside(idx, item)) {
+            if (!idx->match && lyjson_idx_match(ctx, idx)) {
+                return -1;
+            }
+
+            /* only the structural characters outside strings need to be visited, paired brackets not even those */
+            for (; ; ++item) {
+                pos = idx->items[item] & LYJSON_IDX_POS;
+                switch (idx->data[pos]) {
+                case '\0':
+                    *len = pos - base;
+                    return 0;
+                case '[':
+                case '{':
+                    if (idx->match[item]) {
+                        item = idx->match[item];
+                        continue;
+                    }
+                    if (idx->data[pos] == '[') {
+                        arrays++;
+                    } else {
+                        objects++;
+                    }
+                    break;
+                case ']':
+                    arrays--;
+                    break;
+                case '}':
+                    objects--;
+                    break;
+                case ',':
+                    if (!objects && !arrays) {
+                        /* do not eat the comma character */
+                        *len = pos - base;
+                        return 0;
+                    }
+                    break;
+                }
+
+                if (objects < 0) {
+                    if (arrays) {
+                        LOGVAL(ctx, LYE_XML_INVAL, LY_VLOG_LYD, parent, "JSON data (missing end-array)");
+                        return -1;
+                    }
+                    *len = pos - base;
+                    return 0;
+                }
+                if (arrays < 0) {
+                    if (objects) {
+                        LOGVAL(ctx, LYE_XML_INVAL, LY_VLOG_LYD, parent, "JSON data (missing end-object)");
+                        return -1;
+                    }
+                    *len = pos - base;
+                    return 0;
+                }
+            }
+        }
+    }
 
     while (data[*len]) {
         switch (data[*len]) {
@@ -850,17 +1280,58 @@ json_skip_unknown(struct ly_ctx *ctx, struct lyd_node *parent, const char *data,
     return 0;
 }
 
+/* the data callback gets a terminated module name */
+static const struct lys_module *
+json_data_clb(struct ly_ctx *ctx, const char *name, unsigned int name_len)
+{
+    const struct lys_module *module;
+    char *str;
+
+    if (!name) {
+        return ctx->data_clb(ctx, NULL, NULL, 0, ctx->data_clb_data);
+    }
+
+    str = strndup(name, name_len);
+    LY_CHECK_ERR_RETURN(!str, LOGMEM(ctx), NULL);
+    module = ctx->data_clb(ctx, str, NULL, 0, ctx->data_clb_data);
+    free(str);
+    return module;
+}
+
+/* does not log */
+static struct lys_node *
+json_data_predict_schemanode(const struct lys_node *sparent, const struct lyd_node *prev, const char *prefix,
+                             unsigned int prefix_len, const char *name, unsigned int name_len)
+{
+    const struct lys_node *snode;
+    const char *mod_name;
+    int i;
+
+    /* the data siblings are mostly in the schema order, so try the same node (list and leaf-list instances)
+     * and the next one in the schema order */
+    for (snode = prev->schema, i = 0; snode && (i < 2); snode = lys_getnext(snode, sparent, NULL, 0), ++i) {
+        mod_name = lys_node_module(snode)->name;
+        if (!strncmp(snode->name, name, name_len) && !snode->name[name_len]
+                && !strncmp(mod_name, prefix, prefix_len) && !mod_name[prefix_len]) {
+            return (struct lys_node *)snode;
+        }
+    }
+
+    return NULL;
+}
+
 static unsigned int
-json_parse_data(struct ly_ctx *ctx, const char *data, const struct lys_node *schema_parent, struct lyd_node **parent,
-                struct lyd_node *first_sibling, struct lyd_node *prev, struct attr_cont **attrs, int options,
-                struct unres_data *unres, struct lyd_node **act_notif, const char *yang_data_name)
+json_parse_data(struct ly_ctx *ctx, struct lyjson_idx *idx, const char *data, const struct lys_node *schema_parent,
+                struct lyd_node **parent, struct lyd_node *first_sibling, struct lyd_node *prev, struct attr_cont **attrs,
+                int options, struct unres_data *unres, struct lyd_node **act_notif, const char *yang_data_name)
 {
     unsigned int len = 0;
     unsigned int r;
-    unsigned int flag_leaflist = 0;
-    int i;
+    unsigned int flag_leaflist = 0, name_len, prefix_len = 0;
+    int i, is_attr;
     uint8_t pos;
-    char *name, *prefix = NULL, *str = NULL;
+    const char *name, *prefix = NULL, *colon;
+    char *str = NULL, *aux;
     const struct lys_module *module = NULL;
     struct lys_node *schema = NULL;
     const struct lys_node *sparent = NULL;
@@ -876,46 +1347,55 @@ json_parse_data(struct ly_ctx *ctx, const char *data, const struct lys_node *sch
     }
     len++;
 
-    str = lyjson_parse_text(ctx, &data[len], &r);
-    if (!r) {
-        goto error;
-    } else if (data[len + r] != '"') {
-        LOGVAL(ctx, LYE_XML_INVAL, LY_VLOG_LYD, (*parent),
-               "JSON data (missing quotation-mark at the end of string)");
-        goto error;
-    }
-    if ((name = strchr(str, ':'))) {
-        *name = '\0';
-        name++;
-        prefix = str;
-        if (prefix[0] == '@') {
-            prefix++;
-        }
+    if (lyjson_plain_text(idx, &data[len], &r)) {
+        /* the member name is compared in place */
+        name = &data[len];
+        name_len = r;
     } else {
+        str = lyjson_parse_text(ctx, &data[len], &r);
+        if (!r) {
+            goto error;
+        } else if (data[len + r] != '"') {
+            LOGVAL(ctx, LYE_XML_INVAL, LY_VLOG_LYD, (*parent),
+                   "JSON data (missing quotation-mark at the end of string)");
+            goto error;
+        }
         name = str;
-        if (name[0] == '@') {
-            name++;
+        name_len = strlen(str);
+    }
+    is_attr = (name_len && (name[0] == '@'));
+    if ((colon = memchr(name, ':', name_len))) {
+        prefix = name;
+        prefix_len = colon - name;
+        name_len -= prefix_len + 1;
+        name = colon + 1;
+        if (is_attr) {
+            prefix++;
+            prefix_len--;
         }
+    } else if (is_attr) {
+        name++;
+        name_len--;
     }
 
     /* prepare data for parsing node content */
     len += r + 1;
-    len += skip_ws(&data[len]);
+    len += skip_ws(idx, &data[len]);
     if (data[len] != ':') {
         LOGVAL(ctx, LYE_XML_INVAL, LY_VLOG_LYD, (*parent), "JSON data (missing name-separator)");
         goto error;
     }
     len++;
-    len += skip_ws(&data[len]);
+    len += skip_ws(idx, &data[len]);
 
-    if (str[0] == '@' && !str[1]) {
+    if (is_attr && !prefix && !name_len) {
         /* process attribute of the parent object (container or list) */
         if (!(*parent)) {
             LOGVAL(ctx, LYE_XML_INVAL, LY_VLOG_NONE, NULL, "attribute with no corresponding element to belongs to");
             goto error;
         }
 
-        r = json_parse_attr((*parent)->schema->module, &attr, &data[len], options);
+        r = json_parse_attr((*parent)->schema->module, idx, &attr, &data[len], options);
         if (!r) {
             LOGPATH(ctx, LY_VLOG_LYD, *parent);
             goto error;
@@ -944,10 +1424,10 @@ json_parse_data(struct ly_ctx *ctx, const char *data, const struct lys_node *sch
     if (!(*parent)) {
         /* starting in root */
         /* get the proper schema */
-        module = ly_ctx_get_module(ctx, prefix, NULL, 0);
+        module = ly_ctx_nget_module(ctx, prefix, prefix_len, NULL, 0);
         if (ctx->data_clb) {
             if (!module) {
-                module = ctx->data_clb(ctx, prefix, NULL, 0, ctx->data_clb_data);
+                module = json_data_clb(ctx, prefix, prefix_len);
             } else if (!module->implemented) {
                 module = ctx->data_clb(ctx, module->name, module->ns, LY_MODCLB_NOT_IMPLEMENTED, ctx->data_clb_data);
             }
@@ -956,30 +1436,22 @@ json_parse_data(struct ly_ctx *ctx, const char *data, const struct lys_node *sch
             if (yang_data_name) {
                 sparent = lyp_get_yang_data_template(module, yang_data_name, strlen(yang_data_name));
                 schema = NULL;
-                if (sparent) {
-                    /* get the proper schema node */
-                    while ((schema = (struct lys_node *) lys_getnext(schema, sparent, module, 0))) {
-                        if (!strcmp(schema->name, name)) {
-                            break;
-                        }
-                    }
-                }
-            } else {
-                /* get the proper schema node */
-                while ((schema = (struct lys_node *) lys_getnext(schema, NULL, module, 0))) {
-                    if (!strcmp(schema->name, name)) {
-                        break;
-                    }
+                if (sparent && (lys_find_data_child(ctx, sparent, module, NULL, 0, name, name_len,
+                                                    (const struct lys_node **)&schema) == -1)) {
+                    goto error;
                 }
+            } else if (lys_find_data_child(ctx, NULL, module, NULL, 0, name, name_len,
+                                           (const struct lys_node **)&schema) == -1) {
+                goto error;
             }
         }
     } else {
         if (prefix) {
             /* get the proper module to give the chance to load/implement it */
-            module = ly_ctx_get_module(ctx, prefix, NULL, 1);
+            module = ly_ctx_nget_module(ctx, prefix, prefix_len, NULL, 1);
             if (ctx->data_clb) {
                 if (!module) {
-                    ctx->data_clb(ctx, prefix, NULL, 0, ctx->data_clb_data);
+                    json_data_clb(ctx, prefix, prefix_len);
                 } else if (!module->implemented) {
                     ctx->data_clb(ctx, module->name, module->ns, LY_MODCLB_NOT_IMPLEMENTED, ctx->data_clb_data);
                 }
@@ -999,32 +1471,32 @@ json_parse_data(struct ly_ctx *ctx, const char *data, const struct lys_node *sch
             schema = NULL;
         }
 
-        if (schema_parent) {
-            while ((schema = (struct lys_node *)lys_getnext(schema, schema_parent, NULL, 0))) {
-                if (!strcmp(schema->name, name)
-                        && ((prefix && !strcmp(lys_node_module(schema)->name, prefix))
-                        || (!prefix && (lys_node_module(schema) == lys_node_module(schema_parent))))) {
-                    break;
-                }
-            }
-        } else {
-            while ((schema = (struct lys_node *)lys_getnext(schema, (*parent)->schema, NULL, 0))) {
-                if (!strcmp(schema->name, name)
-                        && ((prefix && !strcmp(lys_node_module(schema)->name, prefix))
-                        || (!prefix && (lys_node_module(schema) == lyd_node_module(*parent))))) {
-                    break;
-                }
-            }
+        /* the node is from the module of its parent if there is no prefix */
+        if (!prefix) {
+            prefix = schema_parent ? lys_node_module(schema_parent)->name : lyd_node_module(*parent)->name;
+            prefix_len = strlen(prefix);
+        }
+        if (!schema_parent && prev && (prev->parent == *parent)
+                && ((*parent)->schema->nodetype & (LYS_CONTAINER | LYS_LIST | LYS_NOTIF))) {
+            schema = json_data_predict_schemanode((*parent)->schema, prev, prefix, prefix_len, name, name_len);
+        }
+        if (!schema && (lys_find_data_child(ctx, schema_parent ? schema_parent : (*parent)->schema, NULL, prefix,
+                                            prefix_len, name, name_len, (const struct lys_node **)&schema) == -1)) {
+            goto error;
         }
     }
 
     module = lys_node_module(schema);
     if (!module || !module->implemented || module->disabled) {
         if (options & LYD_OPT_STRICT) {
-            LOGVAL(ctx, LYE_INELEM, (*parent ? LY_VLOG_LYD : LY_VLOG_NONE), (*parent), name);
+            /* the name may not be terminated */
+            aux = strndup(name, name_len);
+            LY_CHECK_ERR_GOTO(!aux, LOGMEM(ctx), error);
+            LOGVAL(ctx, LYE_INELEM, (*parent ? LY_VLOG_LYD : LY_VLOG_NONE), (*parent), aux);
+            free(aux);
             goto error;
         } else {
-            if (json_skip_unknown(ctx, *parent, data, &len)) {
+            if (json_skip_unknown(ctx, idx, *parent, data, &len)) {
                 goto error;
             }
             free(str);
@@ -1032,16 +1504,16 @@ json_parse_data(struct ly_ctx *ctx, const char *data, const struct lys_node *sch
         }
     }
 
-    if (str[0] == '@') {
+    if (is_attr) {
         /* attribute for some sibling node */
         if (data[len] == '[') {
             flag_leaflist = 1;
             len++;
-            len += skip_ws(&data[len]);
+            len += skip_ws(idx, &data[len]);
         }
 
 attr_repeat:
-        r = json_parse_attr((struct lys_module *)module, &attr, &data[len], options);
+        r = json_parse_attr((struct lys_module *)module, idx, &attr, &data[len], options);
         if (!r) {
             LOGPATH(ctx, LY_VLOG_LYD, (*parent));
             goto error;
@@ -1061,7 +1533,7 @@ attr_repeat:
         if (flag_leaflist) {
             if (data[len] == ',') {
                 len++;
-                len += skip_ws(&data[len]);
+                len += skip_ws(idx, &data[len]);
                 flag_leaflist++;
                 goto attr_repeat;
             } else if (data[len] != ']') {
@@ -1069,7 +1541,7 @@ attr_repeat:
                 goto error;
             }
             len++;
-            len += skip_ws(&data[len]);
+            len += skip_ws(idx, &data[len]);
         }
 
         free(str);
@@ -1082,21 +1554,22 @@ attr_repeat:
     case LYS_NOTIF:
     case LYS_RPC:
     case LYS_ACTION:
-        result = calloc(1, sizeof *result);
+        result = lyd_pool_alloc(ctx, sizeof *result);
         break;
     case LYS_LEAF:
     case LYS_LEAFLIST:
-        result = calloc(1, sizeof(struct lyd_node_leaf_list));
+        result = lyd_pool_alloc(ctx, sizeof(struct lyd_node_leaf_list));
         break;
     case LYS_ANYXML:
     case LYS_ANYDATA:
-        result = calloc(1, sizeof(struct lyd_node_anydata));
+        result = lyd_pool_alloc(ctx, sizeof(struct lyd_node_anydata));
         break;
     default:
         LOGINT(ctx);
         goto error;
     }
     LY_CHECK_ERR_GOTO(!result, LOGMEM(ctx), error);
+    ++ly_cnt.nodes_parsed;
 
     result->prev = result;
     result->schema = schema;
@@ -1149,7 +1622,7 @@ attr_repeat:
     case LYS_LEAF:
     case LYS_LEAFLIST:
         /* type detection and assigning the value */
-        r = json_get_value((struct lyd_node_leaf_list *)result, &first_sibling, &data[len], options, unres);
+        r = json_get_value((struct lyd_node_leaf_list *)result, &first_sibling, idx, &data[len], options, unres);
         if (!r) {
             goto error;
         }
@@ -1159,11 +1632,11 @@ attr_repeat:
         }
 
         len += r;
-        len += skip_ws(&data[len]);
+        len += skip_ws(idx, &data[len]);
         break;
     case LYS_ANYDATA:
     case LYS_ANYXML:
-        r = json_get_anydata((struct lyd_node_anydata *)result, &data[len]);
+        r = json_get_anydata((struct lyd_node_anydata *)result, idx, &data[len]);
         if (!r) {
             goto error;
         }
@@ -1175,7 +1648,7 @@ attr_repeat:
 #endif
 
         len += r;
-        len += skip_ws(&data[len]);
+        len += skip_ws(idx, &data[len]);
         break;
     case LYS_CONTAINER:
     case LYS_RPC:
@@ -1209,7 +1682,7 @@ attr_repeat:
             goto error;
         }
         len++;
-        len += skip_ws(&data[len]);
+        len += skip_ws(idx, &data[len]);
 
         if (data[len] != '}') {
             /* non-empty container */
@@ -1218,9 +1691,9 @@ attr_repeat:
             attrs_aux = NULL;
             do {
                 len++;
-                len += skip_ws(&data[len]);
+                len += skip_ws(idx, &data[len]);
 
-                r = json_parse_data(ctx, &data[len], NULL, &result, result->child, diter, &attrs_aux, options, unres, act_notif, yang_data_name);
+                r = json_parse_data(ctx, idx, &data[len], NULL, &result, result->child, diter, &attrs_aux, options, unres, act_notif, yang_data_name);
                 if (!r) {
                     goto error;
                 }
@@ -1242,7 +1715,7 @@ attr_repeat:
             goto error;
         }
         len++;
-        len += skip_ws(&data[len]);
+        len += skip_ws(idx, &data[len]);
 
         /* if we have empty non-presence container, mark it as default */
         if (schema->nodetype == LYS_CONTAINER && !result->child &&
@@ -1259,7 +1732,7 @@ attr_repeat:
         list = result;
         do {
             len++;
-            len += skip_ws(&data[len]);
+            len += skip_ws(idx, &data[len]);
 
             if (data[len] != '{') {
                 LOGVAL(ctx, LYE_XML_INVAL, LY_VLOG_LYD, result,
@@ -1270,9 +1743,9 @@ attr_repeat:
             attrs_aux = NULL;
             do {
                 len++;
-                len += skip_ws(&data[len]);
+                len += skip_ws(idx, &data[len]);
 
-                r = json_parse_data(ctx, &data[len], NULL, &list, list->child, diter, &attrs_aux, options, unres, act_notif, yang_data_name);
+                r = json_parse_data(ctx, idx, &data[len], NULL, &list, list->child, diter, &attrs_aux, options, unres, act_notif, yang_data_name);
                 if (!r) {
                     goto error;
                 }
@@ -1303,7 +1776,7 @@ attr_repeat:
                 goto error;
             }
             len++;
-            len += skip_ws(&data[len]);
+            len += skip_ws(idx, &data[len]);
 
             if (data[len] == ',') {
                 /* various validation checks */
@@ -1314,8 +1787,9 @@ attr_repeat:
                 }
 
                 /* another instance of the list */
-                new = calloc(1, sizeof *new);
+                new = lyd_pool_alloc(ctx, sizeof *new);
                 LY_CHECK_ERR_GOTO(!new, LOGMEM(ctx), error);
+                ++ly_cnt.nodes_parsed;
                 new->parent = list->parent;
                 new->prev = list;
                 list->next = new;
@@ -1338,7 +1812,7 @@ attr_repeat:
             goto error;
         }
         len++;
-        len += skip_ws(&data[len]);
+        len += skip_ws(idx, &data[len]);
         break;
     default:
         LOGINT(ctx);
@@ -1387,9 +1861,9 @@ error:
     return 0;
 }
 
-struct lyd_node *
-lyd_parse_json(struct ly_ctx *ctx, const char *data, int options, const struct lyd_node *rpc_act,
-               const struct lyd_node *data_tree, const char *yang_data_name)
+static struct lyd_node *
+json_parse_tree(struct ly_ctx *ctx, struct lyjson_idx *idx, const char *data, int options,
+                const struct lyd_node *rpc_act, const struct lyd_node *data_tree, const char *yang_data_name)
 {
     struct lyd_node *result = NULL, *next, *iter, *reply_parent = NULL, *reply_top = NULL, *act_notif = NULL;
     struct unres_data *unres = NULL;
@@ -1397,13 +1871,8 @@ lyd_parse_json(struct ly_ctx *ctx, const char *data, int options, const struct l
     int act_cont = 0;
     struct attr_cont *attrs = NULL;
 
-    if (!ctx || !data) {
-        LOGARG;
-        return NULL;
-    }
-
     /* skip leading whitespaces */
-    len += skip_ws(&data[len]);
+    len += skip_ws(idx, &data[len]);
 
     /* expect top-level { */
     if (data[len] != '{') {
@@ -1413,7 +1882,7 @@ lyd_parse_json(struct ly_ctx *ctx, const char *data, int options, const struct l
 
     /* check for empty object */
     r = len + 1;
-    r += skip_ws(&data[r]);
+    r += skip_ws(idx, &data[r]);
     if (data[r] == '}') {
         if (options & LYD_OPT_DATA_ADD_YANGLIB) {
             result = ly_ctx_info(ctx);
@@ -1452,24 +1921,24 @@ lyd_parse_json(struct ly_ctx *ctx, const char *data, int options, const struct l
     next = reply_parent;
     do {
         len++;
-        len += skip_ws(&data[len]);
+        len += skip_ws(idx, &data[len]);
 
         if (!act_cont) {
             if (!strncmp(&data[len], "\"yang:action\"", 13)) {
                 len += 13;
-                len += skip_ws(&data[len]);
+                len += skip_ws(idx, &data[len]);
                 if (data[len] != ':') {
                     LOGVAL(ctx, LYE_XML_INVAL, LY_VLOG_NONE, NULL, "JSON data (missing top-level begin-object)");
                     goto error;
                 }
                 ++len;
-                len += skip_ws(&data[len]);
+                len += skip_ws(idx, &data[len]);
                 if (data[len] != '{') {
                     LOGVAL(ctx, LYE_XML_INVAL, LY_VLOG_NONE, NULL, "JSON data (missing top level yang:action object)");
                     goto error;
                 }
                 ++len;
-                len += skip_ws(&data[len]);
+                len += skip_ws(idx, &data[len]);
 
                 act_cont = 1;
             } else {
@@ -1477,7 +1946,7 @@ lyd_parse_json(struct ly_ctx *ctx, const char *data, int options, const struct l
             }
         }
 
-        r = json_parse_data(ctx, &data[len], NULL, &next, result, iter, &attrs, options, unres, &act_notif, yang_data_name);
+        r = json_parse_data(ctx, idx, &data[len], NULL, &next, result, iter, &attrs, options, unres, &act_notif, yang_data_name);
         if (!r) {
             goto error;
         }
@@ -1510,7 +1979,7 @@ lyd_parse_json(struct ly_ctx *ctx, const char *data, int options, const struct l
         goto error;
     }
     len++;
-    len += skip_ws(&data[len]);
+    len += skip_ws(idx, &data[len]);
 
     if (act_cont == 1) {
         if (data[len] != '}') {
@@ -1518,7 +1987,7 @@ lyd_parse_json(struct ly_ctx *ctx, const char *data, int options, const struct l
             goto error;
         }
         len++;
-        len += skip_ws(&data[len]);
+        len += skip_ws(idx, &data[len]);
     }
 
     /* store attributes */
@@ -1580,6 +2049,7 @@ lyd_parse_json(struct ly_ctx *ctx, const char *data, int options, const struct l
             && lyd_check_mandatory_tree((act_notif ? act_notif : result), ctx, NULL, 0, options)) {
         goto error;
     }
+    lyd_val_subtree_forget(result, NULL, 0, options);
 
     free(unres->node);
     free(unres->type);
@@ -1598,3 +2068,33 @@ error:
 
     return NULL;
 }
+
+struct lyd_node *
+lyd_parse_json(struct ly_ctx *ctx, const char *data, int options, const struct lyd_node *rpc_act,
+               const struct lyd_node *data_tree, const char *yang_data_name)
+{
+#ifdef LYJSON_SSE2
+    struct lyjson_idx idx;
+    struct lyd_node *result;
+#endif
+
+    if (!ctx || !data) {
+        LOGARG;
+        return NULL;
+    }
+
+#ifdef LYJSON_SSE2
+    /* locate all the tokens first, the parser then jumps over whitespaces and strings instead of reading them */
+    if (lyjson_idx_build(ctx, data, &idx)) {
+        return NULL;
+    }
+    if (idx.items) {
+        result = json_parse_tree(ctx, &idx, data, options, rpc_act, data_tree, yang_data_name);
+        free(idx.items);
+        free(idx.match);
+        return result;
+    }
+#endif
+
+    return json_parse_tree(ctx, NULL, data, options, rpc_act, data_tree, yang_data_name);
+}
@@ -14,12 +14,16 @@
 
 #include <assert.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <stdlib.h>
 #include <string.h>
 #include <inttypes.h>
+#include <pthread.h>
+#include <unistd.h>
 #ifdef __APPLE__
 # include <libkern/OSByteOrder.h>
 # define le64toh(x) OSSwapLittleToHostInt64(x)
+# define le32toh(x) OSSwapLittleToHostInt32(x)
 #elif defined(__FreeBSD__) || defined(__NetBSD__) || defined(__DragonFly__)
 # include <sys/endian.h>
 #elif defined(__sun__)
@@ -27,8 +31,10 @@
 # include <sys/byteorder.h>
 # if defined(_BIG_ENDIAN)
 #  define le64toh(x) BSWAP_64(x)
+#  define le32toh(x) BSWAP_32(x)
 # else
 #  define le64toh(x) (x)
+#  define le32toh(x) (x)
 # endif
 #else
 # include <endian.h>
@@ -40,9 +46,23 @@
 #include "parser.h"
 #include "tree_internal.h"
 
+#ifdef LY_ENABLED_LYB_COMPRESSION
+# include <zlib.h>
+#endif
+
 #define LYB_HAVE_READ_GOTO(r, d, go) if (r < 0) goto go; d += r;
 #define LYB_HAVE_READ_RETURN(r, d, ret) if (r < 0) return ret; d += r;
 
+/* get the number of bytes left in the current subtree */
+static size_t
+lyb_left(struct lyb_state *lybs)
+{
+    if (lybs->version >= LYB_VERSION_SIZES) {
+        return lybs->written[lybs->used - 1] - lybs->offset;
+    }
+    return lybs->written[lybs->used - 1];
+}
+
 static int
 lyb_read(const char *data, uint8_t *buf, size_t count, struct lyb_state *lybs)
 {
@@ -52,6 +72,19 @@ lyb_read(const char *data, uint8_t *buf, size_t count, struct lyb_state *lybs)
 
     assert(data && lybs);
 
+    if (lybs->version >= LYB_VERSION_SIZES) {
+        /* no chunks, only the subtree end is checked */
+        if (lybs->used && (count > lyb_left(lybs))) {
+            LOGERR(lybs->ctx, LY_EINVAL, "Invalid LYB data, reading beyond the end of a subtree.");
+            return -1;
+        }
+        if (buf) {
+            memcpy(buf, data, count);
+        }
+        lybs->offset += count;
+        return count;
+    }
+
     while (1) {
         /* check for fully-read (empty) data chunks */
         to_read = count;
@@ -170,7 +203,7 @@ lyb_read_string(const char *data, char **str, int with_length, struct lyb_state
         LYB_HAVE_READ_GOTO(r, data, error);
     } else {
         /* read until the end of this subtree */
-        len = lybs->written[lybs->used - 1];
+        len = lyb_left(lybs);
         if (lybs->position[lybs->used - 1]) {
             next_chunk = 1;
         }
@@ -211,7 +244,7 @@ error:
 static void
 lyb_read_stop_subtree(struct lyb_state *lybs)
 {
-    if (lybs->written[lybs->used - 1]) {
+    if (lyb_left(lybs)) {
         LOGINT(lybs->ctx);
     }
 
@@ -222,6 +255,7 @@ static int
 lyb_read_start_subtree(const char *data, struct lyb_state *lybs)
 {
     uint8_t meta_buf[LYB_META_BYTES];
+    uint32_t size;
 
     if (lybs->used == lybs->size) {
         lybs->size += LYB_STATE_STEP;
@@ -231,6 +265,22 @@ lyb_read_start_subtree(const char *data, struct lyb_state *lybs)
         LY_CHECK_ERR_RETURN(!lybs->written || !lybs->position || !lybs->inner_chunks, LOGMEM(lybs->ctx), -1);
     }
 
+    if (lybs->version >= LYB_VERSION_SIZES) {
+        /* the whole subtree size, store its end */
+        memcpy(&size, data, LYB_SUBTREE_SIZE_BYTES);
+        lybs->offset += LYB_SUBTREE_SIZE_BYTES;
+        if (lybs->used && (le32toh(size) > lyb_left(lybs))) {
+            LOGERR(lybs->ctx, LY_EINVAL, "Invalid LYB data, subtree exceeds its parent.");
+            return -1;
+        }
+
+        ++lybs->used;
+        lybs->written[lybs->used - 1] = lybs->offset + le32toh(size);
+        lybs->inner_chunks[lybs->used - 1] = 0;
+        lybs->position[lybs->used - 1] = 0;
+        return LYB_SUBTREE_SIZE_BYTES;
+    }
+
     memcpy(meta_buf, data, LYB_META_BYTES);
 
     ++lybs->used;
@@ -297,7 +347,7 @@ error:
 }
 
 static struct lyd_node *
-lyb_new_node(const struct lys_node *schema)
+lyb_new_node(const struct lys_node *schema, int options)
 {
     struct lyd_node *node;
 
@@ -307,11 +357,11 @@ lyb_new_node(const struct lys_node *schema)
     case LYS_NOTIF:
     case LYS_RPC:
     case LYS_ACTION:
-        node = calloc(sizeof(struct lyd_node), 1);
+        node = lyd_pool_alloc(schema->module->ctx, sizeof(struct lyd_node));
         break;
     case LYS_LEAF:
     case LYS_LEAFLIST:
-        node = calloc(sizeof(struct lyd_node_leaf_list), 1);
+        node = lyd_pool_alloc(schema->module->ctx, sizeof(struct lyd_node_leaf_list));
 
         if (((struct lys_node_leaf *)schema)->type.base == LY_TYPE_LEAFREF) {
             node->validity |= LYD_VAL_LEAFREF;
@@ -319,16 +369,23 @@ lyb_new_node(const struct lys_node *schema)
         break;
     case LYS_ANYDATA:
     case LYS_ANYXML:
-        node = calloc(sizeof(struct lyd_node_anydata), 1);
+        node = lyd_pool_alloc(schema->module->ctx, sizeof(struct lyd_node_anydata));
         break;
     default:
         return NULL;
     }
     LY_CHECK_ERR_RETURN(!node, LOGMEM(schema->module->ctx), NULL);
+    ++ly_cnt.nodes_parsed;
 
     /* fill basic info */
     node->schema = (struct lys_node *)schema;
-    if (resolve_applies_when(schema, 0, NULL)) {
+    if (options & LYD_OPT_LYB_VALIDATE) {
+        /* the data will be validated */
+        node->validity = ly_new_node_validity(schema);
+        if (resolve_applies_when(schema, 0, NULL)) {
+            node->when_status = LYD_WHEN;
+        }
+    } else if (resolve_applies_when(schema, 0, NULL)) {
         /* this data are considered trusted so if this node exists, it means its when must have been true */
         node->when_status = LYD_WHEN | LYD_WHEN_TRUE;
     }
@@ -484,6 +541,35 @@ lyb_parse_val_1(struct lys_type *type, LY_DATA_TYPE value_type, uint8_t value_fl
     return ret;
 }
 
+/* print an unsigned number into buf, return its length (without sprintf(), it is called for every number) */
+static int
+lyb_print_uint(char *buf, uint64_t num)
+{
+    char digits[20];
+    int len = 0, i;
+
+    do {
+        digits[len++] = '0' + num % 10;
+        num /= 10;
+    } while (num);
+
+    for (i = 0; i < len; ++i) {
+        buf[i] = digits[len - i - 1];
+    }
+    buf[len] = '\0';
+    return len;
+}
+
+static int
+lyb_print_int(char *buf, int64_t num)
+{
+    if (num < 0) {
+        buf[0] = '-';
+        return 1 + lyb_print_uint(buf + 1, -(uint64_t)num);
+    }
+    return lyb_print_uint(buf, num);
+}
+
 /* generally, fill value_str */
 static int
 lyb_parse_val_2(struct lys_type *type, struct lyd_node_leaf_list *leaf, struct lyd_attr *attr, struct unres_data *unres)
@@ -491,9 +577,9 @@ lyb_parse_val_2(struct lys_type *type, struct lyd_node_leaf_list *leaf, struct l
     struct ly_ctx *ctx;
     struct lys_module *mod;
     struct lys_type *rtype = NULL;
-    char num_str[22], *str;
+    char num_str[32], *str;
     int64_t frac, num;
-    uint32_t i, str_len;
+    uint32_t i, str_len, len;
     uint8_t *value_flags, dig;
     const char **value_str;
     LY_DATA_TYPE value_type;
@@ -572,24 +658,33 @@ lyb_parse_val_2(struct lys_type *type, struct lyd_node_leaf_list *leaf, struct l
         *value_str = value->string;
         break;
     case LY_TYPE_BITS:
-        /* print the set bits */
-        str = malloc(1);
-        LY_CHECK_ERR_RETURN(!str, LOGMEM(ctx), -1);
-        str[0] = '\0';
+        /* get the length of the set bits first so that they are printed at once */
         str_len = 0;
         for (i = 0; i < rtype->info.bits.count; ++i) {
             if (value->bit[i]) {
-                str = ly_realloc(str, str_len + strlen(value->bit[i]->name) + (str_len ? 1 : 0) + 1);
-                LY_CHECK_ERR_RETURN(!str, LOGMEM(ctx), -1);
+                str_len += (str_len ? 1 : 0) + strlen(value->bit[i]->name);
+            }
+        }
 
-                str_len += sprintf(str + str_len, "%s%s", str_len ? " " : "", value->bit[i]->name);
+        str = malloc(str_len + 1);
+        LY_CHECK_ERR_RETURN(!str, LOGMEM(ctx), -1);
+        str_len = 0;
+        for (i = 0; i < rtype->info.bits.count; ++i) {
+            if (value->bit[i]) {
+                if (str_len) {
+                    str[str_len++] = ' ';
+                }
+                len = strlen(value->bit[i]->name);
+                memcpy(str + str_len, value->bit[i]->name, len);
+                str_len += len;
             }
         }
+        str[str_len] = '\0';
 
         *value_str = lydict_insert_zc(ctx, str);
         break;
     case LY_TYPE_BOOL:
-        *value_str = lydict_insert(ctx, (value->bln ? "true" : "false"), 0);
+        *value_str = value->bln ? lydict_insert(ctx, "true", 4) : lydict_insert(ctx, "false", 5);
         break;
     case LY_TYPE_EMPTY:
         *value_str = lydict_insert(ctx, "", 0);
@@ -610,36 +705,36 @@ lyb_parse_val_2(struct lys_type *type, struct lyd_node_leaf_list *leaf, struct l
         *value_str = lydict_insert(ctx, value->enm->name, 0);
         break;
     case LY_TYPE_INT8:
-        sprintf(num_str, "%d", value->int8);
-        *value_str = lydict_insert(ctx, num_str, 0);
+        len = lyb_print_int(num_str, value->int8);
+        *value_str = lydict_insert(ctx, num_str, len);
         break;
     case LY_TYPE_UINT8:
-        sprintf(num_str, "%u", value->uint8);
-        *value_str = lydict_insert(ctx, num_str, 0);
+        len = lyb_print_uint(num_str, value->uint8);
+        *value_str = lydict_insert(ctx, num_str, len);
         break;
     case LY_TYPE_INT16:
-        sprintf(num_str, "%d", value->int16);
-        *value_str = lydict_insert(ctx, num_str, 0);
+        len = lyb_print_int(num_str, value->int16);
+        *value_str = lydict_insert(ctx, num_str, len);
         break;
     case LY_TYPE_UINT16:
-        sprintf(num_str, "%u", value->uint16);
-        *value_str = lydict_insert(ctx, num_str, 0);
+        len = lyb_print_uint(num_str, value->uint16);
+        *value_str = lydict_insert(ctx, num_str, len);
         break;
     case LY_TYPE_INT32:
-        sprintf(num_str, "%d", value->int32);
-        *value_str = lydict_insert(ctx, num_str, 0);
+        len = lyb_print_int(num_str, value->int32);
+        *value_str = lydict_insert(ctx, num_str, len);
         break;
     case LY_TYPE_UINT32:
-        sprintf(num_str, "%u", value->uint32);
-        *value_str = lydict_insert(ctx, num_str, 0);
+        len = lyb_print_uint(num_str, value->uint32);
+        *value_str = lydict_insert(ctx, num_str, len);
         break;
     case LY_TYPE_INT64:
-        sprintf(num_str, "%"PRId64, value->int64);
-        *value_str = lydict_insert(ctx, num_str, 0);
+        len = lyb_print_int(num_str, value->int64);
+        *value_str = lydict_insert(ctx, num_str, len);
         break;
     case LY_TYPE_UINT64:
-        sprintf(num_str, "%"PRIu64, value->uint64);
-        *value_str = lydict_insert(ctx, num_str, 0);
+        len = lyb_print_uint(num_str, value->uint64);
+        *value_str = lydict_insert(ctx, num_str, len);
         break;
     case LY_TYPE_DEC64:
         num = value->dec64 / (int64_t)rtype->info.dec64.div;
@@ -655,9 +750,22 @@ lyb_parse_val_2(struct lys_type *type, struct lyd_node_leaf_list *leaf, struct l
             --dig;
         }
 
-        /* handle special case of int64_t not supporting printing -0 */
-        sprintf(num_str, "%s%"PRId64".%.*"PRId64, (num == 0) && (value->dec64 < 0) ? "-" : "", num, dig, frac);
-        *value_str = lydict_insert(ctx, num_str, 0);
+        /* the sign is printed separately for the special case of -0 */
+        len = 0;
+        if (value->dec64 < 0) {
+            num_str[len++] = '-';
+        }
+        len += lyb_print_uint(num_str + len, (num < 0) ? -(uint64_t)num : (uint64_t)num);
+        num_str[len++] = '.';
+
+        /* fraction digits, including the leading zeros */
+        for (i = dig; i; --i) {
+            num_str[len + i - 1] = '0' + frac % 10;
+            frac /= 10;
+        }
+        len += dig;
+        num_str[len] = '\0';
+        *value_str = lydict_insert(ctx, num_str, len);
         break;
     default:
         return -1;
@@ -692,6 +800,37 @@ parse_reference:
     return 0;
 }
 
+/* read a user type value encoded by its plugin and store it */
+static int
+lyb_parse_val_user(struct lys_type *type, const char *data, const char **value_str, lyd_val *value,
+                   LY_DATA_TYPE *value_type, struct lyb_state *lybs)
+{
+    int r, ret = 0;
+    size_t len = 0;
+    uint8_t *buf;
+
+    ret += (r = lyb_read_number(&len, sizeof len, 2, data, lybs));
+    LYB_HAVE_READ_RETURN(r, data, -1);
+
+    buf = malloc(len);
+    LY_CHECK_ERR_RETURN(!buf, LOGMEM(lybs->ctx), -1);
+
+    ret += (r = lyb_read(data, buf, len, lybs));
+    if (r < 0) {
+        free(buf);
+        return -1;
+    }
+
+    r = lytype_decode(type, buf, len, value_str, value);
+    free(buf);
+    if (r) {
+        return -1;
+    }
+
+    *value_type = type->base;
+    return ret;
+}
+
 static int
 lyb_parse_value(struct lys_type *type, struct lyd_node_leaf_list *leaf, struct lyd_attr *attr, const char *data,
                 struct unres_data *unres, struct lyb_state *lybs)
@@ -735,6 +874,13 @@ lyb_parse_value(struct lys_type *type, struct lyd_node_leaf_list *leaf, struct l
         *value_flags |= LY_VALUE_UNRES;
     }
 
+    if ((*value_flags & LY_VALUE_USER) && (*value_type == LY_TYPE_BINARY)) {
+        /* encoded by the user type plugin, the value is fully stored */
+        ret += (r = lyb_parse_val_user(type, data, value_str, value, value_type, lybs));
+        LYB_HAVE_READ_RETURN(r, data, -1);
+        return ret;
+    }
+
     ret += (r = lyb_parse_val_1(type, *value_type, *value_flags, data, value_str, value, lybs));
     LYB_HAVE_READ_RETURN(r, data, -1);
 
@@ -757,49 +903,16 @@ static int
 lyb_parse_attr_name(const struct lys_module *mod, const char *data, struct lys_ext_instance_complex **ext, int options,
                     struct lyb_state *lybs)
 {
-    int r, ret = 0, pos, i, j, k;
-    const struct lys_submodule *submod = NULL;
+    int r, ret = 0;
     char *attr_name = NULL;
 
     /* attr name */
     ret += (r = lyb_read_string(data, &attr_name, 1, lybs));
     LYB_HAVE_READ_RETURN(r, data, -1);
 
-    /* search module */
-    pos = -1;
-    for (i = 0, j = 0; i < mod->ext_size; i = i + j + 1) {
-        j = lys_ext_instance_presence(&mod->ctx->models.list[0]->extensions[0], &mod->ext[i], mod->ext_size - i);
-        if (j == -1) {
-            break;
-        }
-        if (ly_strequal(mod->ext[i + j]->arg_value, attr_name, 0)) {
-            pos = i + j;
-            break;
-        }
-    }
-
-    /* try submodules */
-    if (pos == -1) {
-        for (k = 0; k < mod->inc_size; ++k) {
-            submod = mod->inc[k].submodule;
-            for (i = 0, j = 0; i < submod->ext_size; i = i + j + 1) {
-                j = lys_ext_instance_presence(&mod->ctx->models.list[0]->extensions[0], &submod->ext[i], submod->ext_size - i);
-                if (j == -1) {
-                    break;
-                }
-                if (ly_strequal(submod->ext[i + j]->arg_value, attr_name, 0)) {
-                    pos = i + j;
-                    break;
-                }
-            }
-        }
-    }
-
-    if (pos == -1) {
-        *ext = NULL;
-    } else {
-        *ext = submod ? (struct lys_ext_instance_complex *)submod->ext[pos] : (struct lys_ext_instance_complex *)mod->ext[pos];
-    }
+    /* search the module and its submodules */
+    *ext = (struct lys_ext_instance_complex *)lyp_ext_instance_find(mod, "ietf-yang-metadata", "annotation", attr_name,
+                                                                    strlen(attr_name));
 
     if (!*ext && (options & LYD_OPT_STRICT)) {
         LOGVAL(mod->ctx, LYE_SPEC, LY_VLOG_NONE, NULL, "Failed to find annotation \"%s\" in \"%s\".", attr_name, mod->name);
@@ -814,7 +927,7 @@ lyb_parse_attr_name(const struct lys_module *mod, const char *data, struct lys_e
 static int
 lyb_parse_attributes(struct lyd_node *node, const char *data, int options, struct unres_data *unres, struct lyb_state *lybs)
 {
-    int r, ret = 0;
+    int r, ret = 0, idx;
     uint8_t i, count = 0;
     const struct lys_module *mod;
     struct lys_type **type;
@@ -830,22 +943,35 @@ lyb_parse_attributes(struct lyd_node *node, const char *data, int options, struc
         ret += (r = lyb_read_start_subtree(data, lybs));
         LYB_HAVE_READ_GOTO(r, data, error);
 
-        /* find model */
-        ret += (r = lyb_parse_model(data, &mod, options, lybs));
-        LYB_HAVE_READ_GOTO(r, data, error);
+        if (lybs->version >= LYB_VERSION_ANNOTS) {
+            /* annotation index */
+            idx = 0;
+            ret += (r = lyb_read_number(&idx, sizeof idx, LYB_ANNOT_INDEX_BYTES(lybs->annot_count), data, lybs));
+            LYB_HAVE_READ_GOTO(r, data, error);
+            if (idx >= lybs->annot_count) {
+                LOGVAL(lybs->ctx, LYE_SPEC, LY_VLOG_NONE, NULL, "Invalid LYB annotation index %d.", idx);
+                goto error;
+            }
 
-        if (mod) {
-            /* annotation name */
-            ret += (r = lyb_parse_attr_name(mod, data, &ext, options, lybs));
+            ext = lybs->annots[idx];
+        } else {
+            /* find model */
+            ret += (r = lyb_parse_model(data, &mod, options, lybs));
             LYB_HAVE_READ_GOTO(r, data, error);
+
+            if (mod) {
+                /* annotation name */
+                ret += (r = lyb_parse_attr_name(mod, data, &ext, options, lybs));
+                LYB_HAVE_READ_GOTO(r, data, error);
+            }
         }
 
-        if (!mod || !ext) {
+        if (!ext) {
             /* unknown attribute, skip it */
             do {
-                ret += (r = lyb_read(data, NULL, lybs->written[lybs->used - 1], lybs));
+                ret += (r = lyb_read(data, NULL, lyb_left(lybs), lybs));
                 LYB_HAVE_READ_GOTO(r, data, error);
-            } while (lybs->written[lybs->used - 1]);
+            } while (lyb_left(lybs));
             goto stop_subtree;
         }
 
@@ -853,12 +979,12 @@ lyb_parse_attributes(struct lyd_node *node, const char *data, int options, struc
         if (!attr) {
             assert(!node->attr);
 
-            attr = calloc(1, sizeof *attr);
+            attr = lyd_pool_alloc(lybs->ctx, sizeof *attr);
             LY_CHECK_ERR_GOTO(!attr, LOGMEM(lybs->ctx), error);
 
             node->attr = attr;
         } else {
-            attr->next = calloc(1, sizeof *attr);
+            attr->next = lyd_pool_alloc(lybs->ctx, sizeof *attr);
             LY_CHECK_ERR_GOTO(!attr->next, LOGMEM(lybs->ctx), error);
 
             attr = attr->next;
@@ -908,6 +1034,145 @@ lyb_is_schema_hash_match(struct lys_node *sibling, LYB_HASH *hash, uint8_t hash_
     return 1;
 }
 
+/* record of the LYB schema hash index */
+struct lyb_hash_rec {
+    const void *scope;      /* parent schema node or module of the siblings */
+    struct lys_node *node;  /* sibling, NULL for the record marking the scope indexed */
+    uint32_t pos;           /* position of the sibling in the lys_getnext() order */
+    LYB_HASH hash;          /* sibling hash with collision ID 0, 0 for the scope record */
+};
+
+static int
+lyb_hash_rec_equal(void *val1_p, void *val2_p, int mod, void *UNUSED(cb_data))
+{
+    struct lyb_hash_rec *rec1 = val1_p, *rec2 = val2_p;
+
+    if ((rec1->scope != rec2->scope) || (rec1->hash != rec2->hash)) {
+        return 0;
+    }
+    if (mod && (rec1->node != rec2->node)) {
+        /* siblings with colliding hashes are all stored */
+        return 0;
+    }
+    return 1;
+}
+
+static uint32_t
+lyb_hash_rec_hash(const struct lyb_hash_rec *rec)
+{
+    uint32_t hash;
+
+    hash = dict_hash_multi(0, (const char *)&rec->scope, sizeof rec->scope);
+    hash = dict_hash_multi(hash, (const char *)&rec->hash, sizeof rec->hash);
+    return dict_hash_multi(hash, NULL, 0);
+}
+
+/* add all the siblings of a scope into the index, followed by the record marking the scope indexed */
+static int
+lyb_hash_index_scope(struct hash_table *ht, const struct lys_node *sparent, const struct lys_module *mod)
+{
+    struct lyb_hash_rec rec;
+    struct lys_node *sibling = NULL;
+
+    rec.scope = sparent ? (const void *)sparent : (const void *)mod;
+    rec.pos = 0;
+    while ((sibling = (struct lys_node *)lys_getnext(sibling, sparent, mod, 0))) {
+        rec.node = sibling;
+        rec.hash = lyb_hash(sibling, 0);
+        ++rec.pos;
+        if (lyht_insert(ht, &rec, lyb_hash_rec_hash(&rec), NULL) == -1) {
+            return -1;
+        }
+    }
+
+    rec.node = NULL;
+    rec.hash = 0;
+    if (lyht_insert(ht, &rec, lyb_hash_rec_hash(&rec), NULL) == -1) {
+        return -1;
+    }
+    return EXIT_SUCCESS;
+}
+
+/* find the sibling with the hash sequence in the context index, which is built for every scope on its first use,
+ * a shorter sequence can match more siblings and the first one is used as by lys_getnext() traversal */
+static int
+lyb_find_schema_hash(const struct lys_node *sparent, const struct lys_module *mod, LYB_HASH *hash, uint8_t hash_count,
+                     struct lys_node **sibling, struct lyb_state *lybs)
+{
+    struct ly_ctx *ctx = lybs->ctx;
+    struct lyb_hash_rec rec, *match;
+    uint32_t ht_hash, pos = UINT32_MAX;
+    int rc = EXIT_SUCCESS;
+
+    *sibling = NULL;
+    rec.scope = sparent ? (const void *)sparent : (const void *)mod;
+    rec.node = NULL;
+
+    /* the scope is usually indexed already, the readers do not block each other */
+    rec.hash = 0;
+    pthread_rwlock_rdlock(&ctx->lyb_hashes_lock);
+    if (!ctx->lyb_hashes || (ctx->lyb_hashes_set_id != ctx->models.module_set_id)
+            || lyht_find(ctx->lyb_hashes, &rec, lyb_hash_rec_hash(&rec), NULL)) {
+        pthread_rwlock_unlock(&ctx->lyb_hashes_lock);
+        pthread_rwlock_wrlock(&ctx->lyb_hashes_lock);
+
+        if (ctx->lyb_hashes && (ctx->lyb_hashes_set_id != ctx->models.module_set_id)) {
+            /* modules changed, build the index again */
+            lyht_free(ctx->lyb_hashes);
+            ctx->lyb_hashes = NULL;
+        }
+        if (!ctx->lyb_hashes) {
+            ctx->lyb_hashes = lyht_new(64, sizeof rec, lyb_hash_rec_equal, NULL, 1);
+            LY_CHECK_ERR_GOTO(!ctx->lyb_hashes, LOGMEM(ctx); rc = -1, cleanup);
+            ctx->lyb_hashes_set_id = ctx->models.module_set_id;
+        }
+
+        /* is the scope already indexed? */
+        if (lyht_find(ctx->lyb_hashes, &rec, lyb_hash_rec_hash(&rec), NULL)
+                && lyb_hash_index_scope(ctx->lyb_hashes, sparent, mod)) {
+            lyht_free(ctx->lyb_hashes);
+            ctx->lyb_hashes = NULL;
+            rc = -1;
+            goto cleanup;
+        }
+    }
+
+    /* all the siblings with the first hash, records with other keys may have the same table hash */
+    rec.hash = hash[0];
+    ht_hash = lyb_hash_rec_hash(&rec);
+    if (lyht_find(ctx->lyb_hashes, &rec, ht_hash, (void **)&match)) {
+        goto cleanup;
+    }
+    do {
+        if ((match->scope != rec.scope) || (match->hash != rec.hash)) {
+            continue;
+        }
+
+        /* skip schema nodes from models not present during printing */
+        if ((match->pos < pos) && lyb_has_schema_model(match->node, lybs->models, lybs->mod_count)
+                && lyb_is_schema_hash_match(match->node, hash, hash_count)) {
+            /* match found */
+            *sibling = match->node;
+            pos = match->pos;
+        }
+    } while (!lyht_find_next(ctx->lyb_hashes, match, ht_hash, (void **)&match));
+
+cleanup:
+    pthread_rwlock_unlock(&ctx->lyb_hashes_lock);
+    return rc;
+}
+
+void
+lyb_hashes_clean(struct ly_ctx *ctx)
+{
+    pthread_rwlock_wrlock(&ctx->lyb_hashes_lock);
+
+    lyht_free(ctx->lyb_hashes);
+    ctx->lyb_hashes = NULL;
+
+    pthread_rwlock_unlock(&ctx->lyb_hashes_lock);
+}
+
 static int
 lyb_parse_schema_hash(const struct lys_node *sparent, const struct lys_module *mod, const char *data, const char *yang_data_name,
                       int options, struct lys_node **snode, struct lyb_state *lybs)
@@ -974,13 +1239,8 @@ lyb_parse_schema_hash(const struct lys_node *sparent, const struct lys_module *m
     }
 
     /* find our node with matching hashes */
-    sibling = NULL;
-    while ((sibling = (struct lys_node *)lys_getnext(sibling, sparent, mod, 0))) {
-        /* skip schema nodes from models not present during printing */
-        if (lyb_has_schema_model(sibling, lybs->models, lybs->mod_count) && lyb_is_schema_hash_match(sibling, hash, i + 1)) {
-            /* match found */
-            break;
-        }
+    if (lyb_find_schema_hash(sparent, mod, hash, i + 1, &sibling, lybs)) {
+        return -1;
     }
 
 finish:
@@ -1011,9 +1271,9 @@ lyb_skip_subtree(const char *data, struct lyb_state *lybs)
         ret += r;
 
         /* then read data */
-        ret += (r = lyb_read(data, NULL, lybs->written[lybs->used - 1], lybs));
+        ret += (r = lyb_read(data, NULL, lyb_left(lybs), lybs));
         LYB_HAVE_READ_RETURN(r, data, -1);
-    } while (lybs->written[lybs->used - 1]);
+    } while (lyb_left(lybs));
 
     return ret;
 }
@@ -1061,7 +1321,7 @@ lyb_parse_subtree(const char *data, struct lyd_node *parent, struct lyd_node **f
     /*
      * read the node
      */
-    node = lyb_new_node(snode);
+    node = lyb_new_node(snode, options);
     if (!node) {
         goto error;
     }
@@ -1116,7 +1376,7 @@ lyb_parse_subtree(const char *data, struct lyd_node *parent, struct lyd_node **f
     }
 
     /* read all descendants */
-    while (lybs->written[lybs->used - 1]) {
+    while (lyb_left(lybs)) {
         ret += (r = lyb_parse_subtree(data, node, NULL, NULL, options, unres, lybs));
         LYB_HAVE_READ_GOTO(r, data, error);
     }
@@ -1159,7 +1419,7 @@ error:
 static int
 lyb_parse_data_models(const char *data, int options, struct lyb_state *lybs)
 {
-    int i, r, ret = 0;
+    int i, idx, r, ret = 0;
 
     /* read model count */
     ret += (r = lyb_read_number(&lybs->mod_count, sizeof lybs->mod_count, 2, data, lybs));
@@ -1176,6 +1436,33 @@ lyb_parse_data_models(const char *data, int options, struct lyb_state *lybs)
         }
     }
 
+    if (lybs->version < LYB_VERSION_ANNOTS) {
+        return ret;
+    }
+
+    /* read annotation count */
+    ret += (r = lyb_read_number(&lybs->annot_count, sizeof lybs->annot_count, 2, data, lybs));
+    LYB_HAVE_READ_RETURN(r, data, -1);
+
+    if (lybs->annot_count) {
+        lybs->annots = malloc(lybs->annot_count * sizeof *lybs->annots);
+        LY_CHECK_ERR_RETURN(!lybs->annots, LOGMEM(lybs->ctx), -1);
+
+        /* read annotations, unknown ones are NULL */
+        for (i = 0; i < lybs->annot_count; ++i) {
+            idx = 0;
+            ret += (r = lyb_read_number(&idx, sizeof idx, 2, data, lybs));
+            LYB_HAVE_READ_RETURN(r, data, -1);
+            if (idx >= lybs->mod_count) {
+                LOGVAL(lybs->ctx, LYE_SPEC, LY_VLOG_NONE, NULL, "Invalid LYB model index %d.", idx);
+                return -1;
+            }
+
+            ret += (r = lyb_parse_attr_name(lybs->models[idx], data, &lybs->annots[i], options, lybs));
+            LYB_HAVE_READ_RETURN(r, data, -1);
+        }
+    }
+
     return ret;
 }
 
@@ -1210,14 +1497,296 @@ lyb_parse_magic_number(const char *data, struct lyb_state *lybs)
 }
 
 static int
-lyb_parse_header(const char *data, struct lyb_state *lybs)
+lyb_parse_header(const char *data, uint8_t *flags, struct lyb_state *lybs)
 {
     int ret = 0;
     uint8_t byte = 0;
 
-    /* TODO version, any flags? */
     ret += lyb_read(data, (uint8_t *)&byte, sizeof byte, lybs);
 
+    /* the rest of the data are compressed and/or checksummed */
+    *flags = byte & (LYB_HEADER_COMPRESSED | LYB_HEADER_CHECKSUM);
+
+    /* format version */
+    if ((byte & LYB_HEADER_VERSION_MASK) > LYB_VERSION_USER) {
+        LOGERR(lybs->ctx, LY_EINVAL, "Unsupported LYB format version \"%d\".", (byte & LYB_HEADER_VERSION_MASK) >> 4);
+        return -1;
+    }
+    lybs->version = byte & LYB_HEADER_VERSION_MASK;
+
+    /* schema hash algorithm version */
+    if ((byte & LYB_HEADER_HASH_VERSION_MASK) != LYB_HASH_VERSION) {
+        LOGERR(lybs->ctx, LY_EINVAL, "Unsupported LYB schema hash version \"%d\".", byte & LYB_HEADER_HASH_VERSION_MASK);
+        return -1;
+    }
+
+    return ret;
+}
+
+/* verify the checksum block following the LYB header, return the number of bytes read */
+static int
+lyb_parse_checksum(const char *data, uint32_t *len, uint32_t *ctx_hash, struct ly_ctx *ctx)
+{
+    uint32_t block[3];
+
+    memcpy(block, data, LYB_CHECKSUM_BLOCK_BYTES);
+    *len = le32toh(block[1]);
+    *ctx_hash = le32toh(block[2]);
+
+    if (le32toh(block[0]) != ly_crc32c(0, data + LYB_CHECKSUM_FIELD_BYTES, 2 * LYB_CHECKSUM_FIELD_BYTES + *len)) {
+        LOGERR(ctx, LY_EINVAL, "Invalid LYB data checksum, the data are corrupted.");
+        return -1;
+    }
+
+    return LYB_CHECKSUM_BLOCK_BYTES;
+}
+
+/* read one compressed block length */
+static uint32_t
+lyb_read_block_len(const char *data)
+{
+    uint32_t len;
+
+    memcpy(&len, data, LYB_BLOCK_LEN_BYTES);
+    return le32toh(len);
+}
+
+/* get the length of the compressed blocks following the LYB header */
+static int
+lyb_compressed_length(const char *data)
+{
+    int ret = 0;
+
+    while (lyb_read_block_len(data + ret)) {
+        ret += 2 * LYB_BLOCK_LEN_BYTES + lyb_read_block_len(data + ret + LYB_BLOCK_LEN_BYTES);
+    }
+
+    /* the last zero raw length */
+    return ret + LYB_BLOCK_LEN_BYTES;
+}
+
+/* decompress the blocks following the LYB header into a new buffer, return the number of bytes read */
+static int
+lyb_parse_compressed(const char *data, char **raw, struct ly_ctx *ctx)
+{
+#ifdef LY_ENABLED_LYB_COMPRESSION
+    int ret = 0;
+    uint32_t raw_len, comp_len;
+    size_t len = 0;
+    uLongf block_len;
+    char *mem;
+
+    *raw = NULL;
+    while ((raw_len = lyb_read_block_len(data + ret))) {
+        comp_len = lyb_read_block_len(data + ret + LYB_BLOCK_LEN_BYTES);
+        ret += 2 * LYB_BLOCK_LEN_BYTES;
+        if (raw_len > LYB_BLOCK_SIZE) {
+            LOGERR(ctx, LY_EINVAL, "Invalid compressed LYB block length %" PRIu32 ".", raw_len);
+            goto error;
+        }
+
+        /* one more byte for the terminating zero so that truncated data are not read past the buffer */
+        mem = realloc(*raw, len + raw_len + 1);
+        LY_CHECK_ERR_GOTO(!mem, LOGMEM(ctx), error);
+        *raw = mem;
+
+        block_len = raw_len;
+        if ((uncompress((Bytef *)*raw + len, &block_len, (const Bytef *)data + ret, comp_len) != Z_OK)
+                || (block_len != raw_len)) {
+            LOGERR(ctx, LY_EINVAL, "Decompressing LYB data failed.");
+            goto error;
+        }
+        len += raw_len;
+        ret += comp_len;
+    }
+    ret += LYB_BLOCK_LEN_BYTES;
+
+    if (!*raw) {
+        LOGERR(ctx, LY_EINVAL, "Empty compressed LYB data.");
+        return -1;
+    }
+    (*raw)[len] = '\0';
+    return ret;
+
+error:
+    free(*raw);
+    *raw = NULL;
+    return -1;
+#else
+    (void)data;
+    *raw = NULL;
+    LOGERR(ctx, LY_EINVAL, "Compressed LYB data are not supported (libyang built without zlib).");
+    return -1;
+#endif
+}
+
+struct lyb_parse_worker {
+    const char **starts;        /* first bytes of all the top-level subtrees */
+    struct lyd_node **nodes;    /* parsed top-level subtrees, NULL for unknown data */
+    uint32_t count;
+    uint32_t first;             /* index of the first subtree parsed by this worker */
+    uint32_t step;              /* distance of the next subtrees parsed by this worker */
+    const char *yang_data_name;
+    int options;
+    struct lyb_state lybs;      /* own state, only the models are shared */
+    struct unres_data unres;    /* own unresolved items, merged after all the workers finish */
+    int ret;
+};
+
+static void
+lyb_parse_worker(void *arg)
+{
+    struct lyb_parse_worker *w = arg;
+    uint32_t i;
+
+    for (i = w->first; i < w->count; i += w->step) {
+        if (lyb_parse_subtree(w->starts[i], NULL, &w->nodes[i], w->yang_data_name, w->options, &w->unres, &w->lybs) < 0) {
+            w->ret = EXIT_FAILURE;
+            break;
+        }
+    }
+}
+
+/* parse all the top-level subtrees concurrently, return the number of bytes read (0 if not worth it) or -1 */
+static int
+lyb_parse_parallel(const char *data, struct lyd_node **first_sibling, const char *yang_data_name, int options,
+                   struct unres_data *unres, struct lyb_state *lybs)
+{
+    struct lyb_parse_worker *workers = NULL;
+    struct lyb_state index_lybs;
+    struct lyd_node **nodes = NULL, *last = NULL;
+    const char **starts = NULL;
+    uint32_t i, count = 0, size = 0, unres_count, thread_count = 0;
+    void *mem;
+    int r, ret = 0;
+
+    if (ly_parallel_count(lybs->ctx, 2) < 2) {
+        /* nothing to parallelize */
+        return 0;
+    }
+
+    /* locate the subtrees, they are skipped using their sizes */
+    memset(&index_lybs, 0, sizeof index_lybs);
+    index_lybs.ctx = lybs->ctx;
+    index_lybs.version = lybs->version;
+    while (data[ret]) {
+        if (count == size) {
+            size = size ? size * 2 : LYB_STATE_STEP;
+            mem = realloc(starts, size * sizeof *starts);
+            LY_CHECK_ERR_GOTO(!mem, LOGMEM(lybs->ctx); ret = -1, cleanup);
+            starts = mem;
+        }
+        starts[count++] = data + ret;
+
+        ret += (r = lyb_read_start_subtree(data + ret, &index_lybs));
+        if (r < 0) {
+            ret = -1;
+            goto cleanup;
+        }
+        ret += (r = lyb_skip_subtree(data + ret, &index_lybs));
+        if (r < 0) {
+            ret = -1;
+            goto cleanup;
+        }
+        lyb_read_stop_subtree(&index_lybs);
+    }
+
+    thread_count = ly_parallel_count(lybs->ctx, count);
+    if (thread_count < 2) {
+        /* parse the single subtree normally */
+        ret = 0;
+        goto cleanup;
+    }
+
+    nodes = calloc(count, sizeof *nodes);
+    workers = calloc(thread_count, sizeof *workers);
+    LY_CHECK_ERR_GOTO(!nodes || !workers, LOGMEM(lybs->ctx); ret = -1, cleanup);
+
+    /* the subtrees are distributed round-robin, the calling thread parses its share as the first worker */
+    for (i = 0; i < thread_count; ++i) {
+        workers[i].starts = starts;
+        workers[i].nodes = nodes;
+        workers[i].count = count;
+        workers[i].first = i;
+        workers[i].step = thread_count;
+        workers[i].yang_data_name = yang_data_name;
+        workers[i].options = options;
+        workers[i].lybs.models = lybs->models;
+        workers[i].lybs.mod_count = lybs->mod_count;
+        workers[i].lybs.annots = lybs->annots;
+        workers[i].lybs.annot_count = lybs->annot_count;
+        workers[i].lybs.ctx = lybs->ctx;
+        workers[i].lybs.version = lybs->version;
+    }
+    ly_parallel_run(lybs->ctx, lyb_parse_worker, workers, sizeof *workers, thread_count);
+    unres_count = unres->count;
+    for (i = 0; i < thread_count; ++i) {
+        if (workers[i].ret) {
+            ret = -1;
+        }
+        unres_count += workers[i].unres.count;
+    }
+    if (ret < 0) {
+        goto cleanup;
+    }
+
+    /* merge the unresolved items */
+    if (unres_count > unres->size) {
+        mem = realloc(unres->node, unres_count * sizeof *unres->node);
+        LY_CHECK_ERR_GOTO(!mem, LOGMEM(lybs->ctx); ret = -1, cleanup);
+        unres->node = mem;
+        mem = realloc(unres->type, unres_count * sizeof *unres->type);
+        LY_CHECK_ERR_GOTO(!mem, LOGMEM(lybs->ctx); ret = -1, cleanup);
+        unres->type = mem;
+        unres->size = unres_count;
+    }
+    if (unres_count > unres->count) {
+        for (i = 0; i < thread_count; ++i) {
+            if (workers[i].unres.count) {
+                memcpy(unres->node + unres->count, workers[i].unres.node, workers[i].unres.count * sizeof *unres->node);
+                memcpy(unres->type + unres->count, workers[i].unres.type, workers[i].unres.count * sizeof *unres->type);
+                unres->count += workers[i].unres.count;
+            }
+        }
+    }
+
+    /* link the subtrees in the original order */
+    for (i = 0; i < count; ++i) {
+        if (!nodes[i]) {
+            continue;
+        }
+        if (!*first_sibling) {
+            *first_sibling = nodes[i];
+        } else {
+            last->next = nodes[i];
+            nodes[i]->prev = last;
+            (*first_sibling)->prev = nodes[i];
+        }
+        last = nodes[i];
+        nodes[i] = NULL;
+    }
+
+cleanup:
+    if (nodes) {
+        for (i = 0; i < count; ++i) {
+            lyd_free(nodes[i]);
+        }
+    }
+    if (workers) {
+        for (i = 0; i < thread_count; ++i) {
+            free(workers[i].lybs.written);
+            free(workers[i].lybs.position);
+            free(workers[i].lybs.inner_chunks);
+            free(workers[i].unres.node);
+            free(workers[i].unres.type);
+        }
+    }
+    free(index_lybs.written);
+    free(index_lybs.position);
+    free(index_lybs.inner_chunks);
+    free(starts);
+    free(nodes);
+    free(workers);
     return ret;
 }
 
@@ -1225,10 +1794,13 @@ struct lyd_node *
 lyd_parse_lyb(struct ly_ctx *ctx, const char *data, int options, const struct lyd_node *data_tree,
               const char *yang_data_name, int *parsed)
 {
-    int r = 0, ret = 0;
+    int r = 0, ret = 0, comp_ret = 0, sum_ret = 0;
     struct lyd_node *node = NULL, *next, *act_notif = NULL;
     struct unres_data *unres = NULL;
     struct lyb_state lybs;
+    uint32_t len, ctx_hash;
+    uint8_t flags;
+    char *raw = NULL;
 
     if (!ctx || !data) {
         LOGARG;
@@ -1243,7 +1815,11 @@ lyd_parse_lyb(struct ly_ctx *ctx, const char *data, int options, const struct ly
     lybs.size = LYB_STATE_STEP;
     lybs.models = NULL;
     lybs.mod_count = 0;
+    lybs.annots = NULL;
+    lybs.annot_count = 0;
     lybs.ctx = ctx;
+    lybs.version = LYB_VERSION_CHUNKS;
+    lybs.offset = 0;
 
     unres = calloc(1, sizeof *unres);
     LY_CHECK_ERR_GOTO(!unres, LOGMEM(ctx), finish);
@@ -1253,13 +1829,45 @@ lyd_parse_lyb(struct ly_ctx *ctx, const char *data, int options, const struct ly
     LYB_HAVE_READ_GOTO(r, data, finish);
 
     /* read header */
-    ret += (r = lyb_parse_header(data, &lybs));
+    ret += (r = lyb_parse_header(data, &flags, &lybs));
     LYB_HAVE_READ_GOTO(r, data, finish);
 
+    if (options & LYD_OPT_TRUSTED) {
+        /* explicitly trusted */
+        options &= ~LYD_OPT_LYB_VALIDATE;
+    }
+
+    if (flags & LYB_HEADER_CHECKSUM) {
+        ret += (r = lyb_parse_checksum(data, &len, &ctx_hash, ctx));
+        LYB_HAVE_READ_GOTO(r, data, finish);
+        sum_ret = ret + len;
+
+        if ((options & LYD_OPT_LYB_VALIDATE) && (ctx_hash == lyb_ctx_hash(ctx))) {
+            /* validated in the same schema set */
+            options &= ~LYD_OPT_LYB_VALIDATE;
+        }
+    }
+
+    if (flags & LYB_HEADER_COMPRESSED) {
+        /* the rest is parsed from the decompressed blocks */
+        r = lyb_parse_compressed(data, &raw, ctx);
+        if (r < 0) {
+            goto finish;
+        }
+        comp_ret = ret + r;
+        data = raw;
+    }
+
     /* read used models */
     ret += (r = lyb_parse_data_models(data, options, &lybs));
     LYB_HAVE_READ_GOTO(r, data, finish);
 
+    if ((options & LYD_OPT_PARALLEL) && !(options & (LYD_OPT_RPC | LYD_OPT_RPCREPLY | LYD_OPT_NOTIF))) {
+        /* read the subtrees concurrently, the rest (if any) is read normally */
+        ret += (r = lyb_parse_parallel(data, &node, yang_data_name, options, unres, &lybs));
+        LYB_HAVE_READ_GOTO(r, data, finish);
+    }
+
     /* read subtree(s) */
     while (data[0]) {
         ret += (r = lyb_parse_subtree(data, NULL, &node, yang_data_name, options, unres, &lybs));
@@ -1273,7 +1881,7 @@ lyd_parse_lyb(struct ly_ctx *ctx, const char *data, int options, const struct ly
 
     /* read the last zero, parsing finished */
     ++ret;
-    r = ret;
+    r = sum_ret ? sum_ret : (raw ? comp_ret : ret);
 
     if (options & LYD_OPT_DATA_ADD_YANGLIB) {
         if (lyd_merge(node, ly_ctx_info(ctx), LYD_OPT_DESTRUCT | LYD_OPT_EXPLICIT)) {
@@ -1301,11 +1909,21 @@ lyd_parse_lyb(struct ly_ctx *ctx, const char *data, int options, const struct ly
         }
     }
 
+    /* the data are not known to be valid in this context */
+    if ((options & LYD_OPT_LYB_VALIDATE) && lyd_validate(&node,
+            options & ~(LYD_OPT_LYB_VALIDATE | LYD_OPT_LYB_MOD_UPDATE | LYD_OPT_DATA_ADD_YANGLIB),
+            (options & (LYD_OPT_RPC | LYD_OPT_RPCREPLY | LYD_OPT_NOTIF)) ? (void *)data_tree : (void *)ctx)) {
+        lyd_free_withsiblings(node);
+        node = NULL;
+    }
+
 finish:
     free(lybs.written);
     free(lybs.position);
     free(lybs.inner_chunks);
     free(lybs.models);
+    free(lybs.annots);
+    free(raw);
     if (unres) {
         free(unres->node);
         free(unres->type);
@@ -1326,7 +1944,8 @@ lyd_lyb_data_length(const char *data)
     struct lyb_state lybs;
     int r = 0, ret = 0, i;
     size_t len;
-    uint8_t buf[LYB_SIZE_MAX];
+    uint32_t sum_len;
+    uint8_t buf[LYB_SIZE_MAX], flags;
 
     if (!data) {
         return -1;
@@ -1340,16 +1959,33 @@ lyd_lyb_data_length(const char *data)
     lybs.size = LYB_STATE_STEP;
     lybs.models = NULL;
     lybs.mod_count = 0;
+    lybs.annots = NULL;
+    lybs.annot_count = 0;
     lybs.ctx = NULL;
+    lybs.version = LYB_VERSION_CHUNKS;
+    lybs.offset = 0;
 
     /* read magic number */
     ret += (r = lyb_parse_magic_number(data, &lybs));
     LYB_HAVE_READ_GOTO(r, data, finish);
 
     /* read header */
-    ret += (r = lyb_parse_header(data, &lybs));
+    ret += (r = lyb_parse_header(data, &flags, &lybs));
     LYB_HAVE_READ_GOTO(r, data, finish);
 
+    if (flags & LYB_HEADER_CHECKSUM) {
+        /* the length of the rest is known */
+        memcpy(&sum_len, data + LYB_CHECKSUM_FIELD_BYTES, LYB_CHECKSUM_FIELD_BYTES);
+        ret += LYB_CHECKSUM_BLOCK_BYTES + le32toh(sum_len);
+        goto finish;
+    }
+
+    if (flags & LYB_HEADER_COMPRESSED) {
+        /* the blocks are skipped without decompressing them */
+        ret += lyb_compressed_length(data);
+        goto finish;
+    }
+
     /* read model count */
     ret += (r = lyb_read_number(&lybs.mod_count, sizeof lybs.mod_count, 2, data, &lybs));
     LYB_HAVE_READ_GOTO(r, data, finish);
@@ -1370,6 +2006,28 @@ lyd_lyb_data_length(const char *data)
         LYB_HAVE_READ_GOTO(r, data, finish);
     }
 
+    if (lybs.version >= LYB_VERSION_ANNOTS) {
+        /* read annotation count */
+        ret += (r = lyb_read_number(&lybs.annot_count, sizeof lybs.annot_count, 2, data, &lybs));
+        LYB_HAVE_READ_GOTO(r, data, finish);
+
+        /* read all annotations */
+        for (i = 0; i < lybs.annot_count; ++i) {
+            /* model index */
+            ret += (r = lyb_read(data, NULL, 2, &lybs));
+            LYB_HAVE_READ_GOTO(r, data, finish);
+
+            /* annotation name length */
+            len = 0;
+            ret += (r = lyb_read_number(&len, sizeof len, 2, data, &lybs));
+            LYB_HAVE_READ_GOTO(r, data, finish);
+
+            /* annotation name */
+            ret += (r = lyb_read(data, NULL, len, &lybs));
+            LYB_HAVE_READ_GOTO(r, data, finish);
+        }
+    }
+
     while (data[0]) {
         /* register a new subtree */
         ret += (r = lyb_read_start_subtree(data, &lybs));
@@ -1391,5 +2049,265 @@ finish:
     free(lybs.position);
     free(lybs.inner_chunks);
     free(lybs.models);
+    free(lybs.annots);
     return ret;
 }
+
+struct lyd_lyb_reader {
+    struct ly_ctx *ctx;
+    int options;
+    const char *data;           /* the whole LYB data */
+    size_t map_len;             /* length of the mapped file, 0 if the data belong to the caller */
+    char *raw;                  /* decompressed data following the header of compressed LYB data */
+    struct lyb_state lybs;      /* state with the data models and the format version, shared by all the subtrees */
+    struct {
+        const char *start;      /* the first byte of the top-level subtree */
+        struct lys_node *schema; /* its schema node, NULL for unknown data */
+    } *subtrees;
+    uint32_t count;
+};
+
+static struct lyd_lyb_reader *
+lyb_reader_new(struct ly_ctx *ctx, const char *data, size_t map_len, int options, const char *func)
+{
+    struct lyd_lyb_reader *reader;
+    const struct lys_module *mod;
+    struct lys_node *snode;
+    void *mem;
+    uint32_t size = 0;
+    uint32_t len, ctx_hash;
+    uint8_t flags;
+    int r;
+
+    if (lyp_data_check_options(ctx, options, func)) {
+        return NULL;
+    }
+    if (options & (LYD_OPT_RPC | LYD_OPT_RPCREPLY | LYD_OPT_NOTIF | LYD_OPT_DATA_ADD_YANGLIB)) {
+        LOGERR(ctx, LY_EINVAL, "%s: Invalid options 0x%x (only data trees can be read lazily).", func, options);
+        return NULL;
+    }
+
+    reader = calloc(1, sizeof *reader);
+    LY_CHECK_ERR_RETURN(!reader, LOGMEM(ctx), NULL);
+    reader->ctx = ctx;
+    /* the subtrees are parsed separately, so they cannot be validated */
+    reader->options = options & ~LYD_OPT_LYB_VALIDATE;
+    reader->data = data;
+    reader->map_len = map_len;
+    reader->lybs.ctx = ctx;
+    reader->lybs.version = LYB_VERSION_CHUNKS;
+
+    /* read magic number */
+    r = lyb_parse_magic_number(data, &reader->lybs);
+    LYB_HAVE_READ_GOTO(r, data, error);
+
+    /* read header */
+    r = lyb_parse_header(data, &flags, &reader->lybs);
+    LYB_HAVE_READ_GOTO(r, data, error);
+
+    if (flags & LYB_HEADER_CHECKSUM) {
+        r = lyb_parse_checksum(data, &len, &ctx_hash, ctx);
+        LYB_HAVE_READ_GOTO(r, data, error);
+    }
+
+    if (flags & LYB_HEADER_COMPRESSED) {
+        /* the subtrees are read from the decompressed blocks */
+        if (lyb_parse_compressed(data, &reader->raw, ctx) < 0) {
+            goto error;
+        }
+        data = reader->raw;
+    }
+
+    /* read used models */
+    r = lyb_parse_data_models(data, options, &reader->lybs);
+    LYB_HAVE_READ_GOTO(r, data, error);
+
+    /* index the top-level subtrees, only their schema nodes are read */
+    while (data[0]) {
+        if (reader->count == size) {
+            size = size ? size * 2 : LYB_STATE_STEP;
+            mem = realloc(reader->subtrees, size * sizeof *reader->subtrees);
+            LY_CHECK_ERR_GOTO(!mem, LOGMEM(ctx), error);
+            reader->subtrees = mem;
+        }
+        reader->subtrees[reader->count].start = data;
+
+        r = lyb_read_start_subtree(data, &reader->lybs);
+        LYB_HAVE_READ_GOTO(r, data, error);
+
+        r = lyb_parse_model(data, &mod, options, &reader->lybs);
+        LYB_HAVE_READ_GOTO(r, data, error);
+
+        r = lyb_parse_schema_hash(NULL, mod, data, NULL, options, &snode, &reader->lybs);
+        LYB_HAVE_READ_GOTO(r, data, error);
+        reader->subtrees[reader->count].schema = snode;
+
+        /* the rest of the subtree is not needed now */
+        r = lyb_skip_subtree(data, &reader->lybs);
+        LYB_HAVE_READ_GOTO(r, data, error);
+
+        lyb_read_stop_subtree(&reader->lybs);
+        ++reader->count;
+    }
+
+    return reader;
+
+error:
+    /* the mapped file is unmapped by the caller */
+    reader->map_len = 0;
+    lyd_lyb_reader_free(reader);
+    return NULL;
+}
+
+API struct lyd_lyb_reader *
+lyd_lyb_reader_mem(struct ly_ctx *ctx, const char *data, int options)
+{
+    FUN_IN;
+
+    if (!ctx || !data) {
+        LOGARG;
+        return NULL;
+    }
+
+    return lyb_reader_new(ctx, data, 0, options, __func__);
+}
+
+API struct lyd_lyb_reader *
+lyd_lyb_reader_path(struct ly_ctx *ctx, const char *path, int options)
+{
+    FUN_IN;
+
+    struct lyd_lyb_reader *reader;
+    size_t length = 0;
+    char *data;
+    int fd, ret;
+
+    if (!ctx || !path) {
+        LOGARG;
+        return NULL;
+    }
+
+    fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        LOGERR(ctx, LY_ESYS, "Failed to open data file \"%s\" (%s).", path, strerror(errno));
+        return NULL;
+    }
+
+    ret = lyp_mmap(ctx, fd, 0, &length, (void **)&data);
+    close(fd);
+    if (ret) {
+        LOGERR(ctx, LY_ESYS, "Mapping file descriptor into memory failed (%s()).", __func__);
+        return NULL;
+    } else if (!data) {
+        LOGERR(ctx, LY_EINVAL, "Empty LYB data file \"%s\".", path);
+        return NULL;
+    }
+
+    reader = lyb_reader_new(ctx, data, length, options, __func__);
+    if (!reader) {
+        lyp_munmap(data, length);
+    }
+    return reader;
+}
+
+API uint32_t
+lyd_lyb_reader_count(const struct lyd_lyb_reader *reader)
+{
+    FUN_IN;
+
+    if (!reader) {
+        LOGARG;
+        return 0;
+    }
+
+    return reader->count;
+}
+
+API const struct lys_node *
+lyd_lyb_reader_schema(const struct lyd_lyb_reader *reader, uint32_t idx)
+{
+    FUN_IN;
+
+    if (!reader || (idx >= reader->count)) {
+        LOGARG;
+        return NULL;
+    }
+
+    return reader->subtrees[idx].schema;
+}
+
+API struct lyd_node *
+lyd_lyb_reader_parse(struct lyd_lyb_reader *reader, uint32_t idx)
+{
+    FUN_IN;
+
+    struct lyd_node *node = NULL;
+    struct unres_data *unres = NULL;
+    struct lyb_state lybs;
+
+    if (!reader || (idx >= reader->count)) {
+        LOGARG;
+        return NULL;
+    }
+    if (!reader->subtrees[idx].schema) {
+        /* unknown data, nothing to parse */
+        return NULL;
+    }
+
+    /* the subtree is parsed on its own, only the models are shared */
+    memset(&lybs, 0, sizeof lybs);
+    lybs.models = reader->lybs.models;
+    lybs.mod_count = reader->lybs.mod_count;
+    lybs.annots = reader->lybs.annots;
+    lybs.annot_count = reader->lybs.annot_count;
+    lybs.ctx = reader->ctx;
+    lybs.version = reader->lybs.version;
+
+    unres = calloc(1, sizeof *unres);
+    LY_CHECK_ERR_GOTO(!unres, LOGMEM(reader->ctx), finish);
+
+    if (lyb_parse_subtree(reader->subtrees[idx].start, NULL, &node, NULL, reader->options, unres, &lybs) < 0) {
+        lyd_free_withsiblings(node);
+        node = NULL;
+        goto finish;
+    }
+
+    /* resolve any unresolved instance-identifiers */
+    if (unres->count && lyd_defaults_add_unres(&node, reader->options, reader->ctx, NULL, 0, NULL, NULL, unres, 0)) {
+        lyd_free_withsiblings(node);
+        node = NULL;
+    }
+
+finish:
+    free(lybs.written);
+    free(lybs.position);
+    free(lybs.inner_chunks);
+    if (unres) {
+        free(unres->node);
+        free(unres->type);
+        free(unres);
+    }
+    return node;
+}
+
+API void
+lyd_lyb_reader_free(struct lyd_lyb_reader *reader)
+{
+    FUN_IN;
+
+    if (!reader) {
+        return;
+    }
+
+    if (reader->map_len) {
+        lyp_munmap((void *)reader->data, reader->map_len);
+    }
+    free(reader->lybs.written);
+    free(reader->lybs.position);
+    free(reader->lybs.inner_chunks);
+    free(reader->lybs.models);
+    free(reader->lybs.annots);
+    free(reader->subtrees);
+    free(reader->raw);
+    free(reader);
+}
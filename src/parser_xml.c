@@ -73,15 +73,73 @@ xml_data_search_schemanode(struct lyxml_elem *xml, struct lys_node *start, int o
     return NULL;
 }
 
+/* does not log */
+static struct lys_node *
+xml_data_predict_schemanode(struct lyxml_elem *xml, const struct lys_node *sparent, const struct lyd_node *prev)
+{
+    const struct lys_node *snode;
+    int i;
+
+    /* the data siblings are mostly in the schema order, so try the same node (list and leaf-list instances)
+     * and the next one in the schema order */
+    for (snode = prev->schema, i = 0; snode && (i < 2); snode = lys_getnext(snode, sparent, NULL, 0), ++i) {
+        if (ly_strequal(snode->name, xml->name, 1)
+                && ly_strequal(lys_main_module(snode->module)->ns, xml->ns->value, 1)) {
+            return (struct lys_node *)snode;
+        }
+    }
+
+    return NULL;
+}
+
+/* does not log, except memory errors */
+static struct lys_node *
+xml_data_find_schemanode(struct ly_ctx *ctx, struct lyxml_elem *xml, struct lys_node *sparent,
+                         const struct lys_module *mod, int options)
+{
+    const struct lys_module *xml_mod;
+    const struct lys_node *scope = sparent, *schema = NULL;
+
+    if (sparent && (sparent->nodetype & (LYS_RPC | LYS_ACTION))) {
+        /* the input and output children may have the same names */
+        scope = NULL;
+        if (options & (LYD_OPT_RPC | LYD_OPT_RPCREPLY)) {
+            while ((scope = lys_getnext(scope, sparent, NULL, LYS_GETNEXT_WITHINOUT))) {
+                if (scope->nodetype == ((options & LYD_OPT_RPC) ? LYS_INPUT : LYS_OUTPUT)) {
+                    break;
+                }
+            }
+        }
+    } else if (sparent && !(sparent->nodetype & (LYS_CONTAINER | LYS_LIST | LYS_NOTIF))) {
+        scope = NULL;
+    }
+
+    /* look into the context index of data children first */
+    if ((scope || !sparent) && (xml_mod = ly_ctx_get_module_by_ns(ctx, xml->ns->value, NULL, 0))
+            && !lys_find_data_child(ctx, scope, scope ? NULL : mod, xml_mod->name, strlen(xml_mod->name), xml->name,
+                                    strlen(xml->name), &schema) && schema) {
+        return (struct lys_node *)schema;
+    }
+
+    /* nodes disabled by their if-features are not indexed */
+    return xml_data_search_schemanode(xml, sparent ? sparent->child : mod->data, options);
+}
+
 /* logs directly */
 static int
-xml_get_value(struct lyd_node *node, struct lyxml_elem *xml, int editbits, int trusted)
+xml_get_value(struct lyd_node *node, struct lyxml_elem *xml, int editbits, int trusted, int destruct)
 {
     struct lyd_node_leaf_list *leaf = (struct lyd_node_leaf_list *)node;
 
     assert(node && (node->schema->nodetype & (LYS_LEAFLIST | LYS_LEAF)) && xml);
 
-    leaf->value_str = lydict_insert(node->schema->module->ctx, xml->content, 0);
+    if (destruct) {
+        /* move the dictionary string */
+        leaf->value_str = xml->content;
+        xml->content = NULL;
+    } else {
+        leaf->value_str = lydict_insert(node->schema->module->ctx, xml->content, 0);
+    }
 
     if ((editbits & 0x20) && (node->schema->nodetype & LYS_LEAF) && (!leaf->value_str || !leaf->value_str[0])) {
         /* we have edit-config leaf/leaf-list with delete operation and no (empty) value,
@@ -163,7 +221,7 @@ xml_parse_data(struct ly_ctx *ctx, struct lyxml_elem *xml, struct lyd_node *pare
                     }
                 }
             } else {
-                schema = xml_data_search_schemanode(xml, mod->data, options);
+                schema = xml_data_find_schemanode(ctx, xml, NULL, mod, options);
                 if (!schema) {
                     /* it still can be the specific case of this module containing an augment of another module
                     * top-level choice or top-level choice's case, bleh */
@@ -195,7 +253,12 @@ xml_parse_data(struct ly_ctx *ctx, struct lyxml_elem *xml, struct lyd_node *pare
         }
     } else {
         /* parsing some internal node, we start with parent's schema pointer */
-        schema = xml_data_search_schemanode(xml, parent->schema->child, options);
+        if (prev && (prev->parent == parent) && (parent->schema->nodetype & (LYS_CONTAINER | LYS_LIST | LYS_NOTIF))) {
+            schema = xml_data_predict_schemanode(xml, parent->schema, prev);
+        }
+        if (!schema) {
+            schema = xml_data_find_schemanode(ctx, xml, parent->schema, NULL, options);
+        }
 
         if (ctx->data_clb) {
             if (schema && !lys_node_module(schema)->implemented) {
@@ -237,17 +300,17 @@ xml_parse_data(struct ly_ctx *ctx, struct lyxml_elem *xml, struct lyd_node *pare
                 return -1;
             }
         }
-        *result = calloc(1, sizeof **result);
+        *result = lyd_pool_alloc(ctx, sizeof **result);
         havechildren = 1;
         break;
     case LYS_LEAF:
     case LYS_LEAFLIST:
-        *result = calloc(1, sizeof(struct lyd_node_leaf_list));
+        *result = lyd_pool_alloc(ctx, sizeof(struct lyd_node_leaf_list));
         havechildren = 0;
         break;
     case LYS_ANYXML:
     case LYS_ANYDATA:
-        *result = calloc(1, sizeof(struct lyd_node_anydata));
+        *result = lyd_pool_alloc(ctx, sizeof(struct lyd_node_anydata));
         havechildren = 0;
         break;
     default:
@@ -255,6 +318,7 @@ xml_parse_data(struct ly_ctx *ctx, struct lyxml_elem *xml, struct lyd_node *pare
         return -1;
     }
     LY_CHECK_ERR_RETURN(!(*result), LOGMEM(ctx), -1);
+    ++ly_cnt.nodes_parsed;
 
     (*result)->prev = *result;
     (*result)->schema = schema;
@@ -272,7 +336,7 @@ xml_parse_data(struct ly_ctx *ctx, struct lyxml_elem *xml, struct lyd_node *pare
                 LOGVAL(ctx, LYE_INORDER, LY_VLOG_LYD, *result, schema->name, diter->schema->name);
                 LOGVAL(ctx, LYE_SPEC, LY_VLOG_PREV, NULL, "Invalid position of the key \"%s\" in a list \"%s\".",
                        schema->name, parent->schema->name);
-                free(*result);
+                lyd_pool_free(ctx, *result);
                 *result = NULL;
                 return -1;
             } else {
@@ -453,7 +517,7 @@ attr_error:
     /* type specific processing */
     if (schema->nodetype & (LYS_LEAF | LYS_LEAFLIST)) {
         /* type detection and assigning the value */
-        if (xml_get_value(*result, xml, editbits, options & LYD_OPT_TRUSTED)) {
+        if (xml_get_value(*result, xml, editbits, LYP_TRUSTED_OPT(options), options & LYD_OPT_DESTRUCT)) {
             goto unlink_node_error;
         }
     } else if (schema->nodetype & LYS_ANYDATA) {
@@ -471,7 +535,12 @@ attr_error:
             ((struct lyd_node_anydata *)*result)->value.xml = child;
         } else {
             ((struct lyd_node_anydata *)*result)->value_type = LYD_ANYDATA_CONSTSTRING;
-            ((struct lyd_node_anydata *)*result)->value.str = lydict_insert(ctx, xml->content, 0);
+            if (options & LYD_OPT_DESTRUCT) {
+                ((struct lyd_node_anydata *)*result)->value.str = xml->content;
+                xml->content = NULL;
+            } else {
+                ((struct lyd_node_anydata *)*result)->value.str = lydict_insert(ctx, xml->content, 0);
+            }
         }
     } else if (schema->nodetype & (LYS_RPC | LYS_ACTION)) {
         if (!(options & LYD_OPT_RPC) || *act_notif) {
@@ -748,8 +817,11 @@ lyd_parse_xml(struct ly_ctx *ctx, struct lyxml_elem **root, int options, ...)
             && lyd_check_mandatory_tree((act_notif ? act_notif : result), ctx, NULL, 0, options)) {
         goto error;
     }
+    lyd_val_subtree_forget(result, NULL, 0, options);
 
     if (xmlfree) {
+        /* the action is freed with the rest of its children, leave any other roots to the caller */
+        *root = xmlfree->next ? xmlfree->next : ((xmlfree->prev != xmlfree) ? xmlfree->prev : NULL);
         lyxml_free(ctx, xmlfree);
     }
     free(unres->node);
@@ -761,6 +833,8 @@ lyd_parse_xml(struct ly_ctx *ctx, struct lyxml_elem **root, int options, ...)
 error:
     lyd_free_withsiblings(result);
     if (xmlfree) {
+        /* the action is freed with the rest of its children, leave any other roots to the caller */
+        *root = xmlfree->next ? xmlfree->next : ((xmlfree->prev != xmlfree) ? xmlfree->prev : NULL);
         lyxml_free(ctx, xmlfree);
     }
     free(unres->node);
@@ -1026,7 +1026,7 @@ yang_check_type(struct lys_module *module, struct lys_node *parent, struct yang_
     dertype = &type->der->type;
     while (dertype->der) {
         if (dertype->parent->flags & LYS_VALID_EXT) {
-            type->parent->flags |= LYS_VALID_EXT;
+            type->parent->flags |= LYS_VALID_EXT | LYS_VALID_EXT_TYPE;
         }
         dertype = &dertype->der->type;
     }
@@ -1167,10 +1167,14 @@ yang_read_pattern(struct ly_ctx *ctx, struct lys_restr *pattern, void **precomp,
     char *buf;
     size_t len;
 
-    if (precomp && lyp_precompile_pattern(ctx, value, (pcre**)&precomp[0], (pcre_extra**)&precomp[1])) {
+#ifdef LY_ENABLED_CACHE
+    if (precomp && lyp_pattern_cache_get(ctx, value, (pcre**)&precomp[0], (pcre_extra**)&precomp[1])) {
         free(value);
         return EXIT_FAILURE;
     }
+#else
+    (void)precomp;
+#endif
 
     len = strlen(value);
     buf = malloc((len + 2) * sizeof *buf); /* modifier byte + value + terminating NULL byte */
@@ -2793,6 +2797,89 @@ error:
     return NULL;
 }
 
+int
+yang_lex_dquoted(const char *input, int *tab_count, int *column)
+{
+    const unsigned char *p = (const unsigned char *)input, *line = NULL;
+
+    while (1) {
+        if (*p == '\\') {
+            if (p[1] == 't') {
+                ++(*tab_count);
+            } else if ((p[1] != '\t') && (p[1] != '\n') && (p[1] != '\r') && ((p[1] < 0x20) || (p[1] > 0x7f))) {
+                break;
+            }
+            p += 2;
+        } else if (*p == '\t') {
+            ++(*tab_count);
+            ++p;
+        } else if (*p == '\n') {
+            line = ++p;
+        } else if ((*p == '\r') || ((*p >= 0x20) && (*p <= 0x7f) && (*p != '"'))) {
+            ++p;
+        } else {
+            /* the closing quote, EOF or anything the scanner must check */
+            break;
+        }
+    }
+
+    if (line) {
+        *column = (const char *)p - (const char *)line;
+    } else {
+        *column += (const char *)p - input;
+    }
+    return (const char *)p - input;
+}
+
+int
+yang_lex_squoted(const char *input, int *column)
+{
+    const unsigned char *p = (const unsigned char *)input, *line = NULL;
+
+    while (1) {
+        if (*p == '\n') {
+            line = ++p;
+        } else if ((*p == '\t') || (*p == '\r') || ((*p >= 0x20) && (*p <= 0x7f) && (*p != '\''))) {
+            ++p;
+        } else {
+            break;
+        }
+    }
+
+    if (line) {
+        *column = (const char *)p - (const char *)line;
+    } else {
+        *column += (const char *)p - input;
+    }
+    return (const char *)p - input;
+}
+
+int
+yang_lex_comment(const char *input, int block, int *column)
+{
+    const unsigned char *p = (const unsigned char *)input, *line = NULL;
+
+    while (*p && (*p <= 0x7f)) {
+        if (*p == '\n') {
+            if (!block) {
+                /* the end of the line comment is returned as EOL by the scanner */
+                break;
+            }
+            line = p + 1;
+        } else if (block && (*p == '*') && (p[1] == '/')) {
+            break;
+        }
+        ++p;
+    }
+
+    if (line) {
+        *column = (const char *)p - (const char *)line;
+    } else {
+        *column += (const char *)p - input;
+    }
+    return (const char *)p - input;
+}
+
 static int
 read_indent(const char *input, int indent, int size, int in_index, int *out_index, char *output)
 {
@@ -3321,12 +3408,31 @@ yang_check_imports(struct lys_module *module, struct unres_schema *unres)
     struct lys_include *inc;
     uint8_t imp_size, inc_size, j = 0, i = 0;
     char *s;
+    const char **names, **revs;
 
     imp = module->imp;
     imp_size = module->imp_size;
     inc = module->inc;
     inc_size = module->inc_size;
 
+    if (module->ctx->prefetch_clb && (imp_size || inc_size)) {
+        /* let the caller start retrieving all of them before the first is requested */
+        names = malloc(2 * (imp_size + inc_size) * sizeof *names);
+        LY_CHECK_ERR_GOTO(!names, LOGMEM(module->ctx), error);
+        revs = names + imp_size + inc_size;
+        for (i = 0; i < imp_size; ++i) {
+            names[i] = (char *)imp[i].module;
+            revs[i] = imp[i].rev;
+        }
+        for (j = 0; j < inc_size; ++j) {
+            names[imp_size + j] = (char *)inc[j].submodule;
+            revs[imp_size + j] = inc[j].rev;
+        }
+        ly_ctx_prefetch_clb(module->ctx, names, revs, imp_size + inc_size);
+        free(names);
+        i = j = 0;
+    }
+
     if (imp_size) {
         module->imp = calloc(imp_size, sizeof *module->imp);
         module->imp_size = 0;
@@ -3482,7 +3588,7 @@ yang_fill_type(struct lys_module *module, struct lys_type *type, struct yang_typ
     }
     for (j = 0; j < type->ext_size; ++j) {
         if (type->ext[j]->flags & LYEXT_OPT_VALID) {
-            type->parent->flags |= LYS_VALID_EXT;
+            type->parent->flags |= LYS_VALID_EXT | LYS_VALID_EXT_TYPE;
             break;
         }
     }
@@ -3499,7 +3605,7 @@ yang_fill_type(struct lys_module *module, struct lys_type *type, struct yang_typ
             }
             for (j = 0; j < type->info.enums.enm[i].ext_size; ++j) {
                 if (type->info.enums.enm[i].ext[j]->flags & LYEXT_OPT_VALID) {
-                    type->parent->flags |= LYS_VALID_EXT;
+                    type->parent->flags |= LYS_VALID_EXT | LYS_VALID_EXT_TYPE;
                     break;
                 }
             }
@@ -3516,7 +3622,7 @@ yang_fill_type(struct lys_module *module, struct lys_type *type, struct yang_typ
             }
             for (j = 0; j < type->info.bits.bit[i].ext_size; ++j) {
                 if (type->info.bits.bit[i].ext[j]->flags & LYEXT_OPT_VALID) {
-                    type->parent->flags |= LYS_VALID_EXT;
+                    type->parent->flags |= LYS_VALID_EXT | LYS_VALID_EXT_TYPE;
                     break;
                 }
             }
@@ -3535,7 +3641,7 @@ yang_fill_type(struct lys_module *module, struct lys_type *type, struct yang_typ
             }
             for (j = 0; j < type->info.str.length->ext_size; ++j) {
                 if (type->info.str.length->ext[j]->flags & LYEXT_OPT_VALID) {
-                    type->parent->flags |= LYS_VALID_EXT;
+                    type->parent->flags |= LYS_VALID_EXT | LYS_VALID_EXT_TYPE;
                     break;
                 }
             }
@@ -3548,7 +3654,7 @@ yang_fill_type(struct lys_module *module, struct lys_type *type, struct yang_typ
             }
             for (j = 0; j < type->info.str.patterns[i].ext_size; ++j) {
                 if (type->info.str.patterns[i].ext[j]->flags & LYEXT_OPT_VALID) {
-                    type->parent->flags |= LYS_VALID_EXT;
+                    type->parent->flags |= LYS_VALID_EXT | LYS_VALID_EXT_TYPE;
                     break;
                 }
             }
@@ -3562,7 +3668,7 @@ yang_fill_type(struct lys_module *module, struct lys_type *type, struct yang_typ
             }
             for (j = 0; j < type->info.dec64.range->ext_size; ++j) {
                 if (type->info.dec64.range->ext[j]->flags & LYEXT_OPT_VALID) {
-                    type->parent->flags |= LYS_VALID_EXT;
+                    type->parent->flags |= LYS_VALID_EXT | LYS_VALID_EXT_TYPE;
                     break;
                 }
             }
@@ -79,6 +79,30 @@ struct yang_type {
 
 char *yang_read_string(struct ly_ctx *ctx, const char *input, char *output, int size, int offset, int indent);
 
+/**
+ * @brief Skip the plain part of a double-quoted string at once, used by the scanner.
+ *
+ * Stops at the closing quote or at the first character the scanner rules must check
+ * (non-ASCII, invalid escape, EOF, ...), these are left for the scanner.
+ *
+ * @param[in] input Input buffer following the opening quote or the part already read.
+ * @param[in,out] tab_count Number of tabs in the string, incremented.
+ * @param[in,out] column Column of the last character read, updated.
+ * @return Number of bytes skipped.
+ */
+int yang_lex_dquoted(const char *input, int *tab_count, int *column);
+
+/**
+ * @brief Skip the plain part of a single-quoted string at once, same as yang_lex_dquoted().
+ */
+int yang_lex_squoted(const char *input, int *column);
+
+/**
+ * @brief Skip the plain ASCII part of a comment at once, the end of a block comment
+ * or the newline ending a line comment is left for the scanner, same as yang_lex_dquoted().
+ */
+int yang_lex_comment(const char *input, int block, int *column);
+
 int yang_read_common(struct lys_module *module,char *value, enum yytokentype type);
 
 int yang_read_prefix(struct lys_module *module, struct lys_import *imp, char *value);
@@ -1753,6 +1753,11 @@ static const flex_int16_t yy_chk[4864] =
 #define YY_USER_ACTION yylloc->first_column = yylloc->last_column +1;\
                        yylloc->last_column = yylloc->first_column + yyleng - 1;
 
+/* the plain part of comments and strings is skipped by a loop instead of a rule match per character,
+ * the loop reads the buffer directly so the character replaced by the yytext terminating zero is put back
+ * first, the skipped bytes are then added to the current token */
+#define YANG_LEX_SKIP(SKIP) do { *yy_cp = yyg->yy_hold_char; i = (SKIP); yyless(yyleng + i); } while (0)
+
 #define INITIAL 0
 #define COMMENT1 1
 #define COMMENT2 2
@@ -2104,7 +2109,7 @@ do_action:	/* This label is used only to access EOF actions. */
 
 case 1:
 YY_RULE_SETUP
-{_state = YY_START; BEGIN COMMENT1; }
+{_state = YY_START; BEGIN COMMENT1; YANG_LEX_SKIP(yang_lex_comment(yytext + yyleng, 1, &yylloc->last_column)); }
 	YY_BREAK
 case 2:
 YY_RULE_SETUP
@@ -2121,7 +2126,7 @@ YY_RULE_SETUP
 	YY_BREAK
 case 5:
 YY_RULE_SETUP
-{_state = YY_START; BEGIN COMMENT2;}
+{_state = YY_START; BEGIN COMMENT2; YANG_LEX_SKIP(yang_lex_comment(yytext + yyleng, 0, &yylloc->last_column)); }
 	YY_BREAK
 case 6:
 /* rule 6 can match eol */
@@ -2461,7 +2466,8 @@ YY_RULE_SETUP
 	YY_BREAK
 case 92:
 YY_RULE_SETUP
-{_state = YY_START; BEGIN DOUBLEQUOTES; str = yytext; column = yylloc->first_column; }
+{_state = YY_START; BEGIN DOUBLEQUOTES; str = yytext; column = yylloc->first_column;
+    YANG_LEX_SKIP(yang_lex_dquoted(yytext + yyleng, &tab_count, &yylloc->last_column)); size_str = i; }
 	YY_BREAK
 case 93:
 YY_RULE_SETUP
@@ -2535,6 +2541,8 @@ YY_RULE_SETUP
                     BEGIN SINGLEQUOTES;
                     str = yytext;
                     column = yylloc->first_column;
+                    YANG_LEX_SKIP(yang_lex_squoted(yytext + yyleng, &yylloc->last_column));
+                    size_str = i;
                   }
 	YY_BREAK
 case 101:
@@ -2600,15 +2608,16 @@ YY_RULE_SETUP
 	YY_BREAK
 case 119:
 YY_RULE_SETUP
-{_state = YY_START; BEGIN DOUBLEQUOTES; str = yytext; column = yylloc->first_column; }
+{_state = YY_START; BEGIN DOUBLEQUOTES; str = yytext; column = yylloc->first_column;
+    YANG_LEX_SKIP(yang_lex_dquoted(yytext + yyleng, &tab_count, &yylloc->last_column)); size_str = i; }
 	YY_BREAK
 case 120:
 YY_RULE_SETUP
-{_state = YY_START; BEGIN COMMENT2;}
+{_state = YY_START; BEGIN COMMENT2; YANG_LEX_SKIP(yang_lex_comment(yytext + yyleng, 0, &yylloc->last_column)); }
 	YY_BREAK
 case 121:
 YY_RULE_SETUP
-{_state = YY_START; BEGIN COMMENT1;}
+{_state = YY_START; BEGIN COMMENT1; YANG_LEX_SKIP(yang_lex_comment(yytext + yyleng, 1, &yylloc->last_column)); }
 	YY_BREAK
 case 122:
 YY_RULE_SETUP
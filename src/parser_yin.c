@@ -773,7 +773,7 @@ fill_yin_type(struct lys_module *module, struct lys_node *parent, struct lyxml_e
                     for (j = 0; j < type->info.bits.bit[i].ext_size; ++j) {
                         /* set flag, which represent LYEXT_OPT_VALID */
                         if (type->info.bits.bit[i].ext[j]->flags & LYEXT_OPT_VALID) {
-                            type->parent->flags |= LYS_VALID_EXT;
+                            type->parent->flags |= LYS_VALID_EXT | LYS_VALID_EXT_TYPE;
                             break;
                         }
                     }
@@ -877,7 +877,7 @@ fill_yin_type(struct lys_module *module, struct lys_node *parent, struct lyxml_e
                 for (j = 0; j < type->info.dec64.range->ext_size; ++j) {
                     /* set flag, which represent LYEXT_OPT_VALID */
                     if (type->info.dec64.range->ext[j]->flags & LYEXT_OPT_VALID) {
-                        type->parent->flags |= LYS_VALID_EXT;
+                        type->parent->flags |= LYS_VALID_EXT | LYS_VALID_EXT_TYPE;
                         break;
                     }
                 }
@@ -1083,7 +1083,7 @@ fill_yin_type(struct lys_module *module, struct lys_node *parent, struct lyxml_e
                     for (j = 0; j < type->info.enums.enm[i].ext_size; ++j) {
                         /* set flag, which represent LYEXT_OPT_VALID */
                         if (type->info.enums.enm[i].ext[j]->flags & LYEXT_OPT_VALID) {
-                            type->parent->flags |= LYS_VALID_EXT;
+                            type->parent->flags |= LYS_VALID_EXT | LYS_VALID_EXT_TYPE;
                             break;
                         }
                     }
@@ -1282,7 +1282,7 @@ fill_yin_type(struct lys_module *module, struct lys_node *parent, struct lyxml_e
                 for (j = 0; j < (*restrs)->ext_size; ++j) {
                     /* set flag, which represent LYEXT_OPT_VALID */
                     if ((*restrs)->ext[j]->flags & LYEXT_OPT_VALID) {
-                        type->parent->flags |= LYS_VALID_EXT;
+                        type->parent->flags |= LYS_VALID_EXT | LYS_VALID_EXT_TYPE;
                         break;
                     }
                 }
@@ -1410,7 +1410,7 @@ fill_yin_type(struct lys_module *module, struct lys_node *parent, struct lyxml_e
                 for (j = 0; j < type->info.str.length->ext_size; ++j) {
                     /* set flag, which represent LYEXT_OPT_VALID */
                     if (type->info.str.length->ext[j]->flags & LYEXT_OPT_VALID) {
-                        type->parent->flags |= LYS_VALID_EXT;
+                        type->parent->flags |= LYS_VALID_EXT | LYS_VALID_EXT_TYPE;
                         break;
                     }
                 }
@@ -1449,7 +1449,7 @@ fill_yin_type(struct lys_module *module, struct lys_node *parent, struct lyxml_e
 #ifdef LY_ENABLED_CACHE
                 else {
                     /* outside grouping, check syntax and precompile pattern for later use by libpcre */
-                    if (lyp_precompile_pattern(ctx, value,
+                    if (lyp_pattern_cache_get(ctx, value,
                             (pcre **)&type->info.str.patterns_pcre[type->info.str.pat_count * 2],
                             (pcre_extra **)&type->info.str.patterns_pcre[type->info.str.pat_count * 2 + 1])) {
                         goto error;
@@ -1503,7 +1503,7 @@ fill_yin_type(struct lys_module *module, struct lys_node *parent, struct lyxml_e
                 for (j = 0; j < restr->ext_size; ++j) {
                     /* set flag, which represent LYEXT_OPT_VALID */
                     if (restr->ext[j]->flags & LYEXT_OPT_VALID) {
-                        type->parent->flags |= LYS_VALID_EXT;
+                        type->parent->flags |= LYS_VALID_EXT | LYS_VALID_EXT_TYPE;
                         break;
                     }
                 }
@@ -1609,7 +1609,7 @@ fill_yin_type(struct lys_module *module, struct lys_node *parent, struct lyxml_e
     for(j = 0; j < type->ext_size; ++j) {
         /* set flag, which represent LYEXT_OPT_VALID */
         if (type->ext[j]->flags & LYEXT_OPT_VALID) {
-            type->parent->flags |= LYS_VALID_EXT;
+            type->parent->flags |= LYS_VALID_EXT | LYS_VALID_EXT_TYPE;
             break;
         }
     }
@@ -1618,7 +1618,7 @@ fill_yin_type(struct lys_module *module, struct lys_node *parent, struct lyxml_e
     dertype = &type->der->type;
     while (dertype->der) {
         if (dertype->parent->flags & LYS_VALID_EXT) {
-            type->parent->flags |= LYS_VALID_EXT;
+            type->parent->flags |= LYS_VALID_EXT | LYS_VALID_EXT_TYPE;
         }
         dertype = &dertype->der->type;
     }
@@ -6579,19 +6579,136 @@ error:
     return NULL;
 }
 
+/* top-level (sub)module statement processed after the header statements */
+struct yin_stmt {
+    LY_STMT type;               /* LY_STMT_UNKNOWN for extension instances, LY_STMT_NODE for data definitions */
+    const char *start;          /* start of the statement in the streamed input */
+    struct lyxml_elem *elem;    /* the statement, NULL until read from the streamed input */
+};
+
+struct yin_stmts {
+    struct yin_stmt *stmt;
+    uint32_t count;
+    uint32_t size;
+};
+
+/* read the whole statement if only its start tag was read from the streamed input */
+static int
+yin_whole_stmt(struct lyxml_reader *reader, struct lyxml_elem **child, const char *start)
+{
+    if (reader) {
+        lyxml_free(reader->ctx, *child);
+        *child = lyxml_reader_read(reader, start);
+        if (!*child) {
+            return EXIT_FAILURE;
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+/* remember a statement to be processed later, only where it starts if streamed */
+static int
+yin_add_stmt(struct ly_ctx *ctx, struct yin_stmts *stmts, LY_STMT type, struct lyxml_reader *reader,
+             struct lyxml_elem *child, const char *start)
+{
+    struct yin_stmt *reallocated;
+
+    if (stmts->count == stmts->size) {
+        reallocated = realloc(stmts->stmt, (stmts->size ? stmts->size * 2 : 16) * sizeof *stmts->stmt);
+        LY_CHECK_ERR_RETURN(!reallocated, LOGMEM(ctx), EXIT_FAILURE);
+        stmts->stmt = reallocated;
+        stmts->size = stmts->size ? stmts->size * 2 : 16;
+    }
+
+    stmts->stmt[stmts->count].type = type;
+    stmts->stmt[stmts->count].start = start;
+    if (reader) {
+        /* only the start tag was read */
+        lyxml_free(ctx, child);
+        stmts->stmt[stmts->count].elem = NULL;
+    } else {
+        stmts->stmt[stmts->count].elem = child;
+    }
+    ++stmts->count;
+
+    return EXIT_SUCCESS;
+}
+
+/* get a remembered statement, logs directly */
+static struct lyxml_elem *
+yin_read_stmt(struct lyxml_reader *reader, struct yin_stmt *stmt)
+{
+    if (!stmt->elem) {
+        stmt->elem = lyxml_reader_read(reader, stmt->start);
+    }
+    return stmt->elem;
+}
+
+/* free a processed statement */
+static void
+yin_free_stmt(struct ly_ctx *ctx, struct yin_stmt *stmt)
+{
+    lyxml_free(ctx, stmt->elem);
+    stmt->elem = NULL;
+}
+
+/* logs directly
+ *
+ * announce all the imports and includes of a (sub)module to the prefetch callback
+ */
+static int
+yin_prefetch_imports(struct ly_ctx *ctx, struct lyxml_reader *reader, struct yin_stmts *stmts, int count)
+{
+    struct lyxml_elem *child, *sub;
+    const char **names, **revs;
+    uint32_t i;
+    int u = 0;
+
+    names = malloc(2 * count * sizeof *names);
+    LY_CHECK_ERR_RETURN(!names, LOGMEM(ctx), EXIT_FAILURE);
+    revs = names + count;
+
+    for (i = 0; (i < stmts->count) && (u < count); ++i) {
+        if ((stmts->stmt[i].type != LY_STMT_IMPORT) && (stmts->stmt[i].type != LY_STMT_INCLUDE)) {
+            continue;
+        }
+        /* they are kept read for processing */
+        child = yin_read_stmt(reader, &stmts->stmt[i]);
+        if (!child) {
+            free(names);
+            return EXIT_FAILURE;
+        }
+        names[u] = lyxml_get_attr(child, "module", NULL);
+        revs[u] = NULL;
+        LY_TREE_FOR(child->child, sub) {
+            if (!strcmp(sub->name, "revision-date")) {
+                revs[u] = lyxml_get_attr(sub, "date", NULL);
+            }
+        }
+        ++u;
+    }
+
+    ly_ctx_prefetch_clb(ctx, names, revs, u);
+    free(names);
+    return EXIT_SUCCESS;
+}
+
 /* logs directly
  *
- * common code for yin_read_module() and yin_read_submodule()
+ * common code for yin_read_module() and yin_read_submodule(), the (sub)module children are either in the XML tree
+ * or read by reader one by one, so that only a single top-level statement of the input is ever built
  */
 static int
 read_sub_module(struct lys_module *module, struct lys_submodule *submodule, struct lyxml_elem *yin,
-                struct unres_schema *unres)
+                struct lyxml_reader *reader, struct unres_schema *unres)
 {
     struct ly_ctx *ctx = module->ctx;
-    struct lyxml_elem *next, *child, root, grps, augs, revs, exts;
+    struct lyxml_elem *next, *child;
+    struct yin_stmts stmts = {NULL, 0, 0};
     struct lys_node *node = NULL;
     struct lys_module *trg;
-    const char *value;
+    const char *value, *start = NULL;
+    uint32_t u;
     int i, r, ret = -1;
     int version_flag = 0;
     /* (sub)module substatements are ordered in groups, increment this value when moving to another group
@@ -6607,36 +6724,51 @@ read_sub_module(struct lys_module *module, struct lys_submodule *submodule, stru
     /* to simplify code, store the module/submodule being processed as trg */
     trg = submodule ? (struct lys_module *)submodule : module;
 
-    /* init */
-    memset(&root, 0, sizeof root);
-    memset(&grps, 0, sizeof grps);
-    memset(&augs, 0, sizeof augs);
-    memset(&exts, 0, sizeof exts);
-    memset(&revs, 0, sizeof revs);
-
     /*
      * in the first run, we process elements with cardinality of 1 or 0..1 and
-     * count elements with cardinality 0..n. Data elements (choices, containers,
-     * leafs, lists, leaf-lists) are moved aside to be processed last, since we
+     * count elements with cardinality 0..n. The others are remembered in their
+     * order to be processed later. Data elements (choices, containers,
+     * leafs, lists, leaf-lists) are processed last, since we
      * need have all top-level and groupings already prepared at that time. In
      * the middle loop, we process other elements with carinality of 0..n since
-     * we need to allocate arrays to store them.
+     * we need to allocate arrays to store them. When streamed, only the start
+     * tags of the remembered elements are read in the first run.
      */
     substmt_group = 0;
     substmt_prev = NULL;
-    LY_TREE_FOR_SAFE(yin->child, next, child) {
+    next = yin->child;
+    while (1) {
+        if (reader) {
+            if (lyxml_reader_next(reader, &child, &start)) {
+                goto error;
+            }
+        } else {
+            child = next;
+            next = child ? child->next : NULL;
+        }
+        if (!child) {
+            break;
+        }
+
         if (!child->ns) {
-            /* garbage */
+            /* garbage, still checked */
+            if (yin_whole_stmt(reader, &child, start)) {
+                goto error;
+            }
             lyxml_free(ctx, child);
             continue;
         } else if (strcmp(child->ns->value, LY_NSYIN)) {
             /* possible extension instance */
             YIN_CHECK_ARRAY_OVERFLOW_GOTO(ctx, c_extinst, trg->ext_size, "extension instances",
                                           submodule ? "submodule" : "module", error);
-            lyxml_unlink_elem(ctx, child, 2);
-            lyxml_add_child(ctx, &exts, child);
+            if (yin_add_stmt(ctx, &stmts, LY_STMT_UNKNOWN, reader, child, start)) {
+                goto error;
+            }
             c_extinst++;
         } else if (!submodule && !strcmp(child->name, "namespace")) {
+            if (yin_whole_stmt(reader, &child, start)) {
+                goto error;
+            }
             if (substmt_group > 0) {
                 LOGVAL(ctx, LYE_INSTMT, LY_VLOG_NONE, NULL, child->name);
                 LOGVAL(ctx, LYE_SPEC, LY_VLOG_NONE, NULL, "Statement \"%s\" cannot appear after \"%s\" statement.",
@@ -6658,6 +6790,9 @@ read_sub_module(struct lys_module *module, struct lys_submodule *submodule, stru
 
             substmt_prev = "namespace";
         } else if (!submodule && !strcmp(child->name, "prefix")) {
+            if (yin_whole_stmt(reader, &child, start)) {
+                goto error;
+            }
             if (substmt_group > 0) {
                 LOGVAL(ctx, LYE_INSTMT, LY_VLOG_NONE, NULL, child->name);
                 LOGVAL(ctx, LYE_SPEC, LY_VLOG_NONE, NULL, "Statement \"%s\" cannot appear after \"%s\" statement.",
@@ -6682,6 +6817,9 @@ read_sub_module(struct lys_module *module, struct lys_submodule *submodule, stru
 
             substmt_prev = "prefix";
         } else if (submodule && !strcmp(child->name, "belongs-to")) {
+            if (yin_whole_stmt(reader, &child, start)) {
+                goto error;
+            }
             if (substmt_group > 0) {
                 LOGVAL(ctx, LYE_INSTMT, LY_VLOG_NONE, NULL, child->name);
                 LOGVAL(ctx, LYE_SPEC, LY_VLOG_NONE, NULL, "Statement \"%s\" cannot appear after \"%s\" statement.",
@@ -6744,6 +6882,9 @@ read_sub_module(struct lys_module *module, struct lys_submodule *submodule, stru
             substmt_group = 1;
             YIN_CHECK_ARRAY_OVERFLOW_GOTO(ctx, c_imp, trg->imp_size, "imports",
                                           submodule ? "submodule" : "module", error);
+            if (yin_add_stmt(ctx, &stmts, LY_STMT_IMPORT, reader, child, start)) {
+                goto error;
+            }
             c_imp++;
 
             substmt_prev = "import";
@@ -6757,16 +6898,19 @@ read_sub_module(struct lys_module *module, struct lys_submodule *submodule, stru
             substmt_group = 3;
             YIN_CHECK_ARRAY_OVERFLOW_GOTO(ctx, c_rev, trg->rev_size, "revisions",
                                           submodule ? "submodule" : "module", error);
+            if (yin_add_stmt(ctx, &stmts, LY_STMT_REVISION, reader, child, start)) {
+                goto error;
+            }
             c_rev++;
 
-            lyxml_unlink_elem(ctx, child, 2);
-            lyxml_add_child(ctx, &revs, child);
-
             substmt_prev = "revision";
         } else if (!strcmp(child->name, "typedef")) {
             substmt_group = 4;
             YIN_CHECK_ARRAY_OVERFLOW_GOTO(ctx, c_tpdf, trg->tpdf_size, "typedefs",
                                           submodule ? "submodule" : "module", error);
+            if (yin_add_stmt(ctx, &stmts, LY_STMT_TYPEDEF, reader, child, start)) {
+                goto error;
+            }
             c_tpdf++;
 
             substmt_prev = "typedef";
@@ -6774,6 +6918,9 @@ read_sub_module(struct lys_module *module, struct lys_submodule *submodule, stru
             substmt_group = 4;
             YIN_CHECK_ARRAY_OVERFLOW_GOTO(ctx, c_ident, trg->ident_size, "identities",
                                           submodule ? "submodule" : "module", error);
+            if (yin_add_stmt(ctx, &stmts, LY_STMT_IDENTITY, reader, child, start)) {
+                goto error;
+            }
             c_ident++;
 
             substmt_prev = "identity";
@@ -6787,6 +6934,9 @@ read_sub_module(struct lys_module *module, struct lys_submodule *submodule, stru
             substmt_group = 1;
             YIN_CHECK_ARRAY_OVERFLOW_GOTO(ctx, c_inc, trg->inc_size, "includes",
                                           submodule ? "submodule" : "module", error);
+            if (yin_add_stmt(ctx, &stmts, LY_STMT_INCLUDE, reader, child, start)) {
+                goto error;
+            }
             c_inc++;
 
             substmt_prev = "include";
@@ -6794,16 +6944,20 @@ read_sub_module(struct lys_module *module, struct lys_submodule *submodule, stru
             substmt_group = 4;
             YIN_CHECK_ARRAY_OVERFLOW_GOTO(ctx, c_aug, trg->augment_size, "augments",
                                           submodule ? "submodule" : "module", error);
+            /* augments are processed last */
+            if (yin_add_stmt(ctx, &stmts, LY_STMT_AUGMENT, reader, child, start)) {
+                goto error;
+            }
             c_aug++;
-            /* keep augments separated, processed last */
-            lyxml_unlink_elem(ctx, child, 2);
-            lyxml_add_child(ctx, &augs, child);
 
             substmt_prev = "augment";
         } else if (!strcmp(child->name, "feature")) {
             substmt_group = 4;
             YIN_CHECK_ARRAY_OVERFLOW_GOTO(ctx, c_ftrs, trg->features_size, "features",
                                           submodule ? "submodule" : "module", error);
+            if (yin_add_stmt(ctx, &stmts, LY_STMT_FEATURE, reader, child, start)) {
+                goto error;
+            }
             c_ftrs++;
 
             substmt_prev = "feature";
@@ -6821,20 +6975,25 @@ read_sub_module(struct lys_module *module, struct lys_submodule *submodule, stru
                 !strcmp(child->name, "notification")) {
             substmt_group = 4;
 
-            lyxml_unlink_elem(ctx, child, 2);
-            lyxml_add_child(ctx, &root, child);
+            if (yin_add_stmt(ctx, &stmts, LY_STMT_NODE, reader, child, start)) {
+                goto error;
+            }
 
             substmt_prev = "data definition";
         } else if (!strcmp(child->name, "grouping")) {
             substmt_group = 4;
 
-            /* keep groupings separated and process them before other data statements */
-            lyxml_unlink_elem(ctx, child, 2);
-            lyxml_add_child(ctx, &grps, child);
+            /* groupings are processed before other data statements */
+            if (yin_add_stmt(ctx, &stmts, LY_STMT_GROUPING, reader, child, start)) {
+                goto error;
+            }
 
             substmt_prev = "grouping";
             /* optional statements */
         } else if (!strcmp(child->name, "description")) {
+            if (yin_whole_stmt(reader, &child, start)) {
+                goto error;
+            }
             if (substmt_group > 2) {
                 LOGVAL(ctx, LYE_INSTMT, LY_VLOG_NONE, NULL, child->name);
                 LOGVAL(ctx, LYE_SPEC, LY_VLOG_NONE, NULL, "Statement \"%s\" cannot appear after \"%s\" statement.",
@@ -6858,6 +7017,9 @@ read_sub_module(struct lys_module *module, struct lys_submodule *submodule, stru
 
             substmt_prev = "description";
         } else if (!strcmp(child->name, "reference")) {
+            if (yin_whole_stmt(reader, &child, start)) {
+                goto error;
+            }
             if (substmt_group > 2) {
                 LOGVAL(ctx, LYE_INSTMT, LY_VLOG_NONE, NULL, child->name);
                 LOGVAL(ctx, LYE_SPEC, LY_VLOG_NONE, NULL, "Statement \"%s\" cannot appear after \"%s\" statement.",
@@ -6881,6 +7043,9 @@ read_sub_module(struct lys_module *module, struct lys_submodule *submodule, stru
 
             substmt_prev = "reference";
         } else if (!strcmp(child->name, "organization")) {
+            if (yin_whole_stmt(reader, &child, start)) {
+                goto error;
+            }
             if (substmt_group > 2) {
                 LOGVAL(ctx, LYE_INSTMT, LY_VLOG_NONE, NULL, child->name);
                 LOGVAL(ctx, LYE_SPEC, LY_VLOG_NONE, NULL, "Statement \"%s\" cannot appear after \"%s\" statement.",
@@ -6904,6 +7069,9 @@ read_sub_module(struct lys_module *module, struct lys_submodule *submodule, stru
 
             substmt_prev = "organization";
         } else if (!strcmp(child->name, "contact")) {
+            if (yin_whole_stmt(reader, &child, start)) {
+                goto error;
+            }
             if (substmt_group > 2) {
                 LOGVAL(ctx, LYE_INSTMT, LY_VLOG_NONE, NULL, child->name);
                 LOGVAL(ctx, LYE_SPEC, LY_VLOG_NONE, NULL, "Statement \"%s\" cannot appear after \"%s\" statement.",
@@ -6927,6 +7095,9 @@ read_sub_module(struct lys_module *module, struct lys_submodule *submodule, stru
 
             substmt_prev = "contact";
         } else if (!strcmp(child->name, "yang-version")) {
+            if (yin_whole_stmt(reader, &child, start)) {
+                goto error;
+            }
             if (substmt_group > 0) {
                 LOGVAL(ctx, LYE_INSTMT, LY_VLOG_NONE, NULL, child->name);
                 LOGVAL(ctx, LYE_SPEC, LY_VLOG_NONE, NULL, "Statement \"%s\" cannot appear after \"%s\" statement.",
@@ -6976,6 +7147,9 @@ read_sub_module(struct lys_module *module, struct lys_submodule *submodule, stru
             substmt_group = 4;
             YIN_CHECK_ARRAY_OVERFLOW_GOTO(ctx, c_ext, trg->extensions_size, "extensions",
                                           submodule ? "submodule" : "module", error);
+            if (yin_add_stmt(ctx, &stmts, LY_STMT_EXTENSION, reader, child, start)) {
+                goto error;
+            }
             c_ext++;
 
             substmt_prev = "extension";
@@ -6983,6 +7157,9 @@ read_sub_module(struct lys_module *module, struct lys_submodule *submodule, stru
             substmt_group = 4;
             YIN_CHECK_ARRAY_OVERFLOW_GOTO(ctx, c_dev, trg->deviation_size, "deviations",
                                           submodule ? "submodule" : "module", error);
+            if (yin_add_stmt(ctx, &stmts, LY_STMT_DEVIATION, reader, child, start)) {
+                goto error;
+            }
             c_dev++;
 
             substmt_prev = "deviation";
@@ -7055,7 +7232,14 @@ read_sub_module(struct lys_module *module, struct lys_submodule *submodule, stru
     }
 
     /* middle part 1 - process revision and then check whether this (sub)module was not already parsed, add it there */
-    LY_TREE_FOR_SAFE(revs.child, next, child) {
+    for (u = 0; u < stmts.count; ++u) {
+        if (stmts.stmt[u].type != LY_STMT_REVISION) {
+            continue;
+        }
+        child = yin_read_stmt(reader, &stmts.stmt[u]);
+        if (!child) {
+            goto error;
+        }
         r = fill_yin_revision(trg, child, &trg->rev[trg->rev_size], unres);
         trg->rev_size++;
         if (r) {
@@ -7070,7 +7254,7 @@ read_sub_module(struct lys_module *module, struct lys_submodule *submodule, stru
             }
         }
 
-        lyxml_free(ctx, child);
+        yin_free_stmt(ctx, &stmts.stmt[u]);
     }
 
     /* check the module with respect to the context now */
@@ -7088,21 +7272,45 @@ read_sub_module(struct lys_module *module, struct lys_submodule *submodule, stru
     }
 
     /* check first definition of extensions */
-    if (c_ext) {
-        LY_TREE_FOR_SAFE(yin->child, next, child) {
-            if (!strcmp(child->name, "extension")) {
-                r = fill_yin_extension(trg, child, &trg->extensions[trg->extensions_size], unres);
-                trg->extensions_size++;
-                if (r) {
-                    goto error;
-                }
-
-            }
+    for (u = 0; c_ext && (u < stmts.count); ++u) {
+        if (stmts.stmt[u].type != LY_STMT_EXTENSION) {
+            continue;
         }
+        child = yin_read_stmt(reader, &stmts.stmt[u]);
+        if (!child) {
+            goto error;
+        }
+        r = fill_yin_extension(trg, child, &trg->extensions[trg->extensions_size], unres);
+        trg->extensions_size++;
+        if (r) {
+            goto error;
+        }
+        yin_free_stmt(ctx, &stmts.stmt[u]);
+    }
+
+    /* let the caller start retrieving all the imports and includes before the first is requested */
+    if (ctx->prefetch_clb && (c_imp || c_inc) && yin_prefetch_imports(ctx, reader, &stmts, c_imp + c_inc)) {
+        goto error;
     }
 
     /* middle part 2 - process nodes with cardinality of 0..n except the data nodes and augments */
-    LY_TREE_FOR_SAFE(yin->child, next, child) {
+    for (u = 0; u < stmts.count; ++u) {
+        switch (stmts.stmt[u].type) {
+        case LY_STMT_IMPORT:
+        case LY_STMT_INCLUDE:
+        case LY_STMT_TYPEDEF:
+        case LY_STMT_IDENTITY:
+        case LY_STMT_FEATURE:
+        case LY_STMT_DEVIATION:
+            break;
+        default:
+            continue;
+        }
+        child = yin_read_stmt(reader, &stmts.stmt[u]);
+        if (!child) {
+            goto error;
+        }
+
         if (!strcmp(child->name, "import")) {
             r = fill_yin_import(trg, child, &trg->imp[trg->imp_size], unres);
             trg->imp_size++;
@@ -7148,6 +7356,7 @@ read_sub_module(struct lys_module *module, struct lys_submodule *submodule, stru
                 goto error;
             }
         }
+        yin_free_stmt(ctx, &stmts.stmt[u]);
     }
 
     /* process extension instances */
@@ -7160,7 +7369,16 @@ read_sub_module(struct lys_module *module, struct lys_submodule *submodule, stru
         /* init memory */
         memset(&trg->ext[trg->ext_size], 0, c_extinst * sizeof *trg->ext);
 
-        LY_TREE_FOR_SAFE(exts.child, next, child) {
+        for (u = 0; u < stmts.count; ++u) {
+            if (stmts.stmt[u].type != LY_STMT_UNKNOWN) {
+                continue;
+            }
+            child = yin_read_stmt(reader, &stmts.stmt[u]);
+            if (!child) {
+                goto error;
+            }
+            /* the element is taken over */
+            stmts.stmt[u].elem = NULL;
             r = lyp_yin_fill_ext(trg, LYEXT_PAR_MODULE, 0, 0, trg, child, &trg->ext, trg->ext_size, unres);
             trg->ext_size++;
             if (r) {
@@ -7173,17 +7391,31 @@ read_sub_module(struct lys_module *module, struct lys_submodule *submodule, stru
      * refer to them. Submodule's data nodes are stored in the
      * main module data tree.
      */
-    LY_TREE_FOR_SAFE(grps.child, next, child) {
+    for (u = 0; u < stmts.count; ++u) {
+        if (stmts.stmt[u].type != LY_STMT_GROUPING) {
+            continue;
+        }
+        child = yin_read_stmt(reader, &stmts.stmt[u]);
+        if (!child) {
+            goto error;
+        }
         node = read_yin_grouping(trg, NULL, child, 0, unres);
         if (!node) {
             goto error;
         }
 
-        lyxml_free(ctx, child);
+        yin_free_stmt(ctx, &stmts.stmt[u]);
     }
 
     /* parse data nodes, ... */
-    LY_TREE_FOR_SAFE(root.child, next, child) {
+    for (u = 0; u < stmts.count; ++u) {
+        if (stmts.stmt[u].type != LY_STMT_NODE) {
+            continue;
+        }
+        child = yin_read_stmt(reader, &stmts.stmt[u]);
+        if (!child) {
+            goto error;
+        }
 
         if (!strcmp(child->name, "container")) {
             node = read_yin_container(trg, NULL, child, 0, unres);
@@ -7210,38 +7442,35 @@ read_sub_module(struct lys_module *module, struct lys_submodule *submodule, stru
             goto error;
         }
 
-        lyxml_free(ctx, child);
+        yin_free_stmt(ctx, &stmts.stmt[u]);
     }
 
     /* ... and finally augments (last, so we can augment our data, for instance) */
-    LY_TREE_FOR_SAFE(augs.child, next, child) {
+    for (u = 0; u < stmts.count; ++u) {
+        if (stmts.stmt[u].type != LY_STMT_AUGMENT) {
+            continue;
+        }
+        child = yin_read_stmt(reader, &stmts.stmt[u]);
+        if (!child) {
+            goto error;
+        }
         r = fill_yin_augment(trg, NULL, child, &trg->augment[trg->augment_size], 0, unres);
         trg->augment_size++;
 
         if (r) {
             goto error;
         }
-        lyxml_free(ctx, child);
+        yin_free_stmt(ctx, &stmts.stmt[u]);
     }
 
+    free(stmts.stmt);
     return 0;
 
 error:
-    while (root.child) {
-        lyxml_free(ctx, root.child);
-    }
-    while (grps.child) {
-        lyxml_free(ctx, grps.child);
-    }
-    while (augs.child) {
-        lyxml_free(ctx, augs.child);
-    }
-    while (revs.child) {
-        lyxml_free(ctx, revs.child);
-    }
-    while (exts.child) {
-        lyxml_free(ctx, exts.child);
+    for (u = 0; u < stmts.count; ++u) {
+        yin_free_stmt(ctx, &stmts.stmt[u]);
     }
+    free(stmts.stmt);
 
     return ret;
 }
@@ -7251,14 +7480,15 @@ struct lys_submodule *
 yin_read_submodule(struct lys_module *module, const char *data, struct unres_schema *unres)
 {
     struct ly_ctx *ctx = module->ctx;
+    struct lyxml_reader reader;
     struct lyxml_elem *yin;
     struct lys_submodule *submodule = NULL;
     const char *value;
 
-    yin = lyxml_parse_mem(ctx, data, LYXML_PARSE_NOMIXEDCONTENT);
-    if (!yin) {
+    if (lyxml_reader_init(ctx, data, LYXML_PARSE_NOMIXEDCONTENT, &reader)) {
         return NULL;
     }
+    yin = reader.root;
 
     /* check root element */
     if (!yin->name || strcmp(yin->name, "submodule")) {
@@ -7287,14 +7517,14 @@ yin_read_submodule(struct lys_module *module, const char *data, struct unres_sch
 
     LOGVRB("Reading submodule \"%s\".", submodule->name);
     /* module cannot be changed in this case and 1 cannot be returned */
-    if (read_sub_module(module, submodule, yin, unres)) {
+    if (read_sub_module(module, submodule, yin, &reader, unres)) {
         goto error;
     }
 
     lyp_sort_revisions((struct lys_module *)submodule);
 
     /* cleanup */
-    lyxml_free(ctx, yin);
+    lyxml_reader_clean(&reader);
     lyp_check_circmod_pop(ctx);
 
     LOGVRB("Submodule \"%s\" successfully parsed.", submodule->name);
@@ -7302,7 +7532,7 @@ yin_read_submodule(struct lys_module *module, const char *data, struct unres_sch
 
 error:
     /* cleanup */
-    lyxml_free(ctx, yin);
+    lyxml_reader_clean(&reader);
     if (!submodule) {
         LOGERR(ctx, ly_errno, "Submodule parsing failed.");
         return NULL;
@@ -7320,7 +7550,8 @@ error:
 
 /* logs directly */
 struct lys_module *
-yin_read_module_(struct ly_ctx *ctx, struct lyxml_elem *yin, const char *revision, int implement)
+yin_read_module_(struct ly_ctx *ctx, struct lyxml_elem *yin, struct lyxml_reader *reader, const char *revision,
+                 int implement)
 {
     struct lys_module *module = NULL;
     struct unres_schema *unres;
@@ -7359,7 +7590,7 @@ yin_read_module_(struct ly_ctx *ctx, struct lyxml_elem *yin, const char *revisio
     }
 
     LOGVRB("Reading module \"%s\".", module->name);
-    ret = read_sub_module(module, NULL, yin, unres);
+    ret = read_sub_module(module, NULL, yin, reader, unres);
     if (ret == -1) {
         goto error;
     }
@@ -7445,18 +7676,17 @@ error:
 struct lys_module *
 yin_read_module(struct ly_ctx *ctx, const char *data, const char *revision, int implement)
 {
-    struct lyxml_elem *yin;
+    struct lyxml_reader reader;
     struct lys_module *result;
 
-    yin = lyxml_parse_mem(ctx, data, LYXML_PARSE_NOMIXEDCONTENT);
-    if (!yin) {
+    if (lyxml_reader_init(ctx, data, LYXML_PARSE_NOMIXEDCONTENT, &reader)) {
         LOGERR(ctx, ly_errno, "Module parsing failed.");
         return NULL;
     }
 
-    result = yin_read_module_(ctx, yin, revision, implement);
+    result = yin_read_module_(ctx, reader.root, &reader, revision, implement);
 
-    lyxml_free(ctx, yin);
+    lyxml_reader_clean(&reader);
 
     return result;
 }
@@ -8150,7 +8380,7 @@ lyp_yin_parse_complex_ext(struct lys_module *mod, struct lys_ext_instance_comple
                 goto error;
             }
 
-            *(struct lys_module **)pp = yin_read_module_(mod->ctx, node, NULL, mod->implemented);
+            *(struct lys_module **)pp = yin_read_module_(mod->ctx, node, NULL, NULL, mod->implemented);
             if (!(*pp)) {
                 goto error;
             }
@@ -8278,7 +8508,7 @@ lyp_yin_parse_complex_ext(struct lys_module *mod, struct lys_ext_instance_comple
             LY_CHECK_ERR_GOTO(!(*(struct lys_restr **)p)->expr, LOGMEM(mod->ctx), error);
             ((char *)(*(struct lys_restr **)p)->expr)[0] = modifier;
             strcpy(&((char *)(*(struct lys_restr **)p)->expr)[1], value);
-            lydict_insert_zc(mod->ctx, (char *)(*(struct lys_restr **)p)->expr);
+            (*(struct lys_restr **)p)->expr = lydict_insert_zc(mod->ctx, (char *)(*(struct lys_restr **)p)->expr);
 
             /* get possible sub-statements */
             if (read_restr_substmt(mod, *(struct lys_restr **)p, node, unres)) {
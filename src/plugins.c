@@ -27,28 +27,80 @@
 #include "common.h"
 #include "extensions.h"
 #include "user_types.h"
+#include "user_xpath.h"
 #include "plugin_config.h"
 #include "libyang.h"
 #include "parser.h"
+#include "hash_table.h"
 
 /* internal structures storing the plugins */
 static struct lyext_plugin_list *ext_plugins = NULL;
 static uint16_t ext_plugins_count = 0; /* size of the ext_plugins array */
 
-static struct lytype_plugin_list *type_plugins = NULL;
-static uint16_t type_plugins_count = 0;
+/* the type plugins are never moved once registered, the typedefs refer to them (see lytype_find_tpdf()) */
+static struct lytype_plugin_block {
+    struct lytype_plugin_list *plugins;
+    uint16_t count;
+} *type_plugins = NULL;
+static uint16_t type_plugins_count = 0; /* number of the blocks in type_plugins */
 
-static struct ly_set dlhandlers = {0, 0, {NULL}};
+static struct lyxp_func_list *xpath_funcs = NULL;
+static uint16_t xpath_funcs_count = 0; /* size of the xpath_funcs array */
+
+static struct ly_set dlhandlers = {0};
 static pthread_mutex_t plugins_lock = PTHREAD_MUTEX_INITIALIZER;
 
 static char **loaded_plugins = NULL; /* both ext and type plugin names */
 static uint16_t loaded_plugins_count = 0;
 
+#ifdef LY_BUILTIN_PLUGINS
+static int builtin_plugins_loaded = 0; /* whether the plugins compiled into the library are registered */
+#endif
+
 /**
  * @brief reference counter for the plugins, it actually counts number of contexts
  */
 static uint32_t plugin_refs;
 
+static void
+lytype_plugins_clean(void)
+{
+    uint16_t u;
+
+    for (u = 0; u < type_plugins_count; ++u) {
+        free(type_plugins[u].plugins);
+    }
+    free(type_plugins);
+    type_plugins = NULL;
+    type_plugins_count = 0;
+}
+
+/**
+ * @brief Add a block of type plugins.
+ *
+ * @param[in] plugins Plugins, the array is kept (and freed) by the block.
+ * @param[in] count Number of \p plugins.
+ * @return 0 on success, -1 on error (\p plugins are freed).
+ */
+static int
+lytype_plugins_add(struct lytype_plugin_list *plugins, uint16_t count)
+{
+    struct lytype_plugin_block *b;
+
+    b = realloc(type_plugins, (type_plugins_count + 1) * sizeof *type_plugins);
+    if (!b) {
+        LOGMEM(NULL);
+        free(plugins);
+        return -1;
+    }
+    type_plugins = b;
+    type_plugins[type_plugins_count].plugins = plugins;
+    type_plugins[type_plugins_count].count = count;
+    ++type_plugins_count;
+
+    return 0;
+}
+
 API const char * const *
 ly_get_loaded_plugins(void)
 {
@@ -75,11 +127,11 @@ ly_clean_plugins(void)
         ext_plugins_count = 0;
     }
 
-    if(type_plugins) {
-        free(type_plugins);
-        type_plugins = NULL;
-        type_plugins_count = 0;
-    }
+    lytype_plugins_clean();
+
+    free(xpath_funcs);
+    xpath_funcs = NULL;
+    xpath_funcs_count = 0;
 
     for (u = 0; u < loaded_plugins_count; ++u) {
         free(loaded_plugins[u]);
@@ -102,7 +154,7 @@ ly_clean_plugins(void)
         goto cleanup;
     }
 
-    if (!ext_plugins_count && !type_plugins_count) {
+    if (!ext_plugins_count && !type_plugins_count && !xpath_funcs_count) {
         /* no plugin loaded - nothing to do */
         goto cleanup;
     }
@@ -112,9 +164,11 @@ ly_clean_plugins(void)
     ext_plugins = NULL;
     ext_plugins_count = 0;
 
-    free(type_plugins);
-    type_plugins = NULL;
-    type_plugins_count = 0;
+    lytype_plugins_clean();
+
+    free(xpath_funcs);
+    xpath_funcs = NULL;
+    xpath_funcs_count = 0;
 
     for (u = 0; u < loaded_plugins_count; ++u) {
         free(loaded_plugins[u]);
@@ -122,15 +176,18 @@ ly_clean_plugins(void)
     free(loaded_plugins);
     loaded_plugins = NULL;
     loaded_plugins_count = 0;
+#ifdef LY_BUILTIN_PLUGINS
+    builtin_plugins_loaded = 0;
+#endif
 
     /* close the dl handlers */
     for (u = 0; u < dlhandlers.number; u++) {
         dlclose(dlhandlers.set.g[u]);
     }
+    ly_set_clean(&dlhandlers);
     free(dlhandlers.set.g);
     dlhandlers.set.g = NULL;
     dlhandlers.size = 0;
-    dlhandlers.number = 0;
 
 cleanup:
     /* unlock the global structures */
@@ -143,8 +200,9 @@ static int
 lytype_load_plugin(void *dlhandler, const char *file_name)
 {
     struct lytype_plugin_list *plugin;
+    struct lyxp_func_list *funcs;
     char *str;
-    int *version;
+    int *version, ret;
 
 #ifdef STATIC
     return 0;
@@ -163,7 +221,23 @@ lytype_load_plugin(void *dlhandler, const char *file_name)
                file_name, LYTYPE_API_VERSION, version ? *version : 0);
         return 1;
     }
-    return ly_register_types(plugin, file_name);
+    if ((ret = ly_register_types(plugin, file_name))) {
+        return ret;
+    }
+
+    /* the type plugin can also define XPath functions */
+    funcs = dlsym(dlhandler, "lyxp_func_list");
+    if (dlerror()) {
+        return 0;
+    }
+    version = dlsym(dlhandler, "lyxp_func_api_version");
+    if (dlerror() || *version != LYXPFUNC_API_VERSION) {
+        LOGWRN(NULL, "Processing \"%s\" XPath functions failed, wrong API version - %d expected, %d found.",
+               file_name, LYXPFUNC_API_VERSION, version ? *version : 0);
+        return 0;
+    }
+    ly_register_xpath_funcs(funcs, file_name);
+    return 0;
 }
 
 API int
@@ -171,36 +245,84 @@ ly_register_types(struct lytype_plugin_list *plugin, const char *log_name)
 {
     FUN_IN;
 
-    struct lytype_plugin_list *p;
-    uint32_t u, v;
+    struct lytype_plugin_list *p, *q;
+    uint32_t u, v, w;
 
     for (u = 0; plugin[u].name; u++) {
         /* check user type implementations for collisions */
         for (v = 0; v < type_plugins_count; v++) {
-            if (!strcmp(plugin[u].name, type_plugins[v].name) &&
-                    !strcmp(plugin[u].module, type_plugins[v].module) &&
-                    (!plugin[u].revision || !type_plugins[v].revision || !strcmp(plugin[u].revision, type_plugins[v].revision))) {
-                LOGERR(NULL, LY_ESYS, "Processing \"%s\" extension plugin failed,"
-                        "implementation collision for extension %s from module %s%s%s.",
-                        log_name, plugin[u].name, plugin[u].module, plugin[u].revision ? "@" : "",
-                        plugin[u].revision ? plugin[u].revision : "");
-                return 1;
+            for (w = 0; w < type_plugins[v].count; w++) {
+                q = &type_plugins[v].plugins[w];
+                if (!strcmp(plugin[u].name, q->name) && !strcmp(plugin[u].module, q->module) &&
+                        (!plugin[u].revision || !q->revision || !strcmp(plugin[u].revision, q->revision))) {
+                    LOGERR(NULL, LY_ESYS, "Processing \"%s\" extension plugin failed,"
+                            "implementation collision for extension %s from module %s%s%s.",
+                            log_name, plugin[u].name, plugin[u].module, plugin[u].revision ? "@" : "",
+                            plugin[u].revision ? plugin[u].revision : "");
+                    return 1;
+                }
             }
         }
+
+        if (!plugin[u].encode_clb != !plugin[u].decode_clb) {
+            LOGERR(NULL, LY_ESYS, "Processing \"%s\" user type plugin failed, type %s from module %s must define both"
+                   " the encode and decode callbacks or none of them.", log_name, plugin[u].name, plugin[u].module);
+            return 1;
+        }
+    }
+    if (!u) {
+        return 0;
     }
 
     /* add the new plugins, we have number of new plugins as u */
-    p = realloc(type_plugins, (type_plugins_count + u) * sizeof *type_plugins);
+    p = malloc(u * sizeof *p);
     if (!p) {
         LOGMEM(NULL);
         return -1;
     }
-    type_plugins = p;
-    for (; u; u--) {
-        memcpy(&type_plugins[type_plugins_count], &plugin[u - 1], sizeof *plugin);
-        type_plugins_count++;
+    memcpy(p, plugin, u * sizeof *p);
+
+    return lytype_plugins_add(p, u);
+}
+
+API int
+ly_register_xpath_funcs(struct lyxp_func_list *funcs, const char *log_name)
+{
+    FUN_IN;
+
+    struct lyxp_func_list *p;
+    uint32_t u, v;
+
+    for (u = 0; funcs[u].name; u++) {
+        /* check XPath function implementations for collisions */
+        for (v = 0; v < xpath_funcs_count; v++) {
+            if (!strcmp(funcs[u].name, xpath_funcs[v].name)) {
+                LOGERR(NULL, LY_ESYS, "Processing \"%s\" XPath functions failed, implementation collision for function %s.",
+                       log_name, funcs[u].name);
+                return 1;
+            }
+        }
+
+        if (!funcs[u].clb || (funcs[u].min_args > funcs[u].max_args) || strchr(funcs[u].name, ':')) {
+            LOGERR(NULL, LY_EINVAL, "Processing \"%s\" XPath functions failed, invalid function %s.", log_name,
+                   funcs[u].name);
+            return 1;
+        }
+    }
+    if (!u) {
+        return 0;
     }
 
+    /* add the new functions, we have number of new functions as u */
+    p = realloc(xpath_funcs, (xpath_funcs_count + u) * sizeof *xpath_funcs);
+    if (!p) {
+        LOGMEM(NULL);
+        return -1;
+    }
+    xpath_funcs = p;
+    memcpy(&xpath_funcs[xpath_funcs_count], funcs, u * sizeof *funcs);
+    xpath_funcs_count += u;
+
     return 0;
 }
 
@@ -305,6 +427,48 @@ ly_add_loaded_plugin(char *name)
     loaded_plugins[loaded_plugins_count] = NULL;
 }
 
+static int
+ly_is_loaded_plugin(const char *name, size_t len)
+{
+    uint16_t u;
+
+    for (u = 0; u < loaded_plugins_count; ++u) {
+        if (!strncmp(loaded_plugins[u], name, len) && !loaded_plugins[u][len]) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+#ifdef LY_BUILTIN_PLUGINS
+
+static void
+ly_load_builtin_plugins(void)
+{
+    char *name;
+    uint16_t u;
+
+    for (u = 0; builtin_ext_plugins[u].name; ++u) {
+        if (!ly_register_exts(builtin_ext_plugins[u].plugins, builtin_ext_plugins[u].name)) {
+            name = strdup(builtin_ext_plugins[u].name);
+            LY_CHECK_ERR_RETURN(!name, LOGMEM(NULL), );
+            ly_add_loaded_plugin(name);
+        }
+    }
+    for (u = 0; builtin_type_plugins[u].name; ++u) {
+        if (!ly_register_types(builtin_type_plugins[u].plugins, builtin_type_plugins[u].name)) {
+            name = strdup(builtin_type_plugins[u].name);
+            LY_CHECK_ERR_RETURN(!name, LOGMEM(NULL), );
+            ly_add_loaded_plugin(name);
+        }
+    }
+
+    builtin_plugins_loaded = 1;
+}
+
+#endif /* LY_BUILTIN_PLUGINS */
+
 static void
 ly_load_plugins_dir(DIR *dir, const char *dir_path, int ext_or_type)
 {
@@ -325,6 +489,10 @@ ly_load_plugins_dir(DIR *dir, const char *dir_path, int ext_or_type)
                 strcmp(&file->d_name[len - LY_PLUGIN_SUFFIX_LEN], LY_PLUGIN_SUFFIX)) {
             continue;
         }
+        if (ly_is_loaded_plugin(file->d_name, len - LY_PLUGIN_SUFFIX_LEN)) {
+            /* a plugin of the same name is already registered (built-in or loaded before), do not even open it */
+            continue;
+        }
 
         /* and construct the filepath */
         if (asprintf(&str, "%s/%s", dir_path, file->d_name) == -1) {
@@ -388,15 +556,27 @@ ly_load_plugins(void)
 {
     FUN_IN;
 
+    ly_load_plugins_int(1);
+}
+
+void
+ly_load_plugins_int(int scan)
+{
     DIR* dir;
     const char *pluginsdir;
 
 #ifdef STATIC
+    struct lytype_plugin_list *p;
+    uint16_t count;
+
     /* lock the extension plugins list */
     pthread_mutex_lock(&plugins_lock);
 
     ext_plugins = static_load_lyext_plugins(&ext_plugins_count);
-    type_plugins = static_load_lytype_plugins(&type_plugins_count);
+    p = static_load_lytype_plugins(&count);
+    if (p) {
+        lytype_plugins_add(p, count);
+    }
 
     int u;
     for (u = 0; u < static_loaded_plugins_count; u++) {
@@ -414,6 +594,16 @@ ly_load_plugins(void)
     /* increase references */
     ++plugin_refs;
 
+#ifdef LY_BUILTIN_PLUGINS
+    if (!builtin_plugins_loaded) {
+        ly_load_builtin_plugins();
+    }
+#endif
+
+    if (!scan) {
+        goto cleanup;
+    }
+
     /* try to get the plugins directory from environment variable */
     pluginsdir = getenv("LIBYANG_EXTENSIONS_PLUGINS_DIR");
     if (!pluginsdir) {
@@ -444,10 +634,25 @@ ly_load_plugins(void)
         closedir(dir);
     }
 
+cleanup:
     /* unlock the global structures */
     pthread_mutex_unlock(&plugins_lock);
 }
 
+const struct lyxp_func_list *
+xpath_get_plugin_func(const char *name, uint16_t len)
+{
+    uint16_t u;
+
+    for (u = 0; u < xpath_funcs_count; u++) {
+        if (!strncmp(name, xpath_funcs[u].name, len) && !xpath_funcs[u].name[len]) {
+            return &xpath_funcs[u];
+        }
+    }
+
+    return NULL;
+}
+
 struct lyext_plugin *
 ext_get_plugin(const char *name, const char *module, const char *revision)
 {
@@ -588,38 +793,53 @@ lys_snode2stmt(LYS_NODE nodetype)
 static struct lytype_plugin_list *
 lytype_find(const char *module, const char *revision, const char *type_name)
 {
-    uint16_t u;
+    struct lytype_plugin_list *p;
+    uint16_t u, v;
 
     for (u = 0; u < type_plugins_count; ++u) {
-        if (ly_strequal(module, type_plugins[u].module, 0) && ((!revision && !type_plugins[u].revision)
-                || (revision && ly_strequal(revision, type_plugins[u].revision, 0)))
-                && ly_strequal(type_name, type_plugins[u].name, 0)) {
-            return &(type_plugins[u]);
+        for (v = 0; v < type_plugins[u].count; ++v) {
+            p = &type_plugins[u].plugins[v];
+            if (ly_strequal(module, p->module, 0) && ((!revision && !p->revision)
+                    || (revision && ly_strequal(revision, p->revision, 0))) && ly_strequal(type_name, p->name, 0)) {
+                return p;
+            }
         }
     }
 
     return NULL;
 }
 
+void
+lytype_tpdf_bind(struct lys_tpdf *tpdf)
+{
+    const struct lys_module *mod = tpdf->module;
+
+    if (mod) {
+        tpdf->plugin = lytype_find(mod->name, mod->rev_size ? mod->rev[0].date : NULL, tpdf->name);
+    }
+}
+
 int
-lytype_store(const struct lys_module *mod, const char *type_name, const char **value_str, lyd_val *value)
+lytype_store(const struct lys_tpdf *tpdf, const char **value_str, lyd_val *value)
 {
-    struct lytype_plugin_list *p;
+    struct lytype_plugin_list *p = tpdf->plugin;
+    struct ly_ctx *ctx;
     char *err_msg = NULL;
 
-    assert(mod && type_name && value_str && value);
+    assert(tpdf && value_str && value);
 
-    p = lytype_find(mod->name, mod->rev_size ? mod->rev[0].date : NULL, type_name);
     if (p) {
-        if (p->store_clb(mod->ctx, type_name, value_str, value, &err_msg)) {
+        ctx = tpdf->module->ctx;
+        if (p->store_clb(ctx, tpdf->name, value_str, value, &err_msg)) {
             if (!err_msg) {
-                if (asprintf(&err_msg, "Failed to store value \"%s\" of user type \"%s\".", *value_str, type_name) == -1) {
-                    LOGMEM(mod->ctx);
+                /* error messages of the plugins are allocated by the C library */
+                if ((asprintf)(&err_msg, "Failed to store value \"%s\" of user type \"%s\".", *value_str, tpdf->name) == -1) {
+                    LOGMEM(ctx);
                     return -1;
                 }
             }
-            LOGERR(mod->ctx, LY_EPLUGIN, err_msg);
-            free(err_msg);
+            LOGERR(ctx, LY_EPLUGIN, err_msg);
+            (free)(err_msg);
             return -1;
         }
 
@@ -670,7 +890,7 @@ lytype_free(const struct lys_type *type, lyd_val value, const char *value_str)
         return;
     }
 
-    p = lytype_find(mod->name, mod->rev_size ? mod->rev[0].date : NULL, type->der->name);
+    p = type->der->plugin;
     if (!p) {
         LOGINT(mod->ctx);
         return;
@@ -680,3 +900,142 @@ lytype_free(const struct lys_type *type, lyd_val value, const char *value_str)
         p->free_clb(value.ptr);
     }
 }
+
+/**
+ * @brief Get the plugin storing values of a type directly, not as a union member or a leafref target.
+ */
+static struct lytype_plugin_list *
+lytype_direct_plugin(const struct lys_type *type)
+{
+    if ((type->base == LY_TYPE_UNION) || (type->base == LY_TYPE_LEAFREF) || !type->der) {
+        return NULL;
+    }
+    return type->der->plugin;
+}
+
+int
+lytype_compare(const struct lys_type *type1, const lyd_val *value1, const struct lys_type *type2, const lyd_val *value2)
+{
+    struct lytype_plugin_list *p1, *p2;
+
+    p1 = lytype_direct_plugin(type1);
+    p2 = lytype_direct_plugin(type2);
+    if (!p1 || !p2 || !p1->compare_clb || (p1->compare_clb != p2->compare_clb)) {
+        return -1;
+    }
+
+    return p1->compare_clb(value1, value2) ? 1 : 0;
+}
+
+int
+lytype_hash(const struct lys_type *type, const lyd_val *value, uint32_t *hash)
+{
+    struct lytype_plugin_list *p;
+    const void *data;
+    size_t len;
+
+    p = lytype_direct_plugin(type);
+    if (!p || !p->hash_clb) {
+        return 1;
+    }
+
+    data = p->hash_clb(value, &len);
+    *hash = dict_hash_multi(*hash, data, len);
+    return 0;
+}
+
+int
+lytype_hash_str(const struct lys_type *type, const char *value_str, size_t len, uint32_t *hash)
+{
+    struct lytype_plugin_list *p;
+    struct ly_ctx *ctx;
+    const char *str;
+    char *err_msg = NULL;
+    lyd_val value;
+    int ret = 1;
+
+    p = lytype_direct_plugin(type);
+    if (!p || !p->hash_clb) {
+        return 1;
+    }
+
+    /* store the value the same way as in a data node */
+    ctx = type->der->module->ctx;
+    str = lydict_insert(ctx, value_str, len);
+    memset(&value, 0, sizeof value);
+    value.string = str;
+    if (!p->store_clb(ctx, type->der->name, &str, &value, &err_msg)) {
+        ret = lytype_hash(type, &value, hash);
+        if (p->free_clb) {
+            p->free_clb(value.ptr);
+        }
+    } else {
+        /* not a valid value, it cannot be found anyway */
+        (free)(err_msg);
+    }
+    lydict_remove(ctx, str);
+
+    return ret;
+}
+
+int
+lytype_can_encode(const struct lys_type *type)
+{
+    struct lytype_plugin_list *p;
+
+    p = lytype_direct_plugin(type);
+    return (p && p->encode_clb) ? 1 : 0;
+}
+
+uint8_t *
+lytype_encode(const struct lys_type *type, const lyd_val *value, uint8_t *buf, size_t size, size_t *len)
+{
+    struct lytype_plugin_list *p;
+    uint8_t *data;
+
+    p = lytype_direct_plugin(type);
+    if (!p || !p->encode_clb) {
+        return NULL;
+    }
+
+    *len = p->encode_clb(value, buf, size);
+    if (!*len) {
+        return NULL;
+    } else if (*len <= size) {
+        return buf;
+    }
+
+    /* the buffer is too small */
+    data = malloc(*len);
+    LY_CHECK_ERR_RETURN(!data, LOGMEM(type->parent->module->ctx), NULL);
+    p->encode_clb(value, data, *len);
+    return data;
+}
+
+int
+lytype_decode(const struct lys_type *type, const void *data, size_t len, const char **value_str, lyd_val *value)
+{
+    struct lytype_plugin_list *p;
+    struct ly_ctx *ctx = type->parent->module->ctx;
+    char *err_msg = NULL;
+
+    p = lytype_direct_plugin(type);
+    if (!p || !p->decode_clb) {
+        LOGERR(ctx, LY_EPLUGIN, "No plugin to decode a value of user type \"%s\".", type->der ? type->der->name : "");
+        return -1;
+    }
+
+    if (p->decode_clb(ctx, type->der->name, data, len, value_str, value, &err_msg)) {
+        if (!err_msg) {
+            if ((asprintf)(&err_msg, "Failed to decode a value of user type \"%s\".", type->der->name) == -1) {
+                LOGMEM(ctx);
+                return -1;
+            }
+        }
+        LOGERR(ctx, LY_EPLUGIN, err_msg);
+        (free)(err_msg);
+        return -1;
+    }
+
+    return 0;
+}
@@ -22,11 +22,16 @@
 #include <errno.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <pthread.h>
+#include <sys/uio.h>
 
 #include "common.h"
+#include "context.h"
 #include "tree_schema.h"
 #include "tree_data.h"
+#include "parser.h"
 #include "printer.h"
+#include "tree_internal.h"
 
 struct ext_substmt_info_s ext_substmt_info[] = {
   {NULL, NULL, 0},                              /**< LYEXT_SUBSTMT_SELF */
@@ -77,65 +82,199 @@ nscmp(const struct lyd_node *node1, const struct lyd_node *node2)
     }
 }
 
+/**
+ * @brief Write data directly into a file descriptor or a callback output.
+ *
+ * @return Number of written bytes, -1 on error.
+ */
+static ssize_t
+ly_write_out(struct lyout *out, const char *buf, size_t count)
+{
+    ssize_t r;
+    size_t written = 0;
+
+    if (!count && (out->type == LYOUT_CALLBACK)) {
+        /* let the callback know about an empty output */
+        r = out->method.clb.f(out->method.clb.arg, buf, 0);
+        if (r >= 0) {
+            errno = 0;
+        }
+        return r;
+    }
+
+    while (written < count) {
+        if (out->type == LYOUT_FD) {
+            r = write(out->method.fd, buf + written, count - written);
+            if ((r < 0) && (errno == EINTR)) {
+                continue;
+            }
+        } else {
+            r = out->method.clb.f(out->method.clb.arg, buf + written, count - written);
+            if (r >= 0) {
+                /*
+                 * Depending on what the callback function does, errno might
+                 * contain non-zero values that are not real "errors" (EAGAIN or
+                 * EINTR). Reset errno if the callback returns a zero or positive
+                 * value.
+                 */
+                errno = 0;
+            }
+        }
+        if (r < 0) {
+            return -1;
+        } else if (!r) {
+            /* nothing more can be written */
+            break;
+        }
+        written += r;
+    }
+
+    return written;
+}
+
+/**
+ * @brief Append data to the output buffer of a file descriptor or a callback output, write the buffer
+ * when full. Data not fitting into an empty buffer are written directly.
+ *
+ * @return \p count on success, -1 on error.
+ */
+static int
+ly_write_buffered(struct lyout *out, const char *buf, size_t count)
+{
+#if !LY_PRINT_BUF_SIZE
+    /* no buffering */
+    return ly_write_out(out, buf, count);
+#else
+    struct iovec iov[2];
+    ssize_t r;
+
+    if (!out->out_buf) {
+        out->out_buf = malloc(LY_PRINT_BUF_SIZE);
+        if (!out->out_buf) {
+            LOGMEM(NULL);
+            return -1;
+        }
+    }
+
+    if (out->out_len + count <= LY_PRINT_BUF_SIZE) {
+        /* fits */
+        memcpy(out->out_buf + out->out_len, buf, count);
+        out->out_len += count;
+        if (!count && !out->out_len && (out->type == LYOUT_CALLBACK)) {
+            return ly_write_out(out, buf, 0);
+        }
+        return count;
+    }
+
+    if (count < LY_PRINT_BUF_SIZE) {
+        /* write the buffer and start filling it again */
+        if (ly_print_flush(out)) {
+            return -1;
+        }
+        memcpy(out->out_buf, buf, count);
+        out->out_len = count;
+        return count;
+    }
+
+    /* large data, write them together with the buffer */
+    if (out->type == LYOUT_FD) {
+        iov[0].iov_base = out->out_buf;
+        iov[0].iov_len = out->out_len;
+        iov[1].iov_base = (void *)buf;
+        iov[1].iov_len = count;
+        do {
+            r = writev(out->method.fd, iov, 2);
+        } while ((r < 0) && (errno == EINTR));
+        if (r < 0) {
+            return -1;
+        }
+
+        /* write whatever remained */
+        if ((size_t)r < out->out_len) {
+            if (ly_write_out(out, out->out_buf + r, out->out_len - r) < 0) {
+                return -1;
+            }
+            r = 0;
+        } else {
+            r -= out->out_len;
+        }
+        out->out_len = 0;
+        if (((size_t)r < count) && (ly_write_out(out, buf + r, count - r) < 0)) {
+            return -1;
+        }
+        return count;
+    }
+
+    if (ly_print_flush(out) || (ly_write_out(out, buf, count) < 0)) {
+        return -1;
+    }
+    return count;
+#endif
+}
+
 int
 ly_print(struct lyout *out, const char *format, ...)
 {
     int count = 0;
-    char *msg = NULL, *aux;
+    char buf[256], *msg = NULL, *aux;
     va_list ap;
-#ifndef HAVE_VDPRINTF
-    FILE *stream;
-#endif
+
+    if (!strchr(format, '%')) {
+        /* literal, nothing to format */
+        return ly_write(out, format, strlen(format));
+    }
 
     va_start(ap, format);
 
     switch (out->type) {
-    case LYOUT_FD:
-#ifdef HAVE_VDPRINTF
-        count = vdprintf(out->method.fd, format, ap);
-#else
-        stream = fdopen(dup(out->method.fd), "a+");
-        if (stream) {
-            count = vfprintf(stream, format, ap);
-            fclose(stream);
-        }
-#endif
-        break;
     case LYOUT_STREAM:
         count = vfprintf(out->method.f, format, ap);
         break;
     case LYOUT_MEMORY:
-        count = vasprintf(&msg, format, ap);
+        /* print directly into the memory, enlarge it if needed */
+        count = vsnprintf(out->method.mem.buf ? &out->method.mem.buf[out->method.mem.len] : NULL,
+                          out->method.mem.size - out->method.mem.len, format, ap);
+        va_end(ap);
+        if (count < 0) {
+            return -1;
+        }
         if (out->method.mem.len + count + 1 > out->method.mem.size) {
-            aux = ly_realloc(out->method.mem.buf, out->method.mem.len + count + 1);
+            aux = ly_realloc(out->method.mem.buf, (out->method.mem.len + count + 1) * 2);
             if (!aux) {
                 out->method.mem.buf = NULL;
                 out->method.mem.len = 0;
                 out->method.mem.size = 0;
                 LOGMEM(NULL);
-                va_end(ap);
                 return -1;
             }
             out->method.mem.buf = aux;
-            out->method.mem.size = out->method.mem.len + count + 1;
+            out->method.mem.size = (out->method.mem.len + count + 1) * 2;
+
+            va_start(ap, format);
+            vsnprintf(&out->method.mem.buf[out->method.mem.len], count + 1, format, ap);
+            va_end(ap);
         }
-        memcpy(&out->method.mem.buf[out->method.mem.len], msg, count);
         out->method.mem.len += count;
-        out->method.mem.buf[out->method.mem.len] = '\0';
-        free(msg);
-        break;
+        return count;
+    case LYOUT_FD:
     case LYOUT_CALLBACK:
+        /* short strings are formatted on stack */
+        count = vsnprintf(buf, sizeof buf, format, ap);
+        if (count < 0) {
+            break;
+        } else if ((unsigned)count < sizeof buf) {
+            count = ly_write(out, buf, count);
+            break;
+        }
+
+        va_end(ap);
+        va_start(ap, format);
         count = vasprintf(&msg, format, ap);
-        count = out->method.clb.f(out->method.clb.arg, msg, count);
-        if (count >= 0) {
-            /*
-             * Depending on what the callback function does, errno might
-             * contain non-zero values that are not real "errors" (EAGAIN or
-             * EINTR). Reset errno if the callback returns a zero or positive
-             * value.
-             */
-            errno = 0;
+        if (count < 0) {
+            LOGMEM(NULL);
+            break;
         }
+        count = ly_write(out, msg, count);
         free(msg);
         break;
     }
@@ -144,7 +283,7 @@ ly_print(struct lyout *out, const char *format, ...)
     return count;
 }
 
-void
+int
 ly_print_flush(struct lyout *out)
 {
     switch (out->type) {
@@ -152,16 +291,46 @@ ly_print_flush(struct lyout *out)
         fflush(out->method.f);
         break;
     case LYOUT_FD:
-    case LYOUT_MEMORY:
     case LYOUT_CALLBACK:
+        if (out->out_len) {
+            if (ly_write_out(out, out->out_buf, out->out_len) < (ssize_t)out->out_len) {
+                out->out_len = 0;
+                return EXIT_FAILURE;
+            }
+            out->out_len = 0;
+        }
+        break;
+    case LYOUT_MEMORY:
         /* nothing to do */
         break;
     }
+
+    return EXIT_SUCCESS;
+}
+
+int
+ly_print_finish(struct lyout *out)
+{
+    int ret;
+
+    ret = ly_print_flush(out);
+    if (ret) {
+        LOGERR(NULL, LY_ESYS, "Print error (%s).", strerror(errno));
+    }
+
+    free(out->out_buf);
+    out->out_buf = NULL;
+    free(out->buffered);
+    out->buffered = NULL;
+
+    return ret;
 }
 
 int
 ly_write(struct lyout *out, const char *buf, size_t count)
 {
+    char *aux;
+
     if (out->hole_count) {
         /* we are buffering data after a hole */
         if (out->buf_len + count > out->buf_size) {
@@ -183,25 +352,27 @@ ly_write(struct lyout *out, const char *buf, size_t count)
     switch (out->type) {
     case LYOUT_MEMORY:
         if (out->method.mem.len + count + 1 > out->method.mem.size) {
-            out->method.mem.buf = ly_realloc(out->method.mem.buf, out->method.mem.len + count + 1);
-            if (!out->method.mem.buf) {
+            /* enlarge the memory geometrically, it is often printed in small fragments */
+            aux = ly_realloc(out->method.mem.buf, (out->method.mem.len + count + 1) * 2);
+            if (!aux) {
+                out->method.mem.buf = NULL;
                 out->method.mem.len = 0;
                 out->method.mem.size = 0;
                 LOGMEM(NULL);
                 return -1;
             }
-            out->method.mem.size = out->method.mem.len + count + 1;
+            out->method.mem.buf = aux;
+            out->method.mem.size = (out->method.mem.len + count + 1) * 2;
         }
         memcpy(&out->method.mem.buf[out->method.mem.len], buf, count);
         out->method.mem.len += count;
         out->method.mem.buf[out->method.mem.len] = '\0';
         return count;
     case LYOUT_FD:
-        return write(out->method.fd, buf, count);
+    case LYOUT_CALLBACK:
+        return ly_write_buffered(out, buf, count);
     case LYOUT_STREAM:
         return fwrite(buf, sizeof *buf, count, out->method.f);
-    case LYOUT_CALLBACK:
-        return out->method.clb.f(out->method.clb.arg, buf, count);
     }
 
     return 0;
@@ -290,6 +461,112 @@ ly_write_skipped(struct lyout *out, size_t position, const char *buf, size_t cou
     return count;
 }
 
+struct ly_print_worker {
+    const struct lyd_node **units;
+    struct lyout *outs;
+    uint32_t count;
+    uint32_t first;
+    uint32_t step;
+    ly_print_unit_clb print_unit;
+    void *arg;
+    void *state;
+    int ret;
+};
+
+static void
+ly_print_worker(void *arg)
+{
+    struct ly_print_worker *w = arg;
+    uint32_t i;
+
+    for (i = w->first; i < w->count; i += w->step) {
+        w->outs[i].type = LYOUT_MEMORY;
+        if (w->print_unit(&w->outs[i], w->units[i], i, w->arg, &w->state)) {
+            w->ret = EXIT_FAILURE;
+            break;
+        }
+    }
+}
+
+int
+ly_print_parallel(struct lyout *out, const struct lyd_node **units, uint32_t count, const char *sep,
+                  ly_print_unit_clb print_unit, void *arg, void (*state_free)(void *state))
+{
+    struct ly_print_worker *workers = NULL;
+    struct lyout *outs = NULL;
+    const struct ly_ctx *ctx = count ? units[0]->schema->module->ctx : NULL;
+    void *state = NULL;
+    uint32_t i, thread_count;
+    int ret = EXIT_SUCCESS;
+
+    thread_count = ly_parallel_count(ctx, count);
+
+    if (thread_count < 2) {
+        /* nothing to parallelize, print directly */
+        for (i = 0; i < count; ++i) {
+            if ((i && sep[0] && (ly_write(out, sep, strlen(sep)) < 0)) || print_unit(out, units[i], i, arg, &state)) {
+                ret = EXIT_FAILURE;
+                break;
+            }
+        }
+        if (state && state_free) {
+            state_free(state);
+        }
+        return ret;
+    }
+
+    outs = calloc(count, sizeof *outs);
+    workers = calloc(thread_count, sizeof *workers);
+    LY_CHECK_ERR_GOTO(!outs || !workers, LOGMEM(NULL); ret = EXIT_FAILURE, cleanup);
+
+    /* the units are distributed round-robin, the calling thread prints its share as the first worker */
+    for (i = 0; i < thread_count; ++i) {
+        workers[i].units = units;
+        workers[i].outs = outs;
+        workers[i].count = count;
+        workers[i].first = i;
+        workers[i].step = thread_count;
+        workers[i].print_unit = print_unit;
+        workers[i].arg = arg;
+    }
+    ly_parallel_run(ctx, ly_print_worker, workers, sizeof *workers, thread_count);
+    for (i = 0; i < thread_count; ++i) {
+        if (workers[i].ret) {
+            ret = EXIT_FAILURE;
+        }
+    }
+    if (ret) {
+        goto cleanup;
+    }
+
+    /* concatenate the buffers in the original order */
+    for (i = 0; i < count; ++i) {
+        if ((i && sep[0] && (ly_write(out, sep, strlen(sep)) < 0))
+                || (outs[i].method.mem.len && (ly_write(out, outs[i].method.mem.buf, outs[i].method.mem.len) < 0))) {
+            ret = EXIT_FAILURE;
+            break;
+        }
+    }
+
+cleanup:
+    if (outs) {
+        for (i = 0; i < count; ++i) {
+            free(outs[i].method.mem.buf);
+            free(outs[i].buffered);
+        }
+    }
+    if (workers && state_free) {
+        for (i = 0; i < thread_count; ++i) {
+            if (workers[i].state) {
+                state_free(workers[i].state);
+            }
+        }
+    }
+    free(outs);
+    free(workers);
+    return ret;
+}
+
 static int
 write_iff(struct lyout *out, const struct lys_module *module, struct lys_iffeature *expr, int prefix_kind,
           int *index_e, int *index_f)
@@ -440,6 +717,7 @@ lys_print_fd(int fd, const struct lys_module *module, LYS_OUTFORMAT format, cons
              int line_length, int options)
 {
     struct lyout out;
+    int r;
 
     if (fd < 0 || !module) {
         LOGARG;
@@ -451,7 +729,135 @@ lys_print_fd(int fd, const struct lys_module *module, LYS_OUTFORMAT format, cons
     out.type = LYOUT_FD;
     out.method.fd = fd;
 
-    return lys_print_(&out, module, format, target_node, line_length, options);
+    r = lys_print_(&out, module, format, target_node, line_length, options);
+
+    if (ly_print_finish(&out)) {
+        r = EXIT_FAILURE;
+    }
+    return r;
+}
+
+/* printed whole module cached in the context, see lys_print_mem() */
+struct lys_print_cache_rec {
+    const struct lys_module *module;
+    LYS_OUTFORMAT format;
+    int line_length;
+    int options;
+    char *buf;
+    size_t len;
+};
+
+static int
+lys_print_cache_equal(void *val1_p, void *val2_p, int UNUSED(mod), void *UNUSED(cb_data))
+{
+    struct lys_print_cache_rec *rec1 = val1_p, *rec2 = val2_p;
+
+    return (rec1->module == rec2->module) && (rec1->format == rec2->format) && (rec1->line_length == rec2->line_length)
+            && (rec1->options == rec2->options);
+}
+
+static uint32_t
+lys_print_cache_hash(const struct lys_print_cache_rec *rec)
+{
+    uint32_t hash;
+
+    hash = dict_hash_multi(0, (const char *)&rec->module, sizeof rec->module);
+    hash = dict_hash_multi(hash, (const char *)&rec->format, sizeof rec->format);
+    hash = dict_hash_multi(hash, (const char *)&rec->line_length, sizeof rec->line_length);
+    hash = dict_hash_multi(hash, (const char *)&rec->options, sizeof rec->options);
+    return dict_hash_multi(hash, NULL, 0);
+}
+
+static void
+lys_print_cache_free(struct hash_table *ht)
+{
+    uint32_t i;
+    struct lys_print_cache_rec *rec;
+
+    if (!ht) {
+        return;
+    }
+
+    lyht_finish_resize(ht);
+    for (i = 0; i < ht->size; ++i) {
+        rec = lyht_get_val(ht, i);
+        if (rec) {
+            free(rec->buf);
+        }
+    }
+    lyht_free(ht);
+}
+
+void
+lys_print_cache_clean(struct ly_ctx *ctx)
+{
+    pthread_mutex_lock(&ctx->print_cache_lock);
+
+    lys_print_cache_free(ctx->print_cache);
+    ctx->print_cache = NULL;
+
+    pthread_mutex_unlock(&ctx->print_cache_lock);
+}
+
+/* get a copy of the cached output, 0 if found, 1 if not */
+static int
+lys_print_cache_get(struct ly_ctx *ctx, struct lys_print_cache_rec *rec, char **strp)
+{
+    struct lys_print_cache_rec *match;
+    int ret = 1;
+
+    pthread_mutex_lock(&ctx->print_cache_lock);
+
+    if (ctx->print_cache && (ctx->print_cache_set_id != ctx->models.module_set_id)) {
+        /* modules changed, the printed ones may be changed (deviated, augmented) or even removed */
+        lys_print_cache_free(ctx->print_cache);
+        ctx->print_cache = NULL;
+    }
+
+    if (ctx->print_cache && !lyht_find(ctx->print_cache, rec, lys_print_cache_hash(rec), (void **)&match)) {
+        *strp = malloc(match->len + 1);
+        if (*strp) {
+            memcpy(*strp, match->buf, match->len + 1);
+            ret = 0;
+        }
+    }
+
+    pthread_mutex_unlock(&ctx->print_cache_lock);
+    return ret;
+}
+
+/* remember a copy of the printed output, nothing happens on failure, it is just printed again next time */
+static void
+lys_print_cache_add(struct ly_ctx *ctx, struct lys_print_cache_rec *rec, const char *buf, size_t len)
+{
+    pthread_mutex_lock(&ctx->print_cache_lock);
+
+    if (!ctx->print_cache) {
+        ctx->print_cache = lyht_new(8, sizeof *rec, lys_print_cache_equal, NULL, 1);
+        if (!ctx->print_cache) {
+            goto cleanup;
+        }
+        ctx->print_cache_set_id = ctx->models.module_set_id;
+    } else if (ctx->print_cache_set_id != ctx->models.module_set_id) {
+        /* printed for another module set */
+        goto cleanup;
+    }
+
+    rec->buf = malloc(len + 1);
+    if (!rec->buf) {
+        goto cleanup;
+    }
+    memcpy(rec->buf, buf, len);
+    rec->buf[len] = '\0';
+    rec->len = len;
+
+    /* with a concurrent print of the same module, another copy may have been added meanwhile */
+    if (lyht_insert(ctx->print_cache, rec, lys_print_cache_hash(rec), NULL)) {
+        free(rec->buf);
+    }
+
+cleanup:
+    pthread_mutex_unlock(&ctx->print_cache_lock);
 }
 
 API int
@@ -459,6 +865,7 @@ lys_print_mem(char **strp, const struct lys_module *module, LYS_OUTFORMAT format
               int line_length, int options)
 {
     struct lyout out;
+    struct lys_print_cache_rec rec;
     int r;
 
     if (!strp || !module) {
@@ -466,12 +873,28 @@ lys_print_mem(char **strp, const struct lys_module *module, LYS_OUTFORMAT format
         return EXIT_FAILURE;
     }
 
+    /* the whole modules are printed repeatedly (served to the clients), so they are cached */
+    if (!target_node) {
+        memset(&rec, 0, sizeof rec);
+        rec.module = module;
+        rec.format = format;
+        rec.line_length = line_length;
+        rec.options = options;
+        if (!lys_print_cache_get(module->ctx, &rec, strp)) {
+            return EXIT_SUCCESS;
+        }
+    }
+
     memset(&out, 0, sizeof out);
 
     out.type = LYOUT_MEMORY;
 
     r = lys_print_(&out, module, format, target_node, line_length, options);
 
+    if (!r && !target_node && out.method.mem.buf) {
+        lys_print_cache_add(module->ctx, &rec, out.method.mem.buf, out.method.mem.len);
+    }
+
     *strp = out.method.mem.buf;
     return r;
 }
@@ -481,6 +904,7 @@ lys_print_clb(ssize_t (*writeclb)(void *arg, const void *buf, size_t count), voi
               LYS_OUTFORMAT format, const char *target_node, int line_length, int options)
 {
     struct lyout out;
+    int r;
 
     if (!writeclb || !module) {
         LOGARG;
@@ -493,7 +917,12 @@ lys_print_clb(ssize_t (*writeclb)(void *arg, const void *buf, size_t count), voi
     out.method.clb.f = writeclb;
     out.method.clb.arg = arg;
 
-    return lys_print_(&out, module, format, target_node, line_length, options);
+    r = lys_print_(&out, module, format, target_node, line_length, options);
+
+    if (ly_print_finish(&out)) {
+        r = EXIT_FAILURE;
+    }
+    return r;
 }
 
 int
@@ -715,17 +1144,28 @@ lys_print_target(struct lyout *out, const struct lys_module *module, const char
 static int
 lyd_print_(struct lyout *out, const struct lyd_node *root, LYD_FORMAT format, int options)
 {
+    int rc;
+
+    ly_phase(LY_TRACE_PRINT, 0, root ? root->schema->module->ctx : NULL);
+
     switch (format) {
     case LYD_XML:
-        return xml_print_data(out, root, options);
+        rc = xml_print_data(out, root, options);
+        break;
     case LYD_JSON:
-        return json_print_data(out, root, options);
+        rc = json_print_data(out, root, options);
+        break;
     case LYD_LYB:
-        return lyb_print_data(out, root, options);
+        rc = lyb_print_data(out, root, options);
+        break;
     default:
         LOGERR(root->schema->module->ctx, LY_EINVAL, "Unknown output format.");
-        return EXIT_FAILURE;
+        rc = EXIT_FAILURE;
+        break;
     }
+
+    ly_phase(LY_TRACE_PRINT, 1, root ? root->schema->module->ctx : NULL);
+    return rc;
 }
 
 API int
@@ -791,7 +1231,9 @@ lyd_print_fd(int fd, const struct lyd_node *root, LYD_FORMAT format, int options
 
     r = lyd_print_(&out, root, format, options);
 
-    free(out.buffered);
+    if (ly_print_finish(&out)) {
+        r = EXIT_FAILURE;
+    }
     return r;
 }
 
@@ -837,10 +1279,401 @@ lyd_print_clb(ssize_t (*writeclb)(void *arg, const void *buf, size_t count), voi
 
     r = lyd_print_(&out, root, format, options);
 
-    free(out.buffered);
+    if (ly_print_finish(&out)) {
+        r = EXIT_FAILURE;
+    }
     return r;
 }
 
+static struct lyd_emitter *
+lyd_emitter_new(struct ly_ctx *ctx, LYD_FORMAT format, int options)
+{
+    struct lyd_emitter *em;
+
+    if (!ctx) {
+        LOGARG;
+        return NULL;
+    }
+    if ((format != LYD_XML) && (format != LYD_JSON)) {
+        LOGERR(ctx, LY_EINVAL, "Only XML and JSON data can be emitted.");
+        return NULL;
+    }
+
+    em = calloc(1, sizeof *em);
+    LY_CHECK_ERR_RETURN(!em, LOGMEM(ctx), NULL);
+    em->size = 8;
+    em->frames = calloc(em->size, sizeof *em->frames);
+    LY_CHECK_ERR_RETURN(!em->frames, LOGMEM(ctx); free(em), NULL);
+
+    em->ctx = ctx;
+    em->format = format;
+    em->options = options;
+    em->depth = 1;
+    em->frames[0].level = (options & LYP_FORMAT) ? 1 : 0;
+
+    return em;
+}
+
+API struct lyd_emitter *
+lyd_emitter_new_mem(char **strp, struct ly_ctx *ctx, LYD_FORMAT format, int options)
+{
+    FUN_IN;
+
+    struct lyd_emitter *em;
+
+    if (!strp) {
+        LOGARG;
+        return NULL;
+    }
+
+    em = lyd_emitter_new(ctx, format, options);
+    if (em) {
+        em->out.type = LYOUT_MEMORY;
+        em->strp = strp;
+    }
+    return em;
+}
+
+API struct lyd_emitter *
+lyd_emitter_new_fd(int fd, struct ly_ctx *ctx, LYD_FORMAT format, int options)
+{
+    FUN_IN;
+
+    struct lyd_emitter *em;
+
+    if (fd < 0) {
+        LOGARG;
+        return NULL;
+    }
+
+    em = lyd_emitter_new(ctx, format, options);
+    if (em) {
+        em->out.type = LYOUT_FD;
+        em->out.method.fd = fd;
+    }
+    return em;
+}
+
+API struct lyd_emitter *
+lyd_emitter_new_clb(ssize_t (*writeclb)(void *arg, const void *buf, size_t count), void *arg, struct ly_ctx *ctx,
+                    LYD_FORMAT format, int options)
+{
+    FUN_IN;
+
+    struct lyd_emitter *em;
+
+    if (!writeclb) {
+        LOGARG;
+        return NULL;
+    }
+
+    em = lyd_emitter_new(ctx, format, options);
+    if (em) {
+        em->out.type = LYOUT_CALLBACK;
+        em->out.method.clb.f = writeclb;
+        em->out.method.clb.arg = arg;
+    }
+    return em;
+}
+
+/**
+ * @brief Find the schema node of a new child of the current emitter frame and check that it can be emitted there.
+ */
+static const struct lys_node *
+lyd_emit_schema(struct lyd_emitter *em, const struct lys_module *module, const char *name, LYS_NODE type)
+{
+    struct lyd_emit_frame *frame = &em->frames[em->depth - 1];
+    const struct lys_node *snode = NULL;
+    const struct lys_node_list *slist;
+
+    if (em->error) {
+        LOGERR(em->ctx, LY_EINVAL, "Emitter output failed, no more data can be emitted.");
+        return NULL;
+    }
+    if ((!frame->schema && !module) || !name) {
+        LOGARG;
+        return NULL;
+    }
+
+    if (lys_getnext_data(module, frame->schema, name, strlen(name), type, 0, &snode) || !snode) {
+        if (frame->schema) {
+            LOGERR(em->ctx, LY_EINVAL, "Failed to find \"%s\" as a child of \"%s:%s\".",
+                   name, lys_node_module(frame->schema)->name, frame->schema->name);
+        } else {
+            LOGERR(em->ctx, LY_EINVAL, "Failed to find \"%s\" as a top-level node of \"%s\".", name, module->name);
+        }
+        return NULL;
+    }
+
+    if (frame->schema && (frame->schema->nodetype == LYS_LIST)) {
+        slist = (struct lys_node_list *)frame->schema;
+        if (frame->keys < slist->keys_size) {
+            if (snode != (struct lys_node *)slist->keys[frame->keys]) {
+                LOGERR(em->ctx, LY_EINVAL, "List \"%s\" key \"%s\" must be emitted before \"%s\".",
+                       slist->name, slist->keys[frame->keys]->name, snode->name);
+                return NULL;
+            }
+            return snode;
+        }
+    }
+
+    if (snode == frame->last) {
+        if (!(snode->nodetype & (LYS_LIST | LYS_LEAFLIST))) {
+            LOGERR(em->ctx, LY_EINVAL, "Duplicate instance of \"%s\".", snode->name);
+            return NULL;
+        }
+    } else if (frame->done && (ly_set_contains(frame->done, (void *)snode) > -1)) {
+        if (snode->nodetype & (LYS_LIST | LYS_LEAFLIST)) {
+            LOGERR(em->ctx, LY_EINVAL, "Instances of \"%s\" must be emitted one after another.", snode->name);
+        } else {
+            LOGERR(em->ctx, LY_EINVAL, "Duplicate instance of \"%s\".", snode->name);
+        }
+        return NULL;
+    }
+
+    return snode;
+}
+
+/**
+ * @brief Print a new child of the current emitter frame and remember it there.
+ */
+static int
+lyd_emit_node(struct lyd_emitter *em, const struct lys_node *snode, const struct lyd_node_leaf_list *leaf)
+{
+    struct lyd_emit_frame *frame = &em->frames[em->depth - 1];
+    int r;
+
+    if (em->format == LYD_XML) {
+        r = xml_emit_node(em, snode, leaf);
+    } else {
+        r = json_emit_node(em, snode, leaf);
+    }
+    if (r) {
+        em->error = 1;
+        return EXIT_FAILURE;
+    }
+
+    if (frame->schema && (frame->schema->nodetype == LYS_LIST)
+            && (frame->keys < ((struct lys_node_list *)frame->schema)->keys_size)) {
+        ++frame->keys;
+    }
+    if (frame->last != snode) {
+        if (frame->last) {
+            if (!frame->done) {
+                frame->done = ly_set_new();
+                LY_CHECK_ERR_RETURN(!frame->done, LOGMEM(em->ctx); em->error = 1, EXIT_FAILURE);
+            }
+            if (ly_set_add(frame->done, (void *)frame->last, LY_SET_OPT_USEASLIST) == -1) {
+                em->error = 1;
+                return EXIT_FAILURE;
+            }
+        }
+        frame->last = snode;
+    }
+    ++frame->children;
+
+    return EXIT_SUCCESS;
+}
+
+API int
+lyd_emit_open(struct lyd_emitter *em, const struct lys_module *module, const char *name)
+{
+    FUN_IN;
+
+    const struct lys_node *snode;
+    struct lyd_emit_frame *frames;
+
+    if (!em) {
+        LOGARG;
+        return EXIT_FAILURE;
+    }
+
+    snode = lyd_emit_schema(em, module, name, LYS_CONTAINER | LYS_LIST | LYS_RPC | LYS_ACTION | LYS_NOTIF);
+    if (!snode) {
+        return EXIT_FAILURE;
+    }
+
+    if (em->depth == em->size) {
+        frames = realloc(em->frames, (em->size * 2) * sizeof *em->frames);
+        LY_CHECK_ERR_RETURN(!frames, LOGMEM(em->ctx), EXIT_FAILURE);
+        em->frames = frames;
+        em->size *= 2;
+    }
+    memset(&em->frames[em->depth], 0, sizeof *em->frames);
+
+    if (lyd_emit_node(em, snode, NULL)) {
+        return EXIT_FAILURE;
+    }
+
+    em->frames[em->depth].schema = snode;
+    ++em->depth;
+    return EXIT_SUCCESS;
+}
+
+API int
+lyd_emit_leaf(struct lyd_emitter *em, const struct lys_module *module, const char *name, const char *value)
+{
+    FUN_IN;
+
+    const struct lys_node *snode;
+    struct lys_node_leaf *sleaf;
+    struct lyd_node_leaf_list leaf;
+    struct lys_type *type;
+    int ret;
+
+    if (!em) {
+        LOGARG;
+        return EXIT_FAILURE;
+    }
+
+    snode = lyd_emit_schema(em, module, name, LYS_LEAF | LYS_LEAFLIST);
+    if (!snode) {
+        return EXIT_FAILURE;
+    }
+
+    /* dummy leaf only to validate and canonize the value for the printer */
+    memset(&leaf, 0, sizeof leaf);
+    leaf.schema = (struct lys_node *)snode;
+    leaf.value_str = lydict_insert(em->ctx, value ? value : "", 0);
+
+    for (sleaf = (struct lys_node_leaf *)snode; sleaf->type.base == LY_TYPE_LEAFREF; sleaf = sleaf->type.info.lref.target) {
+        if (!sleaf->type.info.lref.target) {
+            LOGINT(em->ctx);
+            ret = EXIT_FAILURE;
+            goto cleanup;
+        }
+    }
+    type = lyp_parse_value(&sleaf->type, &leaf.value_str, NULL, &leaf, NULL, NULL, 0, 0, 0);
+    if (!type) {
+        ret = EXIT_FAILURE;
+        goto cleanup;
+    }
+    leaf.value_type = type->base;
+
+    ret = lyd_emit_node(em, snode, &leaf);
+
+cleanup:
+    lydict_remove(em->ctx, leaf.value_str);
+    return ret;
+}
+
+API int
+lyd_emit_close(struct lyd_emitter *em)
+{
+    FUN_IN;
+
+    struct lyd_emit_frame *frame;
+    const struct lys_node_list *slist;
+    int r;
+
+    if (!em) {
+        LOGARG;
+        return EXIT_FAILURE;
+    }
+    if (em->error) {
+        LOGERR(em->ctx, LY_EINVAL, "Emitter output failed, no more data can be emitted.");
+        return EXIT_FAILURE;
+    }
+    if (em->depth == 1) {
+        LOGERR(em->ctx, LY_EINVAL, "No emitted node to close.");
+        return EXIT_FAILURE;
+    }
+
+    frame = &em->frames[em->depth - 1];
+    if (frame->schema->nodetype == LYS_LIST) {
+        slist = (struct lys_node_list *)frame->schema;
+        if (frame->keys < slist->keys_size) {
+            LOGERR(em->ctx, LY_EINVAL, "List \"%s\" key \"%s\" was not emitted.", slist->name,
+                   slist->keys[frame->keys]->name);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (em->format == LYD_XML) {
+        r = xml_emit_close(em);
+    } else {
+        r = json_emit_close(em);
+    }
+    if (r) {
+        em->error = 1;
+        return EXIT_FAILURE;
+    }
+
+    ly_set_free(frame->done);
+    --em->depth;
+    return EXIT_SUCCESS;
+}
+
+API int
+lyd_emitter_finish(struct lyd_emitter *em)
+{
+    FUN_IN;
+
+    int r = EXIT_SUCCESS;
+
+    if (!em) {
+        LOGARG;
+        return EXIT_FAILURE;
+    }
+
+    while (!em->error && (em->depth > 1)) {
+        if (lyd_emit_close(em)) {
+            r = EXIT_FAILURE;
+            break;
+        }
+    }
+
+    if (!r && !em->error) {
+        if (em->format == LYD_XML) {
+            r = xml_emit_finish(em);
+        } else {
+            r = json_emit_finish(em);
+        }
+    } else {
+        r = EXIT_FAILURE;
+    }
+
+    if (ly_print_finish(&em->out)) {
+        r = EXIT_FAILURE;
+    }
+    if (em->strp) {
+        if (r) {
+            free(em->out.method.mem.buf);
+            *em->strp = NULL;
+        } else {
+            *em->strp = em->out.method.mem.buf;
+        }
+        em->out.method.mem.buf = NULL;
+        em->strp = NULL;
+    }
+
+    lyd_emitter_free(em);
+    return r;
+}
+
+API void
+lyd_emitter_free(struct lyd_emitter *em)
+{
+    FUN_IN;
+
+    uint32_t i;
+
+    if (!em) {
+        return;
+    }
+
+    for (i = 0; i < em->depth; ++i) {
+        ly_set_free(em->frames[i].done);
+    }
+    free(em->frames);
+    if (em->out.type == LYOUT_MEMORY) {
+        free(em->out.method.mem.buf);
+    }
+    free(em->out.buffered);
+    free(em->out.out_buf);
+    free(em);
+}
+
 static int
 lyd_wd_toprint(const struct lyd_node *node, int options)
 {
@@ -49,6 +49,33 @@ struct lyout {
 
     /* hole counter */
     size_t hole_count;
+
+    /* output buffer of LYOUT_FD and LYOUT_CALLBACK, LY_PRINT_BUF_SIZE long, written by ly_print_flush() */
+    char *out_buf;
+    size_t out_len;
+};
+
+/* one level of the emitted data, the top-level one has no schema node */
+struct lyd_emit_frame {
+    const struct lys_node *schema; /* the opened container, list or operation */
+    const struct lys_node *last;   /* schema node of the last emitted child */
+    struct ly_set *done;           /* schema nodes of the previous children, no more instances can follow */
+    uint32_t children;             /* number of emitted children */
+    uint8_t keys;                  /* number of emitted list keys */
+    int level;                     /* printer indentation level of the children */
+};
+
+struct lyd_emitter {
+    struct ly_ctx *ctx;
+    LYD_FORMAT format;
+    int options;
+    struct lyout out;
+    char **strp;                   /* where to store the result of LYOUT_MEMORY */
+
+    struct lyd_emit_frame *frames; /* frames[0] is the top level */
+    uint32_t depth;
+    uint32_t size;
+    int error;                     /* printing failed, the output is incomplete */
 };
 
 struct ext_substmt_info_s {
@@ -71,11 +98,27 @@ extern struct ext_substmt_info_s ext_substmt_info[];
  * @brief Generic printer, replacement for printf() / write() / etc
  */
 int ly_print(struct lyout *out, const char *format, ...);
-void ly_print_flush(struct lyout *out);
+int ly_print_flush(struct lyout *out);
+int ly_print_finish(struct lyout *out);
 int ly_write(struct lyout *out, const char *buf, size_t count);
 int ly_write_skip(struct lyout *out, size_t count, size_t *position);
 int ly_write_skipped(struct lyout *out, size_t position, const char *buf, size_t count);
 
+/**
+ * @brief Print a top-level unit (a subtree or a group of list instances) with index \p idx into \p out.
+ * \p state is private to the printing thread and kept for all its units, it starts as NULL.
+ */
+typedef int (*ly_print_unit_clb)(struct lyout *out, const struct lyd_node *node, uint32_t idx, void *arg,
+                                 void **state);
+
+/**
+ * @brief Print independent units concurrently, each into its own memory buffer, and write the buffers
+ * into \p out in the order of \p units, separated by \p sep. Prints sequentially if there is only one CPU or unit.
+ * Every non-NULL thread state is freed by \p state_free.
+ */
+int ly_print_parallel(struct lyout *out, const struct lyd_node **units, uint32_t count, const char *sep,
+                      ly_print_unit_clb print_unit, void *arg, void (*state_free)(void *state));
+
 /* prefix_kind: 0 - print import prefixes for foreign features, 1 - print module names, 2 - print prefixes (tree printer), 3 - print module names including revisions (JSONS printer) */
 int ly_print_iffeature(struct lyout *out, const struct lys_module *module, struct lys_iffeature *expr, int prefix_kind);
 
@@ -90,6 +133,18 @@ int xml_print_data(struct lyout *out, const struct lyd_node *root, int options);
 int xml_print_node(struct lyout *out, int level, const struct lyd_node *node, int toplevel, int options);
 int lyb_print_data(struct lyout *out, const struct lyd_node *root, int options);
 
+/*
+ * Emitter callbacks. *_emit_node() prints a new child of the current frame, \p leaf is the value of
+ * a leaf or leaf-list, otherwise it opens the node and sets the level of the new frame (em->frames[em->depth]).
+ * *_emit_close() closes the current frame, *_emit_finish() completes the output once no frames are open.
+ */
+int xml_emit_node(struct lyd_emitter *em, const struct lys_node *schema, const struct lyd_node_leaf_list *leaf);
+int xml_emit_close(struct lyd_emitter *em);
+int xml_emit_finish(struct lyd_emitter *em);
+int json_emit_node(struct lyd_emitter *em, const struct lys_node *schema, const struct lyd_node_leaf_list *leaf);
+int json_emit_close(struct lyd_emitter *em);
+int json_emit_finish(struct lyd_emitter *em);
+
 int lys_print_target(struct lyout *out, const struct lys_module *module, const char *target_schema_path,
                      void (*clb_print_typedef)(struct lyout*, const struct lys_tpdf*, int*),
                      void (*clb_print_identity)(struct lyout*, const struct lys_ident*, int*),
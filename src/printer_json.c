@@ -19,6 +19,7 @@
 #include <inttypes.h>
 
 #include "common.h"
+#include "hash_table.h"
 #include "printer.h"
 #include "tree_data.h"
 #include "resolve.h"
@@ -34,6 +35,8 @@ int
 json_print_string(struct lyout *out, const char *text)
 {
     unsigned int i, n;
+    unsigned char ascii;
+    size_t len;
 
     if (!text) {
         return 0;
@@ -41,7 +44,18 @@ json_print_string(struct lyout *out, const char *text)
 
     ly_write(out, "\"", 1);
     for (i = n = 0; text[i]; i++) {
-        const unsigned char ascii = text[i];
+        /* write the characters needing no escaping at once */
+        len = ly_strlen_noesc(&text[i], LY_ESC_JSON);
+        if (len) {
+            ly_write(out, &text[i], len);
+            n += len;
+            i += len;
+            if (!text[i]) {
+                break;
+            }
+        }
+
+        ascii = text[i];
         if (ascii < 0x20) {
             /* control character */
             n += ly_print(out, "\\u%.4X", ascii);
@@ -64,6 +78,27 @@ json_print_string(struct lyout *out, const char *text)
     return n + 2;
 }
 
+/* print a dictionary string (or its suffix) as a JSON string */
+static void
+json_print_dict_string(struct lyout *out, const char *text)
+{
+    size_t len;
+
+    if (!text) {
+        return;
+    }
+
+    len = strlen(text);
+    if (lydict_plain(text, len)) {
+        /* nothing to escape */
+        ly_write(out, "\"", 1);
+        ly_write(out, text, len);
+        ly_write(out, "\"", 1);
+    } else {
+        json_print_string(out, text);
+    }
+}
+
 static int
 json_print_attrs(struct lyout *out, int level, const struct lyd_node *node, const struct lys_module *wdmod)
 {
@@ -97,7 +132,7 @@ json_print_attrs(struct lyout *out, int level, const struct lyd_node *node, cons
         case LY_TYPE_INT64:
         case LY_TYPE_UINT64:
         case LY_TYPE_DEC64:
-            json_print_string(out, attr->value_str);
+            json_print_dict_string(out, attr->value_str);
             break;
 
         case LY_TYPE_INT8:
@@ -117,9 +152,9 @@ json_print_attrs(struct lyout *out, int level, const struct lyd_node *node, cons
             if (!strncmp(attr->value_str, attr->annotation->module->name, len)
                     && !attr->annotation->module->name[len]) {
                 /* do not print the prefix, it is the default prefix for this node */
-                json_print_string(out, ++p);
+                json_print_dict_string(out, ++p);
             } else {
-                json_print_string(out, attr->value_str);
+                json_print_dict_string(out, attr->value_str);
             }
             break;
 
@@ -139,35 +174,17 @@ json_print_attrs(struct lyout *out, int level, const struct lyd_node *node, cons
     LY_PRINT_RET(node->schema->module->ctx);
 }
 
+/* print the value of a leaf */
 static int
-json_print_leaf(struct lyout *out, int level, const struct lyd_node *node, int onlyvalue, int toplevel, int options)
+json_print_leaf_value(struct lyout *out, const struct lyd_node_leaf_list *leaf)
 {
-    struct lyd_node_leaf_list *leaf = (struct lyd_node_leaf_list *)node, *iter;
+    const struct lyd_node *node = (struct lyd_node *)leaf;
+    const struct lyd_node_leaf_list *iter;
     const struct lys_type *type;
-    const char *schema = NULL, *p, *mod_name;
-    const struct lys_module *wdmod = NULL;
+    const char *p, *mod_name;
     LY_DATA_TYPE datatype;
     size_t len;
 
-    LY_PRINT_SET;
-
-    if ((node->dflt && (options & (LYP_WD_ALL_TAG | LYP_WD_IMPL_TAG))) ||
-            (!node->dflt && (options & LYP_WD_ALL_TAG) && lyd_wd_default(leaf))) {
-        /* we have implicit OR explicit default node */
-        /* get with-defaults module */
-        wdmod = ly_ctx_get_module(node->schema->module->ctx, "ietf-netconf-with-defaults", NULL, 1);
-    }
-
-    if (!onlyvalue) {
-        if (toplevel || !node->parent || nscmp(node, node->parent)) {
-            /* print "namespace" */
-            schema = lys_node_module(node->schema)->name;
-            ly_print(out, "%*s\"%s:%s\":%s", LEVEL, INDENT, schema, node->schema->name, (level ? " " : ""));
-        } else {
-            ly_print(out, "%*s\"%s\":%s", LEVEL, INDENT, node->schema->name, (level ? " " : ""));
-        }
-    }
-
     datatype = leaf->value_type;
 contentprint:
     switch (datatype) {
@@ -180,7 +197,7 @@ contentprint:
     case LY_TYPE_UINT64:
     case LY_TYPE_UNION:
     case LY_TYPE_DEC64:
-        json_print_string(out, leaf->value_str);
+        json_print_dict_string(out, leaf->value_str);
         break;
 
     case LY_TYPE_INT8:
@@ -190,7 +207,11 @@ contentprint:
     case LY_TYPE_UINT16:
     case LY_TYPE_UINT32:
     case LY_TYPE_BOOL:
-        ly_print(out, "%s", leaf->value_str[0] ? leaf->value_str : "null");
+        if (leaf->value_str[0]) {
+            ly_write(out, leaf->value_str, strlen(leaf->value_str));
+        } else {
+            ly_write(out, "null", 4);
+        }
         break;
 
     case LY_TYPE_IDENT:
@@ -200,9 +221,9 @@ contentprint:
         mod_name = leaf->schema->module->name;
         if (!strncmp(leaf->value_str, mod_name, len) && !mod_name[len]) {
             /* do not print the prefix, it is the default prefix for this node */
-            json_print_string(out, ++p);
+            json_print_dict_string(out, ++p);
         } else {
-            json_print_string(out, leaf->value_str);
+            json_print_dict_string(out, leaf->value_str);
         }
         break;
 
@@ -234,6 +255,39 @@ contentprint:
         return EXIT_FAILURE;
     }
 
+    return EXIT_SUCCESS;
+}
+
+static int
+json_print_leaf(struct lyout *out, int level, const struct lyd_node *node, int onlyvalue, int toplevel, int options)
+{
+    struct lyd_node_leaf_list *leaf = (struct lyd_node_leaf_list *)node;
+    const char *schema = NULL;
+    const struct lys_module *wdmod = NULL;
+
+    LY_PRINT_SET;
+
+    if ((node->dflt && (options & (LYP_WD_ALL_TAG | LYP_WD_IMPL_TAG))) ||
+            (!node->dflt && (options & LYP_WD_ALL_TAG) && lyd_wd_default(leaf))) {
+        /* we have implicit OR explicit default node */
+        /* get with-defaults module */
+        wdmod = ly_ctx_get_module(node->schema->module->ctx, "ietf-netconf-with-defaults", NULL, 1);
+    }
+
+    if (!onlyvalue) {
+        if (toplevel || !node->parent || nscmp(node, node->parent)) {
+            /* print "namespace" */
+            schema = lys_node_module(node->schema)->name;
+            ly_print(out, "%*s\"%s:%s\":%s", LEVEL, INDENT, schema, node->schema->name, (level ? " " : ""));
+        } else {
+            ly_print(out, "%*s\"%s\":%s", LEVEL, INDENT, node->schema->name, (level ? " " : ""));
+        }
+    }
+
+    if (json_print_leaf_value(out, leaf)) {
+        return EXIT_FAILURE;
+    }
+
     /* print attributes as sibling leafs */
     if (!onlyvalue && (node->attr || wdmod)) {
         if (schema) {
@@ -290,12 +344,171 @@ json_print_container(struct lyout *out, int level, const struct lyd_node *node,
     LY_PRINT_RET(node->schema->module->ctx);
 }
 
+/* consecutive sibling instances of a list or leaf-list */
+struct json_run {
+    const struct lyd_node *first;
+    uint32_t count;
+    uint32_t next;  /* index of the next run of the same list or leaf-list, 0 if none */
+    int head;       /* the first run, all the instances are printed with it as one array */
+};
+
+/* instances of the lists and leaf-lists among the printed siblings, grouped in one pass */
+struct json_runs {
+    struct json_run *runs;
+    uint32_t count;
+    uint32_t cur;   /* next run not before the printed nodes */
+    struct json_run single;
+};
+
+#define JSON_IS_LIST(node) ((node)->schema->nodetype & (LYS_LIST | LYS_LEAFLIST))
+
+/* the printed node always starts a run */
+#define JSON_RUN_START(node, root) (JSON_IS_LIST(node) && (((node) == (root)) || !(node)->prev->next \
+        || ((node)->prev->schema != (node)->schema)))
+
 static int
-json_print_leaf_list(struct lyout *out, int level, const struct lyd_node *node, int is_list, int toplevel, int options)
+json_run_cmp(const void *ptr1, const void *ptr2)
+{
+    const struct json_run *run1 = *(struct json_run **)ptr1, *run2 = *(struct json_run **)ptr2;
+
+    if (run1->first->schema != run2->first->schema) {
+        return ((uintptr_t)run1->first->schema < (uintptr_t)run2->first->schema) ? -1 : 1;
+    }
+    return (run1 < run2) ? -1 : 1;
+}
+
+/**
+ * @brief Group the list and leaf-list instances of the printed siblings into the runs of consecutive
+ * instances chained by their schema nodes.
+ *
+ * @param[in] root First printed sibling.
+ * @param[in] withsiblings Whether the following siblings are printed, otherwise only @p root is.
+ * @param[out] runs Runs to fill, free with json_runs_clean().
+ * @return EXIT_SUCCESS on success, EXIT_FAILURE on error.
+ */
+static int
+json_runs_build(const struct lyd_node *root, int withsiblings, struct json_runs *runs)
+{
+    const struct lyd_node *first, *node;
+    struct json_run **sorted;
+    uint32_t i;
+
+    memset(runs, 0, sizeof *runs);
+    if (!root) {
+        return EXIT_SUCCESS;
+    } else if (!withsiblings) {
+        if (JSON_IS_LIST(root)) {
+            runs->single.first = root;
+            runs->single.count = 1;
+            runs->single.head = 1;
+            runs->runs = &runs->single;
+            runs->count = 1;
+        }
+        return EXIT_SUCCESS;
+    }
+
+    /* the instances before the printed nodes are not printed, nor any other instances of their lists */
+    for (first = root; first->prev->next; first = first->prev);
+    LY_TREE_FOR(first, node) {
+        if (JSON_RUN_START(node, root)) {
+            ++runs->count;
+        }
+    }
+    if (!runs->count) {
+        return EXIT_SUCCESS;
+    }
+
+    runs->runs = calloc(runs->count, sizeof *runs->runs);
+    LY_CHECK_ERR_RETURN(!runs->runs, LOGMEM(root->schema->module->ctx), EXIT_FAILURE);
+    i = 0;
+    LY_TREE_FOR(first, node) {
+        if (node == root) {
+            runs->cur = i;
+        }
+        if (JSON_RUN_START(node, root)) {
+            runs->runs[i].first = node;
+            runs->runs[i].count = 1;
+            ++i;
+        } else if (JSON_IS_LIST(node)) {
+            runs->runs[i - 1].count++;
+        }
+    }
+
+    if (runs->count == 1) {
+        runs->runs[0].head = 1;
+        return EXIT_SUCCESS;
+    }
+
+    /* chain the runs of the same schema nodes */
+    sorted = malloc(runs->count * sizeof *sorted);
+    LY_CHECK_ERR_RETURN(!sorted, LOGMEM(root->schema->module->ctx); free(runs->runs), EXIT_FAILURE);
+    for (i = 0; i < runs->count; ++i) {
+        sorted[i] = &runs->runs[i];
+    }
+    qsort(sorted, runs->count, sizeof *sorted, json_run_cmp);
+    for (i = 0; i < runs->count; ++i) {
+        if (!i || (sorted[i]->first->schema != sorted[i - 1]->first->schema) || (sorted[i]->first == root)) {
+            sorted[i]->head = 1;
+        } else {
+            sorted[i - 1]->next = sorted[i] - runs->runs;
+        }
+    }
+    free(sorted);
+
+    return EXIT_SUCCESS;
+}
+
+static void
+json_runs_clean(struct json_runs *runs)
+{
+    if (runs->runs != &runs->single) {
+        free(runs->runs);
+    }
+}
+
+/**
+ * @brief Learn whether a sibling is printed, in the order of the siblings.
+ *
+ * @param[in] runs Runs of the siblings.
+ * @param[in] node Next sibling.
+ * @param[out] run Run starting with @p node, if any.
+ * @return Whether @p node is printed, all the instances of a list or leaf-list are printed with its first run.
+ */
+static int
+json_runs_printed(struct json_runs *runs, const struct lyd_node *node, uint32_t *run)
+{
+    if (!JSON_IS_LIST(node)) {
+        return 1;
+    }
+    if ((runs->cur < runs->count) && (runs->runs[runs->cur].first == node)) {
+        *run = runs->cur++;
+        return runs->runs[*run].head;
+    }
+
+    /* another instance of a run */
+    return 0;
+}
+
+/* get the next instance printed in the array of a list or leaf-list */
+static const struct lyd_node *
+json_runs_next(const struct json_runs *runs, uint32_t *run, uint32_t *i, const struct lyd_node *node)
+{
+    if (++(*i) < runs->runs[*run].count) {
+        return node->next;
+    }
+    *run = runs->runs[*run].next;
+    *i = 0;
+    return *run ? runs->runs[*run].first : NULL;
+}
+
+static int
+json_print_leaf_list(struct lyout *out, int level, const struct json_runs *runs, uint32_t run, int toplevel,
+                     int options)
 {
     const char *schema = NULL;
-    const struct lyd_node *list = node;
-    int flag_empty = 0, flag_attrs = 0;
+    const struct lyd_node *node = runs->runs[run].first, *list = node;
+    int is_list = (node->schema->nodetype == LYS_LIST), flag_empty = 0, flag_attrs = 0;
+    uint32_t r = run, i = 0;
 
     LY_PRINT_SET;
 
@@ -367,7 +580,7 @@ json_print_leaf_list(struct lyout *out, int level, const struct lyd_node *node,
             /* if initially called without LYP_WITHSIBLINGS do not print other list entries */
             break;
         }
-        for (list = list->next; list && list->schema != node->schema; list = list->next);
+        list = json_runs_next(runs, &r, &i, list);
         if (list) {
             ly_print(out, ",%s", (level ? "\n" : ""));
         }
@@ -391,7 +604,7 @@ json_print_leaf_list(struct lyout *out, int level, const struct lyd_node *node,
         if (level) {
             level++;
         }
-        for (list = node; list; ) {
+        for (list = node, r = run, i = 0; list; ) {
             if (list->attr) {
                 ly_print(out, "%*s{%s", LEVEL, INDENT, (level ? " " : ""));
                 if (json_print_attrs(out, 0, list, NULL)) {
@@ -402,8 +615,7 @@ json_print_leaf_list(struct lyout *out, int level, const struct lyd_node *node,
                 ly_print(out, "%*snull", LEVEL, INDENT);
             }
 
-
-            for (list = list->next; list && list->schema != node->schema; list = list->next);
+            list = json_runs_next(runs, &r, &i, list);
             if (list) {
                 ly_print(out, ",%s", (level ? "\n" : ""));
             }
@@ -515,79 +727,301 @@ json_print_anydataxml(struct lyout *out, int level, const struct lyd_node *node,
     LY_PRINT_RET(node->schema->module->ctx);
 }
 
+static int
+json_print_node(struct lyout *out, int level, const struct lyd_node *node, const struct json_runs *runs, uint32_t run,
+                int toplevel, int options)
+{
+    switch (node->schema->nodetype) {
+    case LYS_RPC:
+    case LYS_ACTION:
+    case LYS_NOTIF:
+    case LYS_CONTAINER:
+        return json_print_container(out, level, node, toplevel, options);
+    case LYS_LEAF:
+        return json_print_leaf(out, level, node, 0, toplevel, options);
+    case LYS_LEAFLIST:
+    case LYS_LIST:
+        /* print the list/leaflist */
+        return json_print_leaf_list(out, level, runs, run, toplevel, options);
+    case LYS_ANYXML:
+    case LYS_ANYDATA:
+        return json_print_anydataxml(out, level, node, toplevel, options);
+    default:
+        LOGINT(node->schema->module->ctx);
+        return EXIT_FAILURE;
+    }
+}
+
 static int
 json_print_nodes(struct lyout *out, int level, const struct lyd_node *root, int withsiblings, int toplevel, int options)
 {
-    int comma_flag = 0;
-    const struct lyd_node *node, *iter;
+    int comma_flag = 0, printed;
+    const struct lyd_node *node;
+    struct json_runs runs;
+    uint32_t run = 0;
 
     LY_PRINT_SET;
 
+    if (json_runs_build(root, withsiblings, &runs)) {
+        return EXIT_FAILURE;
+    }
     LY_TREE_FOR(root, node) {
+        printed = json_runs_printed(&runs, node, &run);
         if (!lyd_toprint(node, options)) {
             /* wd says do not print */
             continue;
         }
+        ++ly_cnt.nodes_printed;
 
-        switch (node->schema->nodetype) {
-        case LYS_RPC:
-        case LYS_ACTION:
-        case LYS_NOTIF:
-        case LYS_CONTAINER:
+        if (printed) {
             if (comma_flag) {
                 /* print the previous comma */
                 ly_print(out, ",%s", (level ? "\n" : ""));
             }
-            if (json_print_container(out, level, node, toplevel, options)) {
+            if (json_print_node(out, level, node, &runs, run, toplevel, options)) {
+                json_runs_clean(&runs);
                 return EXIT_FAILURE;
             }
+        }
+
+        if (!withsiblings) {
             break;
-        case LYS_LEAF:
-            if (comma_flag) {
-                /* print the previous comma */
-                ly_print(out, ",%s", (level ? "\n" : ""));
-            }
-            if (json_print_leaf(out, level, node, 0, toplevel, options)) {
-                return EXIT_FAILURE;
-            }
-            break;
-        case LYS_LEAFLIST:
-        case LYS_LIST:
-            /* is it already printed? (root node is not) */
-            for (iter = node->prev; iter->next && node != root; iter = iter->prev) {
-                if (iter == node) {
-                    continue;
-                }
-                if (iter->schema == node->schema) {
-                    /* the list has alread some previous instance and therefore it is already printed */
-                    break;
-                }
+        }
+        comma_flag = 1;
+    }
+    json_runs_clean(&runs);
+    if (root && level) {
+        ly_print(out, "\n");
+    }
+
+    LY_PRINT_RET(root ? root->schema->module->ctx : NULL);
+}
+
+/* member key of a schema node in the compact output, "module:name":"name": stored in json_compact.buf */
+struct json_key {
+    const struct lys_node *schema;
+    uint32_t off;       /* offset of the key in the buffer */
+    uint16_t len;       /* length of "module:name": */
+    uint16_t short_len; /* length of "name": following it */
+};
+
+/* state of printing without LYP_FORMAT */
+struct json_compact {
+    struct lyout *out;
+    int options;
+    struct hash_table *keys;  /* struct json_key of the printed schema nodes */
+    char *buf;
+    uint32_t used;
+    uint32_t size;
+};
+
+static int json_compact_print_nodes(struct json_compact *jc, const struct lyd_node *root, int withsiblings,
+                                    int toplevel);
+
+static int
+json_key_equal(void *val1_p, void *val2_p, int UNUSED(mod), void *UNUSED(cb_data))
+{
+    return ((struct json_key *)val1_p)->schema == ((struct json_key *)val2_p)->schema;
+}
+
+static void
+json_compact_clean(struct json_compact *jc)
+{
+    lyht_free(jc->keys);
+    free(jc->buf);
+}
+
+/* print the member name, the key is created when the schema node is printed for the first time */
+static int
+json_compact_print_key(struct json_compact *jc, const struct lyd_node *node, int toplevel)
+{
+    struct ly_ctx *ctx = node->schema->module->ctx;
+    struct json_key key, *match;
+    const char *mod_name, *name;
+    size_t mod_len, name_len;
+    uint32_t hash;
+    char *aux, *ptr;
+
+    if (!jc->keys) {
+        jc->keys = lyht_new(16, sizeof key, json_key_equal, NULL, 1);
+        LY_CHECK_ERR_RETURN(!jc->keys, LOGMEM(ctx), EXIT_FAILURE);
+    }
+
+    key.schema = node->schema;
+    hash = dict_hash_multi(0, (const char *)&key.schema, sizeof key.schema);
+    hash = dict_hash_multi(hash, NULL, 0);
+    if (lyht_find(jc->keys, &key, hash, (void **)&match)) {
+        mod_name = lys_node_module(node->schema)->name;
+        name = node->schema->name;
+        mod_len = strlen(mod_name);
+        name_len = strlen(name);
+
+        key.off = jc->used;
+        key.len = mod_len + name_len + 4;
+        key.short_len = name_len + 3;
+        if (jc->used + key.len + key.short_len > jc->size) {
+            jc->size = (jc->used + key.len + key.short_len) * 2;
+            aux = ly_realloc(jc->buf, jc->size);
+            LY_CHECK_ERR_RETURN(!aux, jc->buf = NULL; LOGMEM(ctx), EXIT_FAILURE);
+            jc->buf = aux;
+        }
+
+        ptr = &jc->buf[key.off];
+        *ptr++ = '"';
+        memcpy(ptr, mod_name, mod_len);
+        ptr += mod_len;
+        *ptr++ = ':';
+        memcpy(ptr, name, name_len);
+        ptr += name_len;
+        *ptr++ = '"';
+        *ptr++ = ':';
+        *ptr++ = '"';
+        memcpy(ptr, name, name_len);
+        ptr += name_len;
+        *ptr++ = '"';
+        *ptr++ = ':';
+        jc->used += key.len + key.short_len;
+
+        if (lyht_insert(jc->keys, &key, hash, (void **)&match)) {
+            LOGINT(ctx);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (toplevel || !node->parent || nscmp(node, node->parent)) {
+        ly_write(jc->out, &jc->buf[match->off], match->len);
+    } else {
+        ly_write(jc->out, &jc->buf[match->off + match->len], match->short_len);
+    }
+    return EXIT_SUCCESS;
+}
+
+static int
+json_compact_print_list(struct json_compact *jc, const struct json_runs *runs, uint32_t run, int toplevel)
+{
+    const struct lyd_node *node = runs->runs[run].first, *list;
+    int is_list = (node->schema->nodetype == LYS_LIST);
+    uint32_t r, i;
+
+    if (is_list && !node->child) {
+        /* printed as null */
+        return json_print_leaf_list(jc->out, 0, runs, run, toplevel, jc->options);
+    }
+    if (!is_list) {
+        for (list = node, r = run, i = 0; list; list = json_runs_next(runs, &r, &i, list)) {
+            if (list->attr) {
+                /* printed with the sibling attribute array */
+                return json_print_leaf_list(jc->out, 0, runs, run, toplevel, jc->options);
             }
-            if (!iter->next || node == root) {
-                if (comma_flag) {
-                    /* print the previous comma */
-                    ly_print(out, ",%s", (level ? "\n" : ""));
-                }
+        }
+    }
 
-                /* print the list/leaflist */
-                if (json_print_leaf_list(out, level, node, node->schema->nodetype == LYS_LIST ? 1 : 0, toplevel, options)) {
+    if (json_compact_print_key(jc, node, toplevel)) {
+        return EXIT_FAILURE;
+    }
+    ly_write(jc->out, "[", 1);
+    for (list = node, r = run, i = 0; list; ) {
+        if (is_list) {
+            ly_write(jc->out, "{", 1);
+            if (list->attr) {
+                ly_write(jc->out, "\"@\":{", 5);
+                if (json_print_attrs(jc->out, 0, list, NULL)) {
                     return EXIT_FAILURE;
                 }
+                ly_write(jc->out, list->child ? "}," : "}", list->child ? 2 : 1);
+            }
+            if (json_compact_print_nodes(jc, list->child, 1, 0)) {
+                return EXIT_FAILURE;
             }
+            ly_write(jc->out, "}", 1);
+        } else if (json_print_leaf_value(jc->out, (struct lyd_node_leaf_list *)list)) {
+            return EXIT_FAILURE;
+        }
+        if (toplevel && !(jc->options & LYP_WITHSIBLINGS)) {
+            /* if initially called without LYP_WITHSIBLINGS do not print other list entries */
             break;
-        case LYS_ANYXML:
-        case LYS_ANYDATA:
+        }
+        list = json_runs_next(runs, &r, &i, list);
+        if (list) {
+            ly_write(jc->out, ",", 1);
+        }
+    }
+    ly_write(jc->out, "]", 1);
+
+    return EXIT_SUCCESS;
+}
+
+/* print a node without any formatting, the nodes needing special handling are printed by the generic functions */
+static int
+json_compact_print_node(struct json_compact *jc, const struct lyd_node *node, const struct json_runs *runs, uint32_t run,
+                        int toplevel)
+{
+    switch (node->schema->nodetype) {
+    case LYS_RPC:
+    case LYS_ACTION:
+    case LYS_NOTIF:
+    case LYS_CONTAINER:
+        if (node->attr) {
+            return json_print_container(jc->out, 0, node, toplevel, jc->options);
+        }
+        if (json_compact_print_key(jc, node, toplevel)) {
+            return EXIT_FAILURE;
+        }
+        ly_write(jc->out, "{", 1);
+        if (json_compact_print_nodes(jc, node->child, 1, 0)) {
+            return EXIT_FAILURE;
+        }
+        ly_write(jc->out, "}", 1);
+        return EXIT_SUCCESS;
+    case LYS_LEAF:
+        if (node->attr || (jc->options & (LYP_WD_ALL_TAG | LYP_WD_IMPL_TAG))) {
+            return json_print_leaf(jc->out, 0, node, 0, toplevel, jc->options);
+        }
+        if (json_compact_print_key(jc, node, toplevel)) {
+            return EXIT_FAILURE;
+        }
+        return json_print_leaf_value(jc->out, (struct lyd_node_leaf_list *)node);
+    case LYS_LEAFLIST:
+    case LYS_LIST:
+        return json_compact_print_list(jc, runs, run, toplevel);
+    case LYS_ANYXML:
+    case LYS_ANYDATA:
+        return json_print_anydataxml(jc->out, 0, node, toplevel, jc->options);
+    default:
+        LOGINT(node->schema->module->ctx);
+        return EXIT_FAILURE;
+    }
+}
+
+static int
+json_compact_print_nodes(struct json_compact *jc, const struct lyd_node *root, int withsiblings, int toplevel)
+{
+    int comma_flag = 0, printed;
+    const struct lyd_node *node;
+    struct json_runs runs;
+    uint32_t run = 0;
+
+    LY_PRINT_SET;
+
+    if (json_runs_build(root, withsiblings, &runs)) {
+        return EXIT_FAILURE;
+    }
+    LY_TREE_FOR(root, node) {
+        printed = json_runs_printed(&runs, node, &run);
+        if (!lyd_toprint(node, jc->options)) {
+            /* wd says do not print */
+            continue;
+        }
+        ++ly_cnt.nodes_printed;
+
+        if (printed) {
             if (comma_flag) {
-                /* print the previous comma */
-                ly_print(out, ",%s", (level ? "\n" : ""));
+                ly_write(jc->out, ",", 1);
             }
-            if (json_print_anydataxml(out, level, node, toplevel, options)) {
+            if (json_compact_print_node(jc, node, &runs, run, toplevel)) {
+                json_runs_clean(&runs);
                 return EXIT_FAILURE;
             }
-            break;
-        default:
-            LOGINT(node->schema->module->ctx);
-            return EXIT_FAILURE;
         }
 
         if (!withsiblings) {
@@ -595,18 +1029,95 @@ json_print_nodes(struct lyout *out, int level, const struct lyd_node *root, int
         }
         comma_flag = 1;
     }
-    if (root && level) {
+    json_runs_clean(&runs);
+
+    LY_PRINT_RET(root ? root->schema->module->ctx : NULL);
+}
+
+struct json_print_unit_arg {
+    int level;
+    int options;
+    struct json_runs runs;
+    uint32_t *unit_runs;    /* run of every unit */
+};
+
+static void
+json_print_unit_free(void *state)
+{
+    json_compact_clean(state);
+    free(state);
+}
+
+static int
+json_print_unit(struct lyout *out, const struct lyd_node *node, uint32_t idx, void *arg, void **state)
+{
+    struct json_print_unit_arg *unit = arg;
+    struct json_compact *jc;
+
+    if (unit->level) {
+        return json_print_node(out, unit->level, node, &unit->runs, unit->unit_runs[idx], 1, unit->options);
+    }
+
+    /* every thread keeps its keys for all its units */
+    if (!*state) {
+        *state = calloc(1, sizeof *jc);
+        LY_CHECK_ERR_RETURN(!*state, LOGMEM(node->schema->module->ctx), EXIT_FAILURE);
+    }
+    jc = *state;
+    jc->out = out;
+    jc->options = unit->options;
+    return json_compact_print_node(jc, node, &unit->runs, unit->unit_runs[idx], 1);
+}
+
+/* print the top-level siblings as separate units, a whole list or leaf-list being one unit, see #LYP_PARALLEL */
+static int
+json_print_parallel(struct lyout *out, int level, const struct lyd_node *root, int options)
+{
+    const struct lyd_node *node, **units;
+    struct json_print_unit_arg arg = {level, options, {NULL, 0, 0, {NULL, 0, 0, 0}}, NULL};
+    uint32_t count = 0, run = 0;
+    int ret, printed;
+
+    LY_TREE_FOR(root, node) {
+        ++count;
+    }
+    units = malloc(count * sizeof *units);
+    arg.unit_runs = malloc(count * sizeof *arg.unit_runs);
+    LY_CHECK_ERR_GOTO(!units || !arg.unit_runs, LOGMEM(root->schema->module->ctx), error);
+    if (json_runs_build(root, 1, &arg.runs)) {
+        goto error;
+    }
+
+    count = 0;
+    LY_TREE_FOR(root, node) {
+        printed = json_runs_printed(&arg.runs, node, &run);
+        if (lyd_toprint(node, options) && printed) {
+            units[count] = node;
+            arg.unit_runs[count++] = run;
+        }
+    }
+
+    ret = ly_print_parallel(out, units, count, level ? ",\n" : ",", json_print_unit, &arg, json_print_unit_free);
+    json_runs_clean(&arg.runs);
+    free(arg.unit_runs);
+    free(units);
+    if (!ret && level) {
         ly_print(out, "\n");
     }
+    return ret;
 
-    LY_PRINT_RET(root ? root->schema->module->ctx : NULL);
+error:
+    free(arg.unit_runs);
+    free(units);
+    return EXIT_FAILURE;
 }
 
 int
 json_print_data(struct lyout *out, const struct lyd_node *root, int options)
 {
     const struct lyd_node *node, *next;
-    int level = 0, action_input = 0;
+    struct json_compact jc;
+    int level = 0, action_input = 0, ret;
 
     LY_PRINT_SET;
 
@@ -648,7 +1159,21 @@ json_print_data(struct lyout *out, const struct lyd_node *root, int options)
     }
 
     /* content */
-    if (json_print_nodes(out, level, root, options & LYP_WITHSIBLINGS, 1, options)) {
+    if (root && (options & LYP_PARALLEL) && (options & LYP_WITHSIBLINGS)) {
+        if (json_print_parallel(out, level, root, options)) {
+            return EXIT_FAILURE;
+        }
+    } else if (!level) {
+        /* machine-readable output */
+        memset(&jc, 0, sizeof jc);
+        jc.out = out;
+        jc.options = options;
+        ret = json_compact_print_nodes(&jc, root, options & LYP_WITHSIBLINGS, 1);
+        json_compact_clean(&jc);
+        if (ret) {
+            return EXIT_FAILURE;
+        }
+    } else if (json_print_nodes(out, level, root, options & LYP_WITHSIBLINGS, 1, options)) {
         return EXIT_FAILURE;
     }
 
@@ -665,3 +1190,119 @@ json_print_data(struct lyout *out, const struct lyd_node *root, int options)
     ly_print_flush(out);
     LY_PRINT_RET(NULL);
 }
+
+/* close the array of the last list or leaf-list instances printed in a frame */
+static void
+json_emit_array_end(struct lyd_emitter *em, struct lyd_emit_frame *frame)
+{
+    int level = frame->level;
+
+    if (frame->last && (frame->last->nodetype & (LYS_LIST | LYS_LEAFLIST))) {
+        ly_print(&em->out, "%s%*s]", (level ? "\n" : ""), LEVEL, INDENT);
+    }
+}
+
+int
+json_emit_node(struct lyd_emitter *em, const struct lys_node *schema, const struct lyd_node_leaf_list *leaf)
+{
+    struct lyd_emit_frame *parent = &em->frames[em->depth - 1];
+    int level = parent->level;
+
+    LY_PRINT_SET;
+
+    if (!parent->schema && !parent->children) {
+        /* start */
+        ly_print(&em->out, "{%s", (level ? "\n" : ""));
+    }
+
+    if (parent->last == schema) {
+        /* another instance of the list or leaf-list */
+        ly_print(&em->out, ",%s", (level ? "\n" : ""));
+    } else {
+        json_emit_array_end(em, parent);
+        if (parent->children) {
+            /* print the previous comma */
+            ly_print(&em->out, ",%s", (level ? "\n" : ""));
+        }
+
+        if (!parent->schema || (lys_node_module(schema) != lys_node_module(parent->schema))) {
+            /* print "namespace" */
+            ly_print(&em->out, "%*s\"%s:%s\":", LEVEL, INDENT, lys_node_module(schema)->name, schema->name);
+        } else {
+            ly_print(&em->out, "%*s\"%s\":", LEVEL, INDENT, schema->name);
+        }
+
+        if (schema->nodetype & (LYS_LIST | LYS_LEAFLIST)) {
+            ly_print(&em->out, "%s[%s", (level ? " " : ""), (level ? "\n" : ""));
+        } else if (leaf) {
+            ly_print(&em->out, "%s", (level ? " " : ""));
+        } else {
+            ly_print(&em->out, "%s{%s", (level ? " " : ""), (level ? "\n" : ""));
+        }
+    }
+
+    if (schema->nodetype & (LYS_LIST | LYS_LEAFLIST)) {
+        /* array item */
+        if (level) {
+            ++level;
+        }
+        ly_print(&em->out, "%*s", LEVEL, INDENT);
+    }
+
+    if (leaf) {
+        if (json_print_leaf_value(&em->out, leaf)) {
+            return EXIT_FAILURE;
+        }
+    } else {
+        if (schema->nodetype == LYS_LIST) {
+            ly_print(&em->out, "{%s", (level ? "\n" : ""));
+        }
+        em->frames[em->depth].level = level ? level + 1 : 0;
+    }
+
+    LY_PRINT_RET(em->ctx);
+}
+
+int
+json_emit_close(struct lyd_emitter *em)
+{
+    struct lyd_emit_frame *frame = &em->frames[em->depth - 1];
+    int level = frame->level;
+
+    LY_PRINT_SET;
+
+    json_emit_array_end(em, frame);
+    if (frame->children && level) {
+        ly_print(&em->out, "\n");
+    }
+    if (level) {
+        --level;
+    }
+    ly_print(&em->out, "%*s}", LEVEL, INDENT);
+
+    LY_PRINT_RET(em->ctx);
+}
+
+int
+json_emit_finish(struct lyd_emitter *em)
+{
+    struct lyd_emit_frame *frame = &em->frames[0];
+    int level = frame->level;
+
+    LY_PRINT_SET;
+
+    if (!frame->children) {
+        /* start */
+        ly_print(&em->out, "{%s", (level ? "\n" : ""));
+    } else {
+        json_emit_array_end(em, frame);
+        if (level) {
+            ly_print(&em->out, "\n");
+        }
+    }
+
+    /* end */
+    ly_print(&em->out, "}%s", (level ? "\n" : ""));
+
+    LY_PRINT_RET(em->ctx);
+}
@@ -15,12 +15,14 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdint.h>
+#include <inttypes.h>
 #include <string.h>
 #include <assert.h>
 #include <stdint.h>
 #ifdef __APPLE__
 # include <libkern/OSByteOrder.h>
 # define htole64(x) OSSwapHostToLittleInt64(x)
+# define htole32(x) OSSwapHostToLittleInt32(x)
 #elif defined(__FreeBSD__) || defined(__NetBSD__) || defined(__DragonFly__)
 # include <sys/endian.h>
 #elif defined(__sun__)
@@ -29,20 +31,28 @@
 # if defined(_BIG_ENDIAN)
 #  define le64toh(x) BSWAP_64(x)
 #  define htole64(x) le64toh(x)
+#  define htole32(x) BSWAP_32(x)
 # else
 #  define le64toh(x) (x)
 #  define htole64(x) (x)
+#  define htole32(x) (x)
 # endif
 #else
 # include <endian.h>
 #endif
 
 #include "common.h"
+#include "context.h"
 #include "printer.h"
 #include "tree_schema.h"
 #include "tree_data.h"
 #include "resolve.h"
 #include "tree_internal.h"
+#include "parser.h"
+
+#ifdef LY_ENABLED_LYB_COMPRESSION
+# include <zlib.h>
+#endif
 
 static int
 lyb_hash_equal_cb(void *UNUSED(val1_p), void *UNUSED(val2_p), int UNUSED(mod), void *UNUSED(cb_data))
@@ -289,6 +299,100 @@ lyb_hash_siblings(struct lys_node *sibling, const struct lys_module **models, in
     return ht;
 }
 
+/* record of the context sibling hash tables */
+struct lyb_sibling_ht_rec {
+    struct lys_node *first_sibling;
+    struct hash_table *ht;
+};
+
+static int
+lyb_sibling_ht_equal(void *val1_p, void *val2_p, int UNUSED(mod), void *UNUSED(cb_data))
+{
+    return ((struct lyb_sibling_ht_rec *)val1_p)->first_sibling == ((struct lyb_sibling_ht_rec *)val2_p)->first_sibling;
+}
+
+static void
+lyb_sibling_hts_free(struct hash_table *hts)
+{
+    uint32_t i;
+    struct lyb_sibling_ht_rec *rec;
+
+    if (!hts) {
+        return;
+    }
+
+    lyht_finish_resize(hts);
+    for (i = 0; i < hts->size; ++i) {
+        rec = lyht_get_val(hts, i);
+        if (rec) {
+            lyht_free(rec->ht);
+        }
+    }
+    lyht_free(hts);
+}
+
+/* get the sibling hash table of first_sibling cached in the context, create it if not yet created,
+ * the table is only read afterwards so it can be used by more printers at once */
+static struct hash_table *
+lyb_sibling_ht_get(struct ly_ctx *ctx, struct lys_node *first_sibling)
+{
+    struct lyb_sibling_ht_rec rec, *match;
+    struct hash_table *ht = NULL;
+    uint32_t hash;
+
+    rec.first_sibling = first_sibling;
+    rec.ht = NULL;
+    hash = dict_hash_multi(0, (const char *)&first_sibling, sizeof first_sibling);
+    hash = dict_hash_multi(hash, NULL, 0);
+
+    pthread_mutex_lock(&ctx->lyb_sibling_hts_lock);
+
+    if (ctx->lyb_sibling_hts && (ctx->lyb_sibling_hts_set_id != ctx->models.module_set_id)) {
+        /* modules changed, build the tables again */
+        lyb_sibling_hts_free(ctx->lyb_sibling_hts);
+        ctx->lyb_sibling_hts = NULL;
+    }
+    if (!ctx->lyb_sibling_hts) {
+        ctx->lyb_sibling_hts = lyht_new(8, sizeof rec, lyb_sibling_ht_equal, NULL, 1);
+        LY_CHECK_ERR_GOTO(!ctx->lyb_sibling_hts, LOGMEM(ctx), cleanup);
+        ctx->lyb_sibling_hts_set_id = ctx->models.module_set_id;
+    }
+
+    if (!lyht_find(ctx->lyb_sibling_hts, &rec, hash, (void **)&match)) {
+        ht = match->ht;
+        goto cleanup;
+    }
+
+    /* we must create sibling hash table */
+    rec.ht = lyb_hash_siblings(first_sibling, NULL, 0);
+    if (!rec.ht) {
+        goto cleanup;
+    }
+
+    /* and save it */
+    if (lyht_insert(ctx->lyb_sibling_hts, &rec, hash, NULL)) {
+        LOGINT(ctx);
+        lyht_free(rec.ht);
+        goto cleanup;
+    }
+    ht = rec.ht;
+
+cleanup:
+    pthread_mutex_unlock(&ctx->lyb_sibling_hts_lock);
+    return ht;
+}
+
+void
+lyb_sibling_hts_clean(struct ly_ctx *ctx)
+{
+    pthread_mutex_lock(&ctx->lyb_sibling_hts_lock);
+
+    lyb_sibling_hts_free(ctx->lyb_sibling_hts);
+    ctx->lyb_sibling_hts = NULL;
+
+    pthread_mutex_unlock(&ctx->lyb_sibling_hts_lock);
+}
+
 static LYB_HASH
 lyb_hash_find(struct hash_table *ht, struct lys_node *node)
 {
@@ -320,96 +424,41 @@ lyb_hash_find(struct hash_table *ht, struct lys_node *node)
 static int
 lyb_write(struct lyout *out, const uint8_t *buf, size_t count, struct lyb_state *lybs)
 {
-    int ret = 0, i, full_chunk_i;
-    size_t r, to_write;
-    uint8_t meta_buf[LYB_META_BYTES];
+    size_t r;
 
     assert(out && lybs);
 
-    while (1) {
-        /* check for full data chunks */
-        to_write = count;
-        full_chunk_i = -1;
-        for (i = 0; i < lybs->used; ++i) {
-            /* we want the innermost chunks resolved first, so replace previous full chunks */
-            if (lybs->written[i] + to_write >= LYB_SIZE_MAX) {
-                /* full chunk, do not write more than allowed */
-                to_write = LYB_SIZE_MAX - lybs->written[i];
-                full_chunk_i = i;
-            }
-        }
-
-        if ((full_chunk_i == -1) && !count) {
-            break;
-        }
-
-        /* we are actually writing some data, not just finishing another chunk */
-        if (to_write) {
-            r = ly_write(out, (char *)buf, to_write);
-            if (r < to_write) {
-                return -1;
-            }
-
-            for (i = 0; i < lybs->used; ++i) {
-                /* increase all written counters */
-                lybs->written[i] += r;
-                assert(lybs->written[i] <= LYB_SIZE_MAX);
-            }
-            /* decrease count/buf */
-            count -= r;
-            buf += r;
-
-            ret += r;
-        }
-
-        if (full_chunk_i > -1) {
-            /* write the meta information (inner chunk count and chunk size) */
-            meta_buf[0] = lybs->written[full_chunk_i] & 0xFF;
-            meta_buf[1] = lybs->inner_chunks[full_chunk_i] & 0xFF;
-
-            r = ly_write_skipped(out, lybs->position[full_chunk_i], (char *)meta_buf, LYB_META_BYTES);
-            if (r < LYB_META_BYTES) {
-                return -1;
-            }
-
-            /* zero written and inner chunks */
-            lybs->written[full_chunk_i] = 0;
-            lybs->inner_chunks[full_chunk_i] = 0;
-
-            /* skip space for another chunk size */
-            r = ly_write_skip(out, LYB_META_BYTES, &lybs->position[full_chunk_i]);
-            if (r < LYB_META_BYTES) {
-                return -1;
-            }
-
-            ret += r;
+    if (!count) {
+        return 0;
+    }
 
-            /* increase inner chunk count */
-            for (i = 0; i < full_chunk_i; ++i) {
-                if (lybs->inner_chunks[i] == LYB_INCHUNK_MAX) {
-                    LOGINT(lybs->ctx);
-                    return -1;
-                }
-                ++lybs->inner_chunks[i];
-            }
-        }
+    r = ly_write(out, (char *)buf, count);
+    if (r < count) {
+        return -1;
     }
 
-    return ret;
+    /* the subtree sizes are learned from the offsets */
+    lybs->offset += r;
+    return r;
 }
 
 static int
 lyb_write_stop_subtree(struct lyout *out, struct lyb_state *lybs)
 {
+    size_t size;
+    uint32_t size_buf;
     int r;
-    uint8_t meta_buf[LYB_META_BYTES];
 
-    /* write the meta chunk information */
-    meta_buf[0] = lybs->written[lybs->used - 1] & 0xFF;
-    meta_buf[1] = lybs->inner_chunks[lybs->used - 1] & 0xFF;
+    /* write the whole subtree size */
+    size = lybs->offset - lybs->written[lybs->used - 1];
+    if (size > UINT32_MAX) {
+        LOGERR(lybs->ctx, LY_EINVAL, "LYB subtree size %zu exceeds the maximum %" PRIu32 " bytes.", size, UINT32_MAX);
+        return -1;
+    }
+    size_buf = htole32((uint32_t)size);
 
-    r = ly_write_skipped(out, lybs->position[lybs->used - 1], (char *)&meta_buf, LYB_META_BYTES);
-    if (r < LYB_META_BYTES) {
+    r = ly_write_skipped(out, lybs->position[lybs->used - 1], (char *)&size_buf, LYB_SUBTREE_SIZE_BYTES);
+    if (r < LYB_SUBTREE_SIZE_BYTES) {
         return -1;
     }
 
@@ -420,30 +469,27 @@ lyb_write_stop_subtree(struct lyout *out, struct lyb_state *lybs)
 static int
 lyb_write_start_subtree(struct lyout *out, struct lyb_state *lybs)
 {
-    int i;
+    int r;
 
     if (lybs->used == lybs->size) {
         lybs->size += LYB_STATE_STEP;
         lybs->written = ly_realloc(lybs->written, lybs->size * sizeof *lybs->written);
         lybs->position = ly_realloc(lybs->position, lybs->size * sizeof *lybs->position);
-        lybs->inner_chunks = ly_realloc(lybs->inner_chunks, lybs->size * sizeof *lybs->inner_chunks);
-        LY_CHECK_ERR_RETURN(!lybs->written || !lybs->position || !lybs->inner_chunks, LOGMEM(lybs->ctx), -1);
+        LY_CHECK_ERR_RETURN(!lybs->written || !lybs->position, LOGMEM(lybs->ctx), -1);
     }
 
-    ++lybs->used;
-    lybs->written[lybs->used - 1] = 0;
-    lybs->inner_chunks[lybs->used - 1] = 0;
-
-    /* another inner chunk */
-    for (i = 0; i < lybs->used - 1; ++i) {
-        if (lybs->inner_chunks[i] == LYB_INCHUNK_MAX) {
-            LOGINT(lybs->ctx);
-            return -1;
-        }
-        ++lybs->inner_chunks[i];
+    /* skip space for the subtree size, it is known only once the subtree is written */
+    r = ly_write_skip(out, LYB_SUBTREE_SIZE_BYTES, &lybs->position[lybs->used]);
+    if (r < LYB_SUBTREE_SIZE_BYTES) {
+        return -1;
     }
+    lybs->offset += r;
+
+    /* the offset where the subtree starts */
+    lybs->written[lybs->used] = lybs->offset;
+    ++lybs->used;
 
-    return ly_write_skip(out, LYB_META_BYTES, &lybs->position[lybs->used - 1]);
+    return r;
 }
 
 static int
@@ -568,13 +614,36 @@ add_model(const struct lys_module ***models, size_t *mod_count, const struct lys
     (*models)[*mod_count - 1] = mod;
 }
 
+static int
+add_annot(struct lys_ext_instance_complex *annot, struct lyb_state *lybs)
+{
+    int i;
+
+    for (i = 0; i < lybs->annot_count; ++i) {
+        if (lybs->annots[i] == annot) {
+            return 0;
+        }
+    }
+
+    if (lybs->annot_count == UINT16_MAX) {
+        LOGERR(lybs->ctx, LY_EINT, "Maximum supported number of different annotations is %u.", UINT16_MAX);
+        return -1;
+    }
+
+    lybs->annots = ly_realloc(lybs->annots, ++lybs->annot_count * sizeof *lybs->annots);
+    LY_CHECK_ERR_RETURN(!lybs->annots, LOGMEM(lybs->ctx), -1);
+    lybs->annots[lybs->annot_count - 1] = annot;
+    return 0;
+}
+
 static int
 lyb_print_data_models(struct lyout *out, const struct lyd_node *root, struct lyb_state *lybs)
 {
-    int ret = 0;
+    int r, ret = 0;
     const struct lys_module **models = NULL, *mod;
     const struct lys_submodule *submod;
-    const struct lyd_node *node;
+    const struct lyd_node *node, *elem, *next;
+    const struct lyd_attr *attr;
     size_t mod_count = 0;
     uint32_t idx = 0, i, j;
 
@@ -626,14 +695,61 @@ next_mod:
         }
     }
 
+    /* collect all the used annotations, their models are referenced by the annotation table */
+    LY_TREE_FOR(root, node) {
+        LY_TREE_DFS_BEGIN(node, next, elem) {
+            LY_TREE_FOR(elem->attr, attr) {
+                if (add_annot(attr->annotation, lybs)) {
+                    ret = -1;
+                    goto finish;
+                }
+                add_model(&models, &mod_count, lys_main_module(attr->annotation->module));
+            }
+            LY_TREE_DFS_END(node, next, elem);
+        }
+    }
+
     /* now write module count on 2 bytes */
-    ret += lyb_write_number(mod_count, 2, out, lybs);
+    ret += (r = lyb_write_number(mod_count, 2, out, lybs));
+    if (r < 0) {
+        ret = -1;
+        goto finish;
+    }
 
     /* and all the used models */
     for (i = 0; i < mod_count; ++i) {
-        ret += lyb_print_model(out, models[i], lybs);
+        ret += (r = lyb_print_model(out, models[i], lybs));
+        if (r < 0) {
+            ret = -1;
+            goto finish;
+        }
+    }
+
+    /* annotation count on 2 bytes */
+    ret += (r = lyb_write_number(lybs->annot_count, 2, out, lybs));
+    if (r < 0) {
+        ret = -1;
+        goto finish;
+    }
+
+    /* and all the used annotations as their model index and name */
+    for (i = 0; i < (unsigned)lybs->annot_count; ++i) {
+        mod = lys_main_module(lybs->annots[i]->module);
+        for (j = 0; models[j] != mod; ++j);
+
+        ret += (r = lyb_write_number(j, 2, out, lybs));
+        if (r < 0) {
+            ret = -1;
+            goto finish;
+        }
+        ret += (r = lyb_write_string(lybs->annots[i]->arg_value, 0, 1, out, lybs));
+        if (r < 0) {
+            ret = -1;
+            goto finish;
+        }
     }
 
+finish:
     free(models);
     return ret;
 }
@@ -652,58 +768,109 @@ lyb_print_magic_number(struct lyout *out)
 }
 
 static int
-lyb_print_header(struct lyout *out)
+lyb_print_header(struct lyout *out, int options, uint8_t version)
 {
     int ret = 0;
     uint8_t byte = 0;
 
-    /* TODO version, some other flags? */
+    /* the rest of the data is compressed */
+    if (options & LYP_LYB_COMPRESS) {
+        byte |= LYB_HEADER_COMPRESSED;
+    }
+
+    /* the checksum block follows */
+    if (options & (LYP_LYB_CHECKSUM | LYP_LYB_VALIDATED)) {
+        byte |= LYB_HEADER_CHECKSUM;
+    }
+
+    /* schema hash algorithm version */
+    byte |= LYB_HASH_VERSION;
+
+    /* format version */
+    byte |= version;
+
     ret += ly_write(out, (char *)&byte, sizeof byte);
 
     return ret;
 }
 
+/* whether the printed trees have some user type values that may be encoded by their plugin */
 static int
-lyb_print_anydata(struct lyd_node_anydata *anydata, struct lyout *out, struct lyb_state *lybs)
+lyb_has_encoded_values(const struct lyd_node *root, int options)
+{
+    const struct lyd_node *next, *node;
+    const struct lyd_attr *attr;
+    struct lys_type **type;
+
+    LY_TREE_FOR(root, root) {
+        LY_TREE_DFS_BEGIN(root, next, node) {
+            if ((node->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST))
+                    && (((struct lyd_node_leaf_list *)node)->value_flags & LY_VALUE_USER)
+                    && lytype_can_encode(&((struct lys_node_leaf *)node->schema)->type)) {
+                return 1;
+            }
+            LY_TREE_FOR(node->attr, attr) {
+                if (attr->value_flags & LY_VALUE_USER) {
+                    type = (struct lys_type **)lys_ext_complex_get_substmt(LY_STMT_TYPE, attr->annotation, NULL);
+                    if (type && *type && lytype_can_encode(*type)) {
+                        return 1;
+                    }
+                }
+            }
+            LY_TREE_DFS_END(root, next, node);
+        }
+
+        if (!(options & LYP_WITHSIBLINGS)) {
+            break;
+        }
+    }
+
+    return 0;
+}
+
+static int
+lyb_print_anydata(const struct lyd_node_anydata *anydata, struct lyout *out, struct lyb_state *lybs)
 {
     int ret = 0, len;
-    char *buf;
+    char *buf = NULL;
+    LYD_ANYDATA_VALUETYPE value_type = anydata->value_type;
+    lyd_anydata_value value = anydata->value;
 
-    if (anydata->value_type == LYD_ANYDATA_XML) {
+    /* the transformed values are only temporary, printing never modifies the printed data */
+    if (value_type == LYD_ANYDATA_XML) {
         /* transform XML into CONSTSTRING */
-        lyxml_print_mem(&buf, anydata->value.xml, LYXML_PRINT_SIBLINGS);
-        lyxml_free(anydata->schema->module->ctx, anydata->value.xml);
+        lyxml_print_mem(&buf, value.xml, LYXML_PRINT_SIBLINGS);
 
-        anydata->value_type = LYD_ANYDATA_CONSTSTRING;
-        anydata->value.str = lydict_insert_zc(anydata->schema->module->ctx, buf);
-    } else if (anydata->value_type == LYD_ANYDATA_DATATREE) {
+        value_type = LYD_ANYDATA_CONSTSTRING;
+        value.str = buf;
+    } else if (value_type == LYD_ANYDATA_DATATREE) {
         /* print data tree into LYB */
-        lyd_print_mem(&buf, anydata->value.tree, LYD_LYB, LYP_WITHSIBLINGS);
-        lyd_free_withsiblings(anydata->value.tree);
+        lyd_print_mem(&buf, value.tree, LYD_LYB, LYP_WITHSIBLINGS);
 
-        anydata->value_type = LYD_ANYDATA_LYB;
-        anydata->value.mem = buf;
-    } else if (anydata->value_type & LYD_ANYDATA_STRING) {
+        value_type = LYD_ANYDATA_LYB;
+        value.mem = buf;
+    } else if (value_type & LYD_ANYDATA_STRING) {
         /* dynamic value, only used for input */
         LOGERR(lybs->ctx, LY_EINT, "Unsupported anydata value type to print.");
         return -1;
     }
 
     /* first byte is type */
-    ret += lyb_write(out, (uint8_t *)&anydata->value_type, sizeof anydata->value_type, lybs);
+    ret += lyb_write(out, (uint8_t *)&value_type, sizeof value_type, lybs);
 
     /* followed by the content */
-    if (anydata->value_type == LYD_ANYDATA_LYB) {
-        len = lyd_lyb_data_length(anydata->value.mem);
+    if (value_type == LYD_ANYDATA_LYB) {
+        len = lyd_lyb_data_length(value.mem);
         if (len > -1) {
-            ret += lyb_write_string(anydata->value.str, (size_t)len, 0, out, lybs);
+            ret += lyb_write_string(value.str, (size_t)len, 0, out, lybs);
         } else {
             ret = len;
         }
     } else {
-        ret += lyb_write_string(anydata->value.str, 0, 0, out, lybs);
+        ret += lyb_write_string(value.str, 0, 0, out, lybs);
     }
 
+    free(buf);
     return ret;
 }
 
@@ -713,7 +880,8 @@ lyb_print_value(const struct lys_type *type, const char *value_str, lyd_val valu
 {
     int ret = 0;
     uint8_t byte = 0;
-    size_t count, i, bits_i;
+    size_t count, i, bits_i, user_len = 0;
+    uint8_t user_buf[32], *user_data = NULL;
     LY_DATA_TYPE dtype;
 
     /* value type byte - ABCD DDDD
@@ -721,7 +889,7 @@ lyb_print_value(const struct lys_type *type, const char *value_str, lyd_val valu
      * A - dflt flag
      * B - user type flag
      * C - unres flag
-     * D (5b) - data type value
+     * D (5b) - data type value (LY_TYPE_BINARY for a user type value encoded by its plugin)
      */
     if (dflt) {
         byte |= 0x80;
@@ -736,12 +904,19 @@ lyb_print_value(const struct lys_type *type, const char *value_str, lyd_val valu
     /* we have only 5b available, must be enough */
     assert((value_type & 0x1f) == value_type);
 
+    if ((value_flags & LY_VALUE_USER) && (lybs->version >= LYB_VERSION_USER)) {
+        /* only values stored directly by their type plugin can be encoded */
+        user_data = lytype_encode(type, &value, user_buf, sizeof user_buf, &user_len);
+    }
+
     /* find actual type */
     while (type->base == LY_TYPE_LEAFREF) {
         type = &type->info.lref.target->type;
     }
 
-    if ((value_flags & LY_VALUE_USER) || (type->base == LY_TYPE_UNION)) {
+    if (user_data) {
+        value_type = LY_TYPE_BINARY;
+    } else if ((value_flags & LY_VALUE_USER) || (type->base == LY_TYPE_UNION)) {
         value_type = LY_TYPE_STRING;
     } else while (value_type == LY_TYPE_LEAFREF) {
         assert(!(value_flags & LY_VALUE_UNRES));
@@ -758,7 +933,14 @@ lyb_print_value(const struct lys_type *type, const char *value_str, lyd_val valu
     ret += lyb_write(out, &byte, sizeof byte, lybs);
 
     /* print value itself */
-    if (value_flags & LY_VALUE_USER) {
+    if (user_data) {
+        /* encoded value with its length */
+        ret += lyb_write_string((char *)user_data, user_len, 1, out, lybs);
+        if (user_data != user_buf) {
+            free(user_data);
+        }
+        return ret;
+    } else if (value_flags & LY_VALUE_USER) {
         dtype = LY_TYPE_STRING;
     } else {
         dtype = value_type;
@@ -847,7 +1029,7 @@ lyb_print_value(const struct lys_type *type, const char *value_str, lyd_val valu
 static int
 lyb_print_attributes(struct lyout *out, struct lyd_attr *attr, struct lyb_state *lybs)
 {
-    int r, ret = 0;
+    int r, ret = 0, i;
     uint8_t count;
     struct lyd_attr *iter;
     struct lys_type **type;
@@ -874,14 +1056,9 @@ lyb_print_attributes(struct lyout *out, struct lyd_attr *attr, struct lyb_state
             return -1;
         }
 
-        /* model */
-        ret += (r = lyb_print_model(out, iter->annotation->module, lybs));
-        if (r < 0) {
-            return -1;
-        }
-
-        /* annotation name with length */
-        ret += (r = lyb_write_string(iter->annotation->arg_value, 0, 1, out, lybs));
+        /* annotation index */
+        for (i = 0; lybs->annots[i] != iter->annotation; ++i);
+        ret += (r = lyb_write_number(i, LYB_ANNOT_INDEX_BYTES(lybs->annot_count), out, lybs));
         if (r < 0) {
             return -1;
         }
@@ -912,12 +1089,11 @@ static int
 lyb_print_schema_hash(struct lyout *out, struct lys_node *schema, struct hash_table **sibling_ht, struct lyb_state *lybs)
 {
     int r, ret = 0;
-    void *mem;
     uint32_t i;
     LYB_HASH hash;
     struct lys_node *first_sibling, *parent;
 
-    /* create whole sibling HT if not already created and saved */
+    /* get whole sibling HT if not already known */
     if (!*sibling_ht) {
         /* get first schema data sibling (or input/output) */
         for (parent = lys_parent(schema);
@@ -925,29 +1101,9 @@ lyb_print_schema_hash(struct lyout *out, struct lys_node *schema, struct hash_ta
              parent = lys_parent(parent));
 
         first_sibling = (struct lys_node *)lys_getnext(NULL, parent, lys_node_module(schema), 0);
-        for (r = 0; r < lybs->sib_ht_count; ++r) {
-            if (lybs->sib_ht[r].first_sibling == first_sibling) {
-                /* we have already created a hash table for these siblings */
-                *sibling_ht = lybs->sib_ht[r].ht;
-                break;
-            }
-        }
-
+        *sibling_ht = lyb_sibling_ht_get(lybs->ctx, first_sibling);
         if (!*sibling_ht) {
-            /* we must create sibling hash table */
-            *sibling_ht = lyb_hash_siblings(first_sibling, NULL, 0);
-            if (!*sibling_ht) {
-                return -1;
-            }
-
-            /* and save it */
-            ++lybs->sib_ht_count;
-            mem = realloc(lybs->sib_ht, lybs->sib_ht_count * sizeof *lybs->sib_ht);
-            LY_CHECK_ERR_RETURN(!mem, LOGMEM(lybs->ctx), -1);
-            lybs->sib_ht = mem;
-
-            lybs->sib_ht[lybs->sib_ht_count - 1].first_sibling = first_sibling;
-            lybs->sib_ht[lybs->sib_ht_count - 1].ht = *sibling_ht;
+            return -1;
         }
     }
 
@@ -995,6 +1151,8 @@ lyb_print_subtree(struct lyout *out, const struct lyd_node *node, struct hash_ta
     struct lyd_node_leaf_list *leaf;
     struct hash_table *child_ht = NULL;
 
+    ++ly_cnt.nodes_printed;
+
     /* register a new subtree */
     ret += (r = lyb_write_start_subtree(out, lybs));
     if (r < 0) {
@@ -1074,6 +1232,140 @@ lyb_print_subtree(struct lyout *out, const struct lyd_node *node, struct hash_ta
     return ret;
 }
 
+static void
+lyb_print_state_clean(struct lyb_state *lybs)
+{
+    free(lybs->written);
+    free(lybs->position);
+}
+
+static void
+lyb_print_state_free(void *state)
+{
+    lyb_print_state_clean(state);
+    free(state);
+}
+
+/* top-level subtrees are independent, only the subtree state is reused by each thread */
+static int
+lyb_print_unit(struct lyout *out, const struct lyd_node *node, uint32_t UNUSED(idx), void *arg, void **state)
+{
+    struct lyb_state *lybs = *state, *data_lybs = arg;
+    struct hash_table *top_sibling_ht = NULL;
+
+    if (!lybs) {
+        lybs = calloc(1, sizeof *lybs);
+        LY_CHECK_ERR_RETURN(!lybs, LOGMEM(lyd_node_module(node)->ctx), EXIT_FAILURE);
+        lybs->ctx = lyd_node_module(node)->ctx;
+        lybs->version = data_lybs->version;
+        /* the annotation table is shared */
+        lybs->annots = data_lybs->annots;
+        lybs->annot_count = data_lybs->annot_count;
+        *state = lybs;
+    }
+
+    if (lyb_print_subtree(out, node, &top_sibling_ht, lybs, 1) < 0) {
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+static int
+lyb_print_parallel(struct lyout *out, const struct lyd_node *root, struct lyb_state *lybs)
+{
+    const struct lyd_node *node, **units;
+    uint32_t count = 0;
+    int ret;
+
+    LY_TREE_FOR(root, node) {
+        ++count;
+    }
+    units = malloc(count * sizeof *units);
+    LY_CHECK_ERR_RETURN(!units, LOGMEM(lyd_node_module(root)->ctx), EXIT_FAILURE);
+
+    count = 0;
+    LY_TREE_FOR(root, node) {
+        units[count++] = node;
+    }
+
+    ret = ly_print_parallel(out, units, count, "", lyb_print_unit, lybs, lyb_print_state_free);
+    free(units);
+    return ret;
+}
+
+/* write the checksum block of the data following it, ctx is the context the data tree was validated in, if any */
+static int
+lyb_print_checksum(struct lyout *out, const char *data, size_t len, struct ly_ctx *ctx)
+{
+    uint32_t block[3];
+
+    if (len > UINT32_MAX) {
+        LOGERR(ctx, LY_EINVAL, "LYB data too long to be checksummed.");
+        return -1;
+    }
+
+    block[1] = htole32((uint32_t)len);
+    block[2] = htole32(ctx ? lyb_ctx_hash(ctx) : 0);
+    block[0] = htole32(ly_crc32c(ly_crc32c(0, &block[1], 2 * LYB_CHECKSUM_FIELD_BYTES), data, len));
+
+    return ly_write(out, (char *)block, LYB_CHECKSUM_BLOCK_BYTES);
+}
+
+#ifdef LY_ENABLED_LYB_COMPRESSION
+
+/* write the data following the LYB header as zlib blocks, return the number of bytes written */
+static int
+lyb_print_compressed(struct lyout *out, const char *data, size_t len, struct ly_ctx *ctx)
+{
+    int r, ret = 0;
+    size_t raw_len;
+    uLongf comp_len;
+    uint32_t block_lens[2];
+    Bytef *block;
+
+    block = malloc(compressBound(LYB_BLOCK_SIZE));
+    LY_CHECK_ERR_RETURN(!block, LOGMEM(ctx), -1);
+
+    do {
+        raw_len = (len > LYB_BLOCK_SIZE) ? LYB_BLOCK_SIZE : len;
+        comp_len = 0;
+        if (raw_len) {
+            comp_len = compressBound(LYB_BLOCK_SIZE);
+            if (compress2(block, &comp_len, (const Bytef *)data, raw_len, Z_BEST_SPEED) != Z_OK) {
+                LOGERR(ctx, LY_EINT, "Compressing LYB data failed.");
+                ret = -1;
+                break;
+            }
+        }
+
+        /* block lengths, only the zero raw length of the last one */
+        block_lens[0] = htole32((uint32_t)raw_len);
+        block_lens[1] = htole32((uint32_t)comp_len);
+        ret += (r = ly_write(out, (char *)block_lens, (raw_len ? 2 : 1) * LYB_BLOCK_LEN_BYTES));
+        if (r < 0) {
+            ret = -1;
+            break;
+        }
+
+        /* block data */
+        if (comp_len) {
+            ret += (r = ly_write(out, (char *)block, comp_len));
+            if (r < 0) {
+                ret = -1;
+                break;
+            }
+        }
+
+        data += raw_len;
+        len -= raw_len;
+    } while (raw_len);
+
+    free(block);
+    return ret;
+}
+
+#endif
+
 int
 lyb_print_data(struct lyout *out, const struct lyd_node *root, int options)
 {
@@ -1083,8 +1375,11 @@ lyb_print_data(struct lyout *out, const struct lyd_node *root, int options)
     const struct lys_module *prev_mod = NULL;
     struct lys_node *parent;
     struct lyb_state lybs;
+    struct lyout raw, comp, *data_out = out, *payload;
 
     memset(&lybs, 0, sizeof lybs);
+    memset(&raw, 0, sizeof raw);
+    memset(&comp, 0, sizeof comp);
 
     if (root) {
         lybs.ctx = lyd_node_module(root)->ctx;
@@ -1096,6 +1391,19 @@ lyb_print_data(struct lyout *out, const struct lyd_node *root, int options)
         }
     }
 
+#ifndef LY_ENABLED_LYB_COMPRESSION
+    if (options & LYP_LYB_COMPRESS) {
+        LOGERR(lybs.ctx, LY_EINVAL, "Compressed LYB data are not supported (libyang built without zlib).");
+        return EXIT_FAILURE;
+    }
+#endif
+
+    if (options & (LYP_LYB_COMPRESS | LYP_LYB_CHECKSUM | LYP_LYB_VALIDATED)) {
+        /* everything after the header is printed into memory first, then compressed and/or checksummed */
+        raw.type = LYOUT_MEMORY;
+        data_out = &raw;
+    }
+
     /* LYB magic number */
     ret += (r = lyb_print_magic_number(out));
     if (r < 0) {
@@ -1103,52 +1411,87 @@ lyb_print_data(struct lyout *out, const struct lyd_node *root, int options)
         goto finish;
     }
 
-    /* LYB header */
-    ret += (r = lyb_print_header(out));
+    /* LYB header, the older format version if no value is encoded by a plugin so that older readers accept it */
+    lybs.version = lyb_has_encoded_values(root, options) ? LYB_VERSION_USER : LYB_VERSION_ANNOTS;
+    ret += (r = lyb_print_header(out, options, lybs.version));
     if (r < 0) {
         rc = EXIT_FAILURE;
         goto finish;
     }
 
     /* all used models */
-    ret += (r = lyb_print_data_models(out, root, &lybs));
+    ret += (r = lyb_print_data_models(data_out, root, &lybs));
     if (r < 0) {
         rc = EXIT_FAILURE;
         goto finish;
     }
 
-    LY_TREE_FOR(root, root) {
-        /* do not reuse sibling hash tables from different modules */
-        if (lyd_node_module(root) != prev_mod) {
-            top_sibling_ht = NULL;
-            prev_mod = lyd_node_module(root);
-        }
-
-        ret += (r = lyb_print_subtree(out, root, &top_sibling_ht, &lybs, 1));
-        if (r < 0) {
+    if (root && (options & LYP_PARALLEL) && (options & LYP_WITHSIBLINGS)) {
+        if (lyb_print_parallel(data_out, root, &lybs)) {
             rc = EXIT_FAILURE;
             goto finish;
         }
+    } else {
+        LY_TREE_FOR(root, root) {
+            /* do not reuse sibling hash tables from different modules */
+            if (lyd_node_module(root) != prev_mod) {
+                top_sibling_ht = NULL;
+                prev_mod = lyd_node_module(root);
+            }
 
-        if (!(options & LYP_WITHSIBLINGS)) {
-            break;
+            ret += (r = lyb_print_subtree(data_out, root, &top_sibling_ht, &lybs, 1));
+            if (r < 0) {
+                rc = EXIT_FAILURE;
+                goto finish;
+            }
+
+            if (!(options & LYP_WITHSIBLINGS)) {
+                break;
+            }
         }
     }
 
     /* ending zero byte */
-    ret += (r = lyb_write(out, &zero, sizeof zero, &lybs));
+    ret += (r = lyb_write(data_out, &zero, sizeof zero, &lybs));
     if (r < 0) {
         rc = EXIT_FAILURE;
+        goto finish;
     }
 
-finish:
-    free(lybs.written);
-    free(lybs.position);
-    free(lybs.inner_chunks);
-    for (r = 0; r < lybs.sib_ht_count; ++r) {
-        lyht_free(lybs.sib_ht[r].ht);
+    if (data_out == &raw) {
+        payload = &raw;
+#ifdef LY_ENABLED_LYB_COMPRESSION
+        if (options & LYP_LYB_COMPRESS) {
+            comp.type = LYOUT_MEMORY;
+            if (lyb_print_compressed(&comp, raw.method.mem.buf, raw.method.mem.len, lybs.ctx) < 0) {
+                rc = EXIT_FAILURE;
+                goto finish;
+            }
+            payload = &comp;
+        }
+#endif
+
+        if (options & (LYP_LYB_CHECKSUM | LYP_LYB_VALIDATED)) {
+            ret += (r = lyb_print_checksum(out, payload->method.mem.buf, payload->method.mem.len,
+                                           (options & LYP_LYB_VALIDATED) ? lybs.ctx : NULL));
+            if (r < 0) {
+                rc = EXIT_FAILURE;
+                goto finish;
+            }
+        }
+
+        ret += (r = ly_write(out, payload->method.mem.buf, payload->method.mem.len));
+        if (r < 0) {
+            rc = EXIT_FAILURE;
+        }
     }
-    free(lybs.sib_ht);
 
+finish:
+    lyb_print_state_clean(&lybs);
+    free(lybs.annots);
+    free(raw.method.mem.buf);
+    free(raw.buffered);
+    free(comp.method.mem.buf);
+    free(comp.buffered);
     return rc;
 }
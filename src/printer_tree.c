@@ -46,6 +46,8 @@ typedef struct {
     int spec_config;                 /**< special config flags - 0 (no special config status),
                                           1 (read-only - rpc output, notification), 2 (write-only - rpc input) */
     int options;                     /**< user-specified tree printer options */
+    struct lyout text;               /**< memory output of the type, keys and if-features text being printed,
+                                          reused for all the nodes */
 } tp_opts;
 
 static void tree_print_snode(struct lyout *out, int level, uint16_t max_name_len, const struct lys_node *node, int mask,
@@ -54,20 +56,34 @@ static void tree_print_snode(struct lyout *out, int level, uint16_t max_name_len
 static int
 tree_print_indent(struct lyout *out, int level, tp_opts *opts)
 {
-    int i, ret = 0;
+    /* the whole indent is written at once, the level is at most 64 (see tree_next_indent()) */
+    char buf[UINT8_MAX + 65 * 3];
+    int i, len;
 
-    if (opts->base_indent) {
-        ret += ly_print(out, "%*s", opts->base_indent, " ");
-    }
+    len = opts->base_indent;
+    memset(buf, ' ', len);
     for (i = 0; i < level; ++i) {
-        if (opts->indent & (1 << i)) {
-            ret += ly_print(out, "|  ");
+        if (opts->indent & (1ULL << i)) {
+            memcpy(buf + len, "|  ", 3);
         } else {
-            ret += ly_print(out, "   ");
+            memcpy(buf + len, "   ", 3);
         }
+        len += 3;
     }
 
-    return ret;
+    return ly_write(out, buf, len);
+}
+
+/* start printing a new text into the reused memory output */
+static struct lyout *
+tree_text_start(tp_opts *opts)
+{
+    opts->text.type = LYOUT_MEMORY;
+    opts->text.method.mem.len = 0;
+    if (opts->text.method.mem.buf) {
+        opts->text.method.mem.buf[0] = '\0';
+    }
+    return &opts->text;
 }
 
 static int
@@ -192,8 +208,8 @@ tree_get_max_name_len(const struct lys_node *sibling, const struct lys_node *aug
             continue;
         }
         if (aug_parent && (sub->parent != aug_parent)) {
-            /* when printing augment children, skip other target children */
-            continue;
+            /* when printing augment children, the other target children follow them */
+            break;
         }
         if (!(sub->nodetype & type_mask)) {
             /* this sibling will not be printed */
@@ -300,76 +316,34 @@ tree_print_prefix(struct lyout *out, const struct lys_node *node, tp_opts *opts)
 }
 
 static int
-tree_print_type(struct lyout *out, const struct lys_type *type, int options, const char **out_str)
+tree_print_type(const struct lys_type *type, tp_opts *opts)
 {
     struct lys_module *type_mod = ((struct lys_tpdf *)type->parent)->module;
+    struct lyout *o;
     const char *str;
-    char *tmp;
     int printed;
 
+    o = tree_text_start(opts);
     if ((type->base == LY_TYPE_LEAFREF) && !type->der->module) {
-        if (options & LYS_OUTOPT_TREE_NO_LEAFREF) {
-            if (out_str) {
-                printed = 7;
-                *out_str = lydict_insert(type_mod->ctx, "leafref", printed);
-            } else {
-                printed = ly_print(out, "leafref");
-            }
+        if (opts->options & LYS_OUTOPT_TREE_NO_LEAFREF) {
+            printed = ly_print(o, "leafref");
+        } else if (opts->options & LYS_OUTOPT_TREE_RFC) {
+            str = transform_json2schema(type_mod, type->info.lref.path);
+            LY_CHECK_RETURN(!str, 0);
+            printed = ly_print(o, "-> %s", str);
+            lydict_remove(type_mod->ctx, str);
         } else {
-            if (options & LYS_OUTOPT_TREE_RFC) {
-                str = transform_json2schema(type_mod, type->info.lref.path);
-                if (out_str) {
-                    printed = 3 + strlen(str);
-                    tmp = malloc(printed + 1);
-                    LY_CHECK_ERR_RETURN(!tmp, LOGMEM(type_mod->ctx), 0);
-                    sprintf(tmp, "-> %s", str);
-                    *out_str = lydict_insert_zc(type_mod->ctx, tmp);
-                } else {
-                    printed = ly_print(out, "-> %s", str);
-                }
-                lydict_remove(type_mod->ctx, str);
-            } else {
-                if (out_str) {
-                    printed = 3 + strlen(type->info.lref.path);
-                    tmp = malloc(printed + 1);
-                    LY_CHECK_ERR_RETURN(!tmp, LOGMEM(type_mod->ctx), 0);
-                    sprintf(tmp, "-> %s", type->info.lref.path);
-                    *out_str = lydict_insert_zc(type_mod->ctx, tmp);
-                } else {
-                    printed = ly_print(out, "-> %s", type->info.lref.path);
-                }
-            }
+            printed = ly_print(o, "-> %s", type->info.lref.path);
         }
     } else if (!lys_type_is_local(type)) {
-        if (options & LYS_OUTOPT_TREE_RFC) {
+        if (opts->options & LYS_OUTOPT_TREE_RFC) {
             str = transform_module_name2import_prefix(type_mod, type->der->module->name);
-            if (out_str) {
-                printed = strlen(str) + 1 + strlen(type->der->name);
-                tmp = malloc(printed + 1);
-                LY_CHECK_ERR_RETURN(!tmp, LOGMEM(type_mod->ctx), 0);
-                sprintf(tmp, "%s:%s", str, type->der->name);
-                *out_str = lydict_insert_zc(type_mod->ctx, tmp);
-            } else {
-                printed = ly_print(out, "%s:%s", str, type->der->name);
-            }
+            printed = ly_print(o, "%s:%s", str, type->der->name);
         } else {
-            if (out_str) {
-                printed = strlen(type->der->module->name) + 1 + strlen(type->der->name);
-                tmp = malloc(printed + 1);
-                LY_CHECK_ERR_RETURN(!tmp, LOGMEM(type_mod->ctx), 0);
-                sprintf(tmp, "%s:%s", type->der->module->name, type->der->name);
-                *out_str = lydict_insert_zc(type_mod->ctx, tmp);
-            } else {
-                printed = ly_print(out, "%s:%s", type->der->module->name, type->der->name);
-            }
+            printed = ly_print(o, "%s:%s", type->der->module->name, type->der->name);
         }
     } else {
-        if (out_str) {
-            printed = strlen(type->der->name);
-            *out_str = lydict_insert(type_mod->ctx, type->der->name, printed);
-        } else {
-            printed = ly_print(out, "%s", type->der->name);
-        }
+        printed = ly_print(o, "%s", type->der->name);
     }
 
     return printed;
@@ -409,8 +383,8 @@ tree_print_config(struct lyout *out, const struct lys_node *node, int spec_confi
 }
 
 static int
-tree_print_features(struct lyout *out, struct lys_iffeature *iff1, uint8_t iff1_size, struct lys_iffeature *iff2,
-                    uint8_t iff2_size, tp_opts *opts, const char **out_str)
+tree_print_features(struct lys_iffeature *iff1, uint8_t iff1_size, struct lys_iffeature *iff2, uint8_t iff2_size,
+                    tp_opts *opts)
 {
     int i, printed;
     struct lyout *o;
@@ -419,17 +393,7 @@ tree_print_features(struct lyout *out, struct lys_iffeature *iff1, uint8_t iff1_
         return 0;
     }
 
-    if (out_str) {
-        o = malloc(sizeof *o);
-        LY_CHECK_ERR_RETURN(!o, LOGMEM(NULL), 0);
-        o->type = LYOUT_MEMORY;
-        o->method.mem.buf = NULL;
-        o->method.mem.len = 0;
-        o->method.mem.size = 0;
-    } else {
-        o = out;
-    }
-
+    o = tree_text_start(opts);
     printed = ly_print(o, "{");
     for (i = 0; i < iff1_size; i++) {
         if (i > 0) {
@@ -445,16 +409,11 @@ tree_print_features(struct lyout *out, struct lys_iffeature *iff1, uint8_t iff1_
     }
     printed += ly_print(o, "}?");
 
-    if (out_str) {
-        *out_str = lydict_insert_zc(opts->module->ctx, o->method.mem.buf);
-        free(o);
-    }
-
     return printed;
 }
 
 static int
-tree_print_keys(struct lyout *out, struct lys_node_leaf **keys, uint8_t keys_size, tp_opts *opts, const char **out_str)
+tree_print_keys(struct lys_node_leaf **keys, uint8_t keys_size, tp_opts *opts)
 {
     int i, printed;
     struct lyout *o;
@@ -463,27 +422,12 @@ tree_print_keys(struct lyout *out, struct lys_node_leaf **keys, uint8_t keys_siz
         return 0;
     }
 
-    if (out_str) {
-        o = malloc(sizeof *o);
-        LY_CHECK_ERR_RETURN(!o, LOGMEM(NULL), 0);
-        o->type = LYOUT_MEMORY;
-        o->method.mem.buf = NULL;
-        o->method.mem.len = 0;
-        o->method.mem.size = 0;
-    } else {
-        o = out;
-    }
-
+    o = tree_text_start(opts);
     printed = ly_print(o, "[");
     for (i = 0; i < keys_size; i++) {
         printed += ly_print(o, "%s%s", keys[i]->name, i + 1 < keys_size ? " " : "]");
     }
 
-    if (out_str) {
-        *out_str = lydict_insert_zc(opts->module->ctx, o->method.mem.buf);
-        free(o);
-    }
-
     return printed;
 }
 
@@ -548,7 +492,7 @@ tree_print_snode(struct lyout *out, int level, uint16_t max_name_len, const stru
     /* print optionally prefix */
     node_len = tree_print_prefix(out, node, opts);
     /* print name */
-    node_len += ly_print(out, node->name);
+    node_len += ly_write(out, node->name, strlen(node->name));
 
     /* print one-character opts */
     switch (node->nodetype & mask) {
@@ -603,10 +547,9 @@ tree_print_snode(struct lyout *out, int level, uint16_t max_name_len, const stru
     case LYS_LEAFLIST:
         assert(max_name_len);
         text_indent = LY_TREE_TYPE_INDENT + (uint8_t)(max_name_len - node_len);
-        text_len = tree_print_type(out, &((struct lys_node_leaf *)node)->type, opts->options, &text_str);
+        text_len = tree_print_type(&((struct lys_node_leaf *)node)->type, opts);
         line_len = tree_print_wrap(out, level, line_len, text_indent, text_len, opts);
-        line_len += ly_print(out, text_str);
-        lydict_remove(opts->module->ctx, text_str);
+        line_len += ly_write(out, opts->text.method.mem.buf, opts->text.method.mem.len);
         break;
     case LYS_ANYDATA:
         assert(max_name_len);
@@ -621,12 +564,10 @@ tree_print_snode(struct lyout *out, int level, uint16_t max_name_len, const stru
         line_len += ly_print(out, "anyxml");
         break;
     case LYS_LIST:
-        text_len = tree_print_keys(out, ((struct lys_node_list *)node)->keys, ((struct lys_node_list *)node)->keys_size,
-                                   opts, &text_str);
+        text_len = tree_print_keys(((struct lys_node_list *)node)->keys, ((struct lys_node_list *)node)->keys_size, opts);
         if (text_len) {
             line_len = tree_print_wrap(out, level, line_len, 1, text_len, opts);
-            line_len += ly_print(out, text_str);
-            lydict_remove(opts->module->ctx, text_str);
+            line_len += ly_write(out, opts->text.method.mem.buf, opts->text.method.mem.len);
         }
         break;
     default:
@@ -671,15 +612,14 @@ tree_print_snode(struct lyout *out, int level, uint16_t max_name_len, const stru
     case LYS_USES:
         if (node->parent && (node->parent->nodetype == LYS_AUGMENT)) {
             /* if-features from an augment are de facto inherited */
-            text_len = tree_print_features(out, node->iffeature, node->iffeature_size,
-                                           node->parent->iffeature, node->parent->iffeature_size, opts, &text_str);
+            text_len = tree_print_features(node->iffeature, node->iffeature_size, node->parent->iffeature,
+                                           node->parent->iffeature_size, opts);
         } else {
-            text_len = tree_print_features(out, node->iffeature, node->iffeature_size, NULL, 0, opts, &text_str);
+            text_len = tree_print_features(node->iffeature, node->iffeature_size, NULL, 0, opts);
         }
         if (text_len) {
             line_len = tree_print_wrap(out, level, line_len, 1, text_len, opts);
-            line_len += ly_print(out, text_str);
-            lydict_remove(opts->module->ctx, text_str);
+            line_len += ly_write(out, opts->text.method.mem.buf, opts->text.method.mem.len);
         }
         break;
     default:
@@ -914,6 +854,7 @@ tree_print_model(struct lyout *out, const struct lys_module *module, const char
     if (target_schema_path) {
         opts.base_indent = LY_TREE_MOD_DATA_INDENT;
         tree_print_subtree(out, node, &opts);
+        free(opts.text.method.mem.buf);
         return EXIT_SUCCESS;
     }
 
@@ -981,9 +922,10 @@ tree_print_model(struct lyout *out, const struct lys_module *module, const char
                | LYS_ACTION | LYS_NOTIF;
         max_child_len = tree_get_max_name_len(aug->child, aug, mask, &opts);
         LY_TREE_FOR(aug->child, node) {
-            /* submodule, foreign augments */
+            /* the augment children are direct siblings followed by the other children of the target, do not
+             * walk through all of them for every augment */
             if (node->parent != aug) {
-                continue;
+                break;
             }
             tree_print_snode(out, 0, max_child_len, node, mask, aug, 0, &opts);
         }
@@ -1020,6 +962,7 @@ tree_print_model(struct lyout *out, const struct lys_module *module, const char
     }
 
     ly_print_flush(out);
+    free(opts.text.method.mem.buf);
 
     return EXIT_SUCCESS;
 }
@@ -22,6 +22,7 @@
 #include <inttypes.h>
 
 #include "common.h"
+#include "hash_table.h"
 #include "parser.h"
 #include "printer.h"
 #include "xml_internal.h"
@@ -33,52 +34,80 @@
 #define INDENT ""
 #define LEVEL (level ? level*2-2 : 0)
 
+/* modules whose namespaces are printed for a top-level node */
 struct mlist {
-    struct mlist *next;
-    struct lys_module *module;
-    uint8_t printed;
+    struct hash_table *ht;          /* added modules, created for the first one */
+    struct lys_module **modules;    /* added modules in the order of adding */
+    uint32_t count;
+    uint32_t printed;               /* number of the first modules whose namespace was already printed */
 };
 
 static int
-modlist_add(struct mlist **mlist, const struct lys_module *mod)
+modlist_equal(void *val1_p, void *val2_p, int UNUSED(mod), void *UNUSED(cb_data))
 {
-    struct mlist *iter;
+    return *(struct lys_module **)val1_p == *(struct lys_module **)val2_p;
+}
 
-    for (iter = *mlist; iter; iter = iter->next) {
-        if (mod == iter->module) {
-            break;
-        }
+static int
+modlist_add(struct mlist *mlist, const struct lys_module *mod)
+{
+    struct lys_module **modules;
+    uint32_t hash;
+    int r;
+
+    if (!mlist->ht) {
+        mlist->ht = lyht_new(8, sizeof mod, modlist_equal, NULL, 1);
+        LY_CHECK_ERR_RETURN(!mlist->ht, LOGMEM(mod->ctx), EXIT_FAILURE);
     }
 
-    if (!iter) {
-        iter = malloc(sizeof *iter);
-        LY_CHECK_ERR_RETURN(!iter, LOGMEM(mod->ctx), EXIT_FAILURE);
-        iter->next = *mlist;
-        iter->module = (struct lys_module *)mod;
-        iter->printed = 0;
-        *mlist = iter;
+    hash = dict_hash_multi(0, (const char *)&mod, sizeof mod);
+    hash = dict_hash_multi(hash, NULL, 0);
+    r = lyht_insert(mlist->ht, &mod, hash, NULL);
+    if (r == 1) {
+        /* already added */
+        return EXIT_SUCCESS;
     }
+    LY_CHECK_ERR_RETURN(r, LOGMEM(mod->ctx), EXIT_FAILURE);
+
+    if (!(mlist->count & (mlist->count - 1))) {
+        /* count is 0 or a power of 2 */
+        modules = realloc(mlist->modules, (mlist->count ? mlist->count * 2 : 1) * sizeof *modules);
+        LY_CHECK_ERR_RETURN(!modules, LOGMEM(mod->ctx), EXIT_FAILURE);
+        mlist->modules = modules;
+    }
+    mlist->modules[mlist->count++] = (struct lys_module *)mod;
 
     return EXIT_SUCCESS;
 }
 
 static void
-free_mlist(struct mlist **mlist) {
-    struct mlist *miter;
-    while (*mlist) {
-        miter = *mlist;
-        *mlist = miter->next;
-        free(miter);
+free_mlist(struct mlist *mlist) {
+    lyht_free(mlist->ht);
+    free(mlist->modules);
+    memset(mlist, 0, sizeof *mlist);
+}
+
+/* print a dictionary string (or its suffix) as XML text */
+static void
+xml_print_dict_text(struct lyout *out, const char *text, LYXML_DATA_TYPE type)
+{
+    size_t len = strlen(text);
+
+    if (lydict_plain(text, len)) {
+        /* nothing to escape */
+        ly_write(out, text, len);
+    } else {
+        lyxml_dump_text(out, text, type);
     }
 }
 
 static void
-xml_print_ns(struct lyout *out, const struct lyd_node *node, struct mlist **mlist, int options)
+xml_print_ns(struct lyout *out, const struct lyd_node *node, struct mlist *mlist, int options)
 {
     struct lyd_node *next, *cur, *node2;
     struct lyd_attr *attr;
     const struct lys_module *wdmod = NULL;
-    struct mlist *miter;
+    uint32_t i;
     int r;
 
     assert(out);
@@ -147,16 +176,11 @@ xml_print_ns(struct lyout *out, const struct lyd_node *node, struct mlist **mlis
     }
 
 print:
-    /* print used namespaces */
-    miter = *mlist;
-    while (miter) {
-
-        if (!miter->printed) {
-            ly_print(out, " xmlns:%s=\"%s\"", miter->module->prefix, miter->module->ns);
-            miter->printed = 1;
-        }
-        miter = miter->next;
+    /* print used namespaces, the most recently added first */
+    for (i = mlist->count; i > mlist->printed; --i) {
+        ly_print(out, " xmlns:%s=\"%s\"", mlist->modules[i - 1]->prefix, mlist->modules[i - 1]->ns);
     }
+    mlist->printed = mlist->count;
 }
 
 static int
@@ -231,7 +255,7 @@ xml_print_attrs(struct lyout *out, const struct lyd_node *node, int options)
         case LY_TYPE_UINT64:
             if (attr->value_str) {
                 /* xml_expr can contain transformed xpath */
-                lyxml_dump_text(out, xml_expr ? xml_expr : attr->value_str, LYXML_DATA_ATTR);
+                xml_print_dict_text(out, xml_expr ? xml_expr : attr->value_str, LYXML_DATA_ATTR);
             }
             break;
 
@@ -244,7 +268,7 @@ xml_print_attrs(struct lyout *out, const struct lyd_node *node, int options)
             len = p - attr->value_str;
             mod_name = attr->annotation->module->name;
             if (!strncmp(attr->value_str, mod_name, len) && !mod_name[len]) {
-                lyxml_dump_text(out, ++p, LYXML_DATA_ATTR);
+                xml_print_dict_text(out, ++p, LYXML_DATA_ATTR);
             } else {
                 /* avoid code duplication - use instance-identifier printer which gets necessary namespaces to print */
                 goto printinst;
@@ -265,7 +289,7 @@ printinst:
             free(prefs);
             free(nss);
 
-            lyxml_dump_text(out, xml_expr, LYXML_DATA_ATTR);
+            xml_print_dict_text(out, xml_expr, LYXML_DATA_ATTR);
             lydict_remove(node->schema->module->ctx, xml_expr);
             break;
 
@@ -289,13 +313,27 @@ printinst:
     LY_PRINT_RET(node->schema->module->ctx);
 }
 
+/* print the start of the opening tag, with the default namespace if \p ns is set */
+static void
+xml_print_elem_start(struct lyout *out, int level, const struct lys_node *schema, int ns)
+{
+    if (ns) {
+        /* print "namespace" */
+        ly_print(out, "%*s<%s xmlns=\"%s\"", LEVEL, INDENT, schema->name, lys_node_module(schema)->ns);
+    } else {
+        ly_print(out, "%*s<%s", LEVEL, INDENT, schema->name);
+    }
+}
+
+/* print the rest of a leaf element following its name and attributes */
 static int
-xml_print_leaf(struct lyout *out, int level, const struct lyd_node *node, int toplevel, int options)
+xml_print_leaf_value(struct lyout *out, const struct lyd_node_leaf_list *leaf)
 {
-    const struct lyd_node_leaf_list *leaf = (struct lyd_node_leaf_list *)node, *iter;
+    const struct lyd_node *node = (struct lyd_node *)leaf;
+    const struct lyd_node_leaf_list *iter;
     const struct lys_type *type;
     struct lys_tpdf *tpdf;
-    const char *ns, *mod_name;
+    const char *mod_name;
     const char **prefs, **nss;
     const char *xml_expr;
     uint32_t ns_count, i;
@@ -303,26 +341,7 @@ xml_print_leaf(struct lyout *out, int level, const struct lyd_node *node, int to
     char *p;
     size_t len;
     enum int_log_opts prev_ilo;
-    struct mlist *mlist = NULL;
-
-    LY_PRINT_SET;
-
-    if (toplevel || !node->parent || nscmp(node, node->parent)) {
-        /* print "namespace" */
-        ns = lyd_node_module(node)->ns;
-        ly_print(out, "%*s<%s xmlns=\"%s\"", LEVEL, INDENT, node->schema->name, ns);
-    } else {
-        ly_print(out, "%*s<%s", LEVEL, INDENT, node->schema->name);
-    }
-
-    if (toplevel) {
-        xml_print_ns(out, node, &mlist, options);
-        free_mlist(&mlist);
-    }
 
-    if (xml_print_attrs(out, node, options)) {
-        return EXIT_FAILURE;
-    }
     datatype = leaf->value_type;
 
 printvalue:
@@ -361,7 +380,7 @@ printvalue:
             ly_print(out, "/>");
         } else {
             ly_print(out, ">");
-            lyxml_dump_text(out, leaf->value_str, LYXML_DATA_ELEM);
+            xml_print_dict_text(out, leaf->value_str, LYXML_DATA_ELEM);
             ly_print(out, "</%s>", node->schema->name);
         }
         break;
@@ -377,7 +396,7 @@ printvalue:
         mod_name = leaf->schema->module->name;
         if (!strncmp(leaf->value_str, mod_name, len) && !mod_name[len]) {
             ly_print(out, ">");
-            lyxml_dump_text(out, ++p, LYXML_DATA_ELEM);
+            xml_print_dict_text(out, ++p, LYXML_DATA_ELEM);
             ly_print(out, "</%s>", node->schema->name);
         } else {
             /* avoid code duplication - use instance-identifier printer which gets necessary namespaces to print */
@@ -386,8 +405,8 @@ printvalue:
         }
         break;
     case LY_TYPE_INST:
-        xml_expr = transform_json2xml(node->schema->module, ((struct lyd_node_leaf_list *)node)->value_str, 1,
-                                      &prefs, &nss, &ns_count);
+        xml_expr = resolve_instid_json2xml(node->schema->module, ((struct lyd_node_leaf_list *)node)->value_str,
+                                           &prefs, &nss, &ns_count);
         if (!xml_expr) {
             /* error */
             return EXIT_FAILURE;
@@ -401,7 +420,7 @@ printvalue:
 
         if (xml_expr[0]) {
             ly_print(out, ">");
-            lyxml_dump_text(out, xml_expr, LYXML_DATA_ELEM);
+            xml_print_dict_text(out, xml_expr, LYXML_DATA_ELEM);
             ly_print(out, "</%s>", node->schema->name);
         } else {
             ly_print(out, "/>");
@@ -439,6 +458,31 @@ printvalue:
         return EXIT_FAILURE;
     }
 
+    return EXIT_SUCCESS;
+}
+
+static int
+xml_print_leaf(struct lyout *out, int level, const struct lyd_node *node, int toplevel, int options)
+{
+    struct mlist mlist = {NULL, NULL, 0, 0};
+
+    LY_PRINT_SET;
+
+    xml_print_elem_start(out, level, node->schema, toplevel || !node->parent || nscmp(node, node->parent));
+
+    if (toplevel) {
+        xml_print_ns(out, node, &mlist, options);
+        free_mlist(&mlist);
+    }
+
+    if (xml_print_attrs(out, node, options)) {
+        return EXIT_FAILURE;
+    }
+
+    if (xml_print_leaf_value(out, (struct lyd_node_leaf_list *)node)) {
+        return EXIT_FAILURE;
+    }
+
     if (level) {
         ly_print(out, "\n");
     }
@@ -450,18 +494,11 @@ static int
 xml_print_container(struct lyout *out, int level, const struct lyd_node *node, int toplevel, int options)
 {
     struct lyd_node *child;
-    const char *ns;
-    struct mlist *mlist = NULL;
+    struct mlist mlist = {NULL, NULL, 0, 0};
 
     LY_PRINT_SET;
 
-    if (toplevel || !node->parent || nscmp(node, node->parent)) {
-        /* print "namespace" */
-        ns = lyd_node_module(node)->ns;
-        ly_print(out, "%*s<%s xmlns=\"%s\"", LEVEL, INDENT, node->schema->name, ns);
-    } else {
-        ly_print(out, "%*s<%s", LEVEL, INDENT, node->schema->name);
-    }
+    xml_print_elem_start(out, level, node->schema, toplevel || !node->parent || nscmp(node, node->parent));
 
     if (toplevel) {
         xml_print_ns(out, node, &mlist, options);
@@ -494,20 +531,13 @@ static int
 xml_print_list(struct lyout *out, int level, const struct lyd_node *node, int is_list, int toplevel, int options)
 {
     struct lyd_node *child;
-    const char *ns;
-    struct mlist *mlist = NULL;
+    struct mlist mlist = {NULL, NULL, 0, 0};
 
     LY_PRINT_SET;
 
     if (is_list) {
         /* list print */
-        if (toplevel || !node->parent || nscmp(node, node->parent)) {
-            /* print "namespace" */
-            ns = lyd_node_module(node)->ns;
-            ly_print(out, "%*s<%s xmlns=\"%s\"", LEVEL, INDENT, node->schema->name, ns);
-        } else {
-            ly_print(out, "%*s<%s", LEVEL, INDENT, node->schema->name);
-        }
+        xml_print_elem_start(out, level, node->schema, toplevel || !node->parent || nscmp(node, node->parent));
 
         if (toplevel) {
             xml_print_ns(out, node, &mlist, options);
@@ -544,19 +574,14 @@ xml_print_anydata(struct lyout *out, int level, const struct lyd_node *node, int
 {
     char *buf;
     struct lyd_node_anydata *any = (struct lyd_node_anydata *)node;
-    struct lyd_node *iter;
-    const char *ns;
-    struct mlist *mlist = NULL;
+    struct lyd_node *iter, *tree = NULL;
+    struct mlist mlist = {NULL, NULL, 0, 0};
+    LYD_ANYDATA_VALUETYPE value_type;
+    lyd_anydata_value value;
 
     LY_PRINT_SET;
 
-    if (toplevel || !node->parent || nscmp(node, node->parent)) {
-        /* print "namespace" */
-        ns = lyd_node_module(node)->ns;
-        ly_print(out, "%*s<%s xmlns=\"%s\"", LEVEL, INDENT, node->schema->name, ns);
-    } else {
-        ly_print(out, "%*s<%s", LEVEL, INDENT, node->schema->name);
-    }
+    xml_print_elem_start(out, level, node->schema, toplevel || !node->parent || nscmp(node, node->parent));
 
     if (toplevel) {
         xml_print_ns(out, node, &mlist, options);
@@ -567,21 +592,24 @@ xml_print_anydata(struct lyout *out, int level, const struct lyd_node *node, int
     if (!(void*)any->value.tree || (any->value_type == LYD_ANYDATA_CONSTSTRING && !any->value.str[0])) {
         /* no content */
         ly_print(out, "/>%s", level ? "\n" : "");
+        free_mlist(&mlist);
     } else {
-        if (any->value_type == LYD_ANYDATA_LYB) {
-            /* parse into a data tree */
-            iter = lyd_parse_mem(node->schema->module->ctx, any->value.mem, LYD_LYB, LYD_OPT_DATA | LYD_OPT_STRICT
+        value_type = any->value_type;
+        value = any->value;
+        if (value_type == LYD_ANYDATA_LYB) {
+            /* parse into a temporary data tree, the node itself is not changed so that printing never modifies
+             * the printed data */
+            tree = lyd_parse_mem(node->schema->module->ctx, value.mem, LYD_LYB, LYD_OPT_DATA | LYD_OPT_STRICT
                                  | LYD_OPT_TRUSTED);
-            if (iter) {
+            if (tree) {
                 /* successfully parsed */
-                free(any->value.mem);
-                any->value_type = LYD_ANYDATA_DATATREE;
-                any->value.tree = iter;
+                value_type = LYD_ANYDATA_DATATREE;
+                value.tree = tree;
             }
         }
-        if (any->value_type == LYD_ANYDATA_DATATREE) {
+        if (value_type == LYD_ANYDATA_DATATREE) {
             /* print namespaces in the anydata data tree */
-            LY_TREE_FOR(any->value.tree, iter) {
+            LY_TREE_FOR(value.tree, iter) {
                 xml_print_ns(out, iter, &mlist, options);
             }
         }
@@ -589,36 +617,38 @@ xml_print_anydata(struct lyout *out, int level, const struct lyd_node *node, int
         ly_print(out, ">");
         free_mlist(&mlist);
         /* ... and print anydata content */
-        switch (any->value_type) {
+        switch (value_type) {
         case LYD_ANYDATA_CONSTSTRING:
-            lyxml_dump_text(out, any->value.str, LYXML_DATA_ELEM);
+            lyxml_dump_text(out, value.str, LYXML_DATA_ELEM);
             break;
         case LYD_ANYDATA_DATATREE:
-            if (any->value.tree) {
+            if (value.tree) {
                 if (level) {
                     ly_print(out, "\n");
                 }
-                LY_TREE_FOR(any->value.tree, iter) {
+                LY_TREE_FOR(value.tree, iter) {
                     if (xml_print_node(out, level ? level + 1 : 0, iter, 0, (options & ~(LYP_WITHSIBLINGS | LYP_NETCONF)))) {
+                        lyd_free_withsiblings(tree);
                         return EXIT_FAILURE;
                     }
                 }
             }
+            lyd_free_withsiblings(tree);
             break;
         case LYD_ANYDATA_XML:
-            lyxml_print_mem(&buf, any->value.xml, (level ? LYXML_PRINT_FORMAT | LYXML_PRINT_NO_LAST_NEWLINE : 0)
-                                                   | LYXML_PRINT_SIBLINGS);
+            lyxml_print_mem(&buf, value.xml, (level ? LYXML_PRINT_FORMAT | LYXML_PRINT_NO_LAST_NEWLINE : 0)
+                                             | LYXML_PRINT_SIBLINGS);
             ly_print(out, "%s%s", level ? "\n" : "", buf);
             free(buf);
             break;
         case LYD_ANYDATA_SXML:
             /* print without escaping special characters */
-            ly_print(out, "%s", any->value.str);
+            ly_print(out, "%s", value.str);
             break;
         case LYD_ANYDATA_JSON:
         case LYD_ANYDATA_LYB:
             /* JSON format is not supported (LYB failed to be converted) */
-            LOGWRN(node->schema->module->ctx, "Unable to print anydata content (type %d) as XML.", any->value_type);
+            LOGWRN(node->schema->module->ctx, "Unable to print anydata content (type %d) as XML.", value_type);
             break;
         case LYD_ANYDATA_STRING:
         case LYD_ANYDATA_SXMLD:
@@ -645,6 +675,7 @@ xml_print_node(struct lyout *out, int level, const struct lyd_node *node, int to
         /* wd says do not print */
         return EXIT_SUCCESS;
     }
+    ++ly_cnt.nodes_printed;
 
     switch (node->schema->nodetype) {
     case LYS_NOTIF:
@@ -675,6 +706,45 @@ xml_print_node(struct lyout *out, int level, const struct lyd_node *node, int to
     return ret;
 }
 
+struct xml_print_unit_arg {
+    int level;
+    int options;
+};
+
+static int
+xml_print_unit(struct lyout *out, const struct lyd_node *node, uint32_t UNUSED(idx), void *arg,
+               void **UNUSED(state))
+{
+    struct xml_print_unit_arg *unit = arg;
+
+    return xml_print_node(out, unit->level, node, 1, unit->options);
+}
+
+/* print every top-level sibling as a separate unit, see #LYP_PARALLEL */
+static int
+xml_print_parallel(struct lyout *out, int level, const struct lyd_node *root, int options)
+{
+    const struct lyd_node *node, **units;
+    struct xml_print_unit_arg arg = {level, options};
+    uint32_t count = 0;
+    int ret;
+
+    LY_TREE_FOR(root, node) {
+        ++count;
+    }
+    units = malloc(count * sizeof *units);
+    LY_CHECK_ERR_RETURN(!units, LOGMEM(root->schema->module->ctx), EXIT_FAILURE);
+
+    count = 0;
+    LY_TREE_FOR(root, node) {
+        units[count++] = node;
+    }
+
+    ret = ly_print_parallel(out, units, count, "", xml_print_unit, &arg, NULL);
+    free(units);
+    return ret;
+}
+
 int
 xml_print_data(struct lyout *out, const struct lyd_node *root, int options)
 {
@@ -728,12 +798,18 @@ xml_print_data(struct lyout *out, const struct lyd_node *root, int options)
     }
 
     /* content */
-    LY_TREE_FOR(root, node) {
-        if (xml_print_node(out, level, node, 1, options)) {
+    if ((options & LYP_PARALLEL) && (options & LYP_WITHSIBLINGS)) {
+        if (xml_print_parallel(out, level, root, options)) {
             return EXIT_FAILURE;
         }
-        if (!(options & LYP_WITHSIBLINGS)) {
-            break;
+    } else {
+        LY_TREE_FOR(root, node) {
+            if (xml_print_node(out, level, node, 1, options)) {
+                return EXIT_FAILURE;
+            }
+            if (!(options & LYP_WITHSIBLINGS)) {
+                break;
+            }
         }
     }
 
@@ -750,3 +826,63 @@ finish:
     LY_PRINT_RET(NULL);
 }
 
+
+int
+xml_emit_node(struct lyd_emitter *em, const struct lys_node *schema, const struct lyd_node_leaf_list *leaf)
+{
+    struct lyd_emit_frame *parent = &em->frames[em->depth - 1];
+    int level = parent->level;
+
+    LY_PRINT_SET;
+
+    if (parent->schema && !parent->children) {
+        /* finish the opening tag of the parent */
+        ly_print(&em->out, ">%s", level ? "\n" : "");
+    }
+
+    xml_print_elem_start(&em->out, level, schema,
+                         !parent->schema || (lys_node_module(schema) != lys_node_module(parent->schema)));
+
+    if (leaf) {
+        if (xml_print_leaf_value(&em->out, leaf)) {
+            return EXIT_FAILURE;
+        }
+        if (level) {
+            ly_print(&em->out, "\n");
+        }
+    } else {
+        /* the opening tag is finished by the first child or when closing the node */
+        em->frames[em->depth].level = level ? level + 1 : 0;
+    }
+
+    LY_PRINT_RET(em->ctx);
+}
+
+int
+xml_emit_close(struct lyd_emitter *em)
+{
+    struct lyd_emit_frame *frame = &em->frames[em->depth - 1];
+    int level = em->frames[em->depth - 2].level;
+
+    LY_PRINT_SET;
+
+    if (!frame->children) {
+        ly_print(&em->out, "/>%s", level ? "\n" : "");
+    } else {
+        ly_print(&em->out, "%*s</%s>%s", LEVEL, INDENT, frame->schema->name, level ? "\n" : "");
+    }
+
+    LY_PRINT_RET(em->ctx);
+}
+
+int
+xml_emit_finish(struct lyd_emitter *em)
+{
+    LY_PRINT_SET;
+
+    if (!em->frames[0].children && ((em->out.type == LYOUT_MEMORY) || (em->out.type == LYOUT_CALLBACK))) {
+        ly_print(&em->out, "");
+    }
+
+    LY_PRINT_RET(em->ctx);
+}
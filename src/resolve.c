@@ -19,6 +19,8 @@
 #include <string.h>
 #include <ctype.h>
 #include <limits.h>
+#include <pthread.h>
+#include <unistd.h>
 
 #include "libyang.h"
 #include "resolve.h"
@@ -36,7 +38,7 @@
 struct parsed_pred {
     const struct lys_node *schema;
     int len;
-    struct {
+    struct parsed_pred_item {
         const char *mod_name;
         int mod_name_len;
         const char *name;
@@ -1144,8 +1146,6 @@ parse_schema_json_predicate(const char *id, const char **mod_name, int *mod_name
     return parsed;
 }
 
-#ifdef LY_ENABLED_CACHE
-
 static int
 resolve_hash_table_find_equal(void *val1_p, void *val2_p, int mod, void *UNUSED(cb_data))
 {
@@ -1222,41 +1222,41 @@ resolve_hash_table_find_equal(void *val1_p, void *val2_p, int mod, void *UNUSED(
     return 0;
 }
 
+#ifdef LY_ENABLED_CACHE
+
 static struct lyd_node *
 resolve_json_data_node_hash(struct lyd_node *parent, struct parsed_pred pp)
 {
-    values_equal_cb prev_cb;
     struct lyd_node **ret = NULL;
     uint32_t hash;
     int i;
 
     assert(parent && parent->hash);
 
-    /* set our value equivalence callback that does not require data nodes */
-    prev_cb = lyht_set_cb(parent->ht, resolve_hash_table_find_equal);
-
     /* get the hash of the searched node */
     hash = dict_hash_multi(0, lys_node_module(pp.schema)->name, strlen(lys_node_module(pp.schema)->name));
     hash = dict_hash_multi(hash, pp.schema->name, strlen(pp.schema->name));
     if (pp.schema->nodetype == LYS_LEAFLIST) {
         assert((pp.len == 1) && (pp.pred[0].name[0] == '.') && (pp.pred[0].nam_len == 1));
         /* leaf-list value in predicate */
-        hash = dict_hash_multi(hash, pp.pred[0].value, pp.pred[0].val_len);
+        if (lytype_hash_str(&((struct lys_node_leaf *)pp.schema)->type, pp.pred[0].value, pp.pred[0].val_len, &hash)) {
+            hash = dict_hash_multi(hash, pp.pred[0].value, pp.pred[0].val_len);
+        }
     } else if (pp.schema->nodetype == LYS_LIST) {
-        /* list keys in predicates */
+        /* list keys in predicates (in the order of the keys) */
         for (i = 0; i < pp.len; ++i) {
-            hash = dict_hash_multi(hash, pp.pred[i].value, pp.pred[i].val_len);
+            if (lytype_hash_str(&((struct lys_node_list *)pp.schema)->keys[i]->type, pp.pred[i].value,
+                                pp.pred[i].val_len, &hash)) {
+                hash = dict_hash_multi(hash, pp.pred[i].value, pp.pred[i].val_len);
+            }
         }
     }
     hash = dict_hash_multi(hash, NULL, 0);
 
-    /* try to find the node */
-    i = lyht_find(parent->ht, &pp, hash, (void **)&ret);
+    /* try to find the node, with our value equivalence callback that does not require data nodes */
+    i = lyht_find_with_cb(parent->ht, &pp, hash, resolve_hash_table_find_equal, (void **)&ret);
     assert(i || *ret);
 
-    /* restore the original callback */
-    lyht_set_cb(parent->ht, prev_cb);
-
     return (i ? NULL : *ret);
 }
 
@@ -1401,9 +1401,25 @@ int
 resolve_iffeature(struct lys_iffeature *expr)
 {
     int index_e = 0, index_f = 0;
+#ifdef LY_ENABLED_CACHE
+    uint32_t set_id;
+    int value;
+#endif
 
     if (expr->expr && expr->features[0]) {
+#ifdef LY_ENABLED_CACHE
+        /* the value changes only with the features, which are all in the same context */
+        set_id = expr->features[0]->module->ctx->feature_set_id;
+        if ((expr->value_cache >> 1) == set_id) {
+            return expr->value_cache & 1;
+        }
+        value = resolve_iffeature_recursive(expr, &index_e, &index_f);
+        /* concurrent threads can only store the same value */
+        expr->value_cache = (set_id << 1) | (value ? 1 : 0);
+        return value;
+#else
         return resolve_iffeature_recursive(expr, &index_e, &index_f);
+#endif
     }
     return 0;
 }
@@ -1614,6 +1630,9 @@ resolve_iffeature_compile(struct lys_iffeature *iffeat_expr, const char *value,
 
     /* allocate the memory */
     iffeat_expr->expr = calloc((j = (expr_size / 4) + ((expr_size % 4) ? 1 : 0)), sizeof *iffeat_expr->expr);
+#ifdef LY_ENABLED_CACHE
+    iffeat_expr->value_cache = 0;
+#endif
     iffeat_expr->features = calloc(f_size, sizeof *iffeat_expr->features);
     stack.stack = malloc(expr_size * sizeof *stack.stack);
     LY_CHECK_ERR_GOTO(!stack.stack || !iffeat_expr->expr || !iffeat_expr->features, LOGMEM(ctx), error);
@@ -2344,7 +2363,7 @@ resolve_json_nodeid(const char *nodeid, const struct ly_ctx *ctx, const struct l
 {
     char *str;
     const char *name, *mod_name, *id, *backup_mod_name = NULL, *yang_data_name = NULL;
-    const struct lys_node *sibling, *start_parent, *parent;
+    const struct lys_node *sibling, *start_parent, *parent, *scope;
     int r, nam_len, mod_name_len, is_relative = -1, has_predicate;
     int yang_data_name_len, backup_mod_name_len;
     /* resolved import module from the start module, it must match the next node-name-match sibling */
@@ -2431,73 +2450,80 @@ resolve_json_nodeid(const char *nodeid, const struct ly_ctx *ctx, const struct l
     prev_mod = module;
 
     while (1) {
-        sibling = NULL;
-        while ((sibling = lys_getnext(sibling, start_parent, module, 0))) {
-            /* name match */
-            if (sibling->name && !strncmp(name, sibling->name, nam_len) && !sibling->name[nam_len]) {
-                /* output check */
-                for (parent = lys_parent(sibling); parent && !(parent->nodetype & (LYS_INPUT | LYS_OUTPUT)); parent = lys_parent(parent));
-                if (parent) {
-                    if (output && (parent->nodetype == LYS_INPUT)) {
-                        continue;
-                    } else if (!output && (parent->nodetype == LYS_OUTPUT)) {
-                        continue;
-                    }
+        /* the input and output children of RPCs and actions may have the same names */
+        scope = start_parent;
+        if (scope && (scope->nodetype & (LYS_RPC | LYS_ACTION))) {
+            scope = NULL;
+            while ((scope = lys_getnext(scope, start_parent, NULL, LYS_GETNEXT_WITHINOUT))) {
+                if (scope->nodetype == (output ? LYS_OUTPUT : LYS_INPUT)) {
+                    break;
                 }
+            }
+            if (!scope) {
+                scope = start_parent;
+            }
+        }
 
-                /* module check */
-                if (mod_name) {
-                    /* will also find an augment module */
-                    prefix_mod = ly_ctx_nget_module(ctx, mod_name, mod_name_len, NULL, 1);
+        /* module check */
+        if (mod_name) {
+            /* will also find an augment module */
+            prefix_mod = ly_ctx_nget_module(ctx, mod_name, mod_name_len, NULL, 1);
+        } else {
+            prefix_mod = prev_mod;
+        }
 
-                    if (!prefix_mod) {
-                        str = strndup(nodeid, (mod_name + mod_name_len) - nodeid);
-                        LOGVAL(ctx, LYE_PATH_INMOD, LY_VLOG_STR, str);
-                        free(str);
+        /* find the data child in the context index */
+        if (lys_find_data_child((struct ly_ctx *)ctx, scope, scope ? NULL : module, prefix_mod ? prefix_mod->name : NULL,
+                                prefix_mod ? strlen(prefix_mod->name) : 0, name, nam_len, &sibling) == -1) {
+            return NULL;
+        }
+        if (sibling && !prefix_mod) {
+            str = strndup(nodeid, (mod_name + mod_name_len) - nodeid);
+            LOGVAL(ctx, LYE_PATH_INMOD, LY_VLOG_STR, str);
+            free(str);
+            return NULL;
+        }
+        if (sibling) {
+            /* output check */
+            for (parent = lys_parent(sibling); parent && !(parent->nodetype & (LYS_INPUT | LYS_OUTPUT)); parent = lys_parent(parent));
+            if (parent && ((output && (parent->nodetype == LYS_INPUT)) || (!output && (parent->nodetype == LYS_OUTPUT)))) {
+                sibling = NULL;
+            }
+        }
+        if (sibling) {
+            /* do we have some predicates on it? */
+            if (has_predicate) {
+                r = 0;
+                if (sibling->nodetype & (LYS_LEAF | LYS_LEAFLIST)) {
+                    if ((r = parse_schema_json_predicate(id, NULL, NULL, NULL, NULL, NULL, NULL, &has_predicate)) < 1) {
+                        LOGVAL(ctx, LYE_PATH_INCHAR, LY_VLOG_NONE, NULL, id[-r], &id[-r]);
                         return NULL;
                     }
-                } else {
-                    prefix_mod = prev_mod;
-                }
-                if (prefix_mod != lys_node_module(sibling)) {
-                    continue;
-                }
-
-                /* do we have some predicates on it? */
-                if (has_predicate) {
-                    r = 0;
-                    if (sibling->nodetype & (LYS_LEAF | LYS_LEAFLIST)) {
-                        if ((r = parse_schema_json_predicate(id, NULL, NULL, NULL, NULL, NULL, NULL, &has_predicate)) < 1) {
-                            LOGVAL(ctx, LYE_PATH_INCHAR, LY_VLOG_NONE, NULL, id[-r], &id[-r]);
-                            return NULL;
-                        }
-                    } else if (sibling->nodetype == LYS_LIST) {
-                        if (resolve_json_schema_list_predicate(id, (const struct lys_node_list *)sibling, &r)) {
-                            return NULL;
-                        }
-                    } else {
-                        LOGVAL(ctx, LYE_PATH_INCHAR, LY_VLOG_NONE, NULL, id[0], id);
+                } else if (sibling->nodetype == LYS_LIST) {
+                    if (resolve_json_schema_list_predicate(id, (const struct lys_node_list *)sibling, &r)) {
                         return NULL;
                     }
-                    id += r;
-                }
-
-                /* the result node? */
-                if (!id[0]) {
-                    return sibling;
-                }
-
-                /* move down the tree, if possible */
-                if (sibling->nodetype & (LYS_LEAF | LYS_LEAFLIST | LYS_ANYDATA)) {
+                } else {
                     LOGVAL(ctx, LYE_PATH_INCHAR, LY_VLOG_NONE, NULL, id[0], id);
                     return NULL;
                 }
-                start_parent = sibling;
+                id += r;
+            }
 
-                /* update prev mod */
-                prev_mod = (start_parent->child ? lys_node_module(start_parent->child) : module);
-                break;
+            /* the result node? */
+            if (!id[0]) {
+                return sibling;
+            }
+
+            /* move down the tree, if possible */
+            if (sibling->nodetype & (LYS_LEAF | LYS_LEAFLIST | LYS_ANYDATA)) {
+                LOGVAL(ctx, LYE_PATH_INCHAR, LY_VLOG_NONE, NULL, id[0], id);
+                return NULL;
             }
+            start_parent = sibling;
+
+            /* update prev mod */
+            prev_mod = (start_parent->child ? lys_node_module(start_parent->child) : module);
         }
 
         /* no match */
@@ -2600,6 +2626,74 @@ resolve_partial_json_data_list_predicate(struct parsed_pred pp, struct lyd_node
     return 0;
 }
 
+struct lyd_node *
+resolve_data_sibling_val(const struct lyd_node *siblings, const struct lys_node *schema, const char **values)
+{
+    struct parsed_pred_item items[8];
+    struct parsed_pred pp;
+    struct lys_node_list *slist;
+    struct lyd_node *iter, *ret = NULL;
+    int i;
+
+    pp.schema = schema;
+    pp.len = 0;
+    pp.pred = items;
+
+    if (schema->nodetype == LYS_LIST) {
+        slist = (struct lys_node_list *)schema;
+        if (!slist->keys_size) {
+            /* key-less list, the first instance */
+            LY_TREE_FOR((struct lyd_node *)siblings, iter) {
+                if (iter->schema == schema) {
+                    return iter;
+                }
+            }
+            return NULL;
+        }
+
+        pp.len = slist->keys_size;
+        if (pp.len > 8) {
+            pp.pred = malloc(pp.len * sizeof *pp.pred);
+            LY_CHECK_ERR_RETURN(!pp.pred, LOGMEM(schema->module->ctx), NULL);
+        }
+        for (i = 0; i < pp.len; ++i) {
+            pp.pred[i].mod_name = NULL;
+            pp.pred[i].name = slist->keys[i]->name;
+            pp.pred[i].nam_len = strlen(slist->keys[i]->name);
+            pp.pred[i].value = values[i];
+            pp.pred[i].val_len = strlen(values[i]);
+        }
+    } else if (schema->nodetype == LYS_LEAFLIST) {
+        pp.len = 1;
+        pp.pred[0].mod_name = NULL;
+        pp.pred[0].name = ".";
+        pp.pred[0].nam_len = 1;
+        pp.pred[0].value = values[0];
+        pp.pred[0].val_len = strlen(values[0]);
+    }
+
+#ifdef LY_ENABLED_CACHE
+    /* state leaf-lists can have several instances with the same value, keep the data order for them */
+    if (siblings->parent && siblings->parent->ht && siblings->parent->hash
+            && ((schema->nodetype != LYS_LEAFLIST) || (schema->flags & LYS_CONFIG_W))) {
+        ret = resolve_json_data_node_hash(siblings->parent, pp);
+    } else
+#endif
+    {
+        LY_TREE_FOR((struct lyd_node *)siblings, iter) {
+            if (resolve_hash_table_find_equal(&pp, &iter, 0, NULL)) {
+                ret = iter;
+                break;
+            }
+        }
+    }
+
+    if (pp.pred != items) {
+        free(pp.pred);
+    }
+    return ret;
+}
+
 /**
  * @brief get the closest parent of the node (or the node itself) identified by the nodeid (path)
  *
@@ -3304,6 +3398,56 @@ error:
     return -1;
 }
 
+int
+resolve_len_ran_chk(struct ly_ctx *ctx, struct lys_type *type, struct len_ran_chk **chk)
+{
+    struct len_ran_intv *intv = NULL, *iter, *dst;
+    uint32_t restr_count = 0, intv_count = 0;
+    struct len_ran_restr *restr;
+    struct lys_type *cur_type = NULL;
+
+    *chk = NULL;
+    if (resolve_len_ran_interval(ctx, NULL, type, &intv)) {
+        return -1;
+    }
+
+    /* all intervals belonging to a single restriction share one type pointer */
+    for (iter = intv; iter; iter = iter->next) {
+        if (iter->type != cur_type) {
+            ++restr_count;
+            cur_type = iter->type;
+        }
+        ++intv_count;
+    }
+
+    *chk = malloc(sizeof **chk + restr_count * sizeof *restr + intv_count * sizeof *intv);
+    LY_CHECK_ERR_GOTO(!*chk, LOGMEM(ctx), cleanup);
+    (*chk)->count = 0;
+    dst = (struct len_ran_intv *)&(*chk)->restr[restr_count];
+    restr = NULL;
+    for (iter = intv; iter; iter = iter->next) {
+        if (!restr || (iter->type != restr->type)) {
+            restr = &(*chk)->restr[(*chk)->count++];
+            restr->type = iter->type;
+            restr->count = 0;
+            restr->intv = dst;
+        }
+        /* the intervals are already checked to be in ascending order */
+        *dst = *iter;
+        dst->next = NULL;
+        ++dst;
+        ++restr->count;
+    }
+
+cleanup:
+    while (intv) {
+        iter = intv->next;
+        free(intv);
+        intv = iter;
+    }
+    return *chk ? EXIT_SUCCESS : -1;
+}
+
 static int
 resolve_superior_type_check(struct lys_type *type)
 {
@@ -3449,8 +3593,10 @@ check_typedef:
     if (resolve_superior_type_check(&match->type)) {
         return EXIT_FAILURE;
     }
-
     if (ret) {
+        /* the values of the type are stored by its plugin, if any (the typedefs of the already loaded modules
+         * are only bound again to the same plugin) */
+        lytype_tpdf_bind(match);
         *ret = match;
     }
     return EXIT_SUCCESS;
@@ -3833,11 +3979,18 @@ unres_data_del(struct unres_data *unres, uint32_t i)
     if (i+1 < unres->count) {
         /* we only move the data, memory is left allocated, why bother */
         memmove(&unres->node[i], &unres->node[i+1], (unres->count-(i+1)) * sizeof *unres->node);
+        if (unres->type) {
+            /* node sets used for resolving paths have no types */
+            memmove(&unres->type[i], &unres->type[i+1], (unres->count-(i+1)) * sizeof *unres->type);
+        }
 
     /* deleting the last item */
     } else if (i == 0) {
         free(unres->node);
         unres->node = NULL;
+        free(unres->type);
+        unres->type = NULL;
+        unres->size = 0;
     }
 
     /* if there are no items after and it is not the last one, just move the counter */
@@ -5463,6 +5616,7 @@ resolve_uses(struct lys_node_uses *uses, struct unres_schema *unres)
             iff = realloc(*old_iff, size * sizeof *rfn->iffeature);
             LY_CHECK_ERR_GOTO(!iff, LOGMEM(ctx), fail);
             *old_iff = iff;
+            memset(&iff[*old_size], 0, rfn->iffeature_size * sizeof *iff);
 
             for (k = 0, j = *old_size; k < rfn->iffeature_size; k++, j++) {
                 resolve_iffeature_getsizes(&rfn->iffeature[k], &usize1, &usize2);
@@ -5862,6 +6016,182 @@ search_base_identity(struct lys_ident *der, struct lys_ident *base)
     return 0;
 }
 
+/* record of the identities index, see resolve_ident_find() */
+struct resolve_ident_rec {
+    const struct lys_ident *base;     /* one of the (transitive) bases of the identity, NULL in its own record */
+    const struct lys_module *module;  /* main module of the identity */
+    const char *name;
+    uint32_t name_len;
+    struct lys_ident *ident;
+};
+
+static int
+resolve_ident_equal(void *val1_p, void *val2_p, int UNUSED(mod), void *UNUSED(cb_data))
+{
+    struct resolve_ident_rec *rec1 = val1_p, *rec2 = val2_p;
+
+    return (rec1->base == rec2->base) && (rec1->module == rec2->module) && (rec1->name_len == rec2->name_len)
+            && !strncmp(rec1->name, rec2->name, rec1->name_len);
+}
+
+static uint32_t
+resolve_ident_hash(const struct resolve_ident_rec *rec)
+{
+    uint32_t hash;
+
+    hash = dict_hash_multi(0, (const char *)&rec->base, sizeof rec->base);
+    hash = dict_hash_multi(hash, (const char *)&rec->module, sizeof rec->module);
+    hash = dict_hash_multi(hash, rec->name, rec->name_len);
+    return dict_hash_multi(hash, NULL, 0);
+}
+
+/**
+ * @brief Add an identity into the index under one of its bases and recursively under all the bases of the base.
+ *
+ * @return EXIT_SUCCESS on success, -1 on error.
+ */
+static int
+resolve_ident_index_bases(struct hash_table *ht, struct resolve_ident_rec *rec, const struct lys_ident *base)
+{
+    uint8_t i;
+
+    rec->base = base;
+    if (lyht_insert(ht, rec, resolve_ident_hash(rec), NULL) == -1) {
+        return -1;
+    }
+
+    /* with more bases, some are possibly reached several times, lyht_insert() then just returns 1 */
+    for (i = 0; i < base->base_size; ++i) {
+        if (resolve_ident_index_bases(ht, rec, base->base[i])) {
+            return -1;
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+static int
+resolve_ident_index_idents(struct hash_table *ht, struct lys_module *mod, struct lys_ident *ident, uint16_t ident_size)
+{
+    struct resolve_ident_rec rec;
+    uint16_t i;
+    uint8_t j;
+
+    rec.module = mod;
+    for (i = 0; i < ident_size; ++i) {
+        rec.name = ident[i].name;
+        rec.name_len = strlen(ident[i].name);
+        rec.ident = &ident[i];
+
+        rec.base = NULL;
+        if (lyht_insert(ht, &rec, resolve_ident_hash(&rec), NULL) == -1) {
+            return -1;
+        }
+        for (j = 0; j < ident[i].base_size; ++j) {
+            if (resolve_ident_index_bases(ht, &rec, ident[i].base[j])) {
+                return -1;
+            }
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+/* ctx->idents_lock must be held, for writing if the index is not built */
+static int
+resolve_idents_index_build(struct ly_ctx *ctx)
+{
+    struct lys_module *mod;
+    int i;
+    uint8_t j;
+
+    if (ctx->idents && (ctx->idents_set_id == ctx->models.module_set_id)) {
+        return EXIT_SUCCESS;
+    }
+
+    /* modules changed, build the index again, only from the modules in the context - the derived identities
+     * of a module being parsed are already in the backlinks of its bases, but it may yet be freed */
+    lyht_free(ctx->idents);
+    ctx->idents = lyht_new(64, sizeof(struct resolve_ident_rec), resolve_ident_equal, NULL, 1);
+    LY_CHECK_ERR_RETURN(!ctx->idents, LOGMEM(ctx), -1);
+
+    for (i = 0; i < ctx->models.used; ++i) {
+        mod = ctx->models.list[i];
+        if (resolve_ident_index_idents(ctx->idents, mod, mod->ident, mod->ident_size)) {
+            goto error;
+        }
+        for (j = 0; j < mod->inc_size; ++j) {
+            if (mod->inc[j].submodule && resolve_ident_index_idents(ctx->idents, mod, mod->inc[j].submodule->ident,
+                                                                    mod->inc[j].submodule->ident_size)) {
+                goto error;
+            }
+        }
+    }
+    ctx->idents_set_id = ctx->models.module_set_id;
+    return EXIT_SUCCESS;
+
+error:
+    LOGMEM(ctx);
+    lyht_free(ctx->idents);
+    ctx->idents = NULL;
+    return -1;
+}
+
+int
+resolve_ident_find(struct ly_ctx *ctx, const struct lys_ident *base, const struct lys_module *module,
+                   const char *name, int nam_len, struct lys_ident **ret)
+{
+    struct resolve_ident_rec rec, *match;
+    int rc;
+
+    assert(ctx && module && name && ret);
+
+    rec.base = base;
+    rec.module = module;
+    rec.name = name;
+    rec.name_len = nam_len;
+
+    /* the index is usually built already, the readers do not block each other */
+    pthread_rwlock_rdlock(&ctx->idents_lock);
+    if (!ctx->idents || (ctx->idents_set_id != ctx->models.module_set_id)) {
+        pthread_rwlock_unlock(&ctx->idents_lock);
+        pthread_rwlock_wrlock(&ctx->idents_lock);
+    }
+
+    rc = resolve_idents_index_build(ctx);
+    if (!rc) {
+        if (!lyht_find(ctx->idents, &rec, resolve_ident_hash(&rec), (void **)&match)) {
+            *ret = match->ident;
+        } else {
+            rc = EXIT_FAILURE;
+        }
+    }
+
+    pthread_rwlock_unlock(&ctx->idents_lock);
+    return rc;
+}
+
+int
+resolve_idents_index(struct ly_ctx *ctx)
+{
+    int rc;
+
+    pthread_rwlock_wrlock(&ctx->idents_lock);
+    rc = resolve_idents_index_build(ctx);
+    pthread_rwlock_unlock(&ctx->idents_lock);
+
+    return rc;
+}
+
+void
+resolve_idents_clean(struct ly_ctx *ctx)
+{
+    pthread_rwlock_wrlock(&ctx->idents_lock);
+
+    lyht_free(ctx->idents);
+    ctx->idents = NULL;
+
+    pthread_rwlock_unlock(&ctx->idents_lock);
+}
+
 /**
  * @brief Resolve JSON data format identityref. Logs directly.
  *
@@ -6021,6 +6351,18 @@ resolve_identref(struct lys_type *type, const char *ident_name, struct lyd_node
         for (i = 0; i < type->info.ident.count; ++i) {
             cur = type->info.ident.ref[i];
 
+            rc = resolve_ident_find(ctx, cur, lys_main_module(imod), name, nam_len, &der);
+            if (rc == -1) {
+                return NULL;
+            } else if (!rc) {
+                cur = der;
+                goto match;
+            } else if (!dflt && !ctx->models.parsing_sub_modules_count) {
+                /* all the identities are in the index, it is not derived from this base */
+                continue;
+            }
+
+            /* the identity may be in a module being parsed */
             if (cur->der) {
                 /* there are some derived identities */
                 for (j = 0; j < cur->der->number; j++) {
@@ -6247,11 +6589,14 @@ resolve_must(struct lyd_node *node, int inout_parent, int ignore_fail)
     struct lys_node *schema;
     struct lys_restr *must;
     struct lyxp_set set;
+    struct ly_profile_mark mark;
     struct ly_ctx *ctx = node->schema->module->ctx;
+    int rc;
 
     assert(node);
     memset(&set, 0, sizeof set);
 
+    schema = node->schema;
     if (inout_parent) {
         for (schema = lys_parent(node->schema);
              schema && (schema->nodetype & (LYS_CHOICE | LYS_CASE | LYS_USES));
@@ -6303,7 +6648,11 @@ resolve_must(struct lyd_node *node, int inout_parent, int ignore_fail)
     }
 
     for (i = 0; i < must_size; ++i) {
-        if (lyxp_eval(must[i].expr, node, LYXP_NODE_ELEM, lyd_node_module(node), &set, LYXP_MUST)) {
+        ++ly_cnt.must_evals;
+        ly_profile_start(&mark);
+        rc = lyxp_eval_cached(must[i].expr, node, LYXP_NODE_ELEM, lyd_node_module(node), &set, LYXP_MUST);
+        ly_profile_end(&mark, LY_PROFILE_MUST, schema, must[i].expr, ctx);
+        if (rc) {
             return -1;
         }
 
@@ -6422,180 +6771,42 @@ resolve_when_ctx_node(struct lyd_node *node, struct lys_node *schema, struct lyd
     return EXIT_SUCCESS;
 }
 
-/**
- * @brief Temporarily unlink nodes as per YANG 1.1 RFC section 7.21.5 for when XPath evaluation.
- * The context node is adjusted if needed.
- *
- * @param[in] snode Schema node, whose children instances need to be unlinked.
- * @param[in,out] node Data siblings where to look for the children of \p snode. If it is unlinked,
- * it is moved to point to another sibling still in the original tree.
- * @param[in,out] ctx_node When context node, adjusted if needed.
- * @param[in] ctx_node_type Context node type, just for information to detect invalid situations.
- * @param[out] unlinked_nodes Unlinked siblings. Can be safely appended to \p node afterwards.
- * Ordering may change, but there will be no semantic change.
- *
- * @return EXIT_SUCCESS on success, -1 on error.
- */
-static int
-resolve_when_unlink_nodes(struct lys_node *snode, struct lyd_node **node, struct lyd_node **ctx_node,
-                          enum lyxp_node_type ctx_node_type, struct lyd_node **unlinked_nodes)
+int
+resolve_applies_must(const struct lyd_node *node)
 {
-    struct lyd_node *next, *elem;
-    const struct lys_node *slast;
-    struct ly_ctx *ctx = snode->module->ctx;
+    int ret = 0;
+    uint8_t must_size;
+    struct lys_node *schema, *iter;
 
-    switch (snode->nodetype) {
-    case LYS_AUGMENT:
-    case LYS_USES:
-    case LYS_CHOICE:
-    case LYS_CASE:
-        slast = NULL;
-        while ((slast = lys_getnext(slast, snode, NULL, LYS_GETNEXT_PARENTUSES))) {
-            if (slast->nodetype & (LYS_ACTION | LYS_NOTIF)) {
-                continue;
-            }
+    assert(node);
 
-            if (resolve_when_unlink_nodes((struct lys_node *)slast, node, ctx_node, ctx_node_type, unlinked_nodes)) {
-                return -1;
-            }
-        }
-        break;
+    schema = node->schema;
+
+    /* their own must */
+    switch (schema->nodetype) {
     case LYS_CONTAINER:
-    case LYS_LIST:
+        must_size = ((struct lys_node_container *)schema)->must_size;
+        break;
     case LYS_LEAF:
+        must_size = ((struct lys_node_leaf *)schema)->must_size;
+        break;
     case LYS_LEAFLIST:
+        must_size = ((struct lys_node_leaflist *)schema)->must_size;
+        break;
+    case LYS_LIST:
+        must_size = ((struct lys_node_list *)schema)->must_size;
+        break;
     case LYS_ANYXML:
     case LYS_ANYDATA:
-        LY_TREE_FOR_SAFE(lyd_first_sibling(*node), next, elem) {
-            if (elem->schema == snode) {
-
-                if (elem == *ctx_node) {
-                    /* We are going to unlink our context node! This normally cannot happen,
-                     * but we use normal top-level data nodes for faking a document root node,
-                     * so if this is the context node, we just use the next top-level node.
-                     * Additionally, it can even happen that there are no top-level data nodes left,
-                     * all were unlinked, so in this case we pass NULL as the context node/data tree,
-                     * lyxp_eval() can handle this special situation.
-                     */
-                    if (ctx_node_type == LYXP_NODE_ELEM) {
-                        LOGINT(ctx);
-                        return -1;
-                    }
-
-                    if (elem->prev == elem) {
-                        /* unlinking last top-level element, use an empty data tree */
-                        *ctx_node = NULL;
-                    } else {
-                        /* in this case just use the previous/last top-level data node */
-                        *ctx_node = elem->prev;
-                    }
-                } else if (elem == *node) {
-                    /* We are going to unlink the currently processed node. This does not matter that
-                     * much, but we would lose access to the original data tree, so just move our
-                     * pointer somewhere still inside it.
-                     */
-                    if ((*node)->prev != *node) {
-                        *node = (*node)->prev;
-                    } else {
-                        /* the processed node with sibings were all unlinked, oh well */
-                        *node = NULL;
-                    }
-                }
-
-                /* temporarily unlink the node */
-                lyd_unlink_internal(elem, 0);
-                if (*unlinked_nodes) {
-                    if (lyd_insert_after((*unlinked_nodes)->prev, elem)) {
-                        LOGINT(ctx);
-                        return -1;
-                    }
-                } else {
-                    *unlinked_nodes = elem;
-                }
-
-                if (snode->nodetype & (LYS_CONTAINER | LYS_LEAF | LYS_ANYDATA)) {
-                    /* there can be only one instance */
-                    break;
-                }
-            }
-        }
-        break;
-    default:
-        LOGINT(ctx);
-        return -1;
-    }
-
-    return EXIT_SUCCESS;
-}
-
-/**
- * @brief Relink the unlinked nodes back.
- *
- * @param[in] node Data node to link the nodes back to. It can actually be the adjusted context node,
- * we simply need a sibling from the original data tree.
- * @param[in] unlinked_nodes Unlinked nodes to relink to \p node.
- * @param[in] ctx_node_type Context node type to distinguish between \p node being the parent
- * or the sibling of \p unlinked_nodes.
- *
- * @return EXIT_SUCCESS on success, -1 on error.
- */
-static int
-resolve_when_relink_nodes(struct lyd_node *node, struct lyd_node *unlinked_nodes, enum lyxp_node_type ctx_node_type)
-{
-    struct lyd_node *elem;
-
-    LY_TREE_FOR_SAFE(unlinked_nodes, unlinked_nodes, elem) {
-        lyd_unlink_internal(elem, 0);
-        if (ctx_node_type == LYXP_NODE_ELEM) {
-            if (lyd_insert_common(node, NULL, elem, 0)) {
-                return -1;
-            }
-        } else {
-            if (lyd_insert_nextto(node, elem, 0, 0)) {
-                return -1;
-            }
-        }
-    }
-
-    return EXIT_SUCCESS;
-}
-
-int
-resolve_applies_must(const struct lyd_node *node)
-{
-    int ret = 0;
-    uint8_t must_size;
-    struct lys_node *schema, *iter;
-
-    assert(node);
-
-    schema = node->schema;
-
-    /* their own must */
-    switch (schema->nodetype) {
-    case LYS_CONTAINER:
-        must_size = ((struct lys_node_container *)schema)->must_size;
-        break;
-    case LYS_LEAF:
-        must_size = ((struct lys_node_leaf *)schema)->must_size;
-        break;
-    case LYS_LEAFLIST:
-        must_size = ((struct lys_node_leaflist *)schema)->must_size;
-        break;
-    case LYS_LIST:
-        must_size = ((struct lys_node_list *)schema)->must_size;
-        break;
-    case LYS_ANYXML:
-    case LYS_ANYDATA:
-        must_size = ((struct lys_node_anydata *)schema)->must_size;
-        break;
-    case LYS_NOTIF:
-        must_size = ((struct lys_node_notif *)schema)->must_size;
-        break;
-    default:
-        must_size = 0;
-        break;
-    }
+        must_size = ((struct lys_node_anydata *)schema)->must_size;
+        break;
+    case LYS_NOTIF:
+        must_size = ((struct lys_node_notif *)schema)->must_size;
+        break;
+    default:
+        must_size = 0;
+        break;
+    }
 
     if (must_size) {
         ++ret;
@@ -6682,6 +6893,92 @@ check_augment:
     return 0;
 }
 
+/* results of the when conditions inherited from schema-only parents, valid during the when phase of
+ * resolve_unres_data(), see resolve_when_inherited() */
+static THREAD_LOCAL struct hash_table *resolve_when_memo;
+
+struct resolve_when_memo_rec {
+    const struct lys_when *when;
+    const struct lyd_node *ctx_node;
+    const struct lyd_node *parent;    /* parent of the hidden sibling instances */
+    int result;
+};
+
+static int
+resolve_when_memo_equal(void *val1_p, void *val2_p, int UNUSED(mod), void *UNUSED(cb_data))
+{
+    struct resolve_when_memo_rec *rec1 = val1_p, *rec2 = val2_p;
+
+    return (rec1->when == rec2->when) && (rec1->ctx_node == rec2->ctx_node) && (rec1->parent == rec2->parent);
+}
+
+static uint32_t
+resolve_when_memo_hash(const struct resolve_when_memo_rec *rec)
+{
+    uint32_t hash;
+
+    hash = dict_hash_multi(0, (const char *)&rec->when, sizeof rec->when);
+    hash = dict_hash_multi(hash, (const char *)&rec->ctx_node, sizeof rec->ctx_node);
+    hash = dict_hash_multi(hash, (const char *)&rec->parent, sizeof rec->parent);
+    return dict_hash_multi(hash, NULL, 0);
+}
+
+/**
+ * @brief Evaluate the when condition of a uses, choice, case, or augment affecting a data node. All the data
+ * children of \p parent instantiated from \p snode share the result, so it is memoized while resolving
+ * the when conditions of a data tree (the tree is not modified then, nodes are deleted only afterwards).
+ *
+ * @param[in] snode Schema node with the when condition.
+ * @param[in] ctx_node Context node of the condition.
+ * @param[in] ctx_node_type Type of \p ctx_node.
+ * @param[in] parent Data parent of the node being resolved.
+ * @param[out] set Boolean result of the condition.
+ * @return 0 on success, 1 if the condition cannot be evaluated yet, -1 on error.
+ */
+static int
+resolve_when_inherited(struct lys_node *snode, struct lyd_node *ctx_node, enum lyxp_node_type ctx_node_type,
+                       struct lyd_node *parent, struct lyxp_set *set)
+{
+    struct resolve_when_memo_rec rec, *match;
+    struct lyxp_hidden hidden;
+    const struct lyxp_hidden *prev_hidden;
+    struct ly_profile_mark mark;
+    struct lys_when *when = snode_get_when(snode);
+    int rc;
+
+    rec.when = when;
+    rec.ctx_node = ctx_node;
+    rec.parent = parent;
+    if (resolve_when_memo && !lyht_find(resolve_when_memo, &rec, resolve_when_memo_hash(&rec), (void **)&match)) {
+        set->type = LYXP_SET_BOOLEAN;
+        set->val.bool = match->result;
+        return 0;
+    }
+
+    /* the sibling instances of the conditional nodes are not present for the evaluation
+     * (YANG 1.1 RFC section 7.21.5), but they are kept in the tree */
+    memset(&hidden, 0, sizeof hidden);
+    hidden.snode = snode;
+    hidden.parent = parent;
+    prev_hidden = lyxp_set_hidden(&hidden);
+    ++ly_cnt.when_evals;
+    ly_profile_start(&mark);
+    rc = lyxp_eval_cached(when->cond, ctx_node, ctx_node_type, lys_node_module(snode), set, LYXP_WHEN);
+    ly_profile_end(&mark, LY_PROFILE_WHEN, snode, when->cond, snode->module->ctx);
+    lyxp_set_hidden(prev_hidden);
+    if (rc) {
+        return rc;
+    }
+
+    lyxp_set_cast(set, LYXP_SET_BOOLEAN, ctx_node, lys_node_module(snode), LYXP_WHEN);
+    if (resolve_when_memo) {
+        /* a failed insert only means the result is evaluated again next time */
+        rec.result = set->val.bool;
+        lyht_insert(resolve_when_memo, &rec, resolve_when_memo_hash(&rec), NULL);
+    }
+    return 0;
+}
+
 /**
  * @brief Resolve (check) all when conditions relevant for \p node.
  * Logs directly.
@@ -6699,22 +6996,34 @@ check_augment:
 int
 resolve_when(struct lyd_node *node, int ignore_fail, struct lys_when **failed_when)
 {
-    struct lyd_node *ctx_node = NULL, *unlinked_nodes, *tmp_node;
+    struct lyd_node *ctx_node = NULL;
     struct lys_node *sparent;
     struct lyxp_set set;
+    struct lyxp_hidden hidden;
+    const struct lyxp_hidden *prev_hidden;
     enum lyxp_node_type ctx_node_type;
+    struct ly_profile_mark mark;
     struct ly_ctx *ctx = node->schema->module->ctx;
     int rc = 0;
 
     assert(node);
     memset(&set, 0, sizeof set);
+    memset(&hidden, 0, sizeof hidden);
+
+    /* forget the result of a previous failed validation, the node is still present */
+    node->when_status &= ~LYD_WHEN_FALSE;
 
     if (!(node->schema->nodetype & (LYS_NOTIF | LYS_RPC | LYS_ACTION)) && snode_get_when(node->schema)) {
-        /* make the node dummy for the evaluation */
-        node->validity |= LYD_VAL_INUSE;
-        rc = lyxp_eval(snode_get_when(node->schema)->cond, node, LYXP_NODE_ELEM, lyd_node_module(node),
-                       &set, LYXP_WHEN);
-        node->validity &= ~LYD_VAL_INUSE;
+        /* make the node dummy for the evaluation, without changing it */
+        hidden.dummy = node;
+        prev_hidden = lyxp_set_hidden(&hidden);
+        ++ly_cnt.when_evals;
+        ly_profile_start(&mark);
+        rc = lyxp_eval_cached(snode_get_when(node->schema)->cond, node, LYXP_NODE_ELEM, lyd_node_module(node),
+                              &set, LYXP_WHEN);
+        ly_profile_end(&mark, LY_PROFILE_WHEN, node->schema, snode_get_when(node->schema)->cond, ctx);
+        lyxp_set_hidden(prev_hidden);
+        hidden.dummy = NULL;
         if (rc) {
             if (rc == 1) {
                 LOGVAL(ctx, LYE_INWHEN, LY_VLOG_LYD, node, snode_get_when(node->schema)->cond);
@@ -6756,24 +7065,7 @@ resolve_when(struct lyd_node *node, int ignore_fail, struct lys_when **failed_wh
                 }
             }
 
-            unlinked_nodes = NULL;
-            /* we do not want our node pointer to change */
-            tmp_node = node;
-            rc = resolve_when_unlink_nodes(sparent, &tmp_node, &ctx_node, ctx_node_type, &unlinked_nodes);
-            if (rc) {
-                goto cleanup;
-            }
-
-            rc = lyxp_eval(snode_get_when(sparent)->cond, ctx_node, ctx_node_type, lys_node_module(sparent),
-                           &set, LYXP_WHEN);
-
-            if (unlinked_nodes && ctx_node) {
-                if (resolve_when_relink_nodes(ctx_node, unlinked_nodes, ctx_node_type)) {
-                    rc = -1;
-                    goto cleanup;
-                }
-            }
-
+            rc = resolve_when_inherited(sparent, ctx_node, ctx_node_type, node->parent, &set);
             if (rc) {
                 if (rc == 1) {
                     LOGVAL(ctx, LYE_INWHEN, LY_VLOG_LYD, node, snode_get_when(sparent)->cond);
@@ -6781,7 +7073,6 @@ resolve_when(struct lyd_node *node, int ignore_fail, struct lys_when **failed_wh
                 goto cleanup;
             }
 
-            lyxp_set_cast(&set, LYXP_SET_BOOLEAN, ctx_node, lys_node_module(sparent), LYXP_WHEN);
             if (!set.val.bool) {
                 if ((ignore_fail == 1) || ((snode_get_when(sparent)->flags & (LYS_XPCONF_DEP | LYS_XPSTATE_DEP))
                         && (ignore_fail == 2))) {
@@ -6810,26 +7101,8 @@ check_augment:
                 }
             }
 
-            unlinked_nodes = NULL;
-            tmp_node = node;
-            rc = resolve_when_unlink_nodes(sparent->parent, &tmp_node, &ctx_node, ctx_node_type, &unlinked_nodes);
-            if (rc) {
-                goto cleanup;
-            }
-
-            rc = lyxp_eval(snode_get_when(sparent->parent)->cond, ctx_node, ctx_node_type,
-                           lys_node_module(sparent->parent), &set, LYXP_WHEN);
-
-            /* reconnect nodes, if ctx_node is NULL then all the nodes were unlinked, but linked together,
-             * so the tree did not actually change and there is nothing for us to do
-             */
-            if (unlinked_nodes && ctx_node) {
-                if (resolve_when_relink_nodes(ctx_node, unlinked_nodes, ctx_node_type)) {
-                    rc = -1;
-                    goto cleanup;
-                }
-            }
-
+            /* the same for the augment */
+            rc = resolve_when_inherited(sparent->parent, ctx_node, ctx_node_type, node->parent, &set);
             if (rc) {
                 if (rc == 1) {
                     LOGVAL(ctx, LYE_INWHEN, LY_VLOG_LYD, node, snode_get_when(sparent->parent)->cond);
@@ -6837,7 +7110,6 @@ check_augment:
                 goto cleanup;
             }
 
-            lyxp_set_cast(&set, LYXP_SET_BOOLEAN, ctx_node, lys_node_module(sparent->parent), LYXP_WHEN);
             if (!set.val.bool) {
                 node->when_status |= LYD_WHEN_FALSE;
                 if ((ignore_fail == 1) || ((snode_get_when(sparent->parent)->flags & (LYS_XPCONF_DEP | LYS_XPSTATE_DEP))
@@ -7132,6 +7404,12 @@ featurecheckdone:
         break;
     case UNRES_XPATH:
         node = (struct lys_node *)item;
+        if (!lys_node_module(node)->implemented) {
+            /* expressions of an import-only module never apply to any data, they are checked
+             * only once the module is made implemented (lys_make_implemented_r()) */
+            rc = EXIT_SUCCESS;
+            break;
+        }
         rc = check_xpath(node, 1);
         break;
     case UNRES_MOD_IMPLEMENT:
@@ -7218,6 +7496,13 @@ featurecheckdone:
                     LY_CHECK_ERR_RETURN(!extlist[node->ext_size], LOGMEM(ctx); node->ext = extlist, -1);
                     memcpy(extlist[node->ext_size], ext, sizeof *ext);
                     extlist[node->ext_size]->flags |= LYEXT_OPT_INHERIT;
+                    if (ext->flags & LYEXT_OPT_VALID) {
+                        /* the inherited instance validates data of this node as well */
+                        node->flags |= LYS_VALID_EXT;
+                        if (ext->flags & LYEXT_OPT_VALID_SUBTREE) {
+                            node->flags |= LYS_VALID_EXT_SUBTREE;
+                        }
+                    }
 
                     node->ext = extlist;
                     node->ext_size++;
@@ -7845,77 +8130,439 @@ check_instid_ext_dep(const struct lys_node *sleaf, const char *json_instid)
     return 0;
 }
 
+/* maximum number of the compiled instance-identifier values of a context */
+#define LY_INSTID_CACHE_MAX 4096
+
 /**
- * @brief Resolve instance-identifier in JSON data format. Logs directly.
- *
- * @param[in] data Data node where the path is used
- * @param[in] path Instance-identifier node value.
- * @param[in,out] ret Resolved instance or NULL.
- *
- * @return 0 on success (even if unresolved and \p ret is NULL), -1 on error.
+ * @brief Step of a compiled instance-identifier.
  */
+struct instid_step {
+    const struct lys_node *schema; /**< schema node of the instance */
+    const char **values;           /**< key values in their order or the leaf-list value (dictionary), NULL if none */
+    uint32_t val_count;            /**< number of values, the schema node may not exist anymore when they are freed */
+    uint32_t pos;                  /**< position of a keyless list instance, 0 if not used */
+};
+
+/**
+ * @brief Compiled instance-identifier value, the instances are found by the hashes of the siblings. Values that
+ * cannot be resolved this way (lists without all their keys, leaf-lists without a value, unimplemented modules)
+ * have no steps and are resolved only from their string.
+ */
+struct instid_rec {
+    const char *path;              /**< value in JSON format (dictionary) */
+    struct instid_step *steps;     /**< compiled steps */
+    uint32_t count;                /**< number of steps */
+    const char *xml;               /**< value in XML format (dictionary), NULL until first needed */
+    const char **prefixes;         /**< prefixes used in xml */
+    const char **namespaces;       /**< namespaces of the prefixes */
+    uint32_t ns_count;             /**< number of prefixes and namespaces */
+};
+
 static int
-resolve_instid(struct lyd_node *data, const char *path, int req_inst, struct lyd_node **ret)
+resolve_instid_rec_equal(void *val1_p, void *val2_p, int UNUSED(mod), void *UNUSED(cb_data))
 {
-    int i = 0, j, parsed, cur_idx;
-    const struct lys_module *mod, *prev_mod = NULL;
-    struct ly_ctx *ctx = data->schema->module->ctx;
-    struct lyd_node *root, *node;
-    const char *model = NULL, *name;
-    char *str;
-    int mod_len, name_len, has_predicate;
-    struct unres_data node_match;
+    return !strcmp((*(struct instid_rec **)val1_p)->path, (*(struct instid_rec **)val2_p)->path);
+}
 
-    memset(&node_match, 0, sizeof node_match);
-    *ret = NULL;
+static uint32_t
+resolve_instid_hash(const char *path)
+{
+    return dict_hash_multi(dict_hash_multi(0, path, strlen(path)), NULL, 0);
+}
 
-    /* we need root to resolve absolute path */
-    for (root = data; root->parent; root = root->parent);
-    /* we're still parsing it and the pointer is not correct yet */
-    if (root->prev) {
-        for (; root->prev->next; root = root->prev);
+static void
+resolve_instid_steps_free(struct ly_ctx *ctx, struct instid_rec *rec)
+{
+    uint32_t i, j;
+
+    for (i = 0; i < rec->count; ++i) {
+        if (!rec->steps[i].values) {
+            continue;
+        }
+        for (j = 0; j < rec->steps[i].val_count; ++j) {
+            lydict_remove(ctx, rec->steps[i].values[j]);
+        }
+        free(rec->steps[i].values);
     }
+    free(rec->steps);
+    rec->steps = NULL;
+    rec->count = 0;
+}
 
-    /* search for the instance node */
-    while (path[i]) {
-        j = parse_instance_identifier(&path[i], &model, &mod_len, &name, &name_len, &has_predicate);
-        if (j <= 0) {
-            LOGVAL(ctx, LYE_INCHAR, LY_VLOG_LYD, data, path[i-j], &path[i-j]);
-            goto error;
+static void
+resolve_instid_rec_free(struct ly_ctx *ctx, struct instid_rec *rec)
+{
+    resolve_instid_steps_free(ctx, rec);
+    lydict_remove(ctx, rec->path);
+    lydict_remove(ctx, rec->xml);
+    free(rec->prefixes);
+    free(rec->namespaces);
+    free(rec);
+}
+
+/* compile the predicates of a step, EXIT_FAILURE if not compilable */
+static int
+resolve_instid_compile_pred(struct ly_ctx *ctx, const char *pred, struct instid_step *step, const struct lys_module *mod,
+                            int *parsed)
+{
+    const char *model, *name, *value;
+    int mod_len, nam_len, val_len, has_predicate, i, j, count;
+    struct lys_node_list *slist;
+
+    count = (step->schema->nodetype == LYS_LIST) ? ((struct lys_node_list *)step->schema)->keys_size : 1;
+    if (count) {
+        step->values = calloc(count, sizeof *step->values);
+        LY_CHECK_ERR_RETURN(!step->values, LOGMEM(ctx), -1);
+        step->val_count = count;
+    }
+
+    *parsed = 0;
+    do {
+        if ((i = parse_predicate(pred + *parsed, &model, &mod_len, &name, &nam_len, &value, &val_len, &has_predicate)) < 1) {
+            return EXIT_FAILURE;
         }
-        i += j;
+        *parsed += i;
 
-        if (model) {
-            str = strndup(model, mod_len);
-            if (!str) {
-                LOGMEM(ctx);
-                goto error;
+        if (name[0] == '.') {
+            if ((step->schema->nodetype != LYS_LEAFLIST) || step->values[0]) {
+                return EXIT_FAILURE;
             }
-            mod = ly_ctx_get_module(ctx, str, NULL, 1);
-            if (ctx->data_clb) {
-                if (!mod) {
-                    mod = ctx->data_clb(ctx, str, NULL, 0, ctx->data_clb_data);
-                } else if (!mod->implemented) {
-                    mod = ctx->data_clb(ctx, mod->name, mod->ns, LY_MODCLB_NOT_IMPLEMENTED, ctx->data_clb_data);
+            j = 0;
+        } else if (isdigit(name[0])) {
+            if ((step->schema->nodetype != LYS_LIST) || count || step->pos || (atoi(name) < 1)) {
+                return EXIT_FAILURE;
+            }
+            step->pos = atoi(name);
+            continue;
+        } else {
+            if (step->schema->nodetype != LYS_LIST) {
+                return EXIT_FAILURE;
+            }
+            slist = (struct lys_node_list *)step->schema;
+            for (j = 0; j < count; ++j) {
+                if (!strncmp(slist->keys[j]->name, name, nam_len) && !slist->keys[j]->name[nam_len]) {
+                    break;
                 }
             }
-            free(str);
+            if ((j == count) || step->values[j] || (model ? (strncmp(slist->keys[j]->module->name, model, mod_len)
+                    || slist->keys[j]->module->name[mod_len]) : (lys_node_module((struct lys_node *)slist->keys[j]) != mod))) {
+                return EXIT_FAILURE;
+            }
+        }
+        step->values[j] = lydict_insert(ctx, value, val_len);
+    } while (has_predicate);
 
-            if (!mod || !mod->implemented || mod->disabled) {
-                break;
+    /* all the keys or the value are required */
+    for (j = 0; j < count; ++j) {
+        if (!step->values[j]) {
+            return EXIT_FAILURE;
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+/* compile the steps of an instance-identifier, EXIT_FAILURE if not compilable */
+static int
+resolve_instid_compile(struct ly_ctx *ctx, struct instid_rec *rec)
+{
+    const struct lys_module *mod = NULL;
+    const struct lys_node *sparent = NULL, *snode;
+    struct instid_step *step;
+    const char *path = rec->path, *model, *name;
+    int i = 0, j, mod_len, nam_len, has_predicate, rc;
+    void *mem;
+
+    while (path[i]) {
+        j = parse_instance_identifier(&path[i], &model, &mod_len, &name, &nam_len, &has_predicate);
+        if (j <= 0) {
+            return EXIT_FAILURE;
+        }
+        i += j;
+
+        if (model) {
+            mod = ly_ctx_nget_module(ctx, model, mod_len, NULL, 1);
+            if (!mod || mod->disabled) {
+                return EXIT_FAILURE;
             }
-        } else if (!prev_mod) {
-            /* first iteration and we are missing module name */
-            LOGVAL(ctx, LYE_INELEM_LEN, LY_VLOG_LYD, data, name_len, name);
-            LOGVAL(ctx, LYE_SPEC, LY_VLOG_PREV, NULL, "Instance-identifier is missing prefix in the first node.");
-            goto error;
-        } else {
-            mod = prev_mod;
+        } else if (!mod) {
+            return EXIT_FAILURE;
         }
 
-        if (resolve_data(mod, name, name_len, root, &node_match)) {
-            /* no instance exists */
-            break;
+        /* the module of the node is always known */
+        rc = lys_find_data_child(ctx, sparent, mod, mod->name, strlen(mod->name), name, nam_len, &snode);
+        if (rc) {
+            return rc;
+        }
+
+        mem = realloc(rec->steps, (rec->count + 1) * sizeof *rec->steps);
+        LY_CHECK_ERR_RETURN(!mem, LOGMEM(ctx), -1);
+        rec->steps = mem;
+        step = &rec->steps[rec->count++];
+        memset(step, 0, sizeof *step);
+        step->schema = snode;
+
+        if (has_predicate) {
+            rc = resolve_instid_compile_pred(ctx, &path[i], step, mod, &j);
+            if (rc) {
+                return rc;
+            }
+            i += j;
+        } else if (snode->nodetype & (LYS_LIST | LYS_LEAFLIST)) {
+            /* more instances */
+            return EXIT_FAILURE;
+        }
+
+        sparent = snode;
+    }
+
+    return rec->count ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* ctx->instids_lock must be held for writing */
+static void
+resolve_instids_free(struct ly_ctx *ctx)
+{
+    uint32_t i;
+    struct instid_rec **rec_p;
+
+    if (!ctx->instids) {
+        return;
+    }
+
+    lyht_finish_resize(ctx->instids);
+    for (i = 0; i < ctx->instids->size; ++i) {
+        rec_p = lyht_get_val(ctx->instids, i);
+        if (rec_p) {
+            resolve_instid_rec_free(ctx, *rec_p);
+        }
+    }
+    lyht_free(ctx->instids);
+    ctx->instids = NULL;
+}
+
+/**
+ * @brief Get the compiled instance-identifier value from the context, compile it if not yet.
+ *
+ * @param[in] ctx Context to use.
+ * @param[in] path Value in JSON format.
+ * @param[in] xml_mod Module to transform the value into XML format in, NULL if not needed.
+ * @return Compiled value valid until the modules of the context change, NULL on error or if not cached.
+ */
+static const struct instid_rec *
+resolve_instid_get(struct ly_ctx *ctx, const char *path, const struct lys_module *xml_mod)
+{
+    struct instid_rec key, *rec, **match;
+    uint32_t hash;
+    enum int_log_opts prev_ilo;
+
+    key.path = path;
+    rec = &key;
+    hash = resolve_instid_hash(path);
+
+    /* the values are usually compiled already, the readers do not block each other */
+    pthread_rwlock_rdlock(&ctx->instids_lock);
+    if (ctx->instids && (ctx->instids_set_id == ctx->models.module_set_id)
+            && !lyht_find(ctx->instids, &rec, hash, (void **)&match) && (!xml_mod || (*match)->xml)) {
+        rec = *match;
+        pthread_rwlock_unlock(&ctx->instids_lock);
+        return rec;
+    }
+    pthread_rwlock_unlock(&ctx->instids_lock);
+
+    pthread_rwlock_wrlock(&ctx->instids_lock);
+
+    if (ctx->instids && (ctx->instids_set_id != ctx->models.module_set_id)) {
+        /* modules changed, the schema nodes may not exist anymore */
+        resolve_instids_free(ctx);
+    }
+    if (!ctx->instids) {
+        ctx->instids = lyht_new(64, sizeof rec, resolve_instid_rec_equal, NULL, 1);
+        LY_CHECK_ERR_GOTO(!ctx->instids, LOGMEM(ctx); rec = NULL, cleanup);
+        ctx->instids_set_id = ctx->models.module_set_id;
+    }
+
+    if (!lyht_find(ctx->instids, &rec, hash, (void **)&match)) {
+        rec = *match;
+    } else if (ctx->instids->used >= LY_INSTID_CACHE_MAX) {
+        rec = NULL;
+        goto cleanup;
+    } else {
+        /* not compiled yet */
+        rec = calloc(1, sizeof *rec);
+        LY_CHECK_ERR_GOTO(!rec, LOGMEM(ctx), cleanup);
+        rec->path = lydict_insert(ctx, path, 0);
+        if (resolve_instid_compile(ctx, rec)) {
+            /* resolved only from the string */
+            resolve_instid_steps_free(ctx, rec);
+        }
+        if (lyht_insert(ctx->instids, &rec, hash, NULL)) {
+            LOGINT(ctx);
+            resolve_instid_rec_free(ctx, rec);
+            rec = NULL;
+            goto cleanup;
+        }
+    }
+
+    if (xml_mod && !rec->xml) {
+        /* the value may be invalid, the errors are logged by the caller */
+        ly_ilo_change(NULL, ILO_IGNORE, &prev_ilo, NULL);
+        rec->xml = transform_json2xml(xml_mod, path, 1, &rec->prefixes, &rec->namespaces, &rec->ns_count);
+        ly_ilo_restore(NULL, prev_ilo, NULL, 0);
+        if (!rec->xml) {
+            rec = NULL;
+        }
+    }
+
+cleanup:
+    pthread_rwlock_unlock(&ctx->instids_lock);
+    return rec;
+}
+
+const char *
+resolve_instid_json2xml(const struct lys_module *module, const char *value, const char ***prefixes,
+                        const char ***namespaces, uint32_t *ns_count)
+{
+    const struct instid_rec *rec;
+
+    rec = resolve_instid_get(module->ctx, value, module);
+    if (!rec) {
+        /* not cached */
+        return transform_json2xml(module, value, 1, prefixes, namespaces, ns_count);
+    }
+
+    *prefixes = NULL;
+    *namespaces = NULL;
+    *ns_count = rec->ns_count;
+    if (rec->ns_count) {
+        *prefixes = malloc(rec->ns_count * sizeof **prefixes);
+        *namespaces = malloc(rec->ns_count * sizeof **namespaces);
+        if (!*prefixes || !*namespaces) {
+            LOGMEM(module->ctx);
+            free(*prefixes);
+            free(*namespaces);
+            return NULL;
+        }
+        memcpy(*prefixes, rec->prefixes, rec->ns_count * sizeof **prefixes);
+        memcpy(*namespaces, rec->namespaces, rec->ns_count * sizeof **namespaces);
+    }
+    return lydict_insert(module->ctx, rec->xml, 0);
+}
+
+void
+resolve_instids_clean(struct ly_ctx *ctx)
+{
+    pthread_rwlock_wrlock(&ctx->instids_lock);
+    resolve_instids_free(ctx);
+    pthread_rwlock_unlock(&ctx->instids_lock);
+}
+
+/* find the target of a compiled instance-identifier, NULL if not found this way */
+static struct lyd_node *
+resolve_instid_compiled(const struct instid_rec *rec, struct lyd_node *root)
+{
+    const struct instid_step *step;
+    struct lyd_node *siblings = root, *node = NULL;
+    uint32_t i, pos;
+
+    for (i = 0; i < rec->count; ++i) {
+        step = &rec->steps[i];
+        if (step->pos) {
+            pos = 0;
+            LY_TREE_FOR(siblings, node) {
+                if ((node->schema == step->schema) && (++pos == step->pos)) {
+                    break;
+                }
+            }
+        } else {
+            node = siblings ? resolve_data_sibling_val(siblings, step->schema, step->values) : NULL;
+        }
+        if (!node) {
+            return NULL;
+        }
+        siblings = node->child;
+    }
+
+    return node;
+}
+
+/**
+ * @brief Resolve instance-identifier in JSON data format. Logs directly.
+ *
+ * @param[in] data Data node where the path is used
+ * @param[in] path Instance-identifier node value.
+ * @param[in,out] ret Resolved instance or NULL.
+ *
+ * @return 0 on success (even if unresolved and \p ret is NULL), -1 on error.
+ */
+static int
+resolve_instid(struct lyd_node *data, const char *path, int req_inst, struct lyd_node **ret)
+{
+    int i = 0, j, parsed, cur_idx;
+    const struct lys_module *mod, *prev_mod = NULL;
+    struct ly_ctx *ctx = data->schema->module->ctx;
+    struct lyd_node *root, *node;
+    const char *model = NULL, *name;
+    char *str;
+    int mod_len, name_len, has_predicate;
+    struct unres_data node_match;
+    const struct instid_rec *rec;
+
+    memset(&node_match, 0, sizeof node_match);
+    *ret = NULL;
+
+    /* we need root to resolve absolute path */
+    for (root = data; root->parent; root = root->parent);
+    /* we're still parsing it and the pointer is not correct yet */
+    if (root->prev) {
+        for (; root->prev->next; root = root->prev);
+    }
+
+    /* the compiled value finds the existing instances, the string is evaluated otherwise */
+    rec = resolve_instid_get(ctx, path, NULL);
+    if (rec && rec->count && (*ret = resolve_instid_compiled(rec, root))) {
+        return EXIT_SUCCESS;
+    }
+
+    /* search for the instance node */
+    while (path[i]) {
+        j = parse_instance_identifier(&path[i], &model, &mod_len, &name, &name_len, &has_predicate);
+        if (j <= 0) {
+            LOGVAL(ctx, LYE_INCHAR, LY_VLOG_LYD, data, path[i-j], &path[i-j]);
+            goto error;
+        }
+        i += j;
+
+        if (model) {
+            str = strndup(model, mod_len);
+            if (!str) {
+                LOGMEM(ctx);
+                goto error;
+            }
+            mod = ly_ctx_get_module(ctx, str, NULL, 1);
+            if (ctx->data_clb) {
+                if (!mod) {
+                    mod = ctx->data_clb(ctx, str, NULL, 0, ctx->data_clb_data);
+                } else if (!mod->implemented) {
+                    mod = ctx->data_clb(ctx, mod->name, mod->ns, LY_MODCLB_NOT_IMPLEMENTED, ctx->data_clb_data);
+                }
+            }
+            free(str);
+
+            if (!mod || !mod->implemented || mod->disabled) {
+                break;
+            }
+        } else if (!prev_mod) {
+            /* first iteration and we are missing module name */
+            LOGVAL(ctx, LYE_INELEM_LEN, LY_VLOG_LYD, data, name_len, name);
+            LOGVAL(ctx, LYE_SPEC, LY_VLOG_PREV, NULL, "Instance-identifier is missing prefix in the first node.");
+            goto error;
+        } else {
+            mod = prev_mod;
+        }
+
+        if (resolve_data(mod, name, name_len, root, &node_match)) {
+            /* no instance exists */
+            break;
         }
 
         if (has_predicate) {
@@ -7981,37 +8628,189 @@ error:
     return -1;
 }
 
+/**
+ * @brief Index of the target instances of one leafref path, all the leafrefs with this path in one data tree
+ * share it while being resolved.
+ */
+struct lref_idx_path {
+    const char *path;              /**< leafref path (dictionary string from the schema) */
+    const struct lys_module *mod;  /**< module to resolve the prefixes of the path in */
+    const struct lys_node *op;     /**< input/output/notification the leafrefs are in, if any */
+    struct hash_table *ht;         /**< target leaf/leaf-list instances hashed by their value */
+};
+
+/**
+ * @brief Leafref target indices used while resolving the leafrefs of one data tree.
+ */
+struct lref_idx {
+    struct lref_idx_path *paths;
+    uint32_t count;
+};
+
+static uint32_t
+lref_idx_hash(const char *value_str)
+{
+    uint32_t hash;
+
+    /* values are in the dictionary, so their pointers identify them */
+    hash = dict_hash_multi(0, (const char *)&value_str, sizeof value_str);
+    return dict_hash_multi(hash, NULL, 0);
+}
+
 static int
-resolve_leafref(struct lyd_node_leaf_list *leaf, const char *path, int req_inst, struct lyd_node **ret)
+lref_idx_val_equal(void *val1_p, void *val2_p, int UNUSED(mod), void *UNUSED(cb_data))
+{
+    struct lyd_node_leaf_list *val1, *val2;
+
+    val1 = *((struct lyd_node_leaf_list **)val1_p);
+    val2 = *((struct lyd_node_leaf_list **)val2_p);
+
+    return ly_strequal(val1->value_str, val2->value_str, 1);
+}
+
+static void
+lref_idx_free(struct lref_idx *idx)
 {
+    uint32_t i;
+
+    for (i = 0; i < idx->count; ++i) {
+        lyht_free(idx->paths[i].ht);
+    }
+    free(idx->paths);
+    idx->paths = NULL;
+    idx->count = 0;
+}
+
+/**
+ * @brief Get the target index of a leafref path, build it if not yet created. Only absolute paths without
+ * predicates select the same target instances for all the leafrefs and can be indexed.
+ *
+ * @param[in] leaf Leafref instance to be resolved.
+ * @param[in] path Leafref path.
+ * @param[in] idx Leafref target indices.
+ * @param[out] ht Target index hash table, NULL if the path cannot be indexed.
+ * @return EXIT_SUCCESS on success, -1 on error.
+ */
+static int
+lref_idx_get(struct lyd_node_leaf_list *leaf, const char *path, struct lref_idx *idx, struct hash_table **ht)
+{
+    struct ly_ctx *ctx = leaf->schema->module->ctx;
+    const struct lys_module *mod = lyd_node_module((struct lyd_node *)leaf);
+    const struct lys_node *op;
+    struct lref_idx_path *ipath;
     struct lyxp_set xp_set;
+    struct lyd_node *target;
     uint32_t i;
+    int rc;
+    void *mem;
 
-    memset(&xp_set, 0, sizeof xp_set);
-    *ret = NULL;
+    *ht = NULL;
+    if ((path[0] != '/') || strchr(path, '[')) {
+        /* the targets depend on the leafref instance */
+        return EXIT_SUCCESS;
+    }
+
+    /* the accessible tree differs in operations and notifications */
+    for (op = lys_parent(leaf->schema); op && !(op->nodetype & (LYS_INPUT | LYS_OUTPUT | LYS_NOTIF)); op = lys_parent(op));
+
+    for (i = 0; i < idx->count; ++i) {
+        if ((idx->paths[i].path == path) && (idx->paths[i].mod == mod) && (idx->paths[i].op == op)) {
+            *ht = idx->paths[i].ht;
+            return EXIT_SUCCESS;
+        }
+    }
 
-    /* syntax was already checked, so just evaluate the path using standard XPath */
-    if (lyxp_eval(path, (struct lyd_node *)leaf, LYXP_NODE_ELEM, lyd_node_module((struct lyd_node *)leaf), &xp_set, 0) != EXIT_SUCCESS) {
+    /* evaluate the path once and index all the targets */
+    memset(&xp_set, 0, sizeof xp_set);
+    if (lyxp_eval(path, (struct lyd_node *)leaf, LYXP_NODE_ELEM, mod, &xp_set, 0) != EXIT_SUCCESS) {
         return -1;
     }
 
+    mem = realloc(idx->paths, (idx->count + 1) * sizeof *idx->paths);
+    LY_CHECK_ERR_GOTO(!mem, LOGMEM(ctx), error);
+    idx->paths = mem;
+    ipath = &idx->paths[idx->count];
+    ipath->path = path;
+    ipath->mod = mod;
+    ipath->op = op;
+    ipath->ht = lyht_new(1, sizeof target, lref_idx_val_equal, NULL, 1);
+    LY_CHECK_ERR_GOTO(!ipath->ht, LOGMEM(ctx), error);
+    ++idx->count;
+
     if (xp_set.type == LYXP_SET_NODE_SET) {
+        if (lyht_reserve(ipath->ht, xp_set.used)) {
+            LOGMEM(ctx);
+            goto error;
+        }
         for (i = 0; i < xp_set.used; ++i) {
             if ((xp_set.val.nodes[i].type != LYXP_NODE_ELEM) || !(xp_set.val.nodes[i].node->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST))) {
                 continue;
             }
 
-            /* not that the value is already in canonical form since the parsers does the conversion,
-             * so we can simply compare just the values */
-            if (ly_strequal(leaf->value_str, ((struct lyd_node_leaf_list *)xp_set.val.nodes[i].node)->value_str, 1)) {
-                /* we have the match */
-                *ret = xp_set.val.nodes[i].node;
-                break;
+            /* keep only the first target with a value, as the XPath evaluation would find it */
+            target = xp_set.val.nodes[i].node;
+            rc = lyht_insert(ipath->ht, &target, lref_idx_hash(((struct lyd_node_leaf_list *)target)->value_str), NULL);
+            if (rc == -1) {
+                LOGMEM(ctx);
+                goto error;
             }
         }
     }
 
     lyxp_set_cast(&xp_set, LYXP_SET_EMPTY, (struct lyd_node *)leaf, NULL, 0);
+    *ht = ipath->ht;
+    return EXIT_SUCCESS;
+
+error:
+    lyxp_set_cast(&xp_set, LYXP_SET_EMPTY, (struct lyd_node *)leaf, NULL, 0);
+    return -1;
+}
+
+static int
+resolve_leafref(struct lyd_node_leaf_list *leaf, const char *path, int req_inst, struct lref_idx *idx,
+                struct lyd_node **ret)
+{
+    struct lyxp_set xp_set;
+    struct hash_table *ht = NULL;
+    struct lyd_node **match_p;
+    uint32_t i;
+
+    memset(&xp_set, 0, sizeof xp_set);
+    *ret = NULL;
+
+    if (idx && lref_idx_get(leaf, path, idx, &ht)) {
+        return -1;
+    }
+
+    if (ht) {
+        /* the value is already in canonical form, look it up directly */
+        if (!lyht_find(ht, &leaf, lref_idx_hash(leaf->value_str), (void **)&match_p)) {
+            *ret = *match_p;
+        }
+    } else {
+        /* syntax was already checked, so just evaluate the path using standard XPath */
+        if (lyxp_eval(path, (struct lyd_node *)leaf, LYXP_NODE_ELEM, lyd_node_module((struct lyd_node *)leaf), &xp_set, 0) != EXIT_SUCCESS) {
+            return -1;
+        }
+
+        if (xp_set.type == LYXP_SET_NODE_SET) {
+            for (i = 0; i < xp_set.used; ++i) {
+                if ((xp_set.val.nodes[i].type != LYXP_NODE_ELEM) || !(xp_set.val.nodes[i].node->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST))) {
+                    continue;
+                }
+
+                /* not that the value is already in canonical form since the parsers does the conversion,
+                 * so we can simply compare just the values */
+                if (ly_strequal(leaf->value_str, ((struct lyd_node_leaf_list *)xp_set.val.nodes[i].node)->value_str, 1)) {
+                    /* we have the match */
+                    *ret = xp_set.val.nodes[i].node;
+                    break;
+                }
+            }
+        }
+
+        lyxp_set_cast(&xp_set, LYXP_SET_EMPTY, (struct lyd_node *)leaf, NULL, 0);
+    }
 
     if (!*ret) {
         /* reference not found */
@@ -8049,6 +8848,7 @@ resolve_union(struct lyd_node_leaf_list *leaf, struct lys_type *type, int store,
         lyd_free_value(leaf->value, leaf->value_type, leaf->value_flags, &((struct lys_node_leaf *)leaf->schema)->type,
                        leaf->value_str, NULL, NULL, NULL);
         memset(&leaf->value, 0, sizeof leaf->value);
+        leaf->value_flags &= ~LY_VALUE_USER;
     }
 
     /* turn logging off, we are going to try to validate the value with all the types in order */
@@ -8067,7 +8867,7 @@ resolve_union(struct lyd_node_leaf_list *leaf, struct lys_type *type, int store,
                 req_inst = t->info.lref.req;
             }
 
-            if (!resolve_leafref(leaf, t->info.lref.path, req_inst, &ret)) {
+            if (!resolve_leafref(leaf, t->info.lref.path, req_inst, NULL, &ret)) {
                 if (store) {
                     if (ret && !(leaf->schema->flags & LYS_LEAFREF_DEP)) {
                         /* valid resolved */
@@ -8124,7 +8924,8 @@ resolve_union(struct lyd_node_leaf_list *leaf, struct lys_type *type, int store,
             }
             break;
         default:
-            if (lyp_parse_value(t, &leaf->value_str, NULL, leaf, NULL, NULL, store, 0, 0)) {
+            if (lyp_union_type_may_match(t, leaf->value_str)
+                    && lyp_parse_value(t, &leaf->value_str, NULL, leaf, NULL, NULL, store, 0, 0)) {
                 success = 1;
             }
             break;
@@ -8138,6 +8939,7 @@ resolve_union(struct lyd_node_leaf_list *leaf, struct lys_type *type, int store,
         if (store) {
             lyd_free_value(leaf->value, leaf->value_type, leaf->value_flags, t, leaf->value_str, NULL, NULL, NULL);
             memset(&leaf->value, 0, sizeof leaf->value);
+            leaf->value_flags &= ~LY_VALUE_USER;
         }
     }
 
@@ -8169,6 +8971,283 @@ resolve_union(struct lyd_node_leaf_list *leaf, struct lys_type *type, int store,
 
 }
 
+/**
+ * @brief Record of a data node in the reverse leafref index of a context.
+ */
+struct lref_rev_rec {
+    const struct lyd_node *node;   /**< leaf/leaf-list instance */
+    const struct lyd_node *target; /**< target the node (a leafref) is linked to, if any */
+    struct ly_set *referrers;      /**< leafrefs linked to the node (a target), if any */
+};
+
+static int
+lref_rev_rec_equal(void *val1_p, void *val2_p, int UNUSED(mod), void *UNUSED(cb_data))
+{
+    return (*(struct lref_rev_rec **)val1_p)->node == (*(struct lref_rev_rec **)val2_p)->node;
+}
+
+static uint32_t
+lref_rev_hash(const struct lyd_node *node)
+{
+    return dict_hash_multi(dict_hash_multi(0, (const char *)&node, sizeof node), NULL, 0);
+}
+
+/* get the record of a node, create it if requested, the index lock must be held */
+static struct lref_rev_rec *
+lref_rev_rec_get(struct ly_ctx *ctx, const struct lyd_node *node, int create)
+{
+    struct lref_rev_rec rec_s, *rec = &rec_s, **rec_p;
+    uint32_t hash;
+
+    hash = lref_rev_hash(node);
+    rec_s.node = node;
+    if (!lyht_find(ctx->lref_rev, &rec, hash, (void **)&rec_p)) {
+        return *rec_p;
+    } else if (!create) {
+        return NULL;
+    }
+
+    rec = calloc(1, sizeof *rec);
+    LY_CHECK_ERR_RETURN(!rec, LOGMEM(ctx), NULL);
+    rec->node = node;
+    if (lyht_insert(ctx->lref_rev, &rec, hash, NULL)) {
+        LOGMEM(ctx);
+        free(rec);
+        return NULL;
+    }
+    return rec;
+}
+
+/* free the record of a node if it holds no link anymore, the index lock must be held */
+static void
+lref_rev_rec_release(struct ly_ctx *ctx, struct lref_rev_rec *rec)
+{
+    if (rec->target || (rec->referrers && rec->referrers->number)) {
+        return;
+    }
+
+    lyht_remove(ctx->lref_rev, &rec, lref_rev_hash(rec->node));
+    ly_set_free(rec->referrers);
+    free(rec);
+}
+
+/* remove a leafref from the referrers of its target, the index lock must be held */
+static void
+lref_rev_unlink(struct ly_ctx *ctx, struct lref_rev_rec *rec)
+{
+    struct lref_rev_rec *trg_rec;
+
+    if (!rec->target) {
+        return;
+    }
+
+    trg_rec = lref_rev_rec_get(ctx, rec->target, 0);
+    rec->target = NULL;
+    if (trg_rec && trg_rec->referrers) {
+        ly_set_rm(trg_rec->referrers, (void *)rec->node);
+        lref_rev_rec_release(ctx, trg_rec);
+    }
+}
+
+/* forget the leafrefs linked to a target, the index lock must be held */
+static struct ly_set *
+lref_rev_unlink_referrers(struct ly_ctx *ctx, struct lref_rev_rec *rec)
+{
+    struct lref_rev_rec *ref_rec;
+    struct ly_set *referrers;
+    uint32_t i;
+
+    referrers = rec->referrers;
+    rec->referrers = NULL;
+    for (i = 0; referrers && (i < referrers->number); ++i) {
+        ref_rec = lref_rev_rec_get(ctx, referrers->set.d[i], 0);
+        if (ref_rec && (ref_rec->target == rec->node)) {
+            ref_rec->target = NULL;
+            lref_rev_rec_release(ctx, ref_rec);
+        }
+    }
+
+    return referrers;
+}
+
+/**
+ * @brief Store a resolved leafref link into the reverse leafref index of the context, if enabled.
+ *
+ * @param[in] leaf Resolved leafref instance.
+ * @param[in] target Its target instance.
+ * @return EXIT_SUCCESS on success, -1 on error.
+ */
+static int
+lref_rev_add(struct lyd_node_leaf_list *leaf, struct lyd_node *target)
+{
+    struct ly_ctx *ctx = leaf->schema->module->ctx;
+    struct lref_rev_rec *rec, *trg_rec;
+    int ret = -1;
+
+    if (!ctx->lref_rev) {
+        return EXIT_SUCCESS;
+    }
+
+    pthread_mutex_lock(&ctx->lref_rev_lock);
+
+    rec = lref_rev_rec_get(ctx, (struct lyd_node *)leaf, 1);
+    if (!rec) {
+        goto cleanup;
+    }
+    if (rec->target != target) {
+        lref_rev_unlink(ctx, rec);
+
+        trg_rec = lref_rev_rec_get(ctx, target, 1);
+        if (!trg_rec) {
+            goto cleanup;
+        }
+        if (!trg_rec->referrers) {
+            trg_rec->referrers = ly_set_new();
+            LY_CHECK_ERR_GOTO(!trg_rec->referrers, LOGMEM(ctx), cleanup);
+        }
+        if (ly_set_add(trg_rec->referrers, leaf, 0) == -1) {
+            goto cleanup;
+        }
+        rec->target = target;
+    }
+    ret = EXIT_SUCCESS;
+
+cleanup:
+    if (ret && rec) {
+        lref_rev_rec_release(ctx, rec);
+    }
+    pthread_mutex_unlock(&ctx->lref_rev_lock);
+    return ret;
+}
+
+struct ly_set *
+resolve_lref_rev_take(const struct lyd_node *target)
+{
+    struct ly_ctx *ctx = target->schema->module->ctx;
+    struct lref_rev_rec *rec;
+    struct ly_set *referrers = NULL;
+
+    pthread_mutex_lock(&ctx->lref_rev_lock);
+    rec = lref_rev_rec_get(ctx, target, 0);
+    if (rec) {
+        referrers = lref_rev_unlink_referrers(ctx, rec);
+        lref_rev_rec_release(ctx, rec);
+    }
+    pthread_mutex_unlock(&ctx->lref_rev_lock);
+
+    return referrers;
+}
+
+void
+resolve_lref_rev_remove(const struct lyd_node *node)
+{
+    struct ly_ctx *ctx = node->schema->module->ctx;
+    struct lref_rev_rec *rec;
+
+    pthread_mutex_lock(&ctx->lref_rev_lock);
+    rec = lref_rev_rec_get(ctx, node, 0);
+    if (rec) {
+        lref_rev_unlink(ctx, rec);
+        ly_set_free(lref_rev_unlink_referrers(ctx, rec));
+        lref_rev_rec_release(ctx, rec);
+    }
+    pthread_mutex_unlock(&ctx->lref_rev_lock);
+}
+
+void
+resolve_lref_rev_clean(struct ly_ctx *ctx)
+{
+    struct lref_rev_rec **rec_p;
+    uint32_t i;
+
+    if (!ctx->lref_rev) {
+        return;
+    }
+
+    lyht_finish_resize(ctx->lref_rev);
+    for (i = 0; i < ctx->lref_rev->size; ++i) {
+        rec_p = lyht_get_val(ctx->lref_rev, i);
+        if (rec_p) {
+            ly_set_free((*rec_p)->referrers);
+            free(*rec_p);
+        }
+    }
+    lyht_free(ctx->lref_rev);
+    ctx->lref_rev = NULL;
+}
+
+int
+resolve_lref_rev_init(struct ly_ctx *ctx)
+{
+    ctx->lref_rev = lyht_new(64, sizeof(struct lref_rev_rec *), lref_rev_rec_equal, NULL, 1);
+    LY_CHECK_ERR_RETURN(!ctx->lref_rev, LOGMEM(ctx), -1);
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Resolve a leafref unres data item. Logs directly.
+ *
+ * @param[in] leaf Leafref instance to resolve.
+ * @param[in] ignore_fail 0 - no, 1 - yes, 2 - yes, but only for external dependencies.
+ * @param[in] idx Leafref target indices to use, NULL to always evaluate the path.
+ *
+ * @return EXIT_SUCCESS on success, EXIT_FAILURE on forward reference, -1 on error.
+ */
+static int
+resolve_unres_data_leafref(struct lyd_node_leaf_list *leaf, int ignore_fail, struct lref_idx *idx)
+{
+    int rc, req_inst;
+    struct lyd_node *ret;
+    struct lys_node_leaf *sleaf = (struct lys_node_leaf *)leaf->schema;
+    struct ly_profile_mark mark;
+
+    assert(sleaf->type.base == LY_TYPE_LEAFREF);
+    assert(leaf->validity & LYD_VAL_LEAFREF);
+    if (ignore_fail) {
+        req_inst = -1;
+    } else {
+        req_inst = sleaf->type.info.lref.req;
+    }
+    if ((leaf->schema->flags & LYS_LEAFREF_DEP) && (ignore_fail == 2)) {
+        /* do not even try to resolve */
+        rc = 0;
+        ret = NULL;
+    } else {
+        ++ly_cnt.leafref_resolutions;
+        ly_profile_start(&mark);
+        rc = resolve_leafref(leaf, sleaf->type.info.lref.path, req_inst, idx, &ret);
+        ly_profile_end(&mark, LY_PROFILE_LEAFREF, leaf->schema, sleaf->type.info.lref.path, leaf->schema->module->ctx);
+    }
+    if (rc) {
+        return rc;
+    }
+
+    if (ret && !(leaf->schema->flags & LYS_LEAFREF_DEP)) {
+        /* valid resolved */
+        if (leaf->value_flags & LY_VALUE_USER) {
+            lytype_free(&sleaf->type, leaf->value, leaf->value_str);
+        } else if (leaf->value_type == LY_TYPE_BITS) {
+            free(leaf->value.bit);
+        }
+        leaf->value.leafref = ret;
+        leaf->value_type = LY_TYPE_LEAFREF;
+        leaf->value_flags &= ~(LY_VALUE_UNRES | LY_VALUE_USER);
+        if (lref_rev_add(leaf, ret)) {
+            return -1;
+        }
+    } else {
+        /* valid unresolved */
+        if (!(leaf->value_flags & LY_VALUE_UNRES)) {
+            if (!lyp_parse_value(&sleaf->type, &leaf->value_str, NULL, leaf, NULL, NULL, 1, 0, 0)) {
+                return -1;
+            }
+        }
+    }
+    leaf->validity &= ~LYD_VAL_LEAFREF;
+
+    return EXIT_SUCCESS;
+}
+
 /**
  * @brief Resolve a single unres data item. Logs directly.
  *
@@ -8191,39 +9270,8 @@ resolve_unres_data_item(struct lyd_node *node, enum UNRES_ITEM type, int ignore_
 
     switch (type) {
     case UNRES_LEAFREF:
-        assert(sleaf->type.base == LY_TYPE_LEAFREF);
-        assert(leaf->validity & LYD_VAL_LEAFREF);
-        if (ignore_fail) {
-            req_inst = -1;
-        } else {
-            req_inst = sleaf->type.info.lref.req;
-        }
-        if ((leaf->schema->flags & LYS_LEAFREF_DEP) && (ignore_fail == 2)) {
-            /* do not even try to resolve */
-            rc = 0;
-            ret = NULL;
-        } else {
-            rc = resolve_leafref(leaf, sleaf->type.info.lref.path, req_inst, &ret);
-        }
-        if (!rc) {
-            if (ret && !(leaf->schema->flags & LYS_LEAFREF_DEP)) {
-                /* valid resolved */
-                if (leaf->value_type == LY_TYPE_BITS) {
-                    free(leaf->value.bit);
-                }
-                leaf->value.leafref = ret;
-                leaf->value_type = LY_TYPE_LEAFREF;
-                leaf->value_flags &= ~LY_VALUE_UNRES;
-            } else {
-                /* valid unresolved */
-                if (!(leaf->value_flags & LY_VALUE_UNRES)) {
-                    if (!lyp_parse_value(&sleaf->type, &leaf->value_str, NULL, leaf, NULL, NULL, 1, 0, 0)) {
-                        return -1;
-                    }
-                }
-            }
-            leaf->validity &= ~LYD_VAL_LEAFREF;
-        } else {
+        rc = resolve_unres_data_leafref(leaf, ignore_fail, NULL);
+        if (rc) {
             return rc;
         }
         break;
@@ -8300,6 +9348,125 @@ resolve_unres_data_item(struct lyd_node *node, enum UNRES_ITEM type, int ignore_
     return EXIT_SUCCESS;
 }
 
+/* minimal number of must conditions evaluated by one thread with #LYD_OPT_PARALLEL */
+#define UNRES_MUST_PARALLEL_MIN 64
+
+struct unres_must_worker {
+    struct unres_data *unres;
+    const uint32_t *items;  /* indices of the must items in unres */
+    uint32_t start;         /* first item of this worker */
+    uint32_t end;           /* item after the last item of this worker */
+    int ignore_fail;
+    uint32_t failed;        /* first failed item, end if none */
+};
+
+static void
+resolve_unres_must_worker(void *arg)
+{
+    struct unres_must_worker *worker = (struct unres_must_worker *)arg;
+    enum int_log_opts prev_ilo;
+    uint32_t i, idx;
+
+    /* the errors would be stored only for this thread, the failed item is resolved again by the caller */
+    ly_ilo_change(NULL, ILO_IGNORE, &prev_ilo, NULL);
+
+    worker->failed = worker->end;
+    for (i = worker->start; i < worker->end; ++i) {
+        idx = worker->items[i];
+        if (resolve_unres_data_item(worker->unres->node[idx], worker->unres->type[idx], worker->ignore_fail, NULL)) {
+            worker->failed = i;
+            break;
+        }
+    }
+
+    ly_ilo_restore(NULL, prev_ilo, NULL, 0);
+}
+
+/**
+ * @brief Resolve the remaining unres data items, the must conditions concurrently (#LYD_OPT_PARALLEL).
+ *
+ * Evaluating must conditions does not modify the data tree so they can be split among the threads in contiguous
+ * ranges. All the other items may modify the data and are resolved first in the calling thread. If some must
+ * conditions are not satisfied, the first of them (in the unres order) is evaluated again to log the error
+ * so that the result does not depend on the scheduling.
+ *
+ * @param[in] unres Unres data structure with resolved when conditions and leafrefs.
+ * @param[in] ignore_fail 0 - no, 1 - yes, 2 - yes, but only for external dependencies.
+ * @return EXIT_SUCCESS on success, -1 on error.
+ */
+static int
+resolve_unres_data_parallel(struct unres_data *unres, int ignore_fail)
+{
+    struct unres_must_worker *workers = NULL;
+    struct ly_ctx *ctx = NULL;
+    uint32_t *items = NULL, i, count = 0, thread_count, failed;
+    int ret = -1;
+
+    /* items that may modify the data */
+    for (i = 0; i < unres->count; ++i) {
+        if (unres->type[i] == UNRES_RESOLVED) {
+            continue;
+        } else if ((unres->type[i] == UNRES_MUST) || (unres->type[i] == UNRES_MUST_INOUT)) {
+            ctx = unres->node[i]->schema->module->ctx;
+            ++count;
+            continue;
+        }
+
+        if (resolve_unres_data_item(unres->node[i], unres->type[i], ignore_fail, NULL)) {
+            /* since when was already resolved, a forward reference is an error */
+            return -1;
+        }
+        unres->type[i] = UNRES_RESOLVED;
+    }
+
+    thread_count = ly_parallel_count(ctx, count / UNRES_MUST_PARALLEL_MIN);
+    if (thread_count < 2) {
+        /* not worth it, resolved by the caller */
+        return EXIT_SUCCESS;
+    }
+
+    items = malloc(count * sizeof *items);
+    workers = calloc(thread_count, sizeof *workers);
+    LY_CHECK_ERR_GOTO(!items || !workers, LOGMEM(NULL), cleanup);
+    for (i = count = 0; i < unres->count; ++i) {
+        if ((unres->type[i] == UNRES_MUST) || (unres->type[i] == UNRES_MUST_INOUT)) {
+            items[count++] = i;
+        }
+    }
+
+    /* the calling thread evaluates its range as the first worker */
+    for (i = 0; i < thread_count; ++i) {
+        workers[i].unres = unres;
+        workers[i].items = items;
+        workers[i].start = (uint32_t)(((uint64_t)count * i) / thread_count);
+        workers[i].end = (uint32_t)(((uint64_t)count * (i + 1)) / thread_count);
+        workers[i].ignore_fail = ignore_fail;
+    }
+    ly_parallel_run(ctx, resolve_unres_must_worker, workers, sizeof *workers, thread_count);
+    failed = count;
+    for (i = 0; i < thread_count; ++i) {
+        if ((failed == count) && (workers[i].failed < workers[i].end)) {
+            failed = workers[i].failed;
+        }
+    }
+
+    /* evaluate the items from the first failed one again, now logging normally */
+    for (i = failed; i < count; ++i) {
+        if (resolve_unres_data_item(unres->node[items[i]], unres->type[items[i]], ignore_fail, NULL)) {
+            goto cleanup;
+        }
+    }
+    for (i = 0; i < count; ++i) {
+        unres->type[items[i]] = UNRES_RESOLVED;
+    }
+    ret = EXIT_SUCCESS;
+
+cleanup:
+    free(items);
+    free(workers);
+    return ret;
+}
+
 /**
  * @brief add data unres item
  *
@@ -8315,13 +9482,19 @@ unres_data_add(struct unres_data *unres, struct lyd_node *node, enum UNRES_ITEM
     assert((type == UNRES_LEAFREF) || (type == UNRES_INSTID) || (type == UNRES_WHEN) || (type == UNRES_MUST)
            || (type == UNRES_MUST_INOUT) || (type == UNRES_UNION) || (type == UNRES_UNIQ_LEAVES));
 
+    if (unres->count == unres->size) {
+        /* grow geometrically, the items are added one by one for every node */
+        unres->size = unres->size ? unres->size * 2 : 8;
+        unres->node = ly_realloc(unres->node, unres->size * sizeof *unres->node);
+        LY_CHECK_ERR_RETURN(!unres->node, LOGMEM(NULL); free(unres->type); unres->type = NULL;
+                            unres->size = unres->count = 0, -1);
+        unres->type = ly_realloc(unres->type, unres->size * sizeof *unres->type);
+        LY_CHECK_ERR_RETURN(!unres->type, LOGMEM(NULL); free(unres->node); unres->node = NULL;
+                            unres->size = unres->count = 0, -1);
+    }
+    unres->node[unres->count] = node;
+    unres->type[unres->count] = type;
     unres->count++;
-    unres->node = ly_realloc(unres->node, unres->count * sizeof *unres->node);
-    LY_CHECK_ERR_RETURN(!unres->node, LOGMEM(NULL), -1);
-    unres->node[unres->count - 1] = node;
-    unres->type = ly_realloc(unres->type, unres->count * sizeof *unres->type);
-    LY_CHECK_ERR_RETURN(!unres->type, LOGMEM(NULL), -1);
-    unres->type[unres->count - 1] = type;
 
     return 0;
 }
@@ -8397,17 +9570,101 @@ resolve_unres_data_autodel_diff(struct unres_data *unres, uint32_t unres_i)
  *
  * @return EXIT_SUCCESS on success, -1 on error.
  */
+/* unres data item with the depth of its node */
+struct unres_item_depth {
+    uint32_t idx;
+    uint32_t depth;
+};
+
+static int
+unres_item_depth_cmp(const void *ptr1, const void *ptr2)
+{
+    const struct unres_item_depth *item1 = ptr1, *item2 = ptr2;
+
+    if (item1->depth != item2->depth) {
+        return (item1->depth < item2->depth) ? -1 : 1;
+    }
+    /* keep the unres order */
+    return (item1->idx < item2->idx) ? -1 : (item1->idx > item2->idx);
+}
+
+/**
+ * @brief Collect indices of all the unres data items of a type into a worklist.
+ *
+ * @param[in] unres Unres data structure to use.
+ * @param[in] type Type of the items.
+ * @param[in] by_depth Whether to order the items by the depth of their nodes (ancestors first), they are in the unres
+ *                     order otherwise.
+ * @param[in,out] items Worklist array (reused).
+ * @param[out] count Number of items in the worklist.
+ * @return EXIT_SUCCESS on success, -1 on error.
+ */
+static int
+unres_data_worklist(struct unres_data *unres, enum UNRES_ITEM type, int by_depth, uint32_t **items, uint32_t *count)
+{
+    struct unres_item_depth *depths = NULL;
+    struct lyd_node *parent;
+    uint32_t i;
+    void *mem;
+
+    *count = 0;
+    for (i = 0; i < unres->count; ++i) {
+        if (unres->type[i] == type) {
+            ++(*count);
+        }
+    }
+    if (!*count) {
+        return EXIT_SUCCESS;
+    }
+
+    mem = realloc(*items, *count * sizeof **items);
+    LY_CHECK_ERR_RETURN(!mem, LOGMEM(NULL), -1);
+    *items = mem;
+    if (by_depth) {
+        depths = malloc(*count * sizeof *depths);
+        LY_CHECK_ERR_RETURN(!depths, LOGMEM(NULL), -1);
+    }
+
+    for (i = 0, *count = 0; i < unres->count; ++i) {
+        if (unres->type[i] != type) {
+            continue;
+        }
+        if (by_depth) {
+            depths[*count].idx = i;
+            depths[*count].depth = 0;
+            for (parent = unres->node[i]->parent; parent; parent = parent->parent) {
+                ++depths[*count].depth;
+            }
+        } else {
+            (*items)[*count] = i;
+        }
+        ++(*count);
+    }
+
+    if (by_depth) {
+        qsort(depths, *count, sizeof *depths, unres_item_depth_cmp);
+        for (i = 0; i < *count; ++i) {
+            (*items)[i] = depths[i].idx;
+        }
+        free(depths);
+    }
+
+    return EXIT_SUCCESS;
+}
+
 int
 resolve_unres_data(struct ly_ctx *ctx, struct unres_data *unres, struct lyd_node **root, int options)
 {
-    uint32_t i, j, first, resolved, del_items, stmt_count;
+    uint32_t i, j, k, del_items, *items = NULL, count, val_errs;
     uint8_t prev_when_status;
-    int rc, progress, ignore_fail;
+    int rc, progress, ignore_fail, failed;
+    LY_TRACE_PHASE phase;
     enum int_log_opts prev_ilo;
     struct ly_err_item *prev_eitem;
     LY_ERR prev_ly_errno = ly_errno;
     struct lyd_node *parent;
     struct lys_when *when;
+    struct lref_idx lref_idx = {NULL, 0};
 
     assert(root);
     assert(unres);
@@ -8431,25 +9688,27 @@ resolve_unres_data(struct ly_ctx *ctx, struct unres_data *unres, struct lyd_node
     }
 
     /*
-     * when-stmt first
+     * when-stmt first, parents before their descendants, the pending ones are attempted again after some progress
      */
-    first = 1;
-    stmt_count = 0;
-    resolved = 0;
+    phase = LY_TRACE_UNRES_WHEN;
+    ly_phase(phase, 0, ctx);
     del_items = 0;
+    if (unres_data_worklist(unres, UNRES_WHEN, 1, &items, &count)) {
+        goto error;
+    }
+    /* without the memo the conditions are just evaluated for every node */
+    resolve_when_memo = lyht_new(16, sizeof(struct resolve_when_memo_rec), resolve_when_memo_equal, NULL, 1);
     do {
         if (!ignore_fail) {
             ly_err_free_next(ctx, prev_eitem);
         }
         progress = 0;
-        for (i = 0; i < unres->count; i++) {
+        for (k = j = 0; k < count; ++k) {
+            i = items[k];
             if (unres->type[i] != UNRES_WHEN) {
+                /* in a subtree to be deleted */
                 continue;
             }
-            if (first) {
-                /* count when-stmt nodes in unres list */
-                stmt_count++;
-            }
 
             /* resolve when condition only when all parent when conditions are already resolved */
             for (parent = unres->node[i]->parent;
@@ -8461,11 +9720,14 @@ resolve_unres_data(struct ly_ctx *ctx, struct unres_data *unres, struct lyd_node
                      */
                     unres->node[i]->when_status |= LYD_WHEN_FALSE;
                     unres->type[i] = UNRES_RESOLVED;
-                    resolved++;
                     break;
                 }
             }
             if (parent) {
+                if (unres->type[i] == UNRES_WHEN) {
+                    /* pending */
+                    items[j++] = i;
+                }
                 continue;
             }
 
@@ -8511,17 +9773,16 @@ resolve_unres_data(struct ly_ctx *ctx, struct unres_data *unres, struct lyd_node
                     del_items++;
 
                     /* update the rest of unres items */
-                    for (j = 0; j < unres->count; j++) {
-                        if (unres->type[j] == UNRES_RESOLVED || unres->type[j] == UNRES_DELETE) {
+                    for (rc = 0; rc < (signed)unres->count; rc++) {
+                        if (unres->type[rc] == UNRES_RESOLVED || unres->type[rc] == UNRES_DELETE) {
                             continue;
                         }
 
                         /* test if the node is in subtree to be deleted */
-                        for (parent = unres->node[j]; parent; parent = parent->parent) {
+                        for (parent = unres->node[rc]; parent; parent = parent->parent) {
                             if (parent == unres->node[i]) {
                                 /* yes, it is */
-                                unres->type[j] = UNRES_RESOLVED;
-                                resolved++;
+                                unres->type[rc] = UNRES_RESOLVED;
                                 break;
                             }
                         }
@@ -8532,17 +9793,23 @@ resolve_unres_data(struct ly_ctx *ctx, struct unres_data *unres, struct lyd_node
                 if (!ignore_fail) {
                     ly_err_free_next(ctx, prev_eitem);
                 }
-                resolved++;
                 progress = 1;
             } else if (rc == -1) {
                 goto error;
-            } /* else forward reference */
+            } else {
+                /* forward reference, pending */
+                items[j++] = i;
+            }
         }
-        first = 0;
-    } while (progress && resolved < stmt_count);
+        count = j;
+    } while (progress && count);
+
+    /* the tree is going to change */
+    lyht_free(resolve_when_memo);
+    resolve_when_memo = NULL;
 
     /* do we have some unresolved when-stmt? */
-    if (stmt_count > resolved) {
+    if (count) {
         goto error;
     }
 
@@ -8570,6 +9837,9 @@ resolve_unres_data(struct ly_ctx *ctx, struct unres_data *unres, struct lyd_node
     /*
      * now leafrefs
      */
+    ly_phase(phase, 1, ctx);
+    phase = LY_TRACE_UNRES_LEAFREF;
+    ly_phase(phase, 0, ctx);
     if (options & LYD_OPT_TRUSTED) {
         /* we want to attempt to resolve leafrefs */
         assert(!ignore_fail);
@@ -8578,69 +9848,92 @@ resolve_unres_data(struct ly_ctx *ctx, struct unres_data *unres, struct lyd_node
         ly_ilo_restore(ctx, prev_ilo, prev_eitem, 0);
         ly_errno = prev_ly_errno;
     }
-    first = 1;
-    stmt_count = 0;
-    resolved = 0;
+    if (unres_data_worklist(unres, UNRES_LEAFREF, 0, &items, &count)) {
+        goto error;
+    }
     do {
         progress = 0;
-        for (i = 0; i < unres->count; i++) {
-            if (unres->type[i] != UNRES_LEAFREF) {
-                continue;
-            }
-            if (first) {
-                /* count leafref nodes in unres list */
-                stmt_count++;
-            }
+        for (k = j = 0; k < count; ++k) {
+            i = items[k];
 
-            rc = resolve_unres_data_item(unres->node[i], unres->type[i], ignore_fail, NULL);
+            /* the data tree does not change anymore, so the targets can be indexed */
+            rc = resolve_unres_data_leafref((struct lyd_node_leaf_list *)unres->node[i], ignore_fail, &lref_idx);
             if (!rc) {
                 unres->type[i] = UNRES_RESOLVED;
                 if (!ignore_fail) {
                     ly_err_free_next(ctx, prev_eitem);
                 }
-                resolved++;
                 progress = 1;
             } else if (rc == -1) {
                 goto error;
-            } /* else forward reference */
+            } else {
+                /* forward reference, pending */
+                items[j++] = i;
+            }
         }
-        first = 0;
-    } while (progress && resolved < stmt_count);
+        count = j;
+    } while (progress && count);
+    lref_idx_free(&lref_idx);
 
     /* do we have some unresolved leafrefs? */
-    if (stmt_count > resolved) {
+    if (count) {
         goto error;
     }
+    free(items);
+    items = NULL;
 
     if (!ignore_fail) {
         /* log normally now, throw away irrelevant errors */
         ly_ilo_restore(ctx, prev_ilo, prev_eitem, 0);
         ly_errno = prev_ly_errno;
     }
+    ly_phase(phase, 1, ctx);
 
     /*
      * rest
      */
+    ly_phase(LY_TRACE_UNRES_REST, 0, ctx);
+    /* the errors from the other threads could not be collected (LYD_OPT_VAL_ALL) */
+    if ((options & LYD_OPT_PARALLEL) && !(options & LYD_OPT_VAL_ALL) && resolve_unres_data_parallel(unres, ignore_fail)) {
+        ly_phase(LY_TRACE_UNRES_REST, 1, ctx);
+        return -1;
+    }
+    failed = 0;
     for (i = 0; i < unres->count; ++i) {
         if (unres->type[i] == UNRES_RESOLVED) {
             continue;
         }
         assert(!(options & LYD_OPT_TRUSTED) || ((unres->type[i] != UNRES_MUST) && (unres->type[i] != UNRES_MUST_INOUT)));
 
+        val_errs = ly_vlog_collected();
         rc = resolve_unres_data_item(unres->node[i], unres->type[i], ignore_fail, NULL);
         if (rc) {
-            /* since when was already resolved, a forward reference is an error */
-            return -1;
+            if (!(options & LYD_OPT_VAL_ALL) || (ly_vlog_collected() <= val_errs)) {
+                /* since when was already resolved, a forward reference is an error */
+                ly_phase(LY_TRACE_UNRES_REST, 1, ctx);
+                return -1;
+            }
+            /* the error was collected, continue with the rest */
+            failed = 1;
         }
 
         unres->type[i] = UNRES_RESOLVED;
     }
+    ly_phase(LY_TRACE_UNRES_REST, 1, ctx);
+    if (failed) {
+        return -1;
+    }
 
     LOGVRB("All data nodes and constraints resolved.");
     unres->count = 0;
     return EXIT_SUCCESS;
 
 error:
+    ly_phase(phase, 1, ctx);
+    free(items);
+    lref_idx_free(&lref_idx);
+    lyht_free(resolve_when_memo);
+    resolve_when_memo = NULL;
     if (!ignore_fail) {
         /* print all the new errors */
         ly_ilo_restore(ctx, prev_ilo, prev_eitem, 1);
@@ -93,6 +93,7 @@ struct unres_data {
     struct lyd_node **node;
     enum UNRES_ITEM *type;
     uint32_t count;
+    uint32_t size;              /**< allocated size of the node and type arrays */
 
     int store_diff;
     struct lyd_difflist *diff;
@@ -135,6 +136,24 @@ struct len_ran_intv {
     struct len_ran_intv *next;
 };
 
+/**
+ * @brief Length or range restriction of a single type in its compiled form.
+ */
+struct len_ran_restr {
+    struct lys_type *type;     /* type with the restriction */
+    uint32_t count;            /* number of intervals */
+    struct len_ran_intv *intv; /* intervals in ascending order (array, next is not used) */
+};
+
+/**
+ * @brief Compiled length or range restrictions of a type and all its base types,
+ * allocated as a single memory block.
+ */
+struct len_ran_chk {
+    uint32_t count;            /* number of restrictions, the base type first */
+    struct len_ran_restr restr[];
+};
+
 /**
  * @brief Convert a string with a decimal64 value into our representation.
  * Syntax is expected to be correct. Does not log.
@@ -186,8 +205,29 @@ const struct lys_node *resolve_json_nodeid(const char *nodeid, const struct ly_c
 struct lyd_node *resolve_partial_json_data_nodeid(const char *nodeid, const char *llist_value, struct lyd_node *start,
                                                   int options, int *parsed);
 
+/**
+ * @brief Find a data instance of a schema node among siblings by its key or leaf-list values.
+ *
+ * @param[in] siblings First sibling to search.
+ * @param[in] schema Schema node of the instance.
+ * @param[in] values Canonical values of all the list keys in their order or of the leaf-list, ignored for other nodes.
+ * @return Found instance, NULL if not found or on error.
+ */
+struct lyd_node *resolve_data_sibling_val(const struct lyd_node *siblings, const struct lys_node *schema,
+                                          const char **values);
+
 int resolve_len_ran_interval(struct ly_ctx *ctx, const char *str_restr, struct lys_type *type, struct len_ran_intv **ret);
 
+/**
+ * @brief Compile length or range restrictions of a type for value checks. Does not log.
+ *
+ * @param[in] ctx Context for errors.
+ * @param[in] type Type of the restrictions.
+ * @param[out] chk Compiled restrictions, to be freed with free().
+ * @return EXIT_SUCCESS on succes, -1 on error.
+ */
+int resolve_len_ran_chk(struct ly_ctx *ctx, struct lys_type *type, struct len_ran_chk **chk);
+
 int resolve_superior_type(const char *name, const char *prefix, const struct lys_module *module,
                           const struct lys_node *parent, struct lys_tpdf **ret);
 
@@ -209,6 +249,90 @@ int resolve_applies_when(const struct lys_node *schema, int mode, const struct l
  *         0x3 - 0x2 & 0x1 combined */
 int resolve_applies_must(const struct lyd_node *node);
 
+/**
+ * @brief Find an identity in the identities index of a context, which is (re)built for all the modules
+ * of the context when needed.
+ *
+ * @param[in] ctx Context to use.
+ * @param[in] base Base identity the found identity must be derived from (not only through itself), NULL for any.
+ * @param[in] module Main module of the identity.
+ * @param[in] name Name of the identity.
+ * @param[in] nam_len Length of \p name.
+ * @param[out] ret Found identity.
+ *
+ * @return EXIT_SUCCESS on success, EXIT_FAILURE if not found, -1 on error.
+ */
+int resolve_ident_find(struct ly_ctx *ctx, const struct lys_ident *base, const struct lys_module *module,
+                       const char *name, int nam_len, struct lys_ident **ret);
+
+/**
+ * @brief Build the identities index of a context, if not yet built for its current modules.
+ *
+ * @param[in] ctx Context to use.
+ * @return EXIT_SUCCESS on success, -1 on error.
+ */
+int resolve_idents_index(struct ly_ctx *ctx);
+
+/**
+ * @brief Free the identities index of a context.
+ *
+ * @param[in] ctx Context to use.
+ */
+void resolve_idents_clean(struct ly_ctx *ctx);
+
+/**
+ * @brief Transform an instance-identifier value from JSON into XML format, the same as transform_json2xml(),
+ * the result is cached with the compiled value in the context.
+ *
+ * @param[in] module Module of the leaf with the value.
+ * @param[in] value Instance-identifier in JSON format.
+ * @param[out] prefixes Array of the used prefixes, to be freed by the caller.
+ * @param[out] namespaces Array of the used namespaces, to be freed by the caller.
+ * @param[out] ns_count Number of \p prefixes and \p namespaces.
+ * @return Value in XML format (dictionary), NULL on error.
+ */
+const char *resolve_instid_json2xml(const struct lys_module *module, const char *value, const char ***prefixes,
+                                    const char ***namespaces, uint32_t *ns_count);
+
+/**
+ * @brief Free the compiled instance-identifier values of a context.
+ *
+ * @param[in] ctx Context to use.
+ */
+void resolve_instids_clean(struct ly_ctx *ctx);
+
+/**
+ * @brief Create the reverse leafref index of a context (#LY_CTX_LEAFREF_INDEX). Resolved leafref instances
+ * are then stored in it with their targets.
+ *
+ * @param[in] ctx Context to use.
+ * @return EXIT_SUCCESS on success, -1 on error.
+ */
+int resolve_lref_rev_init(struct ly_ctx *ctx);
+
+/**
+ * @brief Remove the leafrefs linked to a target from the reverse leafref index and return them.
+ *
+ * @param[in] target Leafref target instance.
+ * @return Set of the leafref instances linked to \p target (some may have been changed since), to be freed
+ * by the caller, NULL if none.
+ */
+struct ly_set *resolve_lref_rev_take(const struct lyd_node *target);
+
+/**
+ * @brief Remove a data node being freed from the reverse leafref index, both as a leafref and as a target.
+ *
+ * @param[in] node Leaf or leaf-list instance.
+ */
+void resolve_lref_rev_remove(const struct lyd_node *node);
+
+/**
+ * @brief Free the reverse leafref index of a context.
+ *
+ * @param[in] ctx Context to use.
+ */
+void resolve_lref_rev_clean(struct ly_ctx *ctx);
+
 struct lys_ident *resolve_identref(struct lys_type *type, const char *ident_name, struct lyd_node *node,
                                    struct lys_module *mod, int dflt);
 
@@ -45,6 +45,12 @@ static struct lyd_node *lyd_dup_withsiblings_to_ctx(const struct lyd_node *node,
 static struct lyd_node *lyd_new_dummy(struct lyd_node *root, struct lyd_node *parent, const struct lys_node *schema,
                                       const char *value, int dflt);
 
+static int lyd_wd_add_subtree(struct lyd_node **root, struct lyd_node *last_parent, struct lyd_node *subroot,
+                              struct lys_node *schema, int toplevel, int options, struct unres_data *unres);
+
+static int lyd_xpath_deps_schedule(struct lyd_node *first, const struct ly_set *changed, int subtrees,
+                                   struct unres_data *unres);
+
 static int
 lyd_anydata_equal(struct lyd_node *first, struct lyd_node *second)
 {
@@ -116,14 +122,29 @@ lyd_list_has_keys(struct lyd_node *list)
 static int
 lyd_leaf_val_equal(struct lyd_node *node1, struct lyd_node *node2, int diff_ctx)
 {
+    struct lyd_node_leaf_list *leaf1 = (struct lyd_node_leaf_list *)node1, *leaf2 = (struct lyd_node_leaf_list *)node2;
+    int r;
+
     assert(node1->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST));
     assert(node1->schema->nodetype == node2->schema->nodetype);
 
+    if (!diff_ctx && (leaf1->value_str == leaf2->value_str)) {
+        return 1;
+    }
+
+    /* user type values may be compared by their plugin */
+    if ((leaf1->value_flags & LY_VALUE_USER) && (leaf2->value_flags & LY_VALUE_USER)) {
+        r = lytype_compare(&((struct lys_node_leaf *)node1->schema)->type, &leaf1->value,
+                           &((struct lys_node_leaf *)node2->schema)->type, &leaf2->value);
+        if (r > -1) {
+            return !r;
+        }
+    }
+
     if (diff_ctx) {
-        return ly_strequal(((struct lyd_node_leaf_list *)node1)->value_str, ((struct lyd_node_leaf_list *)node2)->value_str, 0);
-    } else {
-        return ly_strequal(((struct lyd_node_leaf_list *)node1)->value_str, ((struct lyd_node_leaf_list *)node2)->value_str, 1);
+        return ly_strequal(leaf1->value_str, leaf2->value_str, 0);
     }
+    return 0;
 }
 
 /*
@@ -318,30 +339,56 @@ lyd_hash_table_val_equal(void *val1_p, void *val2_p, int mod, void *UNUSED(cb_da
     return 0;
 }
 
-static void
-lyd_hash_keyless_list_dfs(struct lyd_node *child, uint32_t *hash)
+static uint32_t lyd_hash_keyless_list_sum(struct lyd_node *child);
+
+/* part of a key-less list hash for one of its descendants and their subtree */
+static uint32_t
+lyd_hash_keyless_list_node(struct lyd_node *node)
+{
+    switch (node->schema->nodetype) {
+    case LYS_CONTAINER:
+    case LYS_RPC:
+    case LYS_ACTION:
+    case LYS_NOTIF:
+        return lyd_hash_keyless_list_sum(node->child);
+    case LYS_LIST:
+        /* ignore lists with missing keys */
+        return lyd_list_has_keys(node) ? lyd_hash_keyless_list_sum(node->child) : 0;
+    case LYS_LEAFLIST:
+    case LYS_ANYXML:
+    case LYS_ANYDATA:
+    case LYS_LEAF:
+        return node->hash;
+    default:
+        assert(0);
+        return 0;
+    }
+}
+
+/* a key-less list hash is the sum of the hashes of all its descendant terminal nodes (in any order) so that
+ * it can be updated for a changed descendant without traversing the whole list subtree */
+static uint32_t
+lyd_hash_keyless_list_sum(struct lyd_node *child)
 {
+    uint32_t sum = 0;
+
     LY_TREE_FOR(child, child) {
-        switch (child->schema->nodetype) {
-        case LYS_CONTAINER:
-            lyd_hash_keyless_list_dfs(child->child, hash);
-            break;
-        case LYS_LIST:
-            /* ignore lists with missing keys */
-            if (lyd_list_has_keys(child)) {
-                lyd_hash_keyless_list_dfs(child->child, hash);
-            }
-            break;
-        case LYS_LEAFLIST:
-        case LYS_ANYXML:
-        case LYS_ANYDATA:
-        case LYS_LEAF:
-            *hash = dict_hash_multi(*hash, (char *)&child->hash, sizeof child->hash);
-            break;
-        default:
-            assert(0);
-        }
+        sum += lyd_hash_keyless_list_node(child);
+    }
+    return sum;
+}
+
+/* add a leaf value to a data node hash */
+static uint32_t
+lyd_hash_leaf_value(uint32_t hash, struct lyd_node_leaf_list *leaf)
+{
+    if ((leaf->value_flags & LY_VALUE_USER)
+            && !lytype_hash(&((struct lys_node_leaf *)leaf->schema)->type, &leaf->value, &hash)) {
+        /* hashed by the user type plugin */
+        return hash;
     }
+
+    return dict_hash_multi(hash, leaf->value_str, strlen(leaf->value_str));
 }
 
 int
@@ -354,27 +401,82 @@ lyd_hash(struct lyd_node *node)
         node->hash = dict_hash_multi(0, lyd_node_module(node)->name, strlen(lyd_node_module(node)->name));
         node->hash = dict_hash_multi(node->hash, node->schema->name, strlen(node->schema->name));
         if (node->schema->nodetype == LYS_LEAFLIST) {
-            node->hash = dict_hash_multi(node->hash, ((struct lyd_node_leaf_list *)node)->value_str,
-                                        strlen(((struct lyd_node_leaf_list *)node)->value_str));
+            node->hash = lyd_hash_leaf_value(node->hash, (struct lyd_node_leaf_list *)node);
         } else if (node->schema->nodetype == LYS_LIST) {
             if (((struct lys_node_list *)node->schema)->keys_size) {
                 for (i = 0, iter = node->child; i < ((struct lys_node_list *)node->schema)->keys_size; ++i, iter = iter->next) {
                     assert(iter);
-                    node->hash = dict_hash_multi(node->hash, ((struct lyd_node_leaf_list *)iter)->value_str,
-                                                 strlen(((struct lyd_node_leaf_list *)iter)->value_str));
+                    node->hash = lyd_hash_leaf_value(node->hash, (struct lyd_node_leaf_list *)iter);
                 }
-            } else {
-                /* no-keys list */
-                lyd_hash_keyless_list_dfs(node->child, &node->hash);
             }
         }
         node->hash = dict_hash_multi(node->hash, NULL, 0);
+        if ((node->schema->nodetype == LYS_LIST) && !((struct lys_node_list *)node->schema)->keys_size) {
+            /* no-keys list */
+            node->hash += lyd_hash_keyless_list_sum(node->child);
+        }
         return 0;
     }
 
     return 1;
 }
 
+/* whether a subtree inserted into or unlinked from a parent changes the hash of any key-less list,
+ * the same parents as in lyd_keyless_list_hash_add() are checked */
+static int
+lyd_keyless_list_parent(struct lyd_node *parent)
+{
+    while (parent && !(parent->schema->flags & LYS_CONFIG_W)) {
+        if (parent->schema->nodetype == LYS_LIST) {
+            if (parent->hash && !((struct lys_node_list *)parent->schema)->keys_size) {
+                return 1;
+            } else if (!lyd_list_has_keys(parent)) {
+                return 0;
+            }
+        }
+
+        parent = parent->parent;
+    }
+
+    return 0;
+}
+
+/* update the hashes of the key-less lists a subtree (not) being their part anymore changed by delta */
+static void
+lyd_keyless_list_hash_add(struct lyd_node *parent, uint32_t delta)
+{
+    int r;
+
+    if (!delta) {
+        return;
+    }
+
+    while (parent && !(parent->schema->flags & LYS_CONFIG_W)) {
+        if (parent->schema->nodetype == LYS_LIST) {
+            if (parent->hash && !((struct lys_node_list *)parent->schema)->keys_size) {
+                if (parent->parent && parent->parent->ht) {
+                    /* remove the list from the parent */
+                    r = lyht_remove(parent->parent->ht, &parent, parent->hash);
+                    assert(!r);
+                    (void)r;
+                }
+                parent->hash += delta;
+                if (parent->parent && parent->parent->ht) {
+                    /* re-add the list again */
+                    r = lyht_insert(parent->parent->ht, &parent, parent->hash, NULL);
+                    assert(!r);
+                    (void)r;
+                }
+            } else if (!lyd_list_has_keys(parent)) {
+                /* a parent is a list without keys so it cannot be a part of any parent hash */
+                break;
+            }
+        }
+
+        parent = parent->parent;
+    }
+}
+
 static void
 lyd_keyless_list_hash_change(struct lyd_node *parent)
 {
@@ -407,19 +509,51 @@ lyd_keyless_list_hash_change(struct lyd_node *parent)
     }
 }
 
+/* create hash table of a parent and insert all its children */
+static int
+lyd_hash_table_create(struct lyd_node *parent)
+{
+    struct lyd_node *iter;
+
+    parent->ht = lyht_new(1, sizeof(struct lyd_node *), lyd_hash_table_val_equal, NULL, 1);
+    LY_CHECK_ERR_RETURN(!parent->ht, LOGMEM(parent->schema->module->ctx), -1);
+
+    LY_TREE_FOR(parent->child, iter) {
+        if ((iter->schema->nodetype == LYS_LIST) && !lyd_list_has_keys(iter)) {
+            /* skip lists without keys */
+            continue;
+        }
+
+        if (lyht_insert(parent->ht, &iter, iter->hash, NULL)) {
+            assert(0);
+        }
+    }
+
+    return 0;
+}
+
 static void
 _lyd_insert_hash(struct lyd_node *node, int keyless_list_check)
 {
     struct lyd_node *iter;
+    uint32_t delta;
     int i;
 
     if (node->parent) {
         if ((node->schema->nodetype != LYS_LIST) || lyd_list_has_keys(node)) {
+            /* the subtree hash sum is needed only inside a key-less list */
+            keyless_list_check = keyless_list_check && lyd_keyless_list_parent(node->parent);
+            delta = keyless_list_check ? lyd_hash_keyless_list_node(node) : 0;
             if ((node->schema->nodetype == LYS_LEAF) && lys_is_key((struct lys_node_leaf *)node->schema, NULL)) {
                 /* we are adding a key which means that it may be the last missing key for our parent's hash */
                 if (!lyd_hash(node->parent)) {
                     /* yep, we successfully hashed node->parent so it is technically now added to its parent (hash-wise) */
                     _lyd_insert_hash(node->parent, 0);
+
+                    /* all the parent children are now a part of the key-less list hashes */
+                    if (keyless_list_check) {
+                        delta = lyd_hash_keyless_list_sum(node->parent->child);
+                    }
                 }
             }
 
@@ -434,17 +568,7 @@ _lyd_insert_hash(struct lyd_node *node, int keyless_list_check)
                 assert(i <= LY_CACHE_HT_MIN_CHILDREN);
                 if (i == LY_CACHE_HT_MIN_CHILDREN) {
                     /* create hash table, insert all the children */
-                    node->parent->ht = lyht_new(1, sizeof(struct lyd_node *), lyd_hash_table_val_equal, NULL, 1);
-                    LY_TREE_FOR(node->parent->child, iter) {
-                        if ((iter->schema->nodetype == LYS_LIST) && !lyd_list_has_keys(iter)) {
-                            /* skip lists without keys */
-                            continue;
-                        }
-
-                        if (lyht_insert(node->parent->ht, &iter, iter->hash, NULL)) {
-                            assert(0);
-                        }
-                    }
+                    lyd_hash_table_create(node->parent);
                 }
             } else {
                 if (lyht_insert(node->parent->ht, &node, node->hash, NULL)) {
@@ -454,7 +578,7 @@ _lyd_insert_hash(struct lyd_node *node, int keyless_list_check)
 
             /* if node was in a state data subtree, wasn't it a part of a key-less list hash? */
             if (keyless_list_check) {
-                lyd_keyless_list_hash_change(node->parent);
+                lyd_keyless_list_hash_add(node->parent, delta);
             }
         }
     }
@@ -467,12 +591,37 @@ lyd_insert_hash(struct lyd_node *node)
     _lyd_insert_hash(node, 1);
 }
 
+/* we are going to insert count children into a parent */
+int
+lyd_hash_reserve(struct lyd_node *parent, uint32_t count)
+{
+    if (count < LY_CACHE_HT_FREE_CHILDREN) {
+        /* no hash table needed, it would not be kept with so few children */
+        return 0;
+    }
+
+    if (!parent->ht && lyd_hash_table_create(parent)) {
+        return -1;
+    }
+
+    if (lyht_reserve(parent->ht, count)) {
+        LOGMEM(parent->schema->module->ctx);
+        return -1;
+    }
+    return 0;
+}
+
 static void
 _lyd_unlink_hash(struct lyd_node *node, struct lyd_node *orig_parent, int keyless_list_check)
 {
 #ifndef NDEBUG
     struct lyd_node *iter;
+#endif
+    struct lyd_node *keyless_parent;
+    uint32_t delta;
+    int key_unlink;
 
+#ifndef NDEBUG
     /* it must already be unlinked otherwise keyless lists would get wrong hash */
     if (keyless_list_check && orig_parent) {
         LY_TREE_FOR(orig_parent->child, iter) {
@@ -488,21 +637,33 @@ _lyd_unlink_hash(struct lyd_node *node, struct lyd_node *orig_parent, int keyles
             }
 
             /* if no longer enough children, free the whole hash table */
-            if (orig_parent->ht->used < LY_CACHE_HT_MIN_CHILDREN) {
+            if (orig_parent->ht->used < LY_CACHE_HT_FREE_CHILDREN) {
                 lyht_free(orig_parent->ht);
                 orig_parent->ht = NULL;
             }
         }
 
+        key_unlink = lys_is_key((struct lys_node_leaf *)node->schema, NULL) && orig_parent->hash;
+        keyless_parent = key_unlink ? orig_parent->parent : orig_parent;
+
+        /* the subtree hash sum is needed only inside a key-less list */
+        keyless_list_check = keyless_list_check && lyd_keyless_list_parent(keyless_parent);
+        delta = keyless_list_check ? lyd_hash_keyless_list_node(node) : 0;
+
         /* if the parent is missing a key now, remove hash, also from parent */
-        if (lys_is_key((struct lys_node_leaf *)node->schema, NULL) && orig_parent->hash) {
+        if (key_unlink) {
             _lyd_unlink_hash(orig_parent, orig_parent->parent, 0);
             orig_parent->hash = 0;
+
+            /* none of the parent children are a part of the key-less list hashes anymore */
+            if (keyless_list_check) {
+                delta += lyd_hash_keyless_list_sum(orig_parent->child);
+            }
         }
 
         /* if node was in a state data subtree, shouldn't it be a part of a key-less list hash? */
         if (keyless_list_check) {
-            lyd_keyless_list_hash_change(orig_parent);
+            lyd_keyless_list_hash_add(keyless_parent, -delta);
         }
     }
 }
@@ -516,6 +677,251 @@ lyd_unlink_hash(struct lyd_node *node, struct lyd_node *orig_parent)
 
 #endif
 
+/* data tree transaction changes, see lyd_txn_start() */
+#define LYD_TXN_LINK   0   /* node linked into the tree */
+#define LYD_TXN_UNLINK 1   /* node unlinked from the tree */
+#define LYD_TXN_VALUE  2   /* leaf value changed */
+#define LYD_TXN_DFLT   3   /* default flag changed */
+
+struct lyd_txn_rec {
+    uint8_t type;
+    uint8_t flag;               /* LINK - the node was not in the tree before, DFLT - the original flag */
+    struct lyd_node *node;
+    struct lyd_node *parent;    /* UNLINK - the original position */
+    struct lyd_node *prev;
+    struct lyd_node *next;
+    const char *value_str;      /* VALUE - the original value */
+};
+
+struct lyd_txn {
+    struct ly_ctx *ctx;
+    struct lyd_node *first;      /* current first top-level sibling of the tree */
+    struct lyd_node *orig_first; /* first top-level sibling when the transaction was started */
+    struct lyd_txn_rec *recs;
+    uint32_t count;
+    uint32_t size;
+    struct hash_table *detached; /* nodes unlinked from the tree during the transaction */
+    struct lyd_node **freed;     /* nodes freed in the tree during the transaction, freed by commit */
+    uint32_t freed_count;
+    uint32_t freed_size;
+    int err;                     /* a change failed to be recorded */
+};
+
+/* transaction of the thread, NULL if there is none */
+static THREAD_LOCAL struct lyd_txn *lyd_txn_cur;
+
+static int
+lyd_txn_node_equal(void *val1_p, void *val2_p, int UNUSED(mod), void *UNUSED(cb_data))
+{
+    return *(struct lyd_node **)val1_p == *(struct lyd_node **)val2_p;
+}
+
+static uint32_t
+lyd_txn_node_hash(const struct lyd_node *node)
+{
+    return dict_hash_multi(dict_hash_multi(0, (const char *)&node, sizeof node), NULL, 0);
+}
+
+/* is the node (subtree being) unlinked from the tree in the transaction */
+static int
+lyd_txn_is_detached(struct lyd_node *node)
+{
+    return lyd_txn_cur->detached && !lyht_find(lyd_txn_cur->detached, &node, lyd_txn_node_hash(node), NULL);
+}
+
+/*
+ * Learn whether changes of a node are recorded, it must be in the tree of the thread transaction
+ * or in a subtree unlinked from it during the transaction.
+ */
+static int
+lyd_txn_owns(const struct lyd_node *node)
+{
+    if (!lyd_txn_cur || (node->schema->module->ctx != lyd_txn_cur->ctx)) {
+        return 0;
+    }
+
+    for (; node->parent; node = node->parent);
+    if (lyd_txn_is_detached((struct lyd_node *)node)) {
+        return 1;
+    }
+    for (; node->prev->next; node = node->prev);
+    return (node == lyd_txn_cur->first);
+}
+
+static struct lyd_txn_rec *
+lyd_txn_rec_new(uint8_t type, struct lyd_node *node)
+{
+    struct lyd_txn *txn = lyd_txn_cur;
+    struct lyd_txn_rec *r;
+
+    if (txn->count == txn->size) {
+        r = realloc(txn->recs, (txn->size ? txn->size * 2 : 16) * sizeof *r);
+        if (!r) {
+            LOGMEM(txn->ctx);
+            txn->err = 1;
+            return NULL;
+        }
+        txn->recs = r;
+        txn->size = (txn->size ? txn->size * 2 : 16);
+    }
+
+    r = &txn->recs[txn->count++];
+    memset(r, 0, sizeof *r);
+    r->type = type;
+    r->node = node;
+    return r;
+}
+
+/* record a node just linked into the tree */
+static void
+lyd_txn_rec_link(struct lyd_node *node)
+{
+    struct lyd_txn_rec *r;
+    uint32_t hash;
+
+    r = lyd_txn_rec_new(LYD_TXN_LINK, node);
+    if (!r) {
+        return;
+    }
+
+    hash = lyd_txn_node_hash(node);
+    if (!lyd_txn_cur->detached || lyht_remove(lyd_txn_cur->detached, &node, hash)) {
+        /* inserted from elsewhere */
+        r->flag = 1;
+    }
+
+    if (!node->parent && !node->prev->next) {
+        lyd_txn_cur->first = node;
+    }
+}
+
+/* record a node being unlinked from the tree */
+static void
+lyd_txn_rec_unlink(struct lyd_node *node)
+{
+    struct lyd_txn *txn = lyd_txn_cur;
+    struct lyd_txn_rec *r;
+
+    if (!node->parent && (node->prev == node)) {
+        /* not linked */
+        return;
+    }
+
+    r = lyd_txn_rec_new(LYD_TXN_UNLINK, node);
+    if (!r) {
+        return;
+    }
+    r->parent = node->parent;
+    r->prev = (node->prev->next ? node->prev : NULL);
+    r->next = node->next;
+
+    if (!txn->detached) {
+        txn->detached = lyht_new(8, sizeof node, lyd_txn_node_equal, NULL, 1);
+        if (!txn->detached) {
+            LOGMEM(txn->ctx);
+            txn->err = 1;
+            return;
+        }
+    }
+    if (lyht_insert(txn->detached, &node, lyd_txn_node_hash(node), NULL) == -1) {
+        txn->err = 1;
+    }
+
+    if (node == txn->first) {
+        txn->first = node->next;
+    }
+}
+
+/* record the value of a leaf being changed */
+static void
+lyd_txn_rec_value(struct lyd_node_leaf_list *leaf)
+{
+    struct lyd_txn_rec *r;
+
+    r = lyd_txn_rec_new(LYD_TXN_VALUE, (struct lyd_node *)leaf);
+    if (r) {
+        r->value_str = lydict_insert(lyd_txn_cur->ctx, leaf->value_str, 0);
+    }
+}
+
+/* record the default flag of a node being changed */
+static void
+lyd_txn_rec_dflt(struct lyd_node *node)
+{
+    struct lyd_txn_rec *r;
+
+    r = lyd_txn_rec_new(LYD_TXN_DFLT, node);
+    if (r) {
+        r->flag = node->dflt;
+    }
+}
+
+/* keep a node freed in the tree until the commit, returns 1 if it was kept */
+static int
+lyd_txn_free(struct lyd_node *node)
+{
+    struct lyd_txn *txn = lyd_txn_cur;
+    struct lyd_node **freed;
+
+    if (!lyd_txn_owns(node)) {
+        return 0;
+    }
+
+    if (txn->freed_count == txn->freed_size) {
+        freed = realloc(txn->freed, (txn->freed_size ? txn->freed_size * 2 : 8) * sizeof *freed);
+        if (!freed) {
+            /* cannot be reverted */
+            LOGMEM(txn->ctx);
+            txn->err = 1;
+            return 0;
+        }
+        txn->freed = freed;
+        txn->freed_size = (txn->freed_size ? txn->freed_size * 2 : 8);
+    }
+
+    lyd_unlink_internal(node, 1);
+    txn->freed[txn->freed_count++] = node;
+    return 1;
+}
+
+/* link a node between its new siblings (or as the only child), the parent pointer and hashes are left to the caller */
+static void
+lyd_link_at(struct lyd_node *node, struct lyd_node *parent, struct lyd_node *prev, struct lyd_node *next)
+{
+    struct lyd_node *first;
+
+    if (prev) {
+        if (prev->next) {
+            prev->next->prev = node;
+        } else {
+            /* the new last sibling */
+            if (parent) {
+                first = parent->child;
+            } else {
+                for (first = prev; first->prev->next; first = first->prev);
+            }
+            first->prev = node;
+        }
+        node->next = prev->next;
+        node->prev = prev;
+        prev->next = node;
+    } else if (next) {
+        /* the new first sibling */
+        node->prev = next->prev;
+        node->next = next;
+        next->prev = node;
+        if (parent) {
+            parent->child = node;
+        }
+    } else {
+        node->prev = node;
+        node->next = NULL;
+        if (parent) {
+            parent->child = node;
+        }
+    }
+}
+
 /**
  * @brief get the list of \p data's siblings of the given schema
  */
@@ -591,10 +997,24 @@ lyd_is_when_false(struct lyd_node *root, struct lyd_node *last_parent, struct ly
 }
 
 /**
- * @param[in] root Root node to be able search the data tree in case of no instance
- * @return
- *  0 - all restrictions met
- *  1 - restrictions not met
+ * @brief Learn whether the validation can continue after a failed check because all its errors were collected
+ * (#LYD_OPT_VAL_ALL), the validation then fails only at its end.
+ *
+ * @param[in] options Validation options.
+ * @param[in] val_errs Number of the collected validation errors before the check.
+ * @return non-zero if the validation can continue, 0 otherwise.
+ */
+static int
+lyd_val_err_collected(int options, uint32_t val_errs)
+{
+    return (options & LYD_OPT_VAL_ALL) && (ly_vlog_collected() > val_errs);
+}
+
+/**
+ * @param[in] root Root node to be able search the data tree in case of no instance
+ * @return
+ *  0 - all restrictions met
+ *  1 - restrictions not met
  *  2 - schema node not enabled
  */
 static int
@@ -700,11 +1120,14 @@ lyd_check_mandatory_subtree(struct lyd_node *tree, struct lyd_node *subtree, str
     struct lyd_node *iter;
     struct ly_set *present = NULL;
     unsigned int u;
+    uint32_t val_errs;
     int ret = EXIT_FAILURE;
 
     assert(schema);
 
-    if (lys_is_disabled(schema, 0)) {
+    if (lys_is_disabled(schema, 0) || (!lys_has_mandatory_when(schema)
+            && !resolve_applies_when(schema, 1, last_parent ? last_parent->schema : NULL))) {
+        /* nothing to check or evaluate in the whole subtree */
         return EXIT_SUCCESS;
     }
 
@@ -729,18 +1152,26 @@ lyd_check_mandatory_subtree(struct lyd_node *tree, struct lyd_node *subtree, str
     case LYS_ANYXML:
     case LYS_ANYDATA:
         /* check the schema item */
-        if (lyd_check_mandatory_data(tree, last_parent, present, schema, options)) {
+        val_errs = ly_vlog_collected();
+        if (lyd_check_mandatory_data(tree, last_parent, present, schema, options)
+                && !lyd_val_err_collected(options, val_errs)) {
             goto error;
         }
         break;
     case LYS_LIST:
         /* check the schema item */
-        if (lyd_check_mandatory_data(tree, last_parent, present, schema, options)) {
+        val_errs = ly_vlog_collected();
+        if (lyd_check_mandatory_data(tree, last_parent, present, schema, options)
+                && !lyd_val_err_collected(options, val_errs)) {
             goto error;
         }
 
         /* go recursively */
         for (u = 0; u < present->number; u++) {
+            if ((options & LYD_OPT_VAL_CHANGED) && !(present->set.d[u]->validity & LYD_VAL_SUBTREE)) {
+                /* unchanged subtree */
+                continue;
+            }
             LY_TREE_FOR(schema->child, siter) {
                 if (lyd_check_mandatory_subtree(tree, present->set.d[u], present->set.d[u], siter, 0, options)) {
                     goto error;
@@ -750,6 +1181,10 @@ lyd_check_mandatory_subtree(struct lyd_node *tree, struct lyd_node *subtree, str
         break;
 
     case LYS_CONTAINER:
+        if ((options & LYD_OPT_VAL_CHANGED) && present->number && !(present->set.d[0]->validity & LYD_VAL_SUBTREE)) {
+            /* unchanged subtree */
+            break;
+        }
         if (present->number || !((struct lys_node_container *)schema)->presence) {
             /* if we have existing or non-presence container, go recursively */
             LY_TREE_FOR(schema->child, siter) {
@@ -796,8 +1231,11 @@ lyd_check_mandatory_subtree(struct lyd_node *tree, struct lyd_node *subtree, str
                 }
             } else if (schema->flags & LYS_MAND_TRUE) {
                 /* choice requires some data to be instantiated */
+                val_errs = ly_vlog_collected();
                 LOGVAL(schema->module->ctx, LYE_NOMANDCHOICE, LY_VLOG_LYD, last_parent, schema->name);
-                goto error;
+                if (!lyd_val_err_collected(options, val_errs)) {
+                    goto error;
+                }
             }
         } else {
             /* one of the choice's cases is instantiated, continue into this case */
@@ -923,6 +1361,44 @@ lyd_check_mandatory_tree(struct lyd_node *root, struct ly_ctx *ctx, const struct
     return EXIT_SUCCESS;
 }
 
+static struct lyd_node *
+lyd_parse_xml_(struct ly_ctx *ctx, const struct lyd_node *rpc_act, struct lyxml_elem **xml, int options,
+               const struct lyd_node *data_tree, const char *yang_data_name)
+{
+    struct lyd_node *result;
+
+    /* the XML tree is ours, free it while parsing to lower the peak memory and move its strings */
+    if (options & LYD_OPT_RPCREPLY) {
+        result = lyd_parse_xml(ctx, xml, options | LYD_OPT_DESTRUCT, rpc_act, data_tree);
+    } else if (options & (LYD_OPT_RPC | LYD_OPT_NOTIF)) {
+        result = lyd_parse_xml(ctx, xml, options | LYD_OPT_DESTRUCT, data_tree);
+    } else if (options & LYD_OPT_DATA_TEMPLATE) {
+        result = lyd_parse_xml(ctx, xml, options | LYD_OPT_DESTRUCT, yang_data_name);
+    } else {
+        result = lyd_parse_xml(ctx, xml, options | LYD_OPT_DESTRUCT);
+    }
+    lyxml_free_withsiblings(ctx, *xml);
+    *xml = NULL;
+
+    return result;
+}
+
+static struct lyd_node *
+lyd_parse_check_result(struct lyd_node *result, int options)
+{
+    if (ly_errno) {
+        lyd_free_withsiblings(result);
+        result = NULL;
+    } else if (result && ((options & (LYD_OPT_RPC | LYD_OPT_RPCREPLY))
+            || (result->schema->module->ctx->models.flags & LY_CTX_ORDERED_DATA)) && lyd_schema_sort(result, 1)) {
+        /* rpc and rpc-reply must be sorted, other data if requested */
+        lyd_free_withsiblings(result);
+        result = NULL;
+    }
+
+    return result;
+}
+
 static struct lyd_node *
 lyd_parse_(struct ly_ctx *ctx, const struct lyd_node *rpc_act, const char *data, LYD_FORMAT format, int options,
            const struct lyd_node *data_tree, const char *yang_data_name)
@@ -940,6 +1416,12 @@ lyd_parse_(struct ly_ctx *ctx, const struct lyd_node *rpc_act, const char *data,
         xmlopt = 0;
     }
 
+    ly_phase(LY_TRACE_PARSE, 0, ctx);
+
+    /* cache the repeating strings, allocate the nodes in batches */
+    lydict_cache_start(ctx);
+    lyd_pool_stash_start(ctx);
+
     /* we must free all the errors, otherwise we are unable to properly check returned ly_errno :-/ */
     ly_errno = LY_SUCCESS;
     switch (format) {
@@ -948,16 +1430,7 @@ lyd_parse_(struct ly_ctx *ctx, const struct lyd_node *rpc_act, const char *data,
         if (ly_errno) {
             break;
         }
-        if (options & LYD_OPT_RPCREPLY) {
-            result = lyd_parse_xml(ctx, &xml, options, rpc_act, data_tree);
-        } else if (options & (LYD_OPT_RPC | LYD_OPT_NOTIF)) {
-            result = lyd_parse_xml(ctx, &xml, options, data_tree);
-        } else if (options & LYD_OPT_DATA_TEMPLATE) {
-            result = lyd_parse_xml(ctx, &xml, options, yang_data_name);
-        } else {
-            result = lyd_parse_xml(ctx, &xml, options);
-        }
-        lyxml_free_withsiblings(ctx, xml);
+        result = lyd_parse_xml_(ctx, rpc_act, &xml, options, data_tree, yang_data_name);
         break;
     case LYD_JSON:
         result = lyd_parse_json(ctx, data, options, rpc_act, data_tree, yang_data_name);
@@ -970,66 +1443,78 @@ lyd_parse_(struct ly_ctx *ctx, const struct lyd_node *rpc_act, const char *data,
         break;
     }
 
-    if (ly_errno) {
-        lyd_free_withsiblings(result);
-        return NULL;
-    }
+    result = lyd_parse_check_result(result, options);
 
-    if ((options & (LYD_OPT_RPC | LYD_OPT_RPCREPLY)) && lyd_schema_sort(result, 1)) {
-        /* rpc and rpc-reply must be sorted */
-        lyd_free_withsiblings(result);
-        return NULL;
-    }
+    lyd_pool_stash_flush(ctx);
+    lydict_cache_flush(ctx);
 
+    ly_phase(LY_TRACE_PARSE, 1, ctx);
     return result;
 }
 
-static struct lyd_node *
-lyd_parse_data_(struct ly_ctx *ctx, const char *data, LYD_FORMAT format, int options, va_list ap)
+static int
+lyd_parse_args_(struct ly_ctx *ctx, int options, va_list ap, const char *func, const struct lyd_node **rpc_act,
+                const struct lyd_node **data_tree, const char **yang_data_name)
 {
-    const struct lyd_node *rpc_act = NULL, *data_tree = NULL, *iter;
-    const char *yang_data_name = NULL;
+    const struct lyd_node *iter;
 
-    if (lyp_data_check_options(ctx, options, __func__)) {
-        return NULL;
+    *rpc_act = NULL;
+    *data_tree = NULL;
+    *yang_data_name = NULL;
+
+    if (lyp_data_check_options(ctx, options, func)) {
+        return EXIT_FAILURE;
     }
 
     if (options & LYD_OPT_RPCREPLY) {
-        rpc_act = va_arg(ap, const struct lyd_node *);
-        if (!rpc_act || rpc_act->parent || !(rpc_act->schema->nodetype & (LYS_RPC | LYS_LIST | LYS_CONTAINER))) {
-            LOGERR(ctx, LY_EINVAL, "%s: invalid variable parameter (const struct lyd_node *rpc_act).", __func__);
-            return NULL;
+        *rpc_act = va_arg(ap, const struct lyd_node *);
+        if (!*rpc_act || (*rpc_act)->parent || !((*rpc_act)->schema->nodetype & (LYS_RPC | LYS_LIST | LYS_CONTAINER))) {
+            LOGERR(ctx, LY_EINVAL, "%s: invalid variable parameter (const struct lyd_node *rpc_act).", func);
+            return EXIT_FAILURE;
         }
     }
     if (options & (LYD_OPT_RPC | LYD_OPT_NOTIF | LYD_OPT_RPCREPLY)) {
-        data_tree = va_arg(ap, const struct lyd_node *);
-        if (data_tree) {
+        *data_tree = va_arg(ap, const struct lyd_node *);
+        if (*data_tree) {
             if (options & LYD_OPT_NOEXTDEPS) {
                 LOGERR(ctx, LY_EINVAL, "%s: invalid parameter (variable arg const struct lyd_node *data_tree and LYD_OPT_NOEXTDEPS set).",
-                       __func__);
-                return NULL;
+                       func);
+                return EXIT_FAILURE;
             }
 
-            LY_TREE_FOR(data_tree, iter) {
+            LY_TREE_FOR(*data_tree, iter) {
                 if (iter->parent) {
                     /* a sibling is not top-level */
-                    LOGERR(ctx, LY_EINVAL, "%s: invalid variable parameter (const struct lyd_node *data_tree).", __func__);
-                    return NULL;
+                    LOGERR(ctx, LY_EINVAL, "%s: invalid variable parameter (const struct lyd_node *data_tree).", func);
+                    return EXIT_FAILURE;
                 }
             }
 
             /* move it to the beginning */
-            for (; data_tree->prev->next; data_tree = data_tree->prev);
+            for (; (*data_tree)->prev->next; *data_tree = (*data_tree)->prev);
 
             /* LYD_OPT_NOSIBLINGS cannot be set in this case */
             if (options & LYD_OPT_NOSIBLINGS) {
-                LOGERR(ctx, LY_EINVAL, "%s: invalid parameter (variable arg const struct lyd_node *data_tree with LYD_OPT_NOSIBLINGS).", __func__);
-                return NULL;
+                LOGERR(ctx, LY_EINVAL, "%s: invalid parameter (variable arg const struct lyd_node *data_tree with LYD_OPT_NOSIBLINGS).", func);
+                return EXIT_FAILURE;
             }
         }
     }
     if (options & LYD_OPT_DATA_TEMPLATE) {
-        yang_data_name = va_arg(ap, const char *);
+        *yang_data_name = va_arg(ap, const char *);
+    }
+
+    return EXIT_SUCCESS;
+}
+
+static struct lyd_node *
+lyd_parse_data_(struct ly_ctx *ctx, const char *data, LYD_FORMAT format, int options, va_list ap)
+{
+    const struct lyd_node *rpc_act, *data_tree;
+    const char *yang_data_name;
+
+    if (lyd_parse_args_(ctx, options, ap, __func__, &rpc_act, &data_tree, &yang_data_name)) {
+        return NULL;
     }
 
     return lyd_parse_(ctx, rpc_act, data, format, options, data_tree, yang_data_name);
@@ -1120,4530 +1605,8997 @@ lyd_parse_path(struct ly_ctx *ctx, const char *path, LYD_FORMAT format, int opti
     return ret;
 }
 
-static struct lys_node *
-lyd_new_find_schema(struct lyd_node *parent, const struct lys_module *module, int rpc_output)
-{
-    struct lys_node *siblings;
-
-    if (!parent) {
-        siblings = module->data;
-    } else {
-        if (!parent->schema) {
-            return NULL;
-        }
-        siblings = parent->schema->child;
-        if (siblings && (siblings->nodetype == (rpc_output ? LYS_INPUT : LYS_OUTPUT))) {
-            siblings = siblings->next;
-        }
-        if (siblings && (siblings->nodetype == (rpc_output ? LYS_OUTPUT : LYS_INPUT))) {
-            siblings = siblings->child;
-        }
-    }
-
-    return siblings;
-}
-
-struct lyd_node *
-_lyd_new(struct lyd_node *parent, const struct lys_node *schema, int dflt)
-{
-    struct lyd_node *ret;
-
-    ret = calloc(1, sizeof *ret);
-    LY_CHECK_ERR_RETURN(!ret, LOGMEM(schema->module->ctx), NULL);
-
-    ret->schema = (struct lys_node *)schema;
-    ret->validity = ly_new_node_validity(schema);
-    if (resolve_applies_when(schema, 0, NULL)) {
-        ret->when_status = LYD_WHEN;
-    }
-    ret->prev = ret;
-    ret->dflt = dflt;
+/* states of the chunked XML scanner */
+#define LYD_CHUNK_TEXT 0    /* character data or whitespace/misc between the top-level elements */
+#define LYD_CHUNK_TAG 1     /* inside a start or an end tag */
+#define LYD_CHUNK_QUOT 2    /* inside an attribute value */
+#define LYD_CHUNK_COMMENT 3 /* inside a comment */
+#define LYD_CHUNK_PI 4      /* inside a processing instruction or the XML declaration */
+#define LYD_CHUNK_CDATA 5   /* inside a CDATA section */
 
-#ifdef LY_ENABLED_CACHE
-    lyd_hash(ret);
-#endif
+struct lyd_chunk_parser {
+    struct ly_ctx *ctx;
+    LYD_FORMAT format;
+    int options;
+    const struct lyd_node *rpc_act;
+    const struct lyd_node *data_tree;
+    const char *yang_data_name;
 
-    if (parent) {
-        if (lyd_insert(parent, ret)) {
-            lyd_free(ret);
-            return NULL;
-        }
-    }
-    return ret;
-}
+    char *buf;                  /* not yet consumed data */
+    size_t used;                /* length of the data in buf */
+    size_t size;                /* allocated size of buf */
+
+    /* LYD_XML only */
+    struct lyxml_elem *xml;     /* already parsed top-level XML elements */
+    size_t scan;                /* offset in buf where the scanning continues */
+    uint32_t depth;             /* element depth at scan */
+    uint8_t state;              /* LYD_CHUNK_* */
+    char quot;                  /* quote character of the current attribute value */
+    uint8_t endtag;             /* the current tag is a start (0), an end (1), or another markup (2) tag */
+    uint8_t done;               /* the only allowed top-level element (LYD_OPT_NOSIBLINGS) was parsed */
+    uint8_t error;              /* parsing failed, everything else is refused */
+};
 
-API struct lyd_node *
-lyd_new(struct lyd_node *parent, const struct lys_module *module, const char *name)
+API struct lyd_chunk_parser *
+lyd_chunk_parser_new(struct ly_ctx *ctx, LYD_FORMAT format, int options, ...)
 {
     FUN_IN;
 
-    const struct lys_node *snode = NULL, *siblings;
+    struct lyd_chunk_parser *parser;
+    va_list ap;
+    int r;
 
-    if ((!parent && !module) || !name) {
+    if (!ctx || ((format != LYD_XML) && (format != LYD_JSON) && (format != LYD_LYB))) {
         LOGARG;
         return NULL;
     }
 
-    siblings = lyd_new_find_schema(parent, module, 0);
-    if (!siblings) {
-        LOGARG;
-        return NULL;
-    }
+    parser = calloc(1, sizeof *parser);
+    LY_CHECK_ERR_RETURN(!parser, LOGMEM(ctx), NULL);
 
-    if (lys_getnext_data(module, lys_parent(siblings), name, strlen(name), LYS_CONTAINER | LYS_LIST | LYS_NOTIF
-                         | LYS_RPC | LYS_ACTION, 0, &snode) || !snode) {
-        LOGERR(siblings->module->ctx, LY_EINVAL, "Failed to find \"%s\" as a sibling to \"%s:%s\".",
-               name, lys_node_module(siblings)->name, siblings->name);
+    va_start(ap, options);
+    r = lyd_parse_args_(ctx, options, ap, __func__, &parser->rpc_act, &parser->data_tree, &parser->yang_data_name);
+    va_end(ap);
+    if (r) {
+        free(parser);
         return NULL;
     }
 
-    return _lyd_new(parent, snode, 0);
+    parser->ctx = ctx;
+    parser->format = format;
+    parser->options = options;
+    return parser;
 }
 
-static struct lyd_node *
-lyd_create_leaf(const struct lys_node *schema, const char *val_str, int dflt)
+/**
+ * @brief Check whether the data at \p c start with \p str.
+ *
+ * @return 1 if they do, 0 if they do not, -1 if there are not enough data to decide.
+ */
+static int
+lyd_chunk_prefix(const char *c, size_t avail, const char *str)
 {
-    struct lyd_node_leaf_list *ret;
-
-    ret = calloc(1, sizeof *ret);
-    LY_CHECK_ERR_RETURN(!ret, LOGMEM(schema->module->ctx), NULL);
+    size_t i;
 
-    ret->schema = (struct lys_node *)schema;
-    ret->validity = ly_new_node_validity(schema);
-    if (resolve_applies_when(schema, 0, NULL)) {
-        ret->when_status = LYD_WHEN;
+    for (i = 0; str[i]; ++i) {
+        if (i == avail) {
+            return -1;
+        } else if (c[i] != str[i]) {
+            return 0;
+        }
     }
-    ret->prev = (struct lyd_node *)ret;
-    ret->value_type = ((struct lys_node_leaf *)schema)->type.base;
-    ret->value_str = lydict_insert(schema->module->ctx, val_str ? val_str : "", 0);
-    ret->dflt = dflt;
-
-#ifdef LY_ENABLED_CACHE
-    lyd_hash((struct lyd_node *)ret);
-#endif
 
-    return (struct lyd_node *)ret;
+    return 1;
 }
 
-static struct lyd_node *
-_lyd_new_leaf(struct lyd_node *parent, const struct lys_node *schema, const char *val_str, int dflt, int edit_leaf)
+/**
+ * @brief Parse the XML data in the parser buffer up to \p len into XML elements and discard them from the buffer.
+ */
+static int
+lyd_chunk_parse_xml(struct lyd_chunk_parser *parser, size_t len)
 {
-    struct lyd_node *ret;
-
-    ret = lyd_create_leaf(schema, val_str, dflt);
-    if (!ret) {
-        return NULL;
-    }
-
-    /* connect to parent */
-    if (parent) {
-        if (lyd_insert(parent, ret)) {
-            lyd_free(ret);
-            return NULL;
-        }
-    }
-
-    if (edit_leaf && !((struct lyd_node_leaf_list *)ret)->value_str[0]) {
-        /* empty edit leaf, it is fine */
-        ((struct lyd_node_leaf_list *)ret)->value_type = LY_TYPE_UNKNOWN;
-        return ret;
-    }
+    struct lyxml_elem *xml, *last;
+    char c;
 
-    /* resolve the type correctly (after it was connected to parent cause of log) */
-    if (!lyp_parse_value(&((struct lys_node_leaf *)ret->schema)->type, &((struct lyd_node_leaf_list *)ret)->value_str,
-                         NULL, (struct lyd_node_leaf_list *)ret, NULL, NULL, 1, dflt, 0)) {
-        lyd_free(ret);
-        return NULL;
+    /* terminate the data temporarily, there is always a spare byte */
+    c = parser->buf[len];
+    parser->buf[len] = '\0';
+    ly_errno = LY_SUCCESS;
+    xml = lyxml_parse_mem(parser->ctx, parser->buf, LYXML_PARSE_MULTIROOT);
+    parser->buf[len] = c;
+    if (ly_errno) {
+        lyxml_free_withsiblings(parser->ctx, xml);
+        return EXIT_FAILURE;
     }
 
-    if ((ret->schema->nodetype == LYS_LEAF) && (ret->schema->flags & LYS_UNIQUE)) {
-        for (; parent && (parent->schema->nodetype != LYS_LIST); parent = parent->parent);
-        if (parent) {
-            parent->validity |= LYD_VAL_UNIQUE;
+    if (xml) {
+        if (!parser->xml) {
+            parser->xml = xml;
         } else {
-            LOGINT(schema->module->ctx);
+            /* append the new siblings */
+            last = xml->prev;
+            parser->xml->prev->next = xml;
+            xml->prev = parser->xml->prev;
+            parser->xml->prev = last;
+        }
+        if (parser->options & LYD_OPT_NOSIBLINGS) {
+            parser->done = 1;
         }
     }
 
-    return ret;
+    /* drop the consumed data */
+    memmove(parser->buf, parser->buf + len, parser->used - len);
+    parser->used -= len;
+    parser->scan -= len;
+    return EXIT_SUCCESS;
 }
 
-API struct lyd_node *
-lyd_new_leaf(struct lyd_node *parent, const struct lys_module *module, const char *name, const char *val_str)
+/**
+ * @brief Scan the new XML data in the parser buffer and parse every completed top-level element.
+ */
+static int
+lyd_chunk_scan_xml(struct lyd_chunk_parser *parser)
 {
-    FUN_IN;
+    const char *c, *ptr;
+    size_t avail;
+    int r;
 
-    const struct lys_node *snode = NULL, *siblings;
+    while (parser->scan < parser->used) {
+        c = parser->buf + parser->scan;
+        avail = parser->used - parser->scan;
 
-    if ((!parent && !module) || !name) {
-        LOGARG;
-        return NULL;
-    }
+        switch (parser->state) {
+        case LYD_CHUNK_TEXT:
+            ptr = memchr(c, '<', avail);
+            if (!ptr) {
+                parser->scan = parser->used;
+                break;
+            }
+            parser->scan += ptr - c;
+            c = ptr;
+            avail = parser->used - parser->scan;
 
-    siblings = lyd_new_find_schema(parent, module, 0);
-    if (!siblings) {
-        LOGARG;
-        return NULL;
-    }
+            /* decide what markup starts here, wait for more data if it cannot be decided yet */
+            if (avail < 2) {
+                return EXIT_SUCCESS;
+            }
+            if (c[1] == '?') {
+                parser->state = LYD_CHUNK_PI;
+                parser->scan += 2;
+            } else if (c[1] == '!') {
+                if ((r = lyd_chunk_prefix(c, avail, "<!--")) == 1) {
+                    parser->state = LYD_CHUNK_COMMENT;
+                    parser->scan += 4;
+                } else if (!r && ((r = lyd_chunk_prefix(c, avail, "<![CDATA[")) == 1)) {
+                    parser->state = LYD_CHUNK_CDATA;
+                    parser->scan += 9;
+                } else if (r == -1) {
+                    return EXIT_SUCCESS;
+                } else {
+                    /* DOCTYPE or garbage, let the XML parser report it */
+                    parser->state = LYD_CHUNK_TAG;
+                    parser->endtag = 2;
+                    ++parser->scan;
+                }
+            } else {
+                parser->state = LYD_CHUNK_TAG;
+                parser->endtag = (c[1] == '/') ? 1 : 0;
+                ++parser->scan;
+            }
+            break;
+        case LYD_CHUNK_TAG:
+            for (ptr = c; (ptr < c + avail) && (*ptr != '>') && (*ptr != '"') && (*ptr != '\''); ++ptr);
+            parser->scan += ptr - c;
+            if (ptr == c + avail) {
+                break;
+            }
+            ++parser->scan;
 
-    if (lys_getnext_data(module, lys_parent(siblings), name, strlen(name), LYS_LEAFLIST | LYS_LEAF, 0, &snode) || !snode) {
-        LOGERR(siblings->module->ctx, LY_EINVAL, "Failed to find \"%s\" as a sibling to \"%s:%s\".",
-               name, lys_node_module(siblings)->name, siblings->name);
-        return NULL;
-    }
+            if (*ptr != '>') {
+                parser->state = LYD_CHUNK_QUOT;
+                parser->quot = *ptr;
+                break;
+            }
 
-    return _lyd_new_leaf(parent, snode, val_str, 0, 0);
-}
-
-/**
- * @brief Update (add) default flag of the parents of the added node.
- *
- * @param[in] node Added node
- */
-static void
-lyd_wd_update_parents(struct lyd_node *node)
-{
-    struct lyd_node *parent = node->parent, *iter;
+            parser->state = LYD_CHUNK_TEXT;
+            if (parser->endtag == 1) {
+                if (parser->depth) {
+                    --parser->depth;
+                }
+            } else if (!parser->endtag && (ptr[-1] != '/')) {
+                ++parser->depth;
+            }
 
-    for (parent = node->parent; parent; parent = node->parent) {
-        if (parent->dflt || parent->schema->nodetype != LYS_CONTAINER ||
-                ((struct lys_node_container *)parent->schema)->presence) {
-            /* parent is already default and there is nothing to update or
-             * it is not a non-presence container -> stop the loop */
+            /* top-level element completed, parse it */
+            if (!parser->depth && lyd_chunk_parse_xml(parser, parser->scan)) {
+                return EXIT_FAILURE;
+            }
+            if (parser->done) {
+                /* LYD_OPT_NOSIBLINGS, ignore the rest */
+                parser->used = parser->scan = 0;
+                return EXIT_SUCCESS;
+            }
             break;
-        }
-        /* check that there is still some non default sibling */
-        for (iter = node->prev; iter != node; iter = iter->prev) {
-            if (!iter->dflt) {
-                break;
+        case LYD_CHUNK_QUOT:
+            ptr = memchr(c, parser->quot, avail);
+            if (!ptr) {
+                parser->scan = parser->used;
+            } else {
+                parser->scan += (ptr - c) + 1;
+                parser->state = LYD_CHUNK_TAG;
+            }
+            break;
+        case LYD_CHUNK_COMMENT:
+        case LYD_CHUNK_PI:
+        case LYD_CHUNK_CDATA:
+            ptr = (parser->state == LYD_CHUNK_COMMENT) ? "-->" : ((parser->state == LYD_CHUNK_PI) ? "?>" : "]]>");
+            for (; avail >= strlen(ptr); ++c, --avail, ++parser->scan) {
+                if (!strncmp(c, ptr, strlen(ptr))) {
+                    break;
+                }
+            }
+            if (avail < strlen(ptr)) {
+                /* the terminator may be split between the chunks */
+                return EXIT_SUCCESS;
+            }
+            parser->scan += strlen(ptr);
+            parser->state = LYD_CHUNK_TEXT;
+
+            /* drop the top-level misc */
+            if (!parser->depth && lyd_chunk_parse_xml(parser, parser->scan)) {
+                return EXIT_FAILURE;
             }
-        }
-        if (iter == node && node->prev != node) {
-            /* all siblings are implicit default nodes, propagate it to the parent */
-            node = node->parent;
-            node->dflt = 1;
-            continue;
-        } else {
-            /* stop the loop */
             break;
         }
     }
+
+    return EXIT_SUCCESS;
 }
 
-static void
-check_leaf_list_backlinks(struct lyd_node *node)
+/**
+ * @brief Make space for \p len more bytes and the terminating NULL byte in the parser buffer.
+ */
+static int
+lyd_chunk_grow(struct lyd_chunk_parser *parser, size_t len)
 {
-    struct lyd_node *next, *iter;
-    struct lyd_node_leaf_list *leaf_list;
-    struct ly_set *set, *data;
-    uint32_t i, j;
-    int validity_changed = 0;
+    size_t size;
 
-    /* fix leafrefs */
-    LY_TREE_DFS_BEGIN(node, next, iter) {
-        /* the node is target of a leafref */
-        if ((iter->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST)) && iter->schema->child) {
-            set = (struct ly_set *)iter->schema->child;
-            for (i = 0; i < set->number; i++) {
-                data = lyd_find_instance(iter, set->set.s[i]);
-                if (data) {
-                    for (j = 0; j < data->number; j++) {
-                        /* invalidate the leafref, a change concerning it happened */
-                        leaf_list = (struct lyd_node_leaf_list *)data->set.d[j];
-                        leaf_list->validity |= LYD_VAL_LEAFREF;
-                        validity_changed = 1;
-                        if (leaf_list->value_type == LY_TYPE_LEAFREF) {
-                            /* remove invalid link and put unresolved value back */
-                            lyp_parse_value(&((struct lys_node_leaf *)leaf_list->schema)->type, &leaf_list->value_str,
-                                            NULL, leaf_list, NULL, NULL, 1, leaf_list->dflt, 0);
-                        }
-                    }
-                    ly_set_free(data);
-                } else {
-                    LOGINT(node->schema->module->ctx);
-                    return;
-                }
-            }
+    if (parser->used + len + 1 > parser->size) {
+        size = parser->size * 2;
+        if (size < parser->used + len + 1) {
+            size = parser->used + len + 1;
         }
-        LY_TREE_DFS_END(node, next, iter)
+        parser->buf = ly_realloc(parser->buf, size);
+        if (!parser->buf) {
+            LOGMEM(parser->ctx);
+            parser->used = parser->size = parser->scan = 0;
+            parser->error = 1;
+            return EXIT_FAILURE;
+        }
+        parser->size = size;
     }
 
-    /* invalidate parent to make sure it will be checked in future validation */
-    if (validity_changed && node->parent) {
-        node->parent->validity |= LYD_VAL_MAND;
-    }
+    return EXIT_SUCCESS;
 }
 
 API int
-lyd_change_leaf(struct lyd_node_leaf_list *leaf, const char *val_str)
+lyd_chunk_parser_feed(struct lyd_chunk_parser *parser, const char *data, size_t len)
 {
     FUN_IN;
 
-    const char *backup;
-    int val_change, dflt_change;
-    struct lyd_node *parent;
+    int ret = EXIT_SUCCESS;
 
-    if (!leaf || (leaf->schema->nodetype != LYS_LEAF)) {
+    if (!parser || (!data && len)) {
         LOGARG;
-        return -1;
-    }
-
-    backup = leaf->value_str;
-    leaf->value_str = lydict_insert(leaf->schema->module->ctx, val_str ? val_str : "", 0);
-    /* leaf->value is erased by lyp_parse_value() */
-
-    /* parse the type correctly, makes the value canonical if needed */
-    if (!lyp_parse_value(&((struct lys_node_leaf *)leaf->schema)->type, &leaf->value_str, NULL, leaf, NULL, NULL, 1, 0, 0)) {
-        lydict_remove(leaf->schema->module->ctx, backup);
-        return -1;
-    }
-
-    if (!strcmp(backup, leaf->value_str)) {
-        /* the value remains the same */
-        val_change = 0;
-    } else {
-        val_change = 1;
+        return EXIT_FAILURE;
     }
 
-    /* value is correct, remove backup */
-    lydict_remove(leaf->schema->module->ctx, backup);
-
-    /* clear the default flag, the value is different */
-    if (leaf->dflt) {
-        for (parent = (struct lyd_node *)leaf; parent; parent = parent->parent) {
-            parent->dflt = 0;
-        }
-        dflt_change = 1;
-    } else {
-        dflt_change = 0;
+    if (parser->error) {
+        LOGERR(parser->ctx, LY_EINVAL, "%s: parsing of a previous data chunk failed.", __func__);
+        return EXIT_FAILURE;
+    } else if (parser->done) {
+        /* LYD_OPT_NOSIBLINGS and the element was already parsed */
+        return EXIT_SUCCESS;
+    } else if ((parser->format != LYD_LYB) && memchr(data, '\0', len)) {
+        LOGERR(parser->ctx, LY_EINVAL, "%s: data chunk contains a NULL byte.", __func__);
+        parser->error = 1;
+        return EXIT_FAILURE;
     }
 
-    if (val_change) {
-        /* make the node non-validated */
-        leaf->validity = ly_new_node_validity(leaf->schema);
-
-        /* check possible leafref backlinks */
-        check_leaf_list_backlinks((struct lyd_node *)leaf);
+    /* append the chunk, keep a spare byte for the terminating NULL byte */
+    if (lyd_chunk_grow(parser, len)) {
+        return EXIT_FAILURE;
     }
+    memcpy(parser->buf + parser->used, data, len);
+    parser->used += len;
 
-    if (val_change && (leaf->schema->flags & LYS_UNIQUE)) {
-        for (parent = leaf->parent; parent && (parent->schema->nodetype != LYS_LIST); parent = parent->parent);
-        if (parent) {
-            parent->validity |= LYD_VAL_UNIQUE;
+    if (parser->format == LYD_XML) {
+        /* parse all the completed top-level elements */
+        lydict_cache_start(parser->ctx);
+        lyd_pool_stash_start(parser->ctx);
+        ret = lyd_chunk_scan_xml(parser);
+        lyd_pool_stash_flush(parser->ctx);
+        lydict_cache_flush(parser->ctx);
+        if (ret) {
+            parser->error = 1;
         }
     }
 
-    return (val_change || dflt_change ? 0 : 1);
+    return ret;
 }
 
-static struct lyd_node *
-lyd_create_anydata(struct lyd_node *parent, const struct lys_node *schema, void *value,
-                   LYD_ANYDATA_VALUETYPE value_type)
+API struct lyd_node *
+lyd_chunk_parser_finish(struct lyd_chunk_parser *parser)
 {
-    struct lyd_node *iter;
-    struct lyd_node_anydata *ret;
-    int len;
+    FUN_IN;
 
-    ret = calloc(1, sizeof *ret);
-    LY_CHECK_ERR_RETURN(!ret, LOGMEM(schema->module->ctx), NULL);
+    struct ly_ctx *ctx;
+    struct lyd_node *result = NULL;
 
-    ret->schema = (struct lys_node *)schema;
-    ret->validity = ly_new_node_validity(schema);
-    if (resolve_applies_when(schema, 0, NULL)) {
-        ret->when_status = LYD_WHEN;
+    if (!parser) {
+        LOGARG;
+        return NULL;
     }
-    ret->prev = (struct lyd_node *)ret;
+    ctx = parser->ctx;
 
-    /* set the value */
-    switch (value_type) {
-    case LYD_ANYDATA_CONSTSTRING:
-    case LYD_ANYDATA_SXML:
-    case LYD_ANYDATA_JSON:
-        ret->value.str = lydict_insert(schema->module->ctx, (const char *)value, 0);
-        break;
-    case LYD_ANYDATA_STRING:
-    case LYD_ANYDATA_SXMLD:
-    case LYD_ANYDATA_JSOND:
-        ret->value.str = lydict_insert_zc(schema->module->ctx, (char *)value);
-        value_type &= ~LYD_ANYDATA_STRING; /* make const string from string */
-        break;
-    case LYD_ANYDATA_DATATREE:
-        ret->value.tree = (struct lyd_node *)value;
-        break;
-    case LYD_ANYDATA_XML:
-        ret->value.xml = (struct lyxml_elem *)value;
-        break;
-    case LYD_ANYDATA_LYB:
-        len = lyd_lyb_data_length(value);
-        if (len == -1) {
-            LOGERR(schema->module->ctx, LY_EINVAL, "Invalid LYB data.");
-            return NULL;
-        }
-        ret->value.mem = malloc(len);
-        LY_CHECK_ERR_RETURN(!ret->value.mem, LOGMEM(schema->module->ctx); free(ret), NULL);
-        memcpy(ret->value.mem, value, len);
-        break;
-    case LYD_ANYDATA_LYBD:
-        ret->value.mem = value;
-        value_type &= ~LYD_ANYDATA_STRING; /* make const string from string */
-        break;
+    if (parser->error) {
+        LOGERR(ctx, LY_EINVAL, "%s: parsing of a previous data chunk failed.", __func__);
+        goto cleanup;
     }
-    ret->value_type = value_type;
-
-#ifdef LY_ENABLED_CACHE
-    lyd_hash((struct lyd_node *)ret);
-#endif
 
-    /* connect to parent */
-    if (parent) {
-        if (lyd_insert(parent, (struct lyd_node*)ret)) {
-            lyd_free((struct lyd_node*)ret);
-            return NULL;
+    if (parser->format != LYD_XML) {
+        /* no incremental parsing, parse all the data at once */
+        if (parser->buf) {
+            parser->buf[parser->used] = '\0';
         }
+        result = lyd_parse_(ctx, parser->rpc_act, parser->buf ? parser->buf : "", parser->format, parser->options,
+                            parser->data_tree, parser->yang_data_name);
+        goto cleanup;
+    }
 
-        /* remove the flag from parents */
-        for (iter = parent; iter && iter->dflt; iter = iter->parent) {
-            iter->dflt = 0;
-        }
+    lydict_cache_start(ctx);
+    lyd_pool_stash_start(ctx);
+
+    /* parse the rest, an incomplete element is detected here */
+    if (parser->used && lyd_chunk_parse_xml(parser, parser->used)) {
+        lyd_pool_stash_flush(ctx);
+        lydict_cache_flush(ctx);
+        goto cleanup;
     }
 
-    return (struct lyd_node*)ret;
+    ly_errno = LY_SUCCESS;
+    result = lyd_parse_xml_(ctx, parser->rpc_act, &parser->xml, parser->options, parser->data_tree,
+                            parser->yang_data_name);
+    result = lyd_parse_check_result(result, parser->options);
+
+    lyd_pool_stash_flush(ctx);
+    lydict_cache_flush(ctx);
+
+cleanup:
+    lyd_chunk_parser_free(parser);
+    return result;
 }
 
-API struct lyd_node *
-lyd_new_anydata(struct lyd_node *parent, const struct lys_module *module, const char *name,
-                void *value, LYD_ANYDATA_VALUETYPE value_type)
+API void
+lyd_chunk_parser_free(struct lyd_chunk_parser *parser)
 {
     FUN_IN;
 
-    const struct lys_node *siblings, *snode;
-
-    if ((!parent && !module) || !name) {
-        LOGARG;
-        return NULL;
+    if (!parser) {
+        return;
     }
 
-    siblings = lyd_new_find_schema(parent, module, 0);
-    if (!siblings) {
+    lyxml_free_withsiblings(parser->ctx, parser->xml);
+    free(parser->buf);
+    free(parser);
+}
+
+/* maximum length of the data read at once by a stream parser */
+#define LYD_STREAM_READ 16384
+
+struct lyd_stream_parser {
+    struct lyd_chunk_parser chunk;  /* buffered data and the XML scanner */
+    int fd;                         /* input file descriptor, -1 for memory */
+    const char *data;               /* memory input not yet buffered */
+    size_t data_len;                /* length of data */
+    uint8_t eof;                    /* all the input is buffered */
+
+    /* LYD_JSON only, chunk.scan and chunk.depth are used for the document being scanned */
+    uint8_t begun;                  /* the document being scanned already started */
+    uint8_t string;                 /* scanning inside a string (1) or just after a backslash in it (2) */
+    size_t start;                   /* offset of the document in the buffer */
+    size_t end;                     /* end offset of the scanned complete document, 0 if not yet complete */
+};
+
+static struct lyd_stream_parser *
+lyd_stream_parser_new_(struct ly_ctx *ctx, LYD_FORMAT format, int options, va_list ap, const char *func)
+{
+    struct lyd_stream_parser *stream;
+    struct lyd_chunk_parser *chunk;
+
+    if ((format != LYD_XML) && (format != LYD_JSON)) {
         LOGARG;
         return NULL;
     }
 
-    if (lys_getnext_data(module, lys_parent(siblings), name, strlen(name), LYS_ANYDATA, 0, &snode) || !snode) {
-        LOGERR(siblings->module->ctx, LY_EINVAL, "Failed to find \"%s\" as a sibling to \"%s:%s\".",
-               name, lys_node_module(siblings)->name, siblings->name);
+    stream = calloc(1, sizeof *stream);
+    LY_CHECK_ERR_RETURN(!stream, LOGMEM(ctx), NULL);
+    chunk = &stream->chunk;
+
+    /* the options are checked only once for all the documents */
+    if (lyd_parse_args_(ctx, options, ap, func, &chunk->rpc_act, &chunk->data_tree, &chunk->yang_data_name)) {
+        free(stream);
         return NULL;
     }
 
-    return lyd_create_anydata(parent, snode, value, value_type);
+    chunk->ctx = ctx;
+    chunk->format = format;
+    /* every document is parsed separately */
+    chunk->options = options & ~LYD_OPT_NOSIBLINGS;
+    stream->fd = -1;
+    return stream;
 }
 
-API struct lyd_node *
-lyd_new_yangdata(const struct lys_module *module, const char *name_template, const char *name)
+API struct lyd_stream_parser *
+lyd_stream_parser_mem(struct ly_ctx *ctx, const char *data, LYD_FORMAT format, int options, ...)
 {
     FUN_IN;
 
-    const struct lys_node *schema = NULL, *snode;
+    struct lyd_stream_parser *stream;
+    va_list ap;
 
-    if (!module || !name_template || !name) {
+    if (!ctx || !data) {
         LOGARG;
         return NULL;
     }
 
-    schema = lyp_get_yang_data_template(module, name_template, strlen(name_template));
-    if (!schema) {
-        LOGERR(module->ctx, LY_EINVAL, "Failed to find yang-data template \"%s\".", name_template);
-        return NULL;
+    va_start(ap, options);
+    stream = lyd_stream_parser_new_(ctx, format, options, ap, __func__);
+    va_end(ap);
+    if (stream) {
+        stream->data = data;
+        stream->data_len = strlen(data);
     }
 
-    if (lys_getnext_data(module, schema, name, strlen(name), LYS_CONTAINER, 0, &snode) || !snode) {
-        LOGERR(module->ctx, LY_EINVAL, "Failed to find \"%s\" as a container child of \"%s:%s\".",
-               name, module->name, schema->name);
-        return NULL;
-    }
-
-    return _lyd_new(NULL, snode, 0);
+    return stream;
 }
 
-API struct lyd_node *
-lyd_new_output(struct lyd_node *parent, const struct lys_module *module, const char *name)
+API struct lyd_stream_parser *
+lyd_stream_parser_fd(struct ly_ctx *ctx, int fd, LYD_FORMAT format, int options, ...)
 {
     FUN_IN;
 
-    const struct lys_node *snode = NULL, *siblings;
-
-    if ((!parent && !module) || !name) {
-        LOGARG;
-        return NULL;
-    }
+    struct lyd_stream_parser *stream;
+    va_list ap;
 
-    siblings = lyd_new_find_schema(parent, module, 1);
-    if (!siblings) {
+    if (!ctx || (fd < 0)) {
         LOGARG;
         return NULL;
     }
 
-    if (lys_getnext_data(module, lys_parent(siblings), name, strlen(name), LYS_CONTAINER | LYS_LIST | LYS_NOTIF
-                         | LYS_RPC | LYS_ACTION, 0, &snode) || !snode) {
-        LOGERR(siblings->module->ctx, LY_EINVAL, "Failed to find \"%s\" as a sibling to \"%s:%s\".",
-               name, lys_node_module(siblings)->name, siblings->name);
-        return NULL;
+    va_start(ap, options);
+    stream = lyd_stream_parser_new_(ctx, format, options, ap, __func__);
+    va_end(ap);
+    if (stream) {
+        stream->fd = fd;
     }
 
-    return _lyd_new(parent, snode, 0);
+    return stream;
 }
 
-API struct lyd_node *
-lyd_new_output_leaf(struct lyd_node *parent, const struct lys_module *module, const char *name, const char *val_str)
+/**
+ * @brief Buffer the next part of the stream input.
+ */
+static int
+lyd_stream_read(struct lyd_stream_parser *stream)
 {
-    FUN_IN;
-
-    const struct lys_node *snode = NULL, *siblings;
+    struct lyd_chunk_parser *chunk = &stream->chunk;
+    size_t len;
+    ssize_t r;
 
-    if ((!parent && !module) || !name) {
-        LOGARG;
-        return NULL;
+    if (stream->start) {
+        /* drop the parsed documents and the separators */
+        memmove(chunk->buf, chunk->buf + stream->start, chunk->used - stream->start);
+        chunk->used -= stream->start;
+        chunk->scan -= stream->start;
+        stream->start = 0;
     }
 
-    siblings = lyd_new_find_schema(parent, module, 1);
-    if (!siblings) {
-        LOGARG;
-        return NULL;
+    len = LYD_STREAM_READ;
+    if ((stream->fd == -1) && (len > stream->data_len)) {
+        len = stream->data_len;
+    }
+    if (lyd_chunk_grow(chunk, len)) {
+        return EXIT_FAILURE;
     }
 
-    if (lys_getnext_data(module, lys_parent(siblings), name, strlen(name), LYS_LEAFLIST | LYS_LEAF, 0, &snode) || !snode) {
-        LOGERR(siblings->module->ctx, LY_EINVAL, "Failed to find \"%s\" as a sibling to \"%s:%s\".",
-               name, lys_node_module(siblings)->name, siblings->name);
-        return NULL;
+    if (stream->fd == -1) {
+        memcpy(chunk->buf + chunk->used, stream->data, len);
+        stream->data += len;
+        stream->data_len -= len;
+        if (!stream->data_len) {
+            stream->eof = 1;
+        }
+    } else {
+        do {
+            r = read(stream->fd, chunk->buf + chunk->used, len);
+        } while ((r < 0) && (errno == EINTR));
+        if (r < 0) {
+            LOGERR(chunk->ctx, LY_ESYS, "Reading the data stream failed (%s).", strerror(errno));
+            chunk->error = 1;
+            return EXIT_FAILURE;
+        } else if (!r) {
+            stream->eof = 1;
+        } else if (memchr(chunk->buf + chunk->used, '\0', r)) {
+            LOGERR(chunk->ctx, LY_EINVAL, "Data stream contains a NULL byte.");
+            chunk->error = 1;
+            return EXIT_FAILURE;
+        }
+        len = r;
     }
+    chunk->used += len;
 
-    return _lyd_new_leaf(parent, snode, val_str, 0, 0);
+    return EXIT_SUCCESS;
 }
 
-API struct lyd_node *
-lyd_new_output_anydata(struct lyd_node *parent, const struct lys_module *module, const char *name,
-                       void *value, LYD_ANYDATA_VALUETYPE value_type)
+/**
+ * @brief Scan the new JSON data in the stream buffer for the end of the first document.
+ *
+ * The documents are separated by any whitespace (NDJSON) or RS characters (JSON text sequences, RFC 7464),
+ * which are dropped before a document.
+ */
+static void
+lyd_stream_scan_json(struct lyd_stream_parser *stream)
 {
-    FUN_IN;
+    struct lyd_chunk_parser *chunk = &stream->chunk;
+    char c;
 
-    const struct lys_node *siblings, *snode;
+    for (; !stream->end && (chunk->scan < chunk->used); ++chunk->scan) {
+        c = chunk->buf[chunk->scan];
+        if (stream->string) {
+            if (stream->string == 2) {
+                stream->string = 1;
+            } else if (c == '\\') {
+                stream->string = 2;
+            } else if (c == '"') {
+                stream->string = 0;
+            }
+            continue;
+        }
 
-    if ((!parent && !module) || !name) {
-        LOGARG;
-        return NULL;
-    }
+        if (!chunk->depth && ((c == ' ') || (c == '\t') || (c == '\n') || (c == '\r') || (c == '\x1e'))) {
+            if (stream->begun) {
+                /* the end of a document that is not an object, let the JSON parser report it */
+                stream->end = chunk->scan;
+            } else {
+                /* a separator before the document */
+                stream->start = chunk->scan + 1;
+            }
+            continue;
+        }
 
-    siblings = lyd_new_find_schema(parent, module, 1);
-    if (!siblings) {
-        LOGARG;
-        return NULL;
+        stream->begun = 1;
+        if (c == '"') {
+            stream->string = 1;
+        } else if ((c == '{') || (c == '[')) {
+            ++chunk->depth;
+        } else if (((c == '}') || (c == ']')) && chunk->depth && !--chunk->depth) {
+            stream->end = chunk->scan + 1;
+        }
     }
+}
 
-    if (lys_getnext_data(module, lys_parent(siblings), name, strlen(name), LYS_ANYDATA, 0, &snode) || !snode) {
-        LOGERR(siblings->module->ctx, LY_EINVAL, "Failed to find \"%s\" as a sibling to \"%s:%s\".",
-               name, lys_node_module(siblings)->name, siblings->name);
-        return NULL;
+/**
+ * @brief Parse the next JSON document of a stream.
+ */
+static int
+lyd_stream_next_json(struct lyd_stream_parser *stream, struct lyd_node **node)
+{
+    struct lyd_chunk_parser *chunk = &stream->chunk;
+    char c;
+
+    lyd_stream_scan_json(stream);
+    while (!stream->end && !stream->eof) {
+        if (lyd_stream_read(stream)) {
+            return -1;
+        }
+        lyd_stream_scan_json(stream);
+    }
+    if (!stream->end) {
+        if (!stream->begun) {
+            /* only separators left */
+            return 0;
+        }
+        /* incomplete document, let the JSON parser report it */
+        stream->end = chunk->used;
     }
 
-    return lyd_create_anydata(parent, snode, value, value_type);
+    /* terminate the document temporarily, there is always a spare byte */
+    c = chunk->buf[stream->end];
+    chunk->buf[stream->end] = '\0';
+    ly_errno = LY_SUCCESS;
+    *node = lyd_parse_json(chunk->ctx, chunk->buf + stream->start, chunk->options, chunk->rpc_act, chunk->data_tree,
+                           chunk->yang_data_name);
+    *node = lyd_parse_check_result(*node, chunk->options);
+    chunk->buf[stream->end] = c;
+
+    /* the next document is scanned from its end */
+    stream->start = chunk->scan = stream->end;
+    stream->end = 0;
+    stream->begun = 0;
+    stream->string = 0;
+    chunk->depth = 0;
+
+    return ly_errno ? -1 : 1;
 }
 
-char *
-lyd_make_canonical(const struct lys_node *schema, const char *val_str, int val_str_len)
+/**
+ * @brief Parse the next XML document (top-level element) of a stream.
+ */
+static int
+lyd_stream_next_xml(struct lyd_stream_parser *stream, struct lyd_node **node)
 {
-    struct lyd_node *node;
-    char *str;
-
-    assert(schema->nodetype & (LYS_LEAF | LYS_LEAFLIST));
+    struct lyd_chunk_parser *chunk = &stream->chunk;
+    struct lyxml_elem *xml;
 
-    str = strndup(val_str, val_str_len);
-    if (!str) {
-        LOGMEM(schema->module->ctx);
-        return NULL;
+    while (!chunk->xml && !stream->eof) {
+        if (lyd_stream_read(stream) || lyd_chunk_scan_xml(chunk)) {
+            chunk->error = 1;
+            return -1;
+        }
     }
-
-    node = lyd_create_leaf(schema, str, 0);
-    free(str);
-    if (!node) {
-        return NULL;
+    if (!chunk->xml && chunk->used) {
+        /* the rest, an incomplete element is detected here */
+        if (lyd_chunk_parse_xml(chunk, chunk->used)) {
+            chunk->error = 1;
+            return -1;
+        }
     }
-
-    /* parse the value into a fake leaf */
-    if (!lyp_parse_value(&((struct lys_node_leaf *)node->schema)->type, &((struct lyd_node_leaf_list *)node)->value_str,
-                         NULL, (struct lyd_node_leaf_list *)node, NULL, NULL, 1, 0, 0)) {
-        lyd_free(node);
-        return NULL;
+    if (!chunk->xml) {
+        return 0;
     }
 
-    str = strdup(((struct lyd_node_leaf_list *)node)->value_str);
-    lyd_free(node);
-    if (!str) {
-        LOGMEM(schema->module->ctx);
-        return NULL;
+    /* detach the first element */
+    xml = chunk->xml;
+    chunk->xml = xml->next;
+    if (chunk->xml) {
+        chunk->xml->prev = xml->prev;
     }
+    xml->next = NULL;
+    xml->prev = xml;
 
-    return str;
+    ly_errno = LY_SUCCESS;
+    *node = lyd_parse_xml_(chunk->ctx, chunk->rpc_act, &xml, chunk->options, chunk->data_tree, chunk->yang_data_name);
+    *node = lyd_parse_check_result(*node, chunk->options);
+
+    return ly_errno ? -1 : 1;
 }
 
-static int
-lyd_new_path_list_predicate(struct lyd_node *list, const char *list_name, const char *predicate, int *parsed)
+API int
+lyd_stream_parser_next(struct lyd_stream_parser *stream, struct lyd_node **node)
 {
-    const char *mod_name, *name, *value;
-    char *key_val;
-    int r, i, mod_name_len, nam_len, val_len, has_predicate;
-    struct lys_node_list *slist;
-    struct lys_node *key;
+    FUN_IN;
 
-    slist = (struct lys_node_list *)list->schema;
+    int ret;
 
-    /* is the predicate a number? */
-    if (((r = parse_schema_json_predicate(predicate, &mod_name, &mod_name_len, &name, &nam_len, &value, &val_len, &has_predicate)) < 1)
-            || !strncmp(name, ".", nam_len)) {
-        LOGVAL(slist->module->ctx, LYE_PATH_INCHAR, LY_VLOG_NONE, NULL, predicate[-r], &predicate[-r]);
+    if (!stream || !node) {
+        LOGARG;
         return -1;
     }
+    *node = NULL;
 
-    if (isdigit(name[0])) {
-        /* position index - creating without keys */
-        *parsed += r;
-        return 0;
+    if (stream->chunk.error) {
+        LOGERR(stream->chunk.ctx, LY_EINVAL, "%s: reading of the data stream failed before.", __func__);
+        return -1;
     }
 
-    /* it's not a number, so there must be some keys */
-    if (!slist->keys_size) {
-        /* there are none, so pretend we did not parse anything to get invalid char error later */
-        return 0;
+    /* cache the repeating strings */
+    lydict_cache_start(stream->chunk.ctx);
+    lyd_pool_stash_start(stream->chunk.ctx);
+    if (stream->chunk.format == LYD_XML) {
+        ret = lyd_stream_next_xml(stream, node);
+    } else {
+        ret = lyd_stream_next_json(stream, node);
     }
+    lyd_pool_stash_flush(stream->chunk.ctx);
+    lydict_cache_flush(stream->chunk.ctx);
 
-    /* go through all the keys */
-    i = 0;
-    goto check_parsed_values;
-
-    for (; i < slist->keys_size; ++i) {
-        if (!has_predicate) {
-            LOGVAL(slist->module->ctx, LYE_PATH_MISSKEY, LY_VLOG_NONE, NULL, list_name);
-            return -1;
-        }
+    return ret;
+}
 
-        if (((r = parse_schema_json_predicate(predicate, &mod_name, &mod_name_len, &name, &nam_len, &value, &val_len, &has_predicate)) < 1)
-                || !strncmp(name, ".", nam_len)) {
-            LOGVAL(slist->module->ctx, LYE_PATH_INCHAR, LY_VLOG_NONE, NULL, predicate[-r], &predicate[-r]);
-            return -1;
-        }
+API void
+lyd_stream_parser_free(struct lyd_stream_parser *stream)
+{
+    FUN_IN;
 
-check_parsed_values:
-        key = (struct lys_node *)slist->keys[i];
-        *parsed += r;
-        predicate += r;
+    if (!stream) {
+        return;
+    }
 
-        if (!value || (!mod_name && (lys_node_module(key) != lys_node_module((struct lys_node *)slist)))
-                || (mod_name && (strncmp(lys_node_module(key)->name, mod_name, mod_name_len) || lys_node_module(key)->name[mod_name_len]))
-                || strncmp(key->name, name, nam_len) || key->name[nam_len]) {
-            LOGVAL(slist->module->ctx, LYE_PATH_INKEY, LY_VLOG_NONE, NULL, name);
-            return -1;
-        }
+    lyxml_free_withsiblings(stream->chunk.ctx, stream->chunk.xml);
+    free(stream->chunk.buf);
+    free(stream);
+}
 
-        key_val = malloc((val_len + 1) * sizeof(char));
-        LY_CHECK_ERR_RETURN(!key_val, LOGMEM(slist->module->ctx), -1);
-        strncpy(key_val, value, val_len);
-        key_val[val_len] = '\0';
+static struct lys_node *
+lyd_new_find_schema(struct lyd_node *parent, const struct lys_module *module, int rpc_output)
+{
+    struct lys_node *siblings;
 
-        if (!_lyd_new_leaf(list, key, key_val, 0, 0)) {
-            free(key_val);
-            return -1;
+    if (!parent) {
+        siblings = module->data;
+    } else {
+        if (!parent->schema) {
+            return NULL;
+        }
+        siblings = parent->schema->child;
+        if (siblings && (siblings->nodetype == (rpc_output ? LYS_INPUT : LYS_OUTPUT))) {
+            siblings = siblings->next;
+        }
+        if (siblings && (siblings->nodetype == (rpc_output ? LYS_OUTPUT : LYS_INPUT))) {
+            siblings = siblings->child;
         }
-        free(key_val);
     }
 
-    return 0;
+    return siblings;
 }
 
-static struct lyd_node *
-lyd_new_path_update(struct lyd_node *node, void *value, LYD_ANYDATA_VALUETYPE value_type, int dflt)
+struct lyd_node *
+_lyd_new(struct lyd_node *parent, const struct lys_node *schema, int dflt)
 {
-    struct ly_ctx *ctx = node->schema->module->ctx;
-    struct lyd_node_anydata *any;
-    int len;
+    struct lyd_node *ret;
 
-    switch (node->schema->nodetype) {
-    case LYS_LEAF:
-        if (value_type > LYD_ANYDATA_STRING) {
-            LOGARG;
-            return NULL;
-        }
+    ret = lyd_pool_alloc(schema->module->ctx, sizeof *ret);
+    LY_CHECK_ERR_RETURN(!ret, LOGMEM(schema->module->ctx), NULL);
 
-        if (lyd_change_leaf((struct lyd_node_leaf_list *)node, value) == 0) {
-            /* there was an actual change */
-            if (dflt) {
-                node->dflt = 1;
-            }
-            return node;
-        }
+    ret->schema = (struct lys_node *)schema;
+    ret->validity = ly_new_node_validity(schema);
+    if (resolve_applies_when(schema, 0, NULL)) {
+        ret->when_status = LYD_WHEN;
+    }
+    ret->prev = ret;
+    ret->dflt = dflt;
 
-        if (dflt) {
-            /* maybe the value is the same, but the node is default now */
-            node->dflt = 1;
-            return node;
-        }
+#ifdef LY_ENABLED_CACHE
+    lyd_hash(ret);
+#endif
 
-        break;
-    case LYS_ANYXML:
-    case LYS_ANYDATA:
-        /* the nodes are the same if:
-         * 1) the value types are strings (LYD_ANYDATA_STRING and LYD_ANYDATA_CONSTSTRING equals)
-         *    and the strings equals
-         * 2) the value types are the same, but not strings and the pointers (not the content) are the
-         *    same
-         */
-        any = (struct lyd_node_anydata *)node;
-        if (any->value_type <= LYD_ANYDATA_STRING && value_type <= LYD_ANYDATA_STRING) {
-            if (ly_strequal(any->value.str, (char *)value, 0)) {
-                /* values are the same */
-                return NULL;
-            }
-        } else if (any->value_type == value_type) {
-            /* compare pointers */
-            if ((void *)any->value.tree == value) {
-                /* values are the same */
-                return NULL;
-            }
-        }
-
-        /* values are not the same - 1) remove the old one ... */
-        switch (any->value_type) {
-        case LYD_ANYDATA_CONSTSTRING:
-        case LYD_ANYDATA_SXML:
-        case LYD_ANYDATA_JSON:
-            lydict_remove(ctx, any->value.str);
-            break;
-        case LYD_ANYDATA_DATATREE:
-            lyd_free_withsiblings(any->value.tree);
-            break;
-        case LYD_ANYDATA_XML:
-            lyxml_free_withsiblings(ctx, any->value.xml);
-            break;
-        case LYD_ANYDATA_LYB:
-            free(any->value.mem);
-            break;
-        case LYD_ANYDATA_STRING:
-        case LYD_ANYDATA_SXMLD:
-        case LYD_ANYDATA_JSOND:
-        case LYD_ANYDATA_LYBD:
-            /* dynamic strings are used only as input parameters */
-            assert(0);
-            break;
-        }
-        /* ... and 2) store the new one */
-        switch (value_type) {
-        case LYD_ANYDATA_CONSTSTRING:
-        case LYD_ANYDATA_SXML:
-        case LYD_ANYDATA_JSON:
-            any->value.str = lydict_insert(ctx, (const char *)value, 0);
-            break;
-        case LYD_ANYDATA_STRING:
-        case LYD_ANYDATA_SXMLD:
-        case LYD_ANYDATA_JSOND:
-            any->value.str = lydict_insert_zc(ctx, (char *)value);
-            value_type &= ~LYD_ANYDATA_STRING; /* make const string from string */
-            break;
-        case LYD_ANYDATA_DATATREE:
-            any->value.tree = value;
-            break;
-        case LYD_ANYDATA_XML:
-            any->value.xml = value;
-            break;
-        case LYD_ANYDATA_LYB:
-            len = lyd_lyb_data_length(value);
-            if (len == -1) {
-                LOGERR(ctx, LY_EINVAL, "Invalid LYB data.");
-                return NULL;
-            }
-            any->value.mem = malloc(len);
-            LY_CHECK_ERR_RETURN(!any->value.mem, LOGMEM(ctx), NULL);
-            memcpy(any->value.mem, value, len);
-            break;
-        case LYD_ANYDATA_LYBD:
-            any->value.mem = value;
-            value_type &= ~LYD_ANYDATA_STRING; /* make const string from string */
-            break;
+    if (parent) {
+        if (lyd_insert(parent, ret)) {
+            lyd_free(ret);
+            return NULL;
         }
-        return node;
-    default:
-        /* nothing needed - containers, lists and leaf-lists do not have value or it cannot be changed */
-        break;
     }
-
-    /* not updated */
-    return NULL;
+    return ret;
 }
 
 API struct lyd_node *
-lyd_new_path(struct lyd_node *data_tree, const struct ly_ctx *ctx, const char *path, void *value,
-             LYD_ANYDATA_VALUETYPE value_type, int options)
+lyd_new(struct lyd_node *parent, const struct lys_module *module, const char *name)
 {
     FUN_IN;
 
-    char *str;
-    const char *mod_name, *name, *val_name, *val, *node_mod_name, *id, *backup_mod_name = NULL, *yang_data_name = NULL;
-    struct lyd_node *ret = NULL, *node, *parent = NULL;
-    const struct lys_node *schild, *sparent, *tmp;
-    const struct lys_node_list *slist;
-    const struct lys_module *module, *prev_mod;
-    int r, i, parsed = 0, mod_name_len, nam_len, val_name_len, val_len;
-    int is_relative = -1, has_predicate, first_iter = 1, edit_leaf;
-    int backup_is_relative, backup_mod_name_len, yang_data_name_len;
+    const struct lys_node *snode = NULL, *siblings;
 
-    if (!path || (!data_tree && !ctx)
-            || (!data_tree && (path[0] != '/'))) {
+    if ((!parent && !module) || !name) {
         LOGARG;
         return NULL;
     }
 
-    if (!ctx) {
-        ctx = data_tree->schema->module->ctx;
+    siblings = lyd_new_find_schema(parent, module, 0);
+    if (!siblings) {
+        LOGARG;
+        return NULL;
     }
 
-    id = path;
-
-    if (data_tree) {
-        if (path[0] == '/') {
-            /* absolute path, go through all the siblings and try to find the right parent, if exists,
-             * first go through all the next siblings keeping the original order, for positional predicates */
-            for (node = data_tree; !parsed && node; node = node->next) {
-                parent = resolve_partial_json_data_nodeid(id, value_type > LYD_ANYDATA_STRING ? NULL : value, node,
-                                                          options, &parsed);
-            }
-            if (!parsed) {
-                for (node = data_tree->prev; !parsed && node->next; node = node->prev) {
-                    parent = resolve_partial_json_data_nodeid(id, value_type > LYD_ANYDATA_STRING ? NULL : value, node,
-                                                              options, &parsed);
-                }
-            }
-        } else {
-            /* relative path, use only the provided data tree root */
-            parent = resolve_partial_json_data_nodeid(id, value_type > LYD_ANYDATA_STRING ? NULL : value, data_tree,
-                                                      options, &parsed);
-        }
-        if (parsed == -1) {
-            return NULL;
-        }
-        if (parsed) {
-            assert(parent);
-            /* if we parsed something we have a relative path now for sure, otherwise we don't know */
-            is_relative = 1;
+    if (lys_getnext_data(module, lys_parent(siblings), name, strlen(name), LYS_CONTAINER | LYS_LIST | LYS_NOTIF
+                         | LYS_RPC | LYS_ACTION, 0, &snode) || !snode) {
+        LOGERR(siblings->module->ctx, LY_EINVAL, "Failed to find \"%s\" as a sibling to \"%s:%s\".",
+               name, lys_node_module(siblings)->name, siblings->name);
+        return NULL;
+    }
 
-            id += parsed;
+    return _lyd_new(parent, snode, 0);
+}
 
-            if (!id[0]) {
-                /* the node exists, are we supposed to update it or is it default? */
-                if (!(options & LYD_PATH_OPT_UPDATE) && (!parent->dflt || (options & LYD_PATH_OPT_DFLT))) {
-                    LOGVAL(ctx, LYE_PATH_EXISTS, LY_VLOG_STR, path);
-                    return NULL;
-                }
+static struct lyd_node *
+lyd_create_leaf(const struct lys_node *schema, const char *val_str, int dflt)
+{
+    struct lyd_node_leaf_list *ret;
 
-                /* no change, the default node already exists */
-                if (parent->dflt && (options & LYD_PATH_OPT_DFLT)) {
-                    return NULL;
-                }
+    ret = lyd_pool_alloc(schema->module->ctx, sizeof *ret);
+    LY_CHECK_ERR_RETURN(!ret, LOGMEM(schema->module->ctx), NULL);
 
-                return lyd_new_path_update(parent, value, value_type, options & LYD_PATH_OPT_DFLT);
-            }
-        }
+    ret->schema = (struct lys_node *)schema;
+    ret->validity = ly_new_node_validity(schema);
+    if (resolve_applies_when(schema, 0, NULL)) {
+        ret->when_status = LYD_WHEN;
     }
+    ret->prev = (struct lyd_node *)ret;
+    ret->value_type = ((struct lys_node_leaf *)schema)->type.base;
+    ret->value_str = lydict_insert(schema->module->ctx, val_str ? val_str : "", 0);
+    ret->dflt = dflt;
 
-    backup_is_relative = is_relative;
-    if ((r = parse_schema_nodeid(id, &mod_name, &mod_name_len, &name, &nam_len, &is_relative, NULL, NULL, 1)) < 1) {
-        LOGVAL(ctx, LYE_PATH_INCHAR, LY_VLOG_NONE, NULL, id[-r], &id[-r]);
+#ifdef LY_ENABLED_CACHE
+    lyd_hash((struct lyd_node *)ret);
+#endif
+
+    return (struct lyd_node *)ret;
+}
+
+static struct lyd_node *
+_lyd_new_leaf(struct lyd_node *parent, const struct lys_node *schema, const char *val_str, int dflt, int edit_leaf)
+{
+    struct lyd_node *ret;
+
+    ret = lyd_create_leaf(schema, val_str, dflt);
+    if (!ret) {
         return NULL;
     }
 
-    if (name[0] == '#') {
-        if (is_relative) {
-            LOGVAL(ctx, LYE_PATH_INCHAR, LY_VLOG_NONE, NULL, '#', name);
+    /* connect to parent */
+    if (parent) {
+        if (lyd_insert(parent, ret)) {
+            lyd_free(ret);
             return NULL;
         }
-        yang_data_name = name + 1;
-        yang_data_name_len = nam_len - 1;
-        backup_mod_name = mod_name;
-        backup_mod_name_len = mod_name_len;
-        /* move to the next node in the path */
-        id += r;
-    } else {
-        is_relative = backup_is_relative;
     }
 
-    if ((r = parse_schema_nodeid(id, &mod_name, &mod_name_len, &name, &nam_len, &is_relative, &has_predicate, NULL, 0)) < 1) {
-        LOGVAL(ctx, LYE_PATH_INCHAR, LY_VLOG_NONE, NULL, id[-r], &id[-r]);
-        return NULL;
+    if (edit_leaf && !((struct lyd_node_leaf_list *)ret)->value_str[0]) {
+        /* empty edit leaf, it is fine */
+        ((struct lyd_node_leaf_list *)ret)->value_type = LY_TYPE_UNKNOWN;
+        return ret;
     }
-    /* move to the next node in the path */
-    id += r;
 
-    if (backup_mod_name) {
-        mod_name = backup_mod_name;
-        mod_name_len = backup_mod_name_len;
+    /* resolve the type correctly (after it was connected to parent cause of log) */
+    if (!lyp_parse_value(&((struct lys_node_leaf *)ret->schema)->type, &((struct lyd_node_leaf_list *)ret)->value_str,
+                         NULL, (struct lyd_node_leaf_list *)ret, NULL, NULL, 1, dflt, 0)) {
+        lyd_free(ret);
+        return NULL;
     }
 
-    /* prepare everything for the schema search loop */
-    if (is_relative) {
-        /* we are relative to data_tree or parent if some part of the path already exists */
-        if (!data_tree) {
-            LOGERR(ctx, LY_EINVAL, "%s: provided relative path (%s) without context node.", __func__, path);
-            return NULL;
-        } else if (!parent) {
-            parent = data_tree;
-        }
-        sparent = parent->schema;
-        module = prev_mod = lys_node_module(sparent);
-    } else {
-        /* we are starting from scratch, absolute path */
-        assert(!parent);
-        if (!mod_name) {
-            str = strndup(path, (name + nam_len) - path);
-            LOGVAL(ctx, LYE_PATH_MISSMOD, LY_VLOG_STR, str);
-            free(str);
-            return NULL;
+    if ((ret->schema->nodetype == LYS_LEAF) && (ret->schema->flags & LYS_UNIQUE)) {
+        for (; parent && (parent->schema->nodetype != LYS_LIST); parent = parent->parent);
+        if (parent) {
+            parent->validity |= LYD_VAL_UNIQUE;
+        } else {
+            LOGINT(schema->module->ctx);
         }
+    }
 
-        module = ly_ctx_nget_module(ctx, mod_name, mod_name_len, NULL, 1);
+    return ret;
+}
 
-        if (!module) {
-            str = strndup(path, (mod_name + mod_name_len) - path);
-            LOGVAL(ctx, LYE_PATH_INMOD, LY_VLOG_STR, str);
-            free(str);
-            return NULL;
-        }
-        mod_name = NULL;
-        mod_name_len = 0;
-        prev_mod = module;
+API struct lyd_node *
+lyd_new_leaf(struct lyd_node *parent, const struct lys_module *module, const char *name, const char *val_str)
+{
+    FUN_IN;
 
-        sparent = NULL;
-        if (yang_data_name) {
-            sparent = lyp_get_yang_data_template(module, yang_data_name, yang_data_name_len);
-            if (!sparent) {
-                str = strndup(path, (yang_data_name + yang_data_name_len) - path);
-                LOGVAL(ctx, LYE_PATH_INNODE, LY_VLOG_STR, str);
-                free(str);
-                return NULL;
+    const struct lys_node *snode = NULL, *siblings;
+
+    if ((!parent && !module) || !name) {
+        LOGARG;
+        return NULL;
+    }
+
+    siblings = lyd_new_find_schema(parent, module, 0);
+    if (!siblings) {
+        LOGARG;
+        return NULL;
+    }
+
+    if (lys_getnext_data(module, lys_parent(siblings), name, strlen(name), LYS_LEAFLIST | LYS_LEAF, 0, &snode) || !snode) {
+        LOGERR(siblings->module->ctx, LY_EINVAL, "Failed to find \"%s\" as a sibling to \"%s:%s\".",
+               name, lys_node_module(siblings)->name, siblings->name);
+        return NULL;
+    }
+
+    return _lyd_new_leaf(parent, snode, val_str, 0, 0);
+}
+
+/**
+ * @brief Update (add) default flag of the parents of the added node.
+ *
+ * @param[in] node Added node
+ */
+static void
+lyd_wd_update_parents(struct lyd_node *node)
+{
+    struct lyd_node *parent = node->parent, *iter;
+
+    for (parent = node->parent; parent; parent = node->parent) {
+        if (parent->dflt || parent->schema->nodetype != LYS_CONTAINER ||
+                ((struct lys_node_container *)parent->schema)->presence) {
+            /* parent is already default and there is nothing to update or
+             * it is not a non-presence container -> stop the loop */
+            break;
+        }
+        /* check that there is still some non default sibling */
+        for (iter = node->prev; iter != node; iter = iter->prev) {
+            if (!iter->dflt) {
+                break;
+            }
+        }
+        if (iter == node && node->prev != node) {
+            /* all siblings are implicit default nodes, propagate it to the parent */
+            node = node->parent;
+            if (lyd_txn_cur && lyd_txn_owns(node)) {
+                lyd_txn_rec_dflt(node);
             }
+            node->dflt = 1;
+            continue;
+        } else {
+            /* stop the loop */
+            break;
         }
     }
+}
 
-    /* create nodes in a loop */
-    while (1) {
-        /* find the schema node */
-        schild = NULL;
-        while ((schild = lys_getnext(schild, sparent, module, 0))) {
-            if (schild->nodetype & (LYS_CONTAINER | LYS_LEAF | LYS_LEAFLIST | LYS_LIST
-                                    | LYS_ANYDATA | LYS_NOTIF | LYS_RPC | LYS_ACTION)) {
-                /* module comparison */
-                if (mod_name) {
-                    node_mod_name = lys_node_module(schild)->name;
-                    if (strncmp(node_mod_name, mod_name, mod_name_len) || node_mod_name[mod_name_len]) {
-                        continue;
+/* set LYD_VAL_SUBTREE on all the parents of a changed node */
+static void
+lyd_val_mark_parents(struct lyd_node *node)
+{
+    for (node = node->parent; node && !(node->validity & LYD_VAL_SUBTREE); node = node->parent) {
+        node->validity |= LYD_VAL_SUBTREE;
+    }
+}
+
+/* remember that the node was changed for the incremental validation */
+static void
+lyd_val_set_changed(struct lyd_node *node)
+{
+    node->validity |= LYD_VAL_SUBTREE;
+    lyd_val_mark_parents(node);
+}
+
+static void
+check_leaf_list_backlinks(struct lyd_node *node)
+{
+    struct lyd_node *next, *iter;
+    struct lyd_node_leaf_list *leaf_list;
+    struct ly_set *set, *data;
+    uint32_t i, j;
+    int validity_changed = 0, indexed;
+
+    indexed = (node->schema->module->ctx->lref_rev != NULL);
+
+    /* fix leafrefs */
+    LY_TREE_DFS_BEGIN(node, next, iter) {
+        /* the node is target of a leafref */
+        if ((iter->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST)) && iter->schema->child) {
+            if (indexed && (data = resolve_lref_rev_take(iter))) {
+                /* only the leafrefs linked to this instance */
+                for (j = 0; j < data->number; j++) {
+                    leaf_list = (struct lyd_node_leaf_list *)data->set.d[j];
+                    leaf_list->validity |= LYD_VAL_LEAFREF;
+                    lyd_val_mark_parents((struct lyd_node *)leaf_list);
+                    validity_changed = 1;
+                    if ((leaf_list->value_type == LY_TYPE_LEAFREF) && (leaf_list->value.leafref == iter)) {
+                        lyp_parse_value(&((struct lys_node_leaf *)leaf_list->schema)->type, &leaf_list->value_str,
+                                        NULL, leaf_list, NULL, NULL, 1, leaf_list->dflt, 0);
                     }
-                } else if (lys_node_module(schild) != prev_mod) {
-                    continue;
                 }
+                ly_set_free(data);
+            }
 
-                /* name check */
-                if (strncmp(schild->name, name, nam_len) || schild->name[nam_len]) {
+            set = (struct ly_set *)iter->schema->child;
+            for (i = 0; i < set->number; i++) {
+                if (indexed && (((struct lys_node_leaf *)set->set.s[i])->type.base == LY_TYPE_LEAFREF)
+                        && !(set->set.s[i]->flags & LYS_LEAFREF_DEP)) {
+                    /* all the validated instances of this leafref are linked to their targets in the index */
                     continue;
                 }
 
-                /* RPC/action in/out check */
-                for (tmp = lys_parent(schild); tmp && (tmp->nodetype == LYS_USES); tmp = lys_parent(tmp));
-                if (tmp) {
-                    if (options & LYD_PATH_OPT_OUTPUT) {
-                        if (tmp->nodetype == LYS_INPUT) {
-                            continue;
-                        }
-                    } else {
-                        if (tmp->nodetype == LYS_OUTPUT) {
-                            continue;
+                data = lyd_find_instance(iter, set->set.s[i]);
+                if (data) {
+                    for (j = 0; j < data->number; j++) {
+                        /* invalidate the leafref, a change concerning it happened */
+                        leaf_list = (struct lyd_node_leaf_list *)data->set.d[j];
+                        leaf_list->validity |= LYD_VAL_LEAFREF;
+                        lyd_val_mark_parents((struct lyd_node *)leaf_list);
+                        validity_changed = 1;
+                        if (leaf_list->value_type == LY_TYPE_LEAFREF) {
+                            /* remove invalid link and put unresolved value back */
+                            lyp_parse_value(&((struct lys_node_leaf *)leaf_list->schema)->type, &leaf_list->value_str,
+                                            NULL, leaf_list, NULL, NULL, 1, leaf_list->dflt, 0);
                         }
                     }
+                    ly_set_free(data);
+                } else {
+                    LOGINT(node->schema->module->ctx);
+                    return;
                 }
-
-                break;
             }
         }
+        LY_TREE_DFS_END(node, next, iter)
+    }
 
-        if (!schild) {
-            str = strndup(path, (name + nam_len) - path);
-            LOGVAL(ctx, LYE_PATH_INNODE, LY_VLOG_STR, str);
-            free(str);
-            lyd_free(ret);
-            return NULL;
-        }
+    /* invalidate parent to make sure it will be checked in future validation */
+    if (validity_changed && node->parent) {
+        node->parent->validity |= LYD_VAL_MAND;
+        lyd_val_mark_parents(node->parent);
+    }
+}
 
-        /* we have the right schema node */
-        switch (schild->nodetype) {
-        case LYS_CONTAINER:
-        case LYS_LIST:
-        case LYS_NOTIF:
-        case LYS_RPC:
-        case LYS_ACTION:
-            if (options & LYD_PATH_OPT_NOPARENT) {
-                /* these were supposed to exist */
-                str = strndup(path, (name + nam_len) - path);
-                LOGVAL(ctx, LYE_PATH_MISSPAR, LY_VLOG_STR, str);
-                free(str);
-                lyd_free(ret);
-                return NULL;
-            }
-            node = _lyd_new(is_relative ? parent : NULL, schild, (options & LYD_PATH_OPT_DFLT) ? 1 : 0);
-            break;
-        case LYS_LEAF:
-        case LYS_LEAFLIST:
-            str = NULL;
-            if (has_predicate) {
-                if ((r = parse_schema_json_predicate(id, NULL, NULL, &val_name, &val_name_len, &val, &val_len, &has_predicate)) < 1) {
-                    LOGVAL(ctx, LYE_PATH_INCHAR, LY_VLOG_NONE, NULL, id[-r], &id[-r]);
-                    lyd_free(ret);
-                    return NULL;
-                }
-                id += r;
+API int
+lyd_change_leaf(struct lyd_node_leaf_list *leaf, const char *val_str)
+{
+    FUN_IN;
 
-                if ((val_name[0] != '.') || (val_name_len != 1)) {
-                    LOGVAL(ctx, LYE_PATH_INCHAR, LY_VLOG_NONE, NULL, val_name[0], val_name);
-                    lyd_free(ret);
-                    return NULL;
-                }
+    const char *backup;
+    int val_change, dflt_change, owned;
+    struct lyd_node *parent;
 
-                str = strndup(val, val_len);
-                if (!str) {
-                    LOGMEM(ctx);
-                    lyd_free(ret);
-                    return NULL;
-                }
-            }
-            if (id[0]) {
-                LOGVAL(ctx, LYE_PATH_INCHAR, LY_VLOG_NONE, NULL, id[0], id);
-                free(str);
-                lyd_free(ret);
-                return NULL;
-            }
+    if (!leaf || (leaf->schema->nodetype != LYS_LEAF)) {
+        LOGARG;
+        return -1;
+    }
 
-            if ((options & LYD_PATH_OPT_EDIT) && schild->nodetype == LYS_LEAF) {
-                edit_leaf = 1;
-            } else {
-                edit_leaf = 0;
-            }
-            node = _lyd_new_leaf(is_relative ? parent : NULL, schild, (str ? str : value),
-                                 (options & LYD_PATH_OPT_DFLT) ? 1 : 0, edit_leaf);
-            free(str);
-            break;
-        case LYS_ANYXML:
-        case LYS_ANYDATA:
-            if (id[0]) {
-                LOGVAL(ctx, LYE_PATH_INCHAR, LY_VLOG_NONE, NULL, id[0], id);
-                lyd_free(ret);
-                return NULL;
-            }
-            if (value_type <= LYD_ANYDATA_STRING && !value) {
-                value_type = LYD_ANYDATA_CONSTSTRING;
-                value = "";
+    owned = lyd_txn_cur && lyd_txn_owns((struct lyd_node *)leaf);
+    if (owned) {
+        lyd_txn_rec_value(leaf);
+    }
+
+    if (leaf->value_flags & LY_VALUE_USER) {
+        /* the user type value must be freed based on its original string */
+        lyd_free_value(leaf->value, leaf->value_type, leaf->value_flags, &((struct lys_node_leaf *)leaf->schema)->type,
+                       leaf->value_str, NULL, NULL, NULL);
+        memset(&leaf->value, 0, sizeof leaf->value);
+        leaf->value_flags &= ~LY_VALUE_USER;
+    }
+
+    backup = leaf->value_str;
+    leaf->value_str = lydict_insert(leaf->schema->module->ctx, val_str ? val_str : "", 0);
+    /* leaf->value is erased by lyp_parse_value() */
+
+    /* parse the type correctly, makes the value canonical if needed */
+    if (!lyp_parse_value(&((struct lys_node_leaf *)leaf->schema)->type, &leaf->value_str, NULL, leaf, NULL, NULL, 1, 0, 0)) {
+        lydict_remove(leaf->schema->module->ctx, backup);
+        return -1;
+    }
+
+    if (!strcmp(backup, leaf->value_str)) {
+        /* the value remains the same */
+        val_change = 0;
+    } else {
+        val_change = 1;
+    }
+
+    /* value is correct, remove backup */
+    lydict_remove(leaf->schema->module->ctx, backup);
+
+    /* clear the default flag, the value is different */
+    if (leaf->dflt) {
+        for (parent = (struct lyd_node *)leaf; parent; parent = parent->parent) {
+            if (owned) {
+                lyd_txn_rec_dflt(parent);
             }
-            node = lyd_create_anydata(is_relative ? parent : NULL, schild, value, value_type);
-            break;
-        default:
-            LOGINT(ctx);
-            node = NULL;
-            break;
+            parent->dflt = 0;
         }
+        dflt_change = 1;
+    } else {
+        dflt_change = 0;
+    }
 
-        if (!node) {
-            str = strndup(path, id - path);
+    if (val_change) {
+        /* make the node non-validated */
+        leaf->validity = ly_new_node_validity(leaf->schema);
+        lyd_val_set_changed((struct lyd_node *)leaf);
+
+        /* check possible leafref backlinks */
+        check_leaf_list_backlinks((struct lyd_node *)leaf);
+    }
+
+    if (val_change && (leaf->schema->flags & LYS_UNIQUE)) {
+        for (parent = leaf->parent; parent && (parent->schema->nodetype != LYS_LIST); parent = parent->parent);
+        if (parent) {
+            parent->validity |= LYD_VAL_UNIQUE;
+        }
+    }
+
+    return (val_change || dflt_change ? 0 : 1);
+}
+
+/* whether a leaf already has the typed value */
+static int
+lyd_leaf_value_equal(const struct lyd_node_leaf_list *leaf, LY_DATA_TYPE base, const void *value)
+{
+    if (leaf->value_type != base) {
+        return 0;
+    }
+
+    switch (base) {
+    case LY_TYPE_BOOL:
+        return leaf->value.bln == (*(const int8_t *)value ? 1 : 0);
+    case LY_TYPE_ENUM:
+        return leaf->value.enm->value == *(const int32_t *)value;
+    case LY_TYPE_INT8:
+        return leaf->value.int8 == *(const int8_t *)value;
+    case LY_TYPE_INT16:
+        return leaf->value.int16 == *(const int16_t *)value;
+    case LY_TYPE_INT32:
+        return leaf->value.int32 == *(const int32_t *)value;
+    case LY_TYPE_INT64:
+        return leaf->value.int64 == *(const int64_t *)value;
+    case LY_TYPE_UINT8:
+        return leaf->value.uint8 == *(const uint8_t *)value;
+    case LY_TYPE_UINT16:
+        return leaf->value.uint16 == *(const uint16_t *)value;
+    case LY_TYPE_UINT32:
+        return leaf->value.uint32 == *(const uint32_t *)value;
+    case LY_TYPE_UINT64:
+        return leaf->value.uint64 == *(const uint64_t *)value;
+    case LY_TYPE_DEC64:
+        return leaf->value.dec64 == *(const int64_t *)value;
+    default:
+        return 0;
+    }
+}
+
+API int
+lyd_change_leaf_value(struct lyd_node_leaf_list *leaf, const void *value)
+{
+    FUN_IN;
+
+    struct lyd_node_leaf_list tmp;
+    struct lys_node_leaf *sleaf;
+    struct lyd_node *parent;
+    struct ly_ctx *ctx;
+    int val_change, dflt_change, owned;
+
+    if (!leaf || !value || (leaf->schema->nodetype != LYS_LEAF)) {
+        LOGARG;
+        return -1;
+    }
+    sleaf = (struct lys_node_leaf *)leaf->schema;
+    ctx = sleaf->module->ctx;
+
+    switch (sleaf->type.base) {
+    case LY_TYPE_BOOL:
+    case LY_TYPE_ENUM:
+    case LY_TYPE_INT8:
+    case LY_TYPE_INT16:
+    case LY_TYPE_INT32:
+    case LY_TYPE_INT64:
+    case LY_TYPE_UINT8:
+    case LY_TYPE_UINT16:
+    case LY_TYPE_UINT32:
+    case LY_TYPE_UINT64:
+    case LY_TYPE_DEC64:
+        break;
+    default:
+        LOGERR(ctx, LY_EINVAL, "%s: leaf \"%s\" is not of a numeric, boolean or enumeration type, use lyd_change_leaf().",
+               __func__, sleaf->name);
+        return -1;
+    }
+    if ((leaf->value_flags & LY_VALUE_USER) || lys_is_key(sleaf, NULL)) {
+        LOGERR(ctx, LY_EINVAL, "%s: leaf \"%s\" is a key or of a user type, use lyd_change_leaf().", __func__, sleaf->name);
+        return -1;
+    }
+
+    /* no parsing and no dictionary work for the values that do not change */
+    val_change = !lyd_leaf_value_equal(leaf, sleaf->type.base, value);
+    if (!val_change && !leaf->dflt) {
+        return 1;
+    }
+
+    owned = lyd_txn_cur && lyd_txn_owns((struct lyd_node *)leaf);
+    if (owned) {
+        lyd_txn_rec_value(leaf);
+    }
+
+    if (val_change) {
+        /* the value is stored into a copy so that the leaf is not changed on error */
+        tmp = *leaf;
+        tmp.value_str = lydict_insert(ctx, "", 0);
+        memset(&tmp.value, 0, sizeof tmp.value);
+        if (lyp_store_value(&tmp, &sleaf->type, value, 0)) {
+            lydict_remove(ctx, tmp.value_str);
+            return -1;
+        }
+
+        lydict_remove(ctx, leaf->value_str);
+        leaf->value_str = tmp.value_str;
+        leaf->value = tmp.value;
+        leaf->value_type = tmp.value_type;
+        leaf->value_flags = tmp.value_flags;
+    }
+
+    /* clear the default flag, the value is different */
+    if (leaf->dflt) {
+        for (parent = (struct lyd_node *)leaf; parent; parent = parent->parent) {
+            if (owned) {
+                lyd_txn_rec_dflt(parent);
+            }
+            parent->dflt = 0;
+        }
+        dflt_change = 1;
+    } else {
+        dflt_change = 0;
+    }
+
+    if (val_change) {
+        /* make the node non-validated */
+        leaf->validity = ly_new_node_validity(leaf->schema);
+        lyd_val_set_changed((struct lyd_node *)leaf);
+
+        /* only leafref targets have backlinks */
+        if (leaf->schema->child) {
+            check_leaf_list_backlinks((struct lyd_node *)leaf);
+        }
+    }
+
+    if (val_change && (leaf->schema->flags & LYS_UNIQUE)) {
+        for (parent = leaf->parent; parent && (parent->schema->nodetype != LYS_LIST); parent = parent->parent);
+        if (parent) {
+            parent->validity |= LYD_VAL_UNIQUE;
+        }
+    }
+
+    return (val_change || dflt_change ? 0 : 1);
+}
+
+static struct lyd_node *
+lyd_create_anydata(struct lyd_node *parent, const struct lys_node *schema, void *value,
+                   LYD_ANYDATA_VALUETYPE value_type)
+{
+    struct lyd_node *iter;
+    struct lyd_node_anydata *ret;
+    int len;
+
+    ret = lyd_pool_alloc(schema->module->ctx, sizeof *ret);
+    LY_CHECK_ERR_RETURN(!ret, LOGMEM(schema->module->ctx), NULL);
+
+    ret->schema = (struct lys_node *)schema;
+    ret->validity = ly_new_node_validity(schema);
+    if (resolve_applies_when(schema, 0, NULL)) {
+        ret->when_status = LYD_WHEN;
+    }
+    ret->prev = (struct lyd_node *)ret;
+
+    /* set the value */
+    switch (value_type) {
+    case LYD_ANYDATA_CONSTSTRING:
+    case LYD_ANYDATA_SXML:
+    case LYD_ANYDATA_JSON:
+        ret->value.str = lydict_insert(schema->module->ctx, (const char *)value, 0);
+        break;
+    case LYD_ANYDATA_STRING:
+    case LYD_ANYDATA_SXMLD:
+    case LYD_ANYDATA_JSOND:
+        ret->value.str = lydict_insert_zc(schema->module->ctx, (char *)value);
+        value_type &= ~LYD_ANYDATA_STRING; /* make const string from string */
+        break;
+    case LYD_ANYDATA_DATATREE:
+        ret->value.tree = (struct lyd_node *)value;
+        break;
+    case LYD_ANYDATA_XML:
+        ret->value.xml = (struct lyxml_elem *)value;
+        break;
+    case LYD_ANYDATA_LYB:
+        len = lyd_lyb_data_length(value);
+        if (len == -1) {
+            LOGERR(schema->module->ctx, LY_EINVAL, "Invalid LYB data.");
+            return NULL;
+        }
+        ret->value.mem = malloc(len);
+        LY_CHECK_ERR_RETURN(!ret->value.mem, LOGMEM(schema->module->ctx); lyd_pool_free(schema->module->ctx, ret), NULL);
+        memcpy(ret->value.mem, value, len);
+        break;
+    case LYD_ANYDATA_LYBD:
+        ret->value.mem = value;
+        value_type &= ~LYD_ANYDATA_STRING; /* make const string from string */
+        break;
+    }
+    ret->value_type = value_type;
+
+#ifdef LY_ENABLED_CACHE
+    lyd_hash((struct lyd_node *)ret);
+#endif
+
+    /* connect to parent */
+    if (parent) {
+        if (lyd_insert(parent, (struct lyd_node*)ret)) {
+            lyd_free((struct lyd_node*)ret);
+            return NULL;
+        }
+
+        /* remove the flag from parents */
+        for (iter = parent; iter && iter->dflt; iter = iter->parent) {
+            iter->dflt = 0;
+        }
+    }
+
+    return (struct lyd_node*)ret;
+}
+
+API struct lyd_node *
+lyd_new_anydata(struct lyd_node *parent, const struct lys_module *module, const char *name,
+                void *value, LYD_ANYDATA_VALUETYPE value_type)
+{
+    FUN_IN;
+
+    const struct lys_node *siblings, *snode;
+
+    if ((!parent && !module) || !name) {
+        LOGARG;
+        return NULL;
+    }
+
+    siblings = lyd_new_find_schema(parent, module, 0);
+    if (!siblings) {
+        LOGARG;
+        return NULL;
+    }
+
+    if (lys_getnext_data(module, lys_parent(siblings), name, strlen(name), LYS_ANYDATA, 0, &snode) || !snode) {
+        LOGERR(siblings->module->ctx, LY_EINVAL, "Failed to find \"%s\" as a sibling to \"%s:%s\".",
+               name, lys_node_module(siblings)->name, siblings->name);
+        return NULL;
+    }
+
+    return lyd_create_anydata(parent, snode, value, value_type);
+}
+
+API struct lyd_node *
+lyd_new_yangdata(const struct lys_module *module, const char *name_template, const char *name)
+{
+    FUN_IN;
+
+    const struct lys_node *schema = NULL, *snode;
+
+    if (!module || !name_template || !name) {
+        LOGARG;
+        return NULL;
+    }
+
+    schema = lyp_get_yang_data_template(module, name_template, strlen(name_template));
+    if (!schema) {
+        LOGERR(module->ctx, LY_EINVAL, "Failed to find yang-data template \"%s\".", name_template);
+        return NULL;
+    }
+
+    if (lys_getnext_data(module, schema, name, strlen(name), LYS_CONTAINER, 0, &snode) || !snode) {
+        LOGERR(module->ctx, LY_EINVAL, "Failed to find \"%s\" as a container child of \"%s:%s\".",
+               name, module->name, schema->name);
+        return NULL;
+    }
+
+    return _lyd_new(NULL, snode, 0);
+}
+
+API struct lyd_node *
+lyd_new_output(struct lyd_node *parent, const struct lys_module *module, const char *name)
+{
+    FUN_IN;
+
+    const struct lys_node *snode = NULL, *siblings;
+
+    if ((!parent && !module) || !name) {
+        LOGARG;
+        return NULL;
+    }
+
+    siblings = lyd_new_find_schema(parent, module, 1);
+    if (!siblings) {
+        LOGARG;
+        return NULL;
+    }
+
+    if (lys_getnext_data(module, lys_parent(siblings), name, strlen(name), LYS_CONTAINER | LYS_LIST | LYS_NOTIF
+                         | LYS_RPC | LYS_ACTION, 0, &snode) || !snode) {
+        LOGERR(siblings->module->ctx, LY_EINVAL, "Failed to find \"%s\" as a sibling to \"%s:%s\".",
+               name, lys_node_module(siblings)->name, siblings->name);
+        return NULL;
+    }
+
+    return _lyd_new(parent, snode, 0);
+}
+
+API struct lyd_node *
+lyd_new_output_leaf(struct lyd_node *parent, const struct lys_module *module, const char *name, const char *val_str)
+{
+    FUN_IN;
+
+    const struct lys_node *snode = NULL, *siblings;
+
+    if ((!parent && !module) || !name) {
+        LOGARG;
+        return NULL;
+    }
+
+    siblings = lyd_new_find_schema(parent, module, 1);
+    if (!siblings) {
+        LOGARG;
+        return NULL;
+    }
+
+    if (lys_getnext_data(module, lys_parent(siblings), name, strlen(name), LYS_LEAFLIST | LYS_LEAF, 0, &snode) || !snode) {
+        LOGERR(siblings->module->ctx, LY_EINVAL, "Failed to find \"%s\" as a sibling to \"%s:%s\".",
+               name, lys_node_module(siblings)->name, siblings->name);
+        return NULL;
+    }
+
+    return _lyd_new_leaf(parent, snode, val_str, 0, 0);
+}
+
+API struct lyd_node *
+lyd_new_output_anydata(struct lyd_node *parent, const struct lys_module *module, const char *name,
+                       void *value, LYD_ANYDATA_VALUETYPE value_type)
+{
+    FUN_IN;
+
+    const struct lys_node *siblings, *snode;
+
+    if ((!parent && !module) || !name) {
+        LOGARG;
+        return NULL;
+    }
+
+    siblings = lyd_new_find_schema(parent, module, 1);
+    if (!siblings) {
+        LOGARG;
+        return NULL;
+    }
+
+    if (lys_getnext_data(module, lys_parent(siblings), name, strlen(name), LYS_ANYDATA, 0, &snode) || !snode) {
+        LOGERR(siblings->module->ctx, LY_EINVAL, "Failed to find \"%s\" as a sibling to \"%s:%s\".",
+               name, lys_node_module(siblings)->name, siblings->name);
+        return NULL;
+    }
+
+    return lyd_create_anydata(parent, snode, value, value_type);
+}
+
+char *
+lyd_make_canonical(const struct lys_node *schema, const char *val_str, int val_str_len)
+{
+    struct lyd_node *node;
+    char *str;
+
+    assert(schema->nodetype & (LYS_LEAF | LYS_LEAFLIST));
+
+    str = strndup(val_str, val_str_len);
+    if (!str) {
+        LOGMEM(schema->module->ctx);
+        return NULL;
+    }
+
+    node = lyd_create_leaf(schema, str, 0);
+    free(str);
+    if (!node) {
+        return NULL;
+    }
+
+    /* parse the value into a fake leaf */
+    if (!lyp_parse_value(&((struct lys_node_leaf *)node->schema)->type, &((struct lyd_node_leaf_list *)node)->value_str,
+                         NULL, (struct lyd_node_leaf_list *)node, NULL, NULL, 1, 0, 0)) {
+        lyd_free(node);
+        return NULL;
+    }
+
+    str = strdup(((struct lyd_node_leaf_list *)node)->value_str);
+    lyd_free(node);
+    if (!str) {
+        LOGMEM(schema->module->ctx);
+        return NULL;
+    }
+
+    return str;
+}
+
+static int
+lyd_new_path_list_predicate(struct lyd_node *list, const char *list_name, const char *predicate, int *parsed)
+{
+    const char *mod_name, *name, *value;
+    char *key_val;
+    int r, i, mod_name_len, nam_len, val_len, has_predicate;
+    struct lys_node_list *slist;
+    struct lys_node *key;
+
+    slist = (struct lys_node_list *)list->schema;
+
+    /* is the predicate a number? */
+    if (((r = parse_schema_json_predicate(predicate, &mod_name, &mod_name_len, &name, &nam_len, &value, &val_len, &has_predicate)) < 1)
+            || !strncmp(name, ".", nam_len)) {
+        LOGVAL(slist->module->ctx, LYE_PATH_INCHAR, LY_VLOG_NONE, NULL, predicate[-r], &predicate[-r]);
+        return -1;
+    }
+
+    if (isdigit(name[0])) {
+        /* position index - creating without keys */
+        *parsed += r;
+        return 0;
+    }
+
+    /* it's not a number, so there must be some keys */
+    if (!slist->keys_size) {
+        /* there are none, so pretend we did not parse anything to get invalid char error later */
+        return 0;
+    }
+
+    /* go through all the keys */
+    i = 0;
+    goto check_parsed_values;
+
+    for (; i < slist->keys_size; ++i) {
+        if (!has_predicate) {
+            LOGVAL(slist->module->ctx, LYE_PATH_MISSKEY, LY_VLOG_NONE, NULL, list_name);
+            return -1;
+        }
+
+        if (((r = parse_schema_json_predicate(predicate, &mod_name, &mod_name_len, &name, &nam_len, &value, &val_len, &has_predicate)) < 1)
+                || !strncmp(name, ".", nam_len)) {
+            LOGVAL(slist->module->ctx, LYE_PATH_INCHAR, LY_VLOG_NONE, NULL, predicate[-r], &predicate[-r]);
+            return -1;
+        }
+
+check_parsed_values:
+        key = (struct lys_node *)slist->keys[i];
+        *parsed += r;
+        predicate += r;
+
+        if (!value || (!mod_name && (lys_node_module(key) != lys_node_module((struct lys_node *)slist)))
+                || (mod_name && (strncmp(lys_node_module(key)->name, mod_name, mod_name_len) || lys_node_module(key)->name[mod_name_len]))
+                || strncmp(key->name, name, nam_len) || key->name[nam_len]) {
+            LOGVAL(slist->module->ctx, LYE_PATH_INKEY, LY_VLOG_NONE, NULL, name);
+            return -1;
+        }
+
+        key_val = malloc((val_len + 1) * sizeof(char));
+        LY_CHECK_ERR_RETURN(!key_val, LOGMEM(slist->module->ctx), -1);
+        strncpy(key_val, value, val_len);
+        key_val[val_len] = '\0';
+
+        if (!_lyd_new_leaf(list, key, key_val, 0, 0)) {
+            free(key_val);
+            return -1;
+        }
+        free(key_val);
+    }
+
+    return 0;
+}
+
+static struct lyd_node *
+lyd_new_path_update(struct lyd_node *node, void *value, LYD_ANYDATA_VALUETYPE value_type, int dflt)
+{
+    struct ly_ctx *ctx = node->schema->module->ctx;
+    struct lyd_node_anydata *any;
+    int len;
+
+    switch (node->schema->nodetype) {
+    case LYS_LEAF:
+        if (value_type > LYD_ANYDATA_STRING) {
+            LOGARG;
+            return NULL;
+        }
+
+        if (lyd_change_leaf((struct lyd_node_leaf_list *)node, value) == 0) {
+            /* there was an actual change */
+            if (dflt) {
+                node->dflt = 1;
+            }
+            return node;
+        }
+
+        if (dflt) {
+            /* maybe the value is the same, but the node is default now */
+            node->dflt = 1;
+            return node;
+        }
+
+        break;
+    case LYS_ANYXML:
+    case LYS_ANYDATA:
+        /* the nodes are the same if:
+         * 1) the value types are strings (LYD_ANYDATA_STRING and LYD_ANYDATA_CONSTSTRING equals)
+         *    and the strings equals
+         * 2) the value types are the same, but not strings and the pointers (not the content) are the
+         *    same
+         */
+        any = (struct lyd_node_anydata *)node;
+        if (any->value_type <= LYD_ANYDATA_STRING && value_type <= LYD_ANYDATA_STRING) {
+            if (ly_strequal(any->value.str, (char *)value, 0)) {
+                /* values are the same */
+                return NULL;
+            }
+        } else if (any->value_type == value_type) {
+            /* compare pointers */
+            if ((void *)any->value.tree == value) {
+                /* values are the same */
+                return NULL;
+            }
+        }
+
+        /* values are not the same - 1) remove the old one ... */
+        switch (any->value_type) {
+        case LYD_ANYDATA_CONSTSTRING:
+        case LYD_ANYDATA_SXML:
+        case LYD_ANYDATA_JSON:
+            lydict_remove(ctx, any->value.str);
+            break;
+        case LYD_ANYDATA_DATATREE:
+            lyd_free_withsiblings(any->value.tree);
+            break;
+        case LYD_ANYDATA_XML:
+            lyxml_free_withsiblings(ctx, any->value.xml);
+            break;
+        case LYD_ANYDATA_LYB:
+            free(any->value.mem);
+            break;
+        case LYD_ANYDATA_STRING:
+        case LYD_ANYDATA_SXMLD:
+        case LYD_ANYDATA_JSOND:
+        case LYD_ANYDATA_LYBD:
+            /* dynamic strings are used only as input parameters */
+            assert(0);
+            break;
+        }
+        /* ... and 2) store the new one */
+        switch (value_type) {
+        case LYD_ANYDATA_CONSTSTRING:
+        case LYD_ANYDATA_SXML:
+        case LYD_ANYDATA_JSON:
+            any->value.str = lydict_insert(ctx, (const char *)value, 0);
+            break;
+        case LYD_ANYDATA_STRING:
+        case LYD_ANYDATA_SXMLD:
+        case LYD_ANYDATA_JSOND:
+            any->value.str = lydict_insert_zc(ctx, (char *)value);
+            value_type &= ~LYD_ANYDATA_STRING; /* make const string from string */
+            break;
+        case LYD_ANYDATA_DATATREE:
+            any->value.tree = value;
+            break;
+        case LYD_ANYDATA_XML:
+            any->value.xml = value;
+            break;
+        case LYD_ANYDATA_LYB:
+            len = lyd_lyb_data_length(value);
+            if (len == -1) {
+                LOGERR(ctx, LY_EINVAL, "Invalid LYB data.");
+                return NULL;
+            }
+            any->value.mem = malloc(len);
+            LY_CHECK_ERR_RETURN(!any->value.mem, LOGMEM(ctx), NULL);
+            memcpy(any->value.mem, value, len);
+            break;
+        case LYD_ANYDATA_LYBD:
+            any->value.mem = value;
+            value_type &= ~LYD_ANYDATA_STRING; /* make const string from string */
+            break;
+        }
+        return node;
+    default:
+        /* nothing needed - containers, lists and leaf-lists do not have value or it cannot be changed */
+        break;
+    }
+
+    /* not updated */
+    return NULL;
+}
+
+/* find the deepest existing node of path in data_tree */
+static struct lyd_node *
+lyd_new_path_resolve(struct lyd_node *data_tree, const char *path, const char *llist_value, int options, int *parsed)
+{
+    struct lyd_node *node, *parent = NULL;
+
+    *parsed = 0;
+    if (path[0] == '/') {
+        /* absolute path, go through all the siblings and try to find the right parent, if exists,
+         * first go through all the next siblings keeping the original order, for positional predicates */
+        for (node = data_tree; !*parsed && node; node = node->next) {
+            parent = resolve_partial_json_data_nodeid(path, llist_value, node, options, parsed);
+        }
+        if (!*parsed) {
+            for (node = data_tree->prev; !*parsed && node->next; node = node->prev) {
+                parent = resolve_partial_json_data_nodeid(path, llist_value, node, options, parsed);
+            }
+        }
+    } else {
+        /* relative path, use only the provided data tree root */
+        parent = resolve_partial_json_data_nodeid(path, llist_value, data_tree, options, parsed);
+    }
+
+    return parent;
+}
+
+API struct lyd_node *
+lyd_new_path(struct lyd_node *data_tree, const struct ly_ctx *ctx, const char *path, void *value,
+             LYD_ANYDATA_VALUETYPE value_type, int options)
+{
+    FUN_IN;
+
+    char *str;
+    const char *mod_name, *name, *val_name, *val, *node_mod_name, *id, *backup_mod_name = NULL, *yang_data_name = NULL;
+    struct lyd_node *ret = NULL, *node, *parent = NULL;
+    const struct lys_node *schild, *sparent, *tmp;
+    const struct lys_node_list *slist;
+    const struct lys_module *module, *prev_mod;
+    int r, i, parsed = 0, mod_name_len, nam_len, val_name_len, val_len;
+    int is_relative = -1, has_predicate, first_iter = 1, edit_leaf;
+    int backup_is_relative, backup_mod_name_len, yang_data_name_len;
+
+    if (!path || (!data_tree && !ctx)
+            || (!data_tree && (path[0] != '/'))) {
+        LOGARG;
+        return NULL;
+    }
+
+    if (!ctx) {
+        ctx = data_tree->schema->module->ctx;
+    }
+
+    id = path;
+
+    if (data_tree) {
+        parent = lyd_new_path_resolve(data_tree, id, value_type > LYD_ANYDATA_STRING ? NULL : value, options, &parsed);
+        if (parsed == -1) {
+            return NULL;
+        }
+        if (parsed) {
+            assert(parent);
+            /* if we parsed something we have a relative path now for sure, otherwise we don't know */
+            is_relative = 1;
+
+            id += parsed;
+
+            if (!id[0]) {
+                /* the node exists, are we supposed to update it or is it default? */
+                if (!(options & LYD_PATH_OPT_UPDATE) && (!parent->dflt || (options & LYD_PATH_OPT_DFLT))) {
+                    LOGVAL(ctx, LYE_PATH_EXISTS, LY_VLOG_STR, path);
+                    return NULL;
+                }
+
+                /* no change, the default node already exists */
+                if (parent->dflt && (options & LYD_PATH_OPT_DFLT)) {
+                    return NULL;
+                }
+
+                return lyd_new_path_update(parent, value, value_type, options & LYD_PATH_OPT_DFLT);
+            }
+        }
+    }
+
+    backup_is_relative = is_relative;
+    if ((r = parse_schema_nodeid(id, &mod_name, &mod_name_len, &name, &nam_len, &is_relative, NULL, NULL, 1)) < 1) {
+        LOGVAL(ctx, LYE_PATH_INCHAR, LY_VLOG_NONE, NULL, id[-r], &id[-r]);
+        return NULL;
+    }
+
+    if (name[0] == '#') {
+        if (is_relative) {
+            LOGVAL(ctx, LYE_PATH_INCHAR, LY_VLOG_NONE, NULL, '#', name);
+            return NULL;
+        }
+        yang_data_name = name + 1;
+        yang_data_name_len = nam_len - 1;
+        backup_mod_name = mod_name;
+        backup_mod_name_len = mod_name_len;
+        /* move to the next node in the path */
+        id += r;
+    } else {
+        is_relative = backup_is_relative;
+    }
+
+    if ((r = parse_schema_nodeid(id, &mod_name, &mod_name_len, &name, &nam_len, &is_relative, &has_predicate, NULL, 0)) < 1) {
+        LOGVAL(ctx, LYE_PATH_INCHAR, LY_VLOG_NONE, NULL, id[-r], &id[-r]);
+        return NULL;
+    }
+    /* move to the next node in the path */
+    id += r;
+
+    if (backup_mod_name) {
+        mod_name = backup_mod_name;
+        mod_name_len = backup_mod_name_len;
+    }
+
+    /* prepare everything for the schema search loop */
+    if (is_relative) {
+        /* we are relative to data_tree or parent if some part of the path already exists */
+        if (!data_tree) {
+            LOGERR(ctx, LY_EINVAL, "%s: provided relative path (%s) without context node.", __func__, path);
+            return NULL;
+        } else if (!parent) {
+            parent = data_tree;
+        }
+        sparent = parent->schema;
+        module = prev_mod = lys_node_module(sparent);
+    } else {
+        /* we are starting from scratch, absolute path */
+        assert(!parent);
+        if (!mod_name) {
+            str = strndup(path, (name + nam_len) - path);
+            LOGVAL(ctx, LYE_PATH_MISSMOD, LY_VLOG_STR, str);
+            free(str);
+            return NULL;
+        }
+
+        module = ly_ctx_nget_module(ctx, mod_name, mod_name_len, NULL, 1);
+
+        if (!module) {
+            str = strndup(path, (mod_name + mod_name_len) - path);
+            LOGVAL(ctx, LYE_PATH_INMOD, LY_VLOG_STR, str);
+            free(str);
+            return NULL;
+        }
+        mod_name = NULL;
+        mod_name_len = 0;
+        prev_mod = module;
+
+        sparent = NULL;
+        if (yang_data_name) {
+            sparent = lyp_get_yang_data_template(module, yang_data_name, yang_data_name_len);
+            if (!sparent) {
+                str = strndup(path, (yang_data_name + yang_data_name_len) - path);
+                LOGVAL(ctx, LYE_PATH_INNODE, LY_VLOG_STR, str);
+                free(str);
+                return NULL;
+            }
+        }
+    }
+
+    /* create nodes in a loop */
+    while (1) {
+        /* find the schema node */
+        schild = NULL;
+        while ((schild = lys_getnext(schild, sparent, module, 0))) {
+            if (schild->nodetype & (LYS_CONTAINER | LYS_LEAF | LYS_LEAFLIST | LYS_LIST
+                                    | LYS_ANYDATA | LYS_NOTIF | LYS_RPC | LYS_ACTION)) {
+                /* module comparison */
+                if (mod_name) {
+                    node_mod_name = lys_node_module(schild)->name;
+                    if (strncmp(node_mod_name, mod_name, mod_name_len) || node_mod_name[mod_name_len]) {
+                        continue;
+                    }
+                } else if (lys_node_module(schild) != prev_mod) {
+                    continue;
+                }
+
+                /* name check */
+                if (strncmp(schild->name, name, nam_len) || schild->name[nam_len]) {
+                    continue;
+                }
+
+                /* RPC/action in/out check */
+                for (tmp = lys_parent(schild); tmp && (tmp->nodetype == LYS_USES); tmp = lys_parent(tmp));
+                if (tmp) {
+                    if (options & LYD_PATH_OPT_OUTPUT) {
+                        if (tmp->nodetype == LYS_INPUT) {
+                            continue;
+                        }
+                    } else {
+                        if (tmp->nodetype == LYS_OUTPUT) {
+                            continue;
+                        }
+                    }
+                }
+
+                break;
+            }
+        }
+
+        if (!schild) {
+            str = strndup(path, (name + nam_len) - path);
+            LOGVAL(ctx, LYE_PATH_INNODE, LY_VLOG_STR, str);
+            free(str);
+            lyd_free(ret);
+            return NULL;
+        }
+
+        /* we have the right schema node */
+        switch (schild->nodetype) {
+        case LYS_CONTAINER:
+        case LYS_LIST:
+        case LYS_NOTIF:
+        case LYS_RPC:
+        case LYS_ACTION:
+            if (options & LYD_PATH_OPT_NOPARENT) {
+                /* these were supposed to exist */
+                str = strndup(path, (name + nam_len) - path);
+                LOGVAL(ctx, LYE_PATH_MISSPAR, LY_VLOG_STR, str);
+                free(str);
+                lyd_free(ret);
+                return NULL;
+            }
+            node = _lyd_new(is_relative ? parent : NULL, schild, (options & LYD_PATH_OPT_DFLT) ? 1 : 0);
+            break;
+        case LYS_LEAF:
+        case LYS_LEAFLIST:
+            str = NULL;
+            if (has_predicate) {
+                if ((r = parse_schema_json_predicate(id, NULL, NULL, &val_name, &val_name_len, &val, &val_len, &has_predicate)) < 1) {
+                    LOGVAL(ctx, LYE_PATH_INCHAR, LY_VLOG_NONE, NULL, id[-r], &id[-r]);
+                    lyd_free(ret);
+                    return NULL;
+                }
+                id += r;
+
+                if ((val_name[0] != '.') || (val_name_len != 1)) {
+                    LOGVAL(ctx, LYE_PATH_INCHAR, LY_VLOG_NONE, NULL, val_name[0], val_name);
+                    lyd_free(ret);
+                    return NULL;
+                }
+
+                str = strndup(val, val_len);
+                if (!str) {
+                    LOGMEM(ctx);
+                    lyd_free(ret);
+                    return NULL;
+                }
+            }
+            if (id[0]) {
+                LOGVAL(ctx, LYE_PATH_INCHAR, LY_VLOG_NONE, NULL, id[0], id);
+                free(str);
+                lyd_free(ret);
+                return NULL;
+            }
+
+            if ((options & LYD_PATH_OPT_EDIT) && schild->nodetype == LYS_LEAF) {
+                edit_leaf = 1;
+            } else {
+                edit_leaf = 0;
+            }
+            node = _lyd_new_leaf(is_relative ? parent : NULL, schild, (str ? str : value),
+                                 (options & LYD_PATH_OPT_DFLT) ? 1 : 0, edit_leaf);
+            free(str);
+            break;
+        case LYS_ANYXML:
+        case LYS_ANYDATA:
+            if (id[0]) {
+                LOGVAL(ctx, LYE_PATH_INCHAR, LY_VLOG_NONE, NULL, id[0], id);
+                lyd_free(ret);
+                return NULL;
+            }
+            if (value_type <= LYD_ANYDATA_STRING && !value) {
+                value_type = LYD_ANYDATA_CONSTSTRING;
+                value = "";
+            }
+            node = lyd_create_anydata(is_relative ? parent : NULL, schild, value, value_type);
+            break;
+        default:
+            LOGINT(ctx);
+            node = NULL;
+            break;
+        }
+
+        if (!node) {
+            str = strndup(path, id - path);
             if (is_relative) {
                 LOGVAL(ctx, LYE_SPEC, LY_VLOG_STR, str, "Failed to create node \"%s\" as a child of \"%s\".",
                        schild->name, parent->schema->name);
             } else {
-                LOGVAL(ctx, LYE_SPEC, LY_VLOG_STR, str, "Failed to create node \"%s\".", schild->name);
+                LOGVAL(ctx, LYE_SPEC, LY_VLOG_STR, str, "Failed to create node \"%s\".", schild->name);
+            }
+            free(str);
+            lyd_free(ret);
+            return NULL;
+        }
+        /* special case when we are creating a sibling of a top-level data node */
+        if (!is_relative) {
+            if (data_tree) {
+                for (; data_tree->next; data_tree = data_tree->next);
+                if (lyd_insert_after(data_tree, node)) {
+                    lyd_free(ret);
+                    return NULL;
+                }
+            }
+            is_relative = 1;
+        }
+
+        if (first_iter) {
+            /* sort if needed, but only when inserted somewhere */
+            sparent = node->schema;
+            do {
+                sparent = lys_parent(sparent);
+            } while (sparent && (sparent->nodetype != ((options & LYD_PATH_OPT_OUTPUT) ? LYS_OUTPUT : LYS_INPUT)));
+            if (sparent && lyd_schema_sort(node, 0)) {
+                lyd_free(ret);
+                return NULL;
+            }
+
+            /* set first created node */
+            ret = node;
+            first_iter = 0;
+        }
+
+        parsed = 0;
+        if ((schild->nodetype == LYS_LIST) && has_predicate && lyd_new_path_list_predicate(node, name, id, &parsed)) {
+            lyd_free(ret);
+            return NULL;
+        }
+        id += parsed;
+
+        if (!id[0]) {
+            /* we are done */
+            if (options & LYD_PATH_OPT_NOPARENTRET) {
+                /* last created node */
+                return node;
+            }
+            return ret;
+        }
+
+        /* prepare for another iteration */
+        parent = node;
+        sparent = schild;
+        prev_mod = lys_node_module(schild);
+
+        /* parse another node */
+        if ((r = parse_schema_nodeid(id, &mod_name, &mod_name_len, &name, &nam_len, &is_relative, &has_predicate, NULL, 0)) < 1) {
+            LOGVAL(ctx, LYE_PATH_INCHAR, LY_VLOG_NONE, NULL, id[-r], &id[-r]);
+            lyd_free(ret);
+            return NULL;
+        }
+        id += r;
+
+        /* if a key of a list was supposed to be created, it is created as a part of the list instance creation */
+        if ((schild->nodetype == LYS_LIST) && !mod_name) {
+            slist = (const struct lys_node_list *)schild;
+            for (i = 0; i < slist->keys_size; ++i) {
+                if (!strncmp(slist->keys[i]->name, name, nam_len) && !slist->keys[i]->name[nam_len]) {
+                    /* the path continues? there cannot be anything after a key (leaf) */
+                    if (id[0]) {
+                        LOGVAL(ctx, LYE_PATH_INCHAR, LY_VLOG_NONE, NULL, id[0], id);
+                        lyd_free(ret);
+                        return NULL;
+                    }
+                    return ret;
+                }
+            }
+        }
+    }
+
+    LOGINT(ctx);
+    return NULL;
+}
+
+/* get the length of path without its last node, 0 for a top-level or a single relative node */
+static int
+lyd_new_path_parent_len(const char *path)
+{
+    int i, len = 0, pred = 0;
+    char quot = 0;
+
+    for (i = 1; path[i]; ++i) {
+        if (quot) {
+            if (path[i] == quot) {
+                quot = 0;
+            }
+        } else if ((path[i] == '\'') || (path[i] == '"')) {
+            quot = path[i];
+        } else if (path[i] == '[') {
+            ++pred;
+        } else if (path[i] == ']') {
+            --pred;
+        } else if ((path[i] == '/') && !pred) {
+            len = i;
+        }
+    }
+
+    return len;
+}
+
+API struct lyd_node *
+lyd_new_path_cursor(struct lyd_path_cursor *cursor, struct lyd_node *data_tree, const struct ly_ctx *ctx,
+                    const char *path, void *value, LYD_ANYDATA_VALUETYPE value_type, int options)
+{
+    FUN_IN;
+
+    struct lyd_node *ret, *start, *parent;
+    char *prefix;
+    int len, parsed;
+
+    if (!cursor || !path) {
+        LOGARG;
+        return NULL;
+    }
+
+    len = lyd_new_path_parent_len(path);
+    if (cursor->parent && len && (len == cursor->prefix_len) && !strncmp(path, cursor->prefix, len)) {
+        /* the parent is known, the rest of the path is relative to it */
+        return lyd_new_path(cursor->parent, NULL, path + len + 1, value, value_type, options);
+    }
+
+    lyd_path_cursor_clear(cursor);
+    ly_errno = LY_SUCCESS;
+    ret = lyd_new_path(data_tree, ctx, path, value, value_type, options);
+    if ((!ret && (ly_errno || !data_tree)) || !len) {
+        return ret;
+    }
+
+    /* remember the parent of the node for the next path */
+    start = data_tree;
+    if (!start) {
+        for (start = ret; start->parent; start = start->parent);
+    }
+    prefix = strndup(path, len);
+    LY_CHECK_ERR_RETURN(!prefix, LOGMEM(start->schema->module->ctx), ret);
+
+    parent = lyd_new_path_resolve(start, prefix, NULL, options, &parsed);
+    if (parsed == len) {
+        cursor->parent = parent;
+        cursor->prefix = prefix;
+        cursor->prefix_len = len;
+    } else {
+        free(prefix);
+    }
+
+    return ret;
+}
+
+API void
+lyd_path_cursor_clear(struct lyd_path_cursor *cursor)
+{
+    FUN_IN;
+
+    if (!cursor) {
+        return;
+    }
+
+    free(cursor->prefix);
+    memset(cursor, 0, sizeof *cursor);
+}
+
+API unsigned int
+lyd_list_pos(const struct lyd_node *node)
+{
+    FUN_IN;
+
+    unsigned int pos;
+    struct lys_node *schema;
+
+    if (!node || ((node->schema->nodetype != LYS_LIST) && (node->schema->nodetype != LYS_LEAFLIST))) {
+        return 0;
+    }
+
+    schema = node->schema;
+    pos = 0;
+    do {
+        if (node->schema == schema) {
+            ++pos;
+        }
+        node = node->prev;
+    } while (node->next);
+
+    return pos;
+}
+
+static struct lyd_node *
+lyd_new_dummy(struct lyd_node *root, struct lyd_node *parent, const struct lys_node *schema, const char *value, int dflt)
+{
+    unsigned int index;
+    struct ly_set *spath;
+    const struct lys_node *siter;
+    struct lyd_node *iter, *dummy = NULL;
+
+    assert(schema);
+    assert(schema->nodetype & (LYS_CONTAINER | LYS_LEAF | LYS_LIST | LYS_LEAFLIST | LYS_ANYDATA | LYS_NOTIF |
+                               LYS_RPC | LYS_ACTION));
+
+    spath = ly_set_new();
+    if (!spath) {
+        LOGMEM(schema->module->ctx);
+        return NULL;
+    }
+
+    if (!parent && root) {
+        /* find data root */
+        for (; root->parent; root = root->parent);   /* vertical move (up) */
+        for (; root->prev->next; root = root->prev); /* horizontal move (left) */
+    }
+
+    /* build schema path */
+    for (siter = schema; siter; siter = lys_parent(siter)) {
+        /* stop if we know some of the parents */
+        if (parent && parent->schema == siter) {
+            break;
+        }
+
+        if (siter->nodetype & (LYS_CONTAINER | LYS_LEAF | LYS_LIST | LYS_LEAFLIST | LYS_ANYDATA | LYS_NOTIF |
+                               LYS_RPC | LYS_ACTION)) {
+            /* we have a node that can appear in data tree */
+            ly_set_add(spath, (void*)siter, LY_SET_OPT_USEASLIST);
+        } /* else skip the rest node types */
+    }
+
+    assert(spath->number > 0);
+    index = spath->number;
+    if (!parent && !(spath->set.s[index - 1]->nodetype & LYS_LEAFLIST)) {
+        /* start by searching for the top-level parent */
+        LY_TREE_FOR(root, iter) {
+            if (iter->schema == spath->set.s[index - 1]) {
+                parent = iter;
+                index--;
+                break;
+            }
+        }
+    }
+
+    iter = parent;
+    while (iter && index && !(spath->set.s[index - 1]->nodetype & LYS_LEAFLIST)) {
+        /* search for closer parent on the path */
+        LY_TREE_FOR(parent->child, iter) {
+            if (iter->schema == spath->set.s[index - 1]) {
+                index--;
+                parent = iter;
+                break;
+            }
+        }
+    }
+    while(index) {
+        /* create the missing part of the path */
+        switch (spath->set.s[index - 1]->nodetype) {
+        case LYS_LEAF:
+        case LYS_LEAFLIST:
+            if (value) {
+                iter = _lyd_new_leaf(parent, spath->set.s[index - 1], value, dflt, 0);
+            } else {
+                iter = lyd_create_leaf(spath->set.s[index - 1], value, dflt);
+                if (iter && parent) {
+                    if (lyd_insert(parent, iter)) {
+                        lyd_free(iter);
+                        goto error;
+                    }
+                }
+            }
+            break;
+        case LYS_CONTAINER:
+        case LYS_LIST:
+            iter = _lyd_new(parent, spath->set.s[index - 1], dflt);
+            break;
+        case LYS_ANYXML:
+        case LYS_ANYDATA:
+            iter = lyd_create_anydata(parent, spath->set.s[index - 1], "", LYD_ANYDATA_CONSTSTRING);
+            break;
+        default:
+            goto error;
+        }
+        if (!iter) {
+            LOGINT(schema->module->ctx);
+            goto error;
+        }
+
+        /* we say it is valid and it is dummy */
+        iter->validity = LYD_VAL_INUSE;
+
+        if (!dummy) {
+            dummy = iter;
+        }
+
+        /* continue */
+        parent = iter;
+        index--;
+    }
+
+    ly_set_free(spath);
+
+    return dummy;
+
+error:
+    ly_set_free(spath);
+    lyd_free(dummy);
+    return NULL;
+}
+
+/**
+ * @brief Thread-specific mapping of the schema nodes into another (target) context, see lys_schema_map_start().
+ * The source modules are not removed while it is used, so the schema nodes are identified by their pointers.
+ */
+static THREAD_LOCAL struct {
+    struct ly_ctx *ctx;      /* target context the mapping is used for, NULL if not used */
+    uint32_t depth;          /* number of nested lys_schema_map_start() calls */
+    struct hash_table *ht;   /* mapped schema nodes, created on the first use */
+} lys_schema_map;
+
+struct lys_schema_map_rec {
+    const struct lys_node *src;
+    struct lys_node *trg;
+};
+
+static int
+lys_schema_map_equal(void *val1_p, void *val2_p, int UNUSED(mod), void *UNUSED(cb_data))
+{
+    return ((struct lys_schema_map_rec *)val1_p)->src == ((struct lys_schema_map_rec *)val2_p)->src;
+}
+
+/*
+ * Start mapping the schema nodes found in the target context, so that every schema node is searched for
+ * only once even when many data nodes of it are converted. Calls can be nested, it is used only
+ * for the first target context.
+ */
+static void
+lys_schema_map_start(struct ly_ctx *ctx)
+{
+    if (!lys_schema_map.ctx) {
+        lys_schema_map.ctx = ctx;
+    } else if (lys_schema_map.ctx != ctx) {
+        /* already used for another context */
+        return;
+    }
+
+    ++lys_schema_map.depth;
+}
+
+static void
+lys_schema_map_stop(struct ly_ctx *ctx)
+{
+    if (lys_schema_map.ctx != ctx) {
+        return;
+    }
+
+    if (!--lys_schema_map.depth) {
+        lyht_free(lys_schema_map.ht);
+        lys_schema_map.ht = NULL;
+        lys_schema_map.ctx = NULL;
+    }
+}
+
+/* get the mapped schema node, NULL if not mapped (yet) */
+static struct lys_node *
+lys_schema_map_get(const struct lys_node *schema, struct ly_ctx *ctx)
+{
+    struct lys_schema_map_rec rec, *match;
+    uint32_t hash;
+
+    if ((lys_schema_map.ctx != ctx) || !lys_schema_map.ht) {
+        return NULL;
+    }
+
+    rec.src = schema;
+    hash = dict_hash_multi(dict_hash_multi(0, (const char *)&schema, sizeof schema), NULL, 0);
+    if (lyht_find(lys_schema_map.ht, &rec, hash, (void **)&match)) {
+        return NULL;
+    }
+    return match->trg;
+}
+
+/* remember the schema node found in the target context, failing to do so is not an error */
+static void
+lys_schema_map_add(const struct lys_node *schema, struct lys_node *trg, struct ly_ctx *ctx)
+{
+    struct lys_schema_map_rec rec;
+    uint32_t hash;
+
+    if (lys_schema_map.ctx != ctx) {
+        return;
+    }
+
+    if (!lys_schema_map.ht) {
+        lys_schema_map.ht = lyht_new(64, sizeof rec, lys_schema_map_equal, NULL, 1);
+        if (!lys_schema_map.ht) {
+            return;
+        }
+    }
+
+    rec.src = schema;
+    rec.trg = trg;
+    hash = dict_hash_multi(dict_hash_multi(0, (const char *)&schema, sizeof schema), NULL, 0);
+    lyht_insert(lys_schema_map.ht, &rec, hash, NULL);
+}
+
+static struct lys_node *
+lys_get_schema_inctx_(struct lys_node *schema, struct ly_ctx *ctx)
+{
+    const struct lys_module *mod, *trg_mod = NULL;
+    struct lys_node *parent, *first_sibling = NULL, *iter = NULL;
+    struct ly_set *parents;
+    unsigned int index;
+    uint32_t idx;
+    void **ptr;
+
+    if (!ctx || schema->module->ctx == ctx) {
+        /* we have the same context */
+        return schema;
+    }
+
+    /* store the parents chain */
+    parents = ly_set_new();
+    for (parent = schema; parent; parent = lys_parent(parent)) {
+        /* note - augments are skipped so we will work only with the implemented modules
+         * (where the augments are applied) */
+        if (parent->nodetype != LYS_USES) {
+            ly_set_add(parents, parent, LY_SET_OPT_USEASLIST);
+        }
+    }
+    assert(parents->number);
+    index = parents->number - 1;
+
+    /* process the parents from the top level */
+    /* for the top-level node, we have to locate the module first */
+    parent = parents->set.s[index];
+    if (parent->nodetype == LYS_EXT) {
+        ptr = lys_ext_complex_get_substmt(LY_STMT_NODE, (struct lys_ext_instance_complex *)parent, NULL);
+        if (!ptr) {
+            ly_set_free(parents);
+            return NULL;
+        }
+        first_sibling = *(struct lys_node **)ptr;
+        parent = parents->set.s[--index];
+    }
+    idx = 0;
+    while ((mod = ly_ctx_get_module_iter(ctx, &idx))) {
+        trg_mod = lys_node_module(parent);
+        /* check module name */
+        if (strcmp(mod->name, trg_mod->name)) {
+            continue;
+        }
+
+        /* check revision */
+        if ((!mod->rev_size && !trg_mod->rev_size) ||
+                (mod->rev_size && trg_mod->rev_size && !strcmp(mod->rev[0].date, trg_mod->rev[0].date))) {
+            /* we have match */
+            break;
+        }
+    }
+    /* try data callback */
+    if (!mod && trg_mod && ctx->data_clb) {
+        LOGDBG(LY_LDGYANG, "Attempting to load '%s' into context using callback ...", trg_mod->name);
+        mod = ctx->data_clb(ctx, trg_mod->name, NULL, 0, ctx->data_clb_data);
+    }
+    if (!mod) {
+        ly_set_free(parents);
+        return NULL;
+    }
+    if (!first_sibling) {
+        first_sibling = mod->data;
+    }
+
+    /* now search in the schema tree for the matching node */
+    while (1) {
+        lys_get_sibling(first_sibling, trg_mod->name, 0, parent->name, 0, parent->nodetype,
+                        (const struct lys_node **)&iter);
+        if (!iter) {
+            /* not found, iter will be used as NULL result */
+            break;
+        }
+
+        if (index == 0) {
+            /* we are done, iter is the result */
+            break;
+        } else {
+            /* we are going to continue, so update variables for the next loop */
+            first_sibling = iter->child;
+            parent = parents->set.s[--index];
+            iter = NULL;
+        }
+    }
+
+    ly_set_free(parents);
+    return iter;
+}
+
+static struct lys_node *
+lys_get_schema_inctx(struct lys_node *schema, struct ly_ctx *ctx)
+{
+    struct lys_node *trg;
+
+    if (!ctx || schema->module->ctx == ctx) {
+        /* we have the same context */
+        return schema;
+    }
+
+    trg = lys_schema_map_get(schema, ctx);
+    if (!trg) {
+        trg = lys_get_schema_inctx_(schema, ctx);
+        if (trg) {
+            lys_schema_map_add(schema, trg, ctx);
+        }
+    }
+
+    return trg;
+}
+
+static struct lys_node *
+lyd_get_schema_inctx(const struct lyd_node *node, struct ly_ctx *ctx)
+{
+    assert(node);
+
+    return lys_get_schema_inctx(node->schema, ctx);
+}
+
+/* erase the temporary LYD_VAL_INUSE flags of the siblings and their subtrees */
+static void
+lyd_clear_inuse(struct lyd_node *siblings)
+{
+    struct lyd_node *root, *next, *elem;
+
+    LY_TREE_FOR(siblings, root) {
+        LY_TREE_DFS_BEGIN(root, next, elem) {
+            elem->validity &= ~LYD_VAL_INUSE;
+            LY_TREE_DFS_END(root, next, elem);
+        }
+    }
+}
+
+/* both target and source were validated, source is going to be freed */
+static void
+lyd_merge_node_update(struct lyd_node *target, struct lyd_node *source)
+{
+    struct ly_ctx *ctx;
+    struct lyd_node_leaf_list *trg_leaf, *src_leaf;
+    struct lyd_node_anydata *trg_any, *src_any;
+    const char *value_str;
+    lyd_val value;
+    LY_DATA_TYPE value_type;
+    uint8_t value_flags;
+    int len;
+
+    assert(target->schema->nodetype & (LYS_LEAF | LYS_ANYDATA));
+    ctx = target->schema->module->ctx;
+
+    lyd_val_set_changed(target);
+
+    if ((target->schema->nodetype == LYS_LEAF) && lyd_txn_cur && lyd_txn_owns(target)) {
+        lyd_txn_rec_value((struct lyd_node_leaf_list *)target);
+        lyd_txn_rec_dflt(target);
+    }
+
+    if (ctx == source->schema->module->ctx) {
+        /* source and targets are in the same context */
+        if (target->schema->nodetype == LYS_LEAF) {
+            trg_leaf = (struct lyd_node_leaf_list *)target;
+            src_leaf = (struct lyd_node_leaf_list *)source;
+
+            /* move the value from the source instead of copying it, the source frees the previous target value */
+            value_str = trg_leaf->value_str;
+            trg_leaf->value_str = src_leaf->value_str;
+            src_leaf->value_str = value_str;
+            value = trg_leaf->value;
+            value_type = trg_leaf->value_type;
+            value_flags = trg_leaf->value_flags;
+            trg_leaf->value = src_leaf->value;
+            trg_leaf->value_type = src_leaf->value_type;
+            trg_leaf->value_flags = src_leaf->value_flags;
+            src_leaf->value = value;
+            src_leaf->value_type = value_type;
+            src_leaf->value_flags = value_flags;
+            if (trg_leaf->value_type == LY_TYPE_LEAFREF) {
+                /* the leafref target is in the source tree */
+                trg_leaf->validity |= LYD_VAL_LEAFREF;
+                lyp_parse_value(&((struct lys_node_leaf *)trg_leaf->schema)->type, &trg_leaf->value_str,
+                                NULL, trg_leaf, NULL, NULL, 1, src_leaf->dflt, 0);
+            }
+            trg_leaf->dflt = src_leaf->dflt;
+
+            check_leaf_list_backlinks(target);
+        } else { /* ANYDATA */
+            trg_any = (struct lyd_node_anydata *)target;
+            src_any = (struct lyd_node_anydata *)source;
+
+            switch(trg_any->value_type) {
+            case LYD_ANYDATA_CONSTSTRING:
+            case LYD_ANYDATA_SXML:
+            case LYD_ANYDATA_JSON:
+                lydict_remove(ctx, trg_any->value.str);
+                break;
+            case LYD_ANYDATA_DATATREE:
+                lyd_free_withsiblings(trg_any->value.tree);
+                break;
+            case LYD_ANYDATA_XML:
+                lyxml_free_withsiblings(ctx, trg_any->value.xml);
+                break;
+            case LYD_ANYDATA_LYB:
+                free(trg_any->value.mem);
+                break;
+            case LYD_ANYDATA_STRING:
+            case LYD_ANYDATA_SXMLD:
+            case LYD_ANYDATA_JSOND:
+            case LYD_ANYDATA_LYBD:
+                /* dynamic strings are used only as input parameters */
+                assert(0);
+                break;
+            }
+
+            trg_any->value_type = src_any->value_type;
+            trg_any->value = src_any->value;
+
+            src_any->value_type = LYD_ANYDATA_DATATREE;
+            src_any->value.tree = NULL;
+        }
+    } else {
+        /* we have different contexts for the target and source */
+        if (target->schema->nodetype == LYS_LEAF) {
+            trg_leaf = (struct lyd_node_leaf_list *)target;
+            src_leaf = (struct lyd_node_leaf_list *)source;
+
+            lydict_remove(ctx, trg_leaf->value_str);
+            trg_leaf->value_str = lydict_insert(ctx, src_leaf->value_str, 0);
+            lyd_free_value(trg_leaf->value, trg_leaf->value_type, trg_leaf->value_flags,
+                           &((struct lys_node_leaf *)trg_leaf->schema)->type, trg_leaf->value_str, NULL, NULL, NULL);
+            trg_leaf->value_flags &= ~LY_VALUE_USER;
+            trg_leaf->value_type = src_leaf->value_type;
+            trg_leaf->dflt = src_leaf->dflt;
+
+            switch (trg_leaf->value_type) {
+            case LY_TYPE_BINARY:
+            case LY_TYPE_STRING:
+                /* value_str pointer is shared in these cases */
+                trg_leaf->value.string = trg_leaf->value_str;
+                break;
+            case LY_TYPE_LEAFREF:
+                trg_leaf->validity |= LYD_VAL_LEAFREF;
+                lyp_parse_value(&((struct lys_node_leaf *)trg_leaf->schema)->type, &trg_leaf->value_str,
+                                NULL, trg_leaf, NULL, NULL, 1, trg_leaf->dflt, 0);
+                break;
+            case LY_TYPE_INST:
+                trg_leaf->value.instance = NULL;
+                break;
+            case LY_TYPE_UNION:
+                /* unresolved union (this must be non-validated tree), duplicate the stored string (duplicated
+                 * because of possible change of the value in case of instance-identifier) */
+                trg_leaf->value.string = lydict_insert(ctx, src_leaf->value.string, 0);
+                break;
+            case LY_TYPE_BITS:
+            case LY_TYPE_ENUM:
+            case LY_TYPE_IDENT:
+                /* in case of duplicating bits (no matter if in the same context or not) or enum and identityref into
+                 * a different context, searching for the type and duplicating the data is almost as same as resolving
+                 * the string value, so due to a simplicity, parse the value for the duplicated leaf */
+                lyp_parse_value(&((struct lys_node_leaf *)trg_leaf->schema)->type, &trg_leaf->value_str, NULL,
+                                trg_leaf, NULL, NULL, 1, trg_leaf->dflt, 1);
+                break;
+            default:
+                trg_leaf->value = src_leaf->value;
+                break;
+            }
+            if (src_leaf->value_flags & LY_VALUE_USER) {
+                /* the user type value is stored again by the plugin of the target context */
+                lyp_parse_value(&((struct lys_node_leaf *)trg_leaf->schema)->type, &trg_leaf->value_str, NULL,
+                                trg_leaf, NULL, NULL, 1, trg_leaf->dflt, 1);
+            }
+
+            check_leaf_list_backlinks(target);
+        } else { /* ANYDATA */
+            trg_any = (struct lyd_node_anydata *)target;
+            src_any = (struct lyd_node_anydata *)source;
+
+            switch(trg_any->value_type) {
+            case LYD_ANYDATA_CONSTSTRING:
+            case LYD_ANYDATA_SXML:
+            case LYD_ANYDATA_JSON:
+                lydict_remove(ctx, trg_any->value.str);
+                break;
+            case LYD_ANYDATA_DATATREE:
+                lyd_free_withsiblings(trg_any->value.tree);
+                break;
+            case LYD_ANYDATA_XML:
+                lyxml_free_withsiblings(ctx, trg_any->value.xml);
+                break;
+            case LYD_ANYDATA_LYB:
+                free(trg_any->value.mem);
+                break;
+            case LYD_ANYDATA_STRING:
+            case LYD_ANYDATA_SXMLD:
+            case LYD_ANYDATA_JSOND:
+            case LYD_ANYDATA_LYBD:
+                /* dynamic strings are used only as input parameters */
+                assert(0);
+                break;
+            }
+
+            trg_any->value_type = src_any->value_type;
+            if ((void*)src_any->value.tree) {
+                /* there is a value to duplicate */
+                switch (trg_any->value_type) {
+                case LYD_ANYDATA_CONSTSTRING:
+                case LYD_ANYDATA_SXML:
+                case LYD_ANYDATA_JSON:
+                    trg_any->value.str = lydict_insert(ctx, src_any->value.str, 0);
+                    break;
+                case LYD_ANYDATA_DATATREE:
+                    trg_any->value.tree = lyd_dup_withsiblings_to_ctx(src_any->value.tree, 1, ctx);
+                    break;
+                case LYD_ANYDATA_XML:
+                    trg_any->value.xml = lyxml_dup_elem(ctx, src_any->value.xml, NULL, 1, 1);
+                    break;
+                case LYD_ANYDATA_LYB:
+                    len = lyd_lyb_data_length(src_any->value.mem);
+                    if (len == -1) {
+                        LOGERR(ctx, LY_EINVAL, "Invalid LYB data.");
+                        return;
+                    }
+                    trg_any->value.mem = malloc(len);
+                    LY_CHECK_ERR_RETURN(!trg_any->value.mem, LOGMEM(ctx), );
+                    memcpy(trg_any->value.mem, src_any->value.mem, len);
+                    break;
+                case LYD_ANYDATA_STRING:
+                case LYD_ANYDATA_SXMLD:
+                case LYD_ANYDATA_JSOND:
+                case LYD_ANYDATA_LYBD:
+                    /* dynamic strings are used only as input parameters */
+                    assert(0);
+                    break;
+                }
+            }
+        }
+    }
+}
+
+/* return: 0 (not equal), 1 (equal), -1 (error) */
+static int
+lyd_merge_node_schema_equal(struct lyd_node *node1, struct lyd_node *node2)
+{
+    struct lys_node *sch1;
+
+    if (node1->schema->module->ctx == node2->schema->module->ctx) {
+        if (node1->schema != node2->schema) {
+            return 0;
+        }
+    } else {
+        /* the nodes are in different contexts, get the appropriate schema nodes from the
+         * same context */
+        sch1 = lyd_get_schema_inctx(node1, node2->schema->module->ctx);
+        if (!sch1) {
+            LOGERR(node2->schema->module->ctx, LY_EINVAL, "Target context does not contain a required schema node (%s:%s).",
+                   lyd_node_module(node1)->name, node1->schema->name);
+            return -1;
+        } else if (sch1 != node2->schema) {
+            /* not matching nodes */
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/* return: 0 (not equal), 1 (equal), 2 (equal and state leaf-/list marked), -1 (error) */
+static int
+lyd_merge_node_equal(struct lyd_node *node1, struct lyd_node *node2)
+{
+    int ret;
+
+    switch (node1->schema->nodetype) {
+    case LYS_CONTAINER:
+    case LYS_LEAF:
+    case LYS_ANYXML:
+    case LYS_ANYDATA:
+    case LYS_RPC:
+    case LYS_ACTION:
+    case LYS_NOTIF:
+        return 1;
+    case LYS_LEAFLIST:
+        if (node1->validity & LYD_VAL_INUSE) {
+            /* this instance was already matched, we want to find another so that the number of the istances matches */
+            assert(node1->schema->flags & LYS_CONFIG_R);
+            return 0;
+        }
+
+        ret = lyd_list_equal(node1, node2, 1);
+        if ((ret == 1) && (node1->schema->flags & LYS_CONFIG_R)) {
+            /* mark it as matched */
+            node1->validity |= LYD_VAL_INUSE;
+            ret = 2;
+        }
+        return ret;
+    case LYS_LIST:
+        if (node1->validity & LYD_VAL_INUSE) {
+            /* this instance was already matched, we want to find another so that the number of the istances matches */
+            assert(!((struct lys_node_list *)node1->schema)->keys_size);
+            return 0;
+        }
+
+        ret = lyd_list_equal(node1, node2, 1);
+        if ((ret == 1) && !((struct lys_node_list *)node1->schema)->keys_size) {
+            /* mark it as matched */
+            node1->validity |= LYD_VAL_INUSE;
+            ret = 2;
+        }
+        return ret;
+    default:
+        break;
+    }
+
+    LOGINT(node2->schema->module->ctx);
+    return -1;
+}
+
+/* spends source */
+static int
+lyd_merge_parent_children(struct lyd_node *target, struct lyd_node *source, int options)
+{
+    struct lyd_node *trg_parent, *src, *src_backup, *src_elem, *src_elem_backup, *src_next, *trg_child, *trg_parent_backup;
+    int ret, clear_flag = 0;
+    struct ly_ctx *ctx = target->schema->module->ctx; /* shortcut */
+
+    LY_TREE_FOR_SAFE(source, src_backup, src) {
+        for (src_elem = src_next = src, trg_parent = target;
+            src_elem;
+            src_elem = src_next) {
+
+            /* it won't get inserted in this case */
+            if (src_elem->dflt && (options & LYD_OPT_EXPLICIT)) {
+                if (src_elem == src) {
+                    /* we are done with this subtree in this case */
+                    break;
+                }
+                trg_child = (struct lyd_node *)1;
+                goto src_skip;
+            }
+
+            ret = 0;
+
+#ifdef LY_ENABLED_CACHE
+            struct lyd_node **trg_child_p;
+
+            /* trees are supposed to be validated so all nodes must have their hash, but lets not be that strict */
+            if (!src_elem->hash) {
+                lyd_hash(src_elem);
+            }
+
+            if (trg_parent->ht) {
+                trg_child = NULL;
+                if (!lyht_find(trg_parent->ht, &src_elem, src_elem->hash, (void **)&trg_child_p)) {
+                    trg_child = *trg_child_p;
+                    ret = 1;
+
+                    /* it is a bit more difficult with keyless state lists and leaf-lists */
+                    if (((trg_child->schema->nodetype == LYS_LIST) && !((struct lys_node_list *)trg_child->schema)->keys_size)
+                            || ((trg_child->schema->nodetype == LYS_LEAFLIST) && (trg_child->schema->flags & LYS_CONFIG_R))) {
+                        assert(trg_child->schema->flags & LYS_CONFIG_R);
+
+                        while (trg_child && (trg_child->validity & LYD_VAL_INUSE)) {
+                            /* state lists, find one not-already-found */
+                            if (lyht_find_next(trg_parent->ht, &trg_child, trg_child->hash, (void **)&trg_child_p)) {
+                                trg_child = NULL;
+                            } else {
+                                trg_child = *trg_child_p;
+                            }
+                        }
+                        if (trg_child) {
+                            /* mark it as matched */
+                            trg_child->validity |= LYD_VAL_INUSE;
+                            ret = 2;
+                        } else {
+                            /* actually, it was matched already and no other instance found, so now not a match */
+                            ret = 0;
+                        }
+                    }
+                }
+            } else
+#endif
+            {
+                LY_TREE_FOR(trg_parent->child, trg_child) {
+                    /* schema match, data match? */
+                    ret = lyd_merge_node_schema_equal(trg_child, src_elem);
+                    if (ret == 1) {
+                        ret = lyd_merge_node_equal(trg_child, src_elem);
+                    }
+                    if (ret != 0) {
+                        /* even data match */
+                        break;
+                    }
+                }
+            }
+
+            if (ret > 0) {
+                if (trg_child->schema->nodetype & (LYS_LEAF | LYS_ANYDATA)) {
+                    lyd_merge_node_update(trg_child, src_elem);
+                } else if (ret == 2) {
+                    clear_flag = 1;
+                }
+            } else if (ret == -1) {
+                /* error */
+                lyd_free_withsiblings(source);
+                return 1;
+            }
+
+            /* first prepare for the next iteration */
+            src_elem_backup = src_elem;
+            trg_parent_backup = trg_parent;
+            if (((src_elem->schema->nodetype == LYS_CONTAINER) || ((src_elem->schema->nodetype == LYS_LIST)
+                    && ((struct lys_node_list *)src_elem->schema)->keys_size)) && src_elem->child && trg_child) {
+                /* go into children */
+                src_next = src_elem->child;
+                trg_parent = trg_child;
+            } else {
+src_skip:
+                /* no children (or the whole subtree will be inserted), try siblings */
+                if (src_elem == src) {
+                    /* we are done with this subtree */
+                    if (trg_child) {
+                        /* it's an empty container, list without keys, or an already-updated leaf/anydata, nothing else to do */
+                        break;
+                    } else {
+                        /* ... but we still need to insert it */
+                        src_next = NULL;
+                        goto src_insert;
+                    }
+                } else {
+                    src_next = src_elem->next;
+                    /* trg_parent does not change */
+                }
+            }
+            while (!src_next) {
+                src_elem = src_elem->parent;
+                if (src_elem->parent == src->parent) {
+                    /* we are done, no next element to process */
+                    break;
+                }
+
+                /* parent is already processed, go to its sibling */
+                src_next = src_elem->next;
+                trg_parent = trg_parent->parent;
+            }
+
+            if (!trg_child) {
+src_insert:
+                /* we need to insert the whole subtree */
+                if (ctx == src_elem_backup->schema->module->ctx) {
+                    /* same context - unlink the subtree and insert it into the target */
+                    lyd_unlink(src_elem_backup);
+                } else {
+                    /* different contexts - before inserting subtree, instead of unlinking, duplicate it into the
+                     * target context */
+                    src_elem_backup = lyd_dup_to_ctx(src_elem_backup, 1, ctx);
+                }
+
+                if (src_elem == source) {
+                    /* it will be linked into another data tree and the pointers changed */
+                    source = source->next;
+                }
+
+                /* insert subtree into the target */
+                if (lyd_insert(trg_parent_backup, src_elem_backup)) {
+                    LOGINT(ctx);
+                    lyd_free_withsiblings(source);
+                    return 1;
+                }
+                if (src_elem == src) {
+                    /* we are finished for this src */
+                    break;
+                }
+            }
+        }
+    }
+
+    lyd_free_withsiblings(source);
+    if (clear_flag) {
+        return 2;
+    }
+    return 0;
+}
+
+/* state of lyd_merge_bulk() shared by the merges */
+struct lyd_merge_bulk {
+    struct hash_table *top_ht;  /* target top-level siblings, NULL if not used */
+    int clear_flag;             /* some target nodes are marked LYD_VAL_INUSE */
+};
+
+#ifdef LY_ENABLED_CACHE
+
+/* whether a top-level sibling can be found by its hash */
+static int
+lyd_merge_hashed(struct lyd_node *node)
+{
+    if (!node->hash) {
+        return 0;
+    }
+
+    switch (node->schema->nodetype) {
+    case LYS_CONTAINER:
+    case LYS_LEAF:
+    case LYS_ANYXML:
+    case LYS_ANYDATA:
+        return 1;
+    case LYS_LIST:
+        return ((struct lys_node_list *)node->schema)->keys_size && lyd_list_has_keys(node);
+    case LYS_LEAFLIST:
+        return (node->schema->flags & LYS_CONFIG_W) ? 1 : 0;
+    default:
+        break;
+    }
+
+    return 0;
+}
+
+/* hash table of the top-level siblings, they are not in any parent hash table */
+static int
+lyd_merge_siblings_ht(struct lyd_node *target, struct hash_table **ht)
+{
+    struct lyd_node *iter;
+    uint32_t count = 0;
+
+    LY_TREE_FOR(target, iter) {
+        if (!iter->hash) {
+            lyd_hash(iter);
+        }
+        ++count;
+    }
+
+    *ht = lyht_new(1, sizeof(struct lyd_node *), lyd_hash_table_val_equal, NULL, 1);
+    LY_CHECK_ERR_RETURN(!*ht || lyht_reserve(*ht, count), LOGMEM(target->schema->module->ctx), -1);
+
+    LY_TREE_FOR(target, iter) {
+        if (lyd_merge_hashed(iter) && lyht_insert(*ht, &iter, iter->hash, NULL)) {
+            /* duplicate instance, keep the first one */
+            continue;
+        }
+    }
+
+    return 0;
+}
+
+#endif
+
+/* spends source */
+static int
+lyd_merge_siblings(struct lyd_node *target, struct lyd_node *source, int options, struct hash_table *top_ht)
+{
+    struct lyd_node *trg, *src, *src_backup, *ins;
+    int ret, clear_flag = 0;
+    struct ly_ctx *ctx = target->schema->module->ctx; /* shortcut */
+#ifdef LY_ENABLED_CACHE
+    struct lyd_node **trg_p;
+#else
+    (void)top_ht;
+#endif
+
+    while (target->prev->next) {
+        target = target->prev;
+    }
+
+    LY_TREE_FOR_SAFE(source, src_backup, src) {
+        trg = NULL;
+        ret = 0;
+#ifdef LY_ENABLED_CACHE
+        if (top_ht && (ctx == src->schema->module->ctx) && lyd_merge_hashed(src)) {
+            /* sibling found in the hash table, lyd_merge_node_equal() would not mark it anyway */
+            if (!lyht_find(top_ht, &src, src->hash, (void **)&trg_p)) {
+                trg = *trg_p;
+                ret = 1;
+            }
+        } else
+#endif
+        {
+            LY_TREE_FOR(target, trg) {
+                ret = lyd_merge_node_schema_equal(trg, src);
+                if (ret == 1) {
+                    ret = lyd_merge_node_equal(trg, src);
+                }
+                if (ret) {
+                    break;
+                } /* else not equal, nothing to do */
+            }
+        }
+
+        if (ret == -1) {
+            lyd_free_withsiblings(source);
+            return 1;
+        } else if (trg) {
+            /* sibling found, merge it */
+            if (ret == 2) {
+                clear_flag = 1;
+            }
+
+            switch (trg->schema->nodetype) {
+            case LYS_LEAF:
+            case LYS_ANYXML:
+            case LYS_ANYDATA:
+                lyd_merge_node_update(trg, src);
+                break;
+            case LYS_LEAFLIST:
+                /* it's already there, nothing to do */
+                break;
+            case LYS_LIST:
+            case LYS_CONTAINER:
+            case LYS_NOTIF:
+            case LYS_RPC:
+            case LYS_INPUT:
+            case LYS_OUTPUT:
+                ret = lyd_merge_parent_children(trg, src->child, options);
+                if (ret == 2) {
+                    clear_flag = 1;
+                } else if (ret) {
+                    lyd_free_withsiblings(source);
+                    return 1;
+                }
+                break;
+            default:
+                LOGINT(ctx);
+                lyd_free_withsiblings(source);
+                return 1;
+            }
+        } else {
+            /* sibling not found, insert it */
+            if (ctx != src->schema->module->ctx) {
+                ins = lyd_dup_to_ctx(src, 1, ctx);
+            } else {
+                lyd_unlink(src);
+                if (src == source) {
+                    /* just so source is not freed, we inserted it and need it further */
+                    source = src_backup;
+                }
+                ins = src;
+            }
+            lyd_insert_after(target->prev, ins);
+#ifdef LY_ENABLED_CACHE
+            if (top_ht && ins && lyd_merge_hashed(ins)) {
+                lyht_insert(top_ht, &ins, ins->hash, NULL);
+            }
+#endif
+        }
+    }
+
+    lyd_free_withsiblings(source);
+    if (clear_flag) {
+        return 2;
+    }
+    return 0;
+}
+
+static int
+lyd_merge_to_ctx_(struct lyd_node **trg, const struct lyd_node *src, int options, struct ly_ctx *ctx,
+                  struct lyd_merge_bulk *bulk)
+{
+    struct lyd_node *node = NULL, *node2, *target, *trg_merge_start, *src_merge_start = NULL;
+    const struct lyd_node *iter;
+    struct lys_node *src_snode, *sch = NULL;
+    int i, src_depth, depth, first_iter, ret, dflt = 1, spent = 0;
+    const struct lys_node *parent = NULL;
+
+    target = *trg;
+
+    parent = lys_parent(target->schema);
+
+    /* go up all uses */
+    while (parent && (parent->nodetype == LYS_USES)) {
+        parent = lys_parent(parent);
+    }
+
+    if (parent && !lyp_get_yang_data_template_name(target)) {
+        LOGERR(parent->module->ctx, LY_EINVAL, "Target not a top-level data tree.");
+        return -1;
+    }
+
+    /* get know if we are converting data into a different context */
+    if (ctx && target->schema->module->ctx != ctx) {
+        /* target's data tree context differs from the target context, move the target
+         * data tree into the target context */
+
+        /* get the first target's top-level and store it as the result */
+        for (; target->prev->next; target = target->prev);
+        *trg = target;
+
+        for (node = NULL, trg_merge_start = target; target; target = target->next) {
+            node2 = lyd_dup_to_ctx(target, 1, ctx);
+            if (!node2) {
+                goto error;
+            }
+            if (node) {
+                if (lyd_insert_after(node->prev, node2)) {
+                    goto error;
+                }
+            } else {
+                node = node2;
+            }
+        }
+        target = node;
+        node = NULL;
+    } else if (src->schema->module->ctx != target->schema->module->ctx) {
+        /* the source data will be converted into the target's context during the merge */
+        ctx = target->schema->module->ctx;
+    } else if (ctx == src->schema->module->ctx) {
+        /* no conversion is needed */
+        ctx = NULL;
+    }
+
+    /* find source top-level schema node */
+    for (src_snode = src->schema, src_depth = 0;
+         (src_snode = lys_parent(src_snode)) && src_snode->nodetype != LYS_EXT;
+         ++src_depth);
+
+    /* find first shared missing schema parent of the subtrees */
+    trg_merge_start = target;
+    depth = 0;
+    first_iter = 1;
+    if (src_depth) {
+        /* we are going to create missing parents in the following loop,
+         * but we will need to know a dflt flag for them. In case the newly
+         * created parent is going to have at least one non-default child,
+         * it will be also non-default, otherwise it will be the default node */
+        if (options & LYD_OPT_NOSIBLINGS) {
+            dflt = src->dflt;
+        } else {
+            LY_TREE_FOR(src, iter) {
+                if (!iter->dflt) {
+                    /* non default sibling -> parent is going to be
+                     * created also as non-default */
+                    dflt = 0;
+                    break;
+                }
+            }
+        }
+    }
+    while (1) {
+        /* going from down (source root) to up (top-level or the common node with target */
+        do {
+            for (src_snode = src->schema, i = 0; i < src_depth - depth; src_snode = lys_parent(src_snode), ++i);
+            ++depth;
+        } while (src_snode != src->schema && (src_snode->nodetype & (LYS_CHOICE | LYS_CASE | LYS_USES)));
+
+        if (src_snode == src->schema) {
+            break;
+        }
+
+        if (src_snode->nodetype != LYS_CONTAINER) {
+            /* we would have to create a list (the only data node with children except container), impossible */
+            LOGERR(ctx, LY_EINVAL, "Cannot create %s \"%s\" for the merge.", strnodetype(src_snode->nodetype), src_snode->name);
+            goto error;
+        }
+
+        /* have we created any missing containers already? if we did,
+         * it is totally useless to search for match, there won't ever be */
+        if (!src_merge_start) {
+            if (first_iter) {
+                node = trg_merge_start;
+                first_iter = 0;
+            } else {
+                node = trg_merge_start->child;
+            }
+
+            /* find it in target data nodes */
+            LY_TREE_FOR(node, node) {
+                if (ctx) {
+                    /* we have the schema nodes in the different context */
+                    sch = lys_get_schema_inctx(src_snode, ctx);
+                    if (!sch) {
+                        LOGERR(ctx, LY_EINVAL, "Target context does not contain schema node for the data node being "
+                               "merged (%s:%s).", lys_node_module(src_snode)->name, src_snode->name);
+                        goto error;
+                    }
+                } else {
+                    /* the context is same and comparison of the schema nodes will works fine */
+                    sch = src_snode;
+                }
+
+                if (node->schema == sch) {
+                    trg_merge_start = node;
+                    break;
+                }
+            }
+
+            if (!(options & LYD_OPT_DESTRUCT)) {
+                /* the source tree will be duplicated, so to save some work in case
+                 * of different target context, create also the parents nodes in the
+                 * correct context */
+                src_snode = sch;
+            }
+        } else if (ctx && !(options & LYD_OPT_DESTRUCT)) {
+            /* get the schema node in the correct (target) context, same as above,
+             * this is done to save some work and have the source in the same context
+             * when the provided source tree is below duplicated in the target context
+             * and connected into the parents created here */
+            src_snode = lys_get_schema_inctx(src_snode, ctx);
+            if (!src_snode) {
+                LOGERR(ctx, LY_EINVAL, "Target context does not contain schema node for the data node being "
+                       "merged (%s:%s).", lys_node_module(src_snode)->name, src_snode->name);
+                goto error;
+            }
+        }
+
+        if (!node) {
+            /* it is not there, create it */
+            node2 = _lyd_new(NULL, src_snode, dflt);
+            if (!src_merge_start) {
+                src_merge_start = node2;
+            } else {
+                if (lyd_insert(node2, src_merge_start)) {
+                    goto error;
+                }
+                src_merge_start = node2;
+            }
+        }
+    }
+
+    /* process source according to options */
+    if (options & LYD_OPT_DESTRUCT) {
+        spent = 1;
+        LY_TREE_FOR(src, iter) {
+            check_leaf_list_backlinks((struct lyd_node *)iter);
+            if (options & LYD_OPT_NOSIBLINGS) {
+                break;
+            }
+        }
+
+        node = (struct lyd_node *)src;
+        if ((node->prev != node) && (options & LYD_OPT_NOSIBLINGS)) {
+            node2 = node->prev;
+            lyd_unlink(node);
+            lyd_free_withsiblings(node2);
+        }
+    } else {
+        node = NULL;
+        for (; src; src = src->next) {
+            /* because we already have to duplicate it, do it in the correct context */
+            node2 = lyd_dup_to_ctx(src, 1, ctx);
+            if (!node2) {
+                lyd_free_withsiblings(node);
+                goto error;
+            }
+            if (node) {
+                if (lyd_insert_after(node->prev, node2)) {
+                    lyd_free_withsiblings(node);
+                    goto error;
+                }
+            } else {
+                node = node2;
+            }
+
+            if (options & LYD_OPT_NOSIBLINGS) {
+                break;
+            }
+        }
+    }
+
+    if (src_merge_start) {
+        /* insert data into the created parents */
+        /* first, get the lowest created parent, we don't have to check the nodetype since we are
+         * creating only a simple chain of containers */
+        for (node2 = src_merge_start; node2->child; node2 = node2->child);
+        node2->child = node;
+        LY_TREE_FOR(node, node) {
+            node->parent = node2;
+        }
+    } else {
+        src_merge_start = node;
+    }
+
+    if (!first_iter) {
+        /* !! src_merge start is a child(ren) of trg_merge_start */
+        ret = lyd_merge_parent_children(trg_merge_start, src_merge_start, options);
+    } else {
+        /* !! src_merge start is a (top-level) sibling(s) of trg_merge_start */
+        ret = lyd_merge_siblings(trg_merge_start, src_merge_start, options, bulk ? bulk->top_ht : NULL);
+    }
+    /* it was freed whatever the return value */
+    src_merge_start = NULL;
+    if ((ret == 2) && bulk) {
+        /* cleared once after all the merges */
+        bulk->clear_flag = 1;
+        ret = 0;
+    } else if (ret == 2) {
+        /* clear remporary LYD_VAL_INUSE validation flags */
+        LY_TREE_DFS_BEGIN(target, node2, node) {
+            node->validity &= ~LYD_VAL_INUSE;
+            LY_TREE_DFS_END(target, node2, node);
+        }
+        ret = 0;
+    } else if (ret) {
+        goto error;
+    }
+
+    if (target->schema->nodetype == LYS_RPC) {
+        lyd_schema_sort(target, 1);
+    }
+
+    /* update the pointer to the target tree if needed */
+    if (*trg != target) {
+        lyd_free_withsiblings(*trg);
+        (*trg) = target;
+    }
+    return ret;
+
+error:
+    if (*trg != target) {
+        /* target is duplication of the original target in different context,
+         * free it due to the error */
+        lyd_free_withsiblings(target);
+    }
+    lyd_free_withsiblings(src_merge_start);
+    if (bulk && !spent) {
+        /* lyd_merge_bulk() always spends the source */
+        lyd_free_withsiblings((struct lyd_node *)src);
+    }
+    return -1;
+}
+
+API int
+lyd_merge_to_ctx(struct lyd_node **trg, const struct lyd_node *src, int options, struct ly_ctx *ctx)
+{
+    FUN_IN;
+
+    struct ly_ctx *trg_ctx;
+    int ret;
+
+    if (!trg || !(*trg) || !src) {
+        LOGARG;
+        return -1;
+    }
+
+    /* the source schema nodes are mapped into the target context only once */
+    trg_ctx = (ctx ? ctx : (*trg)->schema->module->ctx);
+    lys_schema_map_start(trg_ctx);
+    ret = lyd_merge_to_ctx_(trg, src, options, ctx, NULL);
+    lys_schema_map_stop(trg_ctx);
+
+    return ret;
+}
+
+API int
+lyd_merge(struct lyd_node *target, const struct lyd_node *source, int options)
+{
+    FUN_IN;
+
+    if (!target || !source) {
+        LOGARG;
+        return -1;
+    }
+
+    return lyd_merge_to_ctx(&target, source, options, target->schema->module->ctx);
+}
+
+API int
+lyd_merge_bulk(struct lyd_node *target, struct lyd_node **sources, unsigned int count, int options)
+{
+    FUN_IN;
+
+    struct lyd_merge_bulk bulk = {NULL, 0};
+    struct ly_ctx *ctx;
+    unsigned int i;
+    int ret = 0;
+
+    if (!target || (count && !sources)) {
+        LOGARG;
+        return -1;
+    }
+    ctx = target->schema->module->ctx;
+    for (; target->prev->next; target = target->prev);
+
+#ifdef LY_ENABLED_CACHE
+    if (!target->parent && lyd_merge_siblings_ht(target, &bulk.top_ht)) {
+        lyht_free(bulk.top_ht);
+        return -1;
+    }
+#endif
+
+    lys_schema_map_start(ctx);
+    for (i = 0; i < count; ++i) {
+        if (!sources[i]) {
+            continue;
+        }
+        if (!ret && lyd_merge_to_ctx_(&target, sources[i], options | LYD_OPT_DESTRUCT, ctx, &bulk)) {
+            ret = -1;
+        } else if (ret) {
+            /* spend the rest of the sources after an error */
+            lyd_free_withsiblings(sources[i]);
+        }
+        sources[i] = NULL;
+    }
+    lys_schema_map_stop(ctx);
+
+    lyht_free(bulk.top_ht);
+    if (bulk.clear_flag) {
+        lyd_clear_inuse(target);
+    }
+    return ret;
+}
+
+/* edit-config operations, the values of the ietf-netconf operation attribute */
+#define LYD_EDIT_MERGE   0
+#define LYD_EDIT_REPLACE 1
+#define LYD_EDIT_CREATE  2
+#define LYD_EDIT_DELETE  3
+#define LYD_EDIT_REMOVE  4
+#define LYD_EDIT_NONE    5  /* only as the default operation */
+
+/* values of the insert attribute */
+#define LYD_EDIT_INS_FIRST  0
+#define LYD_EDIT_INS_LAST   1
+#define LYD_EDIT_INS_BEFORE 2
+#define LYD_EDIT_INS_AFTER  3
+
+struct lyd_edit {
+    struct ly_ctx *ctx;
+    struct lyd_node **root;     /* datastore top-level siblings */
+    struct hash_table *top_ht;  /* hash table of the top-level siblings, NULL if not used */
+    lyd_diff_clb clb;
+    void *clb_data;
+};
+
+static int lyd_edit_siblings(struct lyd_edit *ed, struct lyd_node *parent, struct lyd_node *edit, int parent_op,
+                             int mark, int quiet);
+
+/* get the edit attributes of a node, the values are left unchanged for the missing ones */
+static void
+lyd_edit_attrs(struct ly_ctx *ctx, struct lyd_node *node, int *op, int *insert, const char **anchor)
+{
+    struct lyd_attr *attr;
+
+    LY_TREE_FOR(node->attr, attr) {
+        if (!strcmp(attr->annotation->arg_value, "operation") && !strcmp(attr->annotation->module->name, "ietf-netconf")) {
+            *op = attr->value.enm->value;
+        } else if (attr->annotation->module == ctx->models.list[1]) { /* internal YANG schema */
+            if (!strcmp(attr->annotation->arg_value, "insert")) {
+                *insert = attr->value.enm->value;
+            } else if (!strcmp(attr->annotation->arg_value, "value") || !strcmp(attr->annotation->arg_value, "key")) {
+                *anchor = attr->value_str;
+            }
+        }
+    }
+}
+
+/* whether any descendant of an edit node has an operation or insert attribute */
+static int
+lyd_edit_nested(struct ly_ctx *ctx, struct lyd_node *node)
+{
+    struct lyd_node *next, *elem;
+    const char *anchor;
+    int op, insert;
+
+    LY_TREE_DFS_BEGIN(node, next, elem) {
+        if ((elem != node) && elem->attr) {
+            op = insert = -1;
+            lyd_edit_attrs(ctx, elem, &op, &insert, &anchor);
+            if ((op > -1) || (insert > -1)) {
+                return 1;
+            }
+        }
+        LY_TREE_DFS_END(node, next, elem);
+    }
+
+    return 0;
+}
+
+static int
+lyd_edit_report(struct lyd_edit *ed, LYD_DIFFTYPE type, struct lyd_node *first, struct lyd_node *second)
+{
+    if (ed->clb && ed->clb(type, first, second, ed->clb_data)) {
+        /* stopped */
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+/* find the datastore instance of an edit node */
+static struct lyd_node *
+lyd_edit_find(struct lyd_edit *ed, struct lyd_node *parent, struct lyd_node *node)
+{
+    struct lyd_node *iter;
+#ifdef LY_ENABLED_CACHE
+    struct hash_table *ht;
+    struct lyd_node **match_p;
+
+    if (!node->hash) {
+        lyd_hash(node);
+    }
+    ht = parent ? parent->ht : ed->top_ht;
+    if (ht && lyd_merge_hashed(node)) {
+        if (lyht_find(ht, &node, node->hash, (void **)&match_p)) {
+            return NULL;
+        }
+        return *match_p;
+    }
+#endif
+
+    LY_TREE_FOR(parent ? parent->child : *ed->root, iter) {
+        if ((iter->schema == node->schema)
+                && (!(iter->schema->nodetype & (LYS_LIST | LYS_LEAFLIST)) || (lyd_list_equal(iter, node, 0) == 1))) {
+            return iter;
+        }
+    }
+
+    return NULL;
+}
+
+/* find the instance referenced by the value or key attribute */
+static struct lyd_node *
+lyd_edit_anchor(struct lyd_edit *ed, struct lyd_node *parent, struct lyd_node *node, const char *anchor)
+{
+    struct lyd_node *iter = NULL;
+    struct ly_set *set;
+    char *path;
+
+    if (node->schema->nodetype == LYS_LEAFLIST) {
+        LY_TREE_FOR(parent ? parent->child : *ed->root, iter) {
+            if ((iter->schema == node->schema) && !strcmp(((struct lyd_node_leaf_list *)iter)->value_str, anchor)) {
+                break;
+            }
+        }
+        return iter;
+    }
+
+    if (asprintf(&path, "%s%s:%s%s", parent ? "" : "/", lyd_node_module(node)->name, node->schema->name, anchor) == -1) {
+        LOGMEM(ed->ctx);
+        return NULL;
+    }
+    set = lyd_find_path(parent ? parent : *ed->root, path);
+    free(path);
+    if (set && set->number) {
+        iter = set->set.d[0];
+    }
+    ly_set_free(set);
+
+    return iter;
+}
+
+/* link a new node into the datastore or move an existing one, according to the insert attribute */
+static int
+lyd_edit_insert(struct lyd_edit *ed, struct lyd_node *parent, struct lyd_node *node, struct lyd_node *edit,
+                int insert, const char *anchor, int existing)
+{
+    struct lyd_node *iter, *sibling = NULL;
+    int ret;
+
+    if (!(node->schema->flags & LYS_USERORDERED)) {
+        insert = -1;
+    }
+
+    switch (insert) {
+    case LYD_EDIT_INS_FIRST:
+        LY_TREE_FOR(parent ? parent->child : *ed->root, iter) {
+            if (iter->schema == node->schema) {
+                sibling = iter;
+                break;
+            }
+        }
+        if (sibling == node) {
+            return EXIT_SUCCESS;
+        } else if (sibling) {
+            ret = lyd_insert_before(sibling, node);
+            goto inserted;
+        }
+        break;
+    case LYD_EDIT_INS_BEFORE:
+    case LYD_EDIT_INS_AFTER:
+        sibling = lyd_edit_anchor(ed, parent, node, anchor);
+        if (!sibling) {
+            LOGVAL(ed->ctx, LYE_SPEC, LY_VLOG_LYD, edit, "Instance \"%s\" to insert next to does not exist.", anchor);
+            return EXIT_FAILURE;
+        } else if (sibling == node) {
+            LOGVAL(ed->ctx, LYE_SPEC, LY_VLOG_LYD, edit, "Instance cannot be inserted next to itself.");
+            return EXIT_FAILURE;
+        }
+        ret = (insert == LYD_EDIT_INS_BEFORE) ? lyd_insert_before(sibling, node) : lyd_insert_after(sibling, node);
+        goto inserted;
+    default:
+        if (existing) {
+            if (insert != LYD_EDIT_INS_LAST) {
+                return EXIT_SUCCESS;
+            }
+            LY_TREE_FOR(parent ? parent->child : *ed->root, iter) {
+                if (iter->schema == node->schema) {
+                    sibling = iter;
+                }
+            }
+            if (sibling == node) {
+                return EXIT_SUCCESS;
+            }
+            ret = lyd_insert_after(sibling, node);
+            goto inserted;
+        }
+        break;
+    }
+
+    /* append */
+    if (parent) {
+        ret = lyd_insert(parent, node);
+    } else if (!*ed->root) {
+        *ed->root = node;
+        ret = EXIT_SUCCESS;
+    } else {
+        ret = lyd_insert_sibling(ed->root, node);
+    }
+
+inserted:
+    if (!ret && !parent) {
+        /* the first top-level sibling could have changed */
+        for (; (*ed->root)->prev->next; *ed->root = (*ed->root)->prev);
+    }
+    return ret;
+}
+
+/* unlink and free a datastore node */
+static void
+lyd_edit_free(struct lyd_edit *ed, struct lyd_node *node)
+{
+    if (!node->parent) {
+#ifdef LY_ENABLED_CACHE
+        if (ed->top_ht && lyd_merge_hashed(node)) {
+            lyht_remove(ed->top_ht, &node, node->hash);
+        }
+#endif
+        if (*ed->root == node) {
+            *ed->root = node->next;
+        }
+    }
+    lyd_free(node);
+}
+
+/* the new node was linked to the top level */
+static void
+lyd_edit_top_add(struct lyd_edit *ed, struct lyd_node *node)
+{
+#ifdef LY_ENABLED_CACHE
+    if (!node->parent && ed->top_ht) {
+        if (!node->hash) {
+            lyd_hash(node);
+        }
+        if (lyd_merge_hashed(node)) {
+            lyht_insert(ed->top_ht, &node, node->hash, NULL);
+        }
+    }
+#else
+    (void)ed;
+    (void)node;
+#endif
+}
+
+static int
+lyd_edit_create(struct lyd_edit *ed, struct lyd_node *parent, struct lyd_node *edit, int op, int insert,
+                const char *anchor, int quiet, struct lyd_node **created)
+{
+    struct lyd_node *node;
+    int nested;
+
+    /* without any operations inside, the whole subtree is simply created */
+    nested = lyd_edit_nested(ed->ctx, edit);
+    node = lyd_dup(edit, LYD_DUP_OPT_NO_ATTR | (nested ? LYD_DUP_OPT_WITH_KEYS : LYD_DUP_OPT_RECURSIVE));
+    if (!node) {
+        return EXIT_FAILURE;
+    }
+    if (lyd_edit_insert(ed, parent, node, edit, insert, anchor, 0)) {
+        lyd_free(node);
+        return EXIT_FAILURE;
+    }
+    lyd_edit_top_add(ed, node);
+    *created = node;
+
+    /* the node is new with all its keys, so only merge the children into it, the created ones are not reported */
+    if (nested && lyd_edit_siblings(ed, node, edit->child, (op == LYD_EDIT_CREATE) ? LYD_EDIT_MERGE : op, 0, 1)) {
+        /* do not leave it half-created */
+        lyd_edit_free(ed, node);
+        *created = NULL;
+        return EXIT_FAILURE;
+    }
+
+    if (!quiet && lyd_edit_report(ed, LYD_DIFF_CREATED, parent, node)) {
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+/* delete the unmarked configuration children not present in the replacing edit, unmark the others */
+static int
+lyd_edit_sweep(struct lyd_edit *ed, struct lyd_node *parent, int quiet)
+{
+    struct lyd_node *iter, *next;
+
+    LY_TREE_FOR_SAFE(parent ? parent->child : *ed->root, next, iter) {
+        if (iter->validity & LYD_VAL_INUSE) {
+            iter->validity &= ~LYD_VAL_INUSE;
+        } else if (!iter->dflt && (iter->schema->flags & LYS_CONFIG_W)) {
+            if (!quiet && lyd_edit_report(ed, LYD_DIFF_DELETED, iter, NULL)) {
+                return EXIT_FAILURE;
+            }
+            lyd_edit_free(ed, iter);
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
+
+static int
+lyd_edit_update(struct lyd_edit *ed, struct lyd_node **match, struct lyd_node *edit, int op, int insert,
+                const char *anchor, int quiet)
+{
+    struct lyd_node *node = *match, *prev, *dup;
+
+    if ((insert > -1) && (node->schema->flags & LYS_USERORDERED)) {
+        /* move */
+        prev = node->prev;
+        if (lyd_edit_insert(ed, node->parent, node, edit, insert, anchor, 1)) {
+            return EXIT_FAILURE;
+        }
+        if (!quiet && (node->prev != prev) && lyd_edit_report(ed, LYD_DIFF_MOVEDAFTER1, node,
+                (node->prev->next && (node->prev->schema == node->schema)) ? node->prev : NULL)) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    switch (node->schema->nodetype) {
+    case LYS_LEAF:
+        if (op == LYD_EDIT_NONE) {
+            break;
+        }
+        /* the values are in the same dictionary */
+        if (((struct lyd_node_leaf_list *)node)->value_str != ((struct lyd_node_leaf_list *)edit)->value_str) {
+            if (!quiet && lyd_edit_report(ed, LYD_DIFF_CHANGED, node, edit)) {
+                return EXIT_FAILURE;
+            }
+        } else if (!node->dflt) {
+            break;
+        }
+        if (lyd_change_leaf((struct lyd_node_leaf_list *)node, ((struct lyd_node_leaf_list *)edit)->value_str) == -1) {
+            return EXIT_FAILURE;
+        }
+        break;
+    case LYS_ANYXML:
+    case LYS_ANYDATA:
+        if ((op == LYD_EDIT_NONE) || lyd_anydata_equal(node, edit)) {
+            break;
+        }
+        if (!quiet && lyd_edit_report(ed, LYD_DIFF_CHANGED, node, edit)) {
+            return EXIT_FAILURE;
+        }
+
+        /* replace the node with the new value */
+        dup = lyd_dup(edit, LYD_DUP_OPT_NO_ATTR);
+        if (!dup || lyd_insert_after(node, dup)) {
+            lyd_free(dup);
+            return EXIT_FAILURE;
+        }
+        lyd_edit_free(ed, node);
+        lyd_edit_top_add(ed, dup);
+        *match = dup;
+        break;
+    case LYS_CONTAINER:
+    case LYS_LIST:
+        if (lyd_edit_siblings(ed, node, edit->child, op, op == LYD_EDIT_REPLACE, quiet)) {
+            return EXIT_FAILURE;
+        }
+        if ((op == LYD_EDIT_REPLACE) && lyd_edit_sweep(ed, node, quiet)) {
+            return EXIT_FAILURE;
+        }
+        break;
+    default:
+        /* leaf-list instance is already there */
+        break;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+/* apply the edit siblings to the datastore children of parent (top-level if NULL), mark the matching ones */
+static int
+lyd_edit_siblings(struct lyd_edit *ed, struct lyd_node *parent, struct lyd_node *edit, int parent_op, int mark, int quiet)
+{
+    struct lyd_node *match;
+    const char *anchor;
+    int op, insert;
+
+    LY_TREE_FOR(edit, edit) {
+        op = parent_op;
+        insert = -1;
+        anchor = NULL;
+        lyd_edit_attrs(ed->ctx, edit, &op, &insert, &anchor);
+        match = lyd_edit_find(ed, parent, edit);
+
+        switch (op) {
+        case LYD_EDIT_CREATE:
+            if (match) {
+                LOGVAL(ed->ctx, LYE_SPEC, LY_VLOG_LYD, edit, "Data to create already exist.");
+                return EXIT_FAILURE;
+            }
+            if (lyd_edit_create(ed, parent, edit, op, insert, anchor, quiet, &match)) {
+                return EXIT_FAILURE;
+            }
+            break;
+        case LYD_EDIT_DELETE:
+            if (!match) {
+                LOGVAL(ed->ctx, LYE_SPEC, LY_VLOG_LYD, edit, "Data to delete do not exist.");
+                return EXIT_FAILURE;
+            }
+            /* fallthrough */
+        case LYD_EDIT_REMOVE:
+            if (match) {
+                if (!quiet && lyd_edit_report(ed, LYD_DIFF_DELETED, match, NULL)) {
+                    return EXIT_FAILURE;
+                }
+                lyd_edit_free(ed, match);
+                match = NULL;
+            }
+            break;
+        case LYD_EDIT_NONE:
+            if (!match) {
+                /* create only the parents of the nested operations */
+                if (lyd_edit_nested(ed->ctx, edit) && lyd_edit_create(ed, parent, edit, op, insert, anchor, quiet, &match)) {
+                    return EXIT_FAILURE;
+                }
+                break;
+            }
+            /* fallthrough */
+        default:
+            if (!match) {
+                if (lyd_edit_create(ed, parent, edit, op, insert, anchor, quiet, &match)) {
+                    return EXIT_FAILURE;
+                }
+            } else if (lyd_edit_update(ed, &match, edit, op, insert, anchor, quiet)) {
+                return EXIT_FAILURE;
+            }
+            break;
+        }
+
+        if (mark && match) {
+            match->validity |= LYD_VAL_INUSE;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
+
+API int
+lyd_edit_apply(struct lyd_node **root, struct lyd_node *edit, int options, lyd_diff_clb clb, void *user_data)
+{
+    FUN_IN;
+
+    struct lyd_edit ed = {NULL, root, NULL, clb, user_data};
+    int op, ret;
+
+    if (!root || !edit || edit->parent) {
+        LOGARG;
+        return EXIT_FAILURE;
+    }
+    ed.ctx = edit->schema->module->ctx;
+    if (*root && ((*root)->schema->module->ctx != ed.ctx)) {
+        LOGERR(ed.ctx, LY_EINVAL, "%s: the edit and the data tree are from different contexts.", __func__);
+        return EXIT_FAILURE;
+    }
+
+    for (; edit->prev->next; edit = edit->prev);
+    if (*root) {
+        for (; (*root)->prev->next; *root = (*root)->prev);
+#ifdef LY_ENABLED_CACHE
+        if (lyd_merge_siblings_ht(*root, &ed.top_ht)) {
+            lyht_free(ed.top_ht);
+            return EXIT_FAILURE;
+        }
+#endif
+    }
+
+    if (options & LYD_EDITOPT_REPLACE) {
+        op = LYD_EDIT_REPLACE;
+    } else if (options & LYD_EDITOPT_NONE) {
+        op = LYD_EDIT_NONE;
+    } else {
+        op = LYD_EDIT_MERGE;
+    }
+
+    ret = lyd_edit_siblings(&ed, NULL, edit, op, op == LYD_EDIT_REPLACE, 0);
+    if (!ret && (op == LYD_EDIT_REPLACE)) {
+        /* the whole configuration is replaced */
+        ret = lyd_edit_sweep(&ed, NULL, 0);
+    }
+
+    lyht_free(ed.top_ht);
+    if (ret && *root) {
+        /* do not leave any nodes marked */
+        lyd_clear_inuse(*root);
+    }
+    return ret;
+}
+
+/* journal record types, each followed by the record length (4 B, little-endian) and the LYB data
+ * of the record node with all its parents */
+#define LYD_JOURNAL_CREATE 'c'     /* created subtree */
+#define LYD_JOURNAL_DELETE 'd'     /* deleted node with its keys */
+#define LYD_JOURNAL_REPLACE 'r'    /* changed leaf or anydata with its new value */
+#define LYD_JOURNAL_MOVE 'm'       /* moved user-ordered instance followed by its new preceding instance */
+#define LYD_JOURNAL_MOVE_FIRST 'f' /* user-ordered instance moved to be the first one */
+
+#define LYD_JOURNAL_HDR_LEN 5
+
+/* print a node with all its parents as LYB data */
+static int
+lyd_journal_print_node(const struct lyd_node *node, int dup_options, char **lyb, int *lyb_len)
+{
+    struct lyd_node *dup;
+    int ret;
+
+    dup = lyd_dup(node, dup_options | LYD_DUP_OPT_WITH_PARENTS);
+    if (!dup) {
+        return EXIT_FAILURE;
+    }
+    for (; dup->parent; dup = dup->parent);
+
+    ret = lyd_print_mem(lyb, dup, LYD_LYB, 0);
+    lyd_free(dup);
+    if (ret) {
+        return EXIT_FAILURE;
+    }
+
+    *lyb_len = lyd_lyb_data_length(*lyb);
+    if (*lyb_len < 1) {
+        free(*lyb);
+        *lyb = NULL;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+static int
+lyd_journal_add(char **journal, size_t *len, char type, const struct lyd_node *node, const struct lyd_node *anchor,
+                int dup_options)
+{
+    char *lyb[2] = {NULL, NULL}, *rec;
+    int lyb_len[2] = {0, 0}, i, ret = EXIT_FAILURE;
+    uint32_t rec_len;
+
+    if (lyd_journal_print_node(node, dup_options, &lyb[0], &lyb_len[0])
+            || (anchor && lyd_journal_print_node(anchor, dup_options, &lyb[1], &lyb_len[1]))) {
+        goto cleanup;
+    }
+    rec_len = lyb_len[0] + lyb_len[1];
+
+    *journal = ly_realloc(*journal, *len + LYD_JOURNAL_HDR_LEN + rec_len);
+    LY_CHECK_ERR_GOTO(!*journal, LOGMEM(node->schema->module->ctx), cleanup);
+    rec = *journal + *len;
+
+    rec[0] = type;
+    for (i = 0; i < 4; ++i) {
+        rec[1 + i] = (rec_len >> (8 * i)) & 0xff;
+    }
+    memcpy(rec + LYD_JOURNAL_HDR_LEN, lyb[0], lyb_len[0]);
+    if (anchor) {
+        memcpy(rec + LYD_JOURNAL_HDR_LEN + lyb_len[0], lyb[1], lyb_len[1]);
+    }
+    *len += LYD_JOURNAL_HDR_LEN + rec_len;
+
+    ret = EXIT_SUCCESS;
+
+cleanup:
+    free(lyb[0]);
+    free(lyb[1]);
+    return ret;
+}
+
+API int
+lyd_journal_print_mem(char **strp, size_t *len, const struct lyd_difflist *diff)
+{
+    FUN_IN;
+
+    unsigned int i;
+    int ret = EXIT_SUCCESS;
+
+    if (!strp || !len || !diff) {
+        LOGARG;
+        return EXIT_FAILURE;
+    }
+
+    *strp = NULL;
+    *len = 0;
+    for (i = 0; !ret && (diff->type[i] != LYD_DIFF_END); ++i) {
+        switch (diff->type[i]) {
+        case LYD_DIFF_DELETED:
+            ret = lyd_journal_add(strp, len, LYD_JOURNAL_DELETE, diff->first[i], NULL,
+                                  LYD_DUP_OPT_WITH_KEYS | LYD_DUP_OPT_NO_ATTR);
+            break;
+        case LYD_DIFF_CHANGED:
+            ret = lyd_journal_add(strp, len, LYD_JOURNAL_REPLACE, diff->second[i], NULL, LYD_DUP_OPT_NO_ATTR);
+            break;
+        case LYD_DIFF_CREATED:
+            ret = lyd_journal_add(strp, len, LYD_JOURNAL_CREATE, diff->second[i], NULL, LYD_DUP_OPT_RECURSIVE);
+            break;
+        case LYD_DIFF_MOVEDAFTER1:
+            /* the first node is moved after the second one */
+            ret = lyd_journal_add(strp, len, diff->second[i] ? LYD_JOURNAL_MOVE : LYD_JOURNAL_MOVE_FIRST,
+                                  diff->first[i], diff->second[i], LYD_DUP_OPT_WITH_KEYS | LYD_DUP_OPT_NO_ATTR);
+            break;
+        case LYD_DIFF_MOVEDAFTER2:
+            /* the second node is moved after the first one */
+            ret = lyd_journal_add(strp, len, diff->first[i] ? LYD_JOURNAL_MOVE : LYD_JOURNAL_MOVE_FIRST,
+                                  diff->second[i], diff->first[i], LYD_DUP_OPT_WITH_KEYS | LYD_DUP_OPT_NO_ATTR);
+            break;
+        default:
+            LOGINT(NULL);
+            ret = EXIT_FAILURE;
+            break;
+        }
+    }
+
+    if (ret) {
+        free(*strp);
+        *strp = NULL;
+        *len = 0;
+    }
+    return ret;
+}
+
+API int
+lyd_journal_print_fd(int fd, const struct lyd_difflist *diff)
+{
+    FUN_IN;
+
+    char *journal;
+    size_t len, written;
+    ssize_t r;
+
+    if ((fd < 0) || !diff) {
+        LOGARG;
+        return EXIT_FAILURE;
+    }
+
+    if (lyd_journal_print_mem(&journal, &len, diff)) {
+        return EXIT_FAILURE;
+    }
+
+    /* a single write for all the records if possible so that they are appended at once */
+    for (written = 0; written < len; written += r) {
+        r = write(fd, journal + written, len - written);
+        if (r < 0) {
+            if (errno == EINTR) {
+                r = 0;
+                continue;
+            }
+            LOGERR(diff->first[0] ? diff->first[0]->schema->module->ctx : diff->second[0]->schema->module->ctx,
+                   LY_ESYS, "Writing the journal failed (%s).", strerror(errno));
+            free(journal);
+            return EXIT_FAILURE;
+        }
+    }
+
+    free(journal);
+    return EXIT_SUCCESS;
+}
+
+/* find the data tree instance of a record node */
+static struct lyd_node *
+lyd_journal_match(struct lyd_node *parent, struct lyd_node *first, struct lyd_node *node)
+{
+    struct lyd_node *iter;
+#ifdef LY_ENABLED_CACHE
+    struct lyd_node **match_p;
+
+    if (!node->hash) {
+        lyd_hash(node);
+    }
+    if (parent && parent->ht && lyd_merge_hashed(node)) {
+        if (lyht_find(parent->ht, &node, node->hash, (void **)&match_p)) {
+            return NULL;
+        }
+        return *match_p;
+    }
+#else
+    (void)parent;
+#endif
+
+    LY_TREE_FOR(first, iter) {
+        if ((iter->schema == node->schema)
+                && (!(iter->schema->nodetype & (LYS_LIST | LYS_LEAFLIST)) || (lyd_list_equal(iter, node, 0) == 1))) {
+            return iter;
+        }
+    }
+
+    return NULL;
+}
+
+/* find the data tree instance of the deepest record node, following the record parents */
+static struct lyd_node *
+lyd_journal_find(struct lyd_node *root, struct lyd_node *rec)
+{
+    struct lyd_node *parent = NULL, *match, *iter;
+
+    while (1) {
+        match = lyd_journal_match(parent, parent ? parent->child : root, rec);
+        if (!match || !(rec->schema->nodetype & (LYS_CONTAINER | LYS_LIST))) {
+            return match;
+        }
+
+        /* the next record node is the only child that is not a key */
+        LY_TREE_FOR(rec->child, iter) {
+            if ((iter->schema->nodetype != LYS_LEAF) || !lys_is_key((struct lys_node_leaf *)iter->schema, NULL)) {
+                break;
+            }
+        }
+        if (!iter) {
+            return match;
+        }
+
+        parent = match;
+        rec = iter;
+    }
+}
+
+static int
+lyd_journal_apply_record(struct ly_ctx *ctx, struct lyd_node **root, char type, struct lyd_node **rec,
+                         unsigned int idx)
+{
+    struct lyd_node *node, *anchor = NULL, *iter;
+
+    switch (type) {
+    case LYD_JOURNAL_CREATE:
+    case LYD_JOURNAL_REPLACE:
+        if (!*root) {
+            *root = rec[0];
+        } else if (lyd_merge(*root, rec[0], LYD_OPT_DESTRUCT)) {
+            return EXIT_FAILURE;
+        }
+        /* spent */
+        rec[0] = NULL;
+        break;
+    case LYD_JOURNAL_DELETE:
+        node = lyd_journal_find(*root, rec[0]);
+        if (!node) {
+            LOGERR(ctx, LY_EINVAL, "Journal record %u: the node to delete does not exist.", idx);
+            return EXIT_FAILURE;
+        }
+        if (node == *root) {
+            *root = (*root)->next;
+        }
+        lyd_free(node);
+        break;
+    case LYD_JOURNAL_MOVE:
+    case LYD_JOURNAL_MOVE_FIRST:
+        node = lyd_journal_find(*root, rec[0]);
+        if (rec[1]) {
+            anchor = lyd_journal_find(*root, rec[1]);
+        }
+        if (!node || (rec[1] && !anchor)) {
+            LOGERR(ctx, LY_EINVAL, "Journal record %u: the instance to move does not exist.", idx);
+            return EXIT_FAILURE;
+        }
+
+        if (anchor) {
+            if ((anchor != node) && lyd_insert_after(anchor, node)) {
+                return EXIT_FAILURE;
+            }
+        } else {
+            /* move before the first instance */
+            LY_TREE_FOR(node->parent ? node->parent->child : *root, iter) {
+                if (iter->schema == node->schema) {
+                    break;
+                }
+            }
+            if ((iter != node) && lyd_insert_before(iter, node)) {
+                return EXIT_FAILURE;
+            }
+        }
+        break;
+    default:
+        LOGERR(ctx, LY_EINVAL, "Journal record %u: unknown record type.", idx);
+        return EXIT_FAILURE;
+    }
+
+    if (*root) {
+        for (; (*root)->prev->next; *root = (*root)->prev);
+    }
+    return EXIT_SUCCESS;
+}
+
+API int
+lyd_journal_apply(struct ly_ctx *ctx, struct lyd_node **root, const char *data, size_t len)
+{
+    FUN_IN;
+
+    struct lyd_node *rec[2];
+    unsigned int idx;
+    uint32_t rec_len;
+    int i, lyb_len, ret = EXIT_SUCCESS;
+    char type;
+
+    if (!ctx || !root || (len && !data)) {
+        LOGARG;
+        return EXIT_FAILURE;
+    }
+    if (*root && ((*root)->schema->module->ctx != ctx)) {
+        LOGERR(ctx, LY_EINVAL, "%s: the data tree is from a different context.", __func__);
+        return EXIT_FAILURE;
+    }
+
+    if (*root) {
+        for (; (*root)->prev->next; *root = (*root)->prev);
+    }
+
+    for (idx = 0; !ret && len; ++idx) {
+        if (len < LYD_JOURNAL_HDR_LEN) {
+            LOGERR(ctx, LY_EINVAL, "Journal record %u is truncated.", idx);
+            return EXIT_FAILURE;
+        }
+        type = data[0];
+        rec_len = 0;
+        for (i = 0; i < 4; ++i) {
+            rec_len |= (uint32_t)(uint8_t)data[1 + i] << (8 * i);
+        }
+        data += LYD_JOURNAL_HDR_LEN;
+        len -= LYD_JOURNAL_HDR_LEN;
+        if (len < rec_len) {
+            LOGERR(ctx, LY_EINVAL, "Journal record %u is truncated.", idx);
+            return EXIT_FAILURE;
+        }
+
+        /* parse the record nodes */
+        rec[0] = rec[1] = NULL;
+        lyb_len = lyd_lyb_data_length(data);
+        if ((lyb_len < 1) || ((uint32_t)lyb_len > rec_len) || (((uint32_t)lyb_len < rec_len) != (type == LYD_JOURNAL_MOVE))) {
+            LOGERR(ctx, LY_EINVAL, "Journal record %u is invalid.", idx);
+            return EXIT_FAILURE;
+        }
+        rec[0] = lyd_parse_mem(ctx, data, LYD_LYB, LYD_OPT_EDIT | LYD_OPT_STRICT);
+        if (rec[0] && (type == LYD_JOURNAL_MOVE)) {
+            rec[1] = lyd_parse_mem(ctx, data + lyb_len, LYD_LYB, LYD_OPT_EDIT | LYD_OPT_STRICT);
+        }
+
+        if (!rec[0] || ((type == LYD_JOURNAL_MOVE) && !rec[1])) {
+            ret = EXIT_FAILURE;
+        } else {
+            ret = lyd_journal_apply_record(ctx, root, type, rec, idx);
+        }
+        lyd_free(rec[0]);
+        lyd_free(rec[1]);
+
+        data += rec_len;
+        len -= rec_len;
+    }
+
+    return ret;
+}
+
+API int
+lyd_journal_compact(struct ly_ctx *ctx, const char *snapshot, int options, const char *journal, size_t len, int fd)
+{
+    FUN_IN;
+
+    struct lyd_node *root = NULL;
+    int ret;
+
+    if (!ctx || (fd < 0)) {
+        LOGARG;
+        return EXIT_FAILURE;
+    }
+
+    if (snapshot) {
+        ly_errno = LY_SUCCESS;
+        root = lyd_parse_mem(ctx, snapshot, LYD_LYB, options);
+        if (!root && ly_errno) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    ret = lyd_journal_apply(ctx, &root, journal, len);
+    if (!ret) {
+        ret = lyd_print_fd(fd, root, LYD_LYB, LYP_WITHSIBLINGS);
+    }
+
+    lyd_free_withsiblings(root);
+    return ret;
+}
+
+API void
+lyd_free_diff(struct lyd_difflist *diff)
+{
+    FUN_IN;
+
+    if (diff) {
+        free(diff->type);
+        free(diff->first);
+        free(diff->second);
+        free(diff);
+    }
+}
+
+static int
+lyd_difflist_add(struct lyd_difflist *diff, unsigned int *size, unsigned int index,
+                 LYD_DIFFTYPE type, struct lyd_node *first, struct lyd_node *second)
+{
+    void *new;
+    struct ly_ctx *ctx;
+
+    assert(diff);
+    assert(size && *size);
+    assert(first || second);
+
+    ctx = (first ? first->schema->module->ctx : (second ? second->schema->module->ctx : NULL));
+
+    if (index + 1 == *size) {
+        /* it's time to enlarge */
+        *size = *size + 16;
+        new = realloc(diff->type, *size * sizeof *diff->type);
+        LY_CHECK_ERR_RETURN(!new, LOGMEM(ctx), EXIT_FAILURE);
+        diff->type = new;
+
+        new = realloc(diff->first, *size * sizeof *diff->first);
+        LY_CHECK_ERR_RETURN(!new, LOGMEM(ctx), EXIT_FAILURE);
+        diff->first = new;
+
+        new = realloc(diff->second, *size * sizeof *diff->second);
+        LY_CHECK_ERR_RETURN(!new, LOGMEM(ctx), EXIT_FAILURE);
+        diff->second = new;
+    }
+
+    /* insert the item */
+    diff->type[index] = type;
+    diff->first[index] = first;
+    diff->second[index] = second;
+
+    /* terminate the arrays */
+    index++;
+    diff->type[index] = LYD_DIFF_END;
+    diff->first[index] = NULL;
+    diff->second[index] = NULL;
+
+    return EXIT_SUCCESS;
+}
+
+/* where lyd_diff() reports the differences to */
+struct lyd_diff_out {
+    struct lyd_difflist *diff;       /* collected differences, unless passed to clb */
+    unsigned int size;               /* allocated size of diff */
+    unsigned int index;              /* index of the next difference in diff */
+    lyd_diff_clb clb;                /* callback getting the differences instead */
+    void *clb_data;
+    int stop;                        /* clb asked to stop */
+};
+
+static int
+lyd_diff_out_add(struct lyd_diff_out *out, LYD_DIFFTYPE type, struct lyd_node *first, struct lyd_node *second)
+{
+    if (out->clb) {
+        if (out->clb(type, first, second, out->clb_data)) {
+            out->stop = 1;
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+
+    return lyd_difflist_add(out->diff, &out->size, out->index++, type, first, second);
+}
+
+struct diff_ordered_item {
+    struct lyd_node *first;
+    struct lyd_node *second;
+    unsigned int pos;                /* position of first among the matched instances in the first tree */
+    unsigned int next;               /* following item of the kept subsequence, see lyd_diff_move() */
+    int keep;                        /* the item is in the correct order and is not moved */
+};
+struct diff_ordered {
+    struct lys_node *schema;
+    struct lyd_node *parent;
+    unsigned int count;
+    struct diff_ordered_item *items; /* array in the second tree order */
+};
+
+static int
+diff_ordset_insert(struct lyd_node *node, struct ly_set *ordset)
+{
+    unsigned int i;
+    struct diff_ordered *new_ordered, *iter;
+
+    for (i = 0; i < ordset->number; i++) {
+        iter = (struct diff_ordered *)ordset->set.g[i];
+        if (iter->schema == node->schema && iter->parent == node->parent) {
+            break;
+        }
+    }
+    if (i == ordset->number) {
+        /* not seen user-ordered list */
+        new_ordered = calloc(1, sizeof *new_ordered);
+        LY_CHECK_ERR_RETURN(!new_ordered, LOGMEM(node->schema->module->ctx), EXIT_FAILURE);
+        new_ordered->schema = node->schema;
+        new_ordered->parent = node->parent;
+
+        ly_set_add(ordset, new_ordered, LY_SET_OPT_USEASLIST);
+    }
+    ((struct diff_ordered *)ordset->set.g[i])->count++;
+
+    return EXIT_SUCCESS;
+}
+
+static void
+diff_ordset_free(struct ly_set *set)
+{
+    unsigned int i;
+    struct diff_ordered *ord;
+
+    if (!set) {
+        return;
+    }
+
+    for (i = 0; i < set->number; i++) {
+        ord = (struct diff_ordered *)set->set.g[i];
+        free(ord->items);
+        free(ord);
+    }
+
+    ly_set_free(set);
+}
+
+/*
+ * -1 - error
+ *  0 - ok
+ *  1 - first and second not the same
+ */
+static int
+lyd_diff_compare(struct lyd_node *first, struct lyd_node *second, int options)
+{
+    int rc;
+
+    if (first->dflt && !(options & LYD_DIFFOPT_WITHDEFAULTS)) {
+        /* the second one cannot be default (see lyd_diff()),
+         * so the nodes differs (first one is default node) */
+        return 1;
+    }
+
+    if (first->schema->nodetype & (LYS_LEAFLIST | LYS_LIST)) {
+        if (first->validity & LYD_VAL_INUSE) {
+            /* this node was already matched, it cannot be matched twice (except for state leaf-/lists,
+             * which we want to keep the count on this way) */
+            return 1;
+        }
+
+        rc = lyd_list_equal(first, second, (options & LYD_DIFFOPT_WITHDEFAULTS ? 1 : 0));
+        if (rc == -1) {
+            return -1;
+        } else if (!rc) {
+            /* list instances differs */
+            return 1;
+        }
+        /* matches */
+    }
+
+    return 0;
+}
+
+/*
+ * -1 - error
+ *  0 - ok
+ */
+static int
+lyd_diff_match(struct lyd_node *first, struct lyd_node *second, struct lyd_diff_out *out, struct ly_set *matchset,
+               struct ly_set *ordset, int options)
+{
+    switch (first->schema->nodetype) {
+    case LYS_LEAFLIST:
+    case LYS_LIST:
+        /* additional work for future move matching in case of user ordered lists */
+        if (first->schema->flags & LYS_USERORDERED) {
+            diff_ordset_insert(first, ordset);
+        }
+
+        /* falls through */
+    case LYS_CONTAINER:
+    case LYS_RPC:
+    case LYS_ACTION:
+    case LYS_NOTIF:
+        assert(!(second->validity & LYD_VAL_INUSE));
+        second->validity |= LYD_VAL_INUSE;
+        /* remember the matching node in first for keeping correct pointer in first
+         * for comparing when passing through the second tree in lyd_diff().
+         * Duplicities are not allowed actually, but they cannot happen since single
+         * node can match only one node in the other tree */
+        ly_set_add(matchset, first, LY_SET_OPT_USEASLIST);
+        break;
+    case LYS_LEAF:
+        /* check for leaf's modification */
+        if (!lyd_leaf_val_equal(first, second, 0) || ((options & LYD_DIFFOPT_WITHDEFAULTS) && (first->dflt != second->dflt))) {
+            if (lyd_diff_out_add(out, LYD_DIFF_CHANGED, first, second)) {
+               return -1;
+            }
+        }
+        break;
+    case LYS_ANYXML:
+    case LYS_ANYDATA:
+        /* check for anydata/anyxml's modification */
+        if (!lyd_anydata_equal(first, second) && lyd_diff_out_add(out, LYD_DIFF_CHANGED, first, second)) {
+            return -1;
+        }
+        break;
+    default:
+        LOGINT(first->schema->module->ctx);
+        return -1;
+    }
+
+    /* mark both that they have matching instance in the other tree */
+    assert(!(first->validity & LYD_VAL_INUSE));
+    first->validity |= LYD_VAL_INUSE;
+
+    return 0;
+}
+
+/* @brief compare if the nodes are equivalent including checking the list's keys
+ * Go through the nodes and their parents and in the case of list, compare its keys.
+ *
+ * @return 0 different, 1 equivalent
+ */
+static int
+lyd_diff_equivnode(struct lyd_node *first, struct lyd_node *second)
+{
+    struct lyd_node *iter1, *iter2;
+
+    for (iter1 = first, iter2 = second; iter1 && iter2; iter1 = iter1->parent, iter2 = iter2->parent) {
+        if (iter1->schema->module->ctx == iter2->schema->module->ctx) {
+            if (iter1->schema != iter2->schema) {
+                return 0;
+            }
+        } else {
+            if (!ly_strequal(iter1->schema->name, iter2->schema->name, 0)) {
+                /* comparing the names is fine, even if they are, in fact, 2 different nodes
+                 * with equal names, some of their parents will differ */
+                return 0;
+            }
+        }
+        if (iter1->schema->nodetype == LYS_LIST) {
+            /* compare keys */
+            if (lyd_list_equal(iter1, iter2, 0) != 1) {
+                return 0;
+            }
+        }
+    }
+
+    if (iter1 != iter2) {
+        /* we are supposed to be in root (NULL) in both trees */
+        return 0;
+    }
+
+    return 1;
+}
+
+static void
+lyd_diff_move_preprocess(struct diff_ordered *ordered, struct lyd_node *first, struct lyd_node *second)
+{
+    /* ordered->count was zeroed and now it is incremented with each added
+     * item's information, so the items are stored in the second tree order
+     */
+    ordered->items[ordered->count].first = first;
+    ordered->items[ordered->count].second = second;
+    ordered->count++;
+}
+
+/* content hash of an inner node, see lyd_diff_chash() */
+struct lyd_chash_rec {
+    const struct lyd_node *node;
+    uint64_t hash;
+    int skip;                        /* the (first tree) subtree matched an equal one in the second tree */
+};
+
+static int
+lyd_chash_rec_equal(void *val1_p, void *val2_p, int UNUSED(mod), void *UNUSED(cb_data))
+{
+    return ((struct lyd_chash_rec *)val1_p)->node == ((struct lyd_chash_rec *)val2_p)->node;
+}
+
+/* hash of a node pointer for the temporary tables indexed by nodes */
+static uint32_t
+lyd_node_ptr_hash(const struct lyd_node *node)
+{
+    return dict_hash_multi(dict_hash_multi(0, (const char *)&node, sizeof node), NULL, 0);
+}
+
+static uint64_t
+lyd_content_hash_mix(uint64_t hash)
+{
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+/* two independent 32-bit hashes, NULL data finish them */
+static uint64_t
+lyd_content_hash_part(uint64_t hash, const char *data, size_t len)
+{
+    uint32_t h1 = hash >> 32, h2 = hash;
+
+    h1 = dict_hash_multi(h1, data, len);
+    h2 = dict_hash_oaat_multi(h2, data, len);
+    return ((uint64_t)h1 << 32) | h2;
+}
+
+/**
+ * @brief Compute the content hash of a subtree, see lyd_content_hash().
+ *
+ * @param[in] node Root of the subtree.
+ * @param[in] options Diff options.
+ * @param[in] ht Optional table to store the hashes of the containers and list instances with keys into.
+ * @return Content hash.
+ */
+static uint64_t
+lyd_content_hash_r(const struct lyd_node *node, int options, struct hash_table *ht)
+{
+    const struct lyd_node *iter;
+    const struct lyd_node_anydata *any;
+    const char *str;
+    struct lyd_chash_rec rec;
+    uint64_t hash, sum = 0, ord = 0, child;
+
+    str = lyd_node_module(node)->name;
+    hash = lyd_content_hash_part(0, str, strlen(str));
+    hash = lyd_content_hash_part(hash, node->schema->name, strlen(node->schema->name));
+    if ((options & LYD_DIFFOPT_WITHDEFAULTS) && node->dflt) {
+        hash = lyd_content_hash_part(hash, "\0", 1);
+    }
+
+    switch (node->schema->nodetype) {
+    case LYS_LEAF:
+    case LYS_LEAFLIST:
+        str = ((struct lyd_node_leaf_list *)node)->value_str;
+        str = str ? str : "";
+        hash = lyd_content_hash_part(hash, str, strlen(str));
+        break;
+    case LYS_ANYXML:
+    case LYS_ANYDATA:
+        any = (const struct lyd_node_anydata *)node;
+        switch (any->value_type) {
+        case LYD_ANYDATA_CONSTSTRING:
+        case LYD_ANYDATA_JSON:
+        case LYD_ANYDATA_SXML:
+            str = any->value.str ? any->value.str : "";
+            hash = lyd_content_hash_part(hash, str, strlen(str));
+            break;
+        default:
+            /* not worth comparing, never equal to another node */
+            hash = lyd_content_hash_part(hash, (const char *)&node, sizeof node);
+            break;
+        }
+        break;
+    default:
+        LY_TREE_FOR(node->child, iter) {
+            if (iter->dflt && !(options & LYD_DIFFOPT_WITHDEFAULTS)) {
+                continue;
+            }
+            child = lyd_content_hash_r(iter, options, ht);
+            if ((iter->schema->nodetype & (LYS_LIST | LYS_LEAFLIST)) && (iter->schema->flags & LYS_USERORDERED)) {
+                /* the order of these instances matters */
+                ord = (ord + child) * 0x100000001b3ULL;
+            } else {
+                sum += lyd_content_hash_mix(child);
+            }
+        }
+        break;
+    }
+
+    hash = lyd_content_hash_part(hash, NULL, 0);
+    hash = lyd_content_hash_mix(hash ^ lyd_content_hash_mix(sum + 0x9e3779b97f4a7c15ULL) ^ (ord * 0xff51afd7ed558ccdULL));
+
+    if (ht && node->child && ((node->schema->nodetype == LYS_CONTAINER)
+            || ((node->schema->nodetype == LYS_LIST) && ((struct lys_node_list *)node->schema)->keys_size))) {
+        /* lyd_diff() may descend into these */
+        rec.node = node;
+        rec.hash = hash;
+        rec.skip = 0;
+        lyht_insert(ht, &rec, lyd_node_ptr_hash(node), NULL);
+    }
+
+    return hash;
+}
+
+API uint64_t
+lyd_content_hash(const struct lyd_node *node, int options)
+{
+    FUN_IN;
+
+    if (!node) {
+        return 0;
+    }
+
+    return lyd_content_hash_r(node, options, NULL);
+}
+
+/**
+ * @brief Compute the content hashes of the containers and list instances of both diffed trees.
+ *
+ * @param[in] first First sibling of the first tree.
+ * @param[in] second First sibling of the second tree.
+ * @param[in] options Diff options.
+ * @return Table of struct lyd_chash_rec, NULL on error.
+ */
+static struct hash_table *
+lyd_diff_chash(struct lyd_node *first, struct lyd_node *second, int options)
+{
+    struct hash_table *ht;
+    struct lyd_node *iter;
+
+    ht = lyht_new(8, sizeof(struct lyd_chash_rec), lyd_chash_rec_equal, NULL, 1);
+    LY_CHECK_ERR_RETURN(!ht, LOGMEM(first->schema->module->ctx), NULL);
+
+    LY_TREE_FOR(first, iter) {
+        lyd_content_hash_r(iter, options, ht);
+    }
+    LY_TREE_FOR(second, iter) {
+        lyd_content_hash_r(iter, options, ht);
+    }
+
+    return ht;
+}
+
+/* whether the matched subtrees are equal so they need not be descended into, remembered for the first one */
+static int
+lyd_diff_chash_skip(struct hash_table *ht, struct lyd_node *first, struct lyd_node *second)
+{
+    struct lyd_chash_rec rec, *rec1, *rec2;
+
+    rec.node = first;
+    if (lyht_find(ht, &rec, lyd_node_ptr_hash(first), (void **)&rec1)) {
+        return 0;
+    }
+    rec.node = second;
+    if (lyht_find(ht, &rec, lyd_node_ptr_hash(second), (void **)&rec2)) {
+        return 0;
+    }
+
+    if (rec1->hash != rec2->hash) {
+        return 0;
+    }
+    rec1->skip = 1;
+    return 1;
+}
+
+/* whether the matched subtree of the first tree was equal to the one in the second tree */
+static int
+lyd_diff_chash_skipped(struct hash_table *ht, struct lyd_node *first)
+{
+    struct lyd_chash_rec rec, *match;
+
+    if (!first->child || ((first->schema->nodetype != LYS_CONTAINER) && (first->schema->nodetype != LYS_LIST))) {
+        return 0;
+    }
+
+    rec.node = first;
+    if (lyht_find(ht, &rec, lyd_node_ptr_hash(first), (void **)&match)) {
+        return 0;
+    }
+    return match->skip;
+}
+
+struct diff_ordered_pos {
+    const struct lyd_node *node;
+    unsigned int idx;
+};
+
+static int
+diff_ordered_pos_equal(void *val1_p, void *val2_p, int UNUSED(mod), void *UNUSED(cb_data))
+{
+    return ((struct diff_ordered_pos *)val1_p)->node == ((struct diff_ordered_pos *)val2_p)->node;
+}
+
+/**
+ * @brief Add the moves of user-ordered instances changing their order in the first tree into the one in the second.
+ *
+ * The instances in the longest subsequence already ordered correctly stay, so the number of moves is minimal.
+ * The subsequence is found in O(n log n), the other instances are moved after their predecessor in the second tree order.
+ *
+ * @param[in] ordered Matched instances in the second tree order.
+ * @param[in] out Output to add the moves to.
+ * @return 0 on success, -1 on error or when stopped.
+ */
+static int
+lyd_diff_move(struct diff_ordered *ordered, struct lyd_diff_out *out)
+{
+    struct ly_ctx *ctx = ordered->schema->module->ctx;
+    struct diff_ordered_item *items = ordered->items;
+    struct diff_ordered_pos pos, *match;
+    struct hash_table *ht;
+    struct lyd_node *iter;
+    unsigned int i, j, lo, hi, mid, len = 0, rank = 0, *tails;
+    char *str = NULL;
+
+    if (ordered->count < 2) {
+        return 0;
+    }
+
+    /* get the positions of the instances in the first tree, the items are in their second tree order */
+    ht = lyht_new(8, sizeof pos, diff_ordered_pos_equal, NULL, 1);
+    LY_CHECK_ERR_RETURN(!ht || lyht_reserve(ht, ordered->count), LOGMEM(ctx); lyht_free(ht), -1);
+    for (i = 0; i < ordered->count; ++i) {
+        pos.node = items[i].first;
+        pos.idx = i;
+        lyht_insert(ht, &pos, lyd_node_ptr_hash(pos.node), NULL);
+    }
+    iter = items[0].first;
+    if (iter->parent) {
+        iter = iter->parent->child;
+    } else {
+        for (; iter->prev->next; iter = iter->prev);
+    }
+    for (; iter; iter = iter->next) {
+        if (iter->schema != ordered->schema) {
+            continue;
+        }
+        pos.node = iter;
+        if (!lyht_find(ht, &pos, lyd_node_ptr_hash(iter), (void **)&match)) {
+            items[match->idx].pos = rank++;
+        }
+    }
+    lyht_free(ht);
+    assert(rank == ordered->count);
+
+    /* the longest subsequence of increasing positions, searched from the end (as decreasing) so that
+     * the preceding instances are kept on ties, tails[l] is the item starting such a subsequence of length l + 1
+     * with the lowest position */
+    tails = malloc(ordered->count * sizeof *tails);
+    LY_CHECK_ERR_RETURN(!tails, LOGMEM(ctx), -1);
+    for (i = ordered->count; i > 0; --i) {
+        j = i - 1;
+        lo = 0;
+        hi = len;
+        while (lo < hi) {
+            mid = (lo + hi) / 2;
+            if (items[tails[mid]].pos > items[j].pos) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        items[j].next = lo ? tails[lo - 1] : ordered->count;
+        items[j].keep = 0;
+        tails[lo] = j;
+        if (lo == len) {
+            ++len;
+        }
+    }
+    for (j = tails[len - 1]; j < ordered->count; j = items[j].next) {
+        items[j].keep = 1;
+    }
+    free(tails);
+
+    /* move all the other instances after their predecessors */
+    for (i = 0; i < ordered->count; ++i) {
+        if (items[i].keep) {
+            continue;
+        }
+        LOGDBG(LY_LDGDIFF, "detected moved element \"%s\" from %u to %u", str = lyd_path(items[i].first), items[i].pos, i);
+        free(str);
+        if (lyd_diff_out_add(out, LYD_DIFF_MOVEDAFTER1, items[i].first, i ? items[i - 1].first : NULL)) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+#ifdef LY_ENABLED_CACHE
+
+/**
+ * @brief Create a temporary hash table of the top-level siblings of the first tree, they have no parent
+ * to keep one for matching their instances.
+ *
+ * @param[in] first First top-level sibling.
+ * @param[out] ht Created hash table, NULL if there are too few siblings to need it.
+ * @return 0 on success, -1 on error.
+ */
+static int
+lyd_diff_siblings_ht(struct lyd_node *first, struct hash_table **ht)
+{
+    struct lyd_node *iter;
+    uint32_t count = 0;
+
+    *ht = NULL;
+    LY_TREE_FOR(first, iter) {
+        ++count;
+    }
+    if (count < LY_CACHE_HT_MIN_CHILDREN) {
+        return 0;
+    }
+
+    *ht = lyht_new(1, sizeof(struct lyd_node *), lyd_hash_table_val_equal, NULL, 1);
+    LY_CHECK_ERR_RETURN(!*ht || lyht_reserve(*ht, count), LOGMEM(first->schema->module->ctx), -1);
+
+    LY_TREE_FOR(first, iter) {
+        if (!iter->hash || ((iter->schema->nodetype == LYS_LIST) && !lyd_list_has_keys(iter))) {
+            /* not hashed (lists without keys) */
+            continue;
+        }
+        if (lyht_insert(*ht, &iter, iter->hash, NULL)) {
+            assert(0);
+        }
+    }
+
+    return 0;
+}
+
+#endif
+
+static struct lyd_difflist *
+lyd_diff_init_difflist(struct ly_ctx *ctx, unsigned int *size)
+{
+    struct lyd_difflist *result;
+
+    result = malloc(sizeof *result);
+    LY_CHECK_ERR_RETURN(!result, LOGMEM(ctx); *size = 0, NULL);
+
+    *size = 1;
+    result->type = calloc(*size, sizeof *result->type);
+    result->first = calloc(*size, sizeof *result->first);
+    result->second = calloc(*size, sizeof *result->second);
+    if (!result->type || !result->first || !result->second) {
+        LOGMEM(ctx);
+        free(result->second);
+        free(result->first);
+        free(result->type);
+        free(result);
+        *size = 0;
+        return NULL;
+    }
+
+    return result;
+}
+
+static int
+lyd_diff_(struct lyd_node *first, struct lyd_node *second, int options, struct lyd_diff_out *out)
+{
+    struct ly_ctx *ctx;
+    int rc, marked = 0;
+    struct lyd_node *elem1, *elem2, *iter, *aux, *parent = NULL, *next1, *next2;
+    struct lyd_diff_out out2 = {NULL, 0, 0, NULL, NULL, 0};
+    void *new;
+    unsigned int i, j;
+    struct matchlist_s {
+        struct matchlist_s *prev;
+        struct ly_set *match;
+        unsigned int i;
+    } *matchlist = NULL, *mlaux;
+    struct ly_set *ordset = NULL;
+    struct hash_table *chash = NULL;
+    struct diff_ordered *ordered;
+#ifdef LY_ENABLED_CACHE
+    struct hash_table *ht, *top_ht = NULL;
+#endif
+
+    if (!first) {
+        /* all nodes in second were created,
+         * but the second must be top level */
+        if (second && second->parent) {
+            LOGERR(second->schema->module->ctx, LY_EINVAL, "%s: \"first\" parameter is NULL and \"second\" is not top level.", __func__);
+            return EXIT_FAILURE;
+        }
+        LY_TREE_FOR(second, iter) {
+            if (!iter->dflt || (options & LYD_DIFFOPT_WITHDEFAULTS)) { /* skip the implicit nodes */
+                if (lyd_diff_out_add(out, LYD_DIFF_CREATED, NULL, iter)) {
+                    goto error;
+                }
+            }
+            if (options & LYD_DIFFOPT_NOSIBLINGS) {
+                break;
+            }
+        }
+        return EXIT_SUCCESS;
+    } else if (!second) {
+        /* all nodes from first were deleted */
+        LY_TREE_FOR(first, iter) {
+            if (!iter->dflt || (options & LYD_DIFFOPT_WITHDEFAULTS)) { /* skip the implicit nodes */
+                if (lyd_diff_out_add(out, LYD_DIFF_DELETED, iter, NULL)) {
+                    goto error;
+                }
+            }
+            if (options & LYD_DIFFOPT_NOSIBLINGS) {
+                break;
+            }
+        }
+        return EXIT_SUCCESS;
+    }
+
+    ctx = first->schema->module->ctx;
+
+    if (options & LYD_DIFFOPT_NOSIBLINGS) {
+        /* both trees must start at the same (schema) node */
+        if (first->schema != second->schema) {
+            LOGERR(ctx, LY_EINVAL, "%s: incompatible trees to compare with LYD_OPT_NOSIBLINGS option.", __func__);
+            return EXIT_FAILURE;
+        }
+        /* use first's and second's child to make comparison the same as without LYD_OPT_NOSIBLINGS */
+        first = first->child;
+        second = second->child;
+    } else {
+        /* go to the first sibling in both trees */
+        if (first->parent) {
+            first = first->parent->child;
+        } else {
+            while (first->prev->next) {
+                first = first->prev;
+            }
+        }
+
+        if (second->parent) {
+            second = second->parent->child;
+        } else {
+            for (; second->prev->next; second = second->prev);
+        }
+
+        /* check that both has the same (schema) parent or that they are top-level nodes */
+        if ((first->parent && second->parent && first->parent->schema != second->parent->schema) ||
+                (!first->parent && first->parent != second->parent)) {
+            LOGERR(ctx, LY_EINVAL, "%s: incompatible trees with different parents.", __func__);
+            return EXIT_FAILURE;
+        }
+    }
+    if (first == second) {
+        LOGERR(ctx, LY_EINVAL, "%s: comparing the same tree does not make sense.", __func__);
+        return EXIT_FAILURE;
+    }
+
+    /* the records about created and moved items are created in
+     * bad order, so the records about created nodes (and their
+     * possible moving) is stored separately and added to the
+     * main result (or passed to the callback) at the end.
+     */
+    out2.diff = lyd_diff_init_difflist(ctx, &out2.size);
+    LY_CHECK_ERR_GOTO(!out2.diff, , error);
+
+    matchlist = malloc(sizeof *matchlist);
+    LY_CHECK_ERR_GOTO(!matchlist, LOGMEM(ctx), error);
+
+    matchlist->i = 0;
+    matchlist->match = ly_set_new();
+    matchlist->prev = NULL;
+
+    ordset = ly_set_new();
+    LY_CHECK_ERR_GOTO(!ordset, , error);
+
+#ifdef LY_ENABLED_CACHE
+    if (first && !first->parent && lyd_diff_siblings_ht(first, &top_ht)) {
+        goto error;
+    }
+#endif
+
+    if (first && second && (options & LYD_DIFFOPT_SUBTREEHASH)) {
+        chash = lyd_diff_chash(first, second, options);
+        LY_CHECK_GOTO(!chash, error);
+    }
+
+    /*
+     * compare trees
+     */
+    marked = 1;
+
+    /* 1) newly created nodes + changed leafs/anyxmls */
+    next1 = first;
+    for (elem2 = next2 = second; elem2; elem2 = next2) {
+        /* keep right pointer for searching in the first tree */
+        elem1 = next1;
+
+        if (elem2->dflt && !(options & LYD_DIFFOPT_WITHDEFAULTS)) {
+            /* skip default elements, they could not be created or changed, just deleted */
+            goto cmp_continue;
+        }
+
+#ifdef LY_ENABLED_CACHE
+        struct lyd_node **iter_p;
+
+        ht = elem1 ? (elem1->parent ? elem1->parent->ht : top_ht) : NULL;
+        if (ht && elem2->hash) {
+            /* match the instance in O(1) instead of going through the siblings */
+            iter = NULL;
+            if (!lyht_find(ht, &elem2, elem2->hash, (void **)&iter_p)) {
+                iter = *iter_p;
+                /* we found a match */
+                if (iter->dflt && !(options & LYD_DIFFOPT_WITHDEFAULTS)) {
+                    /* the second one cannot be default (see lyd_diff()),
+                     * so the nodes differs (first one is default node) */
+                    iter = NULL;
+                }
+                while (iter && (iter->validity & LYD_VAL_INUSE)) {
+                    /* state lists, find one not-already-found */
+                    assert((iter->schema->nodetype & (LYS_LIST | LYS_LEAFLIST)) && (iter->schema->flags & LYS_CONFIG_R));
+                    if (lyht_find_next(ht, &iter, iter->hash, (void **)&iter_p)) {
+                        iter = NULL;
+                    } else {
+                        iter = *iter_p;
+                    }
+                }
+            }
+        } else
+#endif
+        {
+            /* search for elem2 instance in the first */
+            LY_TREE_FOR(elem1, iter) {
+                if (iter->schema != elem2->schema) {
+                    continue;
+                }
+
+                /* elem2 instance found */
+                rc = lyd_diff_compare(iter, elem2, options);
+                if (rc == -1) {
+                    goto error;
+                } else if (rc == 0) {
+                    /* match */
+                    break;
+                } /* else, continue */
             }
-            free(str);
-            lyd_free(ret);
-            return NULL;
         }
-        /* special case when we are creating a sibling of a top-level data node */
-        if (!is_relative) {
-            if (data_tree) {
-                for (; data_tree->next; data_tree = data_tree->next);
-                if (lyd_insert_after(data_tree, node)) {
-                    lyd_free(ret);
-                    return NULL;
+        /* we have a match */
+        if (iter && lyd_diff_match(iter, elem2, out, matchlist->match, ordset, options)) {
+            goto error;
+        }
+
+        if (!iter) {
+            /* elem2 not found in the first tree */
+            if (lyd_diff_out_add(&out2, LYD_DIFF_CREATED, elem1 ? elem1->parent : parent, elem2)) {
+                goto error;
+            }
+
+            if (elem1 && (elem2->schema->flags & LYS_USERORDERED)) {
+                /* store the correct place where the node is supposed to be moved after creation */
+                /* if elem1 does not exist, all nodes were created and they will be created in
+                 * correct order, so it is not needed to detect moves */
+                for (aux = elem2->prev; aux->next; aux = aux->prev) {
+                    if (aux->schema == elem2->schema) {
+                        /* predecessor found */
+                        break;
+                    }
+                }
+                if (!aux->next) {
+                    /* predecessor not found */
+                    aux = NULL;
+                }
+                if (lyd_diff_out_add(&out2, LYD_DIFF_MOVEDAFTER2, aux, elem2)) {
+                    goto error;
                 }
             }
-            is_relative = 1;
         }
 
-        if (first_iter) {
-            /* sort if needed, but only when inserted somewhere */
-            sparent = node->schema;
-            do {
-                sparent = lys_parent(sparent);
-            } while (sparent && (sparent->nodetype != ((options & LYD_PATH_OPT_OUTPUT) ? LYS_OUTPUT : LYS_INPUT)));
-            if (sparent && lyd_schema_sort(node, 0)) {
-                lyd_free(ret);
-                return NULL;
+cmp_continue:
+        /* select element for the next run                                    1     2
+         * - first, process all siblings of a single parent                  / \   / \
+         * - then, go to children (deep)                                    3   4 7   8
+         * - return to the parent's next sibling children                  / \
+         *                                                                5   6
+         */
+        /* siblings first */
+        next1 = elem1;
+        next2 = elem2->next;
+
+        if (!next2) {
+            /* children */
+
+            /* first pass of the siblings done, some additional work for future
+             * detection of move may be needed */
+            for (i = ordset->number; i > 0; i--) {
+                ordered = (struct diff_ordered *)ordset->set.g[i - 1];
+                if (ordered->items) {
+                    /* already preprocessed ordered structure */
+                    break;
+                }
+                ordered->items = calloc(ordered->count, sizeof *ordered->items);
+                LY_CHECK_ERR_GOTO(!ordered->items, LOGMEM(ctx), error);
+                /* zero the count to be used as a node position in lyd_diff_move_preprocess() */
+                ordered->count = 0;
             }
 
-            /* set first created node */
-            ret = node;
-            first_iter = 0;
-        }
+            /* first, get the first sibling */
+            if (elem2->parent == second->parent) {
+                elem2 = second;
+            } else {
+                elem2 = elem2->parent->child;
+            }
 
-        parsed = 0;
-        if ((schild->nodetype == LYS_LIST) && has_predicate && lyd_new_path_list_predicate(node, name, id, &parsed)) {
-            lyd_free(ret);
-            return NULL;
-        }
-        id += parsed;
+            /* and then find the first child */
+            LY_TREE_FOR(elem2, iter) {
+                if (!(iter->validity & LYD_VAL_INUSE)) {
+                    /* the iter is not present in both trees */
+                    continue;
+                } else if (matchlist->i == matchlist->match->number) {
+                    if (iter == elem2) {
+                        /* we already went through all the matching nodes and now we are just supposed to stop
+                         * the loop with no iter */
+                        iter = NULL;
+                        break;
+                    } else {
+                        /* we have started with some not processed data in matchlist, but now we have
+                         * the INUSE iter and no nodes in matchlist to find its equivalent,
+                         * so something went wrong somewhere */
+                        LOGINT(ctx);
+                        goto error;
+                    }
+                }
 
-        if (!id[0]) {
-            /* we are done */
-            if (options & LYD_PATH_OPT_NOPARENTRET) {
-                /* last created node */
-                return node;
+                iter->validity &= ~LYD_VAL_INUSE;
+                if ((iter->schema->nodetype & (LYS_LEAFLIST | LYS_LIST)) && (iter->schema->flags & LYS_USERORDERED)) {
+                    for (j = ordset->number; j > 0; j--) {
+                        ordered = (struct diff_ordered *)ordset->set.g[j - 1];
+                        if (ordered->schema != iter->schema || !lyd_diff_equivnode(ordered->parent, iter->parent)) {
+                            continue;
+                        }
+
+                        /* store necessary information for move detection */
+                        lyd_diff_move_preprocess(ordered, matchlist->match->set.d[matchlist->i], iter);
+                        break;
+                    }
+                }
+
+                if (((iter->schema->nodetype == LYS_CONTAINER) || ((iter->schema->nodetype == LYS_LIST)
+                        && ((struct lys_node_list *)iter->schema)->keys_size)) && iter->child) {
+                    while (matchlist->i < matchlist->match->number && matchlist->match->set.d[matchlist->i]->schema != iter->schema) {
+                        matchlist->i++;
+                    }
+                    if (matchlist->i == matchlist->match->number) {
+                        /* we have the INUSE iter, so we have to find its equivalent in match list */
+                        LOGINT(ctx);
+                        goto error;
+                    }
+                    if (chash && lyd_diff_chash_skip(chash, matchlist->match->set.d[matchlist->i], iter)) {
+                        /* equal subtrees */
+                        matchlist->i++;
+                        continue;
+                    }
+                    next1 = matchlist->match->set.d[matchlist->i]->child;
+                    if (!next1) {
+                        parent = matchlist->match->set.d[matchlist->i];
+                    }
+                    matchlist->i++;
+                    next2 = iter->child;
+                    break;
+                }
+                matchlist->i++;
+            }
+
+            if (!iter) {
+                /* no child/data on next level */
+                if (elem2 == second) {
+                    /* done */
+                    break;
+                }
+            } else {
+                /* create new matchlist item */
+                mlaux = malloc(sizeof *mlaux);
+                LY_CHECK_ERR_GOTO(!mlaux, LOGMEM(ctx), error);
+                mlaux->i = 0;
+                mlaux->match = ly_set_new();
+                mlaux->prev = matchlist;
+                matchlist = mlaux;
             }
-            return ret;
         }
 
-        /* prepare for another iteration */
-        parent = node;
-        sparent = schild;
-        prev_mod = lys_node_module(schild);
+        while (!next2) {
+            /* parent */
 
-        /* parse another node */
-        if ((r = parse_schema_nodeid(id, &mod_name, &mod_name_len, &name, &nam_len, &is_relative, &has_predicate, NULL, 0)) < 1) {
-            LOGVAL(ctx, LYE_PATH_INCHAR, LY_VLOG_NONE, NULL, id[-r], &id[-r]);
-            lyd_free(ret);
-            return NULL;
-        }
-        id += r;
+            /* clean the last match set */
+            ly_set_clean(matchlist->match);
+            matchlist->i = 0;
 
-        /* if a key of a list was supposed to be created, it is created as a part of the list instance creation */
-        if ((schild->nodetype == LYS_LIST) && !mod_name) {
-            slist = (const struct lys_node_list *)schild;
-            for (i = 0; i < slist->keys_size; ++i) {
-                if (!strncmp(slist->keys[i]->name, name, nam_len) && !slist->keys[i]->name[nam_len]) {
-                    /* the path continues? there cannot be anything after a key (leaf) */
-                    if (id[0]) {
-                        LOGVAL(ctx, LYE_PATH_INCHAR, LY_VLOG_NONE, NULL, id[0], id);
-                        lyd_free(ret);
-                        return NULL;
+            /* try to go to a cousin - child of the next parent's sibling */
+            mlaux = matchlist->prev;
+            LY_TREE_FOR(elem2->parent->next, iter) {
+                if (!(iter->validity & LYD_VAL_INUSE)) {
+                    continue;
+                } else if (mlaux->i == mlaux->match->number) {
+                    if (iter == elem2->parent->next) {
+                        /* we already went through all the matching nodes and now we are just supposed to stop
+                         * the loop with no iter */
+                        iter = NULL;
+                        break;
+                    } else {
+                        /* we have started with some not processed data in matchlist, but now we have
+                         * the INUSE iter and no nodes in matchlist to find its equivalent,
+                         * so something went wrong somewhere */
+                        LOGINT(ctx);
+                        goto error;
                     }
-                    return ret;
+                }
+
+                iter->validity &= ~LYD_VAL_INUSE;
+                if ((iter->schema->nodetype & (LYS_LEAFLIST | LYS_LIST)) && (iter->schema->flags & LYS_USERORDERED)) {
+                    for (j = ordset->number ; j > 0; j--) {
+                        ordered = (struct diff_ordered *)ordset->set.g[j - 1];
+                        if (ordered->schema != iter->schema || !lyd_diff_equivnode(ordered->parent, iter->parent)) {
+                            continue;
+                        }
+
+                        /* store necessary information for move detection */
+                        lyd_diff_move_preprocess(ordered, mlaux->match->set.d[mlaux->i], iter);
+                        break;
+                    }
+                }
+
+                if (((iter->schema->nodetype == LYS_CONTAINER) || ((iter->schema->nodetype == LYS_LIST)
+                        && ((struct lys_node_list *)iter->schema)->keys_size)) && iter->child) {
+                    while (mlaux->i < mlaux->match->number && mlaux->match->set.d[mlaux->i]->schema != iter->schema) {
+                        mlaux->i++;
+                    }
+                    if (mlaux->i == mlaux->match->number) {
+                        /* we have the INUSE iter, so we have to find its equivalent in match list */
+                        LOGINT(ctx);
+                        goto error;
+                    }
+                    if (chash && lyd_diff_chash_skip(chash, mlaux->match->set.d[mlaux->i], iter)) {
+                        /* equal subtrees */
+                        mlaux->i++;
+                        continue;
+                    }
+                    next1 = mlaux->match->set.d[mlaux->i]->child;
+                    if (!next1) {
+                        parent = mlaux->match->set.d[mlaux->i];
+                    }
+                    mlaux->i++;
+                    next2 = iter->child;
+                    break;
+                }
+                mlaux->i++;
+            }
+
+            /* if no cousin exists, continue next loop on higher level */
+            if (!iter) {
+                elem2 = elem2->parent;
+
+                /* remove matchlist item */
+                ly_set_free(matchlist->match);
+                mlaux = matchlist;
+                matchlist = matchlist->prev;
+                free(mlaux);
+
+                if (!matchlist->prev) { /* elem2->parent == second->parent */
+                    /* done */
+                    break;
                 }
             }
         }
     }
 
-    LOGINT(ctx);
-    return NULL;
-}
-
-API unsigned int
-lyd_list_pos(const struct lyd_node *node)
-{
-    FUN_IN;
-
-    unsigned int pos;
-    struct lys_node *schema;
+    ly_set_free(matchlist->match);
+    free(matchlist);
+    matchlist = NULL;
+#ifdef LY_ENABLED_CACHE
+    lyht_free(top_ht);
+    top_ht = NULL;
+#endif
 
-    if (!node || ((node->schema->nodetype != LYS_LIST) && (node->schema->nodetype != LYS_LEAFLIST))) {
-        return 0;
-    }
+    /* 2) deleted nodes */
+    LY_TREE_DFS_BEGIN(first, next1, elem1) {
+        /* search for elem1s deleted in the second */
+        if (elem1->validity & LYD_VAL_INUSE) {
+            /* erase temporary LYD_VAL_INUSE flag and continue into children */
+            elem1->validity &= ~LYD_VAL_INUSE;
+            if (chash && lyd_diff_chash_skipped(chash, elem1)) {
+                /* equal to the subtree in the second tree, nothing was matched in it */
+                goto dfs_nextsibling;
+            }
+        } else if (!elem1->dflt || (options & LYD_DIFFOPT_WITHDEFAULTS)) {
+            /* elem1 has no matching node in second, add it into result */
+            if (lyd_diff_out_add(out, LYD_DIFF_DELETED, elem1, NULL)) {
+                goto error;
+            }
 
-    schema = node->schema;
-    pos = 0;
-    do {
-        if (node->schema == schema) {
-            ++pos;
+            /* skip subtree processing of data missing in the second tree */
+            goto dfs_nextsibling;
         }
-        node = node->prev;
-    } while (node->next);
-
-    return pos;
-}
-
-static struct lyd_node *
-lyd_new_dummy(struct lyd_node *root, struct lyd_node *parent, const struct lys_node *schema, const char *value, int dflt)
-{
-    unsigned int index;
-    struct ly_set *spath;
-    const struct lys_node *siter;
-    struct lyd_node *iter, *dummy = NULL;
-
-    assert(schema);
-    assert(schema->nodetype & (LYS_CONTAINER | LYS_LEAF | LYS_LIST | LYS_LEAFLIST | LYS_ANYDATA | LYS_NOTIF |
-                               LYS_RPC | LYS_ACTION));
-
-    spath = ly_set_new();
-    if (!spath) {
-        LOGMEM(schema->module->ctx);
-        return NULL;
-    }
-
-    if (!parent && root) {
-        /* find data root */
-        for (; root->parent; root = root->parent);   /* vertical move (up) */
-        for (; root->prev->next; root = root->prev); /* horizontal move (left) */
-    }
 
-    /* build schema path */
-    for (siter = schema; siter; siter = lys_parent(siter)) {
-        /* stop if we know some of the parents */
-        if (parent && parent->schema == siter) {
-            break;
+        /* modified LY_TREE_DFS_END() */
+        /* select element for the next run - children first */
+        if ((elem1->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST | LYS_ANYDATA)) || ((elem1->schema->nodetype == LYS_LIST)
+                && !((struct lys_node_list *)elem1->schema)->keys_size)) {
+            next1 = NULL;
+        } else {
+            next1 = elem1->child;
         }
+        if (!next1) {
+dfs_nextsibling:
+            /* try siblings */
+            next1 = elem1->next;
+        }
+        while (!next1) {
+            /* parent is already processed, go to its sibling */
 
-        if (siter->nodetype & (LYS_CONTAINER | LYS_LEAF | LYS_LIST | LYS_LEAFLIST | LYS_ANYDATA | LYS_NOTIF |
-                               LYS_RPC | LYS_ACTION)) {
-            /* we have a node that can appear in data tree */
-            ly_set_add(spath, (void*)siter, LY_SET_OPT_USEASLIST);
-        } /* else skip the rest node types */
-    }
-
-    assert(spath->number > 0);
-    index = spath->number;
-    if (!parent && !(spath->set.s[index - 1]->nodetype & LYS_LEAFLIST)) {
-        /* start by searching for the top-level parent */
-        LY_TREE_FOR(root, iter) {
-            if (iter->schema == spath->set.s[index - 1]) {
-                parent = iter;
-                index--;
+            elem1 = elem1->parent;
+            if (elem1 == first->parent) {
+                /* we are done, no next element to process */
                 break;
             }
+
+            next1 = elem1->next;
         }
     }
 
-    iter = parent;
-    while (iter && index && !(spath->set.s[index - 1]->nodetype & LYS_LEAFLIST)) {
-        /* search for closer parent on the path */
-        LY_TREE_FOR(parent->child, iter) {
-            if (iter->schema == spath->set.s[index - 1]) {
-                index--;
-                parent = iter;
-                break;
-            }
+    /* 3) moved nodes (when user-ordered) */
+    for (i = 0; i < ordset->number; i++) {
+        if (lyd_diff_move((struct diff_ordered *)ordset->set.g[i], out)) {
+            goto error;
         }
     }
-    while(index) {
-        /* create the missing part of the path */
-        switch (spath->set.s[index - 1]->nodetype) {
-        case LYS_LEAF:
-        case LYS_LEAFLIST:
-            if (value) {
-                iter = _lyd_new_leaf(parent, spath->set.s[index - 1], value, dflt, 0);
-            } else {
-                iter = lyd_create_leaf(spath->set.s[index - 1], value, dflt);
-                if (iter && parent) {
-                    if (lyd_insert(parent, iter)) {
-                        lyd_free(iter);
-                        goto error;
-                    }
-                }
+
+    diff_ordset_free(ordset);
+    ordset = NULL;
+    lyht_free(chash);
+    chash = NULL;
+
+    if (out->clb) {
+        /* pass the newly created (and possibly moved) nodes */
+        for (i = 0; i < out2.index; i++) {
+            if (lyd_diff_out_add(out, out2.diff->type[i], out2.diff->first[i], out2.diff->second[i])) {
+                goto error;
             }
-            break;
-        case LYS_CONTAINER:
-        case LYS_LIST:
-            iter = _lyd_new(parent, spath->set.s[index - 1], dflt);
-            break;
-        case LYS_ANYXML:
-        case LYS_ANYDATA:
-            iter = lyd_create_anydata(parent, spath->set.s[index - 1], "", LYD_ANYDATA_CONSTSTRING);
-            break;
-        default:
-            goto error;
-        }
-        if (!iter) {
-            LOGINT(schema->module->ctx);
-            goto error;
         }
+    } else if (out2.index) {
+        /* append result2 with newly created
+         * (and possibly moved) nodes */
+        if (out->index + out2.index + 1 >= out->size) {
+            /* result must be enlarged */
+            out->size = out->index + out2.index + 1;
+            new = realloc(out->diff->type, out->size * sizeof *out->diff->type);
+            LY_CHECK_ERR_GOTO(!new, LOGMEM(ctx), error);
+            out->diff->type = new;
 
-        /* we say it is valid and it is dummy */
-        iter->validity = LYD_VAL_INUSE;
+            new = realloc(out->diff->first, out->size * sizeof *out->diff->first);
+            LY_CHECK_ERR_GOTO(!new, LOGMEM(ctx), error);
+            out->diff->first = new;
 
-        if (!dummy) {
-            dummy = iter;
+            new = realloc(out->diff->second, out->size * sizeof *out->diff->second);
+            LY_CHECK_ERR_GOTO(!new, LOGMEM(ctx), error);
+            out->diff->second = new;
         }
 
-        /* continue */
-        parent = iter;
-        index--;
+        /* append */
+        memcpy(&out->diff->type[out->index], out2.diff->type, (out2.index + 1) * sizeof *out->diff->type);
+        memcpy(&out->diff->first[out->index], out2.diff->first, (out2.index + 1) * sizeof *out->diff->first);
+        memcpy(&out->diff->second[out->index], out2.diff->second, (out2.index + 1) * sizeof *out->diff->second);
+        out->index += out2.index;
     }
+    lyd_free_diff(out2.diff);
 
-    ly_set_free(spath);
-
-    return dummy;
+    return EXIT_SUCCESS;
 
 error:
-    ly_set_free(spath);
-    lyd_free(dummy);
-    return NULL;
-}
-
-static struct lys_node *
-lys_get_schema_inctx(struct lys_node *schema, struct ly_ctx *ctx)
-{
-    const struct lys_module *mod, *trg_mod = NULL;
-    struct lys_node *parent, *first_sibling = NULL, *iter = NULL;
-    struct ly_set *parents;
-    unsigned int index;
-    uint32_t idx;
-    void **ptr;
+    while (matchlist) {
+        mlaux = matchlist;
+        matchlist = mlaux->prev;
+        ly_set_free(mlaux->match);
+        free(mlaux);
 
-    if (!ctx || schema->module->ctx == ctx) {
-        /* we have the same context */
-        return schema;
     }
+    diff_ordset_free(ordset);
+    lyht_free(chash);
+#ifdef LY_ENABLED_CACHE
+    lyht_free(top_ht);
+#endif
+    lyd_free_diff(out2.diff);
 
-    /* store the parents chain */
-    parents = ly_set_new();
-    for (parent = schema; parent; parent = lys_parent(parent)) {
-        /* note - augments are skipped so we will work only with the implemented modules
-         * (where the augments are applied) */
-        if (parent->nodetype != LYS_USES) {
-            ly_set_add(parents, parent, LY_SET_OPT_USEASLIST);
-        }
+    if (marked) {
+        /* the trees are left unfinished, do not leave them marked */
+        for (; first->prev->next; first = first->prev);
+        for (; second->prev->next; second = second->prev);
+        lyd_clear_inuse(first);
+        lyd_clear_inuse(second);
     }
-    assert(parents->number);
-    index = parents->number - 1;
 
-    /* process the parents from the top level */
-    /* for the top-level node, we have to locate the module first */
-    parent = parents->set.s[index];
-    if (parent->nodetype == LYS_EXT) {
-        ptr = lys_ext_complex_get_substmt(LY_STMT_NODE, (struct lys_ext_instance_complex *)parent, NULL);
-        if (!ptr) {
-            ly_set_free(parents);
-            return NULL;
-        }
-        first_sibling = *(struct lys_node **)ptr;
-        parent = parents->set.s[--index];
-    }
-    idx = 0;
-    while ((mod = ly_ctx_get_module_iter(ctx, &idx))) {
-        trg_mod = lys_node_module(parent);
-        /* check module name */
-        if (strcmp(mod->name, trg_mod->name)) {
-            continue;
-        }
+    return out->stop ? EXIT_SUCCESS : EXIT_FAILURE;
+}
 
-        /* check revision */
-        if ((!mod->rev_size && !trg_mod->rev_size) ||
-                (mod->rev_size && trg_mod->rev_size && !strcmp(mod->rev[0].date, trg_mod->rev[0].date))) {
-            /* we have match */
-            break;
-        }
-    }
-    /* try data callback */
-    if (!mod && trg_mod && ctx->data_clb) {
-        LOGDBG(LY_LDGYANG, "Attempting to load '%s' into context using callback ...", trg_mod->name);
-        mod = ctx->data_clb(ctx, trg_mod->name, NULL, 0, ctx->data_clb_data);
+API struct lyd_difflist *
+lyd_diff(struct lyd_node *first, struct lyd_node *second, int options)
+{
+    FUN_IN;
+
+    struct lyd_diff_out out = {NULL, 0, 0, NULL, NULL, 0};
+
+    out.diff = lyd_diff_init_difflist(first ? first->schema->module->ctx : (second ? second->schema->module->ctx : NULL),
+                                      &out.size);
+    if (!out.diff) {
+        return NULL;
     }
-    if (!mod) {
-        ly_set_free(parents);
+
+    if (lyd_diff_(first, second, options, &out)) {
+        lyd_free_diff(out.diff);
         return NULL;
     }
-    if (!first_sibling) {
-        first_sibling = mod->data;
+
+    return out.diff;
+}
+
+API int
+lyd_diff_iter(struct lyd_node *first, struct lyd_node *second, int options, lyd_diff_clb clb, void *user_data)
+{
+    FUN_IN;
+
+    struct lyd_diff_out out = {NULL, 0, 0, NULL, NULL, 0};
+
+    if (!clb) {
+        LOGARG;
+        return EXIT_FAILURE;
     }
+    out.clb = clb;
+    out.clb_data = user_data;
 
-    /* now search in the schema tree for the matching node */
-    while (1) {
-        lys_get_sibling(first_sibling, trg_mod->name, 0, parent->name, 0, parent->nodetype,
-                        (const struct lys_node **)&iter);
-        if (!iter) {
-            /* not found, iter will be used as NULL result */
-            break;
-        }
+    return lyd_diff_(first, second, options, &out);
+}
 
-        if (index == 0) {
-            /* we are done, iter is the result */
-            break;
-        } else {
-            /* we are going to continue, so update variables for the next loop */
-            first_sibling = iter->child;
-            parent = parents->set.s[--index];
-            iter = NULL;
-        }
+/* LYB patch records, see lyd_lyb_patch() */
+#define LYD_PATCH_END 0     /* end of the patch */
+#define LYD_PATCH_DELETE 1  /* path of a deleted node */
+#define LYD_PATCH_MOVE 2    /* path of a moved user-ordered instance and of its new predecessor, empty for the first one */
+#define LYD_PATCH_MERGE 3   /* LYB data of the changed and created nodes with their parents */
+
+/* LYB patch magic number with the format version 0 */
+static const char lyd_patch_magic[4] = {'l', 'y', 'p', 0x00};
+
+struct lyd_patch_buf {
+    char *data;
+    size_t len;
+    size_t size;
+};
+
+static int
+lyd_patch_write(struct ly_ctx *ctx, struct lyd_patch_buf *buf, const void *data, size_t len)
+{
+    char *mem;
+
+    if (buf->len + len > buf->size) {
+        buf->size = (buf->len + len) * 2;
+        mem = realloc(buf->data, buf->size);
+        LY_CHECK_ERR_RETURN(!mem, LOGMEM(ctx), EXIT_FAILURE);
+        buf->data = mem;
     }
 
-    ly_set_free(parents);
-    return iter;
+    memcpy(buf->data + buf->len, data, len);
+    buf->len += len;
+    return EXIT_SUCCESS;
 }
 
-static struct lys_node *
-lyd_get_schema_inctx(const struct lyd_node *node, struct ly_ctx *ctx)
+/* write the path of a node including the terminating zero, an empty string for no node */
+static int
+lyd_patch_write_path(struct ly_ctx *ctx, struct lyd_patch_buf *buf, const struct lyd_node *node)
 {
-    assert(node);
+    char *path;
+    int ret;
 
-    return lys_get_schema_inctx(node->schema, ctx);
+    if (!node) {
+        return lyd_patch_write(ctx, buf, "", 1);
+    }
+
+    path = lyd_path(node);
+    if (!path) {
+        return EXIT_FAILURE;
+    }
+    ret = lyd_patch_write(ctx, buf, path, strlen(path) + 1);
+    free(path);
+    return ret;
 }
 
-/* both target and source were validated */
-static void
-lyd_merge_node_update(struct lyd_node *target, struct lyd_node *source)
+API int
+lyd_lyb_patch(char **patch, struct lyd_node *first, struct lyd_node *second, int options)
 {
+    FUN_IN;
+
     struct ly_ctx *ctx;
-    struct lyd_node_leaf_list *trg_leaf, *src_leaf;
-    struct lyd_node_anydata *trg_any, *src_any;
-    int len;
+    struct lyd_difflist *diff;
+    struct lyd_patch_buf buf = {NULL, 0, 0};
+    struct lyd_node *upsert = NULL, *dup;
+    char *lyb = NULL;
+    uint8_t op;
+    uint32_t i;
+    int rc = EXIT_FAILURE;
 
-    assert(target->schema->nodetype & (LYS_LEAF | LYS_ANYDATA));
-    ctx = target->schema->module->ctx;
+    if (!patch || (!first && !second)) {
+        LOGARG;
+        return EXIT_FAILURE;
+    }
+    ctx = lyd_node_module(first ? first : second)->ctx;
+    *patch = NULL;
 
-    if (ctx == source->schema->module->ctx) {
-        /* source and targets are in the same context */
-        if (target->schema->nodetype == LYS_LEAF) {
-            trg_leaf = (struct lyd_node_leaf_list *)target;
-            src_leaf = (struct lyd_node_leaf_list *)source;
+    diff = lyd_diff(first, second, options);
+    if (!diff) {
+        return EXIT_FAILURE;
+    }
 
-            lydict_remove(ctx, trg_leaf->value_str);
-            trg_leaf->value_str = lydict_insert(ctx, src_leaf->value_str, 0);
-            trg_leaf->value_type = src_leaf->value_type;
-            if (trg_leaf->value_type == LY_TYPE_LEAFREF) {
-                trg_leaf->validity |= LYD_VAL_LEAFREF;
-                lyp_parse_value(&((struct lys_node_leaf *)trg_leaf->schema)->type, &trg_leaf->value_str,
-                                NULL, trg_leaf, NULL, NULL, 1, src_leaf->dflt, 0);
-            } else {
-                lyd_free_value(trg_leaf->value, trg_leaf->value_type, trg_leaf->value_flags,
-                               &((struct lys_node_leaf *)trg_leaf->schema)->type, trg_leaf->value_str, NULL, NULL, NULL);
-                trg_leaf->value = src_leaf->value;
-            }
-            trg_leaf->dflt = src_leaf->dflt;
+    if (lyd_patch_write(ctx, &buf, lyd_patch_magic, sizeof lyd_patch_magic)) {
+        goto cleanup;
+    }
 
-            check_leaf_list_backlinks(target);
-        } else { /* ANYDATA */
-            trg_any = (struct lyd_node_anydata *)target;
-            src_any = (struct lyd_node_anydata *)source;
+    /* deleted nodes, they are never parents of the changed ones */
+    op = LYD_PATCH_DELETE;
+    for (i = 0; diff->type[i] != LYD_DIFF_END; ++i) {
+        if ((diff->type[i] == LYD_DIFF_DELETED) && (lyd_patch_write(ctx, &buf, &op, 1)
+                || lyd_patch_write_path(ctx, &buf, diff->first[i]))) {
+            goto cleanup;
+        }
+    }
 
-            switch(trg_any->value_type) {
-            case LYD_ANYDATA_CONSTSTRING:
-            case LYD_ANYDATA_SXML:
-            case LYD_ANYDATA_JSON:
-                lydict_remove(ctx, trg_any->value.str);
-                break;
-            case LYD_ANYDATA_DATATREE:
-                lyd_free_withsiblings(trg_any->value.tree);
-                break;
-            case LYD_ANYDATA_XML:
-                lyxml_free_withsiblings(ctx, trg_any->value.xml);
-                break;
-            case LYD_ANYDATA_LYB:
-                free(trg_any->value.mem);
-                break;
-            case LYD_ANYDATA_STRING:
-            case LYD_ANYDATA_SXMLD:
-            case LYD_ANYDATA_JSOND:
-            case LYD_ANYDATA_LYBD:
-                /* dynamic strings are used only as input parameters */
-                assert(0);
-                break;
-            }
+    /* moved instances present in both trees */
+    op = LYD_PATCH_MOVE;
+    for (i = 0; diff->type[i] != LYD_DIFF_END; ++i) {
+        if ((diff->type[i] == LYD_DIFF_MOVEDAFTER1) && (lyd_patch_write(ctx, &buf, &op, 1)
+                || lyd_patch_write_path(ctx, &buf, diff->first[i]) || lyd_patch_write_path(ctx, &buf, diff->second[i]))) {
+            goto cleanup;
+        }
+    }
 
-            trg_any->value_type = src_any->value_type;
-            trg_any->value = src_any->value;
+    /* changed and created nodes merged into a single tree, created nodes keep their order */
+    for (i = 0; diff->type[i] != LYD_DIFF_END; ++i) {
+        if ((diff->type[i] != LYD_DIFF_CHANGED) && (diff->type[i] != LYD_DIFF_CREATED)) {
+            continue;
+        }
 
-            src_any->value_type = LYD_ANYDATA_DATATREE;
-            src_any->value.tree = NULL;
+        dup = lyd_dup(diff->second[i], LYD_DUP_OPT_RECURSIVE | LYD_DUP_OPT_WITH_PARENTS);
+        if (!dup) {
+            goto cleanup;
         }
-    } else {
-        /* we have different contexts for the target and source */
-        if (target->schema->nodetype == LYS_LEAF) {
-            trg_leaf = (struct lyd_node_leaf_list *)target;
-            src_leaf = (struct lyd_node_leaf_list *)source;
+        for (; dup->parent; dup = dup->parent);
 
-            lydict_remove(ctx, trg_leaf->value_str);
-            trg_leaf->value_str = lydict_insert(ctx, src_leaf->value_str, 0);
-            lyd_free_value(trg_leaf->value, trg_leaf->value_type, trg_leaf->value_flags,
-                           &((struct lys_node_leaf *)trg_leaf->schema)->type, trg_leaf->value_str, NULL, NULL, NULL);
-            trg_leaf->value_type = src_leaf->value_type;
-            trg_leaf->dflt = src_leaf->dflt;
+        if (!upsert) {
+            upsert = dup;
+        } else if (lyd_merge(upsert, dup, LYD_OPT_DESTRUCT)) {
+            goto cleanup;
+        }
+    }
+    if (upsert) {
+        op = LYD_PATCH_MERGE;
+        if (lyd_print_mem(&lyb, upsert, LYD_LYB, LYP_WITHSIBLINGS) || lyd_patch_write(ctx, &buf, &op, 1)
+                || lyd_patch_write(ctx, &buf, lyb, lyd_lyb_data_length(lyb))) {
+            goto cleanup;
+        }
+    }
 
-            switch (trg_leaf->value_type) {
-            case LY_TYPE_BINARY:
-            case LY_TYPE_STRING:
-                /* value_str pointer is shared in these cases */
-                trg_leaf->value.string = trg_leaf->value_str;
-                break;
-            case LY_TYPE_LEAFREF:
-                trg_leaf->validity |= LYD_VAL_LEAFREF;
-                lyp_parse_value(&((struct lys_node_leaf *)trg_leaf->schema)->type, &trg_leaf->value_str,
-                                NULL, trg_leaf, NULL, NULL, 1, trg_leaf->dflt, 0);
-                break;
-            case LY_TYPE_INST:
-                trg_leaf->value.instance = NULL;
-                break;
-            case LY_TYPE_UNION:
-                /* unresolved union (this must be non-validated tree), duplicate the stored string (duplicated
-                 * because of possible change of the value in case of instance-identifier) */
-                trg_leaf->value.string = lydict_insert(ctx, src_leaf->value.string, 0);
-                break;
-            case LY_TYPE_BITS:
-            case LY_TYPE_ENUM:
-            case LY_TYPE_IDENT:
-                /* in case of duplicating bits (no matter if in the same context or not) or enum and identityref into
-                 * a different context, searching for the type and duplicating the data is almost as same as resolving
-                 * the string value, so due to a simplicity, parse the value for the duplicated leaf */
-                lyp_parse_value(&((struct lys_node_leaf *)trg_leaf->schema)->type, &trg_leaf->value_str, NULL,
-                                trg_leaf, NULL, NULL, 1, trg_leaf->dflt, 1);
-                break;
-            default:
-                trg_leaf->value = src_leaf->value;
-                break;
-            }
+    /* moved created instances, the paths are the same in both trees */
+    op = LYD_PATCH_MOVE;
+    for (i = 0; diff->type[i] != LYD_DIFF_END; ++i) {
+        if ((diff->type[i] == LYD_DIFF_MOVEDAFTER2) && (lyd_patch_write(ctx, &buf, &op, 1)
+                || lyd_patch_write_path(ctx, &buf, diff->second[i]) || lyd_patch_write_path(ctx, &buf, diff->first[i]))) {
+            goto cleanup;
+        }
+    }
 
-            check_leaf_list_backlinks(target);
-        } else { /* ANYDATA */
-            trg_any = (struct lyd_node_anydata *)target;
-            src_any = (struct lyd_node_anydata *)source;
+    op = LYD_PATCH_END;
+    if (lyd_patch_write(ctx, &buf, &op, 1)) {
+        goto cleanup;
+    }
 
-            switch(trg_any->value_type) {
-            case LYD_ANYDATA_CONSTSTRING:
-            case LYD_ANYDATA_SXML:
-            case LYD_ANYDATA_JSON:
-                lydict_remove(ctx, trg_any->value.str);
-                break;
-            case LYD_ANYDATA_DATATREE:
-                lyd_free_withsiblings(trg_any->value.tree);
-                break;
-            case LYD_ANYDATA_XML:
-                lyxml_free_withsiblings(ctx, trg_any->value.xml);
-                break;
-            case LYD_ANYDATA_LYB:
-                free(trg_any->value.mem);
-                break;
-            case LYD_ANYDATA_STRING:
-            case LYD_ANYDATA_SXMLD:
-            case LYD_ANYDATA_JSOND:
-            case LYD_ANYDATA_LYBD:
-                /* dynamic strings are used only as input parameters */
-                assert(0);
-                break;
-            }
+    *patch = buf.data;
+    buf.data = NULL;
+    rc = EXIT_SUCCESS;
 
-            trg_any->value_type = src_any->value_type;
-            if ((void*)src_any->value.tree) {
-                /* there is a value to duplicate */
-                switch (trg_any->value_type) {
-                case LYD_ANYDATA_CONSTSTRING:
-                case LYD_ANYDATA_SXML:
-                case LYD_ANYDATA_JSON:
-                    trg_any->value.str = lydict_insert(ctx, src_any->value.str, 0);
-                    break;
-                case LYD_ANYDATA_DATATREE:
-                    trg_any->value.tree = lyd_dup_withsiblings_to_ctx(src_any->value.tree, 1, ctx);
-                    break;
-                case LYD_ANYDATA_XML:
-                    trg_any->value.xml = lyxml_dup_elem(ctx, src_any->value.xml, NULL, 1, 1);
-                    break;
-                case LYD_ANYDATA_LYB:
-                    len = lyd_lyb_data_length(src_any->value.mem);
-                    if (len == -1) {
-                        LOGERR(ctx, LY_EINVAL, "Invalid LYB data.");
-                        return;
-                    }
-                    trg_any->value.mem = malloc(len);
-                    LY_CHECK_ERR_RETURN(!trg_any->value.mem, LOGMEM(ctx), );
-                    memcpy(trg_any->value.mem, src_any->value.mem, len);
-                    break;
-                case LYD_ANYDATA_STRING:
-                case LYD_ANYDATA_SXMLD:
-                case LYD_ANYDATA_JSOND:
-                case LYD_ANYDATA_LYBD:
-                    /* dynamic strings are used only as input parameters */
-                    assert(0);
-                    break;
-                }
+cleanup:
+    lyd_free_diff(diff);
+    lyd_free_withsiblings(upsert);
+    free(lyb);
+    free(buf.data);
+    return rc;
+}
+
+API int
+lyd_lyb_patch_length(const char *patch)
+{
+    FUN_IN;
+
+    const char *ptr;
+    int len;
+
+    if (!patch || memcmp(patch, lyd_patch_magic, sizeof lyd_patch_magic)) {
+        return -1;
+    }
+
+    ptr = patch + sizeof lyd_patch_magic;
+    while (1) {
+        switch (*ptr++) {
+        case LYD_PATCH_END:
+            return ptr - patch;
+        case LYD_PATCH_DELETE:
+            ptr += strlen(ptr) + 1;
+            break;
+        case LYD_PATCH_MOVE:
+            ptr += strlen(ptr) + 1;
+            ptr += strlen(ptr) + 1;
+            break;
+        case LYD_PATCH_MERGE:
+            len = lyd_lyb_data_length(ptr);
+            if (len < 0) {
+                return -1;
             }
+            ptr += len;
+            break;
+        default:
+            return -1;
         }
     }
 }
 
-/* return: 0 (not equal), 1 (equal), -1 (error) */
-static int
-lyd_merge_node_schema_equal(struct lyd_node *node1, struct lyd_node *node2)
+/* find the single node of a patch path */
+static struct lyd_node *
+lyd_patch_find(struct ly_ctx *ctx, struct lyd_node *root, const char *path)
 {
-    struct lys_node *sch1;
+    struct ly_set *set = NULL;
+    struct lyd_node *node = NULL;
 
-    if (node1->schema->module->ctx == node2->schema->module->ctx) {
-        if (node1->schema != node2->schema) {
-            return 0;
-        }
+    if (root) {
+        set = lyd_find_path(root, path);
+    }
+    if (set && (set->number == 1)) {
+        node = set->set.d[0];
     } else {
-        /* the nodes are in different contexts, get the appropriate schema nodes from the
-         * same context */
-        sch1 = lyd_get_schema_inctx(node1, node2->schema->module->ctx);
-        if (!sch1) {
-            LOGERR(node2->schema->module->ctx, LY_EINVAL, "Target context does not contain a required schema node (%s:%s).",
-                   lyd_node_module(node1)->name, node1->schema->name);
-            return -1;
-        } else if (sch1 != node2->schema) {
-            /* not matching nodes */
-            return 0;
-        }
+        LOGERR(ctx, LY_EINVAL, "LYB patch does not apply, node \"%s\" not found.", path);
     }
-
-    return 1;
+    ly_set_free(set);
+    return node;
 }
 
-/* return: 0 (not equal), 1 (equal), 2 (equal and state leaf-/list marked), -1 (error) */
-static int
-lyd_merge_node_equal(struct lyd_node *node1, struct lyd_node *node2)
+API int
+lyd_lyb_patch_apply(struct ly_ctx *ctx, struct lyd_node **root, const char *patch, int options)
 {
-    int ret;
+    FUN_IN;
 
-    switch (node1->schema->nodetype) {
-    case LYS_CONTAINER:
-    case LYS_LEAF:
-    case LYS_ANYXML:
-    case LYS_ANYDATA:
-    case LYS_RPC:
-    case LYS_ACTION:
-    case LYS_NOTIF:
-        return 1;
-    case LYS_LEAFLIST:
-        if (node1->validity & LYD_VAL_INUSE) {
-            /* this instance was already matched, we want to find another so that the number of the istances matches */
-            assert(node1->schema->flags & LYS_CONFIG_R);
-            return 0;
-        }
+    struct lyd_node *node, *after, *tree;
+    const char *path;
+    int len;
 
-        ret = lyd_list_equal(node1, node2, 1);
-        if ((ret == 1) && (node1->schema->flags & LYS_CONFIG_R)) {
-            /* mark it as matched */
-            node1->validity |= LYD_VAL_INUSE;
-            ret = 2;
-        }
-        return ret;
-    case LYS_LIST:
-        if (node1->validity & LYD_VAL_INUSE) {
-            /* this instance was already matched, we want to find another so that the number of the istances matches */
-            assert(!((struct lys_node_list *)node1->schema)->keys_size);
-            return 0;
+    if (!ctx || !root || !patch) {
+        LOGARG;
+        return EXIT_FAILURE;
+    }
+    if (memcmp(patch, lyd_patch_magic, sizeof lyd_patch_magic)) {
+        LOGERR(ctx, LY_EINVAL, "Invalid LYB patch magic number.");
+        return EXIT_FAILURE;
+    }
+
+    patch += sizeof lyd_patch_magic;
+    while (*patch != LYD_PATCH_END) {
+        switch (*patch++) {
+        case LYD_PATCH_DELETE:
+            node = lyd_patch_find(ctx, *root, patch);
+            if (!node) {
+                return EXIT_FAILURE;
+            }
+            patch += strlen(patch) + 1;
+
+            if (node == *root) {
+                *root = node->next;
+            }
+            lyd_free(node);
+            break;
+        case LYD_PATCH_MOVE:
+            path = patch;
+            patch += strlen(patch) + 1;
+            node = lyd_patch_find(ctx, *root, path);
+            after = patch[0] ? lyd_patch_find(ctx, *root, patch) : NULL;
+            if (!node || (patch[0] && !after)) {
+                return EXIT_FAILURE;
+            }
+            patch += strlen(patch) + 1;
+
+            if (after) {
+                if (lyd_insert_after(after, node)) {
+                    return EXIT_FAILURE;
+                }
+            } else {
+                /* the first instance */
+                for (after = node->parent ? node->parent->child : *root; after->schema != node->schema; after = after->next);
+                if ((after != node) && lyd_insert_before(after, node)) {
+                    return EXIT_FAILURE;
+                }
+            }
+            break;
+        case LYD_PATCH_MERGE:
+            len = lyd_lyb_data_length(patch);
+            if (len < 0) {
+                LOGERR(ctx, LY_EINVAL, "Invalid LYB data in the LYB patch.");
+                return EXIT_FAILURE;
+            }
+            tree = lyd_parse_mem(ctx, patch, LYD_LYB, options);
+            if (!tree) {
+                return EXIT_FAILURE;
+            }
+            patch += len;
+
+            if (!*root) {
+                *root = tree;
+            } else if (lyd_merge(*root, tree, LYD_OPT_DESTRUCT)) {
+                return EXIT_FAILURE;
+            }
+            break;
+        default:
+            LOGERR(ctx, LY_EINVAL, "Invalid LYB patch record type \"0x%02x\".", (uint8_t)patch[-1]);
+            return EXIT_FAILURE;
         }
 
-        ret = lyd_list_equal(node1, node2, 1);
-        if ((ret == 1) && !((struct lys_node_list *)node1->schema)->keys_size) {
-            /* mark it as matched */
-            node1->validity |= LYD_VAL_INUSE;
-            ret = 2;
+        /* a top-level node may have been moved before the first one */
+        while (*root && (*root)->prev->next) {
+            *root = (*root)->prev;
         }
-        return ret;
-    default:
-        break;
     }
 
-    LOGINT(node2->schema->module->ctx);
-    return -1;
+    return EXIT_SUCCESS;
 }
 
-/* spends source */
-static int
-lyd_merge_parent_children(struct lyd_node *target, struct lyd_node *source, int options)
+static void
+lyd_insert_setinvalid(struct lyd_node *node)
 {
-    struct lyd_node *trg_parent, *src, *src_backup, *src_elem, *src_elem_backup, *src_next, *trg_child, *trg_parent_backup;
-    int ret, clear_flag = 0;
-    struct ly_ctx *ctx = target->schema->module->ctx; /* shortcut */
-
-    LY_TREE_FOR_SAFE(source, src_backup, src) {
-        for (src_elem = src_next = src, trg_parent = target;
-            src_elem;
-            src_elem = src_next) {
-
-            /* it won't get inserted in this case */
-            if (src_elem->dflt && (options & LYD_OPT_EXPLICIT)) {
-                if (src_elem == src) {
-                    /* we are done with this subtree in this case */
-                    break;
-                }
-                trg_child = (struct lyd_node *)1;
-                goto src_skip;
-            }
+    struct lyd_node *next, *elem, *parent_list;
 
-            ret = 0;
+    assert(node);
 
-#ifdef LY_ENABLED_CACHE
-            struct lyd_node **trg_child_p;
+    /* overall validity of the node itself */
+    node->validity = ly_new_node_validity(node->schema) | (node->validity & LYD_VAL_SUBTREE);
+    lyd_val_mark_parents(node);
 
-            /* trees are supposed to be validated so all nodes must have their hash, but lets not be that strict */
-            if (!src_elem->hash) {
-                lyd_hash(src_elem);
+    /* explore changed unique leaves */
+    /* first, get know if there is a list in parents chain */
+    for (parent_list = node->parent;
+         parent_list && parent_list->schema->nodetype != LYS_LIST;
+         parent_list = parent_list->parent);
+    if (parent_list && !(parent_list->validity & LYD_VAL_UNIQUE)) {
+        /* there is a list, so check if we inserted a leaf supposed to be unique */
+        for (elem = node; elem; elem = next) {
+            if (elem->schema->nodetype == LYS_LIST) {
+                /* stop searching to the depth, children would be unique to a list in subtree */
+                goto nextsibling;
             }
 
-            if (trg_parent->ht) {
-                trg_child = NULL;
-                if (!lyht_find(trg_parent->ht, &src_elem, src_elem->hash, (void **)&trg_child_p)) {
-                    trg_child = *trg_child_p;
-                    ret = 1;
-
-                    /* it is a bit more difficult with keyless state lists and leaf-lists */
-                    if (((trg_child->schema->nodetype == LYS_LIST) && !((struct lys_node_list *)trg_child->schema)->keys_size)
-                            || ((trg_child->schema->nodetype == LYS_LEAFLIST) && (trg_child->schema->flags & LYS_CONFIG_R))) {
-                        assert(trg_child->schema->flags & LYS_CONFIG_R);
-
-                        while (trg_child && (trg_child->validity & LYD_VAL_INUSE)) {
-                            /* state lists, find one not-already-found */
-                            if (lyht_find_next(trg_parent->ht, &trg_child, trg_child->hash, (void **)&trg_child_p)) {
-                                trg_child = NULL;
-                            } else {
-                                trg_child = *trg_child_p;
-                            }
-                        }
-                        if (trg_child) {
-                            /* mark it as matched */
-                            trg_child->validity |= LYD_VAL_INUSE;
-                            ret = 2;
-                        } else {
-                            /* actually, it was matched already and no other instance found, so now not a match */
-                            ret = 0;
-                        }
-                    }
-                }
-            } else
-#endif
-            {
-                LY_TREE_FOR(trg_parent->child, trg_child) {
-                    /* schema match, data match? */
-                    ret = lyd_merge_node_schema_equal(trg_child, src_elem);
-                    if (ret == 1) {
-                        ret = lyd_merge_node_equal(trg_child, src_elem);
-                    }
-                    if (ret != 0) {
-                        /* even data match */
-                        break;
-                    }
-                }
+            if (elem->schema->nodetype == LYS_LEAF && (elem->schema->flags & LYS_UNIQUE)) {
+                /* set flag to list for future validation */
+                parent_list->validity |= LYD_VAL_UNIQUE;
+                break;
             }
 
-            if (ret > 0) {
-                if (trg_child->schema->nodetype & (LYS_LEAF | LYS_ANYDATA)) {
-                    lyd_merge_node_update(trg_child, src_elem);
-                } else if (ret == 2) {
-                    clear_flag = 1;
+            if (elem->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST | LYS_ANYDATA)) {
+                if (elem == node) {
+                    /* stop the loop */
+                    break;
                 }
-            } else if (ret == -1) {
-                /* error */
-                lyd_free_withsiblings(source);
-                return 1;
+                goto nextsibling;
             }
 
-            /* first prepare for the next iteration */
-            src_elem_backup = src_elem;
-            trg_parent_backup = trg_parent;
-            if (((src_elem->schema->nodetype == LYS_CONTAINER) || ((src_elem->schema->nodetype == LYS_LIST)
-                    && ((struct lys_node_list *)src_elem->schema)->keys_size)) && src_elem->child && trg_child) {
-                /* go into children */
-                src_next = src_elem->child;
-                trg_parent = trg_child;
-            } else {
-src_skip:
-                /* no children (or the whole subtree will be inserted), try siblings */
-                if (src_elem == src) {
-                    /* we are done with this subtree */
-                    if (trg_child) {
-                        /* it's an empty container, list without keys, or an already-updated leaf/anydata, nothing else to do */
+            /* select next elem to process */
+            /* go into children */
+            next = elem->child;
+            /* go through siblings */
+            if (!next) {
+nextsibling:
+                next = elem->next;
+                if (!next) {
+                    /* no sibling */
+                    if (elem == node) {
+                        /* we are done, back in start node */
                         break;
-                    } else {
-                        /* ... but we still need to insert it */
-                        src_next = NULL;
-                        goto src_insert;
                     }
-                } else {
-                    src_next = src_elem->next;
-                    /* trg_parent does not change */
-                }
-            }
-            while (!src_next) {
-                src_elem = src_elem->parent;
-                if (src_elem->parent == src->parent) {
-                    /* we are done, no next element to process */
+                }
+            }
+            /* go back to parents */
+            while (!next) {
+                elem = elem->parent;
+                if (elem->parent == node->parent) {
+                    /* we are done, back in start node */
                     break;
                 }
+                /* parent was actually already processed, so go to the parent's sibling */
+                next = elem->parent->next;
+            }
+        }
+    }
 
-                /* parent is already processed, go to its sibling */
-                src_next = src_elem->next;
-                trg_parent = trg_parent->parent;
+    if (node->parent) {
+        /* if the inserted node is list/leaflist with constraint on max instances or extension validation callback,
+         * invalidate the parent to make it validate this */
+        if ((node->schema->nodetype & LYS_LEAFLIST) && ((struct lys_node_leaflist *)node->schema)->max) {
+            node->parent->validity |= LYD_VAL_MAND;
+        } else if ((node->schema->nodetype & LYS_LIST) && ((struct lys_node_list *)node->schema)->max) {
+            node->parent->validity |= LYD_VAL_MAND;
+        } else {
+            /* invalidate all parents that have an extension with a validation
+             * callback for their whole subtree */
+            next = node->parent;
+            while (next) {
+                if ((next->schema->flags & LYS_VALID_EXT) && (next->schema->flags & LYS_VALID_EXT_SUBTREE))
+                    next->validity |= LYD_VAL_MAND;
+                next = next->parent;
             }
+        }
+    }
+}
 
-            if (!trg_child) {
-src_insert:
-                /* we need to insert the whole subtree */
-                if (ctx == src_elem_backup->schema->module->ctx) {
-                    /* same context - unlink the subtree and insert it into the target */
-                    lyd_unlink(src_elem_backup);
-                } else {
-                    /* different contexts - before inserting subtree, instead of unlinking, duplicate it into the
-                     * target context */
-                    src_elem_backup = lyd_dup_to_ctx(src_elem_backup, 1, ctx);
-                }
+static void
+lyd_replace(struct lyd_node *orig, struct lyd_node *repl)
+{
+    struct lyd_node *iter, *last, *parent, *prev;
 
-                if (src_elem == source) {
-                    /* it will be linked into another data tree and the pointers changed */
-                    source = source->next;
-                }
+    if (!repl) {
+        /* remove the old one */
+        goto finish;
+    }
 
-                /* insert subtree into the target */
-                if (lyd_insert(trg_parent_backup, src_elem_backup)) {
-                    LOGINT(ctx);
-                    lyd_free_withsiblings(source);
-                    return 1;
-                }
-                if (src_elem == src) {
-                    /* we are finished for this src */
-                    break;
-                }
-            }
+    if (!repl->next && lyd_txn_cur && lyd_txn_owns(orig)) {
+        /* recorded as unlinking the old node, it is freed by the transaction commit */
+        parent = orig->parent;
+        prev = (orig->prev->next ? orig->prev : NULL);
+        iter = orig->next;
+        lyd_unlink_internal(orig, 1);
+        lyd_link_at(repl, parent, prev, iter);
+        goto finish;
+    }
+
+    if (repl->parent || repl->prev->next) {
+        /* isolate the new node */
+        repl->next = NULL;
+        repl->prev = repl;
+        last = repl;
+    } else {
+        /* get the last node of a possible list of nodes to be inserted */
+        for (last = repl; last->next; last = last->next) {
+            /* part of the parent changes */
+            last->parent = orig->parent;
         }
     }
 
-    lyd_free_withsiblings(source);
-    if (clear_flag) {
-        return 2;
+    /* parent */
+    if (orig->parent && (orig->parent->child == orig)) {
+        orig->parent->child = repl;
+    }
+
+    /* predecessor */
+    if (orig->prev == orig) {
+        /* the old was alone */
+        goto finish;
+    }
+    if (orig->prev->next) {
+        orig->prev->next = repl;
+    }
+    repl->prev = orig->prev;
+    orig->prev = orig;
+
+    /* successor */
+    if (orig->next) {
+        orig->next->prev = last;
+        last->next = orig->next;
+        orig->next = NULL;
+    } else {
+        /* fix the last pointer */
+        if (repl->parent) {
+            repl->parent->child->prev = last;
+        } else {
+            /* get the first sibling */
+            for (iter = repl; iter->prev != orig; iter = iter->prev);
+            iter->prev = last;
+        }
+    }
+
+finish:
+    /* remove the old one */
+    lyd_free(orig);
+}
+
+static uint32_t
+lys_module_pos(struct lys_module *module)
+{
+    int i;
+    uint32_t pos = 1;
+
+    for (i = 0; i < module->ctx->models.used; ++i) {
+        if (module->ctx->models.list[i] == module) {
+            return pos;
+        }
+        ++pos;
     }
+
+    LOGINT(module->ctx);
     return 0;
 }
 
-/* spends source */
+/* get the first schema sibling of a data node schema, skipping choices, cases and uses */
+static struct lys_node *
+lys_data_first_sibling(struct lys_node *schema)
+{
+    /* find the data node schema parent */
+    while (lys_parent(schema) && (lys_parent(schema)->nodetype & (LYS_CHOICE | LYS_CASE | LYS_USES))) {
+        schema = lys_parent(schema);
+    }
+
+    /* find the beginning */
+    if (lys_parent(schema)) {
+        schema = lys_parent(schema)->child;
+    } else {
+        while (schema->prev->next) {
+            schema = schema->prev;
+        }
+    }
+
+    return schema;
+}
+
+/* compare the schema order of two sibling data nodes the same way as lyd_schema_sort() does */
 static int
-lyd_merge_siblings(struct lyd_node *target, struct lyd_node *source, int options)
+lys_node_order_cmp(struct lys_node *schema1, struct lys_node *schema2)
 {
-    struct lyd_node *trg, *src, *src_backup, *ins;
-    int ret, clear_flag = 0;
-    struct ly_ctx *ctx = target->schema->module->ctx; /* shortcut */
+    const struct lys_node *next = NULL;
+    struct lys_module *mod1, *mod2;
+    struct lys_node *first;
 
-    while (target->prev->next) {
-        target = target->prev;
+    if (schema1 == schema2) {
+        return 0;
     }
 
-    LY_TREE_FOR_SAFE(source, src_backup, src) {
-        LY_TREE_FOR(target, trg) {
-            /* sibling found, merge it */
-            ret = lyd_merge_node_schema_equal(trg, src);
-            if (ret == 1) {
-                ret = lyd_merge_node_equal(trg, src);
-            }
-            if (ret > 0) {
-                if (ret == 2) {
-                    clear_flag = 1;
-                }
+    mod1 = lys_node_module(schema1);
+    mod2 = lys_node_module(schema2);
+    if (mod1 != mod2) {
+        return (lys_module_pos(mod1) > lys_module_pos(mod2)) ? 1 : -1;
+    }
 
-                switch (trg->schema->nodetype) {
-                case LYS_LEAF:
-                case LYS_ANYXML:
-                case LYS_ANYDATA:
-                    lyd_merge_node_update(trg, src);
-                    break;
-                case LYS_LEAFLIST:
-                    /* it's already there, nothing to do */
-                    break;
-                case LYS_LIST:
-                case LYS_CONTAINER:
-                case LYS_NOTIF:
-                case LYS_RPC:
-                case LYS_INPUT:
-                case LYS_OUTPUT:
-                    ret = lyd_merge_parent_children(trg, src->child, options);
-                    if (ret == 2) {
-                        clear_flag = 1;
-                    } else if (ret) {
-                        lyd_free_withsiblings(source);
-                        return 1;
-                    }
-                    break;
-                default:
-                    LOGINT(ctx);
-                    lyd_free_withsiblings(source);
-                    return 1;
-                }
-                break;
-            } else if (ret == -1) {
-                lyd_free_withsiblings(source);
-                return 1;
-            } /* else not equal, nothing to do */
+    first = lys_data_first_sibling(schema1);
+    while ((next = lys_getnext(next, lys_parent(first), mod1, LYS_GETNEXT_NOSTATECHECK))) {
+        if (next == schema1) {
+            return -1;
+        } else if (next == schema2) {
+            return 1;
         }
+    }
 
-        /* sibling not found, insert it */
-        if (!trg) {
-            if (ctx != src->schema->module->ctx) {
-                ins = lyd_dup_to_ctx(src, 1, ctx);
-            } else {
-                lyd_unlink(src);
-                if (src == source) {
-                    /* just so source is not freed, we inserted it and need it further */
-                    source = src_backup;
-                }
-                ins = src;
+    LOGINT(mod1->ctx);
+    return 0;
+}
+
+/* insert a single node into the siblings starting with *start according to the schema order */
+static void
+lyd_insert_ordered(struct lyd_node *parent, struct lyd_node **start, struct lyd_node *ins)
+{
+    struct lyd_node *iter;
+    struct lys_node *schema = NULL;
+
+    /* find the last sibling not following the node in the schema order, instances of the same
+     * schema node are compared only once */
+    for (iter = (*start)->prev; iter; iter = (iter == *start) ? NULL : iter->prev) {
+        if (iter->schema != schema) {
+            if (lys_node_order_cmp(iter->schema, ins->schema) <= 0) {
+                break;
             }
-            lyd_insert_after(target->prev, ins);
+            schema = iter->schema;
         }
     }
 
-    lyd_free_withsiblings(source);
-    if (clear_flag) {
-        return 2;
+    if (!iter) {
+        /* the first sibling */
+        ins->next = *start;
+        ins->prev = (*start)->prev;
+        (*start)->prev = ins;
+        *start = ins;
+        if (parent) {
+            parent->child = ins;
+        }
+    } else if (!iter->next) {
+        /* the last sibling */
+        iter->next = ins;
+        ins->prev = iter;
+        (*start)->prev = ins;
+    } else {
+        ins->next = iter->next;
+        ins->prev = iter;
+        iter->next->prev = ins;
+        iter->next = ins;
     }
-    return 0;
 }
 
-API int
-lyd_merge_to_ctx(struct lyd_node **trg, const struct lyd_node *src, int options, struct ly_ctx *ctx)
+int
+lyd_insert_common(struct lyd_node *parent, struct lyd_node **sibling, struct lyd_node *node, int invalidate)
 {
-    FUN_IN;
+    struct lys_node *par1, *par2;
+    const struct lys_node *siter;
+    struct lyd_node *start, *iter, *ins, *next1, *next2;
+    int invalid = 0, isrpc = 0, clrdflt = 0, ordered, owned;
+    struct ly_set *llists = NULL;
+    int i;
+    uint8_t pos;
+    int stype = LYS_INPUT | LYS_OUTPUT;
 
-    struct lyd_node *node = NULL, *node2, *target, *trg_merge_start, *src_merge_start = NULL;
-    const struct lyd_node *iter;
-    struct lys_node *src_snode, *sch = NULL;
-    int i, src_depth, depth, first_iter, ret, dflt = 1;
-    const struct lys_node *parent = NULL;
+    assert(parent || sibling);
 
-    if (!trg || !(*trg) || !src) {
-        LOGARG;
-        return -1;
+    ordered = node->schema->module->ctx->models.flags & LY_CTX_ORDERED_DATA;
+    owned = lyd_txn_cur && (lyd_txn_owns(parent ? parent : *sibling) || lyd_txn_owns(node));
+
+    /* get first sibling */
+    if (parent) {
+        start = parent->child;
+    } else {
+        for (start = *sibling; start->prev->next; start = start->prev);
+    }
+
+    /* check placing the node to the appropriate place according to the schema */
+    if (!start) {
+        if (!parent) {
+            /* empty tree to insert */
+            if (node->parent || node->prev->next) {
+                /* unlink the node first */
+                lyd_unlink_internal(node, 1);
+            } /* else insert also node's siblings */
+            *sibling = node;
+            return EXIT_SUCCESS;
+        }
+        par1 = parent->schema;
+        if (par1->nodetype & (LYS_RPC | LYS_ACTION)) {
+            /* it is not clear if the tree being created is going to
+             * be rpc (LYS_INPUT) or rpc-reply (LYS_OUTPUT) so we have to
+             * compare against LYS_RPC or LYS_ACTION in par2
+             */
+            stype = LYS_RPC | LYS_ACTION;
+        }
+    } else if (parent && (parent->schema->nodetype & (LYS_RPC | LYS_ACTION))) {
+        par1 = parent->schema;
+        stype = LYS_RPC | LYS_ACTION;
+    } else {
+        for (par1 = lys_parent(start->schema);
+             par1 && !(par1->nodetype & (LYS_CONTAINER | LYS_LIST | LYS_INPUT | LYS_OUTPUT | LYS_NOTIF));
+             par1 = lys_parent(par1));
+    }
+    for (par2 = lys_parent(node->schema);
+         par2 && !(par2->nodetype & (LYS_CONTAINER | LYS_LIST | stype | LYS_NOTIF));
+         par2 = lys_parent(par2));
+    if (par1 != par2) {
+        LOGERR(parent->schema->module->ctx, LY_EINVAL, "Cannot insert, different parents (\"%s\" and \"%s\").",
+               (par1 ? par1->name : "<top-lvl>"), (par2 ? par2->name : "<top-lvl>"));
+        return EXIT_FAILURE;
     }
-    target = *trg;
-
-    parent = lys_parent(target->schema);
 
-    /* go up all uses */
-    while (parent && (parent->nodetype == LYS_USES)) {
-        parent = lys_parent(parent);
+    if (invalidate) {
+        invalid = isrpc = lyp_is_rpc_action(node->schema);
+        if (!parent || node->parent != parent || isrpc) {
+            /* it is not just moving under a parent node or it is in an RPC where
+             * nodes order matters, so the validation will be necessary */
+            invalid++;
+        }
     }
 
-    if (parent && !lyp_get_yang_data_template_name(target)) {
-        LOGERR(parent->module->ctx, LY_EINVAL, "Target not a top-level data tree.");
-        return -1;
+    /* unlink only if it is not a list of siblings without a parent and node is not the first sibling */
+    if (node->parent || node->prev->next) {
+        /* do it permanent if the parents are not exact same or if it is top-level */
+        lyd_unlink_internal(node, invalid);
     }
 
-    /* get know if we are converting data into a different context */
-    if (ctx && target->schema->module->ctx != ctx) {
-        /* target's data tree context differs from the target context, move the target
-         * data tree into the target context */
-
-        /* get the first target's top-level and store it as the result */
-        for (; target->prev->next; target = target->prev);
-        *trg = target;
+    llists = ly_set_new();
 
-        for (node = NULL, trg_merge_start = target; target; target = target->next) {
-            node2 = lyd_dup_to_ctx(target, 1, ctx);
-            if (!node2) {
+    /* process the nodes to insert one by one */
+    LY_TREE_FOR_SAFE(node, next1, ins) {
+        if (invalid == 1) {
+            /* auto delete nodes from other cases, if any;
+             * this is done only if node->parent != parent */
+            if (lyv_multicases(ins, NULL, &start, 1, NULL)) {
                 goto error;
             }
-            if (node) {
-                if (lyd_insert_after(node->prev, node2)) {
-                    goto error;
-                }
-            } else {
-                node = node2;
-            }
         }
-        target = node;
-        node = NULL;
-    } else if (src->schema->module->ctx != target->schema->module->ctx) {
-        /* the source data will be converted into the target's context during the merge */
-        ctx = target->schema->module->ctx;
-    } else if (ctx == src->schema->module->ctx) {
-        /* no conversion is needed */
-        ctx = NULL;
-    }
-
-    /* find source top-level schema node */
-    for (src_snode = src->schema, src_depth = 0;
-         (src_snode = lys_parent(src_snode)) && src_snode->nodetype != LYS_EXT;
-         ++src_depth);
 
-    /* find first shared missing schema parent of the subtrees */
-    trg_merge_start = target;
-    depth = 0;
-    first_iter = 1;
-    if (src_depth) {
-        /* we are going to create missing parents in the following loop,
-         * but we will need to know a dflt flag for them. In case the newly
-         * created parent is going to have at least one non-default child,
-         * it will be also non-default, otherwise it will be the default node */
-        if (options & LYD_OPT_NOSIBLINGS) {
-            dflt = src->dflt;
-        } else {
-            LY_TREE_FOR(src, iter) {
-                if (!iter->dflt) {
-                    /* non default sibling -> parent is going to be
-                     * created also as non-default */
-                    dflt = 0;
-                    break;
-                }
-            }
-        }
-    }
-    while (1) {
-        /* going from down (source root) to up (top-level or the common node with target */
-        do {
-            for (src_snode = src->schema, i = 0; i < src_depth - depth; src_snode = lys_parent(src_snode), ++i);
-            ++depth;
-        } while (src_snode != src->schema && (src_snode->nodetype & (LYS_CHOICE | LYS_CASE | LYS_USES)));
+        /* isolate the node to be handled separately */
+        ins->prev = ins;
+        ins->next = NULL;
 
-        if (src_snode == src->schema) {
-            break;
+        iter = NULL;
+        if (!ins->dflt) {
+            clrdflt = 1;
         }
 
-        if (src_snode->nodetype != LYS_CONTAINER) {
-            /* we would have to create a list (the only data node with children except container), impossible */
-            LOGERR(ctx, LY_EINVAL, "Cannot create %s \"%s\" for the merge.", strnodetype(src_snode->nodetype), src_snode->name);
-            goto error;
-        }
+        /* are we inserting list key? */
+        if (!ins->dflt && ins->schema->nodetype == LYS_LEAF && lys_is_key((struct lys_node_leaf *)ins->schema, &pos)) {
+            /* yes, we have a key, get know its position */
+            for (i = 0, iter = parent->child;
+                    iter && i < pos && iter->schema->nodetype == LYS_LEAF;
+                    i++, iter = iter->next);
+            if (iter) {
+                /* insert list's key to the correct position - before the iter */
+                if (parent->child == iter) {
+                    parent->child = ins;
+                }
+                if (iter->prev->next) {
+                    iter->prev->next = ins;
+                }
+                ins->prev = iter->prev;
+                iter->prev = ins;
+                ins->next = iter;
 
-        /* have we created any missing containers already? if we did,
-         * it is totally useless to search for match, there won't ever be */
-        if (!src_merge_start) {
-            if (first_iter) {
-                node = trg_merge_start;
-                first_iter = 0;
-            } else {
-                node = trg_merge_start->child;
+                /* update start element */
+                if (parent->child != start) {
+                    start = parent->child;
+                }
             }
 
-            /* find it in target data nodes */
-            LY_TREE_FOR(node, node) {
-                if (ctx) {
-                    /* we have the schema nodes in the different context */
-                    sch = lys_get_schema_inctx(src_snode, ctx);
-                    if (!sch) {
-                        LOGERR(ctx, LY_EINVAL, "Target context does not contain schema node for the data node being "
-                               "merged (%s:%s).", lys_node_module(src_snode)->name, src_snode->name);
-                        goto error;
+            /* try to find previously present default instance to replace */
+        } else if (ins->schema->nodetype == LYS_LEAFLIST) {
+            i = (int)llists->number;
+            if ((ly_set_add(llists, ins->schema, 0) != i) || ins->dflt) {
+                /* each leaf-list must be cleared only once (except when looking for exact same existing dflt nodes) */
+                LY_TREE_FOR_SAFE(start, next2, iter) {
+                    if (iter->schema == ins->schema) {
+                        if ((ins->dflt && (!iter->dflt || ((iter->schema->flags & LYS_CONFIG_W) &&
+                                                           !strcmp(((struct lyd_node_leaf_list *)iter)->value_str,
+                                                                  ((struct lyd_node_leaf_list *)ins)->value_str))))
+                                || (!ins->dflt && iter->dflt)) {
+                            if (iter == start) {
+                                start = next2;
+                            }
+                            lyd_free(iter);
+                        }
                     }
-                } else {
-                    /* the context is same and comparison of the schema nodes will works fine */
-                    sch = src_snode;
                 }
-
-                if (node->schema == sch) {
-                    trg_merge_start = node;
+            }
+        } else if (ins->schema->nodetype == LYS_LEAF || (ins->schema->nodetype == LYS_CONTAINER
+                        && !((struct lys_node_container *)ins->schema)->presence)) {
+            LY_TREE_FOR(start, iter) {
+                if (iter->schema == ins->schema) {
+                    if (ins->dflt || iter->dflt) {
+                        /* replace existing (either explicit or default) node with the new (either explicit or default) node */
+                        lyd_replace(iter, ins);
+                    } else {
+                        /* keep both explicit nodes, let the caller solve it later */
+                        iter = NULL;
+                    }
                     break;
                 }
             }
-
-            if (!(options & LYD_OPT_DESTRUCT)) {
-                /* the source tree will be duplicated, so to save some work in case
-                 * of different target context, create also the parents nodes in the
-                 * correct context */
-                src_snode = sch;
-            }
-        } else if (ctx && !(options & LYD_OPT_DESTRUCT)) {
-            /* get the schema node in the correct (target) context, same as above,
-             * this is done to save some work and have the source in the same context
-             * when the provided source tree is below duplicated in the target context
-             * and connected into the parents created here */
-            src_snode = lys_get_schema_inctx(src_snode, ctx);
-            if (!src_snode) {
-                LOGERR(ctx, LY_EINVAL, "Target context does not contain schema node for the data node being "
-                       "merged (%s:%s).", lys_node_module(src_snode)->name, src_snode->name);
-                goto error;
-            }
         }
 
-        if (!node) {
-            /* it is not there, create it */
-            node2 = _lyd_new(NULL, src_snode, dflt);
-            if (!src_merge_start) {
-                src_merge_start = node2;
-            } else {
-                if (lyd_insert(node2, src_merge_start)) {
-                    goto error;
+        if (!iter) {
+            if (!start) {
+                /* add as the only child of the parent */
+                start = ins;
+                if (parent) {
+                    parent->child = ins;
                 }
-                src_merge_start = node2;
+            } else if (isrpc) {
+                /* add to the specific position in rpc/rpc-reply/action */
+                for (par1 = ins->schema->parent; !(par1->nodetype & (LYS_INPUT | LYS_OUTPUT)); par1 = lys_parent(par1));
+                siter = NULL;
+                LY_TREE_FOR(start, iter) {
+                    while ((siter = lys_getnext(siter, par1, lys_node_module(par1), 0))) {
+                        if (iter->schema == siter || ins->schema == siter) {
+                            break;
+                        }
+                    }
+                    if (ins->schema == siter) {
+                        if ((siter->nodetype & (LYS_LEAFLIST | LYS_LIST)) && iter->schema == siter) {
+                            /* we are inserting leaflist/list instance, but since there are already
+                             * some instances of the same leaflist/list, we want to insert the new one
+                             * as the last instance, so here we have to move on */
+                            while (iter && iter->schema == siter) {
+                                iter = iter->next;
+                            }
+                            if (!iter) {
+                                break;
+                            }
+                        }
+                        /* we have the correct place for new node (before the iter) */
+                        if (iter == start) {
+                            start = ins;
+                            if (parent) {
+                                parent->child = ins;
+                            }
+                        } else {
+                            iter->prev->next = ins;
+                        }
+                        ins->prev = iter->prev;
+                        iter->prev = ins;
+                        ins->next = iter;
+
+                        /* we are done */
+                        break;
+                    }
+                }
+                if (!iter) {
+                    /* add as the last child of the parent */
+                    start->prev->next = ins;
+                    ins->prev = start->prev;
+                    start->prev = ins;
+                }
+            } else if (ordered) {
+                /* add to the position given by the schema order */
+                lyd_insert_ordered(parent, &start, ins);
+            } else {
+                /* add as the last child of the parent */
+                start->prev->next = ins;
+                ins->prev = start->prev;
+                start->prev = ins;
             }
         }
-    }
 
-    /* process source according to options */
-    if (options & LYD_OPT_DESTRUCT) {
-        LY_TREE_FOR(src, iter) {
-            check_leaf_list_backlinks((struct lyd_node *)iter);
-            if (options & LYD_OPT_NOSIBLINGS) {
-                break;
-            }
+#ifdef LY_ENABLED_CACHE
+        lyd_unlink_hash(ins, ins->parent);
+#endif
+
+        ins->parent = parent;
+        if (owned) {
+            lyd_txn_rec_link(ins);
         }
 
-        node = (struct lyd_node *)src;
-        if ((node->prev != node) && (options & LYD_OPT_NOSIBLINGS)) {
-            node2 = node->prev;
-            lyd_unlink(node);
-            lyd_free_withsiblings(node2);
+#ifdef LY_ENABLED_CACHE
+        /* key-less list hashes of the parents are updated only once for all the inserted nodes */
+        _lyd_insert_hash(ins, 0);
+#endif
+
+        if (invalidate) {
+            check_leaf_list_backlinks(ins);
         }
-    } else {
-        node = NULL;
-        for (; src; src = src->next) {
-            /* because we already have to duplicate it, do it in the correct context */
-            node2 = lyd_dup_to_ctx(src, 1, ctx);
-            if (!node2) {
-                lyd_free_withsiblings(node);
-                goto error;
-            }
-            if (node) {
-                if (lyd_insert_after(node->prev, node2)) {
-                    lyd_free_withsiblings(node);
-                    goto error;
-                }
-            } else {
-                node = node2;
-            }
 
-            if (options & LYD_OPT_NOSIBLINGS) {
-                break;
-            }
+        if (invalid) {
+            lyd_insert_setinvalid(ins);
         }
     }
+    ly_set_free(llists);
 
-    if (src_merge_start) {
-        /* insert data into the created parents */
-        /* first, get the lowest created parent, we don't have to check the nodetype since we are
-         * creating only a simple chain of containers */
-        for (node2 = src_merge_start; node2->child; node2 = node2->child);
-        node2->child = node;
-        LY_TREE_FOR(node, node) {
-            node->parent = node2;
+#ifdef LY_ENABLED_CACHE
+    lyd_keyless_list_hash_change(parent);
+#endif
+
+    if (clrdflt) {
+        /* remove the dflt flag from parents */
+        for (iter = parent; iter && iter->dflt; iter = iter->parent) {
+            if (owned) {
+                lyd_txn_rec_dflt(iter);
+            }
+            iter->dflt = 0;
         }
-    } else {
-        src_merge_start = node;
     }
 
-    if (!first_iter) {
-        /* !! src_merge start is a child(ren) of trg_merge_start */
-        ret = lyd_merge_parent_children(trg_merge_start, src_merge_start, options);
-    } else {
-        /* !! src_merge start is a (top-level) sibling(s) of trg_merge_start */
-        ret = lyd_merge_siblings(trg_merge_start, src_merge_start, options);
+    if (sibling) {
+        *sibling = start;
     }
-    /* it was freed whatever the return value */
-    src_merge_start = NULL;
-    if (ret == 2) {
-        /* clear remporary LYD_VAL_INUSE validation flags */
-        LY_TREE_DFS_BEGIN(target, node2, node) {
-            node->validity &= ~LYD_VAL_INUSE;
-            LY_TREE_DFS_END(target, node2, node);
-        }
-        ret = 0;
-    } else if (ret) {
-        goto error;
+    return EXIT_SUCCESS;
+
+error:
+    ly_set_free(llists);
+#ifdef LY_ENABLED_CACHE
+    lyd_keyless_list_hash_change(parent);
+#endif
+    return EXIT_FAILURE;
+}
+
+/**
+ * @brief Thread-specific batch of children being inserted into a parent, see lyd_insert_batch_start().
+ */
+static THREAD_LOCAL struct {
+    struct lyd_node *parent;    /* parent of the batch, NULL if there is none */
+    struct lyd_node *first;     /* pending nodes linked as top-level siblings, NULL if none */
+    uint32_t count;             /* number of the pending nodes */
+} insert_batch;
+
+/* append node with its siblings to the pending nodes of the batch, if possible */
+static int
+lyd_insert_batch_add(struct lyd_node *parent, struct lyd_node *node)
+{
+    struct lys_node *par;
+    struct lyd_node *last;
+
+    if (node->parent || node->prev->next || (parent->schema->nodetype & (LYS_RPC | LYS_ACTION))) {
+        /* the node must be moved or ordered, regular insert */
+        return 1;
     }
 
-    if (target->schema->nodetype == LYS_RPC) {
-        lyd_schema_sort(target, 1);
+    for (par = lys_parent(node->schema);
+         par && !(par->nodetype & (LYS_CONTAINER | LYS_LIST | LYS_INPUT | LYS_OUTPUT | LYS_NOTIF));
+         par = lys_parent(par));
+    if (par != parent->schema) {
+        /* let the regular insert report the error */
+        return 1;
     }
 
-    /* update the pointer to the target tree if needed */
-    if (*trg != target) {
-        lyd_free_withsiblings(*trg);
-        (*trg) = target;
+    for (last = node; last->next; last = last->next) {
+        ++insert_batch.count;
     }
-    return ret;
+    ++insert_batch.count;
 
-error:
-    if (*trg != target) {
-        /* target is duplication of the original target in different context,
-         * free it due to the error */
-        lyd_free_withsiblings(target);
+    if (!insert_batch.first) {
+        insert_batch.first = node;
+    } else {
+        /* connect the lists of siblings */
+        insert_batch.first->prev->next = node;
+        node->prev = insert_batch.first->prev;
+        insert_batch.first->prev = last;
     }
-    lyd_free_withsiblings(src_merge_start);
-    return -1;
+    return 0;
+}
+
+/* insert all the pending nodes of the batch */
+static int
+lyd_insert_batch_flush(void)
+{
+    struct lyd_node *iter, *first;
+    uint32_t count;
+
+    if (!insert_batch.first) {
+        return EXIT_SUCCESS;
+    }
+
+    first = insert_batch.first;
+    count = insert_batch.count;
+    insert_batch.first = NULL;
+    insert_batch.count = 0;
+
+    LY_TREE_FOR(insert_batch.parent->child, iter) {
+        ++count;
+    }
+    if (lyd_reserve_children(insert_batch.parent, count)) {
+        return EXIT_FAILURE;
+    }
+
+    return lyd_insert_common(insert_batch.parent, NULL, first, 1);
 }
 
 API int
-lyd_merge(struct lyd_node *target, const struct lyd_node *source, int options)
+lyd_insert(struct lyd_node *parent, struct lyd_node *node)
 {
     FUN_IN;
 
-    if (!target || !source) {
+    if (!node || !parent || (parent->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST | LYS_ANYDATA))) {
         LOGARG;
-        return -1;
+        return EXIT_FAILURE;
     }
 
-    return lyd_merge_to_ctx(&target, source, options, target->schema->module->ctx);
+    if (parent == insert_batch.parent) {
+        if (!lyd_insert_batch_add(parent, node)) {
+            return EXIT_SUCCESS;
+        }
+
+        /* keep the order of the children */
+        if (lyd_insert_batch_flush()) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    return lyd_insert_common(parent, NULL, node, 1);
 }
 
-API void
-lyd_free_diff(struct lyd_difflist *diff)
+API int
+lyd_insert_batch_start(struct lyd_node *parent)
 {
     FUN_IN;
 
-    if (diff) {
-        free(diff->type);
-        free(diff->first);
-        free(diff->second);
-        free(diff);
+    if (!parent || (parent->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST | LYS_ANYDATA))) {
+        LOGARG;
+        return EXIT_FAILURE;
+    }
+
+    if (insert_batch.parent) {
+        LOGERR(parent->schema->module->ctx, LY_EINVAL, "Another insert batch (into \"%s\") is in progress.",
+               insert_batch.parent->schema->name);
+        return EXIT_FAILURE;
     }
+
+    insert_batch.parent = parent;
+    return EXIT_SUCCESS;
 }
 
-static int
-lyd_difflist_add(struct lyd_difflist *diff, unsigned int *size, unsigned int index,
-                 LYD_DIFFTYPE type, struct lyd_node *first, struct lyd_node *second)
+API int
+lyd_insert_batch_commit(struct lyd_node *parent)
 {
-    void *new;
-    struct ly_ctx *ctx;
+    int ret;
 
-    assert(diff);
-    assert(size && *size);
-    assert(first || second);
+    FUN_IN;
 
-    ctx = (first ? first->schema->module->ctx : (second ? second->schema->module->ctx : NULL));
+    if (!parent || (parent != insert_batch.parent)) {
+        LOGARG;
+        return EXIT_FAILURE;
+    }
 
-    if (index + 1 == *size) {
-        /* it's time to enlarge */
-        *size = *size + 16;
-        new = realloc(diff->type, *size * sizeof *diff->type);
-        LY_CHECK_ERR_RETURN(!new, LOGMEM(ctx), EXIT_FAILURE);
-        diff->type = new;
+    ret = lyd_insert_batch_flush();
+    insert_batch.parent = NULL;
+    return ret;
+}
 
-        new = realloc(diff->first, *size * sizeof *diff->first);
-        LY_CHECK_ERR_RETURN(!new, LOGMEM(ctx), EXIT_FAILURE);
-        diff->first = new;
+API int
+lyd_reserve_children(struct lyd_node *parent, uint32_t count)
+{
+    FUN_IN;
 
-        new = realloc(diff->second, *size * sizeof *diff->second);
-        LY_CHECK_ERR_RETURN(!new, LOGMEM(ctx), EXIT_FAILURE);
-        diff->second = new;
+    if (!parent || (parent->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST | LYS_ANYDATA))) {
+        LOGARG;
+        return EXIT_FAILURE;
     }
 
-    /* insert the item */
-    diff->type[index] = type;
-    diff->first[index] = first;
-    diff->second[index] = second;
-
-    /* terminate the arrays */
-    index++;
-    diff->type[index] = LYD_DIFF_END;
-    diff->first[index] = NULL;
-    diff->second[index] = NULL;
+#ifdef LY_ENABLED_CACHE
+    if (lyd_hash_reserve(parent, count)) {
+        return EXIT_FAILURE;
+    }
+#else
+    (void)count;
+#endif
 
     return EXIT_SUCCESS;
 }
 
-struct diff_ordered_dist {
-    struct diff_ordered_dist *next;
-    int dist;
-};
-struct diff_ordered_item {
-    struct lyd_node *first;
-    struct lyd_node *second;
-    struct diff_ordered_dist *dist;
-};
-struct diff_ordered {
-    struct lys_node *schema;
-    struct lyd_node *parent;
-    unsigned int count;
-    struct diff_ordered_item *items; /* array */
-    struct diff_ordered_dist *dist;  /* linked list (1-way, ring) */
-    struct diff_ordered_dist *dist_last;  /* aux pointer for faster insertion sort */
-};
-
-static int
-diff_ordset_insert(struct lyd_node *node, struct ly_set *ordset)
+API int
+lyd_insert_sibling(struct lyd_node **sibling, struct lyd_node *node)
 {
-    unsigned int i;
-    struct diff_ordered *new_ordered, *iter;
+    FUN_IN;
 
-    for (i = 0; i < ordset->number; i++) {
-        iter = (struct diff_ordered *)ordset->set.g[i];
-        if (iter->schema == node->schema && iter->parent == node->parent) {
-            break;
-        }
+    if (!sibling || !node) {
+        LOGARG;
+        return EXIT_FAILURE;
     }
-    if (i == ordset->number) {
-        /* not seen user-ordered list */
-        new_ordered = calloc(1, sizeof *new_ordered);
-        LY_CHECK_ERR_RETURN(!new_ordered, LOGMEM(node->schema->module->ctx), EXIT_FAILURE);
-        new_ordered->schema = node->schema;
-        new_ordered->parent = node->parent;
 
-        ly_set_add(ordset, new_ordered, LY_SET_OPT_USEASLIST);
-    }
-    ((struct diff_ordered *)ordset->set.g[i])->count++;
+    return lyd_insert_common((*sibling) ? (*sibling)->parent : NULL, sibling, node, 1);
+
+}
+
+int
+lyd_insert_nextto(struct lyd_node *sibling, struct lyd_node *node, int before, int invalidate)
+{
+    struct ly_ctx *ctx;
+    struct lys_node *par1, *par2;
+    struct lyd_node *iter, *start = NULL, *ins, *next1, *next2, *last;
+    struct lyd_node *orig_parent = NULL, *orig_prev = NULL, *orig_next = NULL;
+    int invalid = 0, owned;
+    char *str;
+
+    assert(sibling);
+    assert(node);
+
+    ctx = sibling->schema->module->ctx;
 
-    return EXIT_SUCCESS;
-}
+    if (sibling == node) {
+        return EXIT_SUCCESS;
+    }
+    owned = lyd_txn_cur && (lyd_txn_owns(sibling) || lyd_txn_owns(node));
 
-static void
-diff_ordset_free(struct ly_set *set)
-{
-    unsigned int i, j;
-    struct diff_ordered *ord;
+    /* check placing the node to the appropriate place according to the schema */
+    for (par1 = lys_parent(sibling->schema);
+         par1 && !(par1->nodetype & (LYS_CONTAINER | LYS_LIST | LYS_INPUT | LYS_OUTPUT | LYS_ACTION | LYS_NOTIF));
+         par1 = lys_parent(par1));
+    for (par2 = lys_parent(node->schema);
+         par2 && !(par2->nodetype & (LYS_CONTAINER | LYS_LIST | LYS_INPUT | LYS_OUTPUT | LYS_ACTION | LYS_NOTIF));
+         par2 = lys_parent(par2));
+    if (par1 != par2) {
+        LOGERR(ctx, LY_EINVAL, "Cannot insert, different parents (\"%s\" and \"%s\").",
+               (par1 ? par1->name : "<top-lvl>"), (par2 ? par2->name : "<top-lvl>"));
+        return EXIT_FAILURE;
+    }
 
-    if (!set) {
-        return;
+    if (invalidate && ((node->parent != sibling->parent) || (invalid = lyp_is_rpc_action(node->schema)) || !node->parent)) {
+        /* a) it is not just moving under a parent node (invalid = 1) or
+         * b) it is in an RPC where nodes order matters (invalid = 2) or
+         * c) it is top-level where we don't know if it is the same tree (invalid = 1),
+         * so the validation will be necessary */
+        if (!node->parent && !invalid) {
+            /* c) search in siblings */
+            for (iter = node->prev; iter != node; iter = iter->prev) {
+                if (iter == sibling) {
+                    break;
+                }
+            }
+            if (iter == node) {
+                /* node and siblings are not currently in the same data tree */
+                invalid++;
+            }
+        } else { /* a) and b) */
+            invalid++;
+        }
     }
 
-    for (i = 0; i < set->number; i++) {
-        ord = (struct diff_ordered *)set->set.g[i];
-        for (j = 0; j < ord->count; j++) {
-            free(ord->items[j].dist);
+    /* unlink only if it is not a list of siblings without a parent or node is not the first sibling,
+     * always unlink if just moving a node */
+    if ((!invalid) || node->parent || node->prev->next) {
+        /* remember the original position to be able to revert
+         * unlink in case of error */
+        orig_parent = node->parent;
+        if (node->prev != node) {
+            orig_prev = node->prev;
         }
-        free(ord->items);
-        free(ord);
+        orig_next = node->next;
+        lyd_unlink_internal(node, invalid);
     }
 
-    ly_set_free(set);
-}
+    /* find first sibling node */
+    if (sibling->parent) {
+        start = sibling->parent->child;
+    } else {
+        for (start = sibling; start->prev->next; start = start->prev);
+    }
 
-/*
- * -1 - error
- *  0 - ok
- *  1 - first and second not the same
- */
-static int
-lyd_diff_compare(struct lyd_node *first, struct lyd_node *second, int options)
-{
-    int rc;
+    /* process the nodes one by one to clean the current tree */
+    if (!invalid) {
+        /* just moving one sibling */
+        last = node;
+        node->parent = sibling->parent;
+    } else {
+        LY_TREE_FOR_SAFE(node, next1, ins) {
+            lyd_insert_setinvalid(ins);
 
-    if (first->dflt && !(options & LYD_DIFFOPT_WITHDEFAULTS)) {
-        /* the second one cannot be default (see lyd_diff()),
-         * so the nodes differs (first one is default node) */
-        return 1;
-    }
+            if (invalid == 1) {
+                /* auto delete nodes from other cases */
+                if (lyv_multicases(ins, NULL, &start, 1, sibling) == 2) {
+                    LOGVAL(ctx, LYE_SPEC, LY_VLOG_LYD, sibling, "Insert request refers node (%s) that is going to be auto-deleted.",
+                        ly_errpath(ctx));
+                    goto error;
+                }
+            }
 
-    if (first->schema->nodetype & (LYS_LEAFLIST | LYS_LIST)) {
-        if (first->validity & LYD_VAL_INUSE) {
-            /* this node was already matched, it cannot be matched twice (except for state leaf-/lists,
-             * which we want to keep the count on this way) */
-            return 1;
+            /* try to find previously present default instance to remove because of
+            * inserting the specified node */
+            if (ins->schema->nodetype == LYS_LEAFLIST) {
+                LY_TREE_FOR_SAFE(start, next2, iter) {
+                    if (iter->schema == ins->schema) {
+                        if ((ins->dflt && (!iter->dflt || ((iter->schema->flags & LYS_CONFIG_W) &&
+                                                        !strcmp(((struct lyd_node_leaf_list *)iter)->value_str,
+                                                                ((struct lyd_node_leaf_list *)ins)->value_str))))
+                                || (!ins->dflt && iter->dflt)) {
+                            /* iter will get deleted */
+                            if (iter == sibling) {
+                                LOGERR(ctx, LY_EINVAL, "Insert request refers node (%s) that is going to be auto-deleted.",
+                                    str = lyd_path(sibling));
+                                free(str);
+                                goto error;
+                            }
+                            if (iter == start) {
+                                start = next2;
+                            }
+                            lyd_free(iter);
+                        }
+                    }
+                }
+            } else if (ins->schema->nodetype == LYS_LEAF ||
+                    (ins->schema->nodetype == LYS_CONTAINER && !((struct lys_node_container *)ins->schema)->presence)) {
+                LY_TREE_FOR(start, iter) {
+                    if (iter->schema == ins->schema) {
+                        if (iter->dflt || ins->dflt) {
+                            /* iter gets deleted */
+                            if (iter == sibling) {
+                                LOGERR(ctx, LY_EINVAL, "Insert request refers node (%s) that is going to be auto-deleted.",
+                                    str = lyd_path(sibling));
+                                free(str);
+                                goto error;
+                            }
+                            if (iter == start) {
+                                start = iter->next;
+                            }
+                            lyd_free(iter);
+                        }
+                        break;
+                    }
+                }
+            }
+
+            ins->parent = sibling->parent;
+            last = ins;
         }
+    }
 
-        rc = lyd_list_equal(first, second, (options & LYD_DIFFOPT_WITHDEFAULTS ? 1 : 0));
-        if (rc == -1) {
-            return -1;
-        } else if (!rc) {
-            /* list instances differs */
-            return 1;
+    /* insert the (list of) node(s) to the specified position */
+    if (before) {
+        if (sibling->prev->next) {
+            /* adding into the middle */
+            sibling->prev->next = node;
+        } else if (sibling->parent) {
+            /* at the beginning */
+            sibling->parent->child = node;
         }
-        /* matches */
+        node->prev = sibling->prev;
+        sibling->prev = last;
+        last->next = sibling;
+    } else { /* after */
+        if (sibling->next) {
+            /* adding into the middle - fix the prev pointer of the node after inserted nodes */
+            last->next = sibling->next;
+            sibling->next->prev = last;
+        } else {
+            /* at the end - fix the prev pointer of the first node */
+            start->prev = last;
+        }
+        sibling->next = node;
+        node->prev = sibling;
     }
 
-    return 0;
-}
+#ifdef LY_ENABLED_CACHE
+    /* now that all the nodes are correctly inserted, fix hashes (node was already unlinked) */
+    lyd_insert_hash(node);
 
-/*
- * -1 - error
- *  0 - ok
- */
-static int
-lyd_diff_match(struct lyd_node *first, struct lyd_node *second, struct lyd_difflist *diff, unsigned int *size,
-               unsigned int *i, struct ly_set *matchset, struct ly_set *ordset, int options)
-{
-    switch (first->schema->nodetype) {
-    case LYS_LEAFLIST:
-    case LYS_LIST:
-        /* additional work for future move matching in case of user ordered lists */
-        if (first->schema->flags & LYS_USERORDERED) {
-            diff_ordset_insert(first, ordset);
-        }
+    /* relink all following nodes */
+    iter = node;
+    for (iter = node; iter != last; iter = iter->next) {
+        lyd_unlink_hash(iter, iter->parent);
+        lyd_insert_hash(iter);
+    }
+#endif
 
-        /* falls through */
-    case LYS_CONTAINER:
-    case LYS_RPC:
-    case LYS_ACTION:
-    case LYS_NOTIF:
-        assert(!(second->validity & LYD_VAL_INUSE));
-        second->validity |= LYD_VAL_INUSE;
-        /* remember the matching node in first for keeping correct pointer in first
-         * for comparing when passing through the second tree in lyd_diff().
-         * Duplicities are not allowed actually, but they cannot happen since single
-         * node can match only one node in the other tree */
-        ly_set_add(matchset, first, LY_SET_OPT_USEASLIST);
-        break;
-    case LYS_LEAF:
-        /* check for leaf's modification */
-        if (!lyd_leaf_val_equal(first, second, 0) || ((options & LYD_DIFFOPT_WITHDEFAULTS) && (first->dflt != second->dflt))) {
-            if (lyd_difflist_add(diff, size, (*i)++, LYD_DIFF_CHANGED, first, second)) {
-               return -1;
+    if (owned) {
+        for (iter = node; ; iter = iter->next) {
+            lyd_txn_rec_link(iter);
+            if (iter == last) {
+                break;
             }
         }
-        break;
-    case LYS_ANYXML:
-    case LYS_ANYDATA:
-        /* check for anydata/anyxml's modification */
-        if (!lyd_anydata_equal(first, second) && lyd_difflist_add(diff, size, (*i)++, LYD_DIFF_CHANGED, first, second)) {
-            return -1;
+    }
+
+    if (invalidate) {
+        LY_TREE_FOR(node, next1) {
+            check_leaf_list_backlinks(next1);
+            if (next1 == last) {
+                break;
+            }
         }
-        break;
-    default:
-        LOGINT(first->schema->module->ctx);
-        return -1;
     }
 
-    /* mark both that they have matching instance in the other tree */
-    assert(!(first->validity & LYD_VAL_INUSE));
-    first->validity |= LYD_VAL_INUSE;
+    return EXIT_SUCCESS;
 
-    return 0;
+error:
+    /* insert back to the original position */
+    if (orig_prev) {
+        lyd_insert_after(orig_prev, node);
+    } else if (orig_next) {
+        lyd_insert_before(orig_next, node);
+    } else if (orig_parent) {
+        /* there were no siblings */
+        orig_parent->child = node;
+        node->parent = orig_parent;
+    }
+    return EXIT_FAILURE;
 }
 
-/* @brief compare if the nodes are equivalent including checking the list's keys
- * Go through the nodes and their parents and in the case of list, compare its keys.
- *
- * @return 0 different, 1 equivalent
- */
-static int
-lyd_diff_equivnode(struct lyd_node *first, struct lyd_node *second)
+API int
+lyd_insert_before(struct lyd_node *sibling, struct lyd_node *node)
 {
-    struct lyd_node *iter1, *iter2;
+    FUN_IN;
 
-    for (iter1 = first, iter2 = second; iter1 && iter2; iter1 = iter1->parent, iter2 = iter2->parent) {
-        if (iter1->schema->module->ctx == iter2->schema->module->ctx) {
-            if (iter1->schema != iter2->schema) {
-                return 0;
-            }
-        } else {
-            if (!ly_strequal(iter1->schema->name, iter2->schema->name, 0)) {
-                /* comparing the names is fine, even if they are, in fact, 2 different nodes
-                 * with equal names, some of their parents will differ */
-                return 0;
-            }
-        }
-        if (iter1->schema->nodetype == LYS_LIST) {
-            /* compare keys */
-            if (lyd_list_equal(iter1, iter2, 0) != 1) {
-                return 0;
-            }
-        }
+    if (!node || !sibling) {
+        LOGARG;
+        return EXIT_FAILURE;
     }
 
-    if (iter1 != iter2) {
-        /* we are supposed to be in root (NULL) in both trees */
-        return 0;
+    return lyd_insert_nextto(sibling, node, 1, 1);
+}
+
+API int
+lyd_insert_after(struct lyd_node *sibling, struct lyd_node *node)
+{
+    FUN_IN;
+
+    if (!node || !sibling) {
+        LOGARG;
+        return EXIT_FAILURE;
     }
 
-    return 1;
+    return lyd_insert_nextto(sibling, node, 0, 1);
 }
 
+/* position of a schema node among its siblings, cached while sorting */
+struct lys_node_pos {
+    const struct lys_node *schema;
+    uint32_t mod_pos;
+    uint32_t pos;
+};
+
 static int
-lyd_diff_move_preprocess(struct diff_ordered *ordered, struct lyd_node *first, struct lyd_node *second)
+lys_node_pos_equal(void *val1_p, void *val2_p, int UNUSED(mod), void *UNUSED(cb_data))
 {
-    struct ly_ctx *ctx = first->schema->module->ctx;
-    struct lyd_node *iter;
-    unsigned int pos = 0;
-    int abs_dist;
-    struct diff_ordered_dist *dist_aux;
-    struct diff_ordered_dist *dist_iter, *dist_last;
-    char *str = NULL;
+    return ((struct lys_node_pos *)val1_p)->schema == ((struct lys_node_pos *)val2_p)->schema;
+}
 
-    /* ordered->count was zeroed and now it is incremented with each added
-     * item's information, so it is actually position of the second node
-     */
+static uint32_t
+lys_node_pos_hash(const struct lys_node *schema)
+{
+    return dict_hash_multi(dict_hash_multi(0, (const char *)&schema, sizeof schema), NULL, 0);
+}
 
-    /* get the position of the first node */
-    for (iter = first->prev; iter->next; iter = iter->prev) {
-        if (!(iter->validity & LYD_VAL_INUSE)) {
-            /* skip deleted nodes */
-            continue;
-        }
-        if (iter->schema == first->schema) {
-            pos++;
-        }
-    }
-    if (pos != ordered->count) {
-        LOGDBG(LY_LDGDIFF, "detected moved element \"%s\" from %d to %d (distance %d)",
-               str = lyd_path(first), pos, ordered->count, ordered->count - pos);
-        free(str);
-    }
+/* learn the positions of all the schema siblings of first_sibling from its module at once */
+static void
+lys_module_node_pos_fill(struct hash_table *ht, struct lys_node *first_sibling)
+{
+    const struct lys_node *next = NULL;
+    const struct lys_module *module = lys_node_module(first_sibling);
+    struct lys_node_pos npos;
 
-    /* store information, count distance */
-    ordered->items[pos].dist = dist_aux = calloc(1, sizeof *dist_aux);
-    LY_CHECK_ERR_RETURN(!dist_aux, LOGMEM(ctx), EXIT_FAILURE);
-    ordered->items[pos].dist->dist = ordered->count - pos;
-    abs_dist = abs(ordered->items[pos].dist->dist);
-    ordered->items[pos].first = first;
-    ordered->items[pos].second = second;
-    ordered->count++;
+    npos.mod_pos = lys_module_pos((struct lys_module *)module);
+    npos.pos = 0;
 
-    /* insert sort of distances, higher first */
-    for (dist_iter = ordered->dist, dist_last = NULL;
-            dist_iter;
-            dist_last = dist_iter, dist_iter = dist_iter->next) {
-        if (abs_dist >= abs(dist_iter->dist)) {
-            /* found correct place */
-            dist_aux->next = dist_iter;
-            if (dist_last) {
-                dist_last->next = dist_aux;
-            }
-            break;
-        } else if (dist_iter->next == ordered->dist) {
-            /* last item */
-            dist_aux->next = ordered->dist; /* ring list */
-            ordered->dist_last = dist_aux;
-            break;
-        }
-    }
-    if (dist_aux->next == ordered->dist) {
-        if (ordered->dist_last == dist_aux) {
-            /* last item */
-            if (!ordered->dist) {
-                /* the only item */
-                dist_aux->next = dist_aux;
-                ordered->dist = ordered->dist_last = dist_aux;
-            }
-        } else {
-            /* first item */
-            ordered->dist = dist_aux;
-            if (dist_aux->next) {
-                /* more than one item, update the last one's next */
-                ordered->dist_last->next = dist_aux;
-            } else {
-                /* the only item */
-                ordered->dist_last = dist_aux;
-                dist_aux->next = dist_aux; /* ring list */
-            }
+    /* the schema nodes are actually from data, lys_getnext skips non-data schema nodes for us (we know the parent will not be uses) */
+    while ((next = lys_getnext(next, lys_parent(first_sibling), module, LYS_GETNEXT_NOSTATECHECK))) {
+        ++npos.pos;
+        if (lys_node_module(next) == module) {
+            npos.schema = next;
+            lyht_insert(ht, &npos, lys_node_pos_hash(next), NULL);
         }
     }
-
-    return 0;
 }
 
-static struct lyd_difflist *
-lyd_diff_init_difflist(struct ly_ctx *ctx, unsigned int *size)
+static int
+lyd_node_pos_cmp(const void *item1, const void *item2)
 {
-    struct lyd_difflist *result;
+    struct lyd_node_pos *np1, *np2;
 
-    result = malloc(sizeof *result);
-    LY_CHECK_ERR_RETURN(!result, LOGMEM(ctx); *size = 0, NULL);
+    np1 = (struct lyd_node_pos *)item1;
+    np2 = (struct lyd_node_pos *)item2;
 
-    *size = 1;
-    result->type = calloc(*size, sizeof *result->type);
-    result->first = calloc(*size, sizeof *result->first);
-    result->second = calloc(*size, sizeof *result->second);
-    if (!result->type || !result->first || !result->second) {
-        LOGMEM(ctx);
-        free(result->second);
-        free(result->first);
-        free(result->type);
-        free(result);
-        *size = 0;
-        return NULL;
+    if (np1->mod_pos != np2->mod_pos) {
+        return (np1->mod_pos > np2->mod_pos) ? 1 : -1;
     }
-
-    return result;
+    if (np1->pos != np2->pos) {
+        return (np1->pos > np2->pos) ? 1 : -1;
+    }
+    /* instances of the same node keep their order */
+    return (np1->idx > np2->idx) ? 1 : -1;
 }
 
-API struct lyd_difflist *
-lyd_diff(struct lyd_node *first, struct lyd_node *second, int options)
+API int
+lyd_schema_sort(struct lyd_node *sibling, int recursive)
 {
     FUN_IN;
 
-    struct ly_ctx *ctx;
-    int rc;
-    struct lyd_node *elem1, *elem2, *iter, *aux, *parent = NULL, *next1, *next2;
-    struct lyd_difflist *result, *result2 = NULL;
-    void *new;
-    unsigned int size, size2, index = 0, index2 = 0, i, j, k;
-    struct matchlist_s {
-        struct matchlist_s *prev;
-        struct ly_set *match;
-        unsigned int i;
-    } *matchlist = NULL, *mlaux;
-    struct ly_set *ordset = NULL;
-    struct diff_ordered *ordered;
-    struct diff_ordered_dist *dist_aux, *dist_iter;
-    struct diff_ordered_item item_aux;
+    uint32_t len, i;
+    struct lyd_node *node;
+    struct lys_node *first_ssibling;
+    struct lyd_node_pos *array;
+    struct lys_node_pos npos, *match;
+    struct hash_table *ht;
+    int sorted = 1;
 
-    if (!first) {
-        /* all nodes in second were created,
-         * but the second must be top level */
-        if (second && second->parent) {
-            LOGERR(second->schema->module->ctx, LY_EINVAL, "%s: \"first\" parameter is NULL and \"second\" is not top level.", __func__);
-            return NULL;
+    if (!sibling) {
+        LOGARG;
+        return -1;
+    }
+
+    /* something actually to sort */
+    if (sibling->prev != sibling) {
+
+        /* find the beginning */
+        sibling = lyd_first_sibling(sibling);
+
+        /* count siblings */
+        len = 0;
+        for (node = sibling; node; node = node->next) {
+            ++len;
         }
-        result = lyd_diff_init_difflist(NULL, &size);
-        LY_TREE_FOR(second, iter) {
-            if (!iter->dflt || (options & LYD_DIFFOPT_WITHDEFAULTS)) { /* skip the implicit nodes */
-                if (lyd_difflist_add(result, &size, index++, LYD_DIFF_CREATED, NULL, iter)) {
-                    goto error;
+
+        array = malloc(len * sizeof *array);
+        ht = lyht_new(8, sizeof npos, lys_node_pos_equal, NULL, 1);
+        if (!array || !ht) {
+            LOGMEM(sibling->schema->module->ctx);
+            free(array);
+            lyht_free(ht);
+            return -1;
+        }
+
+        /* fill arrays with positions and corresponding nodes, the positions of all the schema siblings
+         * are learned at once for every module */
+        for (i = 0, node = sibling; i < len; ++i, node = node->next) {
+            npos.schema = node->schema;
+            if (lyht_find(ht, &npos, lys_node_pos_hash(node->schema), (void **)&match)) {
+                first_ssibling = lys_data_first_sibling(node->schema);
+                lys_module_node_pos_fill(ht, first_ssibling);
+                if (lyht_find(ht, &npos, lys_node_pos_hash(node->schema), (void **)&match)) {
+                    LOGINT(sibling->schema->module->ctx);
+                    free(array);
+                    lyht_free(ht);
+                    return -1;
                 }
             }
-            if (options & LYD_DIFFOPT_NOSIBLINGS) {
-                break;
+
+            array[i].node = node;
+            array[i].mod_pos = match->mod_pos;
+            array[i].pos = match->pos;
+            array[i].idx = i;
+            if (i && sorted && (lyd_node_pos_cmp(&array[i - 1], &array[i]) > 0)) {
+                sorted = 0;
             }
         }
-        return result;
-    } else if (!second) {
-        /* all nodes from first were deleted */
-        result = lyd_diff_init_difflist(first->schema->module->ctx, &size);
-        LY_TREE_FOR(first, iter) {
-            if (!iter->dflt || (options & LYD_DIFFOPT_WITHDEFAULTS)) { /* skip the implicit nodes */
-                if (lyd_difflist_add(result, &size, index++, LYD_DIFF_DELETED, iter, NULL)) {
-                    goto error;
+        lyht_free(ht);
+
+        if (sorted) {
+            /* nothing to do */
+            free(array);
+            goto children;
+        }
+
+        /* sort the arrays */
+        qsort(array, len, sizeof *array, lyd_node_pos_cmp);
+
+        /* adjust siblings based on the sorted array */
+        for (i = 0; i < len; ++i) {
+            /* parent child */
+            if (i == 0) {
+                /* adjust sibling so that it still points to the beginning */
+                sibling = array[i].node;
+                if (array[i].node->parent) {
+                    array[i].node->parent->child = array[i].node;
                 }
             }
-            if (options & LYD_DIFFOPT_NOSIBLINGS) {
-                break;
+
+            /* prev */
+            if (i > 0) {
+                array[i].node->prev = array[i - 1].node;
+            } else {
+                array[i].node->prev = array[len - 1].node;
+            }
+
+            /* next */
+            if (i < len - 1) {
+                array[i].node->next = array[i + 1].node;
+            } else {
+                array[i].node->next = NULL;
             }
         }
-        return result;
+        free(array);
     }
 
-    ctx = first->schema->module->ctx;
+children:
+    /* sort all the children recursively */
+    if (recursive) {
+        LY_TREE_FOR(sibling, node) {
+            if ((node->schema->nodetype & (LYS_CONTAINER | LYS_LIST | LYS_RPC | LYS_ACTION | LYS_NOTIF))
+                    && node->child && lyd_schema_sort(node->child, recursive)) {
+                return -1;
+            }
+        }
+    }
 
-    if (options & LYD_DIFFOPT_NOSIBLINGS) {
-        /* both trees must start at the same (schema) node */
-        if (first->schema != second->schema) {
-            LOGERR(ctx, LY_EINVAL, "%s: incompatible trees to compare with LYD_OPT_NOSIBLINGS option.", __func__);
-            return NULL;
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Validate the changed data nodes among \p first and its siblings and continue recursively into the subtrees
+ * with some changes (#LYD_OPT_VAL_INCREMENTAL).
+ *
+ * @param[in] first First sibling to process.
+ * @param[in] options Validation options.
+ * @param[in] unres Unresolved data to add the conditions and references into.
+ * @param[in] changed Set to add the changed data nodes into.
+ * @return EXIT_SUCCESS on success, EXIT_FAILURE on error.
+ */
+static int
+lyd_validate_changed_r(struct lyd_node *first, int options, struct unres_data *unres, struct ly_set *changed)
+{
+    struct lyd_node *iter;
+    uint32_t val_errs;
+
+    LY_TREE_FOR(first, iter) {
+        if (!iter->validity) {
+            /* unchanged subtree */
+            continue;
         }
-        /* use first's and second's child to make comparison the same as without LYD_OPT_NOSIBLINGS */
-        first = first->child;
-        second = second->child;
-    } else {
-        /* go to the first sibling in both trees */
-        if (first->parent) {
-            first = first->parent->child;
-        } else {
-            while (first->prev->next) {
-                first = first->prev;
+
+        if (iter->parent && (iter->schema->nodetype & (LYS_ACTION | LYS_NOTIF))) {
+            LOGVAL(iter->schema->module->ctx, LYE_INELEM, LY_VLOG_LYD, iter, iter->schema->name);
+            LOGVAL(iter->schema->module->ctx, LYE_SPEC, LY_VLOG_PREV, NULL, "Unexpected notification node \"%s\".",
+                   iter->schema->name);
+            return EXIT_FAILURE;
+        }
+
+        if ((iter->validity & ~LYD_VAL_SUBTREE) || (iter->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST | LYS_ANYDATA))) {
+            /* the node itself changed, the flag is kept until the validation succeeds */
+            iter->validity |= LYD_VAL_SUBTREE;
+            if (ly_set_add(changed, iter, LY_SET_OPT_USEASLIST) == -1) {
+                return EXIT_FAILURE;
+            }
+        }
+
+        val_errs = ly_vlog_collected();
+        if ((lyv_data_context(iter, options, unres) || lyv_data_content(iter, options, unres))
+                && !lyd_val_err_collected(options, val_errs)) {
+            return EXIT_FAILURE;
+        }
+
+        /* empty non-default, non-presence container without attributes, make it default */
+        if (!iter->dflt && (iter->schema->nodetype == LYS_CONTAINER) && !iter->child
+                    && !((struct lys_node_container *)iter->schema)->presence && !iter->attr) {
+            iter->dflt = 1;
+        }
+
+        if (!(iter->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST | LYS_ANYDATA)) && iter->child
+                && lyd_validate_changed_r(iter->child, options, unres, changed)) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Update #LYD_VAL_SUBTREE flags in the subtree of a data node after a successful validation.
+ *
+ * @param[in] node Data node with some validity flags.
+ * @return Non-zero if the node or any of its descendants still need to be validated, 0 otherwise.
+ */
+static int
+lyd_val_subtree_update(struct lyd_node *node)
+{
+    struct lyd_node *child;
+    int dirty = 0;
+
+    if (!(node->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST | LYS_ANYDATA))) {
+        LY_TREE_FOR(node->child, child) {
+            if (child->validity && lyd_val_subtree_update(child)) {
+                dirty = 1;
             }
         }
+    }
 
-        if (second->parent) {
-            second = second->parent->child;
-        } else {
-            for (; second->prev->next; second = second->prev);
-        }
+    if (dirty) {
+        node->validity |= LYD_VAL_SUBTREE;
+    } else {
+        node->validity &= ~LYD_VAL_SUBTREE;
+    }
+    return node->validity;
+}
 
-        /* check that both has the same (schema) parent or that they are top-level nodes */
-        if ((first->parent && second->parent && first->parent->schema != second->parent->schema) ||
-                (!first->parent && first->parent != second->parent)) {
-            LOGERR(ctx, LY_EINVAL, "%s: incompatible trees with different parents.", __func__);
-            return NULL;
+void
+lyd_val_subtree_forget(struct lyd_node *first, const struct lys_module **modules, int mod_count, int options)
+{
+    struct lyd_node *root;
+    int i;
+
+    LY_TREE_FOR(first, root) {
+        if (modules) {
+            for (i = 0; i < mod_count; ++i) {
+                if (lyd_node_module(root) == modules[i]) {
+                    break;
+                }
+            }
+            if (i == mod_count) {
+                continue;
+            }
+        }
+        if (root->validity) {
+            lyd_val_subtree_update(root);
+        }
+        if (options & LYD_OPT_NOSIBLINGS) {
+            break;
         }
     }
-    if (first == second) {
-        LOGERR(ctx, LY_EINVAL, "%s: comparing the same tree does not make sense.", __func__);
-        return NULL;
-    }
+}
 
-    /* initiate resulting structure */
-    result = lyd_diff_init_difflist(ctx, &size);
-    LY_CHECK_ERR_GOTO(!result, , error);
+/* value of the first pointer of the val diff terminating item when the created subtrees are only referenced */
+static char lyd_val_diff_nodup;
 
-    /* the records about created and moved items are created in
-     * bad order, so the records about created nodes (and their
-     * possible moving) is stored separately and added to the
-     * main result at the end.
-     */
-    result2 = lyd_diff_init_difflist(ctx, &size2);
-    LY_CHECK_ERR_GOTO(!result2, , error);
+static int
+_lyd_validate(struct lyd_node **node, struct lyd_node *data_tree, struct ly_ctx *ctx, const struct lys_module **modules,
+              int mod_count, struct lyd_difflist **diff, struct lyd_val_err **val_errs, int options)
+{
+    struct lyd_node *root, *next1, *next2, *iter, *act_notif = NULL;
+    int ret = EXIT_FAILURE;
+    unsigned int i;
+    uint32_t val_errs_start = 0, val_errs_prev;
+    struct unres_data *unres = NULL;
+    struct ly_set *changed = NULL;
+    const struct lys_module *yanglib_mod;
 
-    matchlist = malloc(sizeof *matchlist);
-    LY_CHECK_ERR_GOTO(!matchlist, LOGMEM(ctx), error);
+    unres = calloc(1, sizeof *unres);
+    LY_CHECK_ERR_RETURN(!unres, LOGMEM(NULL), EXIT_FAILURE);
 
-    matchlist->i = 0;
-    matchlist->match = ly_set_new();
-    matchlist->prev = NULL;
+    ly_phase(LY_TRACE_VALIDATE, 0, ctx);
 
-    ordset = ly_set_new();
-    LY_CHECK_ERR_GOTO(!ordset, , error);
+    if (val_errs) {
+        /* collect all the validation errors */
+        ly_vlog_collect_start();
+        val_errs_start = ly_vlog_collected();
+    }
 
-    /*
-     * compare trees
-     */
-    /* 1) newly created nodes + changed leafs/anyxmls */
-    next1 = first;
-    for (elem2 = next2 = second; elem2; elem2 = next2) {
-        /* keep right pointer for searching in the first tree */
-        elem1 = next1;
+    if (diff) {
+        unres->store_diff = 1;
+        unres->diff = lyd_diff_init_difflist(ctx, &unres->diff_size);
+    }
 
-        if (elem2->dflt && !(options & LYD_DIFFOPT_WITHDEFAULTS)) {
-            /* skip default elements, they could not be created or changed, just deleted */
-            goto cmp_continue;
-        }
+    if ((options & (LYD_OPT_RPC | LYD_OPT_RPCREPLY)) && *node && ((*node)->schema->nodetype != LYS_RPC)) {
+        options |= LYD_OPT_ACT_NOTIF;
+    }
+    if ((options & (LYD_OPT_NOTIF | LYD_OPT_NOTIF_FILTER)) && *node && ((*node)->schema->nodetype != LYS_NOTIF)) {
+        options |= LYD_OPT_ACT_NOTIF;
+    }
 
-#ifdef LY_ENABLED_CACHE
-        struct lyd_node **iter_p;
+    if (options & LYD_OPT_VAL_INCREMENTAL) {
+        /* validate only the changed nodes and schedule the conditions depending on them */
+        options |= LYD_OPT_VAL_CHANGED;
+        changed = ly_set_new();
+        LY_CHECK_ERR_GOTO(!changed, LOGMEM(ctx), cleanup);
+        if (lyd_validate_changed_r(*node, options, unres, changed)) {
+            goto cleanup;
+        }
+        if (changed->number && lyd_xpath_deps_schedule(*node, changed, 0, unres)) {
+            goto cleanup;
+        }
+    }
 
-        if (elem1 && elem1->parent && elem1->parent->ht) {
-            iter = NULL;
-            if (!lyht_find(elem1->parent->ht, &elem2, elem2->hash, (void **)&iter_p)) {
-                iter = *iter_p;
-                /* we found a match */
-                if (iter->dflt && !(options & LYD_DIFFOPT_WITHDEFAULTS)) {
-                    /* the second one cannot be default (see lyd_diff()),
-                     * so the nodes differs (first one is default node) */
-                    iter = NULL;
-                }
-                while (iter && (iter->validity & LYD_VAL_INUSE)) {
-                    /* state lists, find one not-already-found */
-                    assert((iter->schema->nodetype & (LYS_LIST | LYS_LEAFLIST)) && (iter->schema->flags & LYS_CONFIG_R));
-                    if (lyht_find_next(elem1->parent->ht, &iter, iter->hash, (void **)&iter_p)) {
-                        iter = NULL;
-                    } else {
-                        iter = *iter_p;
-                    }
+    LY_TREE_FOR_SAFE((options & LYD_OPT_VAL_INCREMENTAL) ? NULL : *node, next1, root) {
+        if (modules) {
+            for (i = 0; i < (unsigned)mod_count; ++i) {
+                if (lyd_node_module(root) == modules[i]) {
+                    break;
                 }
             }
-        } else
-#endif
-        {
-            /* search for elem2 instance in the first */
-            LY_TREE_FOR(elem1, iter) {
-                if (iter->schema != elem2->schema) {
-                    continue;
-                }
-
-                /* elem2 instance found */
-                rc = lyd_diff_compare(iter, elem2, options);
-                if (rc == -1) {
-                    goto error;
-                } else if (rc == 0) {
-                    /* match */
-                    break;
-                } /* else, continue */
+            if (i == (unsigned)mod_count) {
+                /* skip data that should not be validated */
+                continue;
             }
         }
-        /* we have a match */
-        if (iter && lyd_diff_match(iter, elem2, result, &size, &index, matchlist->match, ordset, options)) {
-            goto error;
-        }
-
-        if (!iter) {
-            /* elem2 not found in the first tree */
-            if (lyd_difflist_add(result2, &size2, index2++, LYD_DIFF_CREATED, elem1 ? elem1->parent : parent, elem2)) {
-                goto error;
-            }
 
-            if (elem1 && (elem2->schema->flags & LYS_USERORDERED)) {
-                /* store the correct place where the node is supposed to be moved after creation */
-                /* if elem1 does not exist, all nodes were created and they will be created in
-                 * correct order, so it is not needed to detect moves */
-                for (aux = elem2->prev; aux->next; aux = aux->prev) {
-                    if (aux->schema == elem2->schema) {
-                        /* predecessor found */
-                        break;
-                    }
-                }
-                if (!aux->next) {
-                    /* predecessor not found */
-                    aux = NULL;
-                }
-                if (lyd_difflist_add(result2, &size2, index2++, LYD_DIFF_MOVEDAFTER2, aux, elem2)) {
-                    goto error;
+        LY_TREE_DFS_BEGIN(root, next2, iter) {
+            if (iter->parent && (iter->schema->nodetype & (LYS_ACTION | LYS_NOTIF))) {
+                if (!(options & LYD_OPT_ACT_NOTIF) || act_notif) {
+                    LOGVAL(ctx, LYE_INELEM, LY_VLOG_LYD, iter, iter->schema->name);
+                    LOGVAL(ctx, LYE_SPEC, LY_VLOG_PREV, NULL, "Unexpected %s node \"%s\".",
+                           (options & LYD_OPT_RPC ? "action" : "notification"), iter->schema->name);
+                    goto cleanup;
                 }
+                act_notif = iter;
             }
-        }
-
-cmp_continue:
-        /* select element for the next run                                    1     2
-         * - first, process all siblings of a single parent                  / \   / \
-         * - then, go to children (deep)                                    3   4 7   8
-         * - return to the parent's next sibling children                  / \
-         *                                                                5   6
-         */
-        /* siblings first */
-        next1 = elem1;
-        next2 = elem2->next;
-
-        if (!next2) {
-            /* children */
 
-            /* first pass of the siblings done, some additional work for future
-             * detection of move may be needed */
-            for (i = ordset->number; i > 0; i--) {
-                ordered = (struct diff_ordered *)ordset->set.g[i - 1];
-                if (ordered->items) {
-                    /* already preprocessed ordered structure */
-                    break;
-                }
-                ordered->items = calloc(ordered->count, sizeof *ordered->items);
-                LY_CHECK_ERR_GOTO(!ordered->items, LOGMEM(ctx), error);
-                ordered->dist = NULL;
-                /* zero the count to be used as a node position in lyd_diff_move_preprocess() */
-                ordered->count = 0;
+            val_errs_prev = ly_vlog_collected();
+            if ((lyv_data_context(iter, options, unres) || lyv_data_content(iter, options, unres))
+                    && !lyd_val_err_collected(options, val_errs_prev)) {
+                goto cleanup;
             }
 
-            /* first, get the first sibling */
-            if (elem2->parent == second->parent) {
-                elem2 = second;
-            } else {
-                elem2 = elem2->parent->child;
+            /* empty non-default, non-presence container without attributes, make it default */
+            if (!iter->dflt && (iter->schema->nodetype == LYS_CONTAINER) && !iter->child
+                        && !((struct lys_node_container *)iter->schema)->presence && !iter->attr) {
+                iter->dflt = 1;
             }
 
-            /* and then find the first child */
-            LY_TREE_FOR(elem2, iter) {
-                if (!(iter->validity & LYD_VAL_INUSE)) {
-                    /* the iter is not present in both trees */
-                    continue;
-                } else if (matchlist->i == matchlist->match->number) {
-                    if (iter == elem2) {
-                        /* we already went through all the matching nodes and now we are just supposed to stop
-                         * the loop with no iter */
-                        iter = NULL;
-                        break;
-                    } else {
-                        /* we have started with some not processed data in matchlist, but now we have
-                         * the INUSE iter and no nodes in matchlist to find its equivalent,
-                         * so something went wrong somewhere */
-                        LOGINT(ctx);
-                        goto error;
-                    }
-                }
+            LY_TREE_DFS_END(root, next2, iter);
+        }
 
-                iter->validity &= ~LYD_VAL_INUSE;
-                if ((iter->schema->nodetype & (LYS_LEAFLIST | LYS_LIST)) && (iter->schema->flags & LYS_USERORDERED)) {
-                    for (j = ordset->number; j > 0; j--) {
-                        ordered = (struct diff_ordered *)ordset->set.g[j - 1];
-                        if (ordered->schema != iter->schema || !lyd_diff_equivnode(ordered->parent, iter->parent)) {
-                            continue;
-                        }
+        if (options & LYD_OPT_NOSIBLINGS) {
+            break;
+        }
 
-                        /* store necessary information for move detection */
-                        lyd_diff_move_preprocess(ordered, matchlist->match->set.d[matchlist->i], iter);
-                        break;
-                    }
-                }
+    }
 
-                if (((iter->schema->nodetype == LYS_CONTAINER) || ((iter->schema->nodetype == LYS_LIST)
-                        && ((struct lys_node_list *)iter->schema)->keys_size)) && iter->child) {
-                    while (matchlist->i < matchlist->match->number && matchlist->match->set.d[matchlist->i]->schema != iter->schema) {
-                        matchlist->i++;
-                    }
-                    if (matchlist->i == matchlist->match->number) {
-                        /* we have the INUSE iter, so we have to find its equivalent in match list */
-                        LOGINT(ctx);
-                        goto error;
-                    }
-                    next1 = matchlist->match->set.d[matchlist->i]->child;
-                    if (!next1) {
-                        parent = matchlist->match->set.d[matchlist->i];
-                    }
-                    matchlist->i++;
-                    next2 = iter->child;
-                    break;
-                }
-                matchlist->i++;
+    if (options & LYD_OPT_ACT_NOTIF) {
+        if (!act_notif) {
+            LOGVAL(ctx, LYE_MISSELEM, LY_VLOG_LYD, *node, (options & LYD_OPT_RPC ? "action" : "notification"), (*node)->schema->name);
+            goto cleanup;
+        }
+        options &= ~LYD_OPT_ACT_NOTIF;
+    }
+
+    if (*node) {
+        /* check for uniqueness of top-level lists/leaflists because
+         * only the inner instances were tested in lyv_data_content() */
+        yanglib_mod = ly_ctx_get_module(ctx ? ctx : (*node)->schema->module->ctx, "ietf-yang-library", NULL, 1);
+        LY_TREE_FOR(*node, root) {
+            if ((options & LYD_OPT_DATA_ADD_YANGLIB) && yanglib_mod && (root->schema->module == yanglib_mod)) {
+                /* ietf-yang-library data present, so ignore the option to add them */
+                options &= ~LYD_OPT_DATA_ADD_YANGLIB;
             }
 
-            if (!iter) {
-                /* no child/data on next level */
-                if (elem2 == second) {
-                    /* done */
-                    break;
-                }
-            } else {
-                /* create new matchlist item */
-                mlaux = malloc(sizeof *mlaux);
-                LY_CHECK_ERR_GOTO(!mlaux, LOGMEM(ctx), error);
-                mlaux->i = 0;
-                mlaux->match = ly_set_new();
-                mlaux->prev = matchlist;
-                matchlist = mlaux;
+            if (!(root->schema->nodetype & (LYS_LIST | LYS_LEAFLIST)) || !(root->validity & LYD_VAL_DUP)) {
+                continue;
+            }
+
+            if (options & LYD_OPT_TRUSTED) {
+                /* just clear the flag */
+                root->validity &= ~LYD_VAL_DUP;
+                continue;
+            }
+
+            val_errs_prev = ly_vlog_collected();
+            if (lyv_data_dup(root, *node) && !lyd_val_err_collected(options, val_errs_prev)) {
+                goto cleanup;
             }
         }
+    }
 
-        while (!next2) {
-            /* parent */
+    /* add missing ietf-yang-library if requested */
+    if (options & LYD_OPT_DATA_ADD_YANGLIB) {
+        if (!(*node)) {
+            (*node) = ly_ctx_info(ctx);
+        } else if (lyd_merge((*node), ly_ctx_info(ctx), LYD_OPT_DESTRUCT | LYD_OPT_EXPLICIT)) {
+            LOGERR(ctx, LY_EINT, "Adding ietf-yang-library data failed.");
+            goto cleanup;
+        }
+    }
 
-            /* clean the last match set */
-            ly_set_clean(matchlist->match);
-            matchlist->i = 0;
+    /* add default values, resolve unres and check for mandatory nodes in final tree */
+    val_errs_prev = ly_vlog_collected();
+    if (lyd_defaults_add_unres(node, options, ctx, modules, mod_count, data_tree, act_notif, unres, 1)
+            && !lyd_val_err_collected(options, val_errs_prev)) {
+        goto cleanup;
+    }
+    if (act_notif) {
+        if (lyd_check_mandatory_tree(act_notif, ctx, modules, mod_count, options)) {
+            goto cleanup;
+        }
+    } else {
+        if (lyd_check_mandatory_tree(*node, ctx, modules, mod_count, options)) {
+            goto cleanup;
+        }
+    }
 
-            /* try to go to a cousin - child of the next parent's sibling */
-            mlaux = matchlist->prev;
-            LY_TREE_FOR(elem2->parent->next, iter) {
-                if (!(iter->validity & LYD_VAL_INUSE)) {
-                    continue;
-                } else if (mlaux->i == mlaux->match->number) {
-                    if (iter == elem2->parent->next) {
-                        /* we already went through all the matching nodes and now we are just supposed to stop
-                         * the loop with no iter */
-                        iter = NULL;
-                        break;
-                    } else {
-                        /* we have started with some not processed data in matchlist, but now we have
-                         * the INUSE iter and no nodes in matchlist to find its equivalent,
-                         * so something went wrong somewhere */
-                        LOGINT(ctx);
-                        goto error;
-                    }
-                }
+    if (val_errs && (ly_vlog_collected() > val_errs_start)) {
+        /* the tree is not valid */
+        goto cleanup;
+    }
 
-                iter->validity &= ~LYD_VAL_INUSE;
-                if ((iter->schema->nodetype & (LYS_LEAFLIST | LYS_LIST)) && (iter->schema->flags & LYS_USERORDERED)) {
-                    for (j = ordset->number ; j > 0; j--) {
-                        ordered = (struct diff_ordered *)ordset->set.g[j - 1];
-                        if (ordered->schema != iter->schema || !lyd_diff_equivnode(ordered->parent, iter->parent)) {
-                            continue;
-                        }
+    if ((options & (LYD_OPT_RPC | LYD_OPT_RPCREPLY)) && *node && lyd_schema_sort(*node, 1)) {
+        /* rpc and rpc-reply must be sorted */
+        goto cleanup;
+    }
 
-                        /* store necessary information for move detection */
-                        lyd_diff_move_preprocess(ordered, mlaux->match->set.d[mlaux->i], iter);
-                        break;
-                    }
-                }
+    /* forget the changes in the validated subtrees */
+    lyd_val_subtree_forget(*node, modules, mod_count, options);
 
-                if (((iter->schema->nodetype == LYS_CONTAINER) || ((iter->schema->nodetype == LYS_LIST)
-                        && ((struct lys_node_list *)iter->schema)->keys_size)) && iter->child) {
-                    while (mlaux->i < mlaux->match->number && mlaux->match->set.d[mlaux->i]->schema != iter->schema) {
-                        mlaux->i++;
-                    }
-                    if (mlaux->i == mlaux->match->number) {
-                        /* we have the INUSE iter, so we have to find its equivalent in match list */
-                        LOGINT(ctx);
-                        goto error;
-                    }
-                    next1 = mlaux->match->set.d[mlaux->i]->child;
-                    if (!next1) {
-                        parent = mlaux->match->set.d[mlaux->i];
-                    }
-                    mlaux->i++;
-                    next2 = iter->child;
-                    break;
-                }
-                mlaux->i++;
+    /* consolidate diff if created */
+    if (diff) {
+        assert(unres->store_diff);
+
+        for (i = 0; i < unres->diff_idx; ++i) {
+            if (unres->diff->type[i] != LYD_DIFF_CREATED) {
+                continue;
+            }
+            if (options & LYD_OPT_VAL_DIFF_NODUP) {
+                /* just reference the created subtree */
+                unres->diff->first[i] = unres->diff->second[i]->parent;
+                continue;
+            }
+            if (unres->diff->second[i]->parent) {
+                unres->diff->first[i] = (struct lyd_node *)lyd_path(unres->diff->second[i]->parent);
             }
+            unres->diff->second[i] = lyd_dup(unres->diff->second[i], LYD_DUP_OPT_RECURSIVE);
+        }
+        if (options & LYD_OPT_VAL_DIFF_NODUP) {
+            /* remember there is nothing to free for the created subtrees */
+            unres->diff->first[unres->diff_idx] = (struct lyd_node *)&lyd_val_diff_nodup;
+        }
 
-            /* if no cousin exists, continue next loop on higher level */
-            if (!iter) {
-                elem2 = elem2->parent;
+        *diff = unres->diff;
+        unres->diff = 0;
+        unres->diff_idx = 0;
+    }
 
-                /* remove matchlist item */
-                ly_set_free(matchlist->match);
-                mlaux = matchlist;
-                matchlist = matchlist->prev;
-                free(mlaux);
+    ret = EXIT_SUCCESS;
 
-                if (!matchlist->prev) { /* elem2->parent == second->parent */
-                    /* done */
-                    break;
-                }
+cleanup:
+    if (unres) {
+        free(unres->node);
+        free(unres->type);
+        for (i = 0; i < unres->diff_idx; ++i) {
+            if (unres->diff->type[i] == LYD_DIFF_DELETED) {
+                lyd_free_withsiblings(unres->diff->first[i]);
+                free(unres->diff->second[i]);
             }
         }
+        lyd_free_diff(unres->diff);
+        free(unres);
+    }
+    ly_set_free(changed);
+    if (val_errs) {
+        *val_errs = ly_vlog_collect_stop();
     }
 
-    ly_set_free(matchlist->match);
-    free(matchlist);
-    matchlist = NULL;
+    ly_phase(LY_TRACE_VALIDATE, 1, ctx);
+    return ret;
+}
 
-    /* 2) deleted nodes */
-    LY_TREE_DFS_BEGIN(first, next1, elem1) {
-        /* search for elem1s deleted in the second */
-        if (elem1->validity & LYD_VAL_INUSE) {
-            /* erase temporary LYD_VAL_INUSE flag and continue into children */
-            elem1->validity &= ~LYD_VAL_INUSE;
-        } else if (!elem1->dflt || (options & LYD_DIFFOPT_WITHDEFAULTS)) {
-            /* elem1 has no matching node in second, add it into result */
-            if (lyd_difflist_add(result, &size, index++, LYD_DIFF_DELETED, elem1, NULL)) {
-                goto error;
+API int
+lyd_validate(struct lyd_node **node, int options, void *var_arg, ...)
+{
+    FUN_IN;
+
+    struct lyd_node *iter, *data_tree = NULL;
+    struct lyd_difflist **diff = NULL;
+    struct lyd_val_err **val_errs = NULL;
+    struct ly_ctx *ctx = NULL;
+    va_list ap;
+
+    if (!node) {
+        LOGARG;
+        return EXIT_FAILURE;
+    }
+
+    if (lyp_data_check_options(NULL, options, __func__)) {
+        return EXIT_FAILURE;
+    }
+
+    data_tree = *node;
+
+    if ((!(options & LYD_OPT_TYPEMASK)
+            || (options & (LYD_OPT_CONFIG | LYD_OPT_GET | LYD_OPT_GETCONFIG | LYD_OPT_EDIT))) && !(*node)) {
+        /* get context with schemas from the var_arg */
+        ctx = (struct ly_ctx *)var_arg;
+        if (!ctx) {
+            LOGERR(NULL, LY_EINVAL, "%s: invalid variable parameter (struct ly_ctx *ctx).", __func__);
+            return EXIT_FAILURE;
+        }
+
+        /* LYD_OPT_NOSIBLINGS has no meaning here */
+        options &= ~LYD_OPT_NOSIBLINGS;
+    } else if (options & (LYD_OPT_RPC | LYD_OPT_RPCREPLY | LYD_OPT_NOTIF)) {
+        /* LYD_OPT_NOSIBLINGS cannot be set in this case */
+        if (options & LYD_OPT_NOSIBLINGS) {
+            LOGERR(NULL, LY_EINVAL, "%s: invalid parameter (variable arg const struct lyd_node *data_tree with LYD_OPT_NOSIBLINGS).", __func__);
+            return EXIT_FAILURE;
+        } else if (!(*node)) {
+            LOGARG;
+            return EXIT_FAILURE;
+        }
+
+        /* get the additional data tree if given */
+        data_tree = (struct lyd_node *)var_arg;
+        if (data_tree) {
+            if (options & LYD_OPT_NOEXTDEPS) {
+                LOGERR(NULL, LY_EINVAL, "%s: invalid parameter (variable arg const struct lyd_node *data_tree and LYD_OPT_NOEXTDEPS set).",
+                       __func__);
+                return EXIT_FAILURE;
             }
 
-            /* skip subtree processing of data missing in the second tree */
-            goto dfs_nextsibling;
+            LY_TREE_FOR(data_tree, iter) {
+                if (iter->parent) {
+                    /* a sibling is not top-level */
+                    LOGERR(NULL, LY_EINVAL, "%s: invalid variable parameter (const struct lyd_node *data_tree).", __func__);
+                    return EXIT_FAILURE;
+                }
+            }
+
+            /* move it to the beginning */
+            for (; data_tree->prev->next; data_tree = data_tree->prev);
+        }
+    } else if (options & LYD_OPT_DATA_TEMPLATE) {
+        /* get context with schemas from the var_arg */
+        if (*node && ((*node)->prev->next || (*node)->next)) {
+            /* not allow sibling in top-level */
+            LOGERR(NULL, LY_EINVAL, "%s: invalid variable parameter (struct lyd_node *node).", __func__);
+            return EXIT_FAILURE;
         }
+    }
 
-        /* modified LY_TREE_DFS_END() */
-        /* select element for the next run - children first */
-        if ((elem1->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST | LYS_ANYDATA)) || ((elem1->schema->nodetype == LYS_LIST)
-                && !((struct lys_node_list *)elem1->schema)->keys_size)) {
-            next1 = NULL;
-        } else {
-            next1 = elem1->child;
+    if (options & (LYD_OPT_VAL_DIFF | LYD_OPT_VAL_ALL)) {
+        va_start(ap, var_arg);
+        if (options & LYD_OPT_VAL_DIFF) {
+            diff = va_arg(ap, struct lyd_difflist **);
         }
-        if (!next1) {
-dfs_nextsibling:
-            /* try siblings */
-            next1 = elem1->next;
+        if (options & LYD_OPT_VAL_ALL) {
+            val_errs = va_arg(ap, struct lyd_val_err **);
+        }
+        va_end(ap);
+        if ((options & LYD_OPT_VAL_DIFF) && !diff) {
+            LOGERR(ctx, LY_EINVAL, "%s: invalid variable parameter (struct lyd_difflist **).", __func__);
+            return EXIT_FAILURE;
         }
-        while (!next1) {
-            /* parent is already processed, go to its sibling */
+        if ((options & LYD_OPT_VAL_ALL) && !val_errs) {
+            LOGERR(ctx, LY_EINVAL, "%s: invalid variable parameter (struct lyd_val_err **).", __func__);
+            return EXIT_FAILURE;
+        }
+    }
 
-            elem1 = elem1->parent;
-            if (elem1 == first->parent) {
-                /* we are done, no next element to process */
-                break;
+    if (*node) {
+        if (!ctx) {
+            ctx = (*node)->schema->module->ctx;
+        }
+        if (!(options & LYD_OPT_NOSIBLINGS)) {
+            /* check that the node is the first sibling */
+            while ((*node)->prev->next) {
+                *node = (*node)->prev;
             }
-
-            next1 = elem1->next;
         }
     }
 
-    /* 3) moved nodes (when user-ordered) */
-    for (i = 0; i < ordset->number; i++) {
-        ordered = (struct diff_ordered *)ordset->set.g[i];
-        if (!ordered->dist->dist) {
-            /* the dist list is sorted here, but the biggest dist is 0,
-             * so nothing changed in order of these items between first
-             * and second. We can continue with another user-ordered list.
-             */
-            continue;
-        }
+    return _lyd_validate(node, data_tree, ctx, NULL, 0, diff, val_errs, options);
+}
 
-        /* get needed movements
-         * - from the biggest distances try to apply node movements
-         * on first tree node until they will be ordered as in the
-         * second tree - i.e. until there will be no position difference
-         */
+API int
+lyd_validate_modules(struct lyd_node **node, const struct lys_module **modules, int mod_count, int options, ...)
+{
+    FUN_IN;
 
-        for (dist_iter = ordered->dist; ; dist_iter = dist_iter->next) {
-            /* dist list is sorted at the beginning, since applying a move causes
-             * just a small change in other distances, we assume that the biggest
-             * dist is the next one (note that dist list is implemented as ring
-             * list). This way we avoid sorting distances after each move. The loop
-             * stops when all distances are zero.
-             */
-            dist_aux = dist_iter;
-            while (!dist_iter->dist) {
-                /* no dist, so no move. Try another, but when
-                 * there is no dist at all, stop the loop
-                 */
-                dist_iter = dist_iter->next;
-                if (dist_iter == dist_aux) {
-                    /* all dist we zeroed */
-                    goto movedone;
-                }
-            }
-            /* something to move */
-
-            /* get the item to move */
-            for (k = 0; k < ordered->count; k++) {
-                if (ordered->items[k].dist == dist_iter) {
-                    break;
-                }
-            }
+    struct ly_ctx *ctx;
+    struct lyd_difflist **diff = NULL;
+    struct lyd_val_err **val_errs = NULL;
+    va_list ap;
 
-            /* apply the move (distance) */
-            memcpy(&item_aux, &ordered->items[k], sizeof item_aux);
-            if (dist_iter->dist > 0) {
-                /* move to right (other move to left) */
-                while (dist_iter->dist) {
-                    memcpy(&ordered->items[k], &ordered->items[k + 1], sizeof *ordered->items);
-                    ordered->items[k].dist->dist++; /* update moved item distance */
-                    dist_iter->dist--;
-                    k++;
-                }
-            } else {
-                /* move to left (other move to right) */
-                while (dist_iter->dist) {
-                    memcpy(&ordered->items[k], &ordered->items[k - 1], sizeof *ordered->items);
-                    ordered->items[k].dist->dist--; /* update moved item distance */
-                    dist_iter->dist++;
-                    k--;
-                }
-            }
-            memcpy(&ordered->items[k], &item_aux, sizeof *ordered->items);
+    if (!node || !modules || !mod_count) {
+        LOGARG;
+        return EXIT_FAILURE;
+    }
 
-            /* store the transaction into the difflist */
-            if (lyd_difflist_add(result, &size, index++, LYD_DIFF_MOVEDAFTER1, item_aux.first,
-                                 (k > 0) ? ordered->items[k - 1].first : NULL)) {
-                goto error;
-            }
-            continue;
+    ctx = modules[0]->ctx;
 
-movedone:
-            break;
+    if (*node && !(options & LYD_OPT_NOSIBLINGS)) {
+        /* check that the node is the first sibling */
+        while ((*node)->prev->next) {
+            *node = (*node)->prev;
         }
     }
 
-    diff_ordset_free(ordset);
-    ordset = NULL;
-
-    if (index2) {
-        /* append result2 with newly created
-         * (and possibly moved) nodes */
-        if (index + index2 + 1 >= size) {
-            /* result must be enlarged */
-            size = index + index2 + 1;
-            new = realloc(result->type, size * sizeof *result->type);
-            LY_CHECK_ERR_GOTO(!new, LOGMEM(ctx), error);
-            result->type = new;
+    if (lyp_data_check_options(ctx, options, __func__)) {
+        return EXIT_FAILURE;
+    }
 
-            new = realloc(result->first, size * sizeof *result->first);
-            LY_CHECK_ERR_GOTO(!new, LOGMEM(ctx), error);
-            result->first = new;
+    if ((options & LYD_OPT_TYPEMASK) && !(options & (LYD_OPT_CONFIG | LYD_OPT_GET | LYD_OPT_GETCONFIG | LYD_OPT_EDIT))) {
+        LOGERR(NULL, LY_EINVAL, "%s: options include a forbidden data type.", __func__);
+        return EXIT_FAILURE;
+    }
+    if (options & LYD_OPT_VAL_INCREMENTAL) {
+        LOGERR(ctx, LY_EINVAL, "%s: Invalid options 0x%x (LYD_OPT_VAL_INCREMENTAL cannot be used).", __func__, options);
+        return EXIT_FAILURE;
+    }
 
-            new = realloc(result->second, size * sizeof *result->second);
-            LY_CHECK_ERR_GOTO(!new, LOGMEM(ctx), error);
-            result->second = new;
+    if (options & (LYD_OPT_VAL_DIFF | LYD_OPT_VAL_ALL)) {
+        va_start(ap, options);
+        if (options & LYD_OPT_VAL_DIFF) {
+            diff = va_arg(ap, struct lyd_difflist **);
+        }
+        if (options & LYD_OPT_VAL_ALL) {
+            val_errs = va_arg(ap, struct lyd_val_err **);
+        }
+        va_end(ap);
+        if ((options & LYD_OPT_VAL_DIFF) && !diff) {
+            LOGERR(ctx, LY_EINVAL, "%s: invalid variable parameter (struct lyd_difflist **).", __func__);
+            return EXIT_FAILURE;
+        }
+        if ((options & LYD_OPT_VAL_ALL) && !val_errs) {
+            LOGERR(ctx, LY_EINVAL, "%s: invalid variable parameter (struct lyd_val_err **).", __func__);
+            return EXIT_FAILURE;
         }
-
-        /* append */
-        memcpy(&result->type[index], result2->type, (index2 + 1) * sizeof *result->type);
-        memcpy(&result->first[index], result2->first, (index2 + 1) * sizeof *result->first);
-        memcpy(&result->second[index], result2->second, (index2 + 1) * sizeof *result->second);
     }
-    lyd_free_diff(result2);
 
-    return result;
+    return _lyd_validate(node, *node, ctx, modules, mod_count, diff, val_errs, options);
+}
 
-error:
-    while (matchlist) {
-        mlaux = matchlist;
-        matchlist = mlaux->prev;
-        ly_set_free(mlaux->match);
-        free(mlaux);
+/**
+ * @brief Add schema nodes with expressions depending on \p snode or any of its descendants into \p affected.
+ *
+ * @param[in] snode Schema node.
+ * @param[in] affected Set of schema nodes with expressions to evaluate.
+ * @return EXIT_SUCCESS on success, -1 on error.
+ */
+static int
+lyd_xpath_deps_collect(const struct lys_node *snode, struct ly_set *affected)
+{
+    const struct ly_set *deps;
+    const struct lys_node *child;
+    unsigned int i;
 
+    if (lyxp_deps_get(snode, &deps)) {
+        return -1;
+    }
+    for (i = 0; deps && (i < deps->number); ++i) {
+        if (ly_set_add(affected, deps->set.s[i], 0) == -1) {
+            return -1;
+        }
     }
-    diff_ordset_free(ordset);
 
-    lyd_free_diff(result);
-    lyd_free_diff(result2);
+    if (snode->nodetype & (LYS_LEAF | LYS_LEAFLIST | LYS_ANYDATA)) {
+        return EXIT_SUCCESS;
+    }
+    LY_TREE_FOR(snode->child, child) {
+        if ((child->nodetype != LYS_GROUPING) && lyd_xpath_deps_collect(child, affected)) {
+            return -1;
+        }
+    }
 
-    return NULL;
+    return EXIT_SUCCESS;
 }
 
-static void
-lyd_insert_setinvalid(struct lyd_node *node)
+/**
+ * @brief Learn whether a when or must expression applying to instances of \p schema is in \p affected.
+ *        Follows the schema-only parents the same way resolve_when() does.
+ *
+ * @param[in] schema Schema node of the data node.
+ * @param[in] affected Set of schema nodes with expressions to evaluate.
+ * @return non-zero if affected, 0 otherwise.
+ */
+static int
+lyd_xpath_deps_applies(const struct lys_node *schema, const struct ly_set *affected)
 {
-    struct lyd_node *next, *elem, *parent_list;
+    const struct lys_node *sparent = schema;
 
-    assert(node);
+    do {
+        if (ly_set_contains(affected, (void *)sparent) > -1) {
+            return 1;
+        }
+        if (sparent->parent && (sparent->parent->nodetype == LYS_AUGMENT)
+                && (ly_set_contains(affected, sparent->parent) > -1)) {
+            return 1;
+        }
+        sparent = lys_parent(sparent);
+    } while (sparent && (sparent->nodetype & (LYS_USES | LYS_CHOICE | LYS_CASE)));
 
-    /* overall validity of the node itself */
-    node->validity = ly_new_node_validity(node->schema);
+    return 0;
+}
 
-    /* explore changed unique leaves */
-    /* first, get know if there is a list in parents chain */
-    for (parent_list = node->parent;
-         parent_list && parent_list->schema->nodetype != LYS_LIST;
-         parent_list = parent_list->parent);
-    if (parent_list && !(parent_list->validity & LYD_VAL_UNIQUE)) {
-        /* there is a list, so check if we inserted a leaf supposed to be unique */
-        for (elem = node; elem; elem = next) {
-            if (elem->schema->nodetype == LYS_LIST) {
-                /* stop searching to the depth, children would be unique to a list in subtree */
-                goto nextsibling;
+/**
+ * @brief Schedule the when and must conditions that may be affected by changes of some data nodes.
+ *
+ * @param[in] first First top-level sibling of the data tree.
+ * @param[in] changed Set of the changed data nodes.
+ * @param[in] subtrees Whether to schedule also all the conditions in the changed subtrees. If not, the scheduled
+ *                     nodes are remembered as changed until the validation succeeds (#LYD_OPT_VAL_INCREMENTAL).
+ * @param[in] unres Unresolved data to add the conditions into.
+ * @return EXIT_SUCCESS on success, -1 on error.
+ */
+static int
+lyd_xpath_deps_schedule(struct lyd_node *first, const struct ly_set *changed, int subtrees, struct unres_data *unres)
+{
+    struct lyd_node *root, *next1, *next2, *iter, *parent, *changed_root = NULL;
+    const struct lys_node *sparent;
+    struct ly_set *affected, *done;
+    unsigned int i, count;
+    int ret = -1;
+
+    /* learn all the expressions that may be affected by the changes */
+    affected = ly_set_new();
+    done = ly_set_new();
+    LY_CHECK_ERR_GOTO(!affected || !done, LOGMEM(first->schema->module->ctx), cleanup);
+    for (i = 0; i < changed->number; ++i) {
+        for (sparent = changed->set.d[i]->schema; sparent; sparent = lys_parent(sparent)) {
+            count = done->number;
+            if (ly_set_add(done, (void *)sparent, 0) == -1) {
+                goto cleanup;
             }
-
-            if (elem->schema->nodetype == LYS_LEAF && (elem->schema->flags & LYS_UNIQUE)) {
-                /* set flag to list for future validation */
-                parent_list->validity |= LYD_VAL_UNIQUE;
+            if (count == done->number) {
+                /* this schema node and all its parents were already collected */
                 break;
             }
-
-            if (elem->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST | LYS_ANYDATA)) {
-                if (elem == node) {
-                    /* stop the loop */
-                    break;
-                }
-                goto nextsibling;
-            }
-
-            /* select next elem to process */
-            /* go into children */
-            next = elem->child;
-            /* go through siblings */
-            if (!next) {
-nextsibling:
-                next = elem->next;
-                if (!next) {
-                    /* no sibling */
-                    if (elem == node) {
-                        /* we are done, back in start node */
-                        break;
-                    }
-                }
-            }
-            /* go back to parents */
-            while (!next) {
-                elem = elem->parent;
-                if (elem->parent == node->parent) {
-                    /* we are done, back in start node */
-                    break;
-                }
-                /* parent was actually already processed, so go to the parent's sibling */
-                next = elem->parent->next;
-            }
-        }
-    }
-
-    if (node->parent) {
-        /* if the inserted node is list/leaflist with constraint on max instances or extension validation callback,
-         * invalidate the parent to make it validate this */
-        if ((node->schema->nodetype & LYS_LEAFLIST) && ((struct lys_node_leaflist *)node->schema)->max) {
-            node->parent->validity |= LYD_VAL_MAND;
-        } else if ((node->schema->nodetype & LYS_LIST) && ((struct lys_node_list *)node->schema)->max) {
-            node->parent->validity |= LYD_VAL_MAND;
-        } else {
-            /* invalidate all parents that have an extension with a validation
-             * callback for their whole subtree */
-            next = node->parent;
-            while (next) {
-                if ((next->schema->flags & LYS_VALID_EXT) && (next->schema->flags & LYS_VALID_EXT_SUBTREE))
-                    next->validity |= LYD_VAL_MAND;
-                next = next->parent;
+            if (lyd_xpath_deps_collect(sparent, affected)) {
+                goto cleanup;
             }
         }
     }
-}
-
-static void
-lyd_replace(struct lyd_node *orig, struct lyd_node *repl)
-{
-    struct lyd_node *iter, *last;
-
-    if (!repl) {
-        /* remove the old one */
-        goto finish;
-    }
-
-    if (repl->parent || repl->prev->next) {
-        /* isolate the new node */
-        repl->next = NULL;
-        repl->prev = repl;
-        last = repl;
-    } else {
-        /* get the last node of a possible list of nodes to be inserted */
-        for (last = repl; last->next; last = last->next) {
-            /* part of the parent changes */
-            last->parent = orig->parent;
-        }
-    }
 
-    /* parent */
-    if (orig->parent && (orig->parent->child == orig)) {
-        orig->parent->child = repl;
+    if (!subtrees && !affected->number) {
+        /* nothing depends on the changes */
+        ret = EXIT_SUCCESS;
+        goto cleanup;
     }
 
-    /* predecessor */
-    if (orig->prev == orig) {
-        /* the old was alone */
-        goto finish;
-    }
-    if (orig->prev->next) {
-        orig->prev->next = repl;
-    }
-    repl->prev = orig->prev;
-    orig->prev = orig;
+    /* schedule the affected expressions and those of the changed subtrees */
+    LY_TREE_FOR_SAFE(first, next1, root) {
+        LY_TREE_DFS_BEGIN(root, next2, iter) {
+            if (subtrees && changed_root) {
+                for (parent = iter; parent && (parent != changed_root); parent = parent->parent);
+                if (!parent) {
+                    changed_root = NULL;
+                }
+            }
+            if (subtrees && !changed_root && (ly_set_contains(changed, iter) > -1)) {
+                changed_root = iter;
+            }
 
-    /* successor */
-    if (orig->next) {
-        orig->next->prev = last;
-        last->next = orig->next;
-        orig->next = NULL;
-    } else {
-        /* fix the last pointer */
-        if (repl->parent) {
-            repl->parent->child->prev = last;
-        } else {
-            /* get the first sibling */
-            for (iter = repl; iter->prev != orig; iter = iter->prev);
-            iter->prev = last;
+            if (changed_root || lyd_xpath_deps_applies(iter->schema, affected)) {
+                if ((iter->when_status & LYD_WHEN) && unres_data_add(unres, iter, UNRES_WHEN)) {
+                    goto cleanup;
+                }
+                if ((resolve_applies_must(iter) & 0x1) && unres_data_add(unres, iter, UNRES_MUST)) {
+                    goto cleanup;
+                }
+                if (!subtrees) {
+                    lyd_val_set_changed(iter);
+                }
+            }
+
+            LY_TREE_DFS_END(root, next2, iter);
         }
     }
 
-finish:
-    /* remove the old one */
-    lyd_free(orig);
+    ret = EXIT_SUCCESS;
+
+cleanup:
+    ly_set_free(affected);
+    ly_set_free(done);
+    return ret;
 }
 
-int
-lyd_insert_common(struct lyd_node *parent, struct lyd_node **sibling, struct lyd_node *node, int invalidate)
+API int
+lyd_validate_xpath_deps(struct lyd_node **node, const struct ly_set *changed, int options)
 {
-    struct lys_node *par1, *par2;
-    const struct lys_node *siter;
-    struct lyd_node *start, *iter, *ins, *next1, *next2;
-    int invalid = 0, isrpc = 0, clrdflt = 0;
-    struct ly_set *llists = NULL;
-    int i;
-    uint8_t pos;
-    int stype = LYS_INPUT | LYS_OUTPUT;
+    FUN_IN;
 
-    assert(parent || sibling);
+    struct unres_data *unres = NULL;
+    struct ly_ctx *ctx;
+    int ret = EXIT_FAILURE;
 
-    /* get first sibling */
-    if (parent) {
-        start = parent->child;
-    } else {
-        for (start = *sibling; start->prev->next; start = start->prev);
+    if (!node || !changed) {
+        LOGARG;
+        return EXIT_FAILURE;
+    }
+    if (!(*node) || !changed->number) {
+        return EXIT_SUCCESS;
     }
+    ctx = (*node)->schema->module->ctx;
 
-    /* check placing the node to the appropriate place according to the schema */
-    if (!start) {
-        if (!parent) {
-            /* empty tree to insert */
-            if (node->parent || node->prev->next) {
-                /* unlink the node first */
-                lyd_unlink_internal(node, 1);
-            } /* else insert also node's siblings */
-            *sibling = node;
-            return EXIT_SUCCESS;
-        }
-        par1 = parent->schema;
-        if (par1->nodetype & (LYS_RPC | LYS_ACTION)) {
-            /* it is not clear if the tree being created is going to
-             * be rpc (LYS_INPUT) or rpc-reply (LYS_OUTPUT) so we have to
-             * compare against LYS_RPC or LYS_ACTION in par2
-             */
-            stype = LYS_RPC | LYS_ACTION;
-        }
-    } else if (parent && (parent->schema->nodetype & (LYS_RPC | LYS_ACTION))) {
-        par1 = parent->schema;
-        stype = LYS_RPC | LYS_ACTION;
-    } else {
-        for (par1 = lys_parent(start->schema);
-             par1 && !(par1->nodetype & (LYS_CONTAINER | LYS_LIST | LYS_INPUT | LYS_OUTPUT | LYS_NOTIF));
-             par1 = lys_parent(par1));
+    if (lyp_data_check_options(ctx, options, __func__)) {
+        return EXIT_FAILURE;
     }
-    for (par2 = lys_parent(node->schema);
-         par2 && !(par2->nodetype & (LYS_CONTAINER | LYS_LIST | stype | LYS_NOTIF));
-         par2 = lys_parent(par2));
-    if (par1 != par2) {
-        LOGERR(parent->schema->module->ctx, LY_EINVAL, "Cannot insert, different parents (\"%s\" and \"%s\").",
-               (par1 ? par1->name : "<top-lvl>"), (par2 ? par2->name : "<top-lvl>"));
+    if ((options & LYD_OPT_TYPEMASK) & ~LYD_OPT_CONFIG) {
+        LOGERR(ctx, LY_EINVAL, "%s: options include a forbidden data type.", __func__);
         return EXIT_FAILURE;
     }
+    if (options & LYD_OPT_TRUSTED) {
+        return EXIT_SUCCESS;
+    }
 
-    if (invalidate) {
-        invalid = isrpc = lyp_is_rpc_action(node->schema);
-        if (!parent || node->parent != parent || isrpc) {
-            /* it is not just moving under a parent node or it is in an RPC where
-             * nodes order matters, so the validation will be necessary */
-            invalid++;
-        }
+    /* check that the node is the first sibling */
+    while ((*node)->prev->next) {
+        *node = (*node)->prev;
     }
 
-    /* unlink only if it is not a list of siblings without a parent and node is not the first sibling */
-    if (node->parent || node->prev->next) {
-        /* do it permanent if the parents are not exact same or if it is top-level */
-        lyd_unlink_internal(node, invalid);
+    unres = calloc(1, sizeof *unres);
+    LY_CHECK_ERR_GOTO(!unres, LOGMEM(ctx), cleanup);
+
+    if (lyd_xpath_deps_schedule(*node, changed, 1, unres)) {
+        goto cleanup;
     }
 
-    llists = ly_set_new();
+    if (resolve_unres_data(ctx, unres, node, options)) {
+        goto cleanup;
+    }
 
-    /* process the nodes to insert one by one */
-    LY_TREE_FOR_SAFE(node, next1, ins) {
-        if (invalid == 1) {
-            /* auto delete nodes from other cases, if any;
-             * this is done only if node->parent != parent */
-            if (lyv_multicases(ins, NULL, &start, 1, NULL)) {
-                goto error;
-            }
-        }
+    ret = EXIT_SUCCESS;
 
-        /* isolate the node to be handled separately */
-        ins->prev = ins;
-        ins->next = NULL;
+cleanup:
+    if (unres) {
+        free(unres->node);
+        free(unres->type);
+        free(unres);
+    }
+    return ret;
+}
 
-        iter = NULL;
-        if (!ins->dflt) {
-            clrdflt = 1;
-        }
+API int
+lyd_validate_value(struct lys_node *node, const char *value)
+{
+    FUN_IN;
 
-        /* are we inserting list key? */
-        if (!ins->dflt && ins->schema->nodetype == LYS_LEAF && lys_is_key((struct lys_node_leaf *)ins->schema, &pos)) {
-            /* yes, we have a key, get know its position */
-            for (i = 0, iter = parent->child;
-                    iter && i < pos && iter->schema->nodetype == LYS_LEAF;
-                    i++, iter = iter->next);
-            if (iter) {
-                /* insert list's key to the correct position - before the iter */
-                if (parent->child == iter) {
-                    parent->child = ins;
-                }
-                if (iter->prev->next) {
-                    iter->prev->next = ins;
-                }
-                ins->prev = iter->prev;
-                iter->prev = ins;
-                ins->next = iter;
+    struct lyd_node_leaf_list leaf;
+    struct lys_node_leaf *sleaf = (struct lys_node_leaf*)node;
+    int ret = EXIT_SUCCESS;
 
-                /* update start element */
-                if (parent->child != start) {
-                    start = parent->child;
-                }
-            }
+    if (!node || !(node->nodetype & (LYS_LEAF | LYS_LEAFLIST))) {
+        LOGARG;
+        return EXIT_FAILURE;
+    }
 
-            /* try to find previously present default instance to replace */
-        } else if (ins->schema->nodetype == LYS_LEAFLIST) {
-            i = (int)llists->number;
-            if ((ly_set_add(llists, ins->schema, 0) != i) || ins->dflt) {
-                /* each leaf-list must be cleared only once (except when looking for exact same existing dflt nodes) */
-                LY_TREE_FOR_SAFE(start, next2, iter) {
-                    if (iter->schema == ins->schema) {
-                        if ((ins->dflt && (!iter->dflt || ((iter->schema->flags & LYS_CONFIG_W) &&
-                                                           !strcmp(((struct lyd_node_leaf_list *)iter)->value_str,
-                                                                  ((struct lyd_node_leaf_list *)ins)->value_str))))
-                                || (!ins->dflt && iter->dflt)) {
-                            if (iter == start) {
-                                start = next2;
-                            }
-                            lyd_free(iter);
-                        }
-                    }
-                }
-            }
-        } else if (ins->schema->nodetype == LYS_LEAF || (ins->schema->nodetype == LYS_CONTAINER
-                        && !((struct lys_node_container *)ins->schema)->presence)) {
-            LY_TREE_FOR(start, iter) {
-                if (iter->schema == ins->schema) {
-                    if (ins->dflt || iter->dflt) {
-                        /* replace existing (either explicit or default) node with the new (either explicit or default) node */
-                        lyd_replace(iter, ins);
-                    } else {
-                        /* keep both explicit nodes, let the caller solve it later */
-                        iter = NULL;
-                    }
-                    break;
-                }
-            }
-        }
+    if (!value) {
+        value = "";
+    }
 
-        if (!iter) {
-            if (!start) {
-                /* add as the only child of the parent */
-                start = ins;
-                if (parent) {
-                    parent->child = ins;
-                }
-            } else if (isrpc) {
-                /* add to the specific position in rpc/rpc-reply/action */
-                for (par1 = ins->schema->parent; !(par1->nodetype & (LYS_INPUT | LYS_OUTPUT)); par1 = lys_parent(par1));
-                siter = NULL;
-                LY_TREE_FOR(start, iter) {
-                    while ((siter = lys_getnext(siter, par1, lys_node_module(par1), 0))) {
-                        if (iter->schema == siter || ins->schema == siter) {
-                            break;
-                        }
-                    }
-                    if (ins->schema == siter) {
-                        if ((siter->nodetype & (LYS_LEAFLIST | LYS_LIST)) && iter->schema == siter) {
-                            /* we are inserting leaflist/list instance, but since there are already
-                             * some instances of the same leaflist/list, we want to insert the new one
-                             * as the last instance, so here we have to move on */
-                            while (iter && iter->schema == siter) {
-                                iter = iter->next;
-                            }
-                            if (!iter) {
-                                break;
-                            }
-                        }
-                        /* we have the correct place for new node (before the iter) */
-                        if (iter == start) {
-                            start = ins;
-                            if (parent) {
-                                parent->child = ins;
-                            }
-                        } else {
-                            iter->prev->next = ins;
-                        }
-                        ins->prev = iter->prev;
-                        iter->prev = ins;
-                        ins->next = iter;
+    /* dummy leaf */
+    memset(&leaf, 0, sizeof leaf);
+    leaf.value_str = lydict_insert(node->module->ctx, value, 0);
 
-                        /* we are done */
-                        break;
-                    }
-                }
-                if (!iter) {
-                    /* add as the last child of the parent */
-                    start->prev->next = ins;
-                    ins->prev = start->prev;
-                    start->prev = ins;
-                }
-            } else {
-                /* add as the last child of the parent */
-                start->prev->next = ins;
-                ins->prev = start->prev;
-                start->prev = ins;
-            }
+repeat:
+    leaf.value_type = sleaf->type.base;
+    leaf.schema = node;
+
+    if (leaf.value_type == LY_TYPE_LEAFREF) {
+        if (!sleaf->type.info.lref.target) {
+            /* it should either be unresolved leafref (leaf.value_type are ORed flags) or it will be resolved */
+            LOGINT(node->module->ctx);
+            ret = EXIT_FAILURE;
+            goto cleanup;
+        }
+        sleaf = sleaf->type.info.lref.target;
+        goto repeat;
+    } else {
+        if (!lyp_parse_value(&sleaf->type, &leaf.value_str, NULL, &leaf, NULL, NULL, 0, 0, 0)) {
+            ret = EXIT_FAILURE;
+            goto cleanup;
         }
+    }
 
-#ifdef LY_ENABLED_CACHE
-        lyd_unlink_hash(ins, ins->parent);
-#endif
+cleanup:
+    lydict_remove(node->module->ctx, leaf.value_str);
+    return ret;
+}
 
-        ins->parent = parent;
+/**
+ * @brief Reusable checker of the values of a single leaf or leaf-list.
+ */
+struct lyd_value_checker {
+    struct lys_type *type;           /**< type the values are parsed with, the leafref target type for leafrefs */
+    struct lyd_node_leaf_list leaf;  /**< dummy leaf holding the last checked (canonical) value */
+};
 
-#ifdef LY_ENABLED_CACHE
-        lyd_insert_hash(ins);
-#endif
+API struct lyd_value_checker *
+lyd_value_checker_new(const struct lys_node *node)
+{
+    FUN_IN;
 
-        if (invalidate) {
-            check_leaf_list_backlinks(ins);
-        }
+    struct lyd_value_checker *checker;
+    struct lys_node_leaf *sleaf = (struct lys_node_leaf *)node;
 
-        if (invalid) {
-            lyd_insert_setinvalid(ins);
-        }
+    if (!node || !(node->nodetype & (LYS_LEAF | LYS_LEAFLIST))) {
+        LOGARG;
+        return NULL;
     }
-    ly_set_free(llists);
 
-    if (clrdflt) {
-        /* remove the dflt flag from parents */
-        for (iter = parent; iter && iter->dflt; iter = iter->parent) {
-            iter->dflt = 0;
+    /* the leafref target is resolved only once for all the values */
+    while (sleaf->type.base == LY_TYPE_LEAFREF) {
+        if (!sleaf->type.info.lref.target) {
+            LOGINT(node->module->ctx);
+            return NULL;
         }
+        sleaf = sleaf->type.info.lref.target;
     }
 
-    if (sibling) {
-        *sibling = start;
-    }
-    return EXIT_SUCCESS;
+    checker = calloc(1, sizeof *checker);
+    LY_CHECK_ERR_RETURN(!checker, LOGMEM(node->module->ctx), NULL);
 
-error:
-    ly_set_free(llists);
-    return EXIT_FAILURE;
+    checker->type = &sleaf->type;
+    checker->leaf.schema = (struct lys_node *)node;
+    checker->leaf.value_type = sleaf->type.base;
+    return checker;
 }
 
-API int
-lyd_insert(struct lyd_node *parent, struct lyd_node *node)
+/**
+ * @brief Release the last checked value of a checker.
+ */
+static void
+lyd_value_checker_clear(struct lyd_value_checker *checker)
 {
-    FUN_IN;
-
-    if (!node || !parent || (parent->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST | LYS_ANYDATA))) {
-        LOGARG;
-        return EXIT_FAILURE;
-    }
+    struct lyd_node_leaf_list *leaf = &checker->leaf;
 
-    return lyd_insert_common(parent, NULL, node, 1);
+    lyd_free_value(leaf->value, leaf->value_type, leaf->value_flags, checker->type, leaf->value_str, NULL, NULL, NULL);
+    lydict_remove(leaf->schema->module->ctx, leaf->value_str);
+    leaf->value_str = NULL;
+    memset(&leaf->value, 0, sizeof leaf->value);
+    leaf->value_type = checker->type->base;
+    leaf->value_flags = 0;
 }
 
 API int
-lyd_insert_sibling(struct lyd_node **sibling, struct lyd_node *node)
+lyd_value_checker_check(struct lyd_value_checker *checker, const char *value, const char **canonical)
 {
     FUN_IN;
 
-    if (!sibling || !node) {
+    if (!checker) {
         LOGARG;
         return EXIT_FAILURE;
     }
 
-    return lyd_insert_common((*sibling) ? (*sibling)->parent : NULL, sibling, node, 1);
+    if (!value) {
+        value = "";
+    }
 
+    lyd_value_checker_clear(checker);
+    checker->leaf.value_str = lydict_insert(checker->leaf.schema->module->ctx, value, 0);
+
+    /* the value is only checked and canonized, not stored */
+    if (!lyp_parse_value(checker->type, &checker->leaf.value_str, NULL, &checker->leaf, NULL, NULL, 0, 0, 0)) {
+        return EXIT_FAILURE;
+    }
+
+    if (canonical) {
+        *canonical = checker->leaf.value_str;
+    }
+    return EXIT_SUCCESS;
 }
 
-int
-lyd_insert_nextto(struct lyd_node *sibling, struct lyd_node *node, int before, int invalidate)
+API int
+lyd_value_checker_check_typed(struct lyd_value_checker *checker, const void *value, const char **canonical)
 {
-    struct ly_ctx *ctx;
-    struct lys_node *par1, *par2;
-    struct lyd_node *iter, *start = NULL, *ins, *next1, *next2, *last;
-    struct lyd_node *orig_parent = NULL, *orig_prev = NULL, *orig_next = NULL;
-    int invalid = 0;
-    char *str;
-
-    assert(sibling);
-    assert(node);
+    FUN_IN;
 
-    ctx = sibling->schema->module->ctx;
+    int r;
 
-    if (sibling == node) {
-        return EXIT_SUCCESS;
+    if (!checker || !value) {
+        LOGARG;
+        return EXIT_FAILURE;
     }
 
-    /* check placing the node to the appropriate place according to the schema */
-    for (par1 = lys_parent(sibling->schema);
-         par1 && !(par1->nodetype & (LYS_CONTAINER | LYS_LIST | LYS_INPUT | LYS_OUTPUT | LYS_ACTION | LYS_NOTIF));
-         par1 = lys_parent(par1));
-    for (par2 = lys_parent(node->schema);
-         par2 && !(par2->nodetype & (LYS_CONTAINER | LYS_LIST | LYS_INPUT | LYS_OUTPUT | LYS_ACTION | LYS_NOTIF));
-         par2 = lys_parent(par2));
-    if (par1 != par2) {
-        LOGERR(ctx, LY_EINVAL, "Cannot insert, different parents (\"%s\" and \"%s\").",
-               (par1 ? par1->name : "<top-lvl>"), (par2 ? par2->name : "<top-lvl>"));
+    lyd_value_checker_clear(checker);
+    checker->leaf.value_str = lydict_insert(checker->leaf.schema->module->ctx, "", 0);
+
+    r = lyp_store_value(&checker->leaf, checker->type, value, 0);
+    if (r == 1) {
+        LOGERR(checker->leaf.schema->module->ctx, LY_EINVAL,
+               "%s: leaf \"%s\" is not of a numeric, boolean or enumeration type, use lyd_value_checker_check().",
+               __func__, checker->leaf.schema->name);
+    }
+    if (r) {
         return EXIT_FAILURE;
     }
 
-    if (invalidate && ((node->parent != sibling->parent) || (invalid = lyp_is_rpc_action(node->schema)) || !node->parent)) {
-        /* a) it is not just moving under a parent node (invalid = 1) or
-         * b) it is in an RPC where nodes order matters (invalid = 2) or
-         * c) it is top-level where we don't know if it is the same tree (invalid = 1),
-         * so the validation will be necessary */
-        if (!node->parent && !invalid) {
-            /* c) search in siblings */
-            for (iter = node->prev; iter != node; iter = iter->prev) {
-                if (iter == sibling) {
-                    break;
-                }
-            }
-            if (iter == node) {
-                /* node and siblings are not currently in the same data tree */
-                invalid++;
-            }
-        } else { /* a) and b) */
-            invalid++;
-        }
+    if (canonical) {
+        *canonical = checker->leaf.value_str;
     }
+    return EXIT_SUCCESS;
+}
 
-    /* unlink only if it is not a list of siblings without a parent or node is not the first sibling,
-     * always unlink if just moving a node */
-    if ((!invalid) || node->parent || node->prev->next) {
-        /* remember the original position to be able to revert
-         * unlink in case of error */
-        orig_parent = node->parent;
-        if (node->prev != node) {
-            orig_prev = node->prev;
-        }
-        orig_next = node->next;
-        lyd_unlink_internal(node, invalid);
-    }
+API void
+lyd_value_checker_free(struct lyd_value_checker *checker)
+{
+    FUN_IN;
 
-    /* find first sibling node */
-    if (sibling->parent) {
-        start = sibling->parent->child;
-    } else {
-        for (start = sibling; start->prev->next; start = start->prev);
+    if (!checker) {
+        return;
     }
 
-    /* process the nodes one by one to clean the current tree */
-    if (!invalid) {
-        /* just moving one sibling */
-        last = node;
-        node->parent = sibling->parent;
-    } else {
-        LY_TREE_FOR_SAFE(node, next1, ins) {
-            lyd_insert_setinvalid(ins);
+    lyd_value_checker_clear(checker);
+    free(checker);
+}
 
-            if (invalid == 1) {
-                /* auto delete nodes from other cases */
-                if (lyv_multicases(ins, NULL, &start, 1, sibling) == 2) {
-                    LOGVAL(ctx, LYE_SPEC, LY_VLOG_LYD, sibling, "Insert request refers node (%s) that is going to be auto-deleted.",
-                        ly_errpath(ctx));
-                    goto error;
-                }
-            }
+/* create an attribute copy */
+static struct lyd_attr *
+lyd_dup_attr(struct ly_ctx *ctx, struct lyd_node *parent, struct lyd_attr *attr)
+{
+    struct lyd_attr *ret;
 
-            /* try to find previously present default instance to remove because of
-            * inserting the specified node */
-            if (ins->schema->nodetype == LYS_LEAFLIST) {
-                LY_TREE_FOR_SAFE(start, next2, iter) {
-                    if (iter->schema == ins->schema) {
-                        if ((ins->dflt && (!iter->dflt || ((iter->schema->flags & LYS_CONFIG_W) &&
-                                                        !strcmp(((struct lyd_node_leaf_list *)iter)->value_str,
-                                                                ((struct lyd_node_leaf_list *)ins)->value_str))))
-                                || (!ins->dflt && iter->dflt)) {
-                            /* iter will get deleted */
-                            if (iter == sibling) {
-                                LOGERR(ctx, LY_EINVAL, "Insert request refers node (%s) that is going to be auto-deleted.",
-                                    str = lyd_path(sibling));
-                                free(str);
-                                goto error;
-                            }
-                            if (iter == start) {
-                                start = next2;
-                            }
-                            lyd_free(iter);
-                        }
-                    }
-                }
-            } else if (ins->schema->nodetype == LYS_LEAF ||
-                    (ins->schema->nodetype == LYS_CONTAINER && !((struct lys_node_container *)ins->schema)->presence)) {
-                LY_TREE_FOR(start, iter) {
-                    if (iter->schema == ins->schema) {
-                        if (iter->dflt || ins->dflt) {
-                            /* iter gets deleted */
-                            if (iter == sibling) {
-                                LOGERR(ctx, LY_EINVAL, "Insert request refers node (%s) that is going to be auto-deleted.",
-                                    str = lyd_path(sibling));
-                                free(str);
-                                goto error;
-                            }
-                            if (iter == start) {
-                                start = iter->next;
-                            }
-                            lyd_free(iter);
-                        }
-                        break;
-                    }
-                }
-            }
+    /* allocate new attr */
+    if (!parent->attr) {
+        parent->attr = lyd_pool_alloc(ctx, sizeof *parent->attr);
+        ret = parent->attr;
+    } else {
+        for (ret = parent->attr; ret->next; ret = ret->next);
+        ret->next = lyd_pool_alloc(ctx, sizeof *ret);
+        ret = ret->next;
+    }
+    LY_CHECK_ERR_RETURN(!ret, LOGMEM(ctx), NULL);
 
-            ins->parent = sibling->parent;
-            last = ins;
-        }
+    /* fill new attr except */
+    ret->parent = parent;
+    ret->next = NULL;
+    ret->annotation = attr->annotation;
+    ret->name = lydict_insert(ctx, attr->name, 0);
+    ret->value_str = lydict_insert(ctx, attr->value_str, 0);
+    ret->value_type = attr->value_type;
+    ret->value_flags = attr->value_flags & ~LY_VALUE_USER;
+    switch (ret->value_type) {
+    case LY_TYPE_BINARY:
+    case LY_TYPE_STRING:
+        /* value_str pointer is shared in these cases */
+        ret->value.string = ret->value_str;
+        break;
+    case LY_TYPE_LEAFREF:
+        lyp_parse_value(*((struct lys_type **)lys_ext_complex_get_substmt(LY_STMT_TYPE, ret->annotation, NULL)),
+                             &ret->value_str, NULL, NULL, ret, NULL, 1, 0, 0);
+        break;
+    case LY_TYPE_INST:
+        ret->value.instance = NULL;
+        break;
+    case LY_TYPE_UNION:
+        /* unresolved union (this must be non-validated tree), duplicate the stored string (duplicated
+         * because of possible change of the value in case of instance-identifier) */
+        ret->value.string = lydict_insert(ctx, attr->value.string, 0);
+        break;
+    case LY_TYPE_ENUM:
+    case LY_TYPE_IDENT:
+    case LY_TYPE_BITS:
+        /* in case of duplicating bits (no matter if in the same context or not) or enum and identityref into
+         * a different context, searching for the type and duplicating the data is almost as same as resolving
+         * the string value, so due to a simplicity, parse the value for the duplicated leaf */
+        lyp_parse_value(*((struct lys_type **)lys_ext_complex_get_substmt(LY_STMT_TYPE, ret->annotation, NULL)),
+                             &ret->value_str, NULL, NULL, ret, NULL, 1, 0, 0);
+        break;
+    default:
+        ret->value = attr->value;
+        break;
     }
+    if (attr->value_flags & LY_VALUE_USER) {
+        /* the user type plugin stores its own copy of the value */
+        lyp_parse_value(*((struct lys_type **)lys_ext_complex_get_substmt(LY_STMT_TYPE, ret->annotation, NULL)),
+                        &ret->value_str, NULL, NULL, ret, NULL, 1, 0, 0);
+    }
+    return ret;
+}
 
-    /* insert the (list of) node(s) to the specified position */
-    if (before) {
-        if (sibling->prev->next) {
-            /* adding into the middle */
-            sibling->prev->next = node;
-        } else if (sibling->parent) {
-            /* at the beginning */
-            sibling->parent->child = node;
-        }
-        node->prev = sibling->prev;
-        sibling->prev = last;
-        last->next = sibling;
-    } else { /* after */
-        if (sibling->next) {
-            /* adding into the middle - fix the prev pointer of the node after inserted nodes */
-            last->next = sibling->next;
-            sibling->next->prev = last;
-        } else {
-            /* at the end - fix the prev pointer of the first node */
-            start->prev = last;
-        }
-        sibling->next = node;
-        node->prev = sibling;
+int
+lyd_unlink_internal(struct lyd_node *node, int permanent)
+{
+    struct lyd_node *iter;
+
+    if (!node) {
+        LOGARG;
+        return EXIT_FAILURE;
     }
 
-#ifdef LY_ENABLED_CACHE
-    /* now that all the nodes are correctly inserted, fix hashes (node was already unlinked) */
-    lyd_insert_hash(node);
+    if (lyd_txn_cur && (permanent != 2) && lyd_txn_owns(node)) {
+        lyd_txn_rec_unlink(node);
+    }
 
-    /* relink all following nodes */
-    iter = node;
-    for (iter = node; iter != last; iter = iter->next) {
-        lyd_unlink_hash(iter, iter->parent);
-        lyd_insert_hash(iter);
+    if (permanent) {
+        check_leaf_list_backlinks(node);
+    }
+    if ((permanent == 1) && node->parent) {
+        /* the parent must be validated again (mandatory nodes, min-elements, defaults, conditions) */
+        node->parent->validity |= LYD_VAL_MAND;
+        lyd_val_mark_parents(node->parent);
     }
-#endif
 
-    if (invalidate) {
-        LY_TREE_FOR(node, next1) {
-            check_leaf_list_backlinks(next1);
-            if (next1 == last) {
-                break;
+    /* unlink from siblings */
+    if (node->prev->next) {
+        node->prev->next = node->next;
+    }
+    if (node->next) {
+        node->next->prev = node->prev;
+    } else {
+        /* unlinking the last node */
+        if (node->parent) {
+            iter = node->parent->child;
+        } else {
+            iter = node->prev;
+            while (iter->prev != node) {
+                iter = iter->prev;
             }
         }
+        /* update the "last" pointer from the first node */
+        iter->prev = node->prev;
     }
 
-    return EXIT_SUCCESS;
+    /* unlink from parent */
+    if (node->parent) {
+        if (node->parent->child == node) {
+            /* the node is the first child */
+            node->parent->child = node->next;
+        }
 
-error:
-    /* insert back to the original position */
-    if (orig_prev) {
-        lyd_insert_after(orig_prev, node);
-    } else if (orig_next) {
-        lyd_insert_before(orig_next, node);
-    } else if (orig_parent) {
-        /* there were no siblings */
-        orig_parent->child = node;
-        node->parent = orig_parent;
+#ifdef LY_ENABLED_CACHE
+        /* do not remove from parent hash table if freeing the whole subtree */
+        if (permanent != 2) {
+            lyd_unlink_hash(node, node->parent);
+        }
+#endif
+
+        node->parent = NULL;
     }
-    return EXIT_FAILURE;
+
+    node->next = NULL;
+    node->prev = node;
+
+    return EXIT_SUCCESS;
 }
 
 API int
-lyd_insert_before(struct lyd_node *sibling, struct lyd_node *node)
+lyd_unlink(struct lyd_node *node)
 {
     FUN_IN;
 
-    if (!node || !sibling) {
-        LOGARG;
-        return EXIT_FAILURE;
-    }
-
-    return lyd_insert_nextto(sibling, node, 1, 1);
+    return lyd_unlink_internal(node, 1);
 }
 
-API int
-lyd_insert_after(struct lyd_node *sibling, struct lyd_node *node)
+/*
+ * - in leaflist it must be added with value_str
+ */
+static int
+_lyd_dup_node_common(struct lyd_node *new_node, const struct lyd_node *orig, struct ly_ctx *ctx, int options)
 {
-    FUN_IN;
+    struct lyd_attr *attr;
 
-    if (!node || !sibling) {
-        LOGARG;
-        return EXIT_FAILURE;
+    new_node->attr = NULL;
+    if (!(options & LYD_DUP_OPT_NO_ATTR)) {
+        LY_TREE_FOR(orig->attr, attr) {
+            lyd_dup_attr(ctx, new_node, attr);
+        }
+    }
+    new_node->next = NULL;
+    new_node->prev = new_node;
+    new_node->parent = NULL;
+    new_node->validity = ly_new_node_validity(new_node->schema);
+    new_node->dflt = orig->dflt;
+    if (options & LYD_DUP_OPT_WITH_WHEN) {
+        new_node->when_status = orig->when_status;
+    } else {
+        new_node->when_status = orig->when_status & LYD_WHEN;
+    }
+#ifdef LY_ENABLED_CACHE
+    /* just copy the hash, it will not change */
+    if ((new_node->schema->nodetype != LYS_LIST) || lyd_list_has_keys(new_node)) {
+        new_node->hash = orig->hash;
     }
+#endif
 
-    return lyd_insert_nextto(sibling, node, 0, 1);
+#ifdef LY_ENABLED_LYD_PRIV
+    if (ctx->priv_dup_clb) {
+        new_node->priv = ctx->priv_dup_clb(orig->priv);
+    }
+#endif
+
+    return EXIT_SUCCESS;
 }
 
-static uint32_t
-lys_module_pos(struct lys_module *module)
+static struct lyd_node *
+_lyd_dup_node(const struct lyd_node *node, const struct lys_node *schema, struct ly_ctx *ctx, int options)
 {
-    int i;
-    uint32_t pos = 1;
+    struct lyd_node *new_node = NULL;
+    struct lys_node_leaf *sleaf;
+    struct lyd_node_leaf_list *new_leaf;
+    struct lyd_node_anydata *new_any, *old_any;
+    const struct lys_type *type;
+    int r;
+
+    /* fill specific part */
+    switch (node->schema->nodetype) {
+    case LYS_LEAF:
+    case LYS_LEAFLIST:
+        new_leaf = lyd_pool_alloc(ctx, sizeof *new_leaf);
+        new_node = (struct lyd_node *)new_leaf;
+        LY_CHECK_ERR_GOTO(!new_node, LOGMEM(ctx), error);
+        new_node->schema = (struct lys_node *)schema;
+
+        new_leaf->value_str = lydict_insert(ctx, ((struct lyd_node_leaf_list *)node)->value_str, 0);
+        new_leaf->value_type = ((struct lyd_node_leaf_list *)node)->value_type;
+        /* the user type value is stored only once below */
+        new_leaf->value_flags = ((struct lyd_node_leaf_list *)node)->value_flags & ~LY_VALUE_USER;
+        if (_lyd_dup_node_common(new_node, node, ctx, options)) {
+            goto error;
+        }
+
+        /* get schema from the correct context */
+        sleaf = (struct lys_node_leaf *)new_leaf->schema;
+
+        switch (new_leaf->value_type) {
+        case LY_TYPE_BINARY:
+        case LY_TYPE_STRING:
+            /* value_str pointer is shared in these cases */
+            new_leaf->value.string = new_leaf->value_str;
+            break;
+        case LY_TYPE_LEAFREF:
+            new_leaf->validity |= LYD_VAL_LEAFREF;
+            lyp_parse_value(&sleaf->type, &new_leaf->value_str, NULL, new_leaf, NULL, NULL, 1, node->dflt, 0);
+            break;
+        case LY_TYPE_INST:
+            new_leaf->value.instance = NULL;
+            break;
+        case LY_TYPE_UNION:
+            /* unresolved union (this must be non-validated tree), duplicate the stored string (duplicated
+             * because of possible change of the value in case of instance-identifier) */
+            new_leaf->value.string = lydict_insert(ctx, ((struct lyd_node_leaf_list *)node)->value.string, 0);
+            break;
+        case LY_TYPE_ENUM:
+        case LY_TYPE_IDENT:
+        case LY_TYPE_BITS:
+            /* in case of duplicating bits (no matter if in the same context or not) or enum and identityref into
+             * a different context, searching for the type and duplicating the data is almost as same as resolving
+             * the string value, so due to a simplicity, parse the value for the duplicated leaf */
+            if (!lyp_parse_value(&sleaf->type, &new_leaf->value_str, NULL, new_leaf, NULL, NULL, 1, node->dflt, 0)) {
+                goto error;
+            }
+            break;
+        default:
+            new_leaf->value = ((struct lyd_node_leaf_list *)node)->value;
+            break;
+        }
+
+        if ((((struct lyd_node_leaf_list *)node)->value_flags & LY_VALUE_USER)
+                && !(new_leaf->value_flags & LY_VALUE_USER)) {
+            /* get the real type */
+            type = lyd_leaf_type(new_leaf);
+            if (!type || !type->der || !type->der->module) {
+                LOGINT(ctx);
+                goto error;
+            }
+
+            r = lytype_store(type->der, &new_leaf->value_str, &new_leaf->value);
+            if (r == -1) {
+                goto error;
+            } else if (r) {
+                LOGINT(ctx);
+                goto error;
+            }
+            new_leaf->value_flags |= LY_VALUE_USER;
+        }
+        break;
+    case LYS_ANYXML:
+    case LYS_ANYDATA:
+        old_any = (struct lyd_node_anydata *)node;
+        new_any = lyd_pool_alloc(ctx, sizeof *new_any);
+        new_node = (struct lyd_node *)new_any;
+        LY_CHECK_ERR_GOTO(!new_node, LOGMEM(ctx), error);
+        new_node->schema = (struct lys_node *)schema;
+
+        if (_lyd_dup_node_common(new_node, node, ctx, options)) {
+            goto error;
+        }
+
+        new_any->value_type = old_any->value_type;
+        if (!(void*)old_any->value.tree) {
+            /* no value to duplicate */
+            break;
+        }
+        /* duplicate the value */
+        switch (old_any->value_type) {
+        case LYD_ANYDATA_CONSTSTRING:
+        case LYD_ANYDATA_SXML:
+        case LYD_ANYDATA_JSON:
+            new_any->value.str = lydict_insert(ctx, old_any->value.str, 0);
+            break;
+        case LYD_ANYDATA_DATATREE:
+            new_any->value.tree = lyd_dup_withsiblings_to_ctx(old_any->value.tree, 1, ctx);
+            break;
+        case LYD_ANYDATA_XML:
+            new_any->value.xml = lyxml_dup_elem(ctx, old_any->value.xml, NULL, 1, 1);
+            break;
+        case LYD_ANYDATA_LYB:
+            r = lyd_lyb_data_length(old_any->value.mem);
+            if (r == -1) {
+                LOGERR(ctx, LY_EINVAL, "Invalid LYB data.");
+                goto error;
+            }
+            new_any->value.mem = malloc(r);
+            LY_CHECK_ERR_GOTO(!new_any->value.mem, LOGMEM(ctx), error);
+            memcpy(new_any->value.mem, old_any->value.mem, r);
+            break;
+        case LYD_ANYDATA_STRING:
+        case LYD_ANYDATA_SXMLD:
+        case LYD_ANYDATA_JSOND:
+        case LYD_ANYDATA_LYBD:
+            /* dynamic strings are used only as input parameters */
+            assert(0);
+            break;
+        }
+        break;
+    case LYS_CONTAINER:
+    case LYS_LIST:
+    case LYS_NOTIF:
+    case LYS_RPC:
+    case LYS_ACTION:
+        new_node = lyd_pool_alloc(ctx, sizeof *new_node);
+        LY_CHECK_ERR_GOTO(!new_node, LOGMEM(ctx), error);
+        new_node->schema = (struct lys_node *)schema;
 
-    for (i = 0; i < module->ctx->models.used; ++i) {
-        if (module->ctx->models.list[i] == module) {
-            return pos;
+        if (_lyd_dup_node_common(new_node, node, ctx, options)) {
+            goto error;
         }
-        ++pos;
+        break;
+    default:
+        LOGINT(ctx);
+        goto error;
     }
 
-    LOGINT(module->ctx);
-    return 0;
+    return new_node;
+
+error:
+    lyd_free(new_node);
+    return NULL;
 }
 
 static int
-lys_module_node_pos_r(struct lys_node *first_sibling, struct lys_node *target, uint32_t *pos)
+lyd_dup_keys(struct lyd_node *new_list, const struct lyd_node *old_list, struct lys_node *skip_key,
+        struct ly_ctx *log_ctx, int options)
 {
-    const struct lys_node *next = NULL;
+    struct lys_node_list *slist;
+    struct lyd_node *key, *key_dup;
+    uint16_t i;
 
-    /* the schema nodes are actually from data, lys_getnext skips non-data schema nodes for us (we know the parent will not be uses) */
-    while ((next = lys_getnext(next, lys_parent(first_sibling), lys_node_module(first_sibling), LYS_GETNEXT_NOSTATECHECK))) {
-        ++(*pos);
-        if (target == next) {
-            return 0;
-        }
+    if (new_list->schema->nodetype != LYS_LIST) {
+        return 0;
     }
 
-    LOGINT(first_sibling->module->ctx);
-    return 1;
-}
-
-static int
-lyd_node_pos_cmp(const void *item1, const void *item2)
-{
-    uint32_t mpos1, mpos2;
-    struct lyd_node_pos *np1, *np2;
-
-    np1 = (struct lyd_node_pos *)item1;
-    np2 = (struct lyd_node_pos *)item2;
+    slist = (struct lys_node_list *)new_list->schema;
+    for (key = old_list->child, i = 0; key && (i < slist->keys_size); ++i, key = key->next) {
+        if (key->schema != (struct lys_node *)slist->keys[i]) {
+            LOGVAL(log_ctx, LYE_PATH_INKEY, LY_VLOG_LYD, new_list, slist->keys[i]->name);
+            return -1;
+        }
+        if (key->schema == skip_key) {
+            continue;
+        }
 
-    /* different modules? */
-    if (lys_node_module(np1->node->schema) != lys_node_module(np2->node->schema)) {
-        mpos1 = lys_module_pos(lys_node_module(np1->node->schema));
-        mpos2 = lys_module_pos(lys_node_module(np2->node->schema));
-        /* if lys_module_pos failed, there is nothing we can do anyway,
-         * at least internal error will be printed */
+        key_dup = lyd_dup(key, options & LYD_DUP_OPT_NO_ATTR);
+        LY_CHECK_ERR_RETURN(!key_dup, LOGMEM(log_ctx), -1);
 
-        if (mpos1 > mpos2) {
-            return 1;
-        } else {
+        if (lyd_insert(new_list, key_dup)) {
+            lyd_free(key_dup);
             return -1;
         }
     }
-
-    if (np1->pos > np2->pos) {
-        return 1;
-    } else if (np1->pos < np2->pos) {
+    if (!key && (i < slist->keys_size)) {
+        LOGVAL(log_ctx, LYE_PATH_INKEY, LY_VLOG_LYD, new_list, slist->keys[i]->name);
         return -1;
     }
+
     return 0;
 }
 
-API int
-lyd_schema_sort(struct lyd_node *sibling, int recursive)
+API struct lyd_node *
+lyd_dup_to_ctx(const struct lyd_node *node, int options, struct ly_ctx *ctx)
 {
     FUN_IN;
 
-    uint32_t len, i;
-    struct lyd_node *node;
-    struct lys_node *first_ssibling = NULL;
-    struct lyd_node_pos *array;
+    struct ly_ctx *log_ctx;
+    struct lys_node *schema;
+    const char *yang_data_name;
+    const struct lys_module *trg_mod;
+    const struct lyd_node *next, *elem;
+    struct lyd_node *ret, *parent, *new_node = NULL;
 
-    if (!sibling) {
+    if (!node) {
         LOGARG;
-        return -1;
+        return NULL;
     }
 
-    /* something actually to sort */
-    if (sibling->prev != sibling) {
-
-        /* find the beginning */
-        sibling = lyd_first_sibling(sibling);
-
-        /* count siblings */
-        len = 0;
-        for (node = sibling; node; node = node->next) {
-            ++len;
-        }
-
-        array = malloc(len * sizeof *array);
-        LY_CHECK_ERR_RETURN(!array, LOGMEM(sibling->schema->module->ctx), -1);
-
-        /* fill arrays with positions and corresponding nodes */
-        for (i = 0, node = sibling; i < len; ++i, node = node->next) {
-            array[i].pos = 0;
-
-            /* we need to repeat this for every module */
-            if (!first_ssibling || (lyd_node_module(node) != lys_node_module(first_ssibling))) {
-                /* find the data node schema parent */
-                first_ssibling = node->schema;
-                while (lys_parent(first_ssibling)
-                        && (lys_parent(first_ssibling)->nodetype & (LYS_CHOICE | LYS_CASE | LYS_USES))) {
-                    first_ssibling = lys_parent(first_ssibling);
-                }
-
-                /* find the beginning */
-                if (lys_parent(first_ssibling)) {
-                    first_ssibling = lys_parent(first_ssibling)->child;
-                } else {
-                    while (first_ssibling->prev->next) {
-                        first_ssibling = first_ssibling->prev;
-                    }
-                }
-            }
-
-            if (lys_module_node_pos_r(first_ssibling, node->schema, &array[i].pos)) {
-                free(array);
-                return -1;
-            }
-
-            array[i].node = node;
-        }
-
-        /* sort the arrays */
-        qsort(array, len, sizeof *array, lyd_node_pos_cmp);
-
-        /* adjust siblings based on the sorted array */
-        for (i = 0; i < len; ++i) {
-            /* parent child */
-            if (i == 0) {
-                /* adjust sibling so that it still points to the beginning */
-                sibling = array[i].node;
-                if (array[i].node->parent) {
-                    array[i].node->parent->child = array[i].node;
-                }
-            }
-
-            /* prev */
-            if (i > 0) {
-                array[i].node->prev = array[i - 1].node;
-            } else {
-                array[i].node->prev = array[len - 1].node;
-            }
-
-            /* next */
-            if (i < len - 1) {
-                array[i].node->next = array[i + 1].node;
-            } else {
-                array[i].node->next = NULL;
-            }
-        }
-        free(array);
+    /* fix options */
+    if ((options & LYD_DUP_OPT_RECURSIVE) && (options & LYD_DUP_OPT_WITH_KEYS)) {
+        options &= ~LYD_DUP_OPT_WITH_KEYS;
     }
 
-    /* sort all the children recursively */
-    if (recursive) {
-        LY_TREE_FOR(sibling, node) {
-            if ((node->schema->nodetype & (LYS_CONTAINER | LYS_LIST | LYS_RPC | LYS_ACTION | LYS_NOTIF))
-                    && node->child && lyd_schema_sort(node->child, recursive)) {
-                return -1;
-            }
-        }
+    log_ctx = (ctx ? ctx : node->schema->module->ctx);
+    if (ctx == node->schema->module->ctx) {
+        /* target context is actually the same as the source context,
+         * ignore the target context */
+        ctx = NULL;
     }
 
-    return EXIT_SUCCESS;
-}
-
-static int
-_lyd_validate(struct lyd_node **node, struct lyd_node *data_tree, struct ly_ctx *ctx, const struct lys_module **modules,
-              int mod_count, struct lyd_difflist **diff, int options)
-{
-    struct lyd_node *root, *next1, *next2, *iter, *act_notif = NULL;
-    int ret = EXIT_FAILURE;
-    unsigned int i;
-    struct unres_data *unres = NULL;
-    const struct lys_module *yanglib_mod;
-
-    unres = calloc(1, sizeof *unres);
-    LY_CHECK_ERR_RETURN(!unres, LOGMEM(NULL), EXIT_FAILURE);
+    ret = NULL;
+    parent = NULL;
 
-    if (diff) {
-        unres->store_diff = 1;
-        unres->diff = lyd_diff_init_difflist(ctx, &unres->diff_size);
+    /* the strings and nodes are mostly the same as in the original tree */
+    lydict_cache_start(log_ctx);
+    lyd_pool_stash_start(log_ctx);
+    if (ctx) {
+        lys_schema_map_start(ctx);
     }
 
-    if ((options & (LYD_OPT_RPC | LYD_OPT_RPCREPLY)) && *node && ((*node)->schema->nodetype != LYS_RPC)) {
-        options |= LYD_OPT_ACT_NOTIF;
-    }
-    if ((options & (LYD_OPT_NOTIF | LYD_OPT_NOTIF_FILTER)) && *node && ((*node)->schema->nodetype != LYS_NOTIF)) {
-        options |= LYD_OPT_ACT_NOTIF;
-    }
+    /* LY_TREE_DFS */
+    for (elem = next = node; elem; elem = next) {
 
-    LY_TREE_FOR_SAFE(*node, next1, root) {
-        if (modules) {
-            for (i = 0; i < (unsigned)mod_count; ++i) {
-                if (lyd_node_module(root) == modules[i]) {
-                    break;
+        /* find the correct schema */
+        if (ctx) {
+            schema = lys_schema_map_get(elem->schema, ctx);
+            if (!schema && parent) {
+                trg_mod = lyp_get_module(parent->schema->module, NULL, 0, lyd_node_module(elem)->name,
+                                         strlen(lyd_node_module(elem)->name), 1);
+                if (!trg_mod) {
+                    LOGERR(log_ctx, LY_EINVAL, "Target context does not contain model for the data node being duplicated (%s).",
+                                lyd_node_module(elem)->name);
+                    goto error;
                 }
-            }
-            if (i == (unsigned)mod_count) {
-                /* skip data that should not be validated */
-                continue;
-            }
-        }
-
-        LY_TREE_DFS_BEGIN(root, next2, iter) {
-            if (iter->parent && (iter->schema->nodetype & (LYS_ACTION | LYS_NOTIF))) {
-                if (!(options & LYD_OPT_ACT_NOTIF) || act_notif) {
-                    LOGVAL(ctx, LYE_INELEM, LY_VLOG_LYD, iter, iter->schema->name);
-                    LOGVAL(ctx, LYE_SPEC, LY_VLOG_PREV, NULL, "Unexpected %s node \"%s\".",
-                           (options & LYD_OPT_RPC ? "action" : "notification"), iter->schema->name);
-                    goto cleanup;
+                /* we know its parent, so we can start with it */
+                lys_getnext_data(trg_mod, parent->schema, elem->schema->name, strlen(elem->schema->name),
+                                 elem->schema->nodetype, 0, (const struct lys_node **)&schema);
+                if (schema) {
+                    lys_schema_map_add(elem->schema, schema, ctx);
                 }
-                act_notif = iter;
-            }
-
-            if (lyv_data_context(iter, options, unres) || lyv_data_content(iter, options, unres)) {
-                goto cleanup;
+            } else if (!schema) {
+                /* we have to search in complete context */
+                schema = lyd_get_schema_inctx(elem, ctx);
             }
 
-            /* empty non-default, non-presence container without attributes, make it default */
-            if (!iter->dflt && (iter->schema->nodetype == LYS_CONTAINER) && !iter->child
-                        && !((struct lys_node_container *)iter->schema)->presence && !iter->attr) {
-                iter->dflt = 1;
+            if (!schema) {
+                yang_data_name = lyp_get_yang_data_template_name(elem);
+                if (yang_data_name) {
+                    LOGERR(log_ctx, LY_EINVAL, "Target context does not contain schema node for the data node being duplicated "
+                                        "(%s:#%s/%s).", lyd_node_module(elem)->name, yang_data_name, elem->schema->name);
+                } else {
+                    LOGERR(log_ctx, LY_EINVAL, "Target context does not contain schema node for the data node being duplicated "
+                                        "(%s:%s).", lyd_node_module(elem)->name, elem->schema->name);
+                }
+                goto error;
             }
-
-            LY_TREE_DFS_END(root, next2, iter);
+        } else {
+            schema = elem->schema;
         }
 
-        if (options & LYD_OPT_NOSIBLINGS) {
-            break;
+        /* make node copy */
+        new_node = _lyd_dup_node(elem, schema, log_ctx, options);
+        if (!new_node) {
+            goto error;
         }
 
-    }
+        if (parent && lyd_insert(parent, new_node)) {
+            goto error;
+        }
 
-    if (options & LYD_OPT_ACT_NOTIF) {
-        if (!act_notif) {
-            LOGVAL(ctx, LYE_MISSELEM, LY_VLOG_LYD, *node, (options & LYD_OPT_RPC ? "action" : "notification"), (*node)->schema->name);
-            goto cleanup;
+        if (!ret) {
+            ret = new_node;
         }
-        options &= ~LYD_OPT_ACT_NOTIF;
-    }
 
-    if (*node) {
-        /* check for uniqueness of top-level lists/leaflists because
-         * only the inner instances were tested in lyv_data_content() */
-        yanglib_mod = ly_ctx_get_module(ctx ? ctx : (*node)->schema->module->ctx, "ietf-yang-library", NULL, 1);
-        LY_TREE_FOR(*node, root) {
-            if ((options & LYD_OPT_DATA_ADD_YANGLIB) && yanglib_mod && (root->schema->module == yanglib_mod)) {
-                /* ietf-yang-library data present, so ignore the option to add them */
-                options &= ~LYD_OPT_DATA_ADD_YANGLIB;
-            }
+        if (!(options & (LYD_DUP_OPT_RECURSIVE | LYD_DUP_OPT_WITH_KEYS))) {
+            /* no more descendants copied */
+            break;
+        }
 
-            if (!(root->schema->nodetype & (LYS_LIST | LYS_LEAFLIST)) || !(root->validity & LYD_VAL_DUP)) {
-                continue;
+        if (options & LYD_DUP_OPT_WITH_KEYS) {
+            /* copy only descendant keys */
+            if (lyd_dup_keys(new_node, elem, NULL, log_ctx, options)) {
+                goto error;
             }
+            break;
+        }
 
-            if (options & LYD_OPT_TRUSTED) {
-                /* just clear the flag */
-                root->validity &= ~LYD_VAL_DUP;
-                continue;
+        /* LY_TREE_DFS_END */
+        /* select element for the next run - children first,
+         * child exception for lyd_node_leaf and lyd_node_leaflist */
+        if (elem->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST | LYS_ANYDATA)) {
+            next = NULL;
+        } else {
+            next = elem->child;
+        }
+        if (!next) {
+            if (elem->parent == node->parent) {
+                break;
             }
-
-            if (lyv_data_dup(root, *node)) {
-                goto cleanup;
+            /* no children, so try siblings */
+            next = elem->next;
+        } else {
+            parent = new_node;
+#ifdef LY_ENABLED_CACHE
+            /* the number of hashed children is known, size the hash table at once */
+            if (elem->ht && lyd_hash_reserve(parent, elem->ht->used)) {
+                goto error;
             }
+#endif
         }
-    }
+        new_node = NULL;
 
-    /* add missing ietf-yang-library if requested */
-    if (options & LYD_OPT_DATA_ADD_YANGLIB) {
-        if (!(*node)) {
-            (*node) = ly_ctx_info(ctx);
-        } else if (lyd_merge((*node), ly_ctx_info(ctx), LYD_OPT_DESTRUCT | LYD_OPT_EXPLICIT)) {
-            LOGERR(ctx, LY_EINT, "Adding ietf-yang-library data failed.");
-            goto cleanup;
+        while (!next) {
+            /* no siblings, go back through parents */
+            elem = elem->parent;
+            if (elem->parent == node->parent) {
+                break;
+            }
+            if (!parent) {
+                LOGINT(log_ctx);
+                goto error;
+            }
+            parent = parent->parent;
+            /* parent is already processed, go to its sibling */
+            next = elem->next;
         }
     }
 
-    /* add default values, resolve unres and check for mandatory nodes in final tree */
-    if (lyd_defaults_add_unres(node, options, ctx, modules, mod_count, data_tree, act_notif, unres, 1)) {
-        goto cleanup;
-    }
-    if (act_notif) {
-        if (lyd_check_mandatory_tree(act_notif, ctx, modules, mod_count, options)) {
-            goto cleanup;
-        }
-    } else {
-        if (lyd_check_mandatory_tree(*node, ctx, modules, mod_count, options)) {
-            goto cleanup;
+    /* dup all the parents */
+    if (options & LYD_DUP_OPT_WITH_PARENTS) {
+        parent = ret;
+        if (lys_is_key((struct lys_node_leaf *)ret->schema, NULL)) {
+            /* this key was being duplicated so do not add it twice */
+            schema = ret->schema;
+        } else {
+            schema = NULL;
         }
-    }
-
-    if ((options & (LYD_OPT_RPC | LYD_OPT_RPCREPLY)) && *node && lyd_schema_sort(*node, 1)) {
-        /* rpc and rpc-reply must be sorted */
-        goto cleanup;
-    }
-
-    /* consolidate diff if created */
-    if (diff) {
-        assert(unres->store_diff);
+        for (elem = node->parent; elem; elem = elem->parent) {
+            new_node = lyd_dup(elem, options & LYD_DUP_OPT_NO_ATTR);
+            LY_CHECK_ERR_GOTO(!new_node, LOGMEM(log_ctx), error);
 
-        for (i = 0; i < unres->diff_idx; ++i) {
-            if (unres->diff->type[i] == LYD_DIFF_CREATED) {
-                if (unres->diff->second[i]->parent) {
-                    unres->diff->first[i] = (struct lyd_node *)lyd_path(unres->diff->second[i]->parent);
-                }
-                unres->diff->second[i] = lyd_dup(unres->diff->second[i], LYD_DUP_OPT_RECURSIVE);
+            /* dup all list keys */
+            if (lyd_dup_keys(new_node, elem, schema, log_ctx, options)) {
+                goto error;
             }
-        }
-
-        *diff = unres->diff;
-        unres->diff = 0;
-        unres->diff_idx = 0;
-    }
 
-    ret = EXIT_SUCCESS;
-
-cleanup:
-    if (unres) {
-        free(unres->node);
-        free(unres->type);
-        for (i = 0; i < unres->diff_idx; ++i) {
-            if (unres->diff->type[i] == LYD_DIFF_DELETED) {
-                lyd_free_withsiblings(unres->diff->first[i]);
-                free(unres->diff->second[i]);
+            /* link together */
+            if (lyd_insert(new_node, parent)) {
+                ret = parent;
+                goto error;
             }
+            parent = new_node;
         }
-        lyd_free_diff(unres->diff);
-        free(unres);
     }
 
+    if (ctx) {
+        lys_schema_map_stop(ctx);
+    }
+    lyd_pool_stash_flush(log_ctx);
+    lydict_cache_flush(log_ctx);
     return ret;
+
+error:
+    lyd_free(ret);
+    if (ctx) {
+        lys_schema_map_stop(ctx);
+    }
+    lyd_pool_stash_flush(log_ctx);
+    lydict_cache_flush(log_ctx);
+    return NULL;
 }
 
-API int
-lyd_validate(struct lyd_node **node, int options, void *var_arg, ...)
+API struct lyd_node *
+lyd_dup(const struct lyd_node *node, int options)
 {
     FUN_IN;
 
-    struct lyd_node *iter, *data_tree = NULL;
-    struct lyd_difflist **diff = NULL;
-    struct ly_ctx *ctx = NULL;
-    va_list ap;
+    return lyd_dup_to_ctx(node, options, NULL);
+}
 
-    if (!node) {
-        LOGARG;
-        return EXIT_FAILURE;
-    }
+static struct lyd_node *
+lyd_dup_withsiblings_r(const struct lyd_node *first, struct lyd_node *parent_dup, int options, struct ly_ctx *ctx)
+{
+    struct lyd_node *first_dup = NULL, *prev_dup = NULL, *last_dup;
+    const struct lyd_node *next;
 
-    if (lyp_data_check_options(NULL, options, __func__)) {
-        return EXIT_FAILURE;
-    }
+    assert(first);
 
-    data_tree = *node;
+    /* duplicate and connect all siblings */
+    LY_TREE_FOR(first, next) {
+        last_dup = _lyd_dup_node(next, next->schema, ctx, options);
+        if (!last_dup) {
+            goto error;
+        }
 
-    if ((!(options & LYD_OPT_TYPEMASK)
-            || (options & (LYD_OPT_CONFIG | LYD_OPT_GET | LYD_OPT_GETCONFIG | LYD_OPT_EDIT))) && !(*node)) {
-        /* get context with schemas from the var_arg */
-        ctx = (struct ly_ctx *)var_arg;
-        if (!ctx) {
-            LOGERR(NULL, LY_EINVAL, "%s: invalid variable parameter (struct ly_ctx *ctx).", __func__);
-            return EXIT_FAILURE;
+        /* the whole data tree is exactly the same so we can safely copy the validation flags */
+        last_dup->validity = next->validity;
+        last_dup->when_status = next->when_status;
+
+        last_dup->parent = parent_dup;
+        /* connect to the parent or the siblings */
+        if (!first_dup) {
+            first_dup = last_dup;
+            if (parent_dup) {
+                parent_dup->child = first_dup;
+            }
+        } else {
+            assert(prev_dup);
+            prev_dup->next = last_dup;
+            last_dup->prev = prev_dup;
         }
 
-        /* LYD_OPT_NOSIBLINGS has no meaning here */
-        options &= ~LYD_OPT_NOSIBLINGS;
-    } else if (options & (LYD_OPT_RPC | LYD_OPT_RPCREPLY | LYD_OPT_NOTIF)) {
-        /* LYD_OPT_NOSIBLINGS cannot be set in this case */
-        if (options & LYD_OPT_NOSIBLINGS) {
-            LOGERR(NULL, LY_EINVAL, "%s: invalid parameter (variable arg const struct lyd_node *data_tree with LYD_OPT_NOSIBLINGS).", __func__);
-            return EXIT_FAILURE;
-        } else if (!(*node)) {
-            LOGARG;
-            return EXIT_FAILURE;
+#ifdef LY_ENABLED_CACHE
+        /* copy hash */
+        if ((last_dup->schema->nodetype != LYS_LIST) || lyd_list_has_keys(last_dup)) {
+            last_dup->hash = next->hash;
         }
 
-        /* get the additional data tree if given */
-        data_tree = (struct lyd_node *)var_arg;
-        if (data_tree) {
-            if (options & LYD_OPT_NOEXTDEPS) {
-                LOGERR(NULL, LY_EINVAL, "%s: invalid parameter (variable arg const struct lyd_node *data_tree and LYD_OPT_NOEXTDEPS set).",
-                       __func__);
-                return EXIT_FAILURE;
+        /* insert into parent */
+        lyd_insert_hash(last_dup);
+#endif
+
+        if ((next->schema->nodetype & (LYS_LIST | LYS_CONTAINER | LYS_RPC | LYS_ACTION | LYS_NOTIF)) && next->child) {
+#ifdef LY_ENABLED_CACHE
+            /* the number of hashed children is known, size the hash table at once */
+            if (next->ht && lyd_hash_reserve(last_dup, next->ht->used)) {
+                goto error;
+            }
+#endif
+
+            /* recursively duplicate all children */
+            if (!lyd_dup_withsiblings_r(next->child, last_dup, options, ctx)) {
+                goto error;
             }
+        }
+
+        prev_dup = last_dup;
+    }
+
+    /* correctly set last sibling */
+    assert(!prev_dup->next);
+    first_dup->prev = prev_dup;
+
+    return first_dup;
+
+error:
+    /* disconnect and free */
+    if (first_dup) {
+        first_dup->parent = NULL;
+        lyd_free_withsiblings(first_dup);
+    }
+    return NULL;
+}
 
-            LY_TREE_FOR(data_tree, iter) {
-                if (iter->parent) {
-                    /* a sibling is not top-level */
-                    LOGERR(NULL, LY_EINVAL, "%s: invalid variable parameter (const struct lyd_node *data_tree).", __func__);
-                    return EXIT_FAILURE;
-                }
-            }
+static struct lyd_node *
+lyd_dup_withsiblings_to_ctx(const struct lyd_node *node, int options, struct ly_ctx *ctx)
+{
+    const struct lyd_node *iter;
+    struct lyd_node *ret, *ret_iter, *tmp;
 
-            /* move it to the beginning */
-            for (; data_tree->prev->next; data_tree = data_tree->prev);
-        }
-    } else if (options & LYD_OPT_DATA_TEMPLATE) {
-        /* get context with schemas from the var_arg */
-        if (*node && ((*node)->prev->next || (*node)->next)) {
-            /* not allow sibling in top-level */
-            LOGERR(NULL, LY_EINVAL, "%s: invalid variable parameter (struct lyd_node *node).", __func__);
-            return EXIT_FAILURE;
-        }
+    if (!node) {
+        return NULL;
     }
 
-    if (options & LYD_OPT_VAL_DIFF) {
-        va_start(ap, var_arg);
-        diff = va_arg(ap, struct lyd_difflist **);
-        va_end(ap);
-        if (!diff) {
-            LOGERR(ctx, LY_EINVAL, "%s: invalid variable parameter (struct lyd_difflist **).", __func__);
-            return EXIT_FAILURE;
-        }
+    /* find first sibling */
+    while (node->prev->next) {
+        node = node->prev;
     }
 
-    if (*node) {
-        if (!ctx) {
-            ctx = (*node)->schema->module->ctx;
+    if (node->parent) {
+        ret = lyd_dup_to_ctx(node, options, ctx);
+        if (!ret) {
+            return NULL;
         }
-        if (!(options & LYD_OPT_NOSIBLINGS)) {
-            /* check that the node is the first sibling */
-            while ((*node)->prev->next) {
-                *node = (*node)->prev;
+
+        /* copy following siblings */
+        ret_iter = ret;
+        LY_TREE_FOR(node->next, iter) {
+            tmp = lyd_dup_to_ctx(iter, options, ctx);
+            if (!tmp) {
+                lyd_free_withsiblings(ret);
+                return NULL;
+            }
+
+            if (lyd_insert_after(ret_iter, tmp)) {
+                lyd_free_withsiblings(ret);
+                return NULL;
             }
+            ret_iter = ret_iter->next;
+            assert(ret_iter == tmp);
         }
+    } else {
+        /* duplicating top-level siblings, we can duplicate much more efficiently */
+        ret = lyd_dup_withsiblings_r(node, NULL, options, ctx);
     }
 
-    return _lyd_validate(node, data_tree, ctx, NULL, 0, diff, options);
+    return ret;
 }
 
-API int
-lyd_validate_modules(struct lyd_node **node, const struct lys_module **modules, int mod_count, int options, ...)
+API struct lyd_node *
+lyd_dup_withsiblings(const struct lyd_node *node, int options)
 {
     FUN_IN;
 
     struct ly_ctx *ctx;
-    struct lyd_difflist **diff = NULL;
-    va_list ap;
-
-    if (!node || !modules || !mod_count) {
-        LOGARG;
-        return EXIT_FAILURE;
-    }
-
-    ctx = modules[0]->ctx;
-
-    if (*node && !(options & LYD_OPT_NOSIBLINGS)) {
-        /* check that the node is the first sibling */
-        while ((*node)->prev->next) {
-            *node = (*node)->prev;
-        }
-    }
+    struct lyd_node *ret;
 
-    if (lyp_data_check_options(ctx, options, __func__)) {
-        return EXIT_FAILURE;
+    if (!node) {
+        return NULL;
     }
 
-    if ((options & LYD_OPT_TYPEMASK) && !(options & (LYD_OPT_CONFIG | LYD_OPT_GET | LYD_OPT_GETCONFIG | LYD_OPT_EDIT))) {
-        LOGERR(NULL, LY_EINVAL, "%s: options include a forbidden data type.", __func__);
-        return EXIT_FAILURE;
-    }
+    ctx = lyd_node_module(node)->ctx;
 
-    if (options & LYD_OPT_VAL_DIFF) {
-        va_start(ap, options);
-        diff = va_arg(ap, struct lyd_difflist **);
-        va_end(ap);
-        if (!diff) {
-            LOGERR(ctx, LY_EINVAL, "%s: invalid variable parameter (struct lyd_difflist **).", __func__);
-            return EXIT_FAILURE;
-        }
-    }
+    /* the strings and nodes are mostly the same as in the original tree */
+    lydict_cache_start(ctx);
+    lyd_pool_stash_start(ctx);
+    ret = lyd_dup_withsiblings_to_ctx(node, options, ctx);
+    lyd_pool_stash_flush(ctx);
+    lydict_cache_flush(ctx);
 
-    return _lyd_validate(node, *node, ctx, modules, mod_count, diff, options);
+    return ret;
 }
 
-API int
-lyd_validate_value(struct lys_node *node, const char *value)
+API void
+lyd_free_attr(struct ly_ctx *ctx, struct lyd_node *parent, struct lyd_attr *attr, int recursive)
 {
     FUN_IN;
 
-    struct lyd_node_leaf_list leaf;
-    struct lys_node_leaf *sleaf = (struct lys_node_leaf*)node;
-    int ret = EXIT_SUCCESS;
+    struct lyd_attr *iter;
+    struct lys_type **type;
 
-    if (!node || !(node->nodetype & (LYS_LEAF | LYS_LEAFLIST))) {
-        LOGARG;
-        return EXIT_FAILURE;
+    if (!ctx || !attr) {
+        return;
     }
 
-    if (!value) {
-        value = "";
+    if (parent) {
+        if (parent->attr == attr) {
+            if (recursive) {
+                parent->attr = NULL;
+            } else {
+                parent->attr = attr->next;
+            }
+        } else {
+            for (iter = parent->attr; iter->next != attr; iter = iter->next);
+            if (iter->next) {
+                if (recursive) {
+                    iter->next = NULL;
+                } else {
+                    iter->next = attr->next;
+                }
+            }
+        }
     }
 
-    /* dummy leaf */
-    memset(&leaf, 0, sizeof leaf);
-    leaf.value_str = lydict_insert(node->module->ctx, value, 0);
+    if (!recursive) {
+        attr->next = NULL;
+    }
 
-repeat:
-    leaf.value_type = sleaf->type.base;
-    leaf.schema = node;
+    for(iter = attr; iter; ) {
+        attr = iter;
+        iter = iter->next;
 
-    if (leaf.value_type == LY_TYPE_LEAFREF) {
-        if (!sleaf->type.info.lref.target) {
-            /* it should either be unresolved leafref (leaf.value_type are ORed flags) or it will be resolved */
-            LOGINT(node->module->ctx);
-            ret = EXIT_FAILURE;
-            goto cleanup;
-        }
-        sleaf = sleaf->type.info.lref.target;
-        goto repeat;
-    } else {
-        if (!lyp_parse_value(&sleaf->type, &leaf.value_str, NULL, &leaf, NULL, NULL, 0, 0, 0)) {
-            ret = EXIT_FAILURE;
-            goto cleanup;
+        lydict_remove(ctx, attr->name);
+        type = lys_ext_complex_get_substmt(LY_STMT_TYPE, attr->annotation, NULL);
+        assert(type);
+        lyd_free_value(attr->value, attr->value_type, attr->value_flags, *type, attr->value_str, NULL, NULL, NULL);
+        lydict_remove(ctx, attr->value_str);
+        lyd_pool_free(ctx, attr);
+    }
+}
+
+const struct lyd_node *
+lyd_attr_parent(const struct lyd_node *root, struct lyd_attr *attr)
+{
+    const struct lyd_node *next, *elem;
+    struct lyd_attr *node_attr;
+
+    LY_TREE_DFS_BEGIN(root, next, elem) {
+        for (node_attr = elem->attr; node_attr; node_attr = node_attr->next) {
+            if (node_attr == attr) {
+                return elem;
+            }
         }
+        LY_TREE_DFS_END(root, next, elem)
     }
 
-cleanup:
-    lydict_remove(node->module->ctx, leaf.value_str);
-    return ret;
+    return NULL;
 }
 
-/* create an attribute copy */
-static struct lyd_attr *
-lyd_dup_attr(struct ly_ctx *ctx, struct lyd_node *parent, struct lyd_attr *attr)
+API struct lyd_attr *
+lyd_insert_attr(struct lyd_node *parent, const struct lys_module *mod, const char *name, const char *value)
 {
-    struct lyd_attr *ret;
+    FUN_IN;
 
-    /* allocate new attr */
-    if (!parent->attr) {
-        parent->attr = malloc(sizeof *parent->attr);
-        ret = parent->attr;
-    } else {
-        for (ret = parent->attr; ret->next; ret = ret->next);
-        ret->next = calloc(1, sizeof *ret);
-        ret = ret->next;
+    struct lyd_attr *a, *iter;
+    struct ly_ctx *ctx;
+    const struct lys_module *module;
+    struct lys_ext_instance *annot;
+    const char *p;
+    char *aux;
+
+    if (!parent || !name || !value) {
+        LOGARG;
+        return NULL;
     }
-    LY_CHECK_ERR_RETURN(!ret, LOGMEM(ctx), NULL);
+    ctx = parent->schema->module->ctx;
 
-    /* fill new attr except */
-    ret->parent = parent;
-    ret->next = NULL;
-    ret->annotation = attr->annotation;
-    ret->name = lydict_insert(ctx, attr->name, 0);
-    ret->value_str = lydict_insert(ctx, attr->value_str, 0);
-    ret->value_type = attr->value_type;
-    ret->value_flags = attr->value_flags;
-    switch (ret->value_type) {
-    case LY_TYPE_BINARY:
-    case LY_TYPE_STRING:
-        /* value_str pointer is shared in these cases */
-        ret->value.string = ret->value_str;
-        break;
-    case LY_TYPE_LEAFREF:
-        lyp_parse_value(*((struct lys_type **)lys_ext_complex_get_substmt(LY_STMT_TYPE, ret->annotation, NULL)),
-                             &ret->value_str, NULL, NULL, ret, NULL, 1, 0, 0);
-        break;
-    case LY_TYPE_INST:
-        ret->value.instance = NULL;
-        break;
-    case LY_TYPE_UNION:
-        /* unresolved union (this must be non-validated tree), duplicate the stored string (duplicated
-         * because of possible change of the value in case of instance-identifier) */
-        ret->value.string = lydict_insert(ctx, attr->value.string, 0);
-        break;
-    case LY_TYPE_ENUM:
-    case LY_TYPE_IDENT:
-    case LY_TYPE_BITS:
-        /* in case of duplicating bits (no matter if in the same context or not) or enum and identityref into
-         * a different context, searching for the type and duplicating the data is almost as same as resolving
-         * the string value, so due to a simplicity, parse the value for the duplicated leaf */
-        lyp_parse_value(*((struct lys_type **)lys_ext_complex_get_substmt(LY_STMT_TYPE, ret->annotation, NULL)),
-                             &ret->value_str, NULL, NULL, ret, NULL, 1, 0, 0);
-        break;
-    default:
-        ret->value = attr->value;
-        break;
+    if ((p = strchr(name, ':'))) {
+        /* search for the namespace */
+        aux = strndup(name, p - name);
+        if (!aux) {
+            LOGMEM(ctx);
+            return NULL;
+        }
+        module = ly_ctx_get_module(ctx, aux, NULL, 1);
+        free(aux);
+        name = p + 1;
+
+        if (!module) {
+            /* module not found */
+            LOGERR(ctx, LY_EINVAL, "Attribute prefix does not match any implemented schema in the context.");
+            return NULL;
+        }
+    } else if (mod) {
+        module = mod;
+    } else if (!mod && (!strcmp(name, "type") || !strcmp(name, "select")) && !strcmp(parent->schema->name, "filter")) {
+        /* special case of inserting unqualified filter attributes "type" and "select" */
+        module = ly_ctx_get_module(ctx, "ietf-netconf", NULL, 1);
+        if (!module) {
+            LOGERR(ctx, LY_EINVAL, "Attribute prefix does not match any implemented schema in the context.");
+            return NULL;
+        }
+    } else {
+        /* no prefix -> module is the same as for the parent */
+        module = lyd_node_module(parent);
     }
-    return ret;
-}
 
-int
-lyd_unlink_internal(struct lyd_node *node, int permanent)
-{
-    struct lyd_node *iter;
+    annot = lyp_ext_instance_find(module, "ietf-yang-metadata", "annotation", name, strlen(name));
+    if (!annot) {
+        LOGERR(ctx, LY_EINVAL, "Attribute does not match any annotation instance definition.");
+        return NULL;
+    }
 
-    if (!node) {
-        LOGARG;
-        return EXIT_FAILURE;
+    a = lyd_pool_alloc(ctx, sizeof *a);
+    LY_CHECK_ERR_RETURN(!a, LOGMEM(ctx), NULL);
+    a->parent = parent;
+    a->next = NULL;
+    a->annotation = (struct lys_ext_instance_complex *)annot;
+    a->name = lydict_insert(ctx, name, 0);
+    a->value_str = lydict_insert(ctx, value, 0);
+    if (!lyp_parse_value(*((struct lys_type **)lys_ext_complex_get_substmt(LY_STMT_TYPE, a->annotation, NULL)),
+                         &a->value_str, NULL, NULL, a, NULL, 1, 0, 0)) {
+        lyd_free_attr(ctx, NULL, a, 0);
+        return NULL;
     }
 
-    if (permanent) {
-        check_leaf_list_backlinks(node);
+    if (!parent->attr) {
+        parent->attr = a;
+    } else {
+        for (iter = parent->attr; iter->next; iter = iter->next);
+        iter->next = a;
     }
 
-    /* unlink from siblings */
-    if (node->prev->next) {
-        node->prev->next = node->next;
+    return a;
+}
+
+void
+lyd_free_value(lyd_val value, LY_DATA_TYPE value_type, uint8_t value_flags, struct lys_type *type, const char *value_str,
+               lyd_val *old_val, LY_DATA_TYPE *old_val_type, uint8_t *old_val_flags)
+{
+    if (old_val) {
+        *old_val = value;
+        *old_val_type = value_type;
+        *old_val_flags = value_flags;
+        /* we only backup the values for now */
+        return;
     }
-    if (node->next) {
-        node->next->prev = node->prev;
+
+    /* otherwise the value is correctly freed */
+    if (value_flags & LY_VALUE_USER) {
+        lytype_free(type, value, value_str);
     } else {
-        /* unlinking the last node */
-        if (node->parent) {
-            iter = node->parent->child;
-        } else {
-            iter = node->prev;
-            while (iter->prev != node) {
-                iter = iter->prev;
+        switch (value_type) {
+        case LY_TYPE_BITS:
+            if (value.bit) {
+                free(value.bit);
+            }
+            break;
+        case LY_TYPE_INST:
+            if (!(value_flags & LY_VALUE_UNRES)) {
+                break;
             }
+            /* fallthrough */
+        case LY_TYPE_UNION:
+            /* unresolved union leaf */
+            lydict_remove(type->parent->module->ctx, value.string);
+            break;
+        default:
+            break;
         }
-        /* update the "last" pointer from the first node */
-        iter->prev = node->prev;
     }
+}
 
-    /* unlink from parent */
-    if (node->parent) {
-        if (node->parent->child == node) {
-            /* the node is the first child */
-            node->parent->child = node->next;
-        }
+#ifdef LY_ENABLED_DATA_POOL
 
-#ifdef LY_ENABLED_CACHE
-        /* do not remove from parent hash table if freeing the whole subtree */
-        if (permanent != 2) {
-            lyd_unlink_hash(node, node->parent);
-        }
-#endif
+/**
+ * @brief Thread-specific stash of free data pool slots. While parsing or freeing data of a context,
+ * the slots are taken from and returned into the stash and the pool is locked only when the stash is empty
+ * and when it is returned.
+ */
+static THREAD_LOCAL struct {
+    struct ly_ctx *ctx;         /* context the stash is used for, NULL if not used */
+    uint32_t depth;             /* number of nested lyd_pool_stash_start() calls */
+    union lyd_pool_slot *first; /* stashed slots */
+    union lyd_pool_slot *last;
+} pool_stash;
 
-        node->parent = NULL;
-    }
+/**
+ * @brief Take free slots from a data pool, it must be locked.
+ *
+ * @param[in] pool Data pool.
+ * @param[in] count Number of slots to take.
+ * @param[out] first First taken slot, they are linked, NULL if none could be taken.
+ * @param[out] last Last taken slot.
+ */
+static void
+lyd_pool_take_locked(struct lyd_pool *pool, uint32_t count, union lyd_pool_slot **first, union lyd_pool_slot **last)
+{
+    struct lyd_pool_chunk *chunk;
+    union lyd_pool_slot *slot;
+    uint32_t size;
 
-    node->next = NULL;
-    node->prev = node;
+    *first = *last = NULL;
+    while (count) {
+        if (pool->free) {
+            slot = pool->free;
+            pool->free = slot->next;
+        } else {
+            if (!pool->unused) {
+                /* new chunk */
+                size = pool->chunks ? pool->chunks->size * 2 : LYD_POOL_CHUNK_MIN;
+                if (size > LYD_POOL_CHUNK_MAX) {
+                    size = LYD_POOL_CHUNK_MAX;
+                }
+                if (pool->allocator.malloc_clb) {
+                    chunk = pool->allocator.malloc_clb(sizeof *chunk + size * sizeof *chunk->slots,
+                                                       pool->allocator.user_data);
+                } else {
+                    chunk = malloc(sizeof *chunk + size * sizeof *chunk->slots);
+                }
+                if (!chunk) {
+                    return;
+                }
+                chunk->next = pool->chunks;
+                chunk->size = size;
+                pool->chunks = chunk;
+                pool->unused = size;
+            }
+            slot = &pool->chunks->slots[pool->chunks->size - pool->unused];
+            --pool->unused;
+        }
 
-    return EXIT_SUCCESS;
+        slot->next = NULL;
+        if (*last) {
+            (*last)->next = slot;
+        } else {
+            *first = slot;
+        }
+        *last = slot;
+        --count;
+    }
 }
 
-API int
-lyd_unlink(struct lyd_node *node)
+#endif
+
+void *
+lyd_pool_alloc(struct ly_ctx *ctx, size_t size)
 {
-    FUN_IN;
+#ifdef LY_ENABLED_DATA_POOL
+    union lyd_pool_slot *slot, *last;
 
-    return lyd_unlink_internal(node, 1);
-}
+    assert(size <= sizeof *slot);
 
-/*
- * - in leaflist it must be added with value_str
- */
-static int
-_lyd_dup_node_common(struct lyd_node *new_node, const struct lyd_node *orig, struct ly_ctx *ctx, int options)
-{
-    struct lyd_attr *attr;
+    if (pool_stash.ctx == ctx) {
+        if (!pool_stash.first) {
+            /* refill the stash */
+            pthread_mutex_lock(&ctx->data_pool.lock);
+            lyd_pool_take_locked(&ctx->data_pool, LYD_POOL_BATCH, &pool_stash.first, &pool_stash.last);
+            pthread_mutex_unlock(&ctx->data_pool.lock);
+            if (!pool_stash.first) {
+                return NULL;
+            }
+        }
 
-    new_node->attr = NULL;
-    if (!(options & LYD_DUP_OPT_NO_ATTR)) {
-        LY_TREE_FOR(orig->attr, attr) {
-            lyd_dup_attr(ctx, new_node, attr);
+        slot = pool_stash.first;
+        pool_stash.first = slot->next;
+        if (!pool_stash.first) {
+            pool_stash.last = NULL;
         }
-    }
-    new_node->next = NULL;
-    new_node->prev = new_node;
-    new_node->parent = NULL;
-    new_node->validity = ly_new_node_validity(new_node->schema);
-    new_node->dflt = orig->dflt;
-    if (options & LYD_DUP_OPT_WITH_WHEN) {
-        new_node->when_status = orig->when_status;
     } else {
-        new_node->when_status = orig->when_status & LYD_WHEN;
-    }
-#ifdef LY_ENABLED_CACHE
-    /* just copy the hash, it will not change */
-    if ((new_node->schema->nodetype != LYS_LIST) || lyd_list_has_keys(new_node)) {
-        new_node->hash = orig->hash;
+        pthread_mutex_lock(&ctx->data_pool.lock);
+        lyd_pool_take_locked(&ctx->data_pool, 1, &slot, &last);
+        pthread_mutex_unlock(&ctx->data_pool.lock);
+        if (!slot) {
+            return NULL;
+        }
     }
-#endif
 
-#ifdef LY_ENABLED_LYD_PRIV
-    if (ctx->priv_dup_clb) {
-        new_node->priv = ctx->priv_dup_clb(orig->priv);
-    }
+    memset(slot, 0, size);
+    return slot;
+#else
+    (void)ctx;
+    return calloc(1, size);
 #endif
-
-    return EXIT_SUCCESS;
 }
 
-static struct lyd_node *
-_lyd_dup_node(const struct lyd_node *node, const struct lys_node *schema, struct ly_ctx *ctx, int options)
+void
+lyd_pool_free(struct ly_ctx *ctx, void *ptr)
 {
-    struct lyd_node *new_node = NULL;
-    struct lys_node_leaf *sleaf;
-    struct lyd_node_leaf_list *new_leaf;
-    struct lyd_node_anydata *new_any, *old_any;
-    const struct lys_type *type;
-    int r;
+#ifdef LY_ENABLED_DATA_POOL
+    union lyd_pool_slot *slot = ptr;
 
-    /* fill specific part */
-    switch (node->schema->nodetype) {
-    case LYS_LEAF:
-    case LYS_LEAFLIST:
-        new_leaf = calloc(1, sizeof *new_leaf);
-        new_node = (struct lyd_node *)new_leaf;
-        LY_CHECK_ERR_GOTO(!new_node, LOGMEM(ctx), error);
-        new_node->schema = (struct lys_node *)schema;
+    if (!slot) {
+        return;
+    }
 
-        new_leaf->value_str = lydict_insert(ctx, ((struct lyd_node_leaf_list *)node)->value_str, 0);
-        new_leaf->value_type = ((struct lyd_node_leaf_list *)node)->value_type;
-        new_leaf->value_flags = ((struct lyd_node_leaf_list *)node)->value_flags;
-        if (_lyd_dup_node_common(new_node, node, ctx, options)) {
-            goto error;
+    if (pool_stash.ctx == ctx) {
+        /* returned to the pool with the whole stash */
+        slot->next = pool_stash.first;
+        if (!pool_stash.first) {
+            pool_stash.last = slot;
         }
+        pool_stash.first = slot;
+    } else {
+        pthread_mutex_lock(&ctx->data_pool.lock);
+        slot->next = ctx->data_pool.free;
+        ctx->data_pool.free = slot;
+        pthread_mutex_unlock(&ctx->data_pool.lock);
+    }
+#else
+    (void)ctx;
+    free(ptr);
+#endif
+}
 
-        /* get schema from the correct context */
-        sleaf = (struct lys_node_leaf *)new_leaf->schema;
+void
+lyd_pool_stash_start(struct ly_ctx *ctx)
+{
+#ifdef LY_ENABLED_DATA_POOL
+    if (!pool_stash.ctx) {
+        pool_stash.ctx = ctx;
+    } else if (pool_stash.ctx != ctx) {
+        /* the stash is already used for another context */
+        return;
+    }
 
-        switch (new_leaf->value_type) {
-        case LY_TYPE_BINARY:
-        case LY_TYPE_STRING:
-            /* value_str pointer is shared in these cases */
-            new_leaf->value.string = new_leaf->value_str;
-            break;
-        case LY_TYPE_LEAFREF:
-            new_leaf->validity |= LYD_VAL_LEAFREF;
-            lyp_parse_value(&sleaf->type, &new_leaf->value_str, NULL, new_leaf, NULL, NULL, 1, node->dflt, 0);
-            break;
-        case LY_TYPE_INST:
-            new_leaf->value.instance = NULL;
-            break;
-        case LY_TYPE_UNION:
-            /* unresolved union (this must be non-validated tree), duplicate the stored string (duplicated
-             * because of possible change of the value in case of instance-identifier) */
-            new_leaf->value.string = lydict_insert(ctx, ((struct lyd_node_leaf_list *)node)->value.string, 0);
-            break;
-        case LY_TYPE_ENUM:
-        case LY_TYPE_IDENT:
-        case LY_TYPE_BITS:
-            /* in case of duplicating bits (no matter if in the same context or not) or enum and identityref into
-             * a different context, searching for the type and duplicating the data is almost as same as resolving
-             * the string value, so due to a simplicity, parse the value for the duplicated leaf */
-            if (!lyp_parse_value(&sleaf->type, &new_leaf->value_str, NULL, new_leaf, NULL, NULL, 1, node->dflt, 0)) {
-                goto error;
-            }
-            break;
-        default:
-            new_leaf->value = ((struct lyd_node_leaf_list *)node)->value;
-            break;
-        }
+    ++pool_stash.depth;
+#else
+    (void)ctx;
+#endif
+}
 
-        if (new_leaf->value_flags & LY_VALUE_USER) {
-            /* get the real type */
-            type = lyd_leaf_type(new_leaf);
-            if (!type || !type->der || !type->der->module) {
-                LOGINT(ctx);
-                goto error;
-            }
+void
+lyd_pool_stash_flush(struct ly_ctx *ctx)
+{
+#ifdef LY_ENABLED_DATA_POOL
+    if (pool_stash.ctx != ctx) {
+        return;
+    }
 
-            r = lytype_store(type->der->module, type->der->name, &new_leaf->value_str, &new_leaf->value);
-            if (r == -1) {
-                goto error;
-            } else if (r) {
-                LOGINT(ctx);
-                goto error;
-            }
-        }
-        break;
-    case LYS_ANYXML:
-    case LYS_ANYDATA:
-        old_any = (struct lyd_node_anydata *)node;
-        new_any = calloc(1, sizeof *new_any);
-        new_node = (struct lyd_node *)new_any;
-        LY_CHECK_ERR_GOTO(!new_node, LOGMEM(ctx), error);
-        new_node->schema = (struct lys_node *)schema;
+    if (--pool_stash.depth) {
+        /* nested call */
+        return;
+    }
 
-        if (_lyd_dup_node_common(new_node, node, ctx, options)) {
-            goto error;
-        }
+    if (pool_stash.first) {
+        pthread_mutex_lock(&ctx->data_pool.lock);
+        pool_stash.last->next = ctx->data_pool.free;
+        ctx->data_pool.free = pool_stash.first;
+        pthread_mutex_unlock(&ctx->data_pool.lock);
+    }
+    pool_stash.first = pool_stash.last = NULL;
+    pool_stash.ctx = NULL;
+#else
+    (void)ctx;
+#endif
+}
 
-        new_any->value_type = old_any->value_type;
-        if (!(void*)old_any->value.tree) {
-            /* no value to duplicate */
-            break;
+void
+lyd_pool_clean(struct ly_ctx *ctx)
+{
+#ifdef LY_ENABLED_DATA_POOL
+    struct lyd_pool_chunk *chunk;
+
+    while (ctx->data_pool.chunks) {
+        chunk = ctx->data_pool.chunks;
+        ctx->data_pool.chunks = chunk->next;
+        if (ctx->data_pool.allocator.free_clb) {
+            ctx->data_pool.allocator.free_clb(chunk, ctx->data_pool.allocator.user_data);
+        } else {
+            free(chunk);
         }
-        /* duplicate the value */
-        switch (old_any->value_type) {
+    }
+    ctx->data_pool.unused = 0;
+    ctx->data_pool.free = NULL;
+#else
+    (void)ctx;
+#endif
+}
+
+static void
+_lyd_free_node(struct lyd_node *node)
+{
+    struct lyd_node_leaf_list *leaf;
+
+    if (!node) {
+        return;
+    }
+
+    switch (node->schema->nodetype) {
+    case LYS_CONTAINER:
+    case LYS_LIST:
+    case LYS_RPC:
+    case LYS_ACTION:
+    case LYS_NOTIF:
+#ifdef LY_ENABLED_CACHE
+        /* it should be empty because all the children are freed already (only if in debug mode) */
+        lyht_free(node->ht);
+#endif
+        break;
+    case LYS_ANYDATA:
+    case LYS_ANYXML:
+        switch (((struct lyd_node_anydata *)node)->value_type) {
         case LYD_ANYDATA_CONSTSTRING:
         case LYD_ANYDATA_SXML:
         case LYD_ANYDATA_JSON:
-            new_any->value.str = lydict_insert(ctx, old_any->value.str, 0);
+            lydict_remove(node->schema->module->ctx, ((struct lyd_node_anydata *)node)->value.str);
             break;
         case LYD_ANYDATA_DATATREE:
-            new_any->value.tree = lyd_dup_withsiblings_to_ctx(old_any->value.tree, 1, ctx);
+            lyd_free_withsiblings(((struct lyd_node_anydata *)node)->value.tree);
             break;
         case LYD_ANYDATA_XML:
-            new_any->value.xml = lyxml_dup_elem(ctx, old_any->value.xml, NULL, 1, 1);
+            lyxml_free_withsiblings(node->schema->module->ctx, ((struct lyd_node_anydata *)node)->value.xml);
             break;
         case LYD_ANYDATA_LYB:
-            r = lyd_lyb_data_length(old_any->value.mem);
-            if (r == -1) {
-                LOGERR(ctx, LY_EINVAL, "Invalid LYB data.");
-                goto error;
-            }
-            new_any->value.mem = malloc(r);
-            LY_CHECK_ERR_GOTO(!new_any->value.mem, LOGMEM(ctx), error);
-            memcpy(new_any->value.mem, old_any->value.mem, r);
+            free(((struct lyd_node_anydata *)node)->value.mem);
             break;
         case LYD_ANYDATA_STRING:
         case LYD_ANYDATA_SXMLD:
@@ -5654,1021 +10606,1452 @@ _lyd_dup_node(const struct lyd_node *node, const struct lys_node *schema, struct
             break;
         }
         break;
-    case LYS_CONTAINER:
-    case LYS_LIST:
-    case LYS_NOTIF:
-    case LYS_RPC:
-    case LYS_ACTION:
-        new_node = calloc(1, sizeof *new_node);
-        LY_CHECK_ERR_GOTO(!new_node, LOGMEM(ctx), error);
-        new_node->schema = (struct lys_node *)schema;
-
-        if (_lyd_dup_node_common(new_node, node, ctx, options)) {
-            goto error;
+    case LYS_LEAF:
+    case LYS_LEAFLIST:
+        leaf = (struct lyd_node_leaf_list *)node;
+        if (leaf->schema->module->ctx->lref_rev && (leaf->schema->child
+                || (((struct lys_node_leaf *)leaf->schema)->type.base == LY_TYPE_LEAFREF))) {
+            resolve_lref_rev_remove(node);
         }
+        lyd_free_value(leaf->value, leaf->value_type, leaf->value_flags, &((struct lys_node_leaf *)leaf->schema)->type,
+                       leaf->value_str, NULL, NULL, NULL);
+        lydict_remove(leaf->schema->module->ctx, leaf->value_str);
         break;
     default:
-        LOGINT(ctx);
-        goto error;
+        assert(0);
     }
 
-    return new_node;
+    lyd_free_attr(node->schema->module->ctx, node, node->attr, 1);
+    lyd_pool_free(node->schema->module->ctx, node);
+}
 
-error:
-    lyd_free(new_node);
-    return NULL;
+static void lyd_free_withsiblings_r(struct lyd_node *first);
+
+static void
+lyd_free_internal_r(struct lyd_node *node, int top)
+{
+    if (!node) {
+        return;
+    }
+
+    /* if freeing top-level, always remove it from the parent hash table, the leafref backlinks
+     * of the whole subtree are fixed here as well */
+    lyd_unlink_internal(node, (top ? 1 : 2));
+
+    if (!(node->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST | LYS_ANYDATA))) {
+        /* free children, their parents are being freed so there is no need to unlink them,
+         * maintain the hash tables or invalidate anything */
+        lyd_free_withsiblings_r(node->child);
+        node->child = NULL;
+    }
+
+    _lyd_free_node(node);
 }
 
-static int
-lyd_dup_keys(struct lyd_node *new_list, const struct lyd_node *old_list, struct lys_node *skip_key,
-        struct ly_ctx *log_ctx, int options)
+API void
+lyd_free(struct lyd_node *node)
 {
-    struct lys_node_list *slist;
-    struct lyd_node *key, *key_dup;
-    uint16_t i;
+    FUN_IN;
 
-    if (new_list->schema->nodetype != LYS_LIST) {
-        return 0;
+    struct ly_ctx *ctx;
+
+    if (!node || (lyd_txn_cur && lyd_txn_free(node))) {
+        return;
     }
 
-    slist = (struct lys_node_list *)new_list->schema;
-    for (key = old_list->child, i = 0; key && (i < slist->keys_size); ++i, key = key->next) {
-        if (key->schema != (struct lys_node *)slist->keys[i]) {
-            LOGVAL(log_ctx, LYE_PATH_INKEY, LY_VLOG_LYD, new_list, slist->keys[i]->name);
-            return -1;
+    /* remove all the strings and return all the nodes in batches */
+    ctx = node->schema->module->ctx;
+    lydict_release_start(ctx);
+    lyd_pool_stash_start(ctx);
+    lyd_free_internal_r(node, 1);
+    lyd_pool_stash_flush(ctx);
+    lydict_release_flush(ctx);
+}
+
+static void
+lyd_free_withsiblings_r(struct lyd_node *first)
+{
+    struct lyd_node *next, *node;
+
+    LY_TREE_FOR_SAFE(first, next, node) {
+        if (node->schema->nodetype & (LYS_CONTAINER | LYS_LIST | LYS_RPC | LYS_ACTION | LYS_NOTIF)) {
+            lyd_free_withsiblings_r(node->child);
         }
-        if (key->schema == skip_key) {
-            continue;
+        _lyd_free_node(node);
+    }
+}
+
+API void
+lyd_free_withsiblings(struct lyd_node *node)
+{
+    FUN_IN;
+
+    struct lyd_node *iter, *aux;
+    struct ly_ctx *ctx;
+
+    if (!node) {
+        return;
+    }
+
+    if (lyd_txn_cur && lyd_txn_owns(node)) {
+        /* the nodes are kept until the transaction commit */
+        for (; node->prev->next; node = node->prev);
+        LY_TREE_FOR_SAFE(node, aux, iter) {
+            lyd_free(iter);
         }
+        return;
+    }
 
-        key_dup = lyd_dup(key, options & LYD_DUP_OPT_NO_ATTR);
-        LY_CHECK_ERR_RETURN(!key_dup, LOGMEM(log_ctx), -1);
+    /* remove all the strings and return all the nodes in batches */
+    ctx = node->schema->module->ctx;
+    lydict_release_start(ctx);
+    lyd_pool_stash_start(ctx);
 
-        if (lyd_insert(new_list, key_dup)) {
-            lyd_free(key_dup);
-            return -1;
+    if (node->parent) {
+        /* optimization - avoid freeing (unlinking) the last node of the siblings list */
+        /* so, first, free the node's predecessors to the beginning of the list ... */
+        for(iter = node->prev; iter->next; iter = aux) {
+            aux = iter->prev;
+            lyd_free(iter);
+        }
+        /* ... then, the node is the first in the siblings list, so free them all */
+        LY_TREE_FOR_SAFE(node, aux, iter) {
+            lyd_free(iter);
+        }
+    } else {
+        /* node is top-level so we are freeing the whole data tree, we can just free nodes without any unlinking */
+        while (node->prev->next) {
+            /* find the first sibling */
+            node = node->prev;
         }
+
+        /* free it all */
+        lyd_free_withsiblings_r(node);
     }
-    if (!key && (i < slist->keys_size)) {
-        LOGVAL(log_ctx, LYE_PATH_INKEY, LY_VLOG_LYD, new_list, slist->keys[i]->name);
-        return -1;
+
+    lyd_pool_stash_flush(ctx);
+    lydict_release_flush(ctx);
+}
+
+API struct lyd_txn *
+lyd_txn_start(struct lyd_node *root)
+{
+    FUN_IN;
+
+    struct lyd_txn *txn;
+
+    if (!root) {
+        LOGARG;
+        return NULL;
+    }
+    if (lyd_txn_cur) {
+        LOGERR(root->schema->module->ctx, LY_EINVAL, "A data tree transaction is already active in this thread.");
+        return NULL;
     }
 
-    return 0;
+    txn = calloc(1, sizeof *txn);
+    LY_CHECK_ERR_RETURN(!txn, LOGMEM(root->schema->module->ctx), NULL);
+
+    txn->ctx = root->schema->module->ctx;
+    for (; root->parent; root = root->parent);
+    for (; root->prev->next; root = root->prev);
+    txn->first = txn->orig_first = root;
+
+    lyd_txn_cur = txn;
+    return txn;
+}
+
+static void
+lyd_txn_free_log(struct lyd_txn *txn)
+{
+    uint32_t i;
+
+    for (i = 0; i < txn->count; ++i) {
+        if (txn->recs[i].type == LYD_TXN_VALUE) {
+            lydict_remove(txn->ctx, txn->recs[i].value_str);
+        }
+    }
+    free(txn->recs);
+    lyht_free(txn->detached);
+    free(txn->freed);
+    free(txn);
+}
+
+API void
+lyd_txn_commit(struct lyd_txn *txn)
+{
+    FUN_IN;
+
+    uint32_t i;
+
+    if (!txn) {
+        return;
+    }
+    assert(txn == lyd_txn_cur);
+    lyd_txn_cur = NULL;
+
+    for (i = 0; i < txn->freed_count; ++i) {
+        lyd_free(txn->freed[i]);
+    }
+    lyd_txn_free_log(txn);
 }
 
 API struct lyd_node *
-lyd_dup_to_ctx(const struct lyd_node *node, int options, struct ly_ctx *ctx)
+lyd_txn_rollback(struct lyd_txn *txn)
 {
     FUN_IN;
 
-    struct ly_ctx *log_ctx;
-    struct lys_node *schema;
-    const char *yang_data_name;
-    const struct lys_module *trg_mod;
-    const struct lyd_node *next, *elem;
-    struct lyd_node *ret, *parent, *new_node = NULL;
+    struct lyd_txn_rec *r;
+    struct lyd_node *first;
+    uint32_t i;
+    int dflt;
+
+    if (!txn) {
+        LOGARG;
+        return NULL;
+    }
+    if (txn->err) {
+        LOGERR(txn->ctx, LY_EINVAL, "The data tree transaction cannot be reverted, some changes were not recorded.");
+        lyd_txn_commit(txn);
+        return NULL;
+    }
+    assert(txn == lyd_txn_cur);
+    lyd_txn_cur = NULL;
+
+    /* revert the changes from the last one, so the tree always looks the same as right after the change */
+    for (i = txn->count; i; --i) {
+        r = &txn->recs[i - 1];
+        switch (r->type) {
+        case LYD_TXN_LINK:
+            lyd_unlink_internal(r->node, 1);
+            if (r->flag) {
+                /* it was not in the tree, the original position is restored by its unlink record otherwise */
+                lyd_free(r->node);
+            }
+            break;
+        case LYD_TXN_UNLINK:
+            lyd_link_at(r->node, r->parent, r->prev, r->next);
+            r->node->parent = r->parent;
+#ifdef LY_ENABLED_CACHE
+            lyd_insert_hash(r->node);
+#endif
+            break;
+        case LYD_TXN_VALUE:
+            /* the default flags are restored by their own records */
+            dflt = r->node->dflt;
+            r->node->dflt = 0;
+            lyd_change_leaf((struct lyd_node_leaf_list *)r->node, r->value_str);
+            r->node->dflt = dflt;
+            break;
+        case LYD_TXN_DFLT:
+            r->node->dflt = r->flag;
+            break;
+        }
+    }
+
+    /* the freed nodes are back in the tree or were freed with the nodes inserted into it */
+    first = txn->orig_first;
+    lyd_txn_free_log(txn);
+    return first;
+}
+
+/**
+ * Expectations:
+ * - list exists in data tree
+ * - the leaf (defined by the unique_expr) is not instantiated under the list
+ */
+int
+lyd_get_unique_default(const char* unique_expr, struct lyd_node *list, const char **dflt)
+{
+    struct ly_ctx *ctx = list->schema->module->ctx;
+    const struct lys_node *parent;
+    const struct lys_node_leaf *sleaf = NULL;
+    struct lys_tpdf *tpdf;
+    struct lyd_node *last, *node;
+    struct ly_set *s, *r;
+    unsigned int i;
+    enum int_log_opts prev_ilo;
+
+    assert(unique_expr && list && dflt);
+    *dflt = NULL;
 
-    if (!node) {
-        LOGARG;
-        return NULL;
+    if (resolve_descendant_schema_nodeid(unique_expr, list->schema->child, LYS_LEAF, 1, &parent) || !parent) {
+        /* error, but unique expression was checked when the schema was parsed so this should not happened */
+        LOGINT(ctx);
+        return -1;
     }
 
-    /* fix options */
-    if ((options & LYD_DUP_OPT_RECURSIVE) && (options & LYD_DUP_OPT_WITH_KEYS)) {
-        options &= ~LYD_DUP_OPT_WITH_KEYS;
+    sleaf = (struct lys_node_leaf *)parent;
+    if (sleaf->dflt) {
+        /* leaf has a default value */
+        *dflt = sleaf->dflt;
+    } else if (!(sleaf->flags & LYS_MAND_TRUE)) {
+        /* get the default value from the type */
+        for (tpdf = sleaf->type.der; tpdf && !(*dflt); tpdf = tpdf->type.der) {
+            *dflt = tpdf->dflt;
+        }
     }
 
-    log_ctx = (ctx ? ctx : node->schema->module->ctx);
-    if (ctx == node->schema->module->ctx) {
-        /* target context is actually the same as the source context,
-         * ignore the target context */
-        ctx = NULL;
+    if (!(*dflt)) {
+        return 0;
     }
 
-    ret = NULL;
-    parent = NULL;
+    /* it has default value, but check if it can appear in the data tree under the list */
+    s = ly_set_new();
+    for (parent = lys_parent((struct lys_node *)sleaf); parent != list->schema; parent = lys_parent(parent)) {
+        if (!(parent->nodetype & (LYS_CONTAINER | LYS_CASE | LYS_CHOICE | LYS_USES))) {
+            /* This should be already detected when parsing schema */
+            LOGINT(ctx);
+            ly_set_free(s);
+            return -1;
+        }
+        ly_set_add(s, (void *)parent, LY_SET_OPT_USEASLIST);
+    }
 
-    /* LY_TREE_DFS */
-    for (elem = next = node; elem; elem = next) {
+    ly_ilo_change(NULL, ILO_IGNORE, &prev_ilo, NULL);
+    for (i = 0, last = list; i < s->number; i++) {
+        parent = s->set.s[i]; /* shortcut */
 
-        /* find the correct schema */
-        if (ctx) {
-            schema = NULL;
-            if (parent) {
-                trg_mod = lyp_get_module(parent->schema->module, NULL, 0, lyd_node_module(elem)->name,
-                                         strlen(lyd_node_module(elem)->name), 1);
-                if (!trg_mod) {
-                    LOGERR(log_ctx, LY_EINVAL, "Target context does not contain model for the data node being duplicated (%s).",
-                                lyd_node_module(elem)->name);
-                    goto error;
+        switch (parent->nodetype) {
+        case LYS_CONTAINER:
+            if (last) {
+                /* find instance in the data */
+                r = lyd_find_path(last, parent->name);
+                if (!r || r->number > 1) {
+                    ly_set_free(r);
+                    *dflt = NULL;
+                    goto end;
                 }
-                /* we know its parent, so we can start with it */
-                lys_getnext_data(trg_mod, parent->schema, elem->schema->name, strlen(elem->schema->name),
-                                 elem->schema->nodetype, 0, (const struct lys_node **)&schema);
-            } else {
-                /* we have to search in complete context */
-                schema = lyd_get_schema_inctx(elem, ctx);
-            }
-
-            if (!schema) {
-                yang_data_name = lyp_get_yang_data_template_name(elem);
-                if (yang_data_name) {
-                    LOGERR(log_ctx, LY_EINVAL, "Target context does not contain schema node for the data node being duplicated "
-                                        "(%s:#%s/%s).", lyd_node_module(elem)->name, yang_data_name, elem->schema->name);
+                if (r->number) {
+                    last = r->set.d[0];
                 } else {
-                    LOGERR(log_ctx, LY_EINVAL, "Target context does not contain schema node for the data node being duplicated "
-                                        "(%s:%s).", lyd_node_module(elem)->name, elem->schema->name);
+                    last = NULL;
                 }
-                goto error;
+                ly_set_free(r);
             }
-        } else {
-            schema = elem->schema;
-        }
-
-        /* make node copy */
-        new_node = _lyd_dup_node(elem, schema, log_ctx, options);
-        if (!new_node) {
-            goto error;
-        }
-
-        if (parent && lyd_insert(parent, new_node)) {
-            goto error;
-        }
-
-        if (!ret) {
-            ret = new_node;
-        }
-
-        if (!(options & (LYD_DUP_OPT_RECURSIVE | LYD_DUP_OPT_WITH_KEYS))) {
-            /* no more descendants copied */
-            break;
-        }
-
-        if (options & LYD_DUP_OPT_WITH_KEYS) {
-            /* copy only descendant keys */
-            if (lyd_dup_keys(new_node, elem, NULL, log_ctx, options)) {
-                goto error;
+            if (((struct lys_node_container *)parent)->presence) {
+                /* not-instantiated presence container on path */
+                *dflt = NULL;
+                goto end;
             }
             break;
-        }
-
-        /* LY_TREE_DFS_END */
-        /* select element for the next run - children first,
-         * child exception for lyd_node_leaf and lyd_node_leaflist */
-        if (elem->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST | LYS_ANYDATA)) {
-            next = NULL;
-        } else {
-            next = elem->child;
-        }
-        if (!next) {
-            if (elem->parent == node->parent) {
-                break;
-            }
-            /* no children, so try siblings */
-            next = elem->next;
-        } else {
-            parent = new_node;
-        }
-        new_node = NULL;
-
-        while (!next) {
-            /* no siblings, go back through parents */
-            elem = elem->parent;
-            if (elem->parent == node->parent) {
-                break;
-            }
-            if (!parent) {
-                LOGINT(log_ctx);
-                goto error;
+        case LYS_CHOICE :
+            /* check presence of another case */
+            if (!last) {
+                continue;
             }
-            parent = parent->parent;
-            /* parent is already processed, go to its sibling */
-            next = elem->next;
-        }
-    }
-
-    /* dup all the parents */
-    if (options & LYD_DUP_OPT_WITH_PARENTS) {
-        parent = ret;
-        if (lys_is_key((struct lys_node_leaf *)ret->schema, NULL)) {
-            /* this key was being duplicated so do not add it twice */
-            schema = ret->schema;
-        } else {
-            schema = NULL;
-        }
-        for (elem = node->parent; elem; elem = elem->parent) {
-            new_node = lyd_dup(elem, options & LYD_DUP_OPT_NO_ATTR);
-            LY_CHECK_ERR_GOTO(!new_node, LOGMEM(log_ctx), error);
 
-            /* dup all list keys */
-            if (lyd_dup_keys(new_node, elem, schema, log_ctx, options)) {
-                goto error;
+            /* remember the case to be searched in choice by lyv_multicases() */
+            if (i + 1 == s->number) {
+                parent = (struct lys_node *)sleaf;
+            } else if (s->set.s[i + 1]->nodetype == LYS_CASE && (i + 2 < s->number) &&
+                    s->set.s[i + 2]->nodetype == LYS_CHOICE) {
+                /* nested choices are covered by lyv_multicases, we just have to pass
+                 * the lowest choice */
+                i++;
+                continue;
+            } else {
+                parent = s->set.s[i + 1];
             }
-
-            /* link together */
-            if (lyd_insert(new_node, parent)) {
-                ret = parent;
-                goto error;
+            node = last->child;
+            if (lyv_multicases(NULL, (struct lys_node *)parent, &node, 0, NULL)) {
+                /* another case is present */
+                *dflt = NULL;
+                goto end;
             }
-            parent = new_node;
+            break;
+        default:
+            /* LYS_CASE, LYS_USES */
+            continue;
         }
     }
 
-    return ret;
-
-error:
-    lyd_free(ret);
-    return NULL;
+end:
+    ly_ilo_restore(NULL, prev_ilo, NULL, 0);
+    ly_set_free(s);
+    return 0;
 }
 
-API struct lyd_node *
-lyd_dup(const struct lyd_node *node, int options)
+API char *
+lyd_path(const struct lyd_node *node)
 {
     FUN_IN;
 
-    return lyd_dup_to_ctx(node, options, NULL);
-}
-
-static struct lyd_node *
-lyd_dup_withsiblings_r(const struct lyd_node *first, struct lyd_node *parent_dup, int options, struct ly_ctx *ctx)
-{
-    struct lyd_node *first_dup = NULL, *prev_dup = NULL, *last_dup;
-    const struct lyd_node *next;
-
-    assert(first);
+    char *buf = NULL;
 
-    /* duplicate and connect all siblings */
-    LY_TREE_FOR(first, next) {
-        last_dup = _lyd_dup_node(next, next->schema, ctx, options);
-        if (!last_dup) {
-            goto error;
-        }
+    if (!node) {
+        LOGARG;
+        return NULL;
+    }
 
-        /* the whole data tree is exactly the same so we can safely copy the validation flags */
-        last_dup->validity = next->validity;
-        last_dup->when_status = next->when_status;
+    if (ly_vlog_build_path(LY_VLOG_LYD, node, &buf, 0, 0)) {
+        return NULL;
+    }
 
-        last_dup->parent = parent_dup;
-        /* connect to the parent or the siblings */
-        if (!first_dup) {
-            first_dup = last_dup;
-            if (parent_dup) {
-                parent_dup->child = first_dup;
-            }
-        } else {
-            assert(prev_dup);
-            prev_dup->next = last_dup;
-            last_dup->prev = prev_dup;
-        }
+    return buf;
+}
 
-#ifdef LY_ENABLED_CACHE
-        /* copy hash */
-        if ((last_dup->schema->nodetype != LYS_LIST) || lyd_list_has_keys(last_dup)) {
-            last_dup->hash = next->hash;
-        }
+/* output of the forward path printing, either a fixed buffer or a growing one */
+struct lyd_path_out {
+    char *buf;
+    size_t size;
+    size_t len;
+    int grow;
+};
 
-        /* insert into parent */
-        lyd_insert_hash(last_dup);
-#endif
+static int
+lyd_path_out_str(struct lyd_path_out *out, const char *str, size_t len)
+{
+    size_t size;
+    char *mem;
 
-        if ((next->schema->nodetype & (LYS_LIST | LYS_CONTAINER | LYS_RPC | LYS_ACTION | LYS_NOTIF)) && next->child) {
-            /* recursively duplicate all children */
-            if (!lyd_dup_withsiblings_r(next->child, last_dup, options, ctx)) {
-                goto error;
-            }
+    if (out->grow && (out->len + len + 1 > out->size)) {
+        size = out->size ? out->size << 1 : LY_BUF_STEP;
+        if (size < out->len + len + 1) {
+            size = out->len + len + 1;
         }
+        mem = realloc(out->buf, size);
+        LY_CHECK_ERR_RETURN(!mem, LOGMEM(NULL), -1);
+        out->buf = mem;
+        out->size = size;
+    }
 
-        prev_dup = last_dup;
+    if (out->len < out->size) {
+        /* truncated in a fixed buffer */
+        memcpy(out->buf + out->len, str, (out->len + len < out->size) ? len : out->size - out->len);
     }
+    out->len += len;
+    return 0;
+}
 
-    /* correctly set last sibling */
-    assert(!prev_dup->next);
-    first_dup->prev = prev_dup;
+#define PATH_STR(out, str) lyd_path_out_str(out, str, strlen(str))
 
-    return first_dup;
+/* as the predicates printed by ly_vlog_build_path() */
+static int
+lyd_path_out_value(struct lyd_path_out *out, const char *value)
+{
+    const char *quot = strchr(value, '\'') ? "\"" : "'";
 
-error:
-    /* disconnect and free */
-    if (first_dup) {
-        first_dup->parent = NULL;
-        lyd_free_withsiblings(first_dup);
+    if (PATH_STR(out, "=") || PATH_STR(out, quot) || PATH_STR(out, value) || PATH_STR(out, quot)
+            || PATH_STR(out, "]")) {
+        return -1;
     }
-    return NULL;
+    return 0;
 }
 
-static struct lyd_node *
-lyd_dup_withsiblings_to_ctx(const struct lyd_node *node, int options, struct ly_ctx *ctx)
+/* print the path step of a single node, the same as lyd_path() does */
+static int
+lyd_path_out_node(struct lyd_path_out *out, const struct lyd_node *node)
 {
-    const struct lyd_node *iter;
-    struct lyd_node *ret, *ret_iter, *tmp;
+    struct lys_node_list *slist;
+    const struct lyd_node *key;
+    const char *ext_name = NULL;
+    char pos[16];
+    int i;
 
-    if (!node) {
-        return NULL;
+    if (PATH_STR(out, "/")) {
+        return -1;
     }
-
-    /* find first sibling */
-    while (node->prev->next) {
-        node = node->prev;
+    if (!node->parent || (lyd_node_module(node) != lyd_node_module(node->parent))) {
+        if (!node->parent) {
+            ext_name = lyp_get_yang_data_template_name(node);
+        }
+        if (PATH_STR(out, lyd_node_module(node)->name) || PATH_STR(out, ext_name ? ":#" : ":")) {
+            return -1;
+        }
+        if (ext_name && (PATH_STR(out, ext_name) || PATH_STR(out, "/"))) {
+            return -1;
+        }
+    }
+    if (PATH_STR(out, node->schema->name)) {
+        return -1;
     }
 
-    if (node->parent) {
-        ret = lyd_dup_to_ctx(node, options, ctx);
-        if (!ret) {
-            return NULL;
+    if (node->schema->nodetype == LYS_LIST) {
+        slist = (struct lys_node_list *)node->schema;
+        if (!slist->keys_size) {
+            /* instance position */
+            sprintf(pos, "[%u]", lyd_list_pos(node));
+            return PATH_STR(out, pos);
         }
-
-        /* copy following siblings */
-        ret_iter = ret;
-        LY_TREE_FOR(node->next, iter) {
-            tmp = lyd_dup_to_ctx(iter, options, ctx);
-            if (!tmp) {
-                lyd_free_withsiblings(ret);
-                return NULL;
+        for (i = 0; i < slist->keys_size; ++i) {
+            LY_TREE_FOR(node->child, key) {
+                if (key->schema == (struct lys_node *)slist->keys[i]) {
+                    break;
+                }
             }
-
-            if (lyd_insert_after(ret_iter, tmp)) {
-                lyd_free_withsiblings(ret);
-                return NULL;
+            if (!key || !((struct lyd_node_leaf_list *)key)->value_str) {
+                continue;
+            }
+            if (PATH_STR(out, "[")) {
+                return -1;
+            }
+            if ((lyd_node_module(key) != lyd_node_module(node))
+                    && (PATH_STR(out, lyd_node_module(key)->name) || PATH_STR(out, ":"))) {
+                return -1;
+            }
+            if (PATH_STR(out, key->schema->name)
+                    || lyd_path_out_value(out, ((struct lyd_node_leaf_list *)key)->value_str)) {
+                return -1;
             }
-            ret_iter = ret_iter->next;
-            assert(ret_iter == tmp);
         }
-    } else {
-        /* duplicating top-level siblings, we can duplicate much more efficiently */
-        ret = lyd_dup_withsiblings_r(node, NULL, options, ctx);
+    } else if ((node->schema->nodetype == LYS_LEAFLIST) && ((struct lyd_node_leaf_list *)node)->value_str) {
+        if (PATH_STR(out, "[.") || lyd_path_out_value(out, ((struct lyd_node_leaf_list *)node)->value_str)) {
+            return -1;
+        }
     }
 
-    return ret;
+    return 0;
 }
 
-API struct lyd_node *
-lyd_dup_withsiblings(const struct lyd_node *node, int options)
+static int
+lyd_path_out_nodes(struct lyd_path_out *out, const struct lyd_node *node)
+{
+    if (node->parent && lyd_path_out_nodes(out, node->parent)) {
+        return -1;
+    }
+    return lyd_path_out_node(out, node);
+}
+
+API int
+lyd_path_buf(const struct lyd_node *node, char *buf, size_t size)
 {
     FUN_IN;
 
-    if (!node) {
-        return NULL;
+    struct lyd_path_out out = {buf, size, 0, 0};
+
+    if (!node || (!buf && size)) {
+        LOGARG;
+        return -1;
     }
 
-    return lyd_dup_withsiblings_to_ctx(node, options, lyd_node_module(node)->ctx);
+    if (lyd_path_out_nodes(&out, node)) {
+        return -1;
+    }
+    if (size) {
+        buf[(out.len < size) ? out.len : size - 1] = '\0';
+    }
+    return out.len;
 }
 
-API void
-lyd_free_attr(struct ly_ctx *ctx, struct lyd_node *parent, struct lyd_attr *attr, int recursive)
+API const char *
+lyd_path_build(struct lyd_path_builder *builder, const struct lyd_node *node)
 {
     FUN_IN;
 
-    struct lyd_attr *iter;
-    struct lys_type **type;
+    struct lyd_path_out out;
+    const struct lyd_node *iter;
+    uint32_t depth, i, common;
+    void *mem;
 
-    if (!ctx || !attr) {
-        return;
+    if (!builder || !node) {
+        LOGARG;
+        return NULL;
     }
 
-    if (parent) {
-        if (parent->attr == attr) {
-            if (recursive) {
-                parent->attr = NULL;
-            } else {
-                parent->attr = attr->next;
-            }
-        } else {
-            for (iter = parent->attr; iter->next != attr; iter = iter->next);
-            if (iter->next) {
-                if (recursive) {
-                    iter->next = NULL;
-                } else {
-                    iter->next = attr->next;
-                }
-            }
+    for (depth = 0, iter = node; iter; iter = iter->parent, ++depth);
+    if (depth > builder->alloc) {
+        mem = realloc(builder->nodes, depth * sizeof *builder->nodes);
+        LY_CHECK_ERR_RETURN(!mem, LOGMEM(lyd_node_module(node)->ctx), NULL);
+        builder->nodes = mem;
+        mem = realloc(builder->ends, depth * sizeof *builder->ends);
+        LY_CHECK_ERR_RETURN(!mem, LOGMEM(lyd_node_module(node)->ctx), NULL);
+        builder->ends = mem;
+        builder->alloc = depth;
+    }
+
+    /* the ancestors shared with the previous path keep their steps */
+    for (i = depth, iter = node; i > builder->depth; --i, iter = iter->parent);
+    for (; i && (builder->nodes[i - 1] != iter); --i, iter = iter->parent);
+    common = i;
+
+    out.buf = builder->buf;
+    out.size = builder->size;
+    out.len = common ? builder->ends[common - 1] : 0;
+    out.grow = 1;
+
+    /* the remaining steps */
+    for (i = depth, iter = node; i > common; --i, iter = iter->parent) {
+        builder->nodes[i - 1] = iter;
+    }
+    for (i = common; i < depth; ++i) {
+        if (lyd_path_out_node(&out, builder->nodes[i])) {
+            builder->buf = out.buf;
+            builder->size = out.size;
+            builder->depth = 0;
+            return NULL;
         }
+        builder->ends[i] = out.len;
     }
+    builder->depth = depth;
 
-    if (!recursive) {
-        attr->next = NULL;
-    }
+    /* always enough space for the terminating zero */
+    out.buf[out.len] = '\0';
+    builder->buf = out.buf;
+    builder->size = out.size;
+    return builder->buf;
+}
 
-    for(iter = attr; iter; ) {
-        attr = iter;
-        iter = iter->next;
+API void
+lyd_path_builder_clear(struct lyd_path_builder *builder)
+{
+    FUN_IN;
 
-        lydict_remove(ctx, attr->name);
-        type = lys_ext_complex_get_substmt(LY_STMT_TYPE, attr->annotation, NULL);
-        assert(type);
-        lyd_free_value(attr->value, attr->value_type, attr->value_flags, *type, attr->value_str, NULL, NULL, NULL);
-        lydict_remove(ctx, attr->value_str);
-        free(attr);
+    if (!builder) {
+        return;
     }
+
+    free(builder->buf);
+    free(builder->nodes);
+    free(builder->ends);
+    memset(builder, 0, sizeof *builder);
 }
 
-const struct lyd_node *
-lyd_attr_parent(const struct lyd_node *root, struct lyd_attr *attr)
+int
+lyd_build_relative_data_path(const struct lys_module *module, const struct lyd_node *node, const char *schema_id,
+                             char *buf)
 {
-    const struct lyd_node *next, *elem;
-    struct lyd_attr *node_attr;
+    const struct lys_node *snode, *schema;
+    const char *mod_name, *name;
+    int mod_name_len, name_len, len = 0;
+    int r, is_relative = -1;
 
-    LY_TREE_DFS_BEGIN(root, next, elem) {
-        for (node_attr = elem->attr; node_attr; node_attr = node_attr->next) {
-            if (node_attr == attr) {
-                return elem;
+    assert(schema_id && buf);
+    schema = node->schema;
+
+    while (*schema_id) {
+        if ((r = parse_schema_nodeid(schema_id, &mod_name, &mod_name_len, &name, &name_len, &is_relative, NULL, NULL, 0)) < 1) {
+            LOGINT(module->ctx);
+            return -1;
+        }
+        schema_id += r;
+
+        snode = NULL;
+        while ((snode = lys_getnext(snode, schema, NULL, LYS_GETNEXT_WITHCHOICE | LYS_GETNEXT_WITHCASE | LYS_GETNEXT_NOSTATECHECK))) {
+            r = schema_nodeid_siblingcheck(snode, module, mod_name, mod_name_len, name, name_len);
+            if (r == 0) {
+                schema = snode;
+                break;
+            } else if (r == 1) {
+                continue;
+            } else {
+                return -1;
             }
         }
-        LY_TREE_DFS_END(root, next, elem)
+        /* no match */
+        if (!snode || (!schema_id[0] && snode->nodetype != LYS_LEAF)) {
+            LOGINT(module->ctx);
+            return -1;
+        }
+
+        if (!(snode->nodetype & (LYS_CHOICE | LYS_CASE))) {
+            len += sprintf(&buf[len], "%s%s", (len ? "/" : ""), snode->name);
+        }
     }
 
-    return NULL;
+    return len;
 }
 
-API struct lyd_attr *
-lyd_insert_attr(struct lyd_node *parent, const struct lys_module *mod, const char *name, const char *value)
+API struct lyd_path *
+lyd_path_prepare(const struct lys_module *module, const char *path)
 {
     FUN_IN;
 
-    struct lyd_attr *a, *iter;
-    struct ly_ctx *ctx;
-    const struct lys_module *module;
-    const char *p;
-    char *aux;
-    int pos, i;
+    struct lyd_path *prep;
+    char *yang_xpath;
+    const char *mod_name, *name;
+    int mod_name_len, name_len, is_relative = -1;
 
-    if (!parent || !name || !value) {
+    if (!module || !path) {
         LOGARG;
         return NULL;
     }
-    ctx = parent->schema->module->ctx;
 
-    if ((p = strchr(name, ':'))) {
-        /* search for the namespace */
-        aux = strndup(name, p - name);
-        if (!aux) {
-            LOGMEM(ctx);
-            return NULL;
+    if (parse_schema_nodeid(path, &mod_name, &mod_name_len, &name, &name_len, &is_relative, NULL, NULL, 1) > 0) {
+        if (name[0] == '#' && !is_relative) {
+            if (strncmp(mod_name, module->name, mod_name_len) || module->name[mod_name_len]) {
+                return NULL;
+            }
+            path = name + name_len;
         }
-        module = ly_ctx_get_module(ctx, aux, NULL, 1);
-        free(aux);
-        name = p + 1;
+    }
 
-        if (!module) {
-            /* module not found */
-            LOGERR(ctx, LY_EINVAL, "Attribute prefix does not match any implemented schema in the context.");
-            return NULL;
-        }
-    } else if (mod) {
-        module = mod;
-    } else if (!mod && (!strcmp(name, "type") || !strcmp(name, "select")) && !strcmp(parent->schema->name, "filter")) {
-        /* special case of inserting unqualified filter attributes "type" and "select" */
-        module = ly_ctx_get_module(ctx, "ietf-netconf", NULL, 1);
-        if (!module) {
-            LOGERR(ctx, LY_EINVAL, "Attribute prefix does not match any implemented schema in the context.");
-            return NULL;
-        }
-    } else {
-        /* no prefix -> module is the same as for the parent */
-        module = lyd_node_module(parent);
+    prep = malloc(sizeof *prep);
+    LY_CHECK_ERR_RETURN(!prep, LOGMEM(module->ctx), NULL);
+    prep->module = module;
+
+    /* transform JSON into YANG XPATH */
+    yang_xpath = transform_json2xpath(module, path);
+    if (!yang_xpath) {
+        free(prep);
+        return NULL;
+    }
+
+    prep->exp = lyxp_compile_expr(module->ctx, yang_xpath);
+    free(yang_xpath);
+    if (!prep->exp) {
+        free(prep);
+        return NULL;
+    }
+
+    return prep;
+}
+
+API struct ly_set *
+lyd_find_path_prepared(const struct lyd_node *ctx_node, const struct lyd_path *path)
+{
+    FUN_IN;
+
+    struct lyxp_set xp_set;
+    struct ly_set *set;
+    uint32_t i;
+
+    if (!ctx_node || !path || (lyd_node_module(ctx_node)->ctx != path->module->ctx)) {
+        LOGARG;
+        return NULL;
     }
 
-    pos = -1;
-    do {
-        if ((unsigned int)(pos + 1) < module->ext_size) {
-            i = lys_ext_instance_presence(&ctx->models.list[0]->extensions[0],
-                                          &module->ext[pos + 1], module->ext_size - (pos + 1));
-            pos = (i == -1) ? -1 : pos + 1 + i;
-        } else {
-            pos = -1;
-        }
-        if (pos == -1) {
-            LOGERR(ctx, LY_EINVAL, "Attribute does not match any annotation instance definition.");
-            return NULL;
-        }
-    } while (!ly_strequal(module->ext[pos]->arg_value, name, 0));
+    memset(&xp_set, 0, sizeof xp_set);
 
-    a = calloc(1, sizeof *a);
-    LY_CHECK_ERR_RETURN(!a, LOGMEM(ctx), NULL);
-    a->parent = parent;
-    a->next = NULL;
-    a->annotation = (struct lys_ext_instance_complex *)module->ext[pos];
-    a->name = lydict_insert(ctx, name, 0);
-    a->value_str = lydict_insert(ctx, value, 0);
-    if (!lyp_parse_value(*((struct lys_type **)lys_ext_complex_get_substmt(LY_STMT_TYPE, a->annotation, NULL)),
-                         &a->value_str, NULL, NULL, a, NULL, 1, 0, 0)) {
-        lyd_free_attr(ctx, NULL, a, 0);
+    if (lyxp_eval_expr(path->exp, ctx_node, LYXP_NODE_ELEM, path->module, &xp_set, 0) != EXIT_SUCCESS) {
         return NULL;
     }
 
-    if (!parent->attr) {
-        parent->attr = a;
-    } else {
-        for (iter = parent->attr; iter->next; iter = iter->next);
-        iter->next = a;
+    set = ly_set_new();
+    LY_CHECK_ERR_RETURN(!set, LOGMEM(ctx_node->schema->module->ctx), NULL);
+
+    if (xp_set.type == LYXP_SET_NODE_SET) {
+        for (i = 0; i < xp_set.used; ++i) {
+            if (xp_set.val.nodes[i].type == LYXP_NODE_ELEM) {
+                if (ly_set_add(set, xp_set.val.nodes[i].node, LY_SET_OPT_USEASLIST) < 0) {
+                    ly_set_free(set);
+                    set = NULL;
+                    break;
+                }
+            }
+        }
     }
+    /* free xp_set content */
+    lyxp_set_cast(&xp_set, LYXP_SET_EMPTY, ctx_node, NULL, 0);
 
-    return a;
+    return set;
 }
 
-void
-lyd_free_value(lyd_val value, LY_DATA_TYPE value_type, uint8_t value_flags, struct lys_type *type, const char *value_str,
-               lyd_val *old_val, LY_DATA_TYPE *old_val_type, uint8_t *old_val_flags)
+API void
+lyd_path_free(struct lyd_path *path)
 {
-    if (old_val) {
-        *old_val = value;
-        *old_val_type = value_type;
-        *old_val_flags = value_flags;
-        /* we only backup the values for now */
+    FUN_IN;
+
+    if (!path) {
         return;
     }
 
-    /* otherwise the value is correctly freed */
-    if (value_flags & LY_VALUE_USER) {
-        lytype_free(type, value, value_str);
-    } else {
-        switch (value_type) {
-        case LY_TYPE_BITS:
-            if (value.bit) {
-                free(value.bit);
-            }
-            break;
-        case LY_TYPE_INST:
-            if (!(value_flags & LY_VALUE_UNRES)) {
-                break;
-            }
-            /* fallthrough */
-        case LY_TYPE_UNION:
-            /* unresolved union leaf */
-            lydict_remove(type->parent->module->ctx, value.string);
-            break;
-        default:
-            break;
-        }
-    }
+    lyxp_expr_free(path->exp);
+    free(path);
 }
 
-static void
-_lyd_free_node(struct lyd_node *node)
+API struct ly_set *
+lyd_find_path(const struct lyd_node *ctx_node, const char *path)
 {
-    struct lyd_node_leaf_list *leaf;
+    FUN_IN;
 
-    if (!node) {
-        return;
+    struct lyd_path *prep;
+    struct ly_set *set;
+
+    if (!ctx_node || !path) {
+        LOGARG;
+        return NULL;
     }
 
-    switch (node->schema->nodetype) {
-    case LYS_CONTAINER:
-    case LYS_LIST:
-    case LYS_RPC:
-    case LYS_ACTION:
-    case LYS_NOTIF:
-#ifdef LY_ENABLED_CACHE
-        /* it should be empty because all the children are freed already (only if in debug mode) */
-        lyht_free(node->ht);
-#endif
-        break;
-    case LYS_ANYDATA:
-    case LYS_ANYXML:
-        switch (((struct lyd_node_anydata *)node)->value_type) {
-        case LYD_ANYDATA_CONSTSTRING:
-        case LYD_ANYDATA_SXML:
-        case LYD_ANYDATA_JSON:
-            lydict_remove(node->schema->module->ctx, ((struct lyd_node_anydata *)node)->value.str);
-            break;
-        case LYD_ANYDATA_DATATREE:
-            lyd_free_withsiblings(((struct lyd_node_anydata *)node)->value.tree);
-            break;
-        case LYD_ANYDATA_XML:
-            lyxml_free_withsiblings(node->schema->module->ctx, ((struct lyd_node_anydata *)node)->value.xml);
-            break;
-        case LYD_ANYDATA_LYB:
-            free(((struct lyd_node_anydata *)node)->value.mem);
-            break;
-        case LYD_ANYDATA_STRING:
-        case LYD_ANYDATA_SXMLD:
-        case LYD_ANYDATA_JSOND:
-        case LYD_ANYDATA_LYBD:
-            /* dynamic strings are used only as input parameters */
-            assert(0);
-            break;
-        }
-        break;
-    case LYS_LEAF:
-    case LYS_LEAFLIST:
-        leaf = (struct lyd_node_leaf_list *)node;
-        lyd_free_value(leaf->value, leaf->value_type, leaf->value_flags, &((struct lys_node_leaf *)leaf->schema)->type,
-                       leaf->value_str, NULL, NULL, NULL);
-        lydict_remove(leaf->schema->module->ctx, leaf->value_str);
-        break;
-    default:
-        assert(0);
+    prep = lyd_path_prepare(lyd_node_module(ctx_node), path);
+    if (!prep) {
+        return NULL;
     }
 
-    lyd_free_attr(node->schema->module->ctx, node, node->attr, 1);
-    free(node);
+    set = lyd_find_path_prepared(ctx_node, prep);
+    lyd_path_free(prep);
+
+    return set;
 }
 
-static void
-lyd_free_internal_r(struct lyd_node *node, int top)
+API struct ly_set *
+lyd_find_instance(const struct lyd_node *data, const struct lys_node *schema)
 {
-    struct lyd_node *next, *iter;
+    FUN_IN;
 
-    if (!node) {
-        return;
+    struct ly_set *ret, *ret_aux, *spath;
+    const struct lys_node *siter;
+    struct lyd_node *iter;
+    unsigned int i, j;
+
+    if (!data || !schema ||
+            !(schema->nodetype & (LYS_CONTAINER | LYS_LEAF | LYS_LIST | LYS_LEAFLIST | LYS_ANYDATA | LYS_NOTIF | LYS_RPC | LYS_ACTION))) {
+        LOGARG;
+        return NULL;
     }
 
-    /* if freeing top-level, always remove it from the parent hash table */
-    lyd_unlink_internal(node, (top ? 1 : 2));
+    ret = ly_set_new();
+    spath = ly_set_new();
+    if (!ret || !spath) {
+        LOGMEM(schema->module->ctx);
+        goto error;
+    }
 
-    if (!(node->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST | LYS_ANYDATA))) {
-        /* free children */
-        LY_TREE_FOR_SAFE(node->child, next, iter) {
-            lyd_free_internal_r(iter, 0);
+    /* find data root */
+    while (data->parent) {
+        /* vertical move (up) */
+        data = data->parent;
+    }
+    while (data->prev->next) {
+        /* horizontal move (left) */
+        data = data->prev;
+    }
+
+    /* build schema path */
+    for (siter = schema; siter; ) {
+        if (siter->nodetype == LYS_AUGMENT) {
+            siter = ((struct lys_node_augment *)siter)->target;
+            continue;
+        } else if (siter->nodetype & (LYS_CONTAINER | LYS_LEAF | LYS_LIST | LYS_LEAFLIST | LYS_ANYDATA | LYS_NOTIF | LYS_RPC | LYS_ACTION)) {
+            /* standard data node */
+            ly_set_add(spath, (void*)siter, LY_SET_OPT_USEASLIST);
+
+        } /* else skip the rest node types */
+        siter = siter->parent;
+    }
+    if (!spath->number) {
+        /* no valid path */
+        goto error;
+    }
+
+    /* start searching */
+    LY_TREE_FOR((struct lyd_node *)data, iter) {
+        if (iter->schema == spath->set.s[spath->number - 1]) {
+            ly_set_add(ret, iter, LY_SET_OPT_USEASLIST);
+        }
+    }
+    for (i = spath->number - 1; i; i--) {
+        if (!ret->number) {
+            /* nothing found */
+            break;
+        }
+
+        ret_aux = ly_set_new();
+        if (!ret_aux) {
+            LOGMEM(schema->module->ctx);
+            goto error;
+        }
+        for (j = 0; j < ret->number; j++) {
+            LY_TREE_FOR(ret->set.d[j]->child, iter) {
+                if (iter->schema == spath->set.s[i - 1]) {
+                    ly_set_add(ret_aux, iter, LY_SET_OPT_USEASLIST);
+                }
+            }
         }
+        ly_set_free(ret);
+        ret = ret_aux;
     }
 
-    _lyd_free_node(node);
+    ly_set_free(spath);
+    return ret;
+
+error:
+    ly_set_free(ret);
+    ly_set_free(spath);
+
+    return NULL;
 }
 
-API void
-lyd_free(struct lyd_node *node)
+API int
+lyd_leaf_values(const struct lyd_node *data, const char *schema_path, struct lyd_leaf_values *values)
 {
     FUN_IN;
 
-    lyd_free_internal_r(node, 1);
-}
+    struct ly_ctx *ctx;
+    const struct lys_node *snode;
+    const struct lyd_node_leaf_list *leaf, *target;
+    struct ly_set *set;
+    unsigned int i, count;
+    char *mem;
 
-static void
-lyd_free_withsiblings_r(struct lyd_node *first)
-{
-    struct lyd_node *next, *node;
+    if (!data || !schema_path || !values) {
+        LOGARG;
+        return EXIT_FAILURE;
+    }
+    ctx = lyd_node_module(data)->ctx;
+    memset(values, 0, sizeof *values);
 
-    LY_TREE_FOR_SAFE(first, next, node) {
-        if (node->schema->nodetype & (LYS_CONTAINER | LYS_LIST | LYS_RPC | LYS_ACTION | LYS_NOTIF)) {
-            lyd_free_withsiblings_r(node->child);
+    snode = ly_ctx_get_node(ctx, NULL, schema_path, 0);
+    if (!snode) {
+        LOGERR(ctx, LY_EINVAL, "Schema node \"%s\" not found.", schema_path);
+        return EXIT_FAILURE;
+    } else if (!(snode->nodetype & (LYS_LEAF | LYS_LEAFLIST))) {
+        LOGERR(ctx, LY_EINVAL, "Schema node \"%s\" is not a leaf or a leaf-list.", schema_path);
+        return EXIT_FAILURE;
+    }
+
+    set = lyd_find_instance(data, snode);
+    if (!set) {
+        return EXIT_FAILURE;
+    }
+    count = set->number;
+    if (!count) {
+        ly_set_free(set);
+        return EXIT_SUCCESS;
+    }
+
+    /* one allocation for all the arrays, ordered by their alignment */
+    mem = malloc(count * (sizeof *values->values + sizeof *values->strs + sizeof *values->nodes + sizeof *values->types));
+    if (!mem) {
+        LOGMEM(ctx);
+        ly_set_free(set);
+        return EXIT_FAILURE;
+    }
+    values->values = (lyd_val *)mem;
+    values->strs = (const char **)(values->values + count);
+    values->nodes = (const struct lyd_node_leaf_list **)(values->strs + count);
+    values->types = (LY_DATA_TYPE *)(values->nodes + count);
+    values->count = count;
+
+    for (i = 0; i < count; ++i) {
+        leaf = (const struct lyd_node_leaf_list *)set->set.d[i];
+
+        /* follow resolved leafrefs to the actual value */
+        target = leaf;
+        while ((target->value_type == LY_TYPE_LEAFREF) && target->value.leafref) {
+            target = (const struct lyd_node_leaf_list *)target->value.leafref;
         }
-        _lyd_free_node(node);
+
+        values->nodes[i] = leaf;
+        values->strs[i] = leaf->value_str;
+        values->values[i] = target->value;
+        values->types[i] = target->value_type;
     }
+
+    ly_set_free(set);
+    return EXIT_SUCCESS;
 }
 
 API void
-lyd_free_withsiblings(struct lyd_node *node)
+lyd_leaf_values_clean(struct lyd_leaf_values *values)
 {
     FUN_IN;
 
-    struct lyd_node *iter, *aux;
-
-    if (!node) {
+    if (!values) {
         return;
     }
 
-    if (node->parent) {
-        /* optimization - avoid freeing (unlinking) the last node of the siblings list */
-        /* so, first, free the node's predecessors to the beginning of the list ... */
-        for(iter = node->prev; iter->next; iter = aux) {
-            aux = iter->prev;
-            lyd_free(iter);
-        }
-        /* ... then, the node is the first in the siblings list, so free them all */
-        LY_TREE_FOR_SAFE(node, aux, iter) {
-            lyd_free(iter);
-        }
-    } else {
-        /* node is top-level so we are freeing the whole data tree, we can just free nodes without any unlinking */
-        while (node->prev->next) {
-            /* find the first sibling */
-            node = node->prev;
-        }
+    /* all the arrays are allocated together */
+    free(values->values);
+    memset(values, 0, sizeof *values);
+}
 
-        /* free it all */
-        lyd_free_withsiblings_r(node);
+/* fixed width of the values of a column type, 0 for the values stored as strings */
+static uint8_t
+lyd_column_width(LY_DATA_TYPE type)
+{
+    switch (type) {
+    case LY_TYPE_BOOL:
+    case LY_TYPE_INT8:
+    case LY_TYPE_UINT8:
+        return 1;
+    case LY_TYPE_INT16:
+    case LY_TYPE_UINT16:
+        return 2;
+    case LY_TYPE_INT32:
+    case LY_TYPE_UINT32:
+        return 4;
+    case LY_TYPE_DEC64:
+    case LY_TYPE_INT64:
+    case LY_TYPE_UINT64:
+        return 8;
+    default:
+        return 0;
     }
 }
 
-/**
- * Expectations:
- * - list exists in data tree
- * - the leaf (defined by the unique_expr) is not instantiated under the list
- */
-int
-lyd_get_unique_default(const char* unique_expr, struct lyd_node *list, const char **dflt)
+static int
+lyd_column_init(struct lyd_columns *columns, const struct lys_node *snode, unsigned int rows)
 {
-    struct ly_ctx *ctx = list->schema->module->ctx;
-    const struct lys_node *parent;
-    const struct lys_node_leaf *sleaf = NULL;
-    struct lys_tpdf *tpdf;
-    struct lyd_node *last, *node;
-    struct ly_set *s, *r;
+    struct lyd_column *col;
+    const struct lys_type *type;
     unsigned int i;
-    enum int_log_opts prev_ilo;
 
-    assert(unique_expr && list && dflt);
-    *dflt = NULL;
+    /* skip duplicates (keys listed explicitly) */
+    for (i = 0; i < columns->count; ++i) {
+        if (columns->columns[i].schema == (struct lys_node_leaf *)snode) {
+            return EXIT_SUCCESS;
+        }
+    }
 
-    if (resolve_descendant_schema_nodeid(unique_expr, list->schema->child, LYS_LEAF, 1, &parent) || !parent) {
-        /* error, but unique expression was checked when the schema was parsed so this should not happened */
-        LOGINT(ctx);
-        return -1;
+    col = &columns->columns[columns->count++];
+    col->schema = (struct lys_node_leaf *)snode;
+
+    type = &col->schema->type;
+    while ((type->base == LY_TYPE_LEAFREF) && type->info.lref.target) {
+        type = &type->info.lref.target->type;
     }
+    col->width = lyd_column_width(type->base);
+    col->type = col->width ? type->base : LY_TYPE_STRING;
 
-    sleaf = (struct lys_node_leaf *)parent;
-    if (sleaf->dflt) {
-        /* leaf has a default value */
-        *dflt = sleaf->dflt;
-    } else if (!(sleaf->flags & LYS_MAND_TRUE)) {
-        /* get the default value from the type */
-        for (tpdf = sleaf->type.der; tpdf && !(*dflt); tpdf = tpdf->type.der) {
-            *dflt = tpdf->dflt;
-        }
+    col->validity = calloc((rows + 7) / 8 ? (rows + 7) / 8 : 1, 1);
+    if (col->width) {
+        col->values = malloc(rows ? rows * col->width : 1);
+    } else {
+        col->offsets = calloc(rows + 1, sizeof *col->offsets);
     }
+    LY_CHECK_ERR_RETURN(!col->validity || (!col->values && !col->offsets), LOGMEM(snode->module->ctx), EXIT_FAILURE);
 
-    if (!(*dflt)) {
-        return 0;
+    return EXIT_SUCCESS;
+}
+
+API int
+lyd_list_columns(const struct lyd_node *data, const char *list_path, const char **leaves, struct lyd_columns *columns)
+{
+    FUN_IN;
+
+    struct ly_ctx *ctx;
+    const struct lys_node *slist, *siter;
+    const struct lyd_node_leaf_list *leaf, *target;
+    struct lyd_column *col;
+    struct lyd_node *iter;
+    struct ly_set *set = NULL;
+    unsigned int row, i, size = 0, len;
+    char *dptr;
+    uint32_t *data_size = NULL;
+
+    if (!data || !list_path || !columns) {
+        LOGARG;
+        return EXIT_FAILURE;
     }
+    ctx = lyd_node_module(data)->ctx;
+    memset(columns, 0, sizeof *columns);
 
-    /* it has default value, but check if it can appear in the data tree under the list */
-    s = ly_set_new();
-    for (parent = lys_parent((struct lys_node *)sleaf); parent != list->schema; parent = lys_parent(parent)) {
-        if (!(parent->nodetype & (LYS_CONTAINER | LYS_CASE | LYS_CHOICE | LYS_USES))) {
-            /* This should be already detected when parsing schema */
-            LOGINT(ctx);
-            ly_set_free(s);
-            return -1;
-        }
-        ly_set_add(s, (void *)parent, LY_SET_OPT_USEASLIST);
+    slist = ly_ctx_get_node(ctx, NULL, list_path, 0);
+    if (!slist) {
+        LOGERR(ctx, LY_EINVAL, "Schema node \"%s\" not found.", list_path);
+        return EXIT_FAILURE;
+    } else if (slist->nodetype != LYS_LIST) {
+        LOGERR(ctx, LY_EINVAL, "Schema node \"%s\" is not a list.", list_path);
+        return EXIT_FAILURE;
     }
 
-    ly_ilo_change(NULL, ILO_IGNORE, &prev_ilo, NULL);
-    for (i = 0, last = list; i < s->number; i++) {
-        parent = s->set.s[i]; /* shortcut */
+    /* columns, the keys first */
+    size = ((struct lys_node_list *)slist)->keys_size;
+    siter = NULL;
+    while ((siter = lys_getnext(siter, slist, NULL, 0))) {
+        size += (siter->nodetype == LYS_LEAF);
+    }
+    set = lyd_find_instance(data, slist);
+    if (!set) {
+        return EXIT_FAILURE;
+    }
+    columns->rows = set->number;
+    columns->columns = calloc(size ? size : 1, sizeof *columns->columns);
+    LY_CHECK_ERR_GOTO(!columns->columns, LOGMEM(ctx), error);
 
-        switch (parent->nodetype) {
-        case LYS_CONTAINER:
-            if (last) {
-                /* find instance in the data */
-                r = lyd_find_path(last, parent->name);
-                if (!r || r->number > 1) {
-                    ly_set_free(r);
-                    *dflt = NULL;
-                    goto end;
-                }
-                if (r->number) {
-                    last = r->set.d[0];
-                } else {
-                    last = NULL;
+    for (i = 0; i < ((struct lys_node_list *)slist)->keys_size; ++i) {
+        if (lyd_column_init(columns, (struct lys_node *)((struct lys_node_list *)slist)->keys[i], columns->rows)) {
+            goto error;
+        }
+    }
+    if (leaves) {
+        for (; *leaves; ++leaves) {
+            siter = NULL;
+            while ((siter = lys_getnext(siter, slist, NULL, 0))) {
+                if ((siter->nodetype == LYS_LEAF) && ly_strequal(siter->name, *leaves, 0)) {
+                    break;
                 }
-                ly_set_free(r);
             }
-            if (((struct lys_node_container *)parent)->presence) {
-                /* not-instantiated presence container on path */
-                *dflt = NULL;
-                goto end;
+            if (!siter) {
+                LOGERR(ctx, LY_EINVAL, "List \"%s\" has no leaf \"%s\".", slist->name, *leaves);
+                goto error;
             }
-            break;
-        case LYS_CHOICE :
-            /* check presence of another case */
-            if (!last) {
-                continue;
+            if (lyd_column_init(columns, siter, columns->rows)) {
+                goto error;
+            }
+        }
+    } else {
+        siter = NULL;
+        while ((siter = lys_getnext(siter, slist, NULL, 0))) {
+            if ((siter->nodetype == LYS_LEAF) && lyd_column_init(columns, siter, columns->rows)) {
+                goto error;
             }
+        }
+    }
 
-            /* remember the case to be searched in choice by lyv_multicases() */
-            if (i + 1 == s->number) {
-                parent = (struct lys_node *)sleaf;
-            } else if (s->set.s[i + 1]->nodetype == LYS_CASE && (i + 2 < s->number) &&
-                    s->set.s[i + 2]->nodetype == LYS_CHOICE) {
-                /* nested choices are covered by lyv_multicases, we just have to pass
-                 * the lowest choice */
-                i++;
+    /* allocated sizes of the string data */
+    data_size = calloc(columns->count ? columns->count : 1, sizeof *data_size);
+    LY_CHECK_ERR_GOTO(!data_size, LOGMEM(ctx), error);
+
+    for (row = 0; row < columns->rows; ++row) {
+        LY_TREE_FOR(set->set.d[row]->child, iter) {
+            if (iter->schema->nodetype != LYS_LEAF) {
+                continue;
+            }
+            for (i = 0; (i < columns->count) && (columns->columns[i].schema != (struct lys_node_leaf *)iter->schema); ++i);
+            if (i == columns->count) {
                 continue;
+            }
+            col = &columns->columns[i];
+            leaf = (struct lyd_node_leaf_list *)iter;
+
+            if (col->width) {
+                /* follow resolved leafrefs to the actual value */
+                target = leaf;
+                while ((target->value_type == LY_TYPE_LEAFREF) && target->value.leafref) {
+                    target = (struct lyd_node_leaf_list *)target->value.leafref;
+                }
+                if (target->value_type != col->type) {
+                    /* no typed value (unresolved leafref) */
+                    continue;
+                }
+                /* all the members of the value union start at its beginning */
+                memcpy((char *)col->values + row * col->width, &target->value, col->width);
             } else {
-                parent = s->set.s[i + 1];
+                len = leaf->value_str ? strlen(leaf->value_str) : 0;
+                if (len && (col->offsets[row] + len > data_size[i])) {
+                    data_size[i] = (col->offsets[row] + len) * 2;
+                    dptr = realloc(col->data, data_size[i]);
+                    LY_CHECK_ERR_GOTO(!dptr, LOGMEM(ctx), error);
+                    col->data = dptr;
+                }
+                if (len) {
+                    memcpy(col->data + col->offsets[row], leaf->value_str, len);
+                }
+                col->offsets[row + 1] = col->offsets[row] + len;
             }
-            node = last->child;
-            if (lyv_multicases(NULL, (struct lys_node *)parent, &node, 0, NULL)) {
-                /* another case is present */
-                *dflt = NULL;
-                goto end;
+            col->validity[row / 8] |= 1 << (row % 8);
+        }
+
+        /* rows without the string leaves are empty */
+        for (i = 0; i < columns->count; ++i) {
+            col = &columns->columns[i];
+            if (!col->width && !(col->validity[row / 8] & (1 << (row % 8)))) {
+                col->offsets[row + 1] = col->offsets[row];
             }
-            break;
-        default:
-            /* LYS_CASE, LYS_USES */
-            continue;
         }
     }
 
-end:
-    ly_ilo_restore(NULL, prev_ilo, NULL, 0);
-    ly_set_free(s);
-    return 0;
+    free(data_size);
+    ly_set_free(set);
+    return EXIT_SUCCESS;
+
+error:
+    free(data_size);
+    ly_set_free(set);
+    lyd_list_columns_clean(columns);
+    return EXIT_FAILURE;
 }
 
-API char *
-lyd_path(const struct lyd_node *node)
+API void
+lyd_list_columns_clean(struct lyd_columns *columns)
 {
     FUN_IN;
 
-    char *buf = NULL;
+    unsigned int i;
 
-    if (!node) {
-        LOGARG;
-        return NULL;
+    if (!columns) {
+        return;
     }
 
-    if (ly_vlog_build_path(LY_VLOG_LYD, node, &buf, 0, 0)) {
-        return NULL;
+    for (i = 0; i < columns->count; ++i) {
+        free(columns->columns[i].validity);
+        free(columns->columns[i].values);
+        free(columns->columns[i].offsets);
+        free(columns->columns[i].data);
     }
+    free(columns->columns);
+    memset(columns, 0, sizeof *columns);
+}
 
-    return buf;
+/* create the leaf of a column in a row and insert it into the list instance */
+static int
+lyd_new_column_leaf(struct lyd_node *list, const struct lyd_column *col, unsigned int row)
+{
+    struct ly_ctx *ctx = list->schema->module->ctx;
+    struct lys_node_leaf *sleaf = (struct lys_node_leaf *)col->schema;
+    struct lyd_node_leaf_list *leaf;
+    struct lys_type *type;
+    int r;
+
+    leaf = (struct lyd_node_leaf_list *)lyd_create_leaf((struct lys_node *)sleaf, NULL, 0);
+    if (!leaf) {
+        return EXIT_FAILURE;
+    }
+    if (!col->width) {
+        lydict_remove(ctx, leaf->value_str);
+        leaf->value_str = lydict_insert(ctx, col->data + col->offsets[row], col->offsets[row + 1] - col->offsets[row]);
+    }
+    /* connect to the parent first because of the log */
+    if (lyd_insert(list, (struct lyd_node *)leaf)) {
+        lyd_free((struct lyd_node *)leaf);
+        return EXIT_FAILURE;
+    }
+
+    if (col->width) {
+        for (type = &sleaf->type; (type->base == LY_TYPE_LEAFREF) && type->info.lref.target;
+                type = &type->info.lref.target->type);
+        r = lyp_store_value(leaf, type, (char *)col->values + row * col->width, 0);
+        if (r == -1) {
+            return EXIT_FAILURE;
+        }
+        if ((r == 0) && (type == &sleaf->type)) {
+            goto done;
+        }
+        /* leafrefs are resolved from the generated string */
+    }
+    if (!lyp_parse_value(&sleaf->type, &leaf->value_str, NULL, leaf, NULL, NULL, 1, 0, 0)) {
+        return EXIT_FAILURE;
+    }
+
+done:
+    if (sleaf->flags & LYS_UNIQUE) {
+        list->validity |= LYD_VAL_UNIQUE;
+    }
+    return EXIT_SUCCESS;
 }
 
-int
-lyd_build_relative_data_path(const struct lys_module *module, const struct lyd_node *node, const char *schema_id,
-                             char *buf)
+API struct lyd_node *
+lyd_new_list_columns(struct lyd_node *parent, const struct lys_node *schema, const struct lyd_columns *columns)
 {
-    const struct lys_node *snode, *schema;
-    const char *mod_name, *name;
-    int mod_name_len, name_len, len = 0;
-    int r, is_relative = -1;
+    FUN_IN;
 
-    assert(schema_id && buf);
-    schema = node->schema;
+    struct ly_ctx *ctx;
+    const struct lys_node_list *slist = (const struct lys_node_list *)schema;
+    const struct lys_node *par;
+    const struct lys_type *type;
+    const struct lyd_column *col;
+    struct lyd_node *first = NULL, *list, *iter;
+    unsigned int row, i, j, *key_cols = NULL;
+    uint32_t count;
 
-    while (*schema_id) {
-        if ((r = parse_schema_nodeid(schema_id, &mod_name, &mod_name_len, &name, &name_len, &is_relative, NULL, NULL, 0)) < 1) {
-            LOGINT(module->ctx);
-            return -1;
+    if (!schema || (schema->nodetype != LYS_LIST) || !columns || (columns->count && !columns->columns)
+            || (parent && (parent->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST | LYS_ANYDATA)))) {
+        LOGARG;
+        return NULL;
+    }
+    ctx = schema->module->ctx;
+
+    /* check the columns */
+    for (i = 0; i < columns->count; ++i) {
+        col = &columns->columns[i];
+        for (par = col->schema ? lys_parent((struct lys_node *)col->schema) : NULL;
+                par && !(par->nodetype & (LYS_CONTAINER | LYS_LIST | LYS_INPUT | LYS_OUTPUT | LYS_NOTIF));
+                par = lys_parent(par));
+        if (!par || (par != schema) || (col->schema->nodetype != LYS_LEAF)) {
+            LOGERR(ctx, LY_EINVAL, "Column %u is not a leaf of list \"%s\".", i, schema->name);
+            return NULL;
         }
-        schema_id += r;
+        for (type = &col->schema->type; (type->base == LY_TYPE_LEAFREF) && type->info.lref.target;
+                type = &type->info.lref.target->type);
+        if (col->width ? ((col->type != type->base) || (col->width != lyd_column_width(type->base)) || !col->values)
+                : !col->offsets || (col->offsets[columns->rows] && !col->data)) {
+            LOGERR(ctx, LY_EINVAL, "Column of \"%s\" does not match its type.", col->schema->name);
+            return NULL;
+        }
+    }
+    if (!columns->rows) {
+        return NULL;
+    }
 
-        snode = NULL;
-        while ((snode = lys_getnext(snode, schema, NULL, LYS_GETNEXT_WITHCHOICE | LYS_GETNEXT_WITHCASE | LYS_GETNEXT_NOSTATECHECK))) {
-            r = schema_nodeid_siblingcheck(snode, module, mod_name, mod_name_len, name, name_len);
-            if (r == 0) {
-                schema = snode;
-                break;
-            } else if (r == 1) {
-                continue;
-            } else {
-                return -1;
+    key_cols = malloc((slist->keys_size ? slist->keys_size : 1) * sizeof *key_cols);
+    LY_CHECK_ERR_RETURN(!key_cols, LOGMEM(ctx), NULL);
+    for (i = 0; i < slist->keys_size; ++i) {
+        for (j = 0; (j < columns->count) && (columns->columns[j].schema != slist->keys[i]); ++j);
+        if (j == columns->count) {
+            LOGERR(ctx, LY_EINVAL, "Missing the column of key \"%s\" of list \"%s\".", slist->keys[i]->name, schema->name);
+            goto error;
+        }
+        key_cols[i] = j;
+    }
+
+    for (row = 0; row < columns->rows; ++row) {
+        list = _lyd_new(NULL, schema, 0);
+        if (!list) {
+            goto error;
+        }
+        if (!first) {
+            first = list;
+        } else {
+            first->prev->next = list;
+            list->prev = first->prev;
+            first->prev = list;
+        }
+
+        /* the keys first */
+        for (i = 0; i < slist->keys_size; ++i) {
+            col = &columns->columns[key_cols[i]];
+            if (!(col->validity[row / 8] & (1 << (row % 8)))) {
+                LOGERR(ctx, LY_EINVAL, "Missing key \"%s\" in row %u.", col->schema->name, row);
+                goto error;
+            }
+            if (lyd_new_column_leaf(list, col, row)) {
+                goto error;
             }
         }
-        /* no match */
-        if (!snode || (!schema_id[0] && snode->nodetype != LYS_LEAF)) {
-            LOGINT(module->ctx);
-            return -1;
+        for (i = 0; i < columns->count; ++i) {
+            col = &columns->columns[i];
+            if (lys_is_key(col->schema, NULL) || !(col->validity[row / 8] & (1 << (row % 8)))) {
+                continue;
+            }
+            if (lyd_new_column_leaf(list, col, row)) {
+                goto error;
+            }
         }
+    }
+    free(key_cols);
+    key_cols = NULL;
 
-        if (!(snode->nodetype & (LYS_CHOICE | LYS_CASE))) {
-            len += sprintf(&buf[len], "%s%s", (len ? "/" : ""), snode->name);
+    if (parent) {
+        count = columns->rows;
+        LY_TREE_FOR(parent->child, iter) {
+            ++count;
+        }
+        if (lyd_reserve_children(parent, count) || lyd_insert(parent, first)) {
+            goto error;
         }
     }
 
-    return len;
+    return first;
+
+error:
+    free(key_cols);
+    lyd_free_withsiblings(first);
+    return NULL;
 }
 
-API struct ly_set *
-lyd_find_path(const struct lyd_node *ctx_node, const char *path)
+API struct lyd_node *
+lyd_find_sibling_val(const struct lyd_node *siblings, const struct lys_node *schema, const char **values)
 {
     FUN_IN;
 
-    struct lyxp_set xp_set;
-    struct ly_set *set;
-    char *yang_xpath;
-    const char * node_mod_name, *mod_name, *name;
-    int mod_name_len, name_len, is_relative = -1;
-    uint32_t i;
+    int i;
 
-    if (!ctx_node || !path) {
+    if (!siblings || !schema || !(schema->nodetype & (LYS_CONTAINER | LYS_LEAF | LYS_LEAFLIST | LYS_LIST | LYS_ANYDATA))
+            || (!values && (schema->nodetype & (LYS_LEAFLIST | LYS_LIST)))) {
         LOGARG;
         return NULL;
     }
-
-    if (parse_schema_nodeid(path, &mod_name, &mod_name_len, &name, &name_len, &is_relative, NULL, NULL, 1) > 0) {
-        if (name[0] == '#' && !is_relative) {
-            node_mod_name = lyd_node_module(ctx_node)->name;
-            if (strncmp(mod_name, node_mod_name, mod_name_len) || node_mod_name[mod_name_len]) {
+    if (schema->nodetype & (LYS_LEAFLIST | LYS_LIST)) {
+        for (i = 0; i < ((schema->nodetype == LYS_LIST) ? ((struct lys_node_list *)schema)->keys_size : 1); ++i) {
+            if (!values[i]) {
+                LOGARG;
                 return NULL;
             }
-            path = name + name_len;
         }
     }
 
-    /* transform JSON into YANG XPATH */
-    yang_xpath = transform_json2xpath(lyd_node_module(ctx_node), path);
-    if (!yang_xpath) {
-        return NULL;
+    /* first sibling */
+    if (siblings->parent) {
+        siblings = siblings->parent->child;
+    } else {
+        for (; siblings->prev->next; siblings = siblings->prev);
     }
 
-    memset(&xp_set, 0, sizeof xp_set);
+    return resolve_data_sibling_val(siblings, schema, values);
+}
 
-    if (lyxp_eval(yang_xpath, ctx_node, LYXP_NODE_ELEM, lyd_node_module(ctx_node), &xp_set, 0) != EXIT_SUCCESS) {
-        free(yang_xpath);
-        return NULL;
+/* next instance of the same list or leaf-list following a sibling */
+static const struct lyd_node *
+lyd_list_cursor_find(const struct lyd_node *node, const struct lys_node *schema)
+{
+    for (; node && (node->schema != schema); node = node->next);
+    return node;
+}
+
+API int
+lyd_list_cursor_init(struct lyd_list_cursor *cursor, const struct lyd_node *siblings, const struct lys_node *schema,
+                     const char **after)
+{
+    FUN_IN;
+
+    const struct lyd_node *node;
+
+    if (!cursor || !schema || !(schema->nodetype & (LYS_LIST | LYS_LEAFLIST)) || (after && !siblings)) {
+        LOGARG;
+        return EXIT_FAILURE;
     }
-    free(yang_xpath);
 
-    set = ly_set_new();
-    LY_CHECK_ERR_RETURN(!set, LOGMEM(ctx_node->schema->module->ctx), NULL);
+    cursor->schema = schema;
+    cursor->next = NULL;
+    if (!siblings) {
+        /* no instances */
+        return EXIT_SUCCESS;
+    }
 
-    if (xp_set.type == LYXP_SET_NODE_SET) {
-        for (i = 0; i < xp_set.used; ++i) {
-            if (xp_set.val.nodes[i].type == LYXP_NODE_ELEM) {
-                if (ly_set_add(set, xp_set.val.nodes[i].node, LY_SET_OPT_USEASLIST) < 0) {
-                    ly_set_free(set);
-                    set = NULL;
-                    break;
-                }
-            }
+    if (after) {
+        /* resume after the instance, found in the hash table */
+        node = lyd_find_sibling_val(siblings, schema, after);
+        if (!node) {
+            LOGERR(schema->module->ctx, LY_EINVAL, "Instance of \"%s\" to resume after not found.", schema->name);
+            return EXIT_FAILURE;
+        }
+        cursor->next = lyd_list_cursor_find(node->next, schema);
+    } else {
+        /* first sibling */
+        if (siblings->parent) {
+            siblings = siblings->parent->child;
+        } else {
+            for (; siblings->prev->next; siblings = siblings->prev);
         }
+        cursor->next = lyd_list_cursor_find(siblings, schema);
     }
-    /* free xp_set content */
-    lyxp_set_cast(&xp_set, LYXP_SET_EMPTY, ctx_node, NULL, 0);
 
-    return set;
+    return EXIT_SUCCESS;
 }
 
-API struct ly_set *
-lyd_find_instance(const struct lyd_node *data, const struct lys_node *schema)
+API const struct lyd_node *
+lyd_list_cursor_next(struct lyd_list_cursor *cursor)
 {
     FUN_IN;
 
-    struct ly_set *ret, *ret_aux, *spath;
-    const struct lys_node *siter;
-    struct lyd_node *iter;
-    unsigned int i, j;
+    const struct lyd_node *node;
 
-    if (!data || !schema ||
-            !(schema->nodetype & (LYS_CONTAINER | LYS_LEAF | LYS_LIST | LYS_LEAFLIST | LYS_ANYDATA | LYS_NOTIF | LYS_RPC | LYS_ACTION))) {
+    if (!cursor) {
         LOGARG;
         return NULL;
     }
 
-    ret = ly_set_new();
-    spath = ly_set_new();
-    if (!ret || !spath) {
-        LOGMEM(schema->module->ctx);
-        goto error;
-    }
-
-    /* find data root */
-    while (data->parent) {
-        /* vertical move (up) */
-        data = data->parent;
-    }
-    while (data->prev->next) {
-        /* horizontal move (left) */
-        data = data->prev;
+    node = cursor->next;
+    if (node) {
+        cursor->next = lyd_list_cursor_find(node->next, cursor->schema);
     }
+    return node;
+}
 
-    /* build schema path */
-    for (siter = schema; siter; ) {
-        if (siter->nodetype == LYS_AUGMENT) {
-            siter = ((struct lys_node_augment *)siter)->target;
-            continue;
-        } else if (siter->nodetype & (LYS_CONTAINER | LYS_LEAF | LYS_LIST | LYS_LEAFLIST | LYS_ANYDATA | LYS_NOTIF | LYS_RPC | LYS_ACTION)) {
-            /* standard data node */
-            ly_set_add(spath, (void*)siter, LY_SET_OPT_USEASLIST);
+API int
+lyd_list_cursor_print_mem(char **strp, struct lyd_list_cursor *cursor, uint32_t count, LYD_FORMAT format, int options)
+{
+    FUN_IN;
 
-        } /* else skip the rest node types */
-        siter = siter->parent;
-    }
-    if (!spath->number) {
-        /* no valid path */
-        goto error;
-    }
+    const struct lyd_node *node;
+    struct lyd_node *page = NULL, *dup;
+    uint32_t i;
+    int ret;
 
-    /* start searching */
-    LY_TREE_FOR((struct lyd_node *)data, iter) {
-        if (iter->schema == spath->set.s[spath->number - 1]) {
-            ly_set_add(ret, iter, LY_SET_OPT_USEASLIST);
-        }
+    if (!strp || !cursor) {
+        LOGARG;
+        return EXIT_FAILURE;
     }
-    for (i = spath->number - 1; i; i--) {
-        if (!ret->number) {
-            /* nothing found */
-            break;
-        }
 
-        ret_aux = ly_set_new();
-        if (!ret_aux) {
-            LOGMEM(schema->module->ctx);
-            goto error;
+    /* only the instances of the page are duplicated so that they are printed as siblings */
+    for (i = 0; (!count || (i < count)) && (node = lyd_list_cursor_next(cursor)); ++i) {
+        dup = lyd_dup(node, LYD_DUP_OPT_RECURSIVE);
+        if (!page) {
+            page = dup;
         }
-        for (j = 0; j < ret->number; j++) {
-            LY_TREE_FOR(ret->set.d[j]->child, iter) {
-                if (iter->schema == spath->set.s[i - 1]) {
-                    ly_set_add(ret_aux, iter, LY_SET_OPT_USEASLIST);
-                }
-            }
+        if (!dup || ((dup != page) && lyd_insert_sibling(&page, dup))) {
+            lyd_free(dup);
+            lyd_free_withsiblings(page);
+            *strp = NULL;
+            return EXIT_FAILURE;
         }
-        ly_set_free(ret);
-        ret = ret_aux;
     }
 
-    ly_set_free(spath);
+    ret = lyd_print_mem(strp, page, format, options | LYP_WITHSIBLINGS);
+    lyd_free_withsiblings(page);
     return ret;
-
-error:
-    ly_set_free(ret);
-    ly_set_free(spath);
-
-    return NULL;
 }
 
 API struct lyd_node *
@@ -6692,6 +12075,112 @@ lyd_first_sibling(struct lyd_node *node)
     return start;
 }
 
+/* minimal number of the items of a set to create its hash index */
+#define LY_SET_HT_MIN 32
+
+/* record of a set hash index, the first index of an item and its number of occurrences */
+struct ly_set_rec {
+    void *item;
+    unsigned int index;
+    unsigned int count;
+};
+
+static int
+ly_set_rec_equal(void *val1_p, void *val2_p, int UNUSED(mod), void *UNUSED(cb_data))
+{
+    return ((struct ly_set_rec *)val1_p)->item == ((struct ly_set_rec *)val2_p)->item;
+}
+
+static uint32_t
+ly_set_hash(void *item)
+{
+    return dict_hash_multi(dict_hash_multi(0, (const char *)&item, sizeof item), NULL, 0);
+}
+
+static void
+ly_set_ht_free(struct ly_set *set)
+{
+    lyht_free(set->ht);
+    set->ht = NULL;
+    set->indexed = 0;
+}
+
+/* index the items not covered by the hash index, creating it for a large set, 0 if there is none */
+static int
+ly_set_ht_sync(struct ly_set *set)
+{
+    struct ly_set_rec rec, *match;
+    uint32_t size;
+    int r;
+
+    if (set->ht && (set->indexed > set->number)) {
+        /* items removed directly */
+        ly_set_ht_free(set);
+    }
+    if (!set->ht) {
+        if (set->number < LY_SET_HT_MIN) {
+            return 0;
+        }
+        for (size = LY_SET_HT_MIN; size < set->number; size <<= 1);
+        set->ht = lyht_new(size << 1, sizeof rec, ly_set_rec_equal, NULL, 1);
+        if (!set->ht) {
+            return 0;
+        }
+    }
+
+    for (; set->indexed < set->number; ++set->indexed) {
+        rec.item = set->set.g[set->indexed];
+        rec.index = set->indexed;
+        rec.count = 1;
+        r = lyht_insert(set->ht, &rec, ly_set_hash(rec.item), (void **)&match);
+        if (r == -1) {
+            ly_set_ht_free(set);
+            return 0;
+        } else if (r == 1) {
+            /* duplicates of a list keep the first index */
+            ++match->count;
+        }
+    }
+
+    return 1;
+}
+
+/* get the record of an item in the hash index, NULL if not indexed */
+static struct ly_set_rec *
+ly_set_ht_find(const struct ly_set *set, void *item)
+{
+    struct ly_set_rec rec, *match;
+
+    rec.item = item;
+    if (lyht_find(set->ht, &rec, ly_set_hash(item), (void **)&match)) {
+        return NULL;
+    }
+    return match;
+}
+
+/* make space for at least count more items, growing the array geometrically */
+static int
+ly_set_reserve(struct ly_set *set, unsigned int count)
+{
+    unsigned int size;
+    void **new;
+
+    if (set->size - set->number >= count) {
+        return EXIT_SUCCESS;
+    }
+
+    size = set->size ? set->size << 1 : 8;
+    if (size < set->number + count) {
+        size = set->number + count;
+    }
+    new = realloc(set->set.g, size * sizeof *(set->set.g));
+    LY_CHECK_ERR_RETURN(!new, LOGMEM(NULL), EXIT_FAILURE);
+    set->size = size;
+    set->set.g = new;
+
+    return EXIT_SUCCESS;
+}
+
 API struct ly_set *
 ly_set_new(void)
 {
@@ -6713,6 +12202,7 @@ ly_set_free(struct ly_set *set)
         return;
     }
 
+    lyht_free(set->ht);
     free(set->set.g);
     free(set);
 }
@@ -6722,12 +12212,19 @@ ly_set_contains(const struct ly_set *set, void *node)
 {
     FUN_IN;
 
+    struct ly_set_rec *rec;
     unsigned int i;
 
     if (!set) {
         return -1;
     }
 
+    /* the index is only a cache of the set */
+    if (ly_set_ht_sync((struct ly_set *)set)) {
+        rec = ly_set_ht_find(set, node);
+        return rec ? (int)rec->index : -1;
+    }
+
     for (i = 0; i < set->number; i++) {
         if (set->set.g[i] == node) {
             /* object found */
@@ -6757,6 +12254,9 @@ ly_set_dup(const struct ly_set *set)
     new->set.g = malloc(new->size * sizeof *(new->set.g));
     LY_CHECK_ERR_RETURN(!new->set.g, LOGMEM(NULL); free(new), NULL);
     memcpy(new->set.g, set->set.g, new->size * sizeof *(new->set.g));
+    /* indexed when needed */
+    new->indexed = 0;
+    new->ht = NULL;
 
     return new;
 }
@@ -6766,8 +12266,7 @@ ly_set_add(struct ly_set *set, void *node, int options)
 {
     FUN_IN;
 
-    unsigned int i;
-    void **new;
+    int i;
 
     if (!set) {
         LOGARG;
@@ -6776,22 +12275,21 @@ ly_set_add(struct ly_set *set, void *node, int options)
 
     if (!(options & LY_SET_OPT_USEASLIST)) {
         /* search for duplication */
-        for (i = 0; i < set->number; i++) {
-            if (set->set.g[i] == node) {
-                /* already in set */
-                return i;
-            }
+        i = ly_set_contains(set, node);
+        if (i > -1) {
+            /* already in set */
+            return i;
         }
     }
 
-    if (set->size == set->number) {
-        new = realloc(set->set.g, (set->size + 8) * sizeof *(set->set.g));
-        LY_CHECK_ERR_RETURN(!new, LOGMEM(NULL), -1);
-        set->size += 8;
-        set->set.g = new;
+    if (ly_set_reserve(set, 1)) {
+        return -1;
     }
 
     set->set.g[set->number++] = node;
+    if (set->ht && (set->indexed == set->number - 1)) {
+        ly_set_ht_sync(set);
+    }
 
     return set->number - 1;
 }
@@ -6802,7 +12300,6 @@ ly_set_merge(struct ly_set *trg, struct ly_set *src, int options)
     FUN_IN;
 
     unsigned int i, ret;
-    void **new;
 
     if (!trg) {
         LOGARG;
@@ -6826,14 +12323,11 @@ ly_set_merge(struct ly_set *trg, struct ly_set *src, int options)
     }
 
     /* allocate more memory if needed */
-    if (trg->size < trg->number + src->number) {
-        new = realloc(trg->set.g, (trg->number + src->number) * sizeof *(trg->set.g));
-        LY_CHECK_ERR_RETURN(!new, LOGMEM(NULL), -1);
-        trg->size = trg->number + src->number;
-        trg->set.g = new;
+    if (ly_set_reserve(trg, src->number)) {
+        return -1;
     }
 
-    /* copy contents from src into trg */
+    /* copy contents from src into trg, indexed when needed */
     memcpy(trg->set.g + trg->number, src->set.g, src->number * sizeof *(src->set.g));
     ret = src->number;
     trg->number += ret;
@@ -6848,11 +12342,37 @@ ly_set_rm_index(struct ly_set *set, unsigned int index)
 {
     FUN_IN;
 
+    struct ly_set_rec *rec;
+
     if (!set || (index + 1) > set->number) {
         LOGARG;
         return EXIT_FAILURE;
     }
 
+    if (set->ht && (set->indexed == set->number)) {
+        rec = ly_set_ht_find(set, set->set.g[index]);
+        if (!rec) {
+            /* replaced directly */
+            ly_set_ht_free(set);
+        } else if (rec->count == 1) {
+            lyht_remove(set->ht, rec, ly_set_hash(set->set.g[index]));
+        } else if (rec->index == index) {
+            /* the next duplicate is not known, reindex when needed */
+            ly_set_ht_free(set);
+        } else {
+            --rec->count;
+        }
+        if (set->ht && (index < set->number - 1)) {
+            /* the last item is moved */
+            rec = ly_set_ht_find(set, set->set.g[set->number - 1]);
+            if (rec && (rec->index > index)) {
+                rec->index = index;
+            }
+        }
+    } else if (set->ht) {
+        ly_set_ht_free(set);
+    }
+
     if (index == set->number - 1) {
         /* removing last item in set */
         set->set.g[index] = NULL;
@@ -6862,6 +12382,9 @@ ly_set_rm_index(struct ly_set *set, unsigned int index)
         set->set.g[set->number - 1] = NULL;
     }
     set->number--;
+    if (set->ht) {
+        set->indexed = set->number;
+    }
 
     return EXIT_SUCCESS;
 }
@@ -6871,7 +12394,7 @@ ly_set_rm(struct ly_set *set, void *node)
 {
     FUN_IN;
 
-    unsigned int i;
+    int i;
 
     if (!set || !node) {
         LOGARG;
@@ -6879,12 +12402,8 @@ ly_set_rm(struct ly_set *set, void *node)
     }
 
     /* get index */
-    for (i = 0; i < set->number; i++) {
-        if (set->set.g[i] == node) {
-            break;
-        }
-    }
-    if (i == set->number) {
+    i = ly_set_contains(set, node);
+    if (i == -1) {
         /* node is not in set */
         LOGARG;
         return EXIT_FAILURE;
@@ -6902,6 +12421,7 @@ ly_set_clean(struct ly_set *set)
         return EXIT_FAILURE;
     }
 
+    ly_set_ht_free(set);
     set->number = 0;
     return EXIT_SUCCESS;
 }
@@ -7052,10 +12572,54 @@ unres_data_diff_rem(struct unres_data *unres, unsigned int idx)
         unres->diff->second[idx] = unres->diff->second[unres->diff_idx - 1];
     }
 
-    /* move the end */
-    assert(unres->diff->type[unres->diff_idx] == LYD_DIFF_END);
-    unres->diff->type[unres->diff_idx - 1] = unres->diff->type[unres->diff_idx];
-    --unres->diff_idx;
+    /* move the end */
+    assert(unres->diff->type[unres->diff_idx] == LYD_DIFF_END);
+    unres->diff->type[unres->diff_idx - 1] = unres->diff->type[unres->diff_idx];
+    --unres->diff_idx;
+}
+
+API int
+lyd_freeze(struct lyd_node *root)
+{
+    FUN_IN;
+
+    struct lyd_node *top, *next, *elem, *tree;
+    struct lyd_node_anydata *any;
+
+    if (!root) {
+        LOGARG;
+        return EXIT_FAILURE;
+    }
+
+    LY_TREE_FOR(root, top) {
+        LY_TREE_DFS_BEGIN(top, next, elem) {
+            if (elem->validity & LYD_VAL_INUSE) {
+                /* the node is being processed */
+                LOGINT(lyd_node_module(elem)->ctx);
+                return EXIT_FAILURE;
+            }
+
+            if (elem->schema->nodetype & LYS_ANYDATA) {
+                any = (struct lyd_node_anydata *)elem;
+                if (any->value_type == LYD_ANYDATA_LYB) {
+                    /* parse the value once now instead of on every print as XML */
+                    tree = lyd_parse_mem(lyd_node_module(elem)->ctx, any->value.mem, LYD_LYB,
+                                         LYD_OPT_DATA | LYD_OPT_STRICT | LYD_OPT_TRUSTED);
+                    if (tree) {
+                        free(any->value.mem);
+                        any->value_type = LYD_ANYDATA_DATATREE;
+                        any->value.tree = tree;
+                    }
+                }
+                if ((any->value_type == LYD_ANYDATA_DATATREE) && any->value.tree && lyd_freeze(any->value.tree)) {
+                    return EXIT_FAILURE;
+                }
+            }
+            LY_TREE_DFS_END(top, next, elem);
+        }
+    }
+
+    return EXIT_SUCCESS;
 }
 
 API void
@@ -7063,17 +12627,22 @@ lyd_free_val_diff(struct lyd_difflist *diff)
 {
     FUN_IN;
 
-    uint32_t i;
+    uint32_t i, nodup;
 
     if (!diff) {
         return;
     }
 
+    for (i = 0; diff->type[i] != LYD_DIFF_END; ++i);
+    nodup = (diff->first[i] == (struct lyd_node *)&lyd_val_diff_nodup);
+
     for (i = 0; diff->type[i] != LYD_DIFF_END; ++i) {
         switch (diff->type[i]) {
         case LYD_DIFF_CREATED:
-            free(diff->first[i]);
-            lyd_free_withsiblings(diff->second[i]);
+            if (!nodup) {
+                free(diff->first[i]);
+                lyd_free_withsiblings(diff->second[i]);
+            }
             break;
         case LYD_DIFF_DELETED:
             lyd_free_withsiblings(diff->first[i]);
@@ -7374,7 +12943,8 @@ lyd_wd_add_subtree(struct lyd_node **root, struct lyd_node *last_parent, struct
             for (i = 0; i < (signed)present->number; i++) {
                 if (schema->nodetype & LYS_LEAFLIST) {
                     lyd_wd_leaflist_cleanup(present, unres);
-                } else if (schema->nodetype != LYS_LEAF) {
+                } else if ((schema->nodetype != LYS_LEAF) && (!(options & LYD_OPT_VAL_CHANGED)
+                        || (present->set.d[i]->validity & LYD_VAL_SUBTREE))) {
                     if (lyd_wd_add_subtree(root, present->set.d[i], present->set.d[i], schema, 0, options, unres)) {
                         goto error;
                     }
@@ -7507,6 +13077,10 @@ lyd_wd_add_subtree(struct lyd_node **root, struct lyd_node *last_parent, struct
                     } else if (siter->nodetype != LYS_LEAF) {
                         /* recursion */
                         for (i = 0; i < (signed)present->number; i++) {
+                            if ((options & LYD_OPT_VAL_CHANGED) && !(present->set.d[i]->validity & LYD_VAL_SUBTREE)) {
+                                /* unchanged subtree */
+                                continue;
+                            }
                             if (lyd_wd_add_subtree(root, present->set.d[i], present->set.d[i], siter, toplevel, options,
                                                    unres)) {
                                 goto error;
@@ -7726,12 +13300,304 @@ lyd_wd_add(struct lyd_node **root, struct ly_ctx *ctx, const struct lys_module *
     return EXIT_SUCCESS;
 }
 
+/**
+ * @brief Free the default nodes in a subtree (#LYD_OPT_WD_VIRTUAL), keep the ones which are leafref targets.
+ *
+ * @param[in] node Root of the subtree.
+ * @return 1 if the node itself was freed, 0 otherwise.
+ */
+static int
+lyd_wd_virtual_r(struct lyd_node *node)
+{
+    struct lyd_node *next, *iter;
+
+    if (node->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST)) {
+        if (!node->dflt || node->schema->child) {
+            /* explicit node or a possible leafref target */
+            return 0;
+        }
+    } else if (node->schema->nodetype & LYS_ANYDATA) {
+        return 0;
+    } else {
+        LY_TREE_FOR_SAFE(node->child, next, iter) {
+            lyd_wd_virtual_r(iter);
+        }
+        if (!node->dflt || node->child) {
+            return 0;
+        }
+    }
+
+    /* the parent stays valid, the node is only not stored */
+    if (!lyd_txn_cur || !lyd_txn_free(node)) {
+        lyd_unlink_internal(node, 0);
+        lyd_free_internal_r(node, 0);
+    }
+    return 1;
+}
+
+/**
+ * @brief Free the default nodes of a validated tree (#LYD_OPT_WD_VIRTUAL).
+ *
+ * @param[in,out] root Validated tree, the first node can be freed.
+ * @param[in] modules Only data of these modules were validated, NULL for all.
+ * @param[in] mod_count Number of \p modules.
+ * @param[in] options Validation options.
+ */
+static void
+lyd_wd_virtual(struct lyd_node **root, const struct lys_module **modules, int mod_count, int options)
+{
+    struct lyd_node *next, *iter;
+    struct ly_ctx *ctx;
+    int i;
+
+    if (!*root) {
+        return;
+    }
+
+    ctx = (*root)->schema->module->ctx;
+    lydict_release_start(ctx);
+    lyd_pool_stash_start(ctx);
+    LY_TREE_FOR_SAFE(*root, next, iter) {
+        if (modules) {
+            for (i = 0; i < mod_count; ++i) {
+                if (lyd_node_module(iter) == modules[i]) {
+                    break;
+                }
+            }
+            if (i == mod_count) {
+                /* data not validated */
+                continue;
+            }
+        }
+
+        if (iter == *root) {
+            /* the first node may be freed */
+            if (lyd_wd_virtual_r(iter)) {
+                *root = next;
+            }
+        } else {
+            lyd_wd_virtual_r(iter);
+        }
+
+        if (options & LYD_OPT_NOSIBLINGS) {
+            break;
+        }
+    }
+    lyd_pool_stash_flush(ctx);
+    lydict_release_flush(ctx);
+}
+
+/* remember a schema node of an external dependency, nodes of the message itself are skipped */
+static int
+lyd_ext_deps_add(struct ly_set *deps, const struct lys_node *snode, const struct lys_node *msg_op)
+{
+    const struct lys_node *parent;
+
+    if (!snode || !(snode->nodetype & (LYS_CONTAINER | LYS_LIST | LYS_LEAF | LYS_LEAFLIST | LYS_ANYDATA))) {
+        return 0;
+    }
+
+    /* in the message subtree */
+    for (parent = snode; parent && (parent != msg_op); parent = lys_parent(parent));
+    if (parent) {
+        return 0;
+    }
+
+    /* a parent of an action/notification, also in the message */
+    for (parent = lys_parent(msg_op); parent && (parent != snode); parent = lys_parent(parent));
+    if (parent) {
+        return 0;
+    }
+
+    return (ly_set_add(deps, (void *)snode, 0) == -1) ? -1 : 0;
+}
+
+/* remember external dependencies of the leafrefs and instance-identifiers in a union */
+static int
+lyd_ext_deps_union(struct ly_set *deps, struct ly_set *instids, struct lyd_node *node, struct lys_type *type,
+                   const struct lys_node *msg_op)
+{
+    uint8_t i;
+
+    while (!type->info.uni.count) {
+        assert(type->der);
+        type = &type->der->type;
+    }
+
+    for (i = 0; i < type->info.uni.count; ++i) {
+        switch (type->info.uni.types[i].base) {
+        case LY_TYPE_LEAFREF:
+            if (lyd_ext_deps_add(deps, (struct lys_node *)type->info.uni.types[i].info.lref.target, msg_op)) {
+                return -1;
+            }
+            break;
+        case LY_TYPE_INST:
+            if (((struct lyd_node_leaf_list *)node)->value_type == LY_TYPE_INST) {
+                if (ly_set_add(instids, node, LY_SET_OPT_USEASLIST) == -1) {
+                    return -1;
+                }
+            }
+            break;
+        case LY_TYPE_UNION:
+            if (lyd_ext_deps_union(deps, instids, node, &type->info.uni.types[i], msg_op)) {
+                return -1;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    return 0;
+}
+
+/* merge a tree supplied by the external dependencies callback */
+static int
+lyd_ext_deps_merge(struct lyd_node **provided, struct lyd_node *tree)
+{
+    if (!tree) {
+        return 0;
+    }
+
+    for (; tree->parent; tree = tree->parent);
+    for (; tree->prev->next; tree = tree->prev);
+    if (!*provided) {
+        *provided = tree;
+    } else if (lyd_merge(*provided, tree, LYD_OPT_DESTRUCT)) {
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Get the external dependencies of the unresolved message nodes from the context callback.
+ *
+ * @param[in] ctx Context with the callback.
+ * @param[in] unres Unresolved data nodes of the message.
+ * @param[in] msg_op Schema node of the RPC, action, or notification.
+ * @param[out] provided Data tree with the dependencies, NULL if there are none.
+ * @return 0 on success, -1 on error.
+ */
+static int
+lyd_ext_deps_provide(struct ly_ctx *ctx, struct unres_data *unres, const struct lys_node *msg_op,
+                     struct lyd_node **provided)
+{
+    struct ly_set *deps, *instids, *atomized, *atoms;
+    struct lys_node *snode, *parent;
+    struct lyd_node *node;
+    uint32_t i, j;
+    int ret = -1;
+
+    *provided = NULL;
+
+    deps = ly_set_new();
+    instids = ly_set_new();
+    atomized = ly_set_new();
+    LY_CHECK_ERR_GOTO(!deps || !instids || !atomized, LOGMEM(ctx), cleanup);
+
+    for (i = 0; i < unres->count; ++i) {
+        node = unres->node[i];
+        snode = node->schema;
+        switch (unres->type[i]) {
+        case UNRES_LEAFREF:
+            if (lyd_ext_deps_add(deps, (struct lys_node *)((struct lys_node_leaf *)snode)->type.info.lref.target,
+                                 msg_op)) {
+                goto cleanup;
+            }
+            break;
+        case UNRES_UNION:
+            if (lyd_ext_deps_union(deps, instids, node, &((struct lys_node_leaf *)snode)->type, msg_op)) {
+                goto cleanup;
+            }
+            break;
+        case UNRES_INSTID:
+            if (ly_set_add(instids, node, LY_SET_OPT_USEASLIST) == -1) {
+                goto cleanup;
+            }
+            break;
+        case UNRES_MUST_INOUT:
+            /* the must of the parent input/output */
+            for (snode = lys_parent(snode); snode && !(snode->nodetype & (LYS_INPUT | LYS_OUTPUT));
+                 snode = lys_parent(snode));
+            if (!snode) {
+                break;
+            }
+            /* fallthrough */
+        case UNRES_WHEN:
+        case UNRES_MUST:
+            if (!(snode->flags & (LYS_XPCONF_DEP | LYS_XPSTATE_DEP)) || (ly_set_contains(atomized, snode) > -1)) {
+                /* no external dependencies or already added */
+                break;
+            }
+            if (ly_set_add(atomized, snode, 0) == -1) {
+                goto cleanup;
+            }
+
+            atoms = lys_node_xpath_atomize(snode, LYXP_NO_LOCAL);
+            if (!atoms) {
+                goto cleanup;
+            }
+            for (j = 0; j < atoms->number; ++j) {
+                if (lyd_ext_deps_add(deps, atoms->set.s[j], msg_op)) {
+                    ly_set_free(atoms);
+                    goto cleanup;
+                }
+            }
+            ly_set_free(atoms);
+            break;
+        default:
+            break;
+        }
+    }
+
+    /* the parents of other dependencies are supplied with them, do not request their whole subtrees */
+    for (i = 0; i < deps->number; ) {
+        for (j = 0; j < deps->number; ++j) {
+            for (parent = lys_parent(deps->set.s[j]); parent && (parent != deps->set.s[i]); parent = lys_parent(parent));
+            if (parent) {
+                break;
+            }
+        }
+        if (j < deps->number) {
+            ly_set_rm_index(deps, i);
+        } else {
+            ++i;
+        }
+    }
+
+    for (i = 0; i < deps->number; ++i) {
+        if (lyd_ext_deps_merge(provided, ctx->ext_deps_clb(ctx, deps->set.s[i], NULL, ctx->ext_deps_clb_data))) {
+            goto cleanup;
+        }
+    }
+    for (i = 0; i < instids->number; ++i) {
+        if (lyd_ext_deps_merge(provided, ctx->ext_deps_clb(ctx, NULL,
+                                                           ((struct lyd_node_leaf_list *)instids->set.d[i])->value_str,
+                                                           ctx->ext_deps_clb_data))) {
+            goto cleanup;
+        }
+    }
+
+    ret = 0;
+
+cleanup:
+    if (ret) {
+        lyd_free_withsiblings(*provided);
+        *provided = NULL;
+    }
+    ly_set_free(deps);
+    ly_set_free(instids);
+    ly_set_free(atomized);
+    return ret;
+}
+
 int
 lyd_defaults_add_unres(struct lyd_node **root, int options, struct ly_ctx *ctx, const struct lys_module **modules,
                        int mod_count, const struct lyd_node *data_tree, struct lyd_node *act_notif,
                        struct unres_data *unres, int wd)
 {
-    struct lyd_node *msg_sibling = NULL, *msg_parent = NULL, *data_tree_sibling, *data_tree_parent;
+    struct lyd_node *msg_sibling = NULL, *msg_parent = NULL, *data_tree_sibling, *data_tree_parent, *provided = NULL;
     struct lys_node *msg_op = NULL;
     struct ly_set *set;
     int ret = EXIT_FAILURE;
@@ -7786,6 +13652,15 @@ lyd_defaults_add_unres(struct lyd_node **root, int options, struct ly_ctx *ctx,
             return EXIT_FAILURE;
         }
 
+        /* get only the external dependencies instead of the whole additional data tree */
+        if (!data_tree && (options & (LYD_OPT_RPC | LYD_OPT_RPCREPLY | LYD_OPT_NOTIF)) && !(options & LYD_OPT_NOEXTDEPS)
+                && ctx->ext_deps_clb) {
+            if (lyd_ext_deps_provide(ctx, unres, msg_op, &provided)) {
+                return EXIT_FAILURE;
+            }
+            data_tree = provided;
+        }
+
         /* temporarily link the additional data tree to the RPC/action/notification */
         if (data_tree && (options & (LYD_OPT_RPC | LYD_OPT_RPCREPLY | LYD_OPT_NOTIF))) {
             /* duplicate the message tree - if it gets deleted we would not be able to positively identify it */
@@ -7893,11 +13768,17 @@ unlink_datatree:
                 lyd_insert_common(msg_parent, NULL, msg_sibling, 0);
             }
         }
+        lyd_free_withsiblings(provided);
     } else {
         /* we are done */
         ret = EXIT_SUCCESS;
     }
 
+    if (!ret && wd && (options & LYD_OPT_WD_VIRTUAL)) {
+        /* the defaults were needed only for the validation */
+        lyd_wd_virtual(root, modules, mod_count, options);
+    }
+
     return ret;
 }
 
@@ -7962,6 +13843,143 @@ lyd_leaf_type(const struct lyd_node_leaf_list *leaf)
     return type;
 }
 
+/**
+ * @brief Get the share of a dictionary string referenced once more by a data tree.
+ */
+static size_t
+lyd_mem_str(struct ly_ctx *ctx, const char *str)
+{
+    uint32_t refcount;
+
+    if (!str || !(refcount = lydict_refcount(ctx, str))) {
+        /* immortal strings belong to the schemas */
+        return 0;
+    }
+
+    /* with the NUL and the flags byte */
+    return (strlen(str) + 2) / refcount;
+}
+
+static void
+lyd_mem_xml_r(struct ly_ctx *ctx, const struct lyxml_elem *elem, struct lyd_mem_stats *stats)
+{
+    const struct lyxml_attr *attr;
+
+    for (; elem; elem = elem->next) {
+        stats->value_mem += sizeof *elem;
+        stats->dict_mem += lyd_mem_str(ctx, elem->name) + lyd_mem_str(ctx, elem->content);
+        for (attr = elem->attr; attr; attr = attr->next) {
+            if (attr->type == LYXML_ATTR_NS) {
+                stats->value_mem += sizeof(struct lyxml_ns);
+                stats->dict_mem += lyd_mem_str(ctx, ((struct lyxml_ns *)attr)->prefix);
+            } else {
+                stats->value_mem += sizeof *attr;
+                stats->dict_mem += lyd_mem_str(ctx, attr->name);
+            }
+            stats->dict_mem += lyd_mem_str(ctx, attr->value);
+        }
+        lyd_mem_xml_r(ctx, elem->child, stats);
+    }
+}
+
+static void
+lyd_mem_usage_r(const struct lyd_node *node, int withsiblings, struct lyd_mem_stats *stats)
+{
+    struct ly_ctx *ctx;
+    const struct lyd_node_leaf_list *leaf;
+    const struct lyd_node_anydata *any;
+    const struct lys_type *type;
+    const struct lyd_attr *attr;
+    int len;
+
+    for (; node; node = withsiblings ? node->next : NULL) {
+        ctx = node->schema->module->ctx;
+        ++stats->nodes;
+
+        for (attr = node->attr; attr; attr = attr->next) {
+            ++stats->attrs;
+#ifdef LY_ENABLED_DATA_POOL
+            stats->attr_mem += sizeof(union lyd_pool_slot);
+#else
+            stats->attr_mem += sizeof *attr;
+#endif
+            stats->dict_mem += lyd_mem_str(ctx, attr->name) + lyd_mem_str(ctx, attr->value_str);
+        }
+
+        switch (node->schema->nodetype) {
+        case LYS_LEAF:
+        case LYS_LEAFLIST:
+            leaf = (const struct lyd_node_leaf_list *)node;
+#ifndef LY_ENABLED_DATA_POOL
+            stats->node_mem += sizeof *leaf;
+#endif
+            stats->dict_mem += lyd_mem_str(ctx, leaf->value_str);
+            if ((leaf->value_type == LY_TYPE_BITS) && !(leaf->value_flags & LY_VALUE_USER) && leaf->value.bit
+                    && (type = lyd_leaf_type(leaf))) {
+                /* array of the pointers to all the bits of the type */
+                for (; !type->info.bits.count && type->der; type = &type->der->type);
+                stats->value_mem += type->info.bits.count * sizeof *leaf->value.bit;
+            }
+            break;
+        case LYS_ANYXML:
+        case LYS_ANYDATA:
+            any = (const struct lyd_node_anydata *)node;
+#ifndef LY_ENABLED_DATA_POOL
+            stats->node_mem += sizeof *any;
+#endif
+            switch (any->value_type) {
+            case LYD_ANYDATA_CONSTSTRING:
+            case LYD_ANYDATA_SXML:
+            case LYD_ANYDATA_JSON:
+                stats->dict_mem += lyd_mem_str(ctx, any->value.str);
+                break;
+            case LYD_ANYDATA_DATATREE:
+                lyd_mem_usage_r(any->value.tree, 1, stats);
+                break;
+            case LYD_ANYDATA_XML:
+                lyd_mem_xml_r(ctx, any->value.xml, stats);
+                break;
+            case LYD_ANYDATA_LYB:
+                if (any->value.mem && ((len = lyd_lyb_data_length(any->value.mem)) > 0)) {
+                    stats->value_mem += len;
+                }
+                break;
+            default:
+                /* the dynamic string types are never stored */
+                break;
+            }
+            break;
+        default:
+#ifndef LY_ENABLED_DATA_POOL
+            stats->node_mem += sizeof *node;
+#endif
+#ifdef LY_ENABLED_CACHE
+            stats->ht_mem += lyht_mem_size(node->ht);
+#endif
+            lyd_mem_usage_r(node->child, 1, stats);
+            break;
+        }
+#ifdef LY_ENABLED_DATA_POOL
+        /* every node takes a whole slot */
+        stats->node_mem += sizeof(union lyd_pool_slot);
+#endif
+    }
+}
+
+API int
+lyd_mem_usage(const struct lyd_node *node, int withsiblings, struct lyd_mem_stats *stats)
+{
+    FUN_IN;
+
+    if (!node || !stats) {
+        LOGARG;
+        return EXIT_FAILURE;
+    }
+
+    lyd_mem_usage_r(node, withsiblings, stats);
+    return EXIT_SUCCESS;
+}
+
 #ifdef LY_ENABLED_LYD_PRIV
 
 API void *
@@ -156,6 +156,9 @@ struct lyd_attr {
                                       are checked for this node if flag #LYD_OPT_OBSOLETE is used. */
 #define LYD_VAL_LEAFREF  0x08    /**< Node is a leafref, which needs to be resolved (it is invalid, new possible
                                       resolvent, or something similar) */
+#define LYD_VAL_SUBTREE  0x10    /**< The node or some of its descendants changed since the last successful validation,
+                                      set also on all the ancestors so that the incremental validation
+                                      (#LYD_OPT_VAL_INCREMENTAL) can skip the unchanged subtrees */
 #define LYD_VAL_INUSE    0x80    /**< Internal flag for note about various processing on data, should be used only
                                       internally and removed before libyang returns the node to the caller */
 /**
@@ -181,6 +184,9 @@ struct lyd_node {
     uint8_t dflt:1;                  /**< flag for implicit default node */
     uint8_t when_status:3;           /**< bit for checking if the when-stmt condition is resolved - internal use only,
                                           do not use this value! */
+#if defined(LY_ENABLED_COMPACT_DATA) && defined(LY_ENABLED_CACHE)
+    uint32_t hash;                   /**< hash of this particular node (module name + schema name + key string values if list) */
+#endif
 
     struct lyd_attr *attr;           /**< pointer to the list of attributes of this node */
     struct lyd_node *next;           /**< pointer to the next sibling node (NULL if there is no one) */
@@ -195,7 +201,9 @@ struct lyd_node {
 #endif
 
 #ifdef LY_ENABLED_CACHE
+#ifndef LY_ENABLED_COMPACT_DATA
     uint32_t hash;                   /**< hash of this particular node (module name + schema name + key string values if list) */
+#endif
     struct hash_table *ht;           /**< hash table with all the direct children (except keys for a list, lists without keys) */
 #endif
 
@@ -223,6 +231,12 @@ struct lyd_node_leaf_list {
     uint8_t dflt:1;                  /**< flag for implicit default node */
     uint8_t when_status:3;           /**< bit for checking if the when-stmt condition is resolved - internal use only,
                                           do not use this value! */
+#ifdef LY_ENABLED_COMPACT_DATA
+    uint8_t value_flags;             /**< value type flags */
+#ifdef LY_ENABLED_CACHE
+    uint32_t hash;                   /**< hash of this particular node (module name + schema name + string value if leaf-list) */
+#endif
+#endif
 
     struct lyd_attr *attr;           /**< pointer to the list of attributes of this node */
     struct lyd_node *next;           /**< pointer to the next sibling node (NULL if there is no one) */
@@ -236,7 +250,7 @@ struct lyd_node_leaf_list {
     void *priv;                      /**< private user data, not used by libyang */
 #endif
 
-#ifdef LY_ENABLED_CACHE
+#if defined(LY_ENABLED_CACHE) && !defined(LY_ENABLED_COMPACT_DATA)
     uint32_t hash;                   /**< hash of this particular node (module name + schema name + string value if leaf-list) */
 #endif
 
@@ -246,7 +260,9 @@ struct lyd_node_leaf_list {
     const char *value_str;           /**< string representation of value (for comparison, printing,...), always corresponds to value_type */
     lyd_val value;                   /**< node's value representation, always corresponds to schema->type.base */
     LY_DATA_TYPE _PACKED value_type; /**< type of the value in the node, mainly for union to avoid repeating of type detection */
+#ifndef LY_ENABLED_COMPACT_DATA
     uint8_t value_flags;             /**< value type flags */
+#endif
 };
 
 /**
@@ -284,6 +300,9 @@ struct lyd_node_anydata {
     uint8_t dflt:1;                  /**< flag for implicit default node */
     uint8_t when_status:3;           /**< bit for checking if the when-stmt condition is resolved - internal use only,
                                           do not use this value! */
+#if defined(LY_ENABLED_COMPACT_DATA) && defined(LY_ENABLED_CACHE)
+    uint32_t hash;                   /**< hash of this particular node (module name + schema name) */
+#endif
 
     struct lyd_attr *attr;           /**< pointer to the list of attributes of this node */
     struct lyd_node *next;           /**< pointer to the next sibling node (NULL if there is no one) */
@@ -297,7 +316,7 @@ struct lyd_node_anydata {
     void *priv;                      /**< private user data, not used by libyang */
 #endif
 
-#ifdef LY_ENABLED_CACHE
+#if defined(LY_ENABLED_CACHE) && !defined(LY_ENABLED_COMPACT_DATA)
     uint32_t hash;                   /**< hash of this particular node (module name + schema name) */
 #endif
 
@@ -416,6 +435,34 @@ void lyd_free_diff(struct lyd_difflist *diff);
  */
 struct lyd_difflist *lyd_diff(struct lyd_node *first, struct lyd_node *second, int options);
 
+/**
+ * @brief Callback for lyd_diff_iter() getting the differences one by one.
+ *
+ * @param[in] type Type of the difference, never #LYD_DIFF_END.
+ * @param[in] first Node from the first tree, the meaning is the same as of lyd_difflist::first.
+ * @param[in] second Node from the second tree, the meaning is the same as of lyd_difflist::second.
+ * @param[in] user_data Arbitrary user data passed to lyd_diff_iter().
+ * @return 0 to continue, non-zero to stop the comparison.
+ */
+typedef int (*lyd_diff_clb)(LYD_DIFFTYPE type, struct lyd_node *first, struct lyd_node *second, void *user_data);
+
+/**
+ * @brief Compare two data trees the same way as lyd_diff() but pass the differences to a callback instead of
+ * collecting them in a lyd_difflist.
+ *
+ * The callback gets the differences in the same order as they appear in the lyd_diff() result, the nodes can be
+ * inspected but the trees must not be modified until the function returns. Callers only interested in whether or
+ * where the trees differ can stop the comparison from the callback without waiting for the rest of the trees.
+ *
+ * @param[in] first The first (sub)tree to compare, see lyd_diff().
+ * @param[in] second The second (sub)tree to compare, see lyd_diff().
+ * @param[in] options The @ref diffoptions are accepted.
+ * @param[in] clb Callback to get the differences.
+ * @param[in] user_data Arbitrary user data passed to \p clb.
+ * @return EXIT_SUCCESS when the trees were compared or the comparison was stopped by \p clb, EXIT_FAILURE on error.
+ */
+int lyd_diff_iter(struct lyd_node *first, struct lyd_node *second, int options, lyd_diff_clb clb, void *user_data);
+
 /**
  * @defgroup diffoptions Diff options
  * @ingroup datatree
@@ -435,8 +482,65 @@ struct lyd_difflist *lyd_diff(struct lyd_node *first, struct lyd_node *second, i
                                              transactions on the first tree does not result to the exact second tree,
                                              because instead of having implicit default nodes you are going to have
                                              explicit default nodes. */
+#define LYD_DIFFOPT_SUBTREEHASH  0x0002 /**< Compute content hashes (see lyd_content_hash()) of the subtrees of both
+                                             trees first and do not descend into the matched containers and list
+                                             instances whose subtrees have equal hashes. Useful when most of the
+                                             trees are the same, the hashes are computed in a single pass over each
+                                             tree instead of matching all their nodes. */
 /**@} diffoptions */
 
+/**
+ * @brief Compute a content hash of a data subtree.
+ *
+ * The hash covers the node names, the values and the children of the node. The order of the children does not
+ * matter except for the instances of user-ordered lists and leaf-lists. Anydata and anyxml nodes with other than
+ * string values (data trees, XML or LYB) make the hash unique for the particular node. Equal hashes of two subtrees,
+ * even from different contexts, mean (up to a 64-bit hash collision) that lyd_diff() finds no differences between
+ * them, so comparing the hashes of a previous and a new version of the data is a fast equality check.
+ *
+ * @param[in] node Root of the subtree.
+ * @param[in] options The @ref diffoptions are accepted, only #LYD_DIFFOPT_WITHDEFAULTS is relevant, default nodes
+ *            are skipped without it.
+ * @return Content hash, 0 if \p node is NULL.
+ */
+uint64_t lyd_content_hash(const struct lyd_node *node, int options);
+
+/**
+ * @brief Encode the differences of two data trees as an LYB patch.
+ *
+ * The patch holds the paths of the deleted and moved nodes and the changed and created nodes with their parents
+ * as LYB data, so it is much smaller than the whole \p second tree if only a small part of it changes. The nodes
+ * must be identifiable by their paths, as configuration data are. Use lyd_lyb_patch_length() to get its length.
+ *
+ * @param[out] patch Printed patch, the caller is supposed to free it.
+ * @param[in] first The first (base) data tree.
+ * @param[in] second The second (new) data tree.
+ * @param[in] options The @ref diffoptions are accepted.
+ * @return EXIT_SUCCESS on success, EXIT_FAILURE on error.
+ */
+int lyd_lyb_patch(char **patch, struct lyd_node *first, struct lyd_node *second, int options);
+
+/**
+ * @brief Get the length of an LYB patch.
+ *
+ * @param[in] patch LYB patch printed by lyd_lyb_patch().
+ * @return \p patch length or -1 on error.
+ */
+int lyd_lyb_patch_length(const char *patch);
+
+/**
+ * @brief Apply an LYB patch to the base data tree, which is changed into the second tree of lyd_lyb_patch().
+ *
+ * __PARTIAL CHANGE__ - validate after the final change on the data tree (see @ref howtodatamanipulators).
+ *
+ * @param[in] ctx Context of the data trees.
+ * @param[in,out] root Base data tree, it may be NULL and may change to another top-level node.
+ * @param[in] patch LYB patch printed by lyd_lyb_patch().
+ * @param[in] options Parser options for the LYB data of the patch, see @ref parseroptions.
+ * @return EXIT_SUCCESS on success, EXIT_FAILURE on error, the data tree may be changed partially.
+ */
+int lyd_lyb_patch_apply(struct ly_ctx *ctx, struct lyd_node **root, const char *patch, int options);
+
 /**
  * @brief Build data path (usable as path, see @ref howtoxpath) of the data node.
  * @param[in] node Data node to be processed. Note that the node should be from a complete data tree, having a subtree
@@ -446,6 +550,51 @@ struct lyd_difflist *lyd_diff(struct lyd_node *first, struct lyd_node *second, i
  */
 char *lyd_path(const struct lyd_node *node);
 
+/**
+ * @brief Build data path of the data node, the same as lyd_path(), into a caller buffer.
+ *
+ * @param[in] node Data node to be processed.
+ * @param[in] buf Buffer for the path, it is always terminated (if \p size is not 0), truncated if too small.
+ * @param[in] size Size of \p buf.
+ * @return Length of the whole path (without the terminating zero), \p buf is sufficient if it is
+ * less than \p size. -1 on error.
+ */
+int lyd_path_buf(const struct lyd_node *node, char *buf, size_t size);
+
+/**
+ * @brief Builder of data paths reusing the path of the common ancestors of the previous node.
+ *
+ * Zero it before the first use and free its memory with lyd_path_builder_clear().
+ */
+struct lyd_path_builder {
+    char *buf;                      /**< last built path */
+    size_t size;                    /**< allocated size of buf */
+    const struct lyd_node **nodes;  /**< nodes of the last built path from the top-level one */
+    size_t *ends;                   /**< length of the path of each node in nodes */
+    uint32_t depth;                 /**< number of nodes */
+    uint32_t alloc;                 /**< allocated number of nodes and ends */
+};
+
+/**
+ * @brief Build data path of the data node, the same as lyd_path(), only the steps of the ancestors not shared
+ * with the previous node of the builder are printed.
+ *
+ * The builder must be cleared by lyd_path_builder_clear() if any node of the previous path is freed
+ * or its path step changes (key values, instance position of a list without keys).
+ *
+ * @param[in] builder Path builder.
+ * @param[in] node Data node to be processed.
+ * @return Path owned by the builder, valid until its next use, NULL on error.
+ */
+const char *lyd_path_build(struct lyd_path_builder *builder, const struct lyd_node *node);
+
+/**
+ * @brief Free the memory of a path builder and zero it.
+ *
+ * @param[in] builder Path builder to clear.
+ */
+void lyd_path_builder_clear(struct lyd_path_builder *builder);
+
 /**
  * @defgroup parseroptions Data parser options
  * @ingroup datatree
@@ -539,7 +688,47 @@ char *lyd_path(const struct lyd_node *node);
 #define LYD_OPT_VAL_DIFF 0x40000 /**< Flag only for validation, store all the data node changes performed by the validation
                                       in a diff structure. */
 #define LYD_OPT_LYB_MOD_UPDATE 0x80000 /**< Allow to parse data using an updated revision of a module, relevant only for LYB format. */
+#define LYD_OPT_PARALLEL 0x100000 /**< Parse the top-level subtrees concurrently in several threads (one per online CPU
+                                       at most, see ly_ctx_set_executor()) and link them in the original order, relevant only for LYB format.
+                                       The subtrees are located using their sizes without parsing them first. Ignored
+                                       for RPCs, replies and notifications, which have only a single top-level subtree.
+                                       In any validation (including the one done by the parsers), the must conditions
+                                       are evaluated concurrently if there are enough of them, after all the other
+                                       constraints, which may modify the data, are resolved. */
+#define LYD_OPT_LYB_VALIDATE 0x200000 /**< Validate LYB data, which are trusted otherwise, unless they were printed with
+                                           #LYP_LYB_VALIDATED in a context with the same schema set (modules, their
+                                           revisions, conformance, and enabled features). Relevant only for LYB format. */
+#define LYD_OPT_VAL_INCREMENTAL 0x400000 /**< Flag only for validation, validate only the data changed (created, inserted,
+                                              modified, or unlinked) since the last successful validation of the tree
+                                              together with the when and must conditions depending on them and the
+                                              mandatory nodes and default values of their parents. The rest of the tree
+                                              is expected to be valid. Applicable only with #LYD_OPT_DATA or
+                                              #LYD_OPT_CONFIG and neither #LYD_OPT_NOSIBLINGS nor #LYD_OPT_WHENAUTODEL.
+                                              Moving a validated subtree keeps the validity of its descendants. */
+#define LYD_OPT_WD_VIRTUAL 0x800000 /**< Keep the default nodes virtual, they are added only for the time of the validation
+                                         (so that all the constraints are evaluated with them) and freed afterwards, unless
+                                         they are a target of a leafref. The resulting tree then contains only the explicit
+                                         nodes and a later lookup, XPath evaluation or printing sees it like that, the
+                                         defaults are materialized only by a validation without this flag. Applicable only
+                                         with #LYD_OPT_DATA or #LYD_OPT_CONFIG and neither #LYD_OPT_VAL_INCREMENTAL nor
+                                         #LYD_OPT_VAL_DIFF. Such a tree must be completely validated before validating
+                                         it with #LYD_OPT_VAL_INCREMENTAL. */
 #define LYD_OPT_DATA_TEMPLATE 0x1000000 /**< Data represents YANG data template. */
+/* 0x2000000 reserved, used internally */
+#define LYD_OPT_VAL_DIFF_NODUP 0x4000000 /**< Flag only for validation together with #LYD_OPT_VAL_DIFF, the created
+                                              subtrees are not duplicated into the diff but referenced in the validated
+                                              tree, so the diff is valid only until the tree is modified or freed. */
+#define LYD_OPT_VAL_ALL 0x8000000 /**< Flag only for validation, continue past the validation errors and collect all
+                                       of them into an array of struct ::lyd_val_err with the nodes they relate to instead
+                                       of stopping on the first one. The errors are logged as usual, disable logging with
+                                       ly_log_options() to avoid formatting the messages and building the paths. The when
+                                       conditions and leafrefs resolved together still stop the validation on their
+                                       failure. Not applicable with #LYD_OPT_WHENAUTODEL or #LYD_OPT_WD_VIRTUAL, which
+                                       free nodes. */
+#define LYD_OPT_CANONICAL 0x10000000 /**< Together with #LYD_OPT_TRUSTED, the integer, decimal64 and bits values are
+                                          trusted to be in their canonical form too (such as when printed by libyang
+                                          from a validated tree), so they are stored as they are instead of being
+                                          converted into it. Relevant only for XML and JSON formats. */
 
 /**@} parseroptions */
 
@@ -659,6 +848,119 @@ struct lyd_node *lyd_parse_fd(struct ly_ctx *ctx, int fd, LYD_FORMAT format, int
  */
 struct lyd_node *lyd_parse_path(struct ly_ctx *ctx, const char *path, LYD_FORMAT format, int options, ...);
 
+/**
+ * @brief Opaque context of a data parser fed by chunks of data.
+ */
+struct lyd_chunk_parser;
+
+/**
+ * @brief Create a parser (and validator) for data that are available in several consecutive chunks,
+ * for example those being received from a network.
+ *
+ * In case of LY_XML format, every top-level element is parsed into an XML tree as soon as its last chunk is fed
+ * and its text is discarded, so parsing overlaps with receiving the data and only the currently incomplete
+ * top-level element is kept buffered. Conversion into the data tree and its validation is performed by
+ * lyd_chunk_parser_finish(). LY_JSON and LY_LYB data are buffered and parsed completely by lyd_chunk_parser_finish().
+ *
+ * @param[in] ctx Context to connect with the data tree being built.
+ * @param[in] format Format of the input data to be parsed.
+ * @param[in] options Parser options, see @ref parseroptions, as for lyd_parse_mem().
+ * @param[in] ... Variable arguments depend on \p options, see lyd_parse_mem(). The passed data trees
+ *                must not be changed nor freed until lyd_chunk_parser_finish() is called.
+ * @return Created parser, NULL on error.
+ */
+struct lyd_chunk_parser *lyd_chunk_parser_new(struct ly_ctx *ctx, LYD_FORMAT format, int options, ...);
+
+/**
+ * @brief Feed another chunk of data to a parser.
+ *
+ * The chunk can split the data at any position. Once a chunk fails to be parsed, all the following calls fail and
+ * lyd_chunk_parser_finish() returns NULL.
+ *
+ * @param[in] parser Parser created with lyd_chunk_parser_new().
+ * @param[in] data Data chunk, it does not need to be NULL-terminated. Except for LY_LYB format, it must not
+ *                 contain a NULL byte.
+ * @param[in] len Length of \p data.
+ * @return EXIT_SUCCESS on success, EXIT_FAILURE on error.
+ */
+int lyd_chunk_parser_feed(struct lyd_chunk_parser *parser, const char *data, size_t len);
+
+/**
+ * @brief Finish parsing of all the fed data, validate them, and free the parser.
+ *
+ * @param[in] parser Parser created with lyd_chunk_parser_new(), it is always freed.
+ * @return Pointer to the built data tree or NULL in case of empty data, as lyd_parse_mem(). In case of error,
+ *         #ly_errno contains appropriate error code (see #LY_ERR).
+ */
+struct lyd_node *lyd_chunk_parser_finish(struct lyd_chunk_parser *parser);
+
+/**
+ * @brief Free a parser without finishing the parsing.
+ *
+ * @param[in] parser Parser created with lyd_chunk_parser_new().
+ */
+void lyd_chunk_parser_free(struct lyd_chunk_parser *parser);
+
+/**
+ * @brief Opaque context of a parser of a stream of separate data documents.
+ */
+struct lyd_stream_parser;
+
+/**
+ * @brief Create a parser (and validator) for a sequence of separate data documents in memory, for example
+ * notifications, each parsed into its own data tree.
+ *
+ * In case of LY_XML format, every top-level element is a separate document. In case of LY_JSON format, the documents
+ * are separated by whitespace, typically a newline (NDJSON), or by RS characters (JSON text sequences, RFC 7464).
+ * The options are checked only once and the parser buffer is reused for all the documents.
+ *
+ * @param[in] ctx Context to connect with the data trees being built.
+ * @param[in] data Documents in the specified format, they must not be changed nor freed while the parser is used.
+ * @param[in] format Format of the input data to be parsed, only LYD_XML and LYD_JSON are supported.
+ * @param[in] options Parser options, see @ref parseroptions, as for lyd_parse_mem(), #LYD_OPT_NOSIBLINGS is ignored.
+ * @param[in] ... Variable arguments depend on \p options, see lyd_parse_mem(). The passed data trees
+ *                must not be changed nor freed while the parser is used.
+ * @return Created parser, NULL on error.
+ */
+struct lyd_stream_parser *lyd_stream_parser_mem(struct ly_ctx *ctx, const char *data, LYD_FORMAT format, int options, ...);
+
+/**
+ * @brief Create a parser (and validator) for a sequence of separate data documents read from a file descriptor,
+ * see lyd_stream_parser_mem().
+ *
+ * Unlike lyd_parse_fd(), any file descriptor can be used, including pipes and sockets. The data are read only
+ * when the next document is needed.
+ *
+ * @param[in] ctx Context to connect with the data trees being built.
+ * @param[in] fd File descriptor to read the documents from, it is not closed by the parser.
+ * @param[in] format Format of the input data to be parsed, only LYD_XML and LYD_JSON are supported.
+ * @param[in] options Parser options, see @ref parseroptions, as for lyd_parse_mem(), #LYD_OPT_NOSIBLINGS is ignored.
+ * @param[in] ... Variable arguments depend on \p options, see lyd_parse_mem(). The passed data trees
+ *                must not be changed nor freed while the parser is used.
+ * @return Created parser, NULL on error.
+ */
+struct lyd_stream_parser *lyd_stream_parser_fd(struct ly_ctx *ctx, int fd, LYD_FORMAT format, int options, ...);
+
+/**
+ * @brief Parse (and validate) the next document of a stream.
+ *
+ * A document that fails to be parsed or validated is skipped and the following call continues with the next
+ * document. Only failing to read the data or an XML that is not well-formed make all the following calls fail.
+ *
+ * @param[in] stream Parser created with lyd_stream_parser_mem() or lyd_stream_parser_fd().
+ * @param[out] node Built data tree of the document, NULL in case of an empty document or an error. To free it,
+ *             use lyd_free_withsiblings().
+ * @return 1 if a document was parsed, 0 if there are no more documents, -1 on error with #ly_errno set.
+ */
+int lyd_stream_parser_next(struct lyd_stream_parser *stream, struct lyd_node **node);
+
+/**
+ * @brief Free a stream parser.
+ *
+ * @param[in] stream Parser created with lyd_stream_parser_mem() or lyd_stream_parser_fd().
+ */
+void lyd_stream_parser_free(struct lyd_stream_parser *stream);
+
 /**
  * @brief Parse (and validate) XML tree.
  *
@@ -753,6 +1055,24 @@ struct lyd_node *lyd_new_leaf(struct lyd_node *parent, const struct lys_module *
  */
 int lyd_change_leaf(struct lyd_node_leaf_list *leaf, const char *val_str);
 
+/**
+ * @brief Change value of a leaf node of a numeric, boolean or enumeration type to a typed value, without
+ * parsing any string.
+ *
+ * __PARTIAL CHANGE__ - validate after the final change on the data tree (see @ref howtodatamanipulators).
+ *
+ * Same as lyd_change_leaf(), but an unchanged value is detected without any string work and only the canonical
+ * string of a changed value is generated. Keys and leaves of user types are not supported.
+ *
+ * @param[in] leaf A leaf node to change.
+ * @param[in] value New value of the C type of the leaf type base: int8_t for #LY_TYPE_BOOL, the int32_t enum value
+ * for #LY_TYPE_ENUM, the raw int64_t for #LY_TYPE_DEC64 (see ::lyd_val) and the matching integer type otherwise.
+ * @return 0 if the leaf was changed successfully (either its value changed or at least its default flag was cleared),
+ *         <0 on error,
+ *         1 if the value matched the original one and no value neither default flag change occurred.
+ */
+int lyd_change_leaf_value(struct lyd_node_leaf_list *leaf, const void *value);
+
 /**
  * @brief Create a new anydata or anyxml node in a data tree.
  *
@@ -895,6 +1215,46 @@ struct lyd_node *lyd_new_yangdata(const struct lys_module *module, const char *n
 struct lyd_node *lyd_new_path(struct lyd_node *data_tree, const struct ly_ctx *ctx, const char *path, void *value,
                               LYD_ANYDATA_VALUETYPE value_type, int options);
 
+/**
+ * @brief Cursor of lyd_new_path_cursor() remembering the parent of the last created node.
+ *
+ * Zero it before the first use and free its memory with lyd_path_cursor_clear().
+ */
+struct lyd_path_cursor {
+    struct lyd_node *parent;         /**< data node the path prefix points to, NULL if not known */
+    char *prefix;                    /**< path prefix (without the last node) of the last created node */
+    int prefix_len;                  /**< length of the path prefix */
+};
+
+/**
+ * @brief Create a new data node based on a simple XPath the same way as lyd_new_path(), but remember its parent.
+ *
+ * If the next \p path differs from the previous one only in its last node (including predicates), for example
+ * when creating many instances of a list, the parent is not searched for again and the node is directly created
+ * in it, so the time spent does not grow with the depth of the path and with the number of the parent siblings.
+ *
+ * The cursor must be cleared by lyd_path_cursor_clear() if the remembered parent node is freed or if it is
+ * moved to another place in the data tree.
+ *
+ * @param[in,out] cursor Path creation cursor.
+ * @param[in] data_tree Existing data tree to add to/modify, see lyd_new_path().
+ * @param[in] ctx Context to use, see lyd_new_path().
+ * @param[in] path Simple data path, see lyd_new_path().
+ * @param[in] value Value of the new leaf/leaf-list or anydata, see lyd_new_path().
+ * @param[in] value_type Type of the provided \p value parameter, see lyd_new_path().
+ * @param[in] options Bitmask of options flags, see @ref pathoptions.
+ * @return Same as lyd_new_path().
+ */
+struct lyd_node *lyd_new_path_cursor(struct lyd_path_cursor *cursor, struct lyd_node *data_tree, const struct ly_ctx *ctx,
+                                     const char *path, void *value, LYD_ANYDATA_VALUETYPE value_type, int options);
+
+/**
+ * @brief Forget the parent remembered by a path creation cursor and free its memory.
+ *
+ * @param[in] cursor Path creation cursor to clear, it can be used again afterwards.
+ */
+void lyd_path_cursor_clear(struct lyd_path_cursor *cursor);
+
 /**
  * @brief Learn the relative instance position of a list or leaf-list within other instances of the
  * same schema node.
@@ -986,7 +1346,9 @@ struct lyd_node *lyd_dup_to_ctx(const struct lyd_node *node, int options, struct
  * @param[in] target Top-level (or an RPC output child) data tree to merge to. Must be valid.
  * @param[in] source Data tree to merge \p target with. Must be valid (at least as a subtree).
  * @param[in] options Bitmask of the following option flags:
- * - #LYD_OPT_DESTRUCT - spend \p source in the function, otherwise \p source is left untouched,
+ * - #LYD_OPT_DESTRUCT - spend \p source in the function, otherwise \p source is left untouched.
+ * The source subtrees missing in \p target are then relinked into it and the values moved into
+ * the existing nodes instead of being duplicated,
  * - #LYD_OPT_NOSIBLINGS - merge only the \p source subtree (ignore siblings), otherwise merge
  * \p source and all its succeeding siblings (preceding ones are still ignored!),
  * - #LYD_OPT_EXPLICIT - when merging an explicitly set node and a default node, always put
@@ -1017,6 +1379,241 @@ int lyd_merge(struct lyd_node *target, const struct lyd_node *source, int option
  */
 int lyd_merge_to_ctx(struct lyd_node **trg, const struct lyd_node *src, int options, struct ly_ctx *ctx);
 
+/**
+ * @brief Merge several source data trees into a single target data tree, same as calling lyd_merge() with
+ * #LYD_OPT_DESTRUCT for each of them.
+ *
+ * __PARTIAL CHANGE__ - validate after the final change on the data tree (see @ref howtodatamanipulators).
+ *
+ * Meant for many small trees (such as edits) merged into a large \p target. The top-level siblings of \p target
+ * are indexed only once for all the merges and the temporary marks of the matched state list instances are cleared
+ * only once afterwards. The sources in the context of \p target are relinked into it without duplication.
+ *
+ * @param[in] target Top-level (or an RPC output child) data tree to merge to. Must be valid.
+ * @param[in] sources Array of the data trees to merge into \p target in the given order. Must be valid (at least as
+ *            subtrees). All of them are spent, even in case of an error, and the array items set to NULL. NULL items
+ *            are skipped.
+ * @param[in] count Number of items in \p sources.
+ * @param[in] options Bitmask of the #LYD_OPT_NOSIBLINGS and #LYD_OPT_EXPLICIT flags with the same meaning as for
+ *            lyd_merge(), applied to each of \p sources.
+ * @return 0 on success, nonzero in case of an error.
+ */
+int lyd_merge_bulk(struct lyd_node *target, struct lyd_node **sources, unsigned int count, int options);
+
+/**
+ * @defgroup editoptions Edit options
+ * @ingroup datatree
+ *
+ * Default operation of lyd_edit_apply() for the edit nodes without the operation attribute, as the NETCONF
+ * \<edit-config\> default-operation parameter. Without any of these flags, the default operation is merge.
+ *
+ * @{
+ */
+#define LYD_EDITOPT_REPLACE 0x01 /**< The edit replaces the whole configuration in the data tree, top-level nodes
+                                      missing in the edit are deleted. */
+#define LYD_EDITOPT_NONE    0x02 /**< Only the nodes with an operation attribute (and their descendants) are applied,
+                                      the other nodes only select the nodes to apply them to. */
+/** @} editoptions */
+
+/**
+ * @brief Apply a NETCONF \<edit-config\> content to a data tree in a single pass.
+ *
+ * __PARTIAL CHANGE__ - validate after the final change on the data tree (see @ref howtodatamanipulators).
+ *
+ * The edit operations (merge, replace, create, delete and remove) are taken from the ietf-netconf operation
+ * attributes of the \p edit nodes and inherited by their descendants, the user-ordered instances are placed according
+ * to the insert, value and key attributes. The data tree nodes are matched using their hashes and the \p edit
+ * subtrees are duplicated into the data tree without the attributes, \p edit itself is not changed.
+ *
+ * The changes are passed to \p clb with the same meaning as the lyd_diff() items, with the data tree nodes as
+ * the first nodes: #LYD_DIFF_DELETED and #LYD_DIFF_CHANGED (with the \p edit leaf or anydata node as the second
+ * node) before the node is freed or changed, #LYD_DIFF_CREATED (with the parent or NULL as the first and the created
+ * subtree root as the second node) and #LYD_DIFF_MOVEDAFTER1 after the change. Only the root of a created subtree
+ * is passed.
+ *
+ * @param[in,out] root Data tree (datastore) to edit, can point to NULL for an empty tree. The pointer is updated
+ *            if the first top-level node changes.
+ * @param[in] edit Edit data tree, usually parsed with #LYD_OPT_EDIT, from the same context as \p root.
+ * @param[in] options The @ref editoptions are accepted.
+ * @param[in] clb Optional callback to get the applied changes, a non-zero return value stops applying the edit.
+ * @param[in] user_data Arbitrary user data passed to \p clb.
+ * @return EXIT_SUCCESS on success, EXIT_FAILURE on error (such as existing data to create or missing data to delete)
+ *         or when stopped by \p clb. The data tree is then left partially edited.
+ */
+int lyd_edit_apply(struct lyd_node **root, struct lyd_node *edit, int options, lyd_diff_clb clb, void *user_data);
+
+/**
+ * @defgroup nacmaccess NACM access operations
+ * @ingroup datatree
+ *
+ * Access operations of the NETCONF Access Control Model (RFC 8341) rules.
+ *
+ * @{
+ */
+#define LYD_NACM_CREATE 0x01 /**< create a new data node */
+#define LYD_NACM_READ   0x02 /**< read a data node or receive a notification */
+#define LYD_NACM_UPDATE 0x04 /**< change the value of an existing data node */
+#define LYD_NACM_DELETE 0x08 /**< delete a data node */
+#define LYD_NACM_EXEC   0x10 /**< invoke an RPC or action */
+/** @} nacmaccess */
+
+/**
+ * @brief Opaque structure of the NACM rules compiled for a user, see lyd_nacm_new().
+ */
+struct lyd_nacm;
+
+/**
+ * @brief Compile the NACM configuration for a user.
+ *
+ * The rules of the rule-lists applicable to the user groups are compiled in their order, the paths of the
+ * data-node rules are resolved to their schema nodes and the ones with predicates are prepared as XPath
+ * expressions to be evaluated on the checked data trees. The decision for each schema node is evaluated
+ * once, on its first use, and then only the rules with predicates are evaluated for the data instances.
+ * The NACM default-deny-write and default-deny-all extension instances in the schemas are respected.
+ *
+ * The compiled rules reflect the configuration and the context at the moment of the call, the structure
+ * must be created again after a change of the configuration or the context modules. It can be used by
+ * one thread at a time.
+ *
+ * @param[in] nacm_data Data tree with the ietf-netconf-acm nacm container among its top-level siblings.
+ * @param[in] user Name of the user, NULL for a user with no groups.
+ * @param[in] groups Optional NULL-terminated array of the user groups obtained from outside of the NACM
+ * configuration, used if enable-external-groups is true.
+ * @return Compiled NACM rules to be freed by lyd_nacm_free(), NULL on error.
+ */
+struct lyd_nacm *lyd_nacm_new(const struct lyd_node *nacm_data, const char *user, const char **groups);
+
+/**
+ * @brief Free the compiled NACM rules.
+ *
+ * @param[in] nacm Compiled NACM rules to free.
+ */
+void lyd_nacm_free(struct lyd_nacm *nacm);
+
+/**
+ * @brief Decide the access to a single data node.
+ *
+ * @param[in] nacm Compiled NACM rules.
+ * @param[in] node Data node to access.
+ * @param[in] access One of the @ref nacmaccess.
+ * @return 1 if the access is permitted, 0 if denied, -1 on error.
+ */
+int lyd_nacm_allowed(struct lyd_nacm *nacm, const struct lyd_node *node, int access);
+
+/**
+ * @brief Remove all the data nodes not permitted to read from a data tree in a single pass.
+ *
+ * The whole subtree of a node not permitted to read is removed, as well as the whole list instance
+ * if any of its keys is not permitted to read.
+ *
+ * @param[in] nacm Compiled NACM rules.
+ * @param[in,out] tree Data tree to filter, the pointer is updated if the first top-level node is removed
+ * and can point to NULL afterwards.
+ * @return 0 on success, -1 on error.
+ */
+int lyd_nacm_filter(struct lyd_nacm *nacm, struct lyd_node **tree);
+
+/**
+ * @brief Check the access required by an edit, RPC, action or notification in a single pass.
+ *
+ * For an RPC or action, the exec access to the operation node is checked and for a notification, the read access.
+ * For an edit, the access of each edit node is derived from its ietf-netconf operation attribute (inherited by
+ * the descendants) and from its instance in \p data: create or merge and replace of a missing node require create,
+ * merge and replace of an existing leaf with a different value or of an anydata node require update, delete and
+ * remove require delete of the node and of all its existing descendants, and so do the nodes implicitly deleted
+ * by replace. The list keys are covered by their list.
+ *
+ * @param[in] nacm Compiled NACM rules.
+ * @param[in] tree Edit data tree, usually parsed with #LYD_OPT_EDIT, or an RPC, action or notification tree.
+ * @param[in] data Optional current data tree (datastore) the edit is to be applied to. Without it,
+ * all the edit nodes are considered to be missing in the datastore.
+ * @param[in] options The @ref editoptions are accepted, as the default operation of the edit.
+ * @param[out] denied Optional first node whose access was denied.
+ * @return 0 if all the access is permitted, 1 if denied, -1 on error.
+ */
+int lyd_nacm_check(struct lyd_nacm *nacm, const struct lyd_node *tree, const struct lyd_node *data, int options,
+                   const struct lyd_node **denied);
+
+/**
+ * @brief Opaque structure of the subscription filters of many subscribers, see lyd_filter_new().
+ */
+struct lyd_filter;
+
+/**
+ * @brief Create an empty set of subscription filters.
+ *
+ * The filters are meant to be evaluated on every notification (or any data tree) to find the subscribers
+ * it is to be sent to. The same filters of different subscribers are evaluated only once and the filters
+ * that can only select instances of particular top-level nodes (location paths starting with the node, or
+ * their unions) are evaluated only on the trees with such nodes. The set can be used by one thread at a time.
+ *
+ * @param[in] ctx Context of the filters and the evaluated trees.
+ * @return Empty set of filters to be freed by lyd_filter_free(), NULL on error.
+ */
+struct lyd_filter *lyd_filter_new(struct ly_ctx *ctx);
+
+/**
+ * @brief Free a set of subscription filters.
+ *
+ * @param[in] filter Filters to free.
+ */
+void lyd_filter_free(struct lyd_filter *filter);
+
+/**
+ * @brief Add an XPath filter of a subscriber.
+ *
+ * @param[in] filter Set of the filters.
+ * @param[in] module Module of the unprefixed nodes in \p xpath.
+ * @param[in] xpath Filter as an XPath expression in the JSON format, see lyd_find_path(). It matches a tree
+ * if its result is a non-empty node-set or converts to boolean true.
+ * @param[in] id Identifier of the subscriber, any subscriber can have more filters.
+ * @return EXIT_SUCCESS or EXIT_FAILURE.
+ */
+int lyd_filter_add(struct lyd_filter *filter, const struct lys_module *module, const char *xpath, uint32_t id);
+
+/**
+ * @brief Add a subtree filter (RFC 6241 section 6) of a subscriber.
+ *
+ * The filter is transformed into the union of the location paths of all its selection nodes, with the content
+ * match nodes as their predicates. Attribute match expressions are not supported.
+ *
+ * @param[in] filter Set of the filters.
+ * @param[in] subtree Subtree filter as a data tree (for example parsed with #LYD_OPT_GET), the leaves with
+ * a value are the content match nodes.
+ * @param[in] id Identifier of the subscriber, any subscriber can have more filters.
+ * @return EXIT_SUCCESS or EXIT_FAILURE.
+ */
+int lyd_filter_add_subtree(struct lyd_filter *filter, const struct lyd_node *subtree, uint32_t id);
+
+/**
+ * @brief Find the subscribers with a filter matching a tree.
+ *
+ * @param[in] filter Set of the filters.
+ * @param[in] tree Notification (or any data tree) to evaluate the filters on, the whole tree is used.
+ * @param[out] ids Sorted identifiers of the subscribers with a matching filter, each once, to be freed by the caller.
+ * @param[out] count Number of \p ids.
+ * @return EXIT_SUCCESS or EXIT_FAILURE.
+ */
+int lyd_filter_match(const struct lyd_filter *filter, const struct lyd_node *tree, uint32_t **ids, uint32_t *count);
+
+/**
+ * @brief Apply a subtree filter (RFC 6241 section 6) on a data tree.
+ *
+ * The filter and the data are traversed together level by level, no XPath expressions are created. The selected
+ * nodes are duplicated into a new tree, the ancestors of the selected nodes with their list keys are included.
+ * The result of several filter nodes selecting the same data is their union. Attribute match expressions
+ * are not supported.
+ *
+ * @param[in] data Any node of the data tree to filter, all the top-level siblings are used.
+ * @param[in] filter Any element of the subtree filter as an XML tree (for example parsed by lyxml_parse_mem() with
+ * #LYXML_PARSE_MULTIROOT), so the selection nodes of leaves of any type can be empty. The elements with only a text
+ * content are the content match nodes, their content is compared with the canonical values of the leaves.
+ * The elements without a namespace match the nodes of any module.
+ * @param[out] result First top-level sibling of the filtered tree, NULL if nothing was selected.
+ * @return EXIT_SUCCESS or EXIT_FAILURE.
+ */
+int lyd_subtree_filter(const struct lyd_node *data, const struct lyxml_elem *filter, struct lyd_node **result);
+
 #define LYD_OPT_EXPLICIT 0x0100
 
 /**
@@ -1080,6 +1677,47 @@ int lyd_insert(struct lyd_node *parent, struct lyd_node *node);
  */
 int lyd_insert_sibling(struct lyd_node **sibling, struct lyd_node *node);
 
+/**
+ * @brief Prepare a node for having the specified number of children inserted.
+ *
+ * The internal hash table of the children is sized at once instead of being resized repeatedly
+ * while the children are being inserted. It is only an optimization, any number of children
+ * can be inserted afterwards. Has no effect if libyang is compiled without the cache.
+ *
+ * @param[in] parent Parent node that can have children.
+ * @param[in] count Expected number of children of \p parent.
+ * @return EXIT_SUCCESS on success, EXIT_FAILURE on error.
+ */
+int lyd_reserve_children(struct lyd_node *parent, uint32_t count);
+
+/**
+ * @brief Start inserting a batch of children into a node.
+ *
+ * Until lyd_insert_batch_commit() is called, every new node (or a list of top-level siblings) inserted into
+ * \p parent by lyd_insert() or by the lyd_new*() functions in the same thread is only appended to a pending
+ * list. The pending nodes are not found among the \p parent children yet and they must not be unlinked or freed.
+ * On commit, all of them are inserted at once as if by a single lyd_insert() call, so the hash table of the
+ * children is sized once and the default and duplicate instances are resolved once for every leaf-list.
+ * Inserting any other node into \p parent first commits the pending nodes to keep their order.
+ *
+ * Only one batch can be in progress in a thread.
+ *
+ * @param[in] parent Parent node that can have children.
+ * @return EXIT_SUCCESS on success, EXIT_FAILURE on error.
+ */
+int lyd_insert_batch_start(struct lyd_node *parent);
+
+/**
+ * @brief Insert all the pending children of a batch started by lyd_insert_batch_start() and end the batch.
+ *
+ * The batch is ended even if the insertion fails, the pending nodes are then left unlinked and it is up
+ * to the caller to free them.
+ *
+ * @param[in] parent Parent node of the batch.
+ * @return EXIT_SUCCESS on success, EXIT_FAILURE on error.
+ */
+int lyd_insert_batch_commit(struct lyd_node *parent);
+
 /**
  * @brief Insert the \p node element after the \p sibling element. If \p node and \p siblings are already
  * siblings (just moving \p node position).
@@ -1145,6 +1783,41 @@ int lyd_schema_sort(struct lyd_node *sibling, int recursive);
  */
 struct ly_set *lyd_find_path(const struct lyd_node *ctx_node, const char *path);
 
+/**
+ * @brief Opaque structure of a prepared data path, see lyd_path_prepare().
+ */
+struct lyd_path;
+
+/**
+ * @brief Prepare a data path for repeated searching with lyd_find_path_prepared().
+ *
+ * The path is transformed and compiled only once so that its repeated evaluation
+ * is cheaper than calling lyd_find_path() every time. The prepared path can be used
+ * with any data tree of the context of \p module, until the module is removed.
+ *
+ * @param[in] module Module of the path context nodes, unprefixed nodes in \p path belong to it.
+ * @param[in] path Data path expression, the same as for lyd_find_path().
+ * @return Prepared path to be freed by lyd_path_free(), NULL on error or if \p path can never match
+ * a node of \p module.
+ */
+struct lyd_path *lyd_path_prepare(const struct lys_module *module, const char *path);
+
+/**
+ * @brief Search in the given data for instances of nodes matching the prepared path.
+ *
+ * @param[in] ctx_node Path context node, it should belong to the module the path was prepared with.
+ * @param[in] path Prepared data path.
+ * @return Set of found data nodes, the same as for lyd_find_path().
+ */
+struct ly_set *lyd_find_path_prepared(const struct lyd_node *ctx_node, const struct lyd_path *path);
+
+/**
+ * @brief Free a prepared data path.
+ *
+ * @param[in] path Prepared data path to free.
+ */
+void lyd_path_free(struct lyd_path *path);
+
 /**
  * @brief Search in the given data for instances of the provided schema node.
  *
@@ -1157,6 +1830,173 @@ struct ly_set *lyd_find_path(const struct lyd_node *ctx_node, const char *path);
  */
 struct ly_set *lyd_find_instance(const struct lyd_node *data, const struct lys_node *schema);
 
+/**
+ * @brief Values of all the instances of a leaf or leaf-list, see lyd_leaf_values().
+ *
+ * All the arrays have \p count items, item i of every array describes the same instance.
+ */
+struct lyd_leaf_values {
+    unsigned int count;              /**< number of the instances */
+    lyd_val *values;                 /**< typed values of the instances, leafref values are those of their targets */
+    const char **strs;               /**< canonical string values of the instances (value_str) */
+    LY_DATA_TYPE *types;             /**< types of the values (the actual member type for unions, the target type
+                                          for resolved leafrefs) */
+    const struct lyd_node_leaf_list **nodes; /**< the instances themselves */
+};
+
+/**
+ * @brief Extract the values of all the instances of a leaf or leaf-list in one call.
+ *
+ * Meant for bulk exports (and the bindings), which would otherwise need to find the instances and
+ * read their values one by one. The values are stored into arrays allocated all at once, the strings
+ * and the pointers in the values are owned by the data tree and valid only until it is changed.
+ *
+ * @param[in] data A node in the data tree to search, all the sibling trees are searched as in lyd_find_instance().
+ * @param[in] schema_path JSON data path of the leaf or leaf-list schema node without any predicates,
+ * see ly_ctx_get_node().
+ * @param[out] values Filled structure, to be cleaned by lyd_leaf_values_clean(). Nothing is allocated
+ * without any instance.
+ * @return EXIT_SUCCESS or EXIT_FAILURE.
+ */
+int lyd_leaf_values(const struct lyd_node *data, const char *schema_path, struct lyd_leaf_values *values);
+
+/**
+ * @brief Free the arrays filled by lyd_leaf_values().
+ *
+ * @param[in] values Structure to clean, it can be reused afterwards.
+ */
+void lyd_leaf_values_clean(struct lyd_leaf_values *values);
+
+/**
+ * @brief A column of the list instances, see lyd_list_columns().
+ *
+ * The layout follows the Apache Arrow columnar format so that the buffers can be handed over
+ * to its consumers without conversion.
+ */
+struct lyd_column {
+    const struct lys_node_leaf *schema; /**< leaf of the column */
+    LY_DATA_TYPE type;               /**< type of the column, #LY_TYPE_STRING for all the values stored as strings */
+    uint8_t width;                   /**< size of an item of \p values in bytes, 0 for string columns */
+    uint8_t *validity;               /**< bitmap of the rows with the leaf (least significant bit first) */
+    void *values;                    /**< fixed-width columns (integers, #LY_TYPE_BOOL as int8_t and #LY_TYPE_DEC64
+                                          as the raw int64_t), undefined items of the missing leaves */
+    uint32_t *offsets;               /**< string columns, the value of row i is <tt>data[offsets[i]]</tt> up to
+                                          <tt>data[offsets[i + 1]]</tt>, not terminated */
+    char *data;                      /**< string columns, all the canonical values concatenated */
+};
+
+/**
+ * @brief Columns of all the instances of a list, see lyd_list_columns().
+ */
+struct lyd_columns {
+    unsigned int rows;               /**< number of the list instances */
+    unsigned int count;              /**< number of the \p columns */
+    struct lyd_column *columns;      /**< the columns, keys first */
+};
+
+/**
+ * @brief Convert all the instances of a list into columns.
+ *
+ * Every column is a leaf child of the list, integers, booleans and decimal64 values (including leafrefs
+ * to them) are copied from the value of the leaves into typed arrays, all the other values are stored
+ * as their canonical strings.
+ *
+ * @param[in] data A node in the data tree to search, all the sibling trees are searched as in lyd_find_instance().
+ * @param[in] list_path JSON data path of the list schema node without any predicates, see ly_ctx_get_node().
+ * @param[in] leaves NULL-terminated array of the names of the leaf children of the list to convert besides
+ * its keys, NULL for all the leaf children.
+ * @param[out] columns Filled columns, to be cleaned by lyd_list_columns_clean().
+ * @return EXIT_SUCCESS or EXIT_FAILURE.
+ */
+int lyd_list_columns(const struct lyd_node *data, const char *list_path, const char **leaves, struct lyd_columns *columns);
+
+/**
+ * @brief Free the columns filled by lyd_list_columns().
+ *
+ * @param[in] columns Columns to clean, the structure can be reused afterwards.
+ */
+void lyd_list_columns_clean(struct lyd_columns *columns);
+
+/**
+ * @brief Create all the instances of a list from columns, the inverse of lyd_list_columns().
+ *
+ * The values of the fixed-width columns are stored into the leaves directly, only their canonical strings are
+ * generated, the values of the string columns are parsed as usual. The instances are inserted into \p parent at once.
+ *
+ * @param[in] parent Parent of the instances, NULL for top-level instances.
+ * @param[in] schema Schema node of the list.
+ * @param[in] columns Columns of leaf children of \p schema, including all its keys, which must be valid in every row.
+ * \p type and \p width of the columns must be the same as lyd_list_columns() would fill.
+ * @return The first created instance (with the rest as its siblings if \p parent is NULL), NULL if there are
+ * no rows or on error.
+ */
+struct lyd_node *lyd_new_list_columns(struct lyd_node *parent, const struct lys_node *schema,
+                                      const struct lyd_columns *columns);
+
+/**
+ * @brief Search the siblings for an instance of a schema node with the given key or leaf-list values.
+ *
+ * In contrast to lyd_find_path(), no path is printed and evaluated, the internal hash table
+ * of the parent children is used directly if libyang is compiled with the cache. Instances of lists
+ * without keys are not distinguished, the first one is returned for them.
+ *
+ * @param[in] siblings Any of the siblings to search.
+ * @param[in] schema Schema node of the searched instance, a container, leaf, leaf-list, list or anydata.
+ * @param[in] values Values of all the keys of a list in the order of their definition or a single value of
+ * a leaf-list, as they are stored in the value_str member of their data nodes (canonical, identityrefs
+ * with the module name). Ignored (can be NULL) for other nodes.
+ * @return Found instance, NULL if there is none or on error.
+ */
+struct lyd_node *lyd_find_sibling_val(const struct lyd_node *siblings, const struct lys_node *schema, const char **values);
+
+/**
+ * @brief Cursor over the instances of a list or a leaf-list, in their data order.
+ */
+struct lyd_list_cursor {
+    const struct lys_node *schema;  /**< schema node of the instances */
+    const struct lyd_node *next;    /**< next instance to be returned, NULL at the end */
+};
+
+/**
+ * @brief Initialize a cursor over the instances of a list or a leaf-list among siblings.
+ *
+ * No set of the instances is created, the cursor follows the sibling links. A cursor stays valid only
+ * as long as its next instance is not freed.
+ *
+ * @param[in] cursor Cursor to initialize.
+ * @param[in] siblings Any of the siblings with the instances, NULL for no instances.
+ * @param[in] schema Schema node of the list or the leaf-list.
+ * @param[in] after Resume after the instance with these key values or a leaf-list value (see
+ * lyd_find_sibling_val(), found in the hash table), NULL to start with the first instance.
+ * @return EXIT_SUCCESS or EXIT_FAILURE, also if the instance to resume after does not exist.
+ */
+int lyd_list_cursor_init(struct lyd_list_cursor *cursor, const struct lyd_node *siblings, const struct lys_node *schema,
+                         const char **after);
+
+/**
+ * @brief Get the next instance of a cursor and move it forward.
+ *
+ * @param[in] cursor Initialized cursor.
+ * @return Next instance, NULL at the end.
+ */
+const struct lyd_node *lyd_list_cursor_next(struct lyd_list_cursor *cursor);
+
+/**
+ * @brief Print the next page of the instances of a cursor and move it past them.
+ *
+ * The instances are printed as siblings (#LYP_WITHSIBLINGS is implied), only they are duplicated for it.
+ * The key values of the last printed instance can be used to resume with lyd_list_cursor_init().
+ *
+ * @param[out] strp Pointer to store the resulting dump, NULL (or empty) if there were no more instances.
+ * @param[in] cursor Initialized cursor.
+ * @param[in] count Maximum number of the instances on the page, 0 for all the remaining ones.
+ * @param[in] format Data output format.
+ * @param[in] options [printer flags](@ref printerflags).
+ * @return EXIT_SUCCESS or EXIT_FAILURE.
+ */
+int lyd_list_cursor_print_mem(char **strp, struct lyd_list_cursor *cursor, uint32_t count, LYD_FORMAT format,
+                              int options);
+
 /**
  * @brief Get the first sibling of the given node.
  *
@@ -1191,11 +2031,16 @@ struct lyd_node *lyd_first_sibling(struct lyd_node *node);
  *                is expected into which all data node changes performed by the validation will be stored.
  *                Needs to be properly freed. Meaning of diff type is following:
  *                   - LYD_DIFF_CREATED:
- *                      - first - Path identifying the parent node (format of lyd_path()).
- *                      - second - Duplicated subtree of the created nodes.
+ *                      - first - Path identifying the parent node (format of lyd_path()), with
+ *                        #LYD_OPT_VAL_DIFF_NODUP the parent node itself.
+ *                      - second - Duplicated subtree of the created nodes, with #LYD_OPT_VAL_DIFF_NODUP the created
+ *                        subtree in the validated tree.
  *                   - LYD_DIFF_DELETED:
  *                      - first - Unlinked subtree of the deleted nodes.
  *                      - second - Path identifying the original parent (format of lyd_path()).
+ *                If options include #LYD_OPT_VAL_ALL, a (struct lyd_val_err **) follows (after the diff, if any)
+ *                into which the array of all the validation errors is stored, NULL if there are none. Needs to be
+ *                freed with free().
  * @return 0 on success, nonzero in case of an error.
  */
 int lyd_validate(struct lyd_node **node, int options, void *var_arg, ...);
@@ -1215,17 +2060,53 @@ int lyd_validate(struct lyd_node **node, int options, void *var_arg, ...);
  *                is expected into which all data node changes performed by the validation will be stored.
  *                Needs to be properly freed. Meaning of diff type is following:
  *                   - LYD_DIFF_CREATED:
- *                      - first - Path identifying the parent node (format of lyd_path()).
- *                      - second - Duplicated subtree of the created nodes.
+ *                      - first - Path identifying the parent node (format of lyd_path()), with
+ *                        #LYD_OPT_VAL_DIFF_NODUP the parent node itself.
+ *                      - second - Duplicated subtree of the created nodes, with #LYD_OPT_VAL_DIFF_NODUP the created
+ *                        subtree in the validated tree.
  *                   - LYD_DIFF_DELETED:
  *                      - first - Unlinked subtree of the deleted nodes.
  *                      - second - Path identifying the original parent (format of lyd_path()).
+ *                If options include #LYD_OPT_VAL_ALL, a (struct lyd_val_err **) follows (after the diff, if any)
+ *                into which the array of all the validation errors is stored, NULL if there are none. Needs to be
+ *                freed with free().
  * @return 0 on success, nonzero in case of an error.
  */
 int lyd_validate_modules(struct lyd_node **node, const struct lys_module **modules, int mod_count, int options, ...);
 
 /**
- * @brief Free special diff that was returned by lyd_validate() or lyd_validate_modules().
+ * @brief Evaluate again only the when and must conditions of \p node data tree that may have been affected
+ *        by changes of some data nodes, instead of validating the whole tree. These are the conditions of all
+ *        the nodes in the changed subtrees and those depending on the changed nodes, their descendants, or their
+ *        ancestors (see lys_xpath_dependents()). No other validation is performed, so the tree is expected
+ *        to have been valid before the changes.
+ *
+ * @param[in,out] node Data tree to be validated. In case the \p options includes #LYD_OPT_WHENAUTODEL, libyang
+ *                     can modify the provided tree including the root \p node.
+ * @param[in] changed Set of the created or modified data nodes. For removed nodes, add their parent.
+ * @param[in] options Options for the validation, see @ref parseroptions. Accepted data type values include
+ *                    #LYD_OPT_DATA and #LYD_OPT_CONFIG.
+ * @return 0 on success, nonzero in case of an error.
+ */
+int lyd_validate_xpath_deps(struct lyd_node **node, const struct ly_set *changed, int options);
+
+/**
+ * @brief Prepare \p root data tree and all its following siblings to be read by several threads at once.
+ *
+ * The remaining lazily computed parts of the data are computed, so that the reading functions (lyd_find_path(),
+ * lyd_find_sibling*(), XPath evaluation and the printers) perform no writes into the data tree afterwards.
+ * The tree is expected to be validated before (validation itself modifies the tree) and it must not be modified
+ * by any function while it is being read. The readers need no locking, the shared parts of the context
+ * (dictionary, caches) are synchronized by libyang.
+ *
+ * @param[in] root Data tree to prepare.
+ * @return EXIT_SUCCESS on success, EXIT_FAILURE on error.
+ */
+int lyd_freeze(struct lyd_node *root);
+
+/**
+ * @brief Free special diff that was returned by lyd_validate() or lyd_validate_modules(). The subtrees referenced
+ * with #LYD_OPT_VAL_DIFF_NODUP are left in the validated tree.
  *
  * @param[in] diff Diff to free.
  */
@@ -1247,6 +2128,53 @@ void lyd_free_val_diff(struct lyd_difflist *diff);
  */
 int lyd_validate_value(struct lys_node *node, const char *value);
 
+/**
+ * @brief Reusable checker of the values of a single leaf or leaf-list, opaque for the callers.
+ */
+struct lyd_value_checker;
+
+/**
+ * @brief Create a checker of values of a leaf or leaf-list, an alternative to lyd_validate_value() for checking
+ * many values of the same node.
+ *
+ * The type (and the leafref target) is resolved only once and the values are checked with the same type
+ * restrictions, compiled patterns and canonization as the data being parsed. A valid value requires no allocation
+ * except the dictionary record of a string not yet stored in the context.
+ *
+ * @param[in] node Schema node of the leaf or leaf-list eventually holding the values.
+ * @return Value checker to be freed with lyd_value_checker_free(), NULL on error.
+ */
+struct lyd_value_checker *lyd_value_checker_new(const struct lys_node *node);
+
+/**
+ * @brief Check a string value the same way as lyd_validate_value() and get its canonical form.
+ *
+ * @param[in] checker Value checker.
+ * @param[in] value Value to be checked (NULL is checked as empty string).
+ * @param[out] canonical Optional canonical form of a valid \p value, it is valid until the next check
+ * with \p checker or until it is freed.
+ * @return EXIT_SUCCESS if the \p value conforms to the restrictions, EXIT_FAILURE otherwise.
+ */
+int lyd_value_checker_check(struct lyd_value_checker *checker, const char *value, const char **canonical);
+
+/**
+ * @brief Check an already typed value of a numeric, boolean or enumeration type, without parsing any string.
+ *
+ * @param[in] checker Value checker.
+ * @param[in] value Value of the C type of the type base, the same as for lyd_change_leaf_value().
+ * @param[out] canonical Optional canonical string of a valid \p value, it is valid until the next check
+ * with \p checker or until it is freed.
+ * @return EXIT_SUCCESS if the \p value conforms to the restrictions, EXIT_FAILURE otherwise.
+ */
+int lyd_value_checker_check_typed(struct lyd_value_checker *checker, const void *value, const char **canonical);
+
+/**
+ * @brief Free a value checker.
+ *
+ * @param[in] checker Value checker to free.
+ */
+void lyd_value_checker_free(struct lyd_value_checker *checker);
+
 /**
  * @brief Get know if the node contain (despite implicit or explicit) default value.
  *
@@ -1292,6 +2220,45 @@ void lyd_free(struct lyd_node *node);
  */
 void lyd_free_withsiblings(struct lyd_node *node);
 
+/**
+ * @brief Opaque structure of a data tree transaction, see lyd_txn_start().
+ */
+struct lyd_txn;
+
+/**
+ * @brief Start recording the changes of a data tree so that they can be reverted with lyd_txn_rollback()
+ * at a cost proportional to the changes instead of keeping a complete backup of the tree.
+ *
+ * Recorded are the nodes inserted, moved, unlinked and freed (lyd_insert*(), lyd_new*(), lyd_unlink(),
+ * lyd_free*()) and the leaf values changed (lyd_change_leaf(), lyd_merge*()), including such changes made
+ * by lyd_validate() and other functions. The nodes freed in the tree are actually freed only by lyd_txn_commit().
+ * Only one transaction can be active in a thread and it must be finished in the same thread.
+ *
+ * @param[in] root One of the top-level siblings of the data tree.
+ * @return Transaction, NULL on error.
+ */
+struct lyd_txn *lyd_txn_start(struct lyd_node *root);
+
+/**
+ * @brief Finish a transaction keeping all the changes, the nodes freed in the tree are freed now.
+ *
+ * @param[in] txn Transaction to finish, it is freed.
+ */
+void lyd_txn_commit(struct lyd_txn *txn);
+
+/**
+ * @brief Finish a transaction reverting all the recorded changes.
+ *
+ * The nodes unlinked from the tree are linked back and the nodes inserted into the tree from elsewhere
+ * are freed. The values are restored from their canonical strings, the validation flags of the changed
+ * nodes are left set so the next validation checks them again.
+ *
+ * @param[in] txn Transaction to finish, it is freed.
+ * @return First top-level sibling of the reverted tree (the same as when the transaction was started),
+ * NULL on error (a change failed to be recorded), the tree is then left as with lyd_txn_commit().
+ */
+struct lyd_node *lyd_txn_rollback(struct lyd_txn *txn);
+
 /**
  * @brief Insert attribute into the data node.
  *
@@ -1409,6 +2376,98 @@ int lyd_print_path(const char *path, const struct lyd_node *root, LYD_FORMAT for
 int lyd_print_clb(ssize_t (*writeclb)(void *arg, const void *buf, size_t count), void *arg,
                   const struct lyd_node *root, LYD_FORMAT format, int options);
 
+/**
+ * @brief Opaque context of a data emitter printing data without creating a data tree.
+ */
+struct lyd_emitter;
+
+/**
+ * @brief Create an emitter printing data into a memory buffer.
+ *
+ * The emitted nodes are only checked against the schema (existence, list keys emitted first and in order,
+ * no duplicate instances, all the instances of a list or leaf-list consecutively) and the leaf values are
+ * validated, no data tree is created. The output is the same as printing the corresponding data tree
+ * with #LYP_WITHSIBLINGS.
+ *
+ * @param[out] strp Pointer to store the resulting dump by lyd_emitter_finish().
+ * @param[in] ctx Context with the schemas of the emitted data.
+ * @param[in] format Data output format, only LYD_XML and LYD_JSON are supported.
+ * @param[in] options [printer flags](@ref printerflags), only #LYP_FORMAT is respected.
+ * @return Created emitter, NULL on error.
+ */
+struct lyd_emitter *lyd_emitter_new_mem(char **strp, struct ly_ctx *ctx, LYD_FORMAT format, int options);
+
+/**
+ * @brief Create an emitter printing data into a file descriptor, see lyd_emitter_new_mem().
+ *
+ * @param[in] fd File descriptor where to print the data.
+ * @param[in] ctx Context with the schemas of the emitted data.
+ * @param[in] format Data output format, only LYD_XML and LYD_JSON are supported.
+ * @param[in] options [printer flags](@ref printerflags), only #LYP_FORMAT is respected.
+ * @return Created emitter, NULL on error.
+ */
+struct lyd_emitter *lyd_emitter_new_fd(int fd, struct ly_ctx *ctx, LYD_FORMAT format, int options);
+
+/**
+ * @brief Create an emitter printing data via a callback, see lyd_emitter_new_mem().
+ *
+ * @param[in] writeclb Callback function to write the data (see write(1)).
+ * @param[in] arg Optional caller-specific argument to be passed to the \p writeclb callback.
+ * @param[in] ctx Context with the schemas of the emitted data.
+ * @param[in] format Data output format, only LYD_XML and LYD_JSON are supported.
+ * @param[in] options [printer flags](@ref printerflags), only #LYP_FORMAT is respected.
+ * @return Created emitter, NULL on error.
+ */
+struct lyd_emitter *lyd_emitter_new_clb(ssize_t (*writeclb)(void *arg, const void *buf, size_t count), void *arg,
+                                        struct ly_ctx *ctx, LYD_FORMAT format, int options);
+
+/**
+ * @brief Emit the opening of a container, a list instance, an RPC, an action, or a notification.
+ * Its children are emitted as the following nodes until it is closed by lyd_emit_close().
+ *
+ * @param[in] em Emitter to use.
+ * @param[in] module Module of the node. If NULL, the module of the currently open node is used.
+ * Mandatory for top-level nodes.
+ * @param[in] name Schema name of the node.
+ * @return EXIT_SUCCESS on success, EXIT_FAILURE on error.
+ */
+int lyd_emit_open(struct lyd_emitter *em, const struct lys_module *module, const char *name);
+
+/**
+ * @brief Emit a leaf or a leaf-list instance.
+ *
+ * @param[in] em Emitter to use.
+ * @param[in] module Module of the node. If NULL, the module of the currently open node is used.
+ * Mandatory for top-level nodes.
+ * @param[in] name Schema name of the node.
+ * @param[in] value String form of the value, in JSON format as for lyd_new_leaf(). NULL is the same as "".
+ * @return EXIT_SUCCESS on success, EXIT_FAILURE on error.
+ */
+int lyd_emit_leaf(struct lyd_emitter *em, const struct lys_module *module, const char *name, const char *value);
+
+/**
+ * @brief Close the node last opened by lyd_emit_open().
+ *
+ * @param[in] em Emitter to use.
+ * @return EXIT_SUCCESS on success, EXIT_FAILURE on error.
+ */
+int lyd_emit_close(struct lyd_emitter *em);
+
+/**
+ * @brief Close all the open nodes, complete the output, and free the emitter.
+ *
+ * @param[in] em Emitter to finish, it is always freed.
+ * @return EXIT_SUCCESS on success, EXIT_FAILURE on error (then no memory output is stored).
+ */
+int lyd_emitter_finish(struct lyd_emitter *em);
+
+/**
+ * @brief Free an emitter without completing the output.
+ *
+ * @param[in] em Emitter to free.
+ */
+void lyd_emitter_free(struct lyd_emitter *em);
+
 /**
  * @brief Get the double value of a decimal64 leaf/leaf-list.
  *
@@ -1428,6 +2487,161 @@ double lyd_dec64_to_double(const struct lyd_node *node);
  */
 int lyd_lyb_data_length(const char *data);
 
+/**
+ * @brief Opaque structure for reading top-level subtrees of LYB data on demand.
+ *
+ * Only the data models and the schema nodes of the top-level subtrees are read when the reader is created,
+ * the subtrees themselves are parsed only when requested with lyd_lyb_reader_parse(). Data of a file reader
+ * are memory-mapped so pages of the subtrees never parsed are not even read from the disk.
+ */
+struct lyd_lyb_reader;
+
+/**
+ * @brief Create a lazy reader of LYB data in memory.
+ *
+ * @param[in] ctx Context to connect with the data trees being parsed.
+ * @param[in] data LYB data, must be kept valid until the reader is freed.
+ * @param[in] options Parser options, see @ref parseroptions. Only data tree types are supported and
+ * #LYD_OPT_DATA_ADD_YANGLIB is not allowed.
+ * @return Created reader, NULL on error.
+ */
+struct lyd_lyb_reader *lyd_lyb_reader_mem(struct ly_ctx *ctx, const char *data, int options);
+
+/**
+ * @brief Create a lazy reader of a memory-mapped LYB data file.
+ *
+ * @param[in] ctx Context to connect with the data trees being parsed.
+ * @param[in] path Path to the file with the LYB data.
+ * @param[in] options Parser options, same as for lyd_lyb_reader_mem().
+ * @return Created reader, NULL on error.
+ */
+struct lyd_lyb_reader *lyd_lyb_reader_path(struct ly_ctx *ctx, const char *path, int options);
+
+/**
+ * @brief Get the number of top-level subtrees in the LYB data of a reader.
+ *
+ * @param[in] reader LYB reader.
+ * @return Number of the top-level subtrees, including the unknown ones.
+ */
+uint32_t lyd_lyb_reader_count(const struct lyd_lyb_reader *reader);
+
+/**
+ * @brief Get the schema node of a top-level subtree without parsing it.
+ *
+ * @param[in] reader LYB reader.
+ * @param[in] idx Index of the subtree.
+ * @return Schema node of the subtree, NULL for unknown data or on error.
+ */
+const struct lys_node *lyd_lyb_reader_schema(const struct lyd_lyb_reader *reader, uint32_t idx);
+
+/**
+ * @brief Parse a top-level subtree of a reader.
+ *
+ * The subtree is parsed as if it were the only data in the input so any references in it are resolved only
+ * within the subtree. It can be parsed repeatedly, every call returns a new tree.
+ *
+ * @param[in] reader LYB reader.
+ * @param[in] idx Index of the subtree.
+ * @return Parsed subtree to be freed by the caller, NULL for unknown data or on error.
+ */
+struct lyd_node *lyd_lyb_reader_parse(struct lyd_lyb_reader *reader, uint32_t idx);
+
+/**
+ * @brief Free a LYB reader, the trees parsed by it are not affected.
+ *
+ * @param[in] reader LYB reader to free.
+ */
+void lyd_lyb_reader_free(struct lyd_lyb_reader *reader);
+
+/**
+ * @brief Print the changes of a configuration data tree as LYB journal records.
+ *
+ * Every item of \p diff is printed as a separate record with the affected node, its parents and their keys in the
+ * LYB format (created subtrees are printed whole), so the journal is proportional to the changes, not to the data
+ * tree size. Records printed for subsequent diffs can be simply concatenated and applied by lyd_journal_apply()
+ * or folded into a new snapshot by lyd_journal_compact().
+ *
+ * @param[out] strp Pointer to store the records, NULL if \p diff is empty.
+ * @param[out] len Length of the records in \p strp.
+ * @param[in] diff The lyd_diff() result of the configuration data trees to print.
+ * @return EXIT_SUCCESS on success, EXIT_FAILURE on error.
+ */
+int lyd_journal_print_mem(char **strp, size_t *len, const struct lyd_difflist *diff);
+
+/**
+ * @brief Append the changes of a configuration data tree as LYB journal records to a file,
+ * see lyd_journal_print_mem().
+ *
+ * All the records are written at once so with \p fd opened with O_APPEND, concurrent journal writers
+ * do not mix their records.
+ *
+ * @param[in] fd File descriptor of the journal.
+ * @param[in] diff The lyd_diff() result of the configuration data trees to print.
+ * @return EXIT_SUCCESS on success, EXIT_FAILURE on error.
+ */
+int lyd_journal_print_fd(int fd, const struct lyd_difflist *diff);
+
+/**
+ * @brief Apply LYB journal records to a data tree.
+ *
+ * __PARTIAL CHANGE__ - validate after the final change on the data tree (see @ref howtodatamanipulators).
+ *
+ * The records are applied in their order, the data tree nodes are matched using their hashes.
+ *
+ * @param[in] ctx Context of the data tree and the journal.
+ * @param[in,out] root Data tree to apply the records to, can point to NULL for an empty tree. The pointer is updated
+ *            if the first top-level node changes.
+ * @param[in] data Journal records as printed by lyd_journal_print_mem() or lyd_journal_print_fd().
+ * @param[in] len Length of \p data.
+ * @return EXIT_SUCCESS on success, EXIT_FAILURE on error (such as an invalid or truncated record or a missing node
+ *         to delete). The preceding records are left applied.
+ */
+int lyd_journal_apply(struct ly_ctx *ctx, struct lyd_node **root, const char *data, size_t len);
+
+/**
+ * @brief Fold LYB journal records into a new LYB snapshot of the data tree.
+ *
+ * The new snapshot should be printed into a temporary file replacing both the old snapshot and the journal
+ * only once it is complete.
+ *
+ * @param[in] ctx Context of the data.
+ * @param[in] snapshot Previous LYB snapshot printed with #LYP_WITHSIBLINGS, NULL for an empty data tree.
+ * @param[in] options Parser options of \p snapshot, see @ref parseroptions, #LYD_OPT_CONFIG is expected.
+ * @param[in] journal Journal records to apply to \p snapshot.
+ * @param[in] len Length of \p journal.
+ * @param[in] fd File descriptor to print the new LYB snapshot to.
+ * @return EXIT_SUCCESS on success, EXIT_FAILURE on error.
+ */
+int lyd_journal_compact(struct ly_ctx *ctx, const char *snapshot, int options, const char *journal, size_t len,
+                        int fd);
+
+/**
+ * @brief Memory used by a data tree, see lyd_mem_usage().
+ */
+struct lyd_mem_stats {
+    uint32_t nodes;                  /**< number of the data nodes (including the anydata trees) */
+    uint32_t attrs;                  /**< number of the attributes */
+    size_t node_mem;                 /**< memory of the node structures */
+    size_t value_mem;                /**< memory of the values not stored in the dictionary (bits, anydata values) */
+    size_t attr_mem;                 /**< memory of the attribute structures */
+    size_t ht_mem;                   /**< memory of the hash tables of the children */
+    size_t dict_mem;                 /**< share of the dictionary strings, every string is divided among all its
+                                          references so the shares of all the trees sum up to the dictionary size */
+};
+
+/**
+ * @brief Get the memory used by a data tree.
+ *
+ * The statistics are added to \p stats so they can be summed over several trees. User type values
+ * (stored by a type plugin) are not included.
+ *
+ * @param[in] node Data tree (subtree) to examine.
+ * @param[in] withsiblings Whether to examine also all the following siblings of \p node.
+ * @param[in,out] stats Statistics to add to, must be initialized.
+ * @return EXIT_SUCCESS or EXIT_FAILURE on invalid arguments.
+ */
+int lyd_mem_usage(const struct lyd_node *node, int withsiblings, struct lyd_mem_stats *stats);
+
 #ifdef LY_ENABLED_LYD_PRIV
 
 /**
@@ -51,6 +51,12 @@
  */
 #define LYD_OPT_ACT_NOTIF 0x100
 
+/**
+ * @brief internal validation flag, adding default values and checking mandatory nodes descends only into
+ * the data nodes with #LYD_VAL_SUBTREE set, used by #LYD_OPT_VAL_INCREMENTAL
+ */
+#define LYD_OPT_VAL_CHANGED 0x2000000
+
 /**
  * @brief Internal list of built-in types
  */
@@ -61,7 +67,17 @@ extern struct lys_tpdf *ly_types[LY_DATA_TYPE_COUNT];
  */
 struct lyd_node_pos {
     struct lyd_node *node;
-    uint32_t pos;
+    uint32_t mod_pos;           /* position of the node module in the context */
+    uint32_t pos;               /* position of the node schema among its schema siblings */
+    uint32_t idx;               /* original position of the node, keeps the order of instances */
+};
+
+/**
+ * @brief Prepared data path, see lyd_path_prepare().
+ */
+struct lyd_path {
+    const struct lys_module *module; /* module of the unprefixed nodes, local module of the evaluation */
+    struct lyxp_expr *exp;           /* compiled YANG XPath expression */
 };
 
 /**
@@ -75,14 +91,11 @@ struct lyb_state {
     int size;
     const struct lys_module **models;
     int mod_count;
+    struct lys_ext_instance_complex **annots;   /* LYB_VERSION_ANNOTS only, annotations referenced by the attributes */
+    int annot_count;
     struct ly_ctx *ctx;
-
-    /* LYB printer only */
-    struct {
-        struct lys_node *first_sibling;
-        struct hash_table *ht;
-    } *sib_ht;
-    int sib_ht_count;
+    uint8_t version;    /* LYB format version of the data, LYB_VERSION_* */
+    size_t offset;      /* LYB_VERSION_SIZES and later, number of bytes written or read in the subtrees */
 };
 
 /* struct lyb_state allocation step */
@@ -111,6 +124,55 @@ struct lyb_state {
 /* Need to move this first >> collision number (from 0) to get collision ID hash part */
 #define LYB_HASH_COLLISION_ID 0x80
 
+/* Version of the algorithm used by lyb_hash(), stored in the LYB header (0 - one-at-a-time hash) */
+#define LYB_HASH_VERSION 0x00
+
+/* Bits of the LYB header byte holding the hash algorithm version */
+#define LYB_HEADER_HASH_VERSION_MASK 0x03
+
+/* LYB header flag, the header is followed by the checksum block - CRC32C of the rest of the block and all
+ * the following data, the length of the following data, and lyb_ctx_hash() of the context the data were
+ * validated in (0 if not), each in LYB_CHECKSUM_FIELD_BYTES */
+#define LYB_HEADER_CHECKSUM 0x04
+
+/* How many bytes are reserved for one field of the checksum block */
+#define LYB_CHECKSUM_FIELD_BYTES 4
+
+/* Size of the whole checksum block */
+#define LYB_CHECKSUM_BLOCK_BYTES (3 * LYB_CHECKSUM_FIELD_BYTES)
+
+/* LYB header flag, everything following the header is stored in zlib blocks, each preceded by
+ * its raw and compressed length in LYB_BLOCK_LEN_BYTES, a block with raw length 0 ends them */
+#define LYB_HEADER_COMPRESSED 0x08
+
+/* How many bytes are reserved for a compressed block raw and compressed length */
+#define LYB_BLOCK_LEN_BYTES 4
+
+/* Maximum raw length of a compressed block */
+#define LYB_BLOCK_SIZE 65536
+
+/* LYB format version with subtrees split into chunks of at most LYB_SIZE_MAX bytes, each with its metadata */
+#define LYB_VERSION_CHUNKS 0x00
+
+/* LYB format version with the whole size of every subtree in LYB_SUBTREE_SIZE_BYTES before it */
+#define LYB_VERSION_SIZES 0x10
+
+/* LYB format version LYB_VERSION_SIZES with a table of all the used annotations after the models,
+ * attributes reference them by their index */
+#define LYB_VERSION_ANNOTS 0x20
+
+/* LYB format version LYB_VERSION_ANNOTS with user type values possibly encoded by their plugins */
+#define LYB_VERSION_USER 0x30
+
+/* How many bytes an attribute annotation index takes in LYB_VERSION_ANNOTS, depends on the annotation count */
+#define LYB_ANNOT_INDEX_BYTES(count) (((count) > UINT8_MAX + 1) ? 2 : 1)
+
+/* Bits of the LYB header byte holding the format version */
+#define LYB_HEADER_VERSION_MASK 0xf0
+
+/* How many bytes are reserved for a subtree size in LYB_VERSION_SIZES and later */
+#define LYB_SUBTREE_SIZE_BYTES 4
+
 /* How many bytes are reserved for one data chunk SIZE (8B is maximum) */
 #define LYB_SIZE_BYTES 1
 
@@ -131,8 +193,33 @@ struct lyb_state {
 
 LYB_HASH lyb_hash(struct lys_node *sibling, uint8_t collision_id);
 
+/**
+ * @brief Get the hash of the schema set of a context (modules, their revisions, conformance, and enabled features).
+ *
+ * Stored in LYB data, so it must not change between libyang versions.
+ *
+ * @param[in] ctx Context to hash.
+ * @return Non-zero hash, 0 is reserved for unvalidated data in the LYB checksum block.
+ */
+uint32_t lyb_ctx_hash(struct ly_ctx *ctx);
+
 int lyb_has_schema_model(struct lys_node *sibling, const struct lys_module **models, int mod_count);
 
+/**
+ * @brief Free the LYB schema hash index of a context, when the enabled schema nodes change.
+ */
+void lyb_hashes_clean(struct ly_ctx *ctx);
+
+/**
+ * @brief Free the LYB printer sibling hash tables of a context, when the schema nodes change.
+ */
+void lyb_sibling_hts_clean(struct ly_ctx *ctx);
+
+/**
+ * @brief Free the printed modules cached by lys_print_mem() in a context, when the schemas change.
+ */
+void lys_print_cache_clean(struct ly_ctx *ctx);
+
 /**
  * Macros to work with ::lyd_node#when_status
  * +--- bit 1 - some when-stmt connected with the node (resolve_applies_when() is true)
@@ -158,12 +245,20 @@ int lyb_has_schema_model(struct lys_node *sibling, const struct lys_module **mod
 /**
  * @brief Minimum number of children for the parent to create a hash table for them.
  */
-#   define LY_CACHE_HT_MIN_CHILDREN 4
+#   define LY_CACHE_HT_MIN_CHILDREN LY_DATA_HT_MIN_CHILDREN
+
+/**
+ * @brief Number of children below which the parent frees their hash table again. It is lower than
+ * #LY_CACHE_HT_MIN_CHILDREN so that adding and removing a single child does not create and free the table repeatedly.
+ */
+#   define LY_CACHE_HT_FREE_CHILDREN ((LY_CACHE_HT_MIN_CHILDREN + 1) / 2)
 
     int lyd_hash(struct lyd_node *node);
 
     void lyd_insert_hash(struct lyd_node *node);
 
+    int lyd_hash_reserve(struct lyd_node *parent, uint32_t count);
+
     void lyd_unlink_hash(struct lyd_node *node, struct lyd_node *orig_parent);
 #endif
 
@@ -402,6 +497,49 @@ void lys_free(struct lys_module *module, void (*private_destructor)(const struct
  */
 struct lyd_node *_lyd_new(struct lyd_node *parent, const struct lys_node *schema, int dflt);
 
+/**
+ * @brief Allocate zeroed memory for a data node, an attribute or an XML element or attribute.
+ * With #LY_ENABLED_DATA_POOL, it is taken from the context data pool.
+ *
+ * @param[in] ctx Context of the node or attribute.
+ * @param[in] size Size of the node or attribute structure.
+ * @return Allocated memory, NULL on error.
+ */
+void *lyd_pool_alloc(struct ly_ctx *ctx, size_t size);
+
+/**
+ * @brief Free the memory of a data node, an attribute or an XML element or attribute allocated by lyd_pool_alloc().
+ *
+ * @param[in] ctx Context of the node or attribute.
+ * @param[in] ptr Memory to free, can be NULL.
+ */
+void lyd_pool_free(struct ly_ctx *ctx, void *ptr);
+
+/**
+ * @brief Start using the thread stash of the context data pool, should be called before creating
+ * or freeing many data nodes. The slots are then taken from the pool in batches and all the freed ones
+ * are returned at once, each with a single lock acquisition. Can be nested, but the stash is used only
+ * for one context at a time.
+ *
+ * @param[in] ctx Context whose data pool is to be used.
+ */
+void lyd_pool_stash_start(struct ly_ctx *ctx);
+
+/**
+ * @brief Stop using the thread stash of the context data pool and return all the stashed slots.
+ * Must be called for every lyd_pool_stash_start().
+ *
+ * @param[in] ctx Context whose data pool was used.
+ */
+void lyd_pool_stash_flush(struct ly_ctx *ctx);
+
+/**
+ * @brief Free all the memory of the context data pool, no data of the context can exist anymore.
+ *
+ * @param[in] ctx Context whose data pool is to be freed.
+ */
+void lyd_pool_clean(struct ly_ctx *ctx);
+
 /**
  * @brief Find the parent node of an attribute.
  *
@@ -484,6 +622,149 @@ int lys_get_sibling(const struct lys_node *siblings, const char *mod_name, int m
 int lys_getnext_data(const struct lys_module *mod, const struct lys_node *parent, const char *name, int nam_len,
                      LYS_NODE type, int getnext_opts, const struct lys_node **ret);
 
+/**
+ * @brief Find a data child of a schema node by its name in the data children index of the context,
+ * built for each parent when first needed. The result is the same as of comparing the names of all the
+ * nodes returned by lys_getnext() with no options, in their order.
+ *
+ * @param[in] ctx Context.
+ * @param[in] parent Parent of the node, NULL for a top-level node of \p module.
+ * @param[in] module Module of the top-level node, ignored if \p parent is set.
+ * @param[in] mod_name Module name of the node, NULL to match only the \p name.
+ * @param[in] mod_name_len Length of \p mod_name.
+ * @param[in] name Node name.
+ * @param[in] nam_len Length of \p name.
+ * @param[out] ret Found node.
+ *
+ * @return EXIT_SUCCESS on success, EXIT_FAILURE if not found, -1 on error.
+ */
+int lys_find_data_child(struct ly_ctx *ctx, const struct lys_node *parent, const struct lys_module *module,
+                        const char *mod_name, int mod_name_len, const char *name, int nam_len,
+                        const struct lys_node **ret);
+
+/**
+ * @brief Learn whether the data subtree of a schema node can have any mandatory leaf, choice, anydata,
+ * list and leaf-list with min-elements or max-elements, or a node with a when condition (evaluated by
+ * the mandatory check as well), including the node itself. The when conditions of the parents of \p schema
+ * are not considered. The results are computed for whole subtrees when first needed and kept until
+ * the modules of the context change.
+ *
+ * @param[in] schema Schema node.
+ * @return 1 if there can be some, 0 if there are none.
+ */
+int lys_has_mandatory_when(const struct lys_node *schema);
+
+/**
+ * @brief Free the data children index of a context, when the enabled schema nodes change.
+ */
+void lys_data_children_clean(struct ly_ctx *ctx);
+
+/**
+ * @brief Free the index of the deviations by their target modules, see lys_enable_deviations().
+ */
+void lys_deviations_clean(struct ly_ctx *ctx);
+
+/**
+ * @brief Invalidate the cached values of all the if-feature expressions in a context, when features change.
+ *
+ * @param[in] ctx Context of the changed features.
+ */
+void lys_features_changed(struct ly_ctx *ctx);
+
+/**
+ * @brief Search for the schema file like lys_search_localfile(), reuse the listings of the directories searched
+ * before in a context as long as the directories are not modified.
+ *
+ * @param[in] ctx Context to store the directory listings in, NULL to not store them.
+ * @param[in] searchpaths NULL-terminated array of paths to be searched (recursively).
+ * @param[in] cwd Flag to implicitly search also in the current working directory (non-recursively).
+ * @param[in] name Name of the schema to find.
+ * @param[in] revision Revision of the schema to find, NULL for the newest one.
+ * @param[out] localfile Path of the found schema, NULL if not found.
+ * @param[out] format Optional expected format of the found schema.
+ * @return EXIT_FAILURE on error, EXIT_SUCCESS otherwise (even if the file is not found).
+ */
+int lys_search_localfile_ctx(struct ly_ctx *ctx, const char * const *searchpaths, int cwd, const char *name,
+                             const char *revision, char **localfile, LYS_INFORMAT *format);
+
+/**
+ * @brief Free the directory listings stored in a context by lys_search_localfile_ctx().
+ */
+void lys_search_dirs_clean(struct ly_ctx *ctx);
+
+/**
+ * @brief Keep a replaced context modules list or module index until no lock-free reader can access it.
+ *
+ * @param[in] ctx Context.
+ * @param[in] ptr Replaced list or index.
+ * @param[in] ht Whether \p ptr is a hash table (index) or a list.
+ * @return EXIT_SUCCESS on success, -1 on error (nothing was replaced then).
+ */
+int ly_ctx_modules_retire(struct ly_ctx *ctx, void *ptr, int ht);
+
+/**
+ * @brief Free the replaced context modules lists and module indices, unless some lock-free reader is running.
+ *
+ * The replaced ones are already unreachable for the readers starting after them being replaced so once there are
+ * no readers at some moment (always when modules are being removed from the context), they can all be freed.
+ *
+ * @param[in] ctx Context.
+ */
+void ly_ctx_modules_reclaim(struct ly_ctx *ctx);
+
+/**
+ * @brief Add a module into the name and namespace indices of its context.
+ *
+ * The indices are read without locking, so they are replaced by their modified copies instead of being changed.
+ *
+ * @param[in] module Module added into the context list of modules.
+ * @return EXIT_SUCCESS on success, -1 on error.
+ */
+int ly_ctx_module_index_add(struct lys_module *module);
+
+/**
+ * @brief Remove a module from the name and namespace indices of its context, if it is there.
+ *
+ * @param[in] module Module removed from the context list of modules.
+ */
+void ly_ctx_module_index_remove(struct lys_module *module);
+
+/**
+ * @brief Free the ietf-yang-library data kept by ly_ctx_info(), when they change without changing the module set ID.
+ *
+ * @param[in] ctx Context to use.
+ */
+void ly_ctx_info_clean(struct ly_ctx *ctx);
+
+/**
+ * @brief Add the counters of the finished data operation of the thread (ly_cnt) to the context counters.
+ *
+ * @param[in] ctx Context of the operation.
+ */
+void ly_ctx_counters_flush(const struct ly_ctx *ctx);
+
+/**
+ * @brief Get the number of tasks a parallel data operation should be split into.
+ *
+ * @param[in] ctx Context of the operation, can be NULL.
+ * @param[in] max Maximum number of the tasks, such as the number of the work units.
+ * @return Number of the tasks, at most \p max, 1 (or 0 for \p max 0) if not worth splitting.
+ */
+uint32_t ly_parallel_count(const struct ly_ctx *ctx, uint32_t max);
+
+/**
+ * @brief Run the tasks of a parallel data operation using the context executor (ly_ctx_set_executor()).
+ * The calling thread runs the first task and all the tasks that could not be submitted, and waits for
+ * the others to finish.
+ *
+ * @param[in] ctx Context of the operation, can be NULL.
+ * @param[in] task Task function.
+ * @param[in] args Array of the task arguments.
+ * @param[in] arg_size Size of an item of \p args.
+ * @param[in] count Number of the tasks.
+ */
+void ly_parallel_run(const struct ly_ctx *ctx, void (*task)(void *arg), void *args, size_t arg_size, uint32_t count);
+
 int lyd_get_unique_default(const char* unique_expr, struct lyd_node *list, const char **dflt);
 
 int lyd_build_relative_data_path(const struct lys_module *module, const struct lyd_node *node, const char *schema_id,
@@ -544,6 +825,16 @@ int lyd_defaults_add_unres(struct lyd_node **root, int options, struct ly_ctx *c
                            int mod_count, const struct lyd_node *data_tree, struct lyd_node *act_notif,
                            struct unres_data *unres, int wd);
 
+/**
+ * @brief Update #LYD_VAL_SUBTREE flags of the data trees after their successful validation.
+ *
+ * @param[in] first First top-level sibling.
+ * @param[in] modules Only the trees of these modules were validated, NULL for all the trees.
+ * @param[in] mod_count Number of \p modules.
+ * @param[in] options Validation options, only #LYD_OPT_NOSIBLINGS is relevant.
+ */
+void lyd_val_subtree_forget(struct lyd_node *first, const struct lys_module **modules, int mod_count, int options);
+
 void lys_enable_deviations(struct lys_module *module);
 
 void lys_disable_deviations(struct lys_module *module);
@@ -258,6 +258,320 @@ lys_getnext_data(const struct lys_module *mod, const struct lys_node *parent, co
     return EXIT_FAILURE;
 }
 
+/* record of the data children index, see lys_find_data_child() */
+struct lys_child_rec {
+    const void *scope;          /* schema parent or the module of top-level nodes */
+    const char *mod_name;       /* module name of the child, NULL if indexed only by the name */
+    const char *name;           /* name of the child, NULL in the record marking an indexed scope */
+    uint32_t mod_name_len;
+    uint32_t name_len;
+    const struct lys_node *node;
+};
+
+static int
+lys_child_equal(void *val1_p, void *val2_p, int UNUSED(mod), void *UNUSED(cb_data))
+{
+    struct lys_child_rec *rec1 = val1_p, *rec2 = val2_p;
+
+    if ((rec1->scope != rec2->scope) || (!rec1->mod_name != !rec2->mod_name) || (!rec1->name != !rec2->name)) {
+        return 0;
+    }
+    if (rec1->mod_name && ((rec1->mod_name_len != rec2->mod_name_len)
+            || strncmp(rec1->mod_name, rec2->mod_name, rec1->mod_name_len))) {
+        return 0;
+    }
+    if (rec1->name && ((rec1->name_len != rec2->name_len) || strncmp(rec1->name, rec2->name, rec1->name_len))) {
+        return 0;
+    }
+    return 1;
+}
+
+static uint32_t
+lys_child_hash(const struct lys_child_rec *rec)
+{
+    uint32_t hash;
+
+    hash = dict_hash_multi(0, (const char *)&rec->scope, sizeof rec->scope);
+    if (rec->mod_name) {
+        hash = dict_hash_multi(hash, rec->mod_name, rec->mod_name_len);
+    }
+    if (rec->name) {
+        hash = dict_hash_multi(hash, rec->name, rec->name_len);
+    }
+    return dict_hash_multi(hash, NULL, 0);
+}
+
+/**
+ * @brief Add all the data children of a scope into the index, followed by the record marking the scope indexed.
+ * Only the first of children with the same key is found, as it is by lys_getnext() traversal.
+ *
+ * @return EXIT_SUCCESS on success, -1 on error.
+ */
+static int
+lys_child_index_scope(struct hash_table *ht, const struct lys_node *parent, const struct lys_module *module,
+                      int with_module)
+{
+    struct lys_child_rec rec;
+    const struct lys_node *node = NULL;
+
+    rec.scope = parent ? (const void *)parent : (const void *)module;
+    while ((node = lys_getnext(node, parent, parent ? NULL : module, 0))) {
+        if (with_module) {
+            rec.mod_name = lys_node_module(node)->name;
+            rec.mod_name_len = strlen(rec.mod_name);
+        } else {
+            rec.mod_name = NULL;
+            rec.mod_name_len = 0;
+        }
+        rec.name = node->name;
+        rec.name_len = strlen(node->name);
+        rec.node = node;
+        if (lyht_insert(ht, &rec, lys_child_hash(&rec), NULL) == -1) {
+            return -1;
+        }
+    }
+
+    rec.mod_name = with_module ? "" : NULL;
+    rec.mod_name_len = 0;
+    rec.name = NULL;
+    rec.name_len = 0;
+    rec.node = NULL;
+    if (lyht_insert(ht, &rec, lys_child_hash(&rec), NULL) == -1) {
+        return -1;
+    }
+    return EXIT_SUCCESS;
+}
+
+int
+lys_find_data_child(struct ly_ctx *ctx, const struct lys_node *parent, const struct lys_module *module,
+                    const char *mod_name, int mod_name_len, const char *name, int nam_len, const struct lys_node **ret)
+{
+    struct lys_child_rec rec, *match;
+    int indexed = 0, rc = EXIT_FAILURE;
+
+    assert(ctx && (parent || module) && name && ret);
+
+    *ret = NULL;
+    rec.scope = parent ? (const void *)parent : (const void *)module;
+    rec.mod_name = mod_name;
+    rec.mod_name_len = mod_name ? mod_name_len : 0;
+    rec.name = name;
+    rec.name_len = nam_len;
+
+    /* the scope is usually indexed already, the readers do not block each other */
+    pthread_rwlock_rdlock(&ctx->data_children_lock);
+    if (ctx->data_children && (ctx->data_children_set_id == ctx->models.module_set_id)
+            && !lyht_find(ctx->data_children, &rec, lys_child_hash(&rec), (void **)&match)) {
+        *ret = match->node;
+        pthread_rwlock_unlock(&ctx->data_children_lock);
+        return EXIT_SUCCESS;
+    }
+    pthread_rwlock_unlock(&ctx->data_children_lock);
+
+    pthread_rwlock_wrlock(&ctx->data_children_lock);
+
+    if (ctx->data_children_set_id != ctx->models.module_set_id) {
+        /* modules changed, build the indices again */
+        lyht_free(ctx->data_children);
+        ctx->data_children = NULL;
+        lyht_free(ctx->mand_subtrees);
+        ctx->mand_subtrees = NULL;
+    }
+    if (!ctx->data_children) {
+        ctx->data_children = lyht_new(64, sizeof rec, lys_child_equal, NULL, 1);
+        LY_CHECK_ERR_GOTO(!ctx->data_children, LOGMEM(ctx); rc = -1, cleanup);
+        ctx->data_children_set_id = ctx->models.module_set_id;
+    }
+
+    while (1) {
+        if (!lyht_find(ctx->data_children, &rec, lys_child_hash(&rec), (void **)&match)) {
+            *ret = match->node;
+            rc = EXIT_SUCCESS;
+            break;
+        } else if (indexed) {
+            break;
+        }
+
+        /* is the scope already indexed? */
+        rec.name = NULL;
+        rec.name_len = 0;
+        if (mod_name) {
+            rec.mod_name = "";
+            rec.mod_name_len = 0;
+        }
+        if (!lyht_find(ctx->data_children, &rec, lys_child_hash(&rec), NULL)) {
+            break;
+        }
+
+        if (lys_child_index_scope(ctx->data_children, parent, module, mod_name ? 1 : 0)) {
+            lyht_free(ctx->data_children);
+            ctx->data_children = NULL;
+            rc = -1;
+            break;
+        }
+        indexed = 1;
+        rec.mod_name = mod_name;
+        rec.mod_name_len = mod_name ? mod_name_len : 0;
+        rec.name = name;
+        rec.name_len = nam_len;
+    }
+
+cleanup:
+    pthread_rwlock_unlock(&ctx->data_children_lock);
+    return rc;
+}
+
+/* record of the mandatory subtrees index, see lys_has_mandatory_when() */
+struct lys_mand_rec {
+    const struct lys_node *node;
+    int mand;
+};
+
+static int
+lys_mand_equal(void *val1_p, void *val2_p, int UNUSED(mod), void *UNUSED(cb_data))
+{
+    struct lys_mand_rec *rec1 = val1_p, *rec2 = val2_p;
+
+    return rec1->node == rec2->node;
+}
+
+static uint32_t
+lys_mand_hash(const struct lys_node *node)
+{
+    return dict_hash_multi(dict_hash_multi(0, (const char *)&node, sizeof node), NULL, 0);
+}
+
+/**
+ * @brief Add a schema node and all its descendants into the mandatory subtrees index.
+ *
+ * @return 1 if the subtree has some mandatory nodes or when conditions, 0 if not, -1 on error.
+ */
+static int
+lys_mand_index_subtree(struct hash_table *ht, const struct lys_node *node)
+{
+    struct lys_mand_rec rec, *match;
+    const struct lys_node *child;
+    int r;
+
+    rec.node = node;
+    if (!lyht_find(ht, &rec, lys_mand_hash(node), (void **)&match)) {
+        return match->mand;
+    }
+
+    switch (node->nodetype) {
+    case LYS_LEAF:
+    case LYS_CHOICE:
+    case LYS_ANYXML:
+    case LYS_ANYDATA:
+        rec.mand = (node->flags & LYS_MAND_TRUE) ? 1 : 0;
+        break;
+    case LYS_LIST:
+        rec.mand = (((struct lys_node_list *)node)->min || ((struct lys_node_list *)node)->max) ? 1 : 0;
+        break;
+    case LYS_LEAFLIST:
+        rec.mand = (((struct lys_node_leaflist *)node)->min || ((struct lys_node_leaflist *)node)->max) ? 1 : 0;
+        break;
+    default:
+        rec.mand = 0;
+        break;
+    }
+    if (resolve_applies_when(node, 0, NULL)) {
+        /* the when conditions of the node, its augment and the schema-only parents up to a data node */
+        rec.mand = 1;
+    }
+
+    if (!(node->nodetype & (LYS_LEAF | LYS_LEAFLIST | LYS_ANYDATA))) {
+        /* the children of the augments are connected to their targets, too */
+        LY_TREE_FOR(node->child, child) {
+            if (child->nodetype == LYS_GROUPING) {
+                continue;
+            }
+            r = lys_mand_index_subtree(ht, child);
+            if (r == -1) {
+                return -1;
+            }
+            rec.mand |= r;
+        }
+    }
+
+    if (lyht_insert(ht, &rec, lys_mand_hash(node), NULL) == -1) {
+        return -1;
+    }
+    return rec.mand;
+}
+
+int
+lys_has_mandatory_when(const struct lys_node *schema)
+{
+    struct ly_ctx *ctx = schema->module->ctx;
+    struct lys_mand_rec rec, *match;
+    int r;
+
+    rec.node = schema;
+
+    pthread_rwlock_rdlock(&ctx->data_children_lock);
+    if (ctx->mand_subtrees && (ctx->data_children_set_id == ctx->models.module_set_id)
+            && !lyht_find(ctx->mand_subtrees, &rec, lys_mand_hash(schema), (void **)&match)) {
+        r = match->mand;
+        pthread_rwlock_unlock(&ctx->data_children_lock);
+        return r;
+    }
+    pthread_rwlock_unlock(&ctx->data_children_lock);
+
+    pthread_rwlock_wrlock(&ctx->data_children_lock);
+
+    if (ctx->data_children_set_id != ctx->models.module_set_id) {
+        /* modules changed, build both the indices again */
+        lyht_free(ctx->data_children);
+        ctx->data_children = NULL;
+        lyht_free(ctx->mand_subtrees);
+        ctx->mand_subtrees = NULL;
+        ctx->data_children_set_id = ctx->models.module_set_id;
+    }
+    if (!ctx->mand_subtrees) {
+        ctx->mand_subtrees = lyht_new(64, sizeof rec, lys_mand_equal, NULL, 1);
+    }
+
+    r = ctx->mand_subtrees ? lys_mand_index_subtree(ctx->mand_subtrees, schema) : -1;
+    if (r == -1) {
+        /* just check everything */
+        lyht_free(ctx->mand_subtrees);
+        ctx->mand_subtrees = NULL;
+        r = 1;
+    }
+
+    pthread_rwlock_unlock(&ctx->data_children_lock);
+    return r;
+}
+
+void
+lys_data_children_clean(struct ly_ctx *ctx)
+{
+    pthread_rwlock_wrlock(&ctx->data_children_lock);
+
+    lyht_free(ctx->data_children);
+    ctx->data_children = NULL;
+    lyht_free(ctx->mand_subtrees);
+    ctx->mand_subtrees = NULL;
+
+    pthread_rwlock_unlock(&ctx->data_children_lock);
+}
+
+void
+lys_features_changed(struct ly_ctx *ctx)
+{
+#ifdef LY_ENABLED_CACHE
+    /* the ID is stored above the value bit of the cached expressions, never 0 */
+    ctx->feature_set_id = (ctx->feature_set_id + 1) & 0x7FFFFFFF;
+    if (!ctx->feature_set_id) {
+        ctx->feature_set_id = 1;
+    }
+#endif
+
+    /* the printed trees show the disabled nodes differently */
+    lys_print_cache_clean(ctx);
+}
+
 API const struct lys_node *
 lys_getnext(const struct lys_node *last, const struct lys_node *parent, const struct lys_module *module, int options)
 {
@@ -1063,6 +1377,9 @@ lys_parse_mem_(struct ly_ctx *ctx, const char *data, LYS_INFORMAT format, const
         data = enlarged_data;
     }
 
+    /* schema strings live as long as the context */
+    lydict_immortal_start(ctx);
+
     switch (format) {
     case LYS_IN_YIN:
         mod = yin_read_module(ctx, data, revision, implement);
@@ -1085,10 +1402,11 @@ lys_parse_mem_(struct ly_ctx *ctx, const char *data, LYS_INFORMAT format, const
     if (mod && ly_strequal(mod->name, "ietf-netconf", 0)) {
         if (lyp_add_ietf_netconf_annotations_config(mod)) {
             lys_free(mod, NULL, 1, 1);
-            return NULL;
+            mod = NULL;
         }
     }
 
+    lydict_immortal_stop(ctx);
     return mod;
 }
 
@@ -1123,6 +1441,8 @@ lys_sub_parse_mem(struct lys_module *module, const char *data, LYS_INFORMAT form
     /* get the main module */
     module = lys_main_module(module);
 
+    lydict_immortal_start(module->ctx);
+
     switch (format) {
     case LYS_IN_YIN:
         submod = yin_read_submodule(module, data, unres);
@@ -1135,6 +1455,7 @@ lys_sub_parse_mem(struct lys_module *module, const char *data, LYS_INFORMAT form
         break;
     }
 
+    lydict_immortal_stop(module->ctx);
     free(enlarged_data);
     return submod;
 }
@@ -1309,27 +1630,208 @@ lys_sub_parse_fd(struct lys_module *module, int fd, LYS_INFORMAT format, struct
 
 }
 
-API int
-lys_search_localfile(const char * const *searchpaths, int cwd, const char *name, const char *revision, char **localfile, LYS_INFORMAT *format)
+static void
+lys_search_dir_free(struct ly_search_dir *sdir)
 {
-    FUN_IN;
+    uint32_t u;
+
+    for (u = 0; u < sdir->count; ++u) {
+        free(sdir->entries[u].name);
+    }
+    free(sdir->entries);
+    sdir->entries = NULL;
+    sdir->count = 0;
+    sdir->dir_count = 0;
+}
+
+static int
+lys_search_entry_cmp(const void *e1, const void *e2)
+{
+    const struct ly_search_entry *entry1 = e1, *entry2 = e2;
+
+    if (entry1->dir != entry2->dir) {
+        return entry1->dir ? -1 : 1;
+    }
+    return strcmp(entry1->name, entry2->name);
+}
+
+/**
+ * @brief List the directories and regular files (also symlinks to them) of a directory.
+ *
+ * @param[in] path Path of the directory.
+ * @param[in,out] sdir Listing to fill, its previous entries are freed.
+ * @return EXIT_SUCCESS on success, EXIT_FAILURE if the directory cannot be listed, -1 on memory error.
+ */
+static int
+lys_search_dir_list(const char *path, struct ly_search_dir *sdir)
+{
+    DIR *dir;
+    struct dirent *file;
+    struct stat st;
+    struct ly_search_entry *entries;
+    char *wn;
+    uint32_t size = 0;
+    int is_dir;
+
+    lys_search_dir_free(sdir);
+    sdir->racy = 1;
+
+    dir = opendir(path);
+    if (!dir) {
+        LOGWRN(NULL, "Unable to open directory \"%s\" for searching (sub)modules (%s).", path, strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    /* get the modification time before reading the entries, any later change is noticed */
+    if (!fstat(dirfd(dir), &st)) {
+        sdir->mtime = st.st_mtim;
+        /* the timestamps are coarse, changes in the same interval would not change it */
+        sdir->racy = (time(NULL) - st.st_mtim.tv_sec < 2) ? 1 : 0;
+    }
+
+    while ((file = readdir(dir))) {
+        if (!strcmp(".", file->d_name) || !strcmp("..", file->d_name)) {
+            /* skip . and .. */
+            continue;
+        }
+
+        if (file->d_type == DT_DIR) {
+            is_dir = 1;
+        } else if (file->d_type == DT_REG) {
+            is_dir = 0;
+        } else {
+            /* we need to see the target of symlinks instead of symlinks */
+            if (asprintf(&wn, "%s/%s", path, file->d_name) == -1) {
+                LOGMEM(NULL);
+                closedir(dir);
+                return -1;
+            }
+            if (stat(wn, &st) == -1) {
+                LOGWRN(NULL, "Unable to get information about \"%s\" file in \"%s\" when searching for (sub)modules (%s)",
+                       file->d_name, path, strerror(errno));
+                free(wn);
+                continue;
+            }
+            free(wn);
+            if (S_ISDIR(st.st_mode)) {
+                is_dir = 1;
+            } else if (S_ISREG(st.st_mode)) {
+                is_dir = 0;
+            } else {
+                continue;
+            }
+        }
+
+        if (sdir->count == size) {
+            size = size ? size * 2 : 16;
+            entries = realloc(sdir->entries, size * sizeof *entries);
+            LY_CHECK_ERR_GOTO(!entries, LOGMEM(NULL), memerror);
+            sdir->entries = entries;
+        }
+        sdir->entries[sdir->count].name = strdup(file->d_name);
+        LY_CHECK_ERR_GOTO(!sdir->entries[sdir->count].name, LOGMEM(NULL), memerror);
+        sdir->entries[sdir->count].dir = is_dir;
+        ++sdir->count;
+        sdir->dir_count += is_dir;
+    }
+    closedir(dir);
+
+    /* so that the files of a module can be found without going through all the files */
+    if (sdir->count) {
+        qsort(sdir->entries, sdir->count, sizeof *sdir->entries, lys_search_entry_cmp);
+    }
+    return EXIT_SUCCESS;
+
+memerror:
+    closedir(dir);
+    lys_search_dir_free(sdir);
+    return -1;
+}
+
+/**
+ * @brief Get the listing of a directory, reuse the one stored in a context if the directory was not modified since.
+ *
+ * @param[in] ctx Context with the stored listings, NULL to list the directory into \p tmp.
+ * @param[in] path Path of the directory.
+ * @param[in] tmp Listing to use without a context.
+ * @param[out] sdir Listing of the directory.
+ * @return EXIT_SUCCESS on success, EXIT_FAILURE if the directory cannot be listed, -1 on memory error.
+ */
+static int
+lys_search_dir_get(struct ly_ctx *ctx, const char *path, struct ly_search_dir *tmp, struct ly_search_dir **sdir)
+{
+    struct ly_search_dir *dirs;
+    struct stat st;
+    uint32_t u;
+
+    if (!ctx) {
+        *sdir = tmp;
+        return lys_search_dir_list(path, tmp);
+    }
+
+    for (u = 0; u < ctx->search_dir_count; ++u) {
+        if (!strcmp(ctx->search_dirs[u].path, path)) {
+            break;
+        }
+    }
+    if (u < ctx->search_dir_count) {
+        *sdir = &ctx->search_dirs[u];
+        if (!(*sdir)->racy && !stat(path, &st) && (st.st_mtim.tv_sec == (*sdir)->mtime.tv_sec)
+                && (st.st_mtim.tv_nsec == (*sdir)->mtime.tv_nsec)) {
+            /* not modified */
+            return EXIT_SUCCESS;
+        }
+        return lys_search_dir_list(path, *sdir);
+    }
+
+    dirs = realloc(ctx->search_dirs, (ctx->search_dir_count + 1) * sizeof *dirs);
+    LY_CHECK_ERR_RETURN(!dirs, LOGMEM(ctx), -1);
+    ctx->search_dirs = dirs;
+    *sdir = &dirs[ctx->search_dir_count];
+    memset(*sdir, 0, sizeof **sdir);
+    (*sdir)->path = strdup(path);
+    LY_CHECK_ERR_RETURN(!(*sdir)->path, LOGMEM(ctx), -1);
+    ++ctx->search_dir_count;
+
+    return lys_search_dir_list(path, *sdir);
+}
+
+void
+lys_search_dirs_clean(struct ly_ctx *ctx)
+{
+    uint32_t u;
+
+    for (u = 0; u < ctx->search_dir_count; ++u) {
+        lys_search_dir_free(&ctx->search_dirs[u]);
+        free(ctx->search_dirs[u].path);
+    }
+    free(ctx->search_dirs);
+    ctx->search_dirs = NULL;
+    ctx->search_dir_count = 0;
+}
 
+int
+lys_search_localfile_ctx(struct ly_ctx *ctx, const char * const *searchpaths, int cwd, const char *name,
+                         const char *revision, char **localfile, LYS_INFORMAT *format)
+{
     size_t len, flen, match_len = 0, dir_len;
-    int i, implicit_cwd = 0, ret = EXIT_FAILURE;
+    int i, r, implicit_cwd = 0, ret = EXIT_FAILURE;
     char *wd, *wn = NULL;
-    DIR *dir = NULL;
-    struct dirent *file;
+    struct ly_search_dir tmp_dir, *sdir;
+    struct ly_search_entry *file;
     char *match_name = NULL;
     LYS_INFORMAT format_aux, match_format = 0;
+    uint32_t v, first, last;
     unsigned int u;
     struct ly_set *dirs;
-    struct stat st;
 
     if (!localfile) {
         LOGARG;
         return EXIT_FAILURE;
     }
 
+    memset(&tmp_dir, 0, sizeof tmp_dir);
+
     /* start to fill the dir fifo with the context's search path (if set)
      * and the current working directory */
     dirs = ly_set_new();
@@ -1340,7 +1842,8 @@ lys_search_localfile(const char * const *searchpaths, int cwd, const char *name,
 
     len = strlen(name);
     if (cwd) {
-        wd = get_current_dir_name();
+        /* allocated by the C library */
+        wd = ly_mem_adopt(get_current_dir_name());
         if (!wd) {
             LOGMEM(NULL);
             goto cleanup;
@@ -1381,104 +1884,109 @@ lys_search_localfile(const char * const *searchpaths, int cwd, const char *name,
         dirs->set.g[dirs->number] = NULL;
         LOGVRB("Searching for \"%s\" in %s.", name, wd);
 
-        if (dir) {
-            closedir(dir);
-        }
-        dir = opendir(wd);
         dir_len = strlen(wd);
-        if (!dir) {
-            LOGWRN(NULL, "Unable to open directory \"%s\" for searching (sub)modules (%s).", wd, strerror(errno));
-        } else {
-            while ((file = readdir(dir))) {
-                if (!strcmp(".", file->d_name) || !strcmp("..", file->d_name)) {
-                    /* skip . and .. */
-                    continue;
-                }
-                free(wn);
-                if (asprintf(&wn, "%s/%s", wd, file->d_name) == -1) {
+        r = lys_search_dir_get(ctx, wd, &tmp_dir, &sdir);
+        if (r == -1) {
+            goto cleanup;
+        } else if (r) {
+            continue;
+        }
+
+        if (dirs->number || !implicit_cwd) {
+            /* we have another subdirectory in searchpath to explore,
+             * subdirectories are not taken into account in current working dir (dirs->set.g[0]) */
+            for (v = 0; v < sdir->dir_count; ++v) {
+                if (asprintf(&wn, "%s/%s", wd, sdir->entries[v].name) == -1) {
                     LOGMEM(NULL);
                     goto cleanup;
                 }
-                if (stat(wn, &st) == -1) {
-                    LOGWRN(NULL, "Unable to get information about \"%s\" file in \"%s\" when searching for (sub)modules (%s)",
-                           file->d_name, wd, strerror(errno));
-                    continue;
-                }
-                if (S_ISDIR(st.st_mode) && (dirs->number || !implicit_cwd)) {
-                    /* we have another subdirectory in searchpath to explore,
-                     * subdirectories are not taken into account in current working dir (dirs->set.g[0]) */
-                    if (ly_set_add(dirs, wn, 0) == -1) {
-                        goto cleanup;
-                    }
-                    /* continue with the next item in current directory */
-                    wn = NULL;
-                    continue;
-                } else if (!S_ISREG(st.st_mode)) {
-                    /* not a regular file (note that we see the target of symlinks instead of symlinks */
-                    continue;
+                if (ly_set_add(dirs, wn, 0) == -1) {
+                    goto cleanup;
                 }
+                wn = NULL;
+            }
+        }
 
-                /* here we know that the item is a file which can contain a module */
-                if (strncmp(name, file->d_name, len) ||
-                        (file->d_name[len] != '.' && file->d_name[len] != '@')) {
-                    /* different filename than the module we search for */
-                    continue;
-                }
+        /* find the first file not sorted before the module name, all the files starting with it follow */
+        first = sdir->dir_count;
+        last = sdir->count;
+        while (first < last) {
+            v = first + (last - first) / 2;
+            if (strcmp(sdir->entries[v].name, name) < 0) {
+                first = v + 1;
+            } else {
+                last = v;
+            }
+        }
 
-                /* get type according to filename suffix */
-                flen = strlen(file->d_name);
-                if (!strcmp(&file->d_name[flen - 4], ".yin")) {
-                    format_aux = LYS_IN_YIN;
-                } else if (!strcmp(&file->d_name[flen - 5], ".yang")) {
-                    format_aux = LYS_IN_YANG;
-                } else {
-                    /* not supportde suffix/file format */
-                    continue;
-                }
+        for (v = first; (v < sdir->count) && !strncmp(name, sdir->entries[v].name, len); ++v) {
+            file = &sdir->entries[v];
 
-                if (revision) {
-                    /* we look for the specific revision, try to get it from the filename */
-                    if (file->d_name[len] == '@') {
-                        /* check revision from the filename */
-                        if (strncmp(revision, &file->d_name[len + 1], strlen(revision))) {
-                            /* another revision */
-                            continue;
-                        } else {
-                            /* exact revision */
-                            free(match_name);
-                            match_name = wn;
-                            wn = NULL;
-                            match_len = dir_len + 1 + len;
-                            match_format = format_aux;
-                            goto success;
-                        }
+            /* here we know that the item is a file which can contain a module */
+            if (file->name[len] != '.' && file->name[len] != '@') {
+                /* different filename than the module we search for */
+                continue;
+            }
+
+            /* get type according to filename suffix */
+            flen = strlen(file->name);
+            if ((flen >= 4) && !strcmp(&file->name[flen - 4], ".yin")) {
+                format_aux = LYS_IN_YIN;
+            } else if ((flen >= 5) && !strcmp(&file->name[flen - 5], ".yang")) {
+                format_aux = LYS_IN_YANG;
+            } else {
+                /* not supportde suffix/file format */
+                continue;
+            }
+
+            free(wn);
+            if (asprintf(&wn, "%s/%s", wd, file->name) == -1) {
+                LOGMEM(NULL);
+                goto cleanup;
+            }
+
+            if (revision) {
+                /* we look for the specific revision, try to get it from the filename */
+                if (file->name[len] == '@') {
+                    /* check revision from the filename */
+                    if (strncmp(revision, &file->name[len + 1], strlen(revision))) {
+                        /* another revision */
+                        continue;
                     } else {
-                        /* continue trying to find exact revision match, use this only if not found */
+                        /* exact revision */
                         free(match_name);
                         match_name = wn;
                         wn = NULL;
-                        match_len = dir_len + 1 +len;
+                        match_len = dir_len + 1 + len;
                         match_format = format_aux;
-                        continue;
+                        goto success;
                     }
                 } else {
-                    /* remember the revision and try to find the newest one */
-                    if (match_name) {
-                        if (file->d_name[len] != '@' || lyp_check_date(NULL, &file->d_name[len + 1])) {
-                            continue;
-                        } else if (match_name[match_len] == '@' &&
-                                (strncmp(&match_name[match_len + 1], &file->d_name[len + 1], LY_REV_SIZE - 1) >= 0)) {
-                            continue;
-                        }
-                        free(match_name);
-                    }
-
+                    /* continue trying to find exact revision match, use this only if not found */
+                    free(match_name);
                     match_name = wn;
                     wn = NULL;
-                    match_len = dir_len + 1 + len;
+                    match_len = dir_len + 1 +len;
                     match_format = format_aux;
                     continue;
                 }
+            } else {
+                /* remember the revision and try to find the newest one */
+                if (match_name) {
+                    if (file->name[len] != '@' || lyp_check_date(NULL, &file->name[len + 1])) {
+                        continue;
+                    } else if (match_name[match_len] == '@' &&
+                            (strncmp(&match_name[match_len + 1], &file->name[len + 1], LY_REV_SIZE - 1) >= 0)) {
+                        continue;
+                    }
+                    free(match_name);
+                }
+
+                match_name = wn;
+                wn = NULL;
+                match_len = dir_len + 1 + len;
+                match_format = format_aux;
+                continue;
             }
         }
     }
@@ -1494,9 +2002,7 @@ success:
 cleanup:
     free(wn);
     free(wd);
-    if (dir) {
-        closedir(dir);
-    }
+    lys_search_dir_free(&tmp_dir);
     free(match_name);
     for (u = 0; u < dirs->number; u++) {
         free(dirs->set.g[u]);
@@ -1506,6 +2012,14 @@ cleanup:
     return ret;
 }
 
+API int
+lys_search_localfile(const char * const *searchpaths, int cwd, const char *name, const char *revision, char **localfile, LYS_INFORMAT *format)
+{
+    FUN_IN;
+
+    return lys_search_localfile_ctx(NULL, searchpaths, cwd, name, revision, localfile, format);
+}
+
 int
 lys_ext_iter(struct lys_ext_instance **ext, uint8_t ext_size, uint8_t start, LYEXT_SUBSTMT substmt)
 {
@@ -1811,13 +2325,19 @@ type_dup(struct lys_module *mod, struct lys_node *parent, struct lys_type *new,
             if (!in_grp) {
                 new->info.str.patterns_pcre = malloc(new->info.str.pat_count * 2 * sizeof *new->info.str.patterns_pcre);
                 LY_CHECK_ERR_RETURN(!new->info.str.patterns_pcre, LOGMEM(mod->ctx), -1);
-                for (u = 0; u < new->info.str.pat_count; u++) {
-                    if (lyp_precompile_pattern(mod->ctx, &new->info.str.patterns[u].expr[1],
-                                              (pcre**)&new->info.str.patterns_pcre[2 * u],
-                                              (pcre_extra**)&new->info.str.patterns_pcre[2 * u + 1])) {
-                        free(new->info.str.patterns_pcre);
-                        new->info.str.patterns_pcre = NULL;
-                        return -1;
+                if (old->info.str.patterns_pcre) {
+                    /* the compiled patterns are shared from the context cache */
+                    memcpy(new->info.str.patterns_pcre, old->info.str.patterns_pcre,
+                           new->info.str.pat_count * 2 * sizeof *new->info.str.patterns_pcre);
+                } else {
+                    for (u = 0; u < new->info.str.pat_count; u++) {
+                        if (lyp_pattern_cache_get(mod->ctx, &new->info.str.patterns[u].expr[1],
+                                                  (pcre**)&new->info.str.patterns_pcre[2 * u],
+                                                  (pcre_extra**)&new->info.str.patterns_pcre[2 * u + 1])) {
+                            free(new->info.str.patterns_pcre);
+                            new->info.str.patterns_pcre = NULL;
+                            return -1;
+                        }
                     }
                 }
             }
@@ -2282,6 +2802,48 @@ lys_type_dup(struct lys_module *mod, struct lys_node *parent, struct lys_type *n
     return type_dup(mod, parent, new, old, new->base, in_grp, shallow, unres);
 }
 
+#ifdef LY_ENABLED_CACHE
+
+/**
+ * @brief Free compiled length or range restrictions of a type, they are compiled again on the next use.
+ *
+ * @param[in] type Type with the restrictions.
+ */
+static void
+lys_type_chk_free(struct lys_type *type)
+{
+    void **chk;
+
+    switch (type->base) {
+    case LY_TYPE_BINARY:
+        chk = &type->info.binary.length_chk;
+        break;
+    case LY_TYPE_DEC64:
+        chk = &type->info.dec64.range_chk;
+        break;
+    case LY_TYPE_INT8:
+    case LY_TYPE_INT16:
+    case LY_TYPE_INT32:
+    case LY_TYPE_INT64:
+    case LY_TYPE_UINT8:
+    case LY_TYPE_UINT16:
+    case LY_TYPE_UINT32:
+    case LY_TYPE_UINT64:
+        chk = &type->info.num.range_chk;
+        break;
+    case LY_TYPE_STRING:
+        chk = &type->info.str.length_chk;
+        break;
+    default:
+        return;
+    }
+
+    free(*chk);
+    *chk = NULL;
+}
+
+#endif
+
 void
 lys_type_free(struct ly_ctx *ctx, struct lys_type *type,
               void (*private_destructor)(const struct lys_node *node, void *priv))
@@ -2294,6 +2856,9 @@ lys_type_free(struct ly_ctx *ctx, struct lys_type *type,
     }
 
     lys_extension_instances_free(ctx, type->ext, type->ext_size, private_destructor);
+#ifdef LY_ENABLED_CACHE
+    lys_type_chk_free(type);
+#endif
 
     switch (type->base) {
     case LY_TYPE_BINARY:
@@ -2352,15 +2917,10 @@ lys_type_free(struct ly_ctx *ctx, struct lys_type *type,
         free(type->info.str.length);
         for (i = 0; i < type->info.str.pat_count; i++) {
             lys_restr_free(ctx, &type->info.str.patterns[i], private_destructor);
-#ifdef LY_ENABLED_CACHE
-            if (type->info.str.patterns_pcre) {
-                pcre_free((pcre*)type->info.str.patterns_pcre[2 * i]);
-                pcre_free_study((pcre_extra*)type->info.str.patterns_pcre[2 * i + 1]);
-            }
-#endif
         }
         free(type->info.str.patterns);
 #ifdef LY_ENABLED_CACHE
+        /* the compiled patterns are owned by the context cache */
         free(type->info.str.patterns_pcre);
 #endif
         break;
@@ -3651,7 +4211,7 @@ lys_node_dup(struct lys_module *module, struct lys_node *parent, const struct ly
 static void
 lys_node_switch(struct lys_node *node1, struct lys_node *node2)
 {
-    const size_t mem_size = 104;
+    const size_t mem_size = 112;
     uint8_t mem[mem_size];
     size_t offset, size;
 
@@ -3803,6 +4363,11 @@ lys_node_switch(struct lys_node *node1, struct lys_node *node2)
     case LYS_LEAFLIST:
         ((struct lys_node_leaf *)node1)->type.parent = (struct lys_tpdf *)node1;
         ((struct lys_node_leaf *)node2)->type.parent = (struct lys_tpdf *)node2;
+#ifdef LY_ENABLED_CACHE
+        /* compiled restrictions refer to the types by their address */
+        lys_type_chk_free(&((struct lys_node_leaf *)node1)->type);
+        lys_type_chk_free(&((struct lys_node_leaf *)node2)->type);
+#endif
     default:
         break;
     }
@@ -3812,6 +4377,7 @@ void
 lys_free(struct lys_module *module, void (*private_destructor)(const struct lys_node *node, void *priv), int free_subs, int remove_from_ctx)
 {
     struct ly_ctx *ctx;
+    struct lys_module **list;
     int i;
 
     if (!module) {
@@ -3820,13 +4386,28 @@ lys_free(struct lys_module *module, void (*private_destructor)(const struct lys_
 
     /* remove schema from the context */
     ctx = module->ctx;
+    if (!module->type) {
+        ly_ctx_module_index_remove(module);
+    }
     if (remove_from_ctx && ctx->models.used) {
         for (i = 0; i < ctx->models.used; i++) {
             if (ctx->models.list[i] == module) {
-                /* move all the models to not change the order in the list */
-                ctx->models.used--;
-                memmove(&ctx->models.list[i], ctx->models.list[i + 1], (ctx->models.used - i) * sizeof *ctx->models.list);
-                ctx->models.list[ctx->models.used] = NULL;
+                /* move all the models to not change the order in the list, in its copy not to disturb the readers
+                 * (see lyp_ctx_add_module()), or at least in place */
+                list = calloc(ctx->models.size, sizeof *list);
+                if (list && !ly_ctx_modules_retire(ctx, ctx->models.list, 0)) {
+                    memcpy(list, ctx->models.list, i * sizeof *list);
+                    memcpy(&list[i], &ctx->models.list[i + 1], (ctx->models.used - i - 1) * sizeof *list);
+                    LY_ATOMIC_STORE(ctx->models.used, ctx->models.used - 1);
+                    LY_ATOMIC_STORE(ctx->models.list, list);
+                } else {
+                    free(list);
+                    ctx->models.used--;
+                    memmove(&ctx->models.list[i], &ctx->models.list[i + 1], (ctx->models.used - i) * sizeof *ctx->models.list);
+                    ctx->models.list[ctx->models.used] = NULL;
+                }
+                /* the positions of the following modules changed */
+                ctx->models.module_set_id++;
                 /* we are done */
                 break;
             }
@@ -3975,7 +4556,17 @@ lys_features_enable(const struct lys_module *module, const char *feature)
 {
     FUN_IN;
 
-    return lys_features_change(module, feature, 1);
+    int ret;
+
+    ret = lys_features_change(module, feature, 1);
+    if (module) {
+        /* the children disabled by if-features are not in the indexes */
+        lys_features_changed(module->ctx);
+        lys_data_children_clean(module->ctx);
+        ly_ctx_info_clean(module->ctx);
+        lyb_hashes_clean(module->ctx);
+    }
+    return ret;
 }
 
 API int
@@ -3983,7 +4574,16 @@ lys_features_disable(const struct lys_module *module, const char *feature)
 {
     FUN_IN;
 
-    return lys_features_change(module, feature, 0);
+    int ret;
+
+    ret = lys_features_change(module, feature, 0);
+    if (module) {
+        lys_features_changed(module->ctx);
+        lys_data_children_clean(module->ctx);
+        ly_ctx_info_clean(module->ctx);
+        lyb_hashes_clean(module->ctx);
+    }
+    return ret;
 }
 
 API int
@@ -4410,6 +5010,25 @@ next_iter:
     return ret_set;
 }
 
+API struct ly_set *
+lys_xpath_dependents(const struct lys_node *node)
+{
+    FUN_IN;
+
+    const struct ly_set *deps;
+
+    if (!node) {
+        LOGARG;
+        return NULL;
+    }
+
+    if (lyxp_deps_get(node, &deps)) {
+        return NULL;
+    }
+
+    return deps ? ly_set_dup(deps) : ly_set_new();
+}
+
 /* logs */
 int
 apply_aug(struct lys_node_augment *augment, struct unres_schema *unres)
@@ -4655,45 +5274,284 @@ lys_switch_deviation(struct lys_deviation *dev, const struct lys_module *module,
             dev->orig_node = target;
         }
     } else {
-        ret = resolve_schema_nodeid(dev->target_name, NULL, module, &set, 0, 1);
-        if (ret == -1) {
-            LOGINT(module->ctx);
+#ifdef LY_ENABLED_CACHE
+        /* the target node itself is never replaced, only its contents */
+        target = dev->target;
+#endif
+        if (!target) {
+            ret = resolve_schema_nodeid(dev->target_name, NULL, module, &set, 0, 1);
+            if (ret == -1) {
+                LOGINT(module->ctx);
+                ly_set_free(set);
+                return;
+            }
+            target = set->set.s[0];
             ly_set_free(set);
-            return;
+#ifdef LY_ENABLED_CACHE
+            dev->target = target;
+#endif
         }
-        target = set->set.s[0];
-        ly_set_free(set);
 
         /* contents are switched */
         lys_node_switch(target, dev->orig_node);
     }
 }
 
+/* deviation in the deviations index, see lys_deviations_get() */
+struct lys_dev_item {
+    struct lys_module *module;       /* deviating module */
+    uint32_t pos;                    /* position of the deviating module in the context when indexed */
+    uint8_t dev;                     /* index of the deviation in the deviating module */
+};
+
+/* record of the deviations index, all the deviations with a node of the target module in their target path */
+struct lys_dev_rec {
+    const struct lys_module *target;
+    struct lys_dev_item *items;      /* ordered as the deviating modules in the context and their deviations */
+    uint32_t count;
+    uint32_t size;
+};
+
+static int
+lys_dev_equal(void *val1_p, void *val2_p, int UNUSED(mod), void *UNUSED(cb_data))
+{
+    return ((struct lys_dev_rec *)val1_p)->target == ((struct lys_dev_rec *)val2_p)->target;
+}
+
+static uint32_t
+lys_dev_hash(const struct lys_module *target)
+{
+    return dict_hash_multi(dict_hash_multi(0, (const char *)&target, sizeof target), NULL, 0);
+}
+
+static void
+lys_deviations_index_free(struct hash_table *ht)
+{
+    struct lys_dev_rec *rec;
+    uint32_t i;
+
+    if (!ht) {
+        return;
+    }
+    lyht_finish_resize(ht);
+    for (i = 0; i < ht->size; ++i) {
+        rec = lyht_get_val(ht, i);
+        if (rec) {
+            free(rec->items);
+        }
+    }
+    lyht_free(ht);
+}
+
+static int
+lys_deviations_index_add(struct hash_table *ht, const struct lys_module *target, struct lys_dev_item *item)
+{
+    struct lys_dev_rec rec, *match;
+    struct lys_dev_item *new;
+    uint32_t hash;
+
+    rec.target = target;
+    hash = lys_dev_hash(target);
+    if (lyht_find(ht, &rec, hash, (void **)&match)) {
+        rec.items = NULL;
+        rec.count = rec.size = 0;
+        if (lyht_insert(ht, &rec, hash, (void **)&match) == -1) {
+            return -1;
+        }
+    } else if ((match->items[match->count - 1].module == item->module)
+            && (match->items[match->count - 1].dev == item->dev)) {
+        /* more nodes of the target module in the path */
+        return EXIT_SUCCESS;
+    }
+
+    if (match->count == match->size) {
+        new = realloc(match->items, (match->size ? match->size * 2 : 4) * sizeof *new);
+        if (!new) {
+            return -1;
+        }
+        match->items = new;
+        match->size = match->size ? match->size * 2 : 4;
+    }
+    match->items[match->count++] = *item;
+    return EXIT_SUCCESS;
+}
+
+/* ctx->devs_lock must be held */
+static int
+lys_deviations_index_build(struct ly_ctx *ctx)
+{
+    struct lys_dev_item item;
+    struct ly_set targets = {0};
+    const char *name, *colon;
+    int i;
+    unsigned int u;
+
+    if (ctx->devs && (ctx->devs_set_id == ctx->models.module_set_id)) {
+        return EXIT_SUCCESS;
+    }
+
+    lys_deviations_index_free(ctx->devs);
+    ctx->devs = lyht_new(16, sizeof(struct lys_dev_rec), lys_dev_equal, NULL, 1);
+    LY_CHECK_ERR_RETURN(!ctx->devs, LOGMEM(ctx), -1);
+
+    /* a deviation is indexed under all the modules with a prefix in its target path */
+    for (i = 0; i < ctx->models.used; ++i) {
+        item.module = ctx->models.list[i];
+        item.pos = i;
+        for (item.dev = 0; item.dev < item.module->deviation_size; ++item.dev) {
+            for (name = item.module->deviation[item.dev].target_name; (name = strchr(name, '/')); ) {
+                ++name;
+                colon = name + strcspn(name, ":/");
+                if (*colon != ':') {
+                    continue;
+                }
+                ly_set_clean(&targets);
+                if (ly_ctx_nget_modules(ctx, name, colon - name, &targets)) {
+                    goto error;
+                }
+                for (u = 0; u < targets.number; ++u) {
+                    if (lys_deviations_index_add(ctx->devs, targets.set.g[u], &item)) {
+                        goto error;
+                    }
+                }
+            }
+        }
+    }
+    ly_set_clean(&targets);
+    free(targets.set.g);
+    ctx->devs_set_id = ctx->models.module_set_id;
+    return EXIT_SUCCESS;
+
+error:
+    LOGMEM(ctx);
+    ly_set_clean(&targets);
+    free(targets.set.g);
+    lys_deviations_index_free(ctx->devs);
+    ctx->devs = NULL;
+    return -1;
+}
+
+/* ctx->devs_lock must be held, the index must be built */
+static struct lys_dev_rec *
+lys_deviations_find(struct ly_ctx *ctx, const struct lys_module *target)
+{
+    struct lys_dev_rec rec, *match;
+
+    rec.target = target;
+    if (lyht_find(ctx->devs, &rec, lys_dev_hash(target), (void **)&match)) {
+        return NULL;
+    }
+    return match;
+}
+
+/* the module was not yet removed from the context */
+static int
+lys_dev_item_valid(struct ly_ctx *ctx, const struct lys_dev_item *item)
+{
+    return (item->pos < (unsigned)ctx->models.used) && (ctx->models.list[item->pos] == item->module);
+}
+
+/**
+ * @brief Get the deviations of the context modules possibly targeting a module, ordered as the modules
+ * in the context and their deviations.
+ *
+ * @param[in] module Target module.
+ * @param[out] items Array of the deviations, to be freed by the caller.
+ * @return Number of the deviations, -1 on error.
+ */
+static int
+lys_deviations_get(const struct lys_module *module, struct lys_dev_item **items)
+{
+    struct ly_ctx *ctx = module->ctx;
+    struct lys_dev_rec *rec;
+    uint32_t u;
+    int count = 0;
+
+    *items = NULL;
+
+    pthread_mutex_lock(&ctx->devs_lock);
+    if (lys_deviations_index_build(ctx)) {
+        count = -1;
+    } else if ((rec = lys_deviations_find(ctx, module))) {
+        *items = malloc(rec->count * sizeof **items);
+        LY_CHECK_ERR_GOTO(!*items, LOGMEM(ctx); count = -1, cleanup);
+        for (u = 0; u < rec->count; ++u) {
+            if (lys_dev_item_valid(ctx, &rec->items[u])) {
+                (*items)[count++] = rec->items[u];
+            }
+        }
+    }
+
+cleanup:
+    pthread_mutex_unlock(&ctx->devs_lock);
+    return count;
+}
+
+/**
+ * @brief Learn whether a module is possibly deviated by any enabled context module other than the given one.
+ *
+ * @param[in] target Target module.
+ * @param[in] module Deviating module to ignore.
+ * @return 1 if it is (or on error), 0 if it is not.
+ */
+static int
+lys_deviations_other(struct lys_module *target, const struct lys_module *module)
+{
+    struct ly_ctx *ctx = target->ctx;
+    struct lys_dev_rec *rec;
+    uint32_t u;
+    int ret = 0;
+
+    pthread_mutex_lock(&ctx->devs_lock);
+    if (lys_deviations_index_build(ctx)) {
+        ret = 1;
+    } else if ((rec = lys_deviations_find(ctx, target))) {
+        for (u = 0; u < rec->count; ++u) {
+            if ((rec->items[u].module != module) && (rec->items[u].module != target)
+                    && lys_dev_item_valid(ctx, &rec->items[u]) && !rec->items[u].module->disabled) {
+                ret = 1;
+                break;
+            }
+        }
+    }
+    pthread_mutex_unlock(&ctx->devs_lock);
+    return ret;
+}
+
+void
+lys_deviations_clean(struct ly_ctx *ctx)
+{
+    pthread_mutex_lock(&ctx->devs_lock);
+
+    lys_deviations_index_free(ctx->devs);
+    ctx->devs = NULL;
+
+    pthread_mutex_unlock(&ctx->devs_lock);
+}
+
 /* temporarily removes or applies deviations, updates module deviation flag accordingly */
 void
 lys_enable_deviations(struct lys_module *module)
 {
-    uint32_t i = 0, j;
-    const struct lys_module *mod;
-    const char *ptr;
+    int i, count;
+    uint32_t j;
+    struct lys_dev_item *items;
     struct unres_schema *unres;
 
     if (module->deviated) {
+        count = lys_deviations_get(module, &items);
+        if (count == -1) {
+            return;
+        }
         unres = calloc(1, sizeof *unres);
-        LY_CHECK_ERR_RETURN(!unres, LOGMEM(module->ctx), );
+        LY_CHECK_ERR_RETURN(!unres, LOGMEM(module->ctx); free(items), );
 
-        while ((mod = ly_ctx_get_module_iter(module->ctx, &i))) {
-            if (mod == module) {
-                continue;
-            }
-
-            for (j = 0; j < mod->deviation_size; ++j) {
-                ptr = strstr(mod->deviation[j].target_name, module->name);
-                if (ptr && ptr[strlen(module->name)] == ':') {
-                    lys_switch_deviation(&mod->deviation[j], mod, unres);
-                }
+        for (i = 0; i < count; ++i) {
+            if ((items[i].module != module) && !items[i].module->disabled) {
+                lys_switch_deviation(&items[i].module->deviation[items[i].dev], items[i].module, unres);
             }
         }
+        free(items);
 
         assert(module->deviated == 2);
         module->deviated = 1;
@@ -4714,31 +5572,26 @@ lys_enable_deviations(struct lys_module *module)
 void
 lys_disable_deviations(struct lys_module *module)
 {
-    uint32_t i, j;
-    const struct lys_module *mod;
-    const char *ptr;
+    int i;
+    uint32_t j;
+    struct lys_dev_item *items;
     struct unres_schema *unres;
 
     if (module->deviated) {
+        i = lys_deviations_get(module, &items);
+        if (i == -1) {
+            return;
+        }
         unres = calloc(1, sizeof *unres);
-        LY_CHECK_ERR_RETURN(!unres, LOGMEM(module->ctx), );
+        LY_CHECK_ERR_RETURN(!unres, LOGMEM(module->ctx); free(items), );
 
-        i = module->ctx->models.used;
+        /* in the reverse order */
         while (i--) {
-            mod = module->ctx->models.list[i];
-
-            if (mod == module) {
-                continue;
-            }
-
-            j = mod->deviation_size;
-            while (j--) {
-                ptr = strstr(mod->deviation[j].target_name, module->name);
-                if (ptr && ptr[strlen(module->name)] == ':') {
-                    lys_switch_deviation(&mod->deviation[j], mod, unres);
-                }
+            if (items[i].module != module) {
+                lys_switch_deviation(&items[i].module->deviation[items[i].dev], items[i].module, unres);
             }
         }
+        free(items);
 
         assert(module->deviated == 1);
         module->deviated = 2;
@@ -4769,10 +5622,7 @@ apply_dev(struct lys_deviation *dev, const struct lys_module *module, struct unr
 static void
 remove_dev(struct lys_deviation *dev, const struct lys_module *module, struct unres_schema *unres)
 {
-    uint32_t idx = 0, j;
-    const struct lys_module *mod;
     struct lys_module *target_mod, *target_submod;
-    const char *ptr;
 
     if (dev->orig_node) {
         target_mod = lys_node_module(dev->orig_node);
@@ -4783,26 +5633,8 @@ remove_dev(struct lys_deviation *dev, const struct lys_module *module, struct un
     }
     lys_switch_deviation(dev, module, unres);
 
-    /* clear the deviation flag if possible */
-    while ((mod = ly_ctx_get_module_iter(module->ctx, &idx))) {
-        if ((mod == module) || (mod == target_mod)) {
-            continue;
-        }
-
-        for (j = 0; j < mod->deviation_size; ++j) {
-            ptr = strstr(mod->deviation[j].target_name, target_mod->name);
-            if (ptr && (ptr[strlen(target_mod->name)] == ':')) {
-                /* some other module deviation targets the inspected module, flag remains */
-                break;
-            }
-        }
-
-        if (j < mod->deviation_size) {
-            break;
-        }
-    }
-
-    if (!mod) {
+    /* clear the deviation flag if possible, unless some other module deviation targets the inspected module */
+    if (!lys_deviations_other(target_mod, module)) {
         target_mod->deviated = 0;    /* main module */
         target_submod->deviated = 0; /* possible submodule */
     }
@@ -4903,6 +5735,36 @@ lys_sub_module_remove_devs_augs(struct lys_module *module)
     unres_schema_free(module, &unres, 1);
 }
 
+/**
+ * @brief Add the XPath checks of an augment subtree into unres.
+ *
+ * @param[in] node Augment of a module being made implemented or its descendant.
+ * @param[in] unres Unres schema structure to use.
+ * @return 0 on success, -1 on error.
+ */
+static int
+lys_make_implemented_xpath(struct lys_node *node, struct unres_schema *unres)
+{
+    struct lys_node *child;
+
+    if (lys_has_xpath(node) && (unres_schema_add_node(lys_main_module(node->module), unres, node, UNRES_XPATH, NULL) == -1)) {
+        return -1;
+    }
+    if (node->nodetype & (LYS_LEAF | LYS_LEAFLIST | LYS_ANYDATA | LYS_GROUPING)) {
+        return 0;
+    }
+    LY_TREE_FOR(node->child, child) {
+        if (child->parent != node) {
+            /* the augment children are connected among the children of its target */
+            break;
+        }
+        if (lys_make_implemented_xpath(child, unres)) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
 int
 lys_make_implemented_r(struct lys_module *module, struct unres_schema *unres)
 {
@@ -4981,12 +5843,33 @@ lys_make_implemented_r(struct lys_module *module, struct unres_schema *unres)
         }
     }
 
+    if (!(ctx->models.flags & LY_CTX_TRUSTED)) {
+        /* XPath expressions of the augments were skipped while the module was only imported */
+        for (i = 0; i < module->augment_size; i++) {
+            if (lys_make_implemented_xpath((struct lys_node *)&module->augment[i], unres)) {
+                return -1;
+            }
+        }
+        for (i = 0; i < module->inc_size && module->inc[i].submodule; ++i) {
+            for (j = 0; j < module->inc[i].submodule->augment_size; j++) {
+                if (lys_make_implemented_xpath((struct lys_node *)&module->inc[i].submodule->augment[j], unres)) {
+                    return -1;
+                }
+            }
+        }
+    }
+
     LY_TREE_FOR(module->data, root) {
         /* handle leafrefs and recursively change the implemented flags in the leafref targets */
         LY_TREE_DFS_BEGIN(root, next, node) {
             if (node->nodetype == LYS_GROUPING) {
                 goto nextsibling;
             }
+            if (!(ctx->models.flags & LY_CTX_TRUSTED) && lys_has_xpath(node)
+                    && (unres_schema_add_node(module, unres, node, UNRES_XPATH, NULL) == -1)) {
+                /* the XPath expressions were skipped while the module was only imported */
+                return -1;
+            }
             if (node->nodetype & (LYS_LEAF | LYS_LEAFLIST)) {
                 if (((struct lys_node_leaf *)node)->type.base == LY_TYPE_LEAFREF) {
                     if (unres_schema_add_node(module, unres, &((struct lys_node_leaf *)node)->type,
@@ -5076,6 +5959,13 @@ lys_set_implemented(const struct lys_module *module)
     }
     unres_schema_free(NULL, &unres, 0);
 
+    /* the expressions of the module now apply to the data */
+    lyxp_deps_clean(module->ctx);
+    lys_data_children_clean(module->ctx);
+    lyb_hashes_clean(module->ctx);
+    lyb_sibling_hts_clean(module->ctx);
+    ly_ctx_info_clean(module->ctx);
+
     LOGVRB("Module \"%s%s%s\" now implemented.", module->name, (module->rev_size ? "@" : ""),
            (module->rev_size ? module->rev[0].date : ""));
     return EXIT_SUCCESS;
@@ -5493,3 +6383,361 @@ lys_extension_instances_free(struct ly_ctx *ctx, struct lys_ext_instance **e, un
 
 #undef EXTCOMPLEX_FREE_STRUCT
 }
+
+static size_t
+lys_mem_ext(struct lys_ext_instance **ext, uint8_t ext_size)
+{
+    size_t mem;
+    uint8_t i;
+
+    mem = ext_size * sizeof *ext;
+    for (i = 0; i < ext_size; ++i) {
+        if (ext[i]->ext_type == LYEXT_COMPLEX) {
+            mem += ((struct lyext_plugin_complex *)ext[i]->def->plugin)->instance_size;
+        } else {
+            mem += sizeof *ext[i];
+        }
+        mem += lys_mem_ext(ext[i]->ext, ext[i]->ext_size);
+    }
+
+    return mem;
+}
+
+static void
+lys_mem_iffeature(struct lys_iffeature *iffeature, uint8_t iffeature_size, struct lys_mem_stats *stats)
+{
+    uint8_t i;
+
+    /* the expressions and their feature arrays are not included, their size is not stored */
+    stats->restr_mem += iffeature_size * sizeof *iffeature;
+    for (i = 0; i < iffeature_size; ++i) {
+        stats->ext_mem += lys_mem_ext(iffeature[i].ext, iffeature[i].ext_size);
+    }
+}
+
+static size_t
+lys_mem_restr(struct lys_restr *restr, uint32_t size, struct lys_mem_stats *stats)
+{
+    uint32_t i;
+
+    for (i = 0; i < size; ++i) {
+        stats->ext_mem += lys_mem_ext(restr[i].ext, restr[i].ext_size);
+    }
+
+    return size * sizeof *restr;
+}
+
+static void
+lys_mem_when(struct lys_when *when, struct lys_mem_stats *stats)
+{
+    if (when) {
+        stats->restr_mem += sizeof *when;
+        stats->ext_mem += lys_mem_ext(when->ext, when->ext_size);
+    }
+}
+
+static void
+lys_mem_type(struct lys_type *type, struct lys_mem_stats *stats)
+{
+    unsigned int i;
+
+    stats->ext_mem += lys_mem_ext(type->ext, type->ext_size);
+    switch (type->base) {
+    case LY_TYPE_BINARY:
+        stats->type_mem += lys_mem_restr(type->info.binary.length, type->info.binary.length ? 1 : 0, stats);
+        break;
+    case LY_TYPE_BITS:
+        stats->type_mem += type->info.bits.count * sizeof *type->info.bits.bit;
+        for (i = 0; i < type->info.bits.count; ++i) {
+            lys_mem_iffeature(type->info.bits.bit[i].iffeature, type->info.bits.bit[i].iffeature_size, stats);
+            stats->ext_mem += lys_mem_ext(type->info.bits.bit[i].ext, type->info.bits.bit[i].ext_size);
+        }
+        break;
+    case LY_TYPE_DEC64:
+        stats->type_mem += lys_mem_restr(type->info.dec64.range, type->info.dec64.range ? 1 : 0, stats);
+        break;
+    case LY_TYPE_ENUM:
+        stats->type_mem += type->info.enums.count * sizeof *type->info.enums.enm;
+        for (i = 0; i < type->info.enums.count; ++i) {
+            lys_mem_iffeature(type->info.enums.enm[i].iffeature, type->info.enums.enm[i].iffeature_size, stats);
+            stats->ext_mem += lys_mem_ext(type->info.enums.enm[i].ext, type->info.enums.enm[i].ext_size);
+        }
+        break;
+    case LY_TYPE_IDENT:
+        stats->type_mem += type->info.ident.count * sizeof *type->info.ident.ref;
+        break;
+    case LY_TYPE_STRING:
+        stats->type_mem += lys_mem_restr(type->info.str.length, type->info.str.length ? 1 : 0, stats);
+        stats->type_mem += lys_mem_restr(type->info.str.patterns, type->info.str.pat_count, stats);
+        break;
+    case LY_TYPE_UNION:
+        stats->type_mem += type->info.uni.count * sizeof *type->info.uni.types;
+        for (i = 0; i < type->info.uni.count; ++i) {
+            lys_mem_type(&type->info.uni.types[i], stats);
+        }
+        break;
+    case LY_TYPE_INT8:
+    case LY_TYPE_UINT8:
+    case LY_TYPE_INT16:
+    case LY_TYPE_UINT16:
+    case LY_TYPE_INT32:
+    case LY_TYPE_UINT32:
+    case LY_TYPE_INT64:
+    case LY_TYPE_UINT64:
+        stats->type_mem += lys_mem_restr(type->info.num.range, type->info.num.range ? 1 : 0, stats);
+        break;
+    default:
+        /* no allocated restrictions */
+        break;
+    }
+}
+
+static void
+lys_mem_tpdf(struct lys_tpdf *tpdf, uint16_t tpdf_size, struct lys_mem_stats *stats)
+{
+    uint16_t i;
+
+    stats->type_mem += tpdf_size * sizeof *tpdf;
+    for (i = 0; i < tpdf_size; ++i) {
+        stats->ext_mem += lys_mem_ext(tpdf[i].ext, tpdf[i].ext_size);
+        lys_mem_type(&tpdf[i].type, stats);
+    }
+}
+
+static void lys_mem_node_r(struct lys_node *node, struct lys_mem_stats *stats);
+
+static void
+lys_mem_augment(struct lys_node_augment *aug, uint8_t augment_size, struct lys_mem_stats *stats)
+{
+    struct lys_node *child;
+    uint8_t i;
+
+    for (i = 0; i < augment_size; ++i) {
+        ++stats->nodes;
+        stats->ext_mem += lys_mem_ext(aug[i].ext, aug[i].ext_size);
+        lys_mem_iffeature(aug[i].iffeature, aug[i].iffeature_size, stats);
+        lys_mem_when(aug[i].when, stats);
+
+        /* the augmenting nodes are connected into the target children */
+        for (child = aug[i].child; child && (child->parent == (struct lys_node *)&aug[i]); child = child->next) {
+            lys_mem_node_r(child, stats);
+        }
+    }
+    stats->node_mem += augment_size * sizeof *aug;
+}
+
+static void
+lys_mem_node_r(struct lys_node *node, struct lys_mem_stats *stats)
+{
+    struct lys_node *child;
+    struct lys_node_container *cont;
+    struct lys_node_leaf *leaf;
+    struct lys_node_leaflist *llist;
+    struct lys_node_list *list;
+    struct lys_node_anydata *any;
+    struct lys_node_uses *uses;
+    struct lys_node_grp *grp;
+    struct lys_node_case *cs;
+    struct lys_node_choice *choice;
+    struct lys_node_inout *io;
+    struct lys_node_notif *ntf;
+    struct lys_node_rpc_action *rpc;
+    uint8_t i;
+    int children = 1;
+
+    ++stats->nodes;
+    stats->ext_mem += lys_mem_ext(node->ext, node->ext_size);
+    lys_mem_iffeature(node->iffeature, node->iffeature_size, stats);
+
+    switch (node->nodetype) {
+    case LYS_CONTAINER:
+        cont = (struct lys_node_container *)node;
+        stats->node_mem += sizeof *cont;
+        lys_mem_when(cont->when, stats);
+        stats->restr_mem += lys_mem_restr(cont->must, cont->must_size, stats);
+        lys_mem_tpdf(cont->tpdf, cont->tpdf_size, stats);
+        break;
+    case LYS_CHOICE:
+        choice = (struct lys_node_choice *)node;
+        stats->node_mem += sizeof *choice;
+        lys_mem_when(choice->when, stats);
+        break;
+    case LYS_LEAF:
+        leaf = (struct lys_node_leaf *)node;
+        stats->node_mem += sizeof *leaf;
+        lys_mem_when(leaf->when, stats);
+        stats->restr_mem += lys_mem_restr(leaf->must, leaf->must_size, stats);
+        lys_mem_type(&leaf->type, stats);
+        children = 0;
+        break;
+    case LYS_LEAFLIST:
+        llist = (struct lys_node_leaflist *)node;
+        stats->node_mem += sizeof *llist + llist->dflt_size * sizeof *llist->dflt;
+        lys_mem_when(llist->when, stats);
+        stats->restr_mem += lys_mem_restr(llist->must, llist->must_size, stats);
+        lys_mem_type(&llist->type, stats);
+        children = 0;
+        break;
+    case LYS_LIST:
+        list = (struct lys_node_list *)node;
+        stats->node_mem += sizeof *list + list->keys_size * sizeof *list->keys;
+        lys_mem_when(list->when, stats);
+        stats->restr_mem += lys_mem_restr(list->must, list->must_size, stats);
+        stats->restr_mem += list->unique_size * sizeof *list->unique;
+        for (i = 0; i < list->unique_size; ++i) {
+            stats->restr_mem += list->unique[i].expr_size * sizeof *list->unique[i].expr;
+        }
+        lys_mem_tpdf(list->tpdf, list->tpdf_size, stats);
+        break;
+    case LYS_ANYXML:
+    case LYS_ANYDATA:
+        any = (struct lys_node_anydata *)node;
+        stats->node_mem += sizeof *any;
+        lys_mem_when(any->when, stats);
+        stats->restr_mem += lys_mem_restr(any->must, any->must_size, stats);
+        children = 0;
+        break;
+    case LYS_USES:
+        uses = (struct lys_node_uses *)node;
+        stats->node_mem += sizeof *uses;
+        lys_mem_when(uses->when, stats);
+        stats->restr_mem += uses->refine_size * sizeof *uses->refine;
+        for (i = 0; i < uses->refine_size; ++i) {
+            stats->restr_mem += lys_mem_restr(uses->refine[i].must, uses->refine[i].must_size, stats);
+            stats->restr_mem += uses->refine[i].dflt_size * sizeof *uses->refine[i].dflt;
+            lys_mem_iffeature(uses->refine[i].iffeature, uses->refine[i].iffeature_size, stats);
+            stats->ext_mem += lys_mem_ext(uses->refine[i].ext, uses->refine[i].ext_size);
+        }
+        lys_mem_augment(uses->augment, uses->augment_size, stats);
+        break;
+    case LYS_GROUPING:
+        grp = (struct lys_node_grp *)node;
+        stats->node_mem += sizeof *grp;
+        lys_mem_tpdf(grp->tpdf, grp->tpdf_size, stats);
+        break;
+    case LYS_CASE:
+        cs = (struct lys_node_case *)node;
+        stats->node_mem += sizeof *cs;
+        lys_mem_when(cs->when, stats);
+        break;
+    case LYS_INPUT:
+    case LYS_OUTPUT:
+        io = (struct lys_node_inout *)node;
+        stats->node_mem += sizeof *io;
+        stats->restr_mem += lys_mem_restr(io->must, io->must_size, stats);
+        lys_mem_tpdf(io->tpdf, io->tpdf_size, stats);
+        break;
+    case LYS_NOTIF:
+        ntf = (struct lys_node_notif *)node;
+        stats->node_mem += sizeof *ntf;
+        stats->restr_mem += lys_mem_restr(ntf->must, ntf->must_size, stats);
+        lys_mem_tpdf(ntf->tpdf, ntf->tpdf_size, stats);
+        break;
+    case LYS_RPC:
+    case LYS_ACTION:
+        rpc = (struct lys_node_rpc_action *)node;
+        stats->node_mem += sizeof *rpc;
+        lys_mem_tpdf(rpc->tpdf, rpc->tpdf_size, stats);
+        break;
+    default:
+        stats->node_mem += sizeof *node;
+        break;
+    }
+
+    if (children) {
+        /* skip the nodes augmenting this one, they are counted with their augment */
+        LY_TREE_FOR(node->child, child) {
+            if (child->parent == node) {
+                lys_mem_node_r(child, stats);
+            }
+        }
+    }
+}
+
+static void
+lys_mem_module(const struct lys_module *module, struct lys_mem_stats *stats)
+{
+    struct lys_node *node;
+    uint16_t i;
+    uint8_t j;
+
+    stats->module_mem += module->type ? sizeof(struct lys_submodule) : sizeof *module;
+    stats->ext_mem += lys_mem_ext(module->ext, module->ext_size);
+
+    stats->module_mem += module->rev_size * sizeof *module->rev;
+    for (i = 0; i < module->rev_size; ++i) {
+        stats->ext_mem += lys_mem_ext(module->rev[i].ext, module->rev[i].ext_size);
+    }
+    stats->module_mem += module->imp_size * sizeof *module->imp;
+    for (i = 0; i < module->imp_size; ++i) {
+        stats->ext_mem += lys_mem_ext(module->imp[i].ext, module->imp[i].ext_size);
+    }
+    stats->module_mem += module->ident_size * sizeof *module->ident;
+    for (i = 0; i < module->ident_size; ++i) {
+        stats->module_mem += module->ident[i].base_size * sizeof *module->ident[i].base;
+        if (module->ident[i].der) {
+            stats->module_mem += sizeof *module->ident[i].der + module->ident[i].der->size * sizeof(void *);
+        }
+        lys_mem_iffeature(module->ident[i].iffeature, module->ident[i].iffeature_size, stats);
+        stats->ext_mem += lys_mem_ext(module->ident[i].ext, module->ident[i].ext_size);
+    }
+    stats->module_mem += module->features_size * sizeof *module->features;
+    for (i = 0; i < module->features_size; ++i) {
+        if (module->features[i].depfeatures) {
+            stats->module_mem += sizeof *module->features[i].depfeatures
+                    + module->features[i].depfeatures->size * sizeof(void *);
+        }
+        lys_mem_iffeature(module->features[i].iffeature, module->features[i].iffeature_size, stats);
+        stats->ext_mem += lys_mem_ext(module->features[i].ext, module->features[i].ext_size);
+    }
+    stats->module_mem += module->deviation_size * sizeof *module->deviation;
+    for (i = 0; i < module->deviation_size; ++i) {
+        stats->module_mem += module->deviation[i].deviate_size * sizeof *module->deviation[i].deviate;
+        for (j = 0; j < module->deviation[i].deviate_size; ++j) {
+            stats->restr_mem += lys_mem_restr(module->deviation[i].deviate[j].must,
+                                              module->deviation[i].deviate[j].must_size, stats);
+            stats->module_mem += module->deviation[i].deviate[j].dflt_size * sizeof *module->deviation[i].deviate[j].dflt;
+            stats->ext_mem += lys_mem_ext(module->deviation[i].deviate[j].ext, module->deviation[i].deviate[j].ext_size);
+        }
+        stats->ext_mem += lys_mem_ext(module->deviation[i].ext, module->deviation[i].ext_size);
+    }
+    stats->module_mem += module->extensions_size * sizeof *module->extensions;
+    for (i = 0; i < module->extensions_size; ++i) {
+        stats->ext_mem += lys_mem_ext(module->extensions[i].ext, module->extensions[i].ext_size);
+    }
+
+    lys_mem_tpdf(module->tpdf, module->tpdf_size, stats);
+    lys_mem_augment(module->augment, module->augment_size, stats);
+
+    if (!module->type) {
+        LY_TREE_FOR(module->data, node) {
+            lys_mem_node_r(node, stats);
+        }
+    }
+}
+
+API int
+lys_mem_usage(const struct lys_module *module, struct lys_mem_stats *stats)
+{
+    FUN_IN;
+
+    uint8_t i;
+
+    if (!module || !stats) {
+        LOGARG;
+        return EXIT_FAILURE;
+    }
+
+    lys_mem_module(module, stats);
+
+    stats->module_mem += module->inc_size * sizeof *module->inc;
+    for (i = 0; i < module->inc_size; ++i) {
+        stats->ext_mem += lys_mem_ext(module->inc[i].ext, module->inc[i].ext_size);
+        if (module->inc[i].submodule) {
+            /* the data of the submodules are connected into the main module */
+            lys_mem_module((struct lys_module *)module->inc[i].submodule, stats);
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
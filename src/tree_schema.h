@@ -619,9 +619,10 @@ const char * const *ly_get_loaded_plugins(void);
  */
 void ly_load_plugins(void);
 
-/* don't need the contents of these types, just forward-declare them for the next 2 functions. */
+/* don't need the contents of these types, just forward-declare them for the next 3 functions. */
 struct lyext_plugin_list;
 struct lytype_plugin_list;
+struct lyxp_func_list;
 
 /**
  * @brief Directly register a YANG extension by pointer.
@@ -636,10 +637,19 @@ int ly_register_exts(struct lyext_plugin_list *plugin, const char *log_name);
 /**
  * @brief Directly register a YANG type by pointer.
  *
- * This is the analog of ly_register_exts(), for types instead of extensions.
+ * This is the analog of ly_register_exts(), for types instead of extensions. The plugins of the types are looked up
+ * when the schemas are loaded, so the types of the already loaded schemas are not affected.
  */
 int ly_register_types(struct lytype_plugin_list *plugin, const char *log_name);
 
+/**
+ * @brief Directly register user XPath functions by pointer, see @ref user_xpath.
+ *
+ * The functions are looked up when the expressions are evaluated, the array of the functions terminated
+ * by an item with NULL name is copied.
+ */
+int ly_register_xpath_funcs(struct lyxp_func_list *funcs, const char *log_name);
+
 /**
  * @brief Unload all the YANG extension and type plugins.
  *
@@ -820,6 +830,10 @@ typedef enum {
 struct lys_type_info_binary {
     struct lys_restr *length;    /**< length restriction (optional), see
                                       [RFC 6020 sec. 9.4.4](http://tools.ietf.org/html/rfc6020#section-9.4.4) */
+#ifdef LY_ENABLED_CACHE
+    void *length_chk;            /**< compiled length restrictions of the type and its base types to optimize value
+                                      checks. For internal use only. */
+#endif
 };
 
 /**
@@ -860,6 +874,10 @@ struct lys_type_info_dec64 {
                                   That's because the value is inherited for simpler access to the value and easier
                                   manipulation with the decimal64 data */
     uint64_t div;            /**< auxiliary value for moving decimal point (dividing the stored value to get the real value) */
+#ifdef LY_ENABLED_CACHE
+    void *range_chk;         /**< compiled range restrictions of the type and its base types to optimize value checks.
+                                  For internal use only. */
+#endif
 };
 
 /**
@@ -914,6 +932,10 @@ struct lys_type_info_inst {
 struct lys_type_info_num {
     struct lys_restr *range; /**< range restriction (optional), see
                                   [RFC 6020 sec. 9.2.4](http://tools.ietf.org/html/rfc6020#section-9.2.4) */
+#ifdef LY_ENABLED_CACHE
+    void *range_chk;         /**< compiled range restrictions of the type and its base types to optimize value checks.
+                                  For internal use only. */
+#endif
 };
 
 /**
@@ -946,6 +968,8 @@ struct lys_type_info_str {
     void **patterns_pcre;    /**< array of compiled patterns to optimize its evaluation, represented as
                                   array of pointers to results of pcre_compile() and pcre_study().
                                   For internal use only. */
+    void *length_chk;        /**< compiled length restrictions of the type and its base types to optimize value
+                                  checks. For internal use only. */
 #endif
 };
 
@@ -1078,6 +1102,10 @@ struct lys_type {
 struct lys_iffeature {
     uint8_t *expr;                   /**< 2bits array describing the if-feature expression in prefix format */
     uint8_t ext_size;                /**< number of elements in #ext array */
+#ifdef LY_ENABLED_CACHE
+    uint32_t value_cache;            /**< value of the expression (the lowest bit) and the feature set ID of the context
+                                          it is valid for (the other bits), 0 if not yet evaluated */
+#endif
     struct lys_feature **features;   /**< array of pointers to the features used in expression */
     struct lys_ext_instance **ext;   /**< array of pointers to the extension instances */
 };
@@ -1183,6 +1211,9 @@ struct lys_iffeature {
 #define LYS_VALID_EXT    0x2000      /**< flag marking nodes that need to be validated using an extension validation function */
 #define LYS_VALID_EXT_SUBTREE 0x4000 /**< flag marking nodes that need to be validated using an extension
                                           validation function when one of their children nodes is modified */
+#define LYS_VALID_EXT_TYPE 0x8000    /**< flag marking leaves, leaf-lists and typedefs whose type (or any of the
+                                          types it is derived from) has an extension validation function, so
+                                          the type chain is walked only for these */
 
 /**
  * @}
@@ -1233,6 +1264,9 @@ struct lys_node {
     struct lys_module *module;       /**< pointer to the node's module (mandatory) */
 
     LYS_NODE nodetype;               /**< type of the node (mandatory) */
+#if defined(LY_ENABLED_CACHE) && defined(LY_ENABLED_COMPACT_SCHEMA)
+    uint8_t hash[LYS_NODE_HASH_COUNT]; /**< schema hash required for LYB printer/parser */
+#endif
     struct lys_node *parent;         /**< pointer to the parent node, NULL in case of a top level node */
     struct lys_node *child;          /**< pointer to the first child node \note Since other lys_node_*
                                           structures represent end nodes, this member
@@ -1246,7 +1280,7 @@ struct lys_node {
 
     void *priv;                      /**< private caller's data, not used by libyang */
 
-#ifdef LY_ENABLED_CACHE
+#if defined(LY_ENABLED_CACHE) && !defined(LY_ENABLED_COMPACT_SCHEMA)
     uint8_t hash[LYS_NODE_HASH_COUNT]; /**< schema hash required for LYB printer/parser */
 #endif
 };
@@ -1278,6 +1312,9 @@ struct lys_node_container {
     struct lys_module *module;       /**< pointer to the node's module (mandatory) */
 
     LYS_NODE nodetype;               /**< type of the node (mandatory) - #LYS_CONTAINER */
+#if defined(LY_ENABLED_CACHE) && defined(LY_ENABLED_COMPACT_SCHEMA)
+    uint8_t hash[LYS_NODE_HASH_COUNT]; /**< schema hash required for LYB printer/parser */
+#endif
     struct lys_node *parent;         /**< pointer to the parent node, NULL in case of a top level node */
     struct lys_node *child;          /**< pointer to the first child node */
     struct lys_node *next;           /**< pointer to the next sibling node (NULL if there is no one) */
@@ -1288,7 +1325,7 @@ struct lys_node_container {
 
     void *priv;                      /**< private caller's data, not used by libyang */
 
-#ifdef LY_ENABLED_CACHE
+#if defined(LY_ENABLED_CACHE) && !defined(LY_ENABLED_COMPACT_SCHEMA)
     uint8_t hash[LYS_NODE_HASH_COUNT]; /**< schema hash required for LYB printer/parser */
 #endif
 
@@ -1367,6 +1404,9 @@ struct lys_node_leaf {
     struct lys_module *module;       /**< pointer to the node's module (mandatory) */
 
     LYS_NODE nodetype;               /**< type of the node (mandatory) - #LYS_LEAF */
+#if defined(LY_ENABLED_CACHE) && defined(LY_ENABLED_COMPACT_SCHEMA)
+    uint8_t hash[LYS_NODE_HASH_COUNT]; /**< schema hash required for LYB printer/parser */
+#endif
     struct lys_node *parent;         /**< pointer to the parent node, NULL in case of a top level node */
     struct ly_set *backlinks;        /**< replacement for ::lys_node's child member, it is NULL except the leaf/leaflist
                                           is target of a leafref. In that case the set stores ::lys_node leafref objects
@@ -1379,7 +1419,7 @@ struct lys_node_leaf {
 
     void *priv;                      /**< private caller's data, not used by libyang */
 
-#ifdef LY_ENABLED_CACHE
+#if defined(LY_ENABLED_CACHE) && !defined(LY_ENABLED_COMPACT_SCHEMA)
     uint8_t hash[LYS_NODE_HASH_COUNT]; /**< schema hash required for LYB printer/parser */
 #endif
 
@@ -1421,6 +1461,9 @@ struct lys_node_leaflist {
     struct lys_module *module;       /**< pointer to the node's module (mandatory) */
 
     LYS_NODE nodetype;               /**< type of the node (mandatory) - #LYS_LEAFLIST */
+#if defined(LY_ENABLED_CACHE) && defined(LY_ENABLED_COMPACT_SCHEMA)
+    uint8_t hash[LYS_NODE_HASH_COUNT]; /**< schema hash required for LYB printer/parser */
+#endif
     struct lys_node *parent;         /**< pointer to the parent node, NULL in case of a top level node */
     struct ly_set *backlinks;        /**< replacement for ::lys_node's child member, it is NULL except the leaf/leaflist
                                           is target of a leafref. In that case the set stores ::lys_node leafref objects
@@ -1433,7 +1476,7 @@ struct lys_node_leaflist {
 
     void *priv;                      /**< private caller's data, not used by libyang */
 
-#ifdef LY_ENABLED_CACHE
+#if defined(LY_ENABLED_CACHE) && !defined(LY_ENABLED_COMPACT_SCHEMA)
     uint8_t hash[LYS_NODE_HASH_COUNT]; /**< schema hash required for LYB printer/parser */
 #endif
 
@@ -1478,6 +1521,9 @@ struct lys_node_list {
     struct lys_module *module;       /**< pointer to the node's module (mandatory) */
 
     LYS_NODE nodetype;               /**< type of the node (mandatory) - #LYS_LIST */
+#if defined(LY_ENABLED_CACHE) && defined(LY_ENABLED_COMPACT_SCHEMA)
+    uint8_t hash[LYS_NODE_HASH_COUNT]; /**< schema hash required for LYB printer/parser */
+#endif
     struct lys_node *parent;         /**< pointer to the parent node, NULL in case of a top level node */
     struct lys_node *child;          /**< pointer to the first child node */
     struct lys_node *next;           /**< pointer to the next sibling node (NULL if there is no one) */
@@ -1488,7 +1534,7 @@ struct lys_node_list {
 
     void *priv;                      /**< private caller's data, not used by libyang */
 
-#ifdef LY_ENABLED_CACHE
+#if defined(LY_ENABLED_CACHE) && !defined(LY_ENABLED_COMPACT_SCHEMA)
     uint8_t hash[LYS_NODE_HASH_COUNT]; /**< schema hash required for LYB printer/parser */
 #endif
 
@@ -1535,6 +1581,9 @@ struct lys_node_anydata {
     struct lys_module *module;       /**< pointer to the node's module (mandatory) */
 
     LYS_NODE nodetype;               /**< type of the node (mandatory) - #LYS_ANYDATA or #LYS_ANYXML */
+#if defined(LY_ENABLED_CACHE) && defined(LY_ENABLED_COMPACT_SCHEMA)
+    uint8_t hash[LYS_NODE_HASH_COUNT]; /**< schema hash required for LYB printer/parser */
+#endif
     struct lys_node *parent;         /**< pointer to the parent node, NULL in case of a top level node */
     struct lys_node *child;          /**< always NULL */
     struct lys_node *next;           /**< pointer to the next sibling node (NULL if there is no one) */
@@ -1545,7 +1594,7 @@ struct lys_node_anydata {
 
     void *priv;                      /**< private caller's data, not used by libyang */
 
-#ifdef LY_ENABLED_CACHE
+#if defined(LY_ENABLED_CACHE) && !defined(LY_ENABLED_COMPACT_SCHEMA)
     uint8_t hash[LYS_NODE_HASH_COUNT]; /**< schema hash required for LYB printer/parser */
 #endif
 
@@ -1753,6 +1802,9 @@ struct lys_node_notif {
     struct lys_module *module;       /**< pointer to the node's module (mandatory) */
 
     LYS_NODE nodetype;               /**< type of the node (mandatory) - #LYS_NOTIF */
+#if defined(LY_ENABLED_CACHE) && defined(LY_ENABLED_COMPACT_SCHEMA)
+    uint8_t hash[LYS_NODE_HASH_COUNT]; /**< schema hash required for LYB printer/parser */
+#endif
     struct lys_node *parent;         /**< pointer to the parent node, NULL in case of a top level node */
     struct lys_node *child;          /**< pointer to the first child node */
     struct lys_node *next;           /**< pointer to the next sibling node (NULL if there is no one) */
@@ -1763,7 +1815,7 @@ struct lys_node_notif {
 
     void *priv;                      /**< private caller's data, not used by libyang */
 
-#ifdef LY_ENABLED_CACHE
+#if defined(LY_ENABLED_CACHE) && !defined(LY_ENABLED_COMPACT_SCHEMA)
     uint8_t hash[LYS_NODE_HASH_COUNT]; /**< schema hash required for LYB printer/parser */
 #endif
 
@@ -1799,6 +1851,9 @@ struct lys_node_rpc_action {
     struct lys_module *module;       /**< pointer to the node's module (mandatory) */
 
     LYS_NODE nodetype;               /**< type of the node (mandatory) - #LYS_RPC or #LYS_ACTION */
+#if defined(LY_ENABLED_CACHE) && defined(LY_ENABLED_COMPACT_SCHEMA)
+    uint8_t hash[LYS_NODE_HASH_COUNT]; /**< schema hash required for LYB printer/parser */
+#endif
     struct lys_node *parent;         /**< pointer to the parent node, NULL in case of a top level node */
     struct lys_node *child;          /**< pointer to the first child node */
     struct lys_node *next;           /**< pointer to the next sibling node (NULL if there is no one) */
@@ -1809,7 +1864,7 @@ struct lys_node_rpc_action {
 
     void *priv;                      /**< private caller's data, not used by libyang */
 
-#ifdef LY_ENABLED_CACHE
+#if defined(LY_ENABLED_CACHE) && !defined(LY_ENABLED_COMPACT_SCHEMA)
     uint8_t hash[LYS_NODE_HASH_COUNT]; /**< schema hash required for LYB printer/parser */
 #endif
 
@@ -1956,6 +2011,10 @@ struct lys_deviation {
     const char *dsc;                  /**< description (optional) */
     const char *ref;                  /**< reference (optional) */
     struct lys_node *orig_node;       /**< original (non-deviated) node (mandatory) */
+#ifdef LY_ENABLED_CACHE
+    struct lys_node *target;          /**< node the contents of #orig_node are switched with, remembered when
+                                           the deviation is switched for the first time (not for not-supported) */
+#endif
 
     uint8_t deviate_size;             /**< number of elements in the #deviate array */
     uint8_t ext_size;                 /**< number of elements in #ext array */
@@ -2022,6 +2081,8 @@ struct lys_tpdf {
     struct lys_type type;            /**< base type from which the typedef is derived (mandatory). In case of a special
                                           built-in typedef (from yang_types.c), only the base member is filled */
     const char *dflt;                /**< default value of the newly defined type (optional) */
+    struct lytype_plugin_list *plugin; /**< user type plugin of the typedef, found when a type derived from it is resolved,
+                                            NULL if there is none. For internal use only. */
 };
 
 /**
@@ -2344,6 +2405,15 @@ struct ly_set *lys_node_xpath_atomize(const struct lys_node *node, int options);
 #define LYXP_RECURSIVE 0x01 /**< lys_node_xpath_atomize() option to return schema node dependencies of all the expressions in the subtree */
 #define LYXP_NO_LOCAL 0x02  /**< lys_node_xpath_atomize() option to discard schema node dependencies from the local subtree */
 
+/**
+ * @brief Get all the schema nodes with when or must expressions that depend on \p node, meaning it is
+ * one of their atoms (see lys_node_xpath_atomize()). Only the implemented modules are considered.
+ *
+ * @param[in] node Node to examine.
+ * @return Set of the dependent schema nodes (can be empty), NULL on error.
+ */
+struct ly_set *lys_xpath_dependents(const struct lys_node *node);
+
 /**
  * @brief Build schema path (usable as path, see @ref howtoxpath) of the schema node.
  *
@@ -2490,6 +2560,9 @@ void *lys_set_private(const struct lys_node *node, void *priv);
  * @brief Print schema tree in the specified format into a memory block.
  * It is up to caller to free the returned string by free().
  *
+ * A whole module printed (with no \p target_node) is cached in the context, so printing it again in the same format
+ * and with the same options only copies the output, until a module is added or removed or any features change.
+ *
  * @param[out] strp Pointer to store the resulting dump.
  * @param[in] module Schema tree to print.
  * @param[in] format Schema output format.
@@ -2563,6 +2636,32 @@ int lys_print_path(const char *path, const struct lys_module *module, LYS_OUTFOR
 int lys_print_clb(ssize_t (*writeclb)(void *arg, const void *buf, size_t count), void *arg,
                   const struct lys_module *module, LYS_OUTFORMAT format, const char *target_node, int line_length, int options);
 
+/**
+ * @brief Memory used by a schema, see lys_mem_usage().
+ */
+struct lys_mem_stats {
+    uint32_t nodes;                  /**< number of the schema nodes (including groupings, uses, augments and the nodes
+                                          instantiated from groupings) */
+    size_t node_mem;                 /**< memory of the node structures */
+    size_t restr_mem;                /**< memory of the must, when, if-feature, unique and refine statements */
+    size_t type_mem;                 /**< memory of the typedefs and the type restrictions */
+    size_t ext_mem;                  /**< memory of the extension instances */
+    size_t module_mem;               /**< memory of the module structures and their revisions, imports, includes, identities,
+                                          features, deviations and extension definitions */
+};
+
+/**
+ * @brief Get the memory used by a schema and its submodules.
+ *
+ * The statistics are added to \p stats so they can be summed over several modules. The strings are stored
+ * in the context dictionary and are not included, neither are the compiled patterns and range restrictions.
+ *
+ * @param[in] module Schema to examine.
+ * @param[in,out] stats Statistics to add to, must be initialized.
+ * @return EXIT_SUCCESS or EXIT_FAILURE on invalid arguments.
+ */
+int lys_mem_usage(const struct lys_module *module, struct lys_mem_stats *stats);
+
 /** @} */
 
 #ifdef __cplusplus
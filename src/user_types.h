@@ -30,13 +30,13 @@ extern "C" {
 /**
  * @brief User types API version
  */
-#define LYTYPE_API_VERSION 1
+#define LYTYPE_API_VERSION 2
 
 /**
  * @brief Macro to store version of user type plugins API in the plugins.
  * It is matched when the plugin is being loaded by libyang.
  */
-#ifdef STATIC
+#if defined(STATIC) || defined(LY_BUILTIN_PLUGINS)
 #define LYTYPE_VERSION_CHECK
 #else
 #define LYTYPE_VERSION_CHECK int lytype_api_version = LYTYPE_API_VERSION;
@@ -59,6 +59,55 @@ extern "C" {
 typedef int (*lytype_store_clb)(struct ly_ctx *ctx, const char *type_name, const char **value_str, lyd_val *value,
                                 char **err_msg);
 
+/**
+ * @brief Optional callback for comparing two stored user type values.
+ *
+ * It is used instead of comparing the string values whenever both compared values were stored by the plugin.
+ *
+ * @param[in] value1 First stored value.
+ * @param[in] value2 Second stored value.
+ * @return 0 if the values are equal, non-zero otherwise.
+ */
+typedef int (*lytype_compare_clb)(const lyd_val *value1, const lyd_val *value2);
+
+/**
+ * @brief Optional callback providing the data to be hashed instead of the string value of a stored user type value.
+ *
+ * Values equal according to the compare callback must provide the same data. Hashes of list instances searched
+ * by a path with predicates are also computed from the data of the predicate values stored by the plugin.
+ *
+ * @param[in] value Stored value.
+ * @param[out] len Length of the returned data.
+ * @return Data to be hashed, must stay valid as long as \p value.
+ */
+typedef const void *(*lytype_hash_clb)(const lyd_val *value, size_t *len);
+
+/**
+ * @brief Optional callback encoding a stored user type value for LYB data.
+ *
+ * @param[in] value Stored value.
+ * @param[out] buf Buffer for the encoded value.
+ * @param[in] size Size of \p buf, the encoded value is written only if it fits.
+ * @return Length of the whole encoded value (at most 65535 bytes) even if larger than \p size,
+ * 0 if the value should be printed as its string.
+ */
+typedef size_t (*lytype_encode_clb)(const lyd_val *value, uint8_t *buf, size_t size);
+
+/**
+ * @brief Callback for decoding a user type value from LYB data, mandatory together with the encode callback.
+ *
+ * @param[in] ctx libyang ctx to enable correct manipulation with values that are in the dictionary.
+ * @param[in] type_name Name of the type being decoded.
+ * @param[in] data Data created by the encode callback.
+ * @param[in] len Length of \p data.
+ * @param[out] value_str Canonical string value of the decoded value, to be inserted into the dictionary.
+ * @param[out] value Value union for the decoded value to be stored in, as if stored by the store callback.
+ * @param[out] err_msg Can be filled on error. If not, a generic error message will be printed.
+ * @return 0 on success, non-zero if an error occurred and the value could not be decoded.
+ */
+typedef int (*lytype_decode_clb)(struct ly_ctx *ctx, const char *type_name, const void *data, size_t len,
+                                 const char **value_str, lyd_val *value, char **err_msg);
+
 struct lytype_plugin_list {
     const char *module;          /**< Name of the module where the type is defined. */
     const char *revision;        /**< Optional module revision - if not specified, the plugin applies to any revision,
@@ -69,8 +118,28 @@ struct lytype_plugin_list {
     const char *name;            /**< Name of the type to be stored in a custom way. */
     lytype_store_clb store_clb;  /**< Callback used for storing values of this type. */
     void (*free_clb)(void *ptr); /**< Callback used for freeing values of this type. */
+    lytype_compare_clb compare_clb; /**< Optional callback for comparing values of this type. */
+    lytype_hash_clb hash_clb;    /**< Optional callback for hashing values of this type. */
+    lytype_encode_clb encode_clb; /**< Optional callback for encoding values of this type in LYB data. */
+    lytype_decode_clb decode_clb; /**< Callback for decoding values of this type from LYB data, set with \p encode_clb. */
 };
 
+/**
+ * @brief Binary value of the ietf-inet-types address and prefix typedefs stored by the bundled plugin
+ * in lyd_val.ptr. A possible zone index of an address is kept only in the string value.
+ */
+struct lytype_inet_addr {
+    uint8_t family;              /**< AF_INET or AF_INET6 */
+    uint8_t prefix;              /**< prefix length of a prefix typedef, full address length (32 or 128) otherwise */
+    uint8_t addr[16];            /**< address in the network byte order, an IPv4 address uses only the first 4 bytes */
+};
+
+/*
+ * The bundled ietf-yang-types plugin stores mac-address values in lyd_val.uint64 with the first octet
+ * in the most significant used byte and date-and-time values in lyd_val.int64 as the number of seconds
+ * since the Epoch in UTC (fractions of a second are kept only in the string value).
+ */
+
 /**
  * @}
  */
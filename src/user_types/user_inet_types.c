@@ -1,7 +1,7 @@
 /**
  * @file user_inet_types.c
  * @author Michal Vasko <mvasko@cesnet.cz>
- * @brief ietf-inet-types typedef conversion to canonical format
+ * @brief ietf-inet-types typedef conversion to binary and canonical format
  *
  * Copyright (c) 2018 CESNET, z.s.p.o.
  *
@@ -34,102 +34,113 @@ LYTYPE_VERSION_CHECK
 #  define UNUSED(x) UNUSED_ ## x
 #endif
 
-static char *
-convert_ipv6_addr(const char *ipv6_addr, char **err_msg)
+/**
+ * @brief Store the binary form of an address and update the string value to the canonical form created from it.
+ *
+ * @param[in] ctx libyang context.
+ * @param[in,out] value_str String value to be updated.
+ * @param[out] value Value union to store the binary form in.
+ * @param[in] addr Binary form of the address.
+ * @param[in] suffix Zone index or prefix length to append to the canonical address.
+ * @param[out] err_msg Error message.
+ * @return 0 on success, non-zero on error.
+ */
+static int
+inet_store(struct ly_ctx *ctx, const char **value_str, lyd_val *value, const struct lytype_inet_addr *addr,
+           const char *suffix, char **err_msg)
 {
-    char buf[sizeof(struct in6_addr)], *str;
+    char buf[INET6_ADDRSTRLEN], *result;
+    struct lytype_inet_addr *bin;
 
-    str = malloc(INET6_ADDRSTRLEN);
-    if (!str) {
+    /* convert back to string */
+    if (!inet_ntop(addr->family, addr->addr, buf, sizeof buf)) {
+        if (asprintf(err_msg, "Failed to convert %s address (%s).", (addr->family == AF_INET6) ? "IPv6" : "IPv4",
+                     strerror(errno)) == -1) {
+            *err_msg = NULL;
+        }
+        return 1;
+    }
+    if (asprintf(&result, "%s%s", buf, suffix) == -1) {
         *err_msg = NULL;
-        return NULL;
+        return 1;
     }
 
-    if (!inet_pton(AF_INET6, ipv6_addr, buf)) {
-        if (asprintf(err_msg, "Failed to convert IPv6 address \"%s\".", ipv6_addr) == -1) {
-            *err_msg = NULL;
-        }
-        free(str);
-        return NULL;
+    bin = malloc(sizeof *bin);
+    if (!bin) {
+        free(result);
+        *err_msg = NULL;
+        return 1;
     }
+    memcpy(bin, addr, sizeof *bin);
 
-    if (!inet_ntop(AF_INET6, buf, str, INET6_ADDRSTRLEN)) {
-        if (asprintf(err_msg, "Failed to convert IPv6 address (%s).", strerror(errno)) == -1) {
-            *err_msg = NULL;
+    if (!*value_str || strcmp(result, *value_str)) {
+        /* some conversion took place, update the value */
+        if (*value_str) {
+            lydict_remove(ctx, *value_str);
         }
-        free(str);
-        return NULL;
+        *value_str = lydict_insert_zc(ctx, result);
+    } else {
+        free(result);
     }
+    value->ptr = bin;
 
-    return str;
+    return 0;
 }
 
 static int
 ip_store_clb(struct ly_ctx *ctx, const char *UNUSED(type_name), const char **value_str, lyd_val *value, char **err_msg)
 {
-    char *ptr, *ipv6_addr, *result, *tmp;
-
-    if (!strchr(*value_str, ':')) {
-        /* not an IPv6 address */
-        return 0;
-    }
+    struct lytype_inet_addr addr;
+    const char *zone;
+    char *addr_str;
 
-    if ((ptr = strchr(*value_str, '%'))) {
-        /* there is a zone index */
-        ipv6_addr = strndup(*value_str, ptr - *value_str);
+    memset(&addr, 0, sizeof addr);
+    if (strchr(*value_str, ':')) {
+        addr.family = AF_INET6;
+        addr.prefix = 128;
     } else {
-        ipv6_addr = (char *)*value_str;
+        addr.family = AF_INET;
+        addr.prefix = 32;
     }
 
-    /* convert to canonical format */
-    result = convert_ipv6_addr(ipv6_addr, err_msg);
-    if (ptr) {
-        free(ipv6_addr);
+    /* there may be a zone index */
+    zone = strchr(*value_str, '%');
+    if (zone) {
+        addr_str = strndup(*value_str, zone - *value_str);
+    } else {
+        addr_str = strdup(*value_str);
+        zone = "";
     }
-
-    /* failure */
-    if (!result) {
+    if (!addr_str) {
+        *err_msg = NULL;
         return 1;
     }
 
-    if (strncmp(*value_str, result, strlen(result))) {
-        /* some conversion took place, update the value */
-        if (ptr) {
-            tmp = result;
-            if (asprintf(&result, "%s%s", tmp, ptr) == -1) {
-                free(tmp);
-                *err_msg = NULL;
-                return 1;
-            }
-            free(tmp);
+    /* convert it to binary form */
+    if (inet_pton(addr.family, addr_str, addr.addr) != 1) {
+        if (asprintf(err_msg, "Failed to convert %s address \"%s\".", (addr.family == AF_INET6) ? "IPv6" : "IPv4",
+                     addr_str) == -1) {
+            *err_msg = NULL;
         }
-
-        lydict_remove(ctx, *value_str);
-        *value_str = lydict_insert_zc(ctx, result);
-        value->string = *value_str;
-    } else {
-        free(result);
+        free(addr_str);
+        return 1;
     }
+    free(addr_str);
 
-    return 0;
+    return inet_store(ctx, value_str, value, &addr, zone, err_msg);
 }
 
 static int
-ipv4_prefix_store_clb(struct ly_ctx *ctx, const char *UNUSED(type_name), const char **value_str, lyd_val *value, char **err_msg)
+prefix_store(struct ly_ctx *ctx, const char **value_str, lyd_val *value, int family, char **err_msg)
 {
-    char *pref_str, *ptr, *result;
-    uint32_t pref, addr_bin, i, mask;
-
-    if (sizeof addr_bin < sizeof(struct in_addr)) {
-        if (asprintf(err_msg, "Internal error (buffer too small for an ip address).") == -1) {
-            *err_msg = NULL;
-        }
-        return 1;
-    }
+    struct lytype_inet_addr addr;
+    const char *fam_str = (family == AF_INET6) ? "IPv6" : "IPv4";
+    char *pref_str, *ptr, *addr_str, suffix[5];
+    unsigned long int pref, i;
 
     pref_str = strchr(*value_str, '/');
     if (!pref_str) {
-        if (asprintf(err_msg, "Invalid IPv4 prefix \"%s\".", *value_str) == -1) {
+        if (asprintf(err_msg, "Invalid %s prefix \"%s\".", fam_str, *value_str) == -1) {
             *err_msg = NULL;
         }
         return 1;
@@ -137,168 +148,143 @@ ipv4_prefix_store_clb(struct ly_ctx *ctx, const char *UNUSED(type_name), const c
 
     /* learn prefix */
     pref = strtoul(pref_str + 1, &ptr, 10);
-    if (ptr[0] || (pref > 32)) {
-        if (asprintf(err_msg, "Invalid IPv4 prefix \"%s\".", *value_str) == -1) {
+    if (ptr[0] || (pref > ((family == AF_INET6) ? 128 : 32))) {
+        if (asprintf(err_msg, "Invalid %s prefix \"%s\".", fam_str, *value_str) == -1) {
             *err_msg = NULL;
         }
         return 1;
     }
 
-    result = malloc(INET_ADDRSTRLEN + 3);
-    if (!result) {
+    memset(&addr, 0, sizeof addr);
+    addr.family = family;
+    addr.prefix = pref;
+
+    /* copy just the network prefix */
+    addr_str = strndup(*value_str, pref_str - *value_str);
+    if (!addr_str) {
         *err_msg = NULL;
         return 1;
     }
 
-    /* copy just the network prefix */
-    strncpy(result, *value_str, pref_str - *value_str);
-    result[pref_str - *value_str] = '\0';
-
     /* convert it to binary form */
-    if (inet_pton(AF_INET, result, (void *)&addr_bin) != 1) {
-        if (asprintf(err_msg, "Failed to convert IPv4 address \"%s\".", result) == -1) {
+    if (inet_pton(family, addr_str, addr.addr) != 1) {
+        if (asprintf(err_msg, "Failed to convert %s address \"%s\".", fam_str, addr_str) == -1) {
             *err_msg = NULL;
         }
-        free(result);
+        free(addr_str);
         return 1;
     }
+    free(addr_str);
 
     /* zero host bits */
-    mask = 0;
-    for (i = 0; i < 32; ++i) {
-        mask <<= 1;
-        if (pref > i) {
-            mask |= 1;
+    for (i = pref / 8; i < sizeof addr.addr; ++i) {
+        if (i == pref / 8) {
+            addr.addr[i] &= (uint8_t)(0xff00 >> (pref % 8));
+        } else {
+            addr.addr[i] = 0;
         }
     }
-    mask = htonl(mask);
-    addr_bin &= mask;
 
-    /* convert back to string */
-    if (!inet_ntop(AF_INET, (void *)&addr_bin, result, INET_ADDRSTRLEN)) {
-        if (asprintf(err_msg, "Failed to convert IPv4 address (%s).", strerror(errno)) == -1) {
-            *err_msg = NULL;
-        }
-        free(result);
-        return 1;
-    }
-
-    /* add the prefix */
-    strcat(result, pref_str);
-
-    if (strcmp(result, *value_str)) {
-        /* some conversion took place, update the value */
-        lydict_remove(ctx, *value_str);
-        *value_str = lydict_insert_zc(ctx, result);
-        value->string = *value_str;
-    } else {
-        free(result);
-    }
+    sprintf(suffix, "/%lu", pref);
+    return inet_store(ctx, value_str, value, &addr, suffix, err_msg);
+}
 
-    return 0;
+static int
+ipv4_prefix_store_clb(struct ly_ctx *ctx, const char *UNUSED(type_name), const char **value_str, lyd_val *value, char **err_msg)
+{
+    return prefix_store(ctx, value_str, value, AF_INET, err_msg);
 }
 
 static int
 ipv6_prefix_store_clb(struct ly_ctx *ctx, const char *UNUSED(type_name), const char **value_str, lyd_val *value, char **err_msg)
 {
-    char *pref_str, *ptr, *result;
-    unsigned long int pref, i, j;
-    union {
-        struct in6_addr s;
-        uint32_t a[4];
-    } addr_bin;
-    uint32_t mask;
+    return prefix_store(ctx, value_str, value, AF_INET6, err_msg);
+}
 
-    pref_str = strchr(*value_str, '/');
-    if (!pref_str) {
-        if (asprintf(err_msg, "Invalid IPv6 prefix \"%s\".", *value_str) == -1) {
-            *err_msg = NULL;
-        }
-        return 1;
+static int
+ip_prefix_store_clb(struct ly_ctx *ctx, const char *type_name, const char **value_str, lyd_val *value, char **err_msg)
+{
+    if (strchr(*value_str, ':')) {
+        return ipv6_prefix_store_clb(ctx, type_name, value_str, value, err_msg);
     }
+    return ipv4_prefix_store_clb(ctx, type_name, value_str, value, err_msg);
+}
 
-    /* learn prefix */
-    pref = strtoul(pref_str + 1, &ptr, 10);
-    if (ptr[0] || (pref > 128)) {
-        if (asprintf(err_msg, "Invalid IPv6 prefix \"%s\".", *value_str) == -1) {
-            *err_msg = NULL;
-        }
-        return 1;
-    }
+static int
+inet_compare_clb(const lyd_val *value1, const lyd_val *value2)
+{
+    return memcmp(value1->ptr, value2->ptr, sizeof(struct lytype_inet_addr));
+}
 
-    result = malloc(INET6_ADDRSTRLEN + 4);
-    if (!result) {
-        *err_msg = NULL;
-        return 1;
-    }
+static const void *
+inet_hash_clb(const lyd_val *value, size_t *len)
+{
+    const struct lytype_inet_addr *addr = value->ptr;
 
-    /* copy just the network prefix */
-    strncpy(result, *value_str, pref_str - *value_str);
-    result[pref_str - *value_str] = '\0';
+    /* prefix length and the used address bytes, the family is given by the length */
+    *len = 1 + ((addr->family == AF_INET6) ? 16 : 4);
+    return &addr->prefix;
+}
 
-    /* convert it to binary form */
-    if (inet_pton(AF_INET6, result, (void *)&addr_bin.s) != 1) {
-        if (asprintf(err_msg, "Failed to convert IPv6 address \"%s\".", result) == -1) {
-            *err_msg = NULL;
-        }
-        free(result);
-        return 1;
-    }
+static size_t
+inet_encode_clb(const lyd_val *value, uint8_t *buf, size_t size)
+{
+    const void *data;
+    size_t len;
 
-    /* zero host bits */
-    for (i = 0; i < 4; ++i) {
-        mask = 0;
-        for (j = 0; j < 32; ++j) {
-            mask <<= 1;
-            if (pref > (i * 32) + j) {
-                mask |= 1;
-            }
-        }
-        mask = htonl(mask);
-        addr_bin.a[i] &= mask;
+    /* the same data as hashed */
+    data = inet_hash_clb(value, &len);
+    if (len <= size) {
+        memcpy(buf, data, len);
     }
+    return len;
+}
 
-    /* convert back to string */
-    if (!inet_ntop(AF_INET6, (void *)&addr_bin.s, result, INET6_ADDRSTRLEN)) {
-        if (asprintf(err_msg, "Failed to convert IPv6 address (%s).", strerror(errno)) == -1) {
+static int
+inet_decode_clb(struct ly_ctx *ctx, const char *type_name, const void *data, size_t len, const char **value_str,
+                lyd_val *value, char **err_msg)
+{
+    struct lytype_inet_addr addr;
+    char suffix[5] = "";
+
+    memset(&addr, 0, sizeof addr);
+    if (len == 1 + 4) {
+        addr.family = AF_INET;
+    } else if (len == 1 + 16) {
+        addr.family = AF_INET6;
+    } else {
+        if (asprintf(err_msg, "Invalid encoded %s value length %zu.", type_name, len) == -1) {
             *err_msg = NULL;
         }
-        free(result);
         return 1;
     }
+    addr.prefix = ((const uint8_t *)data)[0];
+    memcpy(addr.addr, (const uint8_t *)data + 1, len - 1);
 
-    /* add the prefix */
-    strcat(result, pref_str);
-
-    if (strcmp(result, *value_str)) {
-        /* some conversion took place, update the value */
-        lydict_remove(ctx, *value_str);
-        *value_str = lydict_insert_zc(ctx, result);
-        value->string = *value_str;
-    } else {
-        free(result);
+    if (strstr(type_name, "prefix")) {
+        sprintf(suffix, "/%u", addr.prefix);
     }
 
-    return 0;
-}
-
-static int
-ip_prefix_store_clb(struct ly_ctx *ctx, const char *type_name, const char **value_str, lyd_val *value, char **err_msg)
-{
-    if (strchr(*value_str, ':')) {
-        return ipv6_prefix_store_clb(ctx, type_name, value_str, value, err_msg);
-    }
-    return ipv4_prefix_store_clb(ctx, type_name, value_str, value, err_msg);
+    *value_str = NULL;
+    return inet_store(ctx, value_str, value, &addr, suffix, err_msg);
 }
 
 /* Name of this array must match the file name! */
 struct lytype_plugin_list user_inet_types[] = {
-    {"ietf-inet-types", "2013-07-15", "ip-address", ip_store_clb, NULL},
-    {"ietf-inet-types", "2013-07-15", "ipv6-address", ip_store_clb, NULL},
-    {"ietf-inet-types", "2013-07-15", "ip-address-no-zone", ip_store_clb, NULL},
-    {"ietf-inet-types", "2013-07-15", "ipv6-address-no-zone", ip_store_clb, NULL},
-    {"ietf-inet-types", "2013-07-15", "ip-prefix", ip_prefix_store_clb, NULL},
-    {"ietf-inet-types", "2013-07-15", "ipv4-prefix", ipv4_prefix_store_clb, NULL},
-    {"ietf-inet-types", "2013-07-15", "ipv6-prefix", ipv6_prefix_store_clb, NULL},
-    {NULL, NULL, NULL, NULL, NULL} /* terminating item */
+    {"ietf-inet-types", "2013-07-15", "ip-address", ip_store_clb, free, NULL, NULL, NULL, NULL},
+    {"ietf-inet-types", "2013-07-15", "ipv4-address", ip_store_clb, free, NULL, NULL, NULL, NULL},
+    {"ietf-inet-types", "2013-07-15", "ipv6-address", ip_store_clb, free, NULL, NULL, NULL, NULL},
+    {"ietf-inet-types", "2013-07-15", "ip-address-no-zone", ip_store_clb, free, inet_compare_clb, inet_hash_clb,
+     inet_encode_clb, inet_decode_clb},
+    {"ietf-inet-types", "2013-07-15", "ipv4-address-no-zone", ip_store_clb, free, inet_compare_clb, inet_hash_clb,
+     inet_encode_clb, inet_decode_clb},
+    {"ietf-inet-types", "2013-07-15", "ipv6-address-no-zone", ip_store_clb, free, inet_compare_clb, inet_hash_clb,
+     inet_encode_clb, inet_decode_clb},
+    {"ietf-inet-types", "2013-07-15", "ip-prefix", ip_prefix_store_clb, free, inet_compare_clb, inet_hash_clb,
+     inet_encode_clb, inet_decode_clb},
+    {"ietf-inet-types", "2013-07-15", "ipv4-prefix", ipv4_prefix_store_clb, free, inet_compare_clb, inet_hash_clb,
+     inet_encode_clb, inet_decode_clb},
+    {"ietf-inet-types", "2013-07-15", "ipv6-prefix", ipv6_prefix_store_clb, free, inet_compare_clb, inet_hash_clb,
+     inet_encode_clb, inet_decode_clb},
+    {NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL} /* terminating item */
 };
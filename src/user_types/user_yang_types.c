@@ -1,7 +1,7 @@
 /**
  * @file user_yang_types.c
  * @author Michal Vasko <mvasko@cesnet.cz>
- * @brief ietf-yang-types typedef validation and conversion to canonical format
+ * @brief ietf-yang-types typedef validation and conversion to binary and canonical format
  *
  * Copyright (c) 2018 CESNET, z.s.p.o.
  *
@@ -35,12 +35,13 @@ LYTYPE_VERSION_CHECK
 
 static int
 date_and_time_store_clb(struct ly_ctx *UNUSED(ctx), const char *UNUSED(type_name), const char **value_str,
-                        lyd_val *UNUSED(value), char **err_msg)
+                        lyd_val *value, char **err_msg)
 {
     struct tm tm, tm2;
     uint32_t i, j;
     const char *val_str = *value_str;
-    int ret;
+    int ret, shift = 0;
+    time_t t;
 
     /* \d{4}-\d{2}-\d{2}T\d{2}:\d{2}:\d{2}(\.\d+)?(Z|[\+\-]\d{2}:\d{2})
      * 2018-03-21T09:11:05(.55785...)(Z|+02:00) */
@@ -198,6 +199,13 @@ date_and_time_store_clb(struct ly_ctx *UNUSED(ctx), const char *UNUSED(type_name
             goto error;
         }
 
+        /* learn the shift in seconds */
+        shift = ((val_str[i + 1] - '0') * 10 + (val_str[i + 2] - '0')) * 3600
+                + ((val_str[i + 4] - '0') * 10 + (val_str[i + 5] - '0')) * 60;
+        if (val_str[i] == '-') {
+            shift = -shift;
+        }
+
         i += 5;
         break;
     default:
@@ -212,7 +220,14 @@ date_and_time_store_clb(struct ly_ctx *UNUSED(ctx), const char *UNUSED(type_name
         goto error;
     }
 
-    /* validation succeeded and we do not want to change how it is stored */
+    /* validation succeeded, store the time in UTC, the string is kept since the timezone is a part of it */
+    tm = tm2;
+    t = timegm(&tm);
+    if (t == -1) {
+        ret = asprintf(err_msg, "Converting date-and-time value \"%s\" failed (%s).", val_str, strerror(errno));
+        goto error;
+    }
+    value->int64 = (int64_t)t - shift;
     return 0;
 
 error:
@@ -250,12 +265,115 @@ hex_string_store_clb(struct ly_ctx *ctx, const char *UNUSED(type_name), const ch
     return 0;
 }
 
+static int
+mac_address_store_clb(struct ly_ctx *ctx, const char *UNUSED(type_name), const char **value_str, lyd_val *value, char **err_msg)
+{
+    char *str;
+    uint64_t mac = 0;
+    uint32_t i;
+    int c;
+
+    /* [0-9a-fA-F]{2}(:[0-9a-fA-F]{2}){5} */
+    for (i = 0; i < 17; ++i) {
+        c = (unsigned char)(*value_str)[i];
+        if ((i % 3) == 2) {
+            if (c != ':') {
+                break;
+            }
+            continue;
+        }
+
+        if (!isxdigit(c)) {
+            break;
+        }
+        mac = (mac << 4) | (isdigit(c) ? c - '0' : tolower(c) - 'a' + 10);
+    }
+    if ((i < 17) || (*value_str)[i]) {
+        if (asprintf(err_msg, "Invalid mac-address value \"%s\".", *value_str) == -1) {
+            *err_msg = NULL;
+        }
+        return 1;
+    }
+
+    /* print the canonical value from the binary one */
+    if (asprintf(&str, "%02x:%02x:%02x:%02x:%02x:%02x", (unsigned)(mac >> 40) & 0xff, (unsigned)(mac >> 32) & 0xff,
+                 (unsigned)(mac >> 24) & 0xff, (unsigned)(mac >> 16) & 0xff, (unsigned)(mac >> 8) & 0xff,
+                 (unsigned)mac & 0xff) == -1) {
+        *err_msg = NULL;
+        return 1;
+    }
+
+    if (strcmp(str, *value_str)) {
+        /* update the value correctly */
+        lydict_remove(ctx, *value_str);
+        *value_str = lydict_insert_zc(ctx, str);
+    } else {
+        free(str);
+    }
+    value->uint64 = mac;
+    return 0;
+}
+
+static int
+mac_address_compare_clb(const lyd_val *value1, const lyd_val *value2)
+{
+    return value1->uint64 != value2->uint64;
+}
+
+static const void *
+mac_address_hash_clb(const lyd_val *value, size_t *len)
+{
+    *len = sizeof value->uint64;
+    return &value->uint64;
+}
+
+static size_t
+mac_address_encode_clb(const lyd_val *value, uint8_t *buf, size_t size)
+{
+    uint32_t i;
+
+    /* the 6 octets in their order */
+    if (size >= 6) {
+        for (i = 0; i < 6; ++i) {
+            buf[i] = (value->uint64 >> ((5 - i) * 8)) & 0xff;
+        }
+    }
+    return 6;
+}
+
+static int
+mac_address_decode_clb(struct ly_ctx *ctx, const char *UNUSED(type_name), const void *data, size_t len,
+                       const char **value_str, lyd_val *value, char **err_msg)
+{
+    const uint8_t *octets = data;
+    char *str;
+
+    if (len != 6) {
+        if (asprintf(err_msg, "Invalid encoded mac-address value length %zu.", len) == -1) {
+            *err_msg = NULL;
+        }
+        return 1;
+    }
+
+    if (asprintf(&str, "%02x:%02x:%02x:%02x:%02x:%02x", octets[0], octets[1], octets[2], octets[3], octets[4],
+                 octets[5]) == -1) {
+        *err_msg = NULL;
+        return 1;
+    }
+    *value_str = lydict_insert_zc(ctx, str);
+
+    value->uint64 = ((uint64_t)octets[0] << 40) | ((uint64_t)octets[1] << 32) | ((uint64_t)octets[2] << 24)
+                    | ((uint64_t)octets[3] << 16) | ((uint64_t)octets[4] << 8) | octets[5];
+    return 0;
+}
+
 /* Name of this array must match the file name! */
 struct lytype_plugin_list user_yang_types[] = {
-    {"ietf-yang-types", "2013-07-15", "date-and-time", date_and_time_store_clb, NULL},
-    {"ietf-yang-types", "2013-07-15", "phys-address", hex_string_store_clb, NULL},
-    {"ietf-yang-types", "2013-07-15", "mac-address", hex_string_store_clb, NULL},
-    {"ietf-yang-types", "2013-07-15", "hex-string", hex_string_store_clb, NULL},
-    {"ietf-yang-types", "2013-07-15", "uuid", hex_string_store_clb, NULL},
-    {NULL, NULL, NULL, NULL, NULL} /* terminating item */
+    {"ietf-yang-types", "2013-07-15", "date-and-time", date_and_time_store_clb, NULL, NULL, NULL, NULL, NULL},
+    {"ietf-yang-types", "2013-07-15", "phys-address", hex_string_store_clb, NULL, NULL, NULL, NULL, NULL},
+    {"ietf-yang-types", "2013-07-15", "mac-address", mac_address_store_clb, NULL, mac_address_compare_clb,
+     mac_address_hash_clb, mac_address_encode_clb, mac_address_decode_clb},
+    {"ietf-yang-types", "2013-07-15", "hex-string", hex_string_store_clb, NULL, NULL, NULL, NULL, NULL},
+    {"ietf-yang-types", "2013-07-15", "uuid", hex_string_store_clb, NULL, NULL, NULL, NULL, NULL},
+    {NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL} /* terminating item */
 };
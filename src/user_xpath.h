@@ -0,0 +1,124 @@
+/**
+ * @file user_xpath.h
+ * @brief libyang support for user XPath function implementations.
+ *
+ * Copyright (c) 2018 CESNET, z.s.p.o.
+ *
+ * This source code is licensed under BSD 3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://opensource.org/licenses/BSD-3-Clause
+ */
+
+#ifndef LY_USER_XPATH_H_
+#define LY_USER_XPATH_H_
+
+#include "libyang.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @defgroup user_xpath User XPath Functions
+ * @ingroup datatree
+ * @{
+ *
+ * Additional XPath functions implemented in C, usable in the must and when expressions and in the paths
+ * of the data searching functions. The functions are registered with ly_register_xpath_funcs() or, optionally,
+ * by a user type plugin defining the `lyxp_func_list` array object together with `lyxp_func_api_version`
+ * (see #LYXPFUNC_VERSION_CHECK). Their names cannot have a prefix and the built-in XPath functions take precedence.
+ */
+
+/**
+ * @brief User XPath functions API version
+ */
+#define LYXPFUNC_API_VERSION 1
+
+/**
+ * @brief Macro to store version of user XPath functions API in the type plugins defining the functions.
+ */
+#if defined(STATIC) || defined(LY_BUILTIN_PLUGINS)
+#define LYXPFUNC_VERSION_CHECK
+#else
+#define LYXPFUNC_VERSION_CHECK int lyxp_func_api_version = LYXPFUNC_API_VERSION;
+#endif
+
+/**
+ * @brief Types of the XPath values passed to and from the user XPath functions.
+ */
+typedef enum {
+    LYXP_VALUE_NODES = 0,            /**< node-set, only with #LYXP_FUNC_NODE_ARGS for arguments */
+    LYXP_VALUE_BOOLEAN,              /**< boolean */
+    LYXP_VALUE_NUMBER,               /**< number */
+    LYXP_VALUE_STRING                /**< string */
+} LYXP_VALUE_TYPE;
+
+/**
+ * @brief XPath value passed to and from the user XPath functions.
+ */
+struct lyxp_value {
+    LYXP_VALUE_TYPE type;            /**< type of the value */
+    union {
+        struct {
+            struct lyd_node **nodes; /**< data nodes of the node-set, in the document order, a result array is
+                                          allocated by the C library and spent by libyang */
+            uint32_t count;          /**< number of \p nodes */
+        } nodes;
+        int boolean;                 /**< boolean value */
+        long double number;          /**< number value */
+        char *string;                /**< string value, a result string is allocated by the C library and spent
+                                          by libyang */
+    } value;
+};
+
+/**
+ * @brief Callback evaluating a user XPath function on data.
+ *
+ * @param[in] args Function arguments.
+ * @param[in] arg_count Number of \p args, always between the function minimal and maximal argument count.
+ * @param[in] cur_node Context data node of the whole expression, current() in XPath.
+ * @param[out] result Function result, a node-set result can contain only the nodes from the data tree
+ * of \p cur_node.
+ * @return 0 on success, non-zero on error evaluating the expression.
+ */
+typedef int (*lyxp_func_clb)(const struct lyxp_value *args, uint16_t arg_count, const struct lyd_node *cur_node,
+                             struct lyxp_value *result);
+
+/**
+ * @brief Optional callback providing the schema nodes of a node-set result of a user XPath function.
+ *
+ * It is used when the expression is atomized (see lys_xpath_atomize()) to learn the schema nodes the expression
+ * depends on and to check its paths. If not set, the function result is never a node-set.
+ *
+ * @param[in] args Schema nodes of the function arguments, NULL for the arguments that are not node-sets.
+ * @param[in] arg_count Number of \p args.
+ * @param[in] cur_snode Context schema node of the whole expression.
+ * @param[in,out] result Empty set to add the schema nodes of the result to.
+ * @return 0 on success, non-zero to warn that the arguments are not suitable for the function.
+ */
+typedef int (*lyxp_func_atomize_clb)(struct ly_set **args, uint16_t arg_count, const struct lys_node *cur_snode,
+                                     struct ly_set *result);
+
+#define LYXP_FUNC_NODE_ARGS 0x01     /**< Pass the node-set arguments as the nodes, by default they are converted
+                                          to their string values as by the XPath string() function. */
+
+struct lyxp_func_list {
+    const char *name;                /**< Name of the function. */
+    uint16_t min_args;               /**< Minimal number of the arguments. */
+    uint16_t max_args;               /**< Maximal number of the arguments. */
+    int flags;                       /**< Bitmask of LYXP_FUNC_* flags. */
+    lyxp_func_clb clb;               /**< Callback evaluating the function. */
+    lyxp_func_atomize_clb atomize_clb; /**< Optional callback for atomizing the function. */
+};
+
+/**
+ * @}
+ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LY_USER_XPATH_H_ */
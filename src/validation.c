@@ -136,120 +136,76 @@ lyv_data_context(const struct lyd_node *node, int options, struct unres_data *un
     return 0;
 }
 
-/*
- * actions (cb_data):
- * 0  - compare all uniques
- * n  - compare n-th unique
- */
+/* values of the unique leaves of all the list instances for one unique statement */
+struct lyv_uniq_vals {
+    const char **vals;           /* expr_size values for each instance */
+    uint8_t expr_size;           /* number of unique leaves */
+};
+
 static int
 lyv_list_uniq_equal(void *val1_p, void *val2_p, int UNUSED(mod), void *cb_data)
 {
-    struct ly_ctx *ctx;
-    struct lys_node_list *slist;
-    struct lyd_node *diter, *first, *second;
-    const char *val1, *val2;
-    char *path1, *path2, *uniq_str;
-    uint16_t idx_uniq;
-    int i, j, r, action;
-
-    assert(val1_p && val2_p);
+    struct lyv_uniq_vals *uv = (struct lyv_uniq_vals *)cb_data;
+    uint32_t idx1, idx2;
+    uint8_t i;
 
-    first = *((struct lyd_node **)val1_p);
-    second = *((struct lyd_node **)val2_p);
-    action = (intptr_t)cb_data;
-
-    assert(first && (first->schema->nodetype == LYS_LIST));
-    assert(second && (second->schema == first->schema));
-
-    ctx = first->schema->module->ctx;
-
-    slist = (struct lys_node_list *)first->schema;
+    idx1 = *((uint32_t *)val1_p);
+    idx2 = *((uint32_t *)val2_p);
 
-    /* compare unique leaves */
-    if (action > 0) {
-        i = action - 1;
-        if (i < slist->unique_size) {
-            goto uniquecheck;
+    for (i = 0; i < uv->expr_size; ++i) {
+        /* dictionary strings */
+        if (!ly_strequal(uv->vals[idx1 * uv->expr_size + i], uv->vals[idx2 * uv->expr_size + i], 1)) {
+            return 0;
         }
     }
-    for (i = 0; i < slist->unique_size; i++) {
-uniquecheck:
-        for (j = 0; j < slist->unique[i].expr_size; j++) {
-            /* first */
-            diter = resolve_data_descendant_schema_nodeid(slist->unique[i].expr[j], first->child);
-            if (diter) {
-                val1 = ((struct lyd_node_leaf_list *)diter)->value_str;
-            } else {
-                /* use default value */
-                if (lyd_get_unique_default(slist->unique[i].expr[j], first, &val1)) {
-                    return 1;
-                }
-            }
 
-            /* second */
-            diter = resolve_data_descendant_schema_nodeid(slist->unique[i].expr[j], second->child);
-            if (diter) {
-                val2 = ((struct lyd_node_leaf_list *)diter)->value_str;
-            } else {
-                /* use default value */
-                if (lyd_get_unique_default(slist->unique[i].expr[j], second, &val2)) {
-                    return 1;
-                }
-            }
+    return 1;
+}
 
-            if (!val1 || !val2 || !ly_strequal(val1, val2, 1)) {
-                /* values differ or either one is not set */
-                break;
-            }
-        }
-        if (j && (j == slist->unique[i].expr_size)) {
-            /* all unique leafs are the same in this set, create this nice error */
-            ly_vlog_build_path(LY_VLOG_LYD, first, &path1, 0, 0);
-            ly_vlog_build_path(LY_VLOG_LYD, second, &path2, 0, 0);
+static void
+lyv_list_uniq_err(struct lyd_node *first, struct lyd_node *second, int uniq)
+{
+    struct lys_node_list *slist = (struct lys_node_list *)first->schema;
+    char *path1, *path2, *uniq_str;
+    uint16_t idx_uniq;
+    int j, r;
 
-            /* use buffer to rebuild the unique string */
-            uniq_str = malloc(1024);
-            idx_uniq = 0;
-            for (j = 0; j < slist->unique[i].expr_size; ++j) {
-                if (j) {
-                    uniq_str[idx_uniq++] = ' ';
-                }
-                r = lyd_build_relative_data_path(lys_node_module((struct lys_node *)slist), first,
-                                                 slist->unique[i].expr[j], &uniq_str[idx_uniq]);
-                if (r == -1) {
-                    goto unique_errmsg_cleanup;
-                }
-                idx_uniq += r;
-            }
+    ly_vlog_build_path(LY_VLOG_LYD, first, &path1, 0, 0);
+    ly_vlog_build_path(LY_VLOG_LYD, second, &path2, 0, 0);
 
-            LOGVAL(ctx, LYE_NOUNIQ, LY_VLOG_LYD, second, uniq_str, path1, path2);
-unique_errmsg_cleanup:
-            free(path1);
-            free(path2);
-            free(uniq_str);
-            return 1;
+    /* use buffer to rebuild the unique string */
+    uniq_str = malloc(1024);
+    idx_uniq = 0;
+    for (j = 0; j < slist->unique[uniq].expr_size; ++j) {
+        if (j) {
+            uniq_str[idx_uniq++] = ' ';
         }
-
-        if (action > 0) {
-            /* done */
-            return 0;
+        r = lyd_build_relative_data_path(lys_node_module((struct lys_node *)slist), first,
+                                         slist->unique[uniq].expr[j], &uniq_str[idx_uniq]);
+        if (r == -1) {
+            goto cleanup;
         }
+        idx_uniq += r;
     }
 
-    return 0;
+    LOGVAL(first->schema->module->ctx, LYE_NOUNIQ, LY_VLOG_LYD, second, uniq_str, path1, path2);
+
+cleanup:
+    free(path1);
+    free(path2);
+    free(uniq_str);
 }
 
 int
 lyv_data_unique(struct lyd_node *list)
 {
-    struct lyd_node *diter;
-    struct ly_set *set;
-    uint32_t i, j, n = 0;
-    int ret = 0;
-    uint32_t hash, u, usize = 0;
-    struct hash_table **uniqtables = NULL;
-    const char *id;
-    char *path;
+    struct lyd_node *diter, *first;
+    struct lyd_node **insts = NULL;
+    const char **vals = NULL, *id;
+    struct lyv_uniq_vals uv;
+    struct hash_table *uniqtable;
+    uint32_t i, j, u, count, size = 0, hash, *match;
+    int ret = 0, r;
     struct lys_node_list *slist;
     struct ly_ctx *ctx = list->schema->module->ctx;
 
@@ -260,113 +216,102 @@ lyv_data_unique(struct lyd_node *list)
 
     slist = (struct lys_node_list *)list->schema;
 
-    /* get all list instances */
-    if (ly_vlog_build_path(LY_VLOG_LYD, list, &path, 0, 1)) {
-        return -1;
-    }
-    set = lyd_find_path(list, path);
-    free(path);
-    if (!set) {
-        return -1;
+    /* get all list instances, they are all among the siblings */
+    if (list->parent) {
+        first = list->parent->child;
+    } else {
+        for (first = list; first->prev->next; first = first->prev);
     }
+    count = 0;
+    LY_TREE_FOR(first, diter) {
+        if (diter->schema != list->schema) {
+            continue;
+        }
 
-    for (i = 0; i < set->number; ++i) {
         /* remove the flag */
-        set->set.d[i]->validity &= ~LYD_VAL_UNIQUE;
-    }
+        diter->validity &= ~LYD_VAL_UNIQUE;
 
-    if (set->number == 2) {
-        /* simple comparison */
-        if (lyv_list_uniq_equal(&set->set.d[0], &set->set.d[1], 0, (void *)0)) {
-            /* instance duplication */
-            ly_set_free(set);
-            return 1;
-        }
-    } else if (set->number > 2) {
-        /* use hashes for comparison */
-        /* first, allocate the table, the size depends on number of items in the set */
-        for (u = 31; u > 0; u--) {
-            usize = set->number << u;
-            usize = usize >> u;
-            if (usize == set->number) {
-                break;
-            }
-        }
-        if (u == 0) {
-            LOGINT(ctx);
-            ret = -1;
-            goto cleanup;
-        } else {
-            u = 32 - u;
-            usize = 1 << u;
+        if (count == size) {
+            size = size ? size * 2 : 8;
+            insts = ly_realloc(insts, size * sizeof *insts);
+            LY_CHECK_ERR_RETURN(!insts, LOGMEM(ctx), -1);
         }
+        insts[count++] = diter;
+    }
+    if (count < 2) {
+        free(insts);
+        return 0;
+    }
+
+    for (j = 0; j < slist->unique_size; j++) {
+        /* learn the unique values of all the instances, each of them is resolved only once */
+        vals = malloc(count * slist->unique[j].expr_size * sizeof *vals);
+        LY_CHECK_ERR_GOTO(!vals, LOGMEM(ctx); ret = -1, cleanup);
+        uv.vals = vals;
+        uv.expr_size = slist->unique[j].expr_size;
 
-        n = slist->unique_size;
-        uniqtables = malloc(n * sizeof *uniqtables);
-        if (!uniqtables) {
+        uniqtable = lyht_new(1, sizeof(uint32_t), lyv_list_uniq_equal, &uv, 1);
+        LY_CHECK_ERR_GOTO(!uniqtable, LOGMEM(ctx); ret = -1, cleanup);
+        if (lyht_reserve(uniqtable, count)) {
             LOGMEM(ctx);
             ret = -1;
-            n = 0;
-            goto cleanup;
-        }
-        for (j = 0; j < n; j++) {
-            uniqtables[j] = lyht_new(usize, sizeof(struct lyd_node *), lyv_list_uniq_equal, (void *)(j + 1L), 0);
-            if (!uniqtables[j]) {
-                LOGMEM(ctx);
-                ret = -1;
-                goto cleanup;
-            }
-        }
-
-        for (u = 0; u < set->number; u++) {
-            /* loop for unique - get the hash for the instances */
-            for (j = 0; j < n; j++) {
-                id = NULL;
-                for (i = hash = 0; i < slist->unique[j].expr_size; i++) {
-                    diter = resolve_data_descendant_schema_nodeid(slist->unique[j].expr[i], set->set.d[u]->child);
-                    if (diter) {
-                        id = ((struct lyd_node_leaf_list *)diter)->value_str;
-                    } else {
-                        /* use default value */
-                        if (lyd_get_unique_default(slist->unique[j].expr[i], set->set.d[u], &id)) {
-                            ret = -1;
-                            goto cleanup;
-                        }
+            goto cleanup_ht;
+        }
+
+        for (u = 0; u < count; u++) {
+            id = NULL;
+            for (i = hash = 0; i < slist->unique[j].expr_size; i++) {
+                diter = resolve_data_descendant_schema_nodeid(slist->unique[j].expr[i], insts[u]->child);
+                if (diter) {
+                    id = ((struct lyd_node_leaf_list *)diter)->value_str;
+                } else {
+                    /* use default value */
+                    if (lyd_get_unique_default(slist->unique[j].expr[i], insts[u], &id)) {
+                        ret = -1;
+                        goto cleanup_ht;
                     }
-                    if (!id) {
-                        /* unique item not present nor has default value */
-                        break;
-                    }
-                    hash = dict_hash_multi(hash, id, strlen(id));
                 }
                 if (!id) {
-                    /* skip this list instance since its unique set is incomplete */
-                    continue;
+                    /* unique item not present nor has default value */
+                    break;
                 }
+                vals[u * uv.expr_size + i] = id;
+                hash = dict_hash_multi(hash, id, strlen(id));
+            }
+            if (!id) {
+                /* skip this list instance since its unique set is incomplete */
+                continue;
+            }
 
-                /* finish the hash value */
-                hash = dict_hash_multi(hash, NULL, 0);
+            /* finish the hash value */
+            hash = dict_hash_multi(hash, NULL, 0);
 
-                /* insert into the hashtable */
-                if (lyht_insert(uniqtables[j], &set->set.d[u], hash, NULL)) {
-                    ret = 1;
-                    goto cleanup;
-                }
+            /* insert into the hashtable */
+            r = lyht_insert(uniqtable, &u, hash, (void **)&match);
+            if (r == -1) {
+                LOGMEM(ctx);
+                ret = -1;
+                goto cleanup_ht;
+            } else if (r) {
+                /* all unique leafs are the same in these instances, create this nice error */
+                lyv_list_uniq_err(insts[*match], insts[u], j);
+                ret = 1;
+                goto cleanup_ht;
             }
         }
-    }
 
-cleanup:
-    ly_set_free(set);
-    for (j = 0; j < n; j++) {
-        if (!uniqtables[j]) {
-            /* failed when allocating uniquetables[j], following j are not allocated */
+cleanup_ht:
+        lyht_free(uniqtable);
+        free(vals);
+        vals = NULL;
+        if (ret) {
             break;
         }
-        lyht_free(uniqtables[j]);
     }
-    free(uniqtables);
 
+cleanup:
+    free(vals);
+    free(insts);
     return ret;
 }
 
@@ -442,6 +387,36 @@ lyv_list_equal(void *val1_p, void *val2_p, int UNUSED(mod), void *UNUSED(cb_data
     }
 }
 
+#ifdef LY_ENABLED_CACHE
+
+/**
+ * @brief Check that there is no other instance equal to a list/leaf-list instance using the parent hash table
+ * with all the children.
+ *
+ * @param[in] node List/leaf-list instance in its parent hash table.
+ * @return 0 if there is no duplicate, 1 if there is one (error is logged).
+ */
+static int
+lyv_data_dup_ht(struct lyd_node *node)
+{
+    struct hash_table *ht = node->parent->ht;
+    struct lyd_node **match_p;
+
+    /* the instances with an equal hash are in the probe sequence */
+    if (lyht_find(ht, &node, node->hash, (void **)&match_p)) {
+        return 0;
+    }
+    do {
+        if ((*match_p != node) && ((*match_p)->schema == node->schema) && lyv_list_equal(match_p, &node, 0, NULL)) {
+            return 1;
+        }
+    } while (!lyht_find_next(ht, match_p, node->hash, (void **)&match_p));
+
+    return 0;
+}
+
+#endif
+
 int
 lyv_data_dup(struct lyd_node *node, struct lyd_node *start)
 {
@@ -458,6 +433,36 @@ lyv_data_dup(struct lyd_node *node, struct lyd_node *start)
         start = lyd_first_sibling(node);
     }
 
+#ifdef LY_ENABLED_CACHE
+    if (node->parent && node->parent->ht && ((node->schema->nodetype == LYS_LEAFLIST)
+            || ((struct lys_node_list *)node->schema)->keys_size)) {
+        /* all the hashed instances are in the parent hash table, check only the changed ones */
+        for (diter = start; diter; diter = diter->next) {
+            if ((diter->schema == node->schema) && !diter->hash) {
+                /* an instance with missing keys, not in the hash table */
+                break;
+            }
+        }
+        if (!diter) {
+            for (diter = start; diter; diter = diter->next) {
+                if ((diter->schema != node->schema) || !(diter->validity & LYD_VAL_DUP)) {
+                    continue;
+                }
+
+                /* remove the flag */
+                diter->validity &= ~LYD_VAL_DUP;
+
+                if (lyv_data_dup_ht(diter)) {
+                    /* keep the flag, the instance must be checked again next time */
+                    diter->validity |= LYD_VAL_DUP;
+                    return 1;
+                }
+            }
+            return 0;
+        }
+    }
+#endif
+
     /* check uniqueness of the list/leaflist instances (compare values) */
     set = ly_set_new();
     for (diter = start; diter; diter = diter->next) {
@@ -477,8 +482,7 @@ lyv_data_dup(struct lyd_node *node, struct lyd_node *start)
         /* simple comparison */
         if (lyv_list_equal(&set->set.d[0], &set->set.d[1], 0, 0)) {
             /* instance duplication */
-            ly_set_free(set);
-            return 1;
+            ret = 1;
         }
     } else if (set->number > 2) {
         /* use hashes for comparison */
@@ -530,6 +534,12 @@ lyv_data_dup(struct lyd_node *node, struct lyd_node *start)
     }
 
 cleanup:
+    if (ret) {
+        /* keep the flags, the instances must be checked again next time */
+        for (u = 0; u < set->number; u++) {
+            set->set.d[u]->validity |= LYD_VAL_DUP;
+        }
+    }
     ly_set_free(set);
     lyht_free(keystable);
 
@@ -584,6 +594,12 @@ lyv_extension(struct lys_ext_instance **ext, uint8_t size, struct lyd_node *node
     return 0;
 }
 
+static int lyv_type_chain_extension(struct lyd_node_leaf_list *leaf, struct lys_type *type, int first_type);
+
+/**
+ * @brief Call the extension validation callbacks of the restrictions and the extensions of a single type,
+ * the typedefs it is derived from are not inspected.
+ */
 static int
 lyv_type_extension(struct lyd_node_leaf_list *leaf, struct lys_type *type, int first_type)
 {
@@ -647,7 +663,7 @@ lyv_type_extension(struct lyd_node_leaf_list *leaf, struct lys_type *type, int f
                 }
             }
             if (i < type->info.uni.count &&
-                lyv_type_extension(leaf, &type->info.uni.types[i], first_type)) {
+                lyv_type_chain_extension(leaf, &type->info.uni.types[i], first_type)) {
                 return EXIT_FAILURE;
             }
             break;
@@ -660,12 +676,32 @@ lyv_type_extension(struct lyd_node_leaf_list *leaf, struct lys_type *type, int f
         return EXIT_FAILURE;
     }
 
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Call the extension validation callbacks of a type and all the typedefs it is derived from.
+ *
+ * Each typedef in the chain is visited exactly once and only the ones flagged with #LYS_VALID_EXT
+ * (their own extensions or their type has a callback) are inspected.
+ */
+static int
+lyv_type_chain_extension(struct lyd_node_leaf_list *leaf, struct lys_type *type, int first_type)
+{
+    struct lyd_node *node = (struct lyd_node *)leaf;
+
+    if (lyv_type_extension(leaf, type, first_type)) {
+        return EXIT_FAILURE;
+    }
+
     while (type->der->type.der) {
         type = &type->der->type;
-        if ((type->parent->flags & LYS_VALID_EXT)) {
-            if (lyv_type_extension(leaf, type, 0) || lyv_extension(type->parent->ext, type->parent->ext_size, node)) {
-                return EXIT_FAILURE;
-            }
+        if (!(type->parent->flags & LYS_VALID_EXT)) {
+            continue;
+        }
+        if (((type->parent->flags & LYS_VALID_EXT_TYPE) && lyv_type_extension(leaf, type, 0))
+                || lyv_extension(type->parent->ext, type->parent->ext_size, node)) {
+            return EXIT_FAILURE;
         }
     }
 
@@ -774,10 +810,10 @@ lyv_data_content(struct lyd_node *node, int options, struct unres_data *unres)
                 return EXIT_FAILURE;
             }
 
-            if (schema->nodetype & (LYS_LEAF | LYS_LEAFLIST)) {
+            if ((schema->nodetype & (LYS_LEAF | LYS_LEAFLIST)) && (schema->flags & LYS_VALID_EXT_TYPE)) {
                 type = &((struct lys_node_leaf *) schema)->type;
                 leaf = (struct lyd_node_leaf_list *) node;
-                if (lyv_type_extension(leaf, type, 1)) {
+                if (lyv_type_chain_extension(leaf, type, 1)) {
                     return EXIT_FAILURE;
                 }
             }
@@ -15,6 +15,7 @@
 #include <assert.h>
 #include <errno.h>
 #include <ctype.h>
+#include <limits.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -31,13 +32,22 @@
 #include "printer.h"
 #include "parser.h"
 #include "tree_schema.h"
+#include "tree_internal.h"
 #include "xml_internal.h"
 
+#ifdef __SSE2__
+# define LYXML_SSE2
+# include <emmintrin.h>
+#endif
+
 #define ign_xmlws(p)                                                    \
     while (is_xmlws(*p)) {                                              \
         p++;                                                            \
     }
 
+/* internal parser option, only the start tag of an element is parsed, its content is left unprocessed */
+#define LYXML_PARSE_STARTTAG 0x80
+
 static struct lyxml_attr *lyxml_dup_attr(struct ly_ctx *ctx, struct lyxml_elem *parent, struct lyxml_attr *attr);
 
 API const struct lyxml_ns *
@@ -119,9 +129,9 @@ lyxml_dup_attr(struct ly_ctx *ctx, struct lyxml_elem *parent, struct lyxml_attr
          * attributes (struct lyxml_attr), some of them can be namespace
          * definitions (and in that case they are struct lyxml_ns).
          */
-        result = (struct lyxml_attr *)calloc(1, sizeof (struct lyxml_ns));
+        result = (struct lyxml_attr *)lyd_pool_alloc(ctx, sizeof (struct lyxml_ns));
     } else {
-        result = calloc(1, sizeof (struct lyxml_attr));
+        result = lyd_pool_alloc(ctx, sizeof (struct lyxml_attr));
     }
     LY_CHECK_ERR_RETURN(!result, LOGMEM(ctx), NULL);
 
@@ -205,7 +215,7 @@ lyxml_dup_elem(struct ly_ctx *ctx, struct lyxml_elem *elem, struct lyxml_elem *p
     }
 
     LY_TREE_FOR(elem, elem) {
-        dup = calloc(1, sizeof *dup);
+        dup = lyd_pool_alloc(ctx, sizeof *dup);
         LY_CHECK_ERR_RETURN(!dup, LOGMEM(ctx), NULL);
         dup->content = lydict_insert(ctx, elem->content, 0);
         dup->name = lydict_insert(ctx, elem->name, 0);
@@ -357,7 +367,7 @@ lyxml_free_attr(struct ly_ctx *ctx, struct lyxml_elem *parent, struct lyxml_attr
     }
     lydict_remove(ctx, attr->name);
     lydict_remove(ctx, attr->value);
-    free(attr);
+    lyd_pool_free(ctx, attr);
 }
 
 void
@@ -374,7 +384,7 @@ lyxml_free_attrs(struct ly_ctx *ctx, struct lyxml_elem *elem)
 
         lydict_remove(ctx, a->name);
         lydict_remove(ctx, a->value);
-        free(a);
+        lyd_pool_free(ctx, a);
 
         a = next;
     } while (a);
@@ -395,7 +405,7 @@ lyxml_free_elem(struct ly_ctx *ctx, struct lyxml_elem *elem)
     }
     lydict_remove(ctx, elem->name);
     lydict_remove(ctx, elem->content);
-    free(elem);
+    lyd_pool_free(ctx, elem);
 }
 
 API void
@@ -422,6 +432,9 @@ lyxml_free_withsiblings(struct ly_ctx *ctx, struct lyxml_elem *elem)
         return;
     }
 
+    /* return all the elements and attributes into the context data pool at once */
+    lyd_pool_stash_start(ctx);
+
     /* optimization - avoid freeing (unlinking) the last node of the siblings list */
     /* so, first, free the node's predecessors to the beginning of the list ... */
     for(iter = elem->prev; iter->next; iter = aux) {
@@ -432,6 +445,8 @@ lyxml_free_withsiblings(struct ly_ctx *ctx, struct lyxml_elem *elem)
     LY_TREE_FOR_SAFE(elem, aux, iter) {
         lyxml_free(ctx, iter);
     }
+
+    lyd_pool_stash_flush(ctx);
 }
 
 API const char *
@@ -496,6 +511,12 @@ lyxml_getutf8(struct ly_ctx *ctx, const char *buf, unsigned int *read)
     int i;
 
     c = buf[0];
+
+    /* the most common case, a valid ASCII character */
+    if ((c >= 0x20) && (c < 0x80)) {
+        *read = 1;
+        return c;
+    }
     *read = 0;
 
     /* buf is NULL terminated string, so 0 means EOF */
@@ -579,26 +600,126 @@ lyxml_getutf8(struct ly_ctx *ctx, const char *buf, unsigned int *read)
 static int
 parse_ignore(struct ly_ctx *ctx, const char *data, const char *endstr, unsigned int *len)
 {
-    unsigned int slen;
-    const char *c = data;
+    const char *c;
 
-    slen = strlen(endstr);
-
-    while (*c && strncmp(c, endstr, slen)) {
-        c++;
-    }
-    if (!*c) {
+    c = strstr(data, endstr);
+    if (!c) {
         LOGVAL(ctx, LYE_XML_MISS, LY_VLOG_NONE, NULL, "closing sequence", endstr);
         return EXIT_FAILURE;
     }
-    c += slen;
+    c += strlen(endstr);
+
+    *len = c - data;
+    return EXIT_SUCCESS;
+}
+
+/* logs directly, skip the white spaces, comments, and PIs outside of the elements */
+static int
+parse_misc(struct ly_ctx *ctx, const char *data, unsigned int *len)
+{
+    const char *c = data;
+    unsigned int size;
+
+    while (1) {
+        if (is_xmlws(*c)) {
+            /* skip whitespaces */
+            ign_xmlws(c);
+        } else if (!strncmp(c, "<?", 2)) {
+            /* XMLDecl or PI - ignore it */
+            c += 2;
+            if (parse_ignore(ctx, c, "?>", &size)) {
+                return EXIT_FAILURE;
+            }
+            c += size;
+        } else if (!strncmp(c, "<!--", 4)) {
+            /* Comment - ignore it */
+            c += 2;
+            if (parse_ignore(ctx, c, "-->", &size)) {
+                return EXIT_FAILURE;
+            }
+            c += size;
+        } else {
+            break;
+        }
+    }
 
     *len = c - data;
     return EXIT_SUCCESS;
 }
 
-/* logs directly, fails when return == NULL and *len == 0 */
-static char *
+/**
+ * @brief Check whether a text character needs special processing or can be copied as is.
+ */
+static int
+text_special_char(unsigned char c, char delim, int cdsect)
+{
+    if (!c || (c == ']')) {
+        /* end of data or possibly "]]>" */
+        return 1;
+    } else if (cdsect) {
+        return 0;
+    }
+
+    /* non-ASCII (needs UTF-8 validation), invalid control characters, references, and delimiters */
+    return (c & 0x80) || ((c < 0x20) && (c != 0x9) && (c != 0xa) && (c != 0xd)) || (c == '&') || (c == '<')
+            || (c == (unsigned char)delim);
+}
+
+/**
+ * @brief Get the length of the text at the beginning of \p data that can be copied as is,
+ * meaning valid ASCII characters without any references, delimiters, or CDATA sections end.
+ *
+ * @param[in] data Text to scan, NULL-terminated.
+ * @param[in] delim Delimiter of the text.
+ * @param[in] cdsect Whether the text is inside a CDATA section.
+ * @param[in] max Maximum length to return.
+ * @return Number of plain leading characters, at most \p max.
+ */
+static LY_NO_SANITIZE unsigned int
+text_plain_len(const char *data, char delim, int cdsect, unsigned int max)
+{
+    unsigned int i = 0;
+#ifdef LYXML_SSE2
+    __m128i block, special, ws;
+    uint32_t mask;
+
+    /* scan the unaligned beginning byte by byte, aligned loads then never cross the page with the terminating byte */
+    for (; (i < max) && ((uintptr_t)(data + i) & 0xf); ++i) {
+        if (text_special_char(data[i], delim, cdsect)) {
+            return i;
+        }
+    }
+
+    for (; i < max; i += 16) {
+        block = _mm_load_si128((const __m128i *)(data + i));
+        special = _mm_or_si128(_mm_cmpeq_epi8(block, _mm_setzero_si128()), _mm_cmpeq_epi8(block, _mm_set1_epi8(']')));
+        if (!cdsect) {
+            /* signed comparison, so all non-ASCII bytes are matched as well */
+            ws = _mm_or_si128(_mm_cmpeq_epi8(block, _mm_set1_epi8(0x9)),
+                              _mm_or_si128(_mm_cmpeq_epi8(block, _mm_set1_epi8(0xa)), _mm_cmpeq_epi8(block, _mm_set1_epi8(0xd))));
+            special = _mm_or_si128(special, _mm_andnot_si128(ws, _mm_cmplt_epi8(block, _mm_set1_epi8(0x20))));
+            special = _mm_or_si128(special, _mm_or_si128(_mm_cmpeq_epi8(block, _mm_set1_epi8('&')),
+                                                         _mm_cmpeq_epi8(block, _mm_set1_epi8('<'))));
+            special = _mm_or_si128(special, _mm_cmpeq_epi8(block, _mm_set1_epi8(delim)));
+        }
+
+        mask = (uint32_t)_mm_movemask_epi8(special);
+        if (mask) {
+            i += __builtin_ctz(mask);
+            return (i < max) ? i : max;
+        }
+    }
+
+    return max;
+#else
+    for (; (i < max) && !text_special_char(data[i], delim, cdsect); ++i);
+
+    return i;
+#endif
+}
+
+/* logs directly, fails when return == NULL and *len == 0, returns a dictionary string */
+static const char *
 parse_text(struct ly_ctx *ctx, const char *data, char delim, unsigned int *len)
 {
 #define BUFSIZE 1024
@@ -610,6 +731,14 @@ parse_text(struct ly_ctx *ctx, const char *data, char delim, unsigned int *len)
     int cdsect = 0;
     int32_t n;
 
+    /* the most common case, text without any references or CDATA sections needs no decoding,
+     * insert it into the dictionary directly from the input */
+    r = text_plain_len(data, delim, 0, UINT_MAX);
+    if ((data[r] == delim) && ((delim != '<') || strncmp(&data[r], "<![CDATA[", 9))) {
+        *len = r;
+        return r ? lydict_insert(ctx, data, r) : lydict_insert(ctx, "", 0);
+    }
+
     for (*len = o = 0; cdsect || data[*len] != delim; o++) {
         if (!data[*len] || (!cdsect && !strncmp(&data[*len], "]]>", 3))) {
             LOGVAL(ctx, LYE_XML_INVAL, LY_VLOG_NONE, NULL, "element content, \"]]>\" found");
@@ -644,6 +773,11 @@ loop:
                 *len += 3;
                 cdsect = 0;
                 o--;            /* we don't write any data in this iteration */
+            } else if ((r = text_plain_len(&data[*len], delim, 1, BUFSIZE - o))) {
+                /* copy all the characters up to the possible CDSect end at once */
+                memcpy(&buf[o], &data[*len], r);
+                o += r - 1;     /* o is ++ in for loop */
+                *len += r;
             } else {
                 buf[o] = data[*len];
                 (*len)++;
@@ -706,6 +840,11 @@ loop:
                 o += r - 1;     /* o is ++ in for loop */
                 (*len)++;
             }
+        } else if ((r = text_plain_len(&data[*len], delim, 0, BUFSIZE - o))) {
+            /* copy all the plain ASCII characters at once */
+            memcpy(&buf[o], &data[*len], r);
+            o += r - 1;     /* o is ++ in for loop */
+            *len += r;
         } else {
             r = copyutf8(ctx, &buf[o], &data[*len]);
             if (!r) {
@@ -743,7 +882,7 @@ loop:
         LY_CHECK_ERR_RETURN(!result, LOGMEM(ctx), NULL)
     }
 
-    return result;
+    return lydict_insert_zc(ctx, result);
 
 error:
     *len = 0;
@@ -751,12 +890,167 @@ error:
     return NULL;
 }
 
+/* prefixed namespace declaration in scope */
+struct ns_scope_rec {
+    const char *prefix;             /* dictionary string of the first declaration of the prefix */
+    const struct lyxml_ns *ns;      /* innermost declaration of the prefix, NULL if none */
+};
+
+/* namespace declaration that is in scope and the one it shadows */
+struct ns_scope_decl {
+    const struct lyxml_ns *ns;
+    const struct lyxml_ns *prev;
+};
+
+/* namespace declarations in scope of the element being parsed */
+struct ns_scope {
+    const struct lyxml_ns *dflt;    /* default namespace, NULL if none */
+    struct hash_table *prefixes;    /* struct ns_scope_rec, created for the first prefixed declaration */
+    struct ns_scope_decl *decls;    /* stack of the declarations in scope */
+    uint32_t count;
+    uint32_t size;
+};
+
+static int
+ns_scope_rec_equal(void *val1_p, void *val2_p, int UNUSED(mod), void *UNUSED(cb_data))
+{
+    struct ns_scope_rec *rec1 = val1_p, *rec2 = val2_p;
+
+    return !strcmp(rec1->prefix, rec2->prefix);
+}
+
+static uint32_t
+ns_scope_hash(const char *prefix)
+{
+    return dict_hash_multi(dict_hash_multi(0, prefix, strlen(prefix)), NULL, 0);
+}
+
+static struct ns_scope_rec *
+ns_scope_find(struct ns_scope *scope, const char *prefix)
+{
+    struct ns_scope_rec rec, *match;
+
+    if (!scope->prefixes) {
+        return NULL;
+    }
+
+    rec.prefix = prefix;
+    if (lyht_find(scope->prefixes, &rec, ns_scope_hash(prefix), (void **)&match)) {
+        return NULL;
+    }
+    return match;
+}
+
+/**
+ * @brief Get the namespace of a prefix in the current scope.
+ *
+ * @param[in] scope Namespace scope.
+ * @param[in] prefix Prefix, NULL for the default namespace.
+ * @return Namespace declaration, NULL if not found.
+ */
+static struct lyxml_ns *
+ns_scope_get(struct ns_scope *scope, const char *prefix)
+{
+    struct ns_scope_rec *rec;
+
+    if (!prefix) {
+        return (struct lyxml_ns *)scope->dflt;
+    }
+
+    rec = ns_scope_find(scope, prefix);
+    return rec ? (struct lyxml_ns *)rec->ns : NULL;
+}
+
+/**
+ * @brief Add a namespace declaration into the scope, it shadows any previous declaration of the same prefix.
+ */
+static int
+ns_scope_push(struct ly_ctx *ctx, struct ns_scope *scope, const struct lyxml_ns *ns)
+{
+    struct ns_scope_decl *decls;
+    struct ns_scope_rec rec, *match;
+    const struct lyxml_ns *prev;
+
+    if (!ns->prefix) {
+        prev = scope->dflt;
+        /* xmlns="" -> no namespace */
+        scope->dflt = ns->value ? ns : NULL;
+    } else {
+        if (!scope->prefixes) {
+            scope->prefixes = lyht_new(8, sizeof rec, ns_scope_rec_equal, NULL, 1);
+            LY_CHECK_ERR_RETURN(!scope->prefixes, LOGMEM(ctx), EXIT_FAILURE);
+        }
+
+        rec.prefix = ns->prefix;
+        rec.ns = ns;
+        switch (lyht_insert(scope->prefixes, &rec, ns_scope_hash(ns->prefix), (void **)&match)) {
+        case 0:
+            prev = NULL;
+            break;
+        case 1:
+            prev = match->ns;
+            match->ns = ns;
+            break;
+        default:
+            LOGMEM(ctx);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (scope->count == scope->size) {
+        decls = realloc(scope->decls, (scope->size ? scope->size * 2 : 8) * sizeof *decls);
+        LY_CHECK_ERR_RETURN(!decls, LOGMEM(ctx), EXIT_FAILURE);
+        scope->decls = decls;
+        scope->size = scope->size ? scope->size * 2 : 8;
+    }
+    scope->decls[scope->count].ns = ns;
+    scope->decls[scope->count].prev = prev;
+    ++scope->count;
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Remove the namespace declarations from the scope until only \p count of them remain.
+ */
+static void
+ns_scope_pop(struct ns_scope *scope, uint32_t count)
+{
+    struct ns_scope_decl *decl;
+    struct ns_scope_rec *rec, removed;
+
+    while (scope->count > count) {
+        decl = &scope->decls[--scope->count];
+        if (!decl->ns->prefix) {
+            scope->dflt = decl->prev;
+        } else {
+            rec = ns_scope_find(scope, decl->ns->prefix);
+            assert(rec);
+            if (decl->prev) {
+                rec->ns = decl->prev;
+            } else {
+                /* the record refers to the prefix of the declaration, which may be freed before the scope */
+                removed = *rec;
+                lyht_remove(scope->prefixes, &removed, ns_scope_hash(decl->ns->prefix));
+            }
+        }
+    }
+}
+
+static void
+ns_scope_clean(struct ns_scope *scope)
+{
+    lyht_free(scope->prefixes);
+    free(scope->decls);
+    memset(scope, 0, sizeof *scope);
+}
+
 /* logs directly */
 static struct lyxml_attr *
-parse_attr(struct ly_ctx *ctx, const char *data, unsigned int *len, struct lyxml_elem *parent)
+parse_attr(struct ly_ctx *ctx, const char *data, unsigned int *len, struct lyxml_elem *parent, struct ns_scope *scope)
 {
     const char *c = data, *start, *delim;
-    char *prefix = NULL, xml_flag, *str;
+    char *prefix = NULL, xml_flag;
     int uc;
     struct lyxml_attr *attr = NULL, *a;
     unsigned int size;
@@ -764,7 +1058,7 @@ parse_attr(struct ly_ctx *ctx, const char *data, unsigned int *len, struct lyxml
     /* check if it is attribute or namespace */
     if (!strncmp(c, "xmlns", 5)) {
         /* namespace */
-        attr = calloc(1, sizeof (struct lyxml_ns));
+        attr = lyd_pool_alloc(ctx, sizeof (struct lyxml_ns));
         LY_CHECK_ERR_RETURN(!attr, LOGMEM(ctx), NULL);
 
         attr->type = LYXML_ATTR_NS;
@@ -777,7 +1071,7 @@ parse_attr(struct ly_ctx *ctx, const char *data, unsigned int *len, struct lyxml
         c++;                    /* go after ':' to the prefix value */
     } else {
         /* attribute */
-        attr = calloc(1, sizeof *attr);
+        attr = lyd_pool_alloc(ctx, sizeof *attr);
         LY_CHECK_ERR_RETURN(!attr, LOGMEM(ctx), NULL);
 
         attr->type = LYXML_ATTR_STD;
@@ -788,7 +1082,7 @@ parse_attr(struct ly_ctx *ctx, const char *data, unsigned int *len, struct lyxml
     uc = lyxml_getutf8(ctx, c, &size);
     if (!is_xmlnamestartchar(uc)) {
         LOGVAL(ctx, LYE_XML_INVAL, LY_VLOG_NONE, NULL, "NameStartChar of the attribute");
-        free(attr);
+        lyd_pool_free(ctx, attr);
         return NULL;
     }
     xml_flag = 4;
@@ -808,7 +1102,7 @@ parse_attr(struct ly_ctx *ctx, const char *data, unsigned int *len, struct lyxml
                 LY_CHECK_ERR_GOTO(!prefix, LOGMEM(ctx), error);
                 memcpy(prefix, data, c - data);
                 prefix[c - data] = '\0';
-                attr->ns = lyxml_get_ns(parent, prefix);
+                attr->ns = ns_scope_get(scope, prefix);
             } else if (((*c == 'm') && (xml_flag == 1)) ||
                     ((*c == 'l') && (xml_flag == 2))) {
                 ++xml_flag;
@@ -840,11 +1134,10 @@ equal:
         goto error;
     }
     delim = c;
-    str = parse_text(ctx, ++c, *delim, &size);
-    if (!str && !size) {
+    attr->value = parse_text(ctx, ++c, *delim, &size);
+    if (!attr->value && !size) {
         goto error;
     }
-    attr->value = lydict_insert_zc(ctx, str);
 
     *len = c + size + 1 - data; /* +1 is delimiter size */
 
@@ -869,8 +1162,9 @@ error:
 }
 
 /* logs directly */
-struct lyxml_elem *
-lyxml_parse_elem(struct ly_ctx *ctx, const char *data, unsigned int *len, struct lyxml_elem *parent, int options)
+static struct lyxml_elem *
+lyxml_parse_elem(struct ly_ctx *ctx, const char *data, unsigned int *len, struct lyxml_elem *parent, int options,
+                 struct ns_scope *scope)
 {
     const char *c = data, *start, *e;
     const char *lws;    /* leading white space for handling mixed content */
@@ -881,7 +1175,8 @@ lyxml_parse_elem(struct ly_ctx *ctx, const char *data, unsigned int *len, struct
     struct lyxml_elem *elem = NULL, *child;
     struct lyxml_attr *attr;
     unsigned int size;
-    int nons_flag = 0, closed_flag = 0;
+    uint32_t scope_count = scope->count;
+    int closed_flag = 0;
 
     *len = 0;
 
@@ -928,7 +1223,7 @@ lyxml_parse_elem(struct ly_ctx *ctx, const char *data, unsigned int *len, struct
     }
 
     /* allocate element structure */
-    elem = calloc(1, sizeof *elem);
+    elem = lyd_pool_alloc(ctx, sizeof *elem);
     LY_CHECK_ERR_RETURN(!elem, free(prefix); LOGMEM(ctx), NULL);
 
     elem->next = NULL;
@@ -948,6 +1243,10 @@ process:
         c += 2;
         elem->content = lydict_insert(ctx, "", 0);
         closed_flag = 1;
+    } else if ((*c == '>') && (options & LYXML_PARSE_STARTTAG)) {
+        /* the content is left to the caller */
+        c++;
+        closed_flag = 1;
     } else if (*c == '>') {
         /* process element content */
         c++;
@@ -1061,14 +1360,14 @@ process:
                         LOGVAL(ctx, LYE_XML_INVAL, LY_VLOG_XML, elem, "XML element with mixed content");
                         goto error;
                     }
-                    child = calloc(1, sizeof *child);
+                    child = lyd_pool_alloc(ctx, sizeof *child);
                     LY_CHECK_ERR_GOTO(!child, LOGMEM(ctx), error);
                     child->content = elem->content;
                     elem->content = NULL;
                     lyxml_add_child(ctx, elem, child);
                     elem->flags |= LYXML_ELEM_MIXED;
                 }
-                child = lyxml_parse_elem(ctx, c, &size, elem, options);
+                child = lyxml_parse_elem(ctx, c, &size, elem, options, scope);
                 if (!child) {
                     goto error;
                 }
@@ -1084,11 +1383,10 @@ store_content:
                     c = lws;
                     lws = NULL;
                 }
-                str = parse_text(ctx, c, '<', &size);
-                if (!str && !size) {
+                elem->content = parse_text(ctx, c, '<', &size);
+                if (!elem->content && !size) {
                     goto error;
                 }
-                elem->content = lydict_insert_zc(ctx, str);
                 c += size;      /* move after processed text content */
 
                 if (elem->child) {
@@ -1097,7 +1395,7 @@ store_content:
                         LOGVAL(ctx, LYE_XML_INVAL, LY_VLOG_XML, elem, "XML element with mixed content");
                         goto error;
                     }
-                    child = calloc(1, sizeof *child);
+                    child = lyd_pool_alloc(ctx, sizeof *child);
                     LY_CHECK_ERR_GOTO(!child, LOGMEM(ctx), error);
                     child->content = elem->content;
                     elem->content = NULL;
@@ -1108,26 +1406,15 @@ store_content:
         }
     } else {
         /* process attribute */
-        attr = parse_attr(ctx, c, &size, elem);
+        attr = parse_attr(ctx, c, &size, elem, scope);
         if (!attr) {
             goto error;
         }
         c += size;              /* move after processed attribute */
 
-        /* check namespace */
-        if (attr->type == LYXML_ATTR_NS) {
-            if ((!prefix || !prefix[0]) && !attr->name) {
-                if (attr->value) {
-                    /* default prefix */
-                    elem->ns = (struct lyxml_ns *)attr;
-                } else {
-                    /* xmlns="" -> no namespace */
-                    nons_flag = 1;
-                }
-            } else if (prefix && prefix[0] && attr->name && !strncmp(attr->name, prefix, prefix_len + 1)) {
-                /* matching namespace with prefix */
-                elem->ns = (struct lyxml_ns *)attr;
-            }
+        /* namespace declaration is in scope of the element */
+        if ((attr->type == LYXML_ATTR_NS) && ns_scope_push(ctx, scope, (struct lyxml_ns *)attr)) {
+            goto error;
         }
 
         /* go back to finish element processing */
@@ -1141,13 +1428,13 @@ store_content:
         goto error;
     }
 
-    if (!elem->ns && !nons_flag && parent) {
-        elem->ns = lyxml_get_ns(parent, prefix_len ? prefix : NULL);
-    }
+    elem->ns = ns_scope_get(scope, prefix_len ? prefix : NULL);
+    ns_scope_pop(scope, scope_count);
     free(prefix);
     return elem;
 
 error:
+    ns_scope_pop(scope, scope_count);
     lyxml_free(ctx, elem);
     free(prefix);
     return NULL;
@@ -1162,52 +1449,39 @@ lyxml_parse_mem(struct ly_ctx *ctx, const char *data, int options)
     const char *c = data;
     unsigned int len;
     struct lyxml_elem *root, *first = NULL, *next;
+    struct ns_scope scope;
 
     if (!ctx) {
         LOGARG;
         return NULL;
     }
+    memset(&scope, 0, sizeof scope);
+
+    /* the elements and attributes are taken from the context data pool in batches */
+    lyd_pool_stash_start(ctx);
 
 repeat:
     /* process document */
-    while (1) {
-        if (!*c) {
-            /* eof */
-            return first;
-        } else if (is_xmlws(*c)) {
-            /* skip whitespaces */
-            ign_xmlws(c);
-        } else if (!strncmp(c, "<?", 2)) {
-            /* XMLDecl or PI - ignore it */
-            c += 2;
-            if (parse_ignore(ctx, c, "?>", &len)) {
-                goto error;
-            }
-            c += len;
-        } else if (!strncmp(c, "<!--", 4)) {
-            /* Comment - ignore it */
-            c += 2;
-            if (parse_ignore(ctx, c, "-->", &len)) {
-                goto error;
-            }
-            c += len;
-        } else if (!strncmp(c, "<!", 2)) {
-            /* DOCTYPE */
-            /* TODO - standalone ignore counting < and > */
-            LOGERR(ctx, LY_EINVAL, "DOCTYPE not supported in XML documents.");
-            goto error;
-        } else if (*c == '<') {
-            /* element - process it in next loop to strictly follow XML
-             * format
-             */
-            break;
-        } else {
-            LOGVAL(ctx, LYE_XML_INCHAR, LY_VLOG_NONE, NULL, c);
-            goto error;
-        }
+    if (parse_misc(ctx, c, &len)) {
+        goto error;
+    }
+    c += len;
+    if (!*c) {
+        /* eof */
+        ns_scope_clean(&scope);
+        lyd_pool_stash_flush(ctx);
+        return first;
+    } else if (!strncmp(c, "<!", 2)) {
+        /* DOCTYPE */
+        /* TODO - standalone ignore counting < and > */
+        LOGERR(ctx, LY_EINVAL, "DOCTYPE not supported in XML documents.");
+        goto error;
+    } else if (*c != '<') {
+        LOGVAL(ctx, LYE_XML_INCHAR, LY_VLOG_NONE, NULL, c);
+        goto error;
     }
 
-    root = lyxml_parse_elem(ctx, c, &len, NULL, options);
+    root = lyxml_parse_elem(ctx, c, &len, NULL, options, &scope);
     if (!root) {
         goto error;
     } else if (!first) {
@@ -1231,15 +1505,235 @@ repeat:
         }
     }
 
+    ns_scope_clean(&scope);
+    lyd_pool_stash_flush(ctx);
     return first;
 
 error:
+    ns_scope_clean(&scope);
     LY_TREE_FOR_SAFE(first, next, root) {
         lyxml_free(ctx, root);
     }
+    lyd_pool_stash_flush(ctx);
     return NULL;
 }
 
+/* logs directly, skip the content and the end tag of an element whose start tag was parsed, nothing is built */
+static int
+skip_content(struct ly_ctx *ctx, const char *data, unsigned int *len)
+{
+    const char *c = data;
+    unsigned int size, depth = 1;
+    char quot;
+
+    while (depth) {
+        c = strchr(c, '<');
+        if (!c) {
+            LOGVAL(ctx, LYE_EOF, LY_VLOG_NONE, NULL);
+            return EXIT_FAILURE;
+        }
+
+        if (!strncmp(c, "<!--", 4)) {
+            c += 4;
+            if (parse_ignore(ctx, c, "-->", &size)) {
+                return EXIT_FAILURE;
+            }
+            c += size;
+        } else if (!strncmp(c, "<![CDATA[", 9)) {
+            c += 9;
+            if (parse_ignore(ctx, c, "]]>", &size)) {
+                return EXIT_FAILURE;
+            }
+            c += size;
+        } else if (!strncmp(c, "<?", 2)) {
+            c += 2;
+            if (parse_ignore(ctx, c, "?>", &size)) {
+                return EXIT_FAILURE;
+            }
+            c += size;
+        } else if (c[1] == '/') {
+            /* end tag */
+            c = strchr(c, '>');
+            if (!c) {
+                LOGVAL(ctx, LYE_EOF, LY_VLOG_NONE, NULL);
+                return EXIT_FAILURE;
+            }
+            ++c;
+            --depth;
+        } else {
+            /* start tag, the attribute values may include '>' */
+            for (++c; *c && (*c != '>'); ++c) {
+                if ((*c == '"') || (*c == '\'')) {
+                    quot = *c;
+                    c = strchr(c + 1, quot);
+                    if (!c) {
+                        break;
+                    }
+                }
+            }
+            if (!c || !*c) {
+                LOGVAL(ctx, LYE_EOF, LY_VLOG_NONE, NULL);
+                return EXIT_FAILURE;
+            }
+            if (c[-1] != '/') {
+                ++depth;
+            }
+            ++c;
+        }
+    }
+
+    *len = c - data;
+    return EXIT_SUCCESS;
+}
+
+int
+lyxml_reader_init(struct ly_ctx *ctx, const char *data, int options, struct lyxml_reader *reader)
+{
+    const char *c = data;
+    unsigned int len;
+    struct lyxml_attr *attr;
+
+    memset(reader, 0, sizeof *reader);
+    reader->ctx = ctx;
+    reader->options = options;
+    reader->scope = calloc(1, sizeof *reader->scope);
+    LY_CHECK_ERR_RETURN(!reader->scope, LOGMEM(ctx), EXIT_FAILURE);
+
+    /* the elements and attributes are taken from the context data pool in batches */
+    lyd_pool_stash_start(ctx);
+
+    if (parse_misc(ctx, c, &len)) {
+        goto error;
+    }
+    c += len;
+    if (!*c) {
+        LOGVAL(ctx, LYE_EOF, LY_VLOG_NONE, NULL);
+        goto error;
+    } else if (!strncmp(c, "<!", 2)) {
+        LOGERR(ctx, LY_EINVAL, "DOCTYPE not supported in XML documents.");
+        goto error;
+    } else if (*c != '<') {
+        LOGVAL(ctx, LYE_XML_INCHAR, LY_VLOG_NONE, NULL, c);
+        goto error;
+    }
+
+    reader->root = lyxml_parse_elem(ctx, c, &len, NULL, options | LYXML_PARSE_STARTTAG, reader->scope);
+    if (!reader->root) {
+        goto error;
+    }
+
+    /* the namespaces declared in the root are in scope of all its children */
+    for (attr = reader->root->attr; attr; attr = attr->next) {
+        if ((attr->type == LYXML_ATTR_NS) && ns_scope_push(ctx, reader->scope, (struct lyxml_ns *)attr)) {
+            goto error;
+        }
+    }
+
+    /* qualified name for the end tag */
+    reader->qname = c + 1;
+    for (reader->qname_len = 0; reader->qname[reader->qname_len] && !is_xmlws(reader->qname[reader->qname_len])
+            && !strchr("/>", reader->qname[reader->qname_len]); ++reader->qname_len);
+
+    /* EmptyElemTag has the content set */
+    reader->data = reader->root->content ? NULL : c + len;
+    return EXIT_SUCCESS;
+
+error:
+    lyxml_reader_clean(reader);
+    return EXIT_FAILURE;
+}
+
+int
+lyxml_reader_next(struct lyxml_reader *reader, struct lyxml_elem **elem, const char **start)
+{
+    struct ly_ctx *ctx = reader->ctx;
+    const char *c = reader->data;
+    unsigned int len;
+
+    *elem = NULL;
+    if (!c) {
+        /* no more children */
+        return EXIT_SUCCESS;
+    }
+
+    if (parse_misc(ctx, c, &len)) {
+        return EXIT_FAILURE;
+    }
+    c += len;
+
+    if (!strncmp(c, "</", 2)) {
+        /* end tag of the root */
+        c += 2;
+        if (strncmp(c, reader->qname, reader->qname_len) || is_xmlnamechar(c[reader->qname_len])) {
+            LOGVAL(ctx, LYE_SPEC, LY_VLOG_XML, reader->root, "Invalid (mixed names) opening (%s) and closing element tags.",
+                   reader->root->name);
+            return EXIT_FAILURE;
+        }
+        c += reader->qname_len;
+        ign_xmlws(c);
+        if (*c != '>') {
+            LOGVAL(ctx, LYE_SPEC, LY_VLOG_XML, reader->root, "Data after closing element tag \"%s\".", reader->root->name);
+            return EXIT_FAILURE;
+        }
+        c++;
+
+        ign_xmlws(c);
+        if (*c) {
+            LOGWRN(ctx, "There are some not parsed data:\n%s", c);
+        }
+        reader->data = NULL;
+        return EXIT_SUCCESS;
+    } else if (!*c) {
+        LOGVAL(ctx, LYE_XML_MISS, LY_VLOG_XML, reader->root, "closing element tag", reader->root->name);
+        return EXIT_FAILURE;
+    } else if ((*c != '<') || !strncmp(c, "<!", 2)) {
+        /* text or CDATA */
+        LOGVAL(ctx, LYE_XML_INVAL, LY_VLOG_XML, reader->root, "XML element with mixed content");
+        return EXIT_FAILURE;
+    }
+
+    *elem = lyxml_parse_elem(ctx, c, &len, reader->root, reader->options | LYXML_PARSE_STARTTAG, reader->scope);
+    if (!*elem) {
+        return EXIT_FAILURE;
+    }
+    *start = c;
+    c += len;
+
+    if (!(*elem)->content) {
+        /* not an EmptyElemTag */
+        if (skip_content(ctx, c, &len)) {
+            lyxml_free(ctx, *elem);
+            *elem = NULL;
+            return EXIT_FAILURE;
+        }
+        c += len;
+    }
+    reader->data = c;
+    return EXIT_SUCCESS;
+}
+
+struct lyxml_elem *
+lyxml_reader_read(struct lyxml_reader *reader, const char *start)
+{
+    unsigned int len;
+
+    return lyxml_parse_elem(reader->ctx, start, &len, reader->root, reader->options, reader->scope);
+}
+
+void
+lyxml_reader_clean(struct lyxml_reader *reader)
+{
+    if (!reader->scope) {
+        return;
+    }
+
+    lyxml_free(reader->ctx, reader->root);
+    ns_scope_clean(reader->scope);
+    free(reader->scope);
+    lyd_pool_stash_flush(reader->ctx);
+    memset(reader, 0, sizeof *reader);
+}
+
 API struct lyxml_elem *
 lyxml_parse_path(struct ly_ctx *ctx, const char *filename, int options)
 {
@@ -1286,12 +1780,24 @@ int
 lyxml_dump_text(struct lyout *out, const char *text, LYXML_DATA_TYPE type)
 {
     unsigned int i, n;
+    size_t len;
 
     if (!text) {
         return 0;
     }
 
     for (i = n = 0; text[i]; i++) {
+        /* write the characters needing no escaping at once */
+        len = ly_strlen_noesc(&text[i], (type == LYXML_DATA_ATTR) ? LY_ESC_XML_ATTR : LY_ESC_XML_ELEM);
+        if (len) {
+            ly_write(out, &text[i], len);
+            n += len;
+            i += len;
+            if (!text[i]) {
+                break;
+            }
+        }
+
         switch (text[i]) {
         case '&':
             n += ly_print(out, "&amp;");
@@ -1477,6 +1983,7 @@ lyxml_print_fd(int fd, const struct lyxml_elem *elem, int options)
     FUN_IN;
 
     struct lyout out;
+    int r;
 
     if (fd < 0 || !elem) {
         return 0;
@@ -1488,10 +1995,13 @@ lyxml_print_fd(int fd, const struct lyxml_elem *elem, int options)
     out.method.fd = fd;
 
     if (options & LYXML_PRINT_SIBLINGS) {
-        return dump_siblings(&out, elem, options);
+        r = dump_siblings(&out, elem, options);
     } else {
-        return dump_elem(&out, elem, 0, options, 1);
+        r = dump_elem(&out, elem, 0, options, 1);
     }
+
+    ly_print_finish(&out);
+    return r;
 }
 
 API int
@@ -1526,6 +2036,7 @@ lyxml_print_clb(ssize_t (*writeclb)(void *arg, const void *buf, size_t count), v
     FUN_IN;
 
     struct lyout out;
+    int r;
 
     if (!writeclb || !elem) {
         return 0;
@@ -1538,8 +2049,11 @@ lyxml_print_clb(ssize_t (*writeclb)(void *arg, const void *buf, size_t count), v
     out.method.clb.arg = arg;
 
     if (options & LYXML_PRINT_SIBLINGS) {
-        return dump_siblings(&out, elem, options);
+        r = dump_siblings(&out, elem, options);
     } else {
-        return dump_elem(&out, elem, 0, options, 1);
+        r = dump_elem(&out, elem, 0, options, 1);
     }
+
+    ly_print_finish(&out);
+    return r;
 }
@@ -127,6 +127,68 @@ void lyxml_unlink_elem(struct ly_ctx *ctx, struct lyxml_elem *elem, int copy_ns)
  */
 int lyxml_getutf8(struct ly_ctx *ctx, const char *buf, unsigned int *read);
 
+/*
+ * Parser
+ */
+
+struct ns_scope;
+
+/**
+ * @brief Reader of the children of the root element one by one, so that the whole XML tree is never built.
+ *
+ * The root element is read with its attributes only, the reader keeps its namespace declarations in scope. The root
+ * cannot have a mixed content.
+ */
+struct lyxml_reader {
+    struct ly_ctx *ctx;
+    struct lyxml_elem *root;    /**< root element, without the children not read by lyxml_reader_read() */
+    const char *data;           /**< input after the last skipped child, NULL when the end tag of the root was read */
+    const char *qname;          /**< qualified name of the root in the input */
+    unsigned int qname_len;
+    struct ns_scope *scope;     /**< namespaces in scope of the children */
+    int options;                /**< parser options, see @ref xmlreadoptions */
+};
+
+/**
+ * @brief Start reading an XML document, read the start tag of its root element.
+ *
+ * @param[in] ctx libyang context to use.
+ * @param[in] data NULL-terminated XML document, must be kept until the reader is cleaned.
+ * @param[in] options Parser options, see @ref xmlreadoptions.
+ * @param[out] reader Reader to initialize, to be cleaned by lyxml_reader_clean().
+ * @return EXIT_SUCCESS or EXIT_FAILURE.
+ */
+int lyxml_reader_init(struct ly_ctx *ctx, const char *data, int options, struct lyxml_reader *reader);
+
+/**
+ * @brief Read the start tag of the next child of the root and skip the rest of it without building anything.
+ *
+ * The whole child can be read later by lyxml_reader_read(), it is checked only then.
+ *
+ * @param[in] reader XML reader.
+ * @param[out] elem Child element with its attributes but without its content, linked to the root so it can be freed
+ * by the caller or together with the root. NULL after the last child.
+ * @param[out] start Start of the child in the input.
+ * @return EXIT_SUCCESS or EXIT_FAILURE.
+ */
+int lyxml_reader_next(struct lyxml_reader *reader, struct lyxml_elem **elem, const char **start);
+
+/**
+ * @brief Read a whole child of the root, it is linked as a child of the root.
+ *
+ * @param[in] reader XML reader.
+ * @param[in] start Start of the child returned by lyxml_reader_next().
+ * @return Child element, NULL on error.
+ */
+struct lyxml_elem *lyxml_reader_read(struct lyxml_reader *reader, const char *start);
+
+/**
+ * @brief Free the root element with all the children read and the reader data.
+ *
+ * @param[in] reader XML reader.
+ */
+void lyxml_reader_clean(struct lyxml_reader *reader);
+
 /**
  * @brief Types of the XML data
  */
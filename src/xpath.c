@@ -26,6 +26,7 @@
 #include <limits.h>
 #include <errno.h>
 #include <math.h>
+#include <pthread.h>
 #include <pcre.h>
 
 #include "xpath.h"
@@ -40,6 +41,7 @@
 #include "printer.h"
 #include "parser.h"
 #include "hash_table.h"
+#include "user_xpath.h"
 
 static const struct lyd_node *moveto_get_root(const struct lyd_node *cur_node, int options,
                                               enum lyxp_node_type *root_type);
@@ -48,6 +50,46 @@ static int set_snode_insert_node(struct lyxp_set *set, const struct lys_node *no
 static int eval_expr_select(struct lyxp_expr *exp, uint16_t *exp_idx, enum lyxp_expr_type etype, struct lyd_node *cur_node,
                             struct lys_module *local_mod, struct lyxp_set *set, int options);
 
+/* data nodes the evaluations in the thread see differently than they are in the tree, see lyxp_set_hidden() */
+static THREAD_LOCAL const struct lyxp_hidden *lyxp_hidden;
+
+const struct lyxp_hidden *
+lyxp_set_hidden(const struct lyxp_hidden *hidden)
+{
+    const struct lyxp_hidden *prev = lyxp_hidden;
+
+    lyxp_hidden = hidden;
+    return prev;
+}
+
+/**
+ * @brief Check whether a data node is considered dummy - its value and children cannot be accessed.
+ */
+static int
+lyxp_node_dummy(const struct lyd_node *node)
+{
+    return (node->validity & LYD_VAL_INUSE) || (lyxp_hidden && (lyxp_hidden->dummy == node));
+}
+
+/**
+ * @brief Check whether a data node is considered not present in the data tree.
+ */
+static int
+lyxp_node_hidden(const struct lyd_node *node)
+{
+    const struct lys_node *sparent;
+
+    if (!lyxp_hidden || !lyxp_hidden->snode || (node->parent != lyxp_hidden->parent)) {
+        return 0;
+    }
+
+    /* the instances of the data nodes defined in the schema node, directly or through other such nodes */
+    for (sparent = node->schema->parent;
+            sparent && (sparent != lyxp_hidden->snode) && (sparent->nodetype & (LYS_USES | LYS_CHOICE | LYS_CASE));
+            sparent = sparent->parent);
+    return (sparent == lyxp_hidden->snode);
+}
+
 void
 lyxp_expr_free(struct lyxp_expr *expr)
 {
@@ -386,6 +428,9 @@ cast_string_recursive(struct lyd_node *node, struct lys_module *local_mod, int f
         ++(*used);
 
         LY_TREE_FOR(node->child, child) {
+            if (lyxp_node_hidden(child)) {
+                continue;
+            }
             if (cast_string_recursive(child, local_mod, 0, root_type, indent + 1, str, used, size)) {
                 return -1;
             }
@@ -542,7 +587,7 @@ cast_node_set_to_string(struct lyxp_set *set, struct lyd_node *cur_node, struct
     enum lyxp_node_type root_type;
     char *str;
 
-    if ((set->val.nodes[0].type != LYXP_NODE_ATTR) && (set->val.nodes[0].node->validity & LYD_VAL_INUSE)) {
+    if ((set->val.nodes[0].type != LYXP_NODE_ATTR) && lyxp_node_dummy(set->val.nodes[0].node)) {
         LOGVAL(local_mod->ctx, LYE_XPATH_DUMMY, LY_VLOG_LYD, set->val.nodes[0].node, set->val.nodes[0].node->schema->name);
         return NULL;
     }
@@ -714,6 +759,147 @@ set_dup_node_hash_check(const struct lyxp_set *set, struct lyd_node *node, enum
 
 #endif
 
+/**
+ * @brief Per-thread pool of released set node arrays and sets reused by the following evaluations.
+ */
+static THREAD_LOCAL struct {
+    struct {
+        void *nodes;
+        uint32_t size;
+    } arrays[LYXP_SET_POOL_SIZE];
+    uint16_t array_count;
+    struct lyxp_set *sets[LYXP_SET_POOL_SIZE];
+    uint16_t set_count;
+    int registered;
+} set_pool;
+
+static pthread_once_t set_pool_once = PTHREAD_ONCE_INIT;
+static pthread_key_t set_pool_key;
+static int set_pool_key_ok;
+
+static void
+set_pool_clean(void *UNUSED(arg))
+{
+    uint16_t i;
+
+    for (i = 0; i < set_pool.array_count; ++i) {
+        free(set_pool.arrays[i].nodes);
+    }
+    set_pool.array_count = 0;
+
+    for (i = 0; i < set_pool.set_count; ++i) {
+        free(set_pool.sets[i]);
+    }
+    set_pool.set_count = 0;
+
+    /* the thread-specific value was reset */
+    set_pool.registered = 0;
+}
+
+static void
+set_pool_key_create(void)
+{
+    /* the pool of every thread is freed when it exits */
+    set_pool_key_ok = !pthread_key_create(&set_pool_key, set_pool_clean);
+}
+
+/**
+ * @brief Make sure the pool of this thread is freed when it exits.
+ *
+ * @return 1 if it is possible to store into the pool, 0 otherwise.
+ */
+static int
+set_pool_register(void)
+{
+    if (!set_pool.registered) {
+        pthread_once(&set_pool_once, set_pool_key_create);
+        if (!set_pool_key_ok || pthread_setspecific(set_pool_key, &set_pool)) {
+            return 0;
+        }
+        set_pool.registered = 1;
+    }
+
+    return 1;
+}
+
+/**
+ * @brief Get a node array (usable for all the set node types) from the pool or allocate a new one.
+ *
+ * @param[in] min_size Minimal number of items.
+ * @param[out] size Number of items of the returned array.
+ * @return Node array, NULL on memory error.
+ */
+static void *
+set_pool_nodes_get(uint32_t min_size, uint32_t *size)
+{
+    uint16_t i;
+    void *nodes;
+
+    assert((sizeof(struct lyxp_set_node) == sizeof(struct lyxp_set_snode))
+           && (sizeof(struct lyxp_set_node) == sizeof(struct lyxp_set_attr)));
+
+    for (i = set_pool.array_count; i; --i) {
+        if (set_pool.arrays[i - 1].size >= min_size) {
+            nodes = set_pool.arrays[i - 1].nodes;
+            *size = set_pool.arrays[i - 1].size;
+
+            /* move the last array here */
+            --set_pool.array_count;
+            set_pool.arrays[i - 1] = set_pool.arrays[set_pool.array_count];
+            return nodes;
+        }
+    }
+
+    *size = min_size;
+    return malloc(min_size * sizeof(struct lyxp_set_node));
+}
+
+/**
+ * @brief Return a node array into the pool or free it.
+ *
+ * @param[in] nodes Node array to release, can be NULL.
+ * @param[in] size Number of items of \p nodes.
+ */
+static void
+set_pool_nodes_put(void *nodes, uint32_t size)
+{
+    if (!nodes) {
+        return;
+    }
+
+    if ((size > LYXP_SET_POOL_MAX_NODES) || (set_pool.array_count == LYXP_SET_POOL_SIZE) || !set_pool_register()) {
+        free(nodes);
+        return;
+    }
+
+    set_pool.arrays[set_pool.array_count].nodes = nodes;
+    set_pool.arrays[set_pool.array_count].size = size;
+    ++set_pool.array_count;
+}
+
+static struct lyxp_set *
+set_pool_set_get(void)
+{
+    if (set_pool.set_count) {
+        --set_pool.set_count;
+        return set_pool.sets[set_pool.set_count];
+    }
+
+    return malloc(sizeof(struct lyxp_set));
+}
+
+static void
+set_pool_set_put(struct lyxp_set *set)
+{
+    if ((set_pool.set_count == LYXP_SET_POOL_SIZE) || !set_pool_register()) {
+        free(set);
+        return;
+    }
+
+    set_pool.sets[set_pool.set_count] = set;
+    ++set_pool.set_count;
+}
+
 static void
 set_free_content(struct lyxp_set *set)
 {
@@ -722,13 +908,13 @@ set_free_content(struct lyxp_set *set)
     }
 
     if (set->type == LYXP_SET_NODE_SET) {
-        free(set->val.nodes);
+        set_pool_nodes_put(set->val.nodes, set->size);
 #ifdef LY_ENABLED_CACHE
         lyht_free(set->ht);
         set->ht = NULL;
 #endif
     } else if (set->type == LYXP_SET_SNODE_SET) {
-        free(set->val.snodes);
+        set_pool_nodes_put(set->val.snodes, set->size);
     } else if (set->type == LYXP_SET_STRING) {
         free(set->val.str);
     }
@@ -743,7 +929,7 @@ lyxp_set_free(struct lyxp_set *set)
     }
 
     set_free_content(set);
-    free(set);
+    set_pool_set_put(set);
 }
 
 /**
@@ -763,7 +949,7 @@ set_copy(struct lyxp_set *set)
         return NULL;
     }
 
-    ret = malloc(sizeof *ret);
+    ret = set_pool_set_get();
     LY_CHECK_ERR_RETURN(!ret, LOGMEM(NULL), NULL);
 
     if (set->type == LYXP_SET_SNODE_SET) {
@@ -780,11 +966,11 @@ set_copy(struct lyxp_set *set)
         }
     } else if (set->type == LYXP_SET_NODE_SET) {
         ret->type = set->type;
-        ret->val.nodes = malloc(set->used * sizeof *ret->val.nodes);
+        ret->val.nodes = set_pool_nodes_get(set->used, &ret->size);
         LY_CHECK_ERR_RETURN(!ret->val.nodes, LOGMEM(NULL); free(ret), NULL);
         memcpy(ret->val.nodes, set->val.nodes, set->used * sizeof *ret->val.nodes);
 
-        ret->used = ret->size = set->used;
+        ret->used = set->used;
         ret->ctx_pos = set->ctx_pos;
         ret->ctx_size = set->ctx_size;
 
@@ -882,7 +1068,7 @@ set_fill_set(struct lyxp_set *trg, struct lyxp_set *src)
         set_fill_string(trg, src->val.str, strlen(src->val.str));
     } else {
         if (trg->type == LYXP_SET_NODE_SET) {
-            free(trg->val.nodes);
+            set_pool_nodes_put(trg->val.nodes, trg->size);
         } else if (trg->type == LYXP_SET_STRING) {
             free(trg->val.str);
         }
@@ -894,11 +1080,10 @@ set_fill_set(struct lyxp_set *trg, struct lyxp_set *src)
 
             trg->type = LYXP_SET_NODE_SET;
             trg->used = src->used;
-            trg->size = src->used;
             trg->ctx_pos = src->ctx_pos;
             trg->ctx_size = src->ctx_size;
 
-            trg->val.nodes = malloc(trg->used * sizeof *trg->val.nodes);
+            trg->val.nodes = set_pool_nodes_get(trg->used, &trg->size);
             LY_CHECK_ERR_RETURN(!trg->val.nodes, LOGMEM(NULL); memset(trg, 0, sizeof *trg), );
             memcpy(trg->val.nodes, src->val.nodes, src->used * sizeof *src->val.nodes);
 #ifdef LY_ENABLED_CACHE
@@ -1108,6 +1293,7 @@ set_insert_node(struct lyxp_set *set, const struct lyd_node *node, uint32_t pos,
 {
     assert(set && ((set->type == LYXP_SET_NODE_SET) || (set->type == LYXP_SET_EMPTY)));
 
+    ++ly_cnt.xpath_node_visits;
     if (set->type == LYXP_SET_EMPTY) {
         /* first item */
         if (idx) {
@@ -1115,11 +1301,10 @@ set_insert_node(struct lyxp_set *set, const struct lyd_node *node, uint32_t pos,
             LOGINT(NULL);
             idx = 0;
         }
-        set->val.nodes = malloc(LYXP_SET_SIZE_START * sizeof *set->val.nodes);
+        set->val.nodes = set_pool_nodes_get(LYXP_SET_SIZE_START, &set->size);
         LY_CHECK_ERR_RETURN(!set->val.nodes, LOGMEM(NULL), );
         set->type = LYXP_SET_NODE_SET;
         set->used = 0;
-        set->size = LYXP_SET_SIZE_START;
         set->ctx_pos = 1;
         set->ctx_size = 1;
 #ifdef LY_ENABLED_CACHE
@@ -1347,6 +1532,152 @@ skip_children:
     return pos;
 }
 
+/**
+ * @brief Set node waiting for its position, value of the hash table used by set_assign_pos_dfs().
+ */
+struct lyxp_set_pos_node {
+    const struct lyd_node *node;
+    uint32_t idx;
+};
+
+static int
+set_pos_values_equal_cb(void *val1_p, void *val2_p, int mod, void *UNUSED(cb_data))
+{
+    struct lyxp_set_pos_node *val1, *val2;
+
+    val1 = (struct lyxp_set_pos_node *)val1_p;
+    val2 = (struct lyxp_set_pos_node *)val2_p;
+
+    if (mod) {
+        return (val1->node == val2->node) && (val1->idx == val2->idx);
+    }
+
+    /* all the set nodes of a data node */
+    return val1->node == val2->node;
+}
+
+static uint32_t
+set_pos_hash(const struct lyd_node *node)
+{
+    uint32_t hash;
+
+    hash = dict_hash_multi(0, (const char *)&node, sizeof node);
+    return dict_hash_multi(hash, NULL, 0);
+}
+
+/**
+ * @brief Assign (fill) missing node positions by numbering the data in a single DFS, the result is
+ *        the same as calling get_node_pos() for every node but the cost does not depend on the order of the nodes.
+ *
+ * @param[in] set Set to fill positions in.
+ * @param[in] root Context root node.
+ * @param[in] root_type Context root type.
+ * @param[in] missing Number of nodes without a position in \p set.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int
+set_assign_pos_dfs(struct lyxp_set *set, const struct lyd_node *root, enum lyxp_node_type root_type, uint32_t missing)
+{
+    struct hash_table *ht;
+    struct lyxp_set_pos_node pnode, *match_p;
+    const struct lyd_node *elem, *next;
+    uint32_t i, hash, pos;
+    int r;
+
+    assert(!root->prev->next);
+
+    ht = lyht_new(1, sizeof pnode, set_pos_values_equal_cb, NULL, 1);
+    LY_CHECK_ERR_RETURN(!ht, LOGMEM(root->schema->module->ctx), -1);
+    if (lyht_reserve(ht, missing)) {
+        lyht_free(ht);
+        LOGMEM(root->schema->module->ctx);
+        return -1;
+    }
+
+    /* remember all the nodes waiting for their position */
+    missing = 0;
+    for (i = 0; i < set->used; ++i) {
+        if (set->val.nodes[i].pos) {
+            continue;
+        }
+
+        switch (set->val.nodes[i].type) {
+        case LYXP_NODE_ATTR:
+            pnode.node = lyd_attr_parent(root, set->val.attrs[i].attr);
+            if (!pnode.node) {
+                lyht_free(ht);
+                LOGINT(root->schema->module->ctx);
+                return -1;
+            }
+            break;
+        case LYXP_NODE_ELEM:
+        case LYXP_NODE_TEXT:
+            pnode.node = set->val.nodes[i].node;
+            break;
+        default:
+            /* all roots have position 0 */
+            continue;
+        }
+        pnode.idx = i;
+
+        r = lyht_insert(ht, &pnode, set_pos_hash(pnode.node), NULL);
+        assert(!r);
+        (void)r;
+        ++missing;
+    }
+
+    /* number the data in DFS until all the positions are assigned */
+    pos = 1;
+    elem = root;
+    while (elem && missing) {
+        if ((root_type == LYXP_NODE_ROOT_CONFIG) && (elem->schema->flags & LYS_CONFIG_R)) {
+            /* skip the whole subtree */
+            next = NULL;
+        } else {
+            pnode.node = elem;
+            hash = set_pos_hash(elem);
+            if (!lyht_find(ht, &pnode, hash, (void **)&match_p)) {
+                do {
+                    if (match_p->node == elem) {
+                        set->val.nodes[match_p->idx].pos = pos;
+                        --missing;
+                    }
+                } while (!lyht_find_next(ht, match_p, hash, (void **)&match_p));
+            }
+            ++pos;
+
+            /* children first, child exception for lyd_node_leaf and lyd_node_leaflist */
+            if (elem->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST | LYS_ANYDATA)) {
+                next = NULL;
+            } else {
+                next = elem->child;
+            }
+        }
+
+        /* siblings, then siblings of the parents */
+        while (!next) {
+            if (elem->next) {
+                next = elem->next;
+            } else if (elem->parent == root->parent) {
+                /* all the data traversed */
+                break;
+            } else {
+                elem = elem->parent;
+            }
+        }
+        elem = next;
+    }
+    lyht_free(ht);
+
+    if (missing) {
+        /* some of the nodes are not in the data, cannot be */
+        LOGINT(root->schema->module->ctx);
+    }
+
+    return 0;
+}
+
 /**
  * @brief Assign (fill) missing node positions.
  *
@@ -1360,7 +1691,17 @@ static int
 set_assign_pos(struct lyxp_set *set, const struct lyd_node *root, enum lyxp_node_type root_type)
 {
     const struct lyd_node *prev = NULL, *tmp_node;
-    uint32_t i, tmp_pos = 0;
+    uint32_t i, tmp_pos = 0, missing = 0;
+
+    for (i = 0; i < set->used; ++i) {
+        if (!set->val.nodes[i].pos) {
+            ++missing;
+        }
+    }
+    if (missing >= LYXP_SET_POS_DFS_MIN) {
+        /* searching for every node separately is quadratic if the nodes are not in the data order */
+        return set_assign_pos_dfs(set, root, root_type, missing);
+    }
 
     for (i = 0; i < set->used; ++i) {
         if (!set->val.nodes[i].pos) {
@@ -1519,6 +1860,90 @@ set_comp_cast(struct lyxp_set *trg, struct lyxp_set *src, enum lyxp_set_type typ
     return EXIT_SUCCESS;
 }
 
+/**
+ * @brief Cast a node from \p src directly into a LYXP_SET_NUMBER \p trg using its stored value
+ *        instead of its string representation. Only integer and decimal64 leaves are handled,
+ *        the result is the same as if the node was cast to a string and then to a number.
+ *
+ * @param[out] trg Set to fill with the number.
+ * @param[in] src Node-set with the node.
+ * @param[in] cur_node Original context node.
+ * @param[in] src_idx Index of the node in \p src.
+ * @param[in] options Whether to apply data node access restrictions defined for 'when' and 'must' evaluation.
+ *
+ * @return EXIT_SUCCESS on success, 1 if the node must be cast the generic way.
+ */
+static int
+set_comp_cast_num(struct lyxp_set *trg, const struct lyxp_set *src, const struct lyd_node *cur_node, uint32_t src_idx,
+                  int options)
+{
+    const struct lyd_node_leaf_list *leaf;
+    const struct lys_type *type;
+    long double num;
+    uint8_t i;
+
+    assert(src->type == LYXP_SET_NODE_SET);
+
+    if ((src->val.nodes[src_idx].type != LYXP_NODE_ELEM) && (src->val.nodes[src_idx].type != LYXP_NODE_TEXT)) {
+        return 1;
+    }
+    leaf = (struct lyd_node_leaf_list *)src->val.nodes[src_idx].node;
+    if (!(leaf->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST)) || lyxp_node_dummy((const struct lyd_node *)leaf)
+            || (leaf->value_flags & (LY_VALUE_UNRES | LY_VALUE_USER))) {
+        return 1;
+    }
+    if (options && cur_node && (cur_node->schema->flags & LYS_CONFIG_W) && (leaf->schema->flags & LYS_CONFIG_R)) {
+        /* cast to an empty string in the config root */
+        return 1;
+    }
+
+    switch (leaf->value_type) {
+    case LY_TYPE_INT8:
+        num = leaf->value.int8;
+        break;
+    case LY_TYPE_UINT8:
+        num = leaf->value.uint8;
+        break;
+    case LY_TYPE_INT16:
+        num = leaf->value.int16;
+        break;
+    case LY_TYPE_UINT16:
+        num = leaf->value.uint16;
+        break;
+    case LY_TYPE_INT32:
+        num = leaf->value.int32;
+        break;
+    case LY_TYPE_UINT32:
+        num = leaf->value.uint32;
+        break;
+    case LY_TYPE_INT64:
+        num = leaf->value.int64;
+        break;
+    case LY_TYPE_UINT64:
+        num = leaf->value.uint64;
+        break;
+    case LY_TYPE_DEC64:
+        /* fraction-digits are known only for a plain decimal64 type, not a union member */
+        type = &((struct lys_node_leaf *)leaf->schema)->type;
+        if (type->base != LY_TYPE_DEC64) {
+            return 1;
+        }
+        /* powers of 10 up to 10^18 are exact so a single division rounds the same as strtold() */
+        for (num = 1, i = 0; i < type->info.dec64.dig; ++i) {
+            num *= 10;
+        }
+        num = leaf->value.dec64 / num;
+        break;
+    default:
+        return 1;
+    }
+
+    memset(trg, 0, sizeof *trg);
+    trg->type = LYXP_SET_NUMBER;
+    trg->val.num = num;
+    return EXIT_SUCCESS;
+}
+
 #ifndef NDEBUG
 
 /**
@@ -2144,6 +2569,7 @@ reparse_function_call(struct ly_ctx *ctx, struct lyxp_expr *exp, uint16_t *exp_i
 {
     int min_arg_count = -1, max_arg_count, arg_count;
     uint16_t func_exp_idx;
+    const struct lyxp_func_list *user_func;
 
     if (exp_check_token(ctx, exp, *exp_idx, LYXP_TOKEN_FUNCNAME, 1)) {
         return -1;
@@ -2292,6 +2718,11 @@ reparse_function_call(struct ly_ctx *ctx, struct lyxp_expr *exp, uint16_t *exp_i
         }
         break;
     }
+    if ((min_arg_count == -1)
+            && (user_func = xpath_get_plugin_func(&exp->expr[exp->expr_pos[*exp_idx]], exp->tok_len[*exp_idx]))) {
+        min_arg_count = user_func->min_args;
+        max_arg_count = user_func->max_args;
+    }
     if (min_arg_count == -1) {
         LOGVAL(ctx, LYE_XPATH_INFUNC, LY_VLOG_NONE, NULL, exp->tok_len[*exp_idx], &exp->expr[exp->expr_pos[*exp_idx]]);
         return -1;
@@ -3692,6 +4123,23 @@ xpath_derived_from_ident_cmp(struct lys_ident *ident, const char *ident_str)
     return 0;
 }
 
+/* return 0 - match, 1 - mismatch */
+static int
+xpath_derived_from_base_cmp(struct lys_ident *ident, const char *ident_str)
+{
+    uint8_t i;
+
+    /* the identity is derived also from all the bases of its bases */
+    for (i = 0; i < ident->base_size; ++i) {
+        if (!xpath_derived_from_ident_cmp(ident->base[i], ident_str)
+                || !xpath_derived_from_base_cmp(ident->base[i], ident_str)) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
 /**
  * @brief Execute the YANG 1.1 derived-from(node-set, string) function. Returns LYXP_SET_BOOLEAN depending
  *        on whether the first argument nodes contain a node of an identity derived from the second
@@ -3709,7 +4157,7 @@ static int
 xpath_derived_from(struct lyxp_set **args, uint16_t UNUSED(arg_count), struct lyd_node *cur_node, struct lys_module *local_mod,
                    struct lyxp_set *set, int options)
 {
-    uint16_t i, j;
+    uint16_t i;
     struct lyd_node_leaf_list *leaf;
     struct lys_node_leaf *sleaf;
     lyd_val *val;
@@ -3763,17 +4211,9 @@ xpath_derived_from(struct lyxp_set **args, uint16_t UNUSED(arg_count), struct ly
                     val = &args[0]->val.attrs[i].attr->value;
                 }
             }
-            if (val) {
-                for (j = 0; j < val->ident->base_size; ++j) {
-                    if (!xpath_derived_from_ident_cmp(val->ident->base[j], args[1]->val.str)) {
-                        set_fill_boolean(set, 1);
-                        break;
-                    }
-                }
-
-                if (j < val->ident->base_size) {
-                    break;
-                }
+            if (val && !xpath_derived_from_base_cmp(val->ident, args[1]->val.str)) {
+                set_fill_boolean(set, 1);
+                break;
             }
         }
     }
@@ -3798,7 +4238,7 @@ static int
 xpath_derived_from_or_self(struct lyxp_set **args, uint16_t UNUSED(arg_count), struct lyd_node *cur_node,
                            struct lys_module *local_mod, struct lyxp_set *set, int options)
 {
-    uint16_t i, j;
+    uint16_t i;
     struct lyd_node_leaf_list *leaf;
     struct lys_node_leaf *sleaf;
     lyd_val *val;
@@ -3852,25 +4292,13 @@ xpath_derived_from_or_self(struct lyxp_set **args, uint16_t UNUSED(arg_count), s
                     val = &args[0]->val.attrs[i].attr->value;
                 }
             }
-            if (val) {
-                if (!xpath_derived_from_ident_cmp(val->ident, args[1]->val.str)) {
-                    set_fill_boolean(set, 1);
-                    break;
-                }
-
-                for (j = 0; j < val->ident->base_size; ++j) {
-                    if (!xpath_derived_from_ident_cmp(val->ident->base[j], args[1]->val.str)) {
-                        set_fill_boolean(set, 1);
-                        break;
-                    }
-                }
-
-                if (j < val->ident->base_size) {
-                    break;
-                }
-            }
-        }
-    }
+            if (val && (!xpath_derived_from_ident_cmp(val->ident, args[1]->val.str)
+                    || !xpath_derived_from_base_cmp(val->ident, args[1]->val.str))) {
+                set_fill_boolean(set, 1);
+                break;
+            }
+        }
+    }
 
     return EXIT_SUCCESS;
 }
@@ -4517,6 +4945,79 @@ xpath_position(struct lyxp_set **UNUSED(args), uint16_t UNUSED(arg_count), struc
     return EXIT_SUCCESS;
 }
 
+/**
+ * @brief Match a string against an XPath regular expression using the context cache
+ *        of compiled patterns. The least recently used pattern is replaced when the cache is full.
+ *
+ * @param[in] ctx Context with the cache.
+ * @param[in] pattern Regular expression.
+ * @param[in] str String to match.
+ *
+ * @return 1 if \p str matches, 0 if not, -1 on error.
+ */
+static int
+regex_cache_match(struct ly_ctx *ctx, const char *pattern, const char *str)
+{
+    struct ly_regex_cache_item *item = NULL;
+    pcre *precomp;
+    const char *err_msg = NULL;
+    int i, ret;
+
+    pthread_mutex_lock(&ctx->regex_cache_lock);
+
+    for (i = 0; i < LY_REGEX_CACHE_SIZE; ++i) {
+        if (!ctx->regex_cache[i].pattern) {
+            /* free item, there can be no more patterns after it */
+            item = &ctx->regex_cache[i];
+            break;
+        }
+        if (!strcmp(ctx->regex_cache[i].pattern, pattern)) {
+            item = &ctx->regex_cache[i];
+            goto match;
+        }
+        if (!item || (ctx->regex_cache[i].used < item->used)) {
+            item = &ctx->regex_cache[i];
+        }
+    }
+
+    /* not compiled yet */
+    if (lyp_check_pattern(ctx, pattern, &precomp)) {
+        ret = -1;
+        goto cleanup;
+    }
+
+    /* replace the chosen item */
+    if (item->pattern) {
+        free(item->pattern);
+        pcre_free(item->precomp);
+        pcre_free_study(item->extra);
+    }
+    item->pattern = strdup(pattern);
+    if (!item->pattern) {
+        LOGMEM(ctx);
+        pcre_free(precomp);
+        ret = -1;
+        goto cleanup;
+    }
+    item->precomp = precomp;
+#ifdef PCRE_STUDY_JIT_COMPILE
+    item->extra = pcre_study(precomp, PCRE_STUDY_JIT_COMPILE, &err_msg);
+#else
+    item->extra = pcre_study(precomp, 0, &err_msg);
+#endif
+    if (err_msg) {
+        LOGWRN(ctx, "Studying pattern \"%s\" failed (%s).", pattern, err_msg);
+    }
+
+match:
+    item->used = ++ctx->regex_cache_used;
+    ret = pcre_exec(item->precomp, item->extra, str, strlen(str), 0, 0, NULL, 0) ? 0 : 1;
+
+cleanup:
+    pthread_mutex_unlock(&ctx->regex_cache_lock);
+    return ret;
+}
+
 /**
  * @brief Execute the YANG 1.1 re-match(string, string) function. Returns LYXP_SET_BOOLEAN
  *        depending on whether the second argument regex matches the first argument string. For details refer to
@@ -4534,9 +5035,8 @@ static int
 xpath_re_match(struct lyxp_set **args, uint16_t UNUSED(arg_count), struct lyd_node *cur_node, struct lys_module *local_mod,
                struct lyxp_set *set, int options)
 {
-    pcre *precomp;
     struct lys_node_leaf *sleaf;
-    int ret = EXIT_SUCCESS;
+    int ret = EXIT_SUCCESS, match;
 
     if (options & LYXP_SNODE_ALL) {
         if ((args[0]->type == LYXP_SET_SNODE_SET) && (sleaf = (struct lys_node_leaf *)warn_get_snode_in_ctx(args[0]))) {
@@ -4569,15 +5069,11 @@ xpath_re_match(struct lyxp_set **args, uint16_t UNUSED(arg_count), struct lyd_no
         return -1;
     }
 
-    if (lyp_check_pattern(local_mod->ctx, args[1]->val.str, &precomp)) {
+    match = regex_cache_match(local_mod->ctx, args[1]->val.str, args[0]->val.str);
+    if (match == -1) {
         return -1;
     }
-    if (pcre_exec(precomp, NULL, args[0]->val.str, strlen(args[0]->val.str), 0, 0, NULL, 0)) {
-        set_fill_boolean(set, 0);
-    } else {
-        set_fill_boolean(set, 1);
-    }
-    free(precomp);
+    set_fill_boolean(set, match);
 
     return EXIT_SUCCESS;
 }
@@ -5127,7 +5623,7 @@ xpath_text(struct lyxp_set **UNUSED(args), uint16_t UNUSED(arg_count), struct ly
     for (i = 0; i < set->used;) {
         switch (set->val.nodes[i].type) {
         case LYXP_NODE_ELEM:
-            if (set->val.nodes[i].node->validity & LYD_VAL_INUSE) {
+            if (lyxp_node_dummy(set->val.nodes[i].node)) {
                 LOGVAL(local_mod->ctx, LYE_XPATH_DUMMY, LY_VLOG_LYD, set->val.nodes[i].node, set->val.nodes[i].node->schema->name);
                 return -1;
             }
@@ -5348,6 +5844,11 @@ moveto_resolve_model(const char *mod_name_ns, uint16_t mod_nam_ns_len, struct ly
         }
     }
 
+    if (is_name && !import_and_disabled_model) {
+        /* there is at most one implemented module of a name, use the context index */
+        return (struct lys_module *)ly_ctx_nget_module(ctx, mod_name_ns, mod_nam_ns_len, NULL, 1);
+    }
+
     for (i = 0; i < ctx->models.used; ++i) {
         if (!import_and_disabled_model && (!ctx->models.list[i]->implemented || ctx->models.list[i]->disabled)) {
             /* skip not implemented or disabled modules */
@@ -5482,6 +5983,13 @@ static int
 moveto_node_check(struct lyd_node *node, enum lyxp_node_type root_type, const char *node_name,
                   struct lys_module *moveto_mod, int options)
 {
+    ++ly_cnt.xpath_node_visits;
+
+    /* presence check */
+    if (lyxp_node_hidden(node)) {
+        return -1;
+    }
+
     /* module check */
     if (moveto_mod && (lyd_node_module(node) != moveto_mod)) {
         return -1;
@@ -5624,7 +6132,7 @@ moveto_node(struct lyxp_set *set, struct lyd_node *cur_node, const char *qname,
             }
 
         /* skip nodes without children - leaves, leaflists, anyxmls, and dummy nodes (ouput root will eval to true) */
-        } else if (!(set->val.nodes[i].node->validity & LYD_VAL_INUSE)
+        } else if (!lyxp_node_dummy(set->val.nodes[i].node)
                 && !(set->val.nodes[i].node->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST | LYS_ANYDATA))) {
 
             LY_TREE_FOR(set->val.nodes[i].node->child, sub) {
@@ -5654,6 +6162,346 @@ moveto_node(struct lyxp_set *set, struct lyd_node *cur_node, const char *qname,
     return EXIT_SUCCESS;
 }
 
+#ifdef LY_ENABLED_CACHE
+
+/**
+ * @brief Searched list instance (with its key values) or leaf-list instance (with its value).
+ */
+struct lyxp_hash_pred {
+    const struct lys_node *schema;
+    const char **values; /* canonical key values in the schema order or the leaf-list value, in the dictionary */
+    uint8_t count;      /* number of values */
+};
+
+static int
+moveto_node_hash_match(const struct lyxp_hash_pred *pred, const struct lyd_node *node)
+{
+    const struct lys_node_list *slist;
+    const struct lyd_node *key;
+    uint8_t i;
+
+    if (node->schema != pred->schema) {
+        return 0;
+    }
+
+    if (pred->schema->nodetype == LYS_LEAFLIST) {
+        /* both the values are in the same dictionary */
+        return ly_strequal(((struct lyd_node_leaf_list *)node)->value_str, pred->values[0], 1);
+    }
+
+    slist = (const struct lys_node_list *)pred->schema;
+    for (i = 0, key = node->child; i < pred->count; ++i, key = key->next) {
+        if (!key || (key->schema != (struct lys_node *)slist->keys[i])
+                || !ly_strequal(((struct lyd_node_leaf_list *)key)->value_str, pred->values[i], 1)) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+static int
+moveto_node_hash_equal(void *val1_p, void *val2_p, int mod, void *UNUSED(cb_data))
+{
+    assert(!mod);
+    (void)mod;
+
+    return moveto_node_hash_match((struct lyxp_hash_pred *)val1_p, *((struct lyd_node **)val2_p));
+}
+
+static void
+moveto_node_hash_pred_clean(struct lyxp_hash_pred *pred)
+{
+    uint8_t i;
+
+    if (pred->values) {
+        for (i = 0; i < pred->count; ++i) {
+            lydict_remove(pred->schema->module->ctx, pred->values[i]);
+        }
+        free(pred->values);
+    }
+}
+
+/**
+ * @brief Store the canonical value of a predicate literal the same way set_canonize() would. It is stored
+ * in the dictionary so that the instances can be matched by comparing the value pointers.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int
+moveto_node_hash_value(struct lyxp_expr *exp, uint16_t lit_idx, const struct lys_node *schema, const char **value)
+{
+    char *val, *val_can;
+    enum int_log_opts prev_ilo;
+
+    val = strndup(&exp->expr[exp->expr_pos[lit_idx] + 1], exp->tok_len[lit_idx] - 2);
+    LY_CHECK_ERR_RETURN(!val, LOGMEM(schema->module->ctx), -1);
+
+    /* ignore errors, the value may not satisfy schema constraints */
+    ly_ilo_change(NULL, ILO_IGNORE, &prev_ilo, NULL);
+    val_can = lyd_make_canonical(schema, val, strlen(val));
+    ly_ilo_restore(NULL, prev_ilo, NULL, 0);
+    if (val_can) {
+        free(val);
+        val = val_can;
+    }
+
+    *value = lydict_insert_zc(schema->module->ctx, val);
+    LY_CHECK_RETURN(!*value, -1);
+
+    return 0;
+}
+
+/**
+ * @brief Check whether a predicate is in the form NAME = 'literal' (or . = 'literal').
+ */
+static int
+moveto_node_hash_is_pred(struct lyxp_expr *exp, uint16_t idx)
+{
+    return (exp->used > idx + 4) && (exp->tokens[idx] == LYXP_TOKEN_BRACK1)
+           && ((exp->tokens[idx + 1] == LYXP_TOKEN_NAMETEST) || (exp->tokens[idx + 1] == LYXP_TOKEN_DOT))
+           && (exp->tokens[idx + 2] == LYXP_TOKEN_OPERATOR_COMP)
+           && (exp->tok_len[idx + 2] == 1) && (exp->expr[exp->expr_pos[idx + 2]] == '=')
+           && (exp->tokens[idx + 3] == LYXP_TOKEN_LITERAL) && (exp->tokens[idx + 4] == LYXP_TOKEN_BRACK2);
+}
+
+/**
+ * @brief Fill the searched instance from the predicates following a list or leaf-list NameTest.
+ *
+ * @param[in] exp Parsed XPath expression.
+ * @param[in] idx Index of the first predicate in \p exp.
+ * @param[in] cur_node Original context node.
+ * @param[in] schema List or leaf-list schema node.
+ * @param[out] pred Searched instance.
+ *
+ * @return 0 on success, 1 if the predicates do not select a single instance (by all the keys), -1 on error.
+ */
+static int
+moveto_node_hash_pred(struct lyxp_expr *exp, uint16_t idx, struct lyd_node *cur_node, const struct lys_node *schema,
+                      struct lyxp_hash_pred *pred)
+{
+    const struct lys_node_list *slist;
+    const struct lys_module *key_mod;
+    const char *name, *ptr;
+    uint16_t name_len;
+    uint8_t i, j;
+
+    memset(pred, 0, sizeof *pred);
+    pred->schema = schema;
+
+    if (schema->nodetype == LYS_LEAFLIST) {
+        if (!moveto_node_hash_is_pred(exp, idx) || (exp->tokens[idx + 1] != LYXP_TOKEN_DOT)) {
+            return 1;
+        }
+
+        pred->count = 1;
+        pred->values = calloc(1, sizeof *pred->values);
+        LY_CHECK_ERR_RETURN(!pred->values, LOGMEM(schema->module->ctx), -1);
+        return moveto_node_hash_value(exp, idx + 3, schema, &pred->values[0]);
+    }
+
+    slist = (const struct lys_node_list *)schema;
+    if (!slist->keys_size) {
+        return 1;
+    }
+
+    pred->count = slist->keys_size;
+    pred->values = calloc(pred->count, sizeof *pred->values);
+    LY_CHECK_ERR_RETURN(!pred->values, LOGMEM(schema->module->ctx), -1);
+
+    for (i = 0; i < slist->keys_size; ++i, idx += 5) {
+        if (!moveto_node_hash_is_pred(exp, idx) || (exp->tokens[idx + 1] != LYXP_TOKEN_NAMETEST)) {
+            return 1;
+        }
+
+        /* key module */
+        name = &exp->expr[exp->expr_pos[idx + 1]];
+        name_len = exp->tok_len[idx + 1];
+        if ((ptr = strnchr(name, ':', name_len))) {
+            key_mod = moveto_resolve_model(name, ptr - name, schema->module->ctx, NULL, 1, 0);
+            name_len -= (ptr - name) + 1;
+            name = ptr + 1;
+        } else {
+            key_mod = lyd_node_module(cur_node);
+        }
+        if (key_mod != lys_node_module(schema)) {
+            return 1;
+        }
+
+        /* key name, every key exactly once */
+        for (j = 0; j < slist->keys_size; ++j) {
+            if (!strncmp(slist->keys[j]->name, name, name_len) && !slist->keys[j]->name[name_len]) {
+                break;
+            }
+        }
+        if ((j == slist->keys_size) || pred->values[j]) {
+            return 1;
+        }
+
+        if (moveto_node_hash_value(exp, idx + 3, (struct lys_node *)slist->keys[j], &pred->values[j])) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Move context \p set to list or leaf-list instances selected by all their keys or their value
+ *        using the parent hash tables instead of evaluating the predicates on every child.
+ *        Handles 'NAME' or 'PREFIX:NAME' followed by predicates NAME = 'literal' (. = 'literal').
+ *        Result is LYXP_SET_NODE_SET (or LYXP_SET_EMPTY), equal to the result of moveto_node()
+ *        followed by eval_predicate() for all the processed predicates.
+ *
+ * @param[in] exp Parsed XPath expression.
+ * @param[in,out] exp_idx Position in the expression \p exp, moved after the processed predicates on success.
+ * @param[in] cur_node Original context node.
+ * @param[in,out] set Set to use.
+ * @param[in] options Whether to apply data node access restrictions defined for 'when' and 'must' evaluation.
+ *
+ * @return EXIT_SUCCESS on success, 1 if not applicable and nothing was changed, -1 on error.
+ */
+static int
+moveto_node_hash(struct lyxp_expr *exp, uint16_t *exp_idx, struct lyd_node *cur_node, struct lyxp_set *set, int options)
+{
+    const char *qname, *ptr;
+    uint16_t qname_len, idx;
+    uint32_t i, hash;
+    int ret, replaced, dup;
+    const struct lys_module *moveto_mod;
+    const struct lys_node *parent_schema, *schema;
+    const struct lys_type *stype;
+    struct lyd_node *parent, *sub, **match_p, **iter_p;
+    struct lyxp_hash_pred pred;
+    enum lyxp_node_type root_type;
+
+    /* when checks of all the children could not be performed */
+    if (!set || (set->type != LYXP_SET_NODE_SET) || !set->used || (options & (LYXP_SNODE_ALL | LYXP_WHEN))
+            || (exp->tokens[*exp_idx] != LYXP_TOKEN_NAMETEST) || !moveto_node_hash_is_pred(exp, *exp_idx + 1)) {
+        return 1;
+    }
+
+    /* all the context nodes must be instances of the same schema node with a children hash table */
+    parent_schema = set->val.nodes[0].node->schema;
+    for (i = 0; i < set->used; ++i) {
+        parent = set->val.nodes[i].node;
+        if ((set->val.nodes[i].type != LYXP_NODE_ELEM) || (parent->schema != parent_schema) || !parent->ht
+                || lyxp_node_dummy(parent)) {
+            return 1;
+        }
+    }
+    if (!(parent_schema->nodetype & (LYS_CONTAINER | LYS_LIST))) {
+        return 1;
+    }
+
+    /* prefix */
+    qname = &exp->expr[exp->expr_pos[*exp_idx]];
+    qname_len = exp->tok_len[*exp_idx];
+    if ((ptr = strnchr(qname, ':', qname_len))) {
+        moveto_mod = moveto_resolve_model(qname, ptr - qname, parent_schema->module->ctx, NULL, 1, 0);
+        if (!moveto_mod) {
+            /* let moveto_node() print the error */
+            return 1;
+        }
+        qname_len -= (ptr - qname) + 1;
+        qname = ptr + 1;
+    } else {
+        moveto_mod = lyd_node_module(cur_node);
+    }
+
+    /* schema node */
+    schema = NULL;
+    while ((schema = lys_getnext(schema, parent_schema, NULL, 0))) {
+        if (!strncmp(schema->name, qname, qname_len) && !schema->name[qname_len] && (lys_node_module(schema) == moveto_mod)) {
+            break;
+        }
+    }
+    if (!schema || !(schema->nodetype & (LYS_LIST | LYS_LEAFLIST))) {
+        return 1;
+    }
+
+    /* predicates */
+    ret = moveto_node_hash_pred(exp, *exp_idx + 1, cur_node, schema, &pred);
+    if (ret) {
+        moveto_node_hash_pred_clean(&pred);
+        return ret;
+    }
+
+    /* hash of the searched instance, the same as lyd_hash() */
+    hash = dict_hash_multi(0, moveto_mod->name, strlen(moveto_mod->name));
+    hash = dict_hash_multi(hash, schema->name, strlen(schema->name));
+    for (i = 0; i < pred.count; ++i) {
+        stype = (schema->nodetype == LYS_LEAFLIST) ? &((struct lys_node_leaf *)schema)->type
+                : &((struct lys_node_list *)schema)->keys[i]->type;
+        if (lytype_hash_str(stype, pred.values[i], strlen(pred.values[i]), &hash)) {
+            hash = dict_hash_multi(hash, pred.values[i], strlen(pred.values[i]));
+        }
+    }
+    hash = dict_hash_multi(hash, NULL, 0);
+
+    moveto_get_root(cur_node, options, &root_type);
+
+    for (i = 0; i < set->used; ) {
+        parent = set->val.nodes[i].node;
+        replaced = 0;
+
+        if ((root_type == LYXP_NODE_ROOT_CONFIG) && (schema->flags & LYS_CONFIG_R)) {
+            /* no match */
+            set_remove_node(set, i);
+            continue;
+        }
+
+        ret = lyht_find_with_cb(parent->ht, &pred, hash, moveto_node_hash_equal, (void **)&match_p);
+
+        if (!ret) {
+            /* state lists and leaf-lists may have the same instance several times, keep the data order */
+            dup = 0;
+            iter_p = match_p;
+            while (!lyht_find_next(parent->ht, iter_p, hash, (void **)&iter_p)) {
+                if (moveto_node_hash_match(&pred, *iter_p)) {
+                    dup = 1;
+                    break;
+                }
+            }
+
+            if (dup) {
+                LY_TREE_FOR(parent->child, sub) {
+                    if (moveto_node_hash_match(&pred, sub)) {
+                        if (!replaced) {
+                            set_replace_node(set, sub, 0, LYXP_NODE_ELEM, i);
+                            replaced = 1;
+                        } else {
+                            set_insert_node(set, sub, 0, LYXP_NODE_ELEM, i);
+                        }
+                        ++i;
+                    }
+                }
+            } else {
+                set_replace_node(set, *match_p, 0, LYXP_NODE_ELEM, i);
+                replaced = 1;
+                ++i;
+            }
+        }
+
+        if (!replaced) {
+            /* no match */
+            set_remove_node(set, i);
+        }
+    }
+    moveto_node_hash_pred_clean(&pred);
+
+    /* NameTest and all the processed predicates */
+    idx = *exp_idx + 1 + (schema->nodetype == LYS_LEAFLIST ? 1 : ((struct lys_node_list *)schema)->keys_size) * 5;
+    for (; *exp_idx < idx; ++(*exp_idx)) {
+        LOGDBG(LY_LDGXPATH, "%-27s %s %s[%u]", __func__, "parsed", print_token(exp->tokens[*exp_idx]),
+               exp->expr_pos[*exp_idx]);
+    }
+
+    return EXIT_SUCCESS;
+}
+
+#endif
+
 static int
 moveto_snode(struct lyxp_set *set, struct lys_node *cur_node, const char *qname, uint16_t qname_len, int options)
 {
@@ -5849,13 +6697,18 @@ moveto_node_alldesc(struct lyxp_set *set, struct lyd_node *cur_node, const char
         start = set->val.nodes[i].node;
         for (elem = next = start; elem; elem = next) {
 
+            /* presence check */
+            if (lyxp_node_hidden(elem)) {
+                goto skip_children;
+            }
+
             /* when check */
             if ((options & LYXP_WHEN) && !LYD_WHEN_DONE(elem->when_status)) {
                 return EXIT_FAILURE;
             }
 
             /* dummy and context check */
-            if ((elem->validity & LYD_VAL_INUSE) || ((root_type == LYXP_NODE_ROOT_CONFIG) && (elem->schema->flags & LYS_CONFIG_R))) {
+            if (lyxp_node_dummy(elem) || ((root_type == LYXP_NODE_ROOT_CONFIG) && (elem->schema->flags & LYS_CONFIG_R))) {
                 goto skip_children;
             }
 
@@ -5878,6 +6731,10 @@ moveto_node_alldesc(struct lyxp_set *set, struct lyd_node *cur_node, const char
             if (match) {
                 /* add matching node into result set */
                 set_insert_node(&ret_set, elem, 0, LYXP_NODE_ELEM, ret_set.used);
+                if (options & LYXP_EXISTS) {
+                    /* no other nodes are needed */
+                    goto finish;
+                }
                 if (set_dup_node_check(set, elem, LYXP_NODE_ELEM, i)) {
                     /* the node is a duplicate, we'll process it later in the set */
                     goto skip_children;
@@ -5914,6 +6771,7 @@ skip_children:
         }
     }
 
+finish:
     /* make the temporary set the current one */
     ret_set.ctx_pos = set->ctx_pos;
     ret_set.ctx_size = set->ctx_size;
@@ -6120,7 +6978,7 @@ moveto_attr(struct lyxp_set *set, struct lyd_node *cur_node, const char *qname,
 
         /* only attributes of an elem (not dummy) can be in the result, skip all the rest;
          * our attributes are always qualified */
-        if ((set->val.nodes[i].type == LYXP_NODE_ELEM) && !(set->val.nodes[i].node->validity & LYD_VAL_INUSE)) {
+        if ((set->val.nodes[i].type == LYXP_NODE_ELEM) && !lyxp_node_dummy(set->val.nodes[i].node)) {
             LY_TREE_FOR(set->val.nodes[i].node->attr, sub) {
 
                 /* check "namespace" */
@@ -6317,11 +7175,11 @@ moveto_self_add_children_r(const struct lyd_node *parent, uint32_t parent_pos, e
     case LYXP_NODE_ROOT:
     case LYXP_NODE_ROOT_CONFIG:
         /* add the same node but as an element */
-        if (!set_dup_node_check(dup_check_set, parent, LYXP_NODE_ELEM, -1)) {
+        if (!lyxp_node_hidden(parent) && !set_dup_node_check(dup_check_set, parent, LYXP_NODE_ELEM, -1)) {
             set_insert_node(to_set, parent, 0, LYXP_NODE_ELEM, to_set->used);
 
             /* skip anydata/anyxml and dummy nodes */
-            if (!(parent->schema->nodetype & LYS_ANYDATA) && !(parent->validity & LYD_VAL_INUSE)) {
+            if (!(parent->schema->nodetype & LYS_ANYDATA) && !lyxp_node_dummy(parent)) {
                 /* also add all the children of this node, recursively */
                 ret = moveto_self_add_children_r(parent, 0, LYXP_NODE_ELEM, to_set, dup_check_set, root_type, options);
                 if (ret) {
@@ -6334,8 +7192,8 @@ moveto_self_add_children_r(const struct lyd_node *parent, uint32_t parent_pos, e
         /* add all the children ... */
         if (!(parent->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST))) {
             LY_TREE_FOR(parent->child, sub) {
-                /* context check */
-                if ((root_type == LYXP_NODE_ROOT_CONFIG) && (sub->schema->flags & LYS_CONFIG_R)) {
+                /* presence and context check */
+                if (lyxp_node_hidden(sub) || ((root_type == LYXP_NODE_ROOT_CONFIG) && (sub->schema->flags & LYS_CONFIG_R))) {
                     continue;
                 }
 
@@ -6348,7 +7206,7 @@ moveto_self_add_children_r(const struct lyd_node *parent, uint32_t parent_pos, e
                     set_insert_node(to_set, sub, 0, LYXP_NODE_ELEM, to_set->used);
 
                     /* skip anydata/anyxml and dummy nodes */
-                    if ((sub->schema->nodetype & LYS_ANYDATA) || (sub->validity & LYD_VAL_INUSE)) {
+                    if ((sub->schema->nodetype & LYS_ANYDATA) || lyxp_node_dummy(sub)) {
                         continue;
                     }
 
@@ -6425,7 +7283,7 @@ moveto_self(struct lyxp_set *set, struct lyd_node *cur_node, int all_desc, int o
         }
 
         /* skip anydata/anyxml and dummy nodes */
-        if ((set->val.nodes[i].node->schema->nodetype & LYS_ANYDATA) || (set->val.nodes[i].node->validity & LYD_VAL_INUSE)) {
+        if ((set->val.nodes[i].node->schema->nodetype & LYS_ANYDATA) || lyxp_node_dummy(set->val.nodes[i].node)) {
             continue;
         }
 
@@ -6777,6 +7635,9 @@ moveto_op_comp(struct lyxp_set *set1, struct lyxp_set *set2, const char *op, str
             for (i = 0; i < set1->used; ++i) {
                 switch (set2->type) {
                 case LYXP_SET_NUMBER:
+                    if (!set_comp_cast_num(&iter1, set1, cur_node, i, options)) {
+                        break;
+                    }
                     if (set_comp_cast(&iter1, set1, LYXP_SET_NUMBER, cur_node, local_mod, i, options)) {
                         return -1;
                     }
@@ -6787,6 +7648,10 @@ moveto_op_comp(struct lyxp_set *set1, struct lyxp_set *set2, const char *op, str
                     }
                     break;
                 default:
+                    if (((op[0] == '<') || (op[0] == '>')) && !set_comp_cast_num(&iter1, set1, cur_node, i, options)) {
+                        /* relational operators compare numbers anyway */
+                        break;
+                    }
                     if (set_comp_cast(&iter1, set1, LYXP_SET_STRING, cur_node, local_mod, i, options)) {
                         return -1;
                     }
@@ -6812,6 +7677,9 @@ moveto_op_comp(struct lyxp_set *set1, struct lyxp_set *set2, const char *op, str
             for (i = 0; i < set2->used; ++i) {
                 switch (set1->type) {
                     case LYXP_SET_NUMBER:
+                        if (!set_comp_cast_num(&iter2, set2, cur_node, i, options)) {
+                            break;
+                        }
                         if (set_comp_cast(&iter2, set2, LYXP_SET_NUMBER, cur_node, local_mod, i, options)) {
                             return -1;
                         }
@@ -6822,6 +7690,10 @@ moveto_op_comp(struct lyxp_set *set1, struct lyxp_set *set2, const char *op, str
                         }
                         break;
                     default:
+                        if (((op[0] == '<') || (op[0] == '>')) && !set_comp_cast_num(&iter2, set2, cur_node, i, options)) {
+                            /* relational operators compare numbers anyway */
+                            break;
+                        }
                         if (set_comp_cast(&iter2, set2, LYXP_SET_STRING, cur_node, local_mod, i, options)) {
                             return -1;
                         }
@@ -7142,6 +8014,40 @@ eval_node_test(struct lyxp_expr *exp, uint16_t *exp_idx, struct lyd_node *cur_no
     return EXIT_SUCCESS;
 }
 
+/**
+ * @brief Check whether an expression (a function argument or a predicate) is only a location path
+ *        without any predicates so its result is always a node-set.
+ *
+ * @param[in] exp Parsed XPath expression.
+ * @param[in] exp_idx Position of the expression beginning in \p exp.
+ *
+ * @return 1 if it is, 0 otherwise.
+ */
+static int
+exp_is_path_only(struct lyxp_expr *exp, uint16_t exp_idx)
+{
+    uint16_t i;
+
+    for (i = exp_idx; i < exp->used; ++i) {
+        switch (exp->tokens[i]) {
+        case LYXP_TOKEN_OPERATOR_PATH:
+        case LYXP_TOKEN_NAMETEST:
+        case LYXP_TOKEN_DOT:
+        case LYXP_TOKEN_DDOT:
+            break;
+        case LYXP_TOKEN_PAR2:
+        case LYXP_TOKEN_BRACK2:
+        case LYXP_TOKEN_COMMA:
+            /* end of the expression */
+            return (i > exp_idx);
+        default:
+            return 0;
+        }
+    }
+
+    return (i > exp_idx);
+}
+
 /**
  * @brief Evaluate Predicate. Logs directly on error.
  *
@@ -7159,12 +8065,15 @@ static int
 eval_predicate(struct lyxp_expr *exp, uint16_t *exp_idx, struct lyd_node *cur_node, struct lys_module *local_mod,
                struct lyxp_set *set, int options, int parent_pos_pred)
 {
-    int ret;
+    int ret, pred_options;
     uint16_t i, orig_exp;
     uint32_t orig_pos, orig_size, pred_in_ctx;
     struct lyxp_set set2;
     struct lyd_node *orig_parent;
 
+    /* the predicate filters the nodes, all of them are needed */
+    options &= ~LYXP_EXISTS;
+
     /* '[' */
     LOGDBG(LY_LDGXPATH, "%-27s %s %s[%u]", __func__, (set ? "parsed" : "skipped"),
            print_token(exp->tokens[*exp_idx]), exp->expr_pos[*exp_idx]);
@@ -7189,6 +8098,11 @@ only_parse:
         orig_pos = 0;
         orig_size = set->used;
         orig_parent = NULL;
+        pred_options = options;
+        if (!(options & LYXP_WHEN) && exp_is_path_only(exp, orig_exp)) {
+            /* the predicate is a node-set, it is satisfied by any node */
+            pred_options |= LYXP_EXISTS;
+        }
         for (i = 0; i < set->used; ++i) {
             memset(&set2, 0, sizeof set2);
             set_insert_node(&set2, set->val.nodes[i].node, set->val.nodes[i].pos, set->val.nodes[i].type, 0);
@@ -7206,7 +8120,7 @@ only_parse:
             set2.ctx_size = orig_size;
             *exp_idx = orig_exp;
 
-            ret = eval_expr_select(exp, exp_idx, 0, cur_node, local_mod, &set2, options);
+            ret = eval_expr_select(exp, exp_idx, 0, cur_node, local_mod, &set2, pred_options);
             if (ret == -1 || ret == EXIT_FAILURE) {
                 lyxp_set_cast(&set2, LYXP_SET_EMPTY, cur_node, local_mod, options);
                 return ret;
@@ -7322,7 +8236,7 @@ static int
 eval_relative_location_path(struct lyxp_expr *exp, uint16_t *exp_idx, struct lyd_node *cur_node, struct lys_module *local_mod,
                             int all_desc, struct lyxp_set *set, int options)
 {
-    int attr_axis, ret;
+    int attr_axis, ret, step_options;
 
     goto step;
     do {
@@ -7381,9 +8295,28 @@ step:
             /* fall through */
         case LYXP_TOKEN_NAMETEST:
         case LYXP_TOKEN_NODETYPE:
-            ret = eval_node_test(exp, exp_idx, cur_node, local_mod, attr_axis, all_desc, set, options);
+            step_options = options;
+            if ((exp->used > *exp_idx + 1) && ((exp->tokens[*exp_idx + 1] == LYXP_TOKEN_OPERATOR_PATH)
+                    || (exp->tokens[*exp_idx + 1] == LYXP_TOKEN_BRACK1))) {
+                /* only the last step can stop at the first match */
+                step_options &= ~LYXP_EXISTS;
+            }
+
+            ret = 1;
+#ifdef LY_ENABLED_CACHE
+            if (!attr_axis && !all_desc) {
+                /* instances selected by all their keys are found directly */
+                ret = moveto_node_hash(exp, exp_idx, cur_node, set, options);
+                if (ret == -1) {
+                    return ret;
+                }
+            }
+#endif
             if (ret) {
-                return ret;
+                ret = eval_node_test(exp, exp_idx, cur_node, local_mod, attr_axis, all_desc, set, step_options);
+                if (ret) {
+                    return ret;
+                }
             }
 
             while ((exp->used > *exp_idx) && (exp->tokens[*exp_idx] == LYXP_TOKEN_BRACK1)) {
@@ -7474,6 +8407,174 @@ eval_absolute_location_path(struct lyxp_expr *exp, uint16_t *exp_idx, struct lyd
     return EXIT_SUCCESS;
 }
 
+/**
+ * @brief Execute a user XPath function. Returns LYXP_SET_EMPTY, a node-set or the result of the function.
+ *
+ * @param[in] func User XPath function.
+ * @param[in] args Array of arguments.
+ * @param[in] arg_count Count of elements in \p args.
+ * @param[in] cur_node Original context node (schema node when atomizing).
+ * @param[in] local_mod Current module.
+ * @param[in,out] set Context and result set at the same time.
+ * @param[in] options XPath options.
+ *
+ * @return EXIT_SUCCESS on success, EXIT_FAILURE on unresolved when dependency, -1 on error.
+ */
+static int
+xpath_user_func(const struct lyxp_func_list *func, struct lyxp_set **args, uint16_t arg_count, struct lyd_node *cur_node,
+                struct lys_module *local_mod, struct lyxp_set *set, int options)
+{
+    struct lyxp_value *vals = NULL, res;
+    struct ly_set **snodes = NULL, *res_snodes = NULL;
+    struct lyxp_set node_set;
+    uint16_t i;
+    uint32_t j;
+    int ret = -1;
+
+    if (options & LYXP_SNODE_ALL) {
+        ret = EXIT_SUCCESS;
+        if (func->atomize_clb) {
+            snodes = calloc(arg_count, sizeof *snodes);
+            res_snodes = ly_set_new();
+            LY_CHECK_ERR_GOTO((arg_count && !snodes) || !res_snodes, LOGMEM(local_mod->ctx); ret = -1, snode_cleanup);
+            for (i = 0; i < arg_count; ++i) {
+                if (args[i]->type != LYXP_SET_SNODE_SET) {
+                    continue;
+                }
+                snodes[i] = ly_set_new();
+                LY_CHECK_ERR_GOTO(!snodes[i], LOGMEM(local_mod->ctx); ret = -1, snode_cleanup);
+                for (j = 0; j < args[i]->used; ++j) {
+                    if ((args[i]->val.snodes[j].in_ctx == 1) && (args[i]->val.snodes[j].type == LYXP_NODE_ELEM)) {
+                        ly_set_add(snodes[i], args[i]->val.snodes[j].snode, LY_SET_OPT_USEASLIST);
+                    }
+                }
+            }
+
+            if (func->atomize_clb(snodes, arg_count, (struct lys_node *)cur_node, res_snodes)) {
+                LOGWRN(local_mod->ctx, "Arguments of the XPath function %s are not suitable.", func->name);
+                ret = EXIT_FAILURE;
+            }
+        }
+
+        set_snode_clear_ctx(set);
+        for (j = 0; res_snodes && (j < res_snodes->number); ++j) {
+            if (set_snode_insert_node(set, res_snodes->set.s[j], LYXP_NODE_ELEM) == -1) {
+                ret = -1;
+                break;
+            }
+        }
+
+snode_cleanup:
+        for (i = 0; snodes && (i < arg_count); ++i) {
+            ly_set_free(snodes[i]);
+        }
+        free(snodes);
+        ly_set_free(res_snodes);
+        return ret;
+    }
+
+    if (arg_count) {
+        vals = calloc(arg_count, sizeof *vals);
+        LY_CHECK_ERR_RETURN(!vals, LOGMEM(local_mod->ctx), -1);
+    }
+    for (i = 0; i < arg_count; ++i) {
+        if ((func->flags & LYXP_FUNC_NODE_ARGS) && ((args[i]->type == LYXP_SET_NODE_SET) || (args[i]->type == LYXP_SET_EMPTY))) {
+            vals[i].type = LYXP_VALUE_NODES;
+            if (args[i]->type == LYXP_SET_EMPTY) {
+                continue;
+            }
+            vals[i].value.nodes.nodes = malloc(args[i]->used * sizeof *vals[i].value.nodes.nodes);
+            LY_CHECK_ERR_GOTO(!vals[i].value.nodes.nodes, LOGMEM(local_mod->ctx), cleanup);
+            for (j = 0; j < args[i]->used; ++j) {
+                if (args[i]->val.nodes[j].type == LYXP_NODE_ELEM) {
+                    vals[i].value.nodes.nodes[vals[i].value.nodes.count++] = args[i]->val.nodes[j].node;
+                }
+            }
+            continue;
+        }
+
+        if ((args[i]->type == LYXP_SET_NODE_SET) || (args[i]->type == LYXP_SET_EMPTY)) {
+            if (lyxp_set_cast(args[i], LYXP_SET_STRING, cur_node, local_mod, options)) {
+                goto cleanup;
+            }
+        }
+        switch (args[i]->type) {
+        case LYXP_SET_BOOLEAN:
+            vals[i].type = LYXP_VALUE_BOOLEAN;
+            vals[i].value.boolean = args[i]->val.bool;
+            break;
+        case LYXP_SET_NUMBER:
+            vals[i].type = LYXP_VALUE_NUMBER;
+            vals[i].value.number = args[i]->val.num;
+            break;
+        case LYXP_SET_STRING:
+            vals[i].type = LYXP_VALUE_STRING;
+            vals[i].value.string = args[i]->val.str;
+            break;
+        default:
+            LOGINT(local_mod->ctx);
+            goto cleanup;
+        }
+    }
+
+    memset(&res, 0, sizeof res);
+    if (func->clb(vals, arg_count, cur_node, &res)) {
+        LOGVAL(local_mod->ctx, LYE_SPEC, LY_VLOG_LYD, cur_node, "XPath function %s failed.", func->name);
+        /* the results are allocated by the C library */
+        if (res.type == LYXP_VALUE_NODES) {
+            (free)(res.value.nodes.nodes);
+        } else if (res.type == LYXP_VALUE_STRING) {
+            (free)(res.value.string);
+        }
+        goto cleanup;
+    }
+
+    lyxp_set_cast(set, LYXP_SET_EMPTY, cur_node, local_mod, options);
+    switch (res.type) {
+    case LYXP_VALUE_NODES:
+        /* merged one by one to get them in the document order and without duplicates */
+        memset(&node_set, 0, sizeof node_set);
+        for (j = 0; j < res.value.nodes.count; ++j) {
+            set_insert_node(&node_set, res.value.nodes.nodes[j], 0, LYXP_NODE_ELEM, 0);
+            if (set_sorted_merge(set, &node_set, cur_node, options)) {
+                lyxp_set_cast(&node_set, LYXP_SET_EMPTY, cur_node, local_mod, options);
+                break;
+            }
+        }
+        (free)(res.value.nodes.nodes);
+        if (j < res.value.nodes.count) {
+            goto cleanup;
+        }
+        break;
+    case LYXP_VALUE_BOOLEAN:
+        set_fill_boolean(set, res.value.boolean);
+        break;
+    case LYXP_VALUE_NUMBER:
+        set_fill_number(set, res.value.number);
+        break;
+    case LYXP_VALUE_STRING:
+        if (!res.value.string) {
+            LOGINT(local_mod->ctx);
+            goto cleanup;
+        }
+        set->type = LYXP_SET_STRING;
+        set->val.str = ly_mem_adopt(res.value.string);
+        LY_CHECK_ERR_GOTO(!set->val.str, LOGMEM(local_mod->ctx); set->type = LYXP_SET_EMPTY, cleanup);
+        break;
+    }
+
+    ret = EXIT_SUCCESS;
+
+cleanup:
+    for (i = 0; i < arg_count; ++i) {
+        if (vals[i].type == LYXP_VALUE_NODES) {
+            free(vals[i].value.nodes.nodes);
+        }
+    }
+    free(vals);
+    return ret;
+}
+
 /**
  * @brief Evaluate FunctionCall. Logs directly on error.
  *
@@ -7493,8 +8594,10 @@ eval_function_call(struct lyxp_expr *exp, uint16_t *exp_idx, struct lyd_node *cu
 {
     int rc = EXIT_FAILURE;
     int (*xpath_func)(struct lyxp_set **, uint16_t, struct lyd_node *, struct lys_module *, struct lyxp_set *, int) = NULL;
+    const struct lyxp_func_list *user_func = NULL;
     uint16_t arg_count = 0, i, func_exp = *exp_idx;
     struct lyxp_set **args = NULL, **args_aux;
+    int arg_options;
 
     if (set) {
         /* FunctionName */
@@ -7609,7 +8712,8 @@ eval_function_call(struct lyxp_expr *exp, uint16_t *exp_idx, struct lyd_node *cu
             break;
         }
 
-        if (!xpath_func) {
+        if (!xpath_func
+                && !(user_func = xpath_get_plugin_func(&exp->expr[exp->expr_pos[*exp_idx]], exp->tok_len[*exp_idx]))) {
             LOGVAL(local_mod->ctx, LYE_XPATH_INTOK, LY_VLOG_NONE, NULL, "Unknown", &exp->expr[exp->expr_pos[*exp_idx]]);
             LOGVAL(local_mod->ctx, LYE_SPEC, LY_VLOG_NONE, NULL,
                    "Unknown XPath function \"%.*s\".", exp->tok_len[*exp_idx], &exp->expr[exp->expr_pos[*exp_idx]]);
@@ -7638,7 +8742,14 @@ eval_function_call(struct lyxp_expr *exp, uint16_t *exp_idx, struct lyd_node *cu
                 goto cleanup;
             }
 
-            rc = eval_expr_select(exp, exp_idx, 0, cur_node, local_mod, args[0], options);
+            arg_options = options;
+            if (((xpath_func == &xpath_boolean) || (xpath_func == &xpath_not)) && !(options & (LYXP_SNODE_ALL | LYXP_WHEN))
+                    && exp_is_path_only(exp, *exp_idx)) {
+                /* a node-set argument is true if not empty */
+                arg_options |= LYXP_EXISTS;
+            }
+
+            rc = eval_expr_select(exp, exp_idx, 0, cur_node, local_mod, args[0], arg_options);
             if (rc == -1 || rc == EXIT_FAILURE) {
                 goto cleanup;
             }
@@ -7684,7 +8795,11 @@ eval_function_call(struct lyxp_expr *exp, uint16_t *exp_idx, struct lyd_node *cu
 
     if (set) {
         /* evaluate function */
-        rc = xpath_func(args, arg_count, cur_node, local_mod, set, options);
+        if (user_func) {
+            rc = xpath_user_func(user_func, args, arg_count, cur_node, local_mod, set, options);
+        } else {
+            rc = xpath_func(args, arg_count, cur_node, local_mod, set, options);
+        }
 
         if (options & LYXP_SNODE_ALL) {
             if (rc == EXIT_FAILURE) {
@@ -8573,42 +9688,48 @@ eval_expr_select(struct lyxp_expr *exp, uint16_t *exp_idx, enum lyxp_expr_type e
     return ret;
 }
 
-int
-lyxp_eval(const char *expr, const struct lyd_node *cur_node, enum lyxp_node_type cur_node_type,
-          const struct lys_module *local_mod, struct lyxp_set *set, int options)
+struct lyxp_expr *
+lyxp_compile_expr(struct ly_ctx *ctx, const char *expr)
 {
-    struct ly_ctx *ctx;
     struct lyxp_expr *exp;
     uint16_t exp_idx = 0;
-    int rc = -1;
-
-    if (!expr || !local_mod || !set) {
-        LOGARG;
-        return EXIT_FAILURE;
-    }
-
-    ctx = local_mod->ctx;
 
     exp = lyxp_parse_expr(ctx, expr);
     if (!exp) {
-        rc = -1;
-        goto finish;
+        return NULL;
     }
 
-    rc = reparse_or_expr(ctx, exp, &exp_idx);
-    if (rc) {
-        goto finish;
+    if (reparse_or_expr(ctx, exp, &exp_idx)) {
+        goto error;
     } else if (exp->used > exp_idx) {
         LOGVAL(ctx, LYE_XPATH_INTOK, LY_VLOG_NONE, NULL, "Unknown", &exp->expr[exp->expr_pos[exp_idx]]);
         LOGVAL(ctx, LYE_SPEC, LY_VLOG_NONE, NULL, "Unparsed characters \"%s\" left at the end of an XPath expression.",
                &exp->expr[exp->expr_pos[exp_idx]]);
-        rc = -1;
-        goto finish;
+        goto error;
     }
 
     print_expr_struct_debug(exp);
+    return exp;
+
+error:
+    lyxp_expr_free(exp);
+    return NULL;
+}
+
+int
+lyxp_eval_expr(struct lyxp_expr *exp, const struct lyd_node *cur_node, enum lyxp_node_type cur_node_type,
+               const struct lys_module *local_mod, struct lyxp_set *set, int options)
+{
+    uint16_t exp_idx = 0;
+    int rc;
+
+    if (!exp || !local_mod || !set) {
+        LOGARG;
+        return EXIT_FAILURE;
+    }
+
+    ly_phase(LY_TRACE_XPATH, 0, local_mod->ctx);
 
-    exp_idx = 0;
     memset(set, 0, sizeof *set);
     set->type = LYXP_SET_EMPTY;
     if (cur_node) {
@@ -8620,15 +9741,154 @@ lyxp_eval(const char *expr, const struct lyd_node *cur_node, enum lyxp_node_type
         rc = EXIT_SUCCESS;
     }
     if ((rc == -1) && cur_node) {
-        LOGPATH(ctx, LY_VLOG_LYD, cur_node);
+        LOGPATH(local_mod->ctx, LY_VLOG_LYD, cur_node);
         lyxp_set_cast(set, LYXP_SET_EMPTY, cur_node, local_mod, options);
     }
 
-finish:
+    ++ly_cnt.xpath_evals;
+    if (set->type == LYXP_SET_NODE_SET) {
+        ly_cnt.xpath_set_nodes += set->used;
+    }
+    ly_phase(LY_TRACE_XPATH, 1, local_mod->ctx);
+    return rc;
+}
+
+int
+lyxp_eval(const char *expr, const struct lyd_node *cur_node, enum lyxp_node_type cur_node_type,
+          const struct lys_module *local_mod, struct lyxp_set *set, int options)
+{
+    struct lyxp_expr *exp;
+    int rc;
+
+    if (!expr || !local_mod || !set) {
+        LOGARG;
+        return EXIT_FAILURE;
+    }
+
+    exp = lyxp_compile_expr(local_mod->ctx, expr);
+    if (!exp) {
+        return -1;
+    }
+
+    rc = lyxp_eval_expr(exp, cur_node, cur_node_type, local_mod, set, options);
     lyxp_expr_free(exp);
     return rc;
 }
 
+static int
+lyxp_expr_cache_equal(void *val1_p, void *val2_p, int UNUSED(mod), void *UNUSED(cb_data))
+{
+    struct lyxp_expr *exp1 = *(struct lyxp_expr **)val1_p, *exp2 = *(struct lyxp_expr **)val2_p;
+
+    return !strcmp(exp1->expr, exp2->expr);
+}
+
+struct lyxp_expr *
+lyxp_expr_cache_get(struct ly_ctx *ctx, const char *expr)
+{
+    struct lyxp_expr key, *exp, **match;
+    uint32_t hash;
+
+    /* only the expression is compared */
+    key.expr = (char *)expr;
+    exp = &key;
+    hash = dict_hash_multi(0, expr, strlen(expr));
+    hash = dict_hash_multi(hash, NULL, 0);
+
+    /* the expressions are usually compiled already, the readers do not block each other */
+    pthread_rwlock_rdlock(&ctx->xpath_cache_lock);
+    if (ctx->xpath_cache && !lyht_find(ctx->xpath_cache, &exp, hash, (void **)&match)) {
+        exp = *match;
+        goto cleanup;
+    }
+    pthread_rwlock_unlock(&ctx->xpath_cache_lock);
+
+    /* it may have been compiled meanwhile */
+    pthread_rwlock_wrlock(&ctx->xpath_cache_lock);
+
+    if (!ctx->xpath_cache) {
+        ctx->xpath_cache = lyht_new(8, sizeof exp, lyxp_expr_cache_equal, NULL, 1);
+        LY_CHECK_ERR_GOTO(!ctx->xpath_cache, exp = NULL, cleanup);
+    }
+
+    if (!lyht_find(ctx->xpath_cache, &exp, hash, (void **)&match)) {
+        exp = *match;
+        goto cleanup;
+    }
+
+    /* not compiled yet */
+    exp = lyxp_compile_expr(ctx, expr);
+    if (exp && lyht_insert(ctx->xpath_cache, &exp, hash, NULL)) {
+        LOGINT(ctx);
+        lyxp_expr_free(exp);
+        exp = NULL;
+    }
+
+cleanup:
+    pthread_rwlock_unlock(&ctx->xpath_cache_lock);
+    return exp;
+}
+
+void
+lyxp_expr_cache_clean(struct ly_ctx *ctx)
+{
+    uint32_t i;
+    struct lyxp_expr **exp_p;
+
+    pthread_rwlock_wrlock(&ctx->xpath_cache_lock);
+
+    if (ctx->xpath_cache) {
+        lyht_finish_resize(ctx->xpath_cache);
+        for (i = 0; i < ctx->xpath_cache->size; ++i) {
+            exp_p = lyht_get_val(ctx->xpath_cache, i);
+            if (exp_p) {
+                lyxp_expr_free(*exp_p);
+            }
+        }
+        lyht_free(ctx->xpath_cache);
+        ctx->xpath_cache = NULL;
+    }
+
+    pthread_rwlock_unlock(&ctx->xpath_cache_lock);
+}
+
+void
+lyxp_regex_cache_clean(struct ly_ctx *ctx)
+{
+    int i;
+
+    pthread_mutex_lock(&ctx->regex_cache_lock);
+
+    for (i = 0; (i < LY_REGEX_CACHE_SIZE) && ctx->regex_cache[i].pattern; ++i) {
+        free(ctx->regex_cache[i].pattern);
+        pcre_free(ctx->regex_cache[i].precomp);
+        pcre_free_study(ctx->regex_cache[i].extra);
+    }
+    memset(ctx->regex_cache, 0, sizeof ctx->regex_cache);
+    ctx->regex_cache_used = 0;
+
+    pthread_mutex_unlock(&ctx->regex_cache_lock);
+}
+
+int
+lyxp_eval_cached(const char *expr, const struct lyd_node *cur_node, enum lyxp_node_type cur_node_type,
+                 const struct lys_module *local_mod, struct lyxp_set *set, int options)
+{
+    struct lyxp_expr *exp;
+
+    if (!expr || !local_mod || !set) {
+        LOGARG;
+        return EXIT_FAILURE;
+    }
+
+    exp = lyxp_expr_cache_get(local_mod->ctx, expr);
+    if (!exp) {
+        return -1;
+    }
+
+    return lyxp_eval_expr(exp, cur_node, cur_node_type, local_mod, set, options);
+}
+
 #if 0
 
 /* full xml printing of set elements, not used currently */
@@ -9123,68 +10383,293 @@ finish:
     return ret;
 }
 
-int
-lyxp_node_check_syntax(const struct lys_node *node)
+/* item of the reverse XPath dependency index */
+struct lyxp_dep {
+    const struct lys_node *snode;   /* schema node accessed by the expressions */
+    struct ly_set *dependents;      /* schema nodes with when or must expressions accessing snode */
+};
+
+static int
+lyxp_deps_equal(void *val1_p, void *val2_p, int UNUSED(mod), void *UNUSED(cb_data))
+{
+    return ((struct lyxp_dep *)val1_p)->snode == ((struct lyxp_dep *)val2_p)->snode;
+}
+
+static uint32_t
+lyxp_deps_hash(const struct lys_node *snode)
+{
+    uint32_t hash;
+
+    hash = dict_hash_multi(0, (const char *)&snode, sizeof snode);
+    return dict_hash_multi(hash, NULL, 0);
+}
+
+/**
+ * @brief Add all the dependencies of the when and must expressions of a schema node into the index.
+ *
+ * @param[in] ht Reverse dependency index.
+ * @param[in] node Schema node with the expressions.
+ * @return EXIT_SUCCESS on success, -1 on error.
+ */
+static int
+lyxp_deps_add_node(struct hash_table *ht, const struct lys_node *node)
+{
+    struct lyxp_set set;
+    struct lyxp_dep dep, *match;
+    uint32_t i, hash;
+    enum int_log_opts prev_ilo;
+    int rc;
+
+    /* the expressions were checked when the schema was parsed, ignore those that cannot be atomized */
+    ly_ilo_change(NULL, ILO_IGNORE, &prev_ilo, NULL);
+    rc = lyxp_node_atomize(node, &set, 0);
+    ly_ilo_restore(NULL, prev_ilo, NULL, 0);
+    if (rc) {
+        return EXIT_SUCCESS;
+    }
+
+    for (i = 0; i < set.used; ++i) {
+        if (set.val.snodes[i].type != LYXP_NODE_ELEM) {
+            /* skip roots */
+            continue;
+        }
+
+        dep.snode = set.val.snodes[i].snode;
+        hash = lyxp_deps_hash(dep.snode);
+        if (lyht_find(ht, &dep, hash, (void **)&match)) {
+            dep.dependents = ly_set_new();
+            LY_CHECK_ERR_GOTO(!dep.dependents, LOGMEM(node->module->ctx), error);
+            if (lyht_insert(ht, &dep, hash, (void **)&match)) {
+                ly_set_free(dep.dependents);
+                LOGINT(node->module->ctx);
+                goto error;
+            }
+        }
+        if (ly_set_add(match->dependents, (void *)node, 0) == -1) {
+            goto error;
+        }
+    }
+
+    free(set.val.snodes);
+    return EXIT_SUCCESS;
+
+error:
+    free(set.val.snodes);
+    return -1;
+}
+
+/**
+ * @brief Add the dependencies of all the expressions in schema siblings and their subtrees into the index.
+ *
+ * @param[in] ht Reverse dependency index.
+ * @param[in] first First schema sibling.
+ * @return EXIT_SUCCESS on success, -1 on error.
+ */
+static int
+lyxp_deps_add_siblings(struct hash_table *ht, const struct lys_node *first)
+{
+    const struct lys_node *node;
+
+    for (node = first; node; node = node->next) {
+        if (node->nodetype == LYS_GROUPING) {
+            /* only instantiated nodes */
+            continue;
+        }
+
+        if (node->parent && (node->parent->nodetype == LYS_AUGMENT) && (node->parent->child == node)
+                && lyxp_deps_add_node(ht, node->parent)) {
+            /* augment when, processed with its first child */
+            return -1;
+        }
+
+        if (lyxp_deps_add_node(ht, node)) {
+            return -1;
+        }
+        if (!(node->nodetype & (LYS_LEAF | LYS_LEAFLIST | LYS_ANYDATA)) && lyxp_deps_add_siblings(ht, node->child)) {
+            return -1;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
+
+static void
+lyxp_deps_free(struct hash_table *ht)
 {
-    uint8_t must_size = 0;
-    uint16_t exp_idx;
     uint32_t i;
-    struct lys_when *when = NULL;
-    struct lys_restr *must = NULL;
-    struct lyxp_expr *expr;
+    struct lyxp_dep *dep;
+
+    if (!ht) {
+        return;
+    }
+
+    lyht_finish_resize(ht);
+    for (i = 0; i < ht->size; ++i) {
+        dep = lyht_get_val(ht, i);
+        if (dep) {
+            ly_set_free(dep->dependents);
+        }
+    }
+    lyht_free(ht);
+}
+
+int
+lyxp_deps_get(const struct lys_node *node, const struct ly_set **dependents)
+{
+    struct ly_ctx *ctx = node->module->ctx;
+    struct lyxp_dep dep, *match;
+    int i, ret = EXIT_SUCCESS;
+
+    *dependents = NULL;
+
+    pthread_mutex_lock(&ctx->xpath_deps_lock);
+
+    if (ctx->xpath_deps && (ctx->xpath_deps_set_id != ctx->models.module_set_id)) {
+        /* modules changed, build the index again */
+        lyxp_deps_free(ctx->xpath_deps);
+        ctx->xpath_deps = NULL;
+    }
+
+    if (!ctx->xpath_deps) {
+        ctx->xpath_deps = lyht_new(8, sizeof dep, lyxp_deps_equal, NULL, 1);
+        LY_CHECK_ERR_GOTO(!ctx->xpath_deps, LOGMEM(ctx); ret = -1, cleanup);
+        ctx->xpath_deps_set_id = ctx->models.module_set_id;
+
+        for (i = 0; i < ctx->models.used; ++i) {
+            if (ctx->models.list[i]->implemented && lyxp_deps_add_siblings(ctx->xpath_deps, ctx->models.list[i]->data)) {
+                ret = -1;
+                goto cleanup;
+            }
+        }
+    }
+
+    dep.snode = node;
+    if (!lyht_find(ctx->xpath_deps, &dep, lyxp_deps_hash(node), (void **)&match)) {
+        *dependents = match->dependents;
+    }
+
+cleanup:
+    if (ret) {
+        lyxp_deps_free(ctx->xpath_deps);
+        ctx->xpath_deps = NULL;
+    }
+    pthread_mutex_unlock(&ctx->xpath_deps_lock);
+    return ret;
+}
+
+void
+lyxp_deps_clean(struct ly_ctx *ctx)
+{
+    pthread_mutex_lock(&ctx->xpath_deps_lock);
+
+    lyxp_deps_free(ctx->xpath_deps);
+    ctx->xpath_deps = NULL;
+
+    pthread_mutex_unlock(&ctx->xpath_deps_lock);
+}
+
+/**
+ * @brief Get the when and must restrictions of a schema node.
+ *
+ * @param[in] node Schema node.
+ * @param[out] when When of the node, NULL if it has none.
+ * @param[out] must Must restrictions of the node.
+ * @param[out] must_size Number of the must restrictions.
+ */
+static void
+lyxp_node_when_must(const struct lys_node *node, struct lys_when **when, struct lys_restr **must, uint8_t *must_size)
+{
+    *when = NULL;
+    *must = NULL;
+    *must_size = 0;
 
     switch (node->nodetype) {
     case LYS_CONTAINER:
-        when = ((struct lys_node_container *)node)->when;
-        must = ((struct lys_node_container *)node)->must;
-        must_size = ((struct lys_node_container *)node)->must_size;
+        *when = ((struct lys_node_container *)node)->when;
+        *must = ((struct lys_node_container *)node)->must;
+        *must_size = ((struct lys_node_container *)node)->must_size;
         break;
     case LYS_CHOICE:
-        when = ((struct lys_node_choice *)node)->when;
+        *when = ((struct lys_node_choice *)node)->when;
         break;
     case LYS_LEAF:
-        when = ((struct lys_node_leaf *)node)->when;
-        must = ((struct lys_node_leaf *)node)->must;
-        must_size = ((struct lys_node_leaf *)node)->must_size;
+        *when = ((struct lys_node_leaf *)node)->when;
+        *must = ((struct lys_node_leaf *)node)->must;
+        *must_size = ((struct lys_node_leaf *)node)->must_size;
         break;
     case LYS_LEAFLIST:
-        when = ((struct lys_node_leaflist *)node)->when;
-        must = ((struct lys_node_leaflist *)node)->must;
-        must_size = ((struct lys_node_leaflist *)node)->must_size;
+        *when = ((struct lys_node_leaflist *)node)->when;
+        *must = ((struct lys_node_leaflist *)node)->must;
+        *must_size = ((struct lys_node_leaflist *)node)->must_size;
         break;
     case LYS_LIST:
-        when = ((struct lys_node_list *)node)->when;
-        must = ((struct lys_node_list *)node)->must;
-        must_size = ((struct lys_node_list *)node)->must_size;
+        *when = ((struct lys_node_list *)node)->when;
+        *must = ((struct lys_node_list *)node)->must;
+        *must_size = ((struct lys_node_list *)node)->must_size;
         break;
     case LYS_ANYXML:
     case LYS_ANYDATA:
-        when = ((struct lys_node_anydata *)node)->when;
-        must = ((struct lys_node_anydata *)node)->must;
-        must_size = ((struct lys_node_anydata *)node)->must_size;
+        *when = ((struct lys_node_anydata *)node)->when;
+        *must = ((struct lys_node_anydata *)node)->must;
+        *must_size = ((struct lys_node_anydata *)node)->must_size;
         break;
     case LYS_CASE:
-        when = ((struct lys_node_case *)node)->when;
+        *when = ((struct lys_node_case *)node)->when;
         break;
     case LYS_NOTIF:
-        must = ((struct lys_node_notif *)node)->must;
-        must_size = ((struct lys_node_notif *)node)->must_size;
+        *must = ((struct lys_node_notif *)node)->must;
+        *must_size = ((struct lys_node_notif *)node)->must_size;
         break;
     case LYS_INPUT:
     case LYS_OUTPUT:
-        must = ((struct lys_node_inout *)node)->must;
-        must_size = ((struct lys_node_inout *)node)->must_size;
+        *must = ((struct lys_node_inout *)node)->must;
+        *must_size = ((struct lys_node_inout *)node)->must_size;
         break;
     case LYS_USES:
-        when = ((struct lys_node_uses *)node)->when;
+        *when = ((struct lys_node_uses *)node)->when;
         break;
     case LYS_AUGMENT:
-        when = ((struct lys_node_augment *)node)->when;
+        *when = ((struct lys_node_augment *)node)->when;
         break;
     default:
         /* nothing to check */
         break;
     }
+}
+
+int
+lyxp_node_precompile(const struct lys_node *node)
+{
+    uint8_t must_size;
+    uint32_t i;
+    struct lys_when *when;
+    struct lys_restr *must;
+
+    lyxp_node_when_must(node, &when, &must, &must_size);
+
+    if (when && !lyxp_expr_cache_get(node->module->ctx, when->cond)) {
+        return -1;
+    }
+    for (i = 0; i < must_size; ++i) {
+        if (!lyxp_expr_cache_get(node->module->ctx, must[i].expr)) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+int
+lyxp_node_check_syntax(const struct lys_node *node)
+{
+    uint8_t must_size;
+    uint16_t exp_idx;
+    uint32_t i;
+    struct lys_when *when;
+    struct lys_restr *must;
+    struct lyxp_expr *expr;
+
+    lyxp_node_when_must(node, &when, &must, &must_size);
 
     /* check "when" */
     if (when) {
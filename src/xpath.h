@@ -80,6 +80,13 @@
 #define LYXP_STRING_CAST_SIZE_START 64
 #define LYXP_STRING_CAST_SIZE_STEP 16
 
+/* minimal number of nodes without a position to number them in a single DFS */
+#define LYXP_SET_POS_DFS_MIN 8
+
+/* per-thread pool of released sets and set arrays, larger arrays are freed */
+#define LYXP_SET_POOL_SIZE 16
+#define LYXP_SET_POOL_MAX_NODES 1024
+
 /**
  * @brief Tokens that can be in an XPath expression.
  */
@@ -236,7 +243,7 @@ struct lyxp_set {
  *
  * @param[in] expr XPath expression to evaluate. Must be in JSON format (prefixes are model names).
  * @param[in] cur_node Current (context) data node. If the node has #LYD_VAL_INUSE flag, it is considered dummy (intended
- * for but not restricted to evaluation with the LYXP_WHEN flag).
+ * for but not restricted to evaluation with the LYXP_WHEN flag), see also lyxp_set_hidden().
  * @param[in] cur_node_type Current (context) data node type. For every standard case use #LYXP_NODE_ELEM. But there are
  * cases when the context node \p cur_node is actually supposed to be the XML root, there is no such data node. So, in
  * this case just pass the first top-level node into \p cur_node and use an enum value for this kind of root
@@ -256,6 +263,57 @@ struct lyxp_set {
 int lyxp_eval(const char *expr, const struct lyd_node *cur_node, enum lyxp_node_type cur_node_type,
               const struct lys_module *local_mod, struct lyxp_set *set, int options);
 
+/**
+ * @brief Evaluate a compiled XPath expression on data, see lyxp_eval() for more details.
+ *
+ * @param[in] exp Compiled XPath expression to evaluate, it is not modified.
+ * @param[in] cur_node Current (context) data node.
+ * @param[in] cur_node_type Current (context) data node type.
+ * @param[in] local_mod Local module relative to the \p exp.
+ * @param[out] set Result set.
+ * @param[in] options Whether to apply some evaluation restrictions.
+ *
+ * @return EXIT_SUCCESS on success, EXIT_FAILURE on unresolved when dependency, -1 on error.
+ */
+int lyxp_eval_expr(struct lyxp_expr *exp, const struct lyd_node *cur_node, enum lyxp_node_type cur_node_type,
+                   const struct lys_module *local_mod, struct lyxp_set *set, int options);
+
+/**
+ * @brief Evaluate an XPath expression on data, compiled only once and cached in the context. Intended for
+ * the schema expressions evaluated repeatedly, see lyxp_eval() for more details.
+ *
+ * @param[in] expr XPath expression to evaluate.
+ * @param[in] cur_node Current (context) data node.
+ * @param[in] cur_node_type Current (context) data node type.
+ * @param[in] local_mod Local module relative to the \p expr.
+ * @param[out] set Result set.
+ * @param[in] options Whether to apply some evaluation restrictions.
+ *
+ * @return EXIT_SUCCESS on success, EXIT_FAILURE on unresolved when dependency, -1 on error.
+ */
+int lyxp_eval_cached(const char *expr, const struct lyd_node *cur_node, enum lyxp_node_type cur_node_type,
+                     const struct lys_module *local_mod, struct lyxp_set *set, int options);
+
+/**
+ * @brief Data nodes the XPath evaluations in a thread see differently than they are in the data tree, so that
+ * the tree itself does not have to be changed for the evaluation (and can be evaluated by several threads).
+ */
+struct lyxp_hidden {
+    const struct lyd_node *dummy;   /**< node considered dummy (without value and children) as if it had
+                                         the #LYD_VAL_INUSE flag, NULL for none */
+    const struct lys_node *snode;   /**< uses, choice, case, or augment, the instances of its data nodes among
+                                         the children of \p parent are considered not present, NULL for none */
+    const struct lyd_node *parent;  /**< parent of the nodes hidden by \p snode, NULL for the top-level nodes */
+};
+
+/**
+ * @brief Set the data nodes the following XPath evaluations in the thread see differently.
+ *
+ * @param[in] hidden Nodes to see differently, NULL for none. Must be valid until replaced.
+ * @return Previously set nodes, to be restored when done.
+ */
+const struct lyxp_hidden *lyxp_set_hidden(const struct lyxp_hidden *hidden);
+
 /**
  * @brief Get all the partial XPath nodes (atoms) that are required for \p expr to be evaluated.
  *
@@ -289,6 +347,9 @@ int lyxp_atomize(const char *expr, const struct lys_node *cur_snode, enum lyxp_n
 
 #define LYXP_SNODE_ALL 0x3C
 
+/* only the existence of any resulting node matters so the last descendant step can stop at the first match */
+#define LYXP_EXISTS 0x40
+
 /**
  * @brief Works like lyxp_atomize(), but it is executed on all the when and must expressions
  * which the node has.
@@ -303,6 +364,26 @@ int lyxp_atomize(const char *expr, const struct lys_node *cur_snode, enum lyxp_n
  */
 int lyxp_node_atomize(const struct lys_node *node, struct lyxp_set *set, int set_ext_dep_flags);
 
+/**
+ * @brief Get the schema nodes whose when or must expressions depend on (access) a schema node.
+ *        The reverse dependency index of all the implemented modules is built on first use
+ *        and again whenever the context module set changes. Logs directly.
+ *
+ * @param[in] node Schema node.
+ * @param[out] dependents Set of the dependent schema nodes owned by the index, NULL if there are none.
+ * It is valid until the context module set changes.
+ *
+ * @return EXIT_SUCCESS on success, -1 on error.
+ */
+int lyxp_deps_get(const struct lys_node *node, const struct ly_set **dependents);
+
+/**
+ * @brief Free the reverse XPath dependency index of the context.
+ *
+ * @param[in] ctx Context with the index.
+ */
+void lyxp_deps_clean(struct ly_ctx *ctx);
+
 /**
  * @brief Check syntax of all the XPath expressions of the node.
  *
@@ -347,6 +428,52 @@ void lyxp_set_free(struct lyxp_set *set);
  */
 struct lyxp_expr *lyxp_parse_expr(struct ly_ctx *ctx, const char *expr);
 
+/**
+ * @brief Parse an XPath expression and check its syntax so that it is ready to be evaluated.
+ *        Logs directly.
+ *
+ * @param[in] ctx Context for errors.
+ * @param[in] expr XPath expression to compile. It is duplicated.
+ *
+ * @return Compiled expression to be freed by lyxp_expr_free(), NULL on error.
+ */
+struct lyxp_expr *lyxp_compile_expr(struct ly_ctx *ctx, const char *expr);
+
+/**
+ * @brief Get a compiled XPath expression from the context cache, compile and add it if not there yet.
+ *        Logs directly.
+ *
+ * @param[in] ctx Context with the cache.
+ * @param[in] expr XPath expression.
+ *
+ * @return Compiled expression owned by the context cache, NULL on error.
+ */
+struct lyxp_expr *lyxp_expr_cache_get(struct ly_ctx *ctx, const char *expr);
+
+/**
+ * @brief Compile the when and must expressions of a schema node into the context cache
+ *        (see lyxp_expr_cache_get()). Logs directly.
+ *
+ * @param[in] node Schema node.
+ *
+ * @return 0 on success, -1 on error.
+ */
+int lyxp_node_precompile(const struct lys_node *node);
+
+/**
+ * @brief Free all the compiled XPath expressions in the context cache.
+ *
+ * @param[in] ctx Context with the cache.
+ */
+void lyxp_expr_cache_clean(struct ly_ctx *ctx);
+
+/**
+ * @brief Free all the compiled re-match() patterns in the context cache.
+ *
+ * @param[in] ctx Context with the cache.
+ */
+void lyxp_regex_cache_clean(struct ly_ctx *ctx);
+
 /**
  * @brief Frees a parsed XPath expression. \p expr should not be used afterwards.
  *
@@ -106,13 +106,17 @@ using S_Xml_Attr = std::shared_ptr<Xml_Attr>;
 using S_Xml_Elem = std::shared_ptr<Xml_Elem>;
 
 class Value;
+class Leaf_Values;
 class Data_Node;
+class Data_Node_Ref;
+class Data_Node_Range;
 class Data_Node_Leaf_List;
 class Data_Node_Anydata;
 class Attr;
 class Difflist;
 
 using S_Value = std::shared_ptr<Value>;
+using S_Leaf_Values = std::shared_ptr<Leaf_Values>;
 using S_Data_Node = std::shared_ptr<Data_Node>;
 using S_Data_Node_Leaf_List = std::shared_ptr<Data_Node_Leaf_List>;
 using S_Data_Node_Anydata = std::shared_ptr<Data_Node_Anydata>;
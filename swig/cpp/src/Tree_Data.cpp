@@ -12,6 +12,7 @@
  *     https://opensource.org/licenses/BSD-3-Clause
  */
 
+#include <cmath>
 #include <iostream>
 #include <memory>
 #include <stdexcept>
@@ -37,6 +38,112 @@ Value::Value(lyd_val value, LY_DATA_TYPE* value_type, uint8_t value_flags, S_Del
     deleter(deleter)
 {};
 Value::~Value() {};
+Leaf_Values::Leaf_Values(struct lyd_leaf_values values, S_Deleter deleter):
+    values(values),
+    deleter(deleter)
+{};
+Leaf_Values::~Leaf_Values() {
+    lyd_leaf_values_clean(&values);
+};
+std::vector<std::string> Leaf_Values::strs() {
+    std::vector<std::string> s_vector;
+
+    s_vector.reserve(values.count);
+    for (unsigned int i = 0; i < values.count; ++i) {
+        s_vector.push_back(values.strs[i] ? values.strs[i] : "");
+    }
+
+    return s_vector;
+}
+std::vector<int> Leaf_Values::types() {
+    return std::vector<int>(values.types, values.types + values.count);
+}
+static bool leaf_value_int(const lyd_val *value, LY_DATA_TYPE type, int64_t *num) {
+    switch (type) {
+    case LY_TYPE_BOOL:
+        *num = value->bln;
+        break;
+    case LY_TYPE_DEC64:
+        *num = value->dec64;
+        break;
+    case LY_TYPE_INT8:
+        *num = value->int8;
+        break;
+    case LY_TYPE_INT16:
+        *num = value->int16;
+        break;
+    case LY_TYPE_INT32:
+        *num = value->int32;
+        break;
+    case LY_TYPE_INT64:
+        *num = value->int64;
+        break;
+    case LY_TYPE_UINT8:
+        *num = value->uint8;
+        break;
+    case LY_TYPE_UINT16:
+        *num = value->uint16;
+        break;
+    case LY_TYPE_UINT32:
+        *num = value->uint32;
+        break;
+    case LY_TYPE_UINT64:
+        *num = (int64_t) value->uint64;
+        break;
+    default:
+        return false;
+    }
+
+    return true;
+}
+std::vector<int64_t> Leaf_Values::ints() {
+    std::vector<int64_t> s_vector(values.count, 0);
+
+    for (unsigned int i = 0; i < values.count; ++i) {
+        leaf_value_int(&values.values[i], values.types[i], &s_vector[i]);
+    }
+
+    return s_vector;
+}
+std::vector<double> Leaf_Values::numbers() {
+    std::vector<double> s_vector(values.count, NAN);
+    const struct lys_type *type;
+    int64_t num;
+
+    for (unsigned int i = 0; i < values.count; ++i) {
+        if (!leaf_value_int(&values.values[i], values.types[i], &num)) {
+            continue;
+        }
+
+        if (values.types[i] == LY_TYPE_UINT64) {
+            s_vector[i] = values.values[i].uint64;
+        } else if (values.types[i] == LY_TYPE_DEC64) {
+            type = lyd_leaf_type(values.nodes[i]);
+            s_vector[i] = num;
+            for (uint8_t dig = type ? type->info.dec64.dig : 0; dig; --dig) {
+                s_vector[i] /= 10;
+            }
+        } else {
+            s_vector[i] = num;
+        }
+    }
+
+    return s_vector;
+}
+S_Value Leaf_Values::value(unsigned int index) {
+    if (index >= values.count) {
+        throw std::out_of_range("Index out of range");
+    }
+
+    return std::make_shared<Value>(values.values[index], &values.types[index], values.nodes[index]->value_flags, deleter);
+}
+S_Data_Node Leaf_Values::node(unsigned int index) {
+    if (index >= values.count) {
+        throw std::out_of_range("Index out of range");
+    }
+
+    return std::make_shared<Data_Node>((struct lyd_node *) values.nodes[index], deleter);
+}
 S_Data_Node Value::instance() {
     if (LY_TYPE_INST != type) {
         return nullptr;
@@ -501,6 +608,26 @@ std::string Data_Node::print_mem(LYD_FORMAT format, int options) {
     return s_strp;
 
 }
+S_Leaf_Values Data_Node::leaf_values(const char *schema_path) {
+    struct lyd_leaf_values values;
+
+    if (lyd_leaf_values(node, schema_path, &values)) {
+        check_libyang_error(node->schema->module->ctx);
+        return nullptr;
+    }
+
+    return std::make_shared<Leaf_Values>(values, deleter);
+}
+int Data_Node::print_fd(int fd, LYD_FORMAT format, int options) {
+    int rc = 0;
+
+    rc = lyd_print_fd(fd, node, format, options);
+    if (rc) {
+        check_libyang_error(node->schema->module->ctx);
+    }
+
+    return rc;
+}
 std::vector<S_Data_Node> Data_Node::tree_for() {
     std::vector<S_Data_Node> s_vector;
 
@@ -522,6 +649,64 @@ std::vector<S_Data_Node> Data_Node::tree_dfs() {
 
     return s_vector;
 }
+Data_Node_Range Data_Node::children_range() {
+    struct lyd_node *first = nullptr;
+
+    if (!(node->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST | LYS_ANYDATA))) {
+        first = node->child;
+    }
+    return Data_Node_Range(first, Data_Node_Range::SIBLINGS, deleter);
+}
+
+std::string Data_Node_Ref::path() const {
+    char *path = nullptr;
+
+    path = lyd_path(node);
+    if (!path) {
+        check_libyang_error(node->schema->module->ctx);
+        return nullptr;
+    }
+
+    std::string s_path = path;
+    free(path);
+    return s_path;
+}
+
+S_Data_Node Data_Node_Range::iterator::operator*() const {
+    return std::make_shared<Data_Node>(elem, *deleter);
+}
+Data_Node_Range::iterator &Data_Node_Range::iterator::operator++() {
+    struct lyd_node *next = nullptr;
+
+    if (traversal == SIBLINGS) {
+        elem = elem->next;
+        return *this;
+    }
+
+    /* the same as LY_TREE_DFS_END, children first */
+    if (!(elem->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST | LYS_ANYDATA))) {
+        next = elem->child;
+    }
+    if (!next) {
+        if (elem == start) {
+            /* start has no children */
+            elem = nullptr;
+            return *this;
+        }
+        next = elem->next;
+    }
+    while (!next) {
+        /* no siblings, go back through the parents */
+        elem = elem->parent;
+        if (elem->parent == start->parent) {
+            /* we are done, no next element to process */
+            break;
+        }
+        next = elem->next;
+    }
+    elem = next;
+    return *this;
+}
 
 Data_Node_Leaf_List::Data_Node_Leaf_List(S_Data_Node derived):
     Data_Node(derived->node, derived->deleter),
@@ -17,7 +17,9 @@
 
 #include <iostream>
 #include <memory>
+#include <cstddef>
 #include <exception>
+#include <iterator>
 #include <vector>
 
 #include "Internal.hpp"
@@ -90,6 +92,149 @@ private:
     S_Deleter deleter;
 };
 
+/**
+ * @brief class for wrapping [lyd_leaf_values](@ref lyd_leaf_values).
+ *
+ * All the values are read from the arrays filled by a single lyd_leaf_values() call, the columns
+ * are converted at once so that the bindings need only one call per column.
+ * @class Leaf_Values
+ */
+class Leaf_Values
+{
+public:
+    /** wrapper for struct [lyd_leaf_values](@ref lyd_leaf_values), for internal use only */
+    Leaf_Values(struct lyd_leaf_values values, S_Deleter deleter);
+    Leaf_Values(const Leaf_Values &) = delete;
+    Leaf_Values &operator=(const Leaf_Values &) = delete;
+    ~Leaf_Values();
+    /** get count variable from [lyd_leaf_values](@ref lyd_leaf_values)*/
+    unsigned int count() {return values.count;};
+    /** get strs variable from [lyd_leaf_values](@ref lyd_leaf_values), the canonical values */
+    std::vector<std::string> strs();
+    /** get types variable from [lyd_leaf_values](@ref lyd_leaf_values)*/
+    std::vector<int> types();
+    /** get the integer, boolean and raw decimal64 values, 0 for the values of other types */
+    std::vector<int64_t> ints();
+    /** get the numeric and boolean values with decimal64 values scaled by their fraction-digits, NAN for the values of other types */
+    std::vector<double> numbers();
+    /** get the value of an instance from values variable of [lyd_leaf_values](@ref lyd_leaf_values)*/
+    S_Value value(unsigned int index);
+    /** get an instance from nodes variable of [lyd_leaf_values](@ref lyd_leaf_values)*/
+    S_Data_Node node(unsigned int index);
+
+private:
+    struct lyd_leaf_values values;
+    S_Deleter deleter;
+};
+
+/**
+ * @brief class for a non-owning handle of [lyd_node](@ref lyd_node).
+ *
+ * Unlike Data_Node, the handle is only a pointer to the node that does not keep the tree alive, so it must not be used
+ * after the tree is freed. It is copied by value and the navigation does not allocate, use Data_Node::wrap() to
+ * get an owning Data_Node.
+ * @class Data_Node_Ref
+ */
+class Data_Node_Ref
+{
+public:
+    /** handle of node, NULL for no node */
+    Data_Node_Ref(struct lyd_node *node = nullptr): node(node) {};
+    /** whether the handle refers to a node */
+    explicit operator bool() const {return node != nullptr;};
+    bool operator==(const Data_Node_Ref &other) const {return node == other.node;};
+    bool operator!=(const Data_Node_Ref &other) const {return node != other.node;};
+    /** get next variable from [lyd_node](@ref lyd_node)*/
+    Data_Node_Ref next() const {return Data_Node_Ref(node->next);};
+    /** get prev variable from [lyd_node](@ref lyd_node)*/
+    Data_Node_Ref prev() const {return Data_Node_Ref(node->prev);};
+    /** get parent variable from [lyd_node](@ref lyd_node)*/
+    Data_Node_Ref parent() const {return Data_Node_Ref(node->parent);};
+    /** get child variable from [lyd_node](@ref lyd_node), no node for leaves, leaf-lists and anydata */
+    Data_Node_Ref child() const {
+        return Data_Node_Ref((node->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST | LYS_ANYDATA)) ? nullptr : node->child);
+    };
+    /** get schema variable from [lyd_node](@ref lyd_node)*/
+    struct lys_node *schema() const {return node->schema;};
+    /** get name of the schema node */
+    const char *name() const {return node->schema->name;};
+    /** get value_str variable of a leaf or leaf-list, NULL for other nodes */
+    const char *value_str() const {
+        return (node->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST)) ? ((struct lyd_node_leaf_list *)node)->value_str : nullptr;
+    };
+    /** wrapper for [lyd_path](@ref lyd_path) */
+    std::string path() const;
+
+    /** libnetconf2 related wrappers, for internal use only */
+    struct lyd_node *C_lyd_node() const {return node;};
+
+private:
+    struct lyd_node *node;
+};
+
+/**
+ * @brief class for lazy traversal of the data nodes, in the order of [LY_TREE_FOR](@ref LY_TREE_FOR) or
+ * [LY_TREE_DFS_BEGIN](@ref LY_TREE_DFS_BEGIN). Unlike Data_Node::tree_for() and Data_Node::tree_dfs(), the nodes are
+ * not collected in advance and a node is wrapped only when the iterator is dereferenced, so a traversal using
+ * only Data_Node_Range::iterator::C_lyd_node() does not allocate.
+ * @class Data_Node_Range
+ */
+class Data_Node_Range
+{
+public:
+    /** traversal order */
+    enum Traversal {
+        SIBLINGS,   /**< the node and its following siblings */
+        DFS         /**< the node and all its descendants, depth-first */
+    };
+
+    /** forward iterator over the nodes of the range */
+    class iterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = S_Data_Node;
+        using difference_type = std::ptrdiff_t;
+        using pointer = S_Data_Node *;
+        using reference = S_Data_Node;
+
+        /** iterator at elem of a traversal from start, for internal use only */
+        iterator(struct lyd_node *start, struct lyd_node *elem, Traversal traversal, const S_Deleter *deleter):
+            start(start), elem(elem), traversal(traversal), deleter(deleter) {};
+        /** wrap the current node */
+        S_Data_Node operator*() const;
+        /** the current node without wrapping it, valid as long as the tree */
+        struct lyd_node *C_lyd_node() const {return elem;};
+        /** non-owning handle of the current node, valid as long as the tree */
+        Data_Node_Ref ref() const {return Data_Node_Ref(elem);};
+        /** move to the next node */
+        iterator &operator++();
+        /** move to the next node */
+        iterator operator++(int) {iterator prev = *this; ++(*this); return prev;};
+        bool operator==(const iterator &other) const {return elem == other.elem;};
+        bool operator!=(const iterator &other) const {return elem != other.elem;};
+
+    private:
+        struct lyd_node *start;
+        struct lyd_node *elem;
+        Traversal traversal;
+        const S_Deleter *deleter;
+    };
+
+    /** range of a traversal from node, for internal use only */
+    Data_Node_Range(struct lyd_node *node, Traversal traversal, S_Deleter deleter):
+        node(node), traversal(traversal), deleter(deleter) {};
+    /** iterator at the first node, the iterators are valid as long as the range */
+    iterator begin() const {return iterator(node, node, traversal, &deleter);};
+    /** iterator after the last node */
+    iterator end() const {return iterator(node, nullptr, traversal, &deleter);};
+
+private:
+    struct lyd_node *node;
+    Traversal traversal;
+    S_Deleter deleter;
+};
+
 /**
  * @brief classes for wrapping [lyd_node](@ref lyd_node).
  * @class Data_Node
@@ -194,12 +339,26 @@ public:
     S_Module node_module();
     /** wrapper for [lyd_print_mem](@ref lyd_print_mem) */
     std::string print_mem(LYD_FORMAT format, int options);
+    /** wrapper for [lyd_print_fd](@ref lyd_print_fd) */
+    int print_fd(int fd, LYD_FORMAT format, int options);
+    /** wrapper for [lyd_leaf_values](@ref lyd_leaf_values) */
+    S_Leaf_Values leaf_values(const char *schema_path);
 
     /* emulate TREE macro's */
     /** wrapper for macro [LY_TREE_FOR](@ref LY_TREE_FOR) */
     std::vector<S_Data_Node> tree_for();
     /** wrapper for macro [LY_TREE_DFS_BEGIN](@ref LY_TREE_DFS_BEGIN) and [LY_TREE_DFS_END](@ref LY_TREE_DFS_END) */
     std::vector<S_Data_Node> tree_dfs();
+    /** non-owning handle of the node */
+    Data_Node_Ref ref() {return Data_Node_Ref(node);};
+    /** owning wrapper of a node of the same tree as this node, NULL for no node */
+    S_Data_Node wrap(Data_Node_Ref ref) {return ref ? std::make_shared<Data_Node>(ref.C_lyd_node(), deleter) : nullptr;};
+    /** lazy variant of tree_for(), the node and its following siblings */
+    Data_Node_Range siblings_range() {return Data_Node_Range(node, Data_Node_Range::SIBLINGS, deleter);};
+    /** lazy traversal of the children of the node */
+    Data_Node_Range children_range();
+    /** lazy variant of tree_dfs(), the node and all its descendants */
+    Data_Node_Range dfs_range() {return Data_Node_Range(node, Data_Node_Range::DFS, deleter);};
 
     /** SWIG related wrappers, for internal use only */
     struct lyd_node *swig_node() {return node;};
@@ -20,6 +20,7 @@
 #include "../tests/config.h"
 #include "microtest.h"
 #include <string.h>
+#include <cmath>
 
 const char *lys_module_a = \
 "<?xml version=\"1.0\" encoding=\"UTF-8\"?>           \
@@ -764,4 +765,116 @@ TEST(test_ly_data_node_validate_value)
     }
 }
 
+TEST(test_ly_data_node_range)
+{
+    const char *yang_folder = TESTS_DIR "/api/files";
+    const char *config_file = TESTS_DIR "/api/files/a.xml";
+
+    try {
+        auto ctx = std::make_shared<libyang::Context>(yang_folder);
+        ASSERT_NOTNULL(ctx);
+        ctx->parse_module_mem(lys_module_a, LYS_IN_YIN);
+        auto root = ctx->parse_data_path(config_file, LYD_XML, LYD_OPT_CONFIG | LYD_OPT_STRICT);
+        ASSERT_NOTNULL(root);
+
+        auto dfs = root->tree_dfs();
+        size_t i = 0;
+        for (auto it = root->dfs_range().begin(); it != root->dfs_range().end(); ++it, ++i) {
+            ASSERT_FALSE(i >= dfs.size());
+            ASSERT_EQ(dfs[i]->swig_node(), it.C_lyd_node());
+        }
+        ASSERT_EQ(dfs.size(), i);
+
+        auto siblings = root->child()->tree_for();
+        i = 0;
+        for (auto node : root->children_range()) {
+            ASSERT_FALSE(i >= siblings.size());
+            ASSERT_EQ(siblings[i]->swig_node(), node->swig_node());
+            ++i;
+        }
+        ASSERT_EQ(siblings.size(), i);
+
+        i = 0;
+        for (auto node : root->child()->siblings_range()) {
+            ASSERT_NOTNULL(node);
+            ++i;
+        }
+        ASSERT_EQ(siblings.size(), i);
+    } catch (const std::exception& e) {
+        mt::printFailed(e.what(), stdout);
+        throw;
+    }
+}
+
+TEST(test_ly_data_node_ref)
+{
+    const char *yang_folder = TESTS_DIR "/api/files";
+    const char *config_file = TESTS_DIR "/api/files/a.xml";
+
+    try {
+        auto ctx = std::make_shared<libyang::Context>(yang_folder);
+        ASSERT_NOTNULL(ctx);
+        ctx->parse_module_mem(lys_module_a, LYS_IN_YIN);
+        auto root = ctx->parse_data_path(config_file, LYD_XML, LYD_OPT_CONFIG | LYD_OPT_STRICT);
+        ASSERT_NOTNULL(root);
+
+        libyang::Data_Node_Ref ref = root->ref();
+        ASSERT_TRUE(ref);
+        ASSERT_STREQ("x", ref.name());
+        ASSERT_FALSE(ref.parent());
+
+        libyang::Data_Node_Ref child = ref.child();
+        ASSERT_TRUE(child);
+        ASSERT_EQ(root->child()->swig_node(), child.C_lyd_node());
+        ASSERT_TRUE(child.parent() == ref);
+        ASSERT_STREQ("/a:x/bubba", child.path().c_str());
+        ASSERT_NOTNULL(child.value_str());
+        ASSERT_FALSE(child.child());
+
+        auto node = root->wrap(child);
+        ASSERT_NOTNULL(node);
+        ASSERT_EQ(child.C_lyd_node(), node->swig_node());
+        ASSERT_NULL(root->wrap(libyang::Data_Node_Ref()));
+    } catch (const std::exception& e) {
+        mt::printFailed(e.what(), stdout);
+        throw;
+    }
+}
+
+TEST(test_ly_data_node_leaf_values)
+{
+    const char *yang_folder = TESTS_DIR "/api/files";
+    const char *config_file = TESTS_DIR "/api/files/a.xml";
+
+    try {
+        auto ctx = std::make_shared<libyang::Context>(yang_folder);
+        ASSERT_NOTNULL(ctx);
+        ctx->parse_module_mem(lys_module_a, LYS_IN_YIN);
+        auto root = ctx->parse_data_path(config_file, LYD_XML, LYD_OPT_CONFIG | LYD_OPT_STRICT);
+        ASSERT_NOTNULL(root);
+
+        auto node = root->new_path(ctx, "/a:x/number32", "-3", LYD_ANYDATA_CONSTSTRING, 0);
+        ASSERT_NOTNULL(node);
+
+        auto values = root->leaf_values("/a:x/number32");
+        ASSERT_NOTNULL(values);
+        ASSERT_EQ(1, values->count());
+        ASSERT_STREQ("-3", values->strs()[0].c_str());
+        ASSERT_EQ(LY_TYPE_INT32, values->types()[0]);
+        ASSERT_EQ(-3, values->ints()[0]);
+        ASSERT_EQ(-3.0, values->numbers()[0]);
+        ASSERT_EQ(-3, values->value(0)->int32());
+        ASSERT_STREQ("number32", values->node(0)->schema()->name());
+
+        values = root->leaf_values("/a:x/bubba");
+        ASSERT_NOTNULL(values);
+        ASSERT_EQ(1, values->count());
+        ASSERT_EQ(LY_TYPE_STRING, values->types()[0]);
+        ASSERT_TRUE(std::isnan(values->numbers()[0]));
+    } catch (const std::exception& e) {
+        mt::printFailed(e.what(), stdout);
+        throw;
+    }
+}
+
 TEST_MAIN();
@@ -595,6 +595,59 @@ class TestUM(unittest.TestCase):
         except Exception as e:
             self.fail(e)
 
+    def test_ly_data_node_print_bytearray(self):
+        yang_folder = config.TESTS_DIR + "/api/files"
+        config_file = config.TESTS_DIR + "/api/files/a.xml"
+        try:
+            # Setup
+            ctx = ly.Context(yang_folder)
+            self.assertIsNotNone(ctx)
+            ctx.parse_module_mem(lys_module_a, ly.LYS_IN_YIN)
+            root = ctx.parse_data_path(config_file, ly.LYD_XML, ly.LYD_OPT_CONFIG | ly.LYD_OPT_STRICT)
+            self.assertIsNotNone(root)
+
+            # Tests
+            buf = bytearray()
+            rc = root.print_bytearray(buf, ly.LYD_XML, 0)
+            self.assertEqual(len(result_xml), rc)
+            self.assertEqual(result_xml, buf.decode())
+
+            buf = bytearray()
+            root.print_bytearray(buf, ly.LYD_LYB, ly.LYP_WITHSIBLINGS)
+            new_root = ctx.parse_data_buffer(memoryview(buf), ly.LYD_LYB, ly.LYD_OPT_CONFIG | ly.LYD_OPT_STRICT)
+            self.assertIsNotNone(new_root)
+            self.assertEqual(result_xml, new_root.print_mem(ly.LYD_XML, 0))
+
+            new_root = ctx.parse_data_buffer(result_xml.encode(), ly.LYD_XML, ly.LYD_OPT_CONFIG | ly.LYD_OPT_STRICT)
+            self.assertIsNotNone(new_root)
+            self.assertEqual(result_xml, new_root.print_mem(ly.LYD_XML, 0))
+
+        except Exception as e:
+            self.fail(e)
+
+    def test_ly_data_node_leaf_values(self):
+        yang_folder = config.TESTS_DIR + "/api/files"
+        config_file = config.TESTS_DIR + "/api/files/a.xml"
+        try:
+            # Setup
+            ctx = ly.Context(yang_folder)
+            self.assertIsNotNone(ctx)
+            ctx.parse_module_mem(lys_module_a, ly.LYS_IN_YIN)
+            root = ctx.parse_data_path(config_file, ly.LYD_XML, ly.LYD_OPT_CONFIG | ly.LYD_OPT_STRICT)
+            self.assertIsNotNone(root)
+            root.new_path(ctx, "/a:x/number32", "-3", ly.LYD_ANYDATA_CONSTSTRING, 0)
+
+            # Tests
+            values = root.leaf_values("/a:x/number32")
+            self.assertEqual(1, values.count())
+            self.assertEqual(("-3",), tuple(values.strs()))
+            self.assertEqual((ly.LY_TYPE_INT32,), tuple(values.types()))
+            self.assertEqual((-3,), tuple(values.ints()))
+            self.assertEqual((-3.0,), tuple(values.numbers()))
+
+        except Exception as e:
+            self.fail(e)
+
     def test_ly_data_node_path(self):
         yang_folder = config.TESTS_DIR + "/api/files"
         config_file = config.TESTS_DIR + "/api/files/a.xml"
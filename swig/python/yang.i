@@ -77,6 +77,20 @@ static const char *g_ly_module_imp_clb(const char *mod_name, const char *mod_rev
 }
 %}
 
+%{
+/* lyd_print_clb() writer appending directly to a Python bytearray */
+static ssize_t g_bytearray_write(void *arg, const void *buf, size_t count) {
+    PyObject *array = (PyObject *) arg;
+    Py_ssize_t size = PyByteArray_GET_SIZE(array);
+
+    if (PyByteArray_Resize(array, size + count)) {
+        return -1;
+    }
+    memcpy(PyByteArray_AS_STRING(array) + size, buf, count);
+    return count;
+}
+%}
+
 %extend libyang::Context {
 
     void set_module_imp_clb(PyObject *clb, PyObject *user_data = nullptr) {
@@ -94,6 +108,46 @@ static const char *g_ly_module_imp_clb(const char *mod_name, const char *mod_rev
 
         ly_ctx_set_module_imp_clb(self->swig_ctx(), g_ly_module_imp_clb, class_ctx);
     };
+
+    /* parse data from any object supporting the buffer protocol (bytes, bytearray, memoryview, ...),
+     * the memory is passed to libyang directly whenever it is known to be terminated */
+    std::shared_ptr<libyang::Data_Node> parse_data_buffer(PyObject *data, LYD_FORMAT format, int options = 0) {
+        std::shared_ptr<libyang::Data_Node> node;
+        Py_buffer view;
+        char *copy = nullptr;
+        const char *mem;
+
+        if (PyObject_GetBuffer(data, &view, PyBUF_SIMPLE)) {
+            PyErr_Clear();
+            throw std::runtime_error("Python Object does not support the buffer protocol.\n");
+        }
+
+        if (format == LYD_LYB || PyBytes_Check(data) || PyByteArray_Check(data)) {
+            /* LYB carries its own length, bytes and bytearray are always NULL-terminated */
+            mem = (const char *) view.buf;
+        } else {
+            copy = (char *) malloc(view.len + 1);
+            if (!copy) {
+                PyBuffer_Release(&view);
+                throw std::runtime_error("Memory allocation failed.\n");
+            }
+            memcpy(copy, view.buf, view.len);
+            copy[view.len] = '\0';
+            mem = copy;
+        }
+
+        try {
+            node = self->parse_data_mem(mem, format, options);
+        } catch (...) {
+            free(copy);
+            PyBuffer_Release(&view);
+            throw;
+        }
+
+        free(copy);
+        PyBuffer_Release(&view);
+        return node;
+    }
 }
 
 %extend libyang::Data_Node {
@@ -114,6 +168,26 @@ static const char *g_ly_module_imp_clb(const char *mod_name, const char *mod_rev
 
         return casted;
     }
+
+    /* print the data appending them to the given bytearray, returns the number of bytes written */
+    Py_ssize_t print_bytearray(PyObject *array, LYD_FORMAT format, int options = 0) {
+        Py_ssize_t size;
+
+        if (!PyByteArray_Check(array)) {
+            throw std::runtime_error("Python Object is not a bytearray.\n");
+        }
+
+        size = PyByteArray_GET_SIZE(array);
+        if (lyd_print_clb(g_bytearray_write, array, self->swig_node(), format, options)) {
+            if (PyErr_Occurred()) {
+                PyErr_Clear();
+                throw std::runtime_error("Memory allocation failed.\n");
+            }
+            check_libyang_error(self->swig_node()->schema->module->ctx);
+        }
+
+        return PyByteArray_GET_SIZE(array) - size;
+    }
 };
 
 %extend libyang::Schema_Node {
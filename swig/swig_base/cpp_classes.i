@@ -65,8 +65,16 @@
 %newobject Value::instance;
 %newobject Value::leafref;
 
+%shared_ptr(libyang::Leaf_Values);
+%newobject Leaf_Values::value;
+%newobject Leaf_Values::node;
+
+%ignore    Data_Node_Ref;
+%ignore    Data_Node_Range;
+
 %shared_ptr(libyang::Data_Node);
 %newobject Data_Node::schema;
+%newobject Data_Node::leaf_values;
 %newobject Data_Node::attr;
 %newobject Data_Node::next;
 %newobject Data_Node::prev;
@@ -81,6 +89,11 @@
 %newobject Data_Node::find_instance;
 %ignore    Data_Node::swig_node;
 %ignore    Data_Node::swig_deleter;
+%ignore    Data_Node::siblings_range;
+%ignore    Data_Node::children_range;
+%ignore    Data_Node::dfs_range;
+%ignore    Data_Node::ref;
+%ignore    Data_Node::wrap;
 %newobject Data_Node::diff;
 %newobject Data_Node::new_path;
 %newobject Data_Node::node_module;
@@ -103,6 +116,11 @@
 %newobject Data_Node_Leaf_List::find_instance;
 %ignore    Data_Node_Leaf_List::swig_node;
 %ignore    Data_Node_Leaf_List::swig_deleter;
+%ignore    Data_Node_Leaf_List::siblings_range;
+%ignore    Data_Node_Leaf_List::children_range;
+%ignore    Data_Node_Leaf_List::dfs_range;
+%ignore    Data_Node_Leaf_List::ref;
+%ignore    Data_Node_Leaf_List::wrap;
 %newobject Data_Node_Leaf_List::diff;
 %newobject Data_Node_Leaf_List::new_path;
 %newobject Data_Node_Leaf_List::node_module;
@@ -125,6 +143,11 @@
 %newobject Data_Node_Anydata::find_instance;
 %ignore    Data_Node_Anydata::swig_node;
 %ignore    Data_Node_Anydata::swig_deleter;
+%ignore    Data_Node_Anydata::siblings_range;
+%ignore    Data_Node_Anydata::children_range;
+%ignore    Data_Node_Anydata::dfs_range;
+%ignore    Data_Node_Anydata::ref;
+%ignore    Data_Node_Anydata::wrap;
 %newobject Data_Node_Anydata::diff;
 %newobject Data_Node_Anydata::new_path;
 %newobject Data_Node_Anydata::node_module;
@@ -422,6 +445,9 @@
 %template(vectorData_Node) std::vector<std::shared_ptr<libyang::Data_Node>>;
 %template(vectorSchema_Node) std::vector<std::shared_ptr<libyang::Schema_Node>>;
 %template(vector_String) std::vector<std::string>;
+%template(vector_Int) std::vector<int>;
+%template(vector_Int64) std::vector<int64_t>;
+%template(vector_Double) std::vector<double>;
 %template(vectorModules) std::vector<std::shared_ptr<libyang::Module>>;
 %template(vectorType) std::vector<std::shared_ptr<libyang::Type>>;
 %template(vectorExt_Instance) std::vector<std::shared_ptr<libyang::Ext_Instance>>;
@@ -26,9 +26,12 @@
 #include <sys/mman.h>
 #include <unistd.h>
 #include <string.h>
+#include <pthread.h>
 
 #include "tests/config.h"
 #include "libyang.h"
+/* include private header to be able to check internal values */
+#include "../../src/context.h"
 
 struct ly_ctx *ctx = NULL;
 
@@ -206,7 +209,8 @@ test_lydict_remove(void **state)
     /* string content is supposed to be invalid since now! */
     str = lydict_insert_zc(ctx, value2);
     assert_ptr_not_equal(str, NULL);
-    assert_ptr_not_equal(str, string);
+    /* the memory of value2 may have been moved to the freed one of string */
+    assert_string_equal(str, "new_name");
     lydict_remove(ctx, str);
 }
 
@@ -246,6 +250,196 @@ test_similar_strings(void **state) {
     lydict_remove(ctx, "bbba");
 }
 
+static void
+test_parse_cache(void **state)
+{
+    (void) state; /* unused */
+    struct lyd_node *root;
+    const char *str;
+    uint32_t dict_used;
+    int i;
+
+    dict_used = ctx->dict.shards[0].hash_tab->used;
+
+    /* parsing uses the insert cache, all its references must be counted afterwards */
+    for (i = 0; i < 3; ++i) {
+        root = lyd_parse_mem(ctx, a_data_xml, LYD_XML, LYD_OPT_CONFIG);
+        assert_ptr_not_equal(root, NULL);
+
+        str = lydict_insert(ctx, "test", 0);
+        assert_ptr_equal(str, ((struct lyd_node_leaf_list *)root->child)->value_str);
+        lydict_remove(ctx, str);
+
+        lyd_free_withsiblings(root);
+        assert_int_equal(dict_used, ctx->dict.shards[0].hash_tab->used);
+    }
+}
+
+static void
+test_free_batch(void **state)
+{
+    (void) state; /* unused */
+    const struct lys_module *mod;
+    struct lyd_node *root, *node;
+    char buf[32];
+    uint32_t dict_used;
+    int i;
+
+    mod = ly_ctx_get_module(ctx, "a", NULL, 1);
+    assert_ptr_not_equal(mod, NULL);
+    dict_used = ctx->dict.shards[0].hash_tab->used;
+
+    /* more strings than fit into a single release batch, each value used twice */
+    root = NULL;
+    for (i = 0; i < 3 * LYDICT_RELEASE_BATCH; ++i) {
+        node = lyd_new(NULL, mod, "x");
+        assert_ptr_not_equal(node, NULL);
+        sprintf(buf, "value%d", i / 2);
+        assert_ptr_not_equal(lyd_new_leaf(node, mod, "bubba", buf), NULL);
+        if (root) {
+            assert_int_equal(lyd_insert_after(root->prev, node), 0);
+        } else {
+            root = node;
+        }
+    }
+    assert_int_equal(dict_used + (3 * LYDICT_RELEASE_BATCH) / 2, ctx->dict.shards[0].hash_tab->used);
+
+    /* all the strings must be removed from the dictionary */
+    lyd_free_withsiblings(root);
+    assert_int_equal(dict_used, ctx->dict.shards[0].hash_tab->used);
+}
+
+static void
+test_stats(void **state)
+{
+    (void) state; /* unused */
+    struct ly_ht_stats stats, stats2;
+    const char *str;
+
+    assert_int_not_equal(lydict_stats(NULL, &stats), 0);
+    assert_int_equal(lydict_stats(ctx, &stats), 0);
+    assert_int_equal(stats.used, ctx->dict.shards[0].hash_tab->used);
+    assert_int_equal(stats.size, ctx->dict.shards[0].hash_tab->size);
+    assert_true(stats.used < stats.size);
+
+    str = lydict_insert(ctx, "stats-string", 0);
+    assert_int_equal(lydict_stats(ctx, &stats2), 0);
+    assert_int_equal(stats.used + 1, stats2.used);
+#ifdef LY_ENABLED_HT_STATS
+    assert_true(stats.lookups < stats2.lookups);
+    assert_true(stats.probes < stats2.probes);
+    assert_true(stats2.max_probe >= 1);
+    assert_true(stats2.probes >= stats2.lookups);
+#else
+    assert_int_equal(stats2.lookups, 0);
+#endif
+
+    lydict_remove(ctx, str);
+}
+
+#define SHARDED_THREADS 4
+#define SHARDED_STRINGS 500
+
+static void *
+sharded_thread(void *arg)
+{
+    struct ly_ctx *sctx = (struct ly_ctx *)arg;
+    const char *strs[SHARDED_STRINGS];
+    char buf[32];
+    int i;
+
+    for (i = 0; i < SHARDED_STRINGS; ++i) {
+        sprintf(buf, "str%d", i);
+        strs[i] = lydict_insert(sctx, buf, 0);
+        if (!strs[i] || strcmp(strs[i], buf)) {
+            return (void *)1;
+        }
+    }
+    for (i = 0; i < SHARDED_STRINGS; ++i) {
+        lydict_remove(sctx, strs[i]);
+    }
+
+    return NULL;
+}
+
+static void
+test_sharded(void **state)
+{
+    (void) state; /* unused */
+    struct ly_ctx *sctx;
+    pthread_t threads[SHARDED_THREADS];
+    const char *str1, *str2;
+    void *ret;
+    int i;
+
+    sctx = ly_ctx_new(NULL, LY_CTX_DICT_SHARDED);
+    assert_ptr_not_equal(sctx, NULL);
+
+    /* the same string is stored only once even in the sharded dictionary */
+    str1 = lydict_insert(sctx, "sharded", 0);
+    str2 = lydict_insert_zc(sctx, strdup("sharded"));
+    assert_ptr_equal(str1, str2);
+
+    for (i = 0; i < SHARDED_THREADS; ++i) {
+        assert_int_equal(pthread_create(&threads[i], NULL, sharded_thread, sctx), 0);
+    }
+    for (i = 0; i < SHARDED_THREADS; ++i) {
+        assert_int_equal(pthread_join(threads[i], &ret), 0);
+        assert_ptr_equal(ret, NULL);
+    }
+
+    lydict_remove(sctx, str1);
+    lydict_remove(sctx, str2);
+    ly_ctx_destroy(sctx, NULL);
+}
+
+static void
+test_immortal(void **state)
+{
+    (void) state; /* unused */
+    struct ly_ctx *ictx;
+    const struct lys_module *mod;
+    const char *str1, *str2;
+    uint32_t dict_used, immortal_used;
+    const char *schema1 = "module imm1 {namespace urn:imm1; prefix i1; leaf immortal-leaf {type string;}}";
+    const char *schema2 = "module imm2 {namespace urn:imm2; prefix i2; leaf counted-leaf {type string;}}";
+
+    ictx = ly_ctx_new(NULL, LY_CTX_DICT_IMMORTAL);
+    assert_ptr_not_equal(ictx, NULL);
+    assert_ptr_not_equal(ictx->dict.immortal.hash_tab, NULL);
+    dict_used = ictx->dict.shards[0].hash_tab->used;
+    immortal_used = ictx->dict.immortal.hash_tab->used;
+
+    /* schema strings are immortal */
+    mod = lys_parse_mem(ictx, schema1, LYS_IN_YANG);
+    assert_ptr_not_equal(mod, NULL);
+    assert_int_equal(dict_used, ictx->dict.shards[0].hash_tab->used);
+    assert_int_not_equal(immortal_used, ictx->dict.immortal.hash_tab->used);
+
+    /* data get the same strings without changing the dictionary */
+    str1 = lydict_insert(ictx, "immortal-leaf", 0);
+    assert_ptr_equal(str1, mod->data->name);
+    lydict_remove(ictx, str1);
+    assert_int_equal(dict_used, ictx->dict.shards[0].hash_tab->used);
+
+    /* a string already counted stays counted even when used by a schema */
+    str2 = lydict_insert(ictx, "counted-leaf", 0);
+    assert_int_equal(dict_used + 1, ictx->dict.shards[0].hash_tab->used);
+    mod = lys_parse_mem(ictx, schema2, LYS_IN_YANG);
+    assert_ptr_not_equal(mod, NULL);
+    assert_ptr_equal(str2, mod->data->name);
+    lydict_remove(ictx, str2);
+    assert_int_equal(dict_used + 1, ictx->dict.shards[0].hash_tab->used);
+
+    /* removing the schema does not free the immortal strings */
+    immortal_used = ictx->dict.immortal.hash_tab->used;
+    ly_ctx_clean(ictx, NULL);
+    assert_int_equal(dict_used, ictx->dict.shards[0].hash_tab->used);
+    assert_int_equal(immortal_used, ictx->dict.immortal.hash_tab->used);
+
+    ly_ctx_destroy(ictx, NULL);
+}
+
 int main(void)
 {
     const struct CMUnitTest tests[] = {
@@ -253,6 +447,11 @@ int main(void)
         cmocka_unit_test_setup_teardown(test_lydict_insert_zc, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_lydict_remove, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_similar_strings, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_parse_cache, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_free_batch, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_stats, setup_f, teardown_f),
+        cmocka_unit_test(test_sharded),
+        cmocka_unit_test(test_immortal),
     };
 
     return cmocka_run_group_tests(tests, NULL, NULL);
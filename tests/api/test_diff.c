@@ -346,7 +346,7 @@ test_move2(void **state)
 
     assert_int_equal(diff->type[0], LYD_DIFF_MOVEDAFTER1);
     assert_ptr_not_equal(diff->first[0], NULL);
-    assert_string_equal((str = lyd_path(diff->first[0])), "/defaults:df/llist[.='2']");
+    assert_string_equal((str = lyd_path(diff->first[0])), "/defaults:df/llist[.='3']");
     free(str);
     assert_ptr_not_equal(diff->second[0], NULL);
     assert_string_equal((str = lyd_path(diff->second[0])), "/defaults:df/llist[.='4']");
@@ -354,10 +354,10 @@ test_move2(void **state)
 
     assert_int_equal(diff->type[1], LYD_DIFF_MOVEDAFTER1);
     assert_ptr_not_equal(diff->first[1], NULL);
-    assert_string_equal((str = lyd_path(diff->first[1])), "/defaults:df/llist[.='4']");
+    assert_string_equal((str = lyd_path(diff->first[1])), "/defaults:df/llist[.='2']");
     free(str);
     assert_ptr_not_equal(diff->second[1], NULL);
-    assert_string_equal((str = lyd_path(diff->second[1])), "/defaults:df/llist[.='1']");
+    assert_string_equal((str = lyd_path(diff->second[1])), "/defaults:df/llist[.='3']");
     free(str);
 
     assert_int_equal(diff->type[2], LYD_DIFF_END);
@@ -405,6 +405,52 @@ test_move3(void **state)
     lyd_free_diff(diff);
 }
 
+static void
+test_move_many(void **state)
+{
+    struct state *st = (*state);
+    struct lyd_difflist *diff;
+    struct lyd_node *node, *after;
+    char val[8], *str1, *str2;
+    int i, moves;
+
+    /* 0..99, and the same with every tenth instance moved to the beginning */
+    st->first = lyd_new_path(NULL, st->ctx, "/defaults:df/llist", "0", 0, 0);
+    assert_ptr_not_equal(st->first, NULL);
+    st->second = lyd_dup(st->first, LYD_DUP_OPT_RECURSIVE);
+    assert_ptr_not_equal(st->second, NULL);
+    for (i = 1; i < 100; ++i) {
+        sprintf(val, "%d", i);
+        assert_ptr_not_equal(lyd_new_leaf(st->first, st->mod, "llist", val), NULL);
+        assert_ptr_not_equal((node = lyd_new_leaf(st->second, st->mod, "llist", val)), NULL);
+        if (!(i % 10)) {
+            assert_int_equal(lyd_insert_before(st->second->child, node), 0);
+        }
+    }
+
+    assert_ptr_not_equal((diff = lyd_diff(st->first, st->second, 0)), NULL);
+
+    /* only the moved instances are moved, their application makes the trees equal */
+    for (moves = 0; diff->type[moves] == LYD_DIFF_MOVEDAFTER1; ++moves) {
+        node = diff->first[moves];
+        after = diff->second[moves];
+        if (after) {
+            assert_int_equal(lyd_insert_after(after, node), 0);
+        } else {
+            assert_int_equal(lyd_insert_before(st->first->child, node), 0);
+        }
+    }
+    assert_int_equal(diff->type[moves], LYD_DIFF_END);
+    assert_int_equal(moves, 9);
+    lyd_free_diff(diff);
+
+    lyd_print_mem(&str1, st->first, LYD_XML, 0);
+    lyd_print_mem(&str2, st->second, LYD_XML, 0);
+    assert_string_equal(str1, str2);
+    free(str1);
+    free(str2);
+}
+
 static void
 test_mix1(void **state)
 {
@@ -561,6 +607,245 @@ test_wd1(void **state)
     lyd_free_diff(diff);
 }
 
+static void
+test_toplevel_list(void **state)
+{
+    struct state *st = (*state);
+    const char *yang = "module tl { namespace urn:tl; prefix tl; list l { key k; leaf k { type uint8; } leaf v { type string; } } }";
+    struct lyd_difflist *diff;
+    char path[32], val[4], *str;
+    int i, changed = 0, created = 0, deleted = 0;
+
+    assert_ptr_not_equal(lys_parse_mem(st->ctx, yang, LYS_IN_YANG), NULL);
+
+    /* enough top-level instances for matching them in a hash table */
+    for (i = 0; i < 20; ++i) {
+        sprintf(path, "/tl:l[k='%d']/v", i);
+        sprintf(val, "%d", i);
+        if (!st->first) {
+            assert_ptr_not_equal((st->first = lyd_new_path(NULL, st->ctx, path, val, 0, 0)), NULL);
+        } else {
+            assert_ptr_not_equal(lyd_new_path(st->first, st->ctx, path, val, 0, 0), NULL);
+        }
+    }
+    /* in reverse order, without 0, with changed 5 and new 20 */
+    for (i = 20; i > 0; --i) {
+        sprintf(path, "/tl:l[k='%d']/v", i);
+        sprintf(val, "%d", (i == 5) ? 50 : i);
+        if (!st->second) {
+            assert_ptr_not_equal((st->second = lyd_new_path(NULL, st->ctx, path, val, 0, 0)), NULL);
+        } else {
+            assert_ptr_not_equal(lyd_new_path(st->second, st->ctx, path, val, 0, 0), NULL);
+        }
+    }
+
+    assert_ptr_not_equal((diff = lyd_diff(st->first, st->second, 0)), NULL);
+    for (i = 0; diff->type[i] != LYD_DIFF_END; ++i) {
+        switch (diff->type[i]) {
+        case LYD_DIFF_CHANGED:
+            assert_string_equal((str = lyd_path(diff->second[i])), "/tl:l[k='5']/v");
+            free(str);
+            ++changed;
+            break;
+        case LYD_DIFF_CREATED:
+            assert_string_equal((str = lyd_path(diff->second[i])), "/tl:l[k='20']");
+            free(str);
+            ++created;
+            break;
+        case LYD_DIFF_DELETED:
+            assert_string_equal((str = lyd_path(diff->first[i])), "/tl:l[k='0']");
+            free(str);
+            ++deleted;
+            break;
+        default:
+            fail();
+        }
+    }
+    assert_int_equal(changed, 1);
+    assert_int_equal(created, 1);
+    assert_int_equal(deleted, 1);
+
+    lyd_free_diff(diff);
+}
+
+static void
+test_subtree_hash(void **state)
+{
+    struct state *st = (*state);
+    const char *xml1 = "<df xmlns=\"urn:libyang:tests:defaults\">"
+                         "<foo>42</foo><llist>1</llist><llist>2</llist>"
+                       "</df><hidden xmlns=\"urn:libyang:tests:defaults\">"
+                         "<foo>42</foo><baz>42</baz></hidden>";
+    const char *xml2 = "<df xmlns=\"urn:libyang:tests:defaults\">"
+                         "<foo>41</foo><llist>1</llist><llist>2</llist>"
+                       "</df><hidden xmlns=\"urn:libyang:tests:defaults\">"
+                         "<baz>42</baz><foo>42</foo></hidden>";
+    const char *xml3 = "<df xmlns=\"urn:libyang:tests:defaults\">"
+                         "<foo>42</foo><llist>2</llist><llist>1</llist>"
+                       "</df>";
+    struct lyd_node *third;
+    struct lyd_difflist *diff;
+    char *str;
+
+    assert_ptr_not_equal((st->first = lyd_parse_mem(st->ctx, xml1, LYD_XML, LYD_OPT_CONFIG)), NULL);
+    assert_ptr_not_equal((st->second = lyd_parse_mem(st->ctx, xml2, LYD_XML, LYD_OPT_CONFIG)), NULL);
+    assert_ptr_not_equal((third = lyd_parse_mem(st->ctx, xml3, LYD_XML, LYD_OPT_CONFIG)), NULL);
+
+    /* df, hidden; the order of system-ordered children does not matter, of user-ordered it does */
+    assert_string_equal(st->first->next->schema->name, "hidden");
+    assert_true(lyd_content_hash(st->first, 0) != lyd_content_hash(st->second, 0));
+    assert_true(lyd_content_hash(st->first->next, 0) == lyd_content_hash(st->second->next, 0));
+    assert_true(lyd_content_hash(st->first, 0) != lyd_content_hash(third, 0));
+    lyd_free_withsiblings(third);
+
+    /* the equal subtrees are skipped, the result is the same */
+    assert_ptr_not_equal((diff = lyd_diff(st->first, st->second, LYD_DIFFOPT_SUBTREEHASH)), NULL);
+    assert_int_equal(diff->type[0], LYD_DIFF_CHANGED);
+    assert_string_equal((str = lyd_path(diff->second[0])), "/defaults:df/foo");
+    free(str);
+    assert_int_equal(diff->type[1], LYD_DIFF_END);
+    lyd_free_diff(diff);
+
+    /* the trees are not left marked */
+    assert_ptr_not_equal((diff = lyd_diff(st->first, st->second, 0)), NULL);
+    assert_int_equal(diff->type[0], LYD_DIFF_CHANGED);
+    assert_int_equal(diff->type[1], LYD_DIFF_END);
+    lyd_free_diff(diff);
+}
+
+struct diff_iter {
+    struct lyd_difflist *diff;
+    unsigned int count;
+    unsigned int stop;
+};
+
+static int
+diff_iter_clb(LYD_DIFFTYPE type, struct lyd_node *first, struct lyd_node *second, void *user_data)
+{
+    struct diff_iter *iter = user_data;
+
+    /* the same differences in the same order as from lyd_diff() */
+    assert_int_equal(type, iter->diff->type[iter->count]);
+    assert_ptr_equal(first, iter->diff->first[iter->count]);
+    assert_ptr_equal(second, iter->diff->second[iter->count]);
+    ++iter->count;
+
+    return iter->count == iter->stop;
+}
+
+static void
+test_iter(void **state)
+{
+    struct state *st = (*state);
+    const char *xml1 = "<df xmlns=\"urn:libyang:tests:defaults\">"
+                         "<foo>42</foo><llist>1</llist><llist>2</llist><llist>3</llist>"
+                       "</df><hidden xmlns=\"urn:libyang:tests:defaults\">"
+                         "<foo>42</foo><baz>42</baz></hidden>";
+    const char *xml2 = "<nacm xmlns=\"urn:ietf:params:xml:ns:yang:ietf-netconf-acm\">"
+                         "<enable-nacm>false</enable-nacm>"
+                       "</nacm><df xmlns=\"urn:libyang:tests:defaults\">"
+                         "<foo>41</foo><llist>4</llist><llist>3</llist><llist>1</llist>"
+                       "</df>";
+    struct diff_iter iter = {NULL, 0, 0};
+    unsigned int count;
+
+    assert_ptr_not_equal((st->first = lyd_parse_mem(st->ctx, xml1, LYD_XML, LYD_OPT_CONFIG)), NULL);
+    assert_ptr_not_equal((st->second = lyd_parse_mem(st->ctx, xml2, LYD_XML, LYD_OPT_CONFIG)), NULL);
+
+    assert_ptr_not_equal((iter.diff = lyd_diff(st->first, st->second, 0)), NULL);
+    for (count = 0; iter.diff->type[count] != LYD_DIFF_END; ++count);
+    assert_true(count > 3);
+
+    /* all the differences */
+    assert_int_equal(lyd_diff_iter(st->first, st->second, 0, diff_iter_clb, &iter), EXIT_SUCCESS);
+    assert_int_equal(iter.count, count);
+
+    /* stopped by the callback */
+    iter.count = 0;
+    iter.stop = 2;
+    assert_int_equal(lyd_diff_iter(st->first, st->second, 0, diff_iter_clb, &iter), EXIT_SUCCESS);
+    assert_int_equal(iter.count, 2);
+
+    /* the trees are not left marked */
+    iter.count = 0;
+    iter.stop = 0;
+    assert_int_equal(lyd_diff_iter(st->first, st->second, 0, diff_iter_clb, &iter), EXIT_SUCCESS);
+    assert_int_equal(iter.count, count);
+
+    assert_int_equal(lyd_diff_iter(st->first, st->second, 0, NULL, NULL), EXIT_FAILURE);
+    lyd_free_diff(iter.diff);
+}
+
+static void
+test_lyb_patch(void **state)
+{
+    struct state *st = (*state);
+    const char *xml1 = "<df xmlns=\"urn:libyang:tests:defaults\">"
+                         "<foo>42</foo>"
+                         "<llist>1</llist>"
+                         "<llist>2</llist>"
+                         "<llist>3</llist>"
+                       "</df><hidden xmlns=\"urn:libyang:tests:defaults\">"
+                         "<foo>42</foo><baz>42</baz></hidden>";
+    const char *xml2 = "<nacm xmlns=\"urn:ietf:params:xml:ns:yang:ietf-netconf-acm\">"
+                         "<enable-nacm>false</enable-nacm>"
+                       "</nacm><df xmlns=\"urn:libyang:tests:defaults\">"
+                         "<foo>41</foo>"
+                         "<llist>4</llist>"
+                         "<llist>3</llist>"
+                         "<llist>1</llist>"
+                         "<llist>5</llist>"
+                       "</df>";
+    struct lyd_node *root;
+    struct ly_set *set;
+    char *patch, *lyb, *str;
+
+    assert_ptr_not_equal((st->first = lyd_parse_mem(st->ctx, xml1, LYD_XML, LYD_OPT_CONFIG)), NULL);
+    assert_ptr_not_equal((st->second = lyd_parse_mem(st->ctx, xml2, LYD_XML, LYD_OPT_CONFIG)), NULL);
+
+    assert_int_equal(lyd_lyb_patch(&patch, st->first, st->second, 0), 0);
+    assert_int_not_equal(lyd_lyb_patch_length(patch), -1);
+
+    root = lyd_dup_withsiblings(st->first, LYD_DUP_OPT_RECURSIVE);
+    assert_ptr_not_equal(root, NULL);
+    assert_int_equal(lyd_lyb_patch_apply(st->ctx, &root, patch, LYD_OPT_CONFIG | LYD_OPT_TRUSTED), 0);
+    assert_int_equal(lyd_validate(&root, LYD_OPT_CONFIG, NULL), 0);
+
+    lyd_print_mem(&st->xml, st->second, LYD_XML, LYP_WITHSIBLINGS);
+    lyd_print_mem(&str, root, LYD_XML, LYP_WITHSIBLINGS);
+    assert_string_equal(str, st->xml);
+    free(str);
+
+    /* the patch does not apply to the new tree */
+    assert_int_not_equal(lyd_lyb_patch_apply(st->ctx, &root, patch, LYD_OPT_CONFIG), 0);
+    lyd_free_withsiblings(root);
+
+    /* from an empty tree */
+    free(patch);
+    assert_int_equal(lyd_lyb_patch(&patch, NULL, st->second, 0), 0);
+    root = NULL;
+    assert_int_equal(lyd_lyb_patch_apply(st->ctx, &root, patch, LYD_OPT_CONFIG | LYD_OPT_TRUSTED), 0);
+    lyd_print_mem(&str, root, LYD_XML, LYP_WITHSIBLINGS);
+    assert_string_equal(str, st->xml);
+    free(str);
+    lyd_free_withsiblings(root);
+    free(patch);
+
+    /* only the changes are encoded */
+    lyd_free_withsiblings(st->first);
+    assert_ptr_not_equal((st->first = lyd_dup_withsiblings(st->second, LYD_DUP_OPT_RECURSIVE)), NULL);
+    set = lyd_find_path(st->first, "/defaults:df/foo");
+    assert_ptr_not_equal(set, NULL);
+    assert_int_equal(set->number, 1);
+    assert_int_equal(lyd_change_leaf((struct lyd_node_leaf_list *)set->set.d[0], "40"), 0);
+    ly_set_free(set);
+    assert_int_equal(lyd_lyb_patch(&patch, st->first, st->second, 0), 0);
+    assert_int_equal(lyd_print_mem(&lyb, st->second, LYD_LYB, LYP_WITHSIBLINGS), 0);
+    assert_true(lyd_lyb_patch_length(patch) < lyd_lyb_data_length(lyb));
+    free(lyb);
+    free(patch);
+}
+
 int main(void)
 {
     const struct CMUnitTest tests[] = {
@@ -573,9 +858,14 @@ int main(void)
                     cmocka_unit_test_setup_teardown(test_move1, setup_f, teardown_f),
                     cmocka_unit_test_setup_teardown(test_move2, setup_f, teardown_f),
                     cmocka_unit_test_setup_teardown(test_move3, setup_f, teardown_f),
+                    cmocka_unit_test_setup_teardown(test_move_many, setup_f, teardown_f),
                     cmocka_unit_test_setup_teardown(test_mix1, setup_f, teardown_f),
                     cmocka_unit_test_setup_teardown(test_mix2, setup_f, teardown_f),
-                    cmocka_unit_test_setup_teardown(test_wd1, setup_f, teardown_f), };
+                    cmocka_unit_test_setup_teardown(test_wd1, setup_f, teardown_f),
+                    cmocka_unit_test_setup_teardown(test_toplevel_list, setup_f, teardown_f),
+                    cmocka_unit_test_setup_teardown(test_subtree_hash, setup_f, teardown_f),
+                    cmocka_unit_test_setup_teardown(test_iter, setup_f, teardown_f),
+                    cmocka_unit_test_setup_teardown(test_lyb_patch, setup_f, teardown_f), };
 
     return cmocka_run_group_tests(tests, NULL, NULL);
 }
@@ -0,0 +1,244 @@
+/**
+ * @file test_filter.c
+ * @brief Cmocka tests for the subscription filters evaluation.
+ *
+ * Copyright (c) 2019 CESNET, z.s.p.o.
+ *
+ * This source code is licensed under BSD 3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://opensource.org/licenses/BSD-3-Clause
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "tests/config.h"
+#include "libyang.h"
+
+struct state {
+    struct ly_ctx *ctx;
+    const struct lys_module *mod;
+    struct lyd_filter *filter;
+};
+
+static const char *schema =
+    "module nf {"
+    "  namespace urn:nf;"
+    "  prefix nf;"
+    "  notification alarm { leaf severity { type string; } leaf source { type string; } }"
+    "  notification link-down { leaf if-name { type string; } }"
+    "  container interfaces { list interface { key name; leaf name { type string; } leaf type { type string; }"
+    "    leaf description { type string; } leaf mtu { type uint16; } } }"
+    "}";
+
+static int
+setup_f(void **state)
+{
+    struct state *st;
+
+    (*state) = st = calloc(1, sizeof *st);
+    if (!st) {
+        fprintf(stderr, "Memory allocation error");
+        return -1;
+    }
+
+    st->ctx = ly_ctx_new(NULL, 0);
+    if (!st->ctx) {
+        fprintf(stderr, "Failed to create context.\n");
+        goto error;
+    }
+    st->mod = lys_parse_mem(st->ctx, schema, LYS_IN_YANG);
+    if (!st->mod) {
+        fprintf(stderr, "Failed to load data model.\n");
+        goto error;
+    }
+    st->filter = lyd_filter_new(st->ctx);
+    if (!st->filter) {
+        fprintf(stderr, "Failed to create the filters.\n");
+        goto error;
+    }
+
+    return 0;
+
+error:
+    ly_ctx_destroy(st->ctx, NULL);
+    free(st);
+    (*state) = NULL;
+
+    return -1;
+}
+
+static int
+teardown_f(void **state)
+{
+    struct state *st = (*state);
+
+    lyd_filter_free(st->filter);
+    ly_ctx_destroy(st->ctx, NULL);
+    free(st);
+    (*state) = NULL;
+
+    return 0;
+}
+
+static void
+match(struct state *st, const char *notif_xml, uint32_t expected_count, const uint32_t *expected)
+{
+    struct lyd_node *notif;
+    uint32_t *ids, count, i;
+
+    notif = lyd_parse_mem(st->ctx, notif_xml, LYD_XML, LYD_OPT_NOTIF, NULL);
+    assert_non_null(notif);
+
+    assert_int_equal(lyd_filter_match(st->filter, notif, &ids, &count), EXIT_SUCCESS);
+    assert_int_equal(count, expected_count);
+    for (i = 0; i < count; ++i) {
+        assert_int_equal(ids[i], expected[i]);
+    }
+
+    free(ids);
+    lyd_free_withsiblings(notif);
+}
+
+static void
+test_xpath(void **state)
+{
+    struct state *st = (*state);
+    const uint32_t ids1[] = {1, 2, 4, 6}, ids2[] = {3, 4, 6}, ids3[] = {4, 6};
+
+    assert_int_equal(lyd_filter_add(st->filter, st->mod, "/nf:alarm[severity='critical']", 1), EXIT_SUCCESS);
+    /* the same filter of another subscriber */
+    assert_int_equal(lyd_filter_add(st->filter, st->mod, "/nf:alarm[severity='critical']", 2), EXIT_SUCCESS);
+    assert_int_equal(lyd_filter_add(st->filter, st->mod, "/nf:link-down", 3), EXIT_SUCCESS);
+    /* evaluated on all the notifications */
+    assert_int_equal(lyd_filter_add(st->filter, st->mod, "count(/nf:alarm) = 1 and not(/nf:alarm/severity = 'x')", 4),
+                     EXIT_SUCCESS);
+    assert_int_equal(lyd_filter_add(st->filter, st->mod, "/nf:link-down", 4), EXIT_SUCCESS);
+    assert_int_equal(lyd_filter_add(st->filter, st->mod, "/nf:alarm[severity='none']", 5), EXIT_SUCCESS);
+    /* union of both the notifications */
+    assert_int_equal(lyd_filter_add(st->filter, st->mod, "/nf:alarm | /nf:link-down", 6), EXIT_SUCCESS);
+    assert_int_equal(lyd_filter_add(st->filter, st->mod, "/nf:alarm[", 7), EXIT_FAILURE);
+
+    match(st, "<alarm xmlns=\"urn:nf\"><severity>critical</severity><source>eth0</source></alarm>", 4, ids1);
+    /* subscriber 4 returned once */
+    match(st, "<link-down xmlns=\"urn:nf\"><if-name>eth0</if-name></link-down>", 3, ids2);
+    match(st, "<alarm xmlns=\"urn:nf\"><severity>minor</severity></alarm>", 2, ids3);
+}
+
+static void
+test_subtree(void **state)
+{
+    struct state *st = (*state);
+    struct lyd_node *subtree, *node;
+    const uint32_t ids1[] = {1, 2}, ids2[] = {2};
+
+    /* the parser accepts notification nodes only in a whole notification, the filters are created */
+    subtree = lyd_new(NULL, st->mod, "alarm");
+    assert_non_null(subtree);
+    assert_non_null(lyd_new_leaf(subtree, NULL, "source", "eth0"));
+    assert_non_null(lyd_new_leaf(subtree, NULL, "severity", ""));
+    assert_int_equal(lyd_filter_add_subtree(st->filter, subtree, 1), EXIT_SUCCESS);
+    lyd_free_withsiblings(subtree);
+
+    subtree = lyd_new(NULL, st->mod, "alarm");
+    assert_non_null(subtree);
+    node = lyd_new(NULL, st->mod, "link-down");
+    assert_non_null(node);
+    assert_int_equal(lyd_insert_after(subtree, node), EXIT_SUCCESS);
+    assert_int_equal(lyd_filter_add_subtree(st->filter, subtree, 2), EXIT_SUCCESS);
+    lyd_free_withsiblings(subtree);
+
+    match(st, "<alarm xmlns=\"urn:nf\"><severity>critical</severity><source>eth0</source></alarm>", 2, ids1);
+    match(st, "<alarm xmlns=\"urn:nf\"><severity>critical</severity><source>eth1</source></alarm>", 1, ids2);
+    match(st, "<link-down xmlns=\"urn:nf\"><if-name>eth0</if-name></link-down>", 1, ids2);
+}
+
+static void
+subtree_filter(struct state *st, const struct lyd_node *data, const char *filter_xml, const char *expected)
+{
+    struct lyxml_elem *filter;
+    struct lyd_node *result;
+    char *str = NULL;
+
+    filter = lyxml_parse_mem(st->ctx, filter_xml, LYXML_PARSE_MULTIROOT);
+    assert_non_null(filter);
+
+    assert_int_equal(lyd_subtree_filter(data, filter, &result), EXIT_SUCCESS);
+    if (expected) {
+        assert_non_null(result);
+        lyd_print_mem(&str, result, LYD_XML, LYP_WITHSIBLINGS);
+        assert_string_equal(str, expected);
+    } else {
+        assert_null(result);
+    }
+
+    free(str);
+    lyd_free_withsiblings(result);
+    lyxml_free_withsiblings(st->ctx, filter);
+}
+
+static void
+test_subtree_filter(void **state)
+{
+    struct state *st = (*state);
+    struct lyd_node *data;
+
+    data = lyd_parse_mem(st->ctx,
+                         "<interfaces xmlns=\"urn:nf\">"
+                         "<interface><name>eth0</name><type>ethernet</type><description>a</description><mtu>1500</mtu></interface>"
+                         "<interface><name>eth1</name><type>ethernet</type><description>b</description><mtu>9000</mtu></interface>"
+                         "<interface><name>lo</name><type>loopback</type><description>c</description></interface>"
+                         "</interfaces>", LYD_XML, LYD_OPT_CONFIG);
+    assert_non_null(data);
+
+    /* selection node */
+    subtree_filter(st, data, "<interfaces xmlns=\"urn:nf\"/>",
+                   "<interfaces xmlns=\"urn:nf\">"
+                   "<interface><name>eth0</name><type>ethernet</type><description>a</description><mtu>1500</mtu></interface>"
+                   "<interface><name>eth1</name><type>ethernet</type><description>b</description><mtu>9000</mtu></interface>"
+                   "<interface><name>lo</name><type>loopback</type><description>c</description></interface>"
+                   "</interfaces>");
+
+    /* content match with a selection node, the keys are included, union with a content match only filter */
+    subtree_filter(st, data,
+                   "<interfaces xmlns=\"urn:nf\"><interface><type>ethernet</type><description/></interface>"
+                   "<interface><name>lo</name></interface></interfaces>",
+                   "<interfaces xmlns=\"urn:nf\">"
+                   "<interface><name>eth0</name><type>ethernet</type><description>a</description></interface>"
+                   "<interface><name>eth1</name><type>ethernet</type><description>b</description></interface>"
+                   "<interface><name>lo</name><type>loopback</type><description>c</description></interface>"
+                   "</interfaces>");
+
+    /* selection nodes of typed leaves, a content match of a number */
+    subtree_filter(st, data, "<interfaces xmlns=\"urn:nf\"><interface><mtu/></interface></interfaces>",
+                   "<interfaces xmlns=\"urn:nf\">"
+                   "<interface><name>eth0</name><mtu>1500</mtu></interface>"
+                   "<interface><name>eth1</name><mtu>9000</mtu></interface>"
+                   "</interfaces>");
+    subtree_filter(st, data, "<interfaces xmlns=\"urn:nf\"><interface><mtu>9000</mtu><type/></interface></interfaces>",
+                   "<interfaces xmlns=\"urn:nf\">"
+                   "<interface><name>eth1</name><type>ethernet</type><mtu>9000</mtu></interface>"
+                   "</interfaces>");
+
+    /* no content match */
+    subtree_filter(st, data, "<interfaces xmlns=\"urn:nf\"><interface><name>eth2</name><description/></interface></interfaces>",
+                   NULL);
+
+    lyd_free_withsiblings(data);
+}
+
+int
+main(void)
+{
+    const struct CMUnitTest tests[] = {
+                    cmocka_unit_test_setup_teardown(test_xpath, setup_f, teardown_f),
+                    cmocka_unit_test_setup_teardown(test_subtree, setup_f, teardown_f),
+                    cmocka_unit_test_setup_teardown(test_subtree_filter, setup_f, teardown_f), };
+
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
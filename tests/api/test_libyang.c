@@ -27,6 +27,8 @@
 #include <unistd.h>
 #include <string.h>
 #include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
 
 #include "tests/config.h"
 #include "libyang.h"
@@ -248,6 +250,80 @@ test_ly_ctx_info(void **state)
     lyd_free_withsiblings(node);
 }
 
+static int
+info_has(struct lyd_node *info, const char *path)
+{
+    struct ly_set *set;
+    int ret;
+
+    set = lyd_find_path(info, path);
+    assert_non_null(set);
+    ret = set->number;
+    ly_set_free(set);
+    return ret;
+}
+
+static const char *
+info_imp_clb(const char *mod_name, const char *mod_rev, const char *submod_name, const char *sub_rev, void *user_data,
+             LYS_INFORMAT *format, void (**free_module_data)(void *model_data, void *user_data))
+{
+    (void)mod_rev;
+    (void)submod_name;
+    (void)sub_rev;
+    (void)user_data;
+    (void)free_module_data;
+
+    if (strcmp(mod_name, "j")) {
+        return NULL;
+    }
+    *format = LYS_IN_YANG;
+    return "module j { namespace urn:j; prefix j; container c; }";
+}
+
+static void
+test_ly_ctx_info_cached(void **state)
+{
+    struct lyd_node *node, *node2;
+    const struct lys_module *mod;
+    (void) state; /* unused */
+
+    ctx = ly_ctx_new(NULL, 0);
+    assert_non_null(ctx);
+
+    node = ly_ctx_info(ctx);
+    assert_non_null(node);
+    node2 = ly_ctx_info(ctx);
+    assert_non_null(node2);
+    /* independent copies of the same data */
+    assert_ptr_not_equal(node, node2);
+    assert_int_equal(LYD_VAL_OK, node2->validity);
+    assert_int_equal(info_has(node, "/ietf-yang-library:modules-state/module[name='ietf-yang-library']"), 1);
+    assert_int_equal(info_has(node2, "/ietf-yang-library:modules-state/module[name='ietf-yang-library']"), 1);
+    lyd_free_withsiblings(node2);
+    assert_int_equal(info_has(node, "/ietf-yang-library:modules-state/module[name='i']"), 0);
+    lyd_free_withsiblings(node);
+
+    /* new module */
+    ly_ctx_set_module_imp_clb(ctx, info_imp_clb, NULL);
+    mod = lys_parse_mem(ctx, "module i { namespace urn:i; prefix i; import j { prefix j; } feature f; }", LYS_IN_YANG);
+    assert_non_null(mod);
+    node = ly_ctx_info(ctx);
+    assert_non_null(node);
+    assert_int_equal(info_has(node, "/ietf-yang-library:modules-state/module[name='i']"), 1);
+    assert_int_equal(info_has(node, "/ietf-yang-library:modules-state/module[name='i'][feature='f']"), 0);
+    assert_int_equal(info_has(node, "/ietf-yang-library:modules-state/module[name='j'][conformance-type='import']"), 1);
+    lyd_free_withsiblings(node);
+
+    /* feature and conformance changes */
+    assert_int_equal(lys_features_enable(mod, "f"), EXIT_SUCCESS);
+    assert_int_equal(lys_set_implemented(ly_ctx_get_module(ctx, "j", NULL, 0)), EXIT_SUCCESS);
+    node = ly_ctx_info(ctx);
+    assert_non_null(node);
+    assert_int_equal(info_has(node, "/ietf-yang-library:modules-state/module[name='i'][feature='f']"), 1);
+    assert_int_equal(info_has(node, "/ietf-yang-library:modules-state/module[name='j'][conformance-type='import']"), 0);
+    lyd_free_withsiblings(node);
+}
+
 static void
 test_ly_ctx_new_ylmem(void **state)
 {
@@ -275,6 +351,74 @@ test_ly_ctx_new_ylmem(void **state)
     ly_ctx_destroy(new_ctx, NULL);
 }
 
+static void
+test_ly_ctx_clone(void **state)
+{
+    (void) state; /* unused */
+    const struct lys_module *mod, *cmod;
+    struct lyd_node *node;
+    struct ly_ctx *clone;
+    uint32_t idx;
+
+    ctx = ly_ctx_new(TESTS_DIR"/api/files", 0);
+    assert_non_null(ctx);
+    ly_ctx_set_module_imp_clb(ctx, info_imp_clb, NULL);
+
+    /* modules from files and from memory */
+    assert_non_null(mod = ly_ctx_load_module(ctx, "a", NULL));
+    assert_int_equal(lys_features_enable(mod, "*"), EXIT_SUCCESS);
+    assert_int_equal(lys_features_disable(mod, "foo"), EXIT_SUCCESS);
+    assert_non_null(ly_ctx_load_module(ctx, "y", NULL));
+    assert_non_null(mod = lys_parse_mem(ctx, "module i { namespace urn:i; prefix i; import j { prefix j; }"
+                                        "import a { prefix a; } feature f; augment /a:x { leaf i { type string; } } }",
+                                        LYS_IN_YANG));
+    assert_int_equal(lys_features_enable(mod, "f"), EXIT_SUCCESS);
+    assert_non_null(mod = ly_ctx_load_module(ctx, "z", NULL));
+    assert_int_equal(lys_set_disabled(mod), EXIT_SUCCESS);
+
+    clone = ly_ctx_clone(ctx);
+    assert_non_null(clone);
+    assert_int_equal(clone->models.used, ctx->models.used);
+    assert_int_equal(ly_ctx_get_options(clone), ly_ctx_get_options(ctx));
+    assert_string_equal(ly_ctx_get_searchdirs(clone)[0], ly_ctx_get_searchdirs(ctx)[0]);
+
+    for (idx = 0; idx < (unsigned)ctx->models.used; ++idx) {
+        mod = ctx->models.list[idx];
+        cmod = clone->models.list[idx];
+        assert_string_equal(cmod->name, mod->name);
+        assert_ptr_not_equal(cmod, mod);
+        assert_int_equal(cmod->implemented, mod->implemented);
+        assert_int_equal(cmod->disabled, mod->disabled);
+        if (mod->filepath) {
+            assert_string_equal(cmod->filepath, mod->filepath);
+        }
+    }
+    cmod = ly_ctx_get_module(clone, "a", NULL, 1);
+    assert_non_null(cmod);
+    assert_int_equal(lys_features_state(cmod, "foo"), 0);
+    assert_int_equal(lys_features_state(ly_ctx_get_module(clone, "i", NULL, 1), "f"), 1);
+    assert_non_null(cmod = ly_ctx_get_module(clone, "j", NULL, 0));
+    assert_int_equal(cmod->implemented, 0);
+
+    /* the augment is applied in the clone */
+    node = lyd_new_path(NULL, clone, "/a:x/i:i", "v", 0, 0);
+    assert_non_null(node);
+    lyd_free_withsiblings(node);
+
+    /* changing the clone does not affect the original context */
+    idx = ctx->models.used;
+    assert_non_null(lys_parse_mem(clone, "module k { namespace urn:k; prefix k; leaf k { type string; } }", LYS_IN_YANG));
+    assert_int_equal(ctx->models.used, idx);
+    assert_ptr_equal(ly_ctx_get_module(ctx, "k", NULL, 0), NULL);
+    ly_ctx_destroy(clone, NULL);
+
+    /* a deviated module read from memory cannot be cloned */
+    assert_non_null(lys_parse_mem(ctx, "module m { namespace urn:m; prefix m; leaf m { type string; } }", LYS_IN_YANG));
+    assert_non_null(lys_parse_mem(ctx, "module n { namespace urn:n; prefix n; import m { prefix m; }"
+                                  "deviation /m:m { deviate not-supported; } }", LYS_IN_YANG));
+    assert_ptr_equal(ly_ctx_clone(ctx), NULL);
+}
+
 static void
 test_ly_ctx_module_clb(void **state)
 {
@@ -304,6 +448,69 @@ test_ly_ctx_module_clb(void **state)
     ly_ctx_set_module_data_clb(ctx, NULL, NULL);
 }
 
+static const char *
+prefetch_imp_clb(const char *mod_name, const char *mod_rev, const char *submod_name, const char *sub_rev, void *user_data,
+                 LYS_INFORMAT *format, void (**free_module_data)(void *model_data, void *user_data))
+{
+    static char buf[128];
+    (void)mod_rev;
+    (void)submod_name;
+    (void)sub_rev;
+    (void)user_data;
+    (void)free_module_data;
+
+    *format = LYS_IN_YANG;
+    sprintf(buf, "module %s { namespace urn:%s; prefix %s; }", mod_name, mod_name, mod_name);
+    return buf;
+}
+
+static void
+prefetch_clb(const char **names, const char **revisions, unsigned int count, void *user_data)
+{
+    char *announced = user_data;
+    unsigned int u;
+
+    for (u = 0; u < count; ++u) {
+        strcat(announced, names[u]);
+        strcat(announced, revisions[u] ? revisions[u] : "");
+        strcat(announced, " ");
+    }
+}
+
+static void
+test_ly_ctx_module_prefetch_clb(void **state)
+{
+    (void) state; /* unused */
+    char announced[128] = "";
+    void *data;
+
+    ctx = ly_ctx_new(NULL, 0);
+    assert_ptr_not_equal(ctx, NULL);
+    assert_ptr_equal(ly_ctx_get_module_prefetch_clb(ctx, &data), NULL);
+    assert_ptr_equal(data, NULL);
+
+    ly_ctx_set_module_imp_clb(ctx, prefetch_imp_clb, NULL);
+    ly_ctx_set_module_prefetch_clb(ctx, prefetch_clb, announced);
+    assert_ptr_equal(ly_ctx_get_module_prefetch_clb(ctx, &data), prefetch_clb);
+    assert_ptr_equal(data, announced);
+
+    /* all the imports are announced at once */
+    assert_non_null(lys_parse_mem(ctx, "module pa { namespace urn:pa; prefix pa; import pb { prefix pb; }"
+                                  "import pc { prefix pc; } }", LYS_IN_YANG));
+    assert_string_equal(announced, "pb pc ");
+
+    /* only the missing ones */
+    announced[0] = '\0';
+    assert_non_null(lys_parse_mem(ctx, "<module name=\"pd\" xmlns=\"urn:ietf:params:xml:ns:yang:yin:1\">"
+                                  "<namespace uri=\"urn:pd\"/><prefix value=\"pd\"/>"
+                                  "<import module=\"pb\"><prefix value=\"pb\"/></import>"
+                                  "<import module=\"pe\"><prefix value=\"pe\"/></import></module>", LYS_IN_YIN));
+    assert_string_equal(announced, "pe ");
+
+    ly_ctx_set_module_prefetch_clb(ctx, NULL, NULL);
+    assert_ptr_equal(ly_ctx_get_module_prefetch_clb(ctx, NULL), NULL);
+}
+
 static void
 test_ly_ctx_get_module(void **state)
 {
@@ -450,6 +657,134 @@ test_ly_ctx_load_module(void **state)
     assert_string_equal("b", module->name);
 }
 
+static void
+write_module(const char *dir, const char *file, const char *name, const char *revision)
+{
+    char path[PATH_MAX];
+    FILE *f;
+
+    sprintf(path, "%s/%s", dir, file);
+    f = fopen(path, "w");
+    assert_non_null(f);
+    fprintf(f, "module %s { namespace urn:%s; prefix %s; %s%s%s}", name, name, name,
+            revision ? "revision " : "", revision ? revision : "", revision ? "; " : "");
+    fclose(f);
+}
+
+static void
+test_ly_ctx_load_modules(void **state)
+{
+    (void) state; /* unused */
+    const char *names[] = {"c", "b", "x"};
+    const char *revisions[] = {NULL, "2015-01-01", NULL};
+    const struct lys_module *mods[3];
+
+    ctx = ly_ctx_new(TESTS_DIR"/api/files", 0);
+    assert_non_null(ctx);
+
+    assert_int_equal(ly_ctx_load_modules(NULL, names, revisions, 3, mods), EXIT_FAILURE);
+    assert_int_equal(ly_ctx_load_modules(ctx, NULL, NULL, 1, NULL), EXIT_FAILURE);
+    assert_int_equal(ly_ctx_load_modules(ctx, names, NULL, 0, NULL), EXIT_SUCCESS);
+
+    assert_int_equal(ly_ctx_load_modules(ctx, names, revisions, 3, mods), EXIT_SUCCESS);
+    assert_string_equal(mods[0]->name, "c");
+    assert_string_equal(mods[1]->name, "b");
+    assert_string_equal(mods[1]->rev[0].date, "2015-01-01");
+    assert_string_equal(mods[2]->name, "x");
+    assert_true(mods[0]->implemented && mods[1]->implemented && mods[2]->implemented);
+    /* imported by c */
+    assert_non_null(ly_ctx_get_module(ctx, "a", "2015-01-01", 0));
+
+    /* already loaded modules are just returned */
+    assert_int_equal(ly_ctx_load_modules(ctx, &names[2], NULL, 1, mods), EXIT_SUCCESS);
+    assert_string_equal(mods[0]->name, "x");
+
+    names[1] = "INVALID_NAME";
+    assert_int_equal(ly_ctx_load_modules(ctx, names, NULL, 2, NULL), EXIT_FAILURE);
+}
+
+static void
+test_ly_ctx_load_module_searchdir_change(void **state)
+{
+    (void) state; /* unused */
+    char dir[] = "/tmp/libyang-test-XXXXXX", path[PATH_MAX];
+    const struct lys_module *mod;
+
+    assert_non_null(mkdtemp(dir));
+    write_module(dir, "s1.yang", "s1", NULL);
+
+    ctx = ly_ctx_new(dir, LY_CTX_DISABLE_SEARCHDIR_CWD);
+    assert_non_null(ctx);
+    mod = ly_ctx_load_module(ctx, "s1", NULL);
+    assert_non_null(mod);
+    assert_null(ly_ctx_load_module(ctx, "s2", NULL));
+
+    /* files added after the directory was searched are found */
+    write_module(dir, "s2.yang", "s2", NULL);
+    mod = ly_ctx_load_module(ctx, "s2", NULL);
+    assert_non_null(mod);
+    assert_string_equal(mod->name, "s2");
+
+    sprintf(path, "%s/s1.yang", dir);
+    unlink(path);
+    sprintf(path, "%s/s2.yang", dir);
+    unlink(path);
+    rmdir(dir);
+}
+
+static void
+test_ly_ctx_load_module_searchdir_index(void **state)
+{
+    (void) state; /* unused */
+    char dir[] = "/tmp/libyang-test-XXXXXX", path[PATH_MAX];
+    const char *files[] = {"m@2019-01-01.yang", "m@2020-01-01.yang", "m-x.yang", "ma.yang", "l.yang", "sub/n.yang"};
+    const struct lys_module *mod;
+    unsigned int i;
+
+    assert_non_null(mkdtemp(dir));
+    sprintf(path, "%s/sub", dir);
+    assert_int_equal(mkdir(path, 0700), 0);
+    write_module(dir, files[0], "m", "2019-01-01");
+    write_module(dir, files[1], "m", "2020-01-01");
+    write_module(dir, files[2], "m-x", NULL);
+    write_module(dir, files[3], "ma", NULL);
+    write_module(dir, files[4], "l", NULL);
+    write_module(dir, files[5], "n", NULL);
+
+    ctx = ly_ctx_new(dir, LY_CTX_DISABLE_SEARCHDIR_CWD);
+    assert_non_null(ctx);
+
+    /* the newest revision, not the files of other modules with the same prefix */
+    mod = ly_ctx_load_module(ctx, "m", NULL);
+    assert_non_null(mod);
+    assert_string_equal(mod->rev[0].date, "2020-01-01");
+    mod = ly_ctx_load_module(ctx, "ma", NULL);
+    assert_non_null(mod);
+    assert_string_equal(mod->name, "ma");
+    /* in a subdirectory */
+    mod = ly_ctx_load_module(ctx, "n", NULL);
+    assert_non_null(mod);
+    assert_int_equal(ctx->search_dir_count, 2);
+
+    /* the listings are dropped with the searchdirs */
+    ly_ctx_unset_searchdirs(ctx, -1);
+    assert_int_equal(ctx->search_dir_count, 0);
+    assert_null(ly_ctx_load_module(ctx, "l", NULL));
+
+    assert_int_equal(ly_ctx_set_searchdir(ctx, dir), EXIT_SUCCESS);
+    mod = ly_ctx_load_module(ctx, "l", NULL);
+    assert_non_null(mod);
+    assert_string_equal(mod->name, "l");
+
+    for (i = 0; i < sizeof files / sizeof *files; ++i) {
+        sprintf(path, "%s/%s", dir, files[i]);
+        unlink(path);
+    }
+    sprintf(path, "%s/sub", dir);
+    rmdir(path);
+    rmdir(dir);
+}
+
 static void
 test_ly_ctx_clean(void **state)
 {
@@ -464,25 +799,25 @@ test_ly_ctx_clean(void **state)
     /* remember starting values */
     setid = ctx->models.module_set_id;
     modules_count = ctx->models.used;
-    dict_used = ctx->dict.hash_tab->used;
+    dict_used = ctx->dict.shards[0].hash_tab->used;
 
     /* add a module */
     mod = ly_ctx_load_module(ctx, "x", NULL);
     assert_ptr_not_equal(mod, NULL);
     assert_int_equal(modules_count + 1, ctx->models.used);
-    assert_int_not_equal(dict_used, ctx->dict.hash_tab->used);
+    assert_int_not_equal(dict_used, ctx->dict.shards[0].hash_tab->used);
 
     /* clean the context */
     ly_ctx_clean(ctx, NULL);
     assert_int_equal(setid + 2, ctx->models.module_set_id);
     assert_int_equal(modules_count, ctx->models.used);
-    assert_int_equal(dict_used, ctx->dict.hash_tab->used);
+    assert_int_equal(dict_used, ctx->dict.shards[0].hash_tab->used);
 
     /* add a module again ... */
     mod = ly_ctx_load_module(ctx, "x", NULL);
     assert_ptr_not_equal(mod, NULL);
     assert_int_equal(modules_count + 1, ctx->models.used);
-    assert_int_not_equal(dict_used, ctx->dict.hash_tab->used);
+    assert_int_not_equal(dict_used, ctx->dict.shards[0].hash_tab->used);
 
     /* .. and add some string into dictionary */
     assert_ptr_not_equal(lydict_insert(ctx, "qwertyuiop", 0), NULL);
@@ -492,7 +827,7 @@ test_ly_ctx_clean(void **state)
     ly_ctx_clean(ctx, NULL);
     assert_int_equal(setid + 4, ctx->models.module_set_id);
     assert_int_equal(modules_count, ctx->models.used);
-    assert_int_equal(dict_used, ctx->dict.hash_tab->used);
+    assert_int_equal(dict_used, ctx->dict.shards[0].hash_tab->used);
 
     /* cleanup */
     lydict_remove(ctx, "qwertyuiop");
@@ -547,7 +882,7 @@ test_ly_ctx_remove_module(void **state)
     /* remember starting values */
     setid = ctx->models.module_set_id;
     modules_count = ctx->models.used;
-    dict_used = ctx->dict.hash_tab->used;
+    dict_used = ctx->dict.shards[0].hash_tab->used;
 
     mod = ly_ctx_load_module(ctx, "x", NULL);
     ly_ctx_remove_module(mod, NULL);
@@ -558,7 +893,7 @@ test_ly_ctx_remove_module(void **state)
     assert_true(setid < ctx->models.module_set_id);
     setid = ctx->models.module_set_id;
     assert_int_equal(modules_count + 2, ctx->models.used);
-    assert_int_not_equal(dict_used, ctx->dict.hash_tab->used);
+    assert_int_not_equal(dict_used, ctx->dict.shards[0].hash_tab->used);
 
     /* remove the imported module (x), that should cause removing also the loaded module (y) */
     mod = ly_ctx_get_module(ctx, "x", NULL, 0);
@@ -567,7 +902,7 @@ test_ly_ctx_remove_module(void **state)
     assert_true(setid < ctx->models.module_set_id);
     setid = ctx->models.module_set_id;
     assert_int_equal(modules_count, ctx->models.used);
-    assert_int_equal(dict_used, ctx->dict.hash_tab->used);
+    assert_int_equal(dict_used, ctx->dict.shards[0].hash_tab->used);
 
     /* add a module again ... */
     mod = ly_ctx_load_module(ctx, "y", NULL);
@@ -575,14 +910,14 @@ test_ly_ctx_remove_module(void **state)
     assert_true(setid < ctx->models.module_set_id);
     setid = ctx->models.module_set_id;
     assert_int_equal(modules_count + 2, ctx->models.used);
-    assert_int_not_equal(dict_used, ctx->dict.hash_tab->used);
+    assert_int_not_equal(dict_used, ctx->dict.shards[0].hash_tab->used);
     /* ... now remove the loaded module, the imported module is supposed to be removed because it is not
      * used in any other module */
     ly_ctx_remove_module(mod, NULL);
     assert_true(setid < ctx->models.module_set_id);
     setid = ctx->models.module_set_id;
     assert_int_equal(modules_count, ctx->models.used);
-    assert_int_equal(dict_used, ctx->dict.hash_tab->used);
+    assert_int_equal(dict_used, ctx->dict.shards[0].hash_tab->used);
 
     /* add a module again ... */
     mod = ly_ctx_load_module(ctx, "y", NULL);
@@ -590,7 +925,7 @@ test_ly_ctx_remove_module(void **state)
     assert_true(setid < ctx->models.module_set_id);
     setid = ctx->models.module_set_id;
     assert_int_equal(modules_count + 2, ctx->models.used);
-    assert_int_not_equal(dict_used, ctx->dict.hash_tab->used);
+    assert_int_not_equal(dict_used, ctx->dict.shards[0].hash_tab->used);
     /* and mark even the imported module 'x' as implemented ... */
     assert_int_equal(lys_set_implemented(mod->imp[0].module), EXIT_SUCCESS);
     /* ... now remove the loaded module, the imported module is supposed to be kept because it is implemented */
@@ -598,7 +933,7 @@ test_ly_ctx_remove_module(void **state)
     assert_true(setid < ctx->models.module_set_id);
     setid = ctx->models.module_set_id;
     assert_int_equal(modules_count + 1, ctx->models.used);
-    assert_int_not_equal(dict_used, ctx->dict.hash_tab->used);
+    assert_int_not_equal(dict_used, ctx->dict.shards[0].hash_tab->used);
     mod = ly_ctx_get_module(ctx, "y", NULL, 0);
     assert_ptr_equal(mod, NULL);
     mod = ly_ctx_get_module(ctx, "x", NULL, 0);
@@ -610,7 +945,7 @@ test_ly_ctx_remove_module(void **state)
     assert_true(setid < ctx->models.module_set_id);
     setid = ctx->models.module_set_id;
     assert_int_equal(modules_count + 2, ctx->models.used);
-    assert_int_not_equal(dict_used, ctx->dict.hash_tab->used);
+    assert_int_not_equal(dict_used, ctx->dict.shards[0].hash_tab->used);
     /* and add another one also importing module 'x' ... */
     assert_ptr_not_equal(ly_ctx_load_module(ctx, "z", NULL), NULL);
     assert_true(setid < ctx->models.module_set_id);
@@ -622,7 +957,7 @@ test_ly_ctx_remove_module(void **state)
     assert_true(setid < ctx->models.module_set_id);
     setid = ctx->models.module_set_id;
     assert_int_equal(modules_count + 2, ctx->models.used);
-    assert_int_not_equal(dict_used, ctx->dict.hash_tab->used);
+    assert_int_not_equal(dict_used, ctx->dict.shards[0].hash_tab->used);
     mod = ly_ctx_get_module(ctx, "y", NULL, 0);
     assert_ptr_equal(mod, NULL);
     mod = ly_ctx_get_module(ctx, "x", NULL, 0);
@@ -680,6 +1015,109 @@ test_ly_ctx_remove_module2(void **state)
     assert_true(!leaf->backlinks || !leaf->backlinks->number);
 }
 
+static const char *
+chain_imp_clb(const char *mod_name, const char *mod_rev, const char *submod_name, const char *sub_rev, void *user_data,
+              LYS_INFORMAT *format, void (**free_module_data)(void *model_data, void *user_data))
+{
+    (void)mod_rev;
+    (void)submod_name;
+    (void)sub_rev;
+    (void)user_data;
+    (void)free_module_data;
+
+    *format = LYS_IN_YANG;
+    if (!strcmp(mod_name, "cb")) {
+        return "module cb { namespace urn:cb; prefix cb; import cc { prefix cc; } leaf b { type cc:t; } }";
+    } else if (!strcmp(mod_name, "cc")) {
+        return "module cc { namespace urn:cc; prefix cc; typedef t { type string; } }";
+    }
+    return NULL;
+}
+
+static void
+test_ly_ctx_remove_module_deps(void **state)
+{
+    (void) state; /* unused */
+    const struct lys_module *moda, *modd;
+    int modules_count;
+
+    ctx = ly_ctx_new(NULL, 0);
+    assert_ptr_not_equal(ctx, NULL);
+    ly_ctx_set_module_imp_clb(ctx, chain_imp_clb, NULL);
+    modules_count = ctx->models.used;
+
+    /* ca imports cb importing cc, cd is independent */
+    moda = lys_parse_mem(ctx, "module ca { namespace urn:ca; prefix ca; import cb { prefix cb; } }", LYS_IN_YANG);
+    assert_ptr_not_equal(moda, NULL);
+    modd = lys_parse_mem(ctx, "module cd { namespace urn:cd; prefix cd; }", LYS_IN_YANG);
+    assert_ptr_not_equal(modd, NULL);
+    assert_int_equal(modules_count + 4, ctx->models.used);
+
+    /* disabling cc disables everything importing it, directly or not */
+    assert_int_equal(lys_set_disabled(ly_ctx_get_module(ctx, "cc", NULL, 0)), 0);
+    assert_int_equal(moda->disabled, 1);
+    assert_ptr_equal(ly_ctx_get_module(ctx, "cb", NULL, 0), NULL);
+    assert_int_equal(modd->disabled, 0);
+    assert_int_equal(lys_set_enabled(moda), 0);
+    assert_ptr_not_equal(ly_ctx_get_module(ctx, "cb", NULL, 0), NULL);
+    assert_ptr_not_equal(ly_ctx_get_module(ctx, "cc", NULL, 0), NULL);
+
+    /* removing the implemented module removes also its imports which are no longer used */
+    assert_int_equal(ly_ctx_remove_module(moda, NULL), 0);
+    assert_int_equal(modules_count + 1, ctx->models.used);
+    assert_ptr_equal(ly_ctx_get_module(ctx, "cb", NULL, 0), NULL);
+    assert_ptr_equal(ly_ctx_get_module(ctx, "cc", NULL, 0), NULL);
+    assert_ptr_equal(ly_ctx_get_module(ctx, "cd", NULL, 0), modd);
+
+    /* removing an imported module removes also the modules importing it */
+    moda = lys_parse_mem(ctx, "module ca { namespace urn:ca; prefix ca; import cb { prefix cb; } }", LYS_IN_YANG);
+    assert_ptr_not_equal(moda, NULL);
+    assert_int_equal(ly_ctx_remove_module(ly_ctx_get_module(ctx, "cc", NULL, 0), NULL), 0);
+    assert_int_equal(modules_count + 1, ctx->models.used);
+    assert_ptr_equal(ly_ctx_get_module(ctx, "ca", NULL, 0), NULL);
+    assert_ptr_equal(ly_ctx_get_module(ctx, "cb", NULL, 0), NULL);
+    assert_ptr_equal(ly_ctx_get_module(ctx, "cd", NULL, 0), modd);
+}
+
+static void
+test_ly_ctx_remove_module_deviations(void **state)
+{
+    (void) state; /* unused */
+    const struct lys_module *modt, *mod1, *mod2;
+    char *str;
+
+    ctx = ly_ctx_new(NULL, 0);
+    assert_ptr_not_equal(ctx, NULL);
+
+    modt = lys_parse_mem(ctx, "module t { namespace urn:t; prefix t; leaf a { type string; } leaf b { type string; } }",
+                         LYS_IN_YANG);
+    assert_ptr_not_equal(modt, NULL);
+    mod1 = lys_parse_mem(ctx, "module dev1 { namespace urn:dev1; prefix d1; import t { prefix tt; }"
+                         "deviation /tt:a { deviate not-supported; } }", LYS_IN_YANG);
+    assert_ptr_not_equal(mod1, NULL);
+    mod2 = lys_parse_mem(ctx, "module dev2 { namespace urn:dev2; prefix d2; import t { prefix tt; }"
+                         "deviation /tt:b { deviate add { default x; } } }", LYS_IN_YANG);
+    assert_ptr_not_equal(mod2, NULL);
+    assert_int_equal(modt->deviated, 1);
+    assert_ptr_equal(ly_ctx_get_node(ctx, NULL, "/t:a", 0), NULL);
+
+    /* the module is printed without all the deviations and they are applied again */
+    assert_int_equal(lys_print_mem(&str, modt, LYS_OUT_YANG, NULL, 0, 0), 0);
+    assert_ptr_not_equal(strstr(str, "leaf a"), NULL);
+    assert_ptr_equal(strstr(str, "default"), NULL);
+    free(str);
+    assert_ptr_equal(ly_ctx_get_node(ctx, NULL, "/t:a", 0), NULL);
+    assert_string_equal(((struct lys_node_leaf *)ly_ctx_get_node(ctx, NULL, "/t:b", 0))->dflt, "x");
+
+    /* the module stays deviated while any other deviation is applied */
+    assert_int_equal(ly_ctx_remove_module(mod1, NULL), 0);
+    assert_int_equal(modt->deviated, 1);
+    assert_ptr_not_equal(ly_ctx_get_node(ctx, NULL, "/t:a", 0), NULL);
+    assert_int_equal(ly_ctx_remove_module(mod2, NULL), 0);
+    assert_int_equal(modt->deviated, 0);
+    assert_ptr_equal(((struct lys_node_leaf *)ly_ctx_get_node(ctx, NULL, "/t:b", 0))->dflt, NULL);
+}
+
 static void
 test_lys_set_enabled(void **state)
 {
@@ -775,6 +1213,67 @@ test_lys_set_disabled(void **state)
     assert_ptr_not_equal(modx->data->child, NULL);
 }
 
+static int xpath_warnings;
+
+static void
+xpath_warn_clb(LY_LOG_LEVEL level, const char *msg, const char *path)
+{
+    (void)msg;
+    (void)path;
+
+    if (level == LY_LLWRN) {
+        ++xpath_warnings;
+    }
+}
+
+static const char *
+xpath_imp_clb(const char *mod_name, const char *mod_rev, const char *submod_name, const char *sub_rev, void *user_data,
+              LYS_INFORMAT *format, void (**free_module_data)(void *model_data, void *user_data))
+{
+    (void)mod_rev;
+    (void)submod_name;
+    (void)sub_rev;
+    (void)user_data;
+    (void)free_module_data;
+
+    *format = LYS_IN_YANG;
+    if (!strcmp(mod_name, "xa")) {
+        return "module xa { namespace urn:xa; prefix xa; typedef t { type string; }"
+               "container c { leaf l { when \"../missing\"; type t; } } }";
+    }
+    return NULL;
+}
+
+static void
+test_lys_set_implemented_xpath(void **state)
+{
+    (void) state; /* unused */
+    const struct lys_module *mod;
+
+    ctx = ly_ctx_new(NULL, 0);
+    assert_ptr_not_equal(ctx, NULL);
+    ly_ctx_set_module_imp_clb(ctx, xpath_imp_clb, NULL);
+    ly_set_log_clb(xpath_warn_clb, 0);
+    ly_verb(LY_LLWRN);
+    xpath_warnings = 0;
+
+    /* the expressions of the import-only module are not checked ... */
+    mod = lys_parse_mem(ctx, "module xb { namespace urn:xb; prefix xb; import xa { prefix xa; } leaf b { type xa:t; } }",
+                        LYS_IN_YANG);
+    assert_ptr_not_equal(mod, NULL);
+    mod = ly_ctx_get_module(ctx, "xa", NULL, 0);
+    assert_ptr_not_equal(mod, NULL);
+    assert_int_equal(mod->implemented, 0);
+    assert_int_equal(xpath_warnings, 0);
+
+    /* ... until the module is made implemented */
+    assert_int_equal(lys_set_implemented(mod), EXIT_SUCCESS);
+    assert_int_not_equal(xpath_warnings, 0);
+
+    ly_verb(LY_LLERR);
+    ly_set_log_clb(NULL, 1);
+}
+
 
 static void
 test_ly_ctx_get_module_by_ns(void **state)
@@ -809,6 +1308,97 @@ test_ly_ctx_get_module_by_ns(void **state)
     assert_string_equal("b", module->name);
 }
 
+static void
+test_ly_ctx_get_module_many(void **state)
+{
+    (void) state; /* unused */
+    const struct lys_module *mod, *disabled;
+    char yang[128], name[16], ns[32];
+    int i;
+
+    ctx = ly_ctx_new(NULL, 0);
+    assert_non_null(ctx);
+
+    for (i = 0; i < 200; ++i) {
+        sprintf(yang, "module m%d { namespace urn:m%d; prefix m; leaf l { type string; } }", i, i);
+        assert_non_null(lys_parse_mem(ctx, yang, LYS_IN_YANG));
+    }
+
+    /* remove every other module */
+    for (i = 0; i < 200; i += 2) {
+        sprintf(name, "m%d", i);
+        mod = ly_ctx_get_module(ctx, name, NULL, 1);
+        assert_non_null(mod);
+        assert_int_equal(ly_ctx_remove_module(mod, NULL), EXIT_SUCCESS);
+    }
+    /* disable one */
+    disabled = ly_ctx_get_module(ctx, "m101", NULL, 0);
+    assert_non_null(disabled);
+    assert_int_equal(lys_set_disabled(disabled), EXIT_SUCCESS);
+
+    for (i = 0; i < 200; ++i) {
+        sprintf(name, "m%d", i);
+        sprintf(ns, "urn:m%d", i);
+        mod = ly_ctx_get_module(ctx, name, NULL, 0);
+        if (i == 101) {
+            assert_ptr_equal(mod, NULL);
+            assert_ptr_equal(ly_ctx_get_module_by_ns(ctx, ns, NULL, 0), NULL);
+        } else if (i % 2) {
+            assert_non_null(mod);
+            assert_string_equal(mod->name, name);
+            assert_ptr_equal(ly_ctx_get_module_by_ns(ctx, ns, NULL, 0), mod);
+        } else {
+            assert_ptr_equal(mod, NULL);
+            assert_ptr_equal(ly_ctx_get_module_by_ns(ctx, ns, NULL, 0), NULL);
+        }
+    }
+
+    assert_int_equal(lys_set_enabled(disabled), EXIT_SUCCESS);
+    assert_ptr_equal(ly_ctx_get_module(ctx, "m101", NULL, 1), disabled);
+}
+
+static void
+test_ly_ctx_precompute(void **state)
+{
+    (void) state; /* unused */
+    const struct lys_module *mod;
+    const struct lys_node *node;
+    struct lyd_node *data;
+    const char *yang = "module p { namespace urn:p; prefix p;"
+        "typedef name { type string { length 1..8; pattern '[a-z]+'; } }"
+        "container c { must 'count(l) < 3';"
+        "  leaf s { type name; }"
+        "  leaf-list l { type union { type uint8 { range 1..10; } type name; } }"
+        "  leaf i { when \"../s = 'x'\"; type int16; } } }";
+
+    ctx = ly_ctx_new(NULL, 0);
+    assert_non_null(ctx);
+    mod = lys_parse_mem(ctx, yang, LYS_IN_YANG);
+    assert_non_null(mod);
+
+    assert_int_equal(ly_ctx_precompute(ctx), EXIT_SUCCESS);
+
+    node = ly_ctx_get_node(ctx, NULL, "/p:c/s", 0);
+    assert_non_null(node);
+#ifdef LY_ENABLED_CACHE
+    assert_non_null(((struct lys_node_leaf *)node)->type.info.str.length_chk);
+    assert_non_null(((struct lys_node_leaf *)node)->type.der->type.info.str.patterns_pcre);
+    assert_int_not_equal(node->hash[0], 0);
+#endif
+
+    /* the data still work the same */
+    data = lyd_parse_mem(ctx, "<c xmlns=\"urn:p\"><s>x</s><l>5</l><l>ab</l><i>3</i></c>", LYD_XML, LYD_OPT_CONFIG);
+    assert_non_null(data);
+    lyd_free_withsiblings(data);
+
+    data = lyd_parse_mem(ctx, "<c xmlns=\"urn:p\"><s>X</s></c>", LYD_XML, LYD_OPT_CONFIG);
+    assert_null(data);
+    data = lyd_parse_mem(ctx, "<c xmlns=\"urn:p\"><l>1</l><l>2</l><l>3</l></c>", LYD_XML, LYD_OPT_CONFIG);
+    assert_null(data);
+
+    assert_int_equal(ly_ctx_precompute(NULL), EXIT_FAILURE);
+}
+
 static void
 test_ly_ctx_get_submodule(void **state)
 {
@@ -1030,6 +1620,47 @@ test_ly_set_rm_index(void **state)
     ly_set_free(set);
 }
 
+static void
+test_ly_set_large(void **state)
+{
+    (void) state; /* unused */
+    struct ly_set *set, *src;
+    static int items[1000];
+    int i;
+
+    set = ly_set_new();
+    src = ly_set_new();
+    assert_non_null(set);
+    assert_non_null(src);
+
+    /* the set is indexed */
+    for (i = 0; i < 1000; ++i) {
+        assert_int_equal(ly_set_add(set, &items[i], 0), i);
+    }
+    assert_int_equal(ly_set_add(set, &items[500], 0), 500);
+    assert_int_equal(set->number, 1000);
+    assert_int_equal(ly_set_contains(set, &items[999]), 999);
+
+    /* the last item is moved to the removed index */
+    assert_int_equal(ly_set_rm(set, &items[10]), EXIT_SUCCESS);
+    assert_int_equal(ly_set_contains(set, &items[10]), -1);
+    assert_int_equal(ly_set_contains(set, &items[999]), 10);
+
+    /* duplicates of a list */
+    assert_int_equal(ly_set_add(set, &items[20], LY_SET_OPT_USEASLIST), 999);
+    assert_int_equal(ly_set_rm_index(set, 20), EXIT_SUCCESS);
+    assert_int_equal(ly_set_contains(set, &items[20]), 20);
+
+    /* only the new items are merged */
+    assert_int_equal(ly_set_add(src, &items[10], 0), 0);
+    assert_int_equal(ly_set_add(src, &items[30], 0), 1);
+    assert_int_equal(ly_set_merge(set, src, 0), 1);
+    assert_int_equal(set->number, 1000);
+    assert_int_equal(ly_set_contains(set, &items[10]), 999);
+
+    ly_set_free(set);
+}
+
 static void
 test_ly_set_free(void **state)
 {
@@ -1089,6 +1720,366 @@ test_ly_set_log_clb(void **state)
     assert_ptr_not_equal(clb, clb_new);
 }
 
+#ifdef LY_ENABLED_TRACE
+
+static int trace_depth[LY_TRACE_PRINT + 1];
+static int trace_count[LY_TRACE_PRINT + 1];
+static uint64_t trace_last;
+
+static void
+trace_clb(LY_TRACE_PHASE phase, int end, uint64_t timestamp, const struct ly_ctx *trace_ctx)
+{
+    assert_ptr_equal(trace_ctx, ctx);
+    assert_true(timestamp >= trace_last);
+    trace_last = timestamp;
+
+    if (end) {
+        assert_int_not_equal(trace_depth[phase], 0);
+        --trace_depth[phase];
+        ++trace_count[phase];
+    } else {
+        ++trace_depth[phase];
+    }
+}
+
+static void
+test_ly_set_trace_clb(void **state)
+{
+    (void) state; /* unused */
+    struct lyd_node *data;
+    char *str;
+    int i;
+
+    assert_int_equal(ly_set_trace_clb(trace_clb), 0);
+
+    assert_int_equal(lyd_validate(&root, LYD_OPT_CONFIG, NULL), 0);
+    assert_int_equal(lyd_print_mem(&str, root, LYD_XML, LYP_WITHSIBLINGS), 0);
+    data = lyd_parse_mem(ctx, str, LYD_XML, LYD_OPT_CONFIG);
+    assert_non_null(data);
+    free(str);
+
+    assert_int_equal(ly_set_trace_clb(NULL), 0);
+    lyd_free_withsiblings(data);
+
+    for (i = 0; i <= LY_TRACE_PRINT; ++i) {
+        assert_int_equal(trace_depth[i], 0);
+    }
+    assert_int_equal(trace_count[LY_TRACE_VALIDATE], 1);
+    assert_int_equal(trace_count[LY_TRACE_PRINT], 1);
+    assert_int_equal(trace_count[LY_TRACE_PARSE], 1);
+
+    /* not called anymore */
+    assert_int_equal(lyd_validate(&root, LYD_OPT_CONFIG, NULL), 0);
+    assert_int_equal(trace_count[LY_TRACE_VALIDATE], 1);
+}
+
+static int profile_count[LY_PROFILE_LEAFREF + 1];
+static uint64_t profile_visits;
+
+static void
+profile_clb(LY_PROFILE_KIND kind, const struct lys_node *snode, const char *expr, uint64_t ns, uint64_t visits,
+            const struct ly_ctx *profile_ctx)
+{
+    (void)ns;
+    (void)profile_ctx;
+
+    assert_non_null(snode);
+    assert_non_null(expr);
+    switch (kind) {
+    case LY_PROFILE_WHEN:
+        assert_string_equal(snode->name, "b");
+        break;
+    case LY_PROFILE_MUST:
+        assert_string_equal(snode->name, "a");
+        break;
+    case LY_PROFILE_LEAFREF:
+        assert_string_equal(snode->name, "ref");
+        break;
+    }
+    ++profile_count[kind];
+    profile_visits += visits;
+}
+
+static void
+test_ly_set_profile_clb(void **state)
+{
+    (void) state; /* unused */
+    struct ly_ctx *prof_ctx;
+    struct lyd_node *data;
+    const char *yang = "module prof {namespace urn:prof; prefix p;"
+        "container c {leaf a {type string; must \". != ../ref\";}"
+        "leaf b {when \"../a = 'x'\"; type string;}"
+        "leaf-list l {type string;}"
+        "leaf ref {type leafref {path ../l;}}}}";
+    const char *xml = "<c xmlns=\"urn:prof\"><a>x</a><b>y</b><l>1</l><l>2</l><ref>2</ref></c>";
+
+    prof_ctx = ly_ctx_new(NULL, 0);
+    assert_non_null(prof_ctx);
+    assert_non_null(lys_parse_mem(prof_ctx, yang, LYS_IN_YANG));
+
+    assert_int_equal(ly_set_profile_clb(profile_clb), 0);
+    data = lyd_parse_mem(prof_ctx, xml, LYD_XML, LYD_OPT_CONFIG);
+    assert_non_null(data);
+    assert_int_equal(ly_set_profile_clb(NULL), 0);
+
+    assert_int_equal(profile_count[LY_PROFILE_WHEN], 1);
+    assert_int_equal(profile_count[LY_PROFILE_MUST], 1);
+    assert_int_equal(profile_count[LY_PROFILE_LEAFREF], 1);
+    assert_true(profile_visits > 0);
+
+    /* not called anymore */
+    assert_int_equal(lyd_validate(&data, LYD_OPT_CONFIG, NULL), 0);
+    assert_int_equal(profile_count[LY_PROFILE_MUST], 1);
+
+    lyd_free_withsiblings(data);
+    ly_ctx_destroy(prof_ctx, NULL);
+}
+
+#else
+
+static void
+test_ly_set_trace_clb(void **state)
+{
+    (void) state; /* unused */
+
+    assert_int_not_equal(ly_set_trace_clb(NULL), 0);
+}
+
+static void
+test_ly_set_profile_clb(void **state)
+{
+    (void) state; /* unused */
+
+    assert_int_not_equal(ly_set_profile_clb(NULL), 0);
+}
+
+#endif
+
+static void
+test_ly_ctx_get_counters(void **state)
+{
+    (void) state; /* unused */
+    struct ly_ctx_counters cnt, prev;
+    struct lyd_node *data;
+    char *str;
+
+    assert_int_not_equal(ly_ctx_get_counters(NULL, &cnt), 0);
+    assert_int_not_equal(ly_ctx_get_counters(ctx, NULL), 0);
+
+    assert_int_equal(ly_ctx_get_counters(ctx, &prev), 0);
+
+    assert_int_equal(lyd_print_mem(&str, root, LYD_XML, LYP_WITHSIBLINGS), 0);
+    assert_int_equal(ly_ctx_get_counters(ctx, &cnt), 0);
+    assert_true(cnt.nodes_printed > prev.nodes_printed);
+    assert_int_equal(cnt.nodes_parsed, prev.nodes_parsed);
+    prev = cnt;
+
+    data = lyd_parse_mem(ctx, str, LYD_XML, LYD_OPT_CONFIG);
+    assert_non_null(data);
+    free(str);
+    assert_int_equal(ly_ctx_get_counters(ctx, &cnt), 0);
+    assert_true(cnt.nodes_parsed > prev.nodes_parsed);
+    assert_true(cnt.dict_inserts > prev.dict_inserts);
+    assert_true(cnt.dict_hits <= cnt.dict_inserts);
+    assert_true(cnt.phase_ns[LY_TRACE_PARSE] >= prev.phase_ns[LY_TRACE_PARSE]);
+    assert_int_equal(cnt.phase_ns[LY_TRACE_XPATH], 0);
+    assert_int_equal(cnt.nodes_printed, prev.nodes_printed);
+
+    lyd_free_withsiblings(data);
+}
+
+static void
+test_ly_ctx_mem_usage(void **state)
+{
+    (void) state; /* unused */
+    struct ly_ctx_mem_stats ctx_stats;
+    struct lys_mem_stats mod_stats;
+    struct lyd_mem_stats data_stats, dup_stats;
+    struct lyd_node *dup, *next, *iter;
+    uint32_t count = 0;
+
+    assert_int_not_equal(ly_ctx_mem_usage(NULL, &ctx_stats), 0);
+    assert_int_not_equal(ly_ctx_mem_usage(ctx, NULL), 0);
+    assert_int_not_equal(lyd_mem_usage(NULL, 1, &data_stats), 0);
+    assert_int_not_equal(lys_mem_usage(NULL, &mod_stats), 0);
+
+    assert_int_equal(ly_ctx_mem_usage(ctx, &ctx_stats), 0);
+    assert_int_equal(ctx_stats.modules, ctx->models.used);
+    assert_true(ctx_stats.schema.nodes > 0);
+    assert_true(ctx_stats.schema.node_mem > 0);
+    assert_true(ctx_stats.dict_strings > 0);
+    assert_true(ctx_stats.dict_mem > ctx_stats.dict_strings);
+    assert_true(ctx_stats.index_mem > 0);
+#ifdef LY_ENABLED_DATA_POOL
+    assert_true(ctx_stats.data_pool_mem > ctx_stats.data_pool_free);
+#endif
+
+    /* a single module is a part of the whole context */
+    memset(&mod_stats, 0, sizeof mod_stats);
+    assert_int_equal(lys_mem_usage(module, &mod_stats), 0);
+    assert_true(mod_stats.nodes > 0);
+    assert_true(mod_stats.nodes < ctx_stats.schema.nodes);
+    assert_true(mod_stats.node_mem < ctx_stats.schema.node_mem);
+
+    memset(&data_stats, 0, sizeof data_stats);
+    assert_int_equal(lyd_mem_usage(root, 1, &data_stats), 0);
+    LY_TREE_DFS_BEGIN(root, next, iter) {
+        ++count;
+        LY_TREE_DFS_END(root, next, iter);
+    }
+    assert_true(data_stats.nodes >= count);
+    assert_true(data_stats.node_mem >= count * sizeof(struct lyd_node));
+    assert_true(data_stats.dict_mem > 0);
+
+    /* a duplicate takes the same memory and shares the strings */
+    dup = lyd_dup_withsiblings(root, LYD_DUP_OPT_RECURSIVE);
+    assert_non_null(dup);
+    memset(&dup_stats, 0, sizeof dup_stats);
+    assert_int_equal(lyd_mem_usage(dup, 1, &dup_stats), 0);
+    assert_int_equal(dup_stats.nodes, data_stats.nodes);
+    assert_int_equal(dup_stats.node_mem, data_stats.node_mem);
+    assert_true(dup_stats.dict_mem < data_stats.dict_mem);
+    lyd_free_withsiblings(dup);
+}
+
+static void *
+test_allocator_malloc(size_t size, void *user_data)
+{
+    ++*(uint32_t *)user_data;
+    return malloc(size);
+}
+
+static void *
+test_allocator_realloc(void *ptr, size_t size, void *user_data)
+{
+    ++*(uint32_t *)user_data;
+    return realloc(ptr, size);
+}
+
+static void
+test_allocator_free(void *ptr, void *user_data)
+{
+    (void)user_data;
+    free(ptr);
+}
+
+static void
+test_ly_set_allocator(void **state)
+{
+    (void) state; /* unused */
+    uint32_t count = 0, pool_count = 0;
+    struct ly_allocator allocator = {test_allocator_malloc, NULL, test_allocator_realloc, test_allocator_free, &count};
+    struct ly_allocator pool_allocator = {test_allocator_malloc, NULL, NULL, test_allocator_free, &pool_count};
+    struct lyd_node *data;
+
+    /* not while a context exists */
+    ctx = ly_ctx_new(TESTS_DIR"/api/files", 0);
+    assert_non_null(ctx);
+    assert_int_not_equal(ly_set_allocator(&allocator), 0);
+    ly_ctx_destroy(ctx, NULL);
+    ctx = NULL;
+
+    allocator.free_clb = NULL;
+    assert_int_not_equal(ly_set_allocator(&allocator), 0);
+    allocator.free_clb = test_allocator_free;
+    assert_int_equal(ly_set_allocator(&allocator), 0);
+
+    ctx = ly_ctx_new(TESTS_DIR"/api/files", 0);
+    assert_non_null(ctx);
+    assert_true(count > 0);
+    assert_int_not_equal(ly_ctx_set_allocator(NULL, &pool_allocator), 0);
+#ifdef LY_ENABLED_DATA_POOL
+    assert_int_equal(ly_ctx_set_allocator(ctx, &pool_allocator), 0);
+#else
+    assert_int_not_equal(ly_ctx_set_allocator(ctx, &pool_allocator), 0);
+#endif
+    assert_non_null(lys_parse_path(ctx, TESTS_DIR"/api/files/a.yin", LYS_IN_YIN));
+
+    data = lyd_parse_path(ctx, TESTS_DIR"/api/files/a.xml", LYD_XML, LYD_OPT_CONFIG | LYD_OPT_STRICT);
+    assert_non_null(data);
+#ifdef LY_ENABLED_DATA_POOL
+    /* the data pool cannot change anymore */
+    assert_true(pool_count > 0);
+    assert_int_not_equal(ly_ctx_set_allocator(ctx, NULL), 0);
+#endif
+    lyd_free_withsiblings(data);
+
+    ly_ctx_destroy(ctx, NULL);
+    ctx = NULL;
+    assert_int_equal(ly_set_allocator(NULL), 0);
+}
+
+struct modules_reader {
+    struct ly_ctx *ctx;
+    atomic_int stop;
+    int failed;
+};
+
+static void *
+modules_reader_thread(void *arg)
+{
+    struct modules_reader *reader = (struct modules_reader *)arg;
+    const struct lys_module *mod;
+    uint32_t idx;
+    int count;
+
+    while (!atomic_load(&reader->stop)) {
+        if (!ly_ctx_get_module(reader->ctx, "ietf-yang-library", NULL, 1)
+                || !ly_ctx_get_module_by_ns(reader->ctx, "urn:ietf:params:xml:ns:yang:ietf-yang-types", NULL, 0)) {
+            reader->failed = 1;
+        }
+        idx = count = 0;
+        while ((mod = ly_ctx_get_module_iter(reader->ctx, &idx))) {
+            if (!mod->name) {
+                reader->failed = 1;
+            }
+            ++count;
+        }
+        if (count < (signed)ly_ctx_internal_modules_count(reader->ctx)) {
+            reader->failed = 1;
+        }
+    }
+
+    return NULL;
+}
+
+static void
+test_ly_ctx_load_module_concurrent(void **state)
+{
+    (void) state; /* unused */
+    struct modules_reader reader;
+    pthread_t thread;
+    char yang[128], name[16];
+    int i;
+
+    reader.ctx = ly_ctx_new(NULL, 0);
+    assert_non_null(reader.ctx);
+    atomic_init(&reader.stop, 0);
+    reader.failed = 0;
+    assert_int_equal(pthread_create(&thread, NULL, modules_reader_thread, &reader), 0);
+
+    /* the lists and indices are replaced many times while being read */
+    for (i = 0; i < 100; ++i) {
+        sprintf(yang, "module m%d {namespace urn:m%d; prefix m; leaf l {type string;}}", i, i);
+        assert_non_null(lys_parse_mem(reader.ctx, yang, LYS_IN_YANG));
+    }
+
+    atomic_store(&reader.stop, 1);
+    assert_int_equal(pthread_join(thread, NULL), 0);
+    assert_int_equal(reader.failed, 0);
+
+    for (i = 0; i < 100; ++i) {
+        sprintf(name, "m%d", i);
+        assert_non_null(ly_ctx_get_module(reader.ctx, name, NULL, 1));
+    }
+
+    /* nothing is reading now, all the replaced ones are freed */
+    assert_non_null(lys_parse_mem(reader.ctx, "module last {namespace urn:last; prefix l;}", LYS_IN_YANG));
+    assert_null(reader.ctx->models.retired);
+
+    ly_ctx_destroy(reader.ctx, NULL);
+}
+
 static void
 test_ly_log_options(void **state)
 {
@@ -1164,6 +2155,29 @@ test_ly_log_options(void **state)
     assert_int_equal(ly_errno, LY_SUCCESS);
     i = ly_err_first(ctx);
     assert_null(i);
+
+    /* bounded store */
+    ly_log_options(LY_LOSTORE);
+    assert_int_equal(ly_log_store_limit(2), 0);
+
+    assert_null(ly_path_data2schema(ctx, "/a:f/g/h"));
+    assert_null(ly_path_data2schema(ctx, "/fgh:f/g/h"));
+    assert_int_equal(ly_err_dropped(ctx), 0);
+    assert_null(ly_path_data2schema(ctx, "/a:f/g/h"));
+    assert_int_equal(ly_err_dropped(ctx), 1);
+
+    i = ly_err_first(ctx);
+    assert_non_null(i);
+    assert_string_equal(i->msg, "Module not found or not implemented.");
+    assert_non_null(i->next);
+    assert_string_equal(i->next->msg, "Schema node not found.");
+    assert_null(i->next->next);
+    assert_ptr_equal(i->prev, i->next);
+
+    assert_int_equal(ly_log_store_limit(0), 2);
+    ly_log_options(LY_LOLOG | LY_LOSTORE_LAST);
+    ly_err_clean(ctx, NULL);
+    assert_int_equal(ly_err_dropped(ctx), 0);
 }
 
 static void
@@ -1432,6 +2446,98 @@ test_ly_ctx_get_node(void **state)
     }
 }
 
+static void
+test_ly_ctx_get_node_children(void **state)
+{
+    (void) state; /* unused */
+    const struct lys_node *node;
+    struct lyd_node *data, *rpc;
+    const char *yang1 = "module n1 { namespace urn:n1; prefix n1;"
+        "grouping g { leaf gl { type string; } }"
+        "container c { choice ch { case a { uses g; } case b { leaf bl { type string; } } } }"
+        "rpc r { input { leaf v { type string; } } output { leaf v { type uint8; } } } }";
+    const char *yang2 = "module n2 { namespace urn:n2; prefix n2; import n1 { prefix n1; }"
+        "augment /n1:c { leaf gl { type int8; } } }";
+
+    ctx = ly_ctx_new(NULL, 0);
+    assert_non_null(ctx);
+    assert_non_null(lys_parse_mem(ctx, yang1, LYS_IN_YANG));
+
+    /* through the choice, case and uses */
+    node = ly_ctx_get_node(ctx, NULL, "/n1:c/gl", 0);
+    assert_non_null(node);
+    assert_string_equal(lys_node_module(node)->name, "n1");
+    assert_null(ly_ctx_get_node(ctx, NULL, "/n1:c/n2:gl", 0));
+
+    /* the index is built again with the new module */
+    assert_non_null(lys_parse_mem(ctx, yang2, LYS_IN_YANG));
+    node = ly_ctx_get_node(ctx, NULL, "/n1:c/n2:gl", 0);
+    assert_non_null(node);
+    assert_string_equal(lys_node_module(node)->name, "n2");
+    assert_ptr_not_equal(ly_ctx_get_node(ctx, NULL, "/n1:c/gl", 0), node);
+
+    /* the same names in input and output */
+    node = ly_ctx_get_node(ctx, NULL, "/n1:r/v", 0);
+    assert_non_null(node);
+    assert_int_equal(((struct lys_node_leaf *)node)->type.base, LY_TYPE_STRING);
+    node = ly_ctx_get_node(ctx, NULL, "/n1:r/v", 1);
+    assert_non_null(node);
+    assert_int_equal(((struct lys_node_leaf *)node)->type.base, LY_TYPE_UINT8);
+
+    /* the data parsers find the same nodes */
+    data = lyd_parse_mem(ctx, "<c xmlns=\"urn:n1\"><gl>a</gl><gl xmlns=\"urn:n2\">1</gl></c>", LYD_XML, LYD_OPT_CONFIG);
+    assert_non_null(data);
+    assert_non_null(data->child);
+    assert_non_null(data->child->next);
+    assert_string_equal(lyd_node_module(data->child)->name, "n1");
+    assert_string_equal(lyd_node_module(data->child->next)->name, "n2");
+    lyd_free_withsiblings(data);
+
+    rpc = lyd_parse_mem(ctx, "<r xmlns=\"urn:n1\"><v>a</v></r>", LYD_XML, LYD_OPT_RPC, NULL);
+    assert_non_null(rpc);
+    assert_int_equal(((struct lys_node_leaf *)rpc->child->schema)->type.base, LY_TYPE_STRING);
+    data = lyd_parse_mem(ctx, "<v xmlns=\"urn:n1\">5</v>", LYD_XML, LYD_OPT_RPCREPLY, rpc, NULL);
+    assert_non_null(data);
+    assert_int_equal(((struct lys_node_leaf *)data->child->schema)->type.base, LY_TYPE_UINT8);
+    lyd_free_withsiblings(data);
+    lyd_free_withsiblings(rpc);
+}
+
+static void
+test_ly_ctx_shared_patterns(void **state)
+{
+    (void) state; /* unused */
+    const struct lys_node_leaf *a, *b;
+    struct lyd_node *data;
+    const char *yang = "module s { namespace urn:s; prefix s;"
+        "grouping g { leaf l { type string { pattern '[a-z]+'; } } }"
+        "container a { uses g; }"
+        "container b { uses g { refine l { description x; } } } }";
+
+    ctx = ly_ctx_new(NULL, 0);
+    assert_non_null(ctx);
+    assert_non_null(lys_parse_mem(ctx, yang, LYS_IN_YANG));
+
+    a = (const struct lys_node_leaf *)ly_ctx_get_node(ctx, NULL, "/s:a/l", 0);
+    b = (const struct lys_node_leaf *)ly_ctx_get_node(ctx, NULL, "/s:b/l", 0);
+    assert_non_null(a);
+    assert_non_null(b);
+    assert_ptr_not_equal(a, b);
+#ifdef LY_ENABLED_CACHE
+    /* every copy of the grouping uses the same compiled pattern */
+    assert_non_null(a->type.info.str.patterns_pcre);
+    assert_non_null(b->type.info.str.patterns_pcre);
+    assert_ptr_equal(a->type.info.str.patterns_pcre[0], b->type.info.str.patterns_pcre[0]);
+    assert_ptr_not_equal(a->type.info.str.patterns_pcre, b->type.info.str.patterns_pcre);
+#endif
+
+    data = lyd_parse_mem(ctx, "<a xmlns=\"urn:s\"><l>ok</l></a><b xmlns=\"urn:s\"><l>fine</l></b>", LYD_XML, LYD_OPT_CONFIG);
+    assert_non_null(data);
+    lyd_free_withsiblings(data);
+    data = lyd_parse_mem(ctx, "<b xmlns=\"urn:s\"><l>Bad</l></b>", LYD_XML, LYD_OPT_CONFIG);
+    assert_null(data);
+}
+
 void
 test_ly_ctx_find_path(void **state)
 {
@@ -1653,18 +2759,29 @@ int main(void)
         cmocka_unit_test(test_ly_ctx_set_searchdir),
         cmocka_unit_test(test_ly_ctx_set_searchdir_invalid),
         cmocka_unit_test_setup_teardown(test_ly_ctx_info, setup_f, teardown_f),
+        cmocka_unit_test_teardown(test_ly_ctx_info_cached, teardown_f),
         cmocka_unit_test_setup_teardown(test_ly_ctx_new_ylmem, setup_f, teardown_f),
+        cmocka_unit_test_teardown(test_ly_ctx_clone, teardown_f),
         cmocka_unit_test_setup_teardown(test_ly_ctx_module_clb, setup_f, teardown_f),
+        cmocka_unit_test_teardown(test_ly_ctx_module_prefetch_clb, teardown_f),
         cmocka_unit_test_setup_teardown(test_ly_ctx_get_module, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_ly_ctx_get_module_older, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_ly_ctx_load_module, setup_f, teardown_f),
+        cmocka_unit_test_teardown(test_ly_ctx_load_modules, teardown_f),
+        cmocka_unit_test_teardown(test_ly_ctx_load_module_searchdir_change, teardown_f),
+        cmocka_unit_test_teardown(test_ly_ctx_load_module_searchdir_index, teardown_f),
         cmocka_unit_test_teardown(test_ly_ctx_remove_module, teardown_f),
         cmocka_unit_test_teardown(test_ly_ctx_remove_module2, teardown_f),
+        cmocka_unit_test_teardown(test_ly_ctx_remove_module_deps, teardown_f),
+        cmocka_unit_test_teardown(test_ly_ctx_remove_module_deviations, teardown_f),
         cmocka_unit_test_teardown(test_lys_set_enabled, teardown_f),
         cmocka_unit_test_teardown(test_lys_set_disabled, teardown_f),
+        cmocka_unit_test_teardown(test_lys_set_implemented_xpath, teardown_f),
         cmocka_unit_test(test_ly_ctx_clean),
         cmocka_unit_test(test_ly_ctx_clean2),
         cmocka_unit_test_setup_teardown(test_ly_ctx_get_module_by_ns, setup_f, teardown_f),
+        cmocka_unit_test_teardown(test_ly_ctx_get_module_many, teardown_f),
+        cmocka_unit_test_teardown(test_ly_ctx_precompute, teardown_f),
         cmocka_unit_test_setup_teardown(test_ly_ctx_get_submodule, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_ly_ctx_get_submodule2, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_lys_find_path, setup_f, teardown_f),
@@ -1672,10 +2789,17 @@ int main(void)
         cmocka_unit_test_setup_teardown(test_ly_set_add, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_ly_set_rm, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_ly_set_rm_index, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_ly_set_large, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_ly_set_free, setup_f, teardown_f),
         cmocka_unit_test(test_ly_verb),
         cmocka_unit_test(test_ly_get_log_clb),
         cmocka_unit_test(test_ly_set_log_clb),
+        cmocka_unit_test_setup_teardown(test_ly_set_trace_clb, setup_f, teardown_f),
+        cmocka_unit_test(test_ly_set_profile_clb),
+        cmocka_unit_test_setup_teardown(test_ly_ctx_get_counters, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_ly_ctx_mem_usage, setup_f, teardown_f),
+        cmocka_unit_test_teardown(test_ly_set_allocator, teardown_f),
+        cmocka_unit_test(test_ly_ctx_load_module_concurrent),
         cmocka_unit_test_setup_teardown(test_ly_log_options, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_ly_path_data2schema, setup_f, teardown_f),
         cmocka_unit_test(test_ly_get_loaded_plugins),
@@ -1685,6 +2809,8 @@ int main(void)
         cmocka_unit_test(test_ly_ctx_get_module_iter),
         cmocka_unit_test_setup_teardown(test_ly_ctx_set_trusted, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_ly_ctx_get_node, setup_f, teardown_f),
+        cmocka_unit_test_teardown(test_ly_ctx_get_node_children, teardown_f),
+        cmocka_unit_test_teardown(test_ly_ctx_shared_patterns, teardown_f),
         cmocka_unit_test_setup_teardown(test_ly_ctx_find_path, setup_f, teardown_f),
         cmocka_unit_test(test_ly_ctx_destroy),
         cmocka_unit_test_setup_teardown(test_ly_path_xml2json, setup_f, teardown_f),
@@ -0,0 +1,245 @@
+/**
+ * @file test_nacm.c
+ * @brief Cmocka tests for the NACM rules evaluation.
+ *
+ * Copyright (c) 2019 CESNET, z.s.p.o.
+ *
+ * This source code is licensed under BSD 3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://opensource.org/licenses/BSD-3-Clause
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "tests/config.h"
+#include "libyang.h"
+
+struct state {
+    struct ly_ctx *ctx;
+    const struct lys_module *mod;
+    struct lyd_node *nacm_data;
+    struct lyd_node *data;
+    struct lyd_node *edit;
+    struct lyd_nacm *nacm;
+};
+
+static const char *schema =
+    "module nt {"
+    "  namespace urn:nt;"
+    "  prefix nt;"
+    "  import ietf-netconf-acm { prefix nacm; }"
+    "  container c {"
+    "    leaf a { type string; }"
+    "    leaf secret { nacm:default-deny-all; type string; }"
+    "    list l { key k; leaf k { type string; } leaf v { type string; } }"
+    "  }"
+    "  rpc op;"
+    "  rpc other;"
+    "}";
+
+static const char *nacm_xml =
+    "<nacm xmlns=\"urn:ietf:params:xml:ns:yang:ietf-netconf-acm\">"
+      "<groups><group><name>g</name><user-name>alice</user-name></group></groups>"
+      "<rule-list><name>rl</name><group>g</group>"
+        "<rule><name>r1</name><module-name>nt</module-name>"
+          "<path xmlns:nt=\"urn:nt\">/nt:c/nt:l[nt:k='x']</path>"
+          "<access-operations>read</access-operations><action>deny</action></rule>"
+        "<rule><name>r2</name><module-name>nt</module-name><rpc-name>other</rpc-name><action>deny</action></rule>"
+        "<rule><name>r3</name><module-name>nt</module-name>"
+          "<path xmlns:nt=\"urn:nt\">/nt:c/nt:a</path>"
+          "<access-operations>update</access-operations><action>permit</action></rule>"
+      "</rule-list>"
+    "</nacm>";
+
+static const char *data_xml =
+    "<c xmlns=\"urn:nt\"><a>1</a><secret>s</secret>"
+      "<l><k>x</k><v>1</v></l><l><k>y</k><v>2</v></l>"
+    "</c>";
+
+static int
+setup_f(void **state)
+{
+    struct state *st;
+
+    (*state) = st = calloc(1, sizeof *st);
+    if (!st) {
+        fprintf(stderr, "Memory allocation error");
+        return -1;
+    }
+
+    /* libyang context */
+    st->ctx = ly_ctx_new(TESTS_DIR"/schema/yang/ietf", 0);
+    if (!st->ctx) {
+        fprintf(stderr, "Failed to create context.\n");
+        goto error;
+    }
+
+    /* schemas */
+    if (!ly_ctx_load_module(st->ctx, "ietf-netconf-acm", NULL)) {
+        fprintf(stderr, "Failed to load ietf-netconf-acm.\n");
+        goto error;
+    }
+    st->mod = lys_parse_mem(st->ctx, schema, LYS_IN_YANG);
+    if (!st->mod) {
+        fprintf(stderr, "Failed to load data model.\n");
+        goto error;
+    }
+
+    st->nacm_data = lyd_parse_mem(st->ctx, nacm_xml, LYD_XML, LYD_OPT_CONFIG | LYD_OPT_STRICT);
+    st->data = lyd_parse_mem(st->ctx, data_xml, LYD_XML, LYD_OPT_CONFIG | LYD_OPT_STRICT);
+    if (!st->nacm_data || !st->data) {
+        fprintf(stderr, "Failed to parse data.\n");
+        goto error;
+    }
+
+    return 0;
+
+error:
+    lyd_free_withsiblings(st->nacm_data);
+    lyd_free_withsiblings(st->data);
+    ly_ctx_destroy(st->ctx, NULL);
+    free(st);
+    (*state) = NULL;
+
+    return -1;
+}
+
+static int
+teardown_f(void **state)
+{
+    struct state *st = (*state);
+
+    lyd_nacm_free(st->nacm);
+    lyd_free_withsiblings(st->nacm_data);
+    lyd_free_withsiblings(st->data);
+    lyd_free_withsiblings(st->edit);
+    ly_ctx_destroy(st->ctx, NULL);
+    free(st);
+    (*state) = NULL;
+
+    return 0;
+}
+
+static void
+test_filter(void **state)
+{
+    struct state *st = (*state);
+    struct ly_set *set;
+
+    st->nacm = lyd_nacm_new(st->nacm_data, "alice", NULL);
+    assert_ptr_not_equal(st->nacm, NULL);
+
+    set = lyd_find_path(st->data, "/nt:c/secret");
+    assert_ptr_not_equal(set, NULL);
+    assert_int_equal(set->number, 1);
+    assert_int_equal(lyd_nacm_allowed(st->nacm, set->set.d[0], LYD_NACM_READ), 0);
+    ly_set_free(set);
+
+    assert_int_equal(lyd_nacm_filter(st->nacm, &st->data), 0);
+    assert_ptr_not_equal(st->data, NULL);
+
+    /* default-deny-all */
+    set = lyd_find_path(st->data, "/nt:c/secret");
+    assert_ptr_not_equal(set, NULL);
+    assert_int_equal(set->number, 0);
+    ly_set_free(set);
+
+    /* the rule with a predicate */
+    set = lyd_find_path(st->data, "/nt:c/l");
+    assert_ptr_not_equal(set, NULL);
+    assert_int_equal(set->number, 1);
+    assert_string_equal(((struct lyd_node_leaf_list *)set->set.d[0]->child)->value_str, "y");
+    ly_set_free(set);
+
+    set = lyd_find_path(st->data, "/nt:c/a");
+    assert_ptr_not_equal(set, NULL);
+    assert_int_equal(set->number, 1);
+    ly_set_free(set);
+}
+
+static void
+test_filter_nogroup(void **state)
+{
+    struct state *st = (*state);
+    struct ly_set *set;
+
+    /* the rule-list does not apply */
+    st->nacm = lyd_nacm_new(st->nacm_data, "bob", NULL);
+    assert_ptr_not_equal(st->nacm, NULL);
+
+    assert_int_equal(lyd_nacm_filter(st->nacm, &st->data), 0);
+
+    set = lyd_find_path(st->data, "/nt:c/l");
+    assert_ptr_not_equal(set, NULL);
+    assert_int_equal(set->number, 2);
+    ly_set_free(set);
+
+    set = lyd_find_path(st->data, "/nt:c/secret");
+    assert_ptr_not_equal(set, NULL);
+    assert_int_equal(set->number, 0);
+    ly_set_free(set);
+}
+
+static void
+test_edit(void **state)
+{
+    struct state *st = (*state);
+    const struct lyd_node *denied;
+
+    st->nacm = lyd_nacm_new(st->nacm_data, "alice", NULL);
+    assert_ptr_not_equal(st->nacm, NULL);
+
+    /* update permitted by a rule */
+    st->edit = lyd_parse_mem(st->ctx, "<c xmlns=\"urn:nt\"><a>2</a></c>", LYD_XML, LYD_OPT_EDIT);
+    assert_ptr_not_equal(st->edit, NULL);
+    assert_int_equal(lyd_nacm_check(st->nacm, st->edit, st->data, 0, &denied), 0);
+    assert_ptr_equal(denied, NULL);
+
+    /* without the data, it would be created, denied by write-default */
+    assert_int_equal(lyd_nacm_check(st->nacm, st->edit, NULL, 0, &denied), 1);
+    assert_ptr_equal(denied, st->edit);
+    lyd_free_withsiblings(st->edit);
+
+    /* create denied by write-default */
+    st->edit = lyd_parse_mem(st->ctx, "<c xmlns=\"urn:nt\"><l><k>z</k></l></c>", LYD_XML, LYD_OPT_EDIT);
+    assert_ptr_not_equal(st->edit, NULL);
+    assert_int_equal(lyd_nacm_check(st->nacm, st->edit, st->data, 0, &denied), 1);
+    assert_ptr_equal(denied, st->edit->child);
+}
+
+static void
+test_rpc(void **state)
+{
+    struct state *st = (*state);
+    const struct lyd_node *denied;
+
+    st->nacm = lyd_nacm_new(st->nacm_data, "alice", NULL);
+    assert_ptr_not_equal(st->nacm, NULL);
+
+    st->edit = lyd_new(NULL, st->mod, "op");
+    assert_ptr_not_equal(st->edit, NULL);
+    assert_int_equal(lyd_nacm_check(st->nacm, st->edit, NULL, 0, &denied), 0);
+    lyd_free(st->edit);
+
+    st->edit = lyd_new(NULL, st->mod, "other");
+    assert_ptr_not_equal(st->edit, NULL);
+    assert_int_equal(lyd_nacm_check(st->nacm, st->edit, NULL, 0, &denied), 1);
+    assert_ptr_equal(denied, st->edit);
+}
+
+int main(void)
+{
+    const struct CMUnitTest tests[] = {
+                    cmocka_unit_test_setup_teardown(test_filter, setup_f, teardown_f),
+                    cmocka_unit_test_setup_teardown(test_filter_nogroup, setup_f, teardown_f),
+                    cmocka_unit_test_setup_teardown(test_edit, setup_f, teardown_f),
+                    cmocka_unit_test_setup_teardown(test_rpc, setup_f, teardown_f), };
+
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
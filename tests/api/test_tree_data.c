@@ -26,11 +26,13 @@
 #include <sys/mman.h>
 #include <unistd.h>
 #include <string.h>
+#include <pthread.h>
 
 #include "tests/config.h"
 #include "libyang.h"
 #include "../../src/tree_data.h"
 #include "../../src/tree_schema.h"
+#include "../../src/hash_table.h"
 
 #define TMP_TEMPLATE "/tmp/libyang-XXXXXX"
 
@@ -489,6 +491,148 @@ error:
     fail();
 }
 
+static void
+test_lyd_chunk_parser(void **state)
+{
+    (void) state; /* unused */
+    const char *xml = "<?xml version=\"1.0\"?>\n<!-- a <x> -->\n"
+                      "<x xmlns=\"urn:a\"><bubba><![CDATA[<te>st]]></bubba><number32>5</number32></x>\n"
+                      "<any xmlns=\"urn:a\"><elem attr=\"a>b/\">t</elem><empty/></any>\n<?pi <y>?>"
+                      "<y xmlns=\"urn:a\">val</y>\n";
+    const char *json = "{\"a:x\":{\"bubba\":\"<te>st\",\"number32\":5},\"a:y\":\"val\"}";
+    struct ly_ctx *ctx;
+    struct lyd_chunk_parser *parser;
+    struct lyd_node *node, *ref;
+    char *str1, *str2;
+    size_t i, step, len;
+
+    ctx = ly_ctx_new(TESTS_DIR"/api/files", 0);
+    assert_non_null(ctx);
+    assert_non_null(lys_parse_mem(ctx, lys_module_a, LYS_IN_YIN));
+
+    ref = lyd_parse_mem(ctx, xml, LYD_XML, LYD_OPT_CONFIG);
+    assert_non_null(ref);
+    lyd_print_mem(&str1, ref, LYD_XML, LYP_WITHSIBLINGS);
+    lyd_free_withsiblings(ref);
+
+    /* XML split at all the possible places */
+    len = strlen(xml);
+    for (step = 1; step < 8; ++step) {
+        parser = lyd_chunk_parser_new(ctx, LYD_XML, LYD_OPT_CONFIG);
+        assert_non_null(parser);
+        for (i = 0; i < len; i += step) {
+            assert_int_equal(lyd_chunk_parser_feed(parser, xml + i, (len - i < step) ? len - i : step), 0);
+        }
+        node = lyd_chunk_parser_finish(parser);
+        assert_non_null(node);
+        lyd_print_mem(&str2, node, LYD_XML, LYP_WITHSIBLINGS);
+        assert_string_equal(str1, str2);
+        free(str2);
+        lyd_free_withsiblings(node);
+    }
+    free(str1);
+
+    /* JSON is parsed at once */
+    ref = lyd_parse_mem(ctx, json, LYD_JSON, LYD_OPT_CONFIG);
+    assert_non_null(ref);
+    lyd_print_mem(&str1, ref, LYD_JSON, LYP_WITHSIBLINGS);
+    lyd_free_withsiblings(ref);
+
+    parser = lyd_chunk_parser_new(ctx, LYD_JSON, LYD_OPT_CONFIG);
+    assert_non_null(parser);
+    len = strlen(json);
+    for (i = 0; i < len; i += 3) {
+        assert_int_equal(lyd_chunk_parser_feed(parser, json + i, (len - i < 3) ? len - i : 3), 0);
+    }
+    node = lyd_chunk_parser_finish(parser);
+    assert_non_null(node);
+    lyd_print_mem(&str2, node, LYD_JSON, LYP_WITHSIBLINGS);
+    assert_string_equal(str1, str2);
+    free(str1);
+    free(str2);
+    lyd_free_withsiblings(node);
+
+    /* incomplete element */
+    parser = lyd_chunk_parser_new(ctx, LYD_XML, LYD_OPT_CONFIG);
+    assert_non_null(parser);
+    assert_int_equal(lyd_chunk_parser_feed(parser, "<y xmlns=\"urn:a\">val</y><x xmlns=\"urn:a\"><bubba>", 48), 0);
+    assert_null(lyd_chunk_parser_finish(parser));
+    assert_int_not_equal(ly_errno, LY_SUCCESS);
+
+    /* invalid element fails the feed */
+    parser = lyd_chunk_parser_new(ctx, LYD_XML, LYD_OPT_CONFIG);
+    assert_non_null(parser);
+    assert_int_not_equal(lyd_chunk_parser_feed(parser, "<y xmlns=\"urn:a\">val</z>", 24), 0);
+    assert_int_not_equal(lyd_chunk_parser_feed(parser, "<y/>", 4), 0);
+    lyd_chunk_parser_free(parser);
+
+    ly_ctx_destroy(ctx, NULL);
+}
+
+static void
+test_lyd_stream_parser(void **state)
+{
+    (void) state; /* unused */
+    const char *yang = "module n {namespace urn:n; prefix n; notification ev {leaf seq {type uint8;}}}";
+    const char *json = "{\"n:ev\":{\"seq\":1}}\n\n{\"n:ev\":{\"seq\":\"}{\"}}\n\x1e{\"n:ev\":{\"seq\":3}}\n";
+    const char *xml = "<ev xmlns=\"urn:n\"><seq>1</seq></ev>\n<ev xmlns=\"urn:n\"><seq>a</seq></ev>"
+                      "<ev xmlns=\"urn:n\"><seq>3</seq></ev>";
+    struct ly_ctx *ctx;
+    struct lyd_stream_parser *stream;
+    struct lyd_node *node;
+    int i, fds[2];
+
+    ctx = ly_ctx_new(NULL, 0);
+    assert_non_null(ctx);
+    assert_non_null(lys_parse_mem(ctx, yang, LYS_IN_YANG));
+
+    for (i = 0; i < 3; ++i) {
+        if (i < 2) {
+            stream = lyd_stream_parser_mem(ctx, i ? xml : json, i ? LYD_XML : LYD_JSON, LYD_OPT_NOTIF, NULL);
+        } else {
+            /* documents read from a pipe */
+            assert_int_equal(pipe(fds), 0);
+            assert_int_equal(write(fds[1], json, strlen(json)), strlen(json));
+            close(fds[1]);
+            stream = lyd_stream_parser_fd(ctx, fds[0], LYD_JSON, LYD_OPT_NOTIF, NULL);
+        }
+        assert_non_null(stream);
+
+        assert_int_equal(lyd_stream_parser_next(stream, &node), 1);
+        assert_non_null(node);
+        assert_string_equal(((struct lyd_node_leaf_list *)node->child)->value_str, "1");
+        lyd_free_withsiblings(node);
+
+        /* an invalid document is skipped */
+        assert_int_equal(lyd_stream_parser_next(stream, &node), -1);
+        assert_null(node);
+        assert_int_not_equal(ly_errno, LY_SUCCESS);
+
+        assert_int_equal(lyd_stream_parser_next(stream, &node), 1);
+        assert_non_null(node);
+        assert_string_equal(((struct lyd_node_leaf_list *)node->child)->value_str, "3");
+        lyd_free_withsiblings(node);
+
+        assert_int_equal(lyd_stream_parser_next(stream, &node), 0);
+        assert_int_equal(lyd_stream_parser_next(stream, &node), 0);
+        lyd_stream_parser_free(stream);
+        if (i == 2) {
+            close(fds[0]);
+        }
+    }
+
+    /* incomplete document */
+    stream = lyd_stream_parser_mem(ctx, "{\"n:ev\":{\"seq\":1}}{\"n:ev\":", LYD_JSON, LYD_OPT_NOTIF, NULL);
+    assert_non_null(stream);
+    assert_int_equal(lyd_stream_parser_next(stream, &node), 1);
+    lyd_free_withsiblings(node);
+    assert_int_equal(lyd_stream_parser_next(stream, &node), -1);
+    assert_int_equal(lyd_stream_parser_next(stream, &node), 0);
+    lyd_stream_parser_free(stream);
+
+    ly_ctx_destroy(ctx, NULL);
+}
+
 static void
 test_lyd_new(void **state)
 {
@@ -731,6 +875,69 @@ test_lyd_new_path(void **state)
     lyd_free_withsiblings(root);
 }
 
+static void
+test_lyd_new_path_cursor(void **state)
+{
+    (void) state; /* unused */
+    const char *yang = "module cur {namespace urn:cur; prefix c;"
+                       "container c {list l {key k; leaf k {type string;} leaf v {type uint32;}} leaf t {type string;}}}";
+    struct ly_ctx *ctx;
+    struct lyd_node *data, *node;
+    struct lyd_path_cursor cursor;
+    const struct lys_module *mod;
+    char path[64], *str1, *str2;
+    uint32_t i;
+
+    ctx = ly_ctx_new(NULL, 0);
+    assert_non_null(ctx);
+    mod = lys_parse_mem(ctx, yang, LYS_IN_YANG);
+    assert_non_null(mod);
+    memset(&cursor, 0, sizeof cursor);
+
+    /* the whole path is created, the container is remembered */
+    data = lyd_new_path_cursor(&cursor, NULL, ctx, "/cur:c/l[k='a/b']/v", "0", 0, 0);
+    assert_non_null(data);
+    assert_string_equal(data->schema->name, "c");
+    assert_ptr_equal(cursor.parent, data->child);
+    assert_string_equal(cursor.prefix, "/cur:c/l[k='a/b']");
+
+    for (i = 0; i < 100; ++i) {
+        sprintf(path, "/cur:c/l[k='%u']", i);
+        node = lyd_new_path_cursor(&cursor, data, NULL, path, NULL, 0, 0);
+        assert_non_null(node);
+        assert_ptr_equal(node->parent, data);
+        assert_ptr_equal(cursor.parent, data);
+        sprintf(path, "/cur:c/l[k='%u']/v", i);
+        assert_non_null(lyd_new_path_cursor(&cursor, data, NULL, path, "1", 0, 0));
+    }
+    /* existing nodes are still detected */
+    assert_null(lyd_new_path_cursor(&cursor, data, NULL, "/cur:c/l[k='99']/v", "1", 0, 0));
+    assert_int_equal(ly_vecode(ctx), LYVE_PATH_EXISTS);
+    node = lyd_new_path_cursor(&cursor, data, NULL, "/cur:c/l[k='99']/v", "2", 0, LYD_PATH_OPT_UPDATE);
+    assert_non_null(node);
+    assert_string_equal(((struct lyd_node_leaf_list *)node)->value_str, "2");
+    lyd_path_cursor_clear(&cursor);
+    assert_null(cursor.parent);
+    assert_null(cursor.prefix);
+
+    /* the same tree with lyd_new_path() */
+    assert_int_equal(lyd_print_mem(&str1, data, LYD_XML, LYP_WITHSIBLINGS), 0);
+    lyd_free(data);
+    data = lyd_new_path(NULL, ctx, "/cur:c/l[k='a/b']/v", "0", 0, 0);
+    assert_non_null(data);
+    for (i = 0; i < 100; ++i) {
+        sprintf(path, "/cur:c/l[k='%u']/v", i);
+        assert_non_null(lyd_new_path(data, NULL, path, (i == 99) ? "2" : "1", 0, 0));
+    }
+    assert_int_equal(lyd_print_mem(&str2, data, LYD_XML, LYP_WITHSIBLINGS), 0);
+    assert_string_equal(str1, str2);
+    free(str1);
+    free(str2);
+
+    lyd_free(data);
+    ly_ctx_destroy(ctx, NULL);
+}
+
 static void
 test_lyd_dup(void **state)
 {
@@ -807,6 +1014,119 @@ test_lyd_insert_sibling(void **state)
     assert_string_equal(((struct lyd_node_leaf_list *)root->prev)->value_str, "test");
 }
 
+static void
+test_lyd_reserve_children(void **state)
+{
+    (void) state; /* unused */
+    struct lyd_node *new, *dup, *iter;
+    uint32_t size, count = 0;
+
+    LY_TREE_FOR(root->child, iter) {
+        ++count;
+    }
+
+    assert_int_equal(lyd_reserve_children(root->child, 10), EXIT_FAILURE);
+    assert_int_equal(lyd_reserve_children(root, 64), EXIT_SUCCESS);
+
+#ifdef LY_ENABLED_CACHE
+    /* the hash table is created with the current children and is not resized anymore */
+    assert_ptr_not_equal(root->ht, NULL);
+    assert_int_equal(root->ht->used, count);
+    size = root->ht->size;
+    assert_true(size * LYHT_ENLARGE_PERCENTAGE > 64 * 100);
+
+    new = lyd_new_leaf(root, root->schema->module, "number32", "1");
+    assert_ptr_not_equal(new, NULL);
+    new = lyd_new_leaf(root, root->schema->module, "number64", "1");
+    assert_ptr_not_equal(new, NULL);
+    assert_int_equal(root->ht->used, count + 2);
+    assert_int_equal(root->ht->size, size);
+
+    /* duplicate has the hash table sized for the original children */
+    dup = lyd_dup(root, LYD_DUP_OPT_RECURSIVE);
+    assert_ptr_not_equal(dup, NULL);
+    assert_ptr_not_equal(dup->ht, NULL);
+    assert_int_equal(dup->ht->used, count + 2);
+    assert_true(dup->ht->size * LYHT_ENLARGE_PERCENTAGE > (count + 2) * 100);
+    lyd_free(dup);
+#else
+    (void)new;
+    (void)dup;
+    (void)size;
+#endif
+}
+
+static void
+test_lyd_insert_batch(void **state)
+{
+    (void) state; /* unused */
+    const char *yang = "module bat {yang-version 1.1; namespace urn:bat; prefix b;"
+                       "container c {list l {key k; leaf k {type uint32;}} leaf-list ll {type string; default d;} leaf t {type string;}}}";
+    struct ly_ctx *ctx;
+    struct lyd_node *cont, *node, *iter;
+    const struct lys_module *mod;
+    char buf[16];
+    uint32_t i;
+
+    ctx = ly_ctx_new(NULL, 0);
+    assert_non_null(ctx);
+    mod = lys_parse_mem(ctx, yang, LYS_IN_YANG);
+    assert_non_null(mod);
+    cont = lyd_new(NULL, mod, "c");
+    assert_non_null(cont);
+    assert_int_equal(lyd_validate(&cont, LYD_OPT_CONFIG, NULL), 0);
+    assert_string_equal(cont->child->schema->name, "ll");
+    assert_int_equal(cont->child->dflt, 1);
+
+    assert_int_equal(lyd_insert_batch_start(cont), EXIT_SUCCESS);
+    assert_int_equal(lyd_insert_batch_start(cont), EXIT_FAILURE);
+    for (i = 0; i < 1000; ++i) {
+        sprintf(buf, "%u", i);
+        node = lyd_new(cont, NULL, "l");
+        assert_non_null(node);
+        assert_non_null(lyd_new_leaf(node, NULL, "k", buf));
+        assert_non_null(lyd_new_leaf(cont, NULL, "ll", buf));
+    }
+    /* nothing inserted yet */
+    assert_int_equal(cont->child->dflt, 1);
+    assert_null(cont->child->next);
+
+    /* an existing node is inserted after the pending ones */
+    iter = lyd_new(NULL, mod, "c");
+    assert_non_null(iter);
+    node = lyd_new_leaf(iter, NULL, "t", "x");
+    assert_non_null(node);
+    assert_int_equal(lyd_insert(cont, node), 0);
+    lyd_free(iter);
+    assert_int_equal(lyd_insert_batch_commit(cont), EXIT_SUCCESS);
+    assert_int_equal(lyd_insert_batch_commit(cont), EXIT_FAILURE);
+
+    /* the default leaf-list instance was replaced, the order kept */
+    i = 0;
+    LY_TREE_FOR(cont->child, iter) {
+        if (i < 2000) {
+            assert_string_equal(iter->schema->name, (i % 2) ? "ll" : "l");
+            assert_int_equal(iter->dflt, 0);
+        } else {
+            assert_ptr_equal(iter, node);
+        }
+        ++i;
+    }
+    assert_int_equal(i, 2001);
+#ifdef LY_ENABLED_CACHE
+    assert_non_null(cont->ht);
+    assert_int_equal(cont->ht->used, 2001);
+#endif
+    assert_int_equal(lyd_validate(&cont, LYD_OPT_CONFIG, NULL), 0);
+
+    /* commit without any pending node */
+    assert_int_equal(lyd_insert_batch_start(cont), EXIT_SUCCESS);
+    assert_int_equal(lyd_insert_batch_commit(cont), EXIT_SUCCESS);
+
+    lyd_free(cont);
+    ly_ctx_destroy(ctx, NULL);
+}
+
 static void
 test_lyd_insert_before(void **state)
 {
@@ -938,11 +1258,21 @@ test_lyd_schema_sort(void **state)
     node2 = lyd_new_leaf(node, NULL, "number32", "32");
     assert_non_null(node2);
 
+    /* another list instance after the container */
+    node2 = lyd_new(NULL, module, "l");
+    assert_non_null(node2);
+    assert_non_null(lyd_new_leaf(node2, NULL, "key1", "3"));
+    assert_non_null(lyd_new_leaf(node2, NULL, "key2", "4"));
+    assert_int_equal(lyd_insert_after(node, node2), 0);
+
     assert_int_equal(lyd_schema_sort(root, 1), 0);
 
     root = node;
     assert_string_equal(root->schema->name, "x");
     assert_string_equal(root->next->schema->name, "l");
+    assert_string_equal(((struct lyd_node_leaf_list *)root->next->child)->value_str, "1");
+    assert_ptr_equal(root->next->next, node2);
+    assert_ptr_equal(root->prev, node2);
 
     assert_string_equal(root->child->schema->name, "bar-gggg");
     assert_string_equal(root->child->next->schema->name, "bubba");
@@ -974,6 +1304,568 @@ test_lyd_schema_sort(void **state)
     lyd_free_withsiblings(root);
 }
 
+static void
+test_lyd_insert_ordered(void **state)
+{
+    (void) state; /* unused */
+    const char *yang = "module ord {namespace urn:ord; prefix o;"
+                       "container c {leaf a {type string;} list l {key k; leaf k {type uint8;}}"
+                       "choice ch {leaf b {type string;}} leaf-list z {type string;}} leaf t {type string;}}";
+    const char *xml = "<c xmlns=\"urn:ord\"><z>1</z><l><k>2</k></l><b>b</b><a>a</a><l><k>1</k></l><z>0</z></c>"
+                      "<t xmlns=\"urn:ord\">t</t>";
+    struct ly_ctx *ctx;
+    struct lyd_node *data, *node;
+    const struct lys_module *mod;
+    char *str;
+
+    ctx = ly_ctx_new(NULL, LY_CTX_ORDERED_DATA);
+    assert_non_null(ctx);
+    mod = lys_parse_mem(ctx, yang, LYS_IN_YANG);
+    assert_non_null(mod);
+
+    /* created in the reverse order */
+    node = lyd_new_leaf(NULL, mod, "t", "t");
+    assert_non_null(node);
+    data = lyd_new(NULL, mod, "c");
+    assert_non_null(data);
+    assert_int_equal(lyd_insert_sibling(&node, data), 0);
+    assert_ptr_equal(node, data);
+    assert_non_null(lyd_new_leaf(data, NULL, "z", "1"));
+    assert_non_null(lyd_new_path(data, NULL, "l[k='2']", NULL, 0, 0));
+    assert_non_null(lyd_new_leaf(data, NULL, "b", "b"));
+    assert_non_null(lyd_new_leaf(data, NULL, "a", "a"));
+    assert_non_null(lyd_new_path(data, NULL, "l[k='1']", NULL, 0, 0));
+    assert_non_null(lyd_new_leaf(data, NULL, "z", "0"));
+
+    assert_int_equal(lyd_print_mem(&str, data, LYD_XML, LYP_WITHSIBLINGS), 0);
+    assert_string_equal(str, "<c xmlns=\"urn:ord\"><a>a</a><l><k>2</k></l><l><k>1</k></l><b>b</b><z>1</z><z>0</z></c>"
+                        "<t xmlns=\"urn:ord\">t</t>");
+    free(str);
+    lyd_free_withsiblings(data);
+
+    /* parsed data are sorted the same way */
+    data = lyd_parse_mem(ctx, xml, LYD_XML, LYD_OPT_CONFIG);
+    assert_non_null(data);
+    assert_int_equal(lyd_print_mem(&str, data, LYD_XML, LYP_WITHSIBLINGS), 0);
+    assert_string_equal(str, "<c xmlns=\"urn:ord\"><a>a</a><l><k>2</k></l><l><k>1</k></l><b>b</b><z>1</z><z>0</z></c>"
+                        "<t xmlns=\"urn:ord\">t</t>");
+    free(str);
+    lyd_free_withsiblings(data);
+
+    /* without the option, nodes are appended */
+    ly_ctx_unset_ordered_data(ctx);
+    data = lyd_parse_mem(ctx, xml, LYD_XML, LYD_OPT_CONFIG);
+    assert_non_null(data);
+    assert_string_equal(data->child->schema->name, "z");
+    lyd_free_withsiblings(data);
+
+    ly_ctx_destroy(ctx, NULL);
+}
+
+static void
+test_lyd_freeze(void **state)
+{
+    (void) state; /* unused */
+    const char *yang = "module frz {namespace urn:frz; prefix f;"
+                       "container c {anydata any;} leaf t {type string;}}";
+    struct ly_ctx *ctx;
+    struct lyd_node *data, *node;
+    struct lyd_node_anydata *any;
+    const struct lys_module *mod;
+    char *mem, *str1, *str2;
+
+    ctx = ly_ctx_new(NULL, 0);
+    assert_non_null(ctx);
+    mod = lys_parse_mem(ctx, yang, LYS_IN_YANG);
+    assert_non_null(mod);
+
+    node = lyd_new_leaf(NULL, mod, "t", "val");
+    assert_non_null(node);
+    assert_int_equal(lyd_print_mem(&mem, node, LYD_LYB, LYP_WITHSIBLINGS), 0);
+    lyd_free(node);
+
+    data = lyd_new(NULL, mod, "c");
+    assert_non_null(data);
+    any = (struct lyd_node_anydata *)lyd_new_anydata(data, NULL, "any", mem, LYD_ANYDATA_LYBD);
+    assert_non_null(any);
+
+    /* printing does not change the value */
+    assert_int_equal(lyd_print_mem(&str1, data, LYD_XML, 0), 0);
+    assert_int_equal(any->value_type, LYD_ANYDATA_LYB);
+    assert_int_equal(lyd_print_mem(&str2, data, LYD_XML, 0), 0);
+    assert_string_equal(str1, str2);
+    free(str2);
+    assert_int_equal(lyd_print_mem(&mem, data, LYD_LYB, 0), 0);
+    assert_int_equal(any->value_type, LYD_ANYDATA_LYB);
+    free(mem);
+
+    assert_int_not_equal(lyd_freeze(NULL), 0);
+    assert_int_equal(lyd_freeze(data), 0);
+    assert_int_equal(any->value_type, LYD_ANYDATA_DATATREE);
+    assert_string_equal(any->value.tree->schema->name, "t");
+
+    /* the same output */
+    assert_int_equal(lyd_print_mem(&str2, data, LYD_XML, 0), 0);
+    assert_string_equal(str1, str2);
+    free(str2);
+    assert_int_equal(lyd_print_mem(&mem, data, LYD_LYB, 0), 0);
+    assert_int_equal(any->value_type, LYD_ANYDATA_DATATREE);
+    free(mem);
+    free(str1);
+
+    lyd_free_withsiblings(data);
+    ly_ctx_destroy(ctx, NULL);
+}
+
+static void
+test_lyd_validate_incremental(void **state)
+{
+    (void) state; /* unused */
+    const char *yang = "module inc {namespace urn:inc; prefix i;"
+                       "container top {list l {key k; leaf k {type string;}"
+                       "leaf v {type uint8; must \". < 10\";} leaf m {type string; mandatory true;}}"
+                       "leaf lim {type uint8;} leaf w {when \"../lim > 3\"; type string;}}"
+                       "container other {leaf o {type string; must \"/i:top/lim != 4\";}}}";
+    const char *xml = "<top xmlns=\"urn:inc\"><l><k>a</k><v>1</v><m>x</m></l><l><k>b</k><v>2</v><m>y</m></l>"
+                      "<lim>7</lim><w>q</w></top><other xmlns=\"urn:inc\"><o>z</o></other>";
+    struct ly_ctx *ctx;
+    struct lyd_node *data, *node;
+    struct ly_set *set;
+    const struct lys_module *mod;
+
+    ctx = ly_ctx_new(NULL, 0);
+    assert_non_null(ctx);
+    mod = lys_parse_mem(ctx, yang, LYS_IN_YANG);
+    assert_non_null(mod);
+    data = lyd_parse_mem(ctx, xml, LYD_XML, LYD_OPT_CONFIG);
+    assert_non_null(data);
+    assert_int_equal(data->validity, 0);
+
+    /* invalid options */
+    assert_int_not_equal(lyd_validate(&data, LYD_OPT_CONFIG | LYD_OPT_VAL_INCREMENTAL | LYD_OPT_NOSIBLINGS, NULL), 0);
+    assert_int_not_equal(lyd_validate(&data, LYD_OPT_GET | LYD_OPT_VAL_INCREMENTAL, NULL), 0);
+
+    /* must of the changed node */
+    set = lyd_find_path(data, "/inc:top/l[k='a']/v");
+    assert_int_equal(set->number, 1);
+    node = set->set.d[0];
+    ly_set_free(set);
+    assert_int_equal(lyd_change_leaf((struct lyd_node_leaf_list *)node, "20"), 0);
+    assert_true(data->validity & LYD_VAL_SUBTREE);
+    assert_false(data->next->validity & LYD_VAL_SUBTREE);
+    assert_int_not_equal(lyd_validate(&data, LYD_OPT_CONFIG | LYD_OPT_VAL_INCREMENTAL, NULL), 0);
+    assert_true(data->validity & LYD_VAL_SUBTREE);
+    assert_int_equal(lyd_change_leaf((struct lyd_node_leaf_list *)node, "3"), 0);
+    assert_int_equal(lyd_validate(&data, LYD_OPT_CONFIG | LYD_OPT_VAL_INCREMENTAL, NULL), 0);
+    assert_int_equal(data->validity, 0);
+    assert_int_equal(node->validity, 0);
+
+    /* when and must depending on the changed node */
+    set = lyd_find_path(data, "/inc:top/lim");
+    assert_int_equal(set->number, 1);
+    node = set->set.d[0];
+    ly_set_free(set);
+    assert_int_equal(lyd_change_leaf((struct lyd_node_leaf_list *)node, "3"), 0);
+    assert_int_not_equal(lyd_validate(&data, LYD_OPT_CONFIG | LYD_OPT_VAL_INCREMENTAL, NULL), 0);
+    assert_int_equal(lyd_change_leaf((struct lyd_node_leaf_list *)node, "4"), 0);
+    assert_int_not_equal(lyd_validate(&data, LYD_OPT_CONFIG | LYD_OPT_VAL_INCREMENTAL, NULL), 0);
+    assert_int_equal(lyd_change_leaf((struct lyd_node_leaf_list *)node, "7"), 0);
+    assert_int_equal(lyd_validate(&data, LYD_OPT_CONFIG | LYD_OPT_VAL_INCREMENTAL, NULL), 0);
+    assert_int_equal(data->validity, 0);
+
+    /* removed mandatory node */
+    set = lyd_find_path(data, "/inc:top/l[k='b']/m");
+    assert_int_equal(set->number, 1);
+    node = set->set.d[0]->parent;
+    lyd_free(set->set.d[0]);
+    ly_set_free(set);
+    assert_int_not_equal(lyd_validate(&data, LYD_OPT_CONFIG | LYD_OPT_VAL_INCREMENTAL, NULL), 0);
+    assert_non_null(lyd_new_leaf(node, mod, "m", "y"));
+    assert_int_equal(lyd_validate(&data, LYD_OPT_CONFIG | LYD_OPT_VAL_INCREMENTAL, NULL), 0);
+    assert_int_equal(data->validity, 0);
+    assert_int_equal(node->validity, 0);
+
+    /* full validation still works */
+    assert_int_equal(lyd_validate(&data, LYD_OPT_CONFIG, NULL), 0);
+
+    lyd_free_withsiblings(data);
+    ly_ctx_destroy(ctx, NULL);
+}
+
+static void
+test_lyd_validate_dup(void **state)
+{
+    (void) state; /* unused */
+    const char *yang = "module dup {namespace urn:dup; prefix d;"
+                       "container c {list l {key k; leaf k {type string;}} leaf-list ll {type string;}}}";
+    struct ly_ctx *ctx;
+    struct lyd_node *data, *node;
+    const struct lys_module *mod;
+    char buf[16];
+    int i;
+
+    ctx = ly_ctx_new(NULL, 0);
+    assert_non_null(ctx);
+    mod = lys_parse_mem(ctx, yang, LYS_IN_YANG);
+    assert_non_null(mod);
+
+    data = lyd_new(NULL, mod, "c");
+    assert_non_null(data);
+    for (i = 0; i < 20; ++i) {
+        sprintf(buf, "%d", i);
+        node = lyd_new(data, NULL, "l");
+        assert_non_null(node);
+        assert_non_null(lyd_new_leaf(node, NULL, "k", buf));
+        assert_non_null(lyd_new_leaf(data, NULL, "ll", buf));
+    }
+    assert_int_equal(lyd_validate(&data, LYD_OPT_CONFIG, NULL), 0);
+
+    /* duplicate list instance */
+    node = lyd_new(data, NULL, "l");
+    assert_non_null(node);
+    assert_non_null(lyd_new_leaf(node, NULL, "k", "5"));
+    assert_int_not_equal(lyd_validate(&data, LYD_OPT_CONFIG, NULL), 0);
+    assert_int_equal(ly_vecode(ctx), LYVE_DUPLIST);
+    lyd_free(node);
+    assert_int_equal(lyd_validate(&data, LYD_OPT_CONFIG, NULL), 0);
+
+    /* duplicate leaf-list instance */
+    node = lyd_new_leaf(data, NULL, "ll", "19");
+    assert_non_null(node);
+    assert_int_not_equal(lyd_validate(&data, LYD_OPT_CONFIG, NULL), 0);
+    assert_int_equal(ly_vecode(ctx), LYVE_DUPLEAFLIST);
+    lyd_free(node);
+    assert_int_equal(lyd_validate(&data, LYD_OPT_CONFIG, NULL), 0);
+
+    lyd_free_withsiblings(data);
+    ly_ctx_destroy(ctx, NULL);
+}
+
+static void
+test_lyd_validate_leafref_many(void **state)
+{
+    (void) state; /* unused */
+    const char *yang = "module lr {namespace urn:lr; prefix l;"
+                       "list t {key n; leaf n {type string;}}"
+                       "list r {key n; leaf n {type string;} leaf ref {type leafref {path \"/l:t/l:n\";}}}}";
+    struct ly_ctx *ctx;
+    struct lyd_node *data = NULL, *node, *iter;
+    struct lyd_node_leaf_list *ref = NULL;
+    const struct lys_module *mod;
+    char buf[16];
+    int i;
+
+    ctx = ly_ctx_new(NULL, 0);
+    assert_non_null(ctx);
+    mod = lys_parse_mem(ctx, yang, LYS_IN_YANG);
+    assert_non_null(mod);
+
+    for (i = 0; i < 100; ++i) {
+        sprintf(buf, "%d", i);
+        node = lyd_new(NULL, mod, "t");
+        assert_non_null(node);
+        assert_non_null(lyd_new_leaf(node, NULL, "n", buf));
+        if (data) {
+            assert_int_equal(lyd_insert_sibling(&data, node), 0);
+        } else {
+            data = node;
+        }
+
+        node = lyd_new(NULL, mod, "r");
+        assert_non_null(node);
+        assert_non_null(lyd_new_leaf(node, NULL, "n", buf));
+        sprintf(buf, "%d", 99 - i);
+        assert_non_null(lyd_new_leaf(node, NULL, "ref", buf));
+        assert_int_equal(lyd_insert_sibling(&data, node), 0);
+    }
+    assert_int_equal(lyd_validate(&data, LYD_OPT_CONFIG, NULL), 0);
+
+    /* all the references resolved to the right targets */
+    LY_TREE_FOR(data, iter) {
+        if (strcmp(iter->schema->name, "r")) {
+            continue;
+        }
+        ref = (struct lyd_node_leaf_list *)iter->child->next;
+        assert_int_equal(ref->value_type, LY_TYPE_LEAFREF);
+        assert_string_equal(((struct lyd_node_leaf_list *)ref->value.leafref)->value_str, ref->value_str);
+        assert_string_equal(ref->value.leafref->parent->schema->name, "t");
+    }
+
+    /* missing target */
+    assert_int_equal(lyd_change_leaf(ref, "100"), 0);
+    assert_int_not_equal(lyd_validate(&data, LYD_OPT_CONFIG, NULL), 0);
+    assert_int_equal(ly_vecode(ctx), LYVE_NOLEAFREF);
+    assert_int_equal(lyd_change_leaf(ref, "50"), 0);
+    assert_int_equal(lyd_validate(&data, LYD_OPT_CONFIG, NULL), 0);
+    assert_string_equal(((struct lyd_node_leaf_list *)ref->value.leafref)->value_str, "50");
+
+    lyd_free_withsiblings(data);
+    ly_ctx_destroy(ctx, NULL);
+}
+
+static void
+test_lyd_validate_when_many(void **state)
+{
+    (void) state; /* unused */
+    const char *yang = "module wh {namespace urn:wh; prefix w;"
+                       "leaf max {type uint8;} leaf min {type uint8;}"
+                       "list l {key k; leaf k {type uint8;}"
+                       "container c {when \"../k < /w:max\"; presence p;"
+                       "leaf x {when \"../../k >= /w:min\"; type string;}}}}";
+    struct ly_ctx *ctx;
+    struct lyd_node *data, *node, *iter, *max, *min;
+    const struct lys_module *mod;
+    char buf[16];
+    int i, c_count = 0, x_count = 0;
+
+    ctx = ly_ctx_new(NULL, 0);
+    assert_non_null(ctx);
+    mod = lys_parse_mem(ctx, yang, LYS_IN_YANG);
+    assert_non_null(mod);
+
+    data = max = lyd_new_leaf(NULL, mod, "max", "200");
+    assert_non_null(data);
+    min = lyd_new_leaf(NULL, mod, "min", "0");
+    assert_int_equal(lyd_insert_sibling(&data, min), 0);
+    for (i = 0; i < 100; ++i) {
+        sprintf(buf, "%d", i);
+        node = lyd_new(NULL, mod, "l");
+        assert_non_null(node);
+        assert_non_null(lyd_new_leaf(node, NULL, "k", buf));
+        assert_non_null(lyd_new_leaf(lyd_new(node, NULL, "c"), NULL, "x", buf));
+        assert_int_equal(lyd_insert_sibling(&data, node), 0);
+    }
+    assert_int_equal(lyd_validate(&data, LYD_OPT_CONFIG, NULL), 0);
+
+    /* false when conditions are errors */
+    assert_int_equal(lyd_change_leaf((struct lyd_node_leaf_list *)max, "50"), 0);
+    assert_int_equal(lyd_change_leaf((struct lyd_node_leaf_list *)min, "11"), 0);
+    assert_int_not_equal(lyd_validate(&data, LYD_OPT_CONFIG, NULL), 0);
+    assert_int_equal(ly_vecode(ctx), LYVE_NOWHEN);
+
+    /* remove the nodes with false conditions, together with the descendants */
+    assert_int_equal(lyd_validate(&data, LYD_OPT_CONFIG | LYD_OPT_WHENAUTODEL, NULL), 0);
+    LY_TREE_FOR(data, iter) {
+        if (strcmp(iter->schema->name, "l")) {
+            continue;
+        }
+        node = iter->child->next;
+        if (node) {
+            assert_string_equal(node->schema->name, "c");
+            ++c_count;
+            if (node->child) {
+                assert_string_equal(((struct lyd_node_leaf_list *)node->child)->value_str,
+                                    ((struct lyd_node_leaf_list *)iter->child)->value_str);
+                ++x_count;
+            }
+        }
+    }
+    assert_int_equal(c_count, 50);
+    assert_int_equal(x_count, 39);
+
+    lyd_free_withsiblings(data);
+    ly_ctx_destroy(ctx, NULL);
+}
+
+static void
+test_lyd_validate_parallel(void **state)
+{
+    (void) state; /* unused */
+    const char *yang = "module par {namespace urn:par; prefix p;"
+                       "leaf max {type uint16;}"
+                       "list l {key k; leaf k {type uint16;} leaf v {type uint16; must \". <= /p:max\";}}}";
+    struct ly_ctx *ctx;
+    struct lyd_node *data, *node;
+    struct lyd_node_leaf_list *v100 = NULL, *v400 = NULL;
+    const struct lys_module *mod;
+    char buf[16];
+    int i;
+
+    ctx = ly_ctx_new(NULL, 0);
+    assert_non_null(ctx);
+    mod = lys_parse_mem(ctx, yang, LYS_IN_YANG);
+    assert_non_null(mod);
+
+    data = lyd_new_leaf(NULL, mod, "max", "1000");
+    assert_non_null(data);
+    for (i = 0; i < 500; ++i) {
+        node = lyd_new(NULL, mod, "l");
+        assert_non_null(node);
+        sprintf(buf, "%d", i);
+        assert_non_null(lyd_new_leaf(node, NULL, "k", buf));
+        if (i == 100) {
+            v100 = (struct lyd_node_leaf_list *)lyd_new_leaf(node, NULL, "v", buf);
+        } else if (i == 400) {
+            v400 = (struct lyd_node_leaf_list *)lyd_new_leaf(node, NULL, "v", buf);
+        } else {
+            assert_non_null(lyd_new_leaf(node, NULL, "v", buf));
+        }
+        assert_int_equal(lyd_insert_sibling(&data, node), 0);
+    }
+    assert_non_null(v100);
+    assert_non_null(v400);
+    assert_int_equal(lyd_validate(&data, LYD_OPT_CONFIG | LYD_OPT_PARALLEL, NULL), 0);
+
+    /* the first failed condition is always reported */
+    assert_int_equal(lyd_change_leaf(v100, "2000"), 0);
+    assert_int_equal(lyd_change_leaf(v400, "2000"), 0);
+    for (i = 0; i < 5; ++i) {
+        assert_int_not_equal(lyd_validate(&data, LYD_OPT_CONFIG | LYD_OPT_PARALLEL, NULL), 0);
+        assert_int_equal(ly_vecode(ctx), LYVE_NOMUST);
+        assert_string_equal(ly_errpath(ctx), "/par:l[k='100']/v");
+    }
+
+    assert_int_equal(lyd_change_leaf(v100, "100"), 0);
+    assert_int_not_equal(lyd_validate(&data, LYD_OPT_CONFIG | LYD_OPT_PARALLEL, NULL), 0);
+    assert_string_equal(ly_errpath(ctx), "/par:l[k='400']/v");
+    assert_int_equal(lyd_change_leaf(v400, "400"), 0);
+    assert_int_equal(lyd_validate(&data, LYD_OPT_CONFIG | LYD_OPT_PARALLEL, NULL), 0);
+
+    lyd_free_withsiblings(data);
+    ly_ctx_destroy(ctx, NULL);
+}
+
+static int
+executor_clb(void (*task)(void *arg), void *arg, void *user_data)
+{
+    int *submitted = (int *)user_data;
+
+    if (*submitted < 0) {
+        /* refuse the task */
+        return 1;
+    }
+
+    ++(*submitted);
+    task(arg);
+    return 0;
+}
+
+static void
+test_lyd_validate_executor(void **state)
+{
+    (void) state; /* unused */
+    const char *yang = "module par {namespace urn:par; prefix p;"
+                       "leaf max {type uint16;}"
+                       "list l {key k; leaf k {type uint16;} leaf v {type uint16; must \". <= /p:max\";}}}";
+    struct ly_ctx *ctx;
+    struct lyd_node *data, *node;
+    const struct lys_module *mod;
+    unsigned int threads;
+    void *user_data;
+    char buf[16];
+    int i, submitted = 0;
+
+    ctx = ly_ctx_new(NULL, 0);
+    assert_non_null(ctx);
+    mod = lys_parse_mem(ctx, yang, LYS_IN_YANG);
+    assert_non_null(mod);
+
+    data = lyd_new_leaf(NULL, mod, "max", "1000");
+    assert_non_null(data);
+    for (i = 0; i < 500; ++i) {
+        node = lyd_new(NULL, mod, "l");
+        assert_non_null(node);
+        sprintf(buf, "%d", i);
+        assert_non_null(lyd_new_leaf(node, NULL, "k", buf));
+        assert_non_null(lyd_new_leaf(node, NULL, "v", buf));
+        assert_int_equal(lyd_insert_sibling(&data, node), 0);
+    }
+
+    assert_null(ly_ctx_get_executor(ctx, &threads, NULL));
+    assert_int_equal(threads, 0);
+    ly_ctx_set_executor(ctx, executor_clb, 4, &submitted);
+    assert_ptr_equal(ly_ctx_get_executor(ctx, &threads, &user_data), executor_clb);
+    assert_int_equal(threads, 4);
+    assert_ptr_equal(user_data, &submitted);
+
+    /* the calling thread runs the first of the 4 tasks */
+    assert_int_equal(lyd_validate(&data, LYD_OPT_CONFIG | LYD_OPT_PARALLEL, NULL), 0);
+    assert_int_equal(submitted, 3);
+
+    /* the refused tasks are run by the calling thread */
+    submitted = -1;
+    assert_int_equal(lyd_validate(&data, LYD_OPT_CONFIG | LYD_OPT_PARALLEL, NULL), 0);
+
+    /* never split */
+    submitted = 0;
+    ly_ctx_set_executor(ctx, executor_clb, 1, &submitted);
+    assert_int_equal(lyd_validate(&data, LYD_OPT_CONFIG | LYD_OPT_PARALLEL, NULL), 0);
+    assert_int_equal(submitted, 0);
+
+    lyd_free_withsiblings(data);
+    ly_ctx_destroy(ctx, NULL);
+}
+
+static void
+test_lyd_validate_all(void **state)
+{
+    (void) state; /* unused */
+    const char *yang = "module va {namespace urn:va; prefix v;"
+                       "container c {leaf m {type string; mandatory true;} leaf-list ll {type string;}"
+                       "list l {key k; leaf k {type string;}"
+                       "leaf v {type uint8; must \". < 10\" {error-app-tag too-big;}}}}}";
+    struct ly_ctx *ctx;
+    struct lyd_node *data, *node, *ll, *dup, *va, *vb;
+    struct lyd_val_err *errs = NULL;
+    const struct lys_module *mod;
+
+    ctx = ly_ctx_new(NULL, 0);
+    assert_non_null(ctx);
+    mod = lys_parse_mem(ctx, yang, LYS_IN_YANG);
+    assert_non_null(mod);
+
+    data = lyd_new(NULL, mod, "c");
+    assert_non_null(data);
+    ll = lyd_new_leaf(data, NULL, "ll", "x");
+    assert_non_null(ll);
+    dup = lyd_new_leaf(data, NULL, "ll", "x");
+    assert_non_null(dup);
+    node = lyd_new(data, NULL, "l");
+    assert_non_null(lyd_new_leaf(node, NULL, "k", "a"));
+    va = lyd_new_leaf(node, NULL, "v", "20");
+    assert_non_null(va);
+    node = lyd_new(data, NULL, "l");
+    assert_non_null(lyd_new_leaf(node, NULL, "k", "b"));
+    vb = lyd_new_leaf(node, NULL, "v", "30");
+    assert_non_null(vb);
+
+    /* only the first error without the option */
+    assert_int_not_equal(lyd_validate(&data, LYD_OPT_CONFIG, NULL), 0);
+    assert_int_not_equal(lyd_validate(&data, LYD_OPT_CONFIG | LYD_OPT_VAL_ALL | LYD_OPT_WHENAUTODEL, NULL, &errs), 0);
+
+    /* all of them, neither printed nor stored */
+    ly_log_options(0);
+    assert_int_not_equal(lyd_validate(&data, LYD_OPT_CONFIG | LYD_OPT_VAL_ALL, NULL, &errs), 0);
+    ly_log_options(LY_LOLOG | LY_LOSTORE_LAST);
+    assert_non_null(errs);
+    assert_int_equal(errs[0].no, LY_EVALID);
+    assert_int_equal(errs[0].vecode, LYVE_DUPLEAFLIST);
+    assert_true((errs[0].node == ll) || (errs[0].node == dup));
+    assert_ptr_equal(errs[0].schema, dup->schema);
+    assert_null(errs[0].apptag);
+    assert_int_equal(errs[1].vecode, LYVE_NOMUST);
+    assert_ptr_equal(errs[1].node, va);
+    assert_string_equal(errs[1].apptag, "too-big");
+    assert_int_equal(errs[2].vecode, LYVE_NOMUST);
+    assert_ptr_equal(errs[2].node, vb);
+    assert_string_equal(errs[2].apptag, "too-big");
+    assert_int_equal(errs[3].vecode, LYVE_MISSELEM);
+    assert_ptr_equal(errs[3].node, data);
+    assert_int_equal(errs[4].no, LY_SUCCESS);
+    free(errs);
+
+    /* valid tree */
+    lyd_free(dup);
+    assert_non_null(lyd_new_leaf(data, NULL, "m", "y"));
+    assert_int_equal(lyd_change_leaf((struct lyd_node_leaf_list *)va, "1"), 0);
+    assert_int_equal(lyd_change_leaf((struct lyd_node_leaf_list *)vb, "2"), 0);
+    assert_int_equal(lyd_validate(&data, LYD_OPT_CONFIG | LYD_OPT_VAL_ALL, NULL, &errs), 0);
+    assert_null(errs);
+
+    lyd_free_withsiblings(data);
+    ly_ctx_destroy(ctx, NULL);
+}
+
 static void
 test_lyd_find_path(void **state)
 {
@@ -990,6 +1882,39 @@ test_lyd_find_path(void **state)
     ly_set_free(set);
 }
 
+static void
+test_lyd_find_path_prepared(void **state)
+{
+    (void) state; /* unused */
+    struct ly_set *set = NULL;
+    struct lyd_path *path;
+    int i;
+
+    path = lyd_path_prepare(root->schema->module, "/a:x/bubba");
+    assert_ptr_not_equal(path, NULL);
+
+    for (i = 0; i < 2; ++i) {
+        set = lyd_find_path_prepared(root->child, path);
+        assert_ptr_not_equal(set, NULL);
+        assert_int_equal(set->number, 1);
+        assert_string_equal(((struct lyd_node_leaf_list *)set->set.d[0])->value_str, "test");
+        ly_set_free(set);
+    }
+
+    lyd_path_free(path);
+
+    /* unprefixed nodes belong to the module */
+    path = lyd_path_prepare(root->schema->module, "/x/bubba");
+    assert_ptr_not_equal(path, NULL);
+    set = lyd_find_path_prepared(root, path);
+    assert_ptr_not_equal(set, NULL);
+    assert_int_equal(set->number, 1);
+    ly_set_free(set);
+    lyd_path_free(path);
+
+    assert_ptr_equal(lyd_path_prepare(root->schema->module, "/a:x/["), NULL);
+}
+
 static void
 test_lyd_find_instance(void **state)
 {
@@ -1009,6 +1934,337 @@ test_lyd_find_instance(void **state)
     ly_set_free(set);
 }
 
+static void
+test_lyd_find_sibling_val(void **state)
+{
+    (void) state; /* unused */
+    const char *yang = "module fsv {namespace urn:fsv; prefix f;"
+                       "container c {list l {key \"a b\"; leaf a {type string;} leaf b {type uint8;} leaf v {type string;}}"
+                       "leaf-list ll {type int16;} leaf t {type string;}}}";
+    struct ly_ctx *ctx;
+    struct lyd_node *data, *node;
+    const struct lys_module *mod;
+    const struct lys_node *sl, *sll, *st;
+    const char *keys[2];
+    char a[16], b[16], path[64];
+    int i, count;
+
+    ctx = ly_ctx_new(NULL, 0);
+    assert_non_null(ctx);
+    mod = lys_parse_mem(ctx, yang, LYS_IN_YANG);
+    assert_non_null(mod);
+    sl = ly_ctx_get_node(ctx, NULL, "/fsv:c/l", 0);
+    sll = ly_ctx_get_node(ctx, NULL, "/fsv:c/ll", 0);
+    st = ly_ctx_get_node(ctx, NULL, "/fsv:c/t", 0);
+    assert_non_null(sl);
+    assert_non_null(sll);
+    assert_non_null(st);
+
+    data = lyd_new_path(NULL, ctx, "/fsv:c/t", "x", 0, 0);
+    assert_non_null(data);
+
+    /* both a few and many instances, with and without a hash table of the children */
+    for (count = 2; count <= 64; count *= 32) {
+        for (i = 0; i < count; ++i) {
+            /* the instances from the previous round exist already */
+            sprintf(path, "/fsv:c/l[a='n%d'][b='%d']/v", i, i % 3);
+            node = lyd_new_path(data, NULL, path, "v", 0, LYD_PATH_OPT_UPDATE);
+            assert_true(node || (i < count / 32));
+            sprintf(path, "/fsv:c/ll[.='%d']", -i);
+            node = lyd_new_path(data, NULL, path, NULL, 0, LYD_PATH_OPT_UPDATE);
+            assert_true(node || (i < count / 32));
+        }
+
+        for (i = 0; i < count; ++i) {
+            sprintf(a, "n%d", i);
+            sprintf(b, "%d", i % 3);
+            keys[0] = a;
+            keys[1] = b;
+            node = lyd_find_sibling_val(data->child, sl, keys);
+            assert_non_null(node);
+            assert_ptr_equal(node->schema, sl);
+            assert_string_equal(((struct lyd_node_leaf_list *)node->child)->value_str, a);
+            assert_string_equal(((struct lyd_node_leaf_list *)node->child->next)->value_str, b);
+
+            sprintf(b, "%d", -i);
+            keys[0] = b;
+            node = lyd_find_sibling_val(data->child->prev, sll, keys);
+            assert_non_null(node);
+            assert_string_equal(((struct lyd_node_leaf_list *)node)->value_str, b);
+        }
+
+        /* not matching all the keys */
+        keys[0] = "n1";
+        keys[1] = "0";
+        assert_null(lyd_find_sibling_val(data->child, sl, keys));
+        keys[0] = "1";
+        assert_null(lyd_find_sibling_val(data->child, sll, keys));
+    }
+
+    node = lyd_find_sibling_val(data->child, st, NULL);
+    assert_non_null(node);
+    assert_ptr_equal(node->schema, st);
+    assert_ptr_equal(lyd_find_sibling_val(data, mod->data, NULL), data);
+    assert_null(lyd_find_sibling_val(data->child, sl, NULL));
+    assert_null(lyd_find_sibling_val(NULL, st, NULL));
+
+    lyd_free(data);
+    ly_ctx_destroy(ctx, NULL);
+}
+
+static void
+test_lyd_leaf_values(void **state)
+{
+    (void) state; /* unused */
+    const char *yang = "module lv {namespace urn:lv; prefix l;"
+                       "container c {list l {key a; leaf a {type string;} leaf n {type int32;}"
+                       "leaf r {type leafref {path \"../../ll\";}}}"
+                       "leaf-list ll {type uint8;}}}";
+    struct ly_ctx *ctx;
+    struct lyd_node *data;
+    struct lyd_leaf_values values;
+    char path[64], str[16];
+    unsigned int i;
+
+    ctx = ly_ctx_new(NULL, 0);
+    assert_non_null(ctx);
+    assert_non_null(lys_parse_mem(ctx, yang, LYS_IN_YANG));
+
+    data = lyd_new_path(NULL, ctx, "/lv:c/ll", "7", 0, 0);
+    assert_non_null(data);
+    for (i = 0; i < 10; ++i) {
+        sprintf(path, "/lv:c/l[a='k%u']/n", i);
+        sprintf(str, "%d", -(int)i);
+        assert_non_null(lyd_new_path(data, NULL, path, str, 0, 0));
+        sprintf(path, "/lv:c/l[a='k%u']/r", i);
+        assert_non_null(lyd_new_path(data, NULL, path, "7", 0, 0));
+    }
+    assert_int_equal(lyd_validate(&data, LYD_OPT_CONFIG, NULL), 0);
+
+    assert_int_equal(lyd_leaf_values(data, "/lv:c/l/n", &values), EXIT_SUCCESS);
+    assert_int_equal(values.count, 10);
+    for (i = 0; i < values.count; ++i) {
+        sprintf(str, "%d", -(int)i);
+        assert_int_equal(values.types[i], LY_TYPE_INT32);
+        assert_int_equal(values.values[i].int32, -(int)i);
+        assert_string_equal(values.strs[i], str);
+        assert_string_equal(values.nodes[i]->schema->name, "n");
+    }
+    lyd_leaf_values_clean(&values);
+
+    /* leafrefs give the values of their targets */
+    assert_int_equal(lyd_leaf_values(data, "/lv:c/l/r", &values), EXIT_SUCCESS);
+    assert_int_equal(values.count, 10);
+    for (i = 0; i < values.count; ++i) {
+        assert_int_equal(values.types[i], LY_TYPE_UINT8);
+        assert_int_equal(values.values[i].uint8, 7);
+        assert_string_equal(values.strs[i], "7");
+    }
+    lyd_leaf_values_clean(&values);
+
+    /* no instances */
+    lyd_free(data->child);
+    assert_int_equal(lyd_leaf_values(data, "/lv:c/ll", &values), EXIT_SUCCESS);
+    assert_int_equal(values.count, 0);
+    assert_null(values.values);
+    lyd_leaf_values_clean(&values);
+
+    /* invalid paths */
+    assert_int_equal(lyd_leaf_values(data, "/lv:c/l", &values), EXIT_FAILURE);
+    assert_int_equal(lyd_leaf_values(data, "/lv:c/x", &values), EXIT_FAILURE);
+
+    lyd_free(data);
+    ly_ctx_destroy(ctx, NULL);
+}
+
+static void
+test_lyd_list_columns(void **state)
+{
+    (void) state; /* unused */
+    const char *yang = "module lc {namespace urn:lc; prefix l;"
+                       "list l {key \"name\"; leaf name {type string;} leaf n {type int16;}"
+                       "leaf d {type decimal64 {fraction-digits 2;}} leaf e {type enumeration {enum a; enum b;}}}}";
+    const char *leaves[] = {"n", "e", NULL};
+    struct ly_ctx *ctx;
+    struct lyd_node *data = NULL;
+    struct lyd_columns columns;
+    char path[64], str[16];
+    int16_t *nums;
+    unsigned int i;
+
+    ctx = ly_ctx_new(NULL, 0);
+    assert_non_null(ctx);
+    assert_non_null(lys_parse_mem(ctx, yang, LYS_IN_YANG));
+
+    for (i = 0; i < 20; ++i) {
+        sprintf(path, "/lc:l[name='row%u']", i);
+        if (!data) {
+            data = lyd_new_path(NULL, ctx, path, NULL, 0, 0);
+            assert_non_null(data);
+        } else {
+            assert_non_null(lyd_new_path(data, NULL, path, NULL, 0, 0));
+        }
+        if (i % 2) {
+            /* only the odd rows have the leaves */
+            sprintf(path, "/lc:l[name='row%u']/n", i);
+            sprintf(str, "%u", i);
+            assert_non_null(lyd_new_path(data, NULL, path, str, 0, 0));
+            sprintf(path, "/lc:l[name='row%u']/e", i);
+            assert_non_null(lyd_new_path(data, NULL, path, "b", 0, 0));
+        }
+    }
+
+    assert_int_equal(lyd_list_columns(data, "/lc:l", leaves, &columns), EXIT_SUCCESS);
+    assert_int_equal(columns.rows, 20);
+    assert_int_equal(columns.count, 3);
+    assert_string_equal(columns.columns[0].schema->name, "name");
+    assert_int_equal(columns.columns[0].type, LY_TYPE_STRING);
+    assert_int_equal(columns.columns[1].type, LY_TYPE_INT16);
+    assert_int_equal(columns.columns[1].width, 2);
+    assert_int_equal(columns.columns[2].type, LY_TYPE_STRING);
+
+    nums = columns.columns[1].values;
+    for (i = 0; i < 20; ++i) {
+        sprintf(str, "row%u", i);
+        assert_int_equal(columns.columns[0].offsets[i + 1] - columns.columns[0].offsets[i], strlen(str));
+        assert_memory_equal(columns.columns[0].data + columns.columns[0].offsets[i], str, strlen(str));
+        assert_true(columns.columns[0].validity[i / 8] & (1 << (i % 8)));
+
+        if (i % 2) {
+            assert_true(columns.columns[1].validity[i / 8] & (1 << (i % 8)));
+            assert_int_equal(nums[i], i);
+            assert_int_equal(columns.columns[2].offsets[i + 1] - columns.columns[2].offsets[i], 1);
+            assert_int_equal(columns.columns[2].data[columns.columns[2].offsets[i]], 'b');
+        } else {
+            assert_false(columns.columns[1].validity[i / 8] & (1 << (i % 8)));
+            assert_false(columns.columns[2].validity[i / 8] & (1 << (i % 8)));
+            assert_int_equal(columns.columns[2].offsets[i + 1], columns.columns[2].offsets[i]);
+        }
+    }
+    lyd_list_columns_clean(&columns);
+
+    /* all the leaves */
+    assert_int_equal(lyd_list_columns(data, "/lc:l", NULL, &columns), EXIT_SUCCESS);
+    assert_int_equal(columns.count, 4);
+    assert_int_equal(columns.columns[2].type, LY_TYPE_DEC64);
+    assert_int_equal(columns.columns[2].width, 8);
+    assert_int_equal(columns.columns[2].validity[0], 0);
+    lyd_list_columns_clean(&columns);
+
+    /* invalid arguments */
+    leaves[0] = "x";
+    assert_int_equal(lyd_list_columns(data, "/lc:l", leaves, &columns), EXIT_FAILURE);
+    assert_int_equal(lyd_list_columns(data, "/lc:l/n", NULL, &columns), EXIT_FAILURE);
+
+    lyd_free_withsiblings(data);
+    ly_ctx_destroy(ctx, NULL);
+}
+
+static void
+test_lyd_new_list_columns(void **state)
+{
+    (void) state; /* unused */
+    const char *yang = "module nlc {namespace urn:nlc; prefix n;"
+                       "container c {list l {key \"id\"; leaf id {type uint32;} leaf n {type int8 {range \"0..10\";}}"
+                       "leaf d {type decimal64 {fraction-digits 2;}} leaf s {type string;}}}}";
+    const char *xml = "<c xmlns=\"urn:nlc\"><l><id>1</id><n>5</n><d>1.5</d><s>one</s></l>"
+                      "<l><id>2</id><s>two</s></l><l><id>3</id><n>10</n><d>-0.25</d></l></c>";
+    struct ly_ctx *ctx;
+    struct lyd_node *data, *copy, *list;
+    const struct lys_node *slist;
+    struct lyd_columns columns;
+    char *str1, *str2;
+
+    ctx = ly_ctx_new(NULL, 0);
+    assert_non_null(ctx);
+    assert_non_null(lys_parse_mem(ctx, yang, LYS_IN_YANG));
+    slist = ly_ctx_get_node(ctx, NULL, "/nlc:c/l", 0);
+    assert_non_null(slist);
+
+    data = lyd_parse_mem(ctx, xml, LYD_XML, LYD_OPT_CONFIG);
+    assert_non_null(data);
+    assert_int_equal(lyd_list_columns(data, "/nlc:c/l", NULL, &columns), EXIT_SUCCESS);
+    assert_int_equal(columns.rows, 3);
+
+    /* the same instances created from the columns */
+    copy = lyd_new(NULL, lyd_node_module(data), "c");
+    assert_non_null(copy);
+    list = lyd_new_list_columns(copy, slist, &columns);
+    assert_non_null(list);
+    assert_ptr_equal(list, copy->child);
+    assert_int_equal(lyd_validate(&copy, LYD_OPT_CONFIG, NULL), 0);
+
+    assert_int_equal(lyd_print_mem(&str1, data, LYD_XML, 0), 0);
+    assert_int_equal(lyd_print_mem(&str2, copy, LYD_XML, 0), 0);
+    assert_string_equal(str1, str2);
+    free(str1);
+    free(str2);
+
+    /* the range is checked */
+    ((int8_t *)columns.columns[1].values)[0] = 11;
+    assert_null(lyd_new_list_columns(NULL, slist, &columns));
+
+    /* a missing key */
+    columns.columns[0].validity[0] &= ~0x02;
+    ((int8_t *)columns.columns[1].values)[0] = 1;
+    assert_null(lyd_new_list_columns(NULL, slist, &columns));
+    lyd_list_columns_clean(&columns);
+
+    lyd_free(data);
+    lyd_free(copy);
+    ly_ctx_destroy(ctx, NULL);
+}
+
+static void
+test_lyd_list_cursor(void **state)
+{
+    (void) state; /* unused */
+    const char *yang = "module cur {namespace urn:cur; prefix c;"
+                       "container c {list l {key \"id\"; leaf id {type uint32;} leaf v {type string;}} leaf x {type string;}}}";
+    const char *xml = "<c xmlns=\"urn:cur\"><l><id>1</id><v>a</v></l><x>y</x><l><id>2</id></l><l><id>3</id></l></c>";
+    const char *after[] = {"1"}, *missing[] = {"4"};
+    struct ly_ctx *ctx;
+    struct lyd_node *data;
+    const struct lys_node *slist;
+    struct lyd_list_cursor cursor;
+    char *str;
+
+    ctx = ly_ctx_new(NULL, 0);
+    assert_non_null(ctx);
+    assert_non_null(lys_parse_mem(ctx, yang, LYS_IN_YANG));
+    slist = ly_ctx_get_node(ctx, NULL, "/cur:c/l", 0);
+    assert_non_null(slist);
+    data = lyd_parse_mem(ctx, xml, LYD_XML, LYD_OPT_CONFIG);
+    assert_non_null(data);
+
+    /* all the instances, other siblings skipped */
+    assert_int_equal(lyd_list_cursor_init(&cursor, data->child->next, slist, NULL), EXIT_SUCCESS);
+    assert_ptr_equal(lyd_list_cursor_next(&cursor), data->child);
+    assert_ptr_equal(lyd_list_cursor_next(&cursor), data->child->next->next);
+    assert_ptr_equal(lyd_list_cursor_next(&cursor), data->child->prev);
+    assert_null(lyd_list_cursor_next(&cursor));
+
+    /* pages */
+    assert_int_equal(lyd_list_cursor_init(&cursor, data->child, slist, NULL), EXIT_SUCCESS);
+    assert_int_equal(lyd_list_cursor_print_mem(&str, &cursor, 2, LYD_XML, 0), EXIT_SUCCESS);
+    assert_string_equal(str, "<l xmlns=\"urn:cur\"><id>1</id><v>a</v></l><l xmlns=\"urn:cur\"><id>2</id></l>");
+    free(str);
+    assert_int_equal(lyd_list_cursor_print_mem(&str, &cursor, 2, LYD_JSON, 0), EXIT_SUCCESS);
+    assert_string_equal(str, "{\"cur:l\":[{\"id\":3}]}");
+    free(str);
+    assert_null(cursor.next);
+
+    /* resumed by the keys */
+    assert_int_equal(lyd_list_cursor_init(&cursor, data->child, slist, after), EXIT_SUCCESS);
+    assert_int_equal(lyd_list_cursor_print_mem(&str, &cursor, 0, LYD_JSON, 0), EXIT_SUCCESS);
+    assert_string_equal(str, "{\"cur:l\":[{\"id\":2},{\"id\":3}]}");
+    free(str);
+    assert_int_equal(lyd_list_cursor_init(&cursor, data->child, slist, missing), EXIT_FAILURE);
+
+    lyd_free(data);
+    ly_ctx_destroy(ctx, NULL);
+}
+
 static void
 test_lyd_validate(void **state)
 {
@@ -1115,6 +2371,88 @@ test_lyd_free_withsiblings(void **state)
     lyd_free_withsiblings(copy);
 }
 
+static void
+test_lyd_txn(void **state)
+{
+    (void) state; /* unused */
+    struct lyd_txn *txn;
+    struct lyd_node *node, *bubba;
+    char *orig = NULL, *str = NULL;
+
+    bubba = root->child;
+    assert_string_equal(bubba->schema->name, "bubba");
+    assert_int_equal(lyd_print_mem(&orig, root, LYD_XML, LYP_WITHSIBLINGS), 0);
+
+    /* revert the changes */
+    txn = lyd_txn_start(root);
+    assert_non_null(txn);
+    assert_null(lyd_txn_start(root));
+
+    assert_int_equal(lyd_change_leaf((struct lyd_node_leaf_list *)bubba, "changed"), 0);
+    assert_non_null(lyd_new_leaf(root, NULL, "number32", "1"));
+    node = lyd_new_leaf(NULL, root->schema->module, "y", "top");
+    assert_non_null(node);
+    assert_int_equal(lyd_insert_before(root, node), 0);
+    lyd_free(bubba);
+    assert_non_null(lyd_new_leaf(root, NULL, "bubba", "again"));
+
+    assert_ptr_equal(lyd_txn_rollback(txn), root);
+    assert_ptr_equal(root->child, bubba);
+    assert_int_equal(lyd_print_mem(&str, root, LYD_XML, LYP_WITHSIBLINGS), 0);
+    assert_string_equal(str, orig);
+    free(str);
+    str = NULL;
+
+    /* keep the changes */
+    txn = lyd_txn_start(root);
+    assert_non_null(txn);
+    lyd_free(bubba);
+    assert_non_null(lyd_new_leaf(root, NULL, "number32", "1"));
+    lyd_txn_commit(txn);
+
+    assert_int_equal(lyd_print_mem(&str, root, LYD_XML, LYP_WITHSIBLINGS), 0);
+    assert_null(strstr(str, "bubba"));
+    assert_non_null(strstr(str, "number32"));
+
+    free(str);
+    free(orig);
+}
+
+static void
+test_lyd_free_reuse(void **state)
+{
+    (void) state; /* unused */
+    const char *xml = "<x xmlns=\"urn:a\" xmlns:a=\"urn:a\"><bubba a:test=\"t\">test</bubba></x>";
+    struct lyd_node *data, *iter, *next, *elem;
+    void *freed[16];
+    int count = 0, i;
+
+    data = lyd_parse_mem(ctx, xml, LYD_XML, LYD_OPT_CONFIG);
+    assert_non_null(data);
+    assert_non_null(data->child->attr);
+    LY_TREE_FOR(data, iter) {
+        LY_TREE_DFS_BEGIN(iter, next, elem) {
+            assert_true(count < 16);
+            freed[count++] = elem;
+            LY_TREE_DFS_END(iter, next, elem);
+        }
+    }
+    lyd_free_withsiblings(data);
+
+    data = lyd_parse_mem(ctx, xml, LYD_XML, LYD_OPT_CONFIG);
+    assert_non_null(data);
+    assert_string_equal(data->child->attr->value_str, "t");
+#ifdef LY_ENABLED_DATA_POOL
+    /* the freed nodes are reused */
+    for (i = 0; (i < count) && (freed[i] != data); ++i);
+    assert_int_not_equal(i, count);
+#else
+    (void)i;
+    (void)freed;
+#endif
+    lyd_free_withsiblings(data);
+}
+
 static void
 test_lyd_insert_attr(void **state)
 {
@@ -1588,6 +2926,259 @@ test_lyd_print_clb_json(void **state)
     free(buf);
 }
 
+struct buff_all {
+    char *data;
+    size_t len;
+};
+
+static ssize_t
+custom_lyd_print_clb_all(void *arg, const void *buf, size_t count)
+{
+    struct buff_all *all = arg;
+
+    all->data = realloc(all->data, all->len + count + 1);
+    assert_non_null(all->data);
+    memcpy(all->data + all->len, buf, count);
+    all->len += count;
+    all->data[all->len] = '\0';
+    return count;
+}
+
+static void
+test_lyd_print_large(void **state)
+{
+    (void) state; /* unused */
+    struct buff_all all = {NULL, 0};
+    char *value, *mem, *file, file_name[20];
+    int fd;
+    struct stat sb;
+
+    /* long value printed as a single fragment together with many short ones */
+    value = malloc(20001);
+    assert_non_null(value);
+    memset(value, 'v', 20000);
+    value[20000] = '\0';
+    assert_int_equal(lyd_change_leaf((struct lyd_node_leaf_list *)root->child, value), 0);
+    free(value);
+
+    assert_int_equal(lyd_print_mem(&mem, root, LYD_XML, LYP_FORMAT | LYP_WITHSIBLINGS), 0);
+    assert_true(strlen(mem) > 20000);
+
+    assert_int_equal(lyd_print_clb(custom_lyd_print_clb_all, &all, root, LYD_XML, LYP_FORMAT | LYP_WITHSIBLINGS), 0);
+    assert_string_equal(mem, all.data);
+    free(all.data);
+
+    strcpy(file_name, TMP_TEMPLATE);
+    fd = mkstemp(file_name);
+    assert_true(fd > 0);
+    assert_int_equal(lyd_print_fd(fd, root, LYD_XML, LYP_FORMAT | LYP_WITHSIBLINGS), 0);
+    assert_int_equal(fstat(fd, &sb), 0);
+    assert_int_equal(sb.st_size, strlen(mem));
+    file = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    assert_ptr_not_equal(file, MAP_FAILED);
+    assert_int_equal(memcmp(mem, file, sb.st_size), 0);
+    munmap(file, sb.st_size);
+    close(fd);
+    unlink(file_name);
+
+    free(mem);
+}
+
+static int
+emit_data(struct lyd_emitter *em, const struct lys_module *mod, const struct lys_module *mod2)
+{
+    int r = 0;
+
+    r |= lyd_emit_open(em, mod, "c");
+    r |= lyd_emit_leaf(em, NULL, "s", "a<b\"&\\");
+    r |= lyd_emit_leaf(em, NULL, "n", "1");
+    r |= lyd_emit_leaf(em, NULL, "n", "2");
+    r |= lyd_emit_open(em, NULL, "l");
+    r |= lyd_emit_leaf(em, NULL, "k1", "x");
+    r |= lyd_emit_leaf(em, NULL, "k2", "-1");
+    r |= lyd_emit_leaf(em, NULL, "v", "true");
+    r |= lyd_emit_open(em, NULL, "sub");
+    r |= lyd_emit_leaf(em, NULL, "e", NULL);
+    r |= lyd_emit_close(em);
+    r |= lyd_emit_close(em);
+    r |= lyd_emit_open(em, NULL, "l");
+    r |= lyd_emit_leaf(em, NULL, "k1", "y");
+    r |= lyd_emit_leaf(em, NULL, "k2", "2");
+    r |= lyd_emit_close(em);
+    r |= lyd_emit_open(em, NULL, "ec");
+    r |= lyd_emit_close(em);
+    r |= lyd_emit_leaf(em, NULL, "id", "em2:i2");
+    r |= lyd_emit_leaf(em, mod2, "a2", "t");
+    r |= lyd_emit_close(em);
+    r |= lyd_emit_leaf(em, mod, "top", "v");
+
+    return r;
+}
+
+static void
+test_lyd_emitter(void **state)
+{
+    (void) state; /* unused */
+    const char *yang = "module em {namespace urn:em; prefix em; identity b;"
+                       "container c {leaf s {type string;} leaf-list n {type uint8;}"
+                       "list l {key \"k1 k2\"; leaf k1 {type string;} leaf k2 {type int8;} leaf v {type boolean;}"
+                       "container sub {leaf e {type empty;}}}"
+                       "container ec {presence p;} leaf id {type identityref {base b;}}}"
+                       "leaf top {type string;}}";
+    const char *yang2 = "module em2 {namespace urn:em2; prefix e2; import em {prefix em;}"
+                        "identity i2 {base em:b;} augment /em:c {leaf a2 {type string;}}}";
+    const char *xml = "<c xmlns=\"urn:em\"><s>a&lt;b\"&amp;\\</s><n>1</n><n>2</n>"
+                      "<l><k1>x</k1><k2>-1</k2><v>true</v><sub><e/></sub></l><l><k1>y</k1><k2>2</k2></l><ec/>"
+                      "<id xmlns:e2=\"urn:em2\">e2:i2</id><a2 xmlns=\"urn:em2\">t</a2></c><top xmlns=\"urn:em\">v</top>";
+    const struct lys_module *mod, *mod2;
+    struct ly_ctx *ctx;
+    struct lyd_emitter *em;
+    struct lyd_node *data;
+    LYD_FORMAT formats[] = {LYD_XML, LYD_JSON};
+    int options[] = {0, LYP_FORMAT};
+    char *str1, *str2;
+    unsigned int i, j;
+
+    ctx = ly_ctx_new(NULL, 0);
+    assert_non_null(ctx);
+    mod = lys_parse_mem(ctx, yang, LYS_IN_YANG);
+    assert_non_null(mod);
+    mod2 = lys_parse_mem(ctx, yang2, LYS_IN_YANG);
+    assert_non_null(mod2);
+
+    data = lyd_parse_mem(ctx, xml, LYD_XML, LYD_OPT_CONFIG | LYD_OPT_STRICT);
+    assert_non_null(data);
+
+    /* the same output as printing the data tree */
+    for (i = 0; i < 2; ++i) {
+        for (j = 0; j < 2; ++j) {
+            assert_int_equal(lyd_print_mem(&str1, data, formats[i], LYP_WITHSIBLINGS | options[j]), 0);
+            em = lyd_emitter_new_mem(&str2, ctx, formats[i], options[j]);
+            assert_non_null(em);
+            assert_int_equal(emit_data(em, mod, mod2), 0);
+            assert_int_equal(lyd_emitter_finish(em), 0);
+            assert_string_equal(str1, str2);
+            free(str1);
+            free(str2);
+        }
+    }
+    lyd_free_withsiblings(data);
+
+    /* nothing emitted */
+    em = lyd_emitter_new_mem(&str2, ctx, LYD_JSON, 0);
+    assert_non_null(em);
+    assert_int_equal(lyd_emitter_finish(em), 0);
+    assert_string_equal(str2, "{}");
+    free(str2);
+
+    /* open nodes are closed by finishing */
+    em = lyd_emitter_new_mem(&str2, ctx, LYD_XML, 0);
+    assert_non_null(em);
+    assert_int_equal(lyd_emit_open(em, mod, "c"), 0);
+    assert_int_equal(lyd_emit_open(em, NULL, "sub"), 1);
+    assert_int_equal(lyd_emit_open(em, NULL, "ec"), 0);
+    assert_int_equal(lyd_emitter_finish(em), 0);
+    assert_string_equal(str2, "<c xmlns=\"urn:em\"><ec/></c>");
+    free(str2);
+
+    /* schema violations */
+    em = lyd_emitter_new_mem(&str2, ctx, LYD_XML, 0);
+    assert_non_null(em);
+    assert_int_equal(lyd_emit_leaf(em, NULL, "top", "v"), 1);
+    assert_int_equal(lyd_emit_leaf(em, mod, "c", "v"), 1);
+    assert_int_equal(lyd_emit_close(em), 1);
+    assert_int_equal(lyd_emit_open(em, mod, "c"), 0);
+    assert_int_equal(lyd_emit_leaf(em, NULL, "unknown", "v"), 1);
+    assert_int_equal(lyd_emit_leaf(em, NULL, "s", "a"), 0);
+    assert_int_equal(lyd_emit_leaf(em, NULL, "s", "b"), 1);
+    assert_int_equal(lyd_emit_leaf(em, NULL, "n", "256"), 1);
+    assert_int_equal(lyd_emit_leaf(em, NULL, "n", "1"), 0);
+    assert_int_equal(lyd_emit_open(em, NULL, "l"), 0);
+    assert_int_equal(lyd_emit_leaf(em, NULL, "v", "true"), 1);
+    assert_int_equal(lyd_emit_leaf(em, NULL, "k2", "1"), 1);
+    assert_int_equal(lyd_emit_leaf(em, NULL, "k1", "a"), 0);
+    assert_int_equal(lyd_emit_close(em), 1);
+    assert_int_equal(lyd_emit_leaf(em, NULL, "k2", "x"), 1);
+    assert_int_equal(lyd_emit_leaf(em, NULL, "k2", "1"), 0);
+    assert_int_equal(lyd_emit_close(em), 0);
+    assert_int_equal(lyd_emit_leaf(em, NULL, "n", "2"), 1);
+    assert_int_equal(lyd_emit_close(em), 0);
+    assert_int_equal(lyd_emitter_finish(em), 0);
+    assert_string_equal(str2, "<c xmlns=\"urn:em\"><s>a</s><n>1</n><l><k1>a</k1><k2>1</k2></l></c>");
+    free(str2);
+
+    /* LYB is not supported */
+    assert_null(lyd_emitter_new_mem(&str2, ctx, LYD_LYB, 0));
+
+    ly_ctx_destroy(ctx, NULL);
+}
+
+static void
+test_lyd_print_parallel(void **state)
+{
+    (void) state; /* unused */
+    const char *yang = "module par {namespace urn:par; prefix p;"
+                       "list l {key k; leaf k {type uint16;} leaf v {type string;} container sub {leaf d {type int8; default 5;}}}"
+                       "leaf-list ll {type string;} container c {leaf s {type string;}} leaf t {type boolean;}}";
+    const char *yang2 = "module par2 {namespace urn:par2; prefix p2; list c2 {key x; leaf x {type string;}}}";
+    struct ly_ctx *ctx;
+    struct lyd_node *data;
+    LYD_FORMAT formats[] = {LYD_XML, LYD_JSON, LYD_LYB};
+    int options[] = {0, LYP_FORMAT, LYP_FORMAT | LYP_WD_ALL};
+    char *xml, *str1, *str2;
+    unsigned int i, j;
+    int len, len1, len2;
+
+    ctx = ly_ctx_new(NULL, 0);
+    assert_non_null(ctx);
+    assert_non_null(lys_parse_mem(ctx, yang, LYS_IN_YANG));
+    assert_non_null(lys_parse_mem(ctx, yang2, LYS_IN_YANG));
+
+    xml = malloc(64 * 1024);
+    assert_non_null(xml);
+    len = sprintf(xml, "<c xmlns=\"urn:par\"><s>a&amp;b</s></c><ll xmlns=\"urn:par\">x</ll>");
+    for (i = 0; i < 100; ++i) {
+        len += sprintf(xml + len, "<l xmlns=\"urn:par\"><k>%u</k><v>value %u</v></l>", i, i);
+        if (!(i % 20)) {
+            len += sprintf(xml + len, "<c2 xmlns=\"urn:par2\"><x>%u</x></c2>", i);
+        }
+    }
+    sprintf(xml + len, "<ll xmlns=\"urn:par\">y</ll><t xmlns=\"urn:par\">true</t>");
+
+    data = lyd_parse_mem(ctx, xml, LYD_XML, LYD_OPT_DATA_NO_YANGLIB | LYD_OPT_STRICT);
+    free(xml);
+    assert_non_null(data);
+
+    /* the same output as printing sequentially */
+    for (i = 0; i < 3; ++i) {
+        for (j = 0; j < 3; ++j) {
+            assert_int_equal(lyd_print_mem(&str1, data, formats[i], LYP_WITHSIBLINGS | options[j]), 0);
+            assert_int_equal(lyd_print_mem(&str2, data, formats[i], LYP_WITHSIBLINGS | LYP_PARALLEL | options[j]), 0);
+            if (formats[i] == LYD_LYB) {
+                len1 = lyd_lyb_data_length(str1);
+                len2 = lyd_lyb_data_length(str2);
+                assert_true(len1 > 0);
+                assert_int_equal(len1, len2);
+                assert_int_equal(memcmp(str1, str2, len1), 0);
+            } else {
+                assert_string_equal(str1, str2);
+            }
+            free(str1);
+            free(str2);
+        }
+    }
+
+    /* without siblings the flag has no effect */
+    assert_int_equal(lyd_print_mem(&str1, data, LYD_JSON, 0), 0);
+    assert_int_equal(lyd_print_mem(&str2, data, LYD_JSON, LYP_PARALLEL), 0);
+    assert_string_equal(str1, str2);
+    free(str1);
+    free(str2);
+
+    lyd_free_withsiblings(data);
+    ly_ctx_destroy(ctx, NULL);
+}
+
 static void
 test_lyd_path(void **state)
 {
@@ -1605,6 +3196,380 @@ test_lyd_path(void **state)
     free(str);
 }
 
+static void
+test_lyd_path_buf(void **state)
+{
+    (void) state; /* unused */
+    const char *yang = "module pb {namespace urn:pb; prefix p;"
+                       "container c {list l {key \"a b\"; leaf a {type string;} leaf b {type string;}"
+                       "leaf-list ll {type string;} list k {config false; leaf v {type string;}}}}}";
+    const char *xml = "<c xmlns=\"urn:pb\"><l><a>1</a><b>x'y</b><ll>m</ll><ll>n</ll><k><v>1</v></k><k><v>2</v></k></l>"
+                      "<l><a>2</a><b>z</b><k><v>3</v></k></l></c>";
+    struct ly_ctx *ctx;
+    struct lyd_node *data, *next, *elem;
+    struct lyd_path_builder builder;
+    char buf[16], *str;
+    const char *path;
+    int len;
+
+    ctx = ly_ctx_new(NULL, 0);
+    assert_non_null(ctx);
+    assert_non_null(lys_parse_mem(ctx, yang, LYS_IN_YANG));
+    data = lyd_parse_mem(ctx, xml, LYD_XML, LYD_OPT_GET);
+    assert_non_null(data);
+
+    memset(&builder, 0, sizeof builder);
+    LY_TREE_DFS_BEGIN(data, next, elem) {
+        str = lyd_path(elem);
+        assert_non_null(str);
+
+        /* the same paths */
+        path = lyd_path_build(&builder, elem);
+        assert_non_null(path);
+        assert_string_equal(path, str);
+
+        len = lyd_path_buf(elem, buf, sizeof buf);
+        assert_int_equal(len, strlen(str));
+        if (len < (signed)sizeof buf) {
+            assert_string_equal(buf, str);
+        } else {
+            /* truncated */
+            assert_int_equal(strlen(buf), sizeof buf - 1);
+            assert_memory_equal(buf, str, sizeof buf - 1);
+        }
+
+        free(str);
+        LY_TREE_DFS_END(data, next, elem);
+    }
+    assert_string_equal(lyd_path_build(&builder, data->child), "/pb:c/l[a='1'][b=\"x'y\"]");
+    assert_string_equal(lyd_path_build(&builder, data->child->child->next->next->next->next->next),
+                        "/pb:c/l[a='1'][b=\"x'y\"]/k[2]");
+    assert_int_equal(lyd_path_buf(data, NULL, 0), 5);
+    lyd_path_builder_clear(&builder);
+
+    lyd_free(data);
+    ly_ctx_destroy(ctx, NULL);
+}
+
+static void
+test_lyd_instid_compiled(void **state)
+{
+    (void) state; /* unused */
+    const char *yang = "module ic {namespace urn:ic; prefix i;"
+                       "list l {key \"a b\"; leaf a {type string;} leaf b {type uint8;} leaf-list ll {type string;}}"
+                       "leaf-list ref {type instance-identifier;}}";
+    const char *xml = "<l xmlns=\"urn:ic\"><a>x</a><b>1</b><ll>v</ll></l><l xmlns=\"urn:ic\"><a>x</a><b>2</b></l>"
+                      "<ref xmlns=\"urn:ic\" xmlns:i=\"urn:ic\">/i:l[i:b='2'][i:a='x']</ref>"
+                      "<ref xmlns=\"urn:ic\" xmlns:i=\"urn:ic\">/i:l[i:a='x'][i:b='1']/i:ll[.='v']</ref>"
+                      "<ref xmlns=\"urn:ic\" xmlns:i=\"urn:ic\">/i:l[i:a='x'][i:b='01']/i:a</ref>";
+    struct ly_ctx *ctx;
+    struct lyd_node *data, *ref;
+    char *str1, *str2;
+
+    ctx = ly_ctx_new(NULL, 0);
+    assert_non_null(ctx);
+    assert_non_null(lys_parse_mem(ctx, yang, LYS_IN_YANG));
+    data = lyd_parse_mem(ctx, xml, LYD_XML, LYD_OPT_CONFIG);
+    assert_non_null(data);
+
+    /* keys in any order, a leaf-list, a non-canonical key value resolved from the string */
+    ref = data->next->next;
+    assert_ptr_equal(((struct lyd_node_leaf_list *)ref)->value.instance, data->next);
+    ref = ref->next;
+    assert_ptr_equal(((struct lyd_node_leaf_list *)ref)->value.instance, data->child->next->next);
+    ref = ref->next;
+    assert_ptr_equal(((struct lyd_node_leaf_list *)ref)->value.instance, data->child);
+
+    /* the cached XML format */
+    assert_int_equal(lyd_print_mem(&str1, data, LYD_XML, LYP_WITHSIBLINGS), 0);
+    assert_int_equal(lyd_print_mem(&str2, data, LYD_XML, LYP_WITHSIBLINGS), 0);
+    assert_string_equal(str1, str2);
+    assert_non_null(strstr(str1, "xmlns:i=\"urn:ic\""));
+    free(str1);
+    free(str2);
+
+    lyd_free_withsiblings(data);
+    ly_ctx_destroy(ctx, NULL);
+}
+
+static void
+test_lyd_change_leaf_value(void **state)
+{
+    (void) state; /* unused */
+    const char *yang = "module cv {namespace urn:cv; prefix c;"
+                       "list l {key \"k\"; leaf k {type uint32;} leaf u {type uint32 {range \"0..100\";}}"
+                       "leaf d {type decimal64 {fraction-digits 2;}} leaf e {type enumeration {enum a; enum b {value 5;}}}"
+                       "leaf b {type boolean;} leaf s {type string;}}}";
+    const char *xml = "<l xmlns=\"urn:cv\"><k>1</k><u>10</u><d>1.5</d><e>a</e><b>false</b><s>x</s></l>";
+    struct ly_ctx *ctx;
+    struct lyd_node *data;
+    struct lyd_node_leaf_list *k, *u, *d, *e, *b, *s;
+    uint32_t u32;
+    int64_t i64;
+    int32_t i32;
+    int8_t i8;
+
+    ctx = ly_ctx_new(NULL, 0);
+    assert_non_null(ctx);
+    assert_non_null(lys_parse_mem(ctx, yang, LYS_IN_YANG));
+    data = lyd_parse_mem(ctx, xml, LYD_XML, LYD_OPT_CONFIG);
+    assert_non_null(data);
+    k = (struct lyd_node_leaf_list *)data->child;
+    u = (struct lyd_node_leaf_list *)k->next;
+    d = (struct lyd_node_leaf_list *)u->next;
+    e = (struct lyd_node_leaf_list *)d->next;
+    b = (struct lyd_node_leaf_list *)e->next;
+    s = (struct lyd_node_leaf_list *)b->next;
+
+    u32 = 42;
+    assert_int_equal(lyd_change_leaf_value(u, &u32), 0);
+    assert_int_equal(u->value.uint32, 42);
+    assert_string_equal(u->value_str, "42");
+    assert_int_equal(lyd_change_leaf_value(u, &u32), 1);
+
+    /* out of range, the original value is kept */
+    u32 = 200;
+    assert_int_equal(lyd_change_leaf_value(u, &u32), -1);
+    assert_int_equal(u->value.uint32, 42);
+    assert_string_equal(u->value_str, "42");
+
+    i64 = 325;
+    assert_int_equal(lyd_change_leaf_value(d, &i64), 0);
+    assert_string_equal(d->value_str, "3.25");
+
+    i32 = 5;
+    assert_int_equal(lyd_change_leaf_value(e, &i32), 0);
+    assert_string_equal(e->value_str, "b");
+    assert_string_equal(e->value.enm->name, "b");
+    i32 = 3;
+    assert_int_equal(lyd_change_leaf_value(e, &i32), -1);
+    assert_string_equal(e->value_str, "b");
+
+    i8 = 1;
+    assert_int_equal(lyd_change_leaf_value(b, &i8), 0);
+    assert_string_equal(b->value_str, "true");
+    assert_int_equal(b->value.bln, 1);
+
+    /* keys and other types are not supported */
+    u32 = 2;
+    assert_int_equal(lyd_change_leaf_value(k, &u32), -1);
+    assert_int_equal(lyd_change_leaf_value(s, "y"), -1);
+
+    assert_int_equal(lyd_validate(&data, LYD_OPT_CONFIG, NULL), 0);
+
+    lyd_free_withsiblings(data);
+    ly_ctx_destroy(ctx, NULL);
+}
+
+static void
+test_lyd_leafref_index(void **state)
+{
+    (void) state; /* unused */
+    const char *yang = "module li {namespace urn:li; prefix l;"
+                       "list t {key name; leaf name {type string;}}"
+                       "leaf-list r {type leafref {path \"/t/name\";}}}";
+    const char *xml = "<t xmlns=\"urn:li\"><name>a</name></t><t xmlns=\"urn:li\"><name>b</name></t>"
+                      "<r xmlns=\"urn:li\">a</r><r xmlns=\"urn:li\">b</r>";
+    struct ly_ctx *ctx;
+    struct lyd_node *data, *ta, *tb;
+    struct lyd_node_leaf_list *ra, *rb;
+
+    ctx = ly_ctx_new(NULL, LY_CTX_LEAFREF_INDEX);
+    assert_non_null(ctx);
+    assert_non_null(lys_parse_mem(ctx, yang, LYS_IN_YANG));
+    data = lyd_parse_mem(ctx, xml, LYD_XML, LYD_OPT_CONFIG);
+    assert_non_null(data);
+    ta = data;
+    tb = data->next;
+    ra = (struct lyd_node_leaf_list *)tb->next;
+    rb = (struct lyd_node_leaf_list *)ra->next;
+    assert_int_equal(ra->value_type, LY_TYPE_LEAFREF);
+    assert_ptr_equal(ra->value.leafref, ta->child);
+    assert_ptr_equal(rb->value.leafref, tb->child);
+
+    /* only the leafref linked to the removed target is invalidated */
+    lyd_free(ta);
+    assert_true(ra->validity & LYD_VAL_LEAFREF);
+    assert_int_not_equal(ra->value_type, LY_TYPE_LEAFREF);
+    assert_false(rb->validity & LYD_VAL_LEAFREF);
+    assert_ptr_equal(rb->value.leafref, tb->child);
+    data = tb;
+    assert_int_not_equal(lyd_validate(&data, LYD_OPT_CONFIG, NULL), 0);
+
+    /* a freed leafref is forgotten */
+    lyd_free((struct lyd_node *)ra);
+    assert_int_equal(lyd_validate(&data, LYD_OPT_CONFIG, NULL), 0);
+    assert_ptr_equal(rb->value.leafref, tb->child);
+    lyd_free(tb);
+    assert_true(rb->validity & LYD_VAL_LEAFREF);
+    data = (struct lyd_node *)rb;
+    assert_int_not_equal(lyd_validate(&data, LYD_OPT_CONFIG, NULL), 0);
+
+    lyd_free_withsiblings(data);
+    ly_ctx_destroy(ctx, NULL);
+}
+
+static void
+test_lyd_parse_canonical(void **state)
+{
+    (void) state; /* unused */
+    const char *yang = "module pc {namespace urn:pc; prefix p;"
+                       "container c {leaf i {type int16;} leaf d {type decimal64 {fraction-digits 2;}}"
+                       "leaf b {type bits {bit x; bit y;}}}}";
+    const char *xml = "<c xmlns=\"urn:pc\"><i>-7</i><d>1.50</d><b>x y</b></c>";
+    struct ly_ctx *ctx;
+    struct lyd_node *data;
+    struct lyd_node_leaf_list *leaf;
+    char *str;
+
+    ctx = ly_ctx_new(NULL, 0);
+    assert_non_null(ctx);
+    assert_non_null(lys_parse_mem(ctx, yang, LYS_IN_YANG));
+
+    data = lyd_parse_mem(ctx, xml, LYD_XML, LYD_OPT_CONFIG | LYD_OPT_TRUSTED | LYD_OPT_CANONICAL);
+    assert_non_null(data);
+    leaf = (struct lyd_node_leaf_list *)data->child;
+    assert_int_equal(leaf->value.int16, -7);
+    assert_string_equal(leaf->value_str, "-7");
+    leaf = (struct lyd_node_leaf_list *)leaf->next;
+    assert_int_equal(leaf->value.dec64, 150);
+    assert_string_equal(leaf->value_str, "1.50");
+    leaf = (struct lyd_node_leaf_list *)leaf->next;
+    assert_non_null(leaf->value.bit[0]);
+    assert_non_null(leaf->value.bit[1]);
+
+    /* the printed data are the same */
+    assert_int_equal(lyd_print_mem(&str, data, LYD_XML, LYP_WITHSIBLINGS), 0);
+    assert_string_equal(str, xml);
+    free(str);
+
+    lyd_free_withsiblings(data);
+    ly_ctx_destroy(ctx, NULL);
+}
+
+static void
+test_lyd_journal(void **state)
+{
+    (void) state; /* unused */
+    const char *yang = "module jr {namespace urn:jr; prefix j;"
+                       "container c {leaf a {type string;} leaf b {type string;}"
+                       "list l {key k; leaf k {type string;} leaf v {type int8;}}"
+                       "leaf-list o {type string; ordered-by user;}}}";
+    const char *xml1 = "<c xmlns=\"urn:jr\"><a>x</a><b>y</b><l><k>1</k><v>1</v></l><l><k>2</k><v>2</v></l>"
+                       "<o>p</o><o>q</o><o>r</o></c>";
+    /* the created list instance is merged as the last child */
+    const char *xml2 = "<c xmlns=\"urn:jr\"><a>z</a><l><k>1</k><v>1</v></l><o>r</o><o>p</o><o>q</o>"
+                       "<l><k>3</k><v>3</v></l></c>";
+    struct ly_ctx *ctx;
+    struct lyd_node *first, *second, *data;
+    struct lyd_difflist *diff;
+    char *journal, *str1, *str2;
+    size_t len;
+
+    ctx = ly_ctx_new(NULL, 0);
+    assert_non_null(ctx);
+    assert_non_null(lys_parse_mem(ctx, yang, LYS_IN_YANG));
+
+    first = lyd_parse_mem(ctx, xml1, LYD_XML, LYD_OPT_CONFIG);
+    assert_non_null(first);
+    second = lyd_parse_mem(ctx, xml2, LYD_XML, LYD_OPT_CONFIG);
+    assert_non_null(second);
+
+    diff = lyd_diff(first, second, 0);
+    assert_non_null(diff);
+    assert_int_equal(lyd_journal_print_mem(&journal, &len, diff), 0);
+    assert_non_null(journal);
+    lyd_free_diff(diff);
+
+    /* replaying the journal on the first tree results in the second one */
+    data = lyd_dup(first, LYD_DUP_OPT_RECURSIVE);
+    assert_int_equal(lyd_journal_apply(ctx, &data, journal, len), 0);
+    assert_int_equal(lyd_print_mem(&str1, data, LYD_XML, LYP_WITHSIBLINGS), 0);
+    assert_int_equal(lyd_print_mem(&str2, second, LYD_XML, LYP_WITHSIBLINGS), 0);
+    assert_string_equal(str1, str2);
+    free(str1);
+    lyd_free_withsiblings(data);
+
+    /* also when replayed on an empty tree together with the records creating the first tree */
+    diff = lyd_diff(NULL, first, 0);
+    assert_non_null(diff);
+    assert_int_equal(lyd_journal_print_mem(&str1, &len, diff), 0);
+    lyd_free_diff(diff);
+    data = NULL;
+    assert_int_equal(lyd_journal_apply(ctx, &data, str1, len), 0);
+    free(str1);
+    assert_non_null(data);
+    diff = lyd_diff(first, second, 0);
+    assert_non_null(diff);
+    free(journal);
+    assert_int_equal(lyd_journal_print_mem(&journal, &len, diff), 0);
+    lyd_free_diff(diff);
+    assert_int_equal(lyd_journal_apply(ctx, &data, journal, len), 0);
+    assert_int_equal(lyd_print_mem(&str1, data, LYD_XML, LYP_WITHSIBLINGS), 0);
+    assert_string_equal(str1, str2);
+    free(str1);
+    lyd_free_withsiblings(data);
+
+    /* a truncated journal is detected */
+    data = lyd_dup(first, LYD_DUP_OPT_RECURSIVE);
+    assert_int_not_equal(lyd_journal_apply(ctx, &data, journal, len - 1), 0);
+    lyd_free_withsiblings(data);
+
+    free(str2);
+    free(journal);
+    lyd_free_withsiblings(first);
+    lyd_free_withsiblings(second);
+    ly_ctx_destroy(ctx, NULL);
+}
+
+static struct lyd_node *
+test_ext_deps_clb(struct ly_ctx *ctx, const struct lys_node *schema, const char *path, void *user_data)
+{
+    int *count = (int *)user_data;
+
+    (void)path;
+    assert_non_null(schema);
+    assert_string_equal(schema->name, "k");
+    ++(*count);
+    return lyd_parse_mem(ctx, "<cfg xmlns=\"urn:ed\"><l><k>a</k></l><l><k>b</k></l></cfg>", LYD_XML, LYD_OPT_CONFIG);
+}
+
+static void
+test_lyd_ext_deps_clb(void **state)
+{
+    (void) state; /* unused */
+    const char *yang = "module ed {namespace urn:ed; prefix e;"
+                       "container cfg {list l {key k; leaf k {type string;}}}"
+                       "rpc r {input {leaf ref {type leafref {path \"/e:cfg/e:l/e:k\";}}}}}";
+    struct ly_ctx *ctx;
+    struct lyd_node *rpc;
+    int count = 0;
+
+    ctx = ly_ctx_new(NULL, 0);
+    assert_non_null(ctx);
+    assert_non_null(lys_parse_mem(ctx, yang, LYS_IN_YANG));
+    ly_ctx_set_ext_deps_clb(ctx, test_ext_deps_clb, &count);
+    assert_ptr_equal(ly_ctx_get_ext_deps_clb(ctx, NULL), test_ext_deps_clb);
+
+    /* the referenced list keys are supplied by the callback */
+    rpc = lyd_parse_mem(ctx, "<r xmlns=\"urn:ed\"><ref>b</ref></r>", LYD_XML, LYD_OPT_RPC, NULL);
+    assert_non_null(rpc);
+    assert_int_equal(count, 1);
+    lyd_free(rpc);
+
+    rpc = lyd_parse_mem(ctx, "<r xmlns=\"urn:ed\"><ref>c</ref></r>", LYD_XML, LYD_OPT_RPC, NULL);
+    assert_null(rpc);
+    assert_int_equal(count, 2);
+
+    /* not used without the external dependencies */
+    rpc = lyd_parse_mem(ctx, "<r xmlns=\"urn:ed\"><ref>c</ref></r>", LYD_XML, LYD_OPT_RPC | LYD_OPT_NOEXTDEPS, NULL);
+    assert_non_null(rpc);
+    assert_int_equal(count, 2);
+    lyd_free(rpc);
+
+    ly_ctx_destroy(ctx, NULL);
+}
+
 static void
 test_lyd_leaf_type(void **state)
 {
@@ -1897,6 +3862,132 @@ test_lyd_first_sibling(void **state)
     }
 }
 
+#define SHARED_CTX_THREADS 4
+#define SHARED_CTX_ROUNDS 50
+
+static void *
+shared_ctx_thread(void *arg)
+{
+    const char *xml = (const char *)arg;
+    struct lyd_node *data;
+    char *str;
+    int i, rc = 0;
+
+    for (i = 0; !rc && (i < SHARED_CTX_ROUNDS); ++i) {
+        data = lyd_parse_mem(ctx, xml, LYD_XML, LYD_OPT_CONFIG | LYD_OPT_STRICT);
+        if (!data) {
+            return (void *)1;
+        }
+        if (lyd_validate(&data, LYD_OPT_CONFIG, NULL) || lyd_print_mem(&str, data, LYD_XML, LYP_WITHSIBLINGS)) {
+            rc = 1;
+        } else {
+            rc = strcmp(str, xml) ? 1 : 0;
+            free(str);
+        }
+        lyd_free_withsiblings(data);
+    }
+
+    return rc ? (void *)1 : NULL;
+}
+
+static void
+test_lyd_parse_shared_ctx(void **state)
+{
+    (void) state; /* unused */
+    pthread_t threads[SHARED_CTX_THREADS];
+    char *xml;
+    void *ret;
+    int i;
+
+    /* the schema data built on the first use are built by the threads concurrently */
+    assert_int_equal(lyd_print_mem(&xml, root, LYD_XML, LYP_WITHSIBLINGS), 0);
+    lyd_free_withsiblings(root);
+    root = NULL;
+    ly_ctx_destroy(ctx, NULL);
+    ctx = ly_ctx_new(TESTS_DIR"/api/files", 0);
+    assert_non_null(ctx);
+    assert_non_null(lys_parse_mem(ctx, lys_module_a, LYS_IN_YIN));
+
+    for (i = 0; i < SHARED_CTX_THREADS; ++i) {
+        assert_int_equal(pthread_create(&threads[i], NULL, shared_ctx_thread, xml), 0);
+    }
+    for (i = 0; i < SHARED_CTX_THREADS; ++i) {
+        assert_int_equal(pthread_join(threads[i], &ret), 0);
+        assert_ptr_equal(ret, NULL);
+    }
+
+    free(xml);
+}
+
+static void *
+shared_tree_thread(void *arg)
+{
+    struct lyd_node *tree = (struct lyd_node *)arg;
+    struct ly_set *set;
+    char path[32];
+    int i, rc = 0;
+
+    for (i = 0; !rc && (i < SHARED_CTX_ROUNDS); ++i) {
+        sprintf(path, "/sh:c/l[k='%d']/v", i % 20);
+        set = lyd_find_path(tree, path);
+        if (!set || (set->number != 1)) {
+            rc = 1;
+        }
+        ly_set_free(set);
+    }
+
+    return rc ? (void *)1 : NULL;
+}
+
+static void
+test_lyd_when_shared_tree(void **state)
+{
+    (void) state; /* unused */
+    const char *yang = "module sh {namespace urn:sh; prefix s;"
+                       "grouping g {leaf x {type string;}}"
+                       "container c {uses g {when \"not(x) and other\";} leaf other {type string;}"
+                       "list l {key k; leaf k {type uint16;} leaf v {type string;}}}}";
+    struct ly_ctx *sctx;
+    struct lyd_node *data, *node;
+    pthread_t threads[SHARED_CTX_THREADS];
+    char buf[16];
+    void *ret;
+    int i;
+
+    sctx = ly_ctx_new(NULL, 0);
+    assert_non_null(sctx);
+    assert_non_null(lys_parse_mem(sctx, yang, LYS_IN_YANG));
+
+    data = lyd_new_path(NULL, sctx, "/sh:c/x", "a", 0, 0);
+    assert_non_null(data);
+    assert_non_null(lyd_new_path(data, NULL, "/sh:c/other", "b", 0, 0));
+    for (i = 0; i < 20; ++i) {
+        sprintf(buf, "%d", i);
+        node = lyd_new(data, NULL, "l");
+        assert_non_null(node);
+        assert_non_null(lyd_new_leaf(node, NULL, "k", buf));
+        assert_non_null(lyd_new_leaf(node, NULL, "v", buf));
+    }
+
+    /* x is not present when evaluating the condition of its uses, the tree is not changed meanwhile */
+    assert_int_equal(lyd_validate(&data, LYD_OPT_CONFIG, NULL), 0);
+    assert_string_equal(data->child->schema->name, "x");
+    assert_string_equal(data->child->next->schema->name, "other");
+    assert_ptr_equal(data->child->prev->parent, data);
+
+    /* the tree is only read by the evaluations */
+    for (i = 0; i < SHARED_CTX_THREADS; ++i) {
+        assert_int_equal(pthread_create(&threads[i], NULL, shared_tree_thread, data), 0);
+    }
+    for (i = 0; i < SHARED_CTX_THREADS; ++i) {
+        assert_int_equal(pthread_join(threads[i], &ret), 0);
+        assert_ptr_equal(ret, NULL);
+    }
+
+    lyd_free_withsiblings(data);
+    ly_ctx_destroy(sctx, NULL);
+}
+
 static void
 test_lyd_print_path(void **state)
 {
@@ -1918,23 +4009,45 @@ int main(void)
         cmocka_unit_test(test_lyd_parse_fd),
         cmocka_unit_test(test_lyd_parse_path),
         cmocka_unit_test(test_lyd_parse_xml),
+        cmocka_unit_test(test_lyd_chunk_parser),
+        cmocka_unit_test(test_lyd_stream_parser),
         cmocka_unit_test_setup_teardown(test_lyd_new, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_lyd_new_leaf, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_lyd_change_leaf, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_lyd_output_new_leaf, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_lyd_new_path, setup_f, teardown_f),
+        cmocka_unit_test(test_lyd_new_path_cursor),
         cmocka_unit_test_setup_teardown(test_lyd_dup, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_lyd_insert, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_lyd_insert_sibling, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_lyd_reserve_children, setup_f, teardown_f),
+        cmocka_unit_test(test_lyd_insert_batch),
         cmocka_unit_test_setup_teardown(test_lyd_insert_before, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_lyd_insert_after, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_lyd_schema_sort, setup_f, teardown_f),
+        cmocka_unit_test(test_lyd_insert_ordered),
+        cmocka_unit_test(test_lyd_freeze),
+        cmocka_unit_test(test_lyd_validate_incremental),
+        cmocka_unit_test(test_lyd_validate_dup),
+        cmocka_unit_test(test_lyd_validate_leafref_many),
+        cmocka_unit_test(test_lyd_validate_when_many),
+        cmocka_unit_test(test_lyd_validate_parallel),
+        cmocka_unit_test(test_lyd_validate_executor),
+        cmocka_unit_test(test_lyd_validate_all),
         cmocka_unit_test_setup_teardown(test_lyd_find_path, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_lyd_find_path_prepared, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_lyd_find_instance, setup_f, teardown_f),
+        cmocka_unit_test(test_lyd_find_sibling_val),
+        cmocka_unit_test(test_lyd_leaf_values),
+        cmocka_unit_test(test_lyd_list_columns),
+        cmocka_unit_test(test_lyd_new_list_columns),
+        cmocka_unit_test(test_lyd_list_cursor),
         cmocka_unit_test_setup_teardown(test_lyd_validate, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_lyd_unlink, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_lyd_free, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_lyd_free_withsiblings, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_lyd_txn, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_lyd_free_reuse, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_lyd_insert_attr, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_lyd_free_attr, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_lyd_print_mem_xml, setup_f, teardown_f),
@@ -1949,7 +4062,17 @@ int main(void)
         cmocka_unit_test_setup_teardown(test_lyd_print_clb_xml, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_lyd_print_clb_xml_format, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_lyd_print_clb_json, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_lyd_print_large, setup_f, teardown_f),
+        cmocka_unit_test(test_lyd_emitter),
+        cmocka_unit_test(test_lyd_print_parallel),
         cmocka_unit_test_setup_teardown(test_lyd_path, setup_f, teardown_f),
+        cmocka_unit_test(test_lyd_path_buf),
+        cmocka_unit_test(test_lyd_instid_compiled),
+        cmocka_unit_test(test_lyd_change_leaf_value),
+        cmocka_unit_test(test_lyd_leafref_index),
+        cmocka_unit_test(test_lyd_parse_canonical),
+        cmocka_unit_test(test_lyd_journal),
+        cmocka_unit_test(test_lyd_ext_deps_clb),
         cmocka_unit_test_setup_teardown(test_lyd_leaf_type, setup_f2, teardown_f2),
         cmocka_unit_test_setup_teardown(test_lyd_validation_dflt_empty_containers, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_lyd_diff, setup_f, teardown_f),
@@ -1960,6 +4083,8 @@ int main(void)
         cmocka_unit_test_setup_teardown(test_lyd_new_anydata, setup_f3, teardown_f3),
         cmocka_unit_test_setup_teardown(test_lyd_new_output_anydata, setup_f3, teardown_f3),
         cmocka_unit_test_setup_teardown(test_lyd_first_sibling, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_lyd_parse_shared_ctx, setup_f, teardown_f),
+        cmocka_unit_test(test_lyd_when_shared_tree),
         cmocka_unit_test_setup_teardown(test_lyd_print_path, setup_f, teardown_f),
     };
 
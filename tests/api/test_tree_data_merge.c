@@ -653,6 +653,159 @@ test_merge_leafrefs(void **state)
     free(prt);
 }
 
+static void
+test_merge_bulk(void **state)
+{
+    struct state *st = (*state);
+    const char *sch = "module x {"
+                      "  namespace urn:x;"
+                      "  prefix x;"
+                      "  leaf b { type bits { bit one; bit two; } }"
+                      "  list l {"
+                      "    key n;"
+                      "    leaf n { type uint8; }"
+                      "    leaf t { type string; }}}";
+    const char *edits[] = {"<l xmlns=\"urn:x\"><n>3</n><t>*</t></l>",
+                           "<b xmlns=\"urn:x\">two</b>",
+                           "<l xmlns=\"urn:x\"><n>20</n></l><l xmlns=\"urn:x\"><n>3</n><t>**</t></l>",
+                           "<l xmlns=\"urn:x\"><n>20</n><t>new</t></l>"};
+    struct lyd_node *sources[4];
+    char *str;
+    int i;
+
+    assert_ptr_not_equal(lys_parse_mem(st->ctx1, sch, LYS_IN_YANG), NULL);
+
+    st->target = lyd_new_path(NULL, st->ctx1, "/x:b", "one", 0, 0);
+    assert_ptr_not_equal(st->target, NULL);
+    for (i = 0; i < 10; ++i) {
+        asprintf(&str, "/x:l[n='%d']", i);
+        assert_ptr_not_equal(lyd_new_path(st->target, NULL, str, NULL, 0, 0), NULL);
+        free(str);
+    }
+    assert_int_equal(lyd_validate(&st->target, LYD_OPT_CONFIG, NULL), 0);
+
+    for (i = 0; i < 4; ++i) {
+        sources[i] = lyd_parse_mem(st->ctx1, edits[i], LYD_XML, LYD_OPT_CONFIG);
+        assert_ptr_not_equal(sources[i], NULL);
+    }
+
+    assert_int_equal(lyd_merge_bulk(st->target, sources, 4, 0), 0);
+    for (i = 0; i < 4; ++i) {
+        assert_ptr_equal(sources[i], NULL);
+    }
+    assert_int_equal(lyd_validate(&st->target, LYD_OPT_CONFIG, NULL), 0);
+
+    /* the existing instances were merged, only the new one was added */
+    lyd_print_mem(&st->output, st->target, LYD_XML, LYP_WITHSIBLINGS);
+    assert_string_equal(st->output, "<b xmlns=\"urn:x\">two</b>"
+                        "<l xmlns=\"urn:x\"><n>0</n></l><l xmlns=\"urn:x\"><n>1</n></l><l xmlns=\"urn:x\"><n>2</n></l>"
+                        "<l xmlns=\"urn:x\"><n>3</n><t>**</t></l><l xmlns=\"urn:x\"><n>4</n></l>"
+                        "<l xmlns=\"urn:x\"><n>5</n></l><l xmlns=\"urn:x\"><n>6</n></l><l xmlns=\"urn:x\"><n>7</n></l>"
+                        "<l xmlns=\"urn:x\"><n>8</n></l><l xmlns=\"urn:x\"><n>9</n></l>"
+                        "<l xmlns=\"urn:x\"><n>20</n><t>new</t></l>");
+}
+
+static int
+edit_clb(LYD_DIFFTYPE type, struct lyd_node *UNUSED(first), struct lyd_node *UNUSED(second), void *user_data)
+{
+    int *count = user_data;
+
+    ++count[type];
+    return 0;
+}
+
+static void
+test_edit_apply(void **state)
+{
+    struct state *st = (*state);
+    const char *sch = "module x {"
+                      "  namespace urn:x;"
+                      "  prefix x;"
+                      "  leaf x { type string; }"
+                      "  container c {"
+                      "    leaf a { type string; }"
+                      "    leaf b { type string; }"
+                      "    leaf-list ll { type string; ordered-by user; }"
+                      "    list l {"
+                      "      key n;"
+                      "      leaf n { type string; }"
+                      "      leaf t { type string; }}}}";
+    const char *trg = "<c xmlns=\"urn:x\"><a>1</a><b>2</b><ll>1</ll><ll>2</ll><l><n>1</n><t>a</t></l></c>"
+                      "<x xmlns=\"urn:x\">x</x>";
+    const char *edit1 = "<c xmlns=\"urn:x\" xmlns:nc=\"urn:ietf:params:xml:ns:netconf:base:1.0\" "
+                        "xmlns:yang=\"urn:ietf:params:xml:ns:yang:1\">"
+                          "<a>10</a><b nc:operation=\"delete\"/><ll yang:insert=\"first\">2</ll>"
+                          "<l nc:operation=\"replace\"><n>1</n></l><l><n>2</n><t>b</t></l>"
+                        "</c>";
+    const char *edit2 = "<x xmlns=\"urn:x\" xmlns:nc=\"urn:ietf:params:xml:ns:netconf:base:1.0\" "
+                        "nc:operation=\"create\">y</x>";
+    const char *edit3 = "<x xmlns=\"urn:x\">z</x>";
+    const char *edit4 = "<c xmlns=\"urn:x\" xmlns:nc=\"urn:ietf:params:xml:ns:netconf:base:1.0\">"
+                          "<l nc:operation=\"create\"><n>5</n><t nc:operation=\"merge\">x</t></l>"
+                        "</c>";
+    const char *edit5 = "<c xmlns=\"urn:x\" xmlns:nc=\"urn:ietf:params:xml:ns:netconf:base:1.0\">"
+                          "<l nc:operation=\"create\"><n>6</n><t nc:operation=\"delete\"/></l>"
+                        "</c>";
+    struct lyd_node *edit;
+    int count[LYD_DIFF_MOVEDAFTER2 + 1] = {0};
+
+    assert_int_equal(ly_ctx_set_searchdir(st->ctx1, TESTS_DIR "/schema/yang/ietf"), 0);
+    assert_ptr_not_equal(ly_ctx_load_module(st->ctx1, "ietf-netconf", NULL), NULL);
+    assert_ptr_not_equal(lys_parse_mem(st->ctx1, sch, LYS_IN_YANG), NULL);
+
+    st->target = lyd_parse_mem(st->ctx1, trg, LYD_XML, LYD_OPT_CONFIG);
+    assert_ptr_not_equal(st->target, NULL);
+
+    /* merge with nested operations */
+    edit = lyd_parse_mem(st->ctx1, edit1, LYD_XML, LYD_OPT_EDIT);
+    assert_ptr_not_equal(edit, NULL);
+    assert_int_equal(lyd_edit_apply(&st->target, edit, 0, edit_clb, count), EXIT_SUCCESS);
+    lyd_free_withsiblings(edit);
+    assert_int_equal(count[LYD_DIFF_CHANGED], 1);
+    assert_int_equal(count[LYD_DIFF_DELETED], 2);
+    assert_int_equal(count[LYD_DIFF_MOVEDAFTER1], 1);
+    assert_int_equal(count[LYD_DIFF_CREATED], 1);
+    assert_int_equal(lyd_validate(&st->target, LYD_OPT_CONFIG, NULL), 0);
+
+    lyd_print_mem(&st->output, st->target, LYD_XML, LYP_WITHSIBLINGS);
+    assert_string_equal(st->output, "<c xmlns=\"urn:x\"><a>10</a><ll>2</ll><ll>1</ll><l><n>1</n></l>"
+                        "<l><n>2</n><t>b</t></l></c><x xmlns=\"urn:x\">x</x>");
+    free(st->output);
+
+    /* the data to create exist */
+    edit = lyd_parse_mem(st->ctx1, edit2, LYD_XML, LYD_OPT_EDIT);
+    assert_ptr_not_equal(edit, NULL);
+    assert_int_equal(lyd_edit_apply(&st->target, edit, 0, NULL, NULL), EXIT_FAILURE);
+    lyd_free_withsiblings(edit);
+
+    /* create a list instance with a nested operation */
+    edit = lyd_parse_mem(st->ctx1, edit4, LYD_XML, LYD_OPT_EDIT);
+    assert_ptr_not_equal(edit, NULL);
+    memset(count, 0, sizeof count);
+    assert_int_equal(lyd_edit_apply(&st->target, edit, 0, edit_clb, count), EXIT_SUCCESS);
+    lyd_free_withsiblings(edit);
+    assert_int_equal(count[LYD_DIFF_CREATED], 1);
+
+    /* the nested operation fails, nothing is left created */
+    edit = lyd_parse_mem(st->ctx1, edit5, LYD_XML, LYD_OPT_EDIT);
+    assert_ptr_not_equal(edit, NULL);
+    assert_int_equal(lyd_edit_apply(&st->target, edit, 0, NULL, NULL), EXIT_FAILURE);
+    lyd_free_withsiblings(edit);
+
+    lyd_print_mem(&st->output, st->target, LYD_XML, LYP_WITHSIBLINGS);
+    assert_string_equal(st->output, "<c xmlns=\"urn:x\"><a>10</a><ll>2</ll><ll>1</ll><l><n>1</n></l>"
+                        "<l><n>2</n><t>b</t></l><l><n>5</n><t>x</t></l></c><x xmlns=\"urn:x\">x</x>");
+    free(st->output);
+
+    /* replace the whole configuration */
+    edit = lyd_parse_mem(st->ctx1, edit3, LYD_XML, LYD_OPT_EDIT);
+    assert_ptr_not_equal(edit, NULL);
+    assert_int_equal(lyd_edit_apply(&st->target, edit, LYD_EDITOPT_REPLACE, NULL, NULL), EXIT_SUCCESS);
+    lyd_free_withsiblings(edit);
+
+    lyd_print_mem(&st->output, st->target, LYD_XML, LYP_WITHSIBLINGS);
+    assert_string_equal(st->output, "<x xmlns=\"urn:x\">z</x>");
+}
 
 int
 main(void)
@@ -670,6 +823,8 @@ main(void)
                     cmocka_unit_test_setup_teardown(test_merge_to_ctx, setup_mctx, teardown_mctx),
                     cmocka_unit_test_setup_teardown(test_merge_to_ctx_with_missing_schema, setup_mctx, teardown_mctx),
                     cmocka_unit_test_setup_teardown(test_merge_leafrefs, setup_dflt, teardown_dflt),
+                    cmocka_unit_test_setup_teardown(test_merge_bulk, setup_dflt, teardown_dflt),
+                    cmocka_unit_test_setup_teardown(test_edit_apply, setup_dflt, teardown_dflt),
     };
 
     return cmocka_run_group_tests(tests, NULL, NULL);
@@ -389,6 +389,23 @@ test_lys_parse_mem(void **state)
     ctx = NULL;
 }
 
+static void
+test_lys_parse_mem_strings(void **state)
+{
+    (void) state; /* unused */
+    const struct lys_module *module;
+    const char *yang = "module s { namespace urn:s; prefix s; /* block * comment **/\n"
+        "  // line comment \"not a string\n"
+        "  description\n    \"first\tline \\\"quoted\\\" \\\\\n\t  second line \xc5\xbe\\n\" + 'single \\n'; }";
+    const char *bad = "module s { namespace urn:s; prefix s; description \"ab\x01" "c\"; }";
+
+    module = lys_parse_mem(ctx, yang, LYS_IN_YANG);
+    assert_non_null(module);
+    assert_string_equal(module->dsc, "first\tline \"quoted\" \\\n     second line \xc5\xbe\nsingle \\n");
+
+    assert_null(lys_parse_mem(ctx, bad, LYS_IN_YANG));
+}
+
 static void
 test_lys_parse_fd(void **state)
 {
@@ -637,6 +654,57 @@ test_lys_is_disabled(void **state)
     }
 }
 
+static void
+test_lys_is_disabled_toggle(void **state)
+{
+    (void) state; /* unused */
+    const struct lys_module *fmod, *mod;
+    const struct lys_node *leaf, *other;
+    struct lyd_node *data;
+    const char *yang_f = "module f { yang-version 1.1; namespace urn:f; prefix f;"
+        "feature a; feature b { if-feature a; } }";
+    const char *yang_m = "module m { yang-version 1.1; namespace urn:m; prefix m; import f { prefix f; }"
+        "leaf l { if-feature \"f:a and not f:b\"; type enumeration { enum x; enum y { if-feature f:b; } } }"
+        "leaf o { if-feature f:b; type string; } }";
+
+    fmod = lys_parse_mem(ctx, yang_f, LYS_IN_YANG);
+    assert_non_null(fmod);
+    mod = lys_parse_mem(ctx, yang_m, LYS_IN_YANG);
+    assert_non_null(mod);
+    leaf = mod->data;
+    other = leaf->next;
+
+    /* evaluated repeatedly, the features of another module change */
+    assert_ptr_equal(lys_is_disabled(leaf, 0), leaf);
+    assert_ptr_equal(lys_is_disabled(leaf, 0), leaf);
+    assert_int_equal(lys_features_enable(fmod, "a"), EXIT_SUCCESS);
+    assert_null(lys_is_disabled(leaf, 0));
+    assert_ptr_equal(lys_is_disabled(other, 0), other);
+
+    assert_int_equal(lys_features_enable(fmod, "b"), EXIT_SUCCESS);
+    assert_ptr_equal(lys_is_disabled(leaf, 0), leaf);
+    assert_null(lys_is_disabled(other, 0));
+    data = lyd_new_path(NULL, ctx, "/m:o", "v", 0, 0);
+    assert_non_null(data);
+    lyd_free(data);
+
+    /* disabling a disables also b */
+    assert_int_equal(lys_features_disable(fmod, "a"), EXIT_SUCCESS);
+    assert_int_equal(lys_features_state(fmod, "b"), 0);
+    assert_ptr_equal(lys_is_disabled(leaf, 0), leaf);
+    assert_ptr_equal(lys_is_disabled(other, 0), other);
+    assert_null(lyd_new_path(NULL, ctx, "/m:o", "v", 0, 0));
+
+    /* the enum values follow the features as well */
+    assert_int_equal(lys_features_enable(fmod, "a"), EXIT_SUCCESS);
+    assert_null(lys_is_disabled(leaf, 0));
+    data = lyd_parse_mem(ctx, "<l xmlns=\"urn:m\">y</l>", LYD_XML, LYD_OPT_CONFIG);
+    assert_null(data);
+    data = lyd_parse_mem(ctx, "<l xmlns=\"urn:m\">x</l>", LYD_XML, LYD_OPT_CONFIG);
+    assert_non_null(data);
+    lyd_free_withsiblings(data);
+}
+
 static void
 test_lys_getnext2(const struct lys_module *module)
 {
@@ -747,6 +815,49 @@ test_lys_print_mem_tree(void **state)
     free(result);
 }
 
+static void
+test_lys_print_mem_cached(void **state)
+{
+    (void) state; /* unused */
+    const struct lys_module *module;
+    LYS_INFORMAT yang_format = LYS_IN_YIN;
+    char *result = NULL, *result2 = NULL;
+    int rc;
+
+    module = lys_parse_mem(ctx, lys_module_a, yang_format);
+    if (!module) {
+        fail();
+    }
+
+    rc = lys_print_mem(&result, module, LYS_OUT_TREE, NULL, 0, 0);
+    if (rc) {
+        fail();
+    }
+
+    /* printed again from the cache */
+    rc = lys_print_mem(&result2, module, LYS_OUT_TREE, NULL, 0, 0);
+    if (rc) {
+        fail();
+    }
+    assert_ptr_not_equal(result, result2);
+    assert_string_equal(result, result2);
+    free(result2);
+
+    /* the enabled nodes are printed after the features change */
+    rc = lys_features_enable(module, "*");
+    if (rc) {
+        fail();
+    }
+    rc = lys_print_mem(&result2, module, LYS_OUT_TREE, NULL, 0, 0);
+    if (rc) {
+        fail();
+    }
+    assert_string_not_equal(result, result2);
+    free(result2);
+
+    free(result);
+}
+
 static void
 test_lys_print_mem_yang(void **state)
 {
@@ -1575,6 +1686,7 @@ int main(void)
 {
     const struct CMUnitTest tests[] = {
         cmocka_unit_test(test_lys_parse_mem),
+        cmocka_unit_test_setup_teardown(test_lys_parse_mem_strings, setup_f, teardown_f),
         cmocka_unit_test(test_lys_parse_fd),
         cmocka_unit_test(test_lys_parse_path),
         cmocka_unit_test_setup_teardown(test_lys_features_list, setup_f, teardown_f),
@@ -1582,10 +1694,12 @@ int main(void)
         cmocka_unit_test_setup_teardown(test_lys_features_disable, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_lys_features_state, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_lys_is_disabled, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_lys_is_disabled_toggle, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_lys_getnext, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_lys_parent, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_lys_set_private, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_lys_print_mem_tree, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_lys_print_mem_cached, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_lys_print_mem_yang, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_lys_print_mem_yin, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_lys_print_mem_info, setup_f, teardown_f),
@@ -592,6 +592,119 @@ test_lyxml_xmlns_correct_format(void **state)
     lyxml_free(ctx, xml);
 }
 
+static void
+test_lyxml_parse_text(void **state)
+{
+    (void)state;
+    struct lyxml_elem *xml = NULL;
+    char data[8192], expected[8192], *d, *e;
+    int i;
+
+    /* long text with special characters at various offsets around the block and buffer boundaries */
+    d = data + sprintf(data, "<x xmlns=\"urn:a\" a=\"v&amp;'al\">");
+    e = expected;
+    for (i = 0; i < 300; ++i) {
+        d += sprintf(d, "%.*s&lt;\t\xc3\xa1]", i % 23, "abcdefghijklmnopqrstuvw");
+        e += sprintf(e, "%.*s<\t\xc3\xa1]", i % 23, "abcdefghijklmnopqrstuvw");
+        if (!(i % 50)) {
+            d += sprintf(d, "<![CDATA[<a>]]]]>");
+            e += sprintf(e, "<a>]]");
+        }
+    }
+    sprintf(d, "</x>");
+
+    xml = lyxml_parse_mem(ctx, data, 0);
+    assert_ptr_not_equal(xml, NULL);
+    assert_string_equal(expected, xml->content);
+    assert_string_equal("v&'al", lyxml_get_attr(xml, "a", NULL));
+    lyxml_free(ctx, xml);
+
+    /* plain text and attribute values are dictionary strings */
+    xml = lyxml_parse_mem(ctx, "<x xmlns=\"urn:a\" a=\"\">plain value</x>", 0);
+    assert_ptr_not_equal(xml, NULL);
+    d = (char *)lydict_insert(ctx, "plain value", 0);
+    assert_ptr_equal(d, xml->content);
+    lydict_remove(ctx, d);
+    assert_string_equal("", lyxml_get_attr(xml, "a", NULL));
+    lyxml_free(ctx, xml);
+
+    /* invalid control character after a long plain text */
+    strcpy(data, "<x xmlns=\"urn:a\">");
+    memset(data + 17, 'a', 100);
+    strcpy(data + 117, "\x01</x>");
+    xml = lyxml_parse_mem(ctx, data, 0);
+    assert_ptr_equal(xml, NULL);
+
+    /* unterminated content */
+    data[117] = '\0';
+    xml = lyxml_parse_mem(ctx, data, 0);
+    assert_ptr_equal(xml, NULL);
+}
+
+static void
+test_lyxml_dump_text(void **state)
+{
+    (void)state;
+    struct lyxml_elem *xml, *xml2;
+    char data[8192], *d, *str;
+    int i;
+
+    /* special characters at various offsets around the scanned blocks */
+    d = data + sprintf(data, "<x xmlns=\"urn:a\">");
+    for (i = 0; i < 100; ++i) {
+        d += sprintf(d, "%.*s&lt;&gt;\"&amp;\\", i % 23, "abcdefghijklmnopqrstuvw");
+    }
+    sprintf(d, "</x>");
+
+    xml = lyxml_parse_mem(ctx, data, 0);
+    assert_ptr_not_equal(xml, NULL);
+    assert_int_equal(lyxml_print_mem(&str, xml, 0), strlen(data));
+    assert_string_equal(str, data);
+
+    xml2 = lyxml_parse_mem(ctx, str, 0);
+    assert_ptr_not_equal(xml2, NULL);
+    assert_string_equal(xml->content, xml2->content);
+    free(str);
+    lyxml_free(ctx, xml);
+    lyxml_free(ctx, xml2);
+}
+
+static void
+test_lyxml_ns_scope(void **state)
+{
+    (void)state;
+    struct lyxml_elem *xml = NULL, *b, *c;
+    struct lyxml_attr *attr;
+
+    xml = lyxml_parse_mem(ctx, "<a xmlns=\"urn:d1\" xmlns:p=\"urn:p1\"><p:b xmlns:p=\"urn:p2\" p:at=\"v\"><c xmlns=\"\"/>"
+                          "<p:c/></p:b><p:d/><e/></a>", 0);
+    assert_ptr_not_equal(xml, NULL);
+    assert_string_equal("urn:d1", xml->ns->value);
+
+    /* shadowed prefix */
+    b = xml->child;
+    assert_string_equal("urn:p2", b->ns->value);
+    for (attr = b->attr; attr->type != LYXML_ATTR_STD; attr = attr->next);
+    assert_string_equal("urn:p2", attr->ns->value);
+
+    /* empty default namespace */
+    c = b->child;
+    assert_string_equal("", c->ns->value);
+    assert_string_equal("urn:p2", c->next->ns->value);
+
+    /* restored after the scope ends */
+    assert_string_equal("urn:p1", b->next->ns->value);
+    assert_string_equal("urn:d1", b->next->next->ns->value);
+    lyxml_free(ctx, xml);
+
+    /* undeclared prefix */
+    xml = lyxml_parse_mem(ctx, "<a xmlns:p=\"urn:p1\"><p:b/></a><p:b/>", LYXML_PARSE_MULTIROOT);
+    assert_ptr_not_equal(xml, NULL);
+    assert_string_equal("urn:p1", xml->child->ns->value);
+    assert_ptr_equal(xml->next->ns, NULL);
+    lyxml_free_withsiblings(ctx, xml);
+}
+
 int main(void)
 {
     const struct CMUnitTest tests[] = {
@@ -609,6 +722,9 @@ int main(void)
         cmocka_unit_test_setup_teardown(test_lyxml_free_withsiblings, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_lyxml_xmlns_wrong_format, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_lyxml_xmlns_correct_format, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_lyxml_parse_text, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_lyxml_dump_text, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_lyxml_ns_scope, setup_f, teardown_f),
     };
 
     return cmocka_run_group_tests(tests, NULL, NULL);
@@ -15,11 +15,13 @@
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <setjmp.h>
 #include <cmocka.h>
 
 #include "tests/config.h"
 #include "libyang.h"
+#include "user_xpath.h"
 
 struct state {
     struct ly_ctx *ctx;
@@ -285,6 +287,196 @@ test_advanced(void **state)
     st->set = NULL;
 }
 
+static void
+test_key_predicates(void **state)
+{
+    struct state *st = (*state);
+
+    st->set = lyd_find_path(st->dt, "/ietf-interfaces:interfaces/interface[name='iface1']/ietf-ip:ipv4/ietf-ip:address[ietf-ip:ip='172.0.0.1']");
+    assert_ptr_not_equal(st->set, NULL);
+    assert_int_equal(st->set->number, 1);
+    assert_string_equal(((struct lyd_node_leaf_list *)st->set->set.d[0]->child)->value_str, "172.0.0.1");
+    ly_set_free(st->set);
+    st->set = NULL;
+
+    st->set = lyd_find_path(st->dt, "/ietf-interfaces:interfaces/interface[name='iface1']/ietf-ip:ipv4/ietf-ip:address[ietf-ip:ip='10.0.0.9']");
+    assert_ptr_not_equal(st->set, NULL);
+    assert_int_equal(st->set->number, 0);
+    ly_set_free(st->set);
+    st->set = NULL;
+
+    st->set = lyd_find_path(st->dt, "/ietf-interfaces:interfaces/interface[name='iface1']/ietf-ip:ipv4/ietf-ip:address[ip='10.0.0.1']");
+    assert_ptr_not_equal(st->set, NULL);
+    assert_int_equal(st->set->number, 1);
+    ly_set_free(st->set);
+    st->set = NULL;
+
+    st->set = lyd_find_path(st->dt, "/ietf-interfaces:interfaces/interface[name='iface1']/ietf-ip:ipv4/ietf-ip:address[ietf-ip:ip='10.0.0.1'][1]/ietf-ip:netmask");
+    assert_ptr_not_equal(st->set, NULL);
+    assert_int_equal(st->set->number, 1);
+    assert_string_equal(((struct lyd_node_leaf_list *)st->set->set.d[0])->value_str, "255.0.0.0");
+    ly_set_free(st->set);
+    st->set = NULL;
+
+    st->set = lyd_find_path(st->dt, "/ietf-interfaces:interfaces/interface/ietf-ip:ipv4/ietf-ip:address[ietf-ip:ip='10.0.0.5']");
+    assert_ptr_not_equal(st->set, NULL);
+    assert_int_equal(st->set->number, 1);
+    ly_set_free(st->set);
+    st->set = NULL;
+}
+
+static void
+test_union_order(void **state)
+{
+    struct state *st = (*state);
+    struct lyd_node *next, *elem;
+    unsigned int i = 0;
+
+    st->set = lyd_find_path(st->dt, "//ietf-ip:prefix-length | //ietf-ip:netmask | //ietf-ip:ip");
+    assert_ptr_not_equal(st->set, NULL);
+
+    /* the nodes are in the data order */
+    LY_TREE_DFS_BEGIN(st->dt, next, elem) {
+        if (!strcmp(elem->schema->name, "ip") || !strcmp(elem->schema->name, "netmask")
+                || !strcmp(elem->schema->name, "prefix-length")) {
+            assert_true(i < st->set->number);
+            assert_ptr_equal(st->set->set.d[i], elem);
+            ++i;
+        }
+        LY_TREE_DFS_END(st->dt, next, elem);
+    }
+    assert_int_equal(i, st->set->number);
+    assert_true(i > 8);
+
+    ly_set_free(st->set);
+    st->set = NULL;
+}
+
+static void
+test_existence(void **state)
+{
+    struct state *st = (*state);
+
+    st->set = lyd_find_path(st->dt, "/ietf-interfaces:interfaces/interface[boolean(.//ietf-ip:neighbor)]");
+    assert_ptr_not_equal(st->set, NULL);
+    assert_int_equal(st->set->number, 2);
+    ly_set_free(st->set);
+    st->set = NULL;
+
+    st->set = lyd_find_path(st->dt, "/ietf-interfaces:interfaces/interface[not(ietf-ip:ipv6//ietf-ip:temporary-valid-lifetime)]");
+    assert_ptr_not_equal(st->set, NULL);
+    assert_int_equal(st->set->number, 0);
+    ly_set_free(st->set);
+    st->set = NULL;
+
+    st->set = lyd_find_path(st->dt, "/ietf-interfaces:interfaces/interface[.//ietf-ip:netmask]/name");
+    assert_ptr_not_equal(st->set, NULL);
+    assert_int_equal(st->set->number, 2);
+    ly_set_free(st->set);
+    st->set = NULL;
+
+    st->set = lyd_find_path(st->dt, "/ietf-interfaces:interfaces/interface[.//ietf-ip:ip = '10.0.0.2']/name");
+    assert_ptr_not_equal(st->set, NULL);
+    assert_int_equal(st->set->number, 1);
+    assert_string_equal(((struct lyd_node_leaf_list *)st->set->set.d[0])->value_str, "iface1");
+    ly_set_free(st->set);
+    st->set = NULL;
+
+    st->set = lyd_find_path(st->dt, "/ietf-interfaces:interfaces/interface[count(.//ietf-ip:ip) = 5]");
+    assert_ptr_not_equal(st->set, NULL);
+    assert_int_equal(st->set->number, 2);
+    ly_set_free(st->set);
+    st->set = NULL;
+
+    st->set = lyd_find_path(st->dt, "/ietf-interfaces:interfaces/interface[.//ietf-ip:address[ietf-ip:ip = '172.0.0.5']]/name");
+    assert_ptr_not_equal(st->set, NULL);
+    assert_int_equal(st->set->number, 1);
+    assert_string_equal(((struct lyd_node_leaf_list *)st->set->set.d[0])->value_str, "iface2");
+    ly_set_free(st->set);
+    st->set = NULL;
+}
+
+static void
+test_numeric_compare(void **state)
+{
+    struct state *st = (*state);
+    struct lyd_node *dt;
+    const char *schema =
+    "module num {"
+        "namespace urn:num;"
+        "prefix n;"
+        "container c {"
+            "leaf d { type decimal64 { fraction-digits 2; } }"
+            "leaf-list u { type union { type int8; type string; } }"
+        "}"
+    "}";
+
+    st->set = lyd_find_path(st->dt, "/ietf-interfaces:interfaces/interface[ietf-ip:ipv6/ietf-ip:dup-addr-detect-transmits > 60]/name");
+    assert_ptr_not_equal(st->set, NULL);
+    assert_int_equal(st->set->number, 1);
+    assert_string_equal(((struct lyd_node_leaf_list *)st->set->set.d[0])->value_str, "iface2");
+    ly_set_free(st->set);
+    st->set = NULL;
+
+    st->set = lyd_find_path(st->dt, "/ietf-interfaces:interfaces/interface[60 >= ietf-ip:ipv6/ietf-ip:dup-addr-detect-transmits]/name");
+    assert_ptr_not_equal(st->set, NULL);
+    assert_int_equal(st->set->number, 1);
+    assert_string_equal(((struct lyd_node_leaf_list *)st->set->set.d[0])->value_str, "iface1");
+    ly_set_free(st->set);
+    st->set = NULL;
+
+    st->set = lyd_find_path(st->dt, "/ietf-interfaces:interfaces/interface[ietf-ip:ipv6/ietf-ip:dup-addr-detect-transmits >= '52']");
+    assert_ptr_not_equal(st->set, NULL);
+    assert_int_equal(st->set->number, 2);
+    ly_set_free(st->set);
+    st->set = NULL;
+
+    st->set = lyd_find_path(st->dt, "/ietf-interfaces:interfaces/interface[ietf-ip:ipv6/ietf-ip:mtu > ietf-ip:ipv4/ietf-ip:mtu]/name");
+    assert_ptr_not_equal(st->set, NULL);
+    assert_int_equal(st->set->number, 1);
+    assert_string_equal(((struct lyd_node_leaf_list *)st->set->set.d[0])->value_str, "iface1");
+    ly_set_free(st->set);
+    st->set = NULL;
+
+    st->set = lyd_find_path(st->dt, "/ietf-interfaces:interfaces/interface/ietf-ip:ipv4/ietf-ip:address[ietf-ip:prefix-length = 16.0]");
+    assert_ptr_not_equal(st->set, NULL);
+    assert_int_equal(st->set->number, 2);
+    ly_set_free(st->set);
+    st->set = NULL;
+
+    assert_ptr_not_equal(lys_parse_mem(st->ctx, schema, LYS_IN_YANG), NULL);
+    dt = lyd_parse_mem(st->ctx, "<c xmlns=\"urn:num\"><d>1.25</d><u>5</u><u>abc</u></c>", LYD_XML, LYD_OPT_CONFIG);
+    assert_ptr_not_equal(dt, NULL);
+
+    st->set = lyd_find_path(dt, "/num:c[d = 1.25]");
+    assert_ptr_not_equal(st->set, NULL);
+    assert_int_equal(st->set->number, 1);
+    ly_set_free(st->set);
+
+    st->set = lyd_find_path(dt, "/num:c[d > 1.24]");
+    assert_ptr_not_equal(st->set, NULL);
+    assert_int_equal(st->set->number, 1);
+    ly_set_free(st->set);
+
+    st->set = lyd_find_path(dt, "/num:c[d < 1.25]");
+    assert_ptr_not_equal(st->set, NULL);
+    assert_int_equal(st->set->number, 0);
+    ly_set_free(st->set);
+
+    st->set = lyd_find_path(dt, "/num:c[u > 4]");
+    assert_ptr_not_equal(st->set, NULL);
+    assert_int_equal(st->set->number, 1);
+    ly_set_free(st->set);
+
+    st->set = lyd_find_path(dt, "/num:c[u > 5]");
+    assert_ptr_not_equal(st->set, NULL);
+    assert_int_equal(st->set->number, 0);
+    ly_set_free(st->set);
+    st->set = NULL;
+
+    lyd_free_withsiblings(dt);
+}
+
 static void
 test_functions_operators(void **state)
 {
@@ -361,13 +553,85 @@ test_functions_operators(void **state)
     st->set = NULL;
 }
 
+static int
+test_ends_with_clb(const struct lyxp_value *args, uint16_t arg_count, const struct lyd_node *cur_node,
+                   struct lyxp_value *result)
+{
+    size_t len, suf_len;
+
+    (void)arg_count;
+    (void)cur_node;
+    assert_int_equal(args[0].type, LYXP_VALUE_STRING);
+    assert_int_equal(args[1].type, LYXP_VALUE_STRING);
+
+    len = strlen(args[0].value.string);
+    suf_len = strlen(args[1].value.string);
+    result->type = LYXP_VALUE_BOOLEAN;
+    result->value.boolean = (len >= suf_len) && !strcmp(args[0].value.string + len - suf_len, args[1].value.string);
+    return 0;
+}
+
+static int
+test_first_clb(const struct lyxp_value *args, uint16_t arg_count, const struct lyd_node *cur_node,
+               struct lyxp_value *result)
+{
+    (void)arg_count;
+    (void)cur_node;
+    assert_int_equal(args[0].type, LYXP_VALUE_NODES);
+
+    result->type = LYXP_VALUE_NODES;
+    if (args[0].value.nodes.count) {
+        result->value.nodes.nodes = malloc(sizeof *result->value.nodes.nodes);
+        result->value.nodes.nodes[0] = args[0].value.nodes.nodes[0];
+        result->value.nodes.count = 1;
+    }
+    return 0;
+}
+
+static struct lyxp_func_list test_funcs[] = {
+    {"ends-with", 2, 2, 0, test_ends_with_clb, NULL},
+    {"first", 1, 1, LYXP_FUNC_NODE_ARGS, test_first_clb, NULL},
+    {NULL, 0, 0, 0, NULL, NULL}
+};
+
+static void
+test_user_functions(void **state)
+{
+    struct state *st = (*state);
+
+    assert_int_equal(ly_register_xpath_funcs(test_funcs, "test"), 0);
+
+    st->set = lyd_find_path(st->dt, "/ietf-interfaces:interfaces/interface/name[ends-with(., 'e2')]");
+    assert_ptr_not_equal(st->set, NULL);
+    assert_int_equal(st->set->number, 1);
+    assert_string_equal(((struct lyd_node_leaf_list *)st->set->set.d[0])->value_str, "iface2");
+    ly_set_free(st->set);
+    st->set = NULL;
+
+    st->set = lyd_find_path(st->dt, "first(//ietf-ip:ip)");
+    assert_ptr_not_equal(st->set, NULL);
+    assert_int_equal(st->set->number, 1);
+    assert_string_equal(((struct lyd_node_leaf_list *)st->set->set.d[0])->value_str, "10.0.0.1");
+    ly_set_free(st->set);
+    st->set = NULL;
+
+    /* wrong argument count */
+    st->set = lyd_find_path(st->dt, "/ietf-interfaces:interfaces/interface/name[ends-with(.)]");
+    assert_ptr_equal(st->set, NULL);
+}
+
 int main(void)
 {
     const struct CMUnitTest tests[] = {
                     cmocka_unit_test_setup_teardown(test_invalid, setup_f, teardown_f),
                     cmocka_unit_test_setup_teardown(test_simple, setup_f, teardown_f),
                     cmocka_unit_test_setup_teardown(test_advanced, setup_f, teardown_f),
+                    cmocka_unit_test_setup_teardown(test_key_predicates, setup_f, teardown_f),
+                    cmocka_unit_test_setup_teardown(test_union_order, setup_f, teardown_f),
+                    cmocka_unit_test_setup_teardown(test_existence, setup_f, teardown_f),
+                    cmocka_unit_test_setup_teardown(test_numeric_compare, setup_f, teardown_f),
                     cmocka_unit_test_setup_teardown(test_functions_operators, setup_f, teardown_f),
+                    cmocka_unit_test_setup_teardown(test_user_functions, setup_f, teardown_f),
                     };
 
     return cmocka_run_group_tests(tests, NULL, NULL);
@@ -15,11 +15,13 @@
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <setjmp.h>
 #include <cmocka.h>
 
 #include "tests/config.h"
 #include "libyang.h"
+#include "../../src/context.h"
 
 struct state {
     struct ly_ctx *ctx;
@@ -111,6 +113,46 @@ test_func_re_match(void **state)
     assert_int_equal(st->set->number, 2);
 }
 
+static void
+test_func_re_match_cache(void **state)
+{
+    struct state *st = (*state);
+    char path[64];
+    int i;
+
+    st->dt = lyd_parse_mem(st->ctx, data1, LYD_XML, LYD_OPT_CONFIG);
+    assert_ptr_not_equal(st->dt, NULL);
+
+    /* the pattern is compiled once for all the nodes */
+    st->set = lyd_find_path(st->dt, "/xpath-1.1:top/*[re-match(., 'a+b+c+')]");
+    assert_ptr_not_equal(st->set, NULL);
+    assert_int_equal(st->set->number, 2);
+    ly_set_free(st->set);
+    st->set = NULL;
+    assert_ptr_not_equal(st->ctx->regex_cache[0].pattern, NULL);
+    assert_string_equal(st->ctx->regex_cache[0].pattern, "a+b+c+");
+    assert_ptr_equal(st->ctx->regex_cache[1].pattern, NULL);
+
+    /* more patterns than the cache holds */
+    for (i = 1; i <= LY_REGEX_CACHE_SIZE + 2; ++i) {
+        sprintf(path, "/xpath-1.1:top/*[re-match(., 'a{%d}b+')]", i);
+        st->set = lyd_find_path(st->dt, path);
+        assert_ptr_not_equal(st->set, NULL);
+        assert_int_equal(st->set->number, (i == 2) ? 1 : 0);
+        ly_set_free(st->set);
+        st->set = NULL;
+    }
+    for (i = 0; i < LY_REGEX_CACHE_SIZE; ++i) {
+        assert_ptr_not_equal(st->ctx->regex_cache[i].pattern, NULL);
+        assert_string_not_equal(st->ctx->regex_cache[i].pattern, "a+b+c+");
+    }
+
+    /* an evicted pattern is compiled again */
+    st->set = lyd_find_path(st->dt, "/xpath-1.1:top/*[re-match(., 'a+b+c+')]");
+    assert_ptr_not_equal(st->set, NULL);
+    assert_int_equal(st->set->number, 2);
+}
+
 static void
 test_func_deref(void **state)
 {
@@ -231,6 +273,44 @@ test_func_derived_from_or_self4(void **state)
     assert_int_equal(st->set->number, 1);
 }
 
+static void
+test_func_derived_from_transitive(void **state)
+{
+    struct state *st = (*state);
+    const char *schema = "module x3 { yang-version 1.1; namespace urn:x3; prefix x3; import xpath-1.1 { prefix xp; }"
+                         "identity ident3 { base xp:ident2; } }";
+
+    /* the identities index is built again with the new module */
+    st->dt = lyd_parse_mem(st->ctx, data2, LYD_XML, LYD_OPT_CONFIG);
+    assert_ptr_not_equal(st->dt, NULL);
+    lyd_free_withsiblings(st->dt);
+    assert_ptr_not_equal(lys_parse_mem(st->ctx, schema, LYS_IN_YANG), NULL);
+
+    st->dt = lyd_parse_mem(st->ctx, "<top xmlns=\"urn:xpath-1.1\"><identref xmlns:x=\"urn:x3\">x:ident3</identref></top>",
+                           LYD_XML, LYD_OPT_CONFIG);
+    assert_ptr_not_equal(st->dt, NULL);
+
+    st->set = lyd_find_path(st->dt, "/xpath-1.1:top/*[derived-from(., 'xpath-1.1:ident1')]");
+    assert_ptr_not_equal(st->set, NULL);
+    assert_int_equal(st->set->number, 1);
+    ly_set_free(st->set);
+
+    st->set = lyd_find_path(st->dt, "/xpath-1.1:top/*[derived-from-or-self(., 'x3:ident3')]");
+    assert_ptr_not_equal(st->set, NULL);
+    assert_int_equal(st->set->number, 1);
+    ly_set_free(st->set);
+
+    st->set = lyd_find_path(st->dt, "/xpath-1.1:top/*[derived-from(., 'x3:ident3')]");
+    assert_ptr_not_equal(st->set, NULL);
+    assert_int_equal(st->set->number, 0);
+    lyd_free_withsiblings(st->dt);
+
+    /* the base itself is not a valid value */
+    st->dt = lyd_parse_mem(st->ctx, "<top xmlns=\"urn:xpath-1.1\"><identref>ident1</identref></top>", LYD_XML,
+                           LYD_OPT_CONFIG);
+    assert_ptr_equal(st->dt, NULL);
+}
+
 static void
 test_func_enum_value1(void **state)
 {
@@ -288,6 +368,7 @@ main(void)
 {
     const struct CMUnitTest tests[] = {
         cmocka_unit_test_setup_teardown(test_func_re_match, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_func_re_match_cache, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_func_deref, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_func_derived_from1, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_func_derived_from2, setup_f, teardown_f),
@@ -297,6 +378,7 @@ main(void)
         cmocka_unit_test_setup_teardown(test_func_derived_from_or_self2, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_func_derived_from_or_self3, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_func_derived_from_or_self4, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_func_derived_from_transitive, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_func_enum_value1, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_func_enum_value2, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_func_bit_is_set1, setup_f, teardown_f),
@@ -0,0 +1,56 @@
+#!/bin/sh
+#
+# Run a program under callgrind and check the number of the instructions executed
+# while the instrumentation was on against its threshold.
+#
+# Usage: check_instr.sh [-u] THRESHOLDS NAME COMMAND [ARG]...
+#
+# THRESHOLDS is a file with lines "NAME COUNT", NAME identifies the test. With -u, the threshold
+# of the test is set to the measured count with a 10% margin instead of checking it.
+
+update=0
+if [ "$1" = "-u" ]; then
+    update=1
+    shift
+fi
+if [ $# -lt 3 ]; then
+    echo "Usage: $0 [-u] THRESHOLDS NAME COMMAND [ARG]..." >&2
+    exit 2
+fi
+thresholds=$1
+name=$2
+shift 2
+
+out="callgrind.out.$name"
+rm -f "$out"
+valgrind --tool=callgrind --instr-atstart=no --callgrind-out-file="$out" "$@" > /dev/null 2>&1 || {
+    echo "$name: the program failed" >&2
+    exit 1
+}
+
+count=$(awk '/^(summary|totals):/ { print $2; exit }' "$out")
+if [ -z "$count" ]; then
+    echo "$name: no instruction count in $out" >&2
+    exit 1
+fi
+
+if [ $update -eq 1 ]; then
+    limit=$((count + count / 10))
+    awk -v n="$name" -v l="$limit" '$1 == n { $2 = l; found = 1 } { print } END { if (!found) print n, l }' \
+        "$thresholds" > "$thresholds.tmp" && mv "$thresholds.tmp" "$thresholds"
+    echo "$name: $count instructions, threshold set to $limit"
+    exit 0
+fi
+
+limit=$(awk -v n="$name" '$1 == n { print $2; exit }' "$thresholds")
+if [ -z "$limit" ]; then
+    echo "$name: no threshold in $thresholds" >&2
+    exit 1
+fi
+
+echo "$name: $count instructions (threshold $limit)"
+if [ "$count" -gt "$limit" ]; then
+    echo "$name: instruction count exceeds the threshold by $((count * 100 / limit - 100))%" >&2
+    exit 1
+fi
+exit 0
@@ -0,0 +1,70 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <valgrind/callgrind.h>
+
+#include "tests/config.h"
+#include "libyang.h"
+
+/* print the data in the given format and parse them back, both instrumented */
+int
+main(int argc, char **argv)
+{
+    int i, ret = 1;
+    char *path, *str = NULL;
+    LYD_FORMAT format;
+    struct ly_ctx *ctx = NULL;
+    struct lyd_node *data = NULL, *data2 = NULL;
+
+    if (argc < 4) {
+        return 1;
+    }
+
+    if (!strcmp(argv[1], "json")) {
+        format = LYD_JSON;
+    } else if (!strcmp(argv[1], "lyb")) {
+        format = LYD_LYB;
+    } else {
+        return 1;
+    }
+
+    ctx = ly_ctx_new(NULL, 0);
+    if (!ctx) {
+        return 1;
+    }
+
+    for (i = 2; i < argc - 1; ++i) {
+        asprintf(&path, "%s/callgrind/files/%s", TESTS_DIR, argv[i]);
+        if (!lys_parse_path(ctx, path, LYS_YANG)) {
+            free(path);
+            goto finish;
+        }
+        free(path);
+    }
+
+    asprintf(&path, "%s/callgrind/files/%s", TESTS_DIR, argv[argc - 1]);
+    data = lyd_parse_path(ctx, path, LYD_XML, LYD_OPT_STRICT | LYD_OPT_DATA_NO_YANGLIB);
+    free(path);
+    if (!data) {
+        goto finish;
+    }
+
+    CALLGRIND_START_INSTRUMENTATION;
+    if (!lyd_print_mem(&str, data, format, LYP_WITHSIBLINGS)) {
+        data2 = lyd_parse_mem(ctx, str, format, LYD_OPT_STRICT | LYD_OPT_DATA_NO_YANGLIB);
+    }
+    CALLGRIND_STOP_INSTRUMENTATION;
+
+    if (data2) {
+        ret = 0;
+    }
+
+finish:
+    free(str);
+    lyd_free_withsiblings(data);
+    lyd_free_withsiblings(data2);
+    ly_ctx_destroy(ctx, NULL);
+    return ret;
+}
@@ -0,0 +1,85 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <valgrind/callgrind.h>
+
+#include "tests/config.h"
+#include "libyang.h"
+
+#define SCHEMA TESTS_DIR "/callgrind/files/xpath.yang"
+
+/* number of the instances of each list */
+#define LIST_SIZE 1000
+
+static const char *paths[] = {
+    "/xpath:cont1/list1[key1='a500']",
+    "/xpath:cont1/list2[key2=/xpath:cont1/list1[key1='a999']/key1]",
+    "/xpath:cont1/list1[starts-with(key1, 'a1')]",
+    "/xpath:cont1/list2[contains(substring(key2, 2, 2), '5')]/key2",
+    "/xpath:cont1/*[position() mod 100 = 0]",
+    "//key1[. = 'a999']",
+    "/xpath:cont1[count(list1) = count(list2)]",
+};
+
+int
+main(void)
+{
+    int ret = 0;
+    unsigned int i;
+    char path[64], key[16];
+    struct ly_ctx *ctx = NULL;
+    struct lyd_node *data = NULL, *node;
+    struct ly_set *set;
+
+    ctx = ly_ctx_new(NULL, 0);
+    if (!ctx) {
+        ret = 1;
+        goto finish;
+    }
+
+    if (!lys_parse_path(ctx, SCHEMA, LYS_YANG)) {
+        ret = 1;
+        goto finish;
+    }
+
+    /* the keys of both lists match each other to satisfy the must conditions */
+    for (i = 0; i < LIST_SIZE; ++i) {
+        sprintf(key, "a%u", i);
+        sprintf(path, "/xpath:cont1/list1[key1='%s']", key);
+        node = lyd_new_path(data, ctx, path, NULL, 0, 0);
+        if (!node) {
+            ret = 1;
+            goto finish;
+        }
+        if (!data) {
+            data = node;
+        }
+        sprintf(path, "/xpath:cont1/list2[key2='%s']", key);
+        if (!lyd_new_path(data, ctx, path, NULL, 0, 0)) {
+            ret = 1;
+            goto finish;
+        }
+    }
+    if (lyd_validate(&data, LYD_OPT_CONFIG | LYD_OPT_DATA_NO_YANGLIB, NULL)) {
+        ret = 1;
+        goto finish;
+    }
+
+    CALLGRIND_START_INSTRUMENTATION;
+    for (i = 0; i < sizeof paths / sizeof *paths; ++i) {
+        set = lyd_find_path(data, paths[i]);
+        if (!set || !set->number) {
+            ly_set_free(set);
+            ret = 1;
+            break;
+        }
+        ly_set_free(set);
+    }
+    CALLGRIND_STOP_INSTRUMENTATION;
+
+finish:
+    lyd_free_withsiblings(data);
+    ly_ctx_destroy(ctx, NULL);
+    return ret;
+}
@@ -540,6 +540,93 @@ test_val_diff(void **state)
     lyd_free_val_diff(diff);
 }
 
+static void
+test_val_diff_nodup(void **state)
+{
+    struct state *st = (*state);
+    struct lyd_difflist *diff;
+    struct lyd_node *node;
+    int ret;
+
+    st->dt = lyd_new_path(NULL, st->ctx, "/defaults2:l1[k='when-true']", NULL, 0, 0);
+    assert_non_null(st->dt);
+
+    /* not supported without LYD_OPT_VAL_DIFF */
+    ret = lyd_validate_modules(&st->dt, &st->mod2, 1, LYD_OPT_CONFIG | LYD_OPT_VAL_DIFF_NODUP, &diff);
+    assert_int_not_equal(ret, 0);
+
+    ret = lyd_validate_modules(&st->dt, &st->mod2, 1, LYD_OPT_CONFIG | LYD_OPT_VAL_DIFF | LYD_OPT_VAL_DIFF_NODUP, &diff);
+    assert_int_equal(ret, 0);
+
+    /* the created subtrees are the nodes in the tree */
+    assert_int_equal(diff->type[0], LYD_DIFF_CREATED);
+    assert_string_equal(diff->second[0]->schema->name, "cont1");
+    assert_ptr_equal(diff->first[0], diff->second[0]->parent);
+    assert_int_equal(diff->type[1], LYD_DIFF_CREATED);
+    assert_string_equal(diff->second[1]->schema->name, "dflt2");
+    assert_int_equal(diff->type[2], LYD_DIFF_END);
+    LY_TREE_FOR(st->dt, node) {
+        if (node == diff->second[1]) {
+            break;
+        }
+    }
+    assert_non_null(node);
+
+    /* the tree keeps them */
+    lyd_free_val_diff(diff);
+    assert_int_equal(lyd_print_mem(&(st->xml), st->dt, LYD_XML, LYP_WITHSIBLINGS | LYP_WD_ALL), 0);
+    assert_non_null(strstr(st->xml, "dflt2"));
+    assert_non_null(strstr(st->xml, "dflt1"));
+}
+
+static void
+test_wd_virtual(void **state)
+{
+    struct state *st = (*state);
+    const char *xml = "<l1 xmlns=\"urn:defaults2\"><k>when-true</k></l1>";
+    struct lyd_node *node;
+    int ret;
+
+    st->dt = lyd_parse_mem(st->ctx, xml, LYD_XML, LYD_OPT_CONFIG | LYD_OPT_WD_VIRTUAL);
+    assert_non_null(st->dt);
+
+    /* only the explicit nodes are stored */
+    assert_ptr_equal(st->dt->prev, st->dt);
+    assert_string_equal(st->dt->child->schema->name, "k");
+    assert_null(st->dt->child->next);
+    assert_int_equal(lyd_print_mem(&(st->xml), st->dt, LYD_XML, LYP_WITHSIBLINGS | LYP_WD_ALL), 0);
+    assert_string_equal(st->xml, xml);
+    free(st->xml);
+    st->xml = NULL;
+
+    ret = lyd_validate_modules(&st->dt, &st->mod2, 1, LYD_OPT_CONFIG | LYD_OPT_WD_VIRTUAL, NULL);
+    assert_int_equal(ret, 0);
+    assert_ptr_equal(st->dt->prev, st->dt);
+    assert_null(st->dt->child->next);
+
+    /* not supported combination */
+    ret = lyd_validate(&st->dt, LYD_OPT_CONFIG | LYD_OPT_WD_VIRTUAL | LYD_OPT_VAL_INCREMENTAL, NULL);
+    assert_int_not_equal(ret, 0);
+
+    /* materialize the defaults */
+    ret = lyd_validate_modules(&st->dt, &st->mod2, 1, LYD_OPT_CONFIG, NULL);
+    assert_int_equal(ret, 0);
+    node = st->dt->next;
+    assert_non_null(node);
+    assert_string_equal(node->schema->name, "dflt2");
+    assert_int_equal(node->dflt, 1);
+    node = st->dt->child->next;
+    assert_non_null(node);
+    assert_string_equal(node->schema->name, "cont1");
+    assert_string_equal(node->child->child->schema->name, "dflt1");
+
+    /* and free them again, also the ones of the other modules */
+    ret = lyd_validate(&st->dt, LYD_OPT_CONFIG | LYD_OPT_WD_VIRTUAL, NULL);
+    assert_int_equal(ret, 0);
+    assert_ptr_equal(st->dt->prev, st->dt);
+    assert_null(st->dt->child->next);
+}
+
 static void
 test_feature(void **state)
 {
@@ -690,6 +777,8 @@ int main(void)
                     cmocka_unit_test_setup_teardown(test_rpc_augment, setup_f, teardown_f),
                     cmocka_unit_test_setup_teardown(test_notif_default, setup_f, teardown_f),
                     cmocka_unit_test_setup_teardown(test_val_diff, setup_f, teardown_f),
+                    cmocka_unit_test_setup_teardown(test_val_diff_nodup, setup_f, teardown_f),
+                    cmocka_unit_test_setup_teardown(test_wd_virtual, setup_f, teardown_f),
                     cmocka_unit_test_setup_teardown(test_feature, setup_f, teardown_f),
                     cmocka_unit_test_setup_teardown(test_leaflist_in10, setup_clean_f, teardown_f),
                     cmocka_unit_test_setup_teardown(test_leaflist_yang, setup_clean_f, teardown_f),
@@ -13,7 +13,9 @@
  */
 
 #include <stdio.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <setjmp.h>
 #include <stdarg.h>
 #include <cmocka.h>
@@ -694,6 +696,409 @@ test_parse_string(void **state)
     assert_ptr_equal(st->dt, NULL);
 }
 
+static void
+test_parse_string_inplace(void **state)
+{
+    struct state *st;
+    const char *yang = "module t {namespace urn:t; prefix t;"
+                       "container c {leaf s {type string;} leaf e {type string;} leaf u {type string;} leaf q {type string;}"
+                       "leaf-list ll {type string;} anydata any;}}";
+    const char *data = "{\"t:c\":{\"s\":\"plain\",\"\\u0065\":\"\",\"u\":\"\\u00e1\xc3\xa1\",\"t:q\":\"a\\\"b\","
+                       "\"ll\":[\"x\",\"\",\"y\\n\"],\"any\":\"\"}}";
+    struct lyd_node *node;
+
+    if (setup_f(&st, TESTS_DIR "/schema/yin/ietf", NULL, 0)) {
+        fail();
+    }
+
+    (*state) = st;
+
+    assert_non_null(lys_parse_mem(st->ctx, yang, LYS_IN_YANG));
+
+    st->dt = lyd_parse_mem(st->ctx, data, LYD_JSON, LYD_OPT_CONFIG | LYD_OPT_STRICT);
+    assert_non_null(st->dt);
+
+    node = st->dt->child;
+    assert_string_equal(node->schema->name, "s");
+    assert_string_equal(((struct lyd_node_leaf_list *)node)->value_str, "plain");
+    node = node->next;
+    assert_string_equal(node->schema->name, "e");
+    assert_string_equal(((struct lyd_node_leaf_list *)node)->value_str, "");
+    node = node->next;
+    assert_string_equal(((struct lyd_node_leaf_list *)node)->value_str, "\xc3\xa1\xc3\xa1");
+    node = node->next;
+    assert_string_equal(((struct lyd_node_leaf_list *)node)->value_str, "a\"b");
+    node = node->next;
+    assert_string_equal(((struct lyd_node_leaf_list *)node)->value_str, "x");
+    node = node->next;
+    assert_string_equal(((struct lyd_node_leaf_list *)node)->value_str, "");
+    node = node->next;
+    assert_string_equal(((struct lyd_node_leaf_list *)node)->value_str, "y\n");
+    node = node->next;
+    assert_string_equal(node->schema->name, "any");
+    assert_string_equal(((struct lyd_node_anydata *)node)->value.str, "");
+    lyd_free_withsiblings(st->dt);
+
+    /* unknown names are reported whole */
+    st->dt = lyd_parse_mem(st->ctx, "{\"t:c\":{\"sx\":\"v\"}}", LYD_JSON, LYD_OPT_CONFIG | LYD_OPT_STRICT);
+    assert_null(st->dt);
+    assert_string_equal(ly_errmsg(st->ctx), "Unknown element \"sx\".");
+
+    st->dt = lyd_parse_mem(st->ctx, "{\"t:c\":{\"t:s\":\"v\",\"t\":\"v\"}}", LYD_JSON, LYD_OPT_CONFIG | LYD_OPT_STRICT);
+    assert_null(st->dt);
+    assert_string_equal(ly_errmsg(st->ctx), "Unknown element \"t\".");
+
+    st->dt = lyd_parse_mem(st->ctx, "{\"tt:c\":{}}", LYD_JSON, LYD_OPT_CONFIG | LYD_OPT_STRICT);
+    assert_null(st->dt);
+}
+
+static void
+test_parse_member_names(void **state)
+{
+    struct state *st;
+    const char *yang = "module n {namespace urn:n; prefix n; feature f;"
+                       "container c {leaf x {type string;} choice ch {leaf y {type string;} case z {leaf z {type string;}}}"
+                       "leaf fx {if-feature f; type string;}} leaf top {type string;}}";
+    const char *yang2 = "module n2 {namespace urn:n2; prefix n2; import n {prefix n;}"
+                        "augment /n:c {leaf x {type int8;}}}";
+    const char *data = "{\"n:c\":{\"x\":\"a\",\"z\":\"b\",\"n2:x\":5},\"n:top\":\"t\"}";
+    const struct lys_module *mod;
+    struct lyd_node *node;
+
+    if (setup_f(&st, TESTS_DIR "/schema/yin/ietf", NULL, 0)) {
+        fail();
+    }
+
+    (*state) = st;
+
+    mod = lys_parse_mem(st->ctx, yang, LYS_IN_YANG);
+    assert_non_null(mod);
+
+    /* the augment is not known yet */
+    st->dt = lyd_parse_mem(st->ctx, data, LYD_JSON, LYD_OPT_CONFIG | LYD_OPT_STRICT);
+    assert_null(st->dt);
+
+    assert_non_null(lys_parse_mem(st->ctx, yang2, LYS_IN_YANG));
+    st->dt = lyd_parse_mem(st->ctx, data, LYD_JSON, LYD_OPT_CONFIG | LYD_OPT_STRICT);
+    assert_non_null(st->dt);
+
+    node = st->dt->child;
+    assert_string_equal(node->schema->name, "x");
+    assert_string_equal(lyd_node_module(node)->name, "n");
+    node = node->next;
+    assert_string_equal(node->schema->name, "z");
+    node = node->next;
+    assert_string_equal(node->schema->name, "x");
+    assert_string_equal(lyd_node_module(node)->name, "n2");
+    assert_string_equal(st->dt->next->schema->name, "top");
+    lyd_free_withsiblings(st->dt);
+
+    /* nodes disabled by if-features */
+    st->dt = lyd_parse_mem(st->ctx, "{\"n:c\":{\"fx\":\"a\"}}", LYD_JSON, LYD_OPT_CONFIG | LYD_OPT_STRICT);
+    assert_null(st->dt);
+    assert_int_equal(lys_features_enable(mod, "f"), 0);
+    st->dt = lyd_parse_mem(st->ctx, "{\"n:c\":{\"fx\":\"a\"}}", LYD_JSON, LYD_OPT_CONFIG | LYD_OPT_STRICT);
+    assert_non_null(st->dt);
+    lyd_free_withsiblings(st->dt);
+    assert_int_equal(lys_features_disable(mod, "f"), 0);
+    st->dt = lyd_parse_mem(st->ctx, "{\"n:c\":{\"fx\":\"a\"}}", LYD_JSON, LYD_OPT_CONFIG | LYD_OPT_STRICT);
+    assert_null(st->dt);
+
+    /* the module of the parent is not the module of the node */
+    st->dt = lyd_parse_mem(st->ctx, "{\"n:c\":{\"n2:z\":\"a\"}}", LYD_JSON, LYD_OPT_CONFIG | LYD_OPT_STRICT);
+    assert_null(st->dt);
+    st->dt = lyd_parse_mem(st->ctx, "{\"n2:c\":{}}", LYD_JSON, LYD_OPT_CONFIG | LYD_OPT_STRICT);
+    assert_null(st->dt);
+}
+
+static void
+test_parse_structural_index(void **state)
+{
+    struct state *st;
+    const char *yang = "module si {namespace urn:si; prefix si;"
+                       "container c {leaf-list s {type string;} leaf n {type int32;} leaf b {type boolean;}}}";
+    char data[512], str[80];
+    struct lyd_node *node;
+    int pad, k;
+
+    if (setup_f(&st, TESTS_DIR "/schema/yin/ietf", NULL, 0)) {
+        fail();
+    }
+
+    (*state) = st;
+
+    assert_non_null(lys_parse_mem(st->ctx, yang, LYS_IN_YANG));
+
+    /* move all the tokens over the block boundaries of the index */
+    for (k = 0; k < 70; k += 23) {
+        memset(str, 'x', k);
+        str[k] = '\0';
+        for (pad = 0; pad < 70; ++pad) {
+            sprintf(data, "{\"si:c\":{%*s\"s\" : [\"%s\", \"a\\\\\\\"b\\u0041\",\"\\\\\"],"
+                    "\"z:unknown\": {\"q\": \"}]\\\\\\\"\", \"w\": [1, {}]\t},\n\"n\" : -12 , \"b\":true } }",
+                    pad, "", str);
+            st->dt = lyd_parse_mem(st->ctx, data, LYD_JSON, LYD_OPT_CONFIG);
+            assert_non_null(st->dt);
+
+            node = st->dt->child;
+            assert_string_equal(((struct lyd_node_leaf_list *)node)->value_str, str);
+            node = node->next;
+            assert_string_equal(((struct lyd_node_leaf_list *)node)->value_str, "a\\\"bA");
+            node = node->next;
+            assert_string_equal(((struct lyd_node_leaf_list *)node)->value_str, "\\");
+            node = node->next;
+            assert_string_equal(node->schema->name, "n");
+            assert_int_equal(((struct lyd_node_leaf_list *)node)->value.int32, -12);
+            node = node->next;
+            assert_string_equal(node->schema->name, "b");
+            assert_int_equal(((struct lyd_node_leaf_list *)node)->value.bln, 1);
+            assert_null(node->next);
+            lyd_free_withsiblings(st->dt);
+        }
+    }
+
+    /* whitespaces do not hide the rest of a literal or an unterminated string */
+    st->dt = lyd_parse_mem(st->ctx, "{\"si:c\":{\"b\":true  x}}", LYD_JSON, LYD_OPT_CONFIG);
+    assert_null(st->dt);
+    st->dt = lyd_parse_mem(st->ctx, "{\"si:c\":{\"s\":[\"a  ]}}", LYD_JSON, LYD_OPT_CONFIG);
+    assert_null(st->dt);
+}
+
+static void
+test_parse_skip_unknown(void **state)
+{
+    struct state *st;
+    const char *yang = "module su {namespace urn:su; prefix su; container c {leaf x {type string;} leaf y {type int8;}}}";
+    char data[4096], *p;
+    int i;
+
+    if (setup_f(&st, TESTS_DIR "/schema/yin/ietf", NULL, 0)) {
+        fail();
+    }
+
+    (*state) = st;
+
+    assert_non_null(lys_parse_mem(st->ctx, yang, LYS_IN_YANG));
+
+    /* deeply nested unknown subtrees between the known members */
+    p = data + sprintf(data, "{\"su:c\":{\"v:blob\":");
+    for (i = 0; i < 100; ++i) {
+        p += sprintf(p, "{\"a%d\":[\"]}\",{\"b\":[1,2]},", i);
+    }
+    p += sprintf(p, "null");
+    for (i = 0; i < 100; ++i) {
+        p += sprintf(p, "]}");
+    }
+    sprintf(p, ",\"x\":\"v\",\"v:other\":[[],{}],\"y\":1,\"v:last\":{\"q\":{}}}}");
+    st->dt = lyd_parse_mem(st->ctx, data, LYD_JSON, LYD_OPT_CONFIG);
+    assert_non_null(st->dt);
+    assert_string_equal(st->dt->child->schema->name, "x");
+    assert_string_equal(st->dt->child->next->schema->name, "y");
+    assert_null(st->dt->child->next->next);
+    lyd_free_withsiblings(st->dt);
+
+    /* brackets not matching in a skipped subtree */
+    st->dt = lyd_parse_mem(st->ctx, "{\"su:c\":{\"v:blob\":[1},\"x\":\"v\"}}", LYD_JSON, LYD_OPT_CONFIG);
+    assert_null(st->dt);
+    st->dt = lyd_parse_mem(st->ctx, "{\"su:c\":{\"v:blob\":{\"a\":1]}}", LYD_JSON, LYD_OPT_CONFIG);
+    assert_null(st->dt);
+}
+
+static void
+test_parse_anydata_object(void **state)
+{
+    struct state *st;
+    const char *yang = "module ao {namespace urn:ao; prefix ao; container c {anydata any; leaf x {type string;}}}";
+    const char *value = "{\"a\":\"}\\\"{\",\"b\":[{\"c\":{}},\"}}\"]}";
+    char data[256];
+    struct lyd_node_anydata *any;
+
+    if (setup_f(&st, TESTS_DIR "/schema/yin/ietf", NULL, 0)) {
+        fail();
+    }
+
+    (*state) = st;
+
+    assert_non_null(lys_parse_mem(st->ctx, yang, LYS_IN_YANG));
+
+    /* brackets in strings do not end the value */
+    sprintf(data, "{\"ao:c\":{\"any\":%s ,\"x\":\"v\"}}", value);
+    st->dt = lyd_parse_mem(st->ctx, data, LYD_JSON, LYD_OPT_CONFIG);
+    assert_non_null(st->dt);
+    any = (struct lyd_node_anydata *)st->dt->child;
+    assert_int_equal(any->value_type, LYD_ANYDATA_JSON);
+    assert_string_equal(any->value.str, value);
+    assert_string_equal(any->next->schema->name, "x");
+    lyd_free_withsiblings(st->dt);
+
+    /* unterminated value */
+    st->dt = lyd_parse_mem(st->ctx, "{\"ao:c\":{\"any\":{\"a\":\"}}}\"", LYD_JSON, LYD_OPT_CONFIG);
+    assert_null(st->dt);
+}
+
+static void
+test_parse_numbers_native(void **state)
+{
+    struct state *st;
+    const char *yang = "module nn {namespace urn:nn; prefix nn;"
+                       "container c {leaf i8 {type int8;} leaf i64 {type int64;} leaf u8 {type uint8 {range 1..10;}}"
+                       "leaf u64 {type uint64;} leaf d {type decimal64 {fraction-digits 2;}}"
+                       "leaf-list ll {type int16;} leaf un {type union {type int8; type string;}}}}";
+    struct lyd_node_leaf_list *leaf;
+
+    if (setup_f(&st, TESTS_DIR "/schema/yin/ietf", NULL, 0)) {
+        fail();
+    }
+
+    (*state) = st;
+
+    assert_non_null(lys_parse_mem(st->ctx, yang, LYS_IN_YANG));
+
+    st->dt = lyd_parse_mem(st->ctx, "{\"nn:c\":{\"i8\":-0,\"i64\":-9223372036854775808,\"u8\":10,"
+                           "\"u64\":18446744073709551615,\"d\":1.50,\"ll\":[1,-32768],\"un\":300}}",
+                           LYD_JSON, LYD_OPT_CONFIG | LYD_OPT_STRICT);
+    assert_non_null(st->dt);
+
+    leaf = (struct lyd_node_leaf_list *)st->dt->child;
+    assert_string_equal(leaf->value_str, "0");
+    assert_int_equal(leaf->value_type, LY_TYPE_INT8);
+    assert_int_equal(leaf->value.int8, 0);
+    leaf = (struct lyd_node_leaf_list *)leaf->next;
+    assert_string_equal(leaf->value_str, "-9223372036854775808");
+    assert_true(leaf->value.int64 == INT64_MIN);
+    leaf = (struct lyd_node_leaf_list *)leaf->next;
+    assert_int_equal(leaf->value.uint8, 10);
+    leaf = (struct lyd_node_leaf_list *)leaf->next;
+    assert_string_equal(leaf->value_str, "18446744073709551615");
+    assert_true(leaf->value.uint64 == UINT64_MAX);
+    leaf = (struct lyd_node_leaf_list *)leaf->next;
+    assert_string_equal(leaf->value_str, "1.5");
+    assert_int_equal(leaf->value.dec64, 150);
+    leaf = (struct lyd_node_leaf_list *)leaf->next;
+    assert_int_equal(leaf->value.int16, 1);
+    leaf = (struct lyd_node_leaf_list *)leaf->next;
+    assert_string_equal(leaf->value_str, "-32768");
+    assert_int_equal(leaf->value.int16, -32768);
+    leaf = (struct lyd_node_leaf_list *)leaf->next;
+    assert_string_equal(leaf->value_str, "300");
+    assert_int_equal(leaf->value_type, LY_TYPE_STRING);
+    lyd_free_withsiblings(st->dt);
+
+    st->dt = lyd_parse_mem(st->ctx, "{\"nn:c\":{\"d\":2}}", LYD_JSON, LYD_OPT_CONFIG);
+    assert_non_null(st->dt);
+    assert_string_equal(((struct lyd_node_leaf_list *)st->dt->child)->value_str, "2.0");
+    lyd_free_withsiblings(st->dt);
+
+    /* out of the type or restriction ranges */
+    st->dt = lyd_parse_mem(st->ctx, "{\"nn:c\":{\"i8\":128}}", LYD_JSON, LYD_OPT_CONFIG);
+    assert_null(st->dt);
+    st->dt = lyd_parse_mem(st->ctx, "{\"nn:c\":{\"i64\":9223372036854775808}}", LYD_JSON, LYD_OPT_CONFIG);
+    assert_null(st->dt);
+    st->dt = lyd_parse_mem(st->ctx, "{\"nn:c\":{\"u64\":18446744073709551616}}", LYD_JSON, LYD_OPT_CONFIG);
+    assert_null(st->dt);
+    st->dt = lyd_parse_mem(st->ctx, "{\"nn:c\":{\"u8\":-1}}", LYD_JSON, LYD_OPT_CONFIG);
+    assert_null(st->dt);
+    st->dt = lyd_parse_mem(st->ctx, "{\"nn:c\":{\"u8\":11}}", LYD_JSON, LYD_OPT_CONFIG);
+    assert_null(st->dt);
+    st->dt = lyd_parse_mem(st->ctx, "{\"nn:c\":{\"i8\":1.0}}", LYD_JSON, LYD_OPT_CONFIG);
+    assert_null(st->dt);
+    st->dt = lyd_parse_mem(st->ctx, "{\"nn:c\":{\"d\":1.005}}", LYD_JSON, LYD_OPT_CONFIG);
+    assert_null(st->dt);
+}
+
+static void
+test_print_compact(void **state)
+{
+    struct state *st;
+    const char *yang = "module pc {namespace urn:pc; prefix pc;"
+                       "container c {leaf-list ll {type string;} list l {key k; leaf k {type string;} leaf v {type int8;}}"
+                       "anydata any; container e {presence p;}}}";
+    const char *yang2 = "module pc2 {namespace urn:pc2; prefix pc2; import pc {prefix pc;}"
+                        "augment /pc:c {leaf z {type uint64;} container zc {leaf q {type empty;}}}}";
+    const char *data = "{\"pc:c\":{\"ll\":[\"a\",\"b\"],\"l\":[{\"k\":\"1\",\"v\":5},"
+                       "{\"@\":{\"ietf-netconf:operation\":\"merge\"},\"k\":\"2\"}],\"any\":{\"x\":1},\"e\":{},"
+                       "\"pc2:z\":\"18446744073709551615\",\"pc2:zc\":{\"q\":[null]}}}";
+    const char *data2 = "{\"pc:c\":{\"ll\":[\"a\",\"b\"],\"@ll\":[null,{\"ietf-netconf:operation\":\"merge\"}]}}";
+    char *str;
+
+    if (setup_f(&st, TESTS_DIR "/schema/yin/ietf", NULL, 0)) {
+        fail();
+    }
+
+    (*state) = st;
+
+    assert_non_null(ly_ctx_load_module(st->ctx, "ietf-netconf", NULL));
+    assert_non_null(lys_parse_mem(st->ctx, yang, LYS_IN_YANG));
+    assert_non_null(lys_parse_mem(st->ctx, yang2, LYS_IN_YANG));
+
+    st->dt = lyd_parse_mem(st->ctx, data, LYD_JSON, LYD_OPT_EDIT);
+    assert_non_null(st->dt);
+    lyd_print_mem(&str, st->dt, LYD_JSON, LYP_WITHSIBLINGS);
+    assert_string_equal(str, data);
+    free(str);
+
+    /* top-level nodes always with the module name */
+    lyd_print_mem(&str, st->dt->child, LYD_JSON, LYP_WITHSIBLINGS);
+    assert_string_equal(str, "{\"pc:ll\":[\"a\",\"b\"],\"pc:l\":[{\"k\":\"1\",\"v\":5},"
+                        "{\"@\":{\"ietf-netconf:operation\":\"merge\"},\"k\":\"2\"}],\"pc:any\":{\"x\":1},\"pc:e\":{},"
+                        "\"pc2:z\":\"18446744073709551615\",\"pc2:zc\":{\"q\":[null]}}");
+    free(str);
+    lyd_print_mem(&str, st->dt->child, LYD_JSON, 0);
+    assert_string_equal(str, "{\"pc:ll\":[\"a\"]}");
+    free(str);
+    lyd_free_withsiblings(st->dt);
+
+    st->dt = lyd_parse_mem(st->ctx, data2, LYD_JSON, LYD_OPT_EDIT);
+    assert_non_null(st->dt);
+    lyd_print_mem(&str, st->dt, LYD_JSON, LYP_WITHSIBLINGS);
+    assert_string_equal(str, data2);
+    free(str);
+}
+
+static void
+test_print_interleaved(void **state)
+{
+    struct state *st;
+    const char *yang = "module pi {namespace urn:pi; prefix pi;"
+                       "container c {leaf-list ll {type string;} list l {key k; leaf k {type string;}} leaf d {type string;}}}";
+    const char *xml = "<c xmlns=\"urn:pi\"><ll>a</ll><l><k>1</k></l><ll>b</ll><d>x</d><l><k>2</k></l><ll>c</ll>"
+                      "<l><k>3</k></l></c>";
+    const char *json = "{\"pi:c\":{\"ll\":[\"a\",\"b\",\"c\"],\"l\":[{\"k\":\"1\"},{\"k\":\"2\"},{\"k\":\"3\"}],"
+                       "\"d\":\"x\"}}";
+    char *str;
+    int i;
+
+    if (setup_f(&st, TESTS_DIR "/schema/yin/ietf", NULL, 0)) {
+        fail();
+    }
+
+    (*state) = st;
+
+    assert_non_null(lys_parse_mem(st->ctx, yang, LYS_IN_YANG));
+    st->dt = lyd_parse_mem(st->ctx, xml, LYD_XML, LYD_OPT_CONFIG);
+    assert_non_null(st->dt);
+    assert_string_equal(st->dt->child->next->next->schema->name, "ll");
+
+    /* all the instances in one array wherever they are */
+    for (i = 0; i < 2; ++i) {
+        lyd_print_mem(&str, st->dt, LYD_JSON, LYP_WITHSIBLINGS | (i ? LYP_PARALLEL : 0));
+        assert_string_equal(str, json);
+        free(str);
+    }
+    lyd_print_mem(&str, st->dt->child, LYD_JSON, LYP_WITHSIBLINGS | LYP_PARALLEL);
+    assert_string_equal(str, "{\"pi:ll\":[\"a\",\"b\",\"c\"],\"pi:l\":[{\"k\":\"1\"},{\"k\":\"2\"},{\"k\":\"3\"}],"
+                        "\"pi:d\":\"x\"}");
+    free(str);
+
+    /* the instances before the printed node are not printed */
+    lyd_print_mem(&str, st->dt->child->next->next, LYD_JSON, LYP_WITHSIBLINGS);
+    assert_string_equal(str, "{\"pi:ll\":[\"b\",\"c\"],\"pi:d\":\"x\"}");
+    free(str);
+    lyd_print_mem(&str, st->dt->child->next->next, LYD_JSON, LYP_WITHSIBLINGS | LYP_FORMAT);
+    assert_string_equal(str, "{\n  \"pi:ll\": [\n    \"b\",\n    \"c\"\n  ],\n  \"pi:d\": \"x\"\n}\n");
+    free(str);
+}
+
 int
 main(void)
 {
@@ -701,7 +1106,15 @@ main(void)
                     cmocka_unit_test_teardown(test_parse_if, teardown_f),
                     cmocka_unit_test_teardown(test_parse_numbers, teardown_f),
                     cmocka_unit_test_teardown(test_parse_error_numbers, teardown_f),
+                    cmocka_unit_test_teardown(test_parse_numbers_native, teardown_f),
                     cmocka_unit_test_teardown(test_parse_string, teardown_f),
+                    cmocka_unit_test_teardown(test_parse_string_inplace, teardown_f),
+                    cmocka_unit_test_teardown(test_parse_member_names, teardown_f),
+                    cmocka_unit_test_teardown(test_parse_structural_index, teardown_f),
+                    cmocka_unit_test_teardown(test_parse_skip_unknown, teardown_f),
+                    cmocka_unit_test_teardown(test_parse_anydata_object, teardown_f),
+                    cmocka_unit_test_teardown(test_print_compact, teardown_f),
+                    cmocka_unit_test_teardown(test_print_interleaved, teardown_f),
                     };
 
     return cmocka_run_group_tests(tests, NULL, NULL);
@@ -162,10 +162,44 @@ test_mandatory(void **state)
     assert_int_equal(ly_errno, LY_SUCCESS);
 }
 
+static void
+test_mandatory_deviation(void **state)
+{
+    (void)state; /* unused */
+    struct ly_ctx *ctx;
+    struct lyd_node *data;
+    const char *yang = "module mand-dev {namespace urn:libyang:tests:mand-dev; prefix md;"
+                       "container top {container sub {leaf l {type string;}}}}";
+    const char *dev = "module mand-dev-dev {namespace urn:libyang:tests:mand-dev-dev; prefix mdd;"
+                      "import mand-dev {prefix md;}"
+                      "deviation /md:top/md:sub/md:l {deviate add {mandatory true;}}}";
+    const char *xml = "<top xmlns=\"urn:libyang:tests:mand-dev\"><sub/></top>";
+
+    /* a separate context, the fixture module has top-level mandatory nodes */
+    ctx = ly_ctx_new(NULL, 0);
+    assert_ptr_not_equal(ctx, NULL);
+    assert_ptr_not_equal(lys_parse_mem(ctx, yang, LYS_IN_YANG), NULL);
+
+    /* no mandatory nodes in the subtree */
+    data = lyd_parse_mem(ctx, xml, LYD_XML, LYD_OPT_CONFIG);
+    assert_ptr_not_equal(data, NULL);
+    lyd_free_withsiblings(data);
+
+    /* the leaf is mandatory now */
+    assert_ptr_not_equal(lys_parse_mem(ctx, dev, LYS_IN_YANG), NULL);
+    data = lyd_parse_mem(ctx, xml, LYD_XML, LYD_OPT_CONFIG);
+    assert_ptr_equal(data, NULL);
+    assert_int_equal(ly_errno, LY_EVALID);
+    assert_int_equal(ly_vecode(ctx), LYVE_MISSELEM);
+
+    ly_ctx_destroy(ctx, NULL);
+}
+
 int main(void)
 {
     const struct CMUnitTest tests[] = {
-                    cmocka_unit_test_setup_teardown(test_mandatory, setup_f, teardown_f)
+                    cmocka_unit_test_setup_teardown(test_mandatory, setup_f, teardown_f),
+                    cmocka_unit_test_setup_teardown(test_mandatory_deviation, setup_f, teardown_f)
     };
 
     return cmocka_run_group_tests(tests, NULL, NULL);
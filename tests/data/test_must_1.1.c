@@ -20,6 +20,8 @@
 
 #include "tests/config.h"
 #include "libyang.h"
+#include "../../src/context.h"
+#include "../../src/hash_table.h"
 
 struct state {
     struct ly_ctx *ctx;
@@ -181,13 +183,133 @@ test_notif(void **state)
     assert_int_equal(lyd_validate(&(st->dt), LYD_OPT_NOTIF, NULL), 0);
 }
 
+static void
+test_xpath_cache(void **state)
+{
+    struct state *st = (struct state *)*state;
+    struct lyd_node *node;
+    uint32_t used;
+
+    /* schema */
+    st->mod = lys_parse_path(st->ctx, TESTS_DIR"/data/files/must-inout.yin", LYS_IN_YIN);
+    assert_ptr_not_equal(st->mod, NULL);
+
+    st->dt = lyd_new_path(NULL, st->ctx, "/must-inout:rpc1/b", "bb", 0, 0);
+    assert_ptr_not_equal(st->dt, NULL);
+    node = lyd_new_path(st->dt, st->ctx, "/must-inout:rpc1/c", "5", 0, 0);
+    assert_ptr_not_equal(node, NULL);
+
+    assert_int_equal(lyd_validate(&(st->dt), LYD_OPT_RPC, NULL), 0);
+    assert_ptr_not_equal(st->ctx->xpath_cache, NULL);
+    used = st->ctx->xpath_cache->used;
+    assert_int_not_equal(used, 0);
+
+    /* repeated validation reuses the compiled expressions */
+    assert_int_equal(lyd_validate(&(st->dt), LYD_OPT_RPC, NULL), 0);
+    assert_int_equal(st->ctx->xpath_cache->used, used);
+
+    /* removing the module drops the cache */
+    lyd_free_withsiblings(st->dt);
+    st->dt = NULL;
+    assert_int_equal(ly_ctx_remove_module(st->mod, NULL), 0);
+    assert_ptr_equal(st->ctx->xpath_cache, NULL);
+}
+
+static void
+test_xpath_deps(void **state)
+{
+    struct state *st = (struct state *)*state;
+    const struct lys_node *snode;
+    struct ly_set *set, *changed;
+    const char *schema =
+    "module deps {"
+        "yang-version 1.1;"
+        "namespace urn:deps;"
+        "prefix d;"
+        "container top {"
+            "leaf limit { type uint8; }"
+            "list item { key name; leaf name { type string; } leaf size { type uint8; must \". <= ../../limit\"; } }"
+            "leaf flag { type boolean; }"
+            "leaf extra { when \"../flag = 'true'\"; type string; }"
+        "}"
+    "}";
+    const char *data =
+    "<top xmlns=\"urn:deps\">"
+        "<limit>10</limit>"
+        "<item><name>a</name><size>5</size></item>"
+        "<item><name>b</name><size>7</size></item>"
+        "<flag>true</flag>"
+        "<extra>x</extra>"
+    "</top>";
+
+    st->mod = lys_parse_mem(st->ctx, schema, LYS_IN_YANG);
+    assert_ptr_not_equal(st->mod, NULL);
+
+    /* reverse dependencies */
+    snode = st->mod->data->child;
+    assert_string_equal(snode->name, "limit");
+    set = lys_xpath_dependents(snode);
+    assert_ptr_not_equal(set, NULL);
+    assert_int_equal(set->number, 1);
+    assert_string_equal(set->set.s[0]->name, "size");
+    ly_set_free(set);
+
+    set = lys_xpath_dependents(snode->next->next);
+    assert_ptr_not_equal(set, NULL);
+    assert_int_equal(set->number, 1);
+    assert_string_equal(set->set.s[0]->name, "extra");
+    ly_set_free(set);
+
+    set = lys_xpath_dependents(snode->next->child);
+    assert_ptr_not_equal(set, NULL);
+    assert_int_equal(set->number, 0);
+    ly_set_free(set);
+
+    st->dt = lyd_parse_mem(st->ctx, data, LYD_XML, LYD_OPT_CONFIG);
+    assert_ptr_not_equal(st->dt, NULL);
+
+    /* lowering the limit breaks a must of another node */
+    changed = lyd_find_path(st->dt, "/deps:top/limit");
+    assert_ptr_not_equal(changed, NULL);
+    assert_int_equal(changed->number, 1);
+    assert_int_equal(lyd_change_leaf((struct lyd_node_leaf_list *)changed->set.d[0], "6"), 0);
+    assert_int_not_equal(lyd_validate_xpath_deps(&st->dt, changed, LYD_OPT_CONFIG), 0);
+    assert_int_equal(lyd_change_leaf((struct lyd_node_leaf_list *)changed->set.d[0], "8"), 0);
+    assert_int_equal(lyd_validate_xpath_deps(&st->dt, changed, LYD_OPT_CONFIG), 0);
+    ly_set_free(changed);
+
+    /* a changed node with its own must */
+    changed = lyd_find_path(st->dt, "/deps:top/item[name='a']/size");
+    assert_ptr_not_equal(changed, NULL);
+    assert_int_equal(lyd_change_leaf((struct lyd_node_leaf_list *)changed->set.d[0], "9"), 0);
+    assert_int_not_equal(lyd_validate_xpath_deps(&st->dt, changed, LYD_OPT_CONFIG), 0);
+    assert_int_equal(lyd_change_leaf((struct lyd_node_leaf_list *)changed->set.d[0], "1"), 0);
+    assert_int_equal(lyd_validate_xpath_deps(&st->dt, changed, LYD_OPT_CONFIG), 0);
+    ly_set_free(changed);
+
+    /* a false when condition of a dependent node */
+    changed = lyd_find_path(st->dt, "/deps:top/flag");
+    assert_ptr_not_equal(changed, NULL);
+    assert_int_equal(lyd_change_leaf((struct lyd_node_leaf_list *)changed->set.d[0], "false"), 0);
+    assert_int_not_equal(lyd_validate_xpath_deps(&st->dt, changed, LYD_OPT_CONFIG), 0);
+    assert_int_equal(lyd_validate_xpath_deps(&st->dt, changed, LYD_OPT_CONFIG | LYD_OPT_WHENAUTODEL), 0);
+    ly_set_free(changed);
+
+    set = lyd_find_path(st->dt, "/deps:top/extra");
+    assert_ptr_not_equal(set, NULL);
+    assert_int_equal(set->number, 0);
+    ly_set_free(set);
+}
+
 int main(void)
 {
     const struct CMUnitTest tests[] = {
                     cmocka_unit_test_setup_teardown(test_dependency_rpc, setup_f, teardown_f),
                     cmocka_unit_test_setup_teardown(test_dependency_action, setup_f, teardown_f),
                     cmocka_unit_test_setup_teardown(test_inout, setup_f, teardown_f),
-                    cmocka_unit_test_setup_teardown(test_notif, setup_f, teardown_f)
+                    cmocka_unit_test_setup_teardown(test_notif, setup_f, teardown_f),
+                    cmocka_unit_test_setup_teardown(test_xpath_cache, setup_f, teardown_f),
+                    cmocka_unit_test_setup_teardown(test_xpath_deps, setup_f, teardown_f)
     };
 
     return cmocka_run_group_tests(tests, NULL, NULL);
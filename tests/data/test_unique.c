@@ -144,6 +144,43 @@ test_un_empty(void **state)
     assert_ptr_not_equal(st->dt, NULL);
 }
 
+static void
+test_un_many(void **state)
+{
+    struct state *st = (*state);
+    struct lyd_node *list;
+    char buf[32];
+    int i;
+
+    st->dt = lyd_new(NULL, st->mod, "un");
+    assert_ptr_not_equal(st->dt, NULL);
+    for (i = 0; i < 50; ++i) {
+        sprintf(buf, "n%d", i);
+        list = lyd_new(st->dt, NULL, "list");
+        assert_ptr_not_equal(list, NULL);
+        assert_ptr_not_equal(lyd_new_leaf(list, NULL, "name", buf), NULL);
+        sprintf(buf, "%d", i);
+        assert_ptr_not_equal(lyd_new_leaf(list, NULL, "value", buf), NULL);
+        assert_ptr_not_equal(lyd_new_path(list, NULL, "input/y", buf, 0, 0), NULL);
+    }
+    assert_int_equal(lyd_validate(&st->dt, LYD_OPT_CONFIG, NULL), 0);
+
+    /* a new instance colliding with an existing one */
+    list = lyd_new(st->dt, NULL, "list");
+    assert_ptr_not_equal(list, NULL);
+    assert_ptr_not_equal(lyd_new_leaf(list, NULL, "name", "new"), NULL);
+    assert_ptr_not_equal(lyd_new_leaf(list, NULL, "value", "7"), NULL);
+    assert_ptr_not_equal(lyd_new_path(list, NULL, "input/y", "50", 0, 0), NULL);
+    assert_int_not_equal(lyd_validate(&st->dt, LYD_OPT_CONFIG, NULL), 0);
+    assert_int_equal(ly_vecode(st->ctx), LYVE_NOUNIQ);
+    assert_string_equal(ly_errmsg(st->ctx), "Unique data leaf(s) \"value a\" not satisfied in \"/unique:un/list[name='n7']\" and \"/unique:un/list[name='new']\".");
+
+    /* changing the value resolves the collision */
+    lyd_free(list->child->next);
+    assert_ptr_not_equal(lyd_new_leaf(list, NULL, "value", "50"), NULL);
+    assert_int_equal(lyd_validate(&st->dt, LYD_OPT_CONFIG, NULL), 0);
+}
+
 static void
 test_schema_inpath(void **state)
 {
@@ -170,6 +207,7 @@ int main(void)
                     cmocka_unit_test_setup_teardown(test_un_correct, setup_f, teardown_f),
                     cmocka_unit_test_setup_teardown(test_un_defaults, setup_f, teardown_f),
                     cmocka_unit_test_setup_teardown(test_un_empty, setup_f, teardown_f),
+                    cmocka_unit_test_setup_teardown(test_un_many, setup_f, teardown_f),
                     cmocka_unit_test_setup_teardown(test_schema_inpath, setup_f, teardown_f),
     };
 
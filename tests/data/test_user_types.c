@@ -17,9 +17,11 @@
 #include <setjmp.h>
 #include <stdarg.h>
 #include <cmocka.h>
+#include <sys/socket.h>
 
 #include "tests/config.h"
 #include "libyang.h"
+#include "user_types.h"
 
 struct state {
     struct ly_ctx *ctx;
@@ -219,11 +221,196 @@ test_inet_types(void **state)
     assert_string_equal(((struct lyd_node_leaf_list *)st->dt)->value_str, "::/55");
 }
 
+static void
+test_parse_types(void **state)
+{
+    struct state *st = (struct state *)*state;
+    struct lyd_node *iter;
+    const char *xml = "<inet5 xmlns=\"urn:user-types\">158.1.58.4/24</inet5>"
+                      "<yang2 xmlns=\"urn:user-types\">AA:BB:1D:2F:CA:52</yang2>"
+                      "<inet6 xmlns=\"urn:user-types\">12.1.58.4/8</inet6>"
+                      "<inet1 xmlns=\"urn:user-types\">2008:15:0:0:0:0:feAC:1</inet1>"
+                      "<yang5 xmlns=\"urn:user-types\">12AbCDef-3456-58cd-9ABC-8796cdACdfEE</yang5>"
+                      "<inet7 xmlns=\"urn:user-types\">::C:D:E:f:a/96</inet7>";
+    const char *canon[] = {"158.1.58.0/24", "aa:bb:1d:2f:ca:52", "12.0.0.0/8", "2008:15::feac:1",
+                           "12abcdef-3456-58cd-9abc-8796cdacdfee", "::c:d:e:0:0/96"};
+    int i;
+
+    /* values of several user types stored while parsing a single tree */
+    st->dt = lyd_parse_mem(st->ctx, xml, LYD_XML, LYD_OPT_CONFIG);
+    assert_non_null(st->dt);
+    i = 0;
+    LY_TREE_FOR(st->dt, iter) {
+        assert_int_not_equal(((struct lyd_node_leaf_list *)iter)->value_flags & LY_VALUE_USER, 0);
+        assert_string_equal(((struct lyd_node_leaf_list *)iter)->value_str, canon[i]);
+        ++i;
+    }
+    assert_int_equal(i, 6);
+}
+
+static void
+test_bound_types(void **state)
+{
+    struct state *st = (struct state *)*state;
+    const struct lys_module *mod;
+    const struct lys_node_leaf *sleaf;
+
+    /* the plugins are found once for the typedefs when loading the schemas */
+    sleaf = (const struct lys_node_leaf *)ly_ctx_get_node(st->ctx, NULL, "/user-types:inet5", 0);
+    assert_non_null(sleaf);
+    assert_non_null(sleaf->type.der->plugin);
+
+    mod = lys_parse_mem(st->ctx, "module bound {namespace urn:bound; prefix b; import ietf-yang-types {prefix yang;}"
+                        "leaf c {type yang:counter32;} leaf m {type yang:mac-address;}}", LYS_IN_YANG);
+    assert_non_null(mod);
+    sleaf = (const struct lys_node_leaf *)ly_ctx_get_node(st->ctx, NULL, "/bound:c", 0);
+    assert_non_null(sleaf);
+    assert_null(sleaf->type.der->plugin);
+    sleaf = (const struct lys_node_leaf *)ly_ctx_get_node(st->ctx, NULL, "/bound:m", 0);
+    assert_non_null(sleaf);
+    assert_non_null(sleaf->type.der->plugin);
+
+    st->dt = lyd_new_leaf(NULL, mod, "m", "AA:BB:1D:2F:CA:52");
+    assert_non_null(st->dt);
+    assert_int_not_equal(((struct lyd_node_leaf_list *)st->dt)->value_flags & LY_VALUE_USER, 0);
+    assert_string_equal(((struct lyd_node_leaf_list *)st->dt)->value_str, "aa:bb:1d:2f:ca:52");
+}
+
+static void
+test_binary_values(void **state)
+{
+    struct state *st = (struct state *)*state;
+    struct lyd_node *dup;
+    const struct lytype_inet_addr *addr;
+    const uint8_t v4[] = {192, 168, 0, 1}, v6[16] = {0x20, 0x00};
+    int64_t time;
+
+    /* ip-address with a zone */
+    st->dt = lyd_new_leaf(NULL, st->mod, "inet1", "192.168.0.1%12");
+    assert_non_null(st->dt);
+    assert_int_not_equal(((struct lyd_node_leaf_list *)st->dt)->value_flags & LY_VALUE_USER, 0);
+    addr = ((struct lyd_node_leaf_list *)st->dt)->value.ptr;
+    assert_int_equal(addr->family, AF_INET);
+    assert_int_equal(addr->prefix, 32);
+    assert_memory_equal(addr->addr, v4, sizeof v4);
+
+    /* the duplicate has its own binary value */
+    dup = lyd_dup(st->dt, 0);
+    assert_non_null(dup);
+    assert_ptr_not_equal(((struct lyd_node_leaf_list *)dup)->value.ptr, addr);
+    assert_memory_equal(((struct lyd_node_leaf_list *)dup)->value.ptr, addr, sizeof *addr);
+    lyd_free(dup);
+    lyd_free_withsiblings(st->dt);
+
+    /* ip-prefix */
+    st->dt = lyd_new_leaf(NULL, st->mod, "inet5", "2000:A:B:C:D:E:f:a/16");
+    assert_non_null(st->dt);
+    addr = ((struct lyd_node_leaf_list *)st->dt)->value.ptr;
+    assert_int_equal(addr->family, AF_INET6);
+    assert_int_equal(addr->prefix, 16);
+    assert_memory_equal(addr->addr, v6, sizeof v6);
+
+    /* changing the value replaces the binary value, too */
+    assert_int_equal(lyd_change_leaf((struct lyd_node_leaf_list *)st->dt, "158.1.58.4/24"), 0);
+    addr = ((struct lyd_node_leaf_list *)st->dt)->value.ptr;
+    assert_int_equal(addr->family, AF_INET);
+    assert_int_equal(addr->prefix, 24);
+    assert_string_equal(((struct lyd_node_leaf_list *)st->dt)->value_str, "158.1.58.0/24");
+    lyd_free_withsiblings(st->dt);
+
+    /* mac-address */
+    st->dt = lyd_new_leaf(NULL, st->mod, "yang3", "12:34:56:78:9A:BC");
+    assert_non_null(st->dt);
+    assert_true(((struct lyd_node_leaf_list *)st->dt)->value.uint64 == 0x123456789abcULL);
+    lyd_free_withsiblings(st->dt);
+
+    /* date-and-time, the same time in different timezones */
+    st->dt = lyd_new_leaf(NULL, st->mod, "yang1", "2005-05-31T23:15:15-08:00");
+    assert_non_null(st->dt);
+    time = ((struct lyd_node_leaf_list *)st->dt)->value.int64;
+    assert_true(time == 1117610115);
+    assert_string_equal(((struct lyd_node_leaf_list *)st->dt)->value_str, "2005-05-31T23:15:15-08:00");
+    lyd_free_withsiblings(st->dt);
+
+    st->dt = lyd_new_leaf(NULL, st->mod, "yang1", "2005-06-01T07:15:15.5Z");
+    assert_non_null(st->dt);
+    assert_true(((struct lyd_node_leaf_list *)st->dt)->value.int64 == time);
+}
+
+static void
+test_plugin_callbacks(void **state)
+{
+    struct state *st = (struct state *)*state;
+    const struct lys_module *mod;
+    struct lyd_node *tree, *node;
+    struct ly_set *set;
+    char *lyb = NULL;
+    const char *xml = "<l xmlns=\"urn:clb\"><p>2000:A::1/16</p><m>AA:BB:1D:2F:CA:52</m></l>"
+                      "<l xmlns=\"urn:clb\"><p>2001:DB8::5/64</p><m>00:00:00:00:00:01</m></l>"
+                      "<ll xmlns=\"urn:clb\">12:34:56:78:9A:BC</ll>";
+
+    mod = lys_parse_mem(st->ctx, "module clb {namespace urn:clb; prefix c; import ietf-inet-types {prefix inet;}"
+                        "import ietf-yang-types {prefix yang;}"
+                        "list l {key p; leaf p {type inet:ipv6-prefix;} leaf m {type yang:mac-address;}}"
+                        "leaf-list ll {type yang:mac-address;}}", LYS_IN_YANG);
+    assert_non_null(mod);
+
+    st->dt = lyd_parse_mem(st->ctx, xml, LYD_XML, LYD_OPT_CONFIG);
+    assert_non_null(st->dt);
+
+    /* the instances are found by hashes of the stored values */
+    set = lyd_find_path(st->dt, "/clb:l[p='2001:db8::/64']");
+    assert_non_null(set);
+    assert_int_equal(set->number, 1);
+    assert_string_equal(((struct lyd_node_leaf_list *)set->set.d[0]->child)->value_str, "2001:db8::/64");
+    ly_set_free(set);
+
+    set = lyd_find_path(st->dt, "/clb:ll[.='12:34:56:78:9a:bc']");
+    assert_non_null(set);
+    assert_int_equal(set->number, 1);
+    ly_set_free(set);
+
+    /* duplicate instances are detected by comparing the stored values */
+    node = lyd_new_path(st->dt, NULL, "/clb:l[p='2000::/16']", NULL, 0, 0);
+    assert_null(node);
+    node = lyd_new_path(st->dt, NULL, "/clb:ll", "12:34:56:78:9a:bc", 0, 0);
+    assert_null(node);
+
+    /* LYB keeps the values encoded by the plugins */
+    lyd_print_mem(&lyb, st->dt, LYD_LYB, LYP_WITHSIBLINGS);
+    assert_non_null(lyb);
+    /* header format version with the encoded user type values (LYB_VERSION_USER) */
+    assert_int_equal(lyb[3] & 0xf0, 0x30);
+    tree = lyd_parse_mem(st->ctx, lyb, LYD_LYB, LYD_OPT_CONFIG);
+    free(lyb);
+    assert_non_null(tree);
+
+    node = tree->child;
+    assert_string_equal(((struct lyd_node_leaf_list *)node)->value_str, "2000::/16");
+    assert_int_not_equal(((struct lyd_node_leaf_list *)node)->value_flags & LY_VALUE_USER, 0);
+    assert_int_equal(((struct lytype_inet_addr *)((struct lyd_node_leaf_list *)node)->value.ptr)->prefix, 16);
+    assert_string_equal(((struct lyd_node_leaf_list *)node->next)->value_str, "aa:bb:1d:2f:ca:52");
+    assert_true(((struct lyd_node_leaf_list *)node->next)->value.uint64 == 0xaabb1d2fca52ULL);
+    assert_string_equal(((struct lyd_node_leaf_list *)tree->next->child)->value_str, "2001:db8::/64");
+    assert_string_equal(((struct lyd_node_leaf_list *)tree->next->next)->value_str, "12:34:56:78:9a:bc");
+
+    /* instances of the parsed tree are found the same way */
+    set = lyd_find_path(tree, "/clb:l[p='2000::/16']");
+    assert_non_null(set);
+    assert_int_equal(set->number, 1);
+    ly_set_free(set);
+    lyd_free_withsiblings(tree);
+}
+
 int main(void)
 {
     const struct CMUnitTest tests[] = {
         cmocka_unit_test_setup_teardown(test_yang_types, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_inet_types, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_parse_types, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_bound_types, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_binary_values, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_plugin_callbacks, setup_f, teardown_f),
     };
 
     return cmocka_run_group_tests(tests, NULL, NULL);
@@ -422,6 +422,225 @@ test_validate_value(void **state)
     assert_int_equal(lyd_validate_value(node, "9.223372036854775807"), EXIT_SUCCESS); /* ok */
 }
 
+static void
+test_validate_value_ranges(void **state)
+{
+    struct state *st = (*state);
+    const struct lys_module *mod;
+    struct lys_node *node;
+    const char *yang = "module x {"
+                    "  namespace urn:x;"
+                    "  prefix x;"
+                    "  typedef base {"
+                    "    type int32 {"
+                    "      range \"-100..-50 | 0 | 10..20 | 30..max\";"
+                    "    }"
+                    "  }"
+                    "  leaf a {"
+                    "    type base {"
+                    "      range \"-60..-55 | 0 | 12..15 | 40\" {"
+                    "        error-message \"Out of range.\";"
+                    "      }"
+                    "    }"
+                    "  }"
+                    "  leaf b {"
+                    "    type decimal64 {"
+                    "      fraction-digits 2;"
+                    "      range \"-1.5..-0.5 | 0.25 | 1..2.75\";"
+                    "    }"
+                    "  }"
+                    "  leaf c {"
+                    "    type string {"
+                    "      length \"1 | 3..4 | 6..max\";"
+                    "    }"
+                    "  }"
+                    "}";
+
+    mod = lys_parse_mem(st->ctx, yang, LYS_IN_YANG);
+    assert_ptr_not_equal(mod, NULL);
+
+    /* a, both restrictions must be satisfied */
+    node = mod->data;
+    assert_int_equal(lyd_validate_value(node, "-101"), EXIT_FAILURE);
+    assert_int_equal(lyd_validate_value(node, "-61"), EXIT_FAILURE);
+    assert_int_equal(lyd_validate_value(node, "-60"), EXIT_SUCCESS);
+    assert_int_equal(lyd_validate_value(node, "-55"), EXIT_SUCCESS);
+    assert_int_equal(lyd_validate_value(node, "-54"), EXIT_FAILURE);
+    assert_string_equal(ly_errmsg(st->ctx), "Out of range.");
+    assert_int_equal(lyd_validate_value(node, "-1"), EXIT_FAILURE);
+    assert_int_equal(lyd_validate_value(node, "0"), EXIT_SUCCESS);
+    assert_int_equal(lyd_validate_value(node, "11"), EXIT_FAILURE);
+    assert_int_equal(lyd_validate_value(node, "12"), EXIT_SUCCESS);
+    assert_int_equal(lyd_validate_value(node, "15"), EXIT_SUCCESS);
+    assert_int_equal(lyd_validate_value(node, "16"), EXIT_FAILURE);
+    assert_int_equal(lyd_validate_value(node, "25"), EXIT_FAILURE);
+    assert_int_equal(lyd_validate_value(node, "40"), EXIT_SUCCESS);
+    assert_int_equal(lyd_validate_value(node, "41"), EXIT_FAILURE);
+
+    /* b */
+    node = node->next;
+    assert_int_equal(lyd_validate_value(node, "-1.51"), EXIT_FAILURE);
+    assert_int_equal(lyd_validate_value(node, "-1.5"), EXIT_SUCCESS);
+    assert_int_equal(lyd_validate_value(node, "-0.5"), EXIT_SUCCESS);
+    assert_int_equal(lyd_validate_value(node, "0"), EXIT_FAILURE);
+    assert_int_equal(lyd_validate_value(node, "0.25"), EXIT_SUCCESS);
+    assert_int_equal(lyd_validate_value(node, "0.26"), EXIT_FAILURE);
+    assert_int_equal(lyd_validate_value(node, "2.75"), EXIT_SUCCESS);
+    assert_int_equal(lyd_validate_value(node, "2.76"), EXIT_FAILURE);
+
+    /* c */
+    node = node->next;
+    assert_int_equal(lyd_validate_value(node, ""), EXIT_FAILURE);
+    assert_int_equal(lyd_validate_value(node, "a"), EXIT_SUCCESS);
+    assert_int_equal(lyd_validate_value(node, "aa"), EXIT_FAILURE);
+    assert_int_equal(lyd_validate_value(node, "aaaa"), EXIT_SUCCESS);
+    assert_int_equal(lyd_validate_value(node, "aaaaa"), EXIT_FAILURE);
+    assert_int_equal(lyd_validate_value(node, "aaaaaaaaaa"), EXIT_SUCCESS);
+}
+
+static void
+test_value_checker(void **state)
+{
+    struct state *st = (*state);
+    const struct lys_module *mod;
+    struct lyd_value_checker *checker;
+    const char *canonical;
+    int64_t dec;
+    int32_t num;
+    const char *yang = "module x {"
+                    "  namespace urn:x;"
+                    "  prefix x;"
+                    "  leaf a {"
+                    "    type int32 {"
+                    "      range \"0..100\";"
+                    "    }"
+                    "  }"
+                    "  leaf b {"
+                    "    type leafref {"
+                    "      path \"/a\";"
+                    "    }"
+                    "  }"
+                    "  leaf c {"
+                    "    type decimal64 {"
+                    "      fraction-digits 2;"
+                    "    }"
+                    "  }"
+                    "  leaf d {"
+                    "    type string {"
+                    "      pattern \"[a-z]+\";"
+                    "    }"
+                    "  }"
+                    "  leaf e {"
+                    "    type bits {"
+                    "      bit one;"
+                    "      bit two;"
+                    "    }"
+                    "  }"
+                    "}";
+
+    mod = lys_parse_mem(st->ctx, yang, LYS_IN_YANG);
+    assert_ptr_not_equal(mod, NULL);
+
+    assert_ptr_equal(lyd_value_checker_new(NULL), NULL);
+
+    /* a */
+    checker = lyd_value_checker_new(mod->data);
+    assert_ptr_not_equal(checker, NULL);
+    assert_int_equal(lyd_value_checker_check(checker, "101", NULL), EXIT_FAILURE);
+    assert_int_equal(lyd_value_checker_check(checker, "+05", &canonical), EXIT_SUCCESS);
+    assert_string_equal(canonical, "5");
+    num = 42;
+    assert_int_equal(lyd_value_checker_check_typed(checker, &num, &canonical), EXIT_SUCCESS);
+    assert_string_equal(canonical, "42");
+    num = -1;
+    assert_int_equal(lyd_value_checker_check_typed(checker, &num, NULL), EXIT_FAILURE);
+    lyd_value_checker_free(checker);
+
+    /* b, checked as its target */
+    checker = lyd_value_checker_new(mod->data->next);
+    assert_ptr_not_equal(checker, NULL);
+    assert_int_equal(lyd_value_checker_check(checker, "-1", NULL), EXIT_FAILURE);
+    assert_int_equal(lyd_value_checker_check(checker, "100", &canonical), EXIT_SUCCESS);
+    assert_string_equal(canonical, "100");
+    lyd_value_checker_free(checker);
+
+    /* c */
+    checker = lyd_value_checker_new(mod->data->next->next);
+    assert_ptr_not_equal(checker, NULL);
+    assert_int_equal(lyd_value_checker_check(checker, "1.5", &canonical), EXIT_SUCCESS);
+    assert_string_equal(canonical, "1.5");
+    assert_int_equal(lyd_value_checker_check(checker, "1.555", NULL), EXIT_FAILURE);
+    dec = -125;
+    assert_int_equal(lyd_value_checker_check_typed(checker, &dec, &canonical), EXIT_SUCCESS);
+    assert_string_equal(canonical, "-1.25");
+    lyd_value_checker_free(checker);
+
+    /* d, no typed values */
+    checker = lyd_value_checker_new(mod->data->next->next->next);
+    assert_ptr_not_equal(checker, NULL);
+    assert_int_equal(lyd_value_checker_check(checker, "abc", &canonical), EXIT_SUCCESS);
+    assert_string_equal(canonical, "abc");
+    assert_int_equal(lyd_value_checker_check(checker, "ABC", NULL), EXIT_FAILURE);
+    assert_int_equal(lyd_value_checker_check(checker, "xyz", NULL), EXIT_SUCCESS);
+    assert_int_equal(lyd_value_checker_check_typed(checker, &num, NULL), EXIT_FAILURE);
+    lyd_value_checker_free(checker);
+
+    /* e, the previous value is released on each check */
+    checker = lyd_value_checker_new(mod->data->next->next->next->next);
+    assert_ptr_not_equal(checker, NULL);
+    assert_int_equal(lyd_value_checker_check(checker, "two one", &canonical), EXIT_SUCCESS);
+    assert_string_equal(canonical, "one two");
+    assert_int_equal(lyd_value_checker_check(checker, "two", &canonical), EXIT_SUCCESS);
+    assert_string_equal(canonical, "two");
+    assert_int_equal(lyd_value_checker_check(checker, "three", NULL), EXIT_FAILURE);
+    assert_int_equal(lyd_value_checker_check(checker, "one", NULL), EXIT_SUCCESS);
+    lyd_value_checker_free(checker);
+}
+
+static void
+test_union_member(void **state)
+{
+    struct state *st = (*state);
+    const struct lys_module *mod;
+    struct lyd_node_leaf_list *leaf;
+    const char *yang = "module x {"
+                    "  yang-version 1.1;"
+                    "  namespace urn:x;"
+                    "  prefix x;"
+                    "  leaf u {"
+                    "    type union {"
+                    "      type int8;"
+                    "      type boolean;"
+                    "      type decimal64 {"
+                    "        fraction-digits 2;"
+                    "      }"
+                    "      type string {"
+                    "        length 1..max;"
+                    "      }"
+                    "      type empty;"
+                    "    }"
+                    "  }"
+                    "}";
+    struct {
+        const char *value;
+        LY_DATA_TYPE type;
+    } values[] = {{"5", LY_TYPE_INT8}, {" -7", LY_TYPE_INT8}, {"300", LY_TYPE_DEC64}, {"true", LY_TYPE_BOOL},
+                  {"1.5", LY_TYPE_DEC64}, {"+.5", LY_TYPE_STRING}, {"false ", LY_TYPE_STRING},
+                  {"abc", LY_TYPE_STRING}, {"", LY_TYPE_EMPTY}};
+    unsigned int i;
+
+    mod = lys_parse_mem(st->ctx, yang, LYS_IN_YANG);
+    assert_ptr_not_equal(mod, NULL);
+
+    /* the first member type the value is valid for is used */
+    for (i = 0; i < sizeof values / sizeof *values; ++i) {
+        leaf = (struct lyd_node_leaf_list *)lyd_new_leaf(NULL, mod, "u", values[i].value);
+        assert_non_null(leaf);
+        assert_int_equal(leaf->value_type, values[i].type);
+        lyd_free((struct lyd_node *)leaf);
+    }
+}
+
 void test_xmltojson_anydata(void **state)
 {
     struct state *st = (*state);
@@ -516,6 +735,9 @@ int main(void)
                     cmocka_unit_test_setup_teardown(test_xmltojson_instanceid, setup_f, teardown_f),
                     cmocka_unit_test_setup_teardown(test_canonical, setup_f, teardown_f),
                     cmocka_unit_test_setup_teardown(test_validate_value, setup_f, teardown_f),
+                    cmocka_unit_test_setup_teardown(test_validate_value_ranges, setup_f, teardown_f),
+                    cmocka_unit_test_setup_teardown(test_value_checker, setup_f, teardown_f),
+                    cmocka_unit_test_setup_teardown(test_union_member, setup_f, teardown_f),
                     cmocka_unit_test_setup_teardown(test_xmltojson_anydata, setup_f, teardown_f),
                     cmocka_unit_test_setup_teardown(test_xmltojson_extension, setup_f, teardown_f),
     };
@@ -283,6 +283,15 @@ test_action(void **state)
                 "<conditional_action/>"
             "</conditional>"
         "</advanced>";
+    const char act_invalid[] =
+        "<action xmlns=\"urn:ietf:params:xml:ns:yang:1\">"
+            "<advanced xmlns=\"urn:act1\">"
+                "<conditional xmlns=\"urn:act2\">"
+                    "<conditional_action/>"
+                "</conditional>"
+            "</advanced>"
+            "<unknown xmlns=\"urn:act1\"/>"
+        "</action>";
     const char data[] =
         "<advanced xmlns=\"urn:act1\">"
             "<condition>true</condition>"
@@ -303,6 +312,9 @@ test_action(void **state)
 
     st->act = lyd_parse_mem(st->ctx, act, LYD_XML, LYD_OPT_RPC, st->dt);
     assert_non_null(st->act);
+
+    /* the parsed XML tree is freed properly also after an error in the action */
+    assert_null(lyd_parse_mem(st->ctx, act_invalid, LYD_XML, LYD_OPT_RPC | LYD_OPT_STRICT, st->dt));
 }
 
 int main(void)
@@ -235,6 +235,35 @@ test_unlink_all(void **state)
     assert_string_equal(st->xml, "<a xmlns=\"urn:libyang:tests:when-unlinkall\">val_a</a>");
 }
 
+static void
+test_augment_memo(void **state)
+{
+    struct state *st = (struct state *)*state;
+    struct ly_ctx_counters prev, cnt;
+    const char *yang = "module when-memo {namespace urn:libyang:tests:when-memo; prefix wm;"
+        "container top {leaf flag {type boolean;} container sub;}"
+        "augment /top/sub {when \"../flag = 'true'\"; leaf a {type string;} leaf b {type string;} leaf c {type string;}}}";
+    const char *xml = "<top xmlns=\"urn:libyang:tests:when-memo\"><flag>true</flag>"
+        "<sub><a>1</a><b>2</b><c>3</c></sub></top>";
+
+    st->mod = lys_parse_mem(st->ctx, yang, LYS_IN_YANG);
+    assert_ptr_not_equal(st->mod, NULL);
+
+    /* the augment condition is evaluated once for all its leaves */
+    assert_int_equal(ly_ctx_get_counters(st->ctx, &prev), 0);
+    st->dt = lyd_parse_mem(st->ctx, xml, LYD_XML, LYD_OPT_CONFIG);
+    assert_ptr_not_equal(st->dt, NULL);
+    assert_int_equal(ly_ctx_get_counters(st->ctx, &cnt), 0);
+    assert_int_equal(cnt.when_evals - prev.when_evals, 1);
+
+    /* a new validation does not reuse the results */
+    lyd_free_withsiblings(st->dt);
+    st->dt = lyd_parse_mem(st->ctx, "<top xmlns=\"urn:libyang:tests:when-memo\"><flag>false</flag>"
+                           "<sub><a>1</a><b>2</b><c>3</c></sub></top>", LYD_XML, LYD_OPT_CONFIG);
+    assert_ptr_equal(st->dt, NULL);
+    assert_int_equal(ly_vecode(st->ctx), LYVE_NOWHEN);
+}
+
 int main(void)
 {
     const struct CMUnitTest tests[] = {
@@ -245,7 +274,8 @@ int main(void)
                     cmocka_unit_test_setup_teardown(test_dummy, setup_f, teardown_f),
                     cmocka_unit_test_setup_teardown(test_dependency_noautodel, setup_f, teardown_f),
                     cmocka_unit_test_setup_teardown(test_dependency_circular, setup_f, teardown_f),
-                    cmocka_unit_test_setup_teardown(test_unlink_all, setup_f, teardown_f)
+                    cmocka_unit_test_setup_teardown(test_unlink_all, setup_f, teardown_f),
+                    cmocka_unit_test_setup_teardown(test_augment_memo, setup_f, teardown_f)
     };
 
     return cmocka_run_group_tests(tests, NULL, NULL);
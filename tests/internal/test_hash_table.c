@@ -15,11 +15,13 @@
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <setjmp.h>
 #include <cmocka.h>
 
 #include "tests/config.h"
 #include "libyang.h"
+#include "common.h"
 #include "hash_table.h"
 
 static struct hash_table *ht;
@@ -65,6 +67,20 @@ setup_f_resize(void **state)
     return 0;
 }
 
+static int
+setup_f_large(void **state)
+{
+    (void)state;
+
+    ht = lyht_new(64, sizeof(int), val_equal, NULL, 1);
+    if (!ht) {
+        fprintf(stderr, "Failed to create hash table.\n");
+        return -1;
+    }
+
+    return 0;
+}
+
 static int
 teardown_f(void **state)
 {
@@ -125,11 +141,12 @@ test_half_full(void **state)
     assert_int_equal(lyht_find(ht, &l, l, NULL), 1);
 }
 
+#define GET_REC_VAL(idx) (*((int *)lyht_get_val(ht, idx)))
+
 static void
 test_resize(void **state)
 {
     int i;
-    struct ht_rec *rec;
     (void)state;
 
     for (i = 2; i < 8; ++i) {
@@ -139,17 +156,17 @@ test_resize(void **state)
     assert_int_equal(ht->size, 16);
 
     for (i = 0; i < 2; ++i) {
-        rec = lyht_get_rec(ht->recs, ht->rec_size, i);
-        assert_int_equal(rec->hits, 0);
+        assert_ptr_equal(lyht_get_val(ht, i), NULL);
+        assert_int_equal(ht->ctrl[i], LYHT_CTRL_EMPTY);
     }
     for (; i < 8; ++i) {
-        rec = lyht_get_rec(ht->recs, ht->rec_size, i);
-        assert_int_equal(rec->hits, 1);
-        assert_int_equal(rec->hash, i);
+        assert_ptr_not_equal(lyht_get_val(ht, i), NULL);
+        assert_int_equal(GET_REC_VAL(i), i);
+        assert_int_equal(ht->hashes[i], i);
     }
     for (; i < 16; ++i) {
-        rec = lyht_get_rec(ht->recs, ht->rec_size, i);
-        assert_int_equal(rec->hits, 0);
+        assert_ptr_equal(lyht_get_val(ht, i), NULL);
+        assert_int_equal(ht->ctrl[i], LYHT_CTRL_EMPTY);
     }
 
     for (i = 0; i < 2; ++i) {
@@ -173,13 +190,10 @@ test_resize(void **state)
     }
 }
 
-#define GET_REC_VAL(rec) (*((int *)&(rec)->val))
-
 static void
 test_collisions(void **state)
 {
     int i;
-    struct ht_rec *rec;
     (void)state;
 
     for (i = 2; i < 6; ++i) {
@@ -188,53 +202,27 @@ test_collisions(void **state)
 
     /* check all records */
     for (i = 0; i < 2; ++i) {
-        rec = lyht_get_rec(ht->recs, ht->rec_size, i);
-        assert_int_equal(rec->hits, 0);
+        assert_ptr_equal(lyht_get_val(ht, i), NULL);
     }
-    rec = lyht_get_rec(ht->recs, ht->rec_size, i);
-    assert_int_equal(rec->hits, 4);
-    assert_int_equal(GET_REC_VAL(rec), i);
-    ++i;
     for (; i < 6; ++i) {
-        rec = lyht_get_rec(ht->recs, ht->rec_size, i);
-        assert_int_equal(rec->hits, 1);
-        assert_int_equal(GET_REC_VAL(rec), i);
+        assert_ptr_not_equal(lyht_get_val(ht, i), NULL);
+        assert_int_equal(GET_REC_VAL(i), i);
+        assert_int_equal(ht->hashes[i], 2);
     }
     for (; i < 8; ++i) {
-        rec = lyht_get_rec(ht->recs, ht->rec_size, i);
-        assert_int_equal(rec->hits, 0);
+        assert_ptr_equal(lyht_get_val(ht, i), NULL);
     }
 
+    /* the whole small table is probed at once so no deleted records are needed */
     i = 4;
     assert_int_equal(lyht_remove(ht, &i, 2), 0);
-
-    rec = lyht_get_rec(ht->recs, ht->rec_size, i);
-    assert_int_equal(rec->hits, -1);
+    assert_int_equal(ht->ctrl[i], LYHT_CTRL_EMPTY);
 
     i = 2;
     assert_int_equal(lyht_remove(ht, &i, 2), 0);
-
-    /* check all records */
-    for (i = 0; i < 2; ++i) {
-        rec = lyht_get_rec(ht->recs, ht->rec_size, i);
-        assert_int_equal(rec->hits, 0);
-    }
-    rec = lyht_get_rec(ht->recs, ht->rec_size, i);
-    assert_int_equal(rec->hits, 2);
-    assert_int_equal(GET_REC_VAL(rec), 5);
-    ++i;
-    rec = lyht_get_rec(ht->recs, ht->rec_size, i);
-    assert_int_equal(rec->hits, 1);
-    assert_int_equal(GET_REC_VAL(rec), 3);
-    ++i;
-    for (; i < 6; ++i) {
-        rec = lyht_get_rec(ht->recs, ht->rec_size, i);
-        assert_int_equal(rec->hits, -1);
-    }
-    for (; i < 8; ++i) {
-        rec = lyht_get_rec(ht->recs, ht->rec_size, i);
-        assert_int_equal(rec->hits, 0);
-    }
+    assert_int_equal(ht->ctrl[i], LYHT_CTRL_EMPTY);
+    assert_int_equal(ht->used, 2);
+    assert_int_equal(ht->deleted, 0);
 
     for (i = 0; i < 3; ++i) {
         assert_int_equal(lyht_find(ht, &i, 2, NULL), 1);
@@ -255,25 +243,144 @@ test_collisions(void **state)
     assert_int_equal(lyht_remove(ht, &i, 2), 0);
 
     /* check all records */
-    for (i = 0; i < 2; ++i) {
-        rec = lyht_get_rec(ht->recs, ht->rec_size, i);
-        assert_int_equal(rec->hits, 0);
+    for (i = 0; i < 8; ++i) {
+        assert_int_equal(ht->ctrl[i], LYHT_CTRL_EMPTY);
     }
-    for (; i < 6; ++i) {
-        rec = lyht_get_rec(ht->recs, ht->rec_size, i);
-        assert_int_equal(rec->hits, -1);
+}
+
+static void
+test_deleted(void **state)
+{
+    int i, a[48];
+
+    (void)state;
+
+    for (i = 0; i < 48; ++i) {
+        a[i] = i;
     }
-    for (; i < 8; ++i) {
-        rec = lyht_get_rec(ht->recs, ht->rec_size, i);
-        assert_int_equal(rec->hits, 0);
+
+    /* one long probe sequence */
+    for (i = 0; i < 40; ++i) {
+        assert_int_equal(lyht_insert(ht, &a[i], 0, NULL), 0);
     }
+    assert_int_equal(ht->size, 64);
+
+    /* removed records inside it must be kept deleted */
+    for (i = 1; i < 11; ++i) {
+        assert_int_equal(lyht_remove(ht, &a[i], 0), 0);
+        assert_int_equal(ht->ctrl[i], LYHT_CTRL_DELETED);
+    }
+    assert_int_equal(ht->used, 30);
+    assert_int_equal(ht->deleted, 10);
+
+    /* even the last record of the sequence is in a group of non-empty records, removed value is reinserted at the first free record */
+    assert_int_equal(lyht_remove(ht, &a[39], 0), 0);
+    assert_int_equal(ht->deleted, 11);
+    assert_int_equal(lyht_insert(ht, &a[39], 0, NULL), 0);
+    assert_int_equal(ht->deleted, 10);
+
+    /* values elsewhere, together with the deleted records the table gets full enough to be compacted */
+    for (i = 40; i < 47; ++i) {
+        assert_int_equal(lyht_insert(ht, &a[i], i + 10, NULL), 0);
+        assert_int_equal(ht->deleted, 10);
+    }
+    assert_int_equal(lyht_insert(ht, &a[47], 57, NULL), 0);
+    assert_int_equal(ht->size, 64);
+    assert_int_equal(ht->used, 38);
+    assert_int_equal(ht->deleted, 0);
+
+    for (i = 0; i < 40; ++i) {
+        assert_int_equal(lyht_find(ht, &a[i], 0, NULL), ((i > 0) && (i < 11)) ? 1 : 0);
+    }
+    for (; i < 48; ++i) {
+        assert_int_equal(lyht_find(ht, &a[i], i + 10, NULL), 0);
+    }
+}
+
+static void
+test_find_next(void **state)
+{
+    int i, *match;
+    (void)state;
+
+    for (i = 0; i < 4; ++i) {
+        assert_int_equal(lyht_insert(ht, &i, 5, NULL), 0);
+    }
+
+    /* values with the same hash are returned in the insertion order */
+    i = 0;
+    assert_int_equal(lyht_find(ht, &i, 5, (void **)&match), 0);
+    assert_int_equal(*match, 0);
+    for (i = 1; i < 4; ++i) {
+        assert_int_equal(lyht_find_next(ht, match, 5, (void **)&match), 0);
+        assert_int_equal(*match, i);
+    }
+    assert_int_equal(lyht_find_next(ht, match, 5, (void **)&match), 1);
+}
+
+static void
+test_incremental(void **state)
+{
+    int i, n, val, *match;
+    uint32_t size;
+
+    (void)state;
+
+    /* value with a collision that is moved last */
+    val = -1;
+    assert_int_equal(lyht_insert(ht, &val, LYHT_INCREMENTAL_SIZE - 1, NULL), 0);
+
+    /* fill the table until it starts being enlarged incrementally */
+    for (i = 0; !ht->old; ++i) {
+        assert_int_equal(lyht_insert(ht, &i, i * 2654435761U, NULL), 0);
+    }
+    size = ht->size;
+    assert_int_equal(size, LYHT_INCREMENTAL_SIZE << 1);
+    assert_int_equal(ht->used, i + 1);
+
+    /* all the values are found, also when inserted again */
+    for (val = 0; val < i; ++val) {
+        assert_int_equal(lyht_find(ht, &val, val * 2654435761U, NULL), 0);
+    }
+    val = 0;
+    assert_int_equal(lyht_insert(ht, &val, 0, NULL), 1);
+
+    /* value with equal hash in the new records is returned first */
+    val = -2;
+    assert_int_equal(lyht_insert(ht, &val, LYHT_INCREMENTAL_SIZE - 1, NULL), 0);
+    assert_ptr_not_equal(ht->old, NULL);
+    assert_int_equal(lyht_find(ht, &val, LYHT_INCREMENTAL_SIZE - 1, (void **)&match), 0);
+    assert_int_equal(*match, -2);
+    assert_int_equal(lyht_find_next(ht, match, LYHT_INCREMENTAL_SIZE - 1, (void **)&match), 0);
+    assert_int_equal(*match, -1);
+    assert_int_equal(lyht_find_next(ht, match, LYHT_INCREMENTAL_SIZE - 1, (void **)&match), 1);
+
+    /* remove values both moved and not yet moved */
+    n = i;
+    for (val = 0; val < n; val += 64) {
+        assert_int_equal(lyht_remove(ht, &val, val * 2654435761U), 0);
+    }
+    val = -1;
+    assert_int_equal(lyht_remove(ht, &val, LYHT_INCREMENTAL_SIZE - 1), 0);
+    assert_int_equal(lyht_remove(ht, &val, LYHT_INCREMENTAL_SIZE - 1), 1);
+    assert_ptr_not_equal(ht->old, NULL);
+
+    /* keep inserting until all the values are moved */
+    for (; ht->old; ++i) {
+        assert_int_equal(lyht_insert(ht, &i, i * 2654435761U, NULL), 0);
+    }
+    assert_int_equal(ht->size, size);
+    for (val = 0; val < i; ++val) {
+        assert_int_equal(lyht_find(ht, &val, val * 2654435761U, NULL), ((val < n) && !(val % 64)) ? 1 : 0);
+    }
+    val = -2;
+    assert_int_equal(lyht_find(ht, &val, LYHT_INCREMENTAL_SIZE - 1, NULL), 0);
 }
 
 static void
 test_invalid_move(void **state)
 {
     int i, a[] = { 0, 1, 2, 3, 4, 5, 6, 7, 8 };
-    struct ht_rec *rec;
 
     (void)state;
 
@@ -293,21 +400,22 @@ test_invalid_move(void **state)
     assert_int_equal(lyht_insert(ht, &a[6], 6, NULL), 0);
     assert_int_equal(lyht_insert(ht, &a[7], 7, NULL), 0);
 
-    /* these are the invalid values */
+    /* these are the removed values */
     for (i = 1; i < 4; ++i) {
-        rec = lyht_get_rec(ht->recs, ht->rec_size, i);
-        assert_int_equal(rec->hits, -1);
+        assert_int_equal(ht->ctrl[i], LYHT_CTRL_EMPTY);
     }
 
-    /* if all the values were being moved correctly, this succeeds */
+    /* the first free record is reused */
     assert_int_equal(lyht_insert(ht, &a[8], 0, NULL), 0);
-
-    rec = lyht_get_rec(ht->recs, ht->rec_size, 0);
-    assert_int_equal(rec->hits, 3);
-    rec = lyht_get_rec(ht->recs, ht->rec_size, 1);
-    assert_int_equal(rec->hits, 1);
-    rec = lyht_get_rec(ht->recs, ht->rec_size, 2);
-    assert_int_equal(rec->hits, 1);
+    assert_int_equal(GET_REC_VAL(1), 8);
+    assert_int_equal(ht->ctrl[2], LYHT_CTRL_EMPTY);
+
+    /* there is no empty record left, all still must be found */
+    assert_int_equal(lyht_find(ht, &a[0], 0, NULL), 0);
+    assert_int_equal(lyht_find(ht, &a[4], 0, NULL), 0);
+    assert_int_equal(lyht_find(ht, &a[8], 0, NULL), 0);
+    assert_int_equal(lyht_find(ht, &a[7], 7, NULL), 0);
+    assert_int_equal(lyht_find(ht, &a[2], 2, NULL), 1);
 }
 
 static void
@@ -353,6 +461,63 @@ test_invalid_move2(void **state)
     assert_int_equal(lyht_find(ht, &a[8 + 3], 3, NULL), 0);
 }
 
+static void
+test_dict_plain(void **state)
+{
+    (void)state;
+    struct ly_ctx *ctx;
+    const char *specials = "&<>\"\\\n";
+    /* the escaped characters of each special character */
+    int esc[] = {LY_ESC_XML_ELEM | LY_ESC_XML_ATTR, LY_ESC_XML_ELEM | LY_ESC_XML_ATTR, LY_ESC_XML_ELEM | LY_ESC_XML_ATTR,
+                 LY_ESC_XML_ATTR | LY_ESC_JSON, LY_ESC_JSON, LY_ESC_JSON};
+    char buf[41], *zc;
+    const char *str;
+    int i, j, flag;
+
+    ctx = ly_ctx_new(NULL, 0);
+    assert_non_null(ctx);
+
+    memset(buf, 'a', 40);
+    buf[40] = '\0';
+    assert_int_equal(ly_strlen_noesc(buf, LY_ESC_XML_ATTR | LY_ESC_JSON), 40);
+    str = lydict_insert(ctx, buf, 40);
+    assert_true(lydict_plain(str, 40));
+    assert_true(lydict_plain(str + 5, 35));
+    lydict_remove(ctx, str);
+
+    /* non-ASCII characters are not escaped */
+    assert_int_equal(ly_strlen_noesc("\xc3\xa1\xc3\xa1\xc3\xa1\xc3\xa1\xc3\xa1\xc3\xa1\xc3\xa1\xc3\xa1\xc3\xa1", LY_ESC_JSON), 18);
+    assert_int_equal(ly_strlen_noesc("\xc3\xa1\xc3\xa1\xc3\xa1\xc3\xa1\xc3\xa1\xc3\xa1\xc3\xa1\xc3\xa1\xc3\xa1", LY_ESC_NONASCII), 0);
+    buf[37] = '\x80';
+    assert_int_equal(ly_strlen_noesc(buf, LY_ESC_JSON | LY_ESC_NONASCII), 37);
+    assert_int_equal(ly_strlen_noesc(buf, LY_ESC_JSON), 40);
+    buf[37] = 'a';
+
+    /* a special character at every position of the blocks */
+    for (i = 0; specials[i]; ++i) {
+        for (j = 0; j < 40; ++j) {
+            buf[j] = specials[i];
+            for (flag = LY_ESC_XML_ELEM; flag <= LY_ESC_JSON; flag <<= 1) {
+                assert_int_equal(ly_strlen_noesc(buf, flag), (esc[i] & flag) ? j : 40);
+                assert_int_equal(ly_strlen_noesc(buf + 3, flag), (esc[i] & flag) ? ((j < 3) ? 37 : j - 3) : 37);
+            }
+
+            str = lydict_insert(ctx, buf, 40);
+            assert_false(lydict_plain(str, 40));
+            lydict_remove(ctx, str);
+
+            zc = strdup(buf);
+            assert_non_null(zc);
+            str = lydict_insert_zc(ctx, zc);
+            assert_false(lydict_plain(str, 40));
+            lydict_remove(ctx, str);
+            buf[j] = 'a';
+        }
+    }
+
+    ly_ctx_destroy(ctx, NULL);
+}
+
 int main(void)
 {
     const struct CMUnitTest tests[] = {
@@ -360,8 +525,12 @@ int main(void)
         cmocka_unit_test_setup_teardown(test_half_full, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_resize, setup_f_resize, teardown_f),
         cmocka_unit_test_setup_teardown(test_collisions, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_deleted, setup_f_large, teardown_f),
+        cmocka_unit_test_setup_teardown(test_find_next, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_incremental, setup_f_resize, teardown_f),
         cmocka_unit_test_setup_teardown(test_invalid_move, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_invalid_move2, setup_f, teardown_f),
+        cmocka_unit_test(test_dict_plain),
     };
 
     /*ly_verb(LY_LLDBG);
@@ -19,9 +19,11 @@
 #include <stdarg.h>
 #include <cmocka.h>
 #include <inttypes.h>
+#include <unistd.h>
 
 #include "tests/config.h"
 #include "libyang.h"
+#include "common.h"
 #include "tree_internal.h"
 #include "hash_table.h"
 
@@ -460,6 +462,70 @@ test_many_child_annot(void **state)
     check_data_tree(st->dt1, st->dt2);
 }
 
+static void
+test_annotation_index(void **state)
+{
+    struct state *st = (*state);
+    /* annotation with its module name in LYB_VERSION_SIZES */
+    const char lyb_sizes[] =
+"lyb\020\001\000\013\000annotations\000\000=\000\000\000\013\000annotations\000\000\311\000("
+        "\000\000\000\210\000\042\000\000\000\253\001\032\000\000\000\013\000annotations\000\000\007"
+        "\000astring\012s\012v\021\000\000\000\013\000annotations\000\000\333\000#\000\000\000\013"
+        "\000annotations\000\000\307\000\010\000\000\000\223\000\002\000\000\000\342\000\002\000\000"
+        "\000\233\000+\000\000\000\013\000annotations\000\000\203\000\020\000\000\000\263\000\012\000"
+        "\000\000B\320\000\003\000\000\000l\270\000\002\000\000\000\307\000\000";
+    char *data, *s, *mem;
+    int i, len, plain_len;
+
+    ly_ctx_set_searchdir(st->ctx, TESTS_DIR"/data/files");
+    assert_non_null(ly_ctx_load_module(st->ctx, "annotations", NULL));
+
+    /* previous format version is still parsed */
+    st->dt1 = lyd_parse_mem(st->ctx, "<annotations xmlns=\"urn:annot\" xmlns:p=\"urn:annot\"><annot>"
+                            "<annoted-leaf p:astring=\"s\">v</annoted-leaf></annot></annotations>", LYD_XML, LYD_OPT_CONFIG);
+    assert_ptr_not_equal(st->dt1, NULL);
+    assert_int_equal(lyd_lyb_data_length(lyb_sizes), sizeof lyb_sizes - 1);
+    st->dt2 = lyd_parse_mem(st->ctx, lyb_sizes, LYD_LYB, LYD_OPT_CONFIG | LYD_OPT_STRICT);
+    assert_ptr_not_equal(st->dt2, NULL);
+    check_data_tree(st->dt1, st->dt2);
+    lyd_free_withsiblings(st->dt1);
+    lyd_free_withsiblings(st->dt2);
+    st->dt1 = st->dt2 = NULL;
+
+    /* the same data with and without an annotation on every node */
+    data = malloc(100 * 64 + 64);
+    assert_non_null(data);
+    s = data + sprintf(data, "<annotations xmlns=\"urn:annot\" xmlns:p=\"urn:annot\">");
+    for (i = 0; i < 100; ++i) {
+        s += sprintf(s, "<annot><annoted-leaf>s%d</annoted-leaf></annot>", i);
+    }
+    strcpy(s, "</annotations>");
+    st->dt1 = lyd_parse_mem(st->ctx, data, LYD_XML, LYD_OPT_CONFIG);
+    assert_ptr_not_equal(st->dt1, NULL);
+    assert_int_equal(lyd_print_mem(&mem, st->dt1, LYD_LYB, LYP_WITHSIBLINGS), 0);
+    plain_len = lyd_lyb_data_length(mem);
+    free(mem);
+    lyd_free_withsiblings(st->dt1);
+
+    s = data + sprintf(data, "<annotations xmlns=\"urn:annot\" xmlns:p=\"urn:annot\">");
+    for (i = 0; i < 100; ++i) {
+        s += sprintf(s, "<annot><annoted-leaf p:astring=\"s\">s%d</annoted-leaf></annot>", i);
+    }
+    strcpy(s, "</annotations>");
+    st->dt1 = lyd_parse_mem(st->ctx, data, LYD_XML, LYD_OPT_CONFIG);
+    assert_ptr_not_equal(st->dt1, NULL);
+    free(data);
+
+    assert_int_equal(lyd_print_mem(&st->mem, st->dt1, LYD_LYB, LYP_WITHSIBLINGS), 0);
+    st->dt2 = lyd_parse_mem(st->ctx, st->mem, LYD_LYB, LYD_OPT_CONFIG | LYD_OPT_STRICT);
+    assert_ptr_not_equal(st->dt2, NULL);
+    check_data_tree(st->dt1, st->dt2);
+
+    /* only the annotation table holds the names, each attribute is its subtree size, index and value */
+    len = lyd_lyb_data_length(st->mem);
+    assert_true(len - plain_len <= 100 * (LYB_SUBTREE_SIZE_BYTES + 3) + 32);
+}
+
 static void
 test_union(void **state)
 {
@@ -658,6 +724,404 @@ test_leafrefs(void **state)
     check_data_tree(st->dt1, st->dt2);
 }
 
+static void
+test_versions(void **state)
+{
+    struct state *st = (*state);
+    const char *yang = "module lg {namespace urn:lg; prefix lg; container c {leaf s {type string;} leaf-list n {type uint16;}}}";
+    /* {"lg:c":{"s":"a" x 300,"n":[1,2]}} printed in LYB_VERSION_CHUNKS */
+    const char lyb_chunks[] =
+        "lyb\000\001\000\002\000lg\000\000\377\001\002\000lg\000\000\332\000\377\000\365\000\012aaaaaaaaa"
+        "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa"
+        "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa"
+        "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaB\003aaaaaaaa0\000aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa"
+        "aaaaaaaaaaaaa\005\000\346\000\017\001\000\005\000\346\000\017\002\000\000";
+    char *data, *s;
+    int ret;
+
+    assert_non_null(lys_parse_mem(st->ctx, yang, LYS_IN_YANG));
+
+    data = malloc(100100);
+    assert_non_null(data);
+    s = data + sprintf(data, "{\"lg:c\":{\"s\":\"");
+    memset(s, 'a', 300);
+    strcpy(s + 300, "\",\"n\":[1,2]}}");
+    st->dt1 = lyd_parse_mem(st->ctx, data, LYD_JSON, LYD_OPT_CONFIG);
+    assert_ptr_not_equal(st->dt1, NULL);
+
+    /* previous format version is still parsed */
+    assert_int_equal(lyd_lyb_data_length(lyb_chunks), sizeof lyb_chunks - 1);
+    st->dt2 = lyd_parse_mem(st->ctx, lyb_chunks, LYD_LYB, LYD_OPT_CONFIG | LYD_OPT_STRICT);
+    assert_ptr_not_equal(st->dt2, NULL);
+    check_data_tree(st->dt1, st->dt2);
+    lyd_free_withsiblings(st->dt2);
+
+    ret = lyd_print_mem(&st->mem, st->dt1, LYD_LYB, LYP_WITHSIBLINGS);
+    assert_int_equal(ret, 0);
+    assert_int_equal(st->mem[3] & LYB_HEADER_VERSION_MASK, LYB_VERSION_ANNOTS);
+    st->dt2 = lyd_parse_mem(st->ctx, st->mem, LYD_LYB, LYD_OPT_CONFIG | LYD_OPT_STRICT);
+    assert_ptr_not_equal(st->dt2, NULL);
+    check_data_tree(st->dt1, st->dt2);
+    lyd_free_withsiblings(st->dt1);
+    lyd_free_withsiblings(st->dt2);
+    free(st->mem);
+
+    /* large subtree */
+    memset(s, 'a', 100000);
+    strcpy(s + 100000, "\",\"n\":[1,2]}}");
+    st->dt1 = lyd_parse_mem(st->ctx, data, LYD_JSON, LYD_OPT_CONFIG);
+    assert_ptr_not_equal(st->dt1, NULL);
+    free(data);
+
+    ret = lyd_print_mem(&st->mem, st->dt1, LYD_LYB, LYP_WITHSIBLINGS);
+    assert_int_equal(ret, 0);
+    st->dt2 = lyd_parse_mem(st->ctx, st->mem, LYD_LYB, LYD_OPT_CONFIG | LYD_OPT_STRICT);
+    assert_ptr_not_equal(st->dt2, NULL);
+    check_data_tree(st->dt1, st->dt2);
+
+    /* no chunk metadata inside the value */
+    assert_true(lyd_lyb_data_length(st->mem) < 100000 + 64);
+}
+
+static void
+test_hash_index(void **state)
+{
+    struct state *st = (*state);
+    const char *yang1 = "module hi {namespace urn:hi; prefix hi; feature f;"
+                        "container c {leaf a {type string;} leaf b {if-feature f; type string;}}}";
+    const char *yang2 = "module hi-aug {namespace urn:hi-aug; prefix ha; import hi {prefix hi;}"
+                        "augment /hi:c {leaf x {type string;}}}";
+    const struct lys_module *mod;
+    char *mem;
+    int ret;
+
+    mod = lys_parse_mem(st->ctx, yang1, LYS_IN_YANG);
+    assert_non_null(mod);
+    assert_int_equal(lys_features_enable(mod, "f"), 0);
+
+    st->dt1 = lyd_parse_mem(st->ctx, "{\"hi:c\":{\"a\":\"1\",\"b\":\"2\"}}", LYD_JSON, LYD_OPT_CONFIG);
+    assert_ptr_not_equal(st->dt1, NULL);
+    ret = lyd_print_mem(&st->mem, st->dt1, LYD_LYB, LYP_WITHSIBLINGS);
+    assert_int_equal(ret, 0);
+    st->dt2 = lyd_parse_mem(st->ctx, st->mem, LYD_LYB, LYD_OPT_CONFIG | LYD_OPT_STRICT);
+    assert_ptr_not_equal(st->dt2, NULL);
+    check_data_tree(st->dt1, st->dt2);
+    lyd_free_withsiblings(st->dt2);
+
+    /* the indexed siblings follow the feature state */
+    assert_int_equal(lys_features_disable(mod, "f"), 0);
+    st->dt2 = lyd_parse_mem(st->ctx, st->mem, LYD_LYB, LYD_OPT_CONFIG | LYD_OPT_STRICT);
+    assert_ptr_equal(st->dt2, NULL);
+    assert_int_equal(lys_features_enable(mod, "f"), 0);
+
+    /* and the augments of newly added modules */
+    assert_non_null(lys_parse_mem(st->ctx, yang2, LYS_IN_YANG));
+    lyd_free_withsiblings(st->dt1);
+    st->dt1 = lyd_parse_mem(st->ctx, "{\"hi:c\":{\"a\":\"1\",\"hi-aug:x\":\"3\"}}", LYD_JSON, LYD_OPT_CONFIG);
+    assert_ptr_not_equal(st->dt1, NULL);
+    ret = lyd_print_mem(&mem, st->dt1, LYD_LYB, LYP_WITHSIBLINGS);
+    assert_int_equal(ret, 0);
+    st->dt2 = lyd_parse_mem(st->ctx, mem, LYD_LYB, LYD_OPT_CONFIG | LYD_OPT_STRICT);
+    free(mem);
+    assert_ptr_not_equal(st->dt2, NULL);
+    check_data_tree(st->dt1, st->dt2);
+}
+
+static void
+test_canonical_values(void **state)
+{
+    struct state *st = (*state);
+    const char *yang = "module cv {namespace urn:cv; prefix cv;"
+                       "leaf-list d1 {type decimal64 {fraction-digits 1;}} leaf-list d18 {type decimal64 {fraction-digits 18;}}"
+                       "leaf-list i8 {type int8;} leaf-list i64 {type int64;} leaf-list u64 {type uint64;} leaf-list b {type boolean;}"
+                       "leaf-list bt {type bits {bit one; bit two; bit three;}}}";
+    const char *json = "{\"cv:d1\":[\"0\",\"-0.1\",\"-922337203685477580.8\",\"922337203685477580.7\"],"
+                       "\"cv:d18\":[\"-0.000000000000000001\",\"1.5\",\"-9.223372036854775808\"],"
+                       "\"cv:i8\":[-128,0,127],\"cv:i64\":[\"-9223372036854775808\",\"9223372036854775807\"],"
+                       "\"cv:u64\":[\"0\",\"18446744073709551615\"],\"cv:b\":[true,false],"
+                       "\"cv:bt\":[\"\",\"two\",\"one three\"]}";
+    int ret;
+
+    assert_non_null(lys_parse_mem(st->ctx, yang, LYS_IN_YANG));
+    st->dt1 = lyd_parse_mem(st->ctx, json, LYD_JSON, LYD_OPT_CONFIG);
+    assert_ptr_not_equal(st->dt1, NULL);
+
+    ret = lyd_print_mem(&st->mem, st->dt1, LYD_LYB, LYP_WITHSIBLINGS);
+    assert_int_equal(ret, 0);
+
+    st->dt2 = lyd_parse_mem(st->ctx, st->mem, LYD_LYB, LYD_OPT_CONFIG | LYD_OPT_STRICT);
+    assert_ptr_not_equal(st->dt2, NULL);
+
+    check_data_tree(st->dt1, st->dt2);
+}
+
+static void
+test_lazy_reader(void **state)
+{
+    struct state *st = (*state);
+    const char *yang = "module lz {namespace urn:lz; prefix lz;"
+                       "container a {leaf x {type string;}} container b {leaf y {type string;}} leaf-list l {type uint8;}}";
+    const char *json = "{\"lz:a\":{\"x\":\"1\"},\"lz:b\":{\"y\":\"2\"},\"lz:l\":[1,2,3]}";
+    struct lyd_lyb_reader *reader;
+    struct lyd_node *node;
+    char file_name[20] = "/tmp/libyang-XXXXXX";
+    int fd, ret;
+
+    assert_non_null(lys_parse_mem(st->ctx, yang, LYS_IN_YANG));
+    st->dt1 = lyd_parse_mem(st->ctx, json, LYD_JSON, LYD_OPT_CONFIG);
+    assert_ptr_not_equal(st->dt1, NULL);
+    ret = lyd_print_mem(&st->mem, st->dt1, LYD_LYB, LYP_WITHSIBLINGS);
+    assert_int_equal(ret, 0);
+
+    reader = lyd_lyb_reader_mem(st->ctx, st->mem, LYD_OPT_CONFIG | LYD_OPT_STRICT);
+    assert_non_null(reader);
+    assert_int_equal(lyd_lyb_reader_count(reader), 5);
+    assert_string_equal(lyd_lyb_reader_schema(reader, 0)->name, "a");
+    assert_string_equal(lyd_lyb_reader_schema(reader, 1)->name, "b");
+    assert_string_equal(lyd_lyb_reader_schema(reader, 4)->name, "l");
+    assert_null(lyd_lyb_reader_schema(reader, 5));
+
+    /* only the requested subtree is parsed */
+    st->dt2 = lyd_lyb_reader_parse(reader, 1);
+    assert_non_null(st->dt2);
+    assert_null(st->dt2->next);
+    assert_string_equal(st->dt2->schema->name, "b");
+    assert_string_equal(((struct lyd_node_leaf_list *)st->dt2->child)->value_str, "2");
+    lyd_free(st->dt2);
+
+    node = lyd_lyb_reader_parse(reader, 3);
+    assert_non_null(node);
+    assert_string_equal(((struct lyd_node_leaf_list *)node)->value_str, "2");
+    lyd_free(node);
+    lyd_lyb_reader_free(reader);
+
+    /* memory-mapped file */
+    fd = mkstemp(file_name);
+    assert_true(fd > 0);
+    close(fd);
+    ret = lyd_print_path(file_name, st->dt1, LYD_LYB, LYP_WITHSIBLINGS);
+    assert_int_equal(ret, 0);
+    reader = lyd_lyb_reader_path(st->ctx, file_name, LYD_OPT_CONFIG);
+    unlink(file_name);
+    assert_non_null(reader);
+    assert_int_equal(lyd_lyb_reader_count(reader), 5);
+    st->dt2 = lyd_lyb_reader_parse(reader, 0);
+    lyd_lyb_reader_free(reader);
+    assert_non_null(st->dt2);
+    assert_string_equal(((struct lyd_node_leaf_list *)st->dt2->child)->value_str, "1");
+
+    /* only data trees */
+    assert_null(lyd_lyb_reader_mem(st->ctx, st->mem, LYD_OPT_RPC));
+}
+
+static void
+test_parallel(void **state)
+{
+    struct state *st = (*state);
+    const char *yang = "module par {namespace urn:par; prefix par;"
+                       "list e {key k; leaf k {type uint32;} leaf v {type string;}}"
+                       "leaf-list l {type string;} container c {leaf r {type leafref {path /e/k;}}"
+                       "leaf i {type instance-identifier;}} anydata a;}";
+    struct lyd_node *node, *iter;
+    struct ly_set *set;
+    char *json;
+    size_t len;
+    uint32_t i;
+    int ret;
+
+    assert_non_null(lys_parse_mem(st->ctx, yang, LYS_IN_YANG));
+
+    json = malloc(500 * 48 + 256);
+    assert_non_null(json);
+    strcpy(json, "{\"par:e\":[");
+    len = strlen(json);
+    for (i = 0; i < 500; ++i) {
+        len += sprintf(json + len, "%s{\"k\":%" PRIu32 ",\"v\":\"value %" PRIu32 "\"}", i ? "," : "", i, i);
+    }
+    strcpy(json + len, "],\"par:l\":[\"x\",\"y\",\"z\"],\"par:c\":{\"r\":42,\"i\":\"/par:e[par:k='7']/par:v\"},"
+           "\"par:a\":{\"par:l\":[\"w\"]}}");
+    st->dt1 = lyd_parse_mem(st->ctx, json, LYD_JSON, LYD_OPT_CONFIG);
+    free(json);
+    assert_ptr_not_equal(st->dt1, NULL);
+
+    ret = lyd_print_mem(&st->mem, st->dt1, LYD_LYB, LYP_WITHSIBLINGS);
+    assert_int_equal(ret, 0);
+
+    st->dt2 = lyd_parse_mem(st->ctx, st->mem, LYD_LYB, LYD_OPT_CONFIG | LYD_OPT_STRICT | LYD_OPT_PARALLEL);
+    assert_ptr_not_equal(st->dt2, NULL);
+    check_data_tree(st->dt1, st->dt2);
+
+    /* the original order and a consistent sibling list */
+    for (iter = st->dt2, i = 0; i < 500; iter = iter->next, ++i) {
+        assert_string_equal(iter->schema->name, "e");
+        assert_int_equal(((struct lyd_node_leaf_list *)iter->child)->value.uint32, i);
+        assert_ptr_equal(iter->next->prev, iter);
+    }
+    for (; iter->next; iter = iter->next) {
+        assert_ptr_equal(iter->next->prev, iter);
+    }
+    assert_ptr_equal(st->dt2->prev, iter);
+    assert_string_equal(iter->schema->name, "a");
+
+    /* the instance-identifier was resolved in the linked tree */
+    set = lyd_find_path(st->dt2, "/par:c/i");
+    assert_int_equal(set->number, 1);
+    node = ((struct lyd_node_leaf_list *)set->set.d[0])->value.instance;
+    ly_set_free(set);
+    set = lyd_find_path(st->dt2, "/par:e[k='7']/v");
+    assert_int_equal(set->number, 1);
+    assert_ptr_equal(node, set->set.d[0]);
+    ly_set_free(set);
+}
+
+static ssize_t
+count_clb(void *arg, const void *buf, size_t count)
+{
+    (void)buf;
+    *(size_t *)arg += count;
+    return count;
+}
+
+static void
+test_checksum(void **state)
+{
+    struct state *st = (*state);
+    const char *yang = "module sum {namespace urn:sum; prefix sum;"
+                       "container c {must \"x < 10\"; leaf x {type uint8;} leaf s {type string;}}}";
+    const char *yang2 = "module other {namespace urn:other; prefix o; leaf o {type string;}}";
+    char *corrupt;
+    size_t len = 0;
+    int ret;
+
+    assert_non_null(lys_parse_mem(st->ctx, yang, LYS_IN_YANG));
+    st->dt1 = lyd_new_path(NULL, st->ctx, "/sum:c/x", "20", 0, 0);
+    assert_non_null(st->dt1);
+    assert_non_null(lyd_new_path(st->dt1, NULL, "/sum:c/s", "some value", 0, 0));
+
+    ret = lyd_print_mem(&st->mem, st->dt1, LYD_LYB, LYP_WITHSIBLINGS | LYP_LYB_CHECKSUM);
+    assert_int_equal(ret, 0);
+    ret = lyd_print_clb(count_clb, &len, st->dt1, LYD_LYB, LYP_WITHSIBLINGS | LYP_LYB_CHECKSUM);
+    assert_int_equal(ret, 0);
+    assert_int_equal(lyd_lyb_data_length(st->mem), len);
+
+    /* trusted as before */
+    st->dt2 = lyd_parse_mem(st->ctx, st->mem, LYD_LYB, LYD_OPT_CONFIG | LYD_OPT_STRICT);
+    assert_ptr_not_equal(st->dt2, NULL);
+    assert_string_equal(((struct lyd_node_leaf_list *)st->dt2->child)->value_str, "20");
+    lyd_free_withsiblings(st->dt2);
+
+    /* not marked as validated, so the must fails */
+    assert_null(lyd_parse_mem(st->ctx, st->mem, LYD_LYB, LYD_OPT_CONFIG | LYD_OPT_LYB_VALIDATE));
+
+    /* any corrupted byte is detected */
+    corrupt = malloc(len);
+    assert_non_null(corrupt);
+    memcpy(corrupt, st->mem, len);
+    corrupt[len - 3] ^= 0x01;
+    st->dt2 = lyd_parse_mem(st->ctx, corrupt, LYD_LYB, LYD_OPT_CONFIG);
+    free(corrupt);
+    assert_null(st->dt2);
+    free(st->mem);
+
+    /* the marker skips the validation in the same schema set only */
+    ret = lyd_print_mem(&st->mem, st->dt1, LYD_LYB, LYP_WITHSIBLINGS | LYP_LYB_VALIDATED);
+    assert_int_equal(ret, 0);
+    st->dt2 = lyd_parse_mem(st->ctx, st->mem, LYD_LYB, LYD_OPT_CONFIG | LYD_OPT_LYB_VALIDATE);
+    assert_ptr_not_equal(st->dt2, NULL);
+    assert_string_equal(((struct lyd_node_leaf_list *)st->dt2->child)->value_str, "20");
+    lyd_free_withsiblings(st->dt2);
+    st->dt2 = NULL;
+
+    assert_non_null(lys_parse_mem(st->ctx, yang2, LYS_IN_YANG));
+    assert_null(lyd_parse_mem(st->ctx, st->mem, LYD_LYB, LYD_OPT_CONFIG | LYD_OPT_LYB_VALIDATE));
+
+    /* valid data pass the validation */
+    assert_int_equal(lyd_change_leaf((struct lyd_node_leaf_list *)st->dt1->child, "5"), 0);
+    assert_int_equal(lyd_validate(&st->dt1, LYD_OPT_CONFIG, NULL), 0);
+    free(st->mem);
+    ret = lyd_print_mem(&st->mem, st->dt1, LYD_LYB, LYP_WITHSIBLINGS | LYP_LYB_CHECKSUM);
+    assert_int_equal(ret, 0);
+    st->dt2 = lyd_parse_mem(st->ctx, st->mem, LYD_LYB, LYD_OPT_CONFIG | LYD_OPT_LYB_VALIDATE);
+    assert_ptr_not_equal(st->dt2, NULL);
+    check_data_tree(st->dt1, st->dt2);
+}
+
+#ifdef LY_ENABLED_LYB_COMPRESSION
+
+static void
+test_compressed(void **state)
+{
+    struct state *st = (*state);
+    const char *yang = "module cmp {namespace urn:cmp; prefix cmp;"
+                       "list e {key k; leaf k {type uint32;} leaf v {type string;} leaf b {type binary;}}}";
+    struct lyd_lyb_reader *reader;
+    struct lyd_node *node;
+    char *json, *plain, *compressed;
+    size_t len, plain_len = 0, comp_len = 0;
+    uint32_t i;
+    int ret;
+
+    assert_non_null(lys_parse_mem(st->ctx, yang, LYS_IN_YANG));
+
+    /* more than one compressed block */
+    json = malloc(2001 * 96);
+    assert_non_null(json);
+    strcpy(json, "{\"cmp:e\":[");
+    len = strlen(json);
+    for (i = 0; i < 2000; ++i) {
+        len += sprintf(json + len, "{\"k\":%" PRIu32 ",\"v\":\"a rather long string value repeated in every entry\"},", i);
+    }
+    strcpy(json + len, "{\"k\":2000,\"b\":\"YmluYXJ5IGJpbmFyeSBiaW5hcnkgYmluYXJ5\"}]}");
+    st->dt1 = lyd_parse_mem(st->ctx, json, LYD_JSON, LYD_OPT_CONFIG);
+    free(json);
+    assert_ptr_not_equal(st->dt1, NULL);
+
+    ret = lyd_print_mem(&plain, st->dt1, LYD_LYB, LYP_WITHSIBLINGS);
+    assert_int_equal(ret, 0);
+    ret = lyd_print_mem(&compressed, st->dt1, LYD_LYB, LYP_WITHSIBLINGS | LYP_LYB_COMPRESS);
+    assert_int_equal(ret, 0);
+    ret = lyd_print_clb(count_clb, &plain_len, st->dt1, LYD_LYB, LYP_WITHSIBLINGS);
+    assert_int_equal(ret, 0);
+    ret = lyd_print_clb(count_clb, &comp_len, st->dt1, LYD_LYB, LYP_WITHSIBLINGS | LYP_LYB_COMPRESS);
+    assert_int_equal(ret, 0);
+    assert_true(plain_len > LYB_BLOCK_SIZE);
+    assert_true(comp_len * 4 < plain_len);
+    assert_int_equal(lyd_lyb_data_length(plain), plain_len);
+    assert_int_equal(lyd_lyb_data_length(compressed), comp_len);
+    free(plain);
+
+    /* the compression is detected from the header */
+    st->mem = compressed;
+    st->dt2 = lyd_parse_mem(st->ctx, st->mem, LYD_LYB, LYD_OPT_CONFIG | LYD_OPT_STRICT);
+    assert_ptr_not_equal(st->dt2, NULL);
+    check_data_tree(st->dt1, st->dt2);
+
+    reader = lyd_lyb_reader_mem(st->ctx, st->mem, LYD_OPT_CONFIG);
+    assert_non_null(reader);
+    assert_int_equal(lyd_lyb_reader_count(reader), 2001);
+    node = lyd_lyb_reader_parse(reader, 2000);
+    lyd_lyb_reader_free(reader);
+    assert_non_null(node);
+    assert_string_equal(((struct lyd_node_leaf_list *)node->child)->value_str, "2000");
+    lyd_free(node);
+
+    /* a damaged block is refused */
+    compressed[4 + 2 * LYB_BLOCK_LEN_BYTES] ^= 0xff;
+    assert_null(lyd_parse_mem(st->ctx, st->mem, LYD_LYB, LYD_OPT_CONFIG));
+    free(st->mem);
+
+    /* the checksum covers the compressed blocks */
+    ret = lyd_print_mem(&st->mem, st->dt1, LYD_LYB, LYP_WITHSIBLINGS | LYP_LYB_COMPRESS | LYP_LYB_CHECKSUM);
+    assert_int_equal(ret, 0);
+    assert_int_equal(lyd_lyb_data_length(st->mem), comp_len + LYB_CHECKSUM_BLOCK_BYTES);
+    lyd_free_withsiblings(st->dt2);
+    st->dt2 = lyd_parse_mem(st->ctx, st->mem, LYD_LYB, LYD_OPT_CONFIG | LYD_OPT_STRICT);
+    assert_ptr_not_equal(st->dt2, NULL);
+    check_data_tree(st->dt1, st->dt2);
+}
+
+#endif
+
 int
 main(void)
 {
@@ -669,6 +1133,7 @@ main(void)
         cmocka_unit_test_setup_teardown(test_annotations, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_similar_annot_names, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_many_child_annot, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_annotation_index, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_union, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_union2, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_collisions, setup_f, teardown_f),
@@ -676,6 +1141,15 @@ main(void)
         cmocka_unit_test_setup_teardown(test_submodule_feature, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_coliding_augments, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_leafrefs, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_versions, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_hash_index, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_canonical_values, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_lazy_reader, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_parallel, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_checksum, setup_f, teardown_f),
+#ifdef LY_ENABLED_LYB_COMPRESSION
+        cmocka_unit_test_setup_teardown(test_compressed, setup_f, teardown_f),
+#endif
     };
 
     return cmocka_run_group_tests(tests, NULL, NULL);
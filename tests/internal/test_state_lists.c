@@ -20,6 +20,7 @@
 #include <assert.h>
 
 #include "libyang.h"
+#include "common.h"
 #include "tree_internal.h"
 #include "tests/config.h"
 #include "hash_table.h"
@@ -56,7 +57,7 @@ lyd_hash_check(struct lyd_node *node)
             }
         }
 
-        if (i >= LY_CACHE_HT_MIN_CHILDREN) {
+        if ((i >= LY_CACHE_HT_MIN_CHILDREN) || ((i >= LY_CACHE_HT_FREE_CHILDREN) && node->ht)) {
             assert(node->ht && (node->ht->used == i));
             LY_TREE_FOR(node->child, iter) {
                 if ((iter->schema->nodetype != LYS_LIST) || lyd_list_has_keys(iter)) {
@@ -108,6 +109,39 @@ test_hash(void **state)
     lyd_hash_check(st->root1);
 }
 
+static void
+test_hash_threshold(void **state)
+{
+    struct lyd_node *root;
+    struct state *st = (*state);
+    char buf[16];
+    int i;
+
+    root = lyd_new_path(NULL, st->ctx, "/state-lists:cont", NULL, 0, 0);
+    assert_non_null(root);
+
+    /* the hash table is created only with enough children */
+    for (i = 0; i < LY_CACHE_HT_MIN_CHILDREN; ++i) {
+        assert_null(root->ht);
+        sprintf(buf, "%d", i);
+        assert_non_null(lyd_new_leaf(root, NULL, "ll", buf));
+    }
+    assert_non_null(root->ht);
+    assert_int_equal(root->ht->used, LY_CACHE_HT_MIN_CHILDREN);
+    lyd_hash_check(root);
+
+    /* and kept until only a few of them remain */
+    for (i = LY_CACHE_HT_MIN_CHILDREN; i > LY_CACHE_HT_FREE_CHILDREN; --i) {
+        lyd_free(root->child);
+        assert_non_null(root->ht);
+    }
+    lyd_free(root->child);
+    assert_null(root->ht);
+    lyd_hash_check(root);
+
+    lyd_free(root);
+}
+
 #endif
 
 static int
@@ -475,6 +509,7 @@ int main(void)
     const struct CMUnitTest tests[] = {
 #ifdef LY_ENABLED_CACHE
                     cmocka_unit_test_setup_teardown(test_hash, setup_f, teardown_f),
+                    cmocka_unit_test_setup_teardown(test_hash_threshold, setup_f, teardown_f),
 #endif
                     cmocka_unit_test_setup_teardown(test_merge_same, setup_f, teardown_f),
                     cmocka_unit_test_setup_teardown(test_merge_equal_leaflist, setup_f, teardown_f),
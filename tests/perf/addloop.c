@@ -19,7 +19,7 @@
 #include <fcntl.h>
 #include <unistd.h>
 
-#include <libyang/libyang.h>
+#include "libyang.h"
 
 int main(int argc, char *argv[])
 {
@@ -0,0 +1,1111 @@
+/**
+ * @file datagen.c
+ * @brief Generator of synthetic instance data of the loaded schemas for the benchmarks.
+ *
+ * Copyright (c) 2019 CESNET, z.s.p.o.
+ *
+ * This source code is licensed under BSD 3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://opensource.org/licenses/BSD-3-Clause
+ */
+
+#define _GNU_SOURCE
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "datagen.h"
+
+#define DG_BUF_SIZE 256      /* maximal length of a generated value */
+#define DG_ATTEMPTS 8        /* values tried for a single node before giving up on it */
+#define DG_CHAIN_MAX 32      /* maximal depth of a leafref target below the common ancestor */
+#define DG_REPAIRS 1000      /* nodes removed at most to make the data valid */
+
+#define DG_MISSING 1         /* a mandatory node could not be generated, returned by the node generators */
+
+#define DG_DATA_NODES (LYS_CONTAINER | LYS_LEAF | LYS_LEAFLIST | LYS_LIST | LYS_ANYDATA)
+
+/* a leafref (leaf or leaf-list) to be created once all the other nodes exist */
+struct dg_pending {
+    struct lyd_node *parent;
+    const struct lys_node *snode;
+    uint32_t count;
+};
+
+/* instances of a leafref target referenced by an absolute path */
+struct dg_instances {
+    const struct lys_node *target;
+    struct ly_set *set;
+};
+
+struct datagen {
+    const struct datagen_opts *opts;
+    uint64_t rnd;
+    struct lyd_node *root;
+
+    struct dg_pending *pending;
+    uint32_t pending_count;
+    uint32_t pending_size;
+
+    struct dg_instances *inst;
+    uint32_t inst_count;
+};
+
+static int dg_children(struct datagen *dg, struct lyd_node *parent, const struct lys_node *sparent,
+                       const struct lys_module *module, uint32_t depth, int in_list);
+
+void
+datagen_opts_default(struct datagen_opts *opts)
+{
+    memset(opts, 0, sizeof *opts);
+    opts->top_list_size = 1000;
+    opts->list_size = 4;
+    opts->leaflist_size = 3;
+    opts->optional_pct = 80;
+    opts->default_pct = 50;
+    opts->seed = 1;
+}
+
+/*
+ * helpers
+ */
+
+/* xorshift64*, so the data are the same on all platforms */
+static uint32_t
+dg_rand(struct datagen *dg)
+{
+    dg->rnd ^= dg->rnd >> 12;
+    dg->rnd ^= dg->rnd << 25;
+    dg->rnd ^= dg->rnd >> 27;
+    return (dg->rnd * 0x2545F4914F6CDD1DULL) >> 32;
+}
+
+static int
+dg_chance(struct datagen *dg, uint8_t pct)
+{
+    return (dg_rand(dg) % 100) < pct;
+}
+
+static struct lys_type *
+dg_type_der(struct lys_type *type)
+{
+    return type->der ? &type->der->type : NULL;
+}
+
+static const struct lys_node *
+dg_data_parent(const struct lys_node *snode)
+{
+    do {
+        snode = lys_parent(snode);
+    } while (snode && !(snode->nodetype & DG_DATA_NODES));
+
+    return snode;
+}
+
+static struct lyd_node *
+dg_link(struct datagen *dg, struct lyd_node *parent, struct lyd_node *node)
+{
+    if (!node || parent) {
+        return node;
+    }
+
+    /* top-level node */
+    if (!dg->root) {
+        dg->root = node;
+    } else if (lyd_insert_sibling(&dg->root, node)) {
+        lyd_free(node);
+        return NULL;
+    }
+    return node;
+}
+
+/* the first interval of a range or length restriction */
+static void
+dg_interval(const char *expr, long double min, long double max, long double *lo, long double *hi)
+{
+    char *end;
+
+    *lo = min;
+    *hi = max;
+    if (!expr) {
+        return;
+    }
+
+    while (*expr == ' ') {
+        ++expr;
+    }
+    if (!strncmp(expr, "min", 3)) {
+        expr += 3;
+    } else if (!strncmp(expr, "max", 3)) {
+        *lo = max;
+        expr += 3;
+    } else {
+        *lo = strtold(expr, &end);
+        expr = end;
+    }
+
+    while (*expr == ' ') {
+        ++expr;
+    }
+    if (strncmp(expr, "..", 2)) {
+        /* single value */
+        *hi = *lo;
+        return;
+    }
+    expr += 2;
+    while (*expr == ' ') {
+        ++expr;
+    }
+    if (strncmp(expr, "max", 3)) {
+        *hi = strtold(expr, NULL);
+    }
+}
+
+/*
+ * values
+ */
+
+static int
+dg_number(struct datagen *dg, struct lys_type *type, uint32_t idx, int use_idx, char *buf)
+{
+    struct lys_type *t;
+    struct lys_restr *range = NULL;
+    long double min, max, lo, hi, val, div = 1;
+    uint64_t r;
+    int dig = 0, i;
+
+    switch (type->base) {
+    case LY_TYPE_INT8:
+        min = INT8_MIN;
+        max = INT8_MAX;
+        break;
+    case LY_TYPE_UINT8:
+        min = 0;
+        max = UINT8_MAX;
+        break;
+    case LY_TYPE_INT16:
+        min = INT16_MIN;
+        max = INT16_MAX;
+        break;
+    case LY_TYPE_UINT16:
+        min = 0;
+        max = UINT16_MAX;
+        break;
+    case LY_TYPE_INT32:
+        min = INT32_MIN;
+        max = INT32_MAX;
+        break;
+    case LY_TYPE_UINT32:
+        min = 0;
+        max = UINT32_MAX;
+        break;
+    case LY_TYPE_INT64:
+        min = INT64_MIN;
+        max = INT64_MAX;
+        break;
+    case LY_TYPE_UINT64:
+        min = 0;
+        max = UINT64_MAX;
+        break;
+    case LY_TYPE_DEC64:
+        dig = type->info.dec64.dig;
+        for (i = 0; i < dig; ++i) {
+            div *= 10;
+        }
+        min = INT64_MIN / div;
+        max = INT64_MAX / div;
+        break;
+    default:
+        return 1;
+    }
+
+    /* the most derived range is the effective one */
+    for (t = type; t && !range; t = dg_type_der(t)) {
+        range = (t->base == LY_TYPE_DEC64) ? t->info.dec64.range : t->info.num.range;
+    }
+    dg_interval(range ? range->expr : NULL, min, max, &lo, &hi);
+    if (!range && (lo < 0)) {
+        /* prefer small values, as in the real data */
+        lo = 0;
+        hi = (max < 100000) ? max : 100000;
+    }
+
+    r = use_idx ? idx : dg_rand(dg);
+    if (hi - lo < (long double)UINT32_MAX) {
+        r %= (uint64_t)(hi - lo) + 1;
+    }
+    val = lo + r;
+    if (dig) {
+        val += (dg_rand(dg) % 100) / 100.0L;
+    }
+    if (val > hi) {
+        val = hi;
+    }
+    sprintf(buf, "%.*Lf", dig, val);
+    return 0;
+}
+
+static void
+dg_string_fit(char *buf, long double lo, long double hi)
+{
+    size_t len = strlen(buf);
+
+    while ((len < lo) && (len < DG_BUF_SIZE - 1)) {
+        buf[len++] = 'x';
+    }
+    if (len > hi) {
+        len = hi;
+    }
+    buf[len] = '\0';
+}
+
+/* values of the common typedefs with a pattern */
+static int
+dg_string_known(const char *name, uint32_t v, char *buf)
+{
+    if (!strcmp(name, "ipv4-address") || !strcmp(name, "ipv4-address-no-zone") || !strcmp(name, "dotted-quad")) {
+        sprintf(buf, "10.%u.%u.%u", (v >> 16) & 0xff, (v >> 8) & 0xff, (v & 0xff) ? v & 0xff : 1);
+    } else if (!strcmp(name, "ipv6-address") || !strcmp(name, "ipv6-address-no-zone")) {
+        sprintf(buf, "2001:db8::%x:%x", v >> 16, (v & 0xffff) ? v & 0xffff : 1);
+    } else if (!strcmp(name, "ipv4-prefix")) {
+        sprintf(buf, "10.%u.%u.0/24", (v >> 8) & 0xff, v & 0xff);
+    } else if (!strcmp(name, "ipv6-prefix")) {
+        sprintf(buf, "2001:db8:%x:%x::/64", v >> 16, v & 0xffff);
+    } else if (!strcmp(name, "mac-address") || !strcmp(name, "phys-address")) {
+        sprintf(buf, "02:00:%02x:%02x:%02x:%02x", v >> 24, (v >> 16) & 0xff, (v >> 8) & 0xff, v & 0xff);
+    } else if (!strcmp(name, "hex-string")) {
+        sprintf(buf, "%02x:%02x:%02x:%02x", v >> 24, (v >> 16) & 0xff, (v >> 8) & 0xff, v & 0xff);
+    } else if (!strcmp(name, "date-and-time")) {
+        sprintf(buf, "2019-%02u-%02uT%02u:%02u:%02uZ", v % 12 + 1, v % 28 + 1, v % 24, v % 60, (v / 60) % 60);
+    } else if (!strcmp(name, "domain-name")) {
+        sprintf(buf, "host%u.example.com", v);
+    } else if (!strcmp(name, "uri")) {
+        sprintf(buf, "https://example.com/%u", v);
+    } else if (!strcmp(name, "uuid")) {
+        sprintf(buf, "00000000-0000-4000-8000-%012x", v);
+    } else if (!strcmp(name, "object-identifier") || !strcmp(name, "object-identifier-128")) {
+        sprintf(buf, "1.3.6.1.%u", v);
+    } else if (!strcmp(name, "yang-identifier")) {
+        sprintf(buf, "id%u", v);
+    } else {
+        return 1;
+    }
+    return 0;
+}
+
+static int
+dg_string(struct datagen *dg, struct lys_type *type, uint32_t idx, int use_idx, int attempt, char *buf)
+{
+    struct lys_type *t;
+    struct lys_restr *length = NULL;
+    long double lo, hi;
+    uint32_t v;
+    int pattern = 0;
+
+    v = use_idx ? idx : dg_rand(dg) % 1000000;
+
+    for (t = type; t; t = dg_type_der(t)) {
+        if (t->der && !dg_string_known(t->der->name, v, buf)) {
+            return 0;
+        }
+        if (!length) {
+            length = t->info.str.length;
+        }
+        if (t->info.str.pat_count) {
+            pattern = 1;
+        }
+    }
+
+    if (pattern) {
+        /* unknown pattern, some values likely to match it */
+        switch (attempt % 4) {
+        case 0:
+            sprintf(buf, "name%u", v);
+            break;
+        case 1:
+            sprintf(buf, "%u", v);
+            break;
+        case 2:
+            sprintf(buf, "name-%u", v);
+            break;
+        default:
+            sprintf(buf, "N%u", v);
+            break;
+        }
+    } else {
+        sprintf(buf, "%s-%u", type->parent ? type->parent->name : "value", v);
+    }
+
+    dg_interval(length ? length->expr : NULL, 0, DG_BUF_SIZE - 1, &lo, &hi);
+    dg_string_fit(buf, lo, hi);
+    return 0;
+}
+
+static int
+dg_binary(struct datagen *dg, struct lys_type *type, char *buf)
+{
+    static const char b64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    struct lys_type *t;
+    struct lys_restr *length = NULL;
+    long double lo, hi;
+    uint32_t len, i, chunk;
+    char *p = buf;
+
+    for (t = type; t && !length; t = dg_type_der(t)) {
+        length = t->info.binary.length;
+    }
+    dg_interval(length ? length->expr : NULL, 0, 16, &lo, &hi);
+    len = (lo > 4) ? lo : (hi < 4 ? hi : 4);
+    if (len > 3 * (DG_BUF_SIZE / 4) - 3) {
+        return 1;
+    }
+
+    for (i = 0; i < len; i += 3) {
+        chunk = dg_rand(dg) & 0xffffff;
+        *p++ = b64[(chunk >> 18) & 0x3f];
+        *p++ = b64[(chunk >> 12) & 0x3f];
+        *p++ = (i + 1 < len) ? b64[(chunk >> 6) & 0x3f] : '=';
+        *p++ = (i + 2 < len) ? b64[chunk & 0x3f] : '=';
+    }
+    *p = '\0';
+    return 0;
+}
+
+/* returns non-zero if no value of the type can be generated (by this generator) */
+static int
+dg_value(struct datagen *dg, struct lys_type *type, uint32_t idx, int use_idx, int attempt, char *buf)
+{
+    struct lys_type *t;
+    struct lys_ident *ident;
+    unsigned int i, count;
+    uint32_t r;
+    size_t len;
+
+    r = (use_idx ? idx : dg_rand(dg)) + attempt;
+
+    switch (type->base) {
+    case LY_TYPE_BINARY:
+        return dg_binary(dg, type, buf);
+    case LY_TYPE_BITS:
+        for (t = type; t && !t->info.bits.count; t = dg_type_der(t));
+        if (!t) {
+            return 1;
+        }
+        len = 0;
+        buf[0] = '\0';
+        for (i = 0; i < t->info.bits.count; ++i) {
+            if ((dg_rand(dg) % 2) && (len + strlen(t->info.bits.bit[i].name) + 2 < DG_BUF_SIZE)) {
+                len += sprintf(buf + len, "%s%s", len ? " " : "", t->info.bits.bit[i].name);
+            }
+        }
+        return 0;
+    case LY_TYPE_BOOL:
+        strcpy(buf, (r % 2) ? "true" : "false");
+        return 0;
+    case LY_TYPE_EMPTY:
+        buf[0] = '\0';
+        return 0;
+    case LY_TYPE_ENUM:
+        for (t = type; t && !t->info.enums.count; t = dg_type_der(t));
+        if (!t) {
+            return 1;
+        }
+        strcpy(buf, t->info.enums.enm[r % t->info.enums.count].name);
+        return 0;
+    case LY_TYPE_IDENT:
+        for (t = type; t && !t->info.ident.count; t = dg_type_der(t));
+        if (!t || !t->info.ident.ref[0]->der || !t->info.ident.ref[0]->der->number) {
+            return 1;
+        }
+        count = t->info.ident.ref[0]->der->number;
+        ident = t->info.ident.ref[0]->der->set.g[r % count];
+        if (strlen(ident->name) + strlen(lys_main_module(ident->module)->name) + 2 > DG_BUF_SIZE) {
+            return 1;
+        }
+        sprintf(buf, "%s:%s", lys_main_module(ident->module)->name, ident->name);
+        return 0;
+    case LY_TYPE_STRING:
+        return dg_string(dg, type, idx, use_idx, attempt, buf);
+    case LY_TYPE_UNION:
+        for (t = type; t && !t->info.uni.count; t = dg_type_der(t));
+        if (!t) {
+            return 1;
+        }
+        /* the first member able to generate a value, starting at a different one every attempt */
+        for (i = 0; i < t->info.uni.count; ++i) {
+            if (!dg_value(dg, &t->info.uni.types[(r + i) % t->info.uni.count], idx, use_idx, attempt, buf)) {
+                return 0;
+            }
+        }
+        return 1;
+    case LY_TYPE_INST:
+    case LY_TYPE_LEAFREF:
+        /* leafrefs are generated separately, instance-identifiers are not */
+        return 1;
+    default:
+        return dg_number(dg, type, idx, use_idx, buf);
+    }
+}
+
+static struct lyd_node *
+dg_new_leaf(struct datagen *dg, struct lyd_node *parent, const struct lys_node *snode, struct lys_type *type,
+            uint32_t idx, int use_idx)
+{
+    struct lyd_node *node;
+    char buf[DG_BUF_SIZE];
+    int attempt;
+
+    for (attempt = 0; attempt < DG_ATTEMPTS; ++attempt) {
+        if (dg_value(dg, type, idx, use_idx, attempt, buf)) {
+            break;
+        }
+        node = lyd_new_leaf(parent, lys_node_module(snode), snode->name, buf);
+        if (node) {
+            return dg_link(dg, parent, node);
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * leafrefs
+ */
+
+static struct lys_type *
+dg_lref_type(const struct lys_node *snode)
+{
+    struct lys_type *t;
+
+    for (t = &((struct lys_node_leaf *)snode)->type; t && !t->info.lref.target; t = dg_type_der(t));
+    return t;
+}
+
+/* instances of the target anywhere in the data */
+static struct ly_set *
+dg_lref_global(struct datagen *dg, const struct lys_node *target)
+{
+    struct dg_instances *inst;
+    uint32_t i;
+
+    for (i = 0; i < dg->inst_count; ++i) {
+        if (dg->inst[i].target == target) {
+            return dg->inst[i].set;
+        }
+    }
+
+    inst = realloc(dg->inst, (dg->inst_count + 1) * sizeof *dg->inst);
+    if (!inst) {
+        return NULL;
+    }
+    dg->inst = inst;
+    inst = &dg->inst[dg->inst_count];
+    inst->target = target;
+    inst->set = dg->root ? lyd_find_instance(dg->root, target) : ly_set_new();
+    if (!inst->set) {
+        return NULL;
+    }
+    ++dg->inst_count;
+    return inst->set;
+}
+
+static void
+dg_lref_global_clean(struct datagen *dg)
+{
+    uint32_t i;
+
+    for (i = 0; i < dg->inst_count; ++i) {
+        ly_set_free(dg->inst[i].set);
+    }
+    free(dg->inst);
+    dg->inst = NULL;
+    dg->inst_count = 0;
+}
+
+static void
+dg_free(struct datagen *dg, struct lyd_node *node)
+{
+    /* the cached instances may be freed */
+    dg_lref_global_clean(dg);
+
+    if (node == dg->root) {
+        dg->root = node->next;
+    }
+    lyd_free(node);
+}
+
+static void
+dg_lref_collect(struct lyd_node *first, const struct lys_node **chain, int depth, struct ly_set *set)
+{
+    struct lyd_node *iter;
+
+    LY_TREE_FOR(first, iter) {
+        if (iter->schema != chain[depth]) {
+            continue;
+        }
+        if (!depth) {
+            ly_set_add(set, iter, LY_SET_OPT_USEASLIST);
+        } else {
+            dg_lref_collect(iter->child, chain, depth - 1, set);
+        }
+    }
+}
+
+/* the data nodes from the target up to (not including) the ancestor, returns their count or -1 if not an ancestor */
+static int
+dg_lref_chain(const struct lys_node *target, const struct lys_node *ancestor, const struct lys_node **chain)
+{
+    int depth = 0;
+
+    for (; target != ancestor; target = dg_data_parent(target)) {
+        if (!target || (depth == DG_CHAIN_MAX)) {
+            return -1;
+        }
+        chain[depth++] = target;
+    }
+
+    return depth;
+}
+
+/*
+ * Instances the leafref of a node in parent can refer to. The relative paths are expected to refer to the
+ * instances in the subtree of their common ancestor, the predicates are left to the validation.
+ */
+static struct ly_set *
+dg_lref_instances(struct datagen *dg, struct lyd_node *parent, const struct lys_node *snode, int *dynamic)
+{
+    struct lys_type *type, *t;
+    const struct lys_node *chain[DG_CHAIN_MAX];
+    const char *path;
+    struct ly_set *set;
+    int depth;
+
+    *dynamic = 0;
+    type = dg_lref_type(snode);
+    if (!type) {
+        return NULL;
+    }
+
+    /* the path of a leafref typedef is not copied into the leaves */
+    for (t = type; t && !t->info.lref.path; t = dg_type_der(t));
+    path = t ? t->info.lref.path : "";
+    if (parent && !strncmp(path, "../", 3)) {
+        /* the first step is to the parent */
+        for (path += 3; parent && !strncmp(path, "../", 3); path += 3) {
+            parent = parent->parent;
+        }
+        if (parent) {
+            depth = dg_lref_chain((struct lys_node *)type->info.lref.target, parent->schema, chain);
+            if (depth > 0) {
+                set = ly_set_new();
+                if (set) {
+                    dg_lref_collect(parent->child, chain, depth - 1, set);
+                    *dynamic = 1;
+                }
+                return set;
+            }
+        }
+    }
+
+    return dg_lref_global(dg, (struct lys_node *)type->info.lref.target);
+}
+
+static int
+dg_lref_create(struct datagen *dg, struct dg_pending *p)
+{
+    struct ly_set *set;
+    struct lyd_node *node;
+    uint32_t i, start;
+    int dynamic, ret = 1;
+
+    set = dg_lref_instances(dg, p->parent, p->snode, &dynamic);
+    if (!set || !set->number) {
+        goto cleanup;
+    }
+
+    start = dg_rand(dg);
+    for (i = 0; (i < p->count) && (i < set->number); ++i) {
+        node = lyd_new_leaf(p->parent, lys_node_module(p->snode), p->snode->name,
+                            ((struct lyd_node_leaf_list *)set->set.d[(start + i) % set->number])->value_str);
+        if (node) {
+            dg_link(dg, p->parent, node);
+            ret = 0;
+        }
+    }
+
+cleanup:
+    if (dynamic) {
+        ly_set_free(set);
+    }
+    return ret;
+}
+
+static int
+dg_lref_postpone(struct datagen *dg, struct lyd_node *parent, const struct lys_node *snode, uint32_t count)
+{
+    struct dg_pending *pending;
+
+    if (dg->pending_count == dg->pending_size) {
+        dg->pending_size = dg->pending_size ? dg->pending_size * 2 : 64;
+        pending = realloc(dg->pending, dg->pending_size * sizeof *dg->pending);
+        if (!pending) {
+            return -1;
+        }
+        dg->pending = pending;
+    }
+
+    pending = &dg->pending[dg->pending_count++];
+    pending->parent = parent;
+    pending->snode = snode;
+    pending->count = count;
+    return 0;
+}
+
+/* in rounds, so the leafrefs referring to other leafrefs are created too */
+static void
+dg_lref_resolve(struct datagen *dg)
+{
+    uint32_t i;
+    int progress;
+
+    do {
+        progress = 0;
+        dg_lref_global_clean(dg);
+        for (i = 0; i < dg->pending_count; ++i) {
+            if (dg->pending[i].snode && !dg_lref_create(dg, &dg->pending[i])) {
+                dg->pending[i].snode = NULL;
+                progress = 1;
+            }
+        }
+    } while (progress);
+
+    dg_lref_global_clean(dg);
+}
+
+/*
+ * A leafref key referring into its list instance (such as "../config/name") gets a unique value of the target
+ * type and the target is set to it once the instance is complete, other leafref keys get the existing values.
+ */
+static struct lyd_node *
+dg_lref_key(struct datagen *dg, struct lyd_node *list, const struct lys_node *key, uint32_t idx)
+{
+    struct lys_type *type;
+    const struct lys_node *chain[DG_CHAIN_MAX];
+    struct ly_set *set;
+    struct lyd_node *node;
+
+    type = dg_lref_type(key);
+    if (!type) {
+        return NULL;
+    }
+
+    if (dg_lref_chain((struct lys_node *)type->info.lref.target, list->schema, chain) > 0) {
+        return dg_new_leaf(dg, list, key, &type->info.lref.target->type, idx, 1);
+    }
+
+    set = dg_lref_global(dg, (struct lys_node *)type->info.lref.target);
+    if (!set || (idx >= set->number)) {
+        return NULL;
+    }
+    node = lyd_new_leaf(list, lys_node_module(key), key->name, ((struct lyd_node_leaf_list *)set->set.d[idx])->value_str);
+    return dg_link(dg, list, node);
+}
+
+static int
+dg_lref_key_sync(struct lyd_node *list, struct lyd_node_leaf_list *key)
+{
+    struct lys_type *type;
+    const struct lys_node *chain[DG_CHAIN_MAX];
+    struct lyd_node *parent, *iter;
+    int depth;
+
+    type = dg_lref_type(key->schema);
+    depth = dg_lref_chain((struct lys_node *)type->info.lref.target, list->schema, chain);
+    if (depth < 1) {
+        /* refers to an existing value */
+        return 0;
+    }
+
+    for (parent = list; depth; --depth) {
+        LY_TREE_FOR(parent->child, iter) {
+            if (iter->schema == chain[depth - 1]) {
+                break;
+            }
+        }
+
+        if (depth > 1) {
+            if (!iter) {
+                if (chain[depth - 1]->nodetype != LYS_CONTAINER) {
+                    return -1;
+                }
+                iter = lyd_new(parent, lys_node_module(chain[depth - 1]), chain[depth - 1]->name);
+                if (!iter) {
+                    return -1;
+                }
+            }
+            parent = iter;
+        } else if (iter) {
+            return (lyd_change_leaf((struct lyd_node_leaf_list *)iter, key->value_str) < 0) ? -1 : 0;
+        } else {
+            return lyd_new_leaf(parent, lys_node_module(chain[0]), chain[0]->name, key->value_str) ? 0 : -1;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * nodes
+ */
+
+static int
+dg_is_mandatory(const struct lys_node *snode)
+{
+    switch (snode->nodetype) {
+    case LYS_LEAF:
+    case LYS_CHOICE:
+    case LYS_ANYDATA:
+    case LYS_ANYXML:
+        return snode->flags & LYS_MAND_TRUE;
+    case LYS_LIST:
+        return ((struct lys_node_list *)snode)->min;
+    case LYS_LEAFLIST:
+        return ((struct lys_node_leaflist *)snode)->min;
+    default:
+        return 0;
+    }
+}
+
+static uint32_t
+dg_count(uint32_t count, uint32_t min, uint32_t max, int deep)
+{
+    if (deep || (count < min)) {
+        count = min;
+    }
+    if (max && (count > max)) {
+        count = max;
+    }
+    return count;
+}
+
+static int
+dg_list(struct datagen *dg, struct lyd_node *parent, const struct lys_node *snode, uint32_t depth, int in_list, int deep)
+{
+    struct lys_node_list *slist = (struct lys_node_list *)snode;
+    struct lyd_node *list, *key;
+    uint32_t i, count, created = 0, pending;
+    uint8_t k;
+    int r;
+
+    count = dg_count(in_list ? dg->opts->list_size : dg->opts->top_list_size, slist->min, slist->max, deep);
+
+    for (i = 0; i < count; ++i) {
+        pending = dg->pending_count;
+        list = dg_link(dg, parent, lyd_new(parent, lys_node_module(snode), snode->name));
+        if (!list) {
+            break;
+        }
+
+        /* the keys depend only on the position, they are unique among the siblings */
+        for (k = 0; k < slist->keys_size; ++k) {
+            if (slist->keys[k]->type.base == LY_TYPE_LEAFREF) {
+                key = dg_lref_key(dg, list, (struct lys_node *)slist->keys[k], i);
+            } else {
+                key = dg_new_leaf(dg, list, (struct lys_node *)slist->keys[k], &slist->keys[k]->type, i, !k);
+            }
+            if (!key) {
+                break;
+            }
+        }
+        if (k < slist->keys_size) {
+            dg_free(dg, list);
+            continue;
+        }
+
+        r = dg_children(dg, list, snode, NULL, depth + 1, 1);
+        if (r == -1) {
+            return -1;
+        }
+
+        for (key = list->child, k = 0; !r && (k < slist->keys_size); key = key->next, ++k) {
+            if (slist->keys[k]->type.base == LY_TYPE_LEAFREF) {
+                r = dg_lref_key_sync(list, (struct lyd_node_leaf_list *)key) ? DG_MISSING : 0;
+            }
+        }
+        if (r) {
+            /* the postponed leafrefs of the instance as well */
+            dg->pending_count = pending;
+            dg_free(dg, list);
+            continue;
+        }
+        ++created;
+    }
+
+    return (created < slist->min) ? DG_MISSING : 0;
+}
+
+static int
+dg_leaflist(struct datagen *dg, struct lyd_node *parent, const struct lys_node *snode, int deep)
+{
+    struct lys_node_leaflist *sllist = (struct lys_node_leaflist *)snode;
+    struct lyd_node *node, *iter;
+    uint32_t i, count, base, created = 0;
+
+    count = dg_count(dg->opts->leaflist_size, sllist->min, sllist->max, deep);
+    if (sllist->type.base == LY_TYPE_LEAFREF) {
+        return count ? dg_lref_postpone(dg, parent, snode, count) : 0;
+    }
+
+    /* consecutive values are distinct */
+    base = dg_rand(dg) % 1000000;
+    for (i = 0; i < count; ++i) {
+        node = dg_new_leaf(dg, parent, snode, &sllist->type, base + i, 1);
+        if (!node) {
+            continue;
+        }
+
+        LY_TREE_FOR(parent ? parent->child : dg->root, iter) {
+            if ((iter != node) && (iter->schema == snode) && !strcmp(((struct lyd_node_leaf_list *)iter)->value_str,
+                                                                     ((struct lyd_node_leaf_list *)node)->value_str)) {
+                break;
+            }
+        }
+        if (iter) {
+            dg_free(dg, node);
+        } else {
+            ++created;
+        }
+    }
+
+    return (created < sllist->min) ? DG_MISSING : 0;
+}
+
+static int
+dg_node(struct datagen *dg, struct lyd_node *parent, const struct lys_node *snode, uint32_t depth, int in_list)
+{
+    struct lys_node_leaf *sleaf;
+    const struct lys_node *cs, *iter;
+    struct lyd_node *node;
+    uint32_t count, i, pending;
+    int deep, mandatory, r;
+
+    if ((snode->flags & LYS_CONFIG_R) && !dg->opts->state) {
+        return 0;
+    }
+
+    deep = dg->opts->max_depth && (depth > dg->opts->max_depth);
+    mandatory = dg_is_mandatory(snode);
+
+    switch (snode->nodetype) {
+    case LYS_CONTAINER:
+        if (((struct lys_node_container *)snode)->presence && (deep || !dg_chance(dg, dg->opts->optional_pct))) {
+            return 0;
+        }
+        pending = dg->pending_count;
+        node = dg_link(dg, parent, lyd_new(parent, lys_node_module(snode), snode->name));
+        if (!node) {
+            return 0;
+        }
+        r = dg_children(dg, node, snode, NULL, depth + 1, in_list);
+        if (r == DG_MISSING) {
+            dg->pending_count = pending;
+            dg_free(dg, node);
+            if (((struct lys_node_container *)snode)->presence) {
+                /* the whole container is optional */
+                r = 0;
+            }
+        }
+        return r;
+    case LYS_CHOICE:
+        if (!mandatory && !((struct lys_node_choice *)snode)->dflt && (deep || !dg_chance(dg, dg->opts->optional_pct))) {
+            return 0;
+        }
+
+        count = 0;
+        for (iter = NULL; (iter = lys_getnext(iter, snode, NULL, LYS_GETNEXT_WITHCASE | LYS_GETNEXT_WITHCHOICE));) {
+            ++count;
+        }
+        if (!count) {
+            return 0;
+        }
+        cs = ((struct lys_node_choice *)snode)->dflt;
+        if (!cs || !dg_chance(dg, dg->opts->default_pct)) {
+            i = dg_rand(dg) % count;
+            for (cs = lys_getnext(NULL, snode, NULL, LYS_GETNEXT_WITHCASE | LYS_GETNEXT_WITHCHOICE); i; --i) {
+                cs = lys_getnext(cs, snode, NULL, LYS_GETNEXT_WITHCASE | LYS_GETNEXT_WITHCHOICE);
+            }
+        }
+        if (cs->nodetype != LYS_CASE) {
+            /* shorthand case */
+            r = dg_node(dg, parent, cs, depth, in_list);
+        } else {
+            r = dg_children(dg, parent, cs, NULL, depth, in_list);
+        }
+        /* a partially created case is left to the validation */
+        return (r == DG_MISSING && !mandatory) ? 0 : r;
+    case LYS_LEAF:
+        sleaf = (struct lys_node_leaf *)snode;
+        if (!mandatory && (deep || !dg_chance(dg, (sleaf->dflt || (sleaf->type.der && sleaf->type.der->dflt)) ?
+                                                  dg->opts->default_pct : dg->opts->optional_pct))) {
+            return 0;
+        }
+        if (sleaf->type.base == LY_TYPE_LEAFREF) {
+            return dg_lref_postpone(dg, parent, snode, 1);
+        }
+        if (!dg_new_leaf(dg, parent, snode, &sleaf->type, 0, 0) && mandatory) {
+            return DG_MISSING;
+        }
+        return 0;
+    case LYS_LEAFLIST:
+        if (!mandatory && (deep || !dg_chance(dg, dg->opts->optional_pct))) {
+            return 0;
+        }
+        return dg_leaflist(dg, parent, snode, deep);
+    case LYS_LIST:
+        return dg_list(dg, parent, snode, depth, in_list, deep);
+    case LYS_ANYDATA:
+    case LYS_ANYXML:
+        if (mandatory && !dg_link(dg, parent, lyd_new_anydata(parent, lys_node_module(snode), snode->name,
+                                                               (void *)"", LYD_ANYDATA_CONSTSTRING))) {
+            return DG_MISSING;
+        }
+        return 0;
+    default:
+        /* operations and notifications */
+        return 0;
+    }
+}
+
+/* returns DG_MISSING once a mandatory child is missing, the parent is then removed by the caller */
+static int
+dg_children(struct datagen *dg, struct lyd_node *parent, const struct lys_node *sparent,
+            const struct lys_module *module, uint32_t depth, int in_list)
+{
+    const struct lys_node *iter;
+    int r;
+
+    for (iter = NULL; (iter = lys_getnext(iter, sparent, module, LYS_GETNEXT_WITHCHOICE));) {
+        if ((iter->nodetype == LYS_LEAF) && lys_is_key((struct lys_node_leaf *)iter, NULL)) {
+            /* created with the list instance */
+            continue;
+        }
+        r = dg_node(dg, parent, iter, depth, in_list);
+        if (r == -1) {
+            return -1;
+        } else if (r && parent) {
+            return r;
+        }
+        /* a missing top-level node only is not generated */
+    }
+
+    return 0;
+}
+
+/* remove the empty non-presence containers, those with a default are added back by the validation */
+static void
+dg_prune(struct datagen *dg, struct lyd_node *first)
+{
+    struct lyd_node *iter, *next;
+
+    LY_TREE_FOR_SAFE(first, next, iter) {
+        if (iter->schema->nodetype & (LYS_CONTAINER | LYS_LIST)) {
+            dg_prune(dg, iter->child);
+            if (!iter->child && (iter->schema->nodetype == LYS_CONTAINER)
+                    && !((struct lys_node_container *)iter->schema)->presence) {
+                dg_free(dg, iter);
+            }
+        }
+    }
+}
+
+/* remove the nodes violating the restrictions not taken into account by the generator */
+static int
+dg_validate(struct datagen *dg, struct ly_ctx *ctx)
+{
+    struct ly_set *set;
+    struct lyd_node *node;
+    const char *path;
+    int options, i;
+
+    options = dg->opts->state ? LYD_OPT_DATA | LYD_OPT_DATA_NO_YANGLIB : LYD_OPT_CONFIG;
+    options |= LYD_OPT_WHENAUTODEL;
+
+    for (i = 0; i < DG_REPAIRS; ++i) {
+        if (!lyd_validate(&dg->root, options, ctx)) {
+            return 0;
+        }
+
+        path = ly_errpath(ctx);
+        if (!dg->root || !path || !path[0]) {
+            return -1;
+        }
+        set = lyd_find_path(dg->root, path);
+        if (!set || !set->number) {
+            ly_set_free(set);
+            return -1;
+        }
+
+        /* the last one, it is the duplicate in case of duplicate instances */
+        node = set->set.d[set->number - 1];
+        ly_set_free(set);
+        if ((node->schema->nodetype == LYS_LEAF) && lys_is_key((struct lys_node_leaf *)node->schema, NULL)) {
+            node = node->parent;
+        }
+        dg_free(dg, node);
+    }
+
+    return -1;
+}
+
+struct lyd_node *
+datagen_generate(struct ly_ctx *ctx, const struct lys_module *module, const struct datagen_opts *opts)
+{
+    struct datagen dg;
+    struct datagen_opts dflt;
+    const struct lys_module *mod;
+    uint32_t idx;
+    int log_opts, ret = 0;
+
+    if (!opts) {
+        datagen_opts_default(&dflt);
+        opts = &dflt;
+    }
+
+    memset(&dg, 0, sizeof dg);
+    dg.opts = opts;
+    dg.rnd = opts->seed * 0x9E3779B97F4A7C15ULL + 1;
+
+    /* the errors of the rejected values are expected */
+    log_opts = ly_log_options(LY_LOSTORE_LAST);
+
+    if (module) {
+        ret = dg_children(&dg, NULL, NULL, module, 1, 0);
+    } else {
+        idx = ly_ctx_internal_modules_count(ctx);
+        while (!ret && (mod = ly_ctx_get_module_iter(ctx, &idx))) {
+            if (mod->implemented) {
+                ret = dg_children(&dg, NULL, NULL, mod, 1, 0);
+            }
+        }
+    }
+
+    if (!ret) {
+        dg_lref_resolve(&dg);
+        dg_prune(&dg, dg.root);
+        ret = dg_validate(&dg, ctx);
+    }
+
+    ly_log_options(log_opts);
+    dg_lref_global_clean(&dg);
+    free(dg.pending);
+
+    if (ret) {
+        lyd_free_withsiblings(dg.root);
+        return NULL;
+    }
+    return dg.root;
+}
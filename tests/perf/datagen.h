@@ -0,0 +1,62 @@
+/**
+ * @file datagen.h
+ * @brief Generator of synthetic instance data of the loaded schemas for the benchmarks.
+ *
+ * Copyright (c) 2019 CESNET, z.s.p.o.
+ *
+ * This source code is licensed under BSD 3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://opensource.org/licenses/BSD-3-Clause
+ */
+
+#ifndef LY_DATAGEN_H_
+#define LY_DATAGEN_H_
+
+#include <stdint.h>
+
+#include "libyang.h"
+
+/**
+ * @brief Parameters of the generated data.
+ *
+ * The same parameters (including the seed) always generate the same data. The keys of the list instances
+ * depend only on their position, so the datasets generated with different seeds have the same instances
+ * and only their other values differ.
+ */
+struct datagen_opts {
+    uint32_t top_list_size;      /**< number of instances of the outermost lists (fan-out of the dataset) */
+    uint32_t list_size;          /**< number of instances of the lists nested in another list */
+    uint32_t leaflist_size;      /**< number of values of every leaf-list */
+    uint32_t max_depth;          /**< deeper than this, only the mandatory nodes and the minimal elements are created,
+                                      0 for unlimited */
+    uint8_t optional_pct;        /**< percentage of the optional nodes (and choices) created */
+    uint8_t default_pct;         /**< percentage of the leaves with a default value created explicitly */
+    uint32_t seed;               /**< seed of the generated values */
+    int state;                   /**< whether to generate also the state (config false) nodes */
+};
+
+/**
+ * @brief Initialize the generator parameters with the default values.
+ *
+ * @param[out] opts Parameters to initialize.
+ */
+void datagen_opts_default(struct datagen_opts *opts);
+
+/**
+ * @brief Generate valid instance data of the implemented modules of a context.
+ *
+ * The cardinality (mandatory, min-elements, max-elements), the choices and their defaults, the ranges, lengths,
+ * enumerations, bits and identities of the types, and the leafrefs are respected when generating the values. The
+ * string patterns are known for the common typedefs of ietf-inet-types and ietf-yang-types; other patterns, must,
+ * when and unique restrictions are left to the validation and the nodes violating them are removed.
+ *
+ * @param[in] ctx Context with the schemas.
+ * @param[in] module Module to generate the data of, NULL for all the implemented modules but the internal ones.
+ * @param[in] opts Parameters of the data, NULL for the default ones.
+ * @return Validated data tree, NULL on error (or if no data could be generated).
+ */
+struct lyd_node *datagen_generate(struct ly_ctx *ctx, const struct lys_module *module, const struct datagen_opts *opts);
+
+#endif /* LY_DATAGEN_H_ */
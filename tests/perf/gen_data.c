@@ -0,0 +1,160 @@
+/**
+ * @file gen_data.c
+ * @brief Generates synthetic instance data of the given schemas for the benchmarks.
+ *
+ * Copyright (c) 2019 CESNET, z.s.p.o.
+ *
+ * This source code is licensed under BSD 3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://opensource.org/licenses/BSD-3-Clause
+ */
+
+#define _GNU_SOURCE
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+#include "libyang.h"
+#include "datagen.h"
+
+static void
+usage(const char *name)
+{
+    struct datagen_opts opts;
+
+    datagen_opts_default(&opts);
+    fprintf(stderr, "Usage: %s [OPTIONS] SCHEMA ...\n\n", name);
+    fprintf(stderr, "  -p DIR      Search directory of the imported schemas.\n");
+    fprintf(stderr, "  -m MODULE   Generate the data of this module only (default all the given schemas).\n");
+    fprintf(stderr, "  -n COUNT    Instances of the outermost lists (default %u).\n", opts.top_list_size);
+    fprintf(stderr, "  -l COUNT    Instances of the nested lists (default %u).\n", opts.list_size);
+    fprintf(stderr, "  -L COUNT    Values of the leaf-lists (default %u).\n", opts.leaflist_size);
+    fprintf(stderr, "  -d DEPTH    Only the mandatory nodes deeper than DEPTH (default unlimited).\n");
+    fprintf(stderr, "  -o PERCENT  Optional nodes created (default %u).\n", opts.optional_pct);
+    fprintf(stderr, "  -D PERCENT  Leaves with a default value created explicitly (default %u).\n", opts.default_pct);
+    fprintf(stderr, "  -s SEED     Seed of the values (default %u).\n", opts.seed);
+    fprintf(stderr, "  -S          Generate also the state data.\n");
+    fprintf(stderr, "  -f FORMAT   Output format, xml, json or lyb (default xml).\n");
+    fprintf(stderr, "  -O FILE     Output file (default stdout).\n");
+}
+
+int
+main(int argc, char **argv)
+{
+    struct datagen_opts opts;
+    struct ly_ctx *ctx = NULL;
+    const struct lys_module *mod = NULL;
+    struct lyd_node *data = NULL;
+    const char *searchdir = NULL, *modname = NULL, *output = NULL;
+    LYD_FORMAT format = LYD_XML;
+    LYS_INFORMAT informat;
+    FILE *out = stdout;
+    int opt, i, ret = 1;
+
+    datagen_opts_default(&opts);
+    while ((opt = getopt(argc, argv, "p:m:n:l:L:d:o:D:s:Sf:O:h")) != -1) {
+        switch (opt) {
+        case 'p':
+            searchdir = optarg;
+            break;
+        case 'm':
+            modname = optarg;
+            break;
+        case 'n':
+            opts.top_list_size = strtoul(optarg, NULL, 10);
+            break;
+        case 'l':
+            opts.list_size = strtoul(optarg, NULL, 10);
+            break;
+        case 'L':
+            opts.leaflist_size = strtoul(optarg, NULL, 10);
+            break;
+        case 'd':
+            opts.max_depth = strtoul(optarg, NULL, 10);
+            break;
+        case 'o':
+            opts.optional_pct = strtoul(optarg, NULL, 10);
+            break;
+        case 'D':
+            opts.default_pct = strtoul(optarg, NULL, 10);
+            break;
+        case 's':
+            opts.seed = strtoul(optarg, NULL, 10);
+            break;
+        case 'S':
+            opts.state = 1;
+            break;
+        case 'f':
+            if (!strcmp(optarg, "xml")) {
+                format = LYD_XML;
+            } else if (!strcmp(optarg, "json")) {
+                format = LYD_JSON;
+            } else if (!strcmp(optarg, "lyb")) {
+                format = LYD_LYB;
+            } else {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'O':
+            output = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (optind == argc) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    ctx = ly_ctx_new(searchdir, 0);
+    if (!ctx) {
+        goto cleanup;
+    }
+    for (i = optind; i < argc; ++i) {
+        informat = (strlen(argv[i]) > 4 && !strcmp(argv[i] + strlen(argv[i]) - 4, ".yin")) ? LYS_IN_YIN : LYS_IN_YANG;
+        if (!lys_parse_path(ctx, argv[i], informat)) {
+            goto cleanup;
+        }
+    }
+    if (modname) {
+        mod = ly_ctx_get_module(ctx, modname, NULL, 1);
+        if (!mod) {
+            fprintf(stderr, "Module \"%s\" not found.\n", modname);
+            goto cleanup;
+        }
+    }
+
+    data = datagen_generate(ctx, mod, &opts);
+    if (!data) {
+        fprintf(stderr, "Failed to generate valid data.\n");
+        goto cleanup;
+    }
+
+    if (output) {
+        out = fopen(output, "w");
+        if (!out) {
+            perror("fopen");
+            goto cleanup;
+        }
+    }
+    if (lyd_print_file(out, data, format, LYP_WITHSIBLINGS | LYP_FORMAT)) {
+        goto cleanup;
+    }
+    ret = 0;
+
+cleanup:
+    if (out && (out != stdout)) {
+        fclose(out);
+    }
+    lyd_free_withsiblings(data);
+    ly_ctx_destroy(ctx, NULL);
+    return ret;
+}
@@ -0,0 +1,753 @@
+/**
+ * @file perf.c
+ * @brief Wall-clock benchmarks of the libyang data operations.
+ *
+ * Copyright (c) 2019 CESNET, z.s.p.o.
+ *
+ * This source code is licensed under BSD 3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://opensource.org/licenses/BSD-3-Clause
+ */
+
+#define _GNU_SOURCE
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <sys/resource.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "libyang.h"
+#include "datagen.h"
+
+#define BENCH_ITEMS 10000
+#define BENCH_REPEATS 5
+#define BENCH_SCHEMAS 16
+#define BENCH_XPATH "/bench:cont/item[value > 0]/name"
+
+static const char *schema =
+    "module bench {"
+    "  yang-version 1.1;"
+    "  namespace \"urn:libyang:bench\";"
+    "  prefix b;"
+    "  container cont {"
+    "    list item {"
+    "      key \"id\";"
+    "      leaf id { type uint32; }"
+    "      leaf name { type string { length \"1..64\"; } }"
+    "      leaf value { type int64; }"
+    "      leaf enabled { type boolean; default \"true\"; }"
+    "      leaf-list tag { type string; }"
+    "      container stats {"
+    "        leaf in { type uint64; }"
+    "        leaf out { type uint64; }"
+    "      }"
+    "    }"
+    "  }"
+    "}";
+
+struct bench_opts {
+    uint32_t items;              /* number of list instances in the dataset */
+    uint32_t repeats;
+    const char *yang[BENCH_SCHEMAS]; /* schemas of the generated dataset instead of the built-in one */
+    uint32_t yang_count;
+    const char *searchdir;
+    const char *xpath;
+    uint32_t threads;            /* maximum number of the threads of the threads test */
+};
+
+struct bench_state {
+    const struct bench_opts *opts;
+    struct ly_ctx *ctx;
+    struct lyd_node *data;       /* the validated dataset */
+    struct lyd_node *data2;      /* the dataset with every 10th value changed */
+    char *str[3];                /* the dataset printed in LYD_XML, LYD_JSON and LYD_LYB */
+    size_t str_len[3];
+    uint32_t nodes;              /* number of the data nodes of the dataset */
+
+    /* results of a single repetition, freed after it is measured */
+    struct ly_ctx *out_ctx;
+    struct lyd_node *out;
+    struct lyd_difflist *out_diff;
+    struct ly_set *out_set;
+    char *out_str;
+};
+
+struct bench_test {
+    const char *name;
+    int (*prepare)(struct bench_state *st);   /* before every repetition, not measured */
+    int (*run)(struct bench_state *st);       /* measured */
+    LYD_FORMAT format;                        /* format of the processed text, for the throughput */
+    int per_node;                             /* whether the operation processes all the dataset nodes */
+};
+
+static int
+str_index(LYD_FORMAT format)
+{
+    switch (format) {
+    case LYD_XML:
+        return 0;
+    case LYD_JSON:
+        return 1;
+    default:
+        return 2;
+    }
+}
+
+/*
+ * dataset
+ */
+
+static int
+bench_append(char **buf, size_t *len, size_t *size, const char *format, ...)
+{
+    va_list ap;
+    int r;
+    char *aux;
+
+    while (1) {
+        va_start(ap, format);
+        r = vsnprintf(*buf + *len, *size - *len, format, ap);
+        va_end(ap);
+        if (r < 0) {
+            return -1;
+        }
+        if (*len + r < *size) {
+            *len += r;
+            return 0;
+        }
+
+        *size = (*size + r) * 2;
+        aux = realloc(*buf, *size);
+        if (!aux) {
+            return -1;
+        }
+        *buf = aux;
+    }
+}
+
+/* the same items and values for the same number of items, so the results are comparable */
+static char *
+bench_gen_xml(uint32_t items)
+{
+    char *buf;
+    size_t len = 0, size = 4096;
+    uint32_t i;
+    int r;
+
+    buf = malloc(size);
+    if (!buf) {
+        return NULL;
+    }
+
+    r = bench_append(&buf, &len, &size, "<cont xmlns=\"urn:libyang:bench\">");
+    for (i = 1; !r && (i <= items); ++i) {
+        r = bench_append(&buf, &len, &size,
+                         "<item><id>%u</id><name>item-%u</name><value>%ld</value>"
+                         "<tag>t%u</tag><tag>all</tag>"
+                         "<stats><in>%lu</in><out>%lu</out></stats></item>",
+                         i, i, (long)((i * 7919UL) % 100000) - 50000, i % 8, i * 3UL, i * 5UL);
+    }
+    if (!r) {
+        r = bench_append(&buf, &len, &size, "</cont>");
+    }
+
+    if (r) {
+        free(buf);
+        return NULL;
+    }
+    return buf;
+}
+
+static uint32_t
+bench_count_nodes(struct lyd_node *data)
+{
+    struct lyd_node *root, *next, *elem;
+    uint32_t count = 0;
+
+    LY_TREE_FOR(data, root) {
+        LY_TREE_DFS_BEGIN(root, next, elem) {
+            ++count;
+            LY_TREE_DFS_END(root, next, elem);
+        }
+    }
+
+    return count;
+}
+
+static int
+bench_change_values(struct lyd_node *data)
+{
+    struct lyd_node *item, *leaf;
+    uint32_t i = 0;
+    char buf[32];
+
+    LY_TREE_FOR(data->child, item) {
+        if (i++ % 10) {
+            continue;
+        }
+        LY_TREE_FOR(item->child, leaf) {
+            if (!strcmp(leaf->schema->name, "value")) {
+                sprintf(buf, "%u", i);
+                if (lyd_change_leaf((struct lyd_node_leaf_list *)leaf, buf) < 0) {
+                    return -1;
+                }
+                break;
+            }
+        }
+    }
+
+    return 0;
+}
+
+static struct ly_ctx *
+bench_ctx_new(const struct bench_opts *opts)
+{
+    struct ly_ctx *ctx;
+    uint32_t i;
+
+    ctx = ly_ctx_new(opts->searchdir, 0);
+    if (!ctx) {
+        return NULL;
+    }
+
+    if (!opts->yang_count && !lys_parse_mem(ctx, schema, LYS_IN_YANG)) {
+        goto error;
+    }
+    for (i = 0; i < opts->yang_count; ++i) {
+        if (!lys_parse_path(ctx, opts->yang[i], LYS_IN_YANG)) {
+            goto error;
+        }
+    }
+    return ctx;
+
+error:
+    ly_ctx_destroy(ctx, NULL);
+    return NULL;
+}
+
+/* the list instances are the same and the other values differ for a different seed */
+static struct lyd_node *
+bench_gen_data(struct bench_state *st, uint32_t seed)
+{
+    struct datagen_opts opts;
+
+    datagen_opts_default(&opts);
+    opts.top_list_size = st->opts->items;
+    opts.seed = seed;
+    return datagen_generate(st->ctx, NULL, &opts);
+}
+
+static int
+bench_init(struct bench_state *st)
+{
+    char *xml;
+    int i;
+    LYD_FORMAT formats[] = {LYD_XML, LYD_JSON, LYD_LYB};
+
+    st->ctx = bench_ctx_new(st->opts);
+    if (!st->ctx) {
+        fprintf(stderr, "Failed to create the benchmark context.\n");
+        return -1;
+    }
+
+    if (st->opts->yang_count) {
+        st->data = bench_gen_data(st, 1);
+    } else {
+        xml = bench_gen_xml(st->opts->items);
+        if (!xml) {
+            fprintf(stderr, "Failed to generate the benchmark data.\n");
+            return -1;
+        }
+        st->data = lyd_parse_mem(st->ctx, xml, LYD_XML, LYD_OPT_CONFIG | LYD_OPT_STRICT);
+        free(xml);
+    }
+    if (!st->data) {
+        fprintf(stderr, "Failed to create the benchmark data.\n");
+        return -1;
+    }
+    st->nodes = bench_count_nodes(st->data);
+
+    /* the inputs of the parsers are printed, so they are canonical */
+    for (i = 0; i < 3; ++i) {
+        if (lyd_print_mem(&st->str[i], st->data, formats[i], LYP_WITHSIBLINGS) || !st->str[i]) {
+            fprintf(stderr, "Failed to print the benchmark data.\n");
+            return -1;
+        }
+        if (formats[i] == LYD_LYB) {
+            st->str_len[i] = lyd_lyb_data_length(st->str[i]);
+        } else {
+            st->str_len[i] = strlen(st->str[i]);
+        }
+    }
+
+    if (st->opts->yang_count) {
+        st->data2 = bench_gen_data(st, 2);
+    } else {
+        st->data2 = lyd_dup_withsiblings(st->data, LYD_DUP_OPT_RECURSIVE);
+    }
+    if (!st->data2 || (!st->opts->yang_count && bench_change_values(st->data2))) {
+        fprintf(stderr, "Failed to modify the benchmark data.\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+static void
+bench_clean_run(struct bench_state *st)
+{
+    ly_ctx_destroy(st->out_ctx, NULL);
+    st->out_ctx = NULL;
+    lyd_free_withsiblings(st->out);
+    st->out = NULL;
+    lyd_free_diff(st->out_diff);
+    st->out_diff = NULL;
+    ly_set_free(st->out_set);
+    st->out_set = NULL;
+    free(st->out_str);
+    st->out_str = NULL;
+}
+
+static void
+bench_clean(struct bench_state *st)
+{
+    int i;
+
+    bench_clean_run(st);
+    for (i = 0; i < 3; ++i) {
+        free(st->str[i]);
+    }
+    lyd_free_withsiblings(st->data);
+    lyd_free_withsiblings(st->data2);
+    ly_ctx_destroy(st->ctx, NULL);
+}
+
+/*
+ * tests
+ */
+
+static int
+run_ctx(struct bench_state *st)
+{
+    st->out_ctx = bench_ctx_new(st->opts);
+    return !st->out_ctx;
+}
+
+static int
+run_parse(struct bench_state *st, LYD_FORMAT format)
+{
+    st->out = lyd_parse_mem(st->ctx, st->str[str_index(format)], format, LYD_OPT_CONFIG | LYD_OPT_TRUSTED | LYD_OPT_STRICT);
+    return !st->out;
+}
+
+static int
+run_parse_xml(struct bench_state *st)
+{
+    return run_parse(st, LYD_XML);
+}
+
+static int
+run_parse_json(struct bench_state *st)
+{
+    return run_parse(st, LYD_JSON);
+}
+
+static int
+run_parse_lyb(struct bench_state *st)
+{
+    return run_parse(st, LYD_LYB);
+}
+
+static int
+run_print(struct bench_state *st, LYD_FORMAT format)
+{
+    return lyd_print_mem(&st->out_str, st->data, format, LYP_WITHSIBLINGS);
+}
+
+static int
+run_print_xml(struct bench_state *st)
+{
+    return run_print(st, LYD_XML);
+}
+
+static int
+run_print_json(struct bench_state *st)
+{
+    return run_print(st, LYD_JSON);
+}
+
+static int
+run_print_lyb(struct bench_state *st)
+{
+    return run_print(st, LYD_LYB);
+}
+
+static int
+prepare_validate(struct bench_state *st)
+{
+    /* parsed without validation */
+    return run_parse_xml(st);
+}
+
+static int
+run_validate(struct bench_state *st)
+{
+    return lyd_validate(&st->out, LYD_OPT_CONFIG, st->ctx);
+}
+
+static int
+run_dup(struct bench_state *st)
+{
+    st->out = lyd_dup_withsiblings(st->data, LYD_DUP_OPT_RECURSIVE);
+    return !st->out;
+}
+
+static int
+run_free(struct bench_state *st)
+{
+    lyd_free_withsiblings(st->out);
+    st->out = NULL;
+    return 0;
+}
+
+static int
+run_diff(struct bench_state *st)
+{
+    st->out_diff = lyd_diff(st->data, st->data2, 0);
+    return !st->out_diff;
+}
+
+static int
+run_merge(struct bench_state *st)
+{
+    return lyd_merge(st->out, st->data2, 0);
+}
+
+static int
+run_xpath(struct bench_state *st)
+{
+    st->out_set = lyd_find_path(st->data, st->opts->xpath);
+    return !st->out_set;
+}
+
+static const struct bench_test tests[] = {
+    {"ctx", NULL, run_ctx, LYD_UNKNOWN, 0},
+    {"parse_xml", NULL, run_parse_xml, LYD_XML, 1},
+    {"parse_json", NULL, run_parse_json, LYD_JSON, 1},
+    {"parse_lyb", NULL, run_parse_lyb, LYD_LYB, 1},
+    {"validate", prepare_validate, run_validate, LYD_UNKNOWN, 1},
+    {"print_xml", NULL, run_print_xml, LYD_XML, 1},
+    {"print_json", NULL, run_print_json, LYD_JSON, 1},
+    {"print_lyb", NULL, run_print_lyb, LYD_LYB, 1},
+    {"dup", NULL, run_dup, LYD_UNKNOWN, 1},
+    {"free", run_dup, run_free, LYD_UNKNOWN, 1},
+    {"diff", NULL, run_diff, LYD_UNKNOWN, 1},
+    {"merge", run_dup, run_merge, LYD_UNKNOWN, 1},
+    {"xpath", NULL, run_xpath, LYD_UNKNOWN, 1},
+};
+
+#define TEST_COUNT (sizeof tests / sizeof *tests)
+
+static uint64_t
+bench_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* runs in its own process, so the peak RSS is only of this test (and the dataset) */
+static int
+bench_run_test(const struct bench_test *test, const struct bench_opts *opts)
+{
+    struct bench_state st;
+    struct rusage usage;
+    uint64_t start, elapsed, best = UINT64_MAX, total = 0;
+    uint32_t r, nodes;
+    size_t bytes = 0;
+    int ret = 1;
+
+    memset(&st, 0, sizeof st);
+    st.opts = opts;
+    if (bench_init(&st)) {
+        goto cleanup;
+    }
+
+    /* the first repetition warms up the caches (compiled expressions, hash tables) and is not included */
+    for (r = 0; r <= opts->repeats; ++r) {
+        if (test->prepare && test->prepare(&st)) {
+            fprintf(stderr, "Test \"%s\" preparation failed.\n", test->name);
+            goto cleanup;
+        }
+
+        start = bench_now();
+        if (test->run(&st)) {
+            fprintf(stderr, "Test \"%s\" failed.\n", test->name);
+            goto cleanup;
+        }
+        elapsed = bench_now() - start;
+
+        bench_clean_run(&st);
+        if (!r) {
+            continue;
+        }
+        total += elapsed;
+        if (elapsed < best) {
+            best = elapsed;
+        }
+    }
+
+    getrusage(RUSAGE_SELF, &usage);
+    nodes = test->per_node ? st.nodes : 0;
+    if (test->format != LYD_UNKNOWN) {
+        bytes = st.str_len[str_index(test->format)];
+    }
+
+    printf("{\"test\":\"%s\",\"items\":%u,\"nodes\":%u,\"repeats\":%u,\"ns_per_op\":%lu,\"ns_per_op_mean\":%lu",
+           test->name, opts->items, nodes, opts->repeats, (unsigned long)best, (unsigned long)(total / opts->repeats));
+    if (nodes) {
+        printf(",\"ns_per_node\":%.2f,\"nodes_per_s\":%.0f", (double)best / nodes, nodes * 1e9 / best);
+    }
+    if (bytes) {
+        printf(",\"bytes\":%lu,\"mb_per_s\":%.2f", (unsigned long)bytes, bytes * 1e3 / best);
+    }
+    printf(",\"peak_rss_kb\":%ld}\n", usage.ru_maxrss);
+    fflush(stdout);
+    ret = 0;
+
+cleanup:
+    bench_clean(&st);
+    return ret;
+}
+
+/*
+ * multi-threaded use of a shared context
+ */
+
+struct bench_thread {
+    struct bench_state *st;
+    pthread_t tid;
+    int failed;
+};
+
+/* parse, validate and print the dataset, as a server processing requests would */
+static int
+bench_thread_op(struct bench_state *st)
+{
+    struct lyd_node *data;
+    char *str = NULL;
+    int ret;
+
+    data = lyd_parse_mem(st->ctx, st->str[str_index(LYD_XML)], LYD_XML, LYD_OPT_CONFIG | LYD_OPT_TRUSTED | LYD_OPT_STRICT);
+    if (!data) {
+        return -1;
+    }
+    ret = lyd_validate(&data, LYD_OPT_CONFIG, st->ctx);
+    if (!ret) {
+        ret = lyd_print_mem(&str, data, LYD_JSON, LYP_WITHSIBLINGS);
+    }
+
+    free(str);
+    lyd_free_withsiblings(data);
+    return ret;
+}
+
+static void *
+bench_thread_run(void *arg)
+{
+    struct bench_thread *thr = arg;
+    uint32_t r;
+
+    for (r = 0; !thr->failed && (r < thr->st->opts->repeats); ++r) {
+        thr->failed = bench_thread_op(thr->st);
+    }
+
+    return NULL;
+}
+
+/* 1, 2, 4, ... up to the maximum, 0 after it */
+static uint32_t
+bench_next_threads(uint32_t count, uint32_t max)
+{
+    if (count == max) {
+        return 0;
+    }
+    return (count * 2 < max) ? count * 2 : max;
+}
+
+/* all the threads do the same number of operations */
+static int
+bench_run_threads(const struct bench_opts *opts)
+{
+    struct bench_state st;
+    struct bench_thread *thr = NULL;
+    uint64_t start, elapsed;
+    uint32_t count, i, ops;
+    double ops_per_s, base = 0;
+    int ret = 1;
+
+    memset(&st, 0, sizeof st);
+    st.opts = opts;
+    if (bench_init(&st)) {
+        goto cleanup;
+    }
+    thr = calloc(opts->threads, sizeof *thr);
+    if (!thr) {
+        goto cleanup;
+    }
+
+    /* warm up the caches */
+    if (bench_thread_op(&st)) {
+        fprintf(stderr, "Test \"threads\" failed.\n");
+        goto cleanup;
+    }
+
+    for (count = 1; count; count = bench_next_threads(count, opts->threads)) {
+        start = bench_now();
+        for (i = 0; i < count; ++i) {
+            thr[i].st = &st;
+            thr[i].failed = 0;
+            if (pthread_create(&thr[i].tid, NULL, bench_thread_run, &thr[i])) {
+                fprintf(stderr, "Failed to create a thread.\n");
+                for (; i; --i) {
+                    pthread_join(thr[i - 1].tid, NULL);
+                }
+                goto cleanup;
+            }
+        }
+        for (i = 0; i < count; ++i) {
+            pthread_join(thr[i].tid, NULL);
+        }
+        elapsed = bench_now() - start;
+        for (i = 0; i < count; ++i) {
+            if (thr[i].failed) {
+                fprintf(stderr, "Test \"threads\" failed with %u threads.\n", count);
+                goto cleanup;
+            }
+        }
+
+        ops = count * opts->repeats;
+        ops_per_s = ops * 1e9 / elapsed;
+        if (count == 1) {
+            base = ops_per_s;
+        }
+        printf("{\"test\":\"threads\",\"items\":%u,\"nodes\":%u,\"repeats\":%u,\"threads\":%u,\"ns_per_op\":%lu,"
+               "\"ops_per_s\":%.2f,\"speedup\":%.2f,\"efficiency\":%.2f}\n", opts->items, st.nodes, opts->repeats, count,
+               (unsigned long)(elapsed / ops), ops_per_s, ops_per_s / base, ops_per_s / base / count);
+        fflush(stdout);
+    }
+    ret = 0;
+
+cleanup:
+    free(thr);
+    bench_clean(&st);
+    return ret;
+}
+
+static void
+usage(const char *name)
+{
+    uint32_t i;
+
+    fprintf(stderr, "Usage: %s [-n ITEMS] [-r REPEATS] [-t THREADS] [-y SCHEMA ... [-p DIR] [-x XPATH]] [TEST ...]\n\n", name);
+    fprintf(stderr, "  -n ITEMS    Number of the list instances in the dataset (default %u).\n", BENCH_ITEMS);
+    fprintf(stderr, "  -r REPEATS  Number of the measured repetitions of each test (default %u).\n", BENCH_REPEATS);
+    fprintf(stderr, "  -t THREADS  Maximum number of the threads of the threads test (default the online CPUs).\n");
+    fprintf(stderr, "  -y SCHEMA   Generate the dataset of this YANG schema instead of the built-in one,\n");
+    fprintf(stderr, "              with ITEMS instances of its outermost lists, can be repeated.\n");
+    fprintf(stderr, "  -p DIR      Search directory of the schemas imported by SCHEMA.\n");
+    fprintf(stderr, "  -x XPATH    Expression of the xpath test (default \"%s\", \"//*\" with -y).\n\n", BENCH_XPATH);
+    fprintf(stderr, "Prints one JSON object per test. Tests:");
+    for (i = 0; i < TEST_COUNT; ++i) {
+        fprintf(stderr, " %s", tests[i].name);
+    }
+    fprintf(stderr, " threads\n\n");
+    fprintf(stderr, "The threads test parses, validates and prints the dataset REPEATS times in each of 1, 2, 4, ...\n");
+    fprintf(stderr, "THREADS threads sharing the context and reports the throughput relative to a single thread.\n");
+}
+
+int
+main(int argc, char **argv)
+{
+    struct bench_opts opts;
+    uint32_t i;
+    int opt, j, status, ret = 0;
+    pid_t pid;
+
+    memset(&opts, 0, sizeof opts);
+    opts.items = BENCH_ITEMS;
+    opts.repeats = BENCH_REPEATS;
+    opts.threads = sysconf(_SC_NPROCESSORS_ONLN) > 0 ? sysconf(_SC_NPROCESSORS_ONLN) : 1;
+    while ((opt = getopt(argc, argv, "n:r:t:y:p:x:h")) != -1) {
+        switch (opt) {
+        case 'n':
+            opts.items = strtoul(optarg, NULL, 10);
+            break;
+        case 'r':
+            opts.repeats = strtoul(optarg, NULL, 10);
+            break;
+        case 't':
+            opts.threads = strtoul(optarg, NULL, 10);
+            break;
+        case 'y':
+            if (opts.yang_count == BENCH_SCHEMAS) {
+                usage(argv[0]);
+                return 1;
+            }
+            opts.yang[opts.yang_count++] = optarg;
+            break;
+        case 'p':
+            opts.searchdir = optarg;
+            break;
+        case 'x':
+            opts.xpath = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (!opts.items || !opts.repeats || !opts.threads) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (!opts.xpath) {
+        opts.xpath = opts.yang_count ? "//*" : BENCH_XPATH;
+    }
+
+    for (i = 0; i <= TEST_COUNT; ++i) {
+        if (optind < argc) {
+            /* only the selected tests */
+            for (j = optind; (j < argc) && strcmp(argv[j], (i < TEST_COUNT) ? tests[i].name : "threads"); ++j);
+            if (j == argc) {
+                continue;
+            }
+        }
+
+        fflush(stdout);
+        pid = fork();
+        if (pid == -1) {
+            perror("fork");
+            return 1;
+        } else if (!pid) {
+            exit((i < TEST_COUNT) ? bench_run_test(&tests[i], &opts) : bench_run_threads(&opts));
+        }
+
+        if ((waitpid(pid, &status, 0) == -1) || !WIFEXITED(status) || WEXITSTATUS(status)) {
+            ret = 1;
+        }
+    }
+
+    return ret;
+}
@@ -15,7 +15,7 @@
 #include <stdio.h>
 #include <string.h>
 
-#include <libyang/libyang.h>
+#include "libyang.h"
 
 int main(int argc, char *argv[])
 {
@@ -0,0 +1,332 @@
+/**
+ * @file batch.c
+ * @brief libyang's yanglint tool batch validation of many data files with a single context
+ *
+ * Copyright (c) 2019 CESNET, z.s.p.o.
+ *
+ * This source code is licensed under BSD 3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://opensource.org/licenses/BSD-3-Clause
+ */
+
+#define _GNU_SOURCE
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#include "batch.h"
+#include "libyang.h"
+
+extern volatile uint8_t verbose;
+
+/* shared state of the threads processing a batch */
+struct batch_state {
+    struct ly_ctx *ctx;
+    struct batch_list *batch;
+    int options;
+    FILE *out;
+    LYD_FORMAT outformat;
+    int print_options;
+
+    pthread_mutex_t lock;       /* protects the members below and the output */
+    unsigned int next;          /* next file to process */
+    unsigned int invalid;       /* number of the invalid files */
+    uint64_t bytes;             /* size of the processed files */
+};
+
+static int
+batch_format(const char *filename, LYD_FORMAT *format)
+{
+    const char *ext;
+
+    ext = strrchr(filename, '.');
+    if (ext && !strcmp(ext, ".xml")) {
+        *format = LYD_XML;
+    } else if (ext && !strcmp(ext, ".json")) {
+        *format = LYD_JSON;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+static int
+batch_add_file(struct batch_list *batch, const char *filename)
+{
+    struct batch_file *files;
+    LYD_FORMAT format;
+
+    if (batch_format(filename, &format)) {
+        fprintf(stderr, "yanglint error: batch data file \"%s\" is not an XML or JSON file.\n", filename);
+        return -1;
+    }
+
+    if (batch->count == batch->size) {
+        batch->size = batch->size ? batch->size * 2 : 64;
+        files = realloc(batch->files, batch->size * sizeof *files);
+        if (!files) {
+            fprintf(stderr, "yanglint error: memory allocation failed.\n");
+            return -1;
+        }
+        batch->files = files;
+    }
+    batch->files[batch->count].filename = strdup(filename);
+    if (!batch->files[batch->count].filename) {
+        fprintf(stderr, "yanglint error: memory allocation failed.\n");
+        return -1;
+    }
+    batch->files[batch->count].format = format;
+    ++batch->count;
+    return 0;
+}
+
+static int
+batch_cmp(const void *a, const void *b)
+{
+    return strcmp(((struct batch_file *)a)->filename, ((struct batch_file *)b)->filename);
+}
+
+static int
+batch_add_dir(struct batch_list *batch, const char *dirname)
+{
+    DIR *dir;
+    struct dirent *ent;
+    LYD_FORMAT format;
+    unsigned int first = batch->count;
+    char *path;
+    int ret = 0;
+
+    dir = opendir(dirname);
+    if (!dir) {
+        fprintf(stderr, "yanglint error: unable to open directory \"%s\" (%s).\n", dirname, strerror(errno));
+        return -1;
+    }
+    while (!ret && (ent = readdir(dir))) {
+        if ((ent->d_name[0] == '.') || batch_format(ent->d_name, &format)) {
+            continue;
+        }
+        if (asprintf(&path, "%s/%s", dirname, ent->d_name) == -1) {
+            fprintf(stderr, "yanglint error: memory allocation failed.\n");
+            ret = -1;
+            break;
+        }
+        ret = batch_add_file(batch, path);
+        free(path);
+    }
+    closedir(dir);
+
+    /* the directory order is arbitrary */
+    qsort(batch->files + first, batch->count - first, sizeof *batch->files, batch_cmp);
+    return ret;
+}
+
+static int
+batch_add_path(struct batch_list *batch, const char *path)
+{
+    struct stat st;
+
+    if (stat(path, &st) == -1) {
+        fprintf(stderr, "yanglint error: unable to use batch input \"%s\" (%s).\n", path, strerror(errno));
+        return -1;
+    }
+    if (S_ISDIR(st.st_mode)) {
+        return batch_add_dir(batch, path);
+    }
+    return batch_add_file(batch, path);
+}
+
+int
+batch_add(struct batch_list *batch, const char *filename, int list_file)
+{
+    FILE *f;
+    char *line = NULL, *start, *end;
+    size_t n = 0;
+    struct stat st;
+    int ret = 0;
+
+    if (!list_file || (!stat(filename, &st) && S_ISDIR(st.st_mode))) {
+        return batch_add_path(batch, filename);
+    }
+
+    f = fopen(filename, "r");
+    if (!f) {
+        fprintf(stderr, "yanglint error: unable to open batch list \"%s\" (%s).\n", filename, strerror(errno));
+        return -1;
+    }
+    while (!ret && (getline(&line, &n, f) != -1)) {
+        for (start = line; isspace(*start); ++start);
+        for (end = start + strlen(start); (end > start) && isspace(end[-1]); --end);
+        *end = '\0';
+        if (!start[0] || (start[0] == '#')) {
+            continue;
+        }
+        ret = batch_add_path(batch, start);
+    }
+    free(line);
+    fclose(f);
+    return ret;
+}
+
+void
+batch_clean(struct batch_list *batch)
+{
+    unsigned int i;
+
+    for (i = 0; i < batch->count; ++i) {
+        free(batch->files[i].filename);
+    }
+    free(batch->files);
+    memset(batch, 0, sizeof *batch);
+}
+
+static uint64_t
+batch_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void
+batch_file(struct batch_state *bs, const struct batch_file *file)
+{
+    struct lyd_node *tree;
+    struct stat st;
+    char *str = NULL;
+    int invalid = 0;
+
+    ly_errno = LY_SUCCESS;
+    tree = lyd_parse_path(bs->ctx, file->filename, file->format, bs->options);
+    if (ly_errno) {
+        invalid = 1;
+    } else if (bs->outformat && lyd_print_mem(&str, tree, bs->outformat, LYP_WITHSIBLINGS | bs->print_options)) {
+        invalid = 1;
+    }
+
+    pthread_mutex_lock(&bs->lock);
+    if (!stat(file->filename, &st)) {
+        bs->bytes += st.st_size;
+    }
+    if (invalid) {
+        ++bs->invalid;
+        fprintf(stderr, "yanglint error: data file \"%s\" is not valid.\n", file->filename);
+    } else {
+        if (verbose >= 2) {
+            fprintf(bs->out, "File %s:\n", file->filename);
+        }
+        if (str) {
+            fputs(str, bs->out);
+        }
+    }
+    pthread_mutex_unlock(&bs->lock);
+
+    free(str);
+    lyd_free_withsiblings(tree);
+}
+
+static void *
+batch_thread(void *arg)
+{
+    struct batch_state *bs = arg;
+    unsigned int i;
+
+    while (1) {
+        pthread_mutex_lock(&bs->lock);
+        i = bs->next++;
+        pthread_mutex_unlock(&bs->lock);
+        if (i >= bs->batch->count) {
+            break;
+        }
+        batch_file(bs, &bs->batch->files[i]);
+    }
+
+    return NULL;
+}
+
+static void
+batch_report_phase(FILE *f, const char *name, uint64_t ns, unsigned int count)
+{
+    fprintf(f, "  %-10s %12.3f %14.3f\n", name, ns / 1e9, count ? ns / 1e6 / count : 0.0);
+}
+
+int
+batch_run(struct ly_ctx *ctx, struct batch_list *batch, int options, unsigned int threads, FILE *out,
+          LYD_FORMAT outformat, int print_options)
+{
+    struct batch_state bs;
+    struct ly_ctx_counters start_cnt, end_cnt;
+    pthread_t *tids;
+    uint64_t start, wall, parse_ns, validate_ns;
+    unsigned int i, created;
+    FILE *report;
+
+    memset(&bs, 0, sizeof bs);
+    bs.ctx = ctx;
+    bs.batch = batch;
+    bs.options = options;
+    bs.out = out;
+    bs.outformat = outformat;
+    bs.print_options = print_options;
+    pthread_mutex_init(&bs.lock, NULL);
+
+    if (!threads) {
+        threads = 1;
+    }
+    if (threads > batch->count) {
+        threads = batch->count ? batch->count : 1;
+    }
+    tids = malloc(threads * sizeof *tids);
+    if (!tids) {
+        fprintf(stderr, "yanglint error: memory allocation failed.\n");
+        pthread_mutex_destroy(&bs.lock);
+        return -1;
+    }
+
+    ly_ctx_get_counters(ctx, &start_cnt);
+    start = batch_now();
+    for (created = 1; created < threads; ++created) {
+        if (pthread_create(&tids[created], NULL, batch_thread, &bs)) {
+            fprintf(stderr, "yanglint warning: unable to create a thread, using %u threads.\n", created);
+            break;
+        }
+    }
+    /* the main thread works as well */
+    batch_thread(&bs);
+    for (i = 1; i < created; ++i) {
+        pthread_join(tids[i], NULL);
+    }
+    wall = batch_now() - start;
+    ly_ctx_get_counters(ctx, &end_cnt);
+    free(tids);
+    pthread_mutex_destroy(&bs.lock);
+
+    /* the phase times are summed over the threads and the validation is nested in parsing */
+    validate_ns = end_cnt.phase_ns[LY_TRACE_VALIDATE] - start_cnt.phase_ns[LY_TRACE_VALIDATE];
+    parse_ns = end_cnt.phase_ns[LY_TRACE_PARSE] - start_cnt.phase_ns[LY_TRACE_PARSE];
+    parse_ns = (parse_ns > validate_ns) ? parse_ns - validate_ns : 0;
+
+    report = (out == stdout) && outformat ? stderr : stdout;
+    fprintf(report, "Batch: %u files (%.3f MB), %u valid, %u invalid, %u threads\n", batch->count, bs.bytes / 1e6,
+            batch->count - bs.invalid, bs.invalid, created);
+    fprintf(report, "Wall time: %.3f s (%.1f files/s, %.2f MB/s)\n", wall / 1e9,
+            wall ? batch->count * 1e9 / wall : 0.0, wall ? bs.bytes * 1e3 / wall : 0.0);
+    fprintf(report, "  %-10s %12s %14s\n", "phase", "total [s]", "per file [ms]");
+    batch_report_phase(report, "parse", parse_ns, batch->count);
+    batch_report_phase(report, "validate", validate_ns, batch->count);
+    if (outformat) {
+        batch_report_phase(report, "print", end_cnt.phase_ns[LY_TRACE_PRINT] - start_cnt.phase_ns[LY_TRACE_PRINT],
+                           batch->count);
+    }
+
+    return bs.invalid;
+}
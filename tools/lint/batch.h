@@ -0,0 +1,66 @@
+/**
+ * @file batch.h
+ * @brief libyang's yanglint tool batch validation header
+ *
+ * Copyright (c) 2019 CESNET, z.s.p.o.
+ *
+ * This source code is licensed under BSD 3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://opensource.org/licenses/BSD-3-Clause
+ */
+
+#ifndef BATCH_H_
+#define BATCH_H_
+
+#include <stdio.h>
+
+#include "libyang.h"
+
+struct batch_file {
+    char *filename;
+    LYD_FORMAT format;
+};
+
+/**
+ * @brief List of the data files validated in the batch mode.
+ */
+struct batch_list {
+    struct batch_file *files;
+    unsigned int count;
+    unsigned int size;
+};
+
+/**
+ * @brief Add a data file into a batch, XML and JSON files are accepted.
+ *
+ * @param[in] batch Batch to add to.
+ * @param[in] filename Data file or a directory to add all its XML and JSON files. If \p list_file is set,
+ * a regular file is a text file with one such file (or directory) per line ('#' starts a comment line).
+ * @param[in] list_file Whether \p filename, unless a directory, is a text file listing the data files.
+ * @return 0 on success, -1 on error.
+ */
+int batch_add(struct batch_list *batch, const char *filename, int list_file);
+
+/**
+ * @brief Free the files of a batch.
+ */
+void batch_clean(struct batch_list *batch);
+
+/**
+ * @brief Parse and validate every file of a batch with one context and print the timing report.
+ *
+ * @param[in] ctx Context with the schemas.
+ * @param[in] batch Files to validate.
+ * @param[in] options Parser options, only the data tree types are allowed.
+ * @param[in] threads Number of the threads processing the files.
+ * @param[in] out Output of the printed data, the report is printed to stdout unless it is also \p out.
+ * @param[in] outformat Format to print every valid file in, 0 to not print them.
+ * @param[in] print_options Printer options.
+ * @return Number of the invalid files, -1 on error.
+ */
+int batch_run(struct ly_ctx *ctx, struct batch_list *batch, int options, unsigned int threads, FILE *out,
+              LYD_FORMAT outformat, int print_options);
+
+#endif /* BATCH_H_ */
@@ -22,8 +22,10 @@
 #include <unistd.h>
 #include <getopt.h>
 #include <libgen.h>
+#include <time.h>
 
 #include "commands.h"
+#include "profile.h"
 #include "libyang.h"
 #include "../../src/tree_schema.h"
 #include "../../src/tree_data.h"
@@ -80,8 +82,9 @@ cmd_print_help(void)
 void
 cmd_data_help(void)
 {
-    printf("data [-(-s)trict] [-t TYPE] [-d DEFAULTS] [-o <output-file>] [-f (xml | json | lyb)] [-F (xml | json | lyb)]\n");
-    printf("     [-r <running-file-name>] <data-file-name> [<RPC/action-data-file-name> | <yang-data name>]\n\n");
+    printf("data [-(-s)trict] [-(-p)rofile] [-t TYPE] [-d DEFAULTS] [-o <output-file>] [-f (xml | json | lyb)]\n");
+    printf("     [-F (xml | json | lyb)] [-r <running-file-name>] <data-file-name>\n");
+    printf("     [<RPC/action-data-file-name> | <yang-data name>]\n\n");
     printf("Accepted TYPEs:\n");
     printf("\tauto       - resolve data type (one of the following) automatically (as pyang does),\n");
     printf("\t             this option is applicable only in case of XML input data.\n");
@@ -107,12 +110,15 @@ cmd_data_help(void)
     printf("\texternal references.\n\n");
     printf("\tIf an XPath expression (when/must) needs access to configuration data, you can provide\n");
     printf("\tthem in a file, which will be parsed as 'data' TYPE.\n\n");
+    printf("Option -p:\n");
+    printf("\tReport the when and must conditions and the leafrefs that took the most time and data node\n");
+    printf("\tvisits to evaluate while validating the data.\n\n");
 }
 
 void
 cmd_xpath_help(void)
 {
-    printf("xpath [-t TYPE] [-x <additional-tree-file-name>] -e <XPath-expression>\n"
+    printf("xpath [-(-p)rofile] [-t TYPE] [-x <additional-tree-file-name>] -e <XPath-expression>\n"
            "      <XML-data-file-name> [<JSON-rpc/action-schema-nodeid>]\n");
     printf("Accepted TYPEs:\n");
     printf("\tauto       - resolve data type (one of the following) automatically (as pyang does),\n");
@@ -127,7 +133,10 @@ cmd_xpath_help(void)
     printf("Option -x:\n");
     printf("\tIf RPC/action/notification/RPC reply (for TYPEs 'rpc', 'rpcreply', and 'notif') includes\n");
     printf("\tan XPath expression (when/must) that needs access to the configuration data, you can provide\n");
-    printf("\tthem in a file, which will be parsed as 'config'.\n");
+    printf("\tthem in a file, which will be parsed as 'config'.\n\n");
+    printf("Option -p:\n");
+    printf("\tReport the cost of the XPath expression and of the when and must conditions and the leafrefs\n");
+    printf("\tthat took the most time and data node visits to evaluate while validating the data.\n");
 }
 
 void
@@ -657,7 +666,7 @@ int
 cmd_data(const char *arg)
 {
     int c, argc, option_index, ret = 1;
-    int options = 0, printopt = 0;
+    int options = 0, printopt = 0, profile = 0;
     char **argv = NULL, *ptr;
     const char *out_path = NULL;
     struct lyd_node *data = NULL, *val_tree = NULL;
@@ -670,6 +679,7 @@ cmd_data(const char *arg)
         {"in-format", required_argument, 0, 'F'},
         {"option", required_argument, 0, 't'},
         {"output", required_argument, 0, 'o'},
+        {"profile", no_argument, 0, 'p'},
         {"running", required_argument, 0, 'r'},
         {"strict", no_argument, 0, 's'},
         {NULL, 0, 0, 0}
@@ -694,7 +704,7 @@ cmd_data(const char *arg)
     optind = 0;
     while (1) {
         option_index = 0;
-        c = getopt_long(argc, argv, "d:hf:F:o:st:r:", long_options, &option_index);
+        c = getopt_long(argc, argv, "d:hf:F:o:pst:r:", long_options, &option_index);
         if (c == -1) {
             break;
         }
@@ -746,6 +756,9 @@ cmd_data(const char *arg)
             }
             out_path = optarg;
             break;
+        case 'p':
+            profile = 1;
+            break;
         case 'r':
             if (val_tree || (options & LYD_OPT_NOEXTDEPS)) {
                 fprintf(stderr, "The running datastore (-r) cannot be set multiple times.\n");
@@ -806,7 +819,15 @@ cmd_data(const char *arg)
         goto cleanup;
     }
 
-    if (parse_data(argv[optind], informat, &options, val_tree, argv[optind + 1], &data)) {
+    if (profile && profile_start()) {
+        goto cleanup;
+    }
+    c = parse_data(argv[optind], informat, &options, val_tree, argv[optind + 1], &data);
+    if (profile) {
+        /* the constraints of invalid data are reported as well */
+        profile_stop(stdout);
+    }
+    if (c) {
         goto cleanup;
     }
 
@@ -848,7 +869,9 @@ cmd_xpath(const char *arg)
     int c, argc, option_index, ret = 1, long_str;
     char **argv = NULL, *ptr, *expr = NULL;
     unsigned int i, j;
-    int options = 0;
+    int options = 0, profile = 0;
+    struct ly_ctx_counters cnt_start, cnt_end;
+    struct timespec ts_start, ts_end;
     LYD_FORMAT informat = LYD_UNKNOWN;
     struct lyd_node *data = NULL, *node, *val_tree = NULL;
     struct lyd_node_leaf_list *key;
@@ -856,6 +879,7 @@ cmd_xpath(const char *arg)
     static struct option long_options[] = {
         {"help", no_argument, 0, 'h'},
         {"expr", required_argument, 0, 'e'},
+        {"profile", no_argument, 0, 'p'},
         {NULL, 0, 0, 0}
     };
     void *rlcd;
@@ -900,7 +924,7 @@ cmd_xpath(const char *arg)
     optind = 0;
     while (1) {
         option_index = 0;
-        c = getopt_long(argc, argv, "he:t:x:", long_options, &option_index);
+        c = getopt_long(argc, argv, "he:pt:x:", long_options, &option_index);
         if (c == -1) {
             break;
         }
@@ -913,6 +937,9 @@ cmd_xpath(const char *arg)
         case 'e':
             expr = optarg;
             break;
+        case 'p':
+            profile = 1;
+            break;
         case 't':
             if (!strcmp(optarg, "auto")) {
                 options = (options & ~LYD_OPT_TYPEMASK) | LYD_OPT_TYPEMASK;
@@ -961,11 +988,30 @@ cmd_xpath(const char *arg)
         goto cleanup;
     }
 
-    if (parse_data(argv[optind], informat, &options, val_tree, argv[optind + 1], &data)) {
+    if (profile && profile_start()) {
+        goto cleanup;
+    }
+    c = parse_data(argv[optind], informat, &options, val_tree, argv[optind + 1], &data);
+    if (profile) {
+        profile_stop(stdout);
+    }
+    if (c) {
         goto cleanup;
     }
 
-    if (!(set = lyd_find_path(data, expr))) {
+    if (profile) {
+        ly_ctx_get_counters(ctx, &cnt_start);
+        clock_gettime(CLOCK_MONOTONIC, &ts_start);
+    }
+    set = lyd_find_path(data, expr);
+    if (profile) {
+        clock_gettime(CLOCK_MONOTONIC, &ts_end);
+        ly_ctx_get_counters(ctx, &cnt_end);
+        printf("XPath expression: %.3f ms, %lu node visits\n\n", (ts_end.tv_sec - ts_start.tv_sec) * 1e3
+               + (ts_end.tv_nsec - ts_start.tv_nsec) / 1e6,
+               (unsigned long)(cnt_end.xpath_node_visits - cnt_start.xpath_node_visits));
+    }
+    if (!set) {
         goto cleanup;
     }
 
@@ -24,7 +24,9 @@
 #include <string.h>
 #include <unistd.h>
 
+#include "batch.h"
 #include "commands.h"
+#include "server.h"
 #include "libyang.h"
 
 volatile uint8_t verbose = 0;
@@ -40,6 +42,10 @@ help(int shortout)
     fprintf(stdout, "        Validates the YANG module in <file>, and all its dependencies.\n\n");
     fprintf(stdout, "    yanglint [options] [-f { xml | json }] <schema>... <file>...\n");
     fprintf(stdout, "        Validates the YANG modeled data in <file> according to the <schema>.\n\n");
+    fprintf(stdout, "    yanglint [options] [-f { xml | json }] <schema>... -b <list> [-j <jobs>] [<file>...]\n");
+    fprintf(stdout, "        Validates many YANG modeled data files with a single context and reports the timing.\n\n");
+    fprintf(stdout, "    yanglint [options] <schema>... -S[<socket>]\n");
+    fprintf(stdout, "        Keeps the context with the <schema>s and answers the validation requests.\n\n");
     fprintf(stdout, "    yanglint\n");
     fprintf(stdout, "        Starts interactive mode with more features.\n\n");
 
@@ -66,6 +72,25 @@ help(int shortout)
         "                        has no effect for schemas.\n\n"
         "  -m, --merge           Merge input data files into a single tree and validate at once,\n"
         "                        has no effect for the auto, rpc, rpcreply and notif TYPEs.\n\n"
+        "  -b LIST, --batch=LIST\n"
+        "                        Validate the data files in a batch, using the context created once. LIST is\n"
+        "                        a directory with the XML and JSON data files or a text file with a data file\n"
+        "                        (or directory) per line. The option can be used multiple times and the data\n"
+        "                        <file>s are added to the batch. The time and throughput of the parsing,\n"
+        "                        validation and printing is reported, the invalid files are listed. Only\n"
+        "                        the data, config, get, getconfig and edit TYPEs are supported.\n\n"
+        "  -j JOBS, --jobs=JOBS  Number of the threads validating a batch (default 1).\n\n"
+        "  -S[SOCKET], --server[=SOCKET]\n"
+        "                        Build the context once and answer the requests on the unix SOCKET (the\n"
+        "                        connections are handled one by one), or on stdin and stdout. A request is\n"
+        "                        a line with a command:\n"
+        "        validate [-t TYPE] [-s] (FILE | -F FORMAT -l LENGTH)\n"
+        "        convert -f FORMAT [-t TYPE] [-s] [-d MODE] (FILE | -F FORMAT -l LENGTH)\n"
+        "        xpath [-t TYPE] [-s] (FILE | -F FORMAT -l LENGTH) EXPRESSION\n"
+        "        modules\n"
+        "        quit | shutdown\n"
+        "                        With -l, LENGTH bytes of data follow the line. The answer is an \"OK LENGTH\"\n"
+        "                        or \"ERROR LENGTH\" line followed by LENGTH bytes of the output or the errors.\n\n"
         "  -f FORMAT, --format=FORMAT\n"
         "                        Convert to FORMAT. Supported formats: \n"
         "                        yang, yin, tree, tree-rfc and jsons (JSON) for schemas,\n"
@@ -249,6 +274,7 @@ main_ni(int argc, char* argv[])
     int opt, opt_index = 0, i, featsize = 0;
     struct option options[] = {
         {"auto",             no_argument,       NULL, 'a'},
+        {"batch",            required_argument, NULL, 'b'},
         {"default",          required_argument, NULL, 'd'},
         {"format",           required_argument, NULL, 'f'},
         {"features",         required_argument, NULL, 'F'},
@@ -260,12 +286,14 @@ main_ni(int argc, char* argv[])
         {"help",             no_argument,       NULL, 'h'},
         {"tree-help",        no_argument,       NULL, 'H'},
         {"allimplemented",   no_argument,       NULL, 'i'},
+        {"jobs",             required_argument, NULL, 'j'},
         {"disable-cwd-search", no_argument,     NULL, 'D'},
         {"list",             no_argument,       NULL, 'l'},
         {"merge",            no_argument,       NULL, 'm'},
         {"output",           required_argument, NULL, 'o'},
         {"path",             required_argument, NULL, 'p'},
         {"running",          required_argument, NULL, 'r'},
+        {"server",           optional_argument, NULL, 'S'},
         {"operational",      required_argument, NULL, 'O'},
         {"strict",           no_argument,       NULL, 's'},
         {"type",             required_argument, NULL, 't'},
@@ -303,18 +331,28 @@ main_ni(int argc, char* argv[])
     void *p;
     int index = 0;
     struct lyxml_elem *iter, *elem;
+    struct batch_list batch = {NULL, 0, 0};
+    int batch_mode = 0, server = 0;
+    const char *server_socket = NULL;
+    unsigned long jobs = 1;
 
     opterr = 0;
 #ifndef NDEBUG
-    while ((opt = getopt_long(argc, argv, "ad:f:F:gunP:L:hHiDlmo:p:r:O:st:vVG:y:", options, &opt_index)) != -1)
+    while ((opt = getopt_long(argc, argv, "ab:d:f:F:gunP:L:hHij:Dlmo:p:r:O:sS::t:vVG:y:", options, &opt_index)) != -1)
 #else
-    while ((opt = getopt_long(argc, argv, "ad:f:F:gunP:L:hHiDlmo:p:r:O:st:vVy:", options, &opt_index)) != -1)
+    while ((opt = getopt_long(argc, argv, "ab:d:f:F:gunP:L:hHij:Dlmo:p:r:O:sS::t:vVy:", options, &opt_index)) != -1)
 #endif
     {
         switch (opt) {
         case 'a':
             envelope = 1;
             break;
+        case 'b':
+            batch_mode = 1;
+            if (batch_add(&batch, optarg, 1)) {
+                goto cleanup;
+            }
+            break;
         case 'd':
             if (!strcmp(optarg, "all")) {
                 options_dflt = (options_dflt & ~LYP_WD_MASK) | LYP_WD_ALL;
@@ -406,6 +444,13 @@ main_ni(int argc, char* argv[])
         case 'i':
             options_ctx |= LY_CTX_ALLIMPLEMENTED;
             break;
+        case 'j':
+            jobs = strtoul(optarg, &ptr, 10);
+            if (ptr[0] || !jobs) {
+                fprintf(stderr, "yanglint error: invalid number of jobs \"%s\".\n", optarg);
+                goto cleanup;
+            }
+            break;
         case 'D':
             if (options_ctx & LY_CTX_DISABLE_SEARCHDIRS) {
                 fprintf(stderr, "yanglint error: -D specified too many times.\n");
@@ -464,6 +509,10 @@ main_ni(int argc, char* argv[])
         case 's':
             options_parser |= LYD_OPT_STRICT;
             break;
+        case 'S':
+            server = 1;
+            server_socket = optarg;
+            break;
         case 't':
             if (!strcmp(optarg, "auto")) {
                 options_parser = (options_parser & ~LYD_OPT_TYPEMASK);
@@ -563,7 +612,7 @@ main_ni(int argc, char* argv[])
     }
 
     /* check options compatibility */
-    if (!list && optind >= argc) {
+    if (!list && !batch_mode && !server && optind >= argc) {
         help(1);
         fprintf(stderr, "yanglint error: missing <file> to process\n");
         goto cleanup;
@@ -580,6 +629,29 @@ main_ni(int argc, char* argv[])
                     "yanglint warning: --tree options take effect only in case of the tree output format.\n");
         }
     }
+    if (server && (batch_mode || outformat_s || outformat_d || list)) {
+        fprintf(stderr, "yanglint error: server mode answers requests, batch, output format and list are not allowed.\n");
+        goto cleanup;
+    }
+    if (batch_mode) {
+        if (outformat_s || list) {
+            fprintf(stderr, "yanglint error: batch mode validates data, schema output and list are not allowed.\n");
+            goto cleanup;
+        }
+        if (autodetection || (options_parser & (LYD_OPT_RPC | LYD_OPT_RPCREPLY | LYD_OPT_NOTIF))) {
+            fprintf(stderr, "yanglint error: batch mode does not support the auto, rpc, rpcreply and notif TYPEs.\n");
+            goto cleanup;
+        }
+        if (merge) {
+            fprintf(stderr, "yanglint warning: merging not allowed in batch mode, ignoring option -m.\n");
+            merge = 0;
+        }
+        if (envelope) {
+            fprintf(stderr, "yanglint warning: envelopes are not printed in batch mode, ignoring option -a.\n");
+        }
+    } else if (jobs > 1) {
+        fprintf(stderr, "yanglint warning: jobs apply only to the batch mode, ignoring option -j.\n");
+    }
     if (merge) {
         if (autodetection || (options_parser & (LYD_OPT_RPC | LYD_OPT_RPCREPLY | LYD_OPT_NOTIF))) {
             fprintf(stderr, "yanglint warning: merging not allowed, ignoring option -m.\n");
@@ -663,6 +735,17 @@ main_ni(int argc, char* argv[])
                 goto cleanup;
             }
 
+            if (server) {
+                fprintf(stderr, "yanglint error: data file \"%s\" not allowed in server mode.\n", argv[optind + i]);
+                goto cleanup;
+            }
+            if (batch_mode) {
+                if (batch_add(&batch, argv[optind + i], 0)) {
+                    goto cleanup;
+                }
+                continue;
+            }
+
             /* remember data filename and its format */
             if (!data) {
                 data = data_item = malloc(sizeof *data);
@@ -680,7 +763,11 @@ main_ni(int argc, char* argv[])
         }
     }
 
-    if (outformat_d && !data && !list) {
+    if (batch_mode && !batch.count) {
+        fprintf(stderr, "yanglint error: no data file in the batch.\n");
+        goto cleanup;
+    }
+    if (outformat_d && !data && !list && !batch_mode) {
         fprintf(stderr, "yanglint error: no input data file for the specified data output format.\n");
         goto cleanup;
     }
@@ -714,7 +801,11 @@ main_ni(int argc, char* argv[])
     }
 
     /* convert (print) to FORMAT */
-    if (outformat_s) {
+    if (server) {
+        if (server_run(ctx, server_socket)) {
+            goto cleanup;
+        }
+    } else if (outformat_s) {
         if (outformat_s == LYS_OUT_JSON && mods->number > 1) {
             fputs("[", out);
         }
@@ -735,6 +826,11 @@ main_ni(int argc, char* argv[])
                 fputs("\n", out);
             }
         }
+    } else if (batch_mode) {
+        /* the report is printed to stderr if the data go to stdout */
+        if (batch_run(ctx, &batch, options_parser, jobs, out, outformat_d, LYP_FORMAT | options_dflt)) {
+            goto cleanup;
+        }
     } else if (data) {
         ly_errno = 0;
 
@@ -1043,6 +1139,7 @@ cleanup:
         free(data);
     }
     lyd_free_withsiblings(oper);
+    batch_clean(&batch);
     ly_ctx_destroy(ctx, NULL);
 
     return ret;
@@ -0,0 +1,202 @@
+/**
+ * @file profile.c
+ * @brief libyang's yanglint tool profiling of the data constraints
+ *
+ * Copyright (c) 2019 CESNET, z.s.p.o.
+ *
+ * This source code is licensed under BSD 3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://opensource.org/licenses/BSD-3-Clause
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "profile.h"
+#include "libyang.h"
+
+/* cost of a single constraint, summed over all its evaluations */
+struct profile_item {
+    LY_PROFILE_KIND kind;
+    const struct lys_node *snode;
+    const char *expr;
+    uint64_t evals;
+    uint64_t ns;
+    uint64_t visits;
+};
+
+/* the constraints are hashed by their schema node and expression into an open-addressing index of the items */
+static struct {
+    struct profile_item *items;
+    uint32_t count;
+    uint32_t size;              /* allocated items */
+    uint32_t *index;            /* item index + 1, 0 for an empty slot */
+    uint32_t index_size;        /* power of 2, at least twice the allocated items */
+    int failed;                 /* memory allocation failed, the report is incomplete */
+} profile;
+
+static uint32_t
+profile_hash(LY_PROFILE_KIND kind, const struct lys_node *snode, const char *expr)
+{
+    uint64_t h;
+
+    h = ((uintptr_t)snode ^ ((uintptr_t)expr << 7) ^ kind) * 0x9E3779B97F4A7C15ULL;
+    return (uint32_t)(h >> 32);
+}
+
+static int
+profile_grow(void)
+{
+    struct profile_item *items;
+    uint32_t *index, size, index_size, i, slot;
+
+    size = profile.size ? profile.size * 2 : 64;
+    index_size = size * 2;
+    items = realloc(profile.items, size * sizeof *items);
+    if (!items) {
+        return -1;
+    }
+    profile.items = items;
+    index = calloc(index_size, sizeof *index);
+    if (!index) {
+        return -1;
+    }
+
+    for (i = 0; i < profile.count; ++i) {
+        slot = profile_hash(items[i].kind, items[i].snode, items[i].expr) & (index_size - 1);
+        while (index[slot]) {
+            slot = (slot + 1) & (index_size - 1);
+        }
+        index[slot] = i + 1;
+    }
+    free(profile.index);
+    profile.index = index;
+    profile.index_size = index_size;
+    profile.size = size;
+    return 0;
+}
+
+static void
+profile_clb(LY_PROFILE_KIND kind, const struct lys_node *snode, const char *expr, uint64_t ns, uint64_t visits,
+            const struct ly_ctx *ctx)
+{
+    struct profile_item *item;
+    uint32_t slot;
+
+    (void)ctx;
+
+    if (profile.count == profile.size) {
+        if (profile.failed || profile_grow()) {
+            profile.failed = 1;
+            return;
+        }
+    }
+
+    slot = profile_hash(kind, snode, expr) & (profile.index_size - 1);
+    while (profile.index[slot]) {
+        item = &profile.items[profile.index[slot] - 1];
+        if ((item->kind == kind) && (item->snode == snode) && (item->expr == expr)) {
+            goto add;
+        }
+        slot = (slot + 1) & (profile.index_size - 1);
+    }
+
+    item = &profile.items[profile.count++];
+    memset(item, 0, sizeof *item);
+    item->kind = kind;
+    item->snode = snode;
+    item->expr = expr;
+    profile.index[slot] = profile.count;
+
+add:
+    ++item->evals;
+    item->ns += ns;
+    item->visits += visits;
+}
+
+int
+profile_start(void)
+{
+    memset(&profile, 0, sizeof profile);
+    if (ly_set_profile_clb(profile_clb)) {
+        fprintf(stderr, "Profiling is not supported, libyang was built without ENABLE_TRACE.\n");
+        return 1;
+    }
+    return 0;
+}
+
+static int
+profile_cmp(const void *a, const void *b)
+{
+    const struct profile_item *item1 = a, *item2 = b;
+
+    if (item1->ns != item2->ns) {
+        return (item1->ns < item2->ns) ? 1 : -1;
+    }
+    return (item1->visits < item2->visits) ? 1 : (item1->visits > item2->visits) ? -1 : 0;
+}
+
+static void
+profile_print(FILE *out, const char *title, int conditions)
+{
+    struct profile_item *item;
+    uint64_t evals = 0, ns = 0, visits = 0;
+    uint32_t i, printed = 0;
+    char *path;
+
+    for (i = 0; i < profile.count; ++i) {
+        item = &profile.items[i];
+        if ((item->kind == LY_PROFILE_LEAFREF) == conditions) {
+            continue;
+        }
+        evals += item->evals;
+        ns += item->ns;
+        visits += item->visits;
+    }
+    fprintf(out, "%s: %lu evaluations, %.3f ms, %lu node visits\n", title, (unsigned long)evals, ns / 1e6,
+            (unsigned long)visits);
+    if (!evals) {
+        fprintf(out, "\n");
+        return;
+    }
+
+    fprintf(out, "  %-7s %8s %10s %9s %10s %8s  %s\n", "kind", "evals", "total[ms]", "avg[us]", "visits", "avg",
+            "schema node / expression");
+    for (i = 0; (i < profile.count) && (printed < PROFILE_TOP); ++i) {
+        item = &profile.items[i];
+        if ((item->kind == LY_PROFILE_LEAFREF) == conditions) {
+            continue;
+        }
+        path = lys_path(item->snode, LYS_PATH_FIRST_PREFIX);
+        fprintf(out, "  %-7s %8lu %10.3f %9.2f %10lu %8.1f  %s\n", (item->kind == LY_PROFILE_WHEN) ? "when" :
+                (item->kind == LY_PROFILE_MUST) ? "must" : "leafref", (unsigned long)item->evals, item->ns / 1e6,
+                item->ns / 1e3 / item->evals, (unsigned long)item->visits, (double)item->visits / item->evals,
+                path ? path : item->snode->name);
+        fprintf(out, "  %58s  \"%s\"\n", "", item->expr);
+        free(path);
+        ++printed;
+    }
+    fprintf(out, "\n");
+}
+
+void
+profile_stop(FILE *out)
+{
+    ly_set_profile_clb(NULL);
+
+    qsort(profile.items, profile.count, sizeof *profile.items, profile_cmp);
+    fprintf(out, "Profile:\n");
+    if (profile.failed) {
+        fprintf(out, "Memory allocation failed, the profile is incomplete.\n");
+    }
+    profile_print(out, "when/must conditions", 1);
+    profile_print(out, "leafrefs", 0);
+
+    free(profile.items);
+    free(profile.index);
+    memset(&profile, 0, sizeof profile);
+}
@@ -0,0 +1,40 @@
+/**
+ * @file profile.h
+ * @brief libyang's yanglint tool profiling of the data constraints header
+ *
+ * Copyright (c) 2019 CESNET, z.s.p.o.
+ *
+ * This source code is licensed under BSD 3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://opensource.org/licenses/BSD-3-Clause
+ */
+
+#ifndef PROFILE_H_
+#define PROFILE_H_
+
+#include <stdio.h>
+
+#include "libyang.h"
+
+/* number of the most expensive constraints of each kind printed in the report */
+#define PROFILE_TOP 10
+
+/**
+ * @brief Start collecting the cost of the when, must and leafref evaluations of the data.
+ *
+ * @return 0 on success, non-zero if libyang was built without the support (ENABLE_TRACE).
+ */
+int profile_start(void);
+
+/**
+ * @brief Stop collecting and print the most expensive constraints, sorted by their total evaluation time.
+ *
+ * The schema nodes of the constraints must still exist.
+ *
+ * @param[in] out Output of the report.
+ */
+void profile_stop(FILE *out);
+
+#endif /* PROFILE_H_ */
@@ -0,0 +1,468 @@
+/**
+ * @file server.c
+ * @brief libyang's yanglint tool server mode answering requests with a context built once
+ *
+ * Copyright (c) 2019 CESNET, z.s.p.o.
+ *
+ * This source code is licensed under BSD 3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://opensource.org/licenses/BSD-3-Clause
+ */
+
+#define _GNU_SOURCE
+#include <ctype.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "server.h"
+#include "libyang.h"
+
+/* result of a request */
+enum server_status {
+    SERVER_OK = 0,
+    SERVER_ERROR,
+    SERVER_QUIT,        /* close the connection */
+    SERVER_SHUTDOWN     /* stop the server */
+};
+
+/* parsed arguments of a data request */
+struct server_req {
+    int options;                /* parser options */
+    int printopt;               /* printer options */
+    LYD_FORMAT informat;
+    LYD_FORMAT outformat;
+    long length;                /* length of the inline data, -1 for a file */
+    char *file;
+    char *data;                 /* inline data */
+};
+
+static char *
+server_token(char **str)
+{
+    char *token;
+
+    for (token = *str; isspace(*token); ++token);
+    if (!*token) {
+        *str = token;
+        return NULL;
+    }
+    for (*str = token; **str && !isspace(**str); ++(*str));
+    if (**str) {
+        **str = '\0';
+        ++(*str);
+    }
+    return token;
+}
+
+static int
+server_format(const char *str, LYD_FORMAT *format)
+{
+    const char *ext;
+
+    ext = strrchr(str, '.');
+    if (ext) {
+        str = ext + 1;
+    }
+    if (!strcmp(str, "xml")) {
+        *format = LYD_XML;
+    } else if (!strcmp(str, "json")) {
+        *format = LYD_JSON;
+    } else if (!strcmp(str, "lyb")) {
+        *format = LYD_LYB;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+static int
+server_type(const char *str, int *options)
+{
+    int type;
+
+    if (!strcmp(str, "data")) {
+        type = LYD_OPT_DATA_NO_YANGLIB;
+    } else if (!strcmp(str, "config")) {
+        type = LYD_OPT_CONFIG;
+    } else if (!strcmp(str, "get")) {
+        type = LYD_OPT_GET;
+    } else if (!strcmp(str, "getconfig")) {
+        type = LYD_OPT_GETCONFIG;
+    } else if (!strcmp(str, "edit")) {
+        type = LYD_OPT_EDIT;
+    } else {
+        return -1;
+    }
+    *options = (*options & ~(LYD_OPT_TYPEMASK | LYD_OPT_DATA_NO_YANGLIB)) | type;
+    return 0;
+}
+
+static int
+server_defaults(const char *str, int *printopt)
+{
+    if (!strcmp(str, "all")) {
+        *printopt = (*printopt & ~LYP_WD_MASK) | LYP_WD_ALL;
+    } else if (!strcmp(str, "all-tagged")) {
+        *printopt = (*printopt & ~LYP_WD_MASK) | LYP_WD_ALL_TAG;
+    } else if (!strcmp(str, "trim")) {
+        *printopt = (*printopt & ~LYP_WD_MASK) | LYP_WD_TRIM;
+    } else if (!strcmp(str, "implicit-tagged")) {
+        *printopt = (*printopt & ~LYP_WD_MASK) | LYP_WD_IMPL_TAG;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Parse the options and the data source of a data request and read its inline data.
+ *
+ * @param[in,out] args Arguments following the command, the rest after the data source on return.
+ * @param[in] in Input of the requests.
+ * @param[out] req Parsed arguments.
+ * @param[in] resp Output of the error messages.
+ * @return 0 on success, -1 on invalid arguments, -2 if the input failed.
+ */
+static int
+server_req_parse(char **args, FILE *in, struct server_req *req, FILE *resp)
+{
+    char *token, *ptr;
+    int ret = 0;
+
+    memset(req, 0, sizeof *req);
+    req->options = LYD_OPT_DATA_NO_YANGLIB;
+    req->printopt = LYP_WITHSIBLINGS | LYP_FORMAT;
+    req->length = -1;
+
+    while ((token = server_token(args)) && (token[0] == '-') && token[1]) {
+        if (!strcmp(token, "-s")) {
+            req->options |= LYD_OPT_STRICT;
+            continue;
+        }
+        ptr = server_token(args);
+        if (!ptr || token[2]) {
+            fprintf(resp, "Invalid option \"%s\".\n", token);
+            ret = -1;
+            break;
+        }
+        switch (token[1]) {
+        case 't':
+            if (server_type(ptr, &req->options)) {
+                fprintf(resp, "Invalid data type \"%s\".\n", ptr);
+                ret = -1;
+            }
+            break;
+        case 'f':
+            if (server_format(ptr, &req->outformat)) {
+                fprintf(resp, "Invalid output format \"%s\".\n", ptr);
+                ret = -1;
+            }
+            break;
+        case 'F':
+            if (server_format(ptr, &req->informat)) {
+                fprintf(resp, "Invalid input format \"%s\".\n", ptr);
+                ret = -1;
+            }
+            break;
+        case 'd':
+            if (server_defaults(ptr, &req->printopt)) {
+                fprintf(resp, "Invalid default mode \"%s\".\n", ptr);
+                ret = -1;
+            }
+            break;
+        case 'l':
+            req->length = strtol(ptr, &ptr, 10);
+            if (ptr[0] || (req->length < 0)) {
+                fprintf(resp, "Invalid data length.\n");
+                /* the data cannot be skipped */
+                return -2;
+            }
+            break;
+        default:
+            fprintf(resp, "Invalid option \"%s\".\n", token);
+            ret = -1;
+            break;
+        }
+    }
+
+    if (req->length > -1) {
+        /* the data are read even after an error to stay in sync with the client */
+        req->data = malloc(req->length + 1);
+        if (!req->data) {
+            fprintf(resp, "Memory allocation failed.\n");
+            return -2;
+        }
+        if (fread(req->data, 1, req->length, in) != (size_t)req->length) {
+            return -2;
+        }
+        req->data[req->length] = '\0';
+        if (!req->informat && !ret) {
+            fprintf(resp, "Missing the format of the inline data.\n");
+            ret = -1;
+        }
+        if (token) {
+            /* it is already the following argument, join it back with the rest */
+            if (*args != token + strlen(token)) {
+                token[strlen(token)] = ' ';
+            }
+            *args = token;
+        }
+    } else if (!ret) {
+        if (!token) {
+            fprintf(resp, "Missing the data file.\n");
+            return -1;
+        }
+        req->file = token;
+        if (!req->informat && server_format(req->file, &req->informat)) {
+            fprintf(resp, "Unknown format of the data file \"%s\".\n", req->file);
+            ret = -1;
+        }
+    }
+
+    return ret;
+}
+
+static struct lyd_node *
+server_req_data(struct ly_ctx *ctx, struct server_req *req)
+{
+    ly_errno = LY_SUCCESS;
+    if (req->data) {
+        return lyd_parse_mem(ctx, req->data, req->informat, req->options);
+    }
+    return lyd_parse_path(ctx, req->file, req->informat, req->options);
+}
+
+static void
+server_errors(struct ly_ctx *ctx, FILE *resp)
+{
+    struct ly_err_item *eitem;
+
+    for (eitem = ly_err_first(ctx); eitem; eitem = eitem->next) {
+        if (eitem->path) {
+            fprintf(resp, "%s: %s (%s)\n", (eitem->level == LY_LLERR) ? "err " : "warn", eitem->msg, eitem->path);
+        } else {
+            fprintf(resp, "%s: %s\n", (eitem->level == LY_LLERR) ? "err " : "warn", eitem->msg);
+        }
+    }
+    ly_err_clean(ctx, NULL);
+}
+
+static enum server_status
+server_data(struct ly_ctx *ctx, const char *cmd, char *args, FILE *in, FILE *resp)
+{
+    struct server_req req;
+    struct lyd_node *data = NULL, *node;
+    struct ly_set *set = NULL;
+    enum server_status status = SERVER_ERROR;
+    char *str = NULL, *expr = NULL;
+    unsigned int i;
+    int r;
+
+    r = server_req_parse(&args, in, &req, resp);
+    if (r == -2) {
+        free(req.data);
+        return SERVER_QUIT;
+    } else if (r) {
+        goto cleanup;
+    }
+
+    if (!strcmp(cmd, "convert") && !req.outformat) {
+        fprintf(resp, "Missing the output format.\n");
+        goto cleanup;
+    } else if (!strcmp(cmd, "xpath")) {
+        for (expr = args; isspace(*expr); ++expr);
+        for (i = strlen(expr); i && isspace(expr[i - 1]); --i);
+        expr[i] = '\0';
+        if (!expr[0]) {
+            fprintf(resp, "Missing the XPath expression.\n");
+            goto cleanup;
+        }
+    }
+
+    data = server_req_data(ctx, &req);
+    if (ly_errno) {
+        server_errors(ctx, resp);
+        goto cleanup;
+    }
+
+    if (!strcmp(cmd, "convert")) {
+        if (lyd_print_mem(&str, data, req.outformat, req.printopt)) {
+            server_errors(ctx, resp);
+            goto cleanup;
+        }
+        if (str) {
+            fputs(str, resp);
+        }
+    } else if (expr) {
+        if (!data) {
+            fprintf(resp, "The data are empty.\n");
+            goto cleanup;
+        }
+        set = lyd_find_path(data, expr);
+        if (!set) {
+            server_errors(ctx, resp);
+            goto cleanup;
+        }
+        for (i = 0; i < set->number; ++i) {
+            node = set->set.d[i];
+            free(str);
+            str = lyd_path(node);
+            if (node->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST)) {
+                fprintf(resp, "%s = %s\n", str, ((struct lyd_node_leaf_list *)node)->value_str);
+            } else {
+                fprintf(resp, "%s\n", str);
+            }
+        }
+    }
+    /* the warnings of valid data are not reported */
+    ly_err_clean(ctx, NULL);
+    status = SERVER_OK;
+
+cleanup:
+    ly_set_free(set);
+    free(str);
+    free(req.data);
+    lyd_free_withsiblings(data);
+    return status;
+}
+
+static enum server_status
+server_modules(struct ly_ctx *ctx, FILE *resp)
+{
+    const struct lys_module *mod;
+    uint32_t idx = 0;
+
+    while ((mod = ly_ctx_get_module_iter(ctx, &idx))) {
+        fprintf(resp, "%s%s%s%s\n", mod->name, mod->rev_size ? "@" : "", mod->rev_size ? mod->rev[0].date : "",
+                mod->implemented ? " (implemented)" : "");
+    }
+    return SERVER_OK;
+}
+
+/**
+ * @brief Answer the requests of a single client.
+ */
+static enum server_status
+server_session(struct ly_ctx *ctx, FILE *in, FILE *out)
+{
+    enum server_status status = SERVER_OK;
+    char *line = NULL, *args, *cmd, *buf = NULL;
+    size_t n = 0, len = 0;
+    FILE *resp;
+
+    while (getline(&line, &n, in) != -1) {
+        args = line;
+        cmd = server_token(&args);
+        if (!cmd) {
+            continue;
+        }
+
+        resp = open_memstream(&buf, &len);
+        if (!resp) {
+            status = SERVER_SHUTDOWN;
+            break;
+        }
+        if (!strcmp(cmd, "validate") || !strcmp(cmd, "convert") || !strcmp(cmd, "xpath")) {
+            status = server_data(ctx, cmd, args, in, resp);
+        } else if (!strcmp(cmd, "modules")) {
+            status = server_modules(ctx, resp);
+        } else if (!strcmp(cmd, "quit")) {
+            status = SERVER_QUIT;
+        } else if (!strcmp(cmd, "shutdown")) {
+            status = SERVER_SHUTDOWN;
+        } else {
+            fprintf(resp, "Unknown command \"%s\".\n", cmd);
+            status = SERVER_ERROR;
+        }
+        fclose(resp);
+
+        fprintf(out, "%s %lu\n", (status == SERVER_ERROR) ? "ERROR" : "OK", (unsigned long)len);
+        fwrite(buf, 1, len, out);
+        free(buf);
+        buf = NULL;
+        if (fflush(out) || (status == SERVER_QUIT) || (status == SERVER_SHUTDOWN)) {
+            break;
+        }
+    }
+
+    free(line);
+    return status;
+}
+
+int
+server_run(struct ly_ctx *ctx, const char *socket_path)
+{
+    struct sockaddr_un addr;
+    FILE *in, *out;
+    int sock, client, ret = -1;
+    enum server_status status = SERVER_OK;
+
+    /* the messages are stored and sent in the answers instead of being printed */
+    ly_log_options(LY_LOSTORE);
+    ly_log_store_limit(100);
+
+    if (!socket_path) {
+        server_session(ctx, stdin, stdout);
+        return 0;
+    }
+
+    if (strlen(socket_path) >= sizeof addr.sun_path) {
+        fprintf(stderr, "yanglint error: socket path \"%s\" is too long.\n", socket_path);
+        return -1;
+    }
+    sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (sock == -1) {
+        fprintf(stderr, "yanglint error: unable to create a socket (%s).\n", strerror(errno));
+        return -1;
+    }
+    memset(&addr, 0, sizeof addr);
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, socket_path);
+    unlink(socket_path);
+    if (bind(sock, (struct sockaddr *)&addr, sizeof addr) || listen(sock, 16)) {
+        fprintf(stderr, "yanglint error: unable to listen on \"%s\" (%s).\n", socket_path, strerror(errno));
+        close(sock);
+        return -1;
+    }
+    /* a client closing the connection must not stop the server */
+    signal(SIGPIPE, SIG_IGN);
+
+    while (status != SERVER_SHUTDOWN) {
+        client = accept(sock, NULL, NULL);
+        if (client == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            fprintf(stderr, "yanglint error: accepting a connection failed (%s).\n", strerror(errno));
+            goto cleanup;
+        }
+        in = fdopen(client, "r");
+        out = in ? fdopen(dup(client), "w") : NULL;
+        if (!out) {
+            fprintf(stderr, "yanglint error: unable to open a connection (%s).\n", strerror(errno));
+            if (in) {
+                fclose(in);
+            } else {
+                close(client);
+            }
+            continue;
+        }
+        status = server_session(ctx, in, out);
+        fclose(out);
+        fclose(in);
+    }
+    ret = 0;
+
+cleanup:
+    close(sock);
+    unlink(socket_path);
+    return ret;
+}
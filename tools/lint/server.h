@@ -0,0 +1,41 @@
+/**
+ * @file server.h
+ * @brief libyang's yanglint tool server mode header
+ *
+ * Copyright (c) 2019 CESNET, z.s.p.o.
+ *
+ * This source code is licensed under BSD 3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://opensource.org/licenses/BSD-3-Clause
+ */
+
+#ifndef SERVER_H_
+#define SERVER_H_
+
+#include "libyang.h"
+
+/**
+ * @brief Answer the requests with a context built once, until the input ends or a quit or shutdown request.
+ *
+ * Every request is a line with the command and its arguments separated by spaces:
+ * - validate [-t TYPE] [-s] (FILE | -F FORMAT -l LENGTH)
+ * - convert -f FORMAT [-t TYPE] [-s] [-d MODE] (FILE | -F FORMAT -l LENGTH)
+ * - xpath [-t TYPE] [-s] (FILE | -F FORMAT -l LENGTH) EXPRESSION
+ * - modules
+ * - quit (close the connection)
+ * - shutdown (stop the server)
+ *
+ * With -l, the data are not read from a file, but LENGTH bytes following the request line. The answer is
+ * "OK LENGTH" or "ERROR LENGTH" line followed by LENGTH bytes of the output (the converted data, the nodes
+ * matching the expression, the modules) or of the error messages.
+ *
+ * @param[in] ctx Context with the schemas.
+ * @param[in] socket_path Unix socket to listen on for the connections handled one by one,
+ * NULL to answer the requests from stdin on stdout.
+ * @return 0 on success, -1 on error.
+ */
+int server_run(struct ly_ctx *ctx, const char *socket_path);
+
+#endif /* SERVER_H_ */